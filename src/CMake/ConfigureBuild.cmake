@@ -43,6 +43,23 @@ ELSE (NOT CMAKE_MODULE_PATH)
 ENDIF (NOT CMAKE_MODULE_PATH)
 MARK_AS_ADVANCED(LIBMV_CMAKE_MODULE_PATH_OK)
 
+# Hot path timers and counters, see libmv/logging/logging.h.
+OPTION(WITH_INSTRUMENTATION
+       "Record the timers, counters and histograms and print them at exit." OFF)
+IF (WITH_INSTRUMENTATION)
+  ADD_DEFINITIONS(-DLIBMV_INSTRUMENTATION)
+ENDIF (WITH_INSTRUMENTATION)
+
+# Video input, see libmv/image/video_sequence.h.
+FIND_PACKAGE(FFmpeg)
+IF (FFMPEG_FOUND)
+  OPTION(WITH_FFMPEG "Read the frames of video files with FFmpeg." ON)
+ENDIF (FFMPEG_FOUND)
+IF (WITH_FFMPEG)
+  ADD_DEFINITIONS(-DLIBMV_HAVE_FFMPEG)
+  INCLUDE_DIRECTORIES(${FFMPEG_INCLUDE_DIRS})
+ENDIF (WITH_FFMPEG)
+
 IF (APPLE)
   # Tell gtest not to use mac frameworks.
   ADD_DEFINITIONS('-DGTEST_NOT_MAC_FRAMEWORK_MODE')
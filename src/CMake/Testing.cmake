@@ -41,4 +41,55 @@ MACRO (LIBMV_TEST NAME EXTRA_LIBS)
        ADD_TEST(${NAME}_test ${LIBMV_TESTS_OUTPUT_DIR}/${NAME}_test)
     # ENDIF (CMAKE_BUILD_TYPE STREQUAL "Debug")
   ENDIF (BUILD_TESTS)
-ENDMACRO (LIBMV_TEST)
\ No newline at end of file
+ENDMACRO (LIBMV_TEST)
+
+# Micro-benchmarks, see testing/benchmark.h. They are not run by ctest: run the
+# executables of ${LIBMV_BENCHMARKS_OUTPUT_DIR} with --benchmark_format=json to
+# record the results of a build.
+#
+# With BUILD_PERFORMANCE_TESTS, ctest also runs every benchmark executable as
+# the test ${NAME}_performance, labelled "performance", which fails when a
+# benchmark is more than LIBMV_PERFORMANCE_TOLERANCE slower than in the
+# baseline of this machine, in ${LIBMV_PERFORMANCE_BASELINES_DIR}/${NAME}.csv.
+# The first run records the baseline; delete it to record a new one. Only
+# compare release builds on an otherwise idle machine:
+#
+#   ctest -L performance --output-on-failure
+OPTION(BUILD_BENCHMARKS "Build the micro-benchmarks." OFF)
+OPTION(BUILD_PERFORMANCE_TESTS
+       "Test the speed of the micro-benchmarks against baselines." OFF)
+IF (BUILD_PERFORMANCE_TESTS)
+  SET(BUILD_BENCHMARKS ON)
+  SITE_NAME(LIBMV_SITE_NAME)
+  SET(LIBMV_PERFORMANCE_BASELINES_DIR
+      ${PROJECT_BINARY_DIR}/performance_baselines/${LIBMV_SITE_NAME}
+      CACHE PATH "Directory of the performance baselines of this machine.")
+  SET(LIBMV_PERFORMANCE_TOLERANCE 0.25 CACHE STRING
+      "Fraction by which a benchmark may be slower than its baseline.")
+  FILE(MAKE_DIRECTORY ${LIBMV_PERFORMANCE_BASELINES_DIR})
+ENDIF (BUILD_PERFORMANCE_TESTS)
+MACRO (LIBMV_BENCHMARK NAME EXTRA_LIBS)
+  IF (BUILD_BENCHMARKS)
+    ADD_EXECUTABLE(${NAME}_benchmark ${NAME}_benchmark.cc)
+    TARGET_LINK_LIBRARIES(${NAME}_benchmark
+                          ${EXTRA_LIBS} # Extra libs MUST be first.
+                          libmv_benchmark_main
+                          base
+                          glog
+                          gflags
+                          pthread)
+    SET_TARGET_PROPERTIES(${NAME}_benchmark PROPERTIES
+       RUNTIME_OUTPUT_DIRECTORY         ${LIBMV_BENCHMARKS_OUTPUT_DIR}
+       RUNTIME_OUTPUT_DIRECTORY_RELEASE ${LIBMV_BENCHMARKS_OUTPUT_DIR}
+       RUNTIME_OUTPUT_DIRECTORY_DEBUG   ${LIBMV_BENCHMARKS_OUTPUT_DIR})
+    IF (BUILD_PERFORMANCE_TESTS)
+      ADD_TEST(${NAME}_performance
+               ${LIBMV_BENCHMARKS_OUTPUT_DIR}/${NAME}_benchmark
+               --benchmark_repetitions=3
+               --benchmark_tolerance=${LIBMV_PERFORMANCE_TOLERANCE}
+               --benchmark_baseline=${LIBMV_PERFORMANCE_BASELINES_DIR}/${NAME}.csv)
+      SET_TESTS_PROPERTIES(${NAME}_performance PROPERTIES
+                           LABELS performance)
+    ENDIF (BUILD_PERFORMANCE_TESTS)
+  ENDIF (BUILD_BENCHMARKS)
+ENDMACRO (LIBMV_BENCHMARK)
@@ -0,0 +1,33 @@
+# - Find FFmpeg
+# Find the FFmpeg includes and the libraries decoding video files.
+# This module defines
+#  FFMPEG_INCLUDE_DIRS, where to find libavformat/avformat.h, etc.
+#  FFMPEG_LIBRARIES, the libraries needed to use FFmpeg.
+#  FFMPEG_FOUND, If false, do not try to use FFmpeg.
+# also defined, but not for general use are
+#  FFMPEG_AVFORMAT_LIBRARY, FFMPEG_AVCODEC_LIBRARY, FFMPEG_AVUTIL_LIBRARY and
+#  FFMPEG_SWSCALE_LIBRARY.
+
+FIND_PATH(FFMPEG_INCLUDE_DIR libavformat/avformat.h
+          PATH_SUFFIXES ffmpeg)
+
+FIND_LIBRARY(FFMPEG_AVFORMAT_LIBRARY NAMES avformat)
+FIND_LIBRARY(FFMPEG_AVCODEC_LIBRARY NAMES avcodec)
+FIND_LIBRARY(FFMPEG_AVUTIL_LIBRARY NAMES avutil)
+FIND_LIBRARY(FFMPEG_SWSCALE_LIBRARY NAMES swscale)
+
+IF (FFMPEG_INCLUDE_DIR AND FFMPEG_AVFORMAT_LIBRARY AND FFMPEG_AVCODEC_LIBRARY
+    AND FFMPEG_AVUTIL_LIBRARY AND FFMPEG_SWSCALE_LIBRARY)
+  SET(FFMPEG_FOUND TRUE)
+  SET(FFMPEG_INCLUDE_DIRS ${FFMPEG_INCLUDE_DIR})
+  SET(FFMPEG_LIBRARIES
+      ${FFMPEG_AVFORMAT_LIBRARY}
+      ${FFMPEG_AVCODEC_LIBRARY}
+      ${FFMPEG_SWSCALE_LIBRARY}
+      ${FFMPEG_AVUTIL_LIBRARY})
+ENDIF (FFMPEG_INCLUDE_DIR AND FFMPEG_AVFORMAT_LIBRARY AND FFMPEG_AVCODEC_LIBRARY
+       AND FFMPEG_AVUTIL_LIBRARY AND FFMPEG_SWSCALE_LIBRARY)
+
+MARK_AS_ADVANCED(FFMPEG_INCLUDE_DIR FFMPEG_AVFORMAT_LIBRARY
+                 FFMPEG_AVCODEC_LIBRARY FFMPEG_AVUTIL_LIBRARY
+                 FFMPEG_SWSCALE_LIBRARY)
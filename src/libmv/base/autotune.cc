@@ -0,0 +1,306 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <sstream>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "libmv/base/autotune.h"
+#include "libmv/base/cpu_features.h"
+#include "libmv/base/thread.h"
+#include "libmv/base/timer.h"
+
+namespace libmv {
+namespace {
+
+struct TuningState {
+  TuningState() : enabled(false), loaded(false) {
+    const char *value = getenv("LIBMV_AUTOTUNE");
+    enabled = value && value[0] && strcmp(value, "0") != 0;
+    const char *file = getenv("LIBMV_TUNING_FILE");
+    const char *home = getenv("HOME");
+    if (file) {
+      filename = file;
+    } else if (home && home[0]) {
+      filename = std::string(home) + "/.libmv_tuning";
+    }
+  }
+
+  // Protects the members below, but is not held while calibrating.
+  Mutex mutex;
+  bool enabled;
+  std::string filename;
+  // The values of this machine, read from the file once.
+  bool loaded;
+  std::map<std::string, int> values;
+};
+
+// Created on first use, which is thread safe with GCC and C++11 compilers.
+TuningState *State() {
+  static TuningState state;
+  return &state;
+}
+
+std::string WithoutSpaces(const std::string &text) {
+  std::string result = text;
+  for (size_t i = 0; i < result.size(); ++i) {
+    if (result[i] == ' ' || result[i] == '\t' || result[i] == '\n') {
+      result[i] = '_';
+    }
+  }
+  return result;
+}
+
+std::string HostName() {
+#ifdef _WIN32
+  const char *name = getenv("COMPUTERNAME");
+  return name ? name : "unknown";
+#else
+  char name[256];
+  if (gethostname(name, sizeof(name)) != 0) {
+    return "unknown";
+  }
+  name[sizeof(name) - 1] = '\0';
+  return name;
+#endif
+}
+
+// The "model name" of /proc/cpuinfo on Linux (x86), or its "CPU part" (ARM).
+std::string ProcessorModel() {
+  std::string model = "unknown";
+  FILE *in = fopen("/proc/cpuinfo", "r");
+  if (!in) {
+    return model;
+  }
+  char line[512];
+  while (fgets(line, sizeof(line), in)) {
+    const char *colon = strchr(line, ':');
+    if (!colon) {
+      continue;
+    }
+    if (strncmp(line, "model name", 10) == 0 ||
+        strncmp(line, "CPU part", 8) == 0) {
+      std::string value(colon + 1);
+      size_t begin = value.find_first_not_of(" \t");
+      size_t end = value.find_last_not_of(" \t\n");
+      if (begin != std::string::npos) {
+        model = value.substr(begin, end - begin + 1);
+      }
+      break;
+    }
+  }
+  fclose(in);
+  return model;
+}
+
+// Reads the lines "machine name value" of filename, all of them into lines
+// and the values of machine into values.
+void ReadTuningFile(const std::string &filename,
+                    const std::string &machine,
+                    std::vector<std::string> *lines,
+                    std::map<std::string, int> *values) {
+  FILE *in = fopen(filename.c_str(), "r");
+  if (!in) {
+    return;
+  }
+  char line[1024];
+  while (fgets(line, sizeof(line), in)) {
+    std::istringstream stream(line);
+    std::string line_machine, name;
+    int value;
+    if (!(stream >> line_machine >> name >> value)) {
+      continue;
+    }
+    if (lines) {
+      std::ostringstream entry;
+      entry << line_machine << " " << name << " " << value;
+      lines->push_back(entry.str());
+    }
+    if (values && line_machine == machine) {
+      (*values)[name] = value;
+    }
+  }
+  fclose(in);
+}
+
+// Replaces the value of name for machine in filename, keeping the other
+// lines. The file is written aside and renamed, so that concurrent processes
+// never read half of it.
+void WriteTunedValue(const std::string &filename,
+                     const std::string &machine,
+                     const std::string &name,
+                     int value) {
+  std::vector<std::string> lines;
+  ReadTuningFile(filename, machine, &lines, NULL);
+  std::string prefix = machine + " " + name + " ";
+  std::string temporary = filename + ".tmp";
+  FILE *out = fopen(temporary.c_str(), "w");
+  if (!out) {
+    return;
+  }
+  for (size_t i = 0; i < lines.size(); ++i) {
+    if (lines[i].compare(0, prefix.size(), prefix) != 0) {
+      fprintf(out, "%s\n", lines[i].c_str());
+    }
+  }
+  fprintf(out, "%s%d\n", prefix.c_str(), value);
+  fclose(out);
+  remove(filename.c_str());
+  rename(temporary.c_str(), filename.c_str());
+}
+
+}  // namespace
+
+int TunedValue(const std::string &name,
+               int default_value,
+               const std::vector<int> &candidates,
+               Calibration *calibration) {
+  TuningState *state = State();
+  std::string filename;
+  {
+    MutexLock lock(&state->mutex);
+    if (!state->enabled) {
+      return default_value;
+    }
+    if (!state->loaded) {
+      if (!state->filename.empty()) {
+        ReadTuningFile(state->filename, TuningMachine(), NULL,
+                       &state->values);
+      }
+      state->loaded = true;
+    }
+    std::map<std::string, int>::const_iterator it = state->values.find(name);
+    if (it != state->values.end()) {
+      return it->second;
+    }
+    filename = state->filename;
+  }
+
+  int best_value = default_value;
+  double best_seconds = MeasureCalibration(calibration, default_value);
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    if (candidates[i] == default_value ||
+        !calibration->Accepts(candidates[i])) {
+      continue;
+    }
+    double seconds = MeasureCalibration(calibration, candidates[i]);
+    if (seconds < best_seconds) {
+      best_seconds = seconds;
+      best_value = candidates[i];
+    }
+  }
+
+  MutexLock lock(&state->mutex);
+  state->values[name] = best_value;
+  if (!filename.empty()) {
+    WriteTunedValue(filename, TuningMachine(), name, best_value);
+  }
+  return best_value;
+}
+
+int TunedValue(const std::string &name,
+               int default_value,
+               const int *candidates,
+               int num_candidates,
+               Calibration *calibration) {
+  return TunedValue(name, default_value,
+                    std::vector<int>(candidates, candidates + num_candidates),
+                    calibration);
+}
+
+bool AutoTuning() {
+  TuningState *state = State();
+  MutexLock lock(&state->mutex);
+  return state->enabled;
+}
+
+void SetAutoTuning(bool enabled) {
+  TuningState *state = State();
+  MutexLock lock(&state->mutex);
+  state->enabled = enabled;
+}
+
+std::string TuningFile() {
+  TuningState *state = State();
+  MutexLock lock(&state->mutex);
+  return state->filename;
+}
+
+void SetTuningFile(const std::string &filename) {
+  TuningState *state = State();
+  MutexLock lock(&state->mutex);
+  state->filename = filename;
+  state->values.clear();
+  state->loaded = false;
+}
+
+std::string TuningMachine() {
+  std::ostringstream machine;
+  machine << HostName() << "/" << ProcessorModel() << "/" << NumProcessors()
+          << "/" << SimdLevelName(ActiveSimdLevel());
+  return WithoutSpaces(machine.str());
+}
+
+void ResetTunedValues() {
+  TuningState *state = State();
+  MutexLock lock(&state->mutex);
+  state->values.clear();
+  state->loaded = false;
+}
+
+double MeasureCalibration(Calibration *calibration,
+                          int value,
+                          double min_seconds,
+                          int repetitions) {
+  const int kMaxCalls = 1000000;
+  double best = 0;
+  for (int r = 0; r < repetitions; ++r) {
+    int calls = 1;
+    for (;;) {
+      WallTimer timer;
+      for (int i = 0; i < calls; ++i) {
+        calibration->Run(value);
+      }
+      double seconds = timer.ElapsedSeconds();
+      if (seconds >= min_seconds || calls >= kMaxCalls) {
+        double per_call = seconds / calls;
+        if (r == 0 || per_call < best) {
+          best = per_call;
+        }
+        break;
+      }
+      // Predict the number of calls from the last run, with some margin.
+      double next = 1.4 * calls * min_seconds / (seconds > 1e-9 ? seconds
+                                                                : 1e-9);
+      next = next < 100.0 * calls ? next : 100.0 * calls;
+      calls = next > calls + 1 ? static_cast<int>(next) : calls + 1;
+      calls = calls < kMaxCalls ? calls : kMaxCalls;
+    }
+  }
+  return best;
+}
+
+}  // namespace libmv
@@ -0,0 +1,97 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Tuning of the parameters of the kernels for the machine they run on. A
+// tuned parameter has a default value and a list of candidates; the first
+// time its value is asked for, every candidate is timed with a short
+// calibration benchmark and the fastest one is kept. The values are saved in
+// a file, by machine (host name, processor model, number of processors and
+// SIMD level), so that the next runs on the same machine read them instead.
+//
+// Only parameters that do not change the results, or whose calibration
+// rejects the candidates that lower the quality, are tuned. Tuning is off by
+// default, and the parameters then keep their default values: it is turned
+// on with SetAutoTuning() or the LIBMV_AUTOTUNE environment variable ("1").
+
+#ifndef LIBMV_BASE_AUTOTUNE_H
+#define LIBMV_BASE_AUTOTUNE_H
+
+#include <string>
+#include <vector>
+
+namespace libmv {
+
+// The calibration benchmark of a tuned parameter.
+class Calibration {
+ public:
+  virtual ~Calibration() {}
+  // Runs a fixed amount of work with the parameter set to value.
+  virtual void Run(int value) = 0;
+  // Whether value gives results as good as the default value; the rejected
+  // candidates are not timed. The default value is never rejected.
+  virtual bool Accepts(int /*value*/) { return true; }
+};
+
+// The value of the parameter name: default_value if tuning is off, else the
+// value saved for this machine, else the fastest of the candidates, which is
+// then saved. candidates should contain default_value. A parameter is
+// calibrated at most once per process; concurrent first calls may both
+// calibrate it. The calibration may use other tuned parameters, but not name.
+int TunedValue(const std::string &name,
+               int default_value,
+               const std::vector<int> &candidates,
+               Calibration *calibration);
+
+// Same as above with the candidates in an array.
+int TunedValue(const std::string &name,
+               int default_value,
+               const int *candidates,
+               int num_candidates,
+               Calibration *calibration);
+
+// Whether the parameters are tuned; set it at startup, before the tuned
+// kernels run, since most of them read their parameters once.
+bool AutoTuning();
+void SetAutoTuning(bool enabled);
+
+// The file the tuned values are saved in: $LIBMV_TUNING_FILE, else
+// $HOME/.libmv_tuning. With an empty name, the values are only kept for the
+// process.
+std::string TuningFile();
+void SetTuningFile(const std::string &filename);
+
+// The machine the values are saved for, without spaces.
+std::string TuningMachine();
+
+// Forgets the values tuned or read by this process; they are read from the
+// file again on next use.
+void ResetTunedValues();
+
+// The seconds per call of calibration->Run(value): the calls are repeated
+// until they take at least min_seconds, like the benchmark runner does, and
+// the fastest of repetitions measures is returned.
+double MeasureCalibration(Calibration *calibration,
+                          int value,
+                          double min_seconds = 0.02,
+                          int repetitions = 3);
+
+}  // namespace libmv
+
+#endif  // LIBMV_BASE_AUTOTUNE_H
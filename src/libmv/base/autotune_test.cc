@@ -0,0 +1,100 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstdio>
+#include <string>
+
+#include "libmv/base/autotune.h"
+#include "testing/testing.h"
+
+namespace libmv {
+namespace {
+
+// Work that is the shortest for value 3, and rejects value 4.
+class CountingCalibration : public Calibration {
+ public:
+  CountingCalibration() : runs(0), sum(0) {}
+
+  void Run(int value) {
+    ++runs;
+    int n = 2000 * ((value - 3) * (value - 3) + 1);
+    for (int i = 0; i < n; ++i) {
+      sum += i * 0.5;
+    }
+  }
+  bool Accepts(int value) { return value != 4; }
+
+  int runs;
+  volatile double sum;
+};
+
+const int kCandidates[] = { 1, 2, 3, 4 };
+
+TEST(AutoTune, OffKeepsTheDefault) {
+  bool enabled = AutoTuning();
+  SetAutoTuning(false);
+  CountingCalibration calibration;
+  EXPECT_EQ(1, TunedValue("test_off", 1, kCandidates, 4, &calibration));
+  EXPECT_EQ(0, calibration.runs);
+  SetAutoTuning(enabled);
+}
+
+TEST(AutoTune, KeepsTheFastestAndSavesIt) {
+  bool enabled = AutoTuning();
+  std::string filename = TuningFile();
+  std::string test_file = "/tmp/libmv_autotune_test_tuning";
+  remove(test_file.c_str());
+  SetTuningFile(test_file);
+  SetAutoTuning(true);
+
+  CountingCalibration calibration;
+  EXPECT_EQ(3, TunedValue("test_value", 1, kCandidates, 4, &calibration));
+  EXPECT_GT(calibration.runs, 0);
+
+  // Read from the file, without calibrating.
+  ResetTunedValues();
+  CountingCalibration other;
+  EXPECT_EQ(3, TunedValue("test_value", 1, kCandidates, 4, &other));
+  EXPECT_EQ(0, other.runs);
+
+  // The file has the value of this machine.
+  FILE *in = fopen(test_file.c_str(), "r");
+  ASSERT_TRUE(in != NULL);
+  char machine[512], name[64];
+  int value = 0;
+  EXPECT_EQ(3, fscanf(in, "%511s %63s %d", machine, name, &value));
+  fclose(in);
+  EXPECT_EQ(TuningMachine(), std::string(machine));
+  EXPECT_EQ(std::string("test_value"), std::string(name));
+  EXPECT_EQ(3, value);
+
+  remove(test_file.c_str());
+  SetTuningFile(filename);
+  SetAutoTuning(enabled);
+}
+
+TEST(AutoTune, MachineHasNoSpaces) {
+  std::string machine = TuningMachine();
+  EXPECT_FALSE(machine.empty());
+  EXPECT_EQ(std::string::npos, machine.find(' '));
+}
+
+}  // namespace
+}  // namespace libmv
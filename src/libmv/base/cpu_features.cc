@@ -0,0 +1,191 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+#include "libmv/base/cpu_features.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define LIBMV_CPUID_X86 1
+#elif (defined(__GNUC__) || defined(__clang__)) && \
+      (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define LIBMV_CPUID_X86 1
+#endif
+
+#if defined(__arm__) && defined(__linux__)
+#include <sys/auxv.h>
+#endif
+
+namespace libmv {
+namespace {
+
+const char *kSimdLevelNames[NUM_SIMD_LEVELS] = {
+  "scalar", "neon", "sse2", "sse4.1", "avx2", "avx512"
+};
+
+#ifdef LIBMV_CPUID_X86
+// The eax, ebx, ecx and edx registers of a CPUID leaf.
+void Cpuid(unsigned int leaf, unsigned int subleaf, unsigned int regs[4]) {
+#ifdef _MSC_VER
+  int r[4];
+  __cpuidex(r, leaf, subleaf);
+  for (int i = 0; i < 4; ++i) {
+    regs[i] = r[i];
+  }
+#else
+  __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// The register states the operating system saves, from XCR0.
+unsigned long long EnabledRegisterStates() {
+#ifdef _MSC_VER
+  return _xgetbv(0);
+#else
+  unsigned int eax, edx;
+  __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+
+inline bool Bit(unsigned int reg, int bit) {
+  return (reg >> bit) & 1;
+}
+
+void DetectX86(bool supported[NUM_SIMD_LEVELS]) {
+  unsigned int regs[4];
+  Cpuid(0, 0, regs);
+  const unsigned int max_leaf = regs[0];
+  if (max_leaf < 1) {
+    return;
+  }
+  Cpuid(1, 0, regs);
+  const unsigned int ecx = regs[2], edx = regs[3];
+  bool sse2 = Bit(edx, 26);
+  bool sse4_1 = Bit(ecx, 19);
+  bool fma = Bit(ecx, 12);
+  bool osxsave = Bit(ecx, 27);
+  bool avx = Bit(ecx, 28);
+  bool f16c = Bit(ecx, 29);
+  // The SSE and AVX states, then the AVX-512 opmask and upper registers.
+  unsigned long long states = osxsave ? EnabledRegisterStates() : 0;
+  bool os_avx = (states & 0x6) == 0x6;
+  bool os_avx512 = (states & 0xe6) == 0xe6;
+  bool avx2 = false, avx512f = false;
+  if (max_leaf >= 7) {
+    Cpuid(7, 0, regs);
+    avx2 = Bit(regs[1], 5);
+    avx512f = Bit(regs[1], 16);
+  }
+  supported[SIMD_SSE2] = sse2;
+  supported[SIMD_SSE4_1] = supported[SIMD_SSE2] && sse4_1;
+  supported[SIMD_AVX2] = supported[SIMD_SSE4_1] && avx && os_avx && avx2 &&
+                         fma && f16c;
+  supported[SIMD_AVX512] = supported[SIMD_AVX2] && avx512f && os_avx512;
+}
+#endif
+
+bool DetectNeon() {
+#if defined(__aarch64__) || defined(_M_ARM64)
+  return true;
+#elif defined(__arm__) && defined(__linux__)
+  // HWCAP_NEON, which not every libc defines.
+  return (getauxval(AT_HWCAP) >> 12) & 1;
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  return true;
+#else
+  return false;
+#endif
+}
+
+struct SimdState {
+  SimdState() : max_level(NUM_SIMD_LEVELS - 1) {
+    for (int i = 0; i < NUM_SIMD_LEVELS; ++i) {
+      supported[i] = false;
+    }
+    supported[SIMD_SCALAR] = true;
+    supported[SIMD_NEON] = DetectNeon();
+#ifdef LIBMV_CPUID_X86
+    DetectX86(supported);
+#endif
+    SimdLevel level;
+    const char *name = getenv("LIBMV_SIMD");
+    if (name && ParseSimdLevel(name, &level)) {
+      max_level = level;
+    }
+  }
+
+  bool supported[NUM_SIMD_LEVELS];
+  int max_level;
+};
+
+// Detected on first use, which is thread safe with GCC and C++11 compilers.
+SimdState &State() {
+  static SimdState state;
+  return state;
+}
+
+}  // namespace
+
+bool SimdLevelSupported(SimdLevel level) {
+  return State().supported[level];
+}
+
+bool SimdLevelEnabled(SimdLevel level) {
+  const SimdState &state = State();
+  return state.supported[level] && level <= state.max_level;
+}
+
+SimdLevel ActiveSimdLevel() {
+  for (int i = NUM_SIMD_LEVELS - 1; i > SIMD_SCALAR; --i) {
+    if (SimdLevelEnabled(static_cast<SimdLevel>(i))) {
+      return static_cast<SimdLevel>(i);
+    }
+  }
+  return SIMD_SCALAR;
+}
+
+void SetMaxSimdLevel(SimdLevel level) {
+  State().max_level = level;
+}
+
+SimdLevel MaxSimdLevel() {
+  return static_cast<SimdLevel>(State().max_level);
+}
+
+const char *SimdLevelName(SimdLevel level) {
+  return kSimdLevelNames[level];
+}
+
+bool ParseSimdLevel(const char *name, SimdLevel *level) {
+  for (int i = 0; i < NUM_SIMD_LEVELS; ++i) {
+    if (std::strcmp(name, kSimdLevelNames[i]) == 0) {
+      *level = static_cast<SimdLevel>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace libmv
@@ -0,0 +1,130 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+#ifndef LIBMV_BASE_CPU_FEATURES_H_
+#define LIBMV_BASE_CPU_FEATURES_H_
+
+#include <cstddef>
+
+namespace libmv {
+
+// The instruction sets a kernel can be specialized for. The x86 levels are
+// cumulative: SIMD_SSE4_1 implies SIMD_SSE2, etc. SIMD_AVX2 also requires
+// FMA and F16C, which every AVX2 processor has, and SIMD_AVX512 means
+// AVX-512F. The processor and the operating system (for the AVX registers)
+// must both support a level for it to be used.
+enum SimdLevel {
+  SIMD_SCALAR = 0,
+  SIMD_NEON,
+  SIMD_SSE2,
+  SIMD_SSE4_1,
+  SIMD_AVX2,
+  SIMD_AVX512,
+  NUM_SIMD_LEVELS
+};
+
+// Whether this processor supports level, from CPUID on x86 and HWCAP on ARM.
+// Detected once; SIMD_SCALAR is always supported.
+bool SimdLevelSupported(SimdLevel level);
+
+// Whether the kernels may use level: it is supported and not above the
+// maximum level. The maximum level comes from SetMaxSimdLevel() or else from
+// the LIBMV_SIMD environment variable (a name of SimdLevelName()), and is
+// unlimited by default. Capping it to SIMD_SCALAR runs the scalar fallbacks,
+// e.g. to benchmark them. NEON counts as below the x86 levels.
+bool SimdLevelEnabled(SimdLevel level);
+
+// The highest enabled level.
+SimdLevel ActiveSimdLevel();
+
+// Not thread safe with the kernels being selected; set it at startup, or
+// between the benchmarks.
+void SetMaxSimdLevel(SimdLevel level);
+SimdLevel MaxSimdLevel();
+
+// "scalar", "neon", "sse2", "sse4.1", "avx2" and "avx512".
+const char *SimdLevelName(SimdLevel level);
+// Returns false if name is not one of the names above.
+bool ParseSimdLevel(const char *name, SimdLevel *level);
+
+// The implementations of a kernel for several SIMD levels, starting with the
+// scalar one, which every kernel must have. Get() returns the implementation
+// of the highest enabled level, and costs a few comparisons; call it once per
+// image or array rather than once per pixel. Typically a function local
+// static:
+//
+//   const SimdDispatch<ConvertFunction> &Convert() {
+//     static const SimdDispatch<ConvertFunction> dispatch =
+//         SimdDispatch<ConvertFunction>(ConvertScalar)
+//             .Add(SIMD_SSE2, ConvertSSE2)
+//             .Add(SIMD_AVX2, ConvertAVX2);
+//     return dispatch;
+//   }
+//
+// The implementations for levels above the ones the compiler targets are
+// compiled with LIBMV_TARGET_AVX2 and its siblings.
+template<typename Function>
+class SimdDispatch {
+ public:
+  explicit SimdDispatch(Function scalar) {
+    for (int i = 0; i < NUM_SIMD_LEVELS; ++i) {
+      functions_[i] = NULL;
+    }
+    functions_[SIMD_SCALAR] = scalar;
+  }
+
+  SimdDispatch &Add(SimdLevel level, Function function) {
+    functions_[level] = function;
+    return *this;
+  }
+
+  Function Get() const {
+    return functions_[Level()];
+  }
+
+  // The level of the implementation Get() returns.
+  SimdLevel Level() const {
+    for (int i = NUM_SIMD_LEVELS - 1; i > SIMD_SCALAR; --i) {
+      if (functions_[i] && SimdLevelEnabled(static_cast<SimdLevel>(i))) {
+        return static_cast<SimdLevel>(i);
+      }
+    }
+    return SIMD_SCALAR;
+  }
+
+ private:
+  Function functions_[NUM_SIMD_LEVELS];
+};
+
+}  // namespace libmv
+
+// Compile a function for an instruction set above the ones of the build, with
+// GCC and Clang on x86; it must only be called once SimdLevelEnabled() says
+// so. LIBMV_HAVE_TARGET_X86 tells whether these are available.
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define LIBMV_HAVE_TARGET_X86 1
+#define LIBMV_TARGET_SSE4_1 __attribute__((target("sse4.1")))
+#define LIBMV_TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+#define LIBMV_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+#endif  // LIBMV_BASE_CPU_FEATURES_H_
@@ -0,0 +1,86 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+#include "libmv/base/cpu_features.h"
+#include "testing/testing.h"
+
+namespace {
+
+using namespace libmv;
+
+int Scalar() { return SIMD_SCALAR; }
+int SSE2() { return SIMD_SSE2; }
+int AVX2() { return SIMD_AVX2; }
+
+typedef int (*Function)();
+
+TEST(CpuFeatures, NamesRoundTrip) {
+  for (int i = 0; i < NUM_SIMD_LEVELS; ++i) {
+    SimdLevel level = static_cast<SimdLevel>(i), parsed;
+    EXPECT_TRUE(ParseSimdLevel(SimdLevelName(level), &parsed));
+    EXPECT_EQ(level, parsed);
+  }
+  SimdLevel level = SIMD_SSE2;
+  EXPECT_FALSE(ParseSimdLevel("mmx", &level));
+  EXPECT_EQ(SIMD_SSE2, level);
+}
+
+TEST(CpuFeatures, X86LevelsAreCumulative) {
+  EXPECT_TRUE(SimdLevelSupported(SIMD_SCALAR));
+  for (int i = SIMD_SSE4_1; i < NUM_SIMD_LEVELS; ++i) {
+    if (SimdLevelSupported(static_cast<SimdLevel>(i))) {
+      EXPECT_TRUE(SimdLevelSupported(static_cast<SimdLevel>(i - 1)));
+    }
+  }
+  EXPECT_FALSE(SimdLevelSupported(SIMD_NEON) &&
+               SimdLevelSupported(SIMD_SSE2));
+}
+
+TEST(CpuFeatures, MaxLevelSelectsTheImplementation) {
+  SimdLevel max_level = MaxSimdLevel();
+  SimdDispatch<Function> dispatch = SimdDispatch<Function>(Scalar)
+      .Add(SIMD_SSE2, SSE2)
+      .Add(SIMD_AVX2, AVX2);
+
+  SetMaxSimdLevel(SIMD_SCALAR);
+  EXPECT_EQ(SIMD_SCALAR, ActiveSimdLevel());
+  EXPECT_EQ(SIMD_SCALAR, dispatch.Get()());
+
+  SetMaxSimdLevel(SIMD_AVX512);
+  SimdLevel expected = SIMD_SCALAR;
+  if (SimdLevelSupported(SIMD_AVX2)) {
+    expected = SIMD_AVX2;
+  } else if (SimdLevelSupported(SIMD_SSE2)) {
+    expected = SIMD_SSE2;
+  }
+  EXPECT_EQ(expected, dispatch.Level());
+  EXPECT_EQ(expected, dispatch.Get()());
+  EXPECT_GE(ActiveSimdLevel(), expected);
+
+  // Levels without an implementation fall back to the next one below.
+  SetMaxSimdLevel(SIMD_SSE4_1);
+  EXPECT_EQ(SimdLevelSupported(SIMD_SSE2) ? SIMD_SSE2 : SIMD_SCALAR,
+            dispatch.Get()());
+
+  SetMaxSimdLevel(max_level);
+}
+
+}  // namespace
@@ -21,15 +21,34 @@
 #ifndef LIBMV_ID_GENERATOR_H
 #define LIBMV_ID_GENERATOR_H
 
+#include "libmv/base/thread.h"
+
 namespace libmv {
 
+// Generates sequential IDs. The generation is atomic, so that threads can
+// share a generator; Generate(count) reserves a block of consecutive IDs at
+// once.
 template <typename ID>
 class IdGenerator {
  public:
   IdGenerator() : next_(0) {}
-  ID Generate() { return next_++; }
+  ID Generate() { return Generate(1); }
+  // The first of count consecutive IDs.
+  ID Generate(int count) {
+#if defined(__GNUC__)
+    return __sync_fetch_and_add(&next_, static_cast<ID>(count));
+#else
+    MutexLock lock(&mutex_);
+    ID first = next_;
+    next_ += count;
+    return first;
+#endif
+  }
  private:
   ID next_;
+#if !defined(__GNUC__)
+  Mutex mutex_;
+#endif
 };
 
 }  // namespace libmv
@@ -0,0 +1,359 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/base/instrumentation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <map>
+#include <stdint.h>
+#include <vector>
+
+namespace libmv {
+namespace instrumentation {
+
+long long Counter::value() const {
+#if defined(__GNUC__)
+  return __sync_fetch_and_add(const_cast<long long *>(&value_), 0);
+#else
+  MutexLock lock(&mutex_);
+  return value_;
+#endif
+}
+
+Histogram::Histogram(const std::string &name)
+    : name_(name), count_(0), sum_(0),
+      min_(std::numeric_limits<double>::max()), max_(0) {
+  std::fill(buckets_, buckets_ + kNumBuckets, 0);
+}
+
+void Histogram::Add(double value) {
+  int bucket = 0;
+  if (value > 0) {
+    int exponent;
+    frexp(value, &exponent);
+    bucket = std::max(0, std::min(exponent + kOffset, kNumBuckets - 1));
+  }
+  MutexLock lock(&mutex_);
+  ++count_;
+  sum_ += value;
+  min_ = std::min(min_, value);
+  max_ = std::max(max_, value);
+  ++buckets_[bucket];
+}
+
+long long Histogram::count() const {
+  MutexLock lock(&mutex_);
+  return count_;
+}
+
+double Histogram::sum() const {
+  MutexLock lock(&mutex_);
+  return sum_;
+}
+
+double Histogram::min() const {
+  MutexLock lock(&mutex_);
+  return count_ ? min_ : 0;
+}
+
+double Histogram::max() const {
+  MutexLock lock(&mutex_);
+  return max_;
+}
+
+double Histogram::mean() const {
+  MutexLock lock(&mutex_);
+  return count_ ? sum_ / count_ : 0;
+}
+
+double Histogram::Percentile(double p) const {
+  MutexLock lock(&mutex_);
+  // The rank of the value, allowing for the rounding of p * count_.
+  long long rank = static_cast<long long>(ceil(p * count_ - 1e-9));
+  long long seen = 0;
+  for (int b = 0; b < kNumBuckets; ++b) {
+    seen += buckets_[b];
+    if (seen >= rank && seen > 0) {
+      return std::min(ldexp(1.0, b - kOffset), max_);
+    }
+  }
+  return max_;
+}
+
+namespace {
+
+template<typename T>
+struct Table {
+  typedef std::map<std::string, T *> Map;
+
+  T *Get(const char *name) {
+    typename Map::iterator it = entries.find(name);
+    if (it != entries.end()) {
+      return it->second;
+    }
+    T *entry = new T(name);
+    entries[name] = entry;
+    return entry;
+  }
+  Map entries;
+};
+
+struct Registry {
+  Mutex mutex;
+  Table<Counter> counters;
+  Table<Histogram> histograms;
+  Table<Histogram> timers;
+};
+
+void DumpAtExit() {
+  Dump(stderr);
+}
+
+// Never deleted, so that the statistics can be recorded until the exit.
+Registry *GetRegistry() {
+  static Registry *registry = NULL;
+  static Mutex mutex;
+  MutexLock lock(&mutex);
+  if (!registry) {
+    registry = new Registry;
+    atexit(DumpAtExit);
+  }
+  return registry;
+}
+
+struct TraceEvent {
+  const Histogram *timer;
+  double start;
+  double end;
+  int thread;
+};
+
+struct Trace {
+  Trace() : file(NULL), start(0), num_threads(0) {
+    pthread_key_create(&thread_key, NULL);
+  }
+  Mutex mutex;
+  FILE *file;
+  double start;
+  std::vector<TraceEvent> events;
+  // The index plus one of the calling thread in the trace files; the indices
+  // are kept from a trace to the next.
+  pthread_key_t thread_key;
+  int num_threads;
+};
+
+// Whether a trace is being recorded, read without taking the lock of the trace
+// so that the timers cost nothing more when there is none.
+int tracing = 0;
+
+bool ReadTracing() {
+#if defined(__GNUC__)
+  return __sync_fetch_and_add(&tracing, 0) != 0;
+#else
+  return tracing != 0;
+#endif
+}
+
+void SetTracing(bool enabled) {
+#if defined(__GNUC__)
+  __sync_lock_test_and_set(&tracing, enabled ? 1 : 0);
+#else
+  tracing = enabled ? 1 : 0;
+#endif
+}
+
+Trace *GetTrace() {
+  static Trace *trace = NULL;
+  static Mutex mutex;
+  MutexLock lock(&mutex);
+  if (!trace) {
+    trace = new Trace;
+  }
+  return trace;
+}
+
+// The mutex of the trace must be held.
+int ThreadIndex(Trace *trace) {
+  void *index = pthread_getspecific(trace->thread_key);
+  if (!index) {
+    index = reinterpret_cast<void *>(static_cast<intptr_t>(
+        ++trace->num_threads));
+    pthread_setspecific(trace->thread_key, index);
+  }
+  return static_cast<int>(reinterpret_cast<intptr_t>(index));
+}
+
+void WriteJsonString(FILE *out, const std::string &text) {
+  fputc('"', out);
+  for (size_t i = 0; i < text.size(); ++i) {
+    if (text[i] == '"' || text[i] == '\\') {
+      fputc('\\', out);
+    }
+    fputc(text[i], out);
+  }
+  fputc('"', out);
+}
+
+void StopTraceAtExit() {
+  if (IsTracing()) {
+    StopTrace();
+  }
+}
+
+}  // namespace
+
+Counter *GetCounter(const char *name) {
+  Registry *registry = GetRegistry();
+  MutexLock lock(&registry->mutex);
+  return registry->counters.Get(name);
+}
+
+Histogram *GetHistogram(const char *name) {
+  Registry *registry = GetRegistry();
+  MutexLock lock(&registry->mutex);
+  return registry->histograms.Get(name);
+}
+
+Histogram *GetTimer(const char *name) {
+  Registry *registry = GetRegistry();
+  MutexLock lock(&registry->mutex);
+  return registry->timers.Get(name);
+}
+
+void Dump(FILE *out) {
+  Registry *registry = GetRegistry();
+  MutexLock lock(&registry->mutex);
+
+  if (!registry->timers.entries.empty()) {
+    fprintf(out, "%-40s %10s %12s %12s %12s %12s\n", "Timer", "Calls",
+            "Total (s)", "Mean (ms)", "P90 (ms)", "Max (ms)");
+    Table<Histogram>::Map::const_iterator it = registry->timers.entries.begin();
+    for (; it != registry->timers.entries.end(); ++it) {
+      const Histogram &timer = *it->second;
+      fprintf(out, "%-40s %10lld %12.3f %12.3f %12.3f %12.3f\n",
+              timer.name().c_str(), timer.count(), timer.sum(),
+              1e3 * timer.mean(), 1e3 * timer.Percentile(0.9),
+              1e3 * timer.max());
+    }
+  }
+  if (!registry->counters.entries.empty()) {
+    fprintf(out, "%-40s %16s\n", "Counter", "Value");
+    Table<Counter>::Map::const_iterator it = registry->counters.entries.begin();
+    for (; it != registry->counters.entries.end(); ++it) {
+      fprintf(out, "%-40s %16lld\n",
+              it->second->name().c_str(), it->second->value());
+    }
+  }
+  if (!registry->histograms.entries.empty()) {
+    fprintf(out, "%-40s %10s %12s %12s %12s %12s\n", "Histogram", "Count",
+            "Mean", "Min", "P50", "Max");
+    Table<Histogram>::Map::const_iterator it =
+        registry->histograms.entries.begin();
+    for (; it != registry->histograms.entries.end(); ++it) {
+      const Histogram &histogram = *it->second;
+      fprintf(out, "%-40s %10lld %12.4g %12.4g %12.4g %12.4g\n",
+              histogram.name().c_str(), histogram.count(), histogram.mean(),
+              histogram.min(), histogram.Percentile(0.5), histogram.max());
+    }
+  }
+}
+
+bool StartTrace(const std::string &path) {
+  Trace *trace = GetTrace();
+  MutexLock lock(&trace->mutex);
+  if (trace->file) {
+    return false;
+  }
+  trace->file = fopen(path.c_str(), "w");
+  if (!trace->file) {
+    return false;
+  }
+  static bool registered = false;
+  if (!registered) {
+    atexit(StopTraceAtExit);
+    registered = true;
+  }
+  trace->start = WallTimeInSeconds();
+  trace->events.clear();
+  SetTracing(true);
+  return true;
+}
+
+bool StopTrace() {
+  Trace *trace = GetTrace();
+  MutexLock lock(&trace->mutex);
+  if (!trace->file) {
+    return false;
+  }
+  SetTracing(false);
+
+  // The times are in microseconds since the start of the trace.
+  FILE *out = trace->file;
+  fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+  fprintf(out, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, "
+          "\"args\": {\"name\": \"libmv\"}}");
+  for (int t = 1; t <= trace->num_threads; ++t) {
+    fprintf(out, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+            "\"tid\": %d, \"args\": {\"name\": \"thread %d\"}}", t, t);
+  }
+  for (size_t i = 0; i < trace->events.size(); ++i) {
+    const TraceEvent &event = trace->events[i];
+    fprintf(out, ",\n{\"name\": ");
+    WriteJsonString(out, event.timer->name());
+    fprintf(out, ", \"cat\": \"libmv\", \"ph\": \"X\", \"pid\": 1, "
+            "\"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+            event.thread, 1e6 * (event.start - trace->start),
+            1e6 * (event.end - event.start));
+  }
+  fprintf(out, "\n]}\n");
+  bool ok = !ferror(out);
+  ok = fclose(out) == 0 && ok;
+  trace->file = NULL;
+  trace->events.clear();
+  return ok;
+}
+
+bool IsTracing() {
+  return ReadTracing();
+}
+
+void AddTraceEvent(const Histogram *timer, double start, double end) {
+  if (!ReadTracing()) {
+    return;
+  }
+  Trace *trace = GetTrace();
+  MutexLock lock(&trace->mutex);
+  // The trace may have been stopped meanwhile.
+  if (!trace->file) {
+    return;
+  }
+  TraceEvent event;
+  event.timer = timer;
+  event.start = start;
+  event.end = end;
+  event.thread = ThreadIndex(trace);
+  trace->events.push_back(event);
+}
+
+}  // namespace instrumentation
+}  // namespace libmv
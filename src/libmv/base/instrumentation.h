@@ -0,0 +1,152 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+// Counters, histograms and timers of the hot paths of the library. They are
+// not meant to be used directly but through the LIBMV_COUNTER(),
+// LIBMV_HISTOGRAM() and LIBMV_SCOPED_TIMER() macros of logging.h, which only
+// record anything when the library is built with WITH_INSTRUMENTATION (which
+// defines LIBMV_INSTRUMENTATION). The statistics with the same name are
+// shared by all the places that record them, and all of them are printed to
+// the standard error when the process exits.
+//
+// The timed scopes can also be recorded as a timeline of every thread, see
+// StartTrace().
+
+#ifndef LIBMV_BASE_INSTRUMENTATION_H
+#define LIBMV_BASE_INSTRUMENTATION_H
+
+#include <cstdio>
+#include <string>
+
+#include "libmv/base/thread.h"
+#include "libmv/base/timer.h"
+
+namespace libmv {
+namespace instrumentation {
+
+// A sum that any thread can add to. Adding is a single atomic operation with
+// GCC compatible compilers, and takes a lock otherwise.
+class Counter {
+ public:
+  explicit Counter(const std::string &name) : name_(name), value_(0) {}
+
+  void Add(long long amount) {
+#if defined(__GNUC__)
+    __sync_fetch_and_add(&value_, amount);
+#else
+    MutexLock lock(&mutex_);
+    value_ += amount;
+#endif
+  }
+  long long value() const;
+  const std::string &name() const { return name_; }
+
+ private:
+  Counter(const Counter &);
+  Counter &operator=(const Counter &);
+
+  std::string name_;
+#if !defined(__GNUC__)
+  mutable Mutex mutex_;
+#endif
+  long long value_;
+};
+
+// The distribution of a positive quantity, in buckets of powers of two: the
+// percentiles are known within a factor of two.
+class Histogram {
+ public:
+  // Bucket b holds the values in [2^(b - kOffset - 1), 2^(b - kOffset)), the
+  // first and last buckets holding the smaller and larger values.
+  enum { kNumBuckets = 64, kOffset = 32 };
+
+  explicit Histogram(const std::string &name);
+
+  void Add(double value);
+
+  const std::string &name() const { return name_; }
+  long long count() const;
+  double sum() const;
+  double min() const;
+  double max() const;
+  double mean() const;
+  // The value that a fraction p of the values do not exceed, rounded up to a
+  // power of two, and no larger than max().
+  double Percentile(double p) const;
+
+ private:
+  Histogram(const Histogram &);
+  Histogram &operator=(const Histogram &);
+
+  std::string name_;
+  mutable Mutex mutex_;
+  long long count_;
+  double sum_, min_, max_;
+  long long buckets_[kNumBuckets];
+};
+
+// Starts recording the scopes of the timers, with the thread that ran them,
+// until StopTrace() or the exit of the process, when they are written to path
+// in the trace event format of Chrome: the file can be opened with
+// chrome://tracing or https://ui.perfetto.dev. The events are kept in memory
+// meanwhile. Returns false if the file cannot be created or a trace is already
+// being recorded.
+bool StartTrace(const std::string &path);
+// Writes the trace and stops recording. Returns false if the file could not
+// be written or no trace was being recorded.
+bool StopTrace();
+bool IsTracing();
+// Records that a scope of timer ran from start to end, in seconds of
+// WallTimeInSeconds(), if a trace is being recorded.
+void AddTraceEvent(const Histogram *timer, double start, double end);
+
+// Adds the seconds it lived to a histogram, and to the trace if any.
+class ScopedTimer {
+ public:
+  explicit ScopedTimer(Histogram *timer)
+      : timer_(timer), start_(WallTimeInSeconds()) {}
+  ~ScopedTimer() {
+    double end = WallTimeInSeconds();
+    timer_->Add(end - start_);
+    AddTraceEvent(timer_, start_, end);
+  }
+
+ private:
+  ScopedTimer(const ScopedTimer &);
+  ScopedTimer &operator=(const ScopedTimer &);
+
+  Histogram *timer_;
+  double start_;
+};
+
+// The statistics of a name, created on first use and never deleted. The
+// timers are histograms of durations in seconds, which are printed apart.
+Counter *GetCounter(const char *name);
+Histogram *GetHistogram(const char *name);
+Histogram *GetTimer(const char *name);
+
+// Prints all the statistics, sorted by name. This is done when the process
+// exits if any statistic was created.
+void Dump(FILE *out);
+
+}  // namespace instrumentation
+}  // namespace libmv
+
+#endif  // LIBMV_BASE_INSTRUMENTATION_H
@@ -0,0 +1,169 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstdio>
+#include <string>
+
+// The macros are tested whatever the build option.
+#ifndef LIBMV_INSTRUMENTATION
+#define LIBMV_INSTRUMENTATION
+#endif
+
+#include "libmv/base/instrumentation.h"
+#include "libmv/base/thread.h"
+#include "libmv/logging/logging.h"
+#include "testing/testing.h"
+
+namespace libmv {
+namespace instrumentation {
+namespace {
+
+struct AddOne {
+  explicit AddOne(Counter *counter) : counter(counter) {}
+  void operator()(int) { counter->Add(1); }
+  Counter *counter;
+};
+
+TEST(Counter, ConcurrentAdditions) {
+  Counter counter("test.concurrent");
+  AddOne add_one(&counter);
+  ParallelForDynamic(0, 20000, 4, &add_one);
+  EXPECT_EQ(20000, counter.value());
+}
+
+TEST(Histogram, Statistics) {
+  Histogram histogram("test.statistics");
+  EXPECT_EQ(0, histogram.count());
+  EXPECT_EQ(0, histogram.mean());
+  for (int i = 1; i <= 100; ++i) {
+    histogram.Add(i);
+  }
+  EXPECT_EQ(100, histogram.count());
+  EXPECT_EQ(5050, histogram.sum());
+  EXPECT_EQ(1, histogram.min());
+  EXPECT_EQ(100, histogram.max());
+  EXPECT_DOUBLE_EQ(50.5, histogram.mean());
+  // The 50th value is in [32, 64), the 7th in [4, 8).
+  EXPECT_EQ(64, histogram.Percentile(0.5));
+  EXPECT_EQ(8, histogram.Percentile(0.07));
+  EXPECT_EQ(100, histogram.Percentile(1));
+}
+
+TEST(Histogram, SmallValues) {
+  Histogram histogram("test.small");
+  histogram.Add(0);
+  histogram.Add(1e-3);
+  EXPECT_EQ(0, histogram.min());
+  EXPECT_EQ(1e-3, histogram.Percentile(1));
+}
+
+TEST(Registry, SameNameSameStatistic) {
+  EXPECT_EQ(GetCounter("test.registry"), GetCounter("test.registry"));
+  EXPECT_EQ(GetTimer("test.registry"), GetTimer("test.registry"));
+  EXPECT_NE(GetTimer("test.registry"), GetHistogram("test.registry"));
+}
+
+void Instrumented(int amount) {
+  LIBMV_SCOPED_TIMER("test.macros.timer");
+  LIBMV_COUNTER("test.macros.counter", amount);
+  LIBMV_HISTOGRAM("test.macros.histogram", amount);
+}
+
+TEST(Macros, RecordIntoTheNamedStatistics) {
+  Instrumented(2);
+  Instrumented(5);
+  EXPECT_EQ(7, GetCounter("test.macros.counter")->value());
+  EXPECT_EQ(2, GetHistogram("test.macros.histogram")->count());
+  EXPECT_EQ(5, GetHistogram("test.macros.histogram")->max());
+  EXPECT_EQ(2, GetTimer("test.macros.timer")->count());
+  EXPECT_LE(0, GetTimer("test.macros.timer")->min());
+}
+
+std::string ReadAll(FILE *in) {
+  std::string text;
+  rewind(in);
+  for (int c; (c = fgetc(in)) != EOF; ) {
+    text += static_cast<char>(c);
+  }
+  return text;
+}
+
+TEST(Dump, PrintsEveryStatistic) {
+  GetCounter("test.dump.counter")->Add(3);
+  GetHistogram("test.dump.histogram")->Add(1);
+  GetTimer("test.dump.timer")->Add(0.5);
+
+  FILE *out = tmpfile();
+  ASSERT_TRUE(out != NULL);
+  Dump(out);
+  std::string text = ReadAll(out);
+  fclose(out);
+  EXPECT_NE(std::string::npos, text.find("test.dump.counter"));
+  EXPECT_NE(std::string::npos, text.find("test.dump.histogram"));
+  EXPECT_NE(std::string::npos, text.find("test.dump.timer"));
+}
+
+struct TimeScopes {
+  void operator()(int) { LIBMV_SCOPED_TIMER("test.trace.parallel"); }
+};
+
+TEST(Trace, RecordsTheScopesOfTheTimers) {
+  std::string filename = "/tmp/libmv_instrumentation_test_trace.json";
+  EXPECT_FALSE(IsTracing());
+  Instrumented(1);
+  ASSERT_TRUE(StartTrace(filename));
+  EXPECT_TRUE(IsTracing());
+  EXPECT_FALSE(StartTrace(filename));
+  Instrumented(1);
+  TimeScopes time_scopes;
+  ParallelFor(0, 4, 2, &time_scopes);
+  EXPECT_TRUE(StopTrace());
+  EXPECT_FALSE(IsTracing());
+  EXPECT_FALSE(StopTrace());
+  Instrumented(1);
+
+  FILE *in = fopen(filename.c_str(), "r");
+  ASSERT_TRUE(in != NULL);
+  std::string text = ReadAll(in);
+  fclose(in);
+  remove(filename.c_str());
+
+  // Only the scopes that ran while recording are in the trace.
+  size_t first = text.find("\"test.macros.timer\"");
+  EXPECT_NE(std::string::npos, first);
+  EXPECT_EQ(std::string::npos, text.find("\"test.macros.timer\"", first + 1));
+  int parallel = 0;
+  for (size_t i = text.find("\"test.trace.parallel\""); i != std::string::npos;
+       i = text.find("\"test.trace.parallel\"", i + 1)) {
+    ++parallel;
+  }
+  EXPECT_EQ(4, parallel);
+  EXPECT_NE(std::string::npos, text.find("\"ph\": \"X\""));
+  EXPECT_EQ('}', text[text.find_last_not_of("\n")]);
+}
+
+TEST(Trace, FailsOnUnwritablePaths) {
+  EXPECT_FALSE(StartTrace("/nonexistent/libmv/trace.json"));
+  EXPECT_FALSE(IsTracing());
+}
+
+}  // namespace
+}  // namespace instrumentation
+}  // namespace libmv
@@ -0,0 +1,211 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/base/memory_budget.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "libmv/base/thread.h"
+
+namespace libmv {
+namespace {
+
+// Zero initialized before any constructor runs, so that static containers can
+// account their memory.
+long long memory_in_use[NUM_MEMORY_CATEGORIES];
+long long peak_memory_in_use[NUM_MEMORY_CATEGORIES];
+long long memory_budget = 0;
+
+#if !defined(__GNUC__)
+Mutex *accounting_mutex = NULL;
+pthread_once_t accounting_once = PTHREAD_ONCE_INIT;
+
+void InitAccountingMutex() {
+  accounting_mutex = new Mutex;
+}
+
+Mutex *AccountingMutex() {
+  pthread_once(&accounting_once, &InitAccountingMutex);
+  return accounting_mutex;
+}
+#endif
+
+long long AtomicAdd(long long *value, long long amount) {
+#if defined(__GNUC__)
+  return __sync_add_and_fetch(value, amount);
+#else
+  MutexLock lock(AccountingMutex());
+  return *value += amount;
+#endif
+}
+
+// Raises value to at least new_value.
+void AtomicMax(long long *value, long long new_value) {
+#if defined(__GNUC__)
+  long long old_value = __sync_fetch_and_add(value, 0);
+  while (old_value < new_value) {
+    long long seen = __sync_val_compare_and_swap(value, old_value, new_value);
+    if (seen == old_value) {
+      return;
+    }
+    old_value = seen;
+  }
+#else
+  MutexLock lock(AccountingMutex());
+  *value = std::max(*value, new_value);
+#endif
+}
+
+long long AtomicRead(long long *value) {
+  return AtomicAdd(value, 0);
+}
+
+void AtomicStore(long long *value, long long new_value) {
+#if defined(__GNUC__)
+  __sync_lock_test_and_set(value, new_value);
+#else
+  MutexLock lock(AccountingMutex());
+  *value = new_value;
+#endif
+}
+
+struct Reclaimers {
+  Mutex mutex;
+  std::vector<MemoryReclaimer *> reclaimers;
+};
+
+// Never deleted, so that the caches with static storage can unregister.
+Reclaimers *GetReclaimers() {
+  static Reclaimers *reclaimers = NULL;
+  static Mutex mutex;
+  MutexLock lock(&mutex);
+  if (!reclaimers) {
+    reclaimers = new Reclaimers;
+  }
+  return reclaimers;
+}
+
+}  // namespace
+
+const char *MemoryCategoryName(MemoryCategory category) {
+  switch (category) {
+    case MEMORY_FRAMES:      return "frames";
+    case MEMORY_PYRAMIDS:    return "pyramids";
+    case MEMORY_DESCRIPTORS: return "descriptors";
+    case MEMORY_TRACKS:      return "tracks";
+    case MEMORY_BUNDLE:      return "bundle";
+    case MEMORY_DEPTH_MAPS:  return "depth maps";
+    default:                 return "unknown";
+  }
+}
+
+void AccountMemory(MemoryCategory category, long long bytes) {
+  if (bytes) {
+    long long in_use = AtomicAdd(&memory_in_use[category], bytes);
+    if (bytes > 0) {
+      AtomicMax(&peak_memory_in_use[category], in_use);
+    }
+  }
+}
+
+long long MemoryInUse(MemoryCategory category) {
+  return AtomicRead(&memory_in_use[category]);
+}
+
+long long PeakMemoryInUse(MemoryCategory category) {
+  return AtomicRead(&peak_memory_in_use[category]);
+}
+
+void ResetPeakMemoryInUse() {
+  for (int c = 0; c < NUM_MEMORY_CATEGORIES; ++c) {
+    AtomicStore(&peak_memory_in_use[c], AtomicRead(&memory_in_use[c]));
+  }
+}
+
+long long TotalMemoryInUse() {
+  long long total = 0;
+  for (int c = 0; c < NUM_MEMORY_CATEGORIES; ++c) {
+    total += MemoryInUse(static_cast<MemoryCategory>(c));
+  }
+  return total;
+}
+
+void SetMemoryBudget(long long bytes) {
+  AtomicStore(&memory_budget, std::max(0LL, bytes));
+}
+
+long long MemoryBudget() {
+  return AtomicRead(&memory_budget);
+}
+
+long long MemoryOverBudget() {
+  long long budget = MemoryBudget();
+  if (budget <= 0) {
+    return 0;
+  }
+  return std::max(0LL, TotalMemoryInUse() - budget);
+}
+
+void RegisterMemoryReclaimer(MemoryReclaimer *reclaimer) {
+  Reclaimers *reclaimers = GetReclaimers();
+  MutexLock lock(&reclaimers->mutex);
+  reclaimers->reclaimers.push_back(reclaimer);
+}
+
+void UnregisterMemoryReclaimer(MemoryReclaimer *reclaimer) {
+  Reclaimers *reclaimers = GetReclaimers();
+  MutexLock lock(&reclaimers->mutex);
+  std::vector<MemoryReclaimer *> &list = reclaimers->reclaimers;
+  list.erase(std::remove(list.begin(), list.end(), reclaimer), list.end());
+}
+
+void ReclaimMemoryOverBudget() {
+  if (MemoryOverBudget() <= 0) {
+    return;
+  }
+  // The lock keeps the reclaimers alive while they run. Concurrent calls wait
+  // for each other, and usually find the budget met when they get the lock.
+  Reclaimers *reclaimers = GetReclaimers();
+  MutexLock lock(&reclaimers->mutex);
+  for (size_t i = 0; i < reclaimers->reclaimers.size(); ++i) {
+    long long excess = MemoryOverBudget();
+    if (excess <= 0) {
+      return;
+    }
+    reclaimers->reclaimers[i]->ReclaimMemory(excess);
+  }
+}
+
+void PrintMemoryUsage(FILE *out) {
+  fprintf(out, "%-16s %12s %12s\n", "Memory", "MB", "Peak MB");
+  for (int c = 0; c < NUM_MEMORY_CATEGORIES; ++c) {
+    MemoryCategory category = static_cast<MemoryCategory>(c);
+    fprintf(out, "%-16s %12.1f %12.1f\n", MemoryCategoryName(category),
+            MemoryInUse(category) / 1048576.0,
+            PeakMemoryInUse(category) / 1048576.0);
+  }
+  fprintf(out, "%-16s %12.1f\n", "total", TotalMemoryInUse() / 1048576.0);
+  if (MemoryBudget() > 0) {
+    fprintf(out, "%-16s %12.1f\n", "budget", MemoryBudget() / 1048576.0);
+  }
+}
+
+}  // namespace libmv
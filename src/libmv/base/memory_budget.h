@@ -0,0 +1,127 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Accounting of the memory held by the large containers of the library, by
+// category, and a budget shared by all of them. The caches can register as
+// reclaimers: when the accounted memory exceeds the budget, they evict the
+// items that are not in use, whichever category went over it. Without a
+// budget, the memory is only accounted.
+//
+// The accounting is not a replacement for the allocator statistics: only the
+// containers that keep their MemoryUsage up to date are counted.
+
+#ifndef LIBMV_BASE_MEMORY_BUDGET_H
+#define LIBMV_BASE_MEMORY_BUDGET_H
+
+#include <cstdio>
+
+namespace libmv {
+
+enum MemoryCategory {
+  MEMORY_FRAMES,       // The images of the image caches.
+  MEMORY_PYRAMIDS,     // The levels of the image pyramids.
+  MEMORY_DESCRIPTORS,  // The per image state of the describers.
+  MEMORY_TRACKS,       // The paged in observations of the matches.
+  MEMORY_BUNDLE,       // The workspace of the bundle adjusters.
+  MEMORY_DEPTH_MAPS,   // The depth maps of the multi-view stereo.
+  NUM_MEMORY_CATEGORIES
+};
+
+const char *MemoryCategoryName(MemoryCategory category);
+
+// Adds bytes, which can be negative, to the memory in use by a category. This
+// is a single atomic operation with GCC compatible compilers, and never
+// reclaims memory: see ReclaimMemoryOverBudget().
+void AccountMemory(MemoryCategory category, long long bytes);
+long long MemoryInUse(MemoryCategory category);
+long long TotalMemoryInUse();
+// The largest memory in use by a category since the start of the process or
+// the last ResetPeakMemoryInUse().
+long long PeakMemoryInUse(MemoryCategory category);
+void ResetPeakMemoryInUse();
+
+// The budget of the accounted memory, in bytes; 0, the default, is no budget.
+void SetMemoryBudget(long long bytes);
+long long MemoryBudget();
+// The memory in use beyond the budget, or 0.
+long long MemoryOverBudget();
+
+// Something that can free accounted memory on demand, such as a cache.
+class MemoryReclaimer {
+ public:
+  virtual ~MemoryReclaimer() {}
+  // Frees about bytes of the memory it holds but does not need, and returns
+  // the bytes freed. It is called from any thread, without any lock of the
+  // callers of ReclaimMemoryOverBudget().
+  virtual long long ReclaimMemory(long long bytes) = 0;
+};
+
+// The reclaimers are not owned. Unregistering waits for the reclaimer to
+// return if it is running, so a reclaimer must unregister before it starts
+// being destroyed.
+void RegisterMemoryReclaimer(MemoryReclaimer *reclaimer);
+void UnregisterMemoryReclaimer(MemoryReclaimer *reclaimer);
+
+// Asks the reclaimers to free the memory over the budget, the earliest
+// registered first, until the budget is met. The containers call it after
+// they grew, when they hold no lock that a reclaimer might take.
+void ReclaimMemoryOverBudget();
+
+// Prints the memory in use and its peak by category, and the budget.
+void PrintMemoryUsage(FILE *out);
+
+// The accounted memory of a container, removed from its category when the
+// usage is destroyed. A copy accounts the same memory again, as the copy of
+// the container owns a copy of the memory.
+class MemoryUsage {
+ public:
+  explicit MemoryUsage(MemoryCategory category, long long bytes = 0)
+      : category_(category), bytes_(0) {
+    Set(bytes);
+  }
+  MemoryUsage(const MemoryUsage &other)
+      : category_(other.category_), bytes_(0) {
+    Set(other.bytes_);
+  }
+  MemoryUsage &operator=(const MemoryUsage &other) {
+    if (this != &other) {
+      Set(0);
+      category_ = other.category_;
+      Set(other.bytes_);
+    }
+    return *this;
+  }
+  ~MemoryUsage() { Set(0); }
+
+  void Set(long long bytes) {
+    AccountMemory(category_, bytes - bytes_);
+    bytes_ = bytes;
+  }
+  long long bytes() const { return bytes_; }
+  MemoryCategory category() const { return category_; }
+
+ private:
+  MemoryCategory category_;
+  long long bytes_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_BASE_MEMORY_BUDGET_H
@@ -0,0 +1,123 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/base/memory_budget.h"
+#include "testing/testing.h"
+
+namespace libmv {
+namespace {
+
+TEST(MemoryUsage, AccountsItsBytesUntilDestroyed) {
+  long long tracks = MemoryInUse(MEMORY_TRACKS);
+  {
+    MemoryUsage usage(MEMORY_TRACKS, 100);
+    EXPECT_EQ(tracks + 100, MemoryInUse(MEMORY_TRACKS));
+    usage.Set(40);
+    EXPECT_EQ(tracks + 40, MemoryInUse(MEMORY_TRACKS));
+
+    MemoryUsage copy(usage);
+    EXPECT_EQ(tracks + 80, MemoryInUse(MEMORY_TRACKS));
+    MemoryUsage other(MEMORY_PYRAMIDS, 10);
+    other = usage;
+    EXPECT_EQ(MEMORY_TRACKS, other.category());
+    EXPECT_EQ(tracks + 120, MemoryInUse(MEMORY_TRACKS));
+    other = other;
+    EXPECT_EQ(tracks + 120, MemoryInUse(MEMORY_TRACKS));
+  }
+  EXPECT_EQ(tracks, MemoryInUse(MEMORY_TRACKS));
+}
+
+TEST(MemoryUsage, Peak) {
+  ResetPeakMemoryInUse();
+  long long pyramids = MemoryInUse(MEMORY_PYRAMIDS);
+  EXPECT_EQ(pyramids, PeakMemoryInUse(MEMORY_PYRAMIDS));
+  {
+    MemoryUsage usage(MEMORY_PYRAMIDS, 500);
+    usage.Set(200);
+  }
+  EXPECT_EQ(pyramids + 500, PeakMemoryInUse(MEMORY_PYRAMIDS));
+  ResetPeakMemoryInUse();
+  EXPECT_EQ(pyramids, PeakMemoryInUse(MEMORY_PYRAMIDS));
+}
+
+TEST(MemoryBudget, OverBudget) {
+  EXPECT_EQ(0, MemoryBudget());
+  MemoryUsage usage(MEMORY_BUNDLE, 1000);
+  EXPECT_EQ(0, MemoryOverBudget());
+  SetMemoryBudget(TotalMemoryInUse() - 300);
+  EXPECT_EQ(300, MemoryOverBudget());
+  SetMemoryBudget(TotalMemoryInUse() + 300);
+  EXPECT_EQ(0, MemoryOverBudget());
+  SetMemoryBudget(0);
+  EXPECT_EQ(0, MemoryOverBudget());
+}
+
+// Frees its memory by chunks.
+struct ChunkReclaimer : public MemoryReclaimer {
+  ChunkReclaimer(int num_chunks, long long chunk_size)
+      : memory(MEMORY_FRAMES, num_chunks * chunk_size),
+        chunk_size(chunk_size), calls(0) {}
+  virtual long long ReclaimMemory(long long bytes) {
+    ++calls;
+    long long freed = 0;
+    while (freed < bytes && memory.bytes() > 0) {
+      memory.Set(memory.bytes() - chunk_size);
+      freed += chunk_size;
+    }
+    return freed;
+  }
+  MemoryUsage memory;
+  long long chunk_size;
+  int calls;
+};
+
+TEST(MemoryBudget, ReclaimersFreeTheMemoryOverBudget) {
+  ChunkReclaimer first(2, 100), second(5, 100);
+  RegisterMemoryReclaimer(&first);
+  RegisterMemoryReclaimer(&second);
+
+  ReclaimMemoryOverBudget();
+  EXPECT_EQ(0, first.calls);
+
+  // The first reclaimer is emptied before the second one is asked.
+  SetMemoryBudget(TotalMemoryInUse() - 250);
+  ReclaimMemoryOverBudget();
+  EXPECT_EQ(0, MemoryOverBudget());
+  EXPECT_EQ(0, first.memory.bytes());
+  EXPECT_EQ(400, second.memory.bytes());
+
+  SetMemoryBudget(TotalMemoryInUse() - 10);
+  UnregisterMemoryReclaimer(&second);
+  ReclaimMemoryOverBudget();
+  EXPECT_EQ(400, second.memory.bytes());
+  EXPECT_EQ(10, MemoryOverBudget());
+
+  UnregisterMemoryReclaimer(&first);
+  SetMemoryBudget(0);
+}
+
+TEST(MemoryBudget, CategoryNames) {
+  EXPECT_STREQ("frames", MemoryCategoryName(MEMORY_FRAMES));
+  EXPECT_STREQ("bundle", MemoryCategoryName(MEMORY_BUNDLE));
+  EXPECT_STREQ("depth maps", MemoryCategoryName(MEMORY_DEPTH_MAPS));
+}
+
+}  // namespace
+}  // namespace libmv
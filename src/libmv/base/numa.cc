@@ -0,0 +1,255 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+#include "libmv/base/numa.h"
+
+#include <pthread.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <dirent.h>
+#include <sched.h>
+#endif
+
+#include "libmv/base/thread.h"
+
+namespace libmv {
+namespace {
+
+struct Topology {
+  std::vector<std::vector<int> > node_processors;
+  std::vector<int> processor_nodes;
+};
+
+pthread_once_t topology_once = PTHREAD_ONCE_INIT;
+Topology *topology = NULL;
+
+#ifdef __linux__
+// Parses a list of processors like "0-3,8,10-11".
+void ParseProcessorList(const char *list, std::vector<int> *processors) {
+  const char *p = list;
+  while (*p) {
+    char *end;
+    long first = strtol(p, &end, 10);
+    if (end == p) {
+      return;
+    }
+    long last = first;
+    p = end;
+    if (*p == '-') {
+      ++p;
+      last = strtol(p, &end, 10);
+      if (end == p) {
+        return;
+      }
+      p = end;
+    }
+    for (long i = first; i <= last; ++i) {
+      processors->push_back(i);
+    }
+    if (*p != ',') {
+      return;
+    }
+    ++p;
+  }
+}
+
+void ReadNodes(std::vector<std::vector<int> > *node_processors) {
+  DIR *directory = opendir("/sys/devices/system/node");
+  if (!directory) {
+    return;
+  }
+  // The system numbers of the nodes, which can have gaps.
+  std::vector<int> numbers;
+  while (struct dirent *entry = readdir(directory)) {
+    int number;
+    char rest;
+    if (sscanf(entry->d_name, "node%d%c", &number, &rest) == 1) {
+      numbers.push_back(number);
+    }
+  }
+  closedir(directory);
+  std::sort(numbers.begin(), numbers.end());
+  for (size_t i = 0; i < numbers.size(); ++i) {
+    char path[64];
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/node/node%d/cpulist", numbers[i]);
+    FILE *file = fopen(path, "r");
+    if (!file) {
+      continue;
+    }
+    char list[4096];
+    std::vector<int> processors;
+    if (fgets(list, sizeof(list), file)) {
+      ParseProcessorList(list, &processors);
+    }
+    fclose(file);
+    // Nodes of memory only have no processors to run the threads.
+    if (processors.size() > 0) {
+      node_processors->push_back(processors);
+    }
+  }
+}
+#endif
+
+void InitTopology() {
+  topology = new Topology;
+#ifdef __linux__
+  ReadNodes(&topology->node_processors);
+#endif
+  int num_processors = NumProcessors();
+  if (topology->node_processors.size() == 0) {
+    topology->node_processors.resize(1);
+    for (int i = 0; i < num_processors; ++i) {
+      topology->node_processors[0].push_back(i);
+    }
+  }
+  for (int node = 0; node < topology->node_processors.size(); ++node) {
+    const std::vector<int> &processors = topology->node_processors[node];
+    for (int i = 0; i < processors.size(); ++i) {
+      if (processors[i] >= topology->processor_nodes.size()) {
+        topology->processor_nodes.resize(processors[i] + 1, 0);
+      }
+      topology->processor_nodes[processors[i]] = node;
+    }
+  }
+}
+
+const Topology &GetTopology() {
+  pthread_once(&topology_once, &InitTopology);
+  return *topology;
+}
+
+struct TouchPages {
+  void operator()(int i) {
+    data[i * page_size] = 0;
+  }
+  volatile char *data;
+  size_t page_size;
+};
+
+size_t PageSize() {
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwPageSize;
+#else
+  long page_size = sysconf(_SC_PAGESIZE);
+  return page_size > 0 ? page_size : 4096;
+#endif
+}
+
+}  // namespace
+
+int NumNumaNodes() {
+  return GetTopology().node_processors.size();
+}
+
+int NumaNodeOfProcessor(int processor) {
+  const std::vector<int> &nodes = GetTopology().processor_nodes;
+  if (processor < 0 || processor >= nodes.size()) {
+    return 0;
+  }
+  return nodes[processor];
+}
+
+const std::vector<int> &NumaNodeProcessors(int node) {
+  return GetTopology().node_processors[node];
+}
+
+bool PinThreadToNumaNode(int node) {
+#ifdef __linux__
+  const std::vector<int> &processors = NumaNodeProcessors(node);
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int i = 0; i < processors.size(); ++i) {
+    if (processors[i] < CPU_SETSIZE) {
+      CPU_SET(processors[i], &set);
+    }
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  (void) node;
+  return false;
+#endif
+}
+
+void *AllocatePages(size_t bytes, bool huge_pages) {
+  if (bytes == 0) {
+    return NULL;
+  }
+#ifdef _WIN32
+  (void) huge_pages;
+  return VirtualAlloc(NULL, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+  void *pages = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (pages == MAP_FAILED) {
+    return NULL;
+  }
+#ifdef MADV_HUGEPAGE
+  if (huge_pages) {
+    // Only a hint: without transparent huge pages, the pages stay small.
+    madvise(pages, bytes, MADV_HUGEPAGE);
+  }
+#else
+  (void) huge_pages;
+#endif
+  return pages;
+#endif
+}
+
+void FreePages(void *pages, size_t bytes) {
+  if (pages == NULL) {
+    return;
+  }
+#ifdef _WIN32
+  (void) bytes;
+  VirtualFree(pages, 0, MEM_RELEASE);
+#else
+  munmap(pages, bytes);
+#endif
+}
+
+void FirstTouchPages(void *data, size_t bytes, int num_threads) {
+  if (bytes == 0) {
+    return;
+  }
+  // A byte every page size from data touches every page, data need not be
+  // aligned.
+  size_t page_size = PageSize();
+  TouchPages touch;
+  touch.data = static_cast<char *>(data);
+  touch.page_size = page_size;
+  int num_pages = (bytes + page_size - 1) / page_size;
+  ParallelFor(0, num_pages, num_threads, &touch);
+}
+
+}  // namespace libmv
@@ -0,0 +1,70 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+// The NUMA nodes of the machine, and the placement of large buffers on them.
+// On a machine with several sockets, a page lives in the memory of the node
+// of the thread that first wrote it, and the other nodes reach it through the
+// interconnect. Buffers that a parallel loop processes are therefore best
+// first touched by the loop's own partition of the threads, rather than by
+// the thread that allocated them.
+
+#ifndef LIBMV_BASE_NUMA_H_
+#define LIBMV_BASE_NUMA_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace libmv {
+
+// The number of NUMA nodes, at least 1. The topology is read once from
+// /sys/devices/system/node on Linux; elsewhere there is a single node. The
+// nodes are numbered from 0 without gaps, whatever the numbers of the system.
+int NumNumaNodes();
+
+// The node of a processor, 0 if it is unknown.
+int NumaNodeOfProcessor(int processor);
+
+// The processors of a node, in increasing order.
+const std::vector<int> &NumaNodeProcessors(int node);
+
+// Restricts the calling thread to the processors of node, so that the
+// scheduler still balances it within the node. Returns false where thread
+// affinity is not supported.
+bool PinThreadToNumaNode(int node);
+
+// Pages straight from the operating system, which are zero and not yet
+// placed on any node. With huge_pages, transparent huge pages are requested
+// for them, which only Linux honours. Returns NULL on failure.
+void *AllocatePages(size_t bytes, bool huge_pages);
+void FreePages(void *pages, size_t bytes);
+
+// Writes a zero to every page of [data, data + bytes) from ParallelFor() on
+// num_threads threads, so that the pages are placed in contiguous chunks on
+// the nodes of the threads. A loop that later processes the buffer through
+// ParallelFor() over its rows with the same number of threads has its chunks
+// on the nodes of the threads that placed them, when the thread pool runs
+// them on the same threads. The pages must be zero, e.g. new from
+// AllocatePages().
+void FirstTouchPages(void *data, size_t bytes, int num_threads);
+
+}  // namespace libmv
+
+#endif  // LIBMV_BASE_NUMA_H_
@@ -0,0 +1,81 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+#include <cstring>
+
+#include "libmv/base/numa.h"
+#include "libmv/base/thread.h"
+#include "testing/testing.h"
+
+namespace {
+
+using namespace libmv;
+
+TEST(Numa, EveryProcessorIsOnItsNode) {
+  ASSERT_LE(1, NumNumaNodes());
+  int num_processors = 0;
+  for (int node = 0; node < NumNumaNodes(); ++node) {
+    const std::vector<int> &processors = NumaNodeProcessors(node);
+    EXPECT_LT(0, processors.size());
+    for (int i = 0; i < processors.size(); ++i) {
+      EXPECT_EQ(node, NumaNodeOfProcessor(processors[i]));
+    }
+    num_processors += processors.size();
+  }
+  EXPECT_LE(1, num_processors);
+  EXPECT_EQ(0, NumaNodeOfProcessor(-1));
+}
+
+TEST(Numa, FirstTouchedPagesAreZero) {
+  size_t bytes = 3 * 1000 * 1000 + 17;
+  char *pages = static_cast<char *>(AllocatePages(bytes, true));
+  ASSERT_TRUE(pages != NULL);
+  FirstTouchPages(pages + 5, bytes - 5, 4);
+  for (size_t i = 0; i < bytes; i += 4093) {
+    EXPECT_EQ(0, pages[i]);
+  }
+  memset(pages, 1, bytes);
+  EXPECT_EQ(1, pages[bytes - 1]);
+  FreePages(pages, bytes);
+}
+
+TEST(Numa, PinnedPoolThreadsAreOnTheNodes) {
+  ThreadPool pool(4, true);
+  EXPECT_TRUE(pool.PinsThreads());
+  for (int thread = 0; thread < pool.NumThreads(); ++thread) {
+    EXPECT_LE(0, pool.NumaNode(thread));
+    EXPECT_GT(NumNumaNodes(), pool.NumaNode(thread));
+  }
+  EXPECT_EQ(0, pool.NumaNode(0));
+}
+
+TEST(Numa, SetThreadPinningKeepsTheNumberOfThreads) {
+  int num_threads = NumThreads();
+  EXPECT_FALSE(ThreadPinning());
+  SetThreadPinning(true);
+  EXPECT_TRUE(ThreadPinning());
+  EXPECT_EQ(num_threads, NumThreads());
+  EXPECT_TRUE(ThreadPool::Global()->PinsThreads());
+  SetThreadPinning(false);
+  EXPECT_FALSE(ThreadPool::Global()->PinsThreads());
+}
+
+}  // namespace
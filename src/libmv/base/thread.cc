@@ -0,0 +1,371 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/base/thread.h"
+
+#include <stdint.h>
+#include <cmath>
+
+#include "libmv/base/autotune.h"
+#include "libmv/base/numa.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace libmv {
+namespace {
+
+pthread_once_t global_pool_once = PTHREAD_ONCE_INIT;
+Mutex *global_pool_mutex = NULL;
+ThreadPool *global_pool = NULL;
+bool global_pin_threads = false;
+
+void InitGlobalPoolMutex() {
+  global_pool_mutex = new Mutex;
+}
+
+struct Worker {
+  ThreadPool *pool;
+  int queue;
+};
+
+
+// The node of thread out of num_threads, in contiguous blocks of threads.
+int NodeOfThread(int thread, int num_threads) {
+  return (static_cast<long long>(thread) * NumNumaNodes()) / num_threads;
+}
+
+// A chunk of the calibration of the number of threads: arithmetic on a slice
+// of an array larger than the caches, like the image kernels do.
+struct CalibrationChunk : public Task {
+  void Run() {
+    for (int i = begin; i < end; ++i) {
+      data[i] = std::sqrt(data[i] * 0.5f + 1.0f);
+    }
+  }
+  float *data;
+  int begin;
+  int end;
+};
+
+// Times a fixed amount of work split in many chunks on a pool of the
+// calibrated number of threads. The pool is kept between the runs.
+class NumThreadsCalibration : public Calibration {
+ public:
+  NumThreadsCalibration() : data_(1 << 22, 1.0f), pool_(NULL) {}
+  ~NumThreadsCalibration() { delete pool_; }
+
+  void Run(int num_threads) {
+    if (!pool_ || pool_->NumThreads() != num_threads) {
+      delete pool_;
+      pool_ = new ThreadPool(num_threads);
+    }
+    const int kNumChunks = 64;
+    const int n = data_.size();
+    CalibrationChunk chunks[kNumChunks];
+    TaskGroup group(pool_);
+    for (int c = 0; c < kNumChunks; ++c) {
+      chunks[c].data = &data_[0];
+      chunks[c].begin = (static_cast<long long>(n) * c) / kNumChunks;
+      chunks[c].end = (static_cast<long long>(n) * (c + 1)) / kNumChunks;
+      group.Run(&chunks[c]);
+    }
+    group.Wait();
+  }
+
+ private:
+  std::vector<float> data_;
+  ThreadPool *pool_;
+};
+
+// The number of threads of the global pool: one per processor, or the tuned
+// number among the powers of two up to it (see autotune.h), since memory
+// bound kernels may not scale to all the hardware threads.
+int DefaultNumThreads() {
+  int num_processors = NumProcessors();
+  if (!AutoTuning()) {
+    return num_processors;
+  }
+  std::vector<int> candidates;
+  for (int n = 1; n < num_processors; n *= 2) {
+    candidates.push_back(n);
+  }
+  candidates.push_back(num_processors);
+  NumThreadsCalibration calibration;
+  return TunedValue("num_threads", num_processors, candidates, &calibration);
+}
+
+}  // namespace
+
+ThreadPool::ThreadPool(int num_threads, bool pin_threads)
+    : pin_threads_(pin_threads), num_queued_(0), stop_(false) {
+  pthread_key_create(&queue_key_, NULL);
+  int num_workers = num_threads > 1 ? num_threads - 1 : 0;
+  for (int i = 0; i <= num_workers; ++i) {
+    queues_.push_back(new Queue);
+    // Worker i is thread i + 1, and the last queue is the one of thread 0.
+    queue_nodes_.push_back(NodeOfThread(i < num_workers ? i + 1 : 0,
+                                        num_workers + 1));
+  }
+  steal_orders_.resize(queues_.size());
+  for (int own = 0; own < queues_.size(); ++own) {
+    for (int same_node = 1; same_node >= 0; --same_node) {
+      for (int i = 1; i < queues_.size(); ++i) {
+        int queue = (own + i) % queues_.size();
+        if ((queue_nodes_[queue] == queue_nodes_[own]) == same_node) {
+          steal_orders_[own].push_back(queue);
+        }
+      }
+    }
+  }
+  workers_.reserve(num_workers);
+  for (int i = 0; i < num_workers; ++i) {
+    Worker *worker = new Worker;
+    worker->pool = this;
+    worker->queue = i;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, &ThreadPool::WorkerEntry, worker) == 0) {
+      workers_.push_back(thread);
+    } else {
+      // The queue of the missing worker is still stolen from.
+      delete worker;
+    }
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    MutexLock lock(&mutex_);
+    stop_ = true;
+    wakeup_.Broadcast();
+  }
+  for (int i = 0; i < workers_.size(); ++i) {
+    pthread_join(workers_[i], NULL);
+  }
+  // Without workers, nothing was queued.
+  for (int i = 0; i < queues_.size(); ++i) {
+    delete queues_[i];
+  }
+  pthread_key_delete(queue_key_);
+}
+
+int ThreadPool::NumaNode(int thread) const {
+  return queue_nodes_[thread == 0 ? queues_.size() - 1 : thread - 1];
+}
+
+ThreadPool *ThreadPool::Global() {
+  pthread_once(&global_pool_once, &InitGlobalPoolMutex);
+  {
+    MutexLock lock(global_pool_mutex);
+    if (global_pool) {
+      return global_pool;
+    }
+  }
+  // Tuning may run calibrations, which must not hold the lock.
+  int num_threads = DefaultNumThreads();
+  MutexLock lock(global_pool_mutex);
+  if (!global_pool) {
+    global_pool = new ThreadPool(num_threads, global_pin_threads);
+  }
+  return global_pool;
+}
+
+void ThreadPool::Schedule(Task *task, TaskGroup *group) {
+  // The workers queue their own tasks, the other threads share a queue.
+  intptr_t key = reinterpret_cast<intptr_t>(pthread_getspecific(queue_key_));
+  Queue *queue = key ? queues_[key - 1] : queues_.back();
+  QueuedTask queued = { task, group };
+  {
+    MutexLock lock(&queue->mutex);
+    queue->tasks.push_back(queued);
+  }
+  MutexLock lock(&mutex_);
+  ++num_queued_;
+  wakeup_.Signal();
+}
+
+bool ThreadPool::Pop(QueuedTask *task) {
+  intptr_t key = reinterpret_cast<intptr_t>(pthread_getspecific(queue_key_));
+  int own = key ? key - 1 : queues_.size() - 1;
+  bool found = false;
+  {
+    // The most recent task of the own queue first.
+    Queue *queue = queues_[own];
+    MutexLock lock(&queue->mutex);
+    if (!queue->tasks.empty()) {
+      *task = queue->tasks.back();
+      queue->tasks.pop_back();
+      found = true;
+    }
+  }
+  // Otherwise the oldest task of the next non empty queue, on the same node
+  // first.
+  const std::vector<int> &steal_order = steal_orders_[own];
+  for (int i = 0; !found && i < steal_order.size(); ++i) {
+    Queue *queue = queues_[steal_order[i]];
+    MutexLock lock(&queue->mutex);
+    if (!queue->tasks.empty()) {
+      *task = queue->tasks.front();
+      queue->tasks.pop_front();
+      found = true;
+    }
+  }
+  if (found) {
+    MutexLock lock(&mutex_);
+    --num_queued_;
+  }
+  return found;
+}
+
+bool ThreadPool::RunQueuedTask() {
+  QueuedTask queued;
+  if (!Pop(&queued)) {
+    return false;
+  }
+  queued.task->Run();
+  queued.group->Finish();
+  return true;
+}
+
+void ThreadPool::WorkerLoop(int queue) {
+  pthread_setspecific(queue_key_, reinterpret_cast<void *>(
+      static_cast<intptr_t>(queue + 1)));
+  if (pin_threads_) {
+    PinThreadToNumaNode(queue_nodes_[queue]);
+  }
+  for (;;) {
+    if (RunQueuedTask()) {
+      continue;
+    }
+    MutexLock lock(&mutex_);
+    // num_queued_ can be briefly negative, when a task is taken before its
+    // scheduling thread counted it.
+    while (num_queued_ <= 0 && !stop_) {
+      wakeup_.Wait(&mutex_);
+    }
+    if (stop_ && num_queued_ <= 0) {
+      return;
+    }
+  }
+}
+
+void *ThreadPool::WorkerEntry(void *worker_pointer) {
+  Worker *worker = static_cast<Worker *>(worker_pointer);
+  ThreadPool *pool = worker->pool;
+  int queue = worker->queue;
+  delete worker;
+  pool->WorkerLoop(queue);
+  return NULL;
+}
+
+TaskGroup::TaskGroup(ThreadPool *pool) : pool_(pool), pending_(0) {}
+
+TaskGroup::~TaskGroup() {
+  Wait();
+}
+
+void TaskGroup::Run(Task *task) {
+  if (pool_->workers_.empty()) {
+    task->Run();
+    return;
+  }
+  {
+    MutexLock lock(&mutex_);
+    ++pending_;
+  }
+  pool_->Schedule(task, this);
+}
+
+void TaskGroup::Wait() {
+  for (;;) {
+    {
+      MutexLock lock(&mutex_);
+      if (pending_ == 0) {
+        return;
+      }
+    }
+    if (pool_->RunQueuedTask()) {
+      continue;
+    }
+    // The remaining tasks run on other threads.
+    MutexLock lock(&mutex_);
+    while (pending_ > 0) {
+      finished_.Wait(&mutex_);
+    }
+    return;
+  }
+}
+
+void TaskGroup::Finish() {
+  MutexLock lock(&mutex_);
+  if (--pending_ == 0) {
+    finished_.Broadcast();
+  }
+}
+
+int NumProcessors() {
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  int n = info.dwNumberOfProcessors;
+#else
+  int n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  return n > 0 ? n : 1;
+}
+
+int NumThreads() {
+  return ThreadPool::Global()->NumThreads();
+}
+
+void SetNumThreads(int num_threads) {
+  pthread_once(&global_pool_once, &InitGlobalPoolMutex);
+  MutexLock lock(global_pool_mutex);
+  if (global_pool && global_pool->NumThreads() == num_threads) {
+    return;
+  }
+  delete global_pool;
+  global_pool = new ThreadPool(num_threads, global_pin_threads);
+}
+
+bool ThreadPinning() {
+  pthread_once(&global_pool_once, &InitGlobalPoolMutex);
+  MutexLock lock(global_pool_mutex);
+  return global_pin_threads;
+}
+
+void SetThreadPinning(bool pin_threads) {
+  pthread_once(&global_pool_once, &InitGlobalPoolMutex);
+  MutexLock lock(global_pool_mutex);
+  if (global_pin_threads == pin_threads) {
+    return;
+  }
+  global_pin_threads = pin_threads;
+  if (global_pool) {
+    int num_threads = global_pool->NumThreads();
+    delete global_pool;
+    global_pool = new ThreadPool(num_threads, pin_threads);
+  }
+}
+
+}  // namespace libmv
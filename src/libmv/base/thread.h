@@ -0,0 +1,393 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Minimal threading primitives on top of pthreads, and the thread pool shared
+// by the parallel loops of the library. On Windows the bundled pthreads-w32
+// provides the same API.
+
+#ifndef LIBMV_BASE_THREAD_H
+#define LIBMV_BASE_THREAD_H
+
+#include <pthread.h>
+#include <deque>
+#include <vector>
+
+namespace libmv {
+
+class Mutex {
+ public:
+  Mutex()  { pthread_mutex_init(&mutex_, NULL); }
+  ~Mutex() { pthread_mutex_destroy(&mutex_);    }
+
+  void Lock()   { pthread_mutex_lock(&mutex_);   }
+  void Unlock() { pthread_mutex_unlock(&mutex_); }
+
+ private:
+  friend class ConditionVariable;
+
+  // No copying allowed.
+  Mutex(const Mutex &);
+  Mutex &operator=(const Mutex &);
+
+  pthread_mutex_t mutex_;
+};
+
+// Locks a mutex for the lifetime of the lock object.
+class MutexLock {
+ public:
+  explicit MutexLock(Mutex *mutex) : mutex_(mutex) { mutex_->Lock(); }
+  ~MutexLock() { mutex_->Unlock(); }
+
+ private:
+  MutexLock(const MutexLock &);
+  MutexLock &operator=(const MutexLock &);
+
+  Mutex *mutex_;
+};
+
+class ConditionVariable {
+ public:
+  ConditionVariable()  { pthread_cond_init(&condition_, NULL); }
+  ~ConditionVariable() { pthread_cond_destroy(&condition_);    }
+
+  // The mutex must be locked by the caller.
+  void Wait(Mutex *mutex) { pthread_cond_wait(&condition_, &mutex->mutex_); }
+  void Signal()           { pthread_cond_signal(&condition_);    }
+  void Broadcast()        { pthread_cond_broadcast(&condition_); }
+
+ private:
+  ConditionVariable(const ConditionVariable &);
+  ConditionVariable &operator=(const ConditionVariable &);
+
+  pthread_cond_t condition_;
+};
+
+// A first in first out queue of at most capacity items between the stages of
+// a pipeline: Push() blocks while the queue is full, so a fast producer stays
+// at most capacity items ahead of its consumer, and Pop() blocks while it is
+// empty. After Close(), Push() fails and Pop() fails once the queue is
+// drained, which tells the consumer that the stream ended.
+template<typename T>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(int capacity)
+      : capacity_(capacity < 1 ? 1 : capacity), closed_(false) {}
+
+  bool Push(const T &item) {
+    MutexLock lock(&mutex_);
+    while (!closed_ && items_.size() >= capacity_) {
+      not_full_.Wait(&mutex_);
+    }
+    if (closed_) {
+      return false;
+    }
+    items_.push_back(item);
+    not_empty_.Signal();
+    return true;
+  }
+
+  bool Pop(T *item) {
+    MutexLock lock(&mutex_);
+    while (!closed_ && items_.empty()) {
+      not_empty_.Wait(&mutex_);
+    }
+    if (items_.empty()) {
+      return false;
+    }
+    *item = items_.front();
+    items_.pop_front();
+    not_full_.Signal();
+    return true;
+  }
+
+  void Close() {
+    MutexLock lock(&mutex_);
+    closed_ = true;
+    not_empty_.Broadcast();
+    not_full_.Broadcast();
+  }
+
+ private:
+  BoundedQueue(const BoundedQueue &);
+  BoundedQueue &operator=(const BoundedQueue &);
+
+  size_t capacity_;
+  bool closed_;
+  std::deque<T> items_;
+  Mutex mutex_;
+  ConditionVariable not_full_;
+  ConditionVariable not_empty_;
+};
+
+// Work that a ThreadPool runs once, on any of its threads.
+class Task {
+ public:
+  virtual ~Task() {}
+  virtual void Run() = 0;
+};
+
+class TaskGroup;
+
+// A fixed set of worker threads running Tasks. Every worker has its own queue:
+// it runs the tasks it queued itself last in first out, and when its queue is
+// empty it steals the oldest tasks of the other queues, so that nested parallel
+// loops stay on one thread while the top level work is balanced. The threads
+// waiting for a TaskGroup run queued tasks meanwhile, so nested waits do not
+// deadlock.
+//
+// The threads are spread in contiguous blocks over the NUMA nodes (see
+// libmv/base/numa.h), and an idle worker steals from the queues of its own
+// node before the others, so that the tasks queued by a thread, and the
+// memory they touch, tend to stay on its node. With pinning, every worker is
+// restricted to the processors of its node.
+//
+// The parallel loops of the library share the pool returned by Global(), whose
+// size is set with SetNumThreads(), so that they do not oversubscribe the
+// cores however they are nested.
+class ThreadPool {
+ public:
+  // A pool of num_threads threads, counting the thread that waits for the
+  // tasks: num_threads - 1 workers are started. Without workers, the tasks run
+  // when they are scheduled.
+  explicit ThreadPool(int num_threads, bool pin_threads = false);
+  // Runs the queued tasks and stops the workers.
+  ~ThreadPool();
+
+  int NumThreads() const { return workers_.size() + 1; }
+  bool PinsThreads() const { return pin_threads_; }
+
+  // The NUMA node of a thread, from 0 for the waiting thread to NumThreads()
+  // - 1. Without pinning the workers only prefer the tasks of their node.
+  int NumaNode(int thread) const;
+
+  // The pool shared by the library, created on first use with a thread per
+  // processor, or the number of threads tuned for the machine if tuning is on
+  // (see libmv/base/autotune.h).
+  static ThreadPool *Global();
+
+ private:
+  friend class TaskGroup;
+
+  struct QueuedTask {
+    Task *task;
+    TaskGroup *group;
+  };
+  struct Queue {
+    Mutex mutex;
+    std::deque<QueuedTask> tasks;
+  };
+
+  void Schedule(Task *task, TaskGroup *group);
+  // Runs one queued task if there is any, and returns whether it did.
+  bool RunQueuedTask();
+  bool Pop(QueuedTask *task);
+  void WorkerLoop(int queue);
+  static void *WorkerEntry(void *worker);
+
+  ThreadPool(const ThreadPool &);
+  ThreadPool &operator=(const ThreadPool &);
+
+  bool pin_threads_;
+  std::vector<pthread_t> workers_;
+  // One queue per worker, and a last one for the threads outside of the pool.
+  std::vector<Queue *> queues_;
+  // The node of every queue, and the other queues in the order a thread
+  // steals from them: the ones of its node first.
+  std::vector<int> queue_nodes_;
+  std::vector<std::vector<int> > steal_orders_;
+  // The index plus one of the queue of the calling worker thread.
+  pthread_key_t queue_key_;
+
+  // Protects num_queued_ and stop_, and the workers sleep on it.
+  Mutex mutex_;
+  ConditionVariable wakeup_;
+  int num_queued_;
+  bool stop_;
+};
+
+// Tasks that are waited for together. The tasks are not owned: they must stay
+// alive until Wait() returns. A task can run more tasks in any group and wait
+// for other groups, but must not wait for its own group.
+class TaskGroup {
+ public:
+  explicit TaskGroup(ThreadPool *pool = ThreadPool::Global());
+  // Waits for the tasks.
+  ~TaskGroup();
+
+  void Run(Task *task);
+  // Returns when all the tasks have run, running queued tasks meanwhile.
+  void Wait();
+
+ private:
+  friend class ThreadPool;
+
+  void Finish();
+
+  TaskGroup(const TaskGroup &);
+  TaskGroup &operator=(const TaskGroup &);
+
+  ThreadPool *pool_;
+  Mutex mutex_;
+  ConditionVariable finished_;
+  int pending_;
+};
+
+// The number of processors, at least 1.
+int NumProcessors();
+
+// The number of threads of the global pool, see ThreadPool::Global(). It can
+// be changed with SetNumThreads() (e.g. from the --threads flag of the tools),
+// which must not be called while the pool runs tasks.
+int NumThreads();
+void SetNumThreads(int num_threads);
+
+// Whether the global pool pins its workers to their NUMA nodes; off by
+// default. Like SetNumThreads(), this recreates the pool.
+bool ThreadPinning();
+void SetThreadPinning(bool pin_threads);
+
+namespace parallel_for {
+
+template<typename Functor>
+struct Chunk : public Task {
+  void Run() {
+    for (int i = begin; i < end; ++i) {
+      (*functor)(i);
+    }
+  }
+  Functor *functor;
+  int begin;
+  int end;
+};
+
+// The indices not yet taken by a thread of ParallelForDynamic().
+template<typename Functor>
+struct Queue {
+  Functor *functor;
+  Mutex mutex;
+  int next;
+  int end;
+};
+
+template<typename Functor>
+struct QueueDrain : public Task {
+  void Run() {
+    for (;;) {
+      int i;
+      {
+        MutexLock lock(&queue->mutex);
+        if (queue->next >= queue->end) {
+          return;
+        }
+        i = queue->next++;
+      }
+      (*queue->functor)(i);
+    }
+  }
+  Queue<Functor> *queue;
+};
+
+inline int ClampNumThreads(int n, int num_threads) {
+  if (num_threads > n) {
+    num_threads = n;
+  }
+  if (num_threads < 1) {
+    num_threads = 1;
+  }
+  return num_threads;
+}
+
+}  // namespace parallel_for
+
+// Call functor(i) for every i in [begin, end). The range is split into
+// num_threads contiguous chunks of (nearly) equal size, which run on the
+// global thread pool; the calling thread processes the first chunk itself.
+// Since the partition only depends on the range and the thread count, functors
+// that write to slot i only give the same results regardless of scheduling.
+// The chunks run concurrently on at most NumThreads() threads.
+template<typename Functor>
+void ParallelFor(int begin, int end, int num_threads, Functor *functor) {
+  int n = end - begin;
+  if (n <= 0) {
+    return;
+  }
+  num_threads = parallel_for::ClampNumThreads(n, num_threads);
+
+  std::vector<parallel_for::Chunk<Functor> > chunks(num_threads);
+  for (int t = 0; t < num_threads; ++t) {
+    chunks[t].functor = functor;
+    chunks[t].begin = begin + (n * t) / num_threads;
+    chunks[t].end   = begin + (n * (t + 1)) / num_threads;
+  }
+  if (num_threads == 1) {
+    chunks[0].Run();
+    return;
+  }
+  TaskGroup group;
+  for (int t = 1; t < num_threads; ++t) {
+    group.Run(&chunks[t]);
+  }
+  chunks[0].Run();
+  group.Wait();
+}
+
+// Same as above, with as many chunks as the global pool has threads.
+template<typename Functor>
+void ParallelFor(int begin, int end, Functor *functor) {
+  ParallelFor(begin, end, NumThreads(), functor);
+}
+
+// Same as ParallelFor(), but the threads take the indices one at a time, so
+// that items of uneven cost are balanced between the threads. Which thread
+// runs an index depends on the scheduling, so functors must not depend on it.
+template<typename Functor>
+void ParallelForDynamic(int begin, int end, int num_threads,
+                        Functor *functor) {
+  int n = end - begin;
+  if (n <= 0) {
+    return;
+  }
+  num_threads = parallel_for::ClampNumThreads(n, num_threads);
+
+  parallel_for::Queue<Functor> queue;
+  queue.functor = functor;
+  queue.next = begin;
+  queue.end = end;
+
+  std::vector<parallel_for::QueueDrain<Functor> > drains(num_threads);
+  for (int t = 0; t < num_threads; ++t) {
+    drains[t].queue = &queue;
+  }
+  if (num_threads == 1) {
+    drains[0].Run();
+    return;
+  }
+  // The drains that start after the queue is empty return at once.
+  TaskGroup group;
+  for (int t = 1; t < num_threads; ++t) {
+    group.Run(&drains[t]);
+  }
+  drains[0].Run();
+  group.Wait();
+}
+
+}  // namespace libmv
+
+#endif  // LIBMV_BASE_THREAD_H
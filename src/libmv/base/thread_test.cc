@@ -0,0 +1,234 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <vector>
+
+#include "libmv/base/thread.h"
+#include "testing/testing.h"
+
+namespace libmv {
+namespace {
+
+struct Square {
+  explicit Square(std::vector<int> *out) : out(out) {}
+  void operator()(int i) { (*out)[i] = i * i; }
+  std::vector<int> *out;
+};
+
+struct Sum {
+  Sum() : total(0) {}
+  void operator()(int i) {
+    MutexLock lock(&mutex);
+    total += i;
+  }
+  Mutex mutex;
+  int total;
+};
+
+TEST(ParallelFor, VisitsEveryIndexOnce) {
+  for (int num_threads = 1; num_threads <= 5; ++num_threads) {
+    std::vector<int> out(103, -1);
+    Square square(&out);
+    ParallelFor(0, out.size(), num_threads, &square);
+    for (int i = 0; i < out.size(); ++i) {
+      EXPECT_EQ(i * i, out[i]);
+    }
+  }
+}
+
+TEST(ParallelFor, MoreThreadsThanItems) {
+  std::vector<int> out(3, -1);
+  Square square(&out);
+  ParallelFor(0, 3, 8, &square);
+  EXPECT_EQ(0, out[0]);
+  EXPECT_EQ(1, out[1]);
+  EXPECT_EQ(4, out[2]);
+}
+
+TEST(ParallelFor, EmptyRange) {
+  std::vector<int> out;
+  Square square(&out);
+  ParallelFor(5, 5, 4, &square);
+  ParallelFor(5, 2, 4, &square);
+}
+
+TEST(ParallelFor, MutexProtectsSharedState) {
+  Sum sum;
+  ParallelFor(0, 1000, 4, &sum);
+  EXPECT_EQ(999 * 1000 / 2, sum.total);
+}
+
+TEST(ParallelForDynamic, VisitsEveryIndexOnce) {
+  for (int num_threads = 1; num_threads <= 5; ++num_threads) {
+    std::vector<int> out(103, -1);
+    Square square(&out);
+    ParallelForDynamic(0, out.size(), num_threads, &square);
+    for (int i = 0; i < out.size(); ++i) {
+      EXPECT_EQ(i * i, out[i]);
+    }
+  }
+  std::vector<int> out;
+  Square square(&out);
+  ParallelForDynamic(5, 5, 4, &square);
+}
+
+TEST(ParallelForDynamic, MutexProtectsSharedState) {
+  Sum sum;
+  ParallelForDynamic(10, 1000, 4, &sum);
+  EXPECT_EQ(999 * 1000 / 2 - 9 * 10 / 2, sum.total);
+}
+
+// Adds to a counter, and runs children more levels of nested tasks.
+class Tree : public Task {
+ public:
+  Tree(ThreadPool *pool, int depth, int children, Sum *sum)
+      : pool_(pool), depth_(depth), children_(children), sum_(sum) {}
+  void Run() {
+    (*sum_)(1);
+    if (depth_ == 0) {
+      return;
+    }
+    std::vector<Tree> subtrees(children_,
+                               Tree(pool_, depth_ - 1, children_, sum_));
+    TaskGroup group(pool_);
+    for (int i = 0; i < children_; ++i) {
+      group.Run(&subtrees[i]);
+    }
+    group.Wait();
+  }
+
+ private:
+  ThreadPool *pool_;
+  int depth_, children_;
+  Sum *sum_;
+};
+
+TEST(ThreadPool, NestedTaskGroups) {
+  for (int num_threads = 1; num_threads <= 4; ++num_threads) {
+    ThreadPool pool(num_threads);
+    EXPECT_EQ(num_threads, pool.NumThreads());
+    Sum sum;
+    Tree tree(&pool, 4, 3, &sum);
+    TaskGroup group(&pool);
+    group.Run(&tree);
+    group.Wait();
+    // 1 + 3 + 9 + 27 + 81 tasks.
+    EXPECT_EQ(121, sum.total);
+  }
+}
+
+TEST(ThreadPool, GroupWaitsWhenDestroyed) {
+  ThreadPool pool(3);
+  Sum sum;
+  std::vector<Tree> leaves(50, Tree(&pool, 0, 0, &sum));
+  {
+    TaskGroup group(&pool);
+    for (int i = 0; i < leaves.size(); ++i) {
+      group.Run(&leaves[i]);
+    }
+  }
+  EXPECT_EQ(50, sum.total);
+}
+
+// Runs a ParallelFor from every index of another one.
+struct NestedParallelFor {
+  explicit NestedParallelFor(std::vector<int> *out) : out(out) {}
+  void operator()(int i) {
+    Square square(&(*out)[10 * i]);
+    ParallelFor(0, 10, 3, &square);
+  }
+  struct Square {
+    explicit Square(int *out) : out(out) {}
+    void operator()(int i) { out[i] = i * i; }
+    int *out;
+  };
+  std::vector<int> *out;
+};
+
+TEST(ParallelFor, NestedLoopsShareThePool) {
+  std::vector<int> out(100, -1);
+  NestedParallelFor nested(&out);
+  ParallelFor(0, 10, 4, &nested);
+  for (int i = 0; i < out.size(); ++i) {
+    EXPECT_EQ((i % 10) * (i % 10), out[i]);
+  }
+}
+
+TEST(ParallelFor, GlobalNumThreads) {
+  int num_threads = NumThreads();
+  EXPECT_GE(num_threads, 1);
+  SetNumThreads(3);
+  EXPECT_EQ(3, NumThreads());
+  Sum sum;
+  ParallelFor(0, 1000, &sum);
+  EXPECT_EQ(999 * 1000 / 2, sum.total);
+  SetNumThreads(1);
+  EXPECT_EQ(1, NumThreads());
+  Sum serial_sum;
+  ParallelForDynamic(0, 1000, 4, &serial_sum);
+  EXPECT_EQ(999 * 1000 / 2, serial_sum.total);
+  SetNumThreads(num_threads);
+}
+
+struct Producer {
+  static void *Entry(void *self) {
+    Producer *producer = static_cast<Producer *>(self);
+    for (int i = 0; i < producer->count; ++i) {
+      producer->queue->Push(i);
+    }
+    producer->queue->Close();
+    return NULL;
+  }
+  BoundedQueue<int> *queue;
+  int count;
+};
+
+TEST(BoundedQueue, KeepsTheOrderAcrossThreads) {
+  BoundedQueue<int> queue(3);
+  Producer producer;
+  producer.queue = &queue;
+  producer.count = 1000;
+  pthread_t thread;
+  ASSERT_EQ(0, pthread_create(&thread, NULL, &Producer::Entry, &producer));
+  int item, expected = 0;
+  while (queue.Pop(&item)) {
+    EXPECT_EQ(expected, item);
+    ++expected;
+  }
+  pthread_join(thread, NULL);
+  EXPECT_EQ(1000, expected);
+}
+
+TEST(BoundedQueue, ClosedQueueIsDrainedThenFails) {
+  BoundedQueue<int> queue(2);
+  EXPECT_TRUE(queue.Push(1));
+  EXPECT_TRUE(queue.Push(2));
+  queue.Close();
+  EXPECT_FALSE(queue.Push(3));
+  int item;
+  EXPECT_TRUE(queue.Pop(&item));
+  EXPECT_EQ(1, item);
+  EXPECT_TRUE(queue.Pop(&item));
+  EXPECT_EQ(2, item);
+  EXPECT_FALSE(queue.Pop(&item));
+}
+
+}  // namespace
+}  // namespace libmv
@@ -0,0 +1,69 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_BASE_TIMER_H
+#define LIBMV_BASE_TIMER_H
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#include <cstddef>
+#endif
+
+namespace libmv {
+
+// Seconds since an arbitrary origin; only differences are meaningful.
+inline double WallTimeInSeconds() {
+#ifdef _WIN32
+  LARGE_INTEGER frequency, counter;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  return static_cast<double>(counter.QuadPart) / frequency.QuadPart;
+#else
+  timeval time;
+  gettimeofday(&time, NULL);
+  return time.tv_sec + 1e-6 * time.tv_usec;
+#endif
+}
+
+// A deadline is a WallTimeInSeconds() after which a computation should return
+// the best result it has so far; 0 stands for no deadline.
+inline double DeadlineInSeconds(double seconds_from_now) {
+  return WallTimeInSeconds() + seconds_from_now;
+}
+
+inline bool DeadlineReached(double deadline) {
+  return deadline > 0 && WallTimeInSeconds() >= deadline;
+}
+
+// Measures the wall time elapsed since construction or the last Reset().
+class WallTimer {
+ public:
+  WallTimer() { Reset(); }
+  void Reset() { start_ = WallTimeInSeconds(); }
+  double ElapsedSeconds() const { return WallTimeInSeconds() - start_; }
+ private:
+  double start_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_BASE_TIMER_H
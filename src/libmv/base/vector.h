@@ -25,19 +25,68 @@
 #ifndef LIBMV_BASE_VECTOR_H
 #define LIBMV_BASE_VECTOR_H
 
+#include <algorithm>
 #include <cstring>
 #include <new>
+#if __cplusplus >= 201103L
+#include <utility>
+#endif
 
 #include <Eigen/Core>
 
 namespace libmv {
 
+// Whether a T can be moved to another address with memcpy, leaving nothing to
+// destroy at the old one. True for the types whose copy constructor is a
+// memcpy, and for the Eigen matrices; specialize it for the other types that
+// only own heap memory, like the arrays of libmv/image/array_nd.h.
+template <typename T>
+struct IsRelocatable {
+#if defined(__clang__)
+  enum { value = __is_trivially_constructible(T, const T &) };
+#elif defined(__GNUC__) || defined(_MSC_VER)
+  enum { value = __has_trivial_copy(T) };
+#else
+  enum { value = 0 };
+#endif
+};
+
+template <typename Scalar, int Rows, int Cols, int Options, int MaxRows,
+          int MaxCols>
+struct IsRelocatable<Eigen::Matrix<Scalar, Rows, Cols, Options, MaxRows,
+                                   MaxCols> > {
+  enum { value = 1 };
+};
+
+namespace vector_internal {
+
+// Room for N elements inside the vector, 16 byte aligned for vectorization.
+template <typename T, int N>
+class InlineStorage {
+ protected:
+  T *inline_data() { return reinterpret_cast<T *>(bytes_); }
+
+ private:
+  EIGEN_ALIGN16 char bytes_[N * sizeof(T)];
+};
+
+template <typename T>
+class InlineStorage<T, 0> {
+ protected:
+  T *inline_data() { return 0; }
+};
+
+}  // namespace vector_internal
+
 // A simple container class, which guarantees 16 byte alignment needed for most
-// vectorization. Don't use this container for classes that cannot be copied
-// via memcpy.
+// vectorization. The elements are moved with memcpy when they are
+// IsRelocatable, and copied then destroyed otherwise. With InlineCapacity > 0,
+// the first InlineCapacity elements are stored in the vector itself, so that
+// short vectors do not allocate.
 template <typename T,
-          typename Allocator = Eigen::aligned_allocator<T> >
-class vector {
+          typename Allocator = Eigen::aligned_allocator<T>,
+          int InlineCapacity = 0>
+class vector : private vector_internal::InlineStorage<T, InlineCapacity> {
  public:
   ~vector()                        { clear();                 }
 
@@ -49,23 +98,46 @@ class vector {
     std::fill(data_, data_+size_, val); }
 
   // Copy constructor and assignment.
-  vector(const vector<T, Allocator> &rhs) {
+  vector(const vector &rhs) {
     init();
     copy(rhs);
   }
-  vector<T, Allocator> &operator=(const vector<T, Allocator> &rhs) {
+  vector &operator=(const vector &rhs) {
     if (&rhs != this) {
       copy(rhs);
     }
     return *this;
   }
 
-  /// Swaps the contents of two vectors in constant time.
-  void swap(vector<T, Allocator> &other) {
-    std::swap(allocator_, other.allocator_);
-    std::swap(size_, other.size_);
-    std::swap(capacity_, other.capacity_);
-    std::swap(data_, other.data_);
+#if __cplusplus >= 201103L
+  // Move constructor and assignment; rhs is left empty.
+  vector(vector &&rhs) {
+    init();
+    take(rhs);
+  }
+  vector &operator=(vector &&rhs) {
+    if (&rhs != this) {
+      clear();
+      take(rhs);
+    }
+    return *this;
+  }
+#endif
+
+  /// Swaps the contents of two vectors, in constant time unless the elements
+  /// of one of them are stored inline.
+  void swap(vector &other) {
+    if (data_ != this->inline_data() && other.data_ != other.inline_data()) {
+      std::swap(allocator_, other.allocator_);
+      std::swap(size_, other.size_);
+      std::swap(capacity_, other.capacity_);
+      std::swap(data_, other.data_);
+    } else {
+      vector tmp;
+      tmp.take(*this);
+      take(other);
+      other.take(tmp);
+    }
   }
 
   int      size()            const { return size_;            }
@@ -91,14 +163,50 @@ class vector {
     size_ = size;
   }
 
-
-
   void push_back(const T &value) {
-    if (size_ == capacity_) {
-      reserve(size_ ? 2 * size_ : 1);
-    }
-    new (&data_[size_++]) T(value);
+    T *data;
+    new (back_slot(&data)) T(value);
+    commit_back(data);
+  }
+
+  // Constructs an element at the end from the arguments, and returns it.
+#if __cplusplus >= 201103L
+  template <typename... Args>
+  T &emplace_back(Args &&... args) {
+    T *data;
+    new (back_slot(&data)) T(std::forward<Args>(args)...);
+    commit_back(data);
+    return back();
+  }
+#else
+  T &emplace_back() {
+    T *data;
+    new (back_slot(&data)) T;
+    commit_back(data);
+    return back();
+  }
+  template <typename A1>
+  T &emplace_back(const A1 &a1) {
+    T *data;
+    new (back_slot(&data)) T(a1);
+    commit_back(data);
+    return back();
   }
+  template <typename A1, typename A2>
+  T &emplace_back(const A1 &a1, const A2 &a2) {
+    T *data;
+    new (back_slot(&data)) T(a1, a2);
+    commit_back(data);
+    return back();
+  }
+  template <typename A1, typename A2, typename A3>
+  T &emplace_back(const A1 &a1, const A2 &a2, const A3 &a3) {
+    T *data;
+    new (back_slot(&data)) T(a1, a2, a3);
+    commit_back(data);
+    return back();
+  }
+#endif
 
   void pop_back() {
     resize(size_ - 1);
@@ -111,10 +219,10 @@ class vector {
   }
 
   void reserve(unsigned int size) {
-    if (size > size_) {
+    if (size > capacity_) {
       T *data = static_cast<T *>(allocate(size));
-      memcpy(data, data_, sizeof(*data)*size_);
-      allocator_.deallocate(data_, capacity_);
+      relocate(data, data_, size_);
+      deallocate();
       data_ = data;
       capacity_ = size;
     }
@@ -133,32 +241,89 @@ class vector {
   }
   void init() {
     size_ = 0;
-    data_ = 0;
-    capacity_ = 0;
+    data_ = this->inline_data();
+    capacity_ = InlineCapacity;
   }
 
   void *allocate(int size) {
     return size ? allocator_.allocate(size) : 0;
   }
 
+  // Frees the heap storage, if the elements are not inline.
   void deallocate() {
-    allocator_.deallocate(data_, size_);
+    if (data_ != this->inline_data()) {
+      allocator_.deallocate(data_, capacity_);
+    }
     data_ = 0;
   }
 
-  void copy(const vector<T, Allocator> &rhs) {
+  // Moves n elements from src to the uninitialized dst.
+  static void relocate(T *dst, T *src, int n) {
+    if (IsRelocatable<T>::value) {
+      memcpy(static_cast<void *>(dst), static_cast<void *>(src),
+             sizeof(T) * n);
+    } else {
+      for (int i = 0; i < n; ++i) {
+        new (&dst[i]) T(src[i]);
+        src[i].~T();
+      }
+    }
+  }
+
+  // The uninitialized slot of a new last element, in the storage returned in
+  // data: the current one if it has room, or a larger one. The element is
+  // built before commit_back() releases the old storage, so that it can be
+  // built from an element of the vector.
+  T *back_slot(T **data) {
+    if (size_ < capacity_) {
+      *data = data_;
+    } else {
+      *data = static_cast<T *>(allocate(size_ ? 2 * size_ : 1));
+    }
+    return *data + size_;
+  }
+  void commit_back(T *data) {
+    if (data != data_) {
+      relocate(data, data_, size_);
+      deallocate();
+      data_ = data;
+      capacity_ = size_ ? 2 * size_ : 1;
+    }
+    ++size_;
+  }
+
+  void copy(const vector &rhs) {
     resize(rhs.size());
     for (int i = 0; i < rhs.size(); ++i) {
       (*this)[i] = rhs[i];
     }
   }
 
+  // Moves the elements of rhs to this vector, which must be empty with no
+  // heap storage, and leaves rhs empty.
+  void take(vector &rhs) {
+    if (rhs.data_ != rhs.inline_data()) {
+      data_ = rhs.data_;
+      capacity_ = rhs.capacity_;
+    } else {
+      relocate(data_, rhs.data_, rhs.size_);
+    }
+    size_ = rhs.size_;
+    rhs.init();
+  }
+
   Allocator allocator_;
   unsigned int size_;
   unsigned int capacity_;
   T *data_;
 };
 
+// Vectors without inline storage only own heap memory.
+template <typename T, typename Allocator>
+struct IsRelocatable<vector<T, Allocator, 0> > {
+  enum { value = 1 };
+};
+
 }  // namespace libmv
 
 #endif  // LIBMV_BASE_VECTOR_H
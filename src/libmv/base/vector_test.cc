@@ -220,4 +220,97 @@ TEST(Vector, swap) {
   EXPECT_EQ(2, b[1]);
 }
 
+TEST(Vector, SwapInline) {
+  vector<int, Eigen::aligned_allocator<int>, 2> a, b;
+  a.push_back(1);
+  b.push_back(2);
+  b.push_back(3);
+  b.push_back(4);
+  EXPECT_EQ(4, b.capacity());
+  a.swap(b);
+  ASSERT_EQ(3, a.size());
+  EXPECT_EQ(2, a[0]);
+  EXPECT_EQ(4, a[2]);
+  ASSERT_EQ(1, b.size());
+  EXPECT_EQ(1, b[0]);
+  EXPECT_EQ(2, b.capacity());
+}
+
+TEST(Vector, InlineCapacityDoesNotAllocate) {
+  vector<Vec2, Eigen::aligned_allocator<Vec2>, 4> v;
+  EXPECT_EQ(4, v.capacity());
+  const Vec2 *inline_data = v.begin();
+  for (int i = 0; i < 4; ++i) {
+    v.push_back(Vec2(i, i));
+  }
+  EXPECT_EQ(inline_data, v.begin());
+  EXPECT_EQ(0, size_t(v.begin()) % 16);
+  v.push_back(Vec2(4, 4));
+  EXPECT_NE(inline_data, v.begin());
+  EXPECT_EQ(8, v.capacity());
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(i, v[i](0));
+  }
+  vector<Vec2, Eigen::aligned_allocator<Vec2>, 4> copy(v);
+  ASSERT_EQ(5, copy.size());
+  EXPECT_EQ(4, copy[4](1));
+  v.clear();
+  EXPECT_EQ(inline_data, v.begin());
+  EXPECT_EQ(4, v.capacity());
+}
+
+// Keeps a pointer to itself, so it cannot be moved with memcpy.
+struct SelfPointer {
+  SelfPointer(int v = 0) : value(v), self(this) {}
+  SelfPointer(const SelfPointer &other) : value(other.value), self(this) {}
+  SelfPointer &operator=(const SelfPointer &other) {
+    value = other.value;
+    return *this;
+  }
+  int value;
+  SelfPointer *self;
+};
+
+TEST(Vector, NonRelocatableElementsAreCopied) {
+  EXPECT_FALSE(IsRelocatable<SelfPointer>::value);
+  EXPECT_TRUE(IsRelocatable<int>::value);
+  EXPECT_TRUE(IsRelocatable<Vec2>::value);
+  EXPECT_TRUE(IsRelocatable<Mat>::value);
+  vector<SelfPointer> v;
+  for (int i = 0; i < 9; ++i) {
+    v.push_back(SelfPointer(i));
+  }
+  v.reserve(100);
+  for (int i = 0; i < v.size(); ++i) {
+    EXPECT_EQ(i, v[i].value);
+    EXPECT_EQ(&v[i], v[i].self);
+  }
+}
+
+TEST(Vector, EmplaceBack) {
+  vector<Mat> v;
+  for (int i = 0; i < 5; ++i) {
+    Mat &m = v.emplace_back(2, i + 1);
+    m.setConstant(i);
+  }
+  ASSERT_EQ(5, v.size());
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(i + 1, v[i].cols());
+    EXPECT_EQ(i, v[i](1, i));
+  }
+  vector<int> w;
+  w.emplace_back() = 3;
+  EXPECT_EQ(3, w[0]);
+}
+
+TEST(Vector, PushBackOwnElement) {
+  vector<Mat> v;
+  v.push_back(Mat::Constant(2, 2, 7.0));
+  for (int i = 0; i < 5; ++i) {
+    v.push_back(v[0]);
+  }
+  ASSERT_EQ(6, v.size());
+  EXPECT_EQ(7, v[5](1, 1));
+}
+
 }  // namespace
@@ -22,4 +22,14 @@
 
 namespace libmv {
 
+int Camera::ProjectPoints(const Mat3X &X,
+                          Mat2X *x,
+                          std::vector<char> *is_visible,
+                          int num_threads) const {
+  Mat4X HX(4, X.cols());
+  HX.topRows(3) = X;
+  HX.row(3).setOnes();
+  return ProjectPoints(HX, x, is_visible, num_threads);
+}
+
 }  // namespace libmv
@@ -21,6 +21,8 @@
 #ifndef LIBMV_MULTIVIEW_CAMERA_H_
 #define LIBMV_MULTIVIEW_CAMERA_H_
 
+#include <vector>
+
 #include "libmv/camera/lens_distortion.h"
 #include "libmv/correspondence/feature.h"
 #include "libmv/logging/logging.h"
@@ -40,6 +42,20 @@ class Camera {
   
   // Return the ray direction of a pixel
   virtual Vec3 Ray(const Vec2f &pixel) = 0;
+
+  // Projects the homogeneous points of the columns of X into the columns of
+  // x, using num_threads threads. If is_visible is not NULL, it receives 1
+  // for the visible points and 0 for the others, whose projections are
+  // computed anyway. Returns the number of visible points.
+  virtual int ProjectPoints(const Mat4X &X,
+                            Mat2X *x,
+                            std::vector<char> *is_visible = NULL,
+                            int num_threads = 1) const = 0;
+  // Same as above for euclidean points.
+  int ProjectPoints(const Mat3X &X,
+                    Mat2X *x,
+                    std::vector<char> *is_visible = NULL,
+                    int num_threads = 1) const;
 };
 
 }  // namespace libmv
@@ -18,8 +18,13 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <algorithm>
+
 #include "libmv/camera/pinhole_camera.h"
 #include "libmv/camera/lens_distortion.h"
+#include "libmv/base/thread.h"
+#include "libmv/image/filtered_sequence.h"
+#include "libmv/image/sample.h"
 #include "libmv/numeric/levenberg_marquardt.h"
 
 namespace libmv {
@@ -112,20 +117,179 @@ void LensDistortion::ComputeUndistortedCoordinates(
 }
 
 LensDistortionField::LensDistortionField(const Vec &radial_distortion,
-                                         const Vec &tangential_distortion) :
-    LensDistortion(radial_distortion, tangential_distortion) {
+                                         const Vec &tangential_distortion,
+                                         int grid_step) :
+    LensDistortion(radial_distortion, tangential_distortion),
+    grid_step_(grid_step) {
+  CHECK_GT(grid_step, 0);
   is_precomputed_grid_done_ = false;
 }
-void LensDistortionField::ComputeUndistortedCoordinates(
-    const PinholeCamera &camera,
-    const Vec2 &point,
-    Vec2 *undistorted_point) const {
-  // TODO(julien) Computes the undistorted coordinates of a point using the
-  // look-up table
+
+bool LensDistortionField::IsDistortionMapValid(
+    const PinholeCamera &camera) const {
+  return is_precomputed_grid_done_ &&
+         focal_x_ == camera.focal_x() &&
+         focal_y_ == camera.focal_y() &&
+         principal_point_ == camera.principal_point() &&
+         image_size_ == camera.image_size() &&
+         map_radial_distortion_.size() == radial_distortion().size() &&
+         map_radial_distortion_ == radial_distortion() &&
+         map_tangential_distortion_.size() ==
+           tangential_distortion().size() &&
+         map_tangential_distortion_ == tangential_distortion();
 }
+
 void LensDistortionField::ComputeDistortionMap(
     const PinholeCamera &camera) {
-  // TODO(julien) add a look-up table with precomputed radius for instance
+  if (IsDistortionMapValid(camera)) {
+    return;
+  }
+  is_precomputed_grid_done_ = false;
+  const int width = camera.image_width();
+  const int height = camera.image_height();
+  CHECK_GT(width, 1);
+  CHECK_GT(height, 1);
+
+  map_x_.resize(width * height);
+  map_y_.resize(width * height);
+  is_inside_.resize(width * height);
+  Vec2 q;
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      LensDistortion::ComputeUndistortedCoordinates(camera, Vec2(x, y), &q);
+      int i = y * width + x;
+      map_x_[i] = q.x();
+      map_y_[i] = q.y();
+      is_inside_[i] = 0 <= int(q.x()) && int(q.x()) < width &&
+                      0 <= int(q.y()) && int(q.y()) < height;
+    }
+  }
+
+  // The grid covers the image, its last nodes may be outside.
+  const int num_x = (width - 2) / grid_step_ + 2;
+  const int num_y = (height - 2) / grid_step_ + 2;
+  grid_x_.resize(num_y, num_x);
+  grid_y_.resize(num_y, num_x);
+  for (int j = 0; j < num_y; ++j) {
+    for (int i = 0; i < num_x; ++i) {
+      LensDistortion::ComputeDistortedCoordinates(
+          camera, Vec2(i * grid_step_, j * grid_step_), &q);
+      grid_x_(j, i) = q.x();
+      grid_y_(j, i) = q.y();
+    }
+  }
+
+  focal_x_ = camera.focal_x();
+  focal_y_ = camera.focal_y();
+  principal_point_ = camera.principal_point();
+  image_size_ = camera.image_size();
+  map_radial_distortion_ = radial_distortion();
+  map_tangential_distortion_ = tangential_distortion();
+  is_precomputed_grid_done_ = true;
+  VLOG(1) << "Distortion maps of " << width << "x" << height << " pixels, "
+          << num_x << "x" << num_y << " grid nodes." << std::endl;
+}
+
+Vec2 LensDistortionField::InterpolateGrid(const Vec2 &point) const {
+  double gx = point.x() / grid_step_;
+  double gy = point.y() / grid_step_;
+  // Outside of the grid the border cells are extrapolated.
+  int i = std::max(0, std::min(int(floor(gx)), int(grid_x_.cols()) - 2));
+  int j = std::max(0, std::min(int(floor(gy)), int(grid_x_.rows()) - 2));
+  double ax = gx - i, ay = gy - j;
+  double w00 = (1 - ax) * (1 - ay), w01 = ax * (1 - ay);
+  double w10 = (1 - ax) * ay,       w11 = ax * ay;
+  return Vec2(w00 * grid_x_(j, i)     + w01 * grid_x_(j, i + 1) +
+              w10 * grid_x_(j + 1, i) + w11 * grid_x_(j + 1, i + 1),
+              w00 * grid_y_(j, i)     + w01 * grid_y_(j, i + 1) +
+              w10 * grid_y_(j + 1, i) + w11 * grid_y_(j + 1, i + 1));
+}
+
+void LensDistortionField::ComputeDistortedCoordinates(
+    const PinholeCamera &camera,
+    const Vec2 &point,
+    Vec2 *distorted_point) const {
+  if (!IsDistortionMapValid(camera)) {
+    LensDistortion::ComputeDistortedCoordinates(camera, point,
+                                                distorted_point);
+    return;
+  }
+  // The grid is an approximate inverse of the undistortion F, and so its
+  // error is corrected by the error of G(F(p)) on the same point.
+  const int kNumRefinements = 3;
+  Vec2 target = InterpolateGrid(point);
+  Vec2 p = target, undistorted;
+  for (int i = 0; i < kNumRefinements; ++i) {
+    LensDistortion::ComputeUndistortedCoordinates(camera, p, &undistorted);
+    p += target - InterpolateGrid(undistorted);
+  }
+  *distorted_point = p;
+}
+
+namespace {
+
+// Undistorts rows of an image through the dense maps, for ParallelFor.
+struct UndistortRows {
+  void operator()(int y) const {
+    const int row = y * width;
+    float *samples = out->Data() + row * depth;
+    SampleLinear(*in, map_y + row, map_x + row, width, samples);
+    for (int x = 0; x < width; ++x) {
+      if (!is_inside[row + x]) {
+        std::fill(samples + x * depth, samples + (x + 1) * depth, 0.0f);
+      }
+    }
+  }
+  const FloatImage *in;
+  FloatImage *out;
+  int width, depth;
+  const float *map_x, *map_y;
+  const char *is_inside;
+};
+
+// Undistorts the frames of a sequence, see UndistortSequence().
+class UndistortFilter : public Filter {
+ public:
+  UndistortFilter(const LensDistortionField *distortion, int num_threads)
+      : distortion_(distortion), num_threads_(num_threads) {}
+  virtual ~UndistortFilter() {}
+  virtual void RunFilter(const Array3Df &source, Array3Df *destination) {
+    distortion_->UndistortImage(source, destination, num_threads_);
+  }
+ private:
+  const LensDistortionField *distortion_;
+  int num_threads_;
+};
+
+}  // namespace
+
+void LensDistortionField::UndistortImage(const FloatImage &in,
+                                         FloatImage *out,
+                                         int num_threads) const {
+  CHECK(is_precomputed_grid_done_);
+  const int width = image_size_(0);
+  const int height = image_size_(1);
+  CHECK_EQ(width, in.Width());
+  CHECK_EQ(height, in.Height());
+  const int depth = in.Depth();
+  out->Resize(height, width, depth);
+  UndistortRows undistort;
+  undistort.in = &in;
+  undistort.out = out;
+  undistort.width = width;
+  undistort.depth = depth;
+  undistort.map_x = &map_x_[0];
+  undistort.map_y = &map_y_[0];
+  undistort.is_inside = &is_inside_[0];
+  ParallelFor(0, height, num_threads, &undistort);
+}
+
+ImageSequence *UndistortSequence(ImageSequence *source,
+                                 const LensDistortionField *distortion,
+                                 int num_threads) {
+  return new FilteredImageSequence(source,
+                                   new UndistortFilter(distortion,
+                                                       num_threads));
 }
 
 }  // namespace libmv
@@ -22,11 +22,13 @@
 #define LIBMV_CAMERA_LENS_DISTORTION_H_
 
 #include "libmv/base/vector.h"
+#include "libmv/image/image.h"
 #include "libmv/logging/logging.h"
 #include "libmv/numeric/numeric.h"
 
 namespace libmv {
 
+class ImageSequence;
 class PinholeCamera;
 
 //
@@ -90,35 +92,84 @@ class LensDistortion {
 };
 
 //
-// Use a precomputed map for fast undistortion computation
-// WARNING: This is at best, barely started.
-// This class is cleary not thought out yet!
+// Lens distortion with precomputed maps for the intrinsic parameters and the
+// image size of a camera:
+//  - a dense map of the undistorted coordinates of every pixel, used to
+//    undistort whole images in one pass;
+//  - a sparse grid of the distorted coordinates, every grid_step pixels,
+//    used instead of the Levenberg-Marquardt inversion of the model for
+//    every point: the grid gives an approximation, refined by a few steps of
+//    p += G(q) - G(F(p)), where F is the closed form of the undistortion and
+//    G the grid.
+// The maps are computed by ComputeDistortionMap() and used as long as the
+// camera and the distortion coefficients are those they were computed for;
+// otherwise the LensDistortion methods are used.
 class LensDistortionField : public LensDistortion {
  public:
   LensDistortionField(const Vec &radial_distortion = Vec(), 
-                      const Vec &tangential_distortion = Vec());
+                      const Vec &tangential_distortion = Vec(),
+                      int grid_step = 16);
 
-  // Compute the undistorted coordinates of a 2D point
+  // Compute the distorted coordinates of a 2D point, from the grid if it is
+  // valid for camera.
   // \param[in] camera is a pinhole camera model
-  // \param[in] point is the 2D point (in pixel) we need to undistort
-  // \param[out] undistorted_point is the undistort 2D point (pixel)
+  // \param[in] point is the 2D point (in pixel) we need to distort
+  // \param[out] distorted_point is the distort 2D point (pixel)
   //
-  void ComputeUndistortedCoordinates(const PinholeCamera &camera,
-                                     const Vec2 &point,
-                                     Vec2 *undistorted_point) const;
+  void ComputeDistortedCoordinates(const PinholeCamera &camera,
+                                   const Vec2 &point,
+                                   Vec2 *distorted_point) const;
 
-  // The function constructs two vectors containing the undistorted
-  // coordinates for every pixels of an image
+  // The function computes the dense map and the grid for the intrinsic
+  // parameters and the image size of camera, unless they are already valid.
   void ComputeDistortionMap(const PinholeCamera &camera);
- 
+
+  // True if the maps have been computed for the intrinsic parameters and
+  // the image size of camera, and for the current distortion coefficients.
+  bool IsDistortionMapValid(const PinholeCamera &camera) const;
+
+  // Undistorts a whole image of the size of the maps: out(y, x) is the
+  // bilinear sample of in at the undistorted coordinates of (x, y), or 0
+  // when they are outside of the image. The rows are sampled with the
+  // vectorized SampleLinear(), split between num_threads threads. The maps
+  // must be valid.
+  void UndistortImage(const FloatImage &in, FloatImage *out,
+                      int num_threads = 1) const;
+
+  int grid_step() const { return grid_step_; }
+
  private:
-  // TODO(julien): Find an efficient index for the precomputed map
-  // Contains the undistorted coordinates for every pixel
-  vector<Vec> precomputed_undistortion_grid_;
-  // Defines if the precomputed_distortion_grid is precomputed or not 
+  // Bilinear interpolation of the grid.
+  Vec2 InterpolateGrid(const Vec2 &point) const;
+
+  int grid_step_;
+  // The parameters the maps have been computed for.
   bool is_precomputed_grid_done_;
+  double focal_x_;
+  double focal_y_;
+  Vec2 principal_point_;
+  Vec2u image_size_;
+  Vec map_radial_distortion_;
+  Vec map_tangential_distortion_;
+
+  // Undistorted coordinates of the pixel (x, y) at y * width + x.
+  vector<float> map_x_;
+  vector<float> map_y_;
+  vector<char> is_inside_;
+  // Distorted coordinates of the point (i, j) * grid_step at (j, i).
+  Mat grid_x_;
+  Mat grid_y_;
 };
 
+// The frames of source undistorted by distortion->UndistortImage() with
+// num_threads threads, so that tracking consumes undistorted frames without
+// writing them. The maps of distortion must be valid for the size of the
+// frames. Neither source nor distortion are owned; both must outlive the
+// returned sequence.
+ImageSequence *UndistortSequence(ImageSequence *source,
+                                 const LensDistortionField *distortion,
+                                 int num_threads = 1);
+
 }
 
 #endif  // LIBMV_CAMERA_LENS_DISTORTION_H_
@@ -18,9 +18,13 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include "libmv/base/scoped_ptr.h"
 #include "libmv/base/vector.h"
 #include "libmv/camera/pinhole_camera.h"
 #include "libmv/camera/lens_distortion.h"
+#include "libmv/image/image.h"
+#include "libmv/image/mock_image_sequence.h"
+#include "libmv/image/sample.h"
 #include "libmv/numeric/levenberg_marquardt.h"
 #include "libmv/multiview/structure.h"
 #include "libmv/multiview/test_data_sets.h"
@@ -87,4 +91,123 @@ TEST(LensDistortion, LensDistortionDistortUndistor) {
   }
 }
 
+// A 320x240 camera with the radial and tangential distortion of the test
+// above.
+class LensDistortionFieldTest : public testing::Test {
+ protected:
+  LensDistortionFieldTest()
+      : lens_distortion_(Vec2(0.24, -0.199), Vec3(0.011, 0.001, 0.0001), 16),
+        camera_(&lens_distortion_) {
+    Mat3 K;
+    K << 400, 0, 159.5,
+           0, 410, 119.5,
+           0, 0, 1;
+    camera_.set_intrinsic_matrix(K);
+    camera_.set_image_size(Vec2u(320, 240));
+  }
+
+  LensDistortionField lens_distortion_;
+  PinholeCameraDistortion camera_;
+};
+
+TEST_F(LensDistortionFieldTest, GridMatchesTheIterativeDistortion) {
+  EXPECT_FALSE(lens_distortion_.IsDistortionMapValid(camera_));
+  lens_distortion_.ComputeDistortionMap(camera_);
+  EXPECT_TRUE(lens_distortion_.IsDistortionMapValid(camera_));
+
+  LensDistortion reference(lens_distortion_.radial_distortion(),
+                           lens_distortion_.tangential_distortion());
+  Vec2 distorted, expected;
+  for (double y = -3.5; y < 245; y += 7.3) {
+    for (double x = -2.25; x < 325; x += 11.1) {
+      lens_distortion_.ComputeDistortedCoordinates(camera_, Vec2(x, y),
+                                                   &distorted);
+      reference.ComputeDistortedCoordinates(camera_, Vec2(x, y), &expected);
+      EXPECT_MATRIX_NEAR(expected, distorted, 1e-6);
+    }
+  }
+
+  // The maps are not used anymore once the coefficients have changed.
+  lens_distortion_.set_radial_distortion(Vec2(0.2, -0.1));
+  EXPECT_FALSE(lens_distortion_.IsDistortionMapValid(camera_));
+  reference.set_radial_distortion(Vec2(0.2, -0.1));
+  lens_distortion_.ComputeDistortedCoordinates(camera_, Vec2(10, 20),
+                                               &distorted);
+  reference.ComputeDistortedCoordinates(camera_, Vec2(10, 20), &expected);
+  EXPECT_MATRIX_NEAR(expected, distorted, 1e-8);
+}
+
+TEST_F(LensDistortionFieldTest, UndistortImageSamplesTheDenseMap) {
+  lens_distortion_.ComputeDistortionMap(camera_);
+  for (int depth = 1; depth <= 3; depth += 2) {
+    FloatImage image(240, 320, depth);
+    for (int y = 0; y < 240; ++y) {
+      for (int x = 0; x < 320; ++x) {
+        for (int d = 0; d < depth; ++d) {
+          image(y, x, d) = (x * 7 + y * 13 + d * 29) % 101;
+        }
+      }
+    }
+    FloatImage undistorted;
+    lens_distortion_.UndistortImage(image, &undistorted);
+    ASSERT_EQ(240, undistorted.Height());
+    ASSERT_EQ(320, undistorted.Width());
+    ASSERT_EQ(depth, undistorted.Depth());
+    Vec2 q;
+    for (int y = 0; y < 240; ++y) {
+      for (int x = 0; x < 320; ++x) {
+        camera_.ComputeUndistortedCoordinates(Vec2(x, y), &q);
+        for (int d = 0; d < depth; ++d) {
+          float expected = 0;
+          if (image.Contains(q(1), q(0))) {
+            expected = SampleLinear(image, q(1), q(0), d);
+          }
+          EXPECT_NEAR(expected, undistorted(y, x, d), 1e-3);
+        }
+      }
+    }
+  }
+}
+
+TEST_F(LensDistortionFieldTest, UndistortSequenceIsThreadedUndistortImage) {
+  lens_distortion_.ComputeDistortionMap(camera_);
+  FloatImage image(240, 320, 1);
+  for (int y = 0; y < 240; ++y) {
+    for (int x = 0; x < 320; ++x) {
+      image(y, x) = (x * 7 + y * 13) % 101;
+    }
+  }
+  FloatImage expected, threaded;
+  lens_distortion_.UndistortImage(image, &expected);
+  lens_distortion_.UndistortImage(image, &threaded, 4);
+  ImageCache cache;
+  MockImageSequence frames(&cache);
+  frames.Append(&image);
+  scoped_ptr<ImageSequence> undistorted(
+      UndistortSequence(&frames, &lens_distortion_, 3));
+  ASSERT_EQ(1, undistorted->Length());
+  FloatImage *frame = undistorted->GetFloatImage(0);
+  ASSERT_TRUE(frame != NULL);
+  for (int y = 0; y < 240; ++y) {
+    for (int x = 0; x < 320; ++x) {
+      EXPECT_EQ(expected(y, x), threaded(y, x));
+      EXPECT_EQ(expected(y, x), (*frame)(y, x));
+    }
+  }
+  undistorted->Unpin(0);
+}
+
+TEST_F(LensDistortionFieldTest, UndistortFeature) {
+  PointFeature feature(100.5, 30.25);
+  PointFeature undistorted;
+  camera_.ComputeUndistortedFeature(feature, &undistorted);
+  Vec2 expected;
+  camera_.ComputeUndistortedCoordinates(Vec2(100.5, 30.25), &expected);
+  EXPECT_NEAR(expected.x(), undistorted.x(), 1e-4);
+  EXPECT_NEAR(expected.y(), undistorted.y(), 1e-4);
+  camera_.UndistortFeature(&feature);
+  EXPECT_EQ(undistorted.x(), feature.x());
+  EXPECT_EQ(undistorted.y(), feature.y());
+}
+
 }  // namespace libmv
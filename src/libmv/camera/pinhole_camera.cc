@@ -18,24 +18,28 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <algorithm>
+
+#include "libmv/base/thread.h"
 #include "libmv/camera/pinhole_camera.h"
 #include "libmv/multiview/structure.h"
 
 namespace libmv {
 
-PinholeCamera::PinholeCamera() {
+PinholeCamera::PinholeCamera() : image_size_(0, 0) {
   orientation_matrix_.setIdentity();
   intrinsic_matrix_.setIdentity();
   UpdateProjectionMatrix();
 }
 
-PinholeCamera::PinholeCamera(const Mat34  &P) {
+PinholeCamera::PinholeCamera(const Mat34  &P) : image_size_(0, 0) {
   projection_matrix_ = P;
   // TODO(julien) when the reconstruction is metric, we can call KRt_From_P();
   // but whent it is projective, what to do? add a boolean?
 }
 
-PinholeCamera::PinholeCamera(const Mat3  &R, const Vec3  &t) {
+PinholeCamera::PinholeCamera(const Mat3  &R, const Vec3  &t)
+    : image_size_(0, 0) {
   orientation_matrix_ = R;
   position_ = t;
   UpdateProjectionMatrix();
@@ -43,14 +47,15 @@ PinholeCamera::PinholeCamera(const Mat3  &R, const Vec3  &t) {
 
 PinholeCamera::PinholeCamera(const Mat3  &K,
                              const Mat3  &R,
-                             const Vec3  &t){
+                             const Vec3  &t) : image_size_(0, 0) {
   intrinsic_matrix_   = K;
   orientation_matrix_ = R;
   position_ = t;
   UpdateProjectionMatrix();
 }
 PinholeCamera::PinholeCamera(double focal,
-                             const Vec2 &principal_point) {
+                             const Vec2 &principal_point)
+    : image_size_(0, 0) {
   orientation_matrix_.setIdentity();
   SetIntrinsicParameters(focal, principal_point);
 }
@@ -58,7 +63,8 @@ PinholeCamera::PinholeCamera(double focal,
 PinholeCamera::~PinholeCamera() {
 }
 
-PinholeCamera::PinholeCamera(const PinholeCamera &camera){
+PinholeCamera::PinholeCamera(const PinholeCamera &camera)
+    : Camera(), image_size_(0, 0) {
   this->set_intrinsic_matrix(camera.intrinsic_matrix());
 }
 
@@ -97,6 +103,69 @@ bool PinholeCamera::ProjectPointStructure(
   return true;
 }
 
+// Projects the columns of a block of points.
+struct PinholeCamera::ProjectionBlock {
+  static const int kSize = 256;
+
+  const PinholeCamera *camera;
+  const Mat4X *X;
+  Mat2X *x;
+  std::vector<char> *is_visible;
+  std::vector<int> num_visible;
+
+  void operator()(int block) {
+    const int begin = block * kSize;
+    const int n = std::min(kSize, int(X->cols()) - begin);
+    Mat3X hx = camera->projection_matrix() * X->block(0, begin, 4, n);
+    x->block(0, begin, 1, n) = hx.row(0).cwiseQuotient(hx.row(2));
+    x->block(1, begin, 1, n) = hx.row(1).cwiseQuotient(hx.row(2));
+    camera->DistortProjections(begin, begin + n, x);
+
+    const Vec2u &size = camera->image_size();
+    const bool has_size = size(0) > 0 && size(1) > 0;
+    int visible = 0;
+    for (int c = 0; c < n; ++c) {
+      const int i = begin + c;
+      // The depth of X is hx(2) / X(3) (up to the scale of K).
+      bool is_in_front = hx(2, c) * (*X)(3, i) > 0;
+      bool is_inside = !has_size ||
+          ((*x)(0, i) >= 0 && (*x)(0, i) < size(0) &&
+           (*x)(1, i) >= 0 && (*x)(1, i) < size(1));
+      char v = is_in_front && is_inside;
+      if (is_visible) {
+        (*is_visible)[i] = v;
+      }
+      visible += v;
+    }
+    num_visible[block] = visible;
+  }
+};
+
+int PinholeCamera::ProjectPoints(const Mat4X &X,
+                                 Mat2X *x,
+                                 std::vector<char> *is_visible,
+                                 int num_threads) const {
+  const int n = X.cols();
+  x->resize(2, n);
+  if (is_visible) {
+    is_visible->resize(n);
+  }
+  ProjectionBlock projection;
+  projection.camera = this;
+  projection.X = &X;
+  projection.x = x;
+  projection.is_visible = is_visible;
+  const int num_blocks = (n + ProjectionBlock::kSize - 1) /
+      ProjectionBlock::kSize;
+  projection.num_visible.resize(num_blocks);
+  ParallelFor(0, num_blocks, num_threads, &projection);
+  int num_visible = 0;
+  for (int b = 0; b < num_blocks; ++b) {
+    num_visible += projection.num_visible[b];
+  }
+  return num_visible;
+}
+
 PinholeCameraDistortion::PinholeCameraDistortion(
     LensDistortion *lens_distortion) {
   lens_distortion_ = lens_distortion;
@@ -145,15 +214,39 @@ bool PinholeCameraDistortion::ProjectPointStructure(
 void PinholeCameraDistortion::ComputeUndistortedFeature(
     const Feature &feature,
     Feature *undistorted_feature) const {
-  // TODO(julien) call the 2D undistortion for every 2D component of a feature
-  (void) feature;
-  (void) undistorted_feature;
+  // TODO(julien) call the 2D undistortion for every 2D component of the other
+  // features
+  const PointFeature *point = dynamic_cast<const PointFeature *>(&feature);
+  PointFeature *undistorted_point =
+    dynamic_cast<PointFeature *>(undistorted_feature);
+  if (point && undistorted_point) {
+    *undistorted_point = *point;
+    UndistortFeature(undistorted_point);
+  }
 }
 
 // The function undistorts the feature using the camera distorsion model
 void PinholeCameraDistortion::UndistortFeature(Feature *feature) const {
-  // TODO(julien) call the 2D undistortion for every 2D component of a feature
-  (void) feature;
+  PointFeature *point = dynamic_cast<PointFeature *>(feature);
+  if (point && lens_distortion_) {
+    Vec2 coords;
+    ComputeUndistortedCoordinates(point->coords.cast<double>(), &coords);
+    point->coords = coords.cast<float>();
+  }
+}
+
+void PinholeCameraDistortion::DistortProjections(int begin,
+                                                 int end,
+                                                 Mat2X *x) const {
+  if (!lens_distortion_) {
+    return;
+  }
+  Vec2 distorted;
+  for (int i = begin; i < end; ++i) {
+    lens_distortion_->ComputeDistortedCoordinates(*this, x->col(i),
+                                                  &distorted);
+    x->col(i) = distorted;
+  }
 }
 
 void PinholeCameraDistortion::ComputeUndistortedCoordinates(
@@ -66,8 +66,15 @@ class PinholeCamera : public Camera {
   // The function computes the projection of a 3D point
   virtual bool ProjectPointStructure(const PointStructure &point_structure,
                                      Vec2 *q) const;
-                                      
-  // TODO(julien) A visibility test for a structure
+
+  // The function computes the projections of the columns of X by blocks
+  // (see Camera::ProjectPoints()). A point is visible if it is in front of
+  // the camera and, once the image size is set, projects inside the image.
+  virtual int ProjectPoints(const Mat4X &X,
+                            Mat2X *x,
+                            std::vector<char> *is_visible = NULL,
+                            int num_threads = 1) const;
+  using Camera::ProjectPoints;
                               
   // The function returns the ray direction of a pixel
   virtual Vec3 Ray(const Vec2f &pixel) { return Vec3(pixel.x(), 
@@ -191,7 +198,14 @@ class PinholeCamera : public Camera {
     image_size_ = size;
   }
   
+ protected:
+  // Applies the lens distortion to the projections of the columns begin to
+  // end - 1 of x; called by ProjectPoints() from several threads.
+  virtual void DistortProjections(int begin, int end, Mat2X *x) const {}
+
  private:
+  struct ProjectionBlock;
+
   void UpdateProjectionMatrix();
   void UpdateIntrinsicMatrix();
 
@@ -251,6 +265,10 @@ class PinholeCameraDistortion : public PinholeCamera {
   void set_lens_distortion(LensDistortion *lens_distortion) {
     lens_distortion_ = lens_distortion;
   }
+
+ protected:
+  // Distorts the projections with ComputeDistortedCoordinates().
+  virtual void DistortProjections(int begin, int end, Mat2X *x) const;
   
  private:
   LensDistortion *lens_distortion_;
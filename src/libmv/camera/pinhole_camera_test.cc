@@ -82,4 +82,65 @@ TEST(CameraModel, PinholeCameraProjection) {
   }
 }
 
+TEST(CameraModel, ProjectPointsMatchesTheProjectionOfEachPoint) {
+  const int npoints = 1000;
+  NViewDataSet d = NRealisticCamerasFull(1, npoints);
+  PinholeCamera camera(d.K[0], d.R[0], d.t[0]);
+  Vec2u image_size(d.K[0](0, 2) * 2, d.K[0](1, 2) * 2);
+  camera.set_image_size(image_size);
+
+  // The first point is behind the camera, the second one projects out of
+  // the image; the last ones have a non unit homogeneous coordinate.
+  Mat4X X(4, npoints);
+  X.topRows(3) = d.X;
+  X.row(3).setOnes();
+  X.col(0).head<3>() = 2 * (-camera.orientation_matrix().transpose() *
+                             camera.position()) - d.X.col(0);
+  X.col(1).head<3>() = -camera.orientation_matrix().transpose() *
+    (camera.position() - Vec3(1e4, 0, 1));
+  X.rightCols(10) *= -2.5;
+
+  for (int num_threads = 1; num_threads <= 3; num_threads += 2) {
+    Mat2X x;
+    std::vector<char> is_visible;
+    int num_visible = camera.ProjectPoints(X, &x, &is_visible, num_threads);
+    ASSERT_EQ(npoints, x.cols());
+    ASSERT_EQ(npoints, is_visible.size());
+    EXPECT_FALSE(is_visible[0]);
+    EXPECT_FALSE(is_visible[1]);
+    Vec2 q;
+    int expected_num_visible = 0;
+    for (int i = 2; i < npoints; ++i) {
+      camera.ProjectPointStructure(PointStructure(Vec4(X.col(i))), &q);
+      EXPECT_MATRIX_NEAR(q, x.col(i), 1e-9);
+      bool is_inside = q(0) >= 0 && q(0) < image_size(0) &&
+                       q(1) >= 0 && q(1) < image_size(1);
+      EXPECT_EQ(is_inside, is_visible[i]);
+      expected_num_visible += is_inside;
+    }
+    EXPECT_EQ(expected_num_visible, num_visible);
+    EXPECT_GT(num_visible, npoints / 2);
+  }
+
+  Mat2X x_euclidean;
+  camera.ProjectPoints(d.X, &x_euclidean);
+  EXPECT_MATRIX_NEAR(Project(camera.projection_matrix(), d.X),
+                     x_euclidean, 1e-9);
+}
+
+TEST(CameraModel, ProjectPointsAppliesTheDistortion) {
+  const int npoints = 300;
+  NViewDataSet d = NRealisticCamerasFull(1, npoints);
+  LensDistortion lens_distortion(Vec2(0.24, -0.199), Vec2(0.01, 0.01));
+  PinholeCameraDistortion camera(d.K[0], d.R[0], d.t[0], &lens_distortion);
+  Mat2X x;
+  EXPECT_EQ(npoints, camera.ProjectPoints(d.X, &x, NULL, 2));
+  PointFeature feature;
+  for (int i = 0; i < npoints; ++i) {
+    camera.ProjectPointStructure(PointStructure(Vec3(d.X.col(i))), &feature);
+    EXPECT_NEAR(feature.x(), x(0, i), 1e-4);
+    EXPECT_NEAR(feature.y(), x(1, i), 1e-4);
+  }
+}
+
 }  // namespace libmv
\ No newline at end of file
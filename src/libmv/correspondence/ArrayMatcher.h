@@ -21,6 +21,7 @@
 #ifndef LIBMV_CORRESPONDENCE_ARRAYMATCHER_H_
 #define LIBMV_CORRESPONDENCE_ARRAYMATCHER_H_
 
+#include "libmv/base/thread.h"
 #include "libmv/base/vector.h"
 
 namespace libmv {
@@ -30,8 +31,20 @@ template < typename Scalar = float >
 class ArrayMatcher
 {
   public:
+  ArrayMatcher() : _numThreads(1) {}
   virtual ~ArrayMatcher() {};
 
+  /**
+   * Split the queries of searchNeighbours() in numThreads contiguous chunks
+   * searched concurrently, each with its own search scratch memory. Every
+   * query is searched the same way whatever the split, so the results do not
+   * depend on the number of threads. Matchers whose search state cannot be
+   * split (see ArrayMatcher_Kdtree_Flann) search sequentially.
+   */
+  void SetNumThreads(int numThreads)
+    { _numThreads = numThreads < 1 ? 1 : numThreads; }
+  int NumThreads() const { return _numThreads; }
+
   /**
    * Build the matching structure
    *
@@ -69,8 +82,45 @@ class ArrayMatcher
    */
   virtual bool searchNeighbours( const Scalar * query, int nbQuery,
     vector<int> * indice, vector<Scalar> * distance, int NN)=0;
+
+  protected:
+  /// The number of chunks the nbQuery queries are split in.
+  int numSearchChunks(int nbQuery) const
+    { return parallel_for::ClampNumThreads(nbQuery, _numThreads); }
+
+  int _numThreads;
 };
 
+namespace array_matcher {
+
+template <typename Search>
+struct Chunks {
+  void operator()(int c) const {
+    int begin = (nbQuery * c) / numChunks;
+    int end = (nbQuery * (c + 1)) / numChunks;
+    if (begin < end) {
+      (*search)(c, begin, end);
+    }
+  }
+  Search *search;
+  int nbQuery;
+  int numChunks;
+};
+
+}  // namespace array_matcher
+
+/// Call (*search)(chunk, begin, end) for the numChunks contiguous chunks of
+/// [0, nbQuery), concurrently on the global thread pool; a matcher gives each
+/// chunk its own scratch memory.
+template <typename Search>
+void SearchInChunks(int nbQuery, int numChunks, Search *search) {
+  array_matcher::Chunks<Search> chunks;
+  chunks.search = search;
+  chunks.nbQuery = nbQuery;
+  chunks.numChunks = numChunks;
+  ParallelFor(0, numChunks, numChunks, &chunks);
+}
+
 } // namespace correspondence
 } // namespace libmv
 
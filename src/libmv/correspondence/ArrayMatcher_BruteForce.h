@@ -21,24 +21,28 @@
 #ifndef LIBMV_CORRESPONDENCE_ARRAYMATCHER_BRUTE_FORCE_H_
 #define LIBMV_CORRESPONDENCE_ARRAYMATCHER_BRUTE_FORCE_H_
 
+#include <algorithm>
+#include <vector>
+
 #include "libmv/correspondence/ArrayMatcher.h"
-#include "third_party/flann/src/cpp/flann.h"
+#include "libmv/correspondence/brute_force_matching.h"
 
 namespace libmv {
 namespace correspondence  {
 
-/// Implement ArrayMatcher as a FLANN LINEAR matcher.
-// http://www.cs.ubc.ca/~mariusm/index.php/FLANN/FLANN
-// David G. Lowe and Marius Muja
+/// Implement ArrayMatcher as an exact linear matcher: every query is compared
+/// with every array of the dataset (see BruteForceKnn). Scalar must be float.
+///
+/// The queries are split between SetNumThreads() threads. To match the
+/// features of many images against the same dataset, searchNeighboursBatch()
+/// searches all the query sets in one pass over the dataset.
 template < typename Scalar >
 class ArrayMatcher_BruteForce : public ArrayMatcher<Scalar>
 {
   public:
-  ArrayMatcher_BruteForce():_index_id(NULL) {}
+  ArrayMatcher_BruteForce() : _nbRows(0), _dimension(0) {}
 
-  ~ArrayMatcher_BruteForce()  {
-    flann_free_index(_index_id, &_p);
-    }
+  ~ArrayMatcher_BruteForce()  {}
 
   /**
    * Build the matching structure
@@ -51,19 +55,15 @@ class ArrayMatcher_BruteForce : public ArrayMatcher<Scalar>
    * \return True if success.
    */
   bool build( const Scalar * dataset, int nbRows, int dimension)  {
-
-    _p.log_destination = NULL;
-    _p.log_level = LOG_INFO;
-
-    // Force LINEAR MATCHING : Brute Force.
-    _p.algorithm = LINEAR;
-    _p.target_precision = -1.0f;
-
-    //-- Build FLANN index
-    float fspeedUp;
-    _index_id = flann_build_index( (float*)dataset, nbRows, dimension,
-      &fspeedUp, &_p);
-    return (_index_id != NULL);
+    if (nbRows <= 0 || dimension <= 0) {
+      return false;
+    }
+    _nbRows = nbRows;
+    _dimension = dimension;
+    _dataset.assign(dataset, dataset + nbRows * dimension);
+    _norms.resize(nbRows);
+    SquaredRowNorms(&_dataset[0], nbRows, dimension, &_norms[0]);
+    return true;
   }
 
   /**
@@ -78,14 +78,12 @@ class ArrayMatcher_BruteForce : public ArrayMatcher<Scalar>
    */
   bool searchNeighbour( const Scalar * query, int * indice, Scalar * distance)
   {
-    if (_index_id != NULL) {
-      int iRet = flann_find_nearest_neighbors_index(_index_id, (Scalar*)query,
-        1, indice, distance, 1, _p.checks, &_p);
-        return (iRet == 0);
-    }
-    else  {
+    if (_nbRows == 0) {
       return false;
     }
+    BruteForceKnn(&_dataset[0], &_norms[0], _nbRows, query, 1, _dimension, 1,
+                  indice, distance);
+    return true;
   }
 
 
@@ -103,25 +101,62 @@ class ArrayMatcher_BruteForce : public ArrayMatcher<Scalar>
   bool searchNeighbours( const Scalar * query, int nbQuery,
     vector<int> * indice, vector<Scalar> * distance, int NN)
   {
-    if (_index_id != NULL)  {
-      //-- Check if resultIndices is allocated
-      indice->resize(nbQuery * NN);
-      distance->resize(nbQuery * NN);
-
-      int * indicePTR = &((*indice)[0]);
-      float * distancePTR = &(*distance)[0];
-      int iRet = flann_find_nearest_neighbors_index(_index_id, (Scalar*)query,
-          nbQuery, indicePTR, distancePTR, NN, _p.checks, &_p);
-        return (iRet == 0);
+    if (_nbRows < NN || NN <= 0) {
+      return false;
+    }
+    indice->resize(nbQuery * NN);
+    distance->resize(nbQuery * NN);
+    if (nbQuery > 0) {
+      BruteForceKnnParallel(&_dataset[0], &_norms[0], _nbRows, query, nbQuery,
+                            _dimension, NN, &(*indice)[0], &(*distance)[0],
+                            this->NumThreads());
     }
-    else  {
+    return true;
+  }
+
+  /**
+   * Search the N nearest Neighbours of several sets of queries at once.
+   *
+   * \param[in]   queries   The query arrays of each set
+   * \param[in]   nbQueries The number of query rows of each set
+   * \param[out]  indice    The indices of the nearest arrays, set after
+   *  set, as if the sets were one query array given to searchNeighbours().
+   * \param[out]  distance  The distances between the matched arrays.
+   *
+   * With NN = 2 this gives the two neighbours of the ratio test.
+   *
+   * \return True if success.
+   */
+  bool searchNeighboursBatch(const std::vector<const Scalar *> &queries,
+                             const std::vector<int> &nbQueries,
+                             vector<int> * indice, vector<Scalar> * distance,
+                             int NN)
+  {
+    if (queries.size() != nbQueries.size()) {
       return false;
     }
+    int total = 0;
+    for (size_t i = 0; i < nbQueries.size(); ++i) {
+      total += nbQueries[i];
+    }
+    _batch.resize(total * _dimension);
+    int offset = 0;
+    for (size_t i = 0; i < queries.size(); ++i) {
+      std::copy(queries[i], queries[i] + nbQueries[i] * _dimension,
+                _batch.begin() + offset);
+      offset += nbQueries[i] * _dimension;
+    }
+    return searchNeighbours(_batch.empty() ? NULL : &_batch[0], total,
+                            indice, distance, NN);
   }
 
   private :
-  FLANN_INDEX _index_id;
-  FLANNParameters _p;
+  int _nbRows;
+  int _dimension;
+  // The queries of searchNeighboursBatch(), made contiguous.
+  std::vector<float> _batch;
+  std::vector<float> _dataset;
+  std::vector<float> _norms;
 };
 
 } // namespace correspondence
@@ -0,0 +1,150 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_CORRESPONDENCE_ARRAYMATCHER_BRUTE_FORCE_HAMMING_H_
+#define LIBMV_CORRESPONDENCE_ARRAYMATCHER_BRUTE_FORCE_HAMMING_H_
+
+#include <vector>
+
+#include "libmv/correspondence/ArrayMatcher.h"
+#include "libmv/correspondence/hamming.h"
+
+namespace libmv {
+namespace correspondence  {
+
+/// Implement ArrayMatcher as an exact Hamming distance matcher of binary
+/// descriptors: the arrays are packed 32 bit words (e.g. the words of a
+/// descriptor::BinaryDescriptor), the dimension is the number of words and
+/// the distances are numbers of differing bits. The queries are split between
+/// SetNumThreads() threads.
+class ArrayMatcher_BruteForceHamming : public ArrayMatcher<unsigned int>
+{
+  public:
+  ArrayMatcher_BruteForceHamming() : _nbRows(0), _dimension(0) {}
+
+  ~ArrayMatcher_BruteForceHamming() {}
+
+  /**
+   * Build the matching structure
+   *
+   * \param[in] dataset   Input data.
+   * \param[in] nbRows    The number of component.
+   * \param[in] dimension Number of words of each row of the dataset.
+   *
+   * \return True if success.
+   */
+  bool build( const unsigned int * dataset, int nbRows, int dimension)  {
+    if (nbRows <= 0 || dimension <= 0) {
+      return false;
+    }
+    _nbRows = nbRows;
+    _dimension = dimension;
+    _dataset.assign(dataset, dataset + nbRows * dimension);
+    return true;
+  }
+
+  /**
+   * Search the nearest Neighbour of the scalar array query.
+   *
+   * \param[in]   query     The query array
+   * \param[out]  indice    The indice of array in the dataset that
+   *  have been computed as the nearest array.
+   * \param[out]  distance  The distance between the two arrays.
+   *
+   * \return True if success.
+   */
+  bool searchNeighbour( const unsigned int * query, int * indice,
+    unsigned int * distance)
+  {
+    if (_nbRows == 0) {
+      return false;
+    }
+    search(query, 1, indice, distance);
+    return true;
+  }
+
+  /**
+   * Search the N nearest Neighbour of the scalar array query.
+   *
+   * \param[in]   query     The query array
+   * \param[in]   nbQuery   The number of query rows
+   * \param[out]  indice    The indices of arrays in the dataset that
+   *  have been computed as the nearest arrays.
+   * \param[out]  distance  The distances between the matched arrays.
+   *
+   * \return True if success.
+   */
+  bool searchNeighbours( const unsigned int * query, int nbQuery,
+    vector<int> * indice, vector<unsigned int> * distance, int NN)
+  {
+    if (_nbRows < NN || NN <= 0) {
+      return false;
+    }
+    indice->resize(nbQuery * NN);
+    distance->resize(nbQuery * NN);
+    if (nbQuery > 0) {
+      ChunkSearch search;
+      search.matcher = this;
+      search.query = query;
+      search.NN = NN;
+      search.indice = &(*indice)[0];
+      search.distance = &(*distance)[0];
+      SearchInChunks(nbQuery, numSearchChunks(nbQuery), &search);
+    }
+    return true;
+  }
+
+  private :
+  // Searches the queries [begin, end); the dataset is only read.
+  struct ChunkSearch {
+    void operator()(int, int begin, int end) const {
+      for (int i = begin; i < end; ++i) {
+        matcher->search(query + i * matcher->_dimension, NN, indice + i * NN,
+                        distance + i * NN);
+      }
+    }
+    const ArrayMatcher_BruteForceHamming *matcher;
+    const unsigned int *query;
+    int NN;
+    int *indice;
+    unsigned int *distance;
+  };
+  friend struct ChunkSearch;
+
+  void search(const unsigned int * query, int NN, int * indice,
+              unsigned int * distance) const {
+    int size = 0;
+    for (int j = 0; j < _nbRows; ++j) {
+      AddHammingCandidate(j,
+                          HammingDistance(query, &_dataset[j * _dimension],
+                                          _dimension),
+                          NN, &size, indice, distance);
+    }
+  }
+
+  int _nbRows;
+  int _dimension;
+  std::vector<unsigned int> _dataset;
+};
+
+} // namespace correspondence
+} // namespace libmv
+
+#endif // LIBMV_CORRESPONDENCE_ARRAYMATCHER_BRUTE_FORCE_HAMMING_H_
@@ -0,0 +1,388 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+#ifndef LIBMV_CORRESPONDENCE_ARRAYMATCHER_CASCADE_HASHING_H_
+#define LIBMV_CORRESPONDENCE_ARRAYMATCHER_CASCADE_HASHING_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "libmv/correspondence/ArrayMatcher.h"
+#include "libmv/correspondence/hamming.h"
+
+namespace libmv {
+namespace correspondence  {
+
+/// Implement ArrayMatcher as an approximate L2 matcher of float descriptors
+/// by cascade hashing, after Cheng, Leng, Wu, Cui and Lu "Fast and accurate
+/// image matching with cascade hashing for 3D reconstruction" (CVPR 2014).
+///
+/// The descriptors, centered on the mean of the dataset, are hashed with
+/// random projections at two levels. Each of the nbTables tables buckets the
+/// rows by the signs of nbBucketBits projections; a query gathers the rows of
+/// its bucket in every table. The candidates are then ranked by the Hamming
+/// distance between longer binary codes of 32 * nbCodeWords projections, and
+/// only the nbCandidates closest in Hamming distance are compared with the
+/// exact squared L2 distance. When fewer than NN candidates are found the
+/// query falls back to an exhaustive search so that all the returned indices
+/// are valid.
+///
+/// The queries are split between SetNumThreads() threads, each with its own
+/// scratch memory; the scratch memory is reused by the following searches,
+/// therefore a matcher must not be searched from several threads at once.
+template < typename Scalar = float >
+class ArrayMatcher_CascadeHashing : public ArrayMatcher<Scalar>
+{
+  public:
+  ArrayMatcher_CascadeHashing(int nbTables = 6, int nbBucketBits = 8,
+                              int nbCodeWords = 4, int nbCandidates = 10)
+    : _nbTables(nbTables), _nbBucketBits(nbBucketBits),
+      _nbCodeWords(nbCodeWords), _nbCandidates(nbCandidates),
+      _nbRows(0), _dimension(0) {
+    assert(0 < nbBucketBits && nbBucketBits <= 20);
+    assert(nbCodeWords > 0 && nbCandidates > 0);
+  }
+
+  ~ArrayMatcher_CascadeHashing() {}
+
+  /**
+   * Build the matching structure
+   *
+   * \param[in] dataset   Input data.
+   * \param[in] nbRows    The number of component.
+   * \param[in] dimension Length of the data contained in the each
+   *  row of the dataset.
+   *
+   * \return True if success.
+   */
+  bool build( const Scalar * dataset, int nbRows, int dimension)  {
+    if (nbRows <= 0 || dimension <= 0) {
+      return false;
+    }
+    _nbRows = nbRows;
+    _dimension = dimension;
+    _dataset.assign(dataset, dataset + nbRows * dimension);
+    _scratch.clear();
+
+    _mean.assign(dimension, 0);
+    for (int j = 0; j < nbRows; ++j) {
+      for (int d = 0; d < dimension; ++d) {
+        _mean[d] += _dataset[j * dimension + d];
+      }
+    }
+    for (int d = 0; d < dimension; ++d) {
+      _mean[d] /= nbRows;
+    }
+
+    // Gaussian projections drawn with a fixed seed so that the index is
+    // reproducible: the bucket projections of every table, then the code
+    // projections.
+    int nbProjections = _nbTables * _nbBucketBits + 32 * _nbCodeWords;
+    _projections.resize(nbProjections * dimension);
+    unsigned int seed = 1;
+    for (size_t i = 0; i < _projections.size(); ++i) {
+      _projections[i] = gaussian(&seed);
+    }
+
+    _codes.resize(nbRows * _nbCodeWords);
+    std::vector<unsigned int> keys(nbRows * _nbTables);
+    std::vector<float> projected(nbProjections);
+    for (int j = 0; j < nbRows; ++j) {
+      hash(&_dataset[j * dimension], &projected[0], &keys[j * _nbTables],
+           &_codes[j * _nbCodeWords]);
+    }
+
+    // The rows of every bucket, contiguous, found through the bucket offsets.
+    const int nbBuckets = 1 << _nbBucketBits;
+    _tables.resize(_nbTables);
+    for (int t = 0; t < _nbTables; ++t) {
+      Table &table = _tables[t];
+      table.offsets.assign(nbBuckets + 1, 0);
+      for (int j = 0; j < nbRows; ++j) {
+        ++table.offsets[keys[j * _nbTables + t] + 1];
+      }
+      for (int b = 0; b < nbBuckets; ++b) {
+        table.offsets[b + 1] += table.offsets[b];
+      }
+      table.rows.resize(nbRows);
+      std::vector<int> next(table.offsets.begin(), table.offsets.end() - 1);
+      for (int j = 0; j < nbRows; ++j) {
+        table.rows[next[keys[j * _nbTables + t]]++] = j;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Search the nearest Neighbour of the scalar array query.
+   *
+   * \param[in]   query     The query array
+   * \param[out]  indice    The indice of array in the dataset that
+   *  have been computed as the nearest array.
+   * \param[out]  distance  The distance between the two arrays.
+   *
+   * \return True if success.
+   */
+  bool searchNeighbour( const Scalar * query, int * indice, Scalar * distance)
+  {
+    if (_nbRows == 0) {
+      return false;
+    }
+    search(query, 1, indice, distance, scratch(1));
+    return true;
+  }
+
+  /**
+   * Search the N nearest Neighbour of the scalar array query.
+   *
+   * \param[in]   query     The query array
+   * \param[in]   nbQuery   The number of query rows
+   * \param[out]  indice    The indices of arrays in the dataset that
+   *  have been computed as the nearest arrays.
+   * \param[out]  distance  The squared distances between the matched arrays.
+   *
+   * \return True if success.
+   */
+  bool searchNeighbours( const Scalar * query, int nbQuery,
+    vector<int> * indice, vector<Scalar> * distance, int NN)
+  {
+    if (_nbRows < NN || NN <= 0) {
+      return false;
+    }
+    indice->resize(nbQuery * NN);
+    distance->resize(nbQuery * NN);
+    if (nbQuery > 0) {
+      int numChunks = this->numSearchChunks(nbQuery);
+      scratch(numChunks);
+      ChunkSearch search;
+      search.matcher = this;
+      search.query = query;
+      search.NN = NN;
+      search.indice = &(*indice)[0];
+      search.distance = &(*distance)[0];
+      SearchInChunks(nbQuery, numChunks, &search);
+    }
+    return true;
+  }
+
+  private :
+  struct Table {
+    std::vector<int> offsets;  // Rows of bucket b: [offsets[b], offsets[b+1]).
+    std::vector<int> rows;
+  };
+
+  // The scratch memory of a query.
+  struct Scratch {
+    Scratch() : stamp(0) {}
+    // The rows already gathered for the current query.
+    std::vector<unsigned int> visited;
+    unsigned int stamp;
+    std::vector<float> projected;
+    std::vector<unsigned int> keys;
+    std::vector<unsigned int> code;
+    std::vector<int> candidates;
+    std::vector<unsigned int> hamming;
+    std::vector<int> histogram;
+  };
+
+  // Searches the queries [begin, end) with the scratch of the chunk.
+  struct ChunkSearch {
+    void operator()(int chunk, int begin, int end) const {
+      for (int i = begin; i < end; ++i) {
+        matcher->search(query + i * matcher->_dimension, NN, indice + i * NN,
+                        distance + i * NN, &matcher->_scratch[chunk]);
+      }
+    }
+    ArrayMatcher_CascadeHashing *matcher;
+    const Scalar *query;
+    int NN;
+    int *indice;
+    Scalar *distance;
+  };
+  friend struct ChunkSearch;
+
+  // Makes sure there are at least numChunks scratches, returns the first.
+  Scratch *scratch(int numChunks) {
+    if (int(_scratch.size()) < numChunks) {
+      _scratch.resize(numChunks);
+    }
+    for (int c = 0; c < numChunks; ++c) {
+      _scratch[c].visited.resize(_nbRows, 0);
+    }
+    return &_scratch[0];
+  }
+
+  // Box-Muller on a linear congruential generator.
+  static float gaussian(unsigned int *seed) {
+    *seed = *seed * 1103515245u + 12345u;
+    double u1 = (((*seed >> 8) & 0xffffff) + 1.0) / 16777217.0;
+    *seed = *seed * 1103515245u + 12345u;
+    double u2 = ((*seed >> 8) & 0xffffff) / 16777216.0;
+    return std::sqrt(-2 * std::log(u1)) * std::cos(2 * M_PI * u2);
+  }
+
+  // The bucket of row in every table and its binary code.
+  void hash(const Scalar * row, float * projected, unsigned int * keys,
+            unsigned int * code) const {
+    int nbProjections = _nbTables * _nbBucketBits + 32 * _nbCodeWords;
+    for (int p = 0; p < nbProjections; ++p) {
+      const float * projection = &_projections[p * _dimension];
+      float dot = 0;
+      for (int d = 0; d < _dimension; ++d) {
+        dot += projection[d] * (row[d] - _mean[d]);
+      }
+      projected[p] = dot;
+    }
+    for (int t = 0; t < _nbTables; ++t) {
+      unsigned int k = 0;
+      for (int b = 0; b < _nbBucketBits; ++b) {
+        k |= (projected[t * _nbBucketBits + b] > 0 ? 1u : 0u) << b;
+      }
+      keys[t] = k;
+    }
+    const float * bits = projected + _nbTables * _nbBucketBits;
+    for (int w = 0; w < _nbCodeWords; ++w) {
+      unsigned int word = 0;
+      for (int b = 0; b < 32; ++b) {
+        word |= (bits[w * 32 + b] > 0 ? 1u : 0u) << b;
+      }
+      code[w] = word;
+    }
+  }
+
+  Scalar squaredDistance(const Scalar * query, int row) const {
+    const Scalar * data = &_dataset[row * _dimension];
+    Scalar distance = 0;
+    for (int d = 0; d < _dimension; ++d) {
+      Scalar diff = query[d] - data[d];
+      distance += diff * diff;
+    }
+    return distance;
+  }
+
+  // Inserts a candidate in the sorted list of the k best ones, of which size
+  // are filled (updated), as AddHammingCandidate() does.
+  static void addCandidate(int id, Scalar distance, int k, int * size,
+                           int * ids, Scalar * distances) {
+    if (*size == k && distance >= distances[k - 1]) {
+      return;
+    }
+    int i = *size == k ? k - 1 : (*size)++;
+    for (; i > 0 && distances[i - 1] > distance; --i) {
+      ids[i] = ids[i - 1];
+      distances[i] = distances[i - 1];
+    }
+    ids[i] = id;
+    distances[i] = distance;
+  }
+
+  void search(const Scalar * query, int NN, int * indice, Scalar * distance,
+              Scratch * scratch) const {
+    if (++scratch->stamp == 0) {
+      std::fill(scratch->visited.begin(), scratch->visited.end(), 0);
+      scratch->stamp = 1;
+    }
+    const int nbCodeBits = 32 * _nbCodeWords;
+    std::vector<unsigned int> &keys = scratch->keys;
+    std::vector<unsigned int> &code = scratch->code;
+    scratch->projected.resize(_nbTables * _nbBucketBits + nbCodeBits);
+    keys.resize(_nbTables);
+    code.resize(_nbCodeWords);
+    hash(query, &scratch->projected[0], &keys[0], &code[0]);
+
+    // Gather the rows sharing a bucket with the query, and their Hamming
+    // distance to its code.
+    std::vector<int> &candidates = scratch->candidates;
+    std::vector<unsigned int> &hamming = scratch->hamming;
+    std::vector<int> &histogram = scratch->histogram;
+    candidates.clear();
+    hamming.clear();
+    histogram.assign(nbCodeBits + 1, 0);
+    for (int t = 0; t < _nbTables; ++t) {
+      const Table &table = _tables[t];
+      for (int i = table.offsets[keys[t]]; i < table.offsets[keys[t] + 1];
+           ++i) {
+        int row = table.rows[i];
+        if (scratch->visited[row] == scratch->stamp) {
+          continue;
+        }
+        scratch->visited[row] = scratch->stamp;
+        unsigned int h = HammingDistance(&code[0],
+                                         &_codes[row * _nbCodeWords],
+                                         _nbCodeWords);
+        candidates.push_back(row);
+        hamming.push_back(h);
+        ++histogram[h];
+      }
+    }
+
+    int size = 0;
+    int nbChecks = std::max(_nbCandidates, NN);
+    if (int(candidates.size()) >= NN) {
+      // The Hamming distance below which at most nbChecks candidates lie;
+      // the candidates at the threshold fill the remaining checks.
+      unsigned int threshold = 0;
+      int below = 0;
+      while (threshold < histogram.size() &&
+             below + histogram[threshold] <= nbChecks) {
+        below += histogram[threshold++];
+      }
+      int atThreshold = nbChecks - below;
+      for (size_t c = 0; c < candidates.size(); ++c) {
+        if (hamming[c] > threshold ||
+            (hamming[c] == threshold && atThreshold-- <= 0)) {
+          continue;
+        }
+        addCandidate(candidates[c], squaredDistance(query, candidates[c]),
+                     NN, &size, indice, distance);
+      }
+    }
+    if (size < NN) {
+      size = 0;
+      for (int j = 0; j < _nbRows; ++j) {
+        addCandidate(j, squaredDistance(query, j), NN, &size, indice,
+                     distance);
+      }
+    }
+  }
+
+  int _nbTables;
+  int _nbBucketBits;
+  int _nbCodeWords;
+  int _nbCandidates;
+  int _nbRows;
+  int _dimension;
+  std::vector<Scalar> _dataset;
+  std::vector<float> _mean;
+  std::vector<float> _projections;
+  std::vector<unsigned int> _codes;
+  std::vector<Table> _tables;
+  // One per chunk of queries.
+  std::vector<Scratch> _scratch;
+};
+
+} // namespace correspondence
+} // namespace libmv
+
+#endif // LIBMV_CORRESPONDENCE_ARRAYMATCHER_CASCADE_HASHING_H_
@@ -27,7 +27,9 @@
 namespace libmv {
 namespace correspondence  {
 
-/// Implement ArrayMatcher as the native KDtree libmv matcher.
+/// Implement ArrayMatcher as the native KDtree libmv matcher. The tree is
+/// only read by the searches, which are split between SetNumThreads()
+/// threads.
 template < typename Scalar >
 class ArrayMatcher_Kdtree : public ArrayMatcher<Scalar>
 {
@@ -94,14 +96,15 @@ class ArrayMatcher_Kdtree : public ArrayMatcher<Scalar>
     vector<int> * indice, vector<Scalar> * distance, int NN)
   {
     if (NN==1)  {
-      const Scalar * ptrQuery =  query;
-      for (int i=0; i < nbQuery; ++i) {
-        Scalar distanceToQuery;
-        int nni;
-        _tree.ApproximateNearestNeighborBestBinFirst(ptrQuery, 1000, &nni, &distanceToQuery);
-        distance->push_back(distanceToQuery);
-        indice->push_back(nni);
-        ptrQuery+=_tree.NumDimension();
+      indice->resize(nbQuery);
+      distance->resize(nbQuery);
+      if (nbQuery > 0) {
+        ChunkSearch search;
+        search.tree = &_tree;
+        search.query = query;
+        search.indice = &(*indice)[0];
+        search.distance = &(*distance)[0];
+        SearchInChunks(nbQuery, this->numSearchChunks(nbQuery), &search);
       }
       return true;
     }
@@ -112,6 +115,20 @@ class ArrayMatcher_Kdtree : public ArrayMatcher<Scalar>
   }
 
   private :
+  // Searches the queries [begin, end); the tree is only read.
+  struct ChunkSearch {
+    void operator()(int, int begin, int end) const {
+      for (int i = begin; i < end; ++i) {
+        tree->ApproximateNearestNeighborBestBinFirst(
+            query + i * tree->NumDimension(), 1000, indice + i, distance + i);
+      }
+    }
+    const KdTree<Scalar> *tree;
+    const Scalar *query;
+    int *indice;
+    Scalar *distance;
+  };
+
   KdTree<Scalar> _tree;
 
 };
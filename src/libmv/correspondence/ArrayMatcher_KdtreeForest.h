@@ -0,0 +1,153 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_CORRESPONDENCE_ARRAYMATCHER_KDTREE_FOREST_H_
+#define LIBMV_CORRESPONDENCE_ARRAYMATCHER_KDTREE_FOREST_H_
+
+#include <algorithm>
+#include <vector>
+
+#include "libmv/correspondence/ArrayMatcher.h"
+#include "libmv/correspondence/kdtree_forest.h"
+
+namespace libmv {
+namespace correspondence  {
+
+/// Implement ArrayMatcher as the native randomized KDtree forest matcher.
+/// The queries are split between SetNumThreads() threads, each with its own
+/// search context; the contexts are reused by the following searches,
+/// therefore a matcher must not be searched from several threads at once.
+template < typename Scalar >
+class ArrayMatcher_KdtreeForest : public ArrayMatcher<Scalar>
+{
+  public:
+  /**
+   * \param[in] nbTrees   The number of randomized trees.
+   * \param[in] maxChecks Maximum number of dataset arrays compared to a query
+   *  (0 for an exact search).
+   */
+  ArrayMatcher_KdtreeForest(int nbTrees = 4, int maxChecks = 256)
+    : _nbTrees(nbTrees), _maxChecks(maxChecks) {}
+
+  ~ArrayMatcher_KdtreeForest() {}
+
+  /**
+   * Build the matching structure
+   *
+   * \param[in] dataset   Input data.
+   * \param[in] nbRows    The number of component.
+   * \param[in] dimension Length of the data contained in the each
+   *  row of the dataset.
+   *
+   * \return True if success.
+   */
+  bool build( const Scalar * dataset, int nbRows, int dimension)  {
+    if (nbRows <= 0 || dimension <= 0) {
+      return false;
+    }
+    _forest.Build(dataset, nbRows, dimension, _nbTrees);
+    return true;
+  }
+
+  /**
+   * Search the nearest Neighbour of the scalar array query.
+   *
+   * \param[in]   query     The query array
+   * \param[out]  indice    The indice of array in the dataset that
+   *  have been computed as the nearest array.
+   * \param[out]  distance  The distance between the two arrays.
+   *
+   * \return True if success.
+   */
+  bool searchNeighbour( const Scalar * query, int * indice, Scalar * distance)
+  {
+    if (_forest.NumPoints() == 0) {
+      return false;
+    }
+    _contexts.resize(std::max<size_t>(_contexts.size(), 1));
+    return _forest.Knn(query, 1, _maxChecks, &_contexts[0],
+                       indice, distance) == 1;
+  }
+
+
+  /**
+   * Search the N nearest Neighbour of the scalar array query.
+   *
+   * \param[in]   query     The query array
+   * \param[in]   nbQuery   The number of query rows
+   * \param[out]  indice    The indices of arrays in the dataset that
+   *  have been computed as the nearest arrays.
+   * \param[out]  distance  The distances between the matched arrays.
+   *
+   * \return True if success.
+   */
+  bool searchNeighbours( const Scalar * query, int nbQuery,
+    vector<int> * indice, vector<Scalar> * distance, int NN)
+  {
+    if (_forest.NumPoints() < NN || NN <= 0) {
+      return false;
+    }
+    indice->resize(nbQuery * NN);
+    distance->resize(nbQuery * NN);
+    if (nbQuery > 0) {
+      int numChunks = this->numSearchChunks(nbQuery);
+      _contexts.resize(std::max<size_t>(_contexts.size(), numChunks));
+      ChunkSearch search;
+      search.forest = &_forest;
+      search.maxChecks = _maxChecks;
+      search.contexts = &_contexts;
+      search.query = query;
+      search.NN = NN;
+      search.indice = &(*indice)[0];
+      search.distance = &(*distance)[0];
+      SearchInChunks(nbQuery, numChunks, &search);
+    }
+    return true;
+  }
+
+  private :
+  // Searches the queries [begin, end) with the context of the chunk.
+  struct ChunkSearch {
+    void operator()(int chunk, int begin, int end) const {
+      for (int i = begin; i < end; ++i) {
+        forest->Knn(query + i * forest->NumDimensions(), NN, maxChecks,
+                    &(*contexts)[chunk], indice + i * NN, distance + i * NN);
+      }
+    }
+    const KdForest<Scalar> *forest;
+    int maxChecks;
+    std::vector<typename KdForest<Scalar>::SearchContext> *contexts;
+    const Scalar *query;
+    int NN;
+    int *indice;
+    Scalar *distance;
+  };
+
+  int _nbTrees;
+  int _maxChecks;
+  KdForest<Scalar> _forest;
+  // One per chunk of queries.
+  std::vector<typename KdForest<Scalar>::SearchContext> _contexts;
+};
+
+} // namespace correspondence
+} // namespace libmv
+
+#endif // LIBMV_CORRESPONDENCE_ARRAYMATCHER_KDTREE_FOREST_H_
@@ -30,12 +30,20 @@ namespace correspondence  {
 /// Implement ArrayMatcher as a FLANN KDtree matcher.
 // http://www.cs.ubc.ca/~mariusm/index.php/FLANN/FLANN
 // David G. Lowe and Marius Muja
+//
+// The bundled FLANN keeps the search heap in the index, and its C interface
+// sets global parameters on every search, so the queries are always searched
+// sequentially whatever SetNumThreads().
 
 template < typename Scalar >
 class ArrayMatcher_Kdtree_Flann : public ArrayMatcher<Scalar>
 {
   public:
-  ArrayMatcher_Kdtree_Flann():_index_id(NULL) {}
+  // trees randomized kd-trees are built, and a search checks at most checks
+  // leaves; more of either is slower and finds the true nearest neighbours
+  // more often.
+  ArrayMatcher_Kdtree_Flann(int trees = 8, int checks = 32)
+    :_index_id(NULL), _trees(trees), _checks(checks) {}
 
   ~ArrayMatcher_Kdtree_Flann()  {
     flann_free_index(_index_id, &_p);
@@ -58,8 +66,8 @@ class ArrayMatcher_Kdtree_Flann : public ArrayMatcher<Scalar>
 
     // Force KDTREE matching
     _p.algorithm = KDTREE;
-    _p.checks = 32;    // Maximum number of leaf checked in one search
-    _p.trees = 8;      // number of randomized trees to use
+    _p.checks = _checks; // Maximum number of leaf checked in one search
+    _p.trees = _trees;   // number of randomized trees to use
     _p.branching = 32; // branching factor
     _p.iterations = 7; // max iterations to perform in one kmeans clustering (kmeans tree)
     _p.target_precision = -1.0f;
@@ -127,6 +135,8 @@ class ArrayMatcher_Kdtree_Flann : public ArrayMatcher<Scalar>
   private :
   FLANN_INDEX _index_id;
   FLANNParameters _p;
+  int _trees;
+  int _checks;
 };
 
 } // namespace correspondence
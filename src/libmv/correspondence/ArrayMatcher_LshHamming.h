@@ -0,0 +1,267 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_CORRESPONDENCE_ARRAYMATCHER_LSH_HAMMING_H_
+#define LIBMV_CORRESPONDENCE_ARRAYMATCHER_LSH_HAMMING_H_
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+#include <vector>
+
+#include "libmv/correspondence/ArrayMatcher.h"
+#include "libmv/correspondence/hamming.h"
+
+namespace libmv {
+namespace correspondence  {
+
+/// Implement ArrayMatcher as an approximate Hamming distance matcher of
+/// binary descriptors with bit sampling locality sensitive hashing: each
+/// table keys the rows by a random subset of their bits, and a query only
+/// compares against the rows that share its key (or a key one bit away) in at
+/// least one table. When fewer than NN candidates are found the query falls
+/// back to an exhaustive search so that all the returned indices are valid.
+///
+/// The queries are split between SetNumThreads() threads, each with its own
+/// scratch memory; the scratch memory is reused by the following searches,
+/// therefore a matcher must not be searched from several threads at once.
+class ArrayMatcher_LshHamming : public ArrayMatcher<unsigned int>
+{
+  public:
+  ArrayMatcher_LshHamming(int nbTables = 6, int nbKeyBits = 16,
+                          bool multiProbe = true)
+    : _nbTables(nbTables), _nbKeyBits(nbKeyBits), _multiProbe(multiProbe),
+      _nbRows(0), _dimension(0) {
+    assert(0 < nbKeyBits && nbKeyBits <= 32);
+  }
+
+  ~ArrayMatcher_LshHamming() {}
+
+  /**
+   * Build the matching structure
+   *
+   * \param[in] dataset   Input data.
+   * \param[in] nbRows    The number of component.
+   * \param[in] dimension Number of words of each row of the dataset.
+   *
+   * \return True if success.
+   */
+  bool build( const unsigned int * dataset, int nbRows, int dimension)  {
+    if (nbRows <= 0 || dimension <= 0) {
+      return false;
+    }
+    _nbRows = nbRows;
+    _dimension = dimension;
+    _dataset.assign(dataset, dataset + nbRows * dimension);
+    _scratch.clear();
+
+    // Draw the sampled bits of every table with a fixed seed so that the
+    // index is reproducible.
+    const int nbBits = 32 * dimension;
+    unsigned int seed = 1;
+    _bits.resize(_nbTables * _nbKeyBits);
+    for (size_t i = 0; i < _bits.size(); ++i) {
+      seed = seed * 1103515245u + 12345u;
+      _bits[i] = ((seed >> 16) & 0x7fff) % nbBits;
+    }
+
+    _tables.resize(_nbTables);
+    std::vector<std::pair<unsigned int, int> > entries(nbRows);
+    for (int t = 0; t < _nbTables; ++t) {
+      for (int j = 0; j < nbRows; ++j) {
+        entries[j] = std::make_pair(key(t, &_dataset[j * dimension]), j);
+      }
+      std::sort(entries.begin(), entries.end());
+      _tables[t].keys.resize(nbRows);
+      _tables[t].rows.resize(nbRows);
+      for (int j = 0; j < nbRows; ++j) {
+        _tables[t].keys[j] = entries[j].first;
+        _tables[t].rows[j] = entries[j].second;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Search the nearest Neighbour of the scalar array query.
+   *
+   * \param[in]   query     The query array
+   * \param[out]  indice    The indice of array in the dataset that
+   *  have been computed as the nearest array.
+   * \param[out]  distance  The distance between the two arrays.
+   *
+   * \return True if success.
+   */
+  bool searchNeighbour( const unsigned int * query, int * indice,
+    unsigned int * distance)
+  {
+    if (_nbRows == 0) {
+      return false;
+    }
+    search(query, 1, indice, distance, scratch(1));
+    return true;
+  }
+
+  /**
+   * Search the N nearest Neighbour of the scalar array query.
+   *
+   * \param[in]   query     The query array
+   * \param[in]   nbQuery   The number of query rows
+   * \param[out]  indice    The indices of arrays in the dataset that
+   *  have been computed as the nearest arrays.
+   * \param[out]  distance  The distances between the matched arrays.
+   *
+   * \return True if success.
+   */
+  bool searchNeighbours( const unsigned int * query, int nbQuery,
+    vector<int> * indice, vector<unsigned int> * distance, int NN)
+  {
+    if (_nbRows < NN || NN <= 0) {
+      return false;
+    }
+    indice->resize(nbQuery * NN);
+    distance->resize(nbQuery * NN);
+    if (nbQuery > 0) {
+      int numChunks = numSearchChunks(nbQuery);
+      scratch(numChunks);
+      ChunkSearch search;
+      search.matcher = this;
+      search.query = query;
+      search.NN = NN;
+      search.indice = &(*indice)[0];
+      search.distance = &(*distance)[0];
+      SearchInChunks(nbQuery, numChunks, &search);
+    }
+    return true;
+  }
+
+  private :
+  struct Table {
+    std::vector<unsigned int> keys;  // Sorted.
+    std::vector<int> rows;           // Row of each key.
+  };
+
+  // The rows already compared with the current query.
+  struct Scratch {
+    Scratch() : stamp(0) {}
+    std::vector<unsigned int> visited;
+    unsigned int stamp;
+  };
+
+  // Searches the queries [begin, end) with the scratch of the chunk.
+  struct ChunkSearch {
+    void operator()(int chunk, int begin, int end) const {
+      for (int i = begin; i < end; ++i) {
+        matcher->search(query + i * matcher->_dimension, NN, indice + i * NN,
+                        distance + i * NN, &matcher->_scratch[chunk]);
+      }
+    }
+    ArrayMatcher_LshHamming *matcher;
+    const unsigned int *query;
+    int NN;
+    int *indice;
+    unsigned int *distance;
+  };
+  friend struct ChunkSearch;
+
+  // Makes sure there are at least numChunks scratches, returns the first.
+  Scratch *scratch(int numChunks) {
+    if (int(_scratch.size()) < numChunks) {
+      _scratch.resize(numChunks);
+    }
+    for (int c = 0; c < numChunks; ++c) {
+      _scratch[c].visited.resize(_nbRows, 0);
+    }
+    return &_scratch[0];
+  }
+
+  unsigned int key(int table, const unsigned int * row) const {
+    const int * bits = &_bits[table * _nbKeyBits];
+    unsigned int k = 0;
+    for (int b = 0; b < _nbKeyBits; ++b) {
+      k |= ((row[bits[b] >> 5] >> (bits[b] & 31)) & 1u) << b;
+    }
+    return k;
+  }
+
+  void probe(const Table & table, unsigned int k, const unsigned int * query,
+             int NN, int * size, int * indice, unsigned int * distance,
+             Scratch * scratch) const {
+    std::pair<std::vector<unsigned int>::const_iterator,
+              std::vector<unsigned int>::const_iterator> range =
+        std::equal_range(table.keys.begin(), table.keys.end(), k);
+    for (std::vector<unsigned int>::const_iterator it = range.first;
+         it != range.second; ++it) {
+      int row = table.rows[it - table.keys.begin()];
+      if (scratch->visited[row] == scratch->stamp) {
+        continue;
+      }
+      scratch->visited[row] = scratch->stamp;
+      AddHammingCandidate(row,
+                          HammingDistance(query, &_dataset[row * _dimension],
+                                          _dimension),
+                          NN, size, indice, distance);
+    }
+  }
+
+  void search(const unsigned int * query, int NN, int * indice,
+              unsigned int * distance, Scratch * scratch) const {
+    if (++scratch->stamp == 0) {
+      std::fill(scratch->visited.begin(), scratch->visited.end(), 0);
+      scratch->stamp = 1;
+    }
+    int size = 0;
+    for (int t = 0; t < _nbTables; ++t) {
+      unsigned int k = key(t, query);
+      probe(_tables[t], k, query, NN, &size, indice, distance, scratch);
+      if (_multiProbe) {
+        for (int b = 0; b < _nbKeyBits; ++b) {
+          probe(_tables[t], k ^ (1u << b), query, NN, &size, indice, distance,
+                scratch);
+        }
+      }
+    }
+    if (size < NN) {
+      size = 0;
+      for (int j = 0; j < _nbRows; ++j) {
+        AddHammingCandidate(j,
+                            HammingDistance(query, &_dataset[j * _dimension],
+                                            _dimension),
+                            NN, &size, indice, distance);
+      }
+    }
+  }
+
+  int _nbTables;
+  int _nbKeyBits;
+  bool _multiProbe;
+  int _nbRows;
+  int _dimension;
+  std::vector<unsigned int> _dataset;
+  std::vector<int> _bits;
+  std::vector<Table> _tables;
+  // One per chunk of queries.
+  std::vector<Scratch> _scratch;
+};
+
+} // namespace correspondence
+} // namespace libmv
+
+#endif // LIBMV_CORRESPONDENCE_ARRAYMATCHER_LSH_HAMMING_H_
@@ -0,0 +1,130 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_CORRESPONDENCE_ARRAYMATCHER_QUANTIZED_H_
+#define LIBMV_CORRESPONDENCE_ARRAYMATCHER_QUANTIZED_H_
+
+#include "libmv/correspondence/ArrayMatcher.h"
+#include "libmv/correspondence/quantized_descriptors.h"
+
+namespace libmv {
+namespace correspondence  {
+
+/// Implement ArrayMatcher as a linear matcher over a copy of the dataset
+/// quantized to one byte per coordinate (see QuantizedDescriptors): it takes
+/// a quarter of the memory of ArrayMatcher_BruteForce and the distances are
+/// the asymmetric squared distances to the quantized arrays. The queries are
+/// split between SetNumThreads() threads.
+class ArrayMatcher_Quantized : public ArrayMatcher<float>
+{
+  public:
+  ArrayMatcher_Quantized() {}
+
+  ~ArrayMatcher_Quantized()  {}
+
+  /**
+   * Build the matching structure
+   *
+   * \param[in] dataset   Input data.
+   * \param[in] nbRows    The number of component.
+   * \param[in] dimension Length of the data contained in the each
+   *  row of the dataset.
+   *
+   * \return True if success.
+   */
+  bool build( const float * dataset, int nbRows, int dimension)  {
+    if (nbRows <= 0 || dimension <= 0) {
+      return false;
+    }
+    QuantizeDescriptors(dataset, nbRows, dimension, &_dataset);
+    return true;
+  }
+
+  /**
+   * Search the nearest Neighbour of the scalar array query.
+   *
+   * \param[in]   query     The query array
+   * \param[out]  indice    The indice of array in the dataset that
+   *  have been computed as the nearest array.
+   * \param[out]  distance  The distance between the two arrays.
+   *
+   * \return True if success.
+   */
+  bool searchNeighbour( const float * query, int * indice, float * distance)
+  {
+    if (_dataset.num_rows == 0) {
+      return false;
+    }
+    QuantizedKnn(_dataset, query, 1, 1, indice, distance);
+    return true;
+  }
+
+  /**
+   * Search the N nearest Neighbour of the scalar array query.
+   *
+   * \param[in]   query     The query array
+   * \param[in]   nbQuery   The number of query rows
+   * \param[out]  indice    The indices of arrays in the dataset that
+   *  have been computed as the nearest arrays.
+   * \param[out]  distance  The distances between the matched arrays.
+   *
+   * \return True if success.
+   */
+  bool searchNeighbours( const float * query, int nbQuery,
+    vector<int> * indice, vector<float> * distance, int NN)
+  {
+    if (_dataset.num_rows < NN || NN <= 0) {
+      return false;
+    }
+    indice->resize(nbQuery * NN);
+    distance->resize(nbQuery * NN);
+    if (nbQuery > 0) {
+      ChunkSearch search;
+      search.dataset = &_dataset;
+      search.query = query;
+      search.NN = NN;
+      search.indice = &(*indice)[0];
+      search.distance = &(*distance)[0];
+      SearchInChunks(nbQuery, numSearchChunks(nbQuery), &search);
+    }
+    return true;
+  }
+
+  private :
+  // Searches the queries [begin, end); the dataset is only read.
+  struct ChunkSearch {
+    void operator()(int, int begin, int end) const {
+      QuantizedKnn(*dataset, query + begin * dataset->dimension, end - begin,
+                   NN, indice + begin * NN, distance + begin * NN);
+    }
+    const QuantizedDescriptors *dataset;
+    const float *query;
+    int NN;
+    int *indice;
+    float *distance;
+  };
+
+  QuantizedDescriptors _dataset;
+};
+
+} // namespace correspondence
+} // namespace libmv
+
+#endif // LIBMV_CORRESPONDENCE_ARRAYMATCHER_QUANTIZED_H_
@@ -18,10 +18,14 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <vector>
+
 #include "libmv/correspondence/ArrayMatcher.h"
 #include "libmv/correspondence/ArrayMatcher_BruteForce.h"
+#include "libmv/correspondence/ArrayMatcher_CascadeHashing.h"
 #include "libmv/correspondence/ArrayMatcher_Kdtree_Flann.h"
 #include "libmv/correspondence/ArrayMatcher_Kdtree.h"
+#include "libmv/correspondence/ArrayMatcher_KdtreeForest.h"
 
 #include "libmv/correspondence/feature_matching.h"
 #include "libmv/logging/logging.h"
@@ -41,10 +45,14 @@ struct MatchingKernelTest : public testing::Test {
 // Test :
 // - Libmv Kdtree,
 // - Linear matching FLANN,
-// - FLANN Kdtree.
+// - FLANN Kdtree,
+// - Libmv randomized Kdtree forest,
+// - Cascade hashing.
 typedef Types< ArrayMatcher_Kdtree<float>,
                ArrayMatcher_BruteForce<float>,
-               ArrayMatcher_Kdtree_Flann<float>
+               ArrayMatcher_Kdtree_Flann<float>,
+               ArrayMatcher_KdtreeForest<float>,
+               ArrayMatcher_CascadeHashing<float>
                > MatchingKernelImpl;
 
 TYPED_TEST_CASE(MatchingKernelTest, MatchingKernelImpl);
@@ -182,5 +190,71 @@ TYPED_TEST(MatchingKernelTest, MatcherInterface)
   }
 }
 
+TYPED_TEST(MatchingKernelTest, ThreadedSearchMatchesSequential)
+{
+  // NN = 1, the libmv Kdtree searches only the nearest neighbour.
+  const int kNumRows = 500, kDimension = 16, kNN = 1;
+  std::vector<float> data(kNumRows * kDimension);
+  unsigned int seed = 7;
+  for (size_t i = 0; i < data.size(); ++i) {
+    seed = seed * 1103515245u + 12345u;
+    data[i] = ((seed >> 16) & 0x7fff) / 32768.0f;
+  }
+
+  TypeParam sequential, threaded;
+  threaded.SetNumThreads(4);
+  ASSERT_TRUE(sequential.build(&data[0], kNumRows, kDimension));
+  ASSERT_TRUE(threaded.build(&data[0], kNumRows, kDimension));
+
+  libmv::vector<int> indices, threadedIndices;
+  libmv::vector<float> distances, threadedDistances;
+  ASSERT_TRUE(sequential.searchNeighbours(&data[0], kNumRows,
+                                          &indices, &distances, kNN));
+  ASSERT_TRUE(threaded.searchNeighbours(&data[0], kNumRows,
+                                        &threadedIndices, &threadedDistances,
+                                        kNN));
+  ASSERT_EQ(indices.size(), threadedIndices.size());
+  ASSERT_EQ(distances.size(), threadedDistances.size());
+  for (size_t i = 0; i < indices.size(); ++i) {
+    EXPECT_EQ(indices[i], threadedIndices[i]);
+    EXPECT_EQ(distances[i], threadedDistances[i]);
+  }
+}
+
+TEST(ArrayMatcher_CascadeHashing, NearlyExactRecall) {
+  // Random descriptors, and the same ones with a little noise as queries.
+  const int kNumRows = 2000, kDimension = 64, kNN = 2;
+  std::vector<float> dataset(kNumRows * kDimension), queries(dataset.size());
+  unsigned int seed = 1;
+  for (size_t i = 0; i < dataset.size(); ++i) {
+    seed = seed * 1103515245u + 12345u;
+    dataset[i] = ((seed >> 16) & 0x7fff) / 32768.0f;
+    seed = seed * 1103515245u + 12345u;
+    queries[i] = dataset[i] +
+                 0.02f * (((seed >> 16) & 0x7fff) / 32768.0f - 0.5f);
+  }
+
+  ArrayMatcher_BruteForce<float> exact;
+  ArrayMatcher_CascadeHashing<float> hashing;
+  ASSERT_TRUE(exact.build(&dataset[0], kNumRows, kDimension));
+  ASSERT_TRUE(hashing.build(&dataset[0], kNumRows, kDimension));
+  libmv::vector<int> exact_indices, indices;
+  libmv::vector<float> exact_distances, distances;
+  ASSERT_TRUE(exact.searchNeighbours(&queries[0], kNumRows,
+                                     &exact_indices, &exact_distances, kNN));
+  ASSERT_TRUE(hashing.searchNeighbours(&queries[0], kNumRows,
+                                       &indices, &distances, kNN));
+  ASSERT_EQ(kNumRows * kNN, indices.size());
+
+  int num_found = 0;
+  for (int i = 0; i < kNumRows; ++i) {
+    EXPECT_LE(distances[i * kNN], distances[i * kNN + 1]);
+    if (indices[i * kNN] == exact_indices[i * kNN]) {
+      EXPECT_NEAR(exact_distances[i * kNN], distances[i * kNN], 1e-4);
+      ++num_found;
+    }
+  }
+  EXPECT_GT(num_found, 0.95 * kNumRows);
+}
 
 }  // namespace
@@ -21,9 +21,11 @@
 #ifndef LIBMV_CORRESPONDENCE_INT_BIPARTITE_GRAPH_H_
 #define LIBMV_CORRESPONDENCE_INT_BIPARTITE_GRAPH_H_
 
+#include <algorithm>
 #include <limits>
 #include <map>
 #include <set>
+#include <vector>
 #include <cassert>
 
 namespace libmv {
@@ -38,6 +40,35 @@ class BipartiteGraph {
     left_to_right_[std::make_pair(left, right)] = edge;
     right_to_left_[std::make_pair(right, left)] = edge;
   }
+  // Inserts the n edges (lefts[i], rights[i]) labelled edges[i], given sorted
+  // by left then right, with one hinted insertion per edge in each map: this
+  // takes amortized constant time per edge when the graph is empty or the
+  // new edges come after its edges. A later duplicate edge replaces an earlier
+  // one, as with Insert().
+  void InsertSorted(const T *lefts, const T *rights, const EdgeT *edges,
+                    int n) {
+    for (int i = 0; i < n; ++i) {
+      assert(i == 0 || lefts[i - 1] < lefts[i] ||
+             (lefts[i - 1] == lefts[i] && !(rights[i] < rights[i - 1])));
+      typename EdgeMap::iterator it = left_to_right_.insert(
+          left_to_right_.end(),
+          std::make_pair(std::make_pair(lefts[i], rights[i]), edges[i]));
+      it->second = edges[i];
+    }
+    // The reversed edges are inserted sorted by right then left.
+    std::vector<int> order(n);
+    for (int i = 0; i < n; ++i) {
+      order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), RightThenLeft(rights, lefts));
+    for (int i = 0; i < n; ++i) {
+      int k = order[i];
+      typename EdgeMap::iterator it = right_to_left_.insert(
+          right_to_left_.end(),
+          std::make_pair(std::make_pair(rights[k], lefts[k]), edges[k]));
+      it->second = edges[k];
+    }
+  }
   void Remove(const T &left, const T &right) {
     typename EdgeMap::iterator iter =
      left_to_right_.find(std::make_pair(left, right));
@@ -48,22 +79,20 @@ class BipartiteGraph {
       right_to_left_.erase(iter);
   }
   
-  int NumLeftLeft(T left) const { 
+  // O(log n + number of edges of left).
+  int NumLeftLeft(T left) const {
     int n = 0;
-    typename EdgeMap::const_iterator it;
-    for (it = left_to_right_.begin(); it != left_to_right_.end(); ++it) {
-      if (it->first.first == left)
-        n++;
+    for (Range r = ToLeft(left); r; ++r) {
+      n++;
     }
     return n;
   }
-  
-  int NumLeftRight(T right) const { 
+
+  // O(log n + number of edges of right).
+  int NumLeftRight(T right) const {
     int n = 0;
-    typename EdgeMap::const_iterator it;
-    for (it = left_to_right_.begin(); it != left_to_right_.end(); ++it) {
-      if (it->first.second == right)
-        n++;
+    for (Range r = ToRight(right); r; ++r) {
+      n++;
     }
     return n;
   }
@@ -124,6 +153,17 @@ class BipartiteGraph {
   }
 
  private:
+  struct RightThenLeft {
+    RightThenLeft(const T *rights, const T *lefts)
+        : rights_(rights), lefts_(lefts) {}
+    bool operator()(int a, int b) const {
+      return rights_[a] < rights_[b] ||
+             (rights_[a] == rights_[b] && lefts_[a] < lefts_[b]);
+    }
+    const T *rights_;
+    const T *lefts_;
+  };
+
   std::pair<T, T> Lower(T first) const {
     return std::make_pair(first, std::numeric_limits<T>::min());
   }
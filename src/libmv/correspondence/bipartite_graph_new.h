@@ -21,58 +21,125 @@
 #ifndef LIBMV_CORRESPONDENCE_BIPARTITE_GRAPH_NEW_H_
 #define LIBMV_CORRESPONDENCE_BIPARTITE_GRAPH_NEW_H_
 
+#include <algorithm>
 #include <map>
 #include <set>
+#include <utility>
+#include <vector>
 #include <cassert>
 
 namespace libmv {
 
-// A bipartite graph with labelled edges.
+// A bipartite graph with labelled edges. An edge label joins one pair of
+// nodes, and a pair of nodes is joined by at most one edge. The edges of a node
+// are kept in a vector sorted by the other node, so that deleting a node only
+// touches its edges and the adjacency of its neighbours. Nodes without edges
+// are removed.
 template<class LeftT, class EdgeT, class RightT>
 class BipartiteGraph {
  public:
   typedef std::pair<LeftT, RightT> LeftRight;
   typedef std::map<EdgeT, LeftRight> EdgeMap;
-  typedef std::map<LeftT,  std::map<RightT, EdgeT> > LeftToRightMap;
-  typedef std::map<RightT, std::map<LeftT,  EdgeT> > RightToLeftMap;
+  typedef std::vector<std::pair<RightT, EdgeT> > RightEdges;
+  typedef std::vector<std::pair<LeftT,  EdgeT> > LeftEdges;
+  typedef std::map<LeftT,  RightEdges> LeftToRightMap;
+  typedef std::map<RightT, LeftEdges>  RightToLeftMap;
   typedef BipartiteGraph<LeftT, EdgeT, RightT> GraphT;
 
   int NumEdges()      const { return edges_.size(); }
   int NumLeftNodes()  const { return left_to_right_.size(); }
   int NumRightNodes() const { return right_to_left_.size(); }
 
+  // Inserting an edge label again moves the edge to the new nodes, and an
+  // edge between connected nodes replaces their edge.
   void Insert(const LeftT left, const EdgeT edge, const RightT right) {
     // TODO(keir): Consider making non-unique edges illegal.
+    typename EdgeMap::iterator it = edges_.find(edge);
+    if (it != edges_.end()) {
+      if (it->second == LeftRight(left, right)) {
+        return;
+      }
+      DeleteEdge(it->second.first, it->second.second);
+    }
+    EdgeT old_edge;
+    if (GetEdge(left, right, &old_edge)) {
+      DeleteEdge(left, right);
+    }
     edges_[edge] = LeftRight(left, right);
-    left_to_right_[left][right] = edge;
-    right_to_left_[right][left] = edge;
+    InsertAdjacent(&left_to_right_[left], right, edge);
+    InsertAdjacent(&right_to_left_[right], left, edge);
   }
 
-  // Delete the edge connecting left and right.
+  // Delete the edge connecting left and right, if there is one.
   void DeleteEdge(const LeftT left, const RightT right) {
-    EdgeT edge;
-    assert(GetEdge(left, right, &edge));
-    edges_.erase(edge);
-    left_to_right_[left].erase(right);
-    right_to_left_[right].erase(left);
+    typename LeftToRightMap::iterator lt = left_to_right_.find(left);
+    if (lt == left_to_right_.end()) {
+      return;
+    }
+    typename RightEdges::iterator et = FindAdjacent(&lt->second, right);
+    if (et == lt->second.end()) {
+      return;
+    }
+    edges_.erase(et->second);
+    lt->second.erase(et);
+    if (lt->second.empty()) {
+      left_to_right_.erase(lt);
+    }
+    EraseAdjacent(&right_to_left_, right, left);
+  }
+
+  // Delete a node and its edges, in time proportional to the number of its
+  // edges and of the edges of its neighbours.
+  void DeleteLeft(const LeftT left) {
+    typename LeftToRightMap::iterator lt = left_to_right_.find(left);
+    if (lt == left_to_right_.end()) {
+      return;
+    }
+    const RightEdges &edges = lt->second;
+    for (int i = 0; i < edges.size(); ++i) {
+      edges_.erase(edges[i].second);
+      EraseAdjacent(&right_to_left_, edges[i].first, left);
+    }
+    left_to_right_.erase(lt);
+  }
+  void DeleteRight(const RightT right) {
+    typename RightToLeftMap::iterator rt = right_to_left_.find(right);
+    if (rt == right_to_left_.end()) {
+      return;
+    }
+    const LeftEdges &edges = rt->second;
+    for (int i = 0; i < edges.size(); ++i) {
+      edges_.erase(edges[i].second);
+      EraseAdjacent(&left_to_right_, edges[i].first, right);
+    }
+    right_to_left_.erase(rt);
   }
-  void DeleteRight(const RightT right) { assert(0); } // XXX
-  void DeleteLeft(const LeftT left) { assert(0); } // XXX
 
   bool GetEdge(const LeftT left, const RightT right, EdgeT *edge) const {
     typename LeftToRightMap::const_iterator lt = left_to_right_.find(left);
     if (lt == left_to_right_.end()) {
       return false;
     }
-    const std::map<RightT, EdgeT> &right_to_edge = lt->second;
-    const typename std::map<RightT, EdgeT>::const_iterator rt =
-        right_to_edge.find(right);
-    if (rt == right_to_edge.end()) {
+    const RightEdges &right_to_edge = lt->second;
+    typename RightEdges::const_iterator rt =
+        std::lower_bound(right_to_edge.begin(), right_to_edge.end(), right,
+                         NodeLess<RightT>());
+    if (rt == right_to_edge.end() || right < rt->first) {
       return false;
     }
     *edge = rt->second;
     return true;
   }
+
+  // The number of edges of a node.
+  int LeftDegree(const LeftT left) const {
+    typename LeftToRightMap::const_iterator lt = left_to_right_.find(left);
+    return lt == left_to_right_.end() ? 0 : lt->second.size();
+  }
+  int RightDegree(const RightT right) const {
+    typename RightToLeftMap::const_iterator rt = right_to_left_.find(right);
+    return rt == right_to_left_.end() ? 0 : rt->second.size();
+  }
   
   class LeftEdgeIterator;
   class RightEdgeIterator;
@@ -139,11 +206,10 @@ class BipartiteGraph {
       return iter_ != other.iter_;
     }
    private:
-    LeftEdgeIterator(LeftT left,
-                     typename std::map<RightT, EdgeT>::const_iterator iter)
+    LeftEdgeIterator(LeftT left, typename RightEdges::const_iterator iter)
         : left_(left), iter_(iter) {}
     LeftT left_;
-    typename std::map<RightT, EdgeT>::const_iterator iter_;
+    typename RightEdges::const_iterator iter_;
   };
 
   LeftIterator LeftBegin() const {
@@ -188,14 +254,57 @@ class BipartiteGraph {
       return iter_ != other.iter_;
     }
    private:
-    RightEdgeIterator(RightT right,
-                      typename std::map<LeftT, EdgeT>::const_iterator iter)
+    RightEdgeIterator(RightT right, typename LeftEdges::const_iterator iter)
         : right_(right), iter_(iter) {}
     RightT right_;
-    typename std::map<LeftT, EdgeT>::const_iterator iter_;
+    typename LeftEdges::const_iterator iter_;
   };
 
  private:
+  // Orders the edges of a node by their other node.
+  template<typename NodeT>
+  struct NodeLess {
+    bool operator()(const std::pair<NodeT, EdgeT> &a, const NodeT &b) const {
+      return a.first < b;
+    }
+  };
+
+  template<typename NodeT>
+  static typename std::vector<std::pair<NodeT, EdgeT> >::iterator
+  FindAdjacent(std::vector<std::pair<NodeT, EdgeT> > *edges,
+               const NodeT &node) {
+    typename std::vector<std::pair<NodeT, EdgeT> >::iterator it =
+        std::lower_bound(edges->begin(), edges->end(), node, NodeLess<NodeT>());
+    if (it != edges->end() && node < it->first) {
+      return edges->end();
+    }
+    return it;
+  }
+
+  template<typename NodeT>
+  static void InsertAdjacent(std::vector<std::pair<NodeT, EdgeT> > *edges,
+                             const NodeT &node, const EdgeT &edge) {
+    edges->insert(std::lower_bound(edges->begin(), edges->end(), node,
+                                   NodeLess<NodeT>()),
+                  std::make_pair(node, edge));
+  }
+
+  // Removes other from the edges of node in the adjacency map, and node if it
+  // has no edges left.
+  template<typename AdjacencyMap, typename NodeT, typename OtherT>
+  static void EraseAdjacent(AdjacencyMap *adjacency, const NodeT &node,
+                            const OtherT &other) {
+    typename AdjacencyMap::iterator it = adjacency->find(node);
+    assert(it != adjacency->end());
+    typename AdjacencyMap::mapped_type::iterator et =
+        FindAdjacent(&it->second, other);
+    assert(et != it->second.end());
+    it->second.erase(et);
+    if (it->second.empty()) {
+      adjacency->erase(it);
+    }
+  }
+
   EdgeMap edges_;
   LeftToRightMap left_to_right_;
   RightToLeftMap right_to_left_;
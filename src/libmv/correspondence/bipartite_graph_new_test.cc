@@ -160,4 +160,77 @@ TEST(BipartiteGraph, LeftRightEdgeIterators) {
   EXPECT_EQ(i, 15);
 }
 
+TEST(BipartiteGraph, DeleteEdge) {
+  BipartiteGraph<int, int, int> x;
+  x.Insert(1, 10, 2);
+  x.Insert(1, 30, 4);
+  x.DeleteEdge(1, 2);
+  x.DeleteEdge(1, 7);
+  int edge;
+  EXPECT_FALSE(x.GetEdge(1, 2, &edge));
+  EXPECT_TRUE(x.GetEdge(1, 4, &edge)); EXPECT_EQ(30, edge);
+  EXPECT_EQ(1, x.NumEdges());
+  EXPECT_EQ(1, x.NumLeftNodes());
+  EXPECT_EQ(1, x.NumRightNodes());
+
+  // Nodes without edges are removed.
+  x.DeleteEdge(1, 4);
+  EXPECT_EQ(0, x.NumEdges());
+  EXPECT_EQ(0, x.NumLeftNodes());
+  EXPECT_EQ(0, x.NumRightNodes());
+}
+
+TEST(BipartiteGraph, DeleteLeftAndRight) {
+  BipartiteGraph<int, int, int> x;
+  x.Insert(1, 10, 2);
+  x.Insert(1, 30, 4);
+  x.Insert(1, 40, 5);
+  x.Insert(2, 20, 5);
+  x.Insert(5, 50, 5);
+  x.Insert(5, 60, 4);
+  EXPECT_EQ(3, x.LeftDegree(1));
+  EXPECT_EQ(3, x.RightDegree(5));
+
+  x.DeleteLeft(1);
+  EXPECT_EQ(3, x.NumEdges());
+  EXPECT_EQ(2, x.NumLeftNodes());
+  // Right node 2 only had an edge to left node 1.
+  EXPECT_EQ(2, x.NumRightNodes());
+  EXPECT_EQ(0, x.LeftDegree(1));
+  EXPECT_EQ(0, x.RightDegree(2));
+  EXPECT_EQ(2, x.RightDegree(5));
+  EXPECT_EQ(1, x.RightDegree(4));
+  int edge;
+  EXPECT_FALSE(x.GetEdge(1, 5, &edge));
+  EXPECT_TRUE(x.GetEdge(5, 4, &edge)); EXPECT_EQ(60, edge);
+
+  x.DeleteRight(5);
+  x.DeleteRight(9);
+  EXPECT_EQ(1, x.NumEdges());
+  EXPECT_EQ(1, x.NumLeftNodes());
+  EXPECT_EQ(1, x.NumRightNodes());
+  EXPECT_EQ(60, x.EdgesBegin().edge());
+  EXPECT_EQ(1, x.LeftDegree(5));
+  EXPECT_EQ(0, x.LeftDegree(2));
+}
+
+TEST(BipartiteGraph, ReinsertedEdgesMove) {
+  BipartiteGraph<int, int, int> x;
+  x.Insert(1, 3, 2);
+  x.Insert(4, 3, 1);
+  int edge;
+  EXPECT_FALSE(x.GetEdge(1, 2, &edge));
+  EXPECT_TRUE(x.GetEdge(4, 1, &edge)); EXPECT_EQ(3, edge);
+  EXPECT_EQ(1, x.NumLeftNodes());
+  EXPECT_EQ(1, x.NumRightNodes());
+
+  // A new edge between connected nodes replaces the old one.
+  x.Insert(4, 7, 1);
+  EXPECT_EQ(1, x.NumEdges());
+  EXPECT_TRUE(x.GetEdge(4, 1, &edge)); EXPECT_EQ(7, edge);
+  x.DeleteLeft(4);
+  EXPECT_EQ(0, x.NumEdges());
+  EXPECT_EQ(0, x.NumRightNodes());
+}
+
 }  // namespace
@@ -135,4 +135,34 @@ TEST(BipartiteGraph, ScanEdgesForLeftNode) {
   CheckIteratorOutput(x.ToLeft(2), kExpected);
 }
 
+TEST(BipartiteGraph, InsertSortedMatchesInsert) {
+  const int lefts[] = { 1, 1, 1, 2, 2 };
+  const int rights[] = { 2, 4, 4, 1, 2 };
+  const char edges[] = { 'a', 'b', 'c', 'd', 'e' };
+  TestGraph x, y;
+  x.Insert(0, 3, 'z');
+  y.Insert(0, 3, 'z');
+  x.InsertSorted(lefts, rights, edges, 5);
+  for (int i = 0; i < 5; ++i) {
+    y.Insert(lefts[i], rights[i], edges[i]);
+  }
+  // The later duplicate wins.
+  EXPECT_EQ('c', *x.Edge(1, 4));
+
+  TestGraph::Range rx = x.All(), ry = y.All();
+  for (; rx && ry; ++rx, ++ry) {
+    EXPECT_EQ(ry.left(), rx.left());
+    EXPECT_EQ(ry.right(), rx.right());
+    EXPECT_EQ(ry.edge(), rx.edge());
+  }
+  EXPECT_FALSE(rx || ry);
+  rx = x.ToLeft(2);
+  ry = y.ToLeft(2);
+  for (; rx && ry; ++rx, ++ry) {
+    EXPECT_EQ(ry.left(), rx.left());
+    EXPECT_EQ(ry.edge(), rx.edge());
+  }
+  EXPECT_FALSE(rx || ry);
+}
+
 }  // namespace
@@ -0,0 +1,327 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "libmv/base/thread.h"
+#include "libmv/correspondence/brute_force_matching.h"
+
+namespace libmv {
+namespace {
+
+// Number of queries compared at once with each dataset row: every dataset
+// value loaded is used four times.
+const int kQueryBlock = 4;
+
+// Number of dataset rows compared with all the queries before moving to the
+// next ones; 512 SIFT descriptors (256 KB) stay in the L2 cache.
+const int kDataBlock = 512;
+
+#ifdef __SSE2__
+inline float HorizontalSum(__m128 v) {
+  float s[4];
+  _mm_storeu_ps(s, v);
+  return (s[0] + s[1]) + (s[2] + s[3]);
+}
+#endif
+
+// Dot products of row with the four queries q[0..3].
+void DotFour(const float *row, const float *const *q, int num_dims,
+             float *dots) {
+  int i = 0;
+#ifdef __SSE2__
+  __m128 acc0 = _mm_setzero_ps();
+  __m128 acc1 = _mm_setzero_ps();
+  __m128 acc2 = _mm_setzero_ps();
+  __m128 acc3 = _mm_setzero_ps();
+  for (; i + 4 <= num_dims; i += 4) {
+    __m128 r = _mm_loadu_ps(row + i);
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(r, _mm_loadu_ps(q[0] + i)));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(r, _mm_loadu_ps(q[1] + i)));
+    acc2 = _mm_add_ps(acc2, _mm_mul_ps(r, _mm_loadu_ps(q[2] + i)));
+    acc3 = _mm_add_ps(acc3, _mm_mul_ps(r, _mm_loadu_ps(q[3] + i)));
+  }
+  dots[0] = HorizontalSum(acc0);
+  dots[1] = HorizontalSum(acc1);
+  dots[2] = HorizontalSum(acc2);
+  dots[3] = HorizontalSum(acc3);
+#else
+  dots[0] = dots[1] = dots[2] = dots[3] = 0;
+#endif
+  for (; i < num_dims; ++i) {
+    dots[0] += row[i] * q[0][i];
+    dots[1] += row[i] * q[1][i];
+    dots[2] += row[i] * q[2][i];
+    dots[3] += row[i] * q[3][i];
+  }
+}
+
+// Inserts a candidate into the sorted list of the k best ones.
+inline void AddCandidate(int id, float distance, int k,
+                         int *ids, float *distances) {
+  if (distance >= distances[k - 1]) {
+    return;
+  }
+  int i = k - 1;
+  for (; i > 0 && distances[i - 1] > distance; --i) {
+    ids[i] = ids[i - 1];
+    distances[i] = distances[i - 1];
+  }
+  ids[i] = id;
+  distances[i] = distance;
+}
+
+}  // namespace
+
+void SquaredRowNorms(const float *rows, int num_rows, int num_dims,
+                     float *norms) {
+  for (int r = 0; r < num_rows; ++r) {
+    const float *row = rows + r * num_dims;
+    const float *q[4] = { row, row, row, row };
+    float dots[4];
+    DotFour(row, q, num_dims, dots);
+    norms[r] = dots[0];
+  }
+}
+
+void BruteForceKnn(const float *dataset, const float *dataset_norms,
+                   int num_data,
+                   const float *queries, int num_queries,
+                   int num_dims, int k,
+                   int *ids, float *distances) {
+  for (int i = 0; i < num_queries * k; ++i) {
+    ids[i] = -1;
+    distances[i] = std::numeric_limits<float>::max();
+  }
+  if (num_queries == 0) {
+    return;
+  }
+  std::vector<float> query_norms(num_queries);
+  SquaredRowNorms(queries, num_queries, num_dims, &query_norms[0]);
+
+  for (int d0 = 0; d0 < num_data; d0 += kDataBlock) {
+    int d1 = std::min(num_data, d0 + kDataBlock);
+    for (int q0 = 0; q0 < num_queries; q0 += kQueryBlock) {
+      // Pad the last block by repeating its first query.
+      int block_size = std::min(kQueryBlock, num_queries - q0);
+      const float *q[kQueryBlock];
+      for (int j = 0; j < kQueryBlock; ++j) {
+        q[j] = queries + (q0 + (j < block_size ? j : 0)) * num_dims;
+      }
+      for (int d = d0; d < d1; ++d) {
+        float dots[kQueryBlock];
+        DotFour(dataset + d * num_dims, q, num_dims, dots);
+        for (int j = 0; j < block_size; ++j) {
+          // Rounding can make the distance of nearly equal rows negative.
+          float distance = std::max(0.0f, query_norms[q0 + j]
+                                          + dataset_norms[d] - 2 * dots[j]);
+          int offset = (q0 + j) * k;
+          AddCandidate(d, distance, k, ids + offset, distances + offset);
+        }
+      }
+    }
+  }
+}
+
+namespace {
+
+// Searches the queries of chunk c for ParallelFor.
+struct KnnChunks {
+  void operator()(int c) {
+    int begin = c * chunk_size;
+    int end = std::min(num_queries, begin + chunk_size);
+    if (begin < end) {
+      BruteForceKnn(dataset, dataset_norms, num_data,
+                    queries + begin * num_dims, end - begin,
+                    num_dims, k, ids + begin * k, distances + begin * k);
+    }
+  }
+
+  const float *dataset;
+  const float *dataset_norms;
+  int num_data;
+  const float *queries;
+  int num_queries;
+  int num_dims;
+  int k;
+  int *ids;
+  float *distances;
+  int chunk_size;
+};
+
+// The mutual search of the left rows [begin, end) of a chunk, whose column
+// minima are kept apart until the chunks are merged.
+struct MutualChunks {
+  void operator()(int c) {
+    int begin = c * chunk_size;
+    int end = std::min(num_left, begin + chunk_size);
+    int *ids = column_ids + c * num_right;
+    float *distances = column_distances + c * num_right;
+    std::fill(ids, ids + num_right, -1);
+    std::fill(distances, distances + num_right,
+              std::numeric_limits<float>::max());
+    for (int i = begin; i < end; ++i) {
+      left_ids[i] = -1;
+      left_distances[i] = std::numeric_limits<float>::max();
+    }
+
+    for (int d0 = 0; d0 < num_right; d0 += kDataBlock) {
+      int d1 = std::min(num_right, d0 + kDataBlock);
+      for (int q0 = begin; q0 < end; q0 += kQueryBlock) {
+        int block_size = std::min(kQueryBlock, end - q0);
+        const float *q[kQueryBlock];
+        for (int j = 0; j < kQueryBlock; ++j) {
+          q[j] = left + (q0 + (j < block_size ? j : 0)) * num_dims;
+        }
+        for (int d = d0; d < d1; ++d) {
+          float dots[kQueryBlock];
+          DotFour(right + d * num_dims, q, num_dims, dots);
+          for (int j = 0; j < block_size; ++j) {
+            float distance = std::max(0.0f, left_norms[q0 + j]
+                                            + right_norms[d] - 2 * dots[j]);
+            // Strict comparisons keep the first of equal candidates, as
+            // AddCandidate() does.
+            if (distance < left_distances[q0 + j]) {
+              left_ids[q0 + j] = d;
+              left_distances[q0 + j] = distance;
+            }
+            if (distance < distances[d]) {
+              ids[d] = q0 + j;
+              distances[d] = distance;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  const float *left;
+  const float *left_norms;
+  int num_left;
+  const float *right;
+  const float *right_norms;
+  int num_right;
+  int num_dims;
+  int *left_ids;
+  float *left_distances;
+  // The column minima of every chunk, num_right per chunk.
+  int *column_ids;
+  float *column_distances;
+  int chunk_size;
+};
+
+}  // namespace
+
+void BruteForceKnnParallel(const float *dataset, const float *dataset_norms,
+                           int num_data,
+                           const float *queries, int num_queries,
+                           int num_dims, int k,
+                           int *ids, float *distances,
+                           int num_threads) {
+  if (num_threads <= 1 || num_queries <= kQueryBlock) {
+    BruteForceKnn(dataset, dataset_norms, num_data, queries, num_queries,
+                  num_dims, k, ids, distances);
+    return;
+  }
+  // Whole query blocks per chunk, so that only the last one is padded.
+  int num_blocks = (num_queries + kQueryBlock - 1) / kQueryBlock;
+  int num_chunks = std::min(num_threads, num_blocks);
+  KnnChunks chunks;
+  chunks.dataset = dataset;
+  chunks.dataset_norms = dataset_norms;
+  chunks.num_data = num_data;
+  chunks.queries = queries;
+  chunks.num_queries = num_queries;
+  chunks.num_dims = num_dims;
+  chunks.k = k;
+  chunks.ids = ids;
+  chunks.distances = distances;
+  chunks.chunk_size =
+      kQueryBlock * ((num_blocks + num_chunks - 1) / num_chunks);
+  ParallelFor(0, num_chunks, num_chunks, &chunks);
+}
+
+void BruteForceMutualNearestNeighbors(const float *left, int num_left,
+                                      const float *right, int num_right,
+                                      int num_dims,
+                                      int *left_ids, float *left_distances,
+                                      int *right_ids, float *right_distances,
+                                      int num_threads) {
+  if (num_left == 0 || num_right == 0) {
+    std::fill(left_ids, left_ids + num_left, -1);
+    std::fill(left_distances, left_distances + num_left,
+              std::numeric_limits<float>::max());
+    std::fill(right_ids, right_ids + num_right, -1);
+    std::fill(right_distances, right_distances + num_right,
+              std::numeric_limits<float>::max());
+    return;
+  }
+  std::vector<float> left_norms(num_left), right_norms(num_right);
+  SquaredRowNorms(left, num_left, num_dims, &left_norms[0]);
+  SquaredRowNorms(right, num_right, num_dims, &right_norms[0]);
+
+  // Whole query blocks per chunk, as in BruteForceKnnParallel().
+  int num_blocks = (num_left + kQueryBlock - 1) / kQueryBlock;
+  int num_chunks = std::max(1, std::min(num_threads, num_blocks));
+  MutualChunks chunks;
+  chunks.left = left;
+  chunks.left_norms = &left_norms[0];
+  chunks.num_left = num_left;
+  chunks.right = right;
+  chunks.right_norms = &right_norms[0];
+  chunks.num_right = num_right;
+  chunks.num_dims = num_dims;
+  chunks.left_ids = left_ids;
+  chunks.left_distances = left_distances;
+  chunks.chunk_size =
+      kQueryBlock * ((num_blocks + num_chunks - 1) / num_chunks);
+  if (num_chunks == 1) {
+    chunks.column_ids = right_ids;
+    chunks.column_distances = right_distances;
+    chunks(0);
+    return;
+  }
+  std::vector<int> column_ids(num_chunks * num_right);
+  std::vector<float> column_distances(num_chunks * num_right);
+  chunks.column_ids = &column_ids[0];
+  chunks.column_distances = &column_distances[0];
+  ParallelFor(0, num_chunks, num_chunks, &chunks);
+
+  // The earlier chunks have the smaller left rows, and win ties.
+  std::copy(column_ids.begin(), column_ids.begin() + num_right, right_ids);
+  std::copy(column_distances.begin(), column_distances.begin() + num_right,
+            right_distances);
+  for (int c = 1; c < num_chunks; ++c) {
+    for (int d = 0; d < num_right; ++d) {
+      if (column_distances[c * num_right + d] < right_distances[d]) {
+        right_ids[d] = column_ids[c * num_right + d];
+        right_distances[d] = column_distances[c * num_right + d];
+      }
+    }
+  }
+}
+
+}  // namespace libmv
@@ -0,0 +1,79 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_CORRESPONDENCE_BRUTE_FORCE_MATCHING_H_
+#define LIBMV_CORRESPONDENCE_BRUTE_FORCE_MATCHING_H_
+
+namespace libmv {
+
+// Computes the squared L2 norm of each of the num_rows rows of num_dims floats.
+void SquaredRowNorms(const float *rows, int num_rows, int num_dims,
+                     float *norms);
+
+// Finds the k nearest rows of dataset for each row of queries, by exhaustive
+// search. The squared distances are computed as |q|^2 + |d|^2 - 2 q.d, a
+// block of queries against a block of the dataset at a time, like a matrix
+// product, and the k best candidates of every query are kept while the
+// distances are produced; k = 2 gives the two nearest neighbors needed by the
+// ratio test in a single pass.
+//
+// dataset_norms are the squared norms of the dataset rows, as computed by
+// SquaredRowNorms(). The neighbors of query i are written closest first in
+// ids[i * k, (i + 1) * k) and their squared distances in distances; missing
+// neighbors (k > num_data) get an id of -1.
+void BruteForceKnn(const float *dataset, const float *dataset_norms,
+                   int num_data,
+                   const float *queries, int num_queries,
+                   int num_dims, int k,
+                   int *ids, float *distances);
+
+// Same as BruteForceKnn(), with the queries split in num_threads contiguous
+// chunks searched concurrently. Every query is searched the same way whatever
+// the split, so the results do not depend on the number of threads.
+void BruteForceKnnParallel(const float *dataset, const float *dataset_norms,
+                           int num_data,
+                           const float *queries, int num_queries,
+                           int num_dims, int k,
+                           int *ids, float *distances,
+                           int num_threads);
+
+// Finds the nearest right row of every left row and the nearest left row of
+// every right row in a single pass over the distances, instead of two
+// BruteForceKnn() searches: the distances are computed block-wise as in
+// BruteForceKnn(), once, and the minima of the rows and of the columns of the
+// distance matrix are updated together. left_ids[i] is the nearest right row
+// of left row i and right_ids[j] the nearest left row of right row j, with
+// their squared distances; (i, left_ids[i]) is a mutual nearest neighbor pair
+// if right_ids[left_ids[i]] == i. The distances are the same, and ties are
+// broken the same way, as with two BruteForceKnn() searches with k = 1.
+//
+// The left rows are split in num_threads contiguous chunks searched
+// concurrently; the column minima of the chunks are merged in order, so the
+// results do not depend on the number of threads.
+void BruteForceMutualNearestNeighbors(const float *left, int num_left,
+                                      const float *right, int num_right,
+                                      int num_dims,
+                                      int *left_ids, float *left_distances,
+                                      int *right_ids, float *right_distances,
+                                      int num_threads);
+
+}  // namespace libmv
+
+#endif  // LIBMV_CORRESPONDENCE_BRUTE_FORCE_MATCHING_H_
@@ -0,0 +1,178 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "libmv/correspondence/ArrayMatcher_BruteForce.h"
+#include "libmv/correspondence/brute_force_matching.h"
+#include "testing/testing.h"
+
+namespace {
+
+using namespace libmv;
+
+void RandomRows(int num_rows, int num_dims, unsigned seed,
+                std::vector<float> *rows) {
+  rows->resize(num_rows * num_dims);
+  for (int i = 0; i < num_rows * num_dims; ++i) {
+    seed = seed * 1103515245u + 12345u;
+    (*rows)[i] = ((seed >> 16) & 0x7fff) / 32768.0f;
+  }
+}
+
+TEST(BruteForceKnn, MatchesNaiveSearch) {
+  // Sizes that are neither multiples of the SIMD width nor of the blocks.
+  const int kNumData = 1100, kNumQueries = 37, kNumDims = 21, kK = 2;
+  std::vector<float> dataset, queries, norms(kNumData);
+  RandomRows(kNumData, kNumDims, 1, &dataset);
+  RandomRows(kNumQueries, kNumDims, 2, &queries);
+  SquaredRowNorms(&dataset[0], kNumData, kNumDims, &norms[0]);
+
+  std::vector<int> ids(kNumQueries * kK);
+  std::vector<float> distances(kNumQueries * kK);
+  BruteForceKnn(&dataset[0], &norms[0], kNumData, &queries[0], kNumQueries,
+                kNumDims, kK, &ids[0], &distances[0]);
+
+  for (int q = 0; q < kNumQueries; ++q) {
+    std::vector<std::pair<double, int> > sorted;
+    for (int d = 0; d < kNumData; ++d) {
+      double distance = 0;
+      for (int i = 0; i < kNumDims; ++i) {
+        double diff = queries[q * kNumDims + i] - dataset[d * kNumDims + i];
+        distance += diff * diff;
+      }
+      sorted.push_back(std::make_pair(distance, d));
+    }
+    std::sort(sorted.begin(), sorted.end());
+    for (int i = 0; i < kK; ++i) {
+      EXPECT_EQ(sorted[i].second, ids[q * kK + i]);
+      EXPECT_NEAR(sorted[i].first, distances[q * kK + i], 1e-4);
+    }
+  }
+}
+
+TEST(BruteForceKnn, ParallelGivesTheSameNeighbors) {
+  const int kNumData = 700, kNumQueries = 53, kNumDims = 64, kK = 2;
+  std::vector<float> dataset, queries, norms(kNumData);
+  RandomRows(kNumData, kNumDims, 3, &dataset);
+  RandomRows(kNumQueries, kNumDims, 4, &queries);
+  SquaredRowNorms(&dataset[0], kNumData, kNumDims, &norms[0]);
+
+  std::vector<int> ids(kNumQueries * kK);
+  std::vector<float> distances(kNumQueries * kK);
+  BruteForceKnn(&dataset[0], &norms[0], kNumData, &queries[0], kNumQueries,
+                kNumDims, kK, &ids[0], &distances[0]);
+  for (int num_threads = 2; num_threads <= 5; ++num_threads) {
+    std::vector<int> parallel_ids(kNumQueries * kK);
+    std::vector<float> parallel_distances(kNumQueries * kK);
+    BruteForceKnnParallel(&dataset[0], &norms[0], kNumData,
+                          &queries[0], kNumQueries, kNumDims, kK,
+                          &parallel_ids[0], &parallel_distances[0],
+                          num_threads);
+    EXPECT_TRUE(ids == parallel_ids);
+    EXPECT_TRUE(distances == parallel_distances);
+  }
+}
+
+TEST(BruteForceMutualNearestNeighbors, SameAsTwoSearches) {
+  const int kNumLeft = 601, kNumRight = 530, kNumDims = 20;
+  std::vector<float> left, right, left_norms(kNumLeft), right_norms(kNumRight);
+  RandomRows(kNumLeft, kNumDims, 7, &left);
+  RandomRows(kNumRight, kNumDims, 8, &right);
+  // Duplicated rows make ties.
+  std::copy(left.begin(), left.begin() + kNumDims, left.begin() + kNumDims);
+  std::copy(left.begin(), left.begin() + kNumDims, right.begin());
+  SquaredRowNorms(&left[0], kNumLeft, kNumDims, &left_norms[0]);
+  SquaredRowNorms(&right[0], kNumRight, kNumDims, &right_norms[0]);
+
+  std::vector<int> forward_ids(kNumLeft), reverse_ids(kNumRight);
+  std::vector<float> forward_distances(kNumLeft);
+  std::vector<float> reverse_distances(kNumRight);
+  BruteForceKnn(&right[0], &right_norms[0], kNumRight, &left[0], kNumLeft,
+                kNumDims, 1, &forward_ids[0], &forward_distances[0]);
+  BruteForceKnn(&left[0], &left_norms[0], kNumLeft, &right[0], kNumRight,
+                kNumDims, 1, &reverse_ids[0], &reverse_distances[0]);
+  EXPECT_EQ(0, reverse_ids[0]);
+
+  for (int num_threads = 1; num_threads <= 4; ++num_threads) {
+    std::vector<int> left_ids(kNumLeft), right_ids(kNumRight);
+    std::vector<float> left_distances(kNumLeft), right_distances(kNumRight);
+    BruteForceMutualNearestNeighbors(&left[0], kNumLeft, &right[0], kNumRight,
+                                     kNumDims,
+                                     &left_ids[0], &left_distances[0],
+                                     &right_ids[0], &right_distances[0],
+                                     num_threads);
+    EXPECT_TRUE(forward_ids == left_ids);
+    EXPECT_TRUE(forward_distances == left_distances);
+    EXPECT_TRUE(reverse_ids == right_ids);
+    EXPECT_TRUE(reverse_distances == right_distances);
+  }
+}
+
+TEST(ArrayMatcher_BruteForce, BatchIsTheConcatenation) {
+  const int kNumData = 300, kNumDims = 16;
+  const int kSizes[] = { 13, 0, 40 };
+  std::vector<float> dataset, all_queries;
+  RandomRows(kNumData, kNumDims, 5, &dataset);
+  RandomRows(53, kNumDims, 6, &all_queries);
+
+  correspondence::ArrayMatcher_BruteForce<float> matcher;
+  matcher.SetNumThreads(3);
+  ASSERT_TRUE(matcher.build(&dataset[0], kNumData, kNumDims));
+  std::vector<const float *> queries;
+  std::vector<int> sizes;
+  for (int i = 0, offset = 0; i < 3; offset += kSizes[i] * kNumDims, ++i) {
+    queries.push_back(&all_queries[offset]);
+    sizes.push_back(kSizes[i]);
+  }
+  libmv::vector<int> ids, batch_ids;
+  libmv::vector<float> distances, batch_distances;
+  ASSERT_TRUE(matcher.searchNeighbours(&all_queries[0], 53,
+                                       &ids, &distances, 2));
+  ASSERT_TRUE(matcher.searchNeighboursBatch(queries, sizes,
+                                            &batch_ids, &batch_distances, 2));
+  ASSERT_EQ(ids.size(), batch_ids.size());
+  for (int i = 0; i < ids.size(); ++i) {
+    EXPECT_EQ(ids[i], batch_ids[i]);
+    EXPECT_EQ(distances[i], batch_distances[i]);
+  }
+}
+
+TEST(BruteForceKnn, MoreNeighborsThanData) {
+  float dataset[] = { 0, 0,
+                      3, 4 };
+  float norms[2];
+  SquaredRowNorms(dataset, 2, 2, norms);
+  EXPECT_EQ(25, norms[1]);
+
+  float query[] = { 3, 4 };
+  int ids[3];
+  float distances[3];
+  BruteForceKnn(dataset, norms, 2, query, 1, 2, 3, ids, distances);
+  EXPECT_EQ(1, ids[0]);
+  EXPECT_EQ(0, distances[0]);
+  EXPECT_EQ(0, ids[1]);
+  EXPECT_EQ(25, distances[1]);
+  EXPECT_EQ(-1, ids[2]);
+}
+
+}  // namespace
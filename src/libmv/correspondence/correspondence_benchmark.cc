@@ -0,0 +1,170 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "libmv/correspondence/feature_matching.h"
+#include "libmv/correspondence/klt.h"
+#include "libmv/correspondence/matches.h"
+#include "libmv/image/image.h"
+#include "libmv/image/image_io.h"
+#include "libmv/image/image_pyramid.h"
+#include "libmv/image/sample.h"
+#include "libmv/logging/logging.h"
+#include "testing/benchmark.h"
+
+namespace {
+
+using namespace libmv;
+using libmv::benchmark::DoNotOptimize;
+using libmv::benchmark::State;
+
+// Lenna, and Lenna translated by a fraction of a pixel.
+void ReadLennaPair(FloatImage *image1, FloatImage *image2) {
+  CHECK(ReadImage(THIS_SOURCE_DIR "/klt_test/Lenna.pgm", image1));
+  image2->Resize(image1->Height(), image1->Width());
+  for (int y = 0; y < image1->Height(); ++y) {
+    for (int x = 0; x < image1->Width(); ++x) {
+      float y1 = std::min(y + 0.6f, image1->Height() - 1.0f);
+      float x1 = std::max(x - 0.3f, 0.0f);
+      (*image2)(y, x) = SampleLinear(*image1, y1, x1);
+    }
+  }
+}
+
+BENCHMARK(BM_KLTDetectGoodFeatures) {
+  FloatImage image1, image2;
+  ReadLennaPair(&image1, &image2);
+  ImagePyramid *pyramid = MakeImagePyramid(image1, 1, 0.9);
+  KLTContext klt;
+  state->ResetTiming();
+  double num_features = 0;
+  for (int i = 0; i < state->iterations(); ++i) {
+    KLTContext::FeatureList features;
+    klt.DetectGoodFeatures(pyramid->Level(0), &features);
+    num_features += features.size();
+    state->PauseTiming();
+    for (KLTContext::FeatureList::iterator it = features.begin();
+         it != features.end(); ++it) {
+      delete *it;
+    }
+    state->ResumeTiming();
+  }
+  state->SetItemsProcessed(state->iterations() *
+                           double(image1.Height() * image1.Width()));
+  DoNotOptimize(num_features);
+  delete pyramid;
+}
+
+// Tracks the good features of Lenna into its translated copy; the items are
+// the features.
+void TrackLenna(int num_threads, State *state) {
+  FloatImage image1, image2;
+  ReadLennaPair(&image1, &image2);
+  ImagePyramid *pyramid1 = MakeImagePyramid(image1, 3, 0.9);
+  ImagePyramid *pyramid2 = MakeImagePyramid(image2, 3, 0.9);
+
+  KLTContext klt;
+  klt.SetNumThreads(num_threads);
+  KLTContext::FeatureList detected;
+  klt.DetectGoodFeatures(pyramid1->Level(0), &detected);
+  KLTContext::FeatureArray features1, features2;
+  for (KLTContext::FeatureList::iterator it = detected.begin();
+       it != detected.end(); ++it) {
+    features1.push_back(**it);
+    delete *it;
+  }
+
+  state->ResetTiming();
+  int num_tracked = 0;
+  for (int i = 0; i < state->iterations(); ++i) {
+    num_tracked += klt.TrackFeatures(pyramid1, features1, pyramid2,
+                                     &features2);
+  }
+  state->SetItemsProcessed(state->iterations() * double(features1.size()));
+  DoNotOptimize(num_tracked);
+  delete pyramid1;
+  delete pyramid2;
+}
+
+BENCHMARK(BM_KLTTrackFeatures) {
+  TrackLenna(1, state);
+}
+
+BENCHMARK(BM_KLTTrackFeaturesParallel) {
+  TrackLenna(NumThreads(), state);
+}
+
+// Random descriptors, as SIFT or SURF give, and the same features in reverse
+// order with a little noise on their descriptors.
+void MakeDescriptorSets(int num_features, int dimension,
+                        FeatureSet *left, FeatureSet *right) {
+  srand(1);
+  left->features.resize(num_features);
+  right->features.resize(num_features);
+  for (int i = 0; i < num_features; ++i) {
+    KeypointFeature &a = left->features[i];
+    KeypointFeature &b = right->features[num_features - 1 - i];
+    a.coords << i, 0;
+    b.coords << i, 1;
+    a.descriptor.coords.resize(dimension);
+    b.descriptor.coords.resize(dimension);
+    for (int k = 0; k < dimension; ++k) {
+      a.descriptor.coords(k) = rand() / float(RAND_MAX);
+      b.descriptor.coords(k) = a.descriptor.coords(k) +
+                               0.01f * (rand() / float(RAND_MAX) - 0.5f);
+    }
+  }
+}
+
+// The items are the features of both sets.
+void MatchDescriptors(eLibmvMatchMethod method, State *state) {
+  const int kNumFeatures = 1000;
+  FeatureSet left, right;
+  MakeDescriptorSets(kNumFeatures, 64, &left, &right);
+  state->ResetTiming();
+  int num_matches = 0;
+  for (int i = 0; i < state->iterations(); ++i) {
+    Matches matches;
+    FindCandidateMatches(left, right, &matches, method);
+    num_matches += matches.NumTracks();
+  }
+  state->SetItemsProcessed(state->iterations() * 2.0 * kNumFeatures);
+  DoNotOptimize(num_matches);
+}
+
+BENCHMARK(BM_FindCandidateMatchesLinear) {
+  MatchDescriptors(eMATCH_LINEAR, state);
+}
+
+BENCHMARK(BM_FindCandidateMatchesKdtree) {
+  MatchDescriptors(eMATCH_KDTREE, state);
+}
+
+BENCHMARK(BM_FindCandidateMatchesFLANN) {
+  MatchDescriptors(eMATCH_KDTREE_FLANN, state);
+}
+
+BENCHMARK(BM_FindCandidateMatchesCascadeHashing) {
+  MatchDescriptors(eMATCH_CASCADE_HASHING, state);
+}
+
+}  // namespace
@@ -0,0 +1,250 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+#include "libmv/base/scoped_ptr.h"
+#include "libmv/base/thread.h"
+#include "libmv/correspondence/dense_flow.h"
+#include "libmv/image/convolve.h"
+#include "libmv/image/sample.h"
+#include "libmv/logging/logging.h"
+
+namespace libmv {
+namespace {
+
+// The rows of a level are processed in bands of this many rows.
+const int kBandHeight = 32;
+
+int NumBands(int height) {
+  return (height + kBandHeight - 1) / kBandHeight;
+}
+
+// The rows [begin, end) of a band, and the rows [halo_begin, halo_end) that
+// their window sums read. The box filter of the halo rows alone gives the
+// same sums for the band rows as a filter of the whole level.
+struct Band {
+  Band(int band, int height, int half_window_size) {
+    begin = band * kBandHeight;
+    end = std::min(height, begin + kBandHeight);
+    halo_begin = std::max(0, begin - half_window_size);
+    halo_end = std::min(height, end + half_window_size);
+  }
+  int begin, end;
+  int halo_begin, halo_end;
+};
+
+// The flow of a level from the flow of the next coarser level.
+struct UpsampleFlowBands {
+  void operator()(int band) const {
+    Band rows(band, fine->Height(), 0);
+    for (int y = rows.begin; y < rows.end; ++y) {
+      float *out = &(*fine)(y, 0, 0);
+      for (int x = 0; x < fine->Width(); ++x) {
+        out[2 * x + 0] = 2 * SampleLinear(*coarse, 0.5f * y, 0.5f * x, 0);
+        out[2 * x + 1] = 2 * SampleLinear(*coarse, 0.5f * y, 0.5f * x, 1);
+      }
+    }
+  }
+  const FloatImage *coarse;
+  FloatImage *fine;
+};
+
+// The window sums gxx, gxy and gyy of the gradients of the first image.
+struct StructureTensorBands {
+  void operator()(int band) const {
+    Band rows(band, image_and_gradients->Height(), half_window_size);
+    int width = image_and_gradients->Width();
+    FloatImage products(rows.halo_end - rows.halo_begin, width, 3), sums;
+    for (int y = rows.halo_begin; y < rows.halo_end; ++y) {
+      const float *in = &(*image_and_gradients)(y, 0, 0);
+      float *out = &products(y - rows.halo_begin, 0, 0);
+      for (int x = 0; x < width; ++x) {
+        float gx = in[3 * x + 1], gy = in[3 * x + 2];
+        out[3 * x + 0] = gx * gx;
+        out[3 * x + 1] = gx * gy;
+        out[3 * x + 2] = gy * gy;
+      }
+    }
+    BoxFilter(products, 2 * half_window_size + 1, &sums);
+    for (int y = rows.begin; y < rows.end; ++y) {
+      memcpy(&(*tensor)(y, 0, 0), &sums(y - rows.halo_begin, 0, 0),
+             3 * width * sizeof(float));
+    }
+  }
+  const FloatImage *image_and_gradients;
+  int half_window_size;
+  FloatImage *tensor;
+};
+
+// One Gauss-Newton step of every pixel p, moving its whole window by its
+// flow d(p). The second image is warped by the flow of each pixel q of the
+// window, so it is linearized back to d(p) with the gradient g(q) of the
+// first image:
+//   I2(q + d(p)) ~ I2(q + d(q)) + g(q).(d(p) - d(q))
+// which makes the step next_flow(p) = G(p)^-1 e(p), with e(p) the window sum
+// of g(q) (I1(q) - I2(q + d(q)) + g(q).d(q)). Without the g(q).d(q) term the
+// windows of neighbouring pixels disagree and the iterations drift apart.
+struct FlowUpdateBands {
+  void operator()(int band) const {
+    Band rows(band, intensity2->Height(), half_window_size);
+    int width = intensity2->Width();
+    std::vector<float> xs(width), ys(width), warped(width);
+    FloatImage products(rows.halo_end - rows.halo_begin, width, 2), sums;
+    for (int y = rows.halo_begin; y < rows.halo_end; ++y) {
+      const float *motion = &(*flow)(y, 0, 0);
+      for (int x = 0; x < width; ++x) {
+        xs[x] = x + motion[2 * x + 0];
+        ys[x] = y + motion[2 * x + 1];
+      }
+      SampleLinear(*intensity2, &ys[0], &xs[0], width, &warped[0]);
+      const float *in = &(*image_and_gradients1)(y, 0, 0);
+      float *out = &products(y - rows.halo_begin, 0, 0);
+      for (int x = 0; x < width; ++x) {
+        float gx = in[3 * x + 1], gy = in[3 * x + 2];
+        float difference = in[3 * x] - warped[x] +
+                           gx * motion[2 * x + 0] + gy * motion[2 * x + 1];
+        out[2 * x + 0] = gx * difference;
+        out[2 * x + 1] = gy * difference;
+      }
+    }
+    BoxFilter(products, 2 * half_window_size + 1, &sums);
+
+    float max_update2 = 0;
+    for (int y = rows.begin; y < rows.end; ++y) {
+      const float *g = &(*tensor)(y, 0, 0);
+      const float *e = &sums(y - rows.halo_begin, 0, 0);
+      const float *motion = &(*flow)(y, 0, 0);
+      float *out = &(*next_flow)(y, 0, 0);
+      for (int x = 0; x < width; ++x) {
+        float gxx = g[3 * x], gxy = g[3 * x + 1], gyy = g[3 * x + 2];
+        float ex = e[2 * x], ey = e[2 * x + 1];
+        float det = gxx * gyy - gxy * gxy;
+        out[2 * x + 0] = motion[2 * x + 0];
+        out[2 * x + 1] = motion[2 * x + 1];
+        if (det >= min_determinant) {
+          out[2 * x + 0] = (gyy * ex - gxy * ey) / det;
+          out[2 * x + 1] = (gxx * ey - gxy * ex) / det;
+        }
+        float dx = out[2 * x + 0] - motion[2 * x + 0];
+        float dy = out[2 * x + 1] - motion[2 * x + 1];
+        max_update2 = std::max(max_update2, dx * dx + dy * dy);
+      }
+    }
+    (*max_updates2)[band] = max_update2;
+  }
+  const FloatImage *image_and_gradients1;
+  const FloatImage *intensity2;
+  const FloatImage *tensor;
+  int half_window_size;
+  float min_determinant;
+  const FloatImage *flow;
+  FloatImage *next_flow;
+  std::vector<float> *max_updates2;
+};
+
+}  // namespace
+
+void DenseFlowContext::ComputeFlowOneLevel(
+    const FloatImage &image_and_gradients1,
+    const FloatImage &image_and_gradients2,
+    FloatImage *flow) const {
+  int height = image_and_gradients1.Height();
+  int width = image_and_gradients1.Width();
+  int num_bands = NumBands(height);
+
+  FloatImage tensor(height, width, 3);
+  StructureTensorBands structure;
+  structure.image_and_gradients = &image_and_gradients1;
+  structure.half_window_size = half_window_size_;
+  structure.tensor = &tensor;
+  ParallelFor(0, num_bands, num_threads_, &structure);
+
+  // The warps sample single channel rows, 4 points at a time.
+  FloatImage intensity2(height, width, 1);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      intensity2(y, x) = image_and_gradients2(y, x, 0);
+    }
+  }
+
+  FloatImage next_flow(height, width, 2);
+  std::vector<float> max_updates2(num_bands);
+  FlowUpdateBands update;
+  update.image_and_gradients1 = &image_and_gradients1;
+  update.intensity2 = &intensity2;
+  update.tensor = &tensor;
+  update.half_window_size = half_window_size_;
+  update.min_determinant = min_determinant_;
+  update.max_updates2 = &max_updates2;
+  for (int i = 0; i < max_iterations_; ++i) {
+    update.flow = flow;
+    update.next_flow = &next_flow;
+    ParallelFor(0, num_bands, num_threads_, &update);
+    flow->Swap(&next_flow);
+    if (*std::max_element(max_updates2.begin(), max_updates2.end()) <
+        min_update_distance2_) {
+      break;
+    }
+  }
+}
+
+void DenseFlowContext::ComputeFlow(ImagePyramid *pyramid1,
+                                   ImagePyramid *pyramid2,
+                                   FloatImage *flow) const {
+  LIBMV_SCOPED_TIMER("dense_flow.flow");
+  int num_levels = std::min(pyramid1->NumLevels(), pyramid2->NumLevels());
+  FloatImage level_flow, finer_flow;
+  for (int i = num_levels - 1; i >= 0; --i) {
+    const FloatImage &level1 = pyramid1->Level(i);
+    const FloatImage &level2 = pyramid2->Level(i);
+    assert(level1.Height() == level2.Height());
+    assert(level1.Width() == level2.Width());
+    if (i == num_levels - 1) {
+      level_flow.Resize(level1.Height(), level1.Width(), 2);
+      level_flow.Fill(0);
+    } else {
+      finer_flow.Resize(level1.Height(), level1.Width(), 2);
+      UpsampleFlowBands upsample;
+      upsample.coarse = &level_flow;
+      upsample.fine = &finer_flow;
+      ParallelFor(0, NumBands(level1.Height()), num_threads_, &upsample);
+      level_flow.Swap(&finer_flow);
+    }
+    ComputeFlowOneLevel(level1, level2, &level_flow);
+  }
+  flow->Swap(&level_flow);
+}
+
+void DenseFlowContext::ComputeFlow(const FloatImage &image1,
+                                   const FloatImage &image2,
+                                   int num_levels,
+                                   FloatImage *flow) const {
+  scoped_ptr<ImagePyramid> pyramid1(MakeImagePyramid(image1, num_levels,
+                                                     0.9));
+  scoped_ptr<ImagePyramid> pyramid2(MakeImagePyramid(image2, num_levels,
+                                                     0.9));
+  ComputeFlow(pyramid1.get(), pyramid2.get(), flow);
+}
+
+}  // namespace libmv
@@ -0,0 +1,100 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_CORRESPONDENCE_DENSE_FLOW_H_
+#define LIBMV_CORRESPONDENCE_DENSE_FLOW_H_
+
+#include "libmv/image/image.h"
+#include "libmv/image/image_pyramid.h"
+
+namespace libmv {
+
+// Dense pyramidal Lucas-Kanade optical flow: the tracking equation of
+// KLTContext, solved for every pixel at once. The window sums of the
+// gradient products are box filters over whole levels instead of loops over
+// the window of each feature, so the cost per pixel does not depend on the
+// window size. The structure tensor comes from the first image and is
+// filtered once per level; every iteration warps the second image by the
+// current flow, filters the products of the gradients with the differences,
+// and solves the 2x2 systems.
+//
+// The levels are processed in bands of rows, each with the rows of the
+// window above and below it, which run on the global thread pool. The bands
+// only depend on the size of the image, so the flow does not depend on the
+// number of threads.
+class DenseFlowContext {
+ public:
+  DenseFlowContext()
+      : half_window_size_(3),
+        max_iterations_(5),
+        min_determinant_(1e-6),
+        min_update_distance2_(1e-6),
+        num_threads_(1) {
+  }
+
+  // The motion of every pixel of the image of pyramid1 to the image of
+  // pyramid2, as made by MakeImagePyramid(): flow is resized to the size of
+  // the images, with channel 0 the motion along x and channel 1 along y, in
+  // pixels. Pixels whose window has too little texture at some level keep the
+  // flow of the coarser levels.
+  void ComputeFlow(ImagePyramid *pyramid1,
+                   ImagePyramid *pyramid2,
+                   FloatImage *flow) const;
+
+  // Same as above on single channel images, with pyramids of num_levels.
+  void ComputeFlow(const FloatImage &image1,
+                   const FloatImage &image2,
+                   int num_levels,
+                   FloatImage *flow) const;
+
+  void SetHalfWindowSize(int half_window_size) {
+    half_window_size_ = half_window_size;
+  }
+  int HalfWindowSize() const { return half_window_size_; }
+  int WindowSize() const { return 2 * HalfWindowSize() + 1; }
+
+  // Iterations per level. Every pixel is updated at every iteration, so
+  // unlike the sparse tracker there is no early exit per pixel; the
+  // iterations stop when no pixel moves by more than the minimum update.
+  void SetMaxIterations(int max_iterations) {
+    max_iterations_ = max_iterations;
+  }
+  void SetMinDeterminant(double min_determinant) {
+    min_determinant_ = min_determinant;
+  }
+  void SetNumThreads(int num_threads) { num_threads_ = num_threads; }
+  int NumThreads() const { return num_threads_; }
+
+ private:
+  // Refines flow, of the size of the levels, on one pyramid level.
+  void ComputeFlowOneLevel(const FloatImage &image_and_gradients1,
+                           const FloatImage &image_and_gradients2,
+                           FloatImage *flow) const;
+
+  int half_window_size_;
+  int max_iterations_;
+  double min_determinant_;
+  double min_update_distance2_;
+  int num_threads_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_CORRESPONDENCE_DENSE_FLOW_H_
@@ -0,0 +1,101 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cmath>
+
+#include "libmv/correspondence/dense_flow.h"
+#include "libmv/image/image.h"
+#include "libmv/numeric/numeric.h"
+#include "testing/testing.h"
+
+using namespace libmv;
+
+namespace {
+
+float Texture(double x, double y) {
+  return 0.5 + 0.15 * sin(0.21 * x + 0.05 * y) +
+               0.15 * sin(0.07 * x - 0.19 * y + 1) +
+               0.1 * cos(0.3 * y - 0.11 * x);
+}
+
+// The texture moved by (dx, dy).
+void MakeImage(double dx, double dy, FloatImage *image) {
+  image->Resize(96, 128, 1);
+  for (int y = 0; y < image->Height(); ++y) {
+    for (int x = 0; x < image->Width(); ++x) {
+      (*image)(y, x) = Texture(x - dx, y - dy);
+    }
+  }
+}
+
+TEST(DenseFlow, IdenticalImagesDoNotMove) {
+  FloatImage image, flow;
+  MakeImage(0, 0, &image);
+  DenseFlowContext context;
+  context.ComputeFlow(image, image, 3, &flow);
+  EXPECT_EQ(image.Height(), flow.Height());
+  EXPECT_EQ(image.Width(), flow.Width());
+  EXPECT_EQ(2, flow.Depth());
+  for (int y = 0; y < flow.Height(); ++y) {
+    for (int x = 0; x < flow.Width(); ++x) {
+      EXPECT_EQ(0, flow(y, x, 0));
+      EXPECT_EQ(0, flow(y, x, 1));
+    }
+  }
+}
+
+TEST(DenseFlow, Translation) {
+  FloatImage image1, image2, flow;
+  MakeImage(0, 0, &image1);
+  MakeImage(2.5, -1.25, &image2);
+  DenseFlowContext context;
+  context.ComputeFlow(image1, image2, 3, &flow);
+  // Away from the borders, where the blur of the pyramid darkens the images.
+  double sum_error = 0, max_error = 0;
+  int num_pixels = 0;
+  for (int y = 16; y < flow.Height() - 16; ++y) {
+    for (int x = 16; x < flow.Width() - 16; ++x) {
+      double error = Vec2(flow(y, x, 0) - 2.5, flow(y, x, 1) + 1.25).norm();
+      sum_error += error;
+      max_error = std::max(max_error, error);
+      ++num_pixels;
+    }
+  }
+  EXPECT_LT(sum_error / num_pixels, 0.05);
+  EXPECT_LT(max_error, 0.15);
+}
+
+TEST(DenseFlow, SameFlowWithThreads) {
+  FloatImage image1, image2, flow1, flow4;
+  MakeImage(0, 0, &image1);
+  MakeImage(-1, 0.5, &image2);
+  DenseFlowContext context;
+  context.ComputeFlow(image1, image2, 2, &flow1);
+  context.SetNumThreads(4);
+  context.ComputeFlow(image1, image2, 2, &flow4);
+  for (int y = 0; y < flow1.Height(); ++y) {
+    for (int x = 0; x < flow1.Width(); ++x) {
+      EXPECT_EQ(flow1(y, x, 0), flow4(y, x, 0));
+      EXPECT_EQ(flow1(y, x, 1), flow4(y, x, 1));
+    }
+  }
+}
+
+}  // namespace
@@ -0,0 +1,213 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "libmv/base/thread.h"
+#include "libmv/correspondence/distributed_matching.h"
+#include "libmv/correspondence/matches_binary.h"
+#include "libmv/logging/logging.h"
+
+namespace libmv {
+
+void ShardImages(int num_images, int num_nodes, int node,
+                 std::vector<int> *images) {
+  images->clear();
+  for (int i = node; i < num_images; i += num_nodes) {
+    images->push_back(i);
+  }
+}
+
+void AllImagePairs(int num_images, std::vector<ImagePair> *pairs) {
+  pairs->clear();
+  for (int i = 0; i < num_images; ++i) {
+    for (int j = 0; j < i; ++j) {
+      pairs->push_back(ImagePair(i, j));
+    }
+  }
+}
+
+void PartitionPairs(const std::vector<ImagePair> &pairs,
+                    int num_nodes, int node,
+                    std::vector<ImagePair> *node_pairs) {
+  std::vector<ImagePair> sorted(pairs);
+  std::sort(sorted.begin(), sorted.end());
+  size_t begin = sorted.size() * node / num_nodes;
+  size_t end = sorted.size() * (node + 1) / num_nodes;
+  node_pairs->assign(sorted.begin() + begin, sorted.begin() + end);
+}
+
+bool WritePairList(const std::string &filename,
+                   const std::vector<ImagePair> &pairs) {
+  std::ofstream out(filename.c_str());
+  if (!out) {
+    return false;
+  }
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    out << pairs[i].first << " " << pairs[i].second << "\n";
+  }
+  return out.good();
+}
+
+bool ReadPairList(const std::string &filename,
+                  std::vector<ImagePair> *pairs) {
+  std::ifstream in(filename.c_str());
+  if (!in) {
+    return false;
+  }
+  pairs->clear();
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty()) {
+      continue;
+    }
+    std::istringstream fields(line);
+    ImagePair pair;
+    if (!(fields >> pair.first >> pair.second)) {
+      LOG(ERROR) << "Invalid pair \"" << line << "\" in " << filename;
+      return false;
+    }
+    pairs->push_back(pair);
+  }
+  return true;
+}
+
+std::string PairListFilename(const std::string &directory) {
+  return directory + "/pairs.txt";
+}
+
+std::string PairMatchesFilename(const std::string &directory, int node) {
+  char name[32];
+  sprintf(name, "/pair_matches_%04d.bin", node);
+  return directory + name;
+}
+
+bool ExportPairMatchesToBinary(const std::vector<ImagePair> &pairs,
+                               const std::vector<const Matches *> &pair_matches,
+                               const std::string &filename) {
+  CHECK_EQ(pairs.size(), pair_matches.size());
+  Matches matches;
+  int num_tracks = 0;
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    if (!pair_matches[i]) {
+      continue;
+    }
+    const Matches &pair = *pair_matches[i];
+    for (Matches::Features<PointFeature> r = pair.InImage<PointFeature>(0);
+         r; ++r) {
+      const Feature *feature_b = pair.Get(1, r.track());
+      if (!feature_b) {
+        continue;
+      }
+      matches.Insert(pairs[i].first, num_tracks, r.feature());
+      matches.Insert(pairs[i].second, num_tracks, feature_b);
+      ++num_tracks;
+    }
+  }
+  return ExportMatchesToBinary(matches, filename);
+}
+
+bool PairTrackBuilder::AddFile(const std::string &filename) {
+  MappedMatches file;
+  if (!file.Open(filename)) {
+    return false;
+  }
+  // The observations are sorted by image: match every observation with the
+  // first one seen of its track.
+  std::map<int, std::pair<int, int> > track_features;
+  for (int i = 0; i < file.NumObservations(); ++i) {
+    int image = file.Images()[i];
+    int feature = FeatureIndex(image, file.X()[i], file.Y()[i]);
+    std::map<int, std::pair<int, int> >::iterator track =
+        track_features.find(file.Tracks()[i]);
+    if (track == track_features.end()) {
+      track_features[file.Tracks()[i]] = std::make_pair(image, feature);
+    } else {
+      FeatureMatch match;
+      match.image_a = track->second.first;
+      match.feature_a = track->second.second;
+      match.image_b = image;
+      match.feature_b = feature;
+      matches_.push_back(match);
+    }
+  }
+  return true;
+}
+
+void PairTrackBuilder::AddMatch(int image_a, float x_a, float y_a,
+                                int image_b, float x_b, float y_b) {
+  FeatureMatch match;
+  match.image_a = image_a;
+  match.feature_a = FeatureIndex(image_a, x_a, y_a);
+  match.image_b = image_b;
+  match.feature_b = FeatureIndex(image_b, x_b, y_b);
+  matches_.push_back(match);
+}
+
+int PairTrackBuilder::Build(Matches *tracks, FeatureSet *feature_set) {
+  std::vector<int> num_features(positions_.size());
+  for (size_t i = 0; i < positions_.size(); ++i) {
+    num_features[i] = positions_[i].size();
+  }
+  TrackBuilder builder(num_features);
+  builder.AddMatches(matches_.empty() ? NULL : &matches_[0], matches_.size(),
+                     NumThreads());
+  FeatureTracks feature_tracks;
+  int num_dropped = builder.Build(NumThreads(), &feature_tracks);
+
+  // Resized once, before any pointer to the features is handed to tracks.
+  feature_set->features.clear();
+  feature_set->features.resize(feature_tracks.features.size());
+  for (int t = 0; t < feature_tracks.NumTracks(); ++t) {
+    for (int i = feature_tracks.offsets[t];
+         i < feature_tracks.offsets[t + 1]; ++i) {
+      const TrackFeature &f = feature_tracks.features[i];
+      const Position &position = positions_[f.image][f.feature];
+      KeypointFeature &feature = feature_set->features[i];
+      feature.coords << position.x, position.y;
+      tracks->Insert(f.image, t, &feature);
+    }
+  }
+  return num_dropped;
+}
+
+int PairTrackBuilder::FeatureIndex(int image, float x, float y) {
+  if (image >= positions_.size()) {
+    positions_.resize(image + 1);
+    indices_.resize(image + 1);
+  }
+  Position position;
+  position.x = x;
+  position.y = y;
+  std::map<Position, int>::iterator found = indices_[image].find(position);
+  if (found != indices_[image].end()) {
+    return found->second;
+  }
+  int index = positions_[image].size();
+  indices_[image][position] = index;
+  positions_[image].push_back(position);
+  ++num_features_;
+  return index;
+}
+
+}  // namespace libmv
@@ -0,0 +1,126 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_CORRESPONDENCE_DISTRIBUTED_MATCHING_H_
+#define LIBMV_CORRESPONDENCE_DISTRIBUTED_MATCHING_H_
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "libmv/correspondence/feature_matching.h"
+#include "libmv/correspondence/matches.h"
+#include "libmv/correspondence/track_builder.h"
+
+namespace libmv {
+
+// The pieces of matching a set of images on several nodes that share a file
+// system. Each node is given its index among num_nodes, and the work is split
+// deterministically, so that the nodes need no other communication:
+//
+//   1. every node extracts the features of its shard of the images (see
+//      ShardImages()) into the feature cache (see WriteFeatureCache());
+//   2. the candidate pairs are listed once (see WritePairList()), unless all
+//      the pairs are matched;
+//   3. every node matches its partition of the pairs (see PartitionPairs()),
+//      reading the features from the cache, and exports the consistent
+//      matches with ExportPairMatchesToBinary();
+//   4. the pair matches of all the nodes are merged into tracks by a
+//      PairTrackBuilder.
+
+typedef std::pair<int, int> ImagePair;
+
+// The images of a node: image i belongs to node i % num_nodes, like the
+// shards of nRobustViewMatching::setExtractors().
+void ShardImages(int num_images, int num_nodes, int node,
+                 std::vector<int> *images);
+
+// All the pairs (i, j) with j < i, in the order of computeCrossMatch().
+void AllImagePairs(int num_images, std::vector<ImagePair> *pairs);
+
+// The pairs of a node: the pairs are sorted, so that the pairs of a node
+// share their first image and it reads fewer features, and split in
+// contiguous blocks whose sizes differ by at most one.
+void PartitionPairs(const std::vector<ImagePair> &pairs,
+                    int num_nodes, int node,
+                    std::vector<ImagePair> *node_pairs);
+
+// Pair list files hold one line "indexA indexB" per pair. ReadPairList()
+// returns false if the file cannot be read or a line is not a pair.
+bool WritePairList(const std::string &filename,
+                   const std::vector<ImagePair> &pairs);
+bool ReadPairList(const std::string &filename,
+                  std::vector<ImagePair> *pairs);
+
+// The names of the files the nodes exchange in directory.
+std::string PairListFilename(const std::string &directory);
+std::string PairMatchesFilename(const std::string &directory, int node);
+
+// Exports the matches of pairs to a binary matches file (see
+// ExportMatchesToBinary()), every match being a track of two observations, in
+// the images of its pair. pair_matches[i] holds the matches of pairs[i] in
+// images 0 and 1, as nRobustViewMatching::getSharedData(); NULL for none.
+bool ExportPairMatchesToBinary(const std::vector<ImagePair> &pairs,
+                               const std::vector<const Matches *> &pair_matches,
+                               const std::string &filename);
+
+// Builds tracks from the matches of many pairs with a TrackBuilder. The files
+// do not hold the features themselves, so features are identified by their
+// image and position; the features cached for an image always have the same
+// positions.
+class PairTrackBuilder {
+ public:
+  PairTrackBuilder() : num_features_(0) {}
+
+  // Adds the observations of every track of a binary matches file as matched
+  // together. Returns false if the file cannot be read.
+  bool AddFile(const std::string &filename);
+  void AddMatch(int image_a, float x_a, float y_a,
+                int image_b, float x_b, float y_b);
+
+  int NumFeatures() const { return num_features_; }
+
+  // Fills tracks with the tracks of TrackBuilder::Build(), numbered from 0,
+  // whose features are stored in feature_set, which is cleared and must
+  // outlive tracks. Returns the number of inconsistent tracks dropped.
+  int Build(Matches *tracks, FeatureSet *feature_set);
+
+ private:
+  struct Position {
+    float x, y;
+    bool operator<(const Position &other) const {
+      return x < other.x || (x == other.x && y < other.y);
+    }
+  };
+
+  // The index of the feature at x, y among the features of image.
+  int FeatureIndex(int image, float x, float y);
+
+  // The features of every image, and their indices.
+  std::vector<std::vector<Position> > positions_;
+  std::vector<std::map<Position, int> > indices_;
+  int num_features_;
+  std::vector<FeatureMatch> matches_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_CORRESPONDENCE_DISTRIBUTED_MATCHING_H_
@@ -0,0 +1,150 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <string>
+
+#include "libmv/correspondence/distributed_matching.h"
+#include "libmv/correspondence/matches_binary.h"
+#include "testing/testing.h"
+
+namespace {
+
+using namespace libmv;
+
+std::string TemporaryFilename(const char *name) {
+  return std::string("/tmp/libmv_distributed_matching_test_") + name;
+}
+
+TEST(DistributedMatching, ShardsAndPartitionsCoverEverythingOnce) {
+  std::vector<int> images, all_images;
+  for (int node = 0; node < 3; ++node) {
+    ShardImages(10, 3, node, &images);
+    all_images.insert(all_images.end(), images.begin(), images.end());
+  }
+  std::sort(all_images.begin(), all_images.end());
+  ASSERT_EQ(10, all_images.size());
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(i, all_images[i]);
+  }
+
+  std::vector<ImagePair> pairs, node_pairs, all_pairs;
+  AllImagePairs(10, &pairs);
+  EXPECT_EQ(45, pairs.size());
+  std::reverse(pairs.begin(), pairs.end());
+  for (int node = 0; node < 4; ++node) {
+    PartitionPairs(pairs, 4, node, &node_pairs);
+    EXPECT_LE(11, node_pairs.size());
+    EXPECT_GE(12, node_pairs.size());
+    all_pairs.insert(all_pairs.end(), node_pairs.begin(), node_pairs.end());
+  }
+  std::sort(pairs.begin(), pairs.end());
+  EXPECT_TRUE(pairs == all_pairs);
+}
+
+TEST(DistributedMatching, PairListRoundTrip) {
+  std::string filename = TemporaryFilename("pairs.txt");
+  std::vector<ImagePair> pairs, read;
+  pairs.push_back(ImagePair(3, 1));
+  pairs.push_back(ImagePair(7, 2));
+  EXPECT_TRUE(WritePairList(filename, pairs));
+  EXPECT_TRUE(ReadPairList(filename, &read));
+  EXPECT_TRUE(pairs == read);
+  remove(filename.c_str());
+  EXPECT_FALSE(ReadPairList(filename, &read));
+}
+
+TEST(DistributedMatching, PairMatchesOfSeveralNodesMergeIntoTracks) {
+  // Feature 0 of image 0 is seen in images 1 and 2, through pairs matched by
+  // different nodes.
+  FeatureSet features;
+  features.features.resize(6);
+  features.features[0].coords << 1, 2;
+  features.features[1].coords << 3, 4;
+  features.features[2].coords << 5, 6;
+  features.features[3].coords << 7, 8;
+  features.features[4].coords << 9, 10;
+  features.features[5].coords << 11, 12;
+  Matches pair_01, pair_12;
+  pair_01.Insert(0, 5, &features.features[0]);
+  pair_01.Insert(1, 5, &features.features[1]);
+  pair_01.Insert(0, 6, &features.features[4]);
+  pair_01.Insert(1, 6, &features.features[5]);
+  pair_12.Insert(0, 0, &features.features[1]);
+  pair_12.Insert(1, 0, &features.features[2]);
+
+  std::vector<ImagePair> pairs;
+  std::vector<const Matches *> pair_matches;
+  pairs.push_back(ImagePair(0, 1));
+  pair_matches.push_back(&pair_01);
+  std::string node_0 = PairMatchesFilename("/tmp", 0);
+  EXPECT_TRUE(ExportPairMatchesToBinary(pairs, pair_matches, node_0));
+  pairs[0] = ImagePair(1, 2);
+  pair_matches[0] = &pair_12;
+  std::string node_1 = PairMatchesFilename("/tmp", 1);
+  EXPECT_TRUE(ExportPairMatchesToBinary(pairs, pair_matches, node_1));
+
+  PairTrackBuilder builder;
+  EXPECT_TRUE(builder.AddFile(node_0));
+  EXPECT_TRUE(builder.AddFile(node_1));
+  EXPECT_FALSE(builder.AddFile(TemporaryFilename("missing.bin")));
+  EXPECT_EQ(5, builder.NumFeatures());
+
+  Matches tracks;
+  FeatureSet track_features;
+  EXPECT_EQ(0, builder.Build(&tracks, &track_features));
+  EXPECT_EQ(2, tracks.NumTracks());
+  EXPECT_EQ(3, tracks.NumImages());
+  int track = -1;
+  for (int i = 0; i < 2; ++i) {
+    const PointFeature *in_image_2 =
+        dynamic_cast<const PointFeature *>(tracks.Get(2, i));
+    if (in_image_2) {
+      track = i;
+      EXPECT_EQ(5, in_image_2->x());
+    }
+  }
+  ASSERT_LE(0, track);
+  const PointFeature *in_image_0 =
+      dynamic_cast<const PointFeature *>(tracks.Get(0, track));
+  ASSERT_TRUE(in_image_0 != NULL);
+  EXPECT_EQ(1, in_image_0->x());
+  EXPECT_EQ(2, in_image_0->y());
+  remove(node_0.c_str());
+  remove(node_1.c_str());
+}
+
+TEST(DistributedMatching, TracksWithTwoFeaturesInAnImageAreDropped) {
+  PairTrackBuilder builder;
+  builder.AddMatch(0, 1, 1, 1, 2, 2);
+  builder.AddMatch(1, 2, 2, 2, 3, 3);
+  builder.AddMatch(2, 3, 3, 0, 4, 4);
+  builder.AddMatch(0, 10, 10, 2, 20, 20);
+
+  Matches tracks;
+  FeatureSet features;
+  EXPECT_EQ(1, builder.Build(&tracks, &features));
+  EXPECT_EQ(1, tracks.NumTracks());
+  EXPECT_TRUE(tracks.Get(0, 0) != NULL);
+  EXPECT_TRUE(tracks.Get(2, 0) != NULL);
+  EXPECT_TRUE(tracks.Get(1, 0) == NULL);
+}
+
+}  // namespace
@@ -0,0 +1,309 @@
+// Copyright (c) 2007, 2008 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+#ifndef LIBMV_CORRESPONDENCE_DYNAMIC_KDTREE_H_
+#define LIBMV_CORRESPONDENCE_DYNAMIC_KDTREE_H_
+
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <cassert>
+
+#include "libmv/correspondence/kdtree.h"
+
+namespace libmv {
+
+// A nearest neighbor index that points can be inserted into and removed from
+// without rebuilding it, for sets which change a little at a time, like the
+// tracks of a sequence from one frame to the next.
+//
+// It is a logarithmic forest of static kd-trees, after Bentley and Saxe
+// "Decomposable searching problems I: static-to-dynamic transformation"
+// (1980). New points go to a small buffer which is searched linearly. When
+// the buffer is full, it is merged with the levels 0 to j - 1 into level j,
+// the first empty one, so level j holds up to buffer_size * 2^j points and a
+// point is rebuilt into a tree O(log n) times. Removed points are only
+// marked dead and skipped by the searches; a level is rebuilt once half of
+// its points are dead.
+//
+// The points are copied, and identified by a unique id. Searching is const,
+// so a built index can be searched by several threads at once.
+template <typename Scalar, typename Id = int>
+class DynamicKdTree {
+ public:
+  explicit DynamicKdTree(int num_dims = 0, int buffer_size = 64)
+      : num_dims_(num_dims), buffer_size_(buffer_size) {}
+  ~DynamicKdTree() { Clear(); }
+
+  // Can only change while the index is empty.
+  void SetDimensions(int num_dims) {
+    assert(Size() == 0);
+    num_dims_ = num_dims;
+  }
+  int NumDimension() const { return num_dims_; }
+
+  // The number of points, dead ones excluded.
+  int Size() const { return slots_.size(); }
+  bool Contains(const Id &id) const { return slots_.count(id) > 0; }
+  // The number of kd-trees.
+  int NumTrees() const {
+    int num_trees = 0;
+    for (size_t i = 0; i < levels_.size(); ++i) {
+      num_trees += levels_[i] != NULL;
+    }
+    return num_trees;
+  }
+
+  void Clear() {
+    for (size_t i = 0; i < levels_.size(); ++i) {
+      delete levels_[i];
+    }
+    levels_.clear();
+    buffer_data_.clear();
+    buffer_slots_.clear();
+    slots_.clear();
+    slot_ids_.clear();
+    slot_levels_.clear();
+    slot_alive_.clear();
+    free_slots_.clear();
+  }
+
+  // Inserts a copy of the num_dims values of data. Returns false if id is
+  // already in the index.
+  bool Insert(const Scalar *data, const Id &id) {
+    if (Contains(id)) {
+      return false;
+    }
+    int slot = NewSlot(id, kBuffer);
+    buffer_data_.insert(buffer_data_.end(), data, data + num_dims_);
+    buffer_slots_.push_back(slot);
+    if (int(buffer_slots_.size()) >= buffer_size_) {
+      MergeBuffer();
+    }
+    return true;
+  }
+
+  // Returns false if id is not in the index.
+  bool Remove(const Id &id) {
+    typename std::map<Id, int>::iterator it = slots_.find(id);
+    if (it == slots_.end()) {
+      return false;
+    }
+    int slot = it->second;
+    slots_.erase(it);
+    int level = slot_levels_[slot];
+    if (level == kBuffer) {
+      // The buffer is small, the point is removed right away.
+      int i = 0;
+      while (buffer_slots_[i] != slot) {
+        ++i;
+      }
+      int last = buffer_slots_.size() - 1;
+      buffer_slots_[i] = buffer_slots_[last];
+      std::copy(buffer_data_.begin() + last * num_dims_,
+                buffer_data_.end(),
+                buffer_data_.begin() + i * num_dims_);
+      buffer_slots_.pop_back();
+      buffer_data_.resize(last * num_dims_);
+      FreeSlot(slot);
+    } else {
+      slot_alive_[slot] = 0;
+      Level *l = levels_[level];
+      if (2 * ++l->num_dead > int(l->slots.size())) {
+        RebuildLevel(level);
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Finds the k nearest neighbors of query, closest first, with their squared
+   * distances. Each tree explores at most max_leafs leafs, best bin first, so
+   * the search is exact if max_leafs is at least the number of leafs of the
+   * largest tree. Fewer than k neighbors are returned if the index holds
+   * fewer points.
+   */
+  void Knn(const Scalar *query, int k, int max_leafs,
+           std::vector<Id> *ids, std::vector<Scalar> *distances) const {
+    KnnSortedList<Scalar, int> knn(k);
+    for (size_t i = 0; i < buffer_slots_.size(); ++i) {
+      knn.AddNeighbor(buffer_slots_[i],
+                      L2Distance2(&buffer_data_[i * num_dims_], query));
+    }
+    IsAlive is_alive(&slot_alive_);
+    for (size_t i = 0; i < levels_.size(); ++i) {
+      if (levels_[i]) {
+        levels_[i]->tree.ApproximateKnnBestBinFirst(query, max_leafs,
+                                                    is_alive, &knn);
+      }
+    }
+    ids->resize(knn.Size());
+    distances->resize(knn.Size());
+    for (int i = 0; i < knn.Size(); ++i) {
+      (*ids)[i] = slot_ids_[knn.Neighbor(i)];
+      (*distances)[i] = knn.Distance(i);
+    }
+  }
+
+ private:
+  enum { kBuffer = -1, kFree = -2 };
+  // The trees are built with about that many points per leaf.
+  enum { kPointsPerLeaf = 8 };
+
+  // The tree refers to the points by their slot, and to the values in data,
+  // so a level is never copied.
+  struct Level {
+    std::vector<Scalar> data;
+    std::vector<int> slots;
+    KdTree<Scalar, int> tree;
+    int num_dead;
+  };
+
+  struct IsAlive {
+    explicit IsAlive(const std::vector<char> *alive) : alive_(alive) {}
+    bool operator()(int slot) const { return (*alive_)[slot] != 0; }
+    const std::vector<char> *alive_;
+  };
+
+  int NewSlot(const Id &id, int level) {
+    int slot;
+    if (free_slots_.empty()) {
+      slot = slot_ids_.size();
+      slot_ids_.push_back(id);
+      slot_levels_.push_back(level);
+      slot_alive_.push_back(1);
+    } else {
+      slot = free_slots_.back();
+      free_slots_.pop_back();
+      slot_ids_[slot] = id;
+      slot_levels_[slot] = level;
+      slot_alive_[slot] = 1;
+    }
+    slots_[id] = slot;
+    return slot;
+  }
+
+  void FreeSlot(int slot) {
+    slot_levels_[slot] = kFree;
+    slot_alive_[slot] = 0;
+    free_slots_.push_back(slot);
+  }
+
+  // Appends the live points of level to the ones to build, and frees the
+  // slots of the dead ones.
+  void TakeLevel(int level, std::vector<Scalar> *data,
+                 std::vector<int> *slots) {
+    Level *l = levels_[level];
+    for (size_t i = 0; i < l->slots.size(); ++i) {
+      int slot = l->slots[i];
+      if (slot_alive_[slot]) {
+        data->insert(data->end(), l->data.begin() + i * num_dims_,
+                     l->data.begin() + (i + 1) * num_dims_);
+        slots->push_back(slot);
+      } else {
+        FreeSlot(slot);
+      }
+    }
+    delete l;
+    levels_[level] = NULL;
+  }
+
+  // Builds level from the points, or leaves it empty if there are none.
+  void BuildLevel(int level, std::vector<Scalar> *data,
+                  std::vector<int> *slots) {
+    assert(levels_[level] == NULL);
+    if (slots->empty()) {
+      return;
+    }
+    Level *l = new Level;
+    l->data.swap(*data);
+    l->slots.swap(*slots);
+    l->num_dead = 0;
+    l->tree.SetDimensions(num_dims_);
+    int num_points = l->slots.size();
+    for (int i = 0; i < num_points; ++i) {
+      l->tree.AddPoint(&l->data[i * num_dims_], l->slots[i]);
+      slot_levels_[l->slots[i]] = level;
+    }
+    int num_levels = 1;
+    while ((kPointsPerLeaf << num_levels) <= num_points) {
+      ++num_levels;
+    }
+    l->tree.Build(num_levels);
+    levels_[level] = l;
+  }
+
+  void MergeBuffer() {
+    std::vector<Scalar> data;
+    std::vector<int> slots;
+    data.swap(buffer_data_);
+    slots.swap(buffer_slots_);
+    size_t level = 0;
+    while (level < levels_.size() && levels_[level]) {
+      TakeLevel(level, &data, &slots);
+      ++level;
+    }
+    if (level == levels_.size()) {
+      levels_.push_back(NULL);
+    }
+    BuildLevel(level, &data, &slots);
+  }
+
+  void RebuildLevel(int level) {
+    std::vector<Scalar> data;
+    std::vector<int> slots;
+    TakeLevel(level, &data, &slots);
+    BuildLevel(level, &data, &slots);
+  }
+
+  Scalar L2Distance2(const Scalar *p, const Scalar *q) const {
+    Scalar distance = 0;
+    for (int i = 0; i < num_dims_; ++i) {
+      Scalar diff = p[i] - q[i];
+      distance += diff * diff;
+    }
+    return distance;
+  }
+
+  int num_dims_;
+  int buffer_size_;
+
+  // The points not yet in a tree, num_dims_ values per point.
+  std::vector<Scalar> buffer_data_;
+  std::vector<int> buffer_slots_;
+  // Level j holds up to buffer_size_ * 2^j points, or is NULL.
+  std::vector<Level *> levels_;
+
+  // The slot of every live point. A slot stays taken by a dead point until
+  // its level is rebuilt.
+  std::map<Id, int> slots_;
+  std::vector<Id> slot_ids_;
+  std::vector<int> slot_levels_;
+  std::vector<char> slot_alive_;
+  std::vector<int> free_slots_;
+
+  DynamicKdTree(const DynamicKdTree &);
+  DynamicKdTree &operator=(const DynamicKdTree &);
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_CORRESPONDENCE_DYNAMIC_KDTREE_H_
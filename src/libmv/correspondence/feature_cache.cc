@@ -0,0 +1,203 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "libmv/correspondence/feature_cache.h"
+#include "libmv/logging/logging.h"
+
+namespace libmv {
+
+namespace {
+
+const char kMagic[4] = { 'L', 'M', 'V', 'F' };
+const unsigned int kVersion = 1;
+const int kHeaderFields = 7;
+const int kAlignment = 16;
+
+unsigned int Fnv1a(const char *data, size_t size, unsigned int hash) {
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+const unsigned int kFnvOffset = 2166136261u;
+
+size_t Padding(size_t size) {
+  return (kAlignment - size % kAlignment) % kAlignment;
+}
+
+}  // namespace
+
+bool MakeFeatureCacheKey(const std::string &image_path,
+                         const std::string &parameters,
+                         FeatureCacheKey *key) {
+  FILE *file = fopen(image_path.c_str(), "rb");
+  if (!file) {
+    return false;
+  }
+  unsigned int size = 0;
+  unsigned int hash = kFnvOffset;
+  char buffer[1 << 16];
+  size_t num_read;
+  while ((num_read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    hash = Fnv1a(buffer, num_read, hash);
+    size += num_read;
+  }
+  bool ok = !ferror(file);
+  fclose(file);
+  if (!ok) {
+    return false;
+  }
+  key->image_path = image_path;
+  key->content_size = size;
+  key->content_hash = hash;
+  key->parameters = parameters;
+  return true;
+}
+
+std::string FeatureCacheFilename(const std::string &directory,
+                                 const FeatureCacheKey &key) {
+  std::string name = key.image_path.substr(
+      key.image_path.find_last_of("\\/") + 1);
+  unsigned int hash = Fnv1a(key.image_path.data(), key.image_path.size(),
+                            kFnvOffset);
+  hash = Fnv1a(key.parameters.data(), key.parameters.size(), hash);
+  char suffix[32];
+  sprintf(suffix, "-%08x.features", hash);
+  if (directory.empty()) {
+    return name + suffix;
+  }
+  return directory + "/" + name + suffix;
+}
+
+bool WriteFeatureCache(const std::string &filename,
+                       const FeatureCacheKey &key,
+                       const FeatureSet &features) {
+  unsigned int num_features = features.features.size();
+  unsigned int dimension = num_features ?
+      features.features[0].descriptor.coords.size() : 0;
+
+  std::string temporary = filename + ".tmp";
+  FILE *file = fopen(temporary.c_str(), "wb");
+  if (!file) {
+    LOG(ERROR) << "Cannot write the feature cache " << temporary;
+    return false;
+  }
+  unsigned int header[kHeaderFields] = {
+    kVersion, key.content_size, key.content_hash, key.image_path.size(),
+    key.parameters.size(), num_features, dimension
+  };
+  bool ok = fwrite(kMagic, sizeof(kMagic), 1, file) == 1 &&
+            fwrite(header, sizeof(header), 1, file) == 1;
+  std::string strings = key.image_path + key.parameters;
+  size_t strings_size = sizeof(kMagic) + sizeof(header) + strings.size();
+  strings.resize(strings.size() + Padding(strings_size), '\0');
+  ok = ok && fwrite(strings.data(), 1, strings.size(), file) == strings.size();
+
+  std::vector<float> record(4 + dimension);
+  for (unsigned int i = 0; ok && i < num_features; ++i) {
+    const KeypointFeature &feature = features.features[i];
+    if (feature.descriptor.coords.size() != static_cast<int>(dimension)) {
+      LOG(ERROR) << "The descriptors of " << key.image_path
+                 << " have different sizes.";
+      ok = false;
+      break;
+    }
+    record[0] = feature.x();
+    record[1] = feature.y();
+    record[2] = feature.scale;
+    record[3] = feature.orientation;
+    for (unsigned int d = 0; d < dimension; ++d) {
+      record[4 + d] = feature.descriptor.coords(d);
+    }
+    ok = fwrite(&record[0], sizeof(float), record.size(), file) ==
+        record.size();
+  }
+  ok = fclose(file) == 0 && ok;
+  if (ok && std::rename(temporary.c_str(), filename.c_str()) != 0) {
+    // Windows does not replace an existing file.
+    std::remove(filename.c_str());
+    ok = std::rename(temporary.c_str(), filename.c_str()) == 0;
+  }
+  if (!ok) {
+    std::remove(temporary.c_str());
+    LOG(ERROR) << "Cannot write the feature cache " << filename;
+  }
+  return ok;
+}
+
+bool ReadFeatureCache(const std::string &filename,
+                      const FeatureCacheKey &key,
+                      FeatureSet *features) {
+  FILE *file = fopen(filename.c_str(), "rb");
+  if (!file) {
+    return false;
+  }
+  char magic[sizeof(kMagic)];
+  unsigned int header[kHeaderFields];
+  bool ok = fread(magic, sizeof(magic), 1, file) == 1 &&
+            memcmp(magic, kMagic, sizeof(kMagic)) == 0 &&
+            fread(header, sizeof(header), 1, file) == 1 &&
+            header[0] == kVersion &&
+            header[1] == key.content_size &&
+            header[2] == key.content_hash &&
+            header[3] == key.image_path.size() &&
+            header[4] == key.parameters.size();
+  if (ok) {
+    size_t strings_size = header[3] + header[4];
+    strings_size += Padding(sizeof(kMagic) + sizeof(header) + strings_size);
+    std::vector<char> strings(strings_size + 1);
+    ok = fread(&strings[0], 1, strings_size, file) == strings_size &&
+         key.image_path.compare(0, header[3], &strings[0], header[3]) == 0 &&
+         key.parameters.compare(0, header[4], &strings[header[3]],
+                                header[4]) == 0;
+  }
+  FeatureSet loaded;
+  if (ok) {
+    unsigned int num_features = header[5];
+    unsigned int dimension = header[6];
+    loaded.features.resize(num_features);
+    std::vector<float> record(4 + dimension);
+    for (unsigned int i = 0; ok && i < num_features; ++i) {
+      ok = fread(&record[0], sizeof(float), record.size(), file) ==
+          record.size();
+      KeypointFeature &feature = loaded.features[i];
+      feature.coords << record[0], record[1];
+      feature.scale = record[2];
+      feature.orientation = record[3];
+      feature.descriptor.coords.resize(dimension);
+      for (unsigned int d = 0; d < dimension; ++d) {
+        feature.descriptor.coords(d) = record[4 + d];
+      }
+    }
+  }
+  fclose(file);
+  if (ok) {
+    features->features.swap(loaded.features);
+  }
+  return ok;
+}
+
+}  // namespace libmv
@@ -0,0 +1,77 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_CORRESPONDENCE_FEATURE_CACHE_H_
+#define LIBMV_CORRESPONDENCE_FEATURE_CACHE_H_
+
+#include <string>
+
+#include "libmv/correspondence/feature_matching.h"
+
+namespace libmv {
+
+// Identifies the features of an image: they are only reused for the same
+// image file, with the same contents, and computed with the same detector and
+// describer parameters (any string describing them, chosen by the caller).
+struct FeatureCacheKey {
+  FeatureCacheKey() : content_size(0), content_hash(0) {}
+
+  std::string image_path;
+  unsigned int content_size;
+  unsigned int content_hash;  // FNV-1a of the contents.
+  std::string parameters;
+};
+
+// Reads the image file to fill its key. Returns false if it cannot be read.
+bool MakeFeatureCacheKey(const std::string &image_path,
+                         const std::string &parameters,
+                         FeatureCacheKey *key);
+
+// The name of the cache file of a key in directory, derived from the image
+// path and the parameters.
+std::string FeatureCacheFilename(const std::string &directory,
+                                 const FeatureCacheKey &key);
+
+// Feature cache files hold, in native byte order:
+//
+//   "LMVF", the version, then the content size, content hash, image path
+//   length, parameters length, number of features and descriptor dimension
+//   as 32 bit unsigned integers;
+//   the image path and the parameters, padded with zeros to a multiple of 16
+//   bytes;
+//   one record of 4 + dimension floats per feature: x, y, scale, orientation
+//   and the descriptor.
+//
+// The records are fixed size and aligned, so the file can be mapped and
+// indexed directly. The file is written under a temporary name and renamed,
+// so an interrupted run never leaves a truncated cache.
+bool WriteFeatureCache(const std::string &filename,
+                       const FeatureCacheKey &key,
+                       const FeatureSet &features);
+
+// Returns false, leaving features untouched, if the file does not exist, is
+// not a feature cache or was written for another key.
+bool ReadFeatureCache(const std::string &filename,
+                      const FeatureCacheKey &key,
+                      FeatureSet *features);
+
+}  // namespace libmv
+
+#endif  // LIBMV_CORRESPONDENCE_FEATURE_CACHE_H_
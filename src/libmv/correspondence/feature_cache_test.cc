@@ -0,0 +1,144 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstdio>
+#include <string>
+
+#include "libmv/correspondence/feature_cache.h"
+#include "testing/testing.h"
+
+namespace {
+
+using namespace libmv;
+
+std::string TemporaryFilename(const char *name) {
+  return std::string("/tmp/libmv_feature_cache_test_") + name;
+}
+
+void WriteFile(const std::string &filename, const char *contents) {
+  FILE *file = fopen(filename.c_str(), "wb");
+  fputs(contents, file);
+  fclose(file);
+}
+
+void MakeFeatures(int num_features, int dimension, FeatureSet *features) {
+  features->features.resize(num_features);
+  for (int i = 0; i < num_features; ++i) {
+    KeypointFeature &feature = features->features[i];
+    feature.coords << 1.5f * i, 100.25f - i;
+    feature.scale = 2 + i;
+    feature.orientation = 0.1f * i;
+    feature.descriptor.coords.resize(dimension);
+    for (int d = 0; d < dimension; ++d) {
+      feature.descriptor.coords(d) = i * dimension + d;
+    }
+  }
+}
+
+TEST(FeatureCache, KeyDependsOnTheContents) {
+  std::string image = TemporaryFilename("image.pgm");
+  WriteFile(image, "some pixels");
+  FeatureCacheKey key, same_key, other_key;
+  EXPECT_TRUE(MakeFeatureCacheKey(image, "FAST/DAISY", &key));
+  EXPECT_TRUE(MakeFeatureCacheKey(image, "FAST/DAISY", &same_key));
+  EXPECT_EQ(11, key.content_size);
+  EXPECT_EQ(key.content_hash, same_key.content_hash);
+  EXPECT_EQ(FeatureCacheFilename("/tmp", key),
+            FeatureCacheFilename("/tmp", same_key));
+
+  WriteFile(image, "other pixels");
+  EXPECT_TRUE(MakeFeatureCacheKey(image, "FAST/DAISY", &other_key));
+  EXPECT_NE(key.content_hash, other_key.content_hash);
+
+  // Other parameters use another file.
+  EXPECT_TRUE(MakeFeatureCacheKey(image, "STAR/DAISY", &other_key));
+  EXPECT_NE(FeatureCacheFilename("/tmp", key),
+            FeatureCacheFilename("/tmp", other_key));
+  EXPECT_FALSE(MakeFeatureCacheKey(TemporaryFilename("missing"), "",
+                                   &other_key));
+  std::remove(image.c_str());
+}
+
+TEST(FeatureCache, RoundTrip) {
+  FeatureCacheKey key;
+  key.image_path = "images/frame.png";
+  key.content_size = 1234;
+  key.content_hash = 0xdeadbeef;
+  key.parameters = "FAST/DIPOLE";
+
+  FeatureSet features;
+  MakeFeatures(7, 5, &features);
+  std::string cache = TemporaryFilename("round_trip.features");
+  EXPECT_TRUE(WriteFeatureCache(cache, key, features));
+
+  FeatureSet read;
+  EXPECT_TRUE(ReadFeatureCache(cache, key, &read));
+  ASSERT_EQ(features.features.size(), read.features.size());
+  for (int i = 0; i < features.features.size(); ++i) {
+    const KeypointFeature &a = features.features[i];
+    const KeypointFeature &b = read.features[i];
+    EXPECT_EQ(a.x(), b.x());
+    EXPECT_EQ(a.y(), b.y());
+    EXPECT_EQ(a.scale, b.scale);
+    EXPECT_EQ(a.orientation, b.orientation);
+    ASSERT_EQ(5, b.descriptor.coords.size());
+    for (int d = 0; d < 5; ++d) {
+      EXPECT_EQ(a.descriptor.coords(d), b.descriptor.coords(d));
+    }
+  }
+
+  // An empty set is cached too.
+  FeatureSet empty;
+  EXPECT_TRUE(WriteFeatureCache(cache, key, empty));
+  EXPECT_TRUE(ReadFeatureCache(cache, key, &read));
+  EXPECT_EQ(0, read.features.size());
+  std::remove(cache.c_str());
+}
+
+TEST(FeatureCache, RejectsOtherKeysAndOtherFiles) {
+  FeatureCacheKey key;
+  key.image_path = "frame.png";
+  key.content_size = 10;
+  key.content_hash = 42;
+  key.parameters = "SURF/SURF";
+  FeatureSet features;
+  MakeFeatures(3, 4, &features);
+  std::string cache = TemporaryFilename("keys.features");
+  EXPECT_TRUE(WriteFeatureCache(cache, key, features));
+
+  FeatureSet read;
+  FeatureCacheKey other = key;
+  other.content_hash = 43;
+  EXPECT_FALSE(ReadFeatureCache(cache, other, &read));
+  other = key;
+  other.parameters = "SURF/DAISY";
+  EXPECT_FALSE(ReadFeatureCache(cache, other, &read));
+  other = key;
+  other.image_path = "frame.jpg";
+  EXPECT_FALSE(ReadFeatureCache(cache, other, &read));
+  EXPECT_EQ(0, read.features.size());
+
+  WriteFile(cache, "LMVF but truncated");
+  EXPECT_FALSE(ReadFeatureCache(cache, key, &read));
+  std::remove(cache.c_str());
+  EXPECT_FALSE(ReadFeatureCache(cache, key, &read));
+}
+
+}  // namespace
@@ -0,0 +1,326 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include "libmv/base/scoped_ptr.h"
+#include "libmv/base/thread.h"
+#include "libmv/correspondence/brute_force_matching.h"
+#include "libmv/correspondence/feature_matcher_index.h"
+#include "libmv/logging/logging.h"
+
+using libmv::Mutex;
+using libmv::MutexLock;
+using libmv::scoped_ptr;
+
+namespace {
+
+// Guards the reference counts of all indices, as for images.
+Mutex *ReferenceCountMutex() {
+  static Mutex *mutex = new Mutex;
+  return mutex;
+}
+
+}  // namespace
+
+struct FeatureMatcherIndex::Storage {
+  Storage() : matcher(NULL), ref_count(1) {}
+
+  eLibmvMatchMethod method;
+  int num_rows;
+  int dimension;
+  // Kept for the lifetime of the matcher: the FLANN index refers to them.
+  std::vector<float> rows;
+  scoped_ptr<correspondence::ArrayMatcher<float> > matcher;
+  // Serializes the searches.
+  Mutex search_mutex;
+  int ref_count;
+};
+
+FeatureMatcherIndex::FeatureMatcherIndex() : storage_(NULL) {}
+
+FeatureMatcherIndex::FeatureMatcherIndex(const FeatureMatcherIndex &index)
+    : storage_(index.storage_) {
+  Acquire();
+}
+
+FeatureMatcherIndex &FeatureMatcherIndex::operator=(
+    const FeatureMatcherIndex &index) {
+  if (storage_ != index.storage_) {
+    Release();
+    storage_ = index.storage_;
+    Acquire();
+  }
+  return *this;
+}
+
+FeatureMatcherIndex::~FeatureMatcherIndex() {
+  Release();
+}
+
+bool FeatureMatcherIndex::Build(const FeatureSet &features,
+                                eLibmvMatchMethod method) {
+  if (features.features.size() == 0) {
+    Clear();
+    return false;
+  }
+  int dimension = features.features[0].descriptor.coords.size();
+  std::vector<float> rows(features.features.size() * dimension);
+  for (int i = 0; i < features.features.size(); ++i) {
+    const descriptor::VecfDescriptor &descriptor =
+        features.features[i].descriptor;
+    if (descriptor.coords.size() != dimension) {
+      LOG(INFO) << "[FeatureMatcherIndex] The descriptors have different "
+                << "sizes.";
+      Clear();
+      return false;
+    }
+    for (int j = 0; j < dimension; ++j) {
+      rows[i * dimension + j] = descriptor.coords(j);
+    }
+  }
+  return Build(&rows[0], features.features.size(), dimension, method);
+}
+
+bool FeatureMatcherIndex::Build(const float *rows, int num_rows,
+                                int dimension, eLibmvMatchMethod method) {
+  Clear();
+  if (num_rows <= 0 || dimension <= 0) {
+    return false;
+  }
+  scoped_ptr<Storage> storage(new Storage);
+  storage->method = method;
+  storage->num_rows = num_rows;
+  storage->dimension = dimension;
+  storage->rows.assign(rows, rows + num_rows * dimension);
+  storage->matcher.reset(CreateArrayMatcher(method));
+  if (!storage->matcher.get()) {
+    LOG(INFO) << "[FeatureMatcherIndex] Unknown input match method.";
+    return false;
+  }
+  // The searches of a single pair use the whole pool; nested in the parallel
+  // matching of many pairs they stay on the calling thread.
+  storage->matcher->SetNumThreads(libmv::NumThreads());
+  if (!storage->matcher->build(&storage->rows[0], num_rows, dimension)) {
+    return false;
+  }
+  storage_ = storage.release();
+  return true;
+}
+
+void FeatureMatcherIndex::Clear() {
+  Release();
+}
+
+eLibmvMatchMethod FeatureMatcherIndex::Method() const {
+  assert(storage_);
+  return storage_->method;
+}
+
+int FeatureMatcherIndex::NumRows() const {
+  return storage_ ? storage_->num_rows : 0;
+}
+
+int FeatureMatcherIndex::Dimension() const {
+  return storage_ ? storage_->dimension : 0;
+}
+
+const float *FeatureMatcherIndex::Rows() const {
+  return storage_ ? &storage_->rows[0] : NULL;
+}
+
+int FeatureMatcherIndex::UseCount() const {
+  if (!storage_) {
+    return 0;
+  }
+  MutexLock lock(ReferenceCountMutex());
+  return storage_->ref_count;
+}
+
+bool FeatureMatcherIndex::Search(const float *queries, int num_queries,
+                                 int NN,
+                                 libmv::vector<int> *indices,
+                                 libmv::vector<float> *distances) const {
+  indices->clear();
+  distances->clear();
+  if (!storage_) {
+    return false;
+  }
+  MutexLock lock(&storage_->search_mutex);
+  return storage_->matcher->searchNeighbours(queries, num_queries, indices,
+                                             distances, NN);
+}
+
+size_t FeatureMatcherIndex::MemorySizeInBytes() const {
+  return storage_ ? storage_->rows.size() * sizeof(float) : 0;
+}
+
+void FeatureMatcherIndex::Acquire() {
+  if (storage_) {
+    MutexLock lock(ReferenceCountMutex());
+    ++storage_->ref_count;
+  }
+}
+
+void FeatureMatcherIndex::Release() {
+  if (!storage_) {
+    return;
+  }
+  {
+    MutexLock lock(ReferenceCountMutex());
+    if (--storage_->ref_count > 0) {
+      storage_ = NULL;
+      return;
+    }
+  }
+  delete storage_;
+  storage_ = NULL;
+}
+
+namespace {
+
+// Forward search of the left rows in right_index, then reverse search of the
+// right rows that are the nearest neighbor of some left row only: the others
+// cannot be in a mutual pair. right_ids[j] is -1 for the rows not searched.
+bool MutualNearestNeighbors(const FeatureMatcherIndex &left_index,
+                            const FeatureMatcherIndex &right_index,
+                            libmv::vector<int> *left_ids,
+                            libmv::vector<int> *right_ids) {
+  const int NN = 1;
+  libmv::vector<float> distances;
+  if (!right_index.Search(left_index.Rows(), left_index.NumRows(), NN,
+                          left_ids, &distances)) {
+    return false;
+  }
+  int dimension = right_index.Dimension();
+  std::vector<char> is_candidate(right_index.NumRows(), 0);
+  std::vector<float> queries;
+  std::vector<int> candidates;
+  for (size_t i = 0; i < left_ids->size(); ++i) {
+    int j = (*left_ids)[i];
+    if (j >= 0 && !is_candidate[j]) {
+      is_candidate[j] = 1;
+      candidates.push_back(j);
+      const float *row = right_index.Rows() + j * dimension;
+      queries.insert(queries.end(), row, row + dimension);
+    }
+  }
+  right_ids->resize(right_index.NumRows());
+  std::fill(right_ids->begin(), right_ids->end(), -1);
+  if (candidates.empty()) {
+    return true;
+  }
+  libmv::vector<int> reverse_ids;
+  if (!left_index.Search(&queries[0], candidates.size(), NN,
+                         &reverse_ids, &distances)) {
+    return false;
+  }
+  for (size_t k = 0; k < candidates.size(); ++k) {
+    (*right_ids)[candidates[k]] = reverse_ids[k];
+  }
+  return true;
+}
+
+}  // namespace
+
+void FindCandidateMatches(const FeatureSet &left,
+                          const FeatureMatcherIndex &left_index,
+                          const FeatureSet &right,
+                          const FeatureMatcherIndex &right_index,
+                          Matches *matches) {
+  LIBMV_SCOPED_TIMER("match");
+  if (left_index.IsEmpty() || right_index.IsEmpty())  {
+    return;
+  }
+  assert(left_index.NumRows() == left.features.size());
+  assert(right_index.NumRows() == right.features.size());
+  assert(left_index.Dimension() == right_index.Dimension());
+
+  libmv::vector<int> indices, indicesReverse;
+  if (left_index.Method() == eMATCH_LINEAR &&
+      right_index.Method() == eMATCH_LINEAR) {
+    // The distance matrix is computed once for both directions.
+    indices.resize(left_index.NumRows());
+    indicesReverse.resize(right_index.NumRows());
+    std::vector<float> distances(indices.size());
+    std::vector<float> distancesReverse(indicesReverse.size());
+    BruteForceMutualNearestNeighbors(left_index.Rows(), left_index.NumRows(),
+                                     right_index.Rows(), right_index.NumRows(),
+                                     left_index.Dimension(),
+                                     &indices[0], &distances[0],
+                                     &indicesReverse[0], &distancesReverse[0],
+                                     libmv::NumThreads());
+  } else if (!MutualNearestNeighbors(left_index, right_index,
+                                     &indices, &indicesReverse)) {
+    LOG(INFO) << "[FindCandidateMatches] Cannot compute symmetric matches.";
+    return;
+  }
+
+  // From putative matches get symmetric matches.
+  int max_track_number = 0;
+  for (size_t i = 0; i < indices.size(); ++i) {
+    // Add the match only if we have a symmetric result.
+    if (indices[i] >= 0 && i == indicesReverse[indices[i]])  {
+      matches->Insert(0, max_track_number, &left.features[i]);
+      matches->Insert(1, max_track_number, &right.features[indices[i]]);
+      ++max_track_number;
+    }
+  }
+}
+
+void FindCandidateMatches_Ratio(const FeatureSet &left,
+                                const FeatureMatcherIndex &left_index,
+                                const FeatureSet &right,
+                                const FeatureMatcherIndex &right_index,
+                                Matches *matches,
+                                float fRatio) {
+  LIBMV_SCOPED_TIMER("match");
+  if (left_index.IsEmpty() || right_index.IsEmpty())  {
+    return;
+  }
+  assert(left_index.NumRows() == left.features.size());
+  assert(right_index.NumRows() == right.features.size());
+
+  const int NN = 2;
+  libmv::vector<int> indices;
+  libmv::vector<float> distances;
+  if (!right_index.Search(left_index.Rows(), left_index.NumRows(), NN,
+                          &indices, &distances))  {
+    LOG(INFO) << "[FindCandidateMatches_Ratio] Cannot compute matches.";
+    return;
+  }
+
+  // From putative matches get matches that fit the "Ratio" heuristic.
+  int max_track_number = 0;
+  for (size_t i = 0; i < left.features.size(); ++i) {
+    // Test distance ratio :
+    float distance0 = distances[i*NN];
+    float distance1 = distances[i*NN+NN-1];
+
+    if (distance0 < fRatio * distance1) {
+      matches->Insert(0, max_track_number, &left.features[i]);
+      matches->Insert(1, max_track_number, &right.features[indices[i*NN]]);
+      ++max_track_number;
+    }
+  }
+}
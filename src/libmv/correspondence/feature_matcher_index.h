@@ -0,0 +1,107 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+#ifndef LIBMV_CORRESPONDENCE_FEATURE_MATCHER_INDEX_H_
+#define LIBMV_CORRESPONDENCE_FEATURE_MATCHER_INDEX_H_
+
+#include "libmv/base/vector.h"
+#include "libmv/correspondence/feature_matching.h"
+
+// The matcher of one FeatureSet, built once on a contiguous copy of its
+// descriptors and then searched by every pair the set is matched in, instead
+// of being rebuilt for each pair by FindCandidateMatches().
+//
+// Copies of an index share the same matcher, which is reference counted and
+// deleted with the last copy, so the index can be kept next to its feature set
+// (in maps, caches, or the feature sets of several pipelines) without building
+// or copying it again. Search() is thread safe: the searches of one index are
+// serialized, since some matchers keep scratch memory between queries, while
+// different indices are searched in parallel. The index does not follow later
+// changes of the features; build it again after changing them.
+class FeatureMatcherIndex {
+ public:
+  // An empty index.
+  FeatureMatcherIndex();
+  FeatureMatcherIndex(const FeatureMatcherIndex &index);
+  FeatureMatcherIndex &operator=(const FeatureMatcherIndex &index);
+  ~FeatureMatcherIndex();
+
+  // Builds the matcher of method on the descriptors of features. Returns
+  // false, leaving the index empty, if there are no features or the matcher
+  // cannot be built.
+  bool Build(const FeatureSet &features, eLibmvMatchMethod method);
+  // Same, on num_rows descriptors of dimension floats, copied from rows.
+  bool Build(const float *rows, int num_rows, int dimension,
+             eLibmvMatchMethod method);
+  void Clear();
+
+  bool IsEmpty() const { return storage_ == NULL; }
+  eLibmvMatchMethod Method() const;
+  int NumRows() const;
+  int Dimension() const;
+  // The descriptors the index is built on, one row per feature; they are the
+  // queries when this set is matched against another index. NULL if empty.
+  const float *Rows() const;
+  // The number of indices sharing the matcher, 0 if empty.
+  int UseCount() const;
+
+  // Searches the NN nearest rows of each of the num_queries queries, written
+  // in indices and distances as by ArrayMatcher::searchNeighbours(). Returns
+  // false if the index is empty or the matcher fails.
+  bool Search(const float *queries, int num_queries, int NN,
+              libmv::vector<int> *indices,
+              libmv::vector<float> *distances) const;
+
+  // Approximate memory used by the rows, not counting the matcher itself.
+  size_t MemorySizeInBytes() const;
+
+ private:
+  struct Storage;
+
+  void Acquire();
+  void Release();
+
+  Storage *storage_;
+};
+
+// Same as FindCandidateMatches(), with the indices of left and right built
+// beforehand (with the same method), so that a set matched in several pairs
+// builds its matcher only once. Both directions are searched together: with
+// eMATCH_LINEAR the distances are computed once (see
+// BruteForceMutualNearestNeighbors()), and with the other methods only the
+// right features that are the nearest neighbor of a left one are searched
+// back.
+void FindCandidateMatches(const FeatureSet &left,
+                          const FeatureMatcherIndex &left_index,
+                          const FeatureSet &right,
+                          const FeatureMatcherIndex &right_index,
+                          Matches *matches);
+
+// Same as FindCandidateMatches_Ratio(), with the index of right built
+// beforehand; the queries are the rows of left_index.
+void FindCandidateMatches_Ratio(const FeatureSet &left,
+                                const FeatureMatcherIndex &left_index,
+                                const FeatureSet &right,
+                                const FeatureMatcherIndex &right_index,
+                                Matches *matches,
+                                float fRatio = 0.8f);
+
+#endif  // LIBMV_CORRESPONDENCE_FEATURE_MATCHER_INDEX_H_
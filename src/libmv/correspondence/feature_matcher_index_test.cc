@@ -0,0 +1,148 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+#include "libmv/base/thread.h"
+#include "libmv/correspondence/feature_matcher_index.h"
+#include "testing/testing.h"
+
+namespace {
+
+using namespace libmv;
+
+// Features whose descriptors have a single nearest neighbor in the other set:
+// the right set is the left one shifted a little and reversed.
+void MakeFeatures(int num_features, float shift, bool reverse,
+                  FeatureSet *features) {
+  const int kDimension = 4;
+  features->features.resize(num_features);
+  for (int i = 0; i < num_features; ++i) {
+    int row = reverse ? num_features - 1 - i : i;
+    KeypointFeature &feature = features->features[i];
+    feature.coords << i, i;
+    feature.descriptor.coords.resize(kDimension);
+    for (int d = 0; d < kDimension; ++d) {
+      feature.descriptor.coords(d) = 10 * row + d + shift;
+    }
+  }
+}
+
+void ExpectSameMatches(const Matches &expected, const Matches &matches) {
+  ASSERT_EQ(expected.NumTracks(), matches.NumTracks());
+  for (int track = 0; track < expected.NumTracks(); ++track) {
+    EXPECT_EQ(expected.Get(0, track), matches.Get(0, track));
+    EXPECT_EQ(expected.Get(1, track), matches.Get(1, track));
+  }
+}
+
+TEST(FeatureMatcherIndex, CopiesShareTheMatcher) {
+  FeatureSet features;
+  MakeFeatures(10, 0, false, &features);
+  FeatureMatcherIndex index;
+  EXPECT_TRUE(index.IsEmpty());
+  EXPECT_EQ(0, index.UseCount());
+  ASSERT_TRUE(index.Build(features, eMATCH_LINEAR));
+  EXPECT_EQ(10, index.NumRows());
+  EXPECT_EQ(4, index.Dimension());
+  EXPECT_EQ(1, index.UseCount());
+  {
+    FeatureMatcherIndex copy(index), other;
+    other = copy;
+    EXPECT_EQ(3, index.UseCount());
+    EXPECT_EQ(index.Rows(), other.Rows());
+  }
+  EXPECT_EQ(1, index.UseCount());
+  EXPECT_EQ(20, index.Rows()[2 * 4]);
+
+  index.Clear();
+  EXPECT_TRUE(index.IsEmpty());
+  EXPECT_FALSE(index.Build(FeatureSet(), eMATCH_LINEAR));
+  EXPECT_TRUE(index.IsEmpty());
+}
+
+TEST(FeatureMatcherIndex, SameMatchesAsWithoutIndex) {
+  FeatureSet left, right;
+  MakeFeatures(50, 0, false, &left);
+  MakeFeatures(50, 0.5, true, &right);
+
+  eLibmvMatchMethod methods[] = {
+    eMATCH_LINEAR, eMATCH_KDTREE, eMATCH_KDTREE_FLANN, eMATCH_KDTREE_FOREST
+  };
+  for (int m = 0; m < 4; ++m) {
+    Matches expected;
+    FindCandidateMatches(left, right, &expected, methods[m]);
+    EXPECT_EQ(50, expected.NumTracks());
+
+    FeatureMatcherIndex left_index, right_index;
+    ASSERT_TRUE(left_index.Build(left, methods[m]));
+    ASSERT_TRUE(right_index.Build(right, methods[m]));
+    // The indices can be reused.
+    for (int k = 0; k < 2; ++k) {
+      Matches matches;
+      FindCandidateMatches(left, left_index, right, right_index, &matches);
+      ExpectSameMatches(expected, matches);
+    }
+
+    if (methods[m] == eMATCH_KDTREE) {
+      // No ratio test without a second neighbor.
+      continue;
+    }
+    Matches expected_ratio, ratio;
+    FindCandidateMatches_Ratio(left, right, &expected_ratio, methods[m]);
+    FindCandidateMatches_Ratio(left, left_index, right, right_index, &ratio);
+    ExpectSameMatches(expected_ratio, ratio);
+  }
+}
+
+// Matches every set with the next one, sharing the indices between threads.
+struct PairMatcher {
+  const std::vector<FeatureSet> *features;
+  const std::vector<FeatureMatcherIndex> *indices;
+  std::vector<int> *num_tracks;
+
+  void operator()(int i) const {
+    int j = (i + 1) % features->size();
+    Matches matches;
+    FindCandidateMatches((*features)[i], (*indices)[i],
+                         (*features)[j], (*indices)[j], &matches);
+    (*num_tracks)[i] = matches.NumTracks();
+  }
+};
+
+TEST(FeatureMatcherIndex, SearchFromSeveralThreads) {
+  const int kNumSets = 16;
+  std::vector<FeatureSet> features(kNumSets);
+  std::vector<FeatureMatcherIndex> indices(kNumSets);
+  for (int i = 0; i < kNumSets; ++i) {
+    MakeFeatures(30, 0.1 * i, i % 2 == 1, &features[i]);
+    ASSERT_TRUE(indices[i].Build(features[i], eMATCH_KDTREE_FOREST));
+  }
+  std::vector<int> num_tracks(kNumSets, 0);
+  PairMatcher matcher;
+  matcher.features = &features;
+  matcher.indices = &indices;
+  matcher.num_tracks = &num_tracks;
+  ParallelFor(0, kNumSets, 4, &matcher);
+  for (int i = 0; i < kNumSets; ++i) {
+    EXPECT_EQ(30, num_tracks[i]);
+  }
+}
+
+}  // namespace
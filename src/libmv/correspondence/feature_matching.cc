@@ -1,293 +1,358 @@
-// Copyright (c) 2009 libmv authors.
-//
-// Permission is hereby granted, free of charge, to any person obtaining a copy
-// of this software and associated documentation files (the "Software"), to
-// deal in the Software without restriction, including without limitation the
-// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
-// sell copies of the Software, and to permit persons to whom the Software is
-// furnished to do so, subject to the following conditions:
-//
-// The above copyright notice and this permission notice shall be included in
-// all copies or substantial portions of the Software.
-//
-// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
-// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
-// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
-// IN THE SOFTWARE.
-
-#include "libmv/correspondence/feature_matching.h"
-
-#include "libmv/correspondence/ArrayMatcher.h"
-#include "libmv/correspondence/ArrayMatcher_BruteForce.h"
-#include "libmv/correspondence/ArrayMatcher_Kdtree_Flann.h"
-#include "libmv/correspondence/ArrayMatcher_Kdtree.h"
-
-// Compute candidate matches between 2 sets of features.  Two features A and B
-// are a candidate match if A is the nearest neighbor of B and B is the nearest
-// neighbor of A.
-void FindCandidateMatches(const FeatureSet &left,
-                          const FeatureSet &right,
-                          Matches *matches,
-                          eLibmvMatchMethod eMatchMethod) {
-  if (left.features.size() == 0 ||
-      right.features.size() == 0 )  {
-    return;
-  }
-  int descriptorSize = left.features[0].descriptor.coords.size();
-
-  correspondence::ArrayMatcher<float> * pArrayMatcherA = NULL;
-  correspondence::ArrayMatcher<float> * pArrayMatcherB = NULL;
-  switch (eMatchMethod)
-  {
-  case eMATCH_KDTREE:
-    {
-      // Build the arrays matcher in order to compute matches pair.
-      pArrayMatcherA = new correspondence::ArrayMatcher_Kdtree<float>;
-      pArrayMatcherB = new correspondence::ArrayMatcher_Kdtree<float>;
-    }
-    break;
-    case eMATCH_KDTREE_FLANN:
-    {
-      // Build the arrays matcher in order to compute matches pair.
-      pArrayMatcherA = new correspondence::ArrayMatcher_Kdtree_Flann<float>;
-      pArrayMatcherB = new correspondence::ArrayMatcher_Kdtree_Flann<float>;
-    }
-    break;
-    case eMATCH_LINEAR:
-    {
-      // Build the arrays matcher in order to compute matches pair.
-      pArrayMatcherA = new correspondence::ArrayMatcher_BruteForce<float>;
-      pArrayMatcherB = new correspondence::ArrayMatcher_BruteForce<float>;
-    }
-    break;
-  };
-
-  if (pArrayMatcherA != NULL && pArrayMatcherB != NULL) {
-
-    // Paste the necessary data in contiguous arrays.
-    float * arrayA = FeatureSet::FeatureSetDescriptorsToContiguousArray(left);
-    float * arrayB = FeatureSet::FeatureSetDescriptorsToContiguousArray(right);
-
-    libmv::vector<int> indices, indicesReverse;
-    libmv::vector<float> distances, distancesReverse;
-
-    bool breturn = false;
-    if (pArrayMatcherA->build(arrayA,left.features.size(),descriptorSize) &&
-        pArrayMatcherB->build(arrayB,right.features.size(),descriptorSize) )  {
-
-      const int NN = 1;
-      breturn =
-        pArrayMatcherB->searchNeighbours(arrayA,left.features.size(),
-          &indices, &distances, NN) &&
-        pArrayMatcherA->searchNeighbours(arrayB,right.features.size(),
-          &indicesReverse, &distancesReverse, NN);
-    }
-    delete pArrayMatcherA;
-    delete pArrayMatcherB;
-
-    delete [] arrayA;
-    delete [] arrayB;
-
-    // From putative matches get symmetric matches.
-    if (breturn)  {
-      //TODO(pmoulon) clear previous matches.
-      int max_track_number = 0;
-      for (size_t i = 0; i < indices.size(); ++i) {
-        // Add the match only if we have a symmetric result.
-        if (i == indicesReverse[indices[i]])  {
-          matches->Insert(0, max_track_number, &left.features[i]);
-          matches->Insert(1, max_track_number, &right.features[indices[i]]);
-          ++max_track_number;
-        }
-      }
-    }
-    else  {
-      LOG(INFO) << "[FindCandidateMatches] Cannot compute symmetric matches.";
-    }
-  }
-  else  {
-    LOG(INFO) << "[FindCandidateMatches] Unknown input match method.";
-  }
-}
-
-float * FeatureSet::FeatureSetDescriptorsToContiguousArray
-  ( const FeatureSet & featureSet ) {
-
-  if (featureSet.features.size() == 0)  {
-    return NULL;
-  }
-  int descriptorSize = featureSet.features[0].descriptor.coords.size();
-  // Allocate and paste the necessary data.
-  float * array = new float[featureSet.features.size()*descriptorSize];
-
-  //-- Paste data in the contiguous array :
-  for (int i = 0; i < (int)featureSet.features.size(); ++i) {
-    for (int j = 0;j < descriptorSize; ++j)
-      array[descriptorSize*i + j] = (float)featureSet.features[i][j];
-  }
-  return array;
-}
-
-// Compute candidate matches between 2 sets of features with a ratio.
-void FindCandidateMatches_Ratio(const FeatureSet &left,
-                          const FeatureSet &right,
-                          Matches *matches,
-                          eLibmvMatchMethod eMatchMethod,
-                          float fRatio) {
-
-  if (left.features.size() == 0 ||
-      right.features.size() == 0 )  {
-    return;
-  }
-  int descriptorSize = left.features[0].descriptor.coords.size();
-
-  correspondence::ArrayMatcher<float> * pArrayMatcherA = NULL;
-  switch (eMatchMethod)
-  {
-  case eMATCH_KDTREE:
-    {
-      // Build the arrays matcher in order to compute matches pair.
-      pArrayMatcherA = new correspondence::ArrayMatcher_Kdtree<float>;
-    }
-    break;
-    case eMATCH_KDTREE_FLANN:
-    {
-      // Build the arrays matcher in order to compute matches pair.
-      pArrayMatcherA = new correspondence::ArrayMatcher_Kdtree_Flann<float>;
-    }
-    break;
-    case eMATCH_LINEAR:
-    {
-      // Build the arrays matcher in order to compute matches pair.
-      LOG(INFO) << "Not yet implemented.";
-      return;
-    }
-    break;
-  };
-
-  const int NN = 2;
-  if (pArrayMatcherA != NULL) {
-
-    // Paste the necessary data in contiguous arrays.
-    float * arrayA = FeatureSet::FeatureSetDescriptorsToContiguousArray(left);
-    float * arrayB = FeatureSet::FeatureSetDescriptorsToContiguousArray(right);
-
-    libmv::vector<int> indices;
-    libmv::vector<float> distances;
-
-    bool breturn = false;
-    if (pArrayMatcherA->build(arrayB,right.features.size(),descriptorSize))  {
-      breturn =
-        pArrayMatcherA->searchNeighbours(arrayA,left.features.size(),
-          &indices, &distances, NN);
-    }
-    delete pArrayMatcherA;
-    delete [] arrayA;
-    delete [] arrayB;
-
-    // From putative matches get matches that fit the "Ratio" heuristic.
-    if (breturn)  {
-      //TODO(pmoulon) clear previous matches.
-      int max_track_number = 0;
-
-      for (size_t i = 0; i < left.features.size(); ++i) {
-        // Test distance ratio :
-        float distance0 = distances[i*NN];
-        float distance1 = distances[i*NN+NN-1];
-
-        if (distance0 < fRatio * distance1) {
-          matches->Insert(0, max_track_number, &left.features[i]);
-          matches->Insert(1, max_track_number, &right.features[indices[i*NN]]);
-          ++max_track_number;
-        }
-      }
-    }
-    else  {
-      LOG(INFO) << "[FindCandidateMatches_Ratio] Cannot compute matches.";
-    }
-  }
-  else  {
-    LOG(INFO) << "[FindCandidateMatches_Ratio] Unknow input match method.";
-  }
-}
-
-
-// Compute correspondences that match between 2 sets of features with a ratio.
-void FindCorrespondences(const FeatureSet &left,
-                         const FeatureSet &right,
-                         std::map<size_t, size_t> *correspondences,
-                         eLibmvMatchMethod eMatchMethod,
-                         float fRatio) {
-  if (left.features.size() == 0 ||
-      right.features.size() == 0 )  {
-    return;
-  }
-  int descriptorSize = left.features[0].descriptor.coords.size();
-
-  correspondence::ArrayMatcher<float> * pArrayMatcherA = NULL;
-  switch (eMatchMethod)
-  {
-  case eMATCH_KDTREE:
-    {
-      // Build the arrays matcher in order to compute matches pair.
-      pArrayMatcherA = new correspondence::ArrayMatcher_Kdtree<float>;
-    }
-    break;
-    case eMATCH_KDTREE_FLANN:
-    {
-      // Build the arrays matcher in order to compute matches pair.
-      pArrayMatcherA = new correspondence::ArrayMatcher_Kdtree_Flann<float>;
-    }
-    break;
-    case eMATCH_LINEAR:
-    {
-      // Build the arrays matcher in order to compute matches pair.
-      LOG(INFO) << "Not yet implemented.";
-      return;
-    }
-    break;
-  };
-
-  const int NN = 2;
-  if (pArrayMatcherA != NULL) {
-
-    // Paste the necessary data in contiguous arrays.
-    float * arrayA = FeatureSet::FeatureSetDescriptorsToContiguousArray(left);
-    float * arrayB = FeatureSet::FeatureSetDescriptorsToContiguousArray(right);
-
-    libmv::vector<int> indices;
-    libmv::vector<float> distances;
-
-    bool breturn = false;
-    if (pArrayMatcherA->build(arrayB,right.features.size(),descriptorSize))  {
-      breturn =
-        pArrayMatcherA->searchNeighbours(arrayA,left.features.size(),
-          &indices, &distances, NN);
-    }
-    delete pArrayMatcherA;
-    delete [] arrayA;
-    delete [] arrayB;
-
-    // From putative matches get matches that fit the "Ratio" heuristic.
-    if (breturn)  {
-      for (size_t i = 0; i < left.features.size(); ++i) {
-        // Test distance ratio :
-        float distance0 = distances[i*NN];
-        float distance1 = distances[i*NN+NN-1];
-
-        if (distance0 < fRatio * distance1) {
-          (*correspondences)[i] = indices[i*NN];
-        }
-      }
-    }
-    else  {
-      LOG(INFO) << "[FindCandidateMatches_Ratio] Cannot compute matches.";
-    }
-  }
-  else  {
-    LOG(INFO) << "[FindCandidateMatches_Ratio] Unknow input match method.";
-  }
-}
+// Copyright (c) 2009 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/correspondence/feature_matching.h"
+
+#include <cstdlib>
+
+#include "libmv/base/autotune.h"
+#include "libmv/correspondence/ArrayMatcher.h"
+#include "libmv/correspondence/ArrayMatcher_BruteForce.h"
+#include "libmv/correspondence/ArrayMatcher_CascadeHashing.h"
+#include "libmv/correspondence/ArrayMatcher_Kdtree_Flann.h"
+#include "libmv/correspondence/ArrayMatcher_Kdtree.h"
+#include "libmv/correspondence/ArrayMatcher_KdtreeForest.h"
+#include "libmv/correspondence/ArrayMatcher_Quantized.h"
+#include "libmv/correspondence/feature_matcher_index.h"
+#include "libmv/logging/logging.h"
+
+namespace {
+
+// The settings of the FLANN kd-trees tried by the tuning; the first one is
+// the default.
+struct FlannPreset {
+  int trees;
+  int checks;
+};
+const FlannPreset kFlannPresets[] = {
+  { 8, 32 }, { 2, 32 }, { 4, 16 }, { 4, 32 }, { 4, 64 }, { 8, 16 },
+  { 8, 64 }, { 16, 32 }, { 16, 64 }
+};
+const int kNumFlannPresets = sizeof(kFlannPresets) / sizeof(kFlannPresets[0]);
+
+// Matches noisy copies of SIFT sized random descriptors against them, the
+// index built with the calibrated preset. A preset is accepted if it finds
+// the exact nearest neighbour of as many queries as the default.
+class FlannCalibration : public Calibration {
+ public:
+  FlannCalibration()
+    : dataset_(kNumRows * kDimension), queries_(kNumQueries * kDimension),
+      nearest_(kNumQueries) {
+    srand(1);
+    for (int i = 0; i < dataset_.size(); ++i) {
+      dataset_[i] = rand() / static_cast<float>(RAND_MAX);
+    }
+    for (int q = 0; q < kNumQueries; ++q) {
+      const float *row = &dataset_[(q * 7 % kNumRows) * kDimension];
+      for (int d = 0; d < kDimension; ++d) {
+        queries_[q * kDimension + d] =
+          row[d] + 0.2f * (rand() / static_cast<float>(RAND_MAX) - 0.5f);
+      }
+    }
+    correspondence::ArrayMatcher_BruteForce<float> exact;
+    exact.build(&dataset_[0], kNumRows, kDimension);
+    libmv::vector<float> distances;
+    exact.searchNeighbours(&queries_[0], kNumQueries, &nearest_, &distances,
+                           1);
+    default_found_ = NumFound(0);
+  }
+
+  void Run(int preset) {
+    libmv::vector<int> indices;
+    Search(preset, &indices);
+  }
+
+  bool Accepts(int preset) {
+    return NumFound(preset) >= default_found_;
+  }
+
+ private:
+  void Search(int preset, libmv::vector<int> *indices) {
+    correspondence::ArrayMatcher_Kdtree_Flann<float> matcher(
+        kFlannPresets[preset].trees, kFlannPresets[preset].checks);
+    libmv::vector<float> distances;
+    matcher.build(&dataset_[0], kNumRows, kDimension);
+    matcher.searchNeighbours(&queries_[0], kNumQueries, indices, &distances,
+                             1);
+  }
+
+  int NumFound(int preset) {
+    libmv::vector<int> indices;
+    Search(preset, &indices);
+    int found = 0;
+    for (int q = 0; q < kNumQueries; ++q) {
+      found += indices[q] == nearest_[q];
+    }
+    return found;
+  }
+
+  static const int kNumRows = 2000;
+  static const int kNumQueries = 500;
+  static const int kDimension = 128;
+  libmv::vector<float> dataset_;
+  libmv::vector<float> queries_;
+  libmv::vector<int> nearest_;
+  int default_found_;
+};
+
+int TunedFlannPreset() {
+  if (!AutoTuning()) {
+    return 0;
+  }
+  std::vector<int> candidates;
+  for (int i = 0; i < kNumFlannPresets; ++i) {
+    candidates.push_back(i);
+  }
+  FlannCalibration calibration;
+  int preset = TunedValue("flann_kdtree_preset", 0, candidates, &calibration);
+  return 0 <= preset && preset < kNumFlannPresets ? preset : 0;
+}
+
+}  // namespace
+
+void FlannKdtreeParameters(int *trees, int *checks) {
+  // Tuned on first use, which is thread safe with GCC and C++11 compilers.
+  static const int preset = TunedFlannPreset();
+  *trees = kFlannPresets[preset].trees;
+  *checks = kFlannPresets[preset].checks;
+}
+
+correspondence::ArrayMatcher<float> *CreateArrayMatcher(
+    eLibmvMatchMethod eMatchMethod) {
+  int trees, checks;
+  switch (eMatchMethod) {
+    case eMATCH_KDTREE:
+      return new correspondence::ArrayMatcher_Kdtree<float>;
+    case eMATCH_KDTREE_FLANN:
+      FlannKdtreeParameters(&trees, &checks);
+      return new correspondence::ArrayMatcher_Kdtree_Flann<float>(trees,
+                                                                  checks);
+    case eMATCH_KDTREE_FOREST:
+      return new correspondence::ArrayMatcher_KdtreeForest<float>;
+    case eMATCH_LINEAR:
+      return new correspondence::ArrayMatcher_BruteForce<float>;
+    case eMATCH_LINEAR_QUANTIZED:
+      return new correspondence::ArrayMatcher_Quantized;
+    case eMATCH_CASCADE_HASHING:
+      return new correspondence::ArrayMatcher_CascadeHashing<float>;
+  };
+  return NULL;
+}
+
+// Compute candidate matches between 2 sets of features.  Two features A and B
+// are a candidate match if A is the nearest neighbor of B and B is the nearest
+// neighbor of A.
+void FindCandidateMatches(const FeatureSet &left,
+                          const FeatureSet &right,
+                          Matches *matches,
+                          eLibmvMatchMethod eMatchMethod) {
+  if (left.features.size() == 0 ||
+      right.features.size() == 0 )  {
+    return;
+  }
+  FeatureMatcherIndex left_index, right_index;
+  if (!left_index.Build(left, eMatchMethod) ||
+      !right_index.Build(right, eMatchMethod))  {
+    LOG(INFO) << "[FindCandidateMatches] Cannot build the matchers.";
+    return;
+  }
+  FindCandidateMatches(left, left_index, right, right_index, matches);
+}
+
+void FindCandidateMatches(const FeatureSet &left,
+                          const QuantizedDescriptors &left_descriptors,
+                          const FeatureSet &right,
+                          const QuantizedDescriptors &right_descriptors,
+                          Matches *matches) {
+  LIBMV_SCOPED_TIMER("match");
+  if (left_descriptors.num_rows == 0 ||
+      right_descriptors.num_rows == 0 )  {
+    return;
+  }
+  assert(left_descriptors.num_rows == left.features.size());
+  assert(right_descriptors.num_rows == right.features.size());
+  assert(left_descriptors.dimension == right_descriptors.dimension);
+
+  const int NN = 1;
+  libmv::vector<int> indices(left_descriptors.num_rows);
+  libmv::vector<int> indicesReverse(right_descriptors.num_rows);
+  libmv::vector<float> distances(left_descriptors.num_rows);
+  libmv::vector<float> distancesReverse(right_descriptors.num_rows);
+  {
+    std::vector<float> queries(left_descriptors.codes.size());
+    left_descriptors.Dequantize(&queries[0]);
+    QuantizedKnn(right_descriptors, &queries[0], left_descriptors.num_rows, NN,
+                 &indices[0], &distances[0]);
+  }
+  {
+    std::vector<float> queries(right_descriptors.codes.size());
+    right_descriptors.Dequantize(&queries[0]);
+    QuantizedKnn(left_descriptors, &queries[0], right_descriptors.num_rows, NN,
+                 &indicesReverse[0], &distancesReverse[0]);
+  }
+
+  // From putative matches get symmetric matches.
+  int max_track_number = 0;
+  for (size_t i = 0; i < indices.size(); ++i) {
+    // Add the match only if we have a symmetric result.
+    if (i == indicesReverse[indices[i]])  {
+      matches->Insert(0, max_track_number, &left.features[i]);
+      matches->Insert(1, max_track_number, &right.features[indices[i]]);
+      ++max_track_number;
+    }
+  }
+}
+
+float * FeatureSet::FeatureSetDescriptorsToContiguousArray
+  ( const FeatureSet & featureSet ) {
+
+  if (featureSet.features.size() == 0)  {
+    return NULL;
+  }
+  int descriptorSize = featureSet.features[0].descriptor.coords.size();
+  // Allocate and paste the necessary data.
+  float * array = new float[featureSet.features.size()*descriptorSize];
+
+  //-- Paste data in the contiguous array :
+  for (int i = 0; i < (int)featureSet.features.size(); ++i) {
+    for (int j = 0;j < descriptorSize; ++j)
+      array[descriptorSize*i + j] = (float)featureSet.features[i][j];
+  }
+  return array;
+}
+
+// Compute candidate matches between 2 sets of features with a ratio.
+void FindCandidateMatches_Ratio(const FeatureSet &left,
+                          const FeatureSet &right,
+                          Matches *matches,
+                          eLibmvMatchMethod eMatchMethod,
+                          float fRatio) {
+  LIBMV_SCOPED_TIMER("match");
+  if (left.features.size() == 0 ||
+      right.features.size() == 0 )  {
+    return;
+  }
+  int descriptorSize = left.features[0].descriptor.coords.size();
+
+  correspondence::ArrayMatcher<float> * pArrayMatcherA =
+    CreateArrayMatcher(eMatchMethod);
+
+  const int NN = 2;
+  if (pArrayMatcherA != NULL) {
+
+    // Paste the necessary data in contiguous arrays.
+    float * arrayA = FeatureSet::FeatureSetDescriptorsToContiguousArray(left);
+    float * arrayB = FeatureSet::FeatureSetDescriptorsToContiguousArray(right);
+
+    libmv::vector<int> indices;
+    libmv::vector<float> distances;
+
+    bool breturn = false;
+    if (pArrayMatcherA->build(arrayB,right.features.size(),descriptorSize))  {
+      breturn =
+        pArrayMatcherA->searchNeighbours(arrayA,left.features.size(),
+          &indices, &distances, NN);
+    }
+    delete pArrayMatcherA;
+    delete [] arrayA;
+    delete [] arrayB;
+
+    // From putative matches get matches that fit the "Ratio" heuristic.
+    if (breturn)  {
+      //TODO(pmoulon) clear previous matches.
+      int max_track_number = 0;
+
+      for (size_t i = 0; i < left.features.size(); ++i) {
+        // Test distance ratio :
+        float distance0 = distances[i*NN];
+        float distance1 = distances[i*NN+NN-1];
+
+        if (distance0 < fRatio * distance1) {
+          matches->Insert(0, max_track_number, &left.features[i]);
+          matches->Insert(1, max_track_number, &right.features[indices[i*NN]]);
+          ++max_track_number;
+        }
+      }
+    }
+    else  {
+      LOG(INFO) << "[FindCandidateMatches_Ratio] Cannot compute matches.";
+    }
+  }
+  else  {
+    LOG(INFO) << "[FindCandidateMatches_Ratio] Unknow input match method.";
+  }
+}
+
+
+// Compute correspondences that match between 2 sets of features with a ratio.
+void FindCorrespondences(const FeatureSet &left,
+                         const FeatureSet &right,
+                         std::map<size_t, size_t> *correspondences,
+                         eLibmvMatchMethod eMatchMethod,
+                         float fRatio) {
+  if (left.features.size() == 0 ||
+      right.features.size() == 0 )  {
+    return;
+  }
+  int descriptorSize = left.features[0].descriptor.coords.size();
+
+  correspondence::ArrayMatcher<float> * pArrayMatcherA =
+    CreateArrayMatcher(eMatchMethod);
+
+  const int NN = 2;
+  if (pArrayMatcherA != NULL) {
+
+    // Paste the necessary data in contiguous arrays.
+    float * arrayA = FeatureSet::FeatureSetDescriptorsToContiguousArray(left);
+    float * arrayB = FeatureSet::FeatureSetDescriptorsToContiguousArray(right);
+
+    libmv::vector<int> indices;
+    libmv::vector<float> distances;
+
+    bool breturn = false;
+    if (pArrayMatcherA->build(arrayB,right.features.size(),descriptorSize))  {
+      breturn =
+        pArrayMatcherA->searchNeighbours(arrayA,left.features.size(),
+          &indices, &distances, NN);
+    }
+    delete pArrayMatcherA;
+    delete [] arrayA;
+    delete [] arrayB;
+
+    // From putative matches get matches that fit the "Ratio" heuristic.
+    if (breturn)  {
+      for (size_t i = 0; i < left.features.size(); ++i) {
+        // Test distance ratio :
+        float distance0 = distances[i*NN];
+        float distance1 = distances[i*NN+NN-1];
+
+        if (distance0 < fRatio * distance1) {
+          (*correspondences)[i] = indices[i*NN];
+        }
+      }
+    }
+    else  {
+      LOG(INFO) << "[FindCandidateMatches_Ratio] Cannot compute matches.";
+    }
+  }
+  else  {
+    LOG(INFO) << "[FindCandidateMatches_Ratio] Unknow input match method.";
+  }
+}
@@ -22,6 +22,8 @@
 #define LIBMV_CORRESPONDENCE_FEATURE_SET_H_
 
 #include <map>
+#include <typeinfo>
+#include <vector>
 
 #include "libmv/numeric/numeric.h"
 #include "libmv/base/id_generator.h"
@@ -40,16 +42,25 @@ typedef int FeatureID;
  * inserted a new ID is associated to the feature so that
  * the feature can be retrived later.
  *
- * Internally the class is a thin layer over std::map to be able to deal with
- * different features types in the same bag.
+ * Features are kept in one pool per concrete feature type. Iterating over the
+ * features of a type only visits the pools of that type (or derived types),
+ * which are found with one dynamic_cast per pool instead of one per feature.
+ * Since IDs are generated sequentially, finding a feature by ID is O(1).
  */
 class FeatureSet {
   typedef std::map<FeatureID, Feature *> FeatureMap;
-  
+
+  struct Pool {
+    const std::type_info *type;
+    FeatureMap features;       // Sorted by ID.
+  };
+  typedef std::vector<Pool *> Pools;
+
  public:
   /**
    * Iterate over features, silently skiping any that are not FeatureT or
-   * derived from FeatureT.
+   * derived from FeatureT. Features are visited pool by pool, and by
+   * increasing ID within a pool.
    */
   template<typename FeatureT = Feature>
   class Iterator {
@@ -58,30 +69,51 @@ class FeatureSet {
     FeatureT &feature() {
       return *static_cast<FeatureT *>(r_->second);
     }
-    operator bool() const { return r_ != end_; }
+    operator bool() const { return pools_ && pool_ < pools_->size(); }
     void operator++() { ++r_; Skip(); }
-    Iterator(FeatureMap::iterator begin, FeatureMap::iterator end)
-      : r_(begin), end_(end) { Skip(); }
 
    private:
+    // Iterates from r in pool, then over the next matching pools.
+    Iterator(const Pools *pools, size_t pool, FeatureMap::iterator r)
+      : pools_(pools), pool_(pool), r_(r) { Skip(); }
+    // The end iterator.
+    Iterator() : pools_(NULL), pool_(0) {}
+
     void Skip() {
-      while (r_ != end_
-             && !dynamic_cast<const FeatureT *>(r_->second)) {
-        ++r_;
+      while (r_ == (*pools_)[pool_]->features.end()) {
+        do {
+          ++pool_;
+        } while (pool_ < pools_->size() && !Matches((*pools_)[pool_]));
+        if (pool_ == pools_->size()) {
+          return;
+        }
+        r_ = (*pools_)[pool_]->features.begin();
       }
     }
+    static bool Matches(const Pool *pool) {
+      return !pool->features.empty() &&
+             dynamic_cast<const FeatureT *>(pool->features.begin()->second);
+    }
+    const Pools *pools_;
+    size_t pool_;
     FeatureMap::iterator r_;
-    FeatureMap::iterator end_;
 
     friend class FeatureSet;
   };
 
+  FeatureSet() {}
+
   /**
    * Destructor destroys all features.
    */
   ~FeatureSet() {
-    for (Iterator<Feature> i = All<Feature>(); i; ++i) {
-      delete &i.feature();
+    for (size_t p = 0; p < pools_.size(); ++p) {
+      FeatureMap &features = pools_[p]->features;
+      for (FeatureMap::iterator it = features.begin();
+           it != features.end(); ++it) {
+        delete it->second;
+      }
+      delete pools_[p];
     }
   }
 
@@ -90,7 +122,12 @@ class FeatureSet {
    */
   template<typename FeatureT>
   Iterator<FeatureT> All() {
-    return Iterator<FeatureT>(features_.begin(), features_.end());
+    for (size_t p = 0; p < pools_.size(); ++p) {
+      if (Iterator<FeatureT>::Matches(pools_[p])) {
+        return Iterator<FeatureT>(&pools_, p, pools_[p]->features.begin());
+      }
+    }
+    return Iterator<FeatureT>();
   }
 
   /**
@@ -98,12 +135,7 @@ class FeatureSet {
    */
   template<typename FeatureT>
   Iterator<FeatureT> New() {
-    Feature *f = new FeatureT;
-    FeatureID id = id_generator_.Generate();
-    
-    FeatureMap::iterator it =
-        features_.insert(FeatureMap::value_type(id, f)).first;
-    return Iterator<FeatureT>(it, features_.end());
+    return Add<FeatureT>(new FeatureT);
   }
 
   /**
@@ -116,12 +148,7 @@ class FeatureSet {
    */
   template<typename FeatureT>
   Iterator<FeatureT> Insert(const FeatureT &feature) {
-    Feature *f = new FeatureT(feature);
-    FeatureID id = id_generator_.Generate();
-    
-    FeatureMap::iterator it =
-        features_.insert(FeatureMap::value_type(id, f)).first;
-    return Iterator<FeatureT>(it, features_.end());
+    return Add<FeatureT>(new FeatureT(feature));
   }
 
   /**
@@ -129,8 +156,10 @@ class FeatureSet {
    */
   template<typename FeatureT>
   void Delete(Iterator<FeatureT> *it) {
+    FeatureID id = it->id();
     delete &it->feature();
-    features_.erase(it->r_);
+    pools_[pool_of_id_[id]]->features.erase(it->r_);
+    pool_of_id_[id] = -1;
   }
 
   /**
@@ -138,14 +167,165 @@ class FeatureSet {
    */
   template<typename FeatureT>
   Iterator<FeatureT> Find(FeatureID id) {
-    return Iterator<FeatureT>(features_.find(id), features_.end());
+    if (id < 0 || id >= static_cast<int>(pool_of_id_.size()) ||
+        pool_of_id_[id] < 0) {
+      return Iterator<FeatureT>();
+    }
+    Pool *pool = pools_[pool_of_id_[id]];
+    if (!Iterator<FeatureT>::Matches(pool)) {
+      return Iterator<FeatureT>();
+    }
+    return Iterator<FeatureT>(&pools_, pool_of_id_[id],
+                              pool->features.find(id));
+  }
+
+ private:
+  friend class FeatureSetBuilder;
+
+  template<typename FeatureT>
+  Iterator<FeatureT> Add(Feature *f) {
+    FeatureID id = id_generator_.Generate();
+    int p = PoolFor(typeid(*f));
+    FeatureMap::iterator it = Adopt(p, id, f);
+    return Iterator<FeatureT>(&pools_, p, it);
   }
 
- private: 
-  FeatureMap features_;   // This map owns the features.
+  FeatureMap::iterator Adopt(int p, FeatureID id, Feature *f) {
+    FeatureMap::iterator it = pools_[p]->features.insert(
+        pools_[p]->features.end(), FeatureMap::value_type(id, f));
+    if (id >= static_cast<int>(pool_of_id_.size())) {
+      pool_of_id_.resize(id + 1, -1);
+    }
+    pool_of_id_[id] = p;
+    return it;
+  }
+
+  int PoolFor(const std::type_info &type) {
+    for (size_t p = 0; p < pools_.size(); ++p) {
+      if (*pools_[p]->type == type) {
+        return p;
+      }
+    }
+    Pool *pool = new Pool;
+    pool->type = &type;
+    pools_.push_back(pool);
+    return pools_.size() - 1;
+  }
+
+  // No copying allowed, the set owns its features.
+  FeatureSet(const FeatureSet &);
+  FeatureSet &operator=(const FeatureSet &);
+
+  Pools pools_;                    // The pools own the features.
+  std::vector<int> pool_of_id_;    // Pool index of each ID, or -1.
   IdGenerator<FeatureID> id_generator_;
 };
 
+/**
+ * Collects the features found by parallel detectors and moves them into a
+ * FeatureSet in one step.
+ *
+ * The features are staged in slots, e.g. one per tile or scale, and a slot
+ * must only be written by one thread at a time; the slots need no locking.
+ * Merge() gives the features consecutive IDs, slot by slot and in the order
+ * they were staged, so that the IDs do not depend on the scheduling.
+ */
+class FeatureSetBuilder {
+ public:
+  explicit FeatureSetBuilder(int num_slots) : slots_(num_slots) {
+    for (int i = 0; i < num_slots; ++i) {
+      slots_[i] = new std::vector<Feature *>;
+    }
+  }
+
+  /**
+   * Deletes the features that were not merged.
+   */
+  ~FeatureSetBuilder() {
+    Clear();
+    for (size_t i = 0; i < slots_.size(); ++i) {
+      delete slots_[i];
+    }
+  }
+
+  int NumSlots() const { return slots_.size(); }
+
+  /**
+   * Stages a new feature of type FeatureT in slot and returns it.
+   */
+  template<typename FeatureT>
+  FeatureT *New(int slot) {
+    FeatureT *feature = new FeatureT;
+    slots_[slot]->push_back(feature);
+    return feature;
+  }
+
+  /**
+   * Stages a copy of feature in slot and returns it.
+   */
+  template<typename FeatureT>
+  FeatureT *Insert(int slot, const FeatureT &feature) {
+    FeatureT *copy = new FeatureT(feature);
+    slots_[slot]->push_back(copy);
+    return copy;
+  }
+
+  int NumFeatures() const {
+    int num_features = 0;
+    for (size_t i = 0; i < slots_.size(); ++i) {
+      num_features += slots_[i]->size();
+    }
+    return num_features;
+  }
+
+  /**
+   * Moves the staged features to set, and returns the ID of the first one.
+   * The block of IDs is reserved at once, so the features get consecutive IDs
+   * even if other features are added to the set concurrently from another
+   * thread; the other changes to set must still not run concurrently.
+   */
+  FeatureID Merge(FeatureSet *set) {
+    FeatureID first = set->id_generator_.Generate(NumFeatures());
+    FeatureID id = first;
+    const std::type_info *type = NULL;
+    int pool = -1;
+    for (size_t i = 0; i < slots_.size(); ++i) {
+      std::vector<Feature *> &features = *slots_[i];
+      for (size_t j = 0; j < features.size(); ++j) {
+        // Detectors mostly stage a single type.
+        if (!type || *type != typeid(*features[j])) {
+          type = &typeid(*features[j]);
+          pool = set->PoolFor(*type);
+        }
+        set->Adopt(pool, id++, features[j]);
+      }
+      features.clear();
+    }
+    return first;
+  }
+
+  /**
+   * Deletes the staged features.
+   */
+  void Clear() {
+    for (size_t i = 0; i < slots_.size(); ++i) {
+      std::vector<Feature *> &features = *slots_[i];
+      for (size_t j = 0; j < features.size(); ++j) {
+        delete features[j];
+      }
+      features.clear();
+    }
+  }
+
+ private:
+  FeatureSetBuilder(const FeatureSetBuilder &);
+  FeatureSetBuilder &operator=(const FeatureSetBuilder &);
+
+  // Allocated apart, so that threads filling different slots do not share
+  // cache lines.
+  std::vector<std::vector<Feature *> *> slots_;
+};
+
 }  // namespace libmv
 
 #endif  // LIBMV_CORRESPONDENCE_FEATURE_SET_H_
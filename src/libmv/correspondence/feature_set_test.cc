@@ -21,6 +21,7 @@
 #include <cstdio>
 #include <algorithm>
 
+#include "libmv/base/thread.h"
 #include "libmv/correspondence/feature_set.h"
 #include "libmv/logging/logging.h"
 #include "testing/testing.h"
@@ -42,6 +43,12 @@ struct SiblingTestFeature : public Feature {
   virtual ~SiblingTestFeature() {}
 };
 
+struct DerivedPoint : public MyPoint {
+  virtual ~DerivedPoint() {}
+  DerivedPoint() {}
+  DerivedPoint(int the_tag) : MyPoint(the_tag) {}
+};
+
 
 TEST(FeatureSet, New) {
   FeatureSet features;
@@ -124,4 +131,121 @@ TEST(FeatureSet, Find) {
   EXPECT_EQ(it.feature().tag, found.feature().tag);
 }
 
+TEST(FeatureSet, AllIncludesDerivedTypes) {
+  FeatureSet features;
+  features.Insert<MyPoint>(MyPoint(1));
+  features.New<SiblingTestFeature>();
+  features.Insert<DerivedPoint>(DerivedPoint(2));
+  features.Insert<MyPoint>(MyPoint(3));
+
+  std::vector<int> tags;
+  for (FeatureSet::Iterator<MyPoint> it = features.All<MyPoint>();
+       it; ++it) {
+    tags.push_back(it.feature().tag);
+  }
+  std::sort(tags.begin(), tags.end());
+  ASSERT_EQ(3, tags.size());
+  EXPECT_EQ(1, tags[0]);
+  EXPECT_EQ(2, tags[1]);
+  EXPECT_EQ(3, tags[2]);
+
+  int num_derived = 0;
+  for (FeatureSet::Iterator<DerivedPoint> it = features.All<DerivedPoint>();
+       it; ++it) {
+    EXPECT_EQ(2, it.feature().tag);
+    num_derived++;
+  }
+  EXPECT_EQ(1, num_derived);
+
+  int num_features = 0;
+  for (FeatureSet::Iterator<Feature> it = features.All<Feature>(); it; ++it) {
+    num_features++;
+  }
+  EXPECT_EQ(4, num_features);
+}
+
+TEST(FeatureSet, FindWrongTypeOrMissing) {
+  FeatureSet features;
+  FeatureSet::Iterator<MyPoint> it = features.Insert<MyPoint>(MyPoint(1));
+  FeatureID sibling = features.New<SiblingTestFeature>().id();
+
+  EXPECT_FALSE(features.Find<MyPoint>(sibling));
+  EXPECT_TRUE(features.Find<SiblingTestFeature>(sibling));
+  EXPECT_FALSE(features.Find<MyPoint>(sibling + 1));
+  EXPECT_FALSE(features.Find<MyPoint>(-1));
+
+  FeatureID id = it.id();
+  features.Delete(&it);
+  EXPECT_FALSE(features.Find<MyPoint>(id));
+  EXPECT_FALSE(features.All<MyPoint>());
+}
+
+// Stages tag = 100 * slot + i for the i-th feature of a slot.
+struct StageTile {
+  FeatureSetBuilder *builder;
+  void operator()(int slot) {
+    for (int i = 0; i < slot % 5; ++i) {
+      if (i % 2) {
+        builder->New<DerivedPoint>(slot)->tag = 100 * slot + i;
+      } else {
+        builder->Insert(slot, MyPoint(100 * slot + i));
+      }
+    }
+  }
+};
+
+TEST(FeatureSetBuilder, MergeGivesConsecutiveIdsInSlotOrder) {
+  FeatureSet features;
+  features.Insert<MyPoint>(MyPoint(-1));
+
+  FeatureSetBuilder builder(16);
+  StageTile stage;
+  stage.builder = &builder;
+  ParallelFor(0, builder.NumSlots(), 4, &stage);
+  EXPECT_EQ(30, builder.NumFeatures());
+  EXPECT_EQ(1, builder.Merge(&features));
+  EXPECT_EQ(0, builder.NumFeatures());
+
+  FeatureID id = 1;
+  for (int slot = 0; slot < 16; ++slot) {
+    for (int i = 0; i < slot % 5; ++i, ++id) {
+      FeatureSet::Iterator<MyPoint> it = features.Find<MyPoint>(id);
+      ASSERT_TRUE(it);
+      EXPECT_EQ(100 * slot + i, it.feature().tag);
+      EXPECT_EQ(i % 2 == 1, features.Find<DerivedPoint>(id));
+    }
+  }
+  // The set goes on numbering after the merged features.
+  EXPECT_EQ(31, features.New<MyPoint>().id());
+}
+
+TEST(FeatureSetBuilder, DeletesUnmergedFeatures) {
+  FeatureSetBuilder builder(2);
+  builder.Insert(1, MyPoint(1));
+  builder.New<SiblingTestFeature>(0);
+  builder.Clear();
+  EXPECT_EQ(0, builder.NumFeatures());
+  builder.Insert(0, MyPoint(2));
+}
+
+struct GenerateIds {
+  IdGenerator<int> *generator;
+  std::vector<int> *ids;
+  void operator()(int i) {
+    (*ids)[i] = generator->Generate(2);
+  }
+};
+
+TEST(IdGenerator, BlocksDoNotOverlapAcrossThreads) {
+  IdGenerator<int> generator;
+  std::vector<int> ids(1000);
+  GenerateIds generate = { &generator, &ids };
+  ParallelFor(0, ids.size(), 8, &generate);
+  std::sort(ids.begin(), ids.end());
+  for (int i = 0; i < ids.size(); ++i) {
+    EXPECT_EQ(2 * i, ids[i]);
+  }
+  EXPECT_EQ(2000, generator.Generate());
+}
+
 }  // namespace
@@ -0,0 +1,244 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "libmv/base/vector.h"
+#include "libmv/correspondence/feature_matching.h"
+#include "libmv/logging/logging.h"
+
+namespace {
+
+// The features of a set binned on a regular grid covering them.
+class FeatureGrid {
+ public:
+  FeatureGrid(const FeatureSet &features, double min_cell_size) {
+    const libmv::vector<KeypointFeature> &points = features.features;
+    min_x_ = max_x_ = points[0].x();
+    min_y_ = max_y_ = points[0].y();
+    for (size_t i = 1; i < points.size(); ++i) {
+      min_x_ = std::min(min_x_, double(points[i].x()));
+      max_x_ = std::max(max_x_, double(points[i].x()));
+      min_y_ = std::min(min_y_, double(points[i].y()));
+      max_y_ = std::max(max_y_, double(points[i].y()));
+    }
+    // About one feature per cell, but no cell smaller than the search window.
+    double area = (max_x_ - min_x_ + 1) * (max_y_ - min_y_ + 1);
+    cell_size_ = std::max(min_cell_size, std::sqrt(area / points.size()));
+    cols_ = static_cast<int>((max_x_ - min_x_) / cell_size_) + 1;
+    rows_ = static_cast<int>((max_y_ - min_y_) / cell_size_) + 1;
+    cells_.resize(rows_ * cols_);
+    for (size_t i = 0; i < points.size(); ++i) {
+      int col = static_cast<int>((points[i].x() - min_x_) / cell_size_);
+      int row = static_cast<int>((points[i].y() - min_y_) / cell_size_);
+      cells_[row * cols_ + col].push_back(i);
+    }
+  }
+
+  int Rows() const { return rows_; }
+  int Cols() const { return cols_; }
+
+  // The cell containing a coordinate, possibly outside the grid.
+  int Col(double x) const {
+    return static_cast<int>(std::floor((x - min_x_) / cell_size_));
+  }
+  int Row(double y) const {
+    return static_cast<int>(std::floor((y - min_y_) / cell_size_));
+  }
+  // The coordinate of the left or top border of a cell.
+  double ColX(int col) const { return min_x_ + col * cell_size_; }
+  double RowY(int row) const { return min_y_ + row * cell_size_; }
+
+  const libmv::vector<int> &Cell(int row, int col) const {
+    return cells_[row * cols_ + col];
+  }
+
+ private:
+  double min_x_, max_x_, min_y_, max_y_;
+  double cell_size_;
+  int rows_, cols_;
+  libmv::vector<libmv::vector<int> > cells_;
+};
+
+// Keeps the nearest neighbors of every feature among the pairs considered, to
+// find the symmetric matches.
+class SymmetricMatcher {
+ public:
+  SymmetricMatcher(const FeatureSet &left, const FeatureSet &right)
+      : left_(left),
+        right_(right),
+        best_right_(left.features.size(), -1),
+        best_left_(right.features.size(), -1),
+        best_right_distance_(left.features.size(),
+                             std::numeric_limits<float>::max()),
+        best_left_distance_(right.features.size(),
+                            std::numeric_limits<float>::max()) {}
+
+  void Consider(int i, int j) {
+    float distance = SquaredDistanceL2(left_.features[i].descriptor.coords,
+                                       right_.features[j].descriptor.coords);
+    if (distance < best_right_distance_[i]) {
+      best_right_distance_[i] = distance;
+      best_right_[i] = j;
+    }
+    if (distance < best_left_distance_[j]) {
+      best_left_distance_[j] = distance;
+      best_left_[j] = i;
+    }
+  }
+
+  void Export(Matches *matches) const {
+    int max_track_number = 0;
+    for (size_t i = 0; i < best_right_.size(); ++i) {
+      int j = best_right_[i];
+      if (j >= 0 && best_left_[j] == static_cast<int>(i)) {
+        matches->Insert(0, max_track_number, &left_.features[i]);
+        matches->Insert(1, max_track_number, &right_.features[j]);
+        ++max_track_number;
+      }
+    }
+  }
+
+ private:
+  const FeatureSet &left_;
+  const FeatureSet &right_;
+  libmv::vector<int> best_right_;
+  libmv::vector<int> best_left_;
+  libmv::vector<float> best_right_distance_;
+  libmv::vector<float> best_left_distance_;
+};
+
+// Considers the features of the cells of rows [row_begin, row_end] in the
+// column col of the grid that are within max_distance of the line
+// a x + b y + c = 0, where a^2 + b^2 = 1.
+void ConsiderColumnNearLine(const FeatureSet &right,
+                            const FeatureGrid &grid,
+                            int col, int row_begin, int row_end,
+                            double a, double b, double c,
+                            double max_distance,
+                            int i,
+                            SymmetricMatcher *matcher) {
+  row_begin = std::max(row_begin, 0);
+  row_end = std::min(row_end, grid.Rows() - 1);
+  for (int row = row_begin; row <= row_end; ++row) {
+    const libmv::vector<int> &cell = grid.Cell(row, col);
+    for (size_t k = 0; k < cell.size(); ++k) {
+      const KeypointFeature &y = right.features[cell[k]];
+      if (std::fabs(a * y.x() + b * y.y() + c) <= max_distance) {
+        matcher->Consider(i, cell[k]);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+void FindGuidedMatchesFundamental(const FeatureSet &left,
+                                  const FeatureSet &right,
+                                  const Mat3 &F,
+                                  double max_distance,
+                                  Matches *matches) {
+  LIBMV_SCOPED_TIMER("match.guided");
+  if (left.features.size() == 0 ||
+      right.features.size() == 0 )  {
+    return;
+  }
+  FeatureGrid grid(right, 2 * max_distance);
+  SymmetricMatcher matcher(left, right);
+  for (size_t i = 0; i < left.features.size(); ++i) {
+    const KeypointFeature &x = left.features[i];
+    Vec3 line = F * Vec3(x.x(), x.y(), 1);
+    double norm = std::sqrt(line(0) * line(0) + line(1) * line(1));
+    if (norm == 0) {
+      continue;
+    }
+    double a = line(0) / norm, b = line(1) / norm, c = line(2) / norm;
+    if (std::fabs(b) >= std::fabs(a)) {
+      // Mostly horizontal line: walk the columns, y = -(a x + c) / b.
+      double band = max_distance / std::fabs(b);
+      for (int col = 0; col < grid.Cols(); ++col) {
+        double y0 = -(a * grid.ColX(col) + c) / b;
+        double y1 = -(a * grid.ColX(col + 1) + c) / b;
+        ConsiderColumnNearLine(right, grid, col,
+                               grid.Row(std::min(y0, y1) - band),
+                               grid.Row(std::max(y0, y1) + band),
+                               a, b, c, max_distance, i, &matcher);
+      }
+    } else {
+      // Mostly vertical line: walk the rows, x = -(b y + c) / a.
+      double band = max_distance / std::fabs(a);
+      for (int row = 0; row < grid.Rows(); ++row) {
+        double x0 = -(b * grid.RowY(row) + c) / a;
+        double x1 = -(b * grid.RowY(row + 1) + c) / a;
+        int col_begin = std::max(grid.Col(std::min(x0, x1) - band), 0);
+        int col_end = std::min(grid.Col(std::max(x0, x1) + band),
+                               grid.Cols() - 1);
+        for (int col = col_begin; col <= col_end; ++col) {
+          ConsiderColumnNearLine(right, grid, col, row, row,
+                                 a, b, c, max_distance, i, &matcher);
+        }
+      }
+    }
+  }
+  matcher.Export(matches);
+}
+
+void FindGuidedMatchesHomography(const FeatureSet &left,
+                                 const FeatureSet &right,
+                                 const Mat3 &H,
+                                 double max_distance,
+                                 Matches *matches) {
+  LIBMV_SCOPED_TIMER("match.guided");
+  if (left.features.size() == 0 ||
+      right.features.size() == 0 )  {
+    return;
+  }
+  FeatureGrid grid(right, 2 * max_distance);
+  SymmetricMatcher matcher(left, right);
+  double max_distance2 = max_distance * max_distance;
+  for (size_t i = 0; i < left.features.size(); ++i) {
+    const KeypointFeature &x = left.features[i];
+    Vec3 predicted = H * Vec3(x.x(), x.y(), 1);
+    if (predicted(2) == 0) {
+      continue;
+    }
+    double px = predicted(0) / predicted(2);
+    double py = predicted(1) / predicted(2);
+    int row_begin = std::max(grid.Row(py - max_distance), 0);
+    int row_end = std::min(grid.Row(py + max_distance), grid.Rows() - 1);
+    int col_begin = std::max(grid.Col(px - max_distance), 0);
+    int col_end = std::min(grid.Col(px + max_distance), grid.Cols() - 1);
+    for (int row = row_begin; row <= row_end; ++row) {
+      for (int col = col_begin; col <= col_end; ++col) {
+        const libmv::vector<int> &cell = grid.Cell(row, col);
+        for (size_t k = 0; k < cell.size(); ++k) {
+          const KeypointFeature &y = right.features[cell[k]];
+          double dx = y.x() - px, dy = y.y() - py;
+          if (dx * dx + dy * dy <= max_distance2) {
+            matcher.Consider(i, cell[k]);
+          }
+        }
+      }
+    }
+  }
+  matcher.Export(matches);
+}
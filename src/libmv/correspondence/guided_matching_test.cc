@@ -0,0 +1,124 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/correspondence/feature_matching.h"
+#include "testing/testing.h"
+
+namespace {
+
+using namespace libmv;
+
+// A grid of features whose descriptors repeat on every row: the right features
+// are the left ones shifted by dx, and only their column identifies them.
+void MakeRepeatedGrid(int rows, int cols, float dx, FeatureSet *features) {
+  features->features.resize(rows * cols);
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      KeypointFeature &feature = features->features[i * cols + j];
+      feature.coords << 10 * j + dx, 10 * i;
+      feature.descriptor.coords.resize(2);
+      feature.descriptor.coords << j, 0;
+    }
+  }
+}
+
+// Checks that every match pairs a feature with its shifted copy.
+void ExpectShiftedCopies(const Matches &matches, float dx) {
+  std::set<Matches::TrackID>::const_iterator it = matches.get_tracks().begin();
+  for (; it != matches.get_tracks().end(); ++it) {
+    const PointFeature *left =
+        static_cast<const PointFeature *>(matches.Get(0, *it));
+    const PointFeature *right =
+        static_cast<const PointFeature *>(matches.Get(1, *it));
+    ASSERT_TRUE(left && right);
+    EXPECT_FLOAT_EQ(left->x() + dx, right->x());
+    EXPECT_FLOAT_EQ(left->y(), right->y());
+  }
+}
+
+TEST(GuidedMatching, FundamentalOfHorizontalMotion) {
+  FeatureSet left, right;
+  MakeRepeatedGrid(6, 8, 0, &left);
+  MakeRepeatedGrid(6, 8, 3, &right);
+
+  // y2 - y1 = 0: the epipolar lines are the rows.
+  Mat3 F;
+  F << 0, 0,  0,
+       0, 0,  1,
+       0, -1, 0;
+  Matches matches;
+  FindGuidedMatchesFundamental(left, right, F, 1.0, &matches);
+  EXPECT_EQ(6 * 8, matches.NumTracks());
+  ExpectShiftedCopies(matches, 3);
+}
+
+TEST(GuidedMatching, FundamentalOfVerticalMotion) {
+  FeatureSet left, right;
+  MakeRepeatedGrid(8, 6, 0, &left);
+  MakeRepeatedGrid(8, 6, 0, &right);
+  // Swap the roles of the rows and the columns.
+  for (size_t i = 0; i < left.features.size(); ++i) {
+    std::swap(left.features[i].coords(0), left.features[i].coords(1));
+    std::swap(right.features[i].coords(0), right.features[i].coords(1));
+  }
+
+  // x2 - x1 = 0: the epipolar lines are the columns.
+  Mat3 F;
+  F << 0, 0, -1,
+       0, 0,  0,
+       1, 0,  0;
+  Matches matches;
+  FindGuidedMatchesFundamental(left, right, F, 1.0, &matches);
+  EXPECT_EQ(8 * 6, matches.NumTracks());
+  ExpectShiftedCopies(matches, 0);
+}
+
+TEST(GuidedMatching, Homography) {
+  FeatureSet left, right;
+  MakeRepeatedGrid(6, 8, 0, &left);
+  MakeRepeatedGrid(6, 8, 4, &right);
+
+  Mat3 H;
+  H << 1, 0, 4,
+       0, 1, 0,
+       0, 0, 1;
+  Matches matches;
+  FindGuidedMatchesHomography(left, right, H, 2.0, &matches);
+  EXPECT_EQ(6 * 8, matches.NumTracks());
+  ExpectShiftedCopies(matches, 4);
+
+  // Nothing is close enough to a wrong prediction.
+  H(0, 2) = 50;
+  Matches wrong_matches;
+  FindGuidedMatchesHomography(left, right, H, 2.0, &wrong_matches);
+  EXPECT_GT(6 * 8, wrong_matches.NumTracks());
+  ExpectShiftedCopies(wrong_matches, 4);
+}
+
+TEST(GuidedMatching, EmptySets) {
+  FeatureSet left, right;
+  MakeRepeatedGrid(2, 2, 0, &left);
+  Matches matches;
+  FindGuidedMatchesHomography(left, right, Mat3::Identity(), 1.0, &matches);
+  FindGuidedMatchesFundamental(right, left, Mat3::Identity(), 1.0, &matches);
+  EXPECT_EQ(0, matches.NumTracks());
+}
+
+}  // namespace
@@ -0,0 +1,67 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_CORRESPONDENCE_HAMMING_H_
+#define LIBMV_CORRESPONDENCE_HAMMING_H_
+
+namespace libmv {
+
+// Number of bits set in x.
+inline int Popcount(unsigned int x) {
+#ifdef __GNUC__
+  return __builtin_popcount(x);
+#else
+  x = x - ((x >> 1) & 0x55555555u);
+  x = (x & 0x33333333u) + ((x >> 2) & 0x33333333u);
+  return (((x + (x >> 4)) & 0x0f0f0f0fu) * 0x01010101u) >> 24;
+#endif
+}
+
+// Number of differing bits between two binary descriptors of num_words 32 bit
+// words.
+inline unsigned int HammingDistance(const unsigned int *a,
+                                    const unsigned int *b,
+                                    int num_words) {
+  unsigned int distance = 0;
+  for (int i = 0; i < num_words; ++i) {
+    distance += Popcount(a[i] ^ b[i]);
+  }
+  return distance;
+}
+
+// Inserts a candidate in the sorted list of the k best ones, of which size
+// are filled (updated).
+inline void AddHammingCandidate(int id, unsigned int distance, int k,
+                                int *size, int *ids, unsigned int *distances) {
+  if (*size == k && distance >= distances[k - 1]) {
+    return;
+  }
+  int i = *size == k ? k - 1 : (*size)++;
+  for (; i > 0 && distances[i - 1] > distance; --i) {
+    ids[i] = ids[i - 1];
+    distances[i] = distances[i - 1];
+  }
+  ids[i] = id;
+  distances[i] = distance;
+}
+
+}  // namespace libmv
+
+#endif  // LIBMV_CORRESPONDENCE_HAMMING_H_
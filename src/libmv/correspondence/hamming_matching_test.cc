@@ -0,0 +1,157 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+
+#include "libmv/base/vector.h"
+#include "libmv/correspondence/ArrayMatcher_BruteForceHamming.h"
+#include "libmv/correspondence/ArrayMatcher_LshHamming.h"
+#include "libmv/correspondence/hamming.h"
+#include "testing/testing.h"
+
+namespace {
+using namespace libmv;
+using namespace libmv::correspondence;
+
+const int kNumWords = 8;
+
+unsigned int Random(unsigned int *seed) {
+  *seed = *seed * 1103515245u + 12345u;
+  return *seed;
+}
+
+void RandomRows(int num_rows, unsigned int seed, vector<unsigned int> *rows) {
+  rows->resize(num_rows * kNumWords);
+  for (int i = 0; i < rows->size(); ++i) {
+    (*rows)[i] = (Random(&seed) >> 16) | (Random(&seed) & 0xffff0000u);
+  }
+}
+
+TEST(Hamming, Popcount) {
+  EXPECT_EQ(0, Popcount(0u));
+  EXPECT_EQ(1, Popcount(0x80000000u));
+  EXPECT_EQ(32, Popcount(0xffffffffu));
+  EXPECT_EQ(16, Popcount(0xf0f0f0f0u));
+  unsigned int a[2] = { 0x1u, 0xffu };
+  unsigned int b[2] = { 0x3u, 0x0u };
+  EXPECT_EQ(9, HammingDistance(a, b, 2));
+}
+
+TEST(ArrayMatcher_BruteForceHamming, MatchesNaiveSearch) {
+  vector<unsigned int> data, queries;
+  RandomRows(200, 1, &data);
+  RandomRows(20, 2, &queries);
+
+  ArrayMatcher_BruteForceHamming matcher;
+  EXPECT_TRUE(matcher.build(&data[0], 200, kNumWords));
+  vector<int> indices;
+  vector<unsigned int> distances;
+  const int NN = 3;
+  EXPECT_TRUE(matcher.searchNeighbours(&queries[0], 20, &indices, &distances,
+                                       NN));
+  for (int i = 0; i < 20; ++i) {
+    const unsigned int *query = &queries[i * kNumWords];
+    for (int k = 0; k < NN; ++k) {
+      EXPECT_EQ(distances[i * NN + k],
+                HammingDistance(query, &data[indices[i * NN + k] * kNumWords],
+                                kNumWords));
+      if (k > 0) {
+        EXPECT_LE(distances[i * NN + k - 1], distances[i * NN + k]);
+      }
+    }
+    unsigned int best = 256;
+    for (int j = 0; j < 200; ++j) {
+      best = std::min(best, HammingDistance(query, &data[j * kNumWords],
+                                            kNumWords));
+    }
+    EXPECT_EQ(best, distances[i * NN]);
+  }
+}
+
+TEST(ArrayMatcher_LshHamming, FindsNearDuplicates) {
+  const int num_rows = 500;
+  vector<unsigned int> data, queries;
+  RandomRows(num_rows, 3, &data);
+  // Each query is a copy of a row of the dataset with a few flipped bits.
+  queries.resize(50 * kNumWords);
+  unsigned int seed = 4;
+  for (int i = 0; i < 50; ++i) {
+    int row = 7 * i;
+    for (int w = 0; w < kNumWords; ++w) {
+      queries[i * kNumWords + w] = data[row * kNumWords + w];
+    }
+    for (int f = 0; f < 6; ++f) {
+      int bit = (Random(&seed) >> 16) % 256;
+      queries[i * kNumWords + bit / 32] ^= 1u << (bit % 32);
+    }
+  }
+
+  ArrayMatcher_LshHamming matcher;
+  EXPECT_TRUE(matcher.build(&data[0], num_rows, kNumWords));
+  int found = 0;
+  for (int i = 0; i < 50; ++i) {
+    int indice;
+    unsigned int distance;
+    EXPECT_TRUE(matcher.searchNeighbour(&queries[i * kNumWords], &indice,
+                                        &distance));
+    EXPECT_TRUE(0 <= indice && indice < num_rows);
+    if (indice == 7 * i) {
+      EXPECT_GE(6, distance);
+      ++found;
+    }
+  }
+  EXPECT_LE(48, found);
+
+  // Unrelated queries still get valid neighbours.
+  RandomRows(10, 5, &queries);
+  vector<int> indices;
+  vector<unsigned int> distances;
+  EXPECT_TRUE(matcher.searchNeighbours(&queries[0], 10, &indices, &distances,
+                                       2));
+  for (int i = 0; i < indices.size(); ++i) {
+    EXPECT_TRUE(0 <= indices[i] && indices[i] < num_rows);
+  }
+}
+
+TEST(ArrayMatcher_LshHamming, ThreadedSearchMatchesSequential) {
+  const int num_rows = 500, num_queries = 100, NN = 2;
+  vector<unsigned int> data, queries;
+  RandomRows(num_rows, 6, &data);
+  RandomRows(num_queries, 7, &queries);
+
+  ArrayMatcher_LshHamming sequential, threaded;
+  threaded.SetNumThreads(3);
+  EXPECT_TRUE(sequential.build(&data[0], num_rows, kNumWords));
+  EXPECT_TRUE(threaded.build(&data[0], num_rows, kNumWords));
+  vector<int> indices, threaded_indices;
+  vector<unsigned int> distances, threaded_distances;
+  EXPECT_TRUE(sequential.searchNeighbours(&queries[0], num_queries, &indices,
+                                          &distances, NN));
+  EXPECT_TRUE(threaded.searchNeighbours(&queries[0], num_queries,
+                                        &threaded_indices,
+                                        &threaded_distances, NN));
+  ASSERT_EQ(indices.size(), threaded_indices.size());
+  for (int i = 0; i < indices.size(); ++i) {
+    EXPECT_EQ(indices[i], threaded_indices[i]);
+    EXPECT_EQ(distances[i], threaded_distances[i]);
+  }
+}
+
+}  // namespace
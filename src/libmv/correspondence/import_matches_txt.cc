@@ -1,47 +1,414 @@
-// Copyright (c) 2011 libmv authors.
-//
-// Permission is hereby granted, free of charge, to any person obtaining a copy
-// of this software and associated documentation files (the "Software"), to
-// deal in the Software without restriction, including without limitation the
-// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
-// sell copies of the Software, and to permit persons to whom the Software is
-// furnished to do so, subject to the following conditions:
-//
-// The above copyright notice and this permission notice shall be included in
-// all copies or substantial portions of the Software.
-//
-// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
-// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
-// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
-// IN THE SOFTWARE.
-
-#include <fstream>
-
-#include "libmv/correspondence/import_matches_txt.h"
-
-namespace libmv {
-
-void ImportMatchesFromTxt(const std::string &input_file, 
-                          Matches *matches,
-                          FeatureSet *feature_set) {
-  Matches::ImageID image_id = 0;
-  Matches::TrackID track_id = 0;
-  float x = 0, y = 0;
-  // Reserves 1e6 features to avoid problems during the resize
-  feature_set->features.reserve(1e6);
-  std::ifstream infile;
-  infile.open(input_file.c_str(), std::ios_base::in);
-  while (infile.good()) {
-    infile >> image_id >> track_id >> x >> y;
-    KeypointFeature pf;
-    pf.coords << x, y;
-    feature_set->features.push_back(pf);
-    matches->Insert(image_id, track_id, 
-                    &feature_set->features.back());
-  }
-  infile.close();
-}
-} // namespace libmv
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "libmv/base/thread.h"
+#include "libmv/correspondence/import_matches_txt.h"
+#include "libmv/logging/logging.h"
+
+namespace libmv {
+
+void ImportMatchesFromTxt(const std::string &input_file, 
+                          Matches *matches,
+                          FeatureSet *feature_set) {
+  Matches::ImageID image_id = 0;
+  Matches::TrackID track_id = 0;
+  float x = 0, y = 0;
+  // Reserves 1e6 features to avoid problems during the resize
+  feature_set->features.reserve(1e6);
+  std::ifstream infile;
+  infile.open(input_file.c_str(), std::ios_base::in);
+  while (infile.good()) {
+    infile >> image_id >> track_id >> x >> y;
+    KeypointFeature pf;
+    pf.coords << x, y;
+    feature_set->features.push_back(pf);
+    matches->Insert(image_id, track_id, 
+                    &feature_set->features.back());
+  }
+  infile.close();
+}
+
+namespace {
+
+struct Row {
+  int image;
+  int track;
+  float x;
+  float y;
+};
+
+// The contents of a file, mapped in memory where possible.
+class MappedFile {
+ public:
+  MappedFile() : data_(NULL), size_(0) {}
+  ~MappedFile() {
+#ifndef _WIN32
+    if (data_) {
+      munmap(const_cast<char *>(data_), size_);
+    }
+#endif
+  }
+
+  bool Open(const std::string &filename) {
+#ifdef _WIN32
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (!file) {
+      return false;
+    }
+    char chunk[65536];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+      buffer_.insert(buffer_.end(), chunk, chunk + read);
+    }
+    fclose(file);
+    size_ = buffer_.size();
+    data_ = size_ ? &buffer_[0] : NULL;
+    return true;
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0) {
+      close(fd);
+      return false;
+    }
+    // An empty file cannot be mapped, and has nothing to map.
+    if (status.st_size == 0) {
+      close(fd);
+      return true;
+    }
+    void *mapping = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+      return false;
+    }
+    data_ = static_cast<const char *>(mapping);
+    size_ = status.st_size;
+    return true;
+#endif
+  }
+
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  MappedFile(const MappedFile &);
+  MappedFile &operator=(const MappedFile &);
+
+  const char *data_;
+  size_t size_;
+#ifdef _WIN32
+  std::vector<char> buffer_;
+#endif
+};
+
+inline bool IsBlank(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+inline void SkipBlanks(const char **p, const char *end) {
+  while (*p < end && IsBlank(**p)) {
+    ++*p;
+  }
+}
+
+// A token ends at a blank, a line end or the end of the chunk.
+inline bool AtTokenEnd(const char *p, const char *end) {
+  return p == end || IsBlank(*p) || *p == '\n';
+}
+
+bool ParseInt(const char **p, const char *end, int *value) {
+  const char *s = *p;
+  bool negative = false;
+  if (s < end && (*s == '-' || *s == '+')) {
+    negative = *s == '-';
+    ++s;
+  }
+  if (s == end || !IsDigit(*s)) {
+    return false;
+  }
+  long long v = 0;
+  for (; s < end && IsDigit(*s); ++s) {
+    v = v * 10 + (*s - '0');
+    if (v > 2147483648LL) {
+      return false;
+    }
+  }
+  if (!AtTokenEnd(s, end) || (!negative && v > 2147483647LL)) {
+    return false;
+  }
+  *value = static_cast<int>(negative ? -v : v);
+  *p = s;
+  return true;
+}
+
+// Powers of ten that are exact in double precision.
+const double kExactPowersOf10[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Parses a decimal number such as -12.5e-3. With at most 15 significant
+// digits and a small exponent the mantissa and the scale are exact doubles,
+// so the single division or multiplication is correctly rounded. The rest
+// (long mantissas, huge exponents, nan, inf, hexadecimal) goes to strtod().
+bool ParseFloat(const char **p, const char *end, float *value) {
+  const char *s = *p;
+  bool negative = false;
+  if (s < end && (*s == '-' || *s == '+')) {
+    negative = *s == '-';
+    ++s;
+  }
+  long long mantissa = 0;
+  int num_digits = 0;
+  int exponent = 0;
+  bool has_digits = false;
+  for (; s < end && IsDigit(*s); ++s) {
+    has_digits = true;
+    if (mantissa == 0 && *s == '0') {
+      continue;
+    }
+    if (num_digits < 18) {
+      mantissa = mantissa * 10 + (*s - '0');
+    } else {
+      ++exponent;
+    }
+    ++num_digits;
+  }
+  if (s < end && *s == '.') {
+    for (++s; s < end && IsDigit(*s); ++s) {
+      has_digits = true;
+      if (mantissa == 0 && *s == '0') {
+        --exponent;
+        continue;
+      }
+      if (num_digits < 18) {
+        mantissa = mantissa * 10 + (*s - '0');
+        --exponent;
+      }
+      ++num_digits;
+    }
+  }
+  if (has_digits && s < end && (*s == 'e' || *s == 'E')) {
+    const char *e = s + 1;
+    bool negative_exponent = false;
+    if (e < end && (*e == '-' || *e == '+')) {
+      negative_exponent = *e == '-';
+      ++e;
+    }
+    if (e < end && IsDigit(*e)) {
+      int written = 0;
+      for (; e < end && IsDigit(*e); ++e) {
+        if (written < 100000) {
+          written = written * 10 + (*e - '0');
+        }
+      }
+      exponent += negative_exponent ? -written : written;
+      s = e;
+    }
+  }
+  if (has_digits && AtTokenEnd(s, end) && num_digits <= 15 &&
+      exponent >= -22 && exponent <= 22) {
+    double v = static_cast<double>(mantissa);
+    v = exponent < 0 ? v / kExactPowersOf10[-exponent]
+                     : v * kExactPowersOf10[exponent];
+    *value = static_cast<float>(negative ? -v : v);
+    *p = s;
+    return true;
+  }
+
+  // strtod() needs a terminated string, and the mapping is not.
+  const char *token_end = *p;
+  while (!AtTokenEnd(token_end, end)) {
+    ++token_end;
+  }
+  if (token_end == *p || token_end - *p > 255) {
+    return false;
+  }
+  char token[256];
+  std::copy(*p, token_end, token);
+  token[token_end - *p] = '\0';
+  char *parsed;
+  double v = strtod(token, &parsed);
+  if (parsed != token + (token_end - *p)) {
+    return false;
+  }
+  *value = static_cast<float>(v);
+  *p = token_end;
+  return true;
+}
+
+// Parses the lines of [begin, end), which starts at the beginning of a line.
+struct ParseChunks {
+  void operator()(int i) const {
+    const char *p = (*boundaries)[i];
+    const char *end = (*boundaries)[i + 1];
+    std::vector<Row> &rows = (*chunk_rows)[i];
+    (*ok)[i] = false;
+    while (p < end) {
+      SkipBlanks(&p, end);
+      if (p < end && *p == '\n') {
+        ++p;
+        continue;
+      }
+      if (p == end) {
+        break;
+      }
+      Row row;
+      if (!ParseInt(&p, end, &row.image)) return;
+      SkipBlanks(&p, end);
+      if (!ParseInt(&p, end, &row.track)) return;
+      SkipBlanks(&p, end);
+      if (!ParseFloat(&p, end, &row.x)) return;
+      SkipBlanks(&p, end);
+      if (!ParseFloat(&p, end, &row.y)) return;
+      SkipBlanks(&p, end);
+      if (p < end && *p != '\n') return;
+      rows.push_back(row);
+    }
+    (*ok)[i] = true;
+  }
+  const std::vector<const char *> *boundaries;
+  std::vector<std::vector<Row> > *chunk_rows;
+  std::vector<char> *ok;
+};
+
+struct RowsByImageThenTrack {
+  explicit RowsByImageThenTrack(const std::vector<Row> &rows) : rows_(rows) {}
+  bool operator()(int a, int b) const {
+    return rows_[a].image < rows_[b].image ||
+           (rows_[a].image == rows_[b].image &&
+            rows_[a].track < rows_[b].track);
+  }
+  const std::vector<Row> &rows_;
+};
+
+}  // namespace
+
+bool ImportMatchesFromTxtParallel(const std::string &input_file,
+                                  Matches *matches,
+                                  FeatureSet *feature_set,
+                                  int num_threads) {
+  MappedFile file;
+  if (!file.Open(input_file)) {
+    LOG(ERROR) << "Error: Couldn't open " << input_file;
+    return false;
+  }
+  const char *data = file.data();
+  const char *data_end = data + file.size();
+
+  // A few chunks per thread balance the lines of uneven lengths. Every
+  // boundary is moved to the start of the next line.
+  if (num_threads < 1) {
+    num_threads = 1;
+  }
+  size_t num_chunks = num_threads == 1 ? 1 : 4 * num_threads;
+  num_chunks = std::max<size_t>(1, std::min<size_t>(num_chunks,
+                                                    file.size() / 4096));
+  std::vector<const char *> boundaries(num_chunks + 1, data_end);
+  boundaries[0] = data;
+  for (size_t i = 1; i < num_chunks; ++i) {
+    const char *b = std::max(boundaries[i - 1],
+                             data + file.size() * i / num_chunks);
+    while (b < data_end && b > data && b[-1] != '\n') {
+      ++b;
+    }
+    boundaries[i] = b;
+  }
+
+  std::vector<std::vector<Row> > chunk_rows(num_chunks);
+  std::vector<char> ok(num_chunks);
+  ParseChunks parse;
+  parse.boundaries = &boundaries;
+  parse.chunk_rows = &chunk_rows;
+  parse.ok = &ok;
+  ParallelForDynamic(0, num_chunks, num_threads, &parse);
+
+  std::vector<Row> rows;
+  for (size_t i = 0; i < num_chunks; ++i) {
+    if (!ok[i]) {
+      LOG(ERROR) << "Error: Couldn't parse " << input_file;
+      return false;
+    }
+  }
+  size_t num_rows = 0;
+  for (size_t i = 0; i < num_chunks; ++i) {
+    num_rows += chunk_rows[i].size();
+  }
+  rows.reserve(num_rows);
+  for (size_t i = 0; i < num_chunks; ++i) {
+    rows.insert(rows.end(), chunk_rows[i].begin(), chunk_rows[i].end());
+    std::vector<Row>().swap(chunk_rows[i]);
+  }
+
+  int first = feature_set->features.size();
+  feature_set->features.resize(first + num_rows);
+  for (size_t i = 0; i < num_rows; ++i) {
+    feature_set->features[first + i].coords << rows[i].x, rows[i].y;
+  }
+
+  // Legacy files are usually written sorted, then no sort is needed.
+  std::vector<int> order(num_rows);
+  for (size_t i = 0; i < num_rows; ++i) {
+    order[i] = i;
+  }
+  RowsByImageThenTrack image_then_track(rows);
+  bool sorted = true;
+  for (size_t i = 1; sorted && i < num_rows; ++i) {
+    sorted = !image_then_track(i, i - 1);
+  }
+  if (!sorted) {
+    std::stable_sort(order.begin(), order.end(), image_then_track);
+  }
+  std::vector<Matches::ImageID> images(num_rows);
+  std::vector<Matches::TrackID> tracks(num_rows);
+  std::vector<const Feature *> features(num_rows);
+  for (size_t i = 0; i < num_rows; ++i) {
+    images[i] = rows[order[i]].image;
+    tracks[i] = rows[order[i]].track;
+    features[i] = &feature_set->features[first + order[i]];
+  }
+  if (num_rows) {
+    matches->InsertSorted(&images[0], &tracks[0], &features[0], num_rows);
+  }
+  return true;
+}
+
+} // namespace libmv
@@ -0,0 +1,180 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "libmv/correspondence/feature.h"
+#include "libmv/correspondence/import_matches_txt.h"
+#include "testing/testing.h"
+
+namespace {
+
+using namespace libmv;
+
+std::string TemporaryFilename(const char *name) {
+  return std::string("/tmp/libmv_import_matches_txt_test_") + name;
+}
+
+void WriteFile(const std::string &filename, const std::string &contents) {
+  FILE *file = fopen(filename.c_str(), "wb");
+  ASSERT_TRUE(file != NULL);
+  fwrite(contents.data(), 1, contents.size(), file);
+  fclose(file);
+}
+
+const KeypointFeature *GetKeypoint(const Matches &matches,
+                                   int image, int track) {
+  return static_cast<const KeypointFeature *>(matches.Get(image, track));
+}
+
+TEST(ImportMatchesFromTxtParallel, ReadsUnsortedRows) {
+  std::string filename = TemporaryFilename("unsorted.txt");
+  WriteFile(filename, "3 1 30.5 31.25\n"
+                      "0 2 1.5 -2.5e1\r\n"
+                      "\n"
+                      "  0\t1 10 20  \n"
+                      "3 2 3e2 .5");
+  Matches matches;
+  FeatureSet features;
+  ASSERT_TRUE(ImportMatchesFromTxtParallel(filename, &matches, &features, 1));
+  ASSERT_EQ(4, features.features.size());
+  EXPECT_EQ(2, matches.NumImages());
+  EXPECT_EQ(2, matches.NumTracks());
+  // The features keep the order of the file.
+  EXPECT_EQ(30.5, features.features[0].x());
+  EXPECT_EQ(&features.features[0], GetKeypoint(matches, 3, 1));
+  EXPECT_EQ(-25, GetKeypoint(matches, 0, 2)->y());
+  EXPECT_EQ(10, GetKeypoint(matches, 0, 1)->x());
+  EXPECT_EQ(20, GetKeypoint(matches, 0, 1)->y());
+  EXPECT_EQ(300, GetKeypoint(matches, 3, 2)->x());
+  EXPECT_EQ(0.5, GetKeypoint(matches, 3, 2)->y());
+
+  Matches::Features<KeypointFeature> r = matches.InImage<KeypointFeature>(0);
+  ASSERT_TRUE(r);
+  EXPECT_EQ(1, r.track());
+  ++r;
+  ASSERT_TRUE(r);
+  EXPECT_EQ(2, r.track());
+  remove(filename.c_str());
+}
+
+TEST(ImportMatchesFromTxtParallel, ParsesFloatsLikeStrtof) {
+  const char *tokens[] = {
+    "0", "-0", "1", "0.1", "123.456", "-1e-5", "3.4028235e38", "1.17549435e-38",
+    "1e-45", "0.000123456789012345678", "98765432109876543210", "1E+3",
+    "+2.5", "nan", "-inf", "7.", "0x1p3", "33554431.5"
+  };
+  const int num_tokens = sizeof(tokens) / sizeof(tokens[0]);
+  std::string contents;
+  char line[128];
+  for (int i = 0; i < num_tokens; ++i) {
+    snprintf(line, sizeof(line), "0 %d %s 1\n", i, tokens[i]);
+    contents += line;
+  }
+  std::string filename = TemporaryFilename("floats.txt");
+  WriteFile(filename, contents);
+  Matches matches;
+  FeatureSet features;
+  ASSERT_TRUE(ImportMatchesFromTxtParallel(filename, &matches, &features, 1));
+  ASSERT_EQ(num_tokens, features.features.size());
+  for (int i = 0; i < num_tokens; ++i) {
+    float expected = strtof(tokens[i], NULL);
+    float x = features.features[i].x();
+    if (expected != expected) {
+      EXPECT_TRUE(x != x) << tokens[i];
+    } else {
+      EXPECT_EQ(expected, x) << tokens[i];
+    }
+  }
+  remove(filename.c_str());
+}
+
+TEST(ImportMatchesFromTxtParallel, MatchesTheSerialImportOnAnyThreadCount) {
+  std::string contents;
+  char line[128];
+  srand(5);
+  for (int i = 0; i < 20000; ++i) {
+    snprintf(line, sizeof(line), "%d %d %g %g\n", rand() % 50, rand() % 3000,
+             rand() / 1000.0, -rand() / 7.0);
+    contents += line;
+  }
+  std::string filename = TemporaryFilename("large.txt");
+  WriteFile(filename, contents);
+
+  Matches expected;
+  FeatureSet expected_features;
+  ImportMatchesFromTxt(filename, &expected, &expected_features);
+
+  for (int num_threads = 1; num_threads <= 8; num_threads *= 2) {
+    Matches matches;
+    FeatureSet features;
+    ASSERT_TRUE(ImportMatchesFromTxtParallel(filename, &matches, &features,
+                                             num_threads));
+    EXPECT_EQ(20000, features.features.size());
+    EXPECT_EQ(expected.NumImages(), matches.NumImages());
+    EXPECT_EQ(expected.NumTracks(), matches.NumTracks());
+    int num_matches = 0;
+    Matches::Features<KeypointFeature> r = expected.All<KeypointFeature>();
+    for (; r; ++r, ++num_matches) {
+      const KeypointFeature *feature =
+          GetKeypoint(matches, r.image(), r.track());
+      ASSERT_TRUE(feature != NULL);
+      EXPECT_EQ(r.feature()->x(), feature->x());
+      EXPECT_EQ(r.feature()->y(), feature->y());
+    }
+    int num_parallel_matches = 0;
+    r = matches.All<KeypointFeature>();
+    for (; r; ++r) {
+      ++num_parallel_matches;
+    }
+    EXPECT_EQ(num_matches, num_parallel_matches);
+  }
+  remove(filename.c_str());
+}
+
+TEST(ImportMatchesFromTxtParallel, MalformedFilesLeaveTheOutputUnchanged) {
+  const char *files[] = {
+    "0 1 2 3\n0 2 4\n",
+    "0 1 2 3 4\n",
+    "0 1.5 2 3\n",
+    "0 1 2x 3\n",
+    "0 99999999999 2 3\n",
+  };
+  std::string filename = TemporaryFilename("malformed.txt");
+  for (int i = 0; i < 5; ++i) {
+    WriteFile(filename, files[i]);
+    Matches matches;
+    FeatureSet features;
+    EXPECT_FALSE(ImportMatchesFromTxtParallel(filename, &matches, &features,
+                                              4)) << files[i];
+    EXPECT_EQ(0, features.features.size());
+    EXPECT_EQ(0, matches.NumImages());
+  }
+  remove(filename.c_str());
+
+  Matches matches;
+  FeatureSet features;
+  EXPECT_FALSE(ImportMatchesFromTxtParallel(TemporaryFilename("missing.txt"),
+                                            &matches, &features, 4));
+}
+
+}  // namespace
@@ -212,6 +212,19 @@ class KdTree {
   int ApproximateKnnBestBinFirst(const Scalar *query,
                                  int max_leafs,
                                  SearchResults *neighbors) const {
+    return ApproximateKnnBestBinFirst(query, max_leafs, AcceptAll(), neighbors);
+  }
+
+  /**
+   * Same as above, but only the points whose id passes accept(id) are
+   * neighbors. The list of neighbors may already hold points, for instance
+   * those of another tree; the search then only looks for closer ones.
+   */
+  template <typename Accept>
+  int ApproximateKnnBestBinFirst(const Scalar *query,
+                                 int max_leafs,
+                                 const Accept &accept,
+                                 SearchResults *neighbors) const {
     int num_explored_leafs = 0;
     PriorityQueue<int, Scalar> queue;
     queue.Push(0, 0); // Push root node.
@@ -249,8 +262,10 @@ class KdTree {
       }
       // Explore leaf.
       for (Point *p = nodes_[i].begin; p < nodes_[i].end; ++p) {
-        Scalar distance = L2Distance2(p->data, query);
-        neighbors->AddNeighbor(p->id, distance);
+        if (accept(p->id)) {
+          Scalar distance = L2Distance2(p->data, query);
+          neighbors->AddNeighbor(p->id, distance);
+        }
       }
       num_explored_leafs++;
     }
@@ -258,6 +273,10 @@ class KdTree {
   }
 
  private:
+  struct AcceptAll {
+    bool operator()(const Id &) const { return true; }
+  };
+
   int LeftChild(int i) const {
     return 2 * i + 1;
   }
@@ -0,0 +1,351 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_CORRESPONDENCE_KDTREE_FOREST_H_
+#define LIBMV_CORRESPONDENCE_KDTREE_FOREST_H_
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cassert>
+
+namespace libmv {
+
+// A forest of randomized kd-trees for approximate nearest neighbor search in
+// high dimensional spaces (e.g. SIFT descriptors), after Silpa-Anan and
+// Hartley "Optimised KD-trees for fast image descriptor matching" (CVPR 2008)
+// and Muja and Lowe "Fast approximate nearest neighbors with automatic
+// algorithm configuration" (VISAPP 2009).
+//
+// Each tree splits on an axis drawn at random among the few most variant
+// ones, so that the trees partition the space differently. All the trees are
+// stored in a single flat array of nodes; a search descends every tree once
+// and then explores the closest unexplored branches of the whole forest, best
+// bin first, until max_checks points have been compared to the query.
+//
+// The scratch memory of a query lives in a SearchContext, which is meant to
+// be reused across queries so that searching does not allocate. A context
+// must not be shared between threads; the forest itself is read only once
+// built.
+template <typename Scalar>
+class KdForest {
+ public:
+  class SearchContext;
+
+  KdForest() : num_points_(0), num_dims_(0) {}
+
+  /**
+   * Build the forest on a copy of the num_points x num_dims row major data.
+   *
+   * \param num_trees Number of randomized trees.
+   * \param seed      Seed of the axis selection; the same seed always gives
+   *                  the same forest.
+   */
+  void Build(const Scalar *data, int num_points, int num_dims,
+             int num_trees = 4, unsigned seed = 1) {
+    assert(num_points > 0 && num_dims > 0 && num_trees > 0);
+    num_points_ = num_points;
+    num_dims_ = num_dims;
+    data_.assign(data, data + num_points * num_dims);
+
+    // A binary tree with one point per leaf has 2n - 1 nodes.
+    nodes_.clear();
+    nodes_.reserve(num_trees * (2 * num_points - 1));
+    roots_.resize(num_trees);
+
+    std::vector<int> indices(num_points);
+    random_state_ = seed;
+    for (int t = 0; t < num_trees; ++t) {
+      for (int i = 0; i < num_points; ++i) {
+        indices[i] = i;
+      }
+      roots_[t] = nodes_.size();
+      nodes_.push_back(Node());
+      BuildNode(roots_[t], &indices[0], &indices[0] + num_points);
+    }
+  }
+
+  int NumPoints() const { return num_points_; }
+  int NumDimensions() const { return num_dims_; }
+  int NumTrees() const { return roots_.size(); }
+  int NumNodes() const { return nodes_.size(); }
+
+  /**
+   * Find the k approximate nearest neighbors of query, comparing it to at
+   * most max_checks points of the dataset (a non positive max_checks makes
+   * the search exact). The neighbors are written in ids and their squared
+   * distances in distances, both of size k, closest first; missing neighbors
+   * get an id of -1. Returns the number of neighbors found.
+   */
+  int Knn(const Scalar *query, int k, int max_checks,
+          SearchContext *context, int *ids, Scalar *distances) const {
+    assert(k > 0);
+    if (max_checks <= 0) {
+      max_checks = num_points_;
+    }
+    context->Reset(k, num_points_);
+
+    // Go down every tree first, then the most promising remaining branches.
+    for (int t = 0; t < NumTrees(); ++t) {
+      SearchFrom(roots_[t], 0, 0, query, context);
+    }
+    std::vector<Branch> &heap = context->heap_;
+    while (!heap.empty() && context->num_checks_ < max_checks) {
+      std::pop_heap(heap.begin(), heap.end());
+      Branch branch = heap.back();
+      heap.pop_back();
+      if (!context->Full() || branch.bound < context->FarthestDistance()) {
+        SearchFrom(branch.node, branch.priority, branch.bound, query, context);
+      }
+    }
+
+    int found = context->size_;
+    for (int i = 0; i < k; ++i) {
+      ids[i] = i < found ? context->ids_[i] : -1;
+      distances[i] = i < found ? context->distances_[i]
+                               : std::numeric_limits<Scalar>::max();
+    }
+    return found;
+  }
+
+ private:
+  // An internal node splits on axis at cut: points with a smaller coordinate
+  // go to the child at index child, the others to child + 1. A leaf has a
+  // negative axis and child is the index of its point.
+  struct Node {
+    int axis;
+    Scalar cut;
+    int child;
+  };
+
+  // An unexplored subtree. Branches are explored by increasing priority, the
+  // sum of the squared distances to the cuts on the way down (as in FLANN).
+  // That sum can overestimate the distance to the subtree when an axis is cut
+  // several times, so pruning uses bound, the largest of those squared
+  // distances, which never does.
+  struct Branch {
+    Branch(int n, Scalar p, Scalar b) : node(n), priority(p), bound(b) {}
+    bool operator<(const Branch &other) const {
+      return priority > other.priority;
+    }
+    int node;
+    Scalar priority;
+    Scalar bound;
+  };
+
+ public:
+  // Scratch memory of a query: the branch heap, the k best neighbors found so
+  // far and the per point marks that avoid comparing the query twice with the
+  // same point when it is reached from several trees.
+  class SearchContext {
+   public:
+    SearchContext() : k_(0), size_(0), num_checks_(0), stamp_(0) {}
+
+    // Number of points compared to the query during the last search.
+    int NumChecks() const { return num_checks_; }
+
+   private:
+    friend class KdForest;
+
+    void Reset(int k, int num_points) {
+      k_ = k;
+      size_ = 0;
+      num_checks_ = 0;
+      ids_.resize(k);
+      distances_.resize(k);
+      heap_.clear();
+      if (int(visited_.size()) != num_points || stamp_ == 0x7fffffff) {
+        visited_.assign(num_points, 0);
+        stamp_ = 0;
+      }
+      ++stamp_;
+    }
+
+    bool Full() const { return size_ == k_; }
+    Scalar FarthestDistance() const { return distances_[size_ - 1]; }
+
+    // Inserts a neighbor into the sorted list, shifting the farther ones.
+    void AddNeighbor(int id, Scalar distance) {
+      if (Full() && distance >= distances_[size_ - 1]) {
+        return;
+      }
+      int i = Full() ? size_ - 1 : size_++;
+      for (; i > 0 && distances_[i - 1] > distance; --i) {
+        ids_[i] = ids_[i - 1];
+        distances_[i] = distances_[i - 1];
+      }
+      ids_[i] = id;
+      distances_[i] = distance;
+    }
+
+    int k_;
+    int size_;
+    int num_checks_;
+    int stamp_;
+    std::vector<int> ids_;
+    std::vector<Scalar> distances_;
+    std::vector<Branch> heap_;
+    std::vector<int> visited_;
+  };
+
+ private:
+  // Number of the most variant axes among which the split axis is drawn, and
+  // number of points used to estimate the variances.
+  enum { kRandomAxes = 5, kVarianceSamples = 100 };
+
+  void SearchFrom(int n, Scalar priority, Scalar bound,
+                  const Scalar *query, SearchContext *context) const {
+    while (nodes_[n].axis >= 0) {
+      const Node &node = nodes_[n];
+      Scalar diff = query[node.axis] - node.cut;
+      int near_child = diff < 0 ? node.child : node.child + 1;
+      int far_child = diff < 0 ? node.child + 1 : node.child;
+      Scalar far_bound = std::max(bound, diff * diff);
+      if (!context->Full() || far_bound < context->FarthestDistance()) {
+        context->heap_.push_back(
+            Branch(far_child, priority + diff * diff, far_bound));
+        std::push_heap(context->heap_.begin(), context->heap_.end());
+      }
+      n = near_child;
+    }
+    int point = nodes_[n].child;
+    if (context->visited_[point] == context->stamp_) {
+      return;
+    }
+    context->visited_[point] = context->stamp_;
+    context->num_checks_++;
+    context->AddNeighbor(point, L2Distance2(&data_[point * num_dims_], query));
+  }
+
+  void BuildNode(int n, int *begin, int *end) {
+    if (end - begin == 1) {
+      nodes_[n].axis = -1;
+      nodes_[n].child = *begin;
+      return;
+    }
+    int axis;
+    Scalar cut;
+    ChooseSplit(begin, end, &axis, &cut);
+
+    // Split at the mean, or at the median if all points fall on one side.
+    AxisLess less(&data_[0], num_dims_, axis, cut);
+    int *middle = std::partition(begin, end, less);
+    if (middle == begin || middle == end) {
+      middle = begin + (end - begin) / 2;
+      std::nth_element(begin, middle, end, AxisOrder(&data_[0], num_dims_, axis));
+      cut = data_[*middle * num_dims_ + axis];
+    }
+
+    int child = nodes_.size();
+    nodes_.push_back(Node());
+    nodes_.push_back(Node());
+    nodes_[n].axis = axis;
+    nodes_[n].cut = cut;
+    nodes_[n].child = child;
+    BuildNode(child, begin, middle);
+    BuildNode(child + 1, middle, end);
+  }
+
+  // Draws the split axis among the kRandomAxes most variant ones, and cuts at
+  // the mean along it.
+  void ChooseSplit(const int *begin, const int *end, int *axis, Scalar *cut) {
+    int num_samples = std::min(int(end - begin), int(kVarianceSamples));
+    std::vector<double> mean(num_dims_, 0.0), variance(num_dims_, 0.0);
+    for (int i = 0; i < num_samples; ++i) {
+      const Scalar *p = &data_[begin[i] * num_dims_];
+      for (int d = 0; d < num_dims_; ++d) {
+        mean[d] += p[d];
+      }
+    }
+    for (int d = 0; d < num_dims_; ++d) {
+      mean[d] /= num_samples;
+    }
+    for (int i = 0; i < num_samples; ++i) {
+      const Scalar *p = &data_[begin[i] * num_dims_];
+      for (int d = 0; d < num_dims_; ++d) {
+        double diff = p[d] - mean[d];
+        variance[d] += diff * diff;
+      }
+    }
+
+    // Keep the most variant axes, sorted by decreasing variance.
+    int top[kRandomAxes];
+    int num_top = 0;
+    for (int d = 0; d < num_dims_; ++d) {
+      if (num_top < kRandomAxes || variance[d] > variance[top[num_top - 1]]) {
+        int j = num_top < kRandomAxes ? num_top++ : num_top - 1;
+        for (; j > 0 && variance[top[j - 1]] < variance[d]; --j) {
+          top[j] = top[j - 1];
+        }
+        top[j] = d;
+      }
+    }
+    *axis = top[Random() % num_top];
+    *cut = Scalar(mean[*axis]);
+  }
+
+  // Linear congruential generator; keeps the forests reproducible without
+  // touching the global rand() state.
+  unsigned Random() {
+    random_state_ = random_state_ * 1103515245u + 12345u;
+    return (random_state_ >> 16) & 0x7fff;
+  }
+
+  Scalar L2Distance2(const Scalar *p, const Scalar *q) const {
+    Scalar distance = 0;
+    for (int i = 0; i < num_dims_; ++i) {
+      Scalar diff = p[i] - q[i];
+      distance += diff * diff;
+    }
+    return distance;
+  }
+
+  struct AxisLess {
+    AxisLess(const Scalar *data, int num_dims, int axis, Scalar cut)
+        : data_(data), num_dims_(num_dims), axis_(axis), cut_(cut) {}
+    bool operator()(int i) const {
+      return data_[i * num_dims_ + axis_] < cut_;
+    }
+    const Scalar *data_;
+    int num_dims_, axis_;
+    Scalar cut_;
+  };
+
+  struct AxisOrder {
+    AxisOrder(const Scalar *data, int num_dims, int axis)
+        : data_(data), num_dims_(num_dims), axis_(axis) {}
+    bool operator()(int i, int j) const {
+      return data_[i * num_dims_ + axis_] < data_[j * num_dims_ + axis_];
+    }
+    const Scalar *data_;
+    int num_dims_, axis_;
+  };
+
+  int num_points_;
+  int num_dims_;
+  unsigned random_state_;
+  std::vector<Scalar> data_;
+  std::vector<Node> nodes_;
+  std::vector<int> roots_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_CORRESPONDENCE_KDTREE_FOREST_H_
@@ -20,7 +20,9 @@
 
 #include "testing/testing.h"
 #include "libmv/numeric/numeric.h"
+#include "libmv/correspondence/dynamic_kdtree.h"
 #include "libmv/correspondence/kdtree.h"
+#include "libmv/correspondence/kdtree_forest.h"
 
 using namespace libmv;
 
@@ -187,4 +189,197 @@ TEST(KdTree, ApproximateKnnBestBinFirstBig) {
                              // 13 has been found by testing the code itself :(
 }
 
+// Random points in the unit hypercube, with a generator of our own so that the
+// test does not depend on the platform rand().
+void RandomPoints(int num_points, int num_dims, unsigned seed,
+                  std::vector<float> *points) {
+  points->resize(num_points * num_dims);
+  for (int i = 0; i < num_points * num_dims; ++i) {
+    seed = seed * 1103515245u + 12345u;
+    (*points)[i] = ((seed >> 16) & 0x7fff) / 32768.0f;
+  }
+}
+
+void BruteForceKnn(const std::vector<float> &points, int num_dims,
+                   const float *query, int k, int *ids, float *distances) {
+  std::vector<std::pair<float, int> > sorted;
+  for (int i = 0; i < int(points.size()) / num_dims; ++i) {
+    float distance = 0;
+    for (int d = 0; d < num_dims; ++d) {
+      float diff = points[i * num_dims + d] - query[d];
+      distance += diff * diff;
+    }
+    sorted.push_back(std::make_pair(distance, i));
+  }
+  std::sort(sorted.begin(), sorted.end());
+  for (int i = 0; i < k; ++i) {
+    distances[i] = sorted[i].first;
+    ids[i] = sorted[i].second;
+  }
+}
+
+TEST(KdForest, Build) {
+  std::vector<float> points;
+  RandomPoints(100, 8, 1, &points);
+
+  KdForest<float> forest;
+  forest.Build(&points[0], 100, 8, 3);
+
+  EXPECT_EQ(3, forest.NumTrees());
+  EXPECT_EQ(3 * (2 * 100 - 1), forest.NumNodes());
+}
+
+TEST(KdForest, ExactSearchMatchesBruteForce) {
+  const int kNumPoints = 500, kNumDims = 16, kK = 3;
+  std::vector<float> points, queries;
+  RandomPoints(kNumPoints, kNumDims, 1, &points);
+  RandomPoints(50, kNumDims, 2, &queries);
+
+  KdForest<float> forest;
+  forest.Build(&points[0], kNumPoints, kNumDims);
+
+  // A single context serves all the queries.
+  KdForest<float>::SearchContext context;
+  for (int q = 0; q < 50; ++q) {
+    const float *query = &queries[q * kNumDims];
+    int ids[kK], expected_ids[kK];
+    float distances[kK], expected_distances[kK];
+    EXPECT_EQ(kK, forest.Knn(query, kK, 0, &context, ids, distances));
+    BruteForceKnn(points, kNumDims, query, kK, expected_ids,
+                  expected_distances);
+    for (int i = 0; i < kK; ++i) {
+      EXPECT_EQ(expected_ids[i], ids[i]);
+      EXPECT_NEAR(expected_distances[i], distances[i], 1e-5);
+    }
+    EXPECT_LE(context.NumChecks(), kNumPoints);
+  }
+}
+
+TEST(KdForest, MaxChecksBoundsTheSearch) {
+  const int kNumPoints = 1000, kNumDims = 32;
+  std::vector<float> points, queries;
+  RandomPoints(kNumPoints, kNumDims, 3, &points);
+  RandomPoints(100, kNumDims, 4, &queries);
+
+  KdForest<float> forest;
+  forest.Build(&points[0], kNumPoints, kNumDims, 4);
+
+  KdForest<float>::SearchContext context;
+  int num_exact = 0;
+  for (int q = 0; q < 100; ++q) {
+    const float *query = &queries[q * kNumDims];
+    int id, expected_id;
+    float distance, expected_distance;
+    forest.Knn(query, 1, 200, &context, &id, &distance);
+    // Every tree is descended once before the budget is checked.
+    EXPECT_LE(context.NumChecks(), 200 + forest.NumTrees());
+    BruteForceKnn(points, kNumDims, query, 1, &expected_id, &expected_distance);
+    EXPECT_GE(distance, expected_distance - 1e-5);
+    num_exact += (id == expected_id);
+  }
+  // Random data in 32 dimensions is the worst case for kd-trees; still, the
+  // bounded search must beat picking among the checked points at random.
+  EXPECT_GT(num_exact, 30);
+}
+
+TEST(KdForest, FewerPointsThanNeighbors) {
+  float points[] = { 0, 0,
+                     1, 1 };
+  KdForest<float> forest;
+  forest.Build(points, 2, 2, 2);
+
+  KdForest<float>::SearchContext context;
+  float query[] = { 0.9f, 0.8f };
+  int ids[3];
+  float distances[3];
+  EXPECT_EQ(2, forest.Knn(query, 3, 0, &context, ids, distances));
+  EXPECT_EQ(1, ids[0]);
+  EXPECT_EQ(0, ids[1]);
+  EXPECT_EQ(-1, ids[2]);
+  EXPECT_NEAR(0.1 * 0.1 + 0.2 * 0.2, distances[0], 1e-6);
+}
+
+TEST(DynamicKdTree, InsertAndRemove) {
+  const int kNumPoints = 1000, kNumDims = 8, kK = 3;
+  std::vector<float> points, queries;
+  RandomPoints(kNumPoints, kNumDims, 5, &points);
+  RandomPoints(50, kNumDims, 6, &queries);
+
+  DynamicKdTree<float> index(kNumDims, 16);
+  std::vector<bool> alive(kNumPoints, false);
+  for (int i = 0; i < kNumPoints; ++i) {
+    EXPECT_TRUE(index.Insert(&points[i * kNumDims], i));
+    alive[i] = true;
+  }
+  EXPECT_FALSE(index.Insert(&points[0], 0));
+  // 1000 = 62 * 16 + 8: one tree per bit set in 62.
+  EXPECT_EQ(5, index.NumTrees());
+
+  // Remove two points out of three, which rebuilds some levels, and put a few
+  // back.
+  for (int i = 0; i < kNumPoints; ++i) {
+    if (i % 3 != 0) {
+      EXPECT_TRUE(index.Remove(i));
+      alive[i] = false;
+    }
+  }
+  EXPECT_FALSE(index.Remove(1));
+  for (int i = 1; i < kNumPoints; i += 30) {
+    EXPECT_TRUE(index.Insert(&points[i * kNumDims], i));
+    alive[i] = true;
+  }
+  int num_alive = std::count(alive.begin(), alive.end(), true);
+  EXPECT_EQ(num_alive, index.Size());
+
+  for (int q = 0; q < 50; ++q) {
+    const float *query = &queries[q * kNumDims];
+    std::vector<std::pair<float, int> > expected;
+    for (int i = 0; i < kNumPoints; ++i) {
+      if (alive[i]) {
+        float distance = 0;
+        for (int d = 0; d < kNumDims; ++d) {
+          float diff = points[i * kNumDims + d] - query[d];
+          distance += diff * diff;
+        }
+        expected.push_back(std::make_pair(distance, i));
+      }
+    }
+    std::sort(expected.begin(), expected.end());
+
+    // Enough leafs for an exact search.
+    std::vector<int> ids;
+    std::vector<float> distances;
+    index.Knn(query, kK, kNumPoints, &ids, &distances);
+    ASSERT_EQ(kK, ids.size());
+    for (int i = 0; i < kK; ++i) {
+      EXPECT_EQ(expected[i].second, ids[i]);
+      EXPECT_NEAR(expected[i].first, distances[i], 1e-5);
+    }
+  }
+}
+
+TEST(DynamicKdTree, FewerPointsThanNeighbors) {
+  float points[] = { 0, 0,
+                     1, 1,
+                     2, 2 };
+  DynamicKdTree<float, char> index(2, 2);
+  index.Insert(points, 'a');
+  index.Insert(points + 2, 'b');
+  index.Insert(points + 4, 'c');
+  index.Remove('b');
+
+  float query[] = { 0.9f, 0.8f };
+  std::vector<char> ids;
+  std::vector<float> distances;
+  index.Knn(query, 3, 10, &ids, &distances);
+  ASSERT_EQ(2, ids.size());
+  EXPECT_EQ('a', ids[0]);
+  EXPECT_EQ('c', ids[1]);
+
+  index.Clear();
+  EXPECT_EQ(0, index.Size());
+  index.Knn(query, 3, 10, &ids, &distances);
+  EXPECT_EQ(0, ids.size());
+}
+
 }  // namespace
@@ -18,15 +18,30 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 
+#include <cstring>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "libmv/base/thread.h"
 #include "libmv/base/vector.h"
 #include "libmv/numeric/numeric.h"
 #include "libmv/correspondence/klt.h"
+#include "libmv/correspondence/klt_backend.h"
 #include "libmv/image/image.h"
 #include "libmv/image/image_io.h"
+#include "libmv/image/non_maximal_suppression.h"
 #include "libmv/image/convolve.h"
 #include "libmv/image/sample.h"
+#include "libmv/logging/logging.h"
 
 using std::max;
 using std::min;
@@ -36,24 +51,15 @@ namespace libmv {
 static void FindLocalMaxima(const FloatImage &trackness,
                             float min_trackness,
                             KLTContext::FeatureList *features) {
-  for (int i = 1; i < trackness.Height()-1; ++i) {
-    for (int j = 1; j < trackness.Width()-1; ++j) {
-      if (   trackness(i,j) >= min_trackness
-          && trackness(i,j) >= trackness(i-1, j-1)
-          && trackness(i,j) >= trackness(i-1, j  )
-          && trackness(i,j) >= trackness(i-1, j+1)
-          && trackness(i,j) >= trackness(i  , j-1)
-          && trackness(i,j) >= trackness(i  , j+1)
-          && trackness(i,j) >= trackness(i+1, j-1)
-          && trackness(i,j) >= trackness(i+1, j  )
-          && trackness(i,j) >= trackness(i+1, j+1)) {
-        KLTPointFeature *p = new KLTPointFeature;
-        p->coords(1) = i;
-        p->coords(0) = j;
-        p->trackness = trackness(i,j);
-        features->push_back(p);
-      }
-    }
+  vector<Vec2i> maxima;
+  maxima.reserve(trackness.Width() * trackness.Height() / 16);
+  FindLocalMaximaMaxFilter(trackness, 3, min_trackness, &maxima);
+  for (int k = 0; k < maxima.size(); ++k) {
+    KLTPointFeature *p = new KLTPointFeature;
+    p->coords(1) = maxima[k](1);
+    p->coords(0) = maxima[k](0);
+    p->trackness = trackness(maxima[k](1), maxima[k](0));
+    features->push_back(p);
   }
 }
 
@@ -64,16 +70,17 @@ static void FindLocalMaxima(const FloatImage &trackness,
 // This function computes the matrix for every pixel.
 static void ComputeGradientMatrix(const Array3Df &image_and_gradients,
                                        int window_size,
-                                       Array3Df *gradient_matrix) {
-  Array3Df gradients;
-  gradients.ResizeLike(image_and_gradients);
+                                       FloatImage3 *gradient_matrix) {
+  FloatImage3 gradients(image_and_gradients.Height(),
+                        image_and_gradients.Width());
   for (int j = 0; j < image_and_gradients.Height(); ++j) {
     for (int i = 0; i < image_and_gradients.Width(); ++i) {
       float gx = image_and_gradients(j, i, 1);
       float gy = image_and_gradients(j, i, 2);
-      gradients(j, i, 0) = gx * gx;
-      gradients(j, i, 1) = gx * gy;
-      gradients(j, i, 2) = gy * gy;
+      float *g = gradients.Pixel(j, i);
+      g[0] = gx * gx;
+      g[1] = gx * gy;
+      g[2] = gy * gy;
     }
   }
   // Sum the gradient matrix over tracking window for each pixel.
@@ -93,7 +100,7 @@ static float MinEigenValue(float gxx, float gxy, float gyy) {
 
 // Compute trackness of every pixel given the gradient matrix.
 // This is done as described in the Good Features to Track paper.
-static void ComputeTrackness(const Array3Df gradient_matrix,
+static void ComputeTrackness(const FloatImage3 &gradient_matrix,
                              Array3Df *trackness_pointer,
                              double *trackness_mean) {
   Array3Df &trackness = *trackness_pointer;
@@ -101,9 +108,8 @@ static void ComputeTrackness(const Array3Df gradient_matrix,
   *trackness_mean = 0;
   for (int i = 0; i < trackness.Height(); ++i) {
     for (int j = 0; j < trackness.Width(); ++j) {
-      double t = MinEigenValue(gradient_matrix(i, j, 0),
-                               gradient_matrix(i, j, 1),
-                               gradient_matrix(i, j, 2));
+      const float *g = gradient_matrix.Pixel(i, j);
+      double t = MinEigenValue(g[0], g[1], g[2]);
       trackness(i, j) = t;
       *trackness_mean += t;
     }
@@ -111,12 +117,6 @@ static void ComputeTrackness(const Array3Df gradient_matrix,
   *trackness_mean /= trackness.Size();
 }
 
-static double dist2(const Vec2f &x, const Vec2f &y) {
-  double a = x(0) - y(0);
-  double b = x(1) - y(1);
-  return a * a + b * b;
-}
-
 // TODO(keir): Use Stan's neat trick of using a 'punch-out' array to detect
 // too-closes features. This is O(n^2)!
 static void RemoveTooCloseFeatures(KLTContext::FeatureList *features,
@@ -128,7 +128,7 @@ static void RemoveTooCloseFeatures(KLTContext::FeatureList *features,
     KLTContext::FeatureList::iterator j = i;
     ++j;
     while (j != features->end() && !i_deleted) {
-      if (dist2((*i)->coords, (*j)->coords) < mindist2) {
+      if (SquaredDistanceL2((*i)->coords, (*j)->coords) < mindist2) {
         KLTContext::FeatureList::iterator to_delete;
         if ((*i)->trackness < (*j)->trackness) {
           to_delete = i;
@@ -152,7 +152,8 @@ static void RemoveTooCloseFeatures(KLTContext::FeatureList *features,
 
 void KLTContext::DetectGoodFeatures(const Array3Df &image_and_gradients,
                                     FeatureList *features) {
-  Array3Df gradient_matrix;
+  LIBMV_SCOPED_TIMER("klt.detect");
+  FloatImage3 gradient_matrix;
   ComputeGradientMatrix(image_and_gradients, WindowSize(), &gradient_matrix);
 
   Array3Df trackness;
@@ -165,39 +166,412 @@ void KLTContext::DetectGoodFeatures(const Array3Df &image_and_gradients,
   RemoveTooCloseFeatures(features, min_feature_dist_ * min_feature_dist_);
 }
 
+namespace {
+
+// Trackness of the pixels of one cell of the replenishment grid, and of a
+// ring of one pixel around it for the non maximal suppression.
+struct TracknessTile {
+  int x0, y0;  // Position of the tile in the image.
+  Array3Df trackness;
+};
+
+// Computes the trackness of the pixels [x0, x1) x [y0, y1) of the image, with
+// the gradient matrix summed over the window clipped to the image like
+// BoxFilter() does.
+void ComputeTracknessTile(const Array3Df &image_and_gradients,
+                          int half_window_size,
+                          int x0, int y0, int x1, int y1,
+                          TracknessTile *tile) {
+  const int width = image_and_gradients.Width();
+  const int height = image_and_gradients.Height();
+  const int sx0 = max(0, x0 - half_window_size);
+  const int sy0 = max(0, y0 - half_window_size);
+  const int sx1 = min(width, x1 + half_window_size);
+  const int sy1 = min(height, y1 + half_window_size);
+
+  // Integral images of gx^2, gx gy and gy^2 over the summed area.
+  const int iw = sx1 - sx0 + 1, ih = sy1 - sy0 + 1;
+  std::vector<double> integral(3 * iw * ih, 0.0);
+  for (int r = 1; r < ih; ++r) {
+    double row_sum[3] = { 0, 0, 0 };
+    for (int c = 1; c < iw; ++c) {
+      float gx = image_and_gradients(sy0 + r - 1, sx0 + c - 1, 1);
+      float gy = image_and_gradients(sy0 + r - 1, sx0 + c - 1, 2);
+      row_sum[0] += gx * gx;
+      row_sum[1] += gx * gy;
+      row_sum[2] += gy * gy;
+      for (int k = 0; k < 3; ++k) {
+        integral[3 * (r * iw + c) + k] =
+            integral[3 * ((r - 1) * iw + c) + k] + row_sum[k];
+      }
+    }
+  }
+
+  tile->x0 = x0;
+  tile->y0 = y0;
+  tile->trackness.Resize(y1 - y0, x1 - x0);
+  for (int y = y0; y < y1; ++y) {
+    const int r0 = max(sy0, y - half_window_size) - sy0;
+    const int r1 = min(sy1, y + half_window_size + 1) - sy0;
+    for (int x = x0; x < x1; ++x) {
+      const int c0 = max(sx0, x - half_window_size) - sx0;
+      const int c1 = min(sx1, x + half_window_size + 1) - sx0;
+      float g[3];
+      for (int k = 0; k < 3; ++k) {
+        g[k] = integral[3 * (r1 * iw + c1) + k] -
+               integral[3 * (r0 * iw + c1) + k] -
+               integral[3 * (r1 * iw + c0) + k] +
+               integral[3 * (r0 * iw + c0) + k];
+      }
+      tile->trackness(y - y0, x - x0) = MinEigenValue(g[0], g[1], g[2]);
+    }
+  }
+}
+
+bool MoreTrackable(const KLTPointFeature *a, const KLTPointFeature *b) {
+  return a->trackness > b->trackness;
+}
+
+// Buckets of features, in cells at least as large as the minimum distance
+// between features: only the 3x3 cells around a point can be too close.
+class FeatureGrid {
+ public:
+  FeatureGrid(int width, int height, int cell_size)
+      : cell_size_(cell_size),
+        columns_((width + cell_size - 1) / cell_size),
+        rows_((height + cell_size - 1) / cell_size),
+        cells_(columns_ * rows_) {}
+
+  int Cell(const Vec2f &p) const {
+    int column = min(columns_ - 1, max(0, int(p(0)) / cell_size_));
+    int row = min(rows_ - 1, max(0, int(p(1)) / cell_size_));
+    return row * columns_ + column;
+  }
+
+  bool IsEmpty(int cell) const { return cells_[cell].empty(); }
+
+  void Add(const Vec2f &p) { cells_[Cell(p)].push_back(p); }
+
+  bool HasPointCloserThan(const Vec2f &p, double distance2) const {
+    int cell = Cell(p);
+    int column = cell % columns_, row = cell / columns_;
+    for (int r = max(0, row - 1); r <= min(rows_ - 1, row + 1); ++r) {
+      for (int c = max(0, column - 1); c <= min(columns_ - 1, column + 1);
+           ++c) {
+        const std::vector<Vec2f> &points = cells_[r * columns_ + c];
+        for (int i = 0; i < points.size(); ++i) {
+          if (SquaredDistanceL2(points[i], p) < distance2) {
+            return true;
+          }
+        }
+      }
+    }
+    return false;
+  }
+
+  int NumColumns() const { return columns_; }
+  int NumRows() const { return rows_; }
+
+ private:
+  int cell_size_;
+  int columns_;
+  int rows_;
+  std::vector<std::vector<Vec2f> > cells_;
+};
+
+}  // namespace
+
+void KLTContext::ReplenishGoodFeatures(const Array3Df &image_and_gradients,
+                                       FeatureList *features) {
+  LIBMV_SCOPED_TIMER("klt.replenish");
+  const int width = image_and_gradients.Width();
+  const int height = image_and_gradients.Height();
+  const int cell_size = max(1, int(ceil(min_feature_dist_)));
+  FeatureGrid grid(width, height, cell_size);
+  for (FeatureList::const_iterator it = features->begin();
+       it != features->end(); ++it) {
+    grid.Add((*it)->coords);
+  }
+
+  // Trackness of the cells without live features.
+  std::vector<TracknessTile> tiles;
+  double trackness_sum = 0;
+  int trackness_count = 0;
+  for (int row = 0; row < grid.NumRows(); ++row) {
+    for (int column = 0; column < grid.NumColumns(); ++column) {
+      if (!grid.IsEmpty(row * grid.NumColumns() + column)) {
+        continue;
+      }
+      int x0 = column * cell_size, y0 = row * cell_size;
+      int x1 = min(width, x0 + cell_size), y1 = min(height, y0 + cell_size);
+      tiles.push_back(TracknessTile());
+      TracknessTile &tile = tiles.back();
+      ComputeTracknessTile(image_and_gradients, HalfWindowSize(),
+                           max(0, x0 - 1), max(0, y0 - 1),
+                           min(width, x1 + 1), min(height, y1 + 1), &tile);
+      for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+          trackness_sum += tile.trackness(y - tile.y0, x - tile.x0);
+        }
+      }
+      trackness_count += (x1 - x0) * (y1 - y0);
+    }
+  }
+  if (trackness_count == 0) {
+    return;
+  }
+  min_trackness_ = trackness_sum / trackness_count;
+
+  // The local maxima of the tiles are in their cells, as the ring is skipped.
+  std::vector<KLTPointFeature *> candidates;
+  vector<Vec2i> maxima;
+  for (int i = 0; i < tiles.size(); ++i) {
+    const TracknessTile &tile = tiles[i];
+    maxima.clear();
+    FindLocalMaximaMaxFilter(tile.trackness, 3, min_trackness_, &maxima);
+    for (int k = 0; k < maxima.size(); ++k) {
+      KLTPointFeature *p = new KLTPointFeature;
+      p->coords(0) = tile.x0 + maxima[k](0);
+      p->coords(1) = tile.y0 + maxima[k](1);
+      p->trackness = tile.trackness(maxima[k](1), maxima[k](0));
+      candidates.push_back(p);
+    }
+  }
+
+  // Keep the most trackable candidates first.
+  std::stable_sort(candidates.begin(), candidates.end(), MoreTrackable);
+  const double min_distance2 = min_feature_dist_ * min_feature_dist_;
+  for (int i = 0; i < candidates.size(); ++i) {
+    if (grid.HasPointCloserThan(candidates[i]->coords, min_distance2)) {
+      delete candidates[i];
+    } else {
+      grid.Add(candidates[i]->coords);
+      features->push_back(candidates[i]);
+    }
+  }
+}
+
+// Fetch all the levels of a pyramid up front. ImagePyramid::Level() may touch
+// an image cache, so it must not be called from the tracking threads.
+static void FetchLevels(ImagePyramid *pyramid,
+                        std::vector<const FloatImage *> *levels) {
+  levels->resize(pyramid->NumLevels());
+  for (int i = 0; i < pyramid->NumLevels(); ++i) {
+    (*levels)[i] = &pyramid->Level(i);
+  }
+}
+
+namespace {
+
+// Track features1[i] into (*features2)[i], and back if the forward-backward
+// check is enabled. Used by ParallelFor, each index only touches its own
+// output slots.
+struct TrackFeaturesFunctor {
+  const KLTContext *klt;
+  const std::vector<const FloatImage *> *levels1;
+  const std::vector<const FloatImage *> *levels2;
+  const KLTPointFeature *const *features1;
+  KLTPointFeature **features2;
+  int *tracked;
+  int *rejected;
+
+  void operator()(int i) {
+    tracked[i] = klt->TrackFeature(*levels1, *features1[i],
+                                   *levels2, features2[i]);
+    rejected[i] = tracked[i] &&
+                  !klt->TracksBack(*levels1, *features1[i],
+                                   *levels2, *features2[i]);
+    if (rejected[i]) {
+      tracked[i] = 0;
+    }
+  }
+};
+
+int Sum(const std::vector<int> &values) {
+  int sum = 0;
+  for (size_t i = 0; i < values.size(); ++i) {
+    sum += values[i];
+  }
+  return sum;
+}
+
+}  // namespace
+
 void KLTContext::TrackFeatures(ImagePyramid *pyramid1,
                                const FeatureList &features1,
                                ImagePyramid *pyramid2,
                                FeatureList *features2_pointer) {
+  LIBMV_SCOPED_TIMER("klt.track");
   FeatureList &features2 = *features2_pointer;
 
+  std::vector<const FloatImage *> levels1, levels2;
+  FetchLevels(pyramid1, &levels1);
+  FetchLevels(pyramid2, &levels2);
+
+  std::vector<const KLTPointFeature *> inputs(features1.begin(),
+                                              features1.end());
+  std::vector<KLTPointFeature *> outputs(inputs.size());
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    outputs[i] = new KLTPointFeature;
+  }
+  std::vector<int> tracked(inputs.size()), rejected(inputs.size());
+
+  TrackFeaturesFunctor functor;
+  functor.klt = this;
+  functor.levels1 = &levels1;
+  functor.levels2 = &levels2;
+  functor.features1 = inputs.empty() ? NULL : &inputs[0];
+  functor.features2 = outputs.empty() ? NULL : &outputs[0];
+  functor.tracked = tracked.empty() ? NULL : &tracked[0];
+  functor.rejected = rejected.empty() ? NULL : &rejected[0];
+  ParallelFor(0, inputs.size(), num_threads_, &functor);
+  LIBMV_COUNTER("klt.forward_backward_rejected", Sum(rejected));
+
   features2.clear();
-  for (FeatureList::const_iterator i = features1.begin();
-       i != features1.end(); ++i) {
-    KLTPointFeature *tracked_feature = new KLTPointFeature;
-    TrackFeature(pyramid1, **i, pyramid2, tracked_feature);
-    features2.push_back(tracked_feature);
+  features2.insert(features2.end(), outputs.begin(), outputs.end());
+}
+
+int KLTContext::TrackFeatures(ImagePyramid *pyramid1,
+                              const FeatureArray &features1,
+                              ImagePyramid *pyramid2,
+                              FeatureArray *features2_pointer,
+                              std::vector<int> *tracked_pointer) {
+  LIBMV_SCOPED_TIMER("klt.track");
+  FeatureArray &features2 = *features2_pointer;
+  features2.resize(features1.size());
+  for (size_t i = 0; i < features1.size(); ++i) {
+    // Keep the window size and trackness of the source feature.
+    features2[i] = features1[i];
+  }
+  std::vector<int> tracked(features1.size()), rejected(features1.size());
+
+  if (backend_) {
+    std::vector<Vec2> positions1(features1.size());
+    std::vector<Vec2> positions2(features1.size());
+    for (size_t i = 0; i < features1.size(); ++i) {
+      positions1[i] = features1[i].coords.cast<double>();
+      positions2[i] = InitialPosition(features1[i]);
+    }
+    backend_->TrackFeatures(*this, pyramid1, pyramid2,
+                            positions1, &positions2, &tracked);
+    for (size_t i = 0; i < features1.size(); ++i) {
+      if (tracked[i]) {
+        features2[i].coords = positions2[i].cast<float>();
+      }
+    }
+    if (max_forward_backward_error_ > 0) {
+      // The tracked features back, as a second batch on the same pyramids.
+      std::vector<int> indices;
+      std::vector<Vec2> back_from, back_to;
+      for (size_t i = 0; i < features1.size(); ++i) {
+        if (tracked[i]) {
+          indices.push_back(i);
+          back_from.push_back(positions2[i]);
+          back_to.push_back(BackwardInitialPosition(features1[i],
+                                                    positions2[i]));
+        }
+      }
+      std::vector<int> tracked_back(indices.size());
+      backend_->TrackFeatures(*this, pyramid2, pyramid1,
+                              back_from, &back_to, &tracked_back);
+      for (size_t j = 0; j < indices.size(); ++j) {
+        int i = indices[j];
+        if (!tracked_back[j] || !IsBackWithinError(features1[i], back_to[j])) {
+          tracked[i] = 0;
+          rejected[i] = 1;
+        }
+      }
+    }
+  } else {
+    std::vector<const FloatImage *> levels1, levels2;
+    FetchLevels(pyramid1, &levels1);
+    FetchLevels(pyramid2, &levels2);
+
+    std::vector<const KLTPointFeature *> inputs(features1.size());
+    std::vector<KLTPointFeature *> outputs(features1.size());
+    for (size_t i = 0; i < features1.size(); ++i) {
+      inputs[i] = &features1[i];
+      outputs[i] = &features2[i];
+    }
+
+    TrackFeaturesFunctor functor;
+    functor.klt = this;
+    functor.levels1 = &levels1;
+    functor.levels2 = &levels2;
+    functor.features1 = inputs.empty() ? NULL : &inputs[0];
+    functor.features2 = outputs.empty() ? NULL : &outputs[0];
+    functor.tracked = tracked.empty() ? NULL : &tracked[0];
+    functor.rejected = rejected.empty() ? NULL : &rejected[0];
+    ParallelFor(0, inputs.size(), num_threads_, &functor);
   }
+
+  int num_tracked = Sum(tracked);
+  LIBMV_COUNTER("klt.tracked", num_tracked);
+  LIBMV_COUNTER("klt.lost", tracked.size() - num_tracked);
+  LIBMV_COUNTER("klt.forward_backward_rejected", Sum(rejected));
+  if (tracked_pointer) {
+    tracked_pointer->swap(tracked);
+  }
+  return num_tracked;
 }
 
 bool KLTContext::TrackFeature(ImagePyramid *pyramid1,
                               const KLTPointFeature &feature1,
                               ImagePyramid *pyramid2,
                               KLTPointFeature *feature2_pointer) {
-  Vec2 position1, position2;
-  position2(0) = feature1.coords(0);
-  position2(1) = feature1.coords(1);
-  position2 /= pow(2., pyramid1->NumLevels());
-
-  for (int i = pyramid1->NumLevels() - 1; i >= 0; --i) {
-    position1(0) = feature1.coords(0) / pow(2., i);
-    position1(1) = feature1.coords(1) / pow(2., i);
-    position2 *= 2;
-
-    bool succeeded = TrackFeatureOneLevel(pyramid1->Level(i),
-                                          position1,
-                                          pyramid2->Level(i),
-                                          &position2);
+  std::vector<const FloatImage *> levels1, levels2;
+  FetchLevels(pyramid1, &levels1);
+  FetchLevels(pyramid2, &levels2);
+  return TrackFeature(levels1, feature1, levels2, feature2_pointer);
+}
+
+ImagePyramid *KLTContext::MakeImagePyramid(const FloatImage &image,
+                                           int num_levels,
+                                           double sigma) const {
+  if (backend_) {
+    return backend_->MakeImagePyramid(image, num_levels, sigma);
+  }
+  return libmv::MakeImagePyramid(image, num_levels, sigma);
+}
+
+Vec2 KLTContext::InitialPosition(const KLTPointFeature &feature1) const {
+  Vec2 position = feature1.coords.cast<double>();
+  if (predictor_) {
+    position = predictor_->Predict(position);
+  }
+  return position;
+}
+
+Vec2 KLTContext::BackwardInitialPosition(const KLTPointFeature &feature1,
+                                         const Vec2 &position2) const {
+  return position2 - (InitialPosition(feature1) -
+                      feature1.coords.cast<double>());
+}
+
+bool KLTContext::IsBackWithinError(const KLTPointFeature &feature1,
+                                   const Vec2 &position1) const {
+  return (position1 - feature1.coords.cast<double>()).squaredNorm() <=
+         Square(max_forward_backward_error_);
+}
+
+bool KLTContext::TrackPosition(const std::vector<const FloatImage *> &levels1,
+                               const Vec2 &position1,
+                               const std::vector<const FloatImage *> &levels2,
+                               Vec2 *position2) const {
+  assert(levels1.size() == levels2.size());
+  int num_levels = levels1.size();
+
+  Vec2 level_position1;
+  Vec2 level_position2 = *position2 / pow(2., num_levels);
+
+  for (int i = num_levels - 1; i >= 0; --i) {
+    level_position1 = position1 / pow(2., i);
+    level_position2 *= 2;
+
+    bool succeeded = TrackFeatureOneLevel(*levels1[i],
+                                          level_position1,
+                                          *levels2[i],
+                                          &level_position2);
     if (i == 0 && !succeeded) {
       // Only fail on the highest-resolution level, because a failure on a
       // coarse level does not mean failure at a lower level (consider
@@ -205,22 +579,185 @@ bool KLTContext::TrackFeature(ImagePyramid *pyramid1,
       return false;
     }
   }
+  *position2 = level_position2;
+  return true;
+}
+
+bool KLTContext::TrackFeature(const std::vector<const FloatImage *> &levels1,
+                              const KLTPointFeature &feature1,
+                              const std::vector<const FloatImage *> &levels2,
+                              KLTPointFeature *feature2_pointer) const {
+  Vec2 position2 = InitialPosition(feature1);
+  if (!TrackPosition(levels1, feature1.coords.cast<double>(),
+                     levels2, &position2)) {
+    return false;
+  }
   feature2_pointer->coords = position2.cast<float>();
   return true;
 }
 
+bool KLTContext::TracksBack(const std::vector<const FloatImage *> &levels1,
+                            const KLTPointFeature &feature1,
+                            const std::vector<const FloatImage *> &levels2,
+                            const KLTPointFeature &feature2) const {
+  if (max_forward_backward_error_ <= 0) {
+    return true;
+  }
+  Vec2 position2 = feature2.coords.cast<double>();
+  Vec2 position1 = BackwardInitialPosition(feature1, position2);
+  return TrackPosition(levels2, position2, levels1, &position1) &&
+         IsBackWithinError(feature1, position1);
+}
+
+// All the samples of a tracking window share the same sub-pixel offset, so the
+// bilinear weights only need to be computed once per window. When the window
+// and the neighbourhood used by the interpolation lie inside the image, no
+// clamping is needed and the samples are read straight from memory.
+struct BilinearWindow {
+  const float *origin;  // Channel 0 of the top left pixel of the window.
+  int row_stride;       // Distance between rows, in floats.
+  float w00, w01, w10, w11;
+};
+
+// Return false if the window at position is too close to the border for the
+// fast path. Only interleaved 3-channel images (value, gx, gy) are handled;
+// their rows may be padded.
+static bool InitBilinearWindow(const ArrayView3D<const float> &image,
+                               const Vec2 &position,
+                               int half_width,
+                               BilinearWindow *window) {
+  if (image.Depth() != 3 || image.Stride(1) != 3 || image.Stride(2) != 1) {
+    return false;
+  }
+  double x_floor = floor(position(0));
+  double y_floor = floor(position(1));
+  int x0 = int(x_floor) - half_width;
+  int y0 = int(y_floor) - half_width;
+  int size = 2 * half_width + 1;
+  // The interpolation reads one pixel past the window in each direction, and
+  // the vectorized loads read four floats per pixel, i.e. one float of the
+  // pixel after that.
+  if (x0 < 0 || y0 < 0 ||
+      x0 + size + 1 >= image.Width() ||
+      y0 + size >= image.Height()) {
+    return false;
+  }
+  float dx = position(0) - x_floor;
+  float dy = position(1) - y_floor;
+  window->origin = &image(y0, x0, 0);
+  window->row_stride = image.Stride(0);
+  window->w00 = (1 - dx) * (1 - dy);
+  window->w01 = dx * (1 - dy);
+  window->w10 = (1 - dx) * dy;
+  window->w11 = dx * dy;
+  return true;
+}
+
+// Accumulate the tracking equation over a window that passed
+// InitBilinearWindow() in both images. The image channel of image 2 and its
+// gradients are interpolated together.
+static void ComputeTrackingEquationInterior(const BilinearWindow &window1,
+                                            const BilinearWindow &window2,
+                                            int half_width,
+                                            float *gxx,
+                                            float *gxy,
+                                            float *gyy,
+                                            float *ex,
+                                            float *ey) {
+  const int size = 2 * half_width + 1;
+  const int stride1 = window1.row_stride;
+  const int stride2 = window2.row_stride;
+#ifdef __SSE__
+  const __m128 a00 = _mm_set1_ps(window1.w00);
+  const __m128 a01 = _mm_set1_ps(window1.w01);
+  const __m128 a10 = _mm_set1_ps(window1.w10);
+  const __m128 a11 = _mm_set1_ps(window1.w11);
+  const __m128 b00 = _mm_set1_ps(window2.w00);
+  const __m128 b01 = _mm_set1_ps(window2.w01);
+  const __m128 b10 = _mm_set1_ps(window2.w10);
+  const __m128 b11 = _mm_set1_ps(window2.w11);
+  // Lanes: (gxx, gxy, gyy, unused) and (unused, ex, ey, unused).
+  __m128 g_sum = _mm_setzero_ps();
+  __m128 e_sum = _mm_setzero_ps();
+  for (int r = 0; r < size; ++r) {
+    const float *p1 = window1.origin + r * stride1;
+    const float *p2 = window2.origin + r * stride2;
+    for (int c = 0; c < size; ++c, p1 += 3, p2 += 3) {
+      // Interpolate (I, gx1, gy1, -) and (J, gx, gy, -) in one go.
+      __m128 s1 = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(a00, _mm_loadu_ps(p1)),
+                     _mm_mul_ps(a01, _mm_loadu_ps(p1 + 3))),
+          _mm_add_ps(_mm_mul_ps(a10, _mm_loadu_ps(p1 + stride1)),
+                     _mm_mul_ps(a11, _mm_loadu_ps(p1 + stride1 + 3))));
+      __m128 s2 = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(b00, _mm_loadu_ps(p2)),
+                     _mm_mul_ps(b01, _mm_loadu_ps(p2 + 3))),
+          _mm_add_ps(_mm_mul_ps(b10, _mm_loadu_ps(p2 + stride2)),
+                     _mm_mul_ps(b11, _mm_loadu_ps(p2 + stride2 + 3))));
+      __m128 d = _mm_sub_ps(s1, s2);
+      __m128 e = _mm_shuffle_ps(d, d, _MM_SHUFFLE(0, 0, 0, 0));
+      __m128 u = _mm_shuffle_ps(s2, s2, _MM_SHUFFLE(3, 2, 1, 1));
+      __m128 v = _mm_shuffle_ps(s2, s2, _MM_SHUFFLE(3, 2, 2, 1));
+      g_sum = _mm_add_ps(g_sum, _mm_mul_ps(u, v));
+      e_sum = _mm_add_ps(e_sum, _mm_mul_ps(e, s2));
+    }
+  }
+  float g[4], e[4];
+  _mm_storeu_ps(g, g_sum);
+  _mm_storeu_ps(e, e_sum);
+  *gxx = g[0];
+  *gxy = g[1];
+  *gyy = g[2];
+  *ex = e[1];
+  *ey = e[2];
+#else
+  *gxx = *gxy = *gyy = 0;
+  *ex = *ey = 0;
+  for (int r = 0; r < size; ++r) {
+    const float *p1 = window1.origin + r * stride1;
+    const float *p2 = window2.origin + r * stride2;
+    for (int c = 0; c < size; ++c, p1 += 3, p2 += 3) {
+      float I = window1.w00 * p1[0] + window1.w01 * p1[3] +
+                window1.w10 * p1[stride1] + window1.w11 * p1[stride1 + 3];
+      float s2[3];
+      for (int k = 0; k < 3; ++k) {
+        s2[k] = window2.w00 * p2[k] + window2.w01 * p2[k + 3] +
+                window2.w10 * p2[k + stride2] +
+                window2.w11 * p2[k + stride2 + 3];
+      }
+      float J = s2[0], gx = s2[1], gy = s2[2];
+      *gxx += gx * gx;
+      *gxy += gx * gy;
+      *gyy += gy * gy;
+      *ex += (I - J) * gx;
+      *ey += (I - J) * gy;
+    }
+  }
+#endif
+}
+
 // Compute the gradient matrix noted by Z and the error vector e.
 // See Good Features to Track.
-static void ComputeTrackingEquation(const Array3Df &image_and_gradient1,
-                                    const Array3Df &image_and_gradient2,
-                                    const Vec2 &position1,
-                                    const Vec2 &position2,
-                                    int half_width,
-                                    float *gxx,
-                                    float *gxy,
-                                    float *gyy,
-                                    float *ex,
-                                    float *ey) {
+static void ComputeTrackingEquation(
+    const ArrayView3D<const float> &image_and_gradient1,
+    const ArrayView3D<const float> &image_and_gradient2,
+    const Vec2 &position1,
+    const Vec2 &position2,
+    int half_width,
+    float *gxx,
+    float *gxy,
+    float *gyy,
+    float *ex,
+    float *ey) {
+  BilinearWindow window1, window2;
+  if (InitBilinearWindow(image_and_gradient1, position1, half_width,
+                         &window1) &&
+      InitBilinearWindow(image_and_gradient2, position2, half_width,
+                         &window2)) {
+    ComputeTrackingEquationInterior(window1, window2, half_width,
+                                    gxx, gxy, gyy, ex, ey);
+    return;
+  }
   *gxx = *gxy = *gyy = 0;
   *ex = *ey = 0;
   for (int r = -half_width; r <= half_width; ++r) {
@@ -270,12 +807,22 @@ static bool SolveTrackingEquation(float gxx, float gxy, float gyy,
 bool KLTContext::TrackFeatureOneLevel(const Array3Df &image_and_gradient1,
                                       const Vec2 &position1,
                                       const Array3Df &image_and_gradient2,
-                                      Vec2 *position2_pointer) {
+                                      Vec2 *position2_pointer) const {
+  return TrackFeatureOneLevel(ArrayView3D<const float>(image_and_gradient1),
+                              position1,
+                              ArrayView3D<const float>(image_and_gradient2),
+                              position2_pointer);
+}
+
+bool KLTContext::TrackFeatureOneLevel(
+    const ArrayView3D<const float> &image_and_gradient1,
+    const Vec2 &position1,
+    const ArrayView3D<const float> &image_and_gradient2,
+    Vec2 *position2_pointer) const {
   Vec2 &position2 = *position2_pointer;
 
   int i;
   float dx=0, dy=0;
-  max_iterations_ = 10;
   for (i = 0; i < max_iterations_; ++i) {
     // Compute gradient matrix and error vector.
     float gxx, gxy, gyy, ex, ey;
@@ -308,6 +855,363 @@ bool KLTContext::TrackFeatureOneLevel(const Array3Df &image_and_gradient1,
 }
 
 
+namespace {
+
+// Bilinear weights of the fixed point kernels, in units of 2^-kWeightBits.
+const int kWeightBits = 14;
+// Intensities are interpolated to kFixedPointGradientScale (2^5) times their
+// byte value, the scale of the gradients.
+const int kIntensityDescale = kWeightBits - 5;
+
+struct FixedPointWindow {
+  int x0, y0;  // Top left pixel of the window.
+  int w00, w01, w10, w11;
+};
+
+void InitFixedPointWindow(const Vec2 &position, int half_width,
+                          FixedPointWindow *window) {
+  double x_floor = floor(position(0));
+  double y_floor = floor(position(1));
+  window->x0 = int(x_floor) - half_width;
+  window->y0 = int(y_floor) - half_width;
+  float dx = position(0) - x_floor;
+  float dy = position(1) - y_floor;
+  const float one = 1 << kWeightBits;
+  window->w00 = int(floor((1 - dx) * (1 - dy) * one + 0.5f));
+  window->w01 = int(floor(dx * (1 - dy) * one + 0.5f));
+  window->w10 = int(floor((1 - dx) * dy * one + 0.5f));
+  window->w11 = (1 << kWeightBits) - window->w00 - window->w01 - window->w10;
+}
+
+// True if the window and the pixels right and below it are in the image.
+bool IsInterior(const FixedPointLevel &level,
+                const FixedPointWindow &window,
+                int size) {
+  return window.x0 >= 0 && window.y0 >= 0 &&
+         window.x0 + size < level.Width() &&
+         window.y0 + size < level.Height();
+}
+
+// Interpolate pixel (r, c) of the window, clamping to the image borders.
+template<typename T>
+inline int InterpolateFixedPoint(const Array3D<T> &image,
+                                 const FixedPointWindow &window,
+                                 int r, int c, int descale) {
+  int y = window.y0 + r, x = window.x0 + c;
+  int y1 = std::min(std::max(y, 0), image.Height() - 1);
+  int y2 = std::min(std::max(y + 1, 0), image.Height() - 1);
+  int x1 = std::min(std::max(x, 0), image.Width() - 1);
+  int x2 = std::min(std::max(x + 1, 0), image.Width() - 1);
+  int sum = window.w00 * image(y1, x1) + window.w01 * image(y1, x2) +
+            window.w10 * image(y2, x1) + window.w11 * image(y2, x2);
+  return (sum + (1 << (descale - 1))) >> descale;
+}
+
+#ifdef __SSE2__
+// Weights of two horizontally adjacent pixels, for _mm_madd_epi16().
+inline __m128i PairWeights(int left, int right) {
+  return _mm_set_epi16(right, left, right, left, right, left, right, left);
+}
+
+// Interpolate four consecutive pixels from rows of 16 bit values.
+inline __m128i Interpolate4(__m128i top_left, __m128i top_right,
+                            __m128i bottom_left, __m128i bottom_right,
+                            __m128i top_weights, __m128i bottom_weights,
+                            int descale) {
+  __m128i top = _mm_madd_epi16(_mm_unpacklo_epi16(top_left, top_right),
+                               top_weights);
+  __m128i bottom = _mm_madd_epi16(
+      _mm_unpacklo_epi16(bottom_left, bottom_right), bottom_weights);
+  __m128i sum = _mm_add_epi32(_mm_add_epi32(top, bottom),
+                              _mm_set1_epi32(1 << (descale - 1)));
+  return _mm_srai_epi32(sum, descale);
+}
+
+inline __m128i LoadFourShorts(const short *p) {
+  return _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p));
+}
+
+inline __m128i LoadFourBytes(const unsigned char *p) {
+  int bytes;
+  std::memcpy(&bytes, p, sizeof(bytes));
+  return _mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), _mm_setzero_si128());
+}
+
+inline float SumLanes(__m128 v) {
+  float lanes[4];
+  _mm_storeu_ps(lanes, v);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+#endif
+
+// The tracking equation of ComputeTrackingEquation() on fixed point levels.
+// The samples are interpolated with integer weights and the products of the
+// interpolated values are exact; only their sums are floating point. With
+// SSE2, the interior of the windows is processed four pixels at a time.
+void ComputeFixedPointTrackingEquation(const FixedPointLevel &level1,
+                                       const FixedPointLevel &level2,
+                                       float intensity_scale,
+                                       const Vec2 &position1,
+                                       const Vec2 &position2,
+                                       int half_width,
+                                       float *gxx,
+                                       float *gxy,
+                                       float *gyy,
+                                       float *ex,
+                                       float *ey) {
+  const int size = 2 * half_width + 1;
+  FixedPointWindow window1, window2;
+  InitFixedPointWindow(position1, half_width, &window1);
+  InitFixedPointWindow(position2, half_width, &window2);
+  float sum_xx = 0, sum_xy = 0, sum_yy = 0, sum_ex = 0, sum_ey = 0;
+
+  // Columns [0, vector_end) of the rows are done with SSE2.
+  int vector_end = 0;
+#ifdef __SSE2__
+  if (IsInterior(level1, window1, size) && IsInterior(level2, window2, size)) {
+    vector_end = size / 4 * 4;
+    const __m128i top1 = PairWeights(window1.w00, window1.w01);
+    const __m128i bottom1 = PairWeights(window1.w10, window1.w11);
+    const __m128i top2 = PairWeights(window2.w00, window2.w01);
+    const __m128i bottom2 = PairWeights(window2.w10, window2.w11);
+    const __m128i zero = _mm_setzero_si128();
+    const int image_stride1 = level1.image.Stride(0);
+    const int image_stride2 = level2.image.Stride(0);
+    const int gradient_stride = level2.gradient_x.Stride(0);
+    __m128 xx = _mm_setzero_ps(), xy = _mm_setzero_ps(),
+           yy = _mm_setzero_ps(), vex = _mm_setzero_ps(),
+           vey = _mm_setzero_ps();
+    for (int r = 0; r < size; ++r) {
+      const unsigned char *i1 = &level1.image(window1.y0 + r, window1.x0);
+      const unsigned char *i2 = &level2.image(window2.y0 + r, window2.x0);
+      const short *gx = &level2.gradient_x(window2.y0 + r, window2.x0);
+      const short *gy = &level2.gradient_y(window2.y0 + r, window2.x0);
+      for (int c = 0; c < vector_end; c += 4) {
+        __m128i I = Interpolate4(
+            LoadFourBytes(i1 + c), LoadFourBytes(i1 + c + 1),
+            LoadFourBytes(i1 + c + image_stride1),
+            LoadFourBytes(i1 + c + image_stride1 + 1),
+            top1, bottom1, kIntensityDescale);
+        __m128i J = Interpolate4(
+            LoadFourBytes(i2 + c), LoadFourBytes(i2 + c + 1),
+            LoadFourBytes(i2 + c + image_stride2),
+            LoadFourBytes(i2 + c + image_stride2 + 1),
+            top2, bottom2, kIntensityDescale);
+        __m128i Gx = Interpolate4(
+            LoadFourShorts(gx + c), LoadFourShorts(gx + c + 1),
+            LoadFourShorts(gx + c + gradient_stride),
+            LoadFourShorts(gx + c + gradient_stride + 1),
+            top2, bottom2, kWeightBits);
+        __m128i Gy = Interpolate4(
+            LoadFourShorts(gy + c), LoadFourShorts(gy + c + 1),
+            LoadFourShorts(gy + c + gradient_stride),
+            LoadFourShorts(gy + c + gradient_stride + 1),
+            top2, bottom2, kWeightBits);
+        // Back to 16 bits: the four values are in the low half. The products
+        // of pairs of lanes are summed by _mm_madd_epi16().
+        __m128i e16 = _mm_packs_epi32(_mm_sub_epi32(I, J), zero);
+        __m128i gx16 = _mm_packs_epi32(Gx, zero);
+        __m128i gy16 = _mm_packs_epi32(Gy, zero);
+        xx = _mm_add_ps(xx, _mm_cvtepi32_ps(_mm_madd_epi16(gx16, gx16)));
+        xy = _mm_add_ps(xy, _mm_cvtepi32_ps(_mm_madd_epi16(gx16, gy16)));
+        yy = _mm_add_ps(yy, _mm_cvtepi32_ps(_mm_madd_epi16(gy16, gy16)));
+        vex = _mm_add_ps(vex, _mm_cvtepi32_ps(_mm_madd_epi16(e16, gx16)));
+        vey = _mm_add_ps(vey, _mm_cvtepi32_ps(_mm_madd_epi16(e16, gy16)));
+      }
+    }
+    sum_xx = SumLanes(xx);
+    sum_xy = SumLanes(xy);
+    sum_yy = SumLanes(yy);
+    sum_ex = SumLanes(vex);
+    sum_ey = SumLanes(vey);
+  }
+#endif
+  for (int r = 0; r < size; ++r) {
+    for (int c = vector_end; c < size; ++c) {
+      int I = InterpolateFixedPoint(level1.image, window1, r, c,
+                                    kIntensityDescale);
+      int J = InterpolateFixedPoint(level2.image, window2, r, c,
+                                    kIntensityDescale);
+      int gx = InterpolateFixedPoint(level2.gradient_x, window2, r, c,
+                                     kWeightBits);
+      int gy = InterpolateFixedPoint(level2.gradient_y, window2, r, c,
+                                     kWeightBits);
+      sum_xx += gx * gx;
+      sum_xy += gx * gy;
+      sum_yy += gy * gy;
+      sum_ex += (I - J) * gx;
+      sum_ey += (I - J) * gy;
+    }
+  }
+
+  // Back to the units of the float levels.
+  float scale = intensity_scale * kFixedPointGradientScale;
+  float inverse_scale2 = 1 / (scale * scale);
+  *gxx = sum_xx * inverse_scale2;
+  *gxy = sum_xy * inverse_scale2;
+  *gyy = sum_yy * inverse_scale2;
+  *ex = sum_ex * inverse_scale2;
+  *ey = sum_ey * inverse_scale2;
+}
+
+// Track features1[i] into (*features2)[i] through fixed point pyramids.
+struct TrackFixedPointFeaturesFunctor {
+  const KLTContext *klt;
+  const FixedPointPyramid *pyramid1;
+  const FixedPointPyramid *pyramid2;
+  const KLTPointFeature *features1;
+  KLTPointFeature *features2;
+  int *tracked;
+  int *rejected;
+
+  void operator()(int i) {
+    tracked[i] = klt->TrackFeature(*pyramid1, features1[i],
+                                   *pyramid2, &features2[i]);
+    rejected[i] = tracked[i] &&
+                  !klt->TracksBack(*pyramid1, features1[i],
+                                   *pyramid2, features2[i]);
+    if (rejected[i]) {
+      tracked[i] = 0;
+    }
+  }
+};
+
+}  // namespace
+
+bool KLTContext::TrackFeatureOneLevel(const FixedPointLevel &level1,
+                                      const Vec2 &position1,
+                                      const FixedPointLevel &level2,
+                                      float intensity_scale,
+                                      Vec2 *position2_pointer) const {
+  Vec2 &position2 = *position2_pointer;
+
+  for (int i = 0; i < max_iterations_; ++i) {
+    float gxx, gxy, gyy, ex, ey;
+    ComputeFixedPointTrackingEquation(level1, level2, intensity_scale,
+                                      position1, position2,
+                                      HalfWindowSize(),
+                                      &gxx, &gxy, &gyy, &ex, &ey);
+    float dx = 0, dy = 0;
+    if (!SolveTrackingEquation(gxx, gxy, gyy, ex, ey, min_determinant_,
+                               &dx, &dy)) {
+      return false;
+    }
+    position2(0) += dx;
+    position2(1) += dy;
+    if (Square(dx) + Square(dy) < min_update_distance2_) {
+      break;
+    }
+  }
+  return true;
+}
+
+bool KLTContext::TrackPosition(const FixedPointPyramid &pyramid1,
+                               const Vec2 &position1,
+                               const FixedPointPyramid &pyramid2,
+                               Vec2 *position2) const {
+  assert(pyramid1.NumLevels() == pyramid2.NumLevels());
+  assert(pyramid1.IntensityScale() == pyramid2.IntensityScale());
+  int num_levels = pyramid1.NumLevels();
+
+  Vec2 level_position1;
+  Vec2 level_position2 = *position2 / pow(2., num_levels);
+
+  for (int i = num_levels - 1; i >= 0; --i) {
+    level_position1 = position1 / pow(2., i);
+    level_position2 *= 2;
+
+    bool succeeded = TrackFeatureOneLevel(pyramid1.Level(i),
+                                          level_position1,
+                                          pyramid2.Level(i),
+                                          pyramid1.IntensityScale(),
+                                          &level_position2);
+    // As for the float pyramids, only fail on the finest level.
+    if (i == 0 && !succeeded) {
+      return false;
+    }
+  }
+  *position2 = level_position2;
+  return true;
+}
+
+bool KLTContext::TrackFeature(const FixedPointPyramid &pyramid1,
+                              const KLTPointFeature &feature1,
+                              const FixedPointPyramid &pyramid2,
+                              KLTPointFeature *feature2_pointer) const {
+  Vec2 position2 = InitialPosition(feature1);
+  if (!TrackPosition(pyramid1, feature1.coords.cast<double>(),
+                     pyramid2, &position2)) {
+    return false;
+  }
+  feature2_pointer->coords = position2.cast<float>();
+  return true;
+}
+
+bool KLTContext::TracksBack(const FixedPointPyramid &pyramid1,
+                            const KLTPointFeature &feature1,
+                            const FixedPointPyramid &pyramid2,
+                            const KLTPointFeature &feature2) const {
+  if (max_forward_backward_error_ <= 0) {
+    return true;
+  }
+  Vec2 position2 = feature2.coords.cast<double>();
+  Vec2 position1 = BackwardInitialPosition(feature1, position2);
+  return TrackPosition(pyramid2, position2, pyramid1, &position1) &&
+         IsBackWithinError(feature1, position1);
+}
+
+int KLTContext::TrackFeatures(const FixedPointPyramid &pyramid1,
+                              const FeatureArray &features1,
+                              const FixedPointPyramid &pyramid2,
+                              FeatureArray *features2_pointer,
+                              std::vector<int> *tracked_pointer) const {
+  LIBMV_SCOPED_TIMER("klt.track_fixed_point");
+  FeatureArray &features2 = *features2_pointer;
+  features2 = features1;
+  std::vector<int> tracked(features1.size()), rejected(features1.size());
+
+  TrackFixedPointFeaturesFunctor functor;
+  functor.klt = this;
+  functor.pyramid1 = &pyramid1;
+  functor.pyramid2 = &pyramid2;
+  functor.features1 = features1.empty() ? NULL : &features1[0];
+  functor.features2 = features2.empty() ? NULL : &features2[0];
+  functor.tracked = tracked.empty() ? NULL : &tracked[0];
+  functor.rejected = rejected.empty() ? NULL : &rejected[0];
+  ParallelFor(0, features1.size(), num_threads_, &functor);
+
+  int num_tracked = Sum(tracked);
+  LIBMV_COUNTER("klt.tracked", num_tracked);
+  LIBMV_COUNTER("klt.lost", tracked.size() - num_tracked);
+  LIBMV_COUNTER("klt.forward_backward_rejected", Sum(rejected));
+  if (tracked_pointer) {
+    tracked_pointer->swap(tracked);
+  }
+  return num_tracked;
+}
+Vec2 EstimateVelocity(const KLTContext::FeatureArray &features1,
+                      const KLTContext::FeatureArray &features2,
+                      const std::vector<int> *tracked) {
+  assert(features1.size() == features2.size());
+  std::vector<double> dx, dy;
+  for (size_t i = 0; i < features1.size(); ++i) {
+    if (tracked && !(*tracked)[i]) {
+      continue;
+    }
+    dx.push_back(features2[i].coords(0) - features1[i].coords(0));
+    dy.push_back(features2[i].coords(1) - features1[i].coords(1));
+  }
+  if (dx.empty()) {
+    return Vec2::Zero();
+  }
+  // The median is not thrown off by the features that are lost or that move
+  // on their own.
+  size_t middle = dx.size() / 2;
+  std::nth_element(dx.begin(), dx.begin() + middle, dx.end());
+  std::nth_element(dy.begin(), dy.begin() + middle, dy.end());
+  return Vec2(dx[middle], dy[middle]);
+}
+
 void KLTContext::DrawFeatureList(const FeatureList &features,
                                  const Vec3 &color,
                                  FloatImage *image) const {
@@ -23,8 +23,10 @@
 
 #include <cassert>
 #include <list>
+#include <vector>
 
 #include "libmv/correspondence/feature.h"
+#include "libmv/image/fixed_point_pyramid.h"
 #include "libmv/image/image.h"
 #include "libmv/image/image_pyramid.h"
 #include "libmv/numeric/numeric.h"
@@ -40,22 +42,81 @@ struct KLTPointFeature : public PointFeature {
   float trackness;
 };
 
+// Predicts where a feature of the previous frame is in the next one, to seed
+// the search of KLTContext::TrackFeature() on the coarsest pyramid level. With
+// a good prediction, large motions need fewer levels and iterations.
+class KLTMotionPredictor {
+ public:
+  virtual ~KLTMotionPredictor() {}
+  virtual Vec2 Predict(const Vec2 &position) const = 0;
+};
+
+// Every feature keeps moving by the same displacement per frame, for instance
+// the one measured on the previous frames by EstimateVelocity().
+class ConstantVelocityPredictor : public KLTMotionPredictor {
+ public:
+  explicit ConstantVelocityPredictor(const Vec2 &velocity)
+      : velocity_(velocity) {}
+  virtual ~ConstantVelocityPredictor() {}
+  virtual Vec2 Predict(const Vec2 &position) const {
+    return position + velocity_;
+  }
+ private:
+  Vec2 velocity_;
+};
+
+// Every feature moves by a global homography between the frames, for instance
+// the one fitted to the tracks of the previous frames.
+class HomographyPredictor : public KLTMotionPredictor {
+ public:
+  explicit HomographyPredictor(const Mat3 &H) : H_(H) {}
+  virtual ~HomographyPredictor() {}
+  virtual Vec2 Predict(const Vec2 &position) const {
+    Vec3 predicted = H_ * Vec3(position(0), position(1), 1);
+    if (predicted(2) == 0) {
+      return position;
+    }
+    return Vec2(predicted(0) / predicted(2), predicted(1) / predicted(2));
+  }
+ private:
+  Mat3 H_;
+};
+
+class KLTBackend;
+
 class KLTContext {
  public:
   typedef std::list<KLTPointFeature *> FeatureList;
 
+  // Contiguous storage for features; avoids the per-node allocations and
+  // pointer chasing of FeatureList when tracking thousands of features.
+  typedef std::vector<KLTPointFeature> FeatureArray;
+
   KLTContext()
       : half_window_size_(3),
         max_iterations_(10),
         min_trackness_(0.1),
         min_feature_dist_(10),
         min_determinant_(1e-6),
-        min_update_distance2_(1e-6) {
+        min_update_distance2_(1e-6),
+        max_forward_backward_error_(0),
+        num_threads_(1),
+        predictor_(NULL),
+        backend_(NULL) {
   }
 
   void DetectGoodFeatures(const Array3Df &image_and_gradients,
                           FeatureList *features);
 
+  // Adds good features to track to the live features, only looking in the
+  // areas without any: the trackness is computed in the cells of a grid of
+  // min_feature_dist_ that hold no feature, and the new features are kept,
+  // most trackable first, if they are min_feature_dist_ away from all the
+  // others. image_and_gradients is a level of an ImagePyramid, so nothing is
+  // blurred or differentiated again.
+  void ReplenishGoodFeatures(const Array3Df &image_and_gradients,
+                             FeatureList *features);
+
   bool TrackFeature(ImagePyramid *pyramid1,
                     const KLTPointFeature &feature1,
                     ImagePyramid *pyramid2,
@@ -66,27 +127,155 @@ class KLTContext {
                      ImagePyramid *pyramid2,
                      FeatureList *features2_pointer);
 
+  // Track every feature of features1 into the same slot of features2. If
+  // tracked is not null, (*tracked)[i] is set to 1 if feature i was tracked
+  // successfully and to 0 otherwise. Returns the number of tracked features.
+  // With a backend, the pyramids must come from MakeImagePyramid().
+  int TrackFeatures(ImagePyramid *pyramid1,
+                    const FeatureArray &features1,
+                    ImagePyramid *pyramid2,
+                    FeatureArray *features2_pointer,
+                    std::vector<int> *tracked = NULL);
+
   bool TrackFeatureOneLevel(const FloatImage &image_and_gradient1,
                             const Vec2 &position1,
                             const FloatImage &image_and_gradient2,
-                            Vec2 *position2_pointer);
+                            Vec2 *position2_pointer) const;
+
+  // Same as above for strided images, e.g. the views of a PaddedArray3D.
+  // The (value, gx, gy) channels can be interleaved or planar, and the rows
+  // can be padded.
+  bool TrackFeatureOneLevel(const ArrayView3D<const float> &image_and_gradient1,
+                            const Vec2 &position1,
+                            const ArrayView3D<const float> &image_and_gradient2,
+                            Vec2 *position2_pointer) const;
 
 
+  // Same as the float versions above on fixed point pyramids, with integer
+  // interpolation and exact products in the kernels. intensity_scale is the
+  // one of the pyramid the levels come from.
+  bool TrackFeatureOneLevel(const FixedPointLevel &level1,
+                            const Vec2 &position1,
+                            const FixedPointLevel &level2,
+                            float intensity_scale,
+                            Vec2 *position2_pointer) const;
+
+  bool TrackFeature(const FixedPointPyramid &pyramid1,
+                    const KLTPointFeature &feature1,
+                    const FixedPointPyramid &pyramid2,
+                    KLTPointFeature *feature2_pointer) const;
+
+  int TrackFeatures(const FixedPointPyramid &pyramid1,
+                    const FeatureArray &features1,
+                    const FixedPointPyramid &pyramid2,
+                    FeatureArray *features2_pointer,
+                    std::vector<int> *tracked = NULL) const;
+
   void DrawFeatureList(const FeatureList &features,
                        const Vec3 &color,
                        FloatImage *image) const;
-  int HalfWindowSize() { return half_window_size_; }
-  int WindowSize() { return 2 * HalfWindowSize() + 1; }
+  int HalfWindowSize() const { return half_window_size_; }
+  int WindowSize() const { return 2 * HalfWindowSize() + 1; }
+
+  // Number of threads used by TrackFeatures(). The features are split into
+  // contiguous chunks, one per thread, so the results do not depend on the
+  // number of threads.
+  void SetNumThreads(int num_threads) { num_threads_ = num_threads; }
+  int NumThreads() const { return num_threads_; }
+
+  // Tracks every feature back from where it was tracked to, on the same
+  // pyramids, and drops the features that land farther than max_error pixels
+  // from where they started: drifting tracks rarely come back. The backward
+  // track of a feature runs in the same task as its forward track, so the
+  // check costs a second tracking pass but no pyramid. Applies to the
+  // TrackFeatures() calls; 0, the default, disables the check.
+  void SetMaxForwardBackwardError(double max_error) {
+    max_forward_backward_error_ = max_error;
+  }
+  double MaxForwardBackwardError() const {
+    return max_forward_backward_error_;
+  }
+
+  // Whether feature2, tracked from feature1, tracks back to within
+  // MaxForwardBackwardError() of feature1. Always true when the check is
+  // disabled.
+  bool TracksBack(const std::vector<const FloatImage *> &levels1,
+                  const KLTPointFeature &feature1,
+                  const std::vector<const FloatImage *> &levels2,
+                  const KLTPointFeature &feature2) const;
+  bool TracksBack(const FixedPointPyramid &pyramid1,
+                  const KLTPointFeature &feature1,
+                  const FixedPointPyramid &pyramid2,
+                  const KLTPointFeature &feature2) const;
+
+  // Seeds the position of the tracked features with a prediction instead of
+  // their previous position. The predictor is not owned and must outlive the
+  // tracking calls; NULL, the default, disables the prediction.
+  void SetMotionPredictor(const KLTMotionPredictor *predictor) {
+    predictor_ = predictor;
+  }
+
+  // Builds the pyramids and tracks the features of the FeatureArray version
+  // of TrackFeatures() with backend, e.g. on an accelerator (see
+  // klt_backend.h). The backend is not owned and must outlive the tracking
+  // calls; NULL, the default, tracks on the host with NumThreads() threads.
+  void SetBackend(KLTBackend *backend) { backend_ = backend; }
+  KLTBackend *Backend() const { return backend_; }
+
+  // A pyramid for TrackFeatures(), made by the backend if there is one.
+  ImagePyramid *MakeImagePyramid(const FloatImage &image,
+                                 int num_levels,
+                                 double sigma = 0.9) const;
+
+  // Track a feature through pyramid levels that are already fetched. Unlike
+  // ImagePyramid::Level(), this is safe to call from several threads at once.
+  bool TrackFeature(const std::vector<const FloatImage *> &levels1,
+                    const KLTPointFeature &feature1,
+                    const std::vector<const FloatImage *> &levels2,
+                    KLTPointFeature *feature2_pointer) const;
 
  private:
+  // The position in the next frame to start the search from.
+  Vec2 InitialPosition(const KLTPointFeature &feature1) const;
+  // The position in the previous frame to start the search back from
+  // position2: the prediction undone.
+  Vec2 BackwardInitialPosition(const KLTPointFeature &feature1,
+                               const Vec2 &position2) const;
+  // Whether position1 tracked back to within the maximum error of feature1.
+  bool IsBackWithinError(const KLTPointFeature &feature1,
+                         const Vec2 &position1) const;
+
+  // Tracks position1, in the coordinates of the finest level, into the
+  // second pyramid. On input position2 is where to start the search from.
+  bool TrackPosition(const std::vector<const FloatImage *> &levels1,
+                     const Vec2 &position1,
+                     const std::vector<const FloatImage *> &levels2,
+                     Vec2 *position2) const;
+  bool TrackPosition(const FixedPointPyramid &pyramid1,
+                     const Vec2 &position1,
+                     const FixedPointPyramid &pyramid2,
+                     Vec2 *position2) const;
+
   int half_window_size_;
   int max_iterations_;
   double min_trackness_;
   double min_feature_dist_;
   double min_determinant_;
   double min_update_distance2_;
+  double max_forward_backward_error_;
+  int num_threads_;
+  const KLTMotionPredictor *predictor_;
+  KLTBackend *backend_;
 };
 
+// The median displacement of the features tracked from features1 to the same
+// slots of features2, as returned by KLTContext::TrackFeatures(). If tracked
+// is not null only the features i with (*tracked)[i] set are used. Returns
+// zero if there is no such feature.
+Vec2 EstimateVelocity(const KLTContext::FeatureArray &features1,
+                      const KLTContext::FeatureArray &features2,
+                      const std::vector<int> *tracked = NULL);
+
 void DrawFeature(const PointFeature &feature,
                  const Vec3 &color,
                  FloatImage *image);
@@ -0,0 +1,93 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+#include <cmath>
+
+#include "libmv/base/thread.h"
+#include "libmv/correspondence/klt_backend.h"
+#include "libmv/logging/logging.h"
+
+namespace libmv {
+
+ImagePyramid *LevelByLevelKLTBackend::MakeImagePyramid(const FloatImage &image,
+                                                       int num_levels,
+                                                       double sigma) {
+  return libmv::MakeImagePyramid(image, num_levels, sigma);
+}
+
+namespace {
+
+// Tracks every feature on one level; the "kernel" of a level. Each index only
+// touches its own slots.
+struct TrackLevelFunctor {
+  const KLTContext *klt;
+  const FloatImage *level1;
+  const FloatImage *level2;
+  double scale;
+  const Vec2 *positions1;
+  Vec2 *positions2;
+  int *status;
+
+  void operator()(int i) {
+    Vec2 position1;
+    position1(0) = positions1[i](0) / scale;
+    position1(1) = positions1[i](1) / scale;
+    positions2[i] *= 2;
+    status[i] = klt->TrackFeatureOneLevel(*level1, position1,
+                                          *level2, &positions2[i]);
+  }
+};
+
+}  // namespace
+
+void LevelByLevelKLTBackend::TrackFeatures(const KLTContext &klt,
+                                           ImagePyramid *pyramid1,
+                                           ImagePyramid *pyramid2,
+                                           const std::vector<Vec2> &positions1,
+                                           std::vector<Vec2> *positions2,
+                                           std::vector<int> *status) {
+  LIBMV_SCOPED_TIMER("klt.backend.track");
+  CHECK_EQ(pyramid1->NumLevels(), pyramid2->NumLevels());
+  CHECK_EQ(positions1.size(), positions2->size());
+  const int num_levels = pyramid1->NumLevels();
+  const int n = positions1.size();
+  status->assign(n, 0);
+  if (n == 0) {
+    return;
+  }
+  for (int i = 0; i < n; ++i) {
+    (*positions2)[i] /= pow(2., num_levels);
+  }
+
+  TrackLevelFunctor functor;
+  functor.klt = &klt;
+  functor.positions1 = &positions1[0];
+  functor.positions2 = &(*positions2)[0];
+  functor.status = &(*status)[0];
+  // Only the status of the finest level counts: a failure on a coarse level,
+  // e.g. out of bounds, does not mean a failure on the finer ones.
+  for (int level = num_levels - 1; level >= 0; --level) {
+    functor.level1 = &pyramid1->Level(level);
+    functor.level2 = &pyramid2->Level(level);
+    functor.scale = pow(2., level);
+    ParallelFor(0, n, num_threads_, &functor);
+  }
+}
+
+}  // namespace libmv
@@ -0,0 +1,91 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+// Backends of KLTContext::TrackFeatures(): where the pyramids are built and
+// the features tracked. An accelerator backend (OpenCL, CUDA) keeps the
+// pyramids it makes on the device and only copies a level back to the host
+// when ImagePyramid::Level() is called; it tracks all the features of a level
+// in one kernel launch and only returns their positions and status. The host
+// API and the KLTPointFeature results stay the ones of KLTContext.
+
+#ifndef LIBMV_CORRESPONDENCE_KLT_BACKEND_H_
+#define LIBMV_CORRESPONDENCE_KLT_BACKEND_H_
+
+#include <vector>
+
+#include "libmv/correspondence/klt.h"
+#include "libmv/image/image.h"
+#include "libmv/image/image_pyramid.h"
+#include "libmv/numeric/numeric.h"
+
+namespace libmv {
+
+class KLTBackend {
+ public:
+  virtual ~KLTBackend() {}
+
+  // A pyramid of blurred images and derivatives, as libmv::MakeImagePyramid().
+  // The tracked pyramids must come from the backend that tracks them.
+  virtual ImagePyramid *MakeImagePyramid(const FloatImage &image,
+                                         int num_levels,
+                                         double sigma) = 0;
+
+  // Tracks the features at positions1 in pyramid1 into pyramid2, with the
+  // window and the stopping criteria of klt. On input positions2 holds the
+  // positions to start the search from, in pyramid2; on output it holds the
+  // tracked positions, and (*status)[i] is 1 if feature i was tracked and 0
+  // otherwise. The positions of the lost features are unspecified.
+  virtual void TrackFeatures(const KLTContext &klt,
+                             ImagePyramid *pyramid1,
+                             ImagePyramid *pyramid2,
+                             const std::vector<Vec2> &positions1,
+                             std::vector<Vec2> *positions2,
+                             std::vector<int> *status) = 0;
+};
+
+// The reference backend, on the host. It tracks the features the way an
+// accelerator does: one pyramid level at a time, from the coarsest, with all
+// the features of a level tracked by one ParallelFor() before moving to the
+// next. The working set is then one level pair at a time instead of the whole
+// pyramids, which also helps the caches. The results are the same as the ones
+// of KLTContext without a backend.
+class LevelByLevelKLTBackend : public KLTBackend {
+ public:
+  explicit LevelByLevelKLTBackend(int num_threads = 1)
+      : num_threads_(num_threads) {}
+  virtual ~LevelByLevelKLTBackend() {}
+
+  virtual ImagePyramid *MakeImagePyramid(const FloatImage &image,
+                                         int num_levels,
+                                         double sigma);
+
+  virtual void TrackFeatures(const KLTContext &klt,
+                             ImagePyramid *pyramid1,
+                             ImagePyramid *pyramid2,
+                             const std::vector<Vec2> &positions1,
+                             std::vector<Vec2> *positions2,
+                             std::vector<int> *status);
+
+ private:
+  int num_threads_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_CORRESPONDENCE_KLT_BACKEND_H_
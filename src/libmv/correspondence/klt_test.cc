@@ -21,7 +21,9 @@
 #include "libmv/image/image.h"
 #include "libmv/image/image_pyramid.h"
 #include "libmv/image/convolve.h"
+#include "libmv/image/padded_array.h"
 #include "libmv/correspondence/klt.h"
+#include "libmv/correspondence/klt_backend.h"
 #include "testing/testing.h"
 
 using std::vector;
@@ -47,6 +49,61 @@ TEST(KLTContext, DetectGoodFeaturesSimple) {
   delete features.back();
 }
 
+TEST(KLTContext, ReplenishGoodFeatures) {
+  Array3Df image(80, 100);
+  image.Fill(0);
+  // A grid of bright dots, 20 pixels apart.
+  for (int y = 10; y < 80; y += 20) {
+    for (int x = 10; x < 100; x += 20) {
+      image(y, x) = 1.f;
+    }
+  }
+  Array3Df derivatives;
+  BlurredImageAndDerivativesChannels(image, 3.0, &derivatives);
+
+  KLTContext klt;
+  KLTContext::FeatureList detected, replenished;
+  klt.DetectGoodFeatures(derivatives, &detected);
+  klt.ReplenishGoodFeatures(derivatives, &replenished);
+  EXPECT_EQ(20, detected.size());
+  EXPECT_EQ(detected.size(), replenished.size());
+
+  // Keep the three left columns of features; only the rest is replenished.
+  KLTContext::FeatureList features;
+  for (KLTContext::FeatureList::iterator it = replenished.begin();
+       it != replenished.end(); ++it) {
+    if ((*it)->coords(0) < 60) {
+      features.push_back(*it);
+    } else {
+      delete *it;
+    }
+  }
+  int num_kept = features.size();
+  EXPECT_EQ(12, num_kept);
+  const KLTPointFeature *first = features.front();
+  klt.ReplenishGoodFeatures(derivatives, &features);
+  EXPECT_EQ(20, features.size());
+  EXPECT_EQ(first, features.front());
+  int i = 0;
+  for (KLTContext::FeatureList::iterator it = features.begin();
+       it != features.end(); ++it, ++i) {
+    float x = (*it)->coords(0), y = (*it)->coords(1);
+    if (i >= num_kept) {
+      EXPECT_LT(60, x);
+    }
+    EXPECT_EQ(10, int(x) % 20);
+    EXPECT_EQ(10, int(y) % 20);
+  }
+  for (KLTContext::FeatureList::iterator it = detected.begin();
+       it != detected.end(); ++it) {
+    delete *it;
+  }
+  for (KLTContext::FeatureList::iterator it = features.begin();
+       it != features.end(); ++it) {
+    delete *it;
+  }
+}
+
 TEST(KLTContext, TrackFeatureOneLevel) {
   Array3Df image1(51, 51);
   image1.Fill(0);
@@ -71,8 +128,6 @@ TEST(KLTContext, TrackFeatureOneLevel) {
   EXPECT_NEAR(position2(1), y0 + dy, 0.001);
 }
 
-// TODO(pau) test TrackFeatures.
-
 TEST(KLTContext, TrackFeature) {
   Array3Df image1(128, 64);
   image1.Fill(0);
@@ -101,4 +156,419 @@ TEST(KLTContext, TrackFeature) {
   delete pyramid2;
 }
 
+// Smooth blob sampled at sub-pixel centers, so that the interpolation weights
+// used by the tracker are not trivially 0 or 1.
+static void MakeBlob(double x0, double y0, Array3Df *image) {
+  image->Resize(64, 64);
+  for (int y = 0; y < image->Height(); ++y) {
+    for (int x = 0; x < image->Width(); ++x) {
+      double r2 = Square(x - x0) + Square(y - y0);
+      (*image)(y, x) = exp(-r2 / (2 * 9.0));
+    }
+  }
+}
+
+TEST(KLTContext, TrackFeatureOneLevelSubPixel) {
+  double x0 = 30.3, y0 = 31.7;
+  double dx = 0.6, dy = -0.4;
+  Array3Df image1, image2;
+  MakeBlob(x0, y0, &image1);
+  MakeBlob(x0 + dx, y0 + dy, &image2);
+
+  Array3Df derivatives1, derivatives2;
+  BlurredImageAndDerivativesChannels(image1, 0.9, &derivatives1);
+  BlurredImageAndDerivativesChannels(image2, 0.9, &derivatives2);
+
+  KLTContext klt;
+  Vec2 position1, position2;
+  position1 << x0, y0;
+  position2 << x0, y0;
+  EXPECT_TRUE(klt.TrackFeatureOneLevel(derivatives1, position1,
+                                       derivatives2, &position2));
+  EXPECT_NEAR(position2(0), x0 + dx, 0.05);
+  EXPECT_NEAR(position2(1), y0 + dy, 0.05);
+
+  // Near the border the tracker takes the clamped path; it must agree.
+  Vec2 border1, border2;
+  border1 << 1.3, 1.7;
+  border2 << 1.3, 1.7;
+  Array3Df shifted1, shifted2;
+  MakeBlob(border1(0), border1(1), &shifted1);
+  MakeBlob(border1(0) + dx, border1(1) + dy, &shifted2);
+  BlurredImageAndDerivativesChannels(shifted1, 0.9, &derivatives1);
+  BlurredImageAndDerivativesChannels(shifted2, 0.9, &derivatives2);
+  klt.TrackFeatureOneLevel(derivatives1, border1, derivatives2, &border2);
+  EXPECT_NEAR(border2(0), border1(0) + dx, 0.2);
+  EXPECT_NEAR(border2(1), border1(1) + dy, 0.2);
+}
+
+TEST(KLTContext, TrackFeatureOneLevelStrided) {
+  double x0 = 30.3, y0 = 31.7;
+  double dx = 0.6, dy = -0.4;
+  Array3Df image1, image2;
+  MakeBlob(x0, y0, &image1);
+  MakeBlob(x0 + dx, y0 + dy, &image2);
+
+  Array3Df derivatives1, derivatives2;
+  BlurredImageAndDerivativesChannels(image1, 0.9, &derivatives1);
+  BlurredImageAndDerivativesChannels(image2, 0.9, &derivatives2);
+
+  KLTContext klt;
+  Vec2 position1, expected;
+  position1 << x0, y0;
+  expected << x0, y0;
+  klt.TrackFeatureOneLevel(derivatives1, position1, derivatives2, &expected);
+
+  PaddedArray3Df::Layout layouts[] = {
+    PaddedArray3Df::INTERLEAVED,
+    PaddedArray3Df::PLANAR,
+  };
+  for (int l = 0; l < 2; ++l) {
+    PaddedArray3Df padded1(1, 1, 1, layouts[l]);
+    PaddedArray3Df padded2(1, 1, 1, layouts[l]);
+    padded1.CopyFrom(derivatives1);
+    padded2.CopyFrom(derivatives2);
+    Vec2 position2;
+    position2 << x0, y0;
+    EXPECT_TRUE(klt.TrackFeatureOneLevel(padded1.View(), position1,
+                                         padded2.View(), &position2));
+    EXPECT_NEAR(expected(0), position2(0), 1e-4);
+    EXPECT_NEAR(expected(1), position2(1), 1e-4);
+  }
+}
+
+// Image with a few well separated bright dots, and the same image shifted.
+static void MakeDotImages(int dx, int dy, Array3Df *image1, Array3Df *image2) {
+  image1->Resize(128, 128);
+  image2->Resize(128, 128);
+  image1->Fill(0);
+  image2->Fill(0);
+  for (int y = 32; y < 100; y += 32) {
+    for (int x = 32; x < 100; x += 32) {
+      (*image1)(y, x) = 1.0f;
+      (*image2)(y + dy, x + dx) = 1.0f;
+    }
+  }
+}
+
+TEST(KLTContext, TrackFeaturesList) {
+  Array3Df image1, image2;
+  int dx = 3, dy = 2;
+  MakeDotImages(dx, dy, &image1, &image2);
+
+  ImagePyramid *pyramid1 = MakeImagePyramid(image1, 3, 0.9);
+  ImagePyramid *pyramid2 = MakeImagePyramid(image2, 3, 0.9);
+
+  KLTContext klt;
+  klt.SetNumThreads(3);
+  KLTContext::FeatureList features1, features2;
+  for (int y = 32; y < 100; y += 32) {
+    for (int x = 32; x < 100; x += 32) {
+      KLTPointFeature *feature = new KLTPointFeature;
+      feature->coords << x, y;
+      features1.push_back(feature);
+    }
+  }
+  klt.TrackFeatures(pyramid1, features1, pyramid2, &features2);
+
+  ASSERT_EQ(features1.size(), features2.size());
+  KLTContext::FeatureList::iterator it1 = features1.begin();
+  KLTContext::FeatureList::iterator it2 = features2.begin();
+  for (; it1 != features1.end(); ++it1, ++it2) {
+    EXPECT_NEAR((*it1)->coords(0) + dx, (*it2)->coords(0), 0.001);
+    EXPECT_NEAR((*it1)->coords(1) + dy, (*it2)->coords(1), 0.001);
+    delete *it1;
+    delete *it2;
+  }
+  delete pyramid1;
+  delete pyramid2;
+}
+
+TEST(KLTContext, TrackFeaturesArrayIsIndependentOfThreadCount) {
+  Array3Df image1, image2;
+  int dx = 2, dy = 3;
+  MakeDotImages(dx, dy, &image1, &image2);
+
+  ImagePyramid *pyramid1 = MakeImagePyramid(image1, 3, 0.9);
+  ImagePyramid *pyramid2 = MakeImagePyramid(image2, 3, 0.9);
+
+  KLTContext::FeatureArray features1;
+  for (int y = 32; y < 100; y += 32) {
+    for (int x = 32; x < 100; x += 32) {
+      KLTPointFeature feature;
+      feature.coords << x, y;
+      features1.push_back(feature);
+    }
+  }
+
+  KLTContext klt;
+  KLTContext::FeatureArray serial;
+  std::vector<int> serial_tracked;
+  int num_tracked = klt.TrackFeatures(pyramid1, features1, pyramid2,
+                                      &serial, &serial_tracked);
+  EXPECT_EQ(features1.size(), num_tracked);
+  ASSERT_EQ(features1.size(), serial.size());
+  for (size_t i = 0; i < serial.size(); ++i) {
+    EXPECT_EQ(1, serial_tracked[i]);
+    EXPECT_NEAR(features1[i].coords(0) + dx, serial[i].coords(0), 0.001);
+    EXPECT_NEAR(features1[i].coords(1) + dy, serial[i].coords(1), 0.001);
+  }
+
+  for (int num_threads = 2; num_threads <= 4; ++num_threads) {
+    klt.SetNumThreads(num_threads);
+    KLTContext::FeatureArray parallel;
+    std::vector<int> parallel_tracked;
+    klt.TrackFeatures(pyramid1, features1, pyramid2,
+                      &parallel, &parallel_tracked);
+    ASSERT_EQ(serial.size(), parallel.size());
+    for (size_t i = 0; i < serial.size(); ++i) {
+      EXPECT_EQ(serial_tracked[i], parallel_tracked[i]);
+      EXPECT_EQ(serial[i].coords(0), parallel[i].coords(0));
+      EXPECT_EQ(serial[i].coords(1), parallel[i].coords(1));
+    }
+  }
+  delete pyramid1;
+  delete pyramid2;
+}
+
+TEST(KLTContext, LevelByLevelBackendGivesTheSameResults) {
+  Array3Df image1, image2;
+  int dx = 2, dy = 3;
+  MakeDotImages(dx, dy, &image1, &image2);
+
+  KLTContext::FeatureArray features1;
+  for (int y = 32; y < 100; y += 32) {
+    for (int x = 32; x < 100; x += 32) {
+      KLTPointFeature feature;
+      feature.coords << x, y;
+      features1.push_back(feature);
+    }
+  }
+  // Lost off the image.
+  KLTPointFeature outside;
+  outside.coords << -50, 40;
+  features1.push_back(outside);
+
+  KLTContext klt;
+  ImagePyramid *pyramid1 = klt.MakeImagePyramid(image1, 3);
+  ImagePyramid *pyramid2 = klt.MakeImagePyramid(image2, 3);
+  KLTContext::FeatureArray expected;
+  std::vector<int> expected_tracked;
+  klt.TrackFeatures(pyramid1, features1, pyramid2,
+                    &expected, &expected_tracked);
+  EXPECT_EQ(0, expected_tracked.back());
+  delete pyramid1;
+  delete pyramid2;
+
+  for (int num_threads = 1; num_threads <= 3; ++num_threads) {
+    LevelByLevelKLTBackend backend(num_threads);
+    klt.SetBackend(&backend);
+    EXPECT_EQ(&backend, klt.Backend());
+    pyramid1 = klt.MakeImagePyramid(image1, 3);
+    pyramid2 = klt.MakeImagePyramid(image2, 3);
+    KLTContext::FeatureArray features2;
+    std::vector<int> tracked;
+    EXPECT_EQ(features1.size() - 1,
+              klt.TrackFeatures(pyramid1, features1, pyramid2,
+                                &features2, &tracked));
+    ASSERT_EQ(expected.size(), features2.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+      EXPECT_EQ(expected_tracked[i], tracked[i]);
+      EXPECT_EQ(expected[i].coords(0), features2[i].coords(0));
+      EXPECT_EQ(expected[i].coords(1), features2[i].coords(1));
+    }
+    delete pyramid1;
+    delete pyramid2;
+  }
+}
+
+TEST(KLTContext, TrackFeatureOneLevelFixedPoint) {
+  double x0 = 30.3, y0 = 31.7;
+  double dx = 0.6, dy = -0.4;
+  Array3Df image1, image2;
+  MakeBlob(x0, y0, &image1);
+  MakeBlob(x0 + dx, y0 + dy, &image2);
+  FixedPointPyramid pyramid1(image1, 1, 0.9);
+  FixedPointPyramid pyramid2(image2, 1, 0.9);
+
+  KLTContext klt;
+  Vec2 position1, position2;
+  position1 << x0, y0;
+  position2 << x0, y0;
+  EXPECT_TRUE(klt.TrackFeatureOneLevel(pyramid1.Level(0), position1,
+                                       pyramid2.Level(0),
+                                       pyramid1.IntensityScale(),
+                                       &position2));
+  EXPECT_NEAR(position2(0), x0 + dx, 0.05);
+  EXPECT_NEAR(position2(1), y0 + dy, 0.05);
+
+  // The clamped path near the border.
+  Vec2 border1, border2;
+  border1 << 1.3, 1.7;
+  border2 << 1.3, 1.7;
+  MakeBlob(border1(0), border1(1), &image1);
+  MakeBlob(border1(0) + dx, border1(1) + dy, &image2);
+  pyramid1.Init(image1, 1, 0.9);
+  pyramid2.Init(image2, 1, 0.9);
+  klt.TrackFeatureOneLevel(pyramid1.Level(0), border1, pyramid2.Level(0),
+                           pyramid1.IntensityScale(), &border2);
+  EXPECT_NEAR(border2(0), border1(0) + dx, 0.2);
+  EXPECT_NEAR(border2(1), border1(1) + dy, 0.2);
+}
+
+TEST(KLTContext, TrackFeaturesFixedPoint) {
+  Array3Df image1, image2;
+  int dx = 2, dy = 3;
+  MakeDotImages(dx, dy, &image1, &image2);
+  FixedPointPyramid pyramid1(image1, 3, 0.9);
+  FixedPointPyramid pyramid2(image2, 3, 0.9);
+
+  KLTContext::FeatureArray features1;
+  for (int y = 32; y < 100; y += 32) {
+    for (int x = 32; x < 100; x += 32) {
+      KLTPointFeature feature;
+      feature.coords << x, y;
+      features1.push_back(feature);
+    }
+  }
+
+  KLTContext klt;
+  KLTContext::FeatureArray serial;
+  std::vector<int> tracked;
+  EXPECT_EQ(features1.size(), klt.TrackFeatures(pyramid1, features1, pyramid2,
+                                                &serial, &tracked));
+  ASSERT_EQ(features1.size(), serial.size());
+  for (size_t i = 0; i < serial.size(); ++i) {
+    EXPECT_EQ(1, tracked[i]);
+    EXPECT_NEAR(features1[i].coords(0) + dx, serial[i].coords(0), 0.01);
+    EXPECT_NEAR(features1[i].coords(1) + dy, serial[i].coords(1), 0.01);
+  }
+
+  klt.SetNumThreads(3);
+  KLTContext::FeatureArray parallel;
+  klt.TrackFeatures(pyramid1, features1, pyramid2, &parallel);
+  ASSERT_EQ(serial.size(), parallel.size());
+  for (size_t i = 0; i < serial.size(); ++i) {
+    EXPECT_EQ(serial[i].coords(0), parallel[i].coords(0));
+    EXPECT_EQ(serial[i].coords(1), parallel[i].coords(1));
+  }
+}
+
+TEST(KLTContext, TrackFeaturesWithMotionPrediction) {
+  // Too far for a single level without a prediction.
+  Array3Df image1, image2;
+  int dx = 12, dy = -9;
+  MakeDotImages(dx, dy, &image1, &image2);
+  ImagePyramid *pyramid1 = MakeImagePyramid(image1, 1, 0.9);
+  ImagePyramid *pyramid2 = MakeImagePyramid(image2, 1, 0.9);
+
+  KLTContext::FeatureArray features1;
+  for (int y = 32; y < 100; y += 32) {
+    for (int x = 32; x < 100; x += 32) {
+      KLTPointFeature feature;
+      feature.coords << x, y;
+      features1.push_back(feature);
+    }
+  }
+
+  KLTContext klt;
+  KLTContext::FeatureArray unpredicted;
+  klt.TrackFeatures(pyramid1, features1, pyramid2, &unpredicted);
+  EXPECT_GT((unpredicted[0].coords - features1[0].coords -
+             Vec2f(dx, dy)).norm(), 1);
+
+  // A rough guess of the velocity is enough.
+  ConstantVelocityPredictor velocity(Vec2(dx - 1.5, dy + 1));
+  klt.SetMotionPredictor(&velocity);
+  KLTContext::FeatureArray predicted;
+  std::vector<int> tracked;
+  EXPECT_EQ(features1.size(), klt.TrackFeatures(pyramid1, features1, pyramid2,
+                                                &predicted, &tracked));
+  for (size_t i = 0; i < predicted.size(); ++i) {
+    EXPECT_NEAR(features1[i].coords(0) + dx, predicted[i].coords(0), 0.001);
+    EXPECT_NEAR(features1[i].coords(1) + dy, predicted[i].coords(1), 0.001);
+  }
+  Vec2 measured = EstimateVelocity(features1, predicted, &tracked);
+  EXPECT_NEAR(dx, measured(0), 0.001);
+  EXPECT_NEAR(dy, measured(1), 0.001);
+
+  // The same with a translation homography, on fixed point pyramids.
+  Mat3 H;
+  H << 1, 0, dx + 1,
+       0, 1, dy - 1,
+       0, 0, 1;
+  HomographyPredictor homography(H);
+  klt.SetMotionPredictor(&homography);
+  FixedPointPyramid fixed_pyramid1(image1, 1, 0.9);
+  FixedPointPyramid fixed_pyramid2(image2, 1, 0.9);
+  KLTContext::FeatureArray fixed_point;
+  EXPECT_EQ(features1.size(), klt.TrackFeatures(fixed_pyramid1, features1,
+                                                fixed_pyramid2,
+                                                &fixed_point));
+  for (size_t i = 0; i < fixed_point.size(); ++i) {
+    EXPECT_NEAR(features1[i].coords(0) + dx, fixed_point[i].coords(0), 0.01);
+    EXPECT_NEAR(features1[i].coords(1) + dy, fixed_point[i].coords(1), 0.01);
+  }
+
+  delete pyramid1;
+  delete pyramid2;
+}
+
+TEST(KLTContext, ForwardBackwardCheckRejectsAmbiguousTracks) {
+  // The dot at (32, 32) moves by (3, 2). The two dots on row 64 merge into the
+  // single dot between them: the left one tracks to it, but tracking it back
+  // lands between the two.
+  Array3Df image1(128, 128), image2(128, 128);
+  image1.Fill(0);
+  image2.Fill(0);
+  image1(32, 32) = 1;
+  image2(34, 35) = 1;
+  image1(64, 60) = 1;
+  image1(64, 68) = 1;
+  image2(65, 64) = 1;
+
+  KLTContext::FeatureArray features1(2);
+  features1[0].coords << 32, 32;
+  features1[1].coords << 60, 64;
+
+  KLTContext klt;
+  ImagePyramid *pyramid1 = klt.MakeImagePyramid(image1, 3);
+  ImagePyramid *pyramid2 = klt.MakeImagePyramid(image2, 3);
+  KLTContext::FeatureArray features2;
+  std::vector<int> tracked;
+  EXPECT_EQ(2, klt.TrackFeatures(pyramid1, features1, pyramid2,
+                                 &features2, &tracked));
+
+  klt.SetMaxForwardBackwardError(1);
+  EXPECT_EQ(1, klt.TrackFeatures(pyramid1, features1, pyramid2,
+                                 &features2, &tracked));
+  EXPECT_EQ(1, tracked[0]);
+  EXPECT_EQ(0, tracked[1]);
+  EXPECT_NEAR(35, features2[0].coords(0), 0.001);
+  EXPECT_NEAR(34, features2[0].coords(1), 0.001);
+  delete pyramid1;
+  delete pyramid2;
+
+  // The backward tracks of a backend run as a second batch.
+  LevelByLevelKLTBackend backend(2);
+  klt.SetBackend(&backend);
+  pyramid1 = klt.MakeImagePyramid(image1, 3);
+  pyramid2 = klt.MakeImagePyramid(image2, 3);
+  EXPECT_EQ(1, klt.TrackFeatures(pyramid1, features1, pyramid2,
+                                 &features2, &tracked));
+  EXPECT_EQ(1, tracked[0]);
+  EXPECT_EQ(0, tracked[1]);
+  delete pyramid1;
+  delete pyramid2;
+
+  // Same on fixed point pyramids.
+  klt.SetBackend(NULL);
+  FixedPointPyramid fixed_pyramid1(image1, 3, 0.9);
+  FixedPointPyramid fixed_pyramid2(image2, 3, 0.9);
+  EXPECT_EQ(1, klt.TrackFeatures(fixed_pyramid1, features1, fixed_pyramid2,
+                                 &features2, &tracked));
+  EXPECT_EQ(1, tracked[0]);
+  EXPECT_EQ(0, tracked[1]);
+}
+
 }  // namespace
@@ -91,9 +91,36 @@ class Matches {
     tracks_.insert(track);
   }
 
+  // Inserts the n features given sorted by image then track, as with
+  // BipartiteGraph::InsertSorted(). Does not take ownership of the features.
+  void InsertSorted(const ImageID *images, const TrackID *tracks,
+                    const Feature *const *features, int n) {
+    graph_.InsertSorted(images, tracks, features, n);
+    for (int i = 0; i < n; ++i) {
+      images_.insert(images_.end(), images[i]);
+      tracks_.insert(tracks[i]);
+    }
+  }
+
   void Remove(ImageID image, TrackID track) {
     graph_.Remove(image, track);
   }
+
+  // Removes all the features of image, the image and the tracks left without
+  // features. Note that this function does not desallocate features.
+  void RemoveImage(ImageID image) {
+    std::vector<TrackID> tracks;
+    for (Graph::Range r = graph_.ToLeft(image); r; ++r) {
+      tracks.push_back(r.right());
+    }
+    for (int i = 0; i < tracks.size(); ++i) {
+      graph_.Remove(image, tracks[i]);
+      if (!graph_.ToRight(tracks[i])) {
+        tracks_.erase(tracks[i]);
+      }
+    }
+    images_.erase(image);
+  }
   
   // Erases all the elements.  
   // Note that this function does not desallocate features
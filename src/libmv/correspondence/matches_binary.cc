@@ -0,0 +1,408 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "libmv/correspondence/feature.h"
+#include "libmv/correspondence/matches_binary.h"
+#include "libmv/logging/logging.h"
+
+namespace libmv {
+
+namespace {
+
+const char kMagic[4] = { 'L', 'M', 'V', 'M' };
+const unsigned int kVersion = 1;
+const size_t kHeaderSize = 16;
+const size_t kAlignment = 16;
+
+size_t PaddedSize(size_t size) {
+  return (size + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+struct Row {
+  int image;
+  int track;
+  float x, y;
+  int descriptor_index;
+};
+
+bool ImageThenTrack(const Row &a, const Row &b) {
+  return a.image < b.image || (a.image == b.image && a.track < b.track);
+}
+
+// Writes one column followed by its padding.
+template <typename T>
+bool WriteColumn(const std::vector<Row> &rows, T Row::*field, FILE *file) {
+  std::vector<T> column(rows.size());
+  for (size_t i = 0; i < rows.size(); ++i) {
+    column[i] = rows[i].*field;
+  }
+  size_t size = column.size() * sizeof(T);
+  char zeros[kAlignment] = { 0 };
+  return (column.empty() ||
+          fwrite(&column[0], sizeof(T), column.size(), file) ==
+              column.size()) &&
+         fwrite(zeros, 1, PaddedSize(size) - size, file) ==
+             PaddedSize(size) - size;
+}
+
+bool WriteRows(const std::vector<Row> &rows,
+               bool descriptor_indices,
+               const std::string &filename) {
+  FILE *file = fopen(filename.c_str(), "wb");
+  if (!file) {
+    LOG(ERROR) << "Cannot write the matches " << filename;
+    return false;
+  }
+  unsigned int header[3] = {
+    kVersion,
+    static_cast<unsigned int>(rows.size()),
+    descriptor_indices ? MATCHES_BINARY_DESCRIPTOR_INDICES : 0u
+  };
+  bool ok = fwrite(kMagic, sizeof(kMagic), 1, file) == 1 &&
+            fwrite(header, sizeof(header), 1, file) == 1 &&
+            WriteColumn(rows, &Row::image, file) &&
+            WriteColumn(rows, &Row::track, file) &&
+            WriteColumn(rows, &Row::x, file) &&
+            WriteColumn(rows, &Row::y, file) &&
+            (!descriptor_indices ||
+             WriteColumn(rows, &Row::descriptor_index, file));
+  ok = fclose(file) == 0 && ok;
+  if (!ok) {
+    LOG(ERROR) << "Cannot write the matches " << filename;
+  }
+  return ok;
+}
+
+}  // namespace
+
+MappedMatches::MappedMatches()
+    : mapping_(NULL), mapping_size_(0), num_observations_(0),
+      images_(NULL), tracks_(NULL), x_(NULL), y_(NULL),
+      descriptor_indices_(NULL) {
+}
+
+MappedMatches::~MappedMatches() {
+  Close();
+}
+
+void MappedMatches::Close() {
+  if (mapping_) {
+#ifdef _WIN32
+    delete static_cast<std::vector<int> *>(mapping_);
+#else
+    munmap(mapping_, mapping_size_);
+#endif
+  }
+  mapping_ = NULL;
+  mapping_size_ = 0;
+  num_observations_ = 0;
+  images_ = tracks_ = descriptor_indices_ = NULL;
+  x_ = y_ = NULL;
+}
+
+bool MappedMatches::Open(const std::string &filename) {
+  Close();
+#ifdef _WIN32
+  FILE *file = fopen(filename.c_str(), "rb");
+  if (!file) {
+    LOG(ERROR) << "Error: Couldn't open " << filename;
+    return false;
+  }
+  // Read into ints, so the columns are aligned as in a mapping.
+  std::vector<int> *buffer = new std::vector<int>;
+  int chunk[16384];
+  size_t read;
+  while ((read = fread(chunk, sizeof(int), 16384, file)) > 0) {
+    buffer->insert(buffer->end(), chunk, chunk + read);
+  }
+  fclose(file);
+  mapping_ = buffer;
+  mapping_size_ = buffer->size() * sizeof(int);
+  const char *data = mapping_size_ ?
+      reinterpret_cast<const char *>(&(*buffer)[0]) : NULL;
+#else
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    LOG(ERROR) << "Error: Couldn't open " << filename;
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0 || status.st_size == 0) {
+    close(fd);
+    return false;
+  }
+  mapping_size_ = status.st_size;
+  void *mapping = mmap(NULL, mapping_size_, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping stays valid after the descriptor is closed.
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    LOG(ERROR) << "Error: Couldn't map " << filename;
+    mapping_size_ = 0;
+    return false;
+  }
+  mapping_ = mapping;
+  const char *data = static_cast<const char *>(mapping);
+#endif
+
+  unsigned int header[3];
+  if (mapping_size_ < kHeaderSize ||
+      memcmp(data, kMagic, sizeof(kMagic)) != 0) {
+    Close();
+    return false;
+  }
+  memcpy(header, data + sizeof(kMagic), sizeof(header));
+  bool has_descriptor_indices =
+      (header[2] & MATCHES_BINARY_DESCRIPTOR_INDICES) != 0;
+  size_t column_size = PaddedSize(header[1] * sizeof(int));
+  size_t num_columns = has_descriptor_indices ? 5 : 4;
+  if (header[0] != kVersion ||
+      mapping_size_ < kHeaderSize + num_columns * column_size) {
+    Close();
+    return false;
+  }
+  num_observations_ = header[1];
+  const char *columns = data + kHeaderSize;
+  images_ = reinterpret_cast<const int *>(columns);
+  tracks_ = reinterpret_cast<const int *>(columns + column_size);
+  x_ = reinterpret_cast<const float *>(columns + 2 * column_size);
+  y_ = reinterpret_cast<const float *>(columns + 3 * column_size);
+  if (has_descriptor_indices) {
+    descriptor_indices_ =
+        reinterpret_cast<const int *>(columns + 4 * column_size);
+  }
+  return true;
+}
+
+MatchesBinaryWriter::MatchesBinaryWriter()
+    : num_observations_(0), last_image_(0), last_track_(0), ok_(true) {
+  for (int i = 0; i < 4; ++i) {
+    columns_[i] = NULL;
+  }
+}
+
+MatchesBinaryWriter::~MatchesBinaryWriter() {
+  if (IsOpen()) {
+    Close();
+  }
+}
+
+void MatchesBinaryWriter::CloseColumns() {
+  for (int i = 0; i < 4; ++i) {
+    if (columns_[i]) {
+      fclose(columns_[i]);
+    }
+    columns_[i] = NULL;
+  }
+}
+
+bool MatchesBinaryWriter::Open(const std::string &filename) {
+  if (IsOpen()) {
+    Close();
+  }
+  for (int i = 0; i < 4; ++i) {
+    columns_[i] = tmpfile();
+    if (!columns_[i]) {
+      LOG(ERROR) << "Cannot create the temporary files of " << filename;
+      CloseColumns();
+      return false;
+    }
+  }
+  filename_ = filename;
+  num_observations_ = 0;
+  ok_ = true;
+  return true;
+}
+
+void MatchesBinaryWriter::Add(int image, int track, float x, float y) {
+  assert(IsOpen());
+  CHECK(num_observations_ == 0 || image > last_image_ ||
+        (image == last_image_ && track > last_track_))
+      << "Observations must be added by image then track.";
+  last_image_ = image;
+  last_track_ = track;
+  ok_ = ok_ &&
+        fwrite(&image, sizeof(image), 1, columns_[0]) == 1 &&
+        fwrite(&track, sizeof(track), 1, columns_[1]) == 1 &&
+        fwrite(&x, sizeof(x), 1, columns_[2]) == 1 &&
+        fwrite(&y, sizeof(y), 1, columns_[3]) == 1;
+  num_observations_++;
+}
+
+bool MatchesBinaryWriter::Close() {
+  if (!IsOpen()) {
+    return false;
+  }
+  FILE *file = fopen(filename_.c_str(), "wb");
+  if (!file) {
+    LOG(ERROR) << "Cannot write the matches " << filename_;
+    CloseColumns();
+    return false;
+  }
+  unsigned int header[3] = {
+    kVersion, static_cast<unsigned int>(num_observations_), 0u
+  };
+  bool ok = ok_ &&
+            fwrite(kMagic, sizeof(kMagic), 1, file) == 1 &&
+            fwrite(header, sizeof(header), 1, file) == 1;
+  // The 4 columns have 4 byte entries, hence the same padding.
+  const size_t size = num_observations_ * sizeof(int);
+  char buffer[16384];
+  char zeros[kAlignment] = { 0 };
+  for (int i = 0; ok && i < 4; ++i) {
+    ok = fseek(columns_[i], 0, SEEK_SET) == 0;
+    size_t read;
+    while (ok && (read = fread(buffer, 1, sizeof(buffer), columns_[i])) > 0) {
+      ok = fwrite(buffer, 1, read, file) == read;
+    }
+    ok = ok && fwrite(zeros, 1, PaddedSize(size) - size, file) ==
+                   PaddedSize(size) - size;
+  }
+  ok = fclose(file) == 0 && ok;
+  CloseColumns();
+  if (!ok) {
+    LOG(ERROR) << "Cannot write the matches " << filename_;
+  }
+  return ok;
+}
+
+bool ExportMatchesToBinary(const Matches &matches,
+                           const std::string &out_file_name,
+                           const FeatureSet *features) {
+  const KeypointFeature *first = NULL, *last = NULL;
+  if (features && features->features.size() > 0) {
+    first = &features->features[0];
+    last = first + features->features.size();
+  }
+  // The matches are iterated in (image, track) order.
+  std::vector<Row> rows;
+  for (Matches::Features<PointFeature> r = matches.All<PointFeature>(); r;
+       ++r) {
+    Row row;
+    row.image = r.image();
+    row.track = r.track();
+    row.x = r.feature()->x();
+    row.y = r.feature()->y();
+    const KeypointFeature *keypoint =
+        dynamic_cast<const KeypointFeature *>(r.feature());
+    row.descriptor_index = keypoint && keypoint >= first && keypoint < last ?
+        keypoint - first : -1;
+    rows.push_back(row);
+  }
+  return WriteRows(rows, features != NULL, out_file_name);
+}
+
+bool ImportMatchesFromBinary(const std::string &input_file,
+                             Matches *matches,
+                             FeatureSet *feature_set) {
+  MappedMatches file;
+  if (!file.Open(input_file)) {
+    return false;
+  }
+  int n = file.NumObservations();
+  size_t first = feature_set->features.size();
+  feature_set->features.resize(first + n);
+  for (int i = 0; i < n; ++i) {
+    KeypointFeature &feature = feature_set->features[first + i];
+    feature.coords << file.X()[i], file.Y()[i];
+    matches->Insert(file.Images()[i], file.Tracks()[i], &feature);
+  }
+  return true;
+}
+
+void LoadTrackStore(const MappedMatches &file,
+                    FeatureSet *feature_set,
+                    TrackStore *store) {
+  int n = file.NumObservations();
+  feature_set->features.clear();
+  feature_set->features.resize(n);
+  std::vector<TrackStore::Observation> observations(n);
+  for (int i = 0; i < n; ++i) {
+    KeypointFeature &feature = feature_set->features[i];
+    feature.coords << file.X()[i], file.Y()[i];
+    observations[i].image = file.Images()[i];
+    observations[i].track = file.Tracks()[i];
+    observations[i].feature = &feature;
+    observations[i].point = &feature;
+  }
+  store->Build(observations);
+}
+
+bool ConvertMatchesTxtToBinary(const std::string &txt_file,
+                               const std::string &binary_file) {
+  FILE *file = fopen(txt_file.c_str(), "r");
+  if (!file) {
+    LOG(ERROR) << "Error: Couldn't open " << txt_file;
+    return false;
+  }
+  std::vector<Row> rows;
+  Row row;
+  row.descriptor_index = -1;
+  while (fscanf(file, "%d %d %f %f",
+                &row.image, &row.track, &row.x, &row.y) == 4) {
+    rows.push_back(row);
+  }
+  bool ok = feof(file) != 0;
+  fclose(file);
+  if (!ok) {
+    LOG(ERROR) << "Error: Couldn't parse " << txt_file;
+    return false;
+  }
+  std::stable_sort(rows.begin(), rows.end(), ImageThenTrack);
+  return WriteRows(rows, false, binary_file);
+}
+
+bool ConvertMatchesBinaryToTxt(const std::string &binary_file,
+                               const std::string &txt_file) {
+  MappedMatches matches;
+  if (!matches.Open(binary_file)) {
+    return false;
+  }
+  FILE *file = fopen(txt_file.c_str(), "w");
+  if (!file) {
+    LOG(ERROR) << "Error: Couldn't open " << txt_file;
+    return false;
+  }
+  // %g matches the default precision of the streams of ExportMatchesToTxt().
+  bool ok = true;
+  for (int i = 0; ok && i < matches.NumObservations(); ++i) {
+    ok = fprintf(file, "%d %d %g %g\n", matches.Images()[i],
+                 matches.Tracks()[i], matches.X()[i], matches.Y()[i]) > 0;
+  }
+  ok = fclose(file) == 0 && ok;
+  if (!ok) {
+    LOG(ERROR) << "Cannot write the matches " << txt_file;
+  }
+  return ok;
+}
+
+}  // namespace libmv
@@ -0,0 +1,153 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_CORRESPONDENCE_MATCHES_BINARY_H_
+#define LIBMV_CORRESPONDENCE_MATCHES_BINARY_H_
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+#include "libmv/correspondence/feature_matching.h"
+#include "libmv/correspondence/matches.h"
+#include "libmv/correspondence/track_store.h"
+
+namespace libmv {
+
+// Binary matches files hold the same observations as the TXT format of
+// ExportMatchesToTxt(), stored by columns, in native byte order:
+//
+//   "LMVM", the version, the number of observations n and the flags, as 32
+//   bit unsigned integers;
+//   n image ids, n track ids (32 bit signed integers), n x and n y (floats);
+//   if the descriptor flag is set, n descriptor indices (32 bit signed
+//   integers, -1 for none).
+//
+// Every column starts on a multiple of 16 bytes, padded with zeros. The
+// observations are sorted by image then track.
+enum {
+  MATCHES_BINARY_DESCRIPTOR_INDICES = 1,
+};
+
+// A binary matches file mapped into memory: the columns are read straight
+// from the pages of the file. The columns are valid until the file is closed.
+//
+// Where mmap() is not available the file is read into memory instead.
+class MappedMatches {
+ public:
+  MappedMatches();
+  ~MappedMatches();
+
+  // Returns false if the file cannot be mapped or is not a binary matches
+  // file. Closes any previously opened file.
+  bool Open(const std::string &filename);
+  void Close();
+
+  bool IsOpen() const { return mapping_ != NULL; }
+
+  int NumObservations() const { return num_observations_; }
+  const int   *Images() const { return images_; }
+  const int   *Tracks() const { return tracks_; }
+  const float *X()      const { return x_; }
+  const float *Y()      const { return y_; }
+  // NULL if the file has no descriptor indices.
+  const int   *DescriptorIndices() const { return descriptor_indices_; }
+
+ private:
+  MappedMatches(const MappedMatches &);
+  MappedMatches &operator=(const MappedMatches &);
+
+  void *mapping_;
+  size_t mapping_size_;
+  int num_observations_;
+  const int *images_;
+  const int *tracks_;
+  const float *x_;
+  const float *y_;
+  const int *descriptor_indices_;
+};
+
+// Writes a binary matches file one observation at a time, for producers like
+// a streaming tracker that never hold all the matches in memory. The
+// observations must be added sorted by image then track, and are written
+// without descriptor indices. Until Close() the columns are spilled to
+// temporary files, so the memory used does not grow with the observations.
+class MatchesBinaryWriter {
+ public:
+  MatchesBinaryWriter();
+  // Closes the file if it is open.
+  ~MatchesBinaryWriter();
+
+  // Returns false if the temporary files cannot be created. Closes any
+  // previously opened file.
+  bool Open(const std::string &filename);
+  void Add(int image, int track, float x, float y);
+  // Writes the file. Returns false if any write failed.
+  bool Close();
+
+  bool IsOpen() const { return columns_[0] != NULL; }
+  int NumObservations() const { return num_observations_; }
+
+ private:
+  MatchesBinaryWriter(const MatchesBinaryWriter &);
+  MatchesBinaryWriter &operator=(const MatchesBinaryWriter &);
+
+  void CloseColumns();
+
+  std::string filename_;
+  // The image, track, x and y columns.
+  FILE *columns_[4];
+  int num_observations_;
+  int last_image_, last_track_;
+  bool ok_;
+};
+
+// Exports the point features of matches. If features is not NULL, the index
+// in features->features of every feature that lives there is saved as its
+// descriptor index, so the descriptors can be found again once features is
+// saved elsewhere (for instance with WriteFeatureCache()).
+bool ExportMatchesToBinary(const Matches &matches,
+                           const std::string &out_file_name,
+                           const FeatureSet *features = NULL);
+
+// Imports the matches of a binary file like ImportMatchesFromTxt(), appending
+// one KeypointFeature per observation to feature_set. feature_set is resized
+// once, before any pointer to the new features is handed to matches.
+bool ImportMatchesFromBinary(const std::string &input_file,
+                             Matches *matches,
+                             FeatureSet *feature_set);
+
+// Fills store with the observations of an open file, without building a
+// Matches. The features are stored in feature_set, which is cleared, and must
+// outlive store.
+void LoadTrackStore(const MappedMatches &file,
+                    FeatureSet *feature_set,
+                    TrackStore *store);
+
+// Converters between the TXT format and the binary format. The TXT format has
+// no descriptor indices; they are dropped when converting to TXT.
+bool ConvertMatchesTxtToBinary(const std::string &txt_file,
+                               const std::string &binary_file);
+bool ConvertMatchesBinaryToTxt(const std::string &binary_file,
+                               const std::string &txt_file);
+
+}  // namespace libmv
+
+#endif  // LIBMV_CORRESPONDENCE_MATCHES_BINARY_H_
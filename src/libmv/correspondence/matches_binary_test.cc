@@ -0,0 +1,200 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstdio>
+#include <string>
+
+#include "libmv/correspondence/export_matches_txt.h"
+#include "libmv/correspondence/feature.h"
+#include "libmv/correspondence/matches_binary.h"
+#include "testing/testing.h"
+
+namespace {
+
+using namespace libmv;
+
+std::string TemporaryFilename(const char *name) {
+  return std::string("/tmp/libmv_matches_binary_test_") + name;
+}
+
+class MatchesBinaryTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    features.features.resize(4);
+    // Inserted out of order on purpose.
+    Add(3, 1, 0, 30.5f, 31.25f);
+    Add(0, 2, 1, 1.5f, 2.5f);
+    Add(0, 1, 2, 10, 20);
+    Add(3, 2, 3, 300, 400);
+  }
+  void Add(int image, int track, int i, float x, float y) {
+    features.features[i].coords << x, y;
+    matches.Insert(image, track, &features.features[i]);
+  }
+
+  FeatureSet features;
+  Matches matches;
+};
+
+TEST_F(MatchesBinaryTest, ColumnsAreSortedByImageThenTrack) {
+  std::string filename = TemporaryFilename("columns.bin");
+  EXPECT_TRUE(ExportMatchesToBinary(matches, filename, &features));
+
+  MappedMatches file;
+  ASSERT_TRUE(file.Open(filename));
+  ASSERT_EQ(4, file.NumObservations());
+  const int images[] = { 0, 0, 3, 3 };
+  const int tracks[] = { 1, 2, 1, 2 };
+  const float x[] = { 10, 1.5f, 30.5f, 300 };
+  const int descriptors[] = { 2, 1, 0, 3 };
+  ASSERT_TRUE(file.DescriptorIndices() != NULL);
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(images[i], file.Images()[i]);
+    EXPECT_EQ(tracks[i], file.Tracks()[i]);
+    EXPECT_EQ(x[i], file.X()[i]);
+    EXPECT_EQ(descriptors[i], file.DescriptorIndices()[i]);
+  }
+  EXPECT_EQ(31.25f, file.Y()[2]);
+  EXPECT_EQ(0u, reinterpret_cast<size_t>(file.X()) % 16);
+  file.Close();
+  EXPECT_FALSE(file.IsOpen());
+
+  // Without a feature set there are no descriptor indices.
+  EXPECT_TRUE(ExportMatchesToBinary(matches, filename));
+  ASSERT_TRUE(file.Open(filename));
+  EXPECT_TRUE(file.DescriptorIndices() == NULL);
+  std::remove(filename.c_str());
+}
+
+TEST_F(MatchesBinaryTest, ImportAndLoadTrackStore) {
+  std::string filename = TemporaryFilename("import.bin");
+  EXPECT_TRUE(ExportMatchesToBinary(matches, filename));
+
+  Matches imported;
+  FeatureSet imported_features;
+  EXPECT_TRUE(ImportMatchesFromBinary(filename, &imported,
+                                      &imported_features));
+  EXPECT_EQ(4, imported_features.features.size());
+  EXPECT_EQ(2, imported.NumImages());
+  EXPECT_EQ(2, imported.NumTracks());
+  const PointFeature *feature =
+      static_cast<const PointFeature *>(imported.Get(3, 1));
+  ASSERT_TRUE(feature != NULL);
+  EXPECT_EQ(30.5f, feature->x());
+  EXPECT_EQ(31.25f, feature->y());
+
+  MappedMatches file;
+  ASSERT_TRUE(file.Open(filename));
+  FeatureSet store_features;
+  TrackStore store;
+  LoadTrackStore(file, &store_features, &store);
+  EXPECT_EQ(4, store.NumObservations());
+  TrackStore::Range r = store.InTrack(2);
+  ASSERT_EQ(2, r.size());
+  EXPECT_EQ(0, r[0].image);
+  EXPECT_EQ(3, r[1].image);
+  EXPECT_EQ(400.f, r[1].point->y());
+  std::remove(filename.c_str());
+}
+
+TEST_F(MatchesBinaryTest, ConvertToAndFromTxt) {
+  std::string txt = TemporaryFilename("matches.txt");
+  std::string binary = TemporaryFilename("matches.bin");
+  std::string txt_again = TemporaryFilename("matches_again.txt");
+  ExportMatchesToTxt(matches, txt);
+  EXPECT_TRUE(ConvertMatchesTxtToBinary(txt, binary));
+  EXPECT_TRUE(ConvertMatchesBinaryToTxt(binary, txt_again));
+
+  MappedMatches file;
+  ASSERT_TRUE(file.Open(binary));
+  ASSERT_EQ(4, file.NumObservations());
+  EXPECT_EQ(3, file.Images()[3]);
+  EXPECT_EQ(2, file.Tracks()[3]);
+  EXPECT_EQ(300.f, file.X()[3]);
+
+  // The round trip gives back the same text.
+  std::string contents[2];
+  std::string names[2] = { txt, txt_again };
+  for (int i = 0; i < 2; ++i) {
+    FILE *in = fopen(names[i].c_str(), "r");
+    ASSERT_TRUE(in != NULL);
+    int c;
+    while ((c = fgetc(in)) != EOF) {
+      contents[i] += static_cast<char>(c);
+    }
+    fclose(in);
+  }
+  EXPECT_EQ(contents[0], contents[1]);
+  std::remove(txt.c_str());
+  std::remove(binary.c_str());
+  std::remove(txt_again.c_str());
+}
+
+TEST_F(MatchesBinaryTest, WriterGivesTheSameFileAsExport) {
+  std::string exported = TemporaryFilename("exported.bin");
+  std::string written = TemporaryFilename("written.bin");
+  EXPECT_TRUE(ExportMatchesToBinary(matches, exported));
+
+  MatchesBinaryWriter writer;
+  ASSERT_TRUE(writer.Open(written));
+  writer.Add(0, 1, 10, 20);
+  writer.Add(0, 2, 1.5f, 2.5f);
+  writer.Add(3, 1, 30.5f, 31.25f);
+  writer.Add(3, 2, 300, 400);
+  EXPECT_EQ(4, writer.NumObservations());
+  EXPECT_TRUE(writer.Close());
+  EXPECT_FALSE(writer.IsOpen());
+
+  std::string contents[2];
+  const std::string *files[2] = { &exported, &written };
+  for (int i = 0; i < 2; ++i) {
+    FILE *in = fopen(files[i]->c_str(), "rb");
+    ASSERT_TRUE(in != NULL);
+    int c;
+    while ((c = fgetc(in)) != EOF) {
+      contents[i] += static_cast<char>(c);
+    }
+    fclose(in);
+  }
+  EXPECT_EQ(contents[0], contents[1]);
+
+  // An empty file is still a valid matches file.
+  ASSERT_TRUE(writer.Open(written));
+  EXPECT_TRUE(writer.Close());
+  MappedMatches file;
+  EXPECT_TRUE(file.Open(written));
+  EXPECT_EQ(0, file.NumObservations());
+  std::remove(exported.c_str());
+  std::remove(written.c_str());
+}
+
+TEST(MatchesBinary, RejectsOtherFiles) {
+  std::string filename = TemporaryFilename("other.bin");
+  FILE *file = fopen(filename.c_str(), "wb");
+  fputs("LMVF, not matches", file);
+  fclose(file);
+  MappedMatches matches;
+  EXPECT_FALSE(matches.Open(filename));
+  EXPECT_FALSE(matches.IsOpen());
+  std::remove(filename.c_str());
+  EXPECT_FALSE(matches.Open(filename));
+}
+
+}  // namespace
@@ -0,0 +1,90 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/correspondence/matches_pager.h"
+#include "libmv/logging/logging.h"
+
+namespace libmv {
+
+namespace {
+
+// The accounted memory of a paged in observation: its feature, and about a
+// node of the map of matches pointing to it.
+const long long kBytesPerObservation = sizeof(PointFeature) + 48;
+
+}  // namespace
+
+MatchesPager::MatchesPager(const MappedMatches *file, Matches *matches)
+    : file_(file), matches_(matches), num_paged_in_features_(0),
+      memory_(MEMORY_TRACKS) {
+  CHECK(file->IsOpen());
+  const int *file_images = file->Images();
+  int begin = 0;
+  for (int i = 1; i <= file->NumObservations(); ++i) {
+    if (i == file->NumObservations() || file_images[i] != file_images[begin]) {
+      images_.push_back(file_images[begin]);
+      ranges_[file_images[begin]] = std::make_pair(begin, i);
+      begin = i;
+    }
+  }
+}
+
+MatchesPager::~MatchesPager() {
+  while (!pages_.empty()) {
+    PageOut(pages_.begin()->first);
+  }
+}
+
+bool MatchesPager::PageIn(Matches::ImageID image) {
+  std::map<Matches::ImageID, std::pair<int, int> >::const_iterator range =
+    ranges_.find(image);
+  if (range == ranges_.end() || IsPagedIn(image)) {
+    return false;
+  }
+  int begin = range->second.first, end = range->second.second;
+  // The page is sized once, before any pointer to its features is handed to
+  // matches.
+  std::vector<PointFeature> *page = new std::vector<PointFeature>(end - begin);
+  for (int i = begin; i < end; ++i) {
+    PointFeature &feature = (*page)[i - begin];
+    feature.coords << file_->X()[i], file_->Y()[i];
+    matches_->Insert(image, file_->Tracks()[i], &feature);
+  }
+  pages_[image] = page;
+  num_paged_in_features_ += page->size();
+  memory_.Set(num_paged_in_features_ * kBytesPerObservation);
+  ReclaimMemoryOverBudget();
+  return true;
+}
+
+void MatchesPager::PageOut(Matches::ImageID image) {
+  std::map<Matches::ImageID, std::vector<PointFeature> *>::iterator page =
+    pages_.find(image);
+  if (page == pages_.end()) {
+    return;
+  }
+  matches_->RemoveImage(image);
+  num_paged_in_features_ -= page->second->size();
+  memory_.Set(num_paged_in_features_ * kBytesPerObservation);
+  delete page->second;
+  pages_.erase(page);
+}
+
+}  // namespace libmv
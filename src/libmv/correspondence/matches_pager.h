@@ -0,0 +1,83 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_CORRESPONDENCE_MATCHES_PAGER_H_
+#define LIBMV_CORRESPONDENCE_MATCHES_PAGER_H_
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "libmv/base/memory_budget.h"
+#include "libmv/base/vector.h"
+#include "libmv/correspondence/feature.h"
+#include "libmv/correspondence/matches.h"
+#include "libmv/correspondence/matches_binary.h"
+
+namespace libmv {
+
+// Pages the observations of a binary matches file in and out of a Matches,
+// one image at a time, so that only the features of the paged in images are
+// in memory. The observations of the file are sorted by image, so an image
+// is a contiguous range of the mapped columns and paging it in does not read
+// the rest of the file.
+//
+// The pager owns the point features it inserts into matches; they are valid
+// until their image is paged out.
+class MatchesPager {
+ public:
+  // file must be open; file and matches must outlive the pager.
+  MatchesPager(const MappedMatches *file, Matches *matches);
+  // Pages out all the images.
+  ~MatchesPager();
+
+  // The images of the file, in increasing order.
+  const vector<Matches::ImageID> &images() const { return images_; }
+
+  // Returns false if image is not in the file or is already paged in.
+  bool PageIn(Matches::ImageID image);
+  // Removes the features of image from matches (see Matches::RemoveImage())
+  // and deletes them. Does nothing if image is not paged in.
+  void PageOut(Matches::ImageID image);
+
+  bool IsPagedIn(Matches::ImageID image) const {
+    return pages_.find(image) != pages_.end();
+  }
+  int NumPagedInImages()   const { return pages_.size(); }
+  int NumPagedInFeatures() const { return num_paged_in_features_; }
+
+ private:
+  MatchesPager(const MatchesPager &);
+  MatchesPager &operator=(const MatchesPager &);
+
+  const MappedMatches *file_;
+  Matches *matches_;
+  vector<Matches::ImageID> images_;
+  // The observations of an image are [begin, end).
+  std::map<Matches::ImageID, std::pair<int, int> > ranges_;
+  std::map<Matches::ImageID, std::vector<PointFeature> *> pages_;
+  int num_paged_in_features_;
+  // The paged in observations, as MEMORY_TRACKS.
+  MemoryUsage memory_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_CORRESPONDENCE_MATCHES_PAGER_H_
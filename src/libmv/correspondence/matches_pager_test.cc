@@ -0,0 +1,83 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "libmv/correspondence/feature.h"
+#include "libmv/correspondence/matches_binary.h"
+#include "libmv/correspondence/matches_pager.h"
+#include "testing/testing.h"
+
+namespace {
+
+using namespace libmv;
+
+TEST(MatchesPager, PagesImagesInAndOut) {
+  // Track t is seen by the images t and t + 1, with x = 10 * image + t.
+  std::vector<PointFeature> features(8);
+  Matches matches;
+  for (int t = 0; t < 4; ++t) {
+    for (int image = t; image < t + 2; ++image) {
+      PointFeature &feature = features[2 * t + image - t];
+      feature.coords << 10 * image + t, t;
+      matches.Insert(image, t, &feature);
+    }
+  }
+  std::string filename = "/tmp/libmv_matches_pager_test.bin";
+  ASSERT_TRUE(ExportMatchesToBinary(matches, filename));
+  MappedMatches file;
+  ASSERT_TRUE(file.Open(filename));
+
+  Matches paged;
+  MatchesPager pager(&file, &paged);
+  ASSERT_EQ(5, pager.images().size());
+  EXPECT_EQ(4, pager.images()[4]);
+  EXPECT_FALSE(pager.PageIn(5));
+
+  EXPECT_TRUE(pager.PageIn(1));
+  EXPECT_FALSE(pager.PageIn(1));
+  EXPECT_TRUE(pager.PageIn(2));
+  EXPECT_EQ(2, pager.NumPagedInImages());
+  EXPECT_EQ(4, pager.NumPagedInFeatures());
+  EXPECT_EQ(2, paged.NumImages());
+  EXPECT_EQ(3, paged.NumTracks());
+  const PointFeature *feature =
+    static_cast<const PointFeature *>(paged.Get(2, 1));
+  ASSERT_TRUE(feature != NULL);
+  EXPECT_EQ(21, feature->x());
+  EXPECT_EQ(1, feature->y());
+
+  // Track 0 is only seen by image 1, track 1 by both images.
+  pager.PageOut(1);
+  EXPECT_FALSE(pager.IsPagedIn(1));
+  EXPECT_EQ(2, pager.NumPagedInFeatures());
+  EXPECT_EQ(1, paged.NumImages());
+  EXPECT_EQ(2, paged.NumTracks());
+  EXPECT_TRUE(paged.Get(1, 1) == NULL);
+  EXPECT_TRUE(paged.Get(2, 1) != NULL);
+  EXPECT_EQ(0, paged.NumFeatureTrack(0));
+
+  file.Close();
+  std::remove(filename.c_str());
+}
+
+}  // namespace
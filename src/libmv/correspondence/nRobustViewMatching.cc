@@ -18,11 +18,19 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <algorithm>
+#include <ostream>
+#include <set>
+
 #include "libmv/base/scoped_ptr.h"
+#include "libmv/base/thread.h"
 #include "libmv/base/vector_utils.h"
 #include "libmv/correspondence/feature.h"
+#include "libmv/correspondence/feature_cache.h"
+#include "libmv/correspondence/feature_matcher_index.h"
 #include "libmv/correspondence/feature_matching.h"
 #include "libmv/correspondence/nRobustViewMatching.h"
+#include "libmv/correspondence/vocabulary_tree.h"
 #include "libmv/descriptor/descriptor.h"
 #include "libmv/descriptor/vector_descriptor.h"
 #include "libmv/detector/detector.h"
@@ -38,13 +46,35 @@ using namespace std;
 nRobustViewMatching::nRobustViewMatching(){
    m_pDetector = NULL;
   m_pDescriber = NULL;
+  m_bQuantizedDescriptors = false;
+  m_bGuidedMatching = false;
+  m_bReleaseDescriptors = false;
+  m_iNumThreads = 1;
+  m_pPairMatchesOutput = NULL;
+  m_bFeatureCache = false;
 }
 
 nRobustViewMatching::nRobustViewMatching(
   detector::Detector * pDetector,
-  descriptor::Describer * pDescriber){
+  descriptor::Describer * pDescriber,
+  bool bQuantizedDescriptors){
   m_pDetector = pDetector;
   m_pDescriber = pDescriber;
+  m_bQuantizedDescriptors = bQuantizedDescriptors;
+  m_bGuidedMatching = false;
+  m_bReleaseDescriptors = false;
+  m_iNumThreads = 1;
+  m_pPairMatchesOutput = NULL;
+  m_bFeatureCache = false;
+}
+
+void nRobustViewMatching::setExtractors(
+  const std::vector<detector::Detector *> & detectors,
+  const std::vector<descriptor::Describer *> & describers)
+{
+  CHECK_EQ(detectors.size(), describers.size());
+  m_vec_Detectors = detectors;
+  m_vec_Describers = describers;
 }
 
 /**
@@ -56,6 +86,31 @@ nRobustViewMatching::nRobustViewMatching(
  */
 bool nRobustViewMatching::computeData(const string & filename)
 {
+  FeatureSet KeypointData;
+  if (!extractData(filename, m_pDetector, m_pDescriber, &KeypointData)) {
+    return false;
+  }
+  storeViewData(filename, &KeypointData);
+  return true;
+}
+
+bool nRobustViewMatching::extractData(const string & filename,
+                                      detector::Detector * pDetector,
+                                      descriptor::Describer * pDescriber,
+                                      FeatureSet * KeypointData) const
+{
+  FeatureCacheKey cacheKey;
+  string cacheFilename;
+  if (m_bFeatureCache &&
+      MakeFeatureCacheKey(filename, m_featureCacheParameters, &cacheKey)) {
+    cacheFilename = FeatureCacheFilename(m_featureCacheDirectory, cacheKey);
+    if (ReadFeatureCache(cacheFilename, cacheKey, KeypointData)) {
+      VLOG(1) << "Read the features of " << filename << " from "
+              << cacheFilename;
+      return true;
+    }
+  }
+
   Array3Du imageA;
   if (!ReadImage(filename.c_str(), &imageA)) {
     LOG(FATAL) << "Failed loading image: " << filename;
@@ -74,18 +129,18 @@ bool nRobustViewMatching::computeData(const string & filename)
     Image im(img_array);
 
     libmv::vector<libmv::Feature *> features;
-    m_pDetector->Detect( im, &features, NULL);
+    libmv::detector::DetectorData *data = NULL;
+    pDetector->Detect( im, &features, &data);
+    scoped_ptr<libmv::detector::DetectorData> detector_data(data);
 
     libmv::vector<descriptor::Descriptor *> descriptors;
-    m_pDescriber->Describe(features, im, NULL, &descriptors);
+    pDescriber->Describe(features, im, detector_data.get(), &descriptors);
 
     // Copy data.
-    m_ViewData.insert( make_pair(filename,FeatureSet()) );
-    FeatureSet & KeypointData = m_ViewData[filename];
-    KeypointData.features.resize(descriptors.size());
+    KeypointData->features.resize(descriptors.size());
     for(int i = 0;i < descriptors.size(); ++i)
     {
-      KeypointFeature & feat = KeypointData.features[i];
+      KeypointFeature & feat = KeypointData->features[i];
       feat.descriptor = *(descriptor::VecfDescriptor*)descriptors[i];
       *(PointFeature*)(&feat) = *(PointFeature*)features[i];
     }
@@ -93,10 +148,82 @@ bool nRobustViewMatching::computeData(const string & filename)
     DeleteElements(&features);
     DeleteElements(&descriptors);
 
+    if (!cacheFilename.empty()) {
+      WriteFeatureCache(cacheFilename, cacheKey, *KeypointData);
+    }
     return true;
   }
 }
 
+// Extracts the features of the elements of one shard, element i being in
+// shard i % num_shards, with the detector and describer of the shard.
+struct nRobustViewMatching::DataExtractor {
+  const nRobustViewMatching *matching;
+  const libmv::vector<string> *names;
+  std::vector<FeatureSet> *features;
+  std::vector<int> *extracted;
+
+  void operator()(int shard) const {
+    const int num_shards = matching->m_vec_Detectors.size();
+    for (int i = shard; i < names->size(); i += num_shards) {
+      (*extracted)[i] = matching->extractData(
+        (*names)[i], matching->m_vec_Detectors[shard],
+        matching->m_vec_Describers[shard], &(*features)[i]);
+    }
+  }
+};
+
+bool nRobustViewMatching::computeAllData(
+  const libmv::vector<string> & vec_data)
+{
+  bool bRes = true;
+  if (m_vec_Detectors.empty()) {
+    for (int i=0; i < vec_data.size(); ++i) {
+      bRes &= computeData(vec_data[i]);
+    }
+    return bRes;
+  }
+  std::vector<FeatureSet> features(vec_data.size());
+  std::vector<int> extracted(vec_data.size(), 0);
+  DataExtractor extractor;
+  extractor.matching = this;
+  extractor.names = &vec_data;
+  extractor.features = &features;
+  extractor.extracted = &extracted;
+  const int num_shards = m_vec_Detectors.size();
+  ParallelFor(0, num_shards, num_shards, &extractor);
+  for (int i=0; i < vec_data.size(); ++i) {
+    if (extracted[i]) {
+      storeViewData(vec_data[i], &features[i]);
+    }
+    bRes &= extracted[i] != 0;
+  }
+  return bRes;
+}
+
+void nRobustViewMatching::storeViewData(const string & filename,
+                                        FeatureSet * features)
+{
+  m_ViewData.insert( make_pair(filename,FeatureSet()) );
+  FeatureSet & KeypointData = m_ViewData[filename];
+  KeypointData.features.swap(features->features);
+  m_ViewIndices.erase(filename);
+  if (m_bQuantizedDescriptors && KeypointData.features.size() > 0) {
+    // Quantize the descriptors without keeping a float copy.
+    int dimension = KeypointData.features[0].descriptor.coords.size();
+    libmv::vector<float> rows(KeypointData.features.size() * dimension);
+    for(int i = 0;i < KeypointData.features.size(); ++i) {
+      Vecf & coords = KeypointData.features[i].descriptor.coords;
+      for (int j = 0; j < dimension; ++j) {
+        rows[i * dimension + j] = coords(j);
+      }
+      coords.resize(0);
+    }
+    QuantizeDescriptors(&rows[0], KeypointData.features.size(), dimension,
+                        &m_ViewDescriptors[filename]);
+  }
+}
+
 /**
 * Compute the putative match between data computed from element A and B
 *  Store the match data internally in the class
@@ -133,29 +260,226 @@ bool nRobustViewMatching::MatchData(const string & dataA, const string & dataB)
   int iDataB = find(m_vec_InputNames.begin(), m_vec_InputNames.end(), dataB)
                 - m_vec_InputNames.begin();
 
+  std::vector<std::pair<int, int> > pairs(1, std::make_pair(iDataA, iDataB));
+  buildViewIndices(pairs);
   Matches matches;
-  //TODO(pmoulon) make FindCandidatesMatches a parameter.
-  FindCandidateMatches(m_ViewData[dataA],
-                       m_ViewData[dataB],
-                       &matches);
-  /*FindCandidateMatches_Ratio(m_ViewData[dataA],
-                       m_ViewData[dataB],
-                       &matches,eMATCH_KDTREE_FLANN , 0.6f);*/
+  findPairMatches(iDataA, iDataB, &matches);
   Matches consistent_matches;
   if (computeConstrainMatches(matches,iDataA,iDataB,&consistent_matches))
   {
     matches = consistent_matches;
   }
+  storePairMatches(iDataA, iDataB, matches);
+
+  return true;
+}
+
+void nRobustViewMatching::findPairMatches(int dataAindex,
+                                          int dataBindex,
+                                          Matches * matches) const
+{
+  const string & dataA = m_vec_InputNames[dataAindex];
+  const string & dataB = m_vec_InputNames[dataBindex];
+  //TODO(pmoulon) make FindCandidatesMatches a parameter.
+  if (m_bQuantizedDescriptors) {
+    FindCandidateMatches(m_ViewData.find(dataA)->second,
+                         m_ViewDescriptors.find(dataA)->second,
+                         m_ViewData.find(dataB)->second,
+                         m_ViewDescriptors.find(dataB)->second,
+                         matches);
+  } else {
+    map<string,FeatureMatcherIndex>::const_iterator indexA =
+      m_ViewIndices.find(dataA);
+    map<string,FeatureMatcherIndex>::const_iterator indexB =
+      m_ViewIndices.find(dataB);
+    if (indexA != m_ViewIndices.end() && indexB != m_ViewIndices.end()) {
+      FindCandidateMatches(m_ViewData.find(dataA)->second, indexA->second,
+                           m_ViewData.find(dataB)->second, indexB->second,
+                           matches);
+    } else {
+      FindCandidateMatches(m_ViewData.find(dataA)->second,
+                           m_ViewData.find(dataB)->second,
+                           matches);
+    }
+  }
+  /*FindCandidateMatches_Ratio(m_ViewData[dataA],
+                       m_ViewData[dataB],
+                       &matches,eMATCH_KDTREE_FLANN , 0.6f);*/
+}
+
+void nRobustViewMatching::storePairMatches(int dataAindex,
+                                           int dataBindex,
+                                           const Matches & matches)
+{
+  if (m_pPairMatchesOutput) {
+    std::ostream & out = *m_pPairMatchesOutput;
+    for (Matches::Features<PointFeature> r = matches.InImage<PointFeature>(0);
+         r; ++r) {
+      const PointFeature * featureB =
+        dynamic_cast<const PointFeature *>(matches.Get(1, r.track()));
+      if (featureB) {
+        out << dataAindex << " " << dataBindex << " "
+            << r.feature()->x() << " " << r.feature()->y() << " "
+            << featureB->x() << " " << featureB->y() << "\n";
+      }
+    }
+    out.flush();
+  }
   if (matches.NumTracks() > 0)
   {
     m_sharedData.insert(
       make_pair(
-        make_pair(m_vec_InputNames[iDataA],m_vec_InputNames[iDataB]),
+        make_pair(m_vec_InputNames[dataAindex],m_vec_InputNames[dataBindex]),
         matches)
       );
   }
+}
 
-  return true;
+// Fits the model of every pair of a matchPairs() call into its own slot, and
+// releases the descriptors of the views whose last pair is fitted.
+struct nRobustViewMatching::PairFitter {
+  const nRobustViewMatching *matching;
+  const std::vector<std::pair<int, int> > *pairs;
+  // The fits and has_data of the batch of pairs starting at first.
+  int first;
+  std::vector<PairFit> *fits;
+  std::vector<int> *has_data;
+  bool release_descriptors;
+  // Protects the descriptors left to release.
+  Mutex mutex;
+  std::vector<int> remaining_pairs;
+
+  void operator()(int i) {
+    int dataA = (*pairs)[i].first, dataB = (*pairs)[i].second;
+    const string & nameA = matching->m_vec_InputNames[dataA];
+    const string & nameB = matching->m_vec_InputNames[dataB];
+    if (matching->m_ViewData.find(nameA) == matching->m_ViewData.end() ||
+        matching->m_ViewData.find(nameB) == matching->m_ViewData.end()) {
+      return;
+    }
+    Matches matches;
+    matching->findPairMatches(dataA, dataB, &matches);
+    matching->fitPair(matches, dataA, dataB, &(*fits)[i - first]);
+    (*has_data)[i - first] = 1;
+    if (release_descriptors) {
+      MutexLock lock(&mutex);
+      if (--remaining_pairs[dataA] == 0) {
+        const_cast<nRobustViewMatching *>(matching)->releaseDescriptors(nameA);
+      }
+      if (--remaining_pairs[dataB] == 0) {
+        const_cast<nRobustViewMatching *>(matching)->releaseDescriptors(nameB);
+      }
+    }
+  }
+};
+
+// Builds the matcher indices of some elements, one slot each.
+struct nRobustViewMatching::IndexBuilder {
+  const std::vector<const FeatureSet *> *features;
+  std::vector<FeatureMatcherIndex *> *indices;
+
+  void operator()(int i) const {
+    (*indices)[i]->Build(*(*features)[i], eMATCH_KDTREE_FLANN);
+  }
+};
+
+void nRobustViewMatching::buildViewIndices(
+    const std::vector<std::pair<int, int> > & pairs)
+{
+  if (m_bQuantizedDescriptors) {
+    return;
+  }
+  std::set<int> views;
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    views.insert(pairs[i].first);
+    views.insert(pairs[i].second);
+  }
+  // The map is only changed here, the builders fill their own index.
+  std::vector<const FeatureSet *> features;
+  std::vector<FeatureMatcherIndex *> indices;
+  for (std::set<int>::const_iterator view = views.begin();
+       view != views.end(); ++view) {
+    const string & name = m_vec_InputNames[*view];
+    map<string,FeatureSet>::const_iterator data = m_ViewData.find(name);
+    if (data == m_ViewData.end() ||
+        m_ViewIndices.find(name) != m_ViewIndices.end()) {
+      continue;
+    }
+    features.push_back(&data->second);
+    indices.push_back(&m_ViewIndices[name]);
+  }
+  IndexBuilder builder;
+  builder.features = &features;
+  builder.indices = &indices;
+  ParallelFor(0, int(indices.size()), std::max(m_iNumThreads, 1), &builder);
+}
+
+void nRobustViewMatching::releaseDescriptors(const string & data)
+{
+  // Only its own pairs search the index, and they are all matched.
+  map<string,FeatureMatcherIndex>::iterator index = m_ViewIndices.find(data);
+  if (index != m_ViewIndices.end()) {
+    index->second.Clear();
+  }
+  map<string,FeatureSet>::iterator view = m_ViewData.find(data);
+  if (view != m_ViewData.end()) {
+    libmv::vector<KeypointFeature> & features = view->second.features;
+    for (int i = 0; i < features.size(); ++i) {
+      features[i].descriptor.coords.resize(0);
+    }
+  }
+  map<string,QuantizedDescriptors>::iterator descriptors =
+    m_ViewDescriptors.find(data);
+  if (descriptors != m_ViewDescriptors.end()) {
+    descriptors->second = QuantizedDescriptors();
+  }
+}
+
+bool nRobustViewMatching::matchPairs(
+    const std::vector<std::pair<int, int> > & pairs)
+{
+  // Only the fits of a batch of pairs are kept until they are merged.
+  const int batch_size = 64 * std::max(m_iNumThreads, 1);
+  std::vector<PairFit> fits;
+  std::vector<int> has_data;
+
+  PairFitter fitter;
+  fitter.matching = this;
+  fitter.pairs = &pairs;
+  fitter.fits = &fits;
+  fitter.has_data = &has_data;
+  fitter.release_descriptors = m_bReleaseDescriptors;
+  fitter.remaining_pairs.resize(m_vec_InputNames.size(), 0);
+  buildViewIndices(pairs);
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    ++fitter.remaining_pairs[pairs[i].first];
+    ++fitter.remaining_pairs[pairs[i].second];
+  }
+
+  bool bRes = true;
+  for (int first = 0; first < pairs.size(); first += batch_size) {
+    const int last = std::min(first + batch_size, int(pairs.size()));
+    fits.assign(last - first, PairFit());
+    has_data.assign(last - first, 0);
+    fitter.first = first;
+    // The pairs take very different times to fit.
+    ParallelForDynamic(first, last, m_iNumThreads, &fitter);
+
+    // The tracks are merged in the order of the pairs, as with MatchData().
+    for (int i = first; i < last; ++i) {
+      if (!has_data[i - first]) {
+        LOG(INFO) << "[nViewMatching::matchPairs] "
+                  << "Could not identify data for one of the input name.";
+        bRes = false;
+        continue;
+      }
+      Matches consistent_matches;
+      mergePair(fits[i - first], pairs[i].first, pairs[i].second,
+                &consistent_matches);
+      storePairMatches(pairs[i].first, pairs[i].second, consistent_matches);
+    }
+  }
+  return bRes;
 }
 
 /**
@@ -173,49 +497,172 @@ bool nRobustViewMatching::computeCrossMatch( const libmv::vector<string> & vec_d
   }
 
   m_vec_InputNames = vec_data;
-  bool bRes = true;
-  for (int i=0; i < vec_data.size(); ++i) {
-    bRes &= computeData(vec_data[i]);
-  }
+  bool bRes = computeAllData(vec_data);
 
-  bool bRes2 = true;
+  std::vector<std::pair<int, int> > pairs;
   for (int i=0; i < vec_data.size(); ++i) {
     for (int j=0; j < i; ++j)
     {
       if (m_ViewData.find(vec_data[i]) != m_ViewData.end() &&
         m_ViewData.find(vec_data[j]) != m_ViewData.end())
       {
-        bRes2 &= this->MatchData( vec_data[i], vec_data[j]);
+        pairs.push_back(std::make_pair(i, j));
       }
     }
   }
-  return bRes2;
+  return matchPairs(pairs);
 }
 
-bool nRobustViewMatching::computeRelativeMatch(
-    const libmv::vector<string>& vec_data) {
+int nRobustViewMatching::getViewDescriptorRows(const string & data,
+                                               std::vector<float> * rows)
+{
+  rows->clear();
+  if (m_ViewData.find(data) == m_ViewData.end()) {
+    return 0;
+  }
+  if (m_bQuantizedDescriptors) {
+    const QuantizedDescriptors & descriptors = m_ViewDescriptors[data];
+    rows->resize(descriptors.codes.size());
+    if (!rows->empty()) {
+      descriptors.Dequantize(&(*rows)[0]);
+    }
+    return descriptors.dimension;
+  }
+  const FeatureSet & features = m_ViewData[data];
+  if (features.features.size() == 0) {
+    return 0;
+  }
+  int dimension = features.features[0].descriptor.coords.size();
+  float * array = FeatureSet::FeatureSetDescriptorsToContiguousArray(features);
+  rows->assign(array, array + features.features.size() * dimension);
+  delete [] array;
+  return dimension;
+}
+
+bool nRobustViewMatching::computeCandidateMatch(
+    const libmv::vector<string> & vec_data,
+    int num_candidates)
+{
+  std::vector<std::pair<int, int> > pairs;
+  if (!computeCandidatePairs(vec_data, num_candidates, &pairs)) {
+    return false;
+  }
+  VLOG(1) << "Matching " << pairs.size() << " candidate pairs.";
+  return matchPairs(pairs);
+}
+
+bool nRobustViewMatching::computeCandidatePairs(
+    const libmv::vector<string> & vec_data,
+    int num_candidates,
+    std::vector<std::pair<int, int> > * candidate_pairs)
+{
   if (m_pDetector == NULL || m_pDescriber == NULL)  {
     LOG(FATAL) << "Invalid Detector or Describer.";
     return false;
   }
 
   m_vec_InputNames = vec_data;
-  bool bRes = true;
+  computeAllData(vec_data);
+  candidate_pairs->clear();
+
+  std::vector<std::vector<float> > rows(vec_data.size());
+  int dimension = 0;
+  size_t num_rows = 0;
+  for (int i=0; i < vec_data.size(); ++i) {
+    dimension = std::max(dimension,
+                         getViewDescriptorRows(vec_data[i], &rows[i]));
+    num_rows += rows[i].size();
+  }
+  if (dimension == 0) {
+    return false;
+  }
+  num_rows /= dimension;
+
+  // Train the tree on at most kMaxTrainingRows descriptors, taken evenly
+  // from all the elements.
+  const size_t kMaxTrainingRows = 100000;
+  size_t stride = (num_rows + kMaxTrainingRows - 1) / kMaxTrainingRows;
+  std::vector<float> training;
+  size_t row = 0;
+  for (int i=0; i < vec_data.size(); ++i) {
+    for (size_t j = 0; j < rows[i].size(); j += dimension, ++row) {
+      if (row % stride == 0) {
+        training.insert(training.end(), rows[i].begin() + j,
+                        rows[i].begin() + j + dimension);
+      }
+    }
+  }
+  VocabularyTree tree;
+  const int kBranching = 10, kDepth = 4;
+  tree.Build(&training[0], training.size() / dimension, dimension,
+             kBranching, kDepth);
+  for (int i=0; i < vec_data.size(); ++i) {
+    tree.AddImage(rows[i].empty() ? NULL : &rows[i][0],
+                  rows[i].size() / dimension);
+  }
+
+  // Match every pair of candidates once, in the order of computeCrossMatch().
+  std::set<std::pair<int, int> > pairs;
+  std::vector<std::pair<float, int> > candidates;
   for (int i=0; i < vec_data.size(); ++i) {
-    bRes &= computeData(vec_data[i]);
+    tree.QueryImage(i, num_candidates, &candidates);
+    for (size_t k = 0; k < candidates.size(); ++k) {
+      int j = candidates[k].second;
+      pairs.insert(std::make_pair(std::max(i, j), std::min(i, j)));
+    }
+  }
+  candidate_pairs->assign(pairs.begin(), pairs.end());
+  return true;
+}
+
+bool nRobustViewMatching::computePairMatch(
+    const libmv::vector<string> & vec_data,
+    const std::vector<std::pair<int, int> > & pairs)
+{
+  if (m_pDetector == NULL || m_pDescriber == NULL)  {
+    LOG(FATAL) << "Invalid Detector or Describer.";
+    return false;
+  }
+
+  m_vec_InputNames = vec_data;
+  std::set<int> views;
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    views.insert(pairs[i].first);
+    views.insert(pairs[i].second);
+  }
+  libmv::vector<string> names;
+  names.reserve(views.size());
+  for (std::set<int>::const_iterator view = views.begin();
+       view != views.end(); ++view) {
+    if (m_ViewData.find(vec_data[*view]) == m_ViewData.end()) {
+      names.push_back(vec_data[*view]);
+    }
+  }
+  bool bRes = computeAllData(names);
+  return matchPairs(pairs) && bRes;
+}
+
+bool nRobustViewMatching::computeRelativeMatch(
+    const libmv::vector<string>& vec_data) {
+  if (m_pDetector == NULL || m_pDescriber == NULL)  {
+    LOG(FATAL) << "Invalid Detector or Describer.";
+    return false;
   }
 
-  bool bRes2 = true;
+  m_vec_InputNames = vec_data;
+  bool bRes = computeAllData(vec_data);
+
+  std::vector<std::pair<int, int> > pairs;
   for (int i=1; i < vec_data.size(); ++i) {
     if (m_ViewData.find(vec_data[i-1]) != m_ViewData.end() &&
         m_ViewData.find(vec_data[i])   != m_ViewData.end())
     {
-      bRes2 &= this->MatchData(vec_data[i-1], vec_data[i]);
+      pairs.push_back(std::make_pair(i-1, i));
     }
   }
   // Match the first and the last images (in order to detect loop)
-  bRes2 &= this->MatchData(vec_data[0], vec_data[vec_data.size() - 1]);
-  return bRes2;
+  pairs.push_back(std::make_pair(0, int(vec_data.size()) - 1));
+  return matchPairs(pairs);
 }
 
 /**
@@ -239,13 +686,26 @@ bool nRobustViewMatching::computeConstrainMatches(const Matches & matchIn,
               << " Could not export constrained matches.";
     return false;
   }
+  PairFit fit;
+  fitPair(matchIn, dataAindex, dataBindex, &fit);
+  mergePair(fit, dataAindex, dataBindex, matchesOut);
+  return true;
+}
+
+void nRobustViewMatching::fitPair(const Matches & matchIn,
+                                  int dataAindex,
+                                  int dataBindex,
+                                  PairFit * fit) const
+{
   libmv::vector<Mat> x;
-  libmv::vector<int> tracks, images;
+  libmv::vector<int> images;
   images.push_back(0);
   images.push_back(1);
+  fit->matches = matchIn;
+  libmv::vector<int> & tracks = fit->tracks;
+  libmv::vector<int> & inliers = fit->inliers;
   PointMatchMatrices(matchIn, images, &tracks, &x);
 
-  libmv::vector<int> inliers;
   Mat3 H;
   // TODO(pmoulon) Make the Correspondence filter a parameter.
   //HomographyFromCorrespondences2PointRobust(x[0], x[1], 0.3, &H, &inliers);
@@ -253,6 +713,45 @@ bool nRobustViewMatching::computeConstrainMatches(const Matches & matchIn,
   //AffineFromCorrespondences2PointRobust(x[0], x[1], 1, &H, &inliers);
   FundamentalFromCorrespondences7PointRobust(x[0], x[1], 1.0, &H, &inliers);
 
+  Matches guided_matches;
+  if (m_bGuidedMatching && !m_bQuantizedDescriptors &&
+      inliers.size() > 7 * 2) {
+    // Match again, only near the epipolar lines of the fitted model, and
+    // refit the model to these (denser) matches.
+    FindGuidedMatchesFundamental(
+        m_ViewData.find(m_vec_InputNames[dataAindex])->second,
+        m_ViewData.find(m_vec_InputNames[dataBindex])->second,
+        H, 1.0, &guided_matches);
+    libmv::vector<Mat> guided_x;
+    libmv::vector<int> guided_tracks, guided_inliers;
+    Mat3 guided_H;
+    PointMatchMatrices(guided_matches, images, &guided_tracks, &guided_x);
+    if (guided_tracks.size() > 7) {
+      FundamentalFromCorrespondences7PointRobust(guided_x[0], guided_x[1], 1.0,
+                                                 &guided_H, &guided_inliers);
+    }
+    if (guided_inliers.size() > inliers.size()) {
+      VLOG(2) << "Guided matching: " << guided_inliers.size()
+              << " inliers instead of " << inliers.size();
+      fit->matches = guided_matches;
+      tracks = guided_tracks;
+      inliers = guided_inliers;
+    }
+  }
+}
+
+void nRobustViewMatching::mergePair(const PairFit & fit,
+                                    int dataAindex,
+                                    int dataBindex,
+                                    Matches * matchesOut)
+{
+  const Matches *constrained = &fit.matches;
+  const libmv::vector<int> & tracks = fit.tracks;
+  const libmv::vector<int> & inliers = fit.inliers;
+  libmv::vector<int> images;
+  images.push_back(0);
+  images.push_back(1);
+
   //TODO(pmoulon) insert an optimization phase.
   // Rerun Robust correspondance on the inliers.
   // it will allow to compute a better model and filter ugly fitting.
@@ -265,12 +764,12 @@ bool nRobustViewMatching::computeConstrainMatches(const Matches & matchIn,
       // Build new correspondence graph containing only inliers.
       for (int l = 0; l < inliers.size(); ++l)  {
         const int k = inliers[l];
-        m_featureToTrackTable[matchIn.Get(0, tracks[k])] = l;
-        m_featureToTrackTable[matchIn.Get(1, tracks[k])] = l;
+        m_featureToTrackTable[constrained->Get(0, tracks[k])] = l;
+        m_featureToTrackTable[constrained->Get(1, tracks[k])] = l;
         m_tracks.Insert(dataAindex, l,
-            matchIn.Get(dataBindex, tracks[k]));
+            constrained->Get(dataBindex, tracks[k]));
         m_tracks.Insert(dataBindex, l,
-            matchIn.Get(dataAindex, tracks[k]));
+            constrained->Get(dataAindex, tracks[k]));
       }
     }
     else  {
@@ -278,24 +777,24 @@ bool nRobustViewMatching::computeConstrainMatches(const Matches & matchIn,
       for (int l = 0; l < inliers.size(); ++l)  {
         const int k = inliers[l];
         map<const Feature*, int>::const_iterator iter =
-          m_featureToTrackTable.find(matchIn.Get(1, tracks[k]));
+          m_featureToTrackTable.find(constrained->Get(1, tracks[k]));
 
         if (iter!=m_featureToTrackTable.end())  {
           // Add a feature to the existing track
           const int trackIndex = iter->second;
-          m_featureToTrackTable[matchIn.Get(0, tracks[k])] = trackIndex;
+          m_featureToTrackTable[constrained->Get(0, tracks[k])] = trackIndex;
           m_tracks.Insert(dataAindex, trackIndex,
-            matchIn.Get(0, tracks[k]));
+            constrained->Get(0, tracks[k]));
         }
         else  {
           // It's a new track
           const int trackIndex = m_tracks.NumTracks();
-          m_featureToTrackTable[matchIn.Get(0, tracks[k])] = trackIndex;
-          m_featureToTrackTable[matchIn.Get(1, tracks[k])] = trackIndex;
+          m_featureToTrackTable[constrained->Get(0, tracks[k])] = trackIndex;
+          m_featureToTrackTable[constrained->Get(1, tracks[k])] = trackIndex;
           m_tracks.Insert(dataAindex, trackIndex,
-              matchIn.Get(0, tracks[k]));
+              constrained->Get(0, tracks[k]));
           m_tracks.Insert(dataBindex, trackIndex,
-              matchIn.Get(1, tracks[k]));
+              constrained->Get(1, tracks[k]));
         }
       }
     }
@@ -307,11 +806,10 @@ bool nRobustViewMatching::computeConstrainMatches(const Matches & matchIn,
         int k = inliers[l];
         for (int i = 0; i < 2; ++i) {
           consistent_matches.Insert(images[i], tracks[k],
-              matchIn.Get(images[i], tracks[k]));
+              constrained->Get(images[i], tracks[k]));
         }
       }
     }
   }
-  return true;
 }
 
@@ -23,11 +23,15 @@
 
 struct FeatureSet;
 #include <map>
+#include <ostream>
+#include <vector>
 #include "libmv/detector/detector.h"
 #include "libmv/descriptor/descriptor.h"
 #include "libmv/correspondence/feature.h"
+#include "libmv/correspondence/feature_matcher_index.h"
 #include "libmv/correspondence/matches.h"
 #include "libmv/correspondence/nViewMatchingInterface.h"
+#include "libmv/correspondence/quantized_descriptors.h"
 
 namespace libmv {
 namespace correspondence  {
@@ -40,8 +44,12 @@ class nRobustViewMatching :public nViewMatchingInterface  {
   nRobustViewMatching();
   // Constructor (Specify a detector and a describer interface)
   // The class do not handle memory management over this two parameter.
+  // With bQuantizedDescriptors the descriptors of every view are kept with one
+  // byte per coordinate (see QuantizedDescriptors) instead of in the
+  // features of getViewData(), which then have empty descriptors.
   nRobustViewMatching(detector::Detector * pDetector,
-                      descriptor::Describer * pDescriber);
+                      descriptor::Describer * pDescriber,
+                      bool bQuantizedDescriptors = false);
   //TODO(pmoulon) Add a constructor with a Detector and a Descriptor
   // Add also a Template function to make the match robust..
   ~nRobustViewMatching(){};
@@ -77,6 +85,56 @@ class nRobustViewMatching :public nViewMatchingInterface  {
   bool computeCrossMatch( const libmv::vector<string> & vec_data);
   
   
+  /**
+  * Same as computeCrossMatch(), but every element is only matched with the
+  * num_candidates elements that look most similar to it, according to a
+  * vocabulary tree (see VocabularyTree) trained on the descriptors of all
+  * the elements. This avoids matching all the pairs of large sets.
+  *
+  * \param[in] vec_data The data on which we want compute cross matches.
+  * \param[in] num_candidates The number of candidates of every element.
+  *
+  * \return True if success (and any matches was found).
+  */
+  bool computeCandidateMatch(const libmv::vector<string> & vec_data,
+                             int num_candidates);
+
+  /**
+  * Find the pairs that computeCandidateMatch() matches, without matching
+  * them: every element with its num_candidates most similar ones. The pairs
+  * (i, j) have i > j and are sorted.
+  *
+  * \param[in] vec_data The data among which the pairs are searched.
+  * \param[in] num_candidates The number of candidates of every element.
+  * \param[out] pairs The candidate pairs, by index in vec_data.
+  *
+  * \return True if success (and any descriptor was found).
+  */
+  bool computeCandidatePairs(const libmv::vector<string> & vec_data,
+                             int num_candidates,
+                             std::vector<std::pair<int, int> > * pairs);
+
+  /**
+  * Match only the given pairs of elements, e.g. the share of a node of the
+  * pairs of a larger set (see PartitionPairs()). Only the data of the
+  * elements of the pairs is computed.
+  *
+  * \param[in] vec_data The data the indices of the pairs refer to.
+  * \param[in] pairs The pairs to match, by index in vec_data.
+  *
+  * \return True if success (and any matches was found).
+  */
+  bool computePairMatch(const libmv::vector<string> & vec_data,
+                        const std::vector<std::pair<int, int> > & pairs);
+
+  /**
+  * Compute the data of all the elements, as computeData(), in parallel with
+  * setExtractors().
+  *
+  * \return True if the data of every element is computed.
+  */
+  bool computeAllData(const libmv::vector<string> & vec_data);
+
   /**
   * From a series of element it computes the incremental putative match list.
   * (only locally, in the relative neighborhood)
@@ -102,21 +160,155 @@ class nRobustViewMatching :public nViewMatchingInterface  {
                                int dataBindex,
                                Matches * matchesOut);
 
+  /**
+  * Enable a second matching pass after the model is fitted between two
+  * views: the descriptors are only compared near the epipolar lines (see
+  * FindGuidedMatchesFundamental()), which usually finds more inliers. It
+  * needs the descriptors kept in the features, so it is ignored with
+  * quantized descriptors.
+  */
+  void setGuidedMatching(bool bGuidedMatching)
+    { m_bGuidedMatching = bGuidedMatching;  }
+
+  /**
+  * Number of threads matching the pairs of computeCrossMatch(),
+  * computeCandidateMatch() and computeRelativeMatch(). The pairs are
+  * matched and fitted in parallel, and the tracks are then merged in the
+  * same order as with one thread. Only the random sampling of the robust
+  * fits, which share rand(), depends on the number of threads.
+  */
+  void setNumThreads(int iNumThreads)
+    { m_iNumThreads = iNumThreads;  }
+
+  /**
+  * Free the descriptors of every element as soon as all its pairs are
+  * matched by the functions above, to bound the memory used by large sets.
+  * The features of getViewData() then have empty descriptors.
+  */
+  void setReleaseDescriptors(bool bReleaseDescriptors)
+    { m_bReleaseDescriptors = bReleaseDescriptors;  }
+
+  /**
+  * Detect and describe the elements of computeCrossMatch(),
+  * computeCandidateMatch() and computeRelativeMatch() with one thread per
+  * detector and describer pair, since they are not thread safe. The
+  * elements are split in interleaved shards, one per pair, and their
+  * features are stored as with computeData(). The pointers are not owned.
+  */
+  void setExtractors(const std::vector<detector::Detector *> & detectors,
+                     const std::vector<descriptor::Describer *> & describers);
+
+  /**
+  * Write the geometrically consistent matches of every pair to out as soon
+  * as the pair is merged, one line "indexA indexB xA yA xB yB" per match,
+  * instead of only keeping them in getSharedData(). The pairs are matched
+  * in batches, so that only the fits of a batch are in memory at once. out is
+  * not owned; NULL, the default, disables the output.
+  */
+  void setPairMatchesOutput(std::ostream * out)
+    { m_pPairMatchesOutput = out;  }
+
+  /**
+  * Keep the features and descriptors computed by computeData() in files of
+  * directory (see WriteFeatureCache()), and read them back instead of
+  * detecting again when the image, its contents and parameters are the same.
+  * parameters must describe the detector and describer configuration, since
+  * they cannot be inspected.
+  */
+  void setFeatureCache(const string & directory, const string & parameters)
+  {
+    m_bFeatureCache = true;
+    m_featureCacheDirectory = directory;
+    m_featureCacheParameters = parameters;
+  }
+
   /// Return pairwise correspondence ( geometrically filtered )
   const map< pair<string,string>, Matches> & getSharedData() const
     { return m_sharedData;  }
   /// Return extracted feature over the given image.
   const map<string,FeatureSet> & getViewData() const
     { return m_ViewData;  }
+  /// Return the quantized descriptors of each view (if requested).
+  const map<string,QuantizedDescriptors> & getViewDescriptors() const
+    { return m_ViewDescriptors;  }
   /// Return detected geometrical consistent matches
   const Matches & getMatches()  const
     { return m_tracks;  }
 
 private :
+  /// The model fitted to the matches of a pair of elements, and its inliers.
+  struct PairFit {
+    Matches matches;
+    libmv::vector<int> tracks;
+    libmv::vector<int> inliers;
+  };
+  struct PairFitter;
+  struct IndexBuilder;
+  struct DataExtractor;
+
+  /// Detect and describe an element with the given detector and describer,
+  /// or read its features from the cache. Safe to call from several threads
+  /// with different detectors and describers.
+  bool extractData(const string & filename,
+                   detector::Detector * pDetector,
+                   descriptor::Describer * pDescriber,
+                   FeatureSet * features) const;
+
+  /// Keep the features of an element, quantizing their descriptors if
+  /// requested. *features is emptied.
+  void storeViewData(const string & filename, FeatureSet * features);
+  /// Compute the putative matches of two elements (by index).
+  void findPairMatches(int dataAindex, int dataBindex,
+                       Matches * matches) const;
+  /// Fit the geometric model of computeConstrainMatches(), without touching
+  /// the tracks, so that several pairs can be fitted at once.
+  void fitPair(const Matches & matchIn, int dataAindex, int dataBindex,
+               PairFit * fit) const;
+  /// Merge the inliers of a fitted pair into the tracks and export them.
+  void mergePair(const PairFit & fit, int dataAindex, int dataBindex,
+                 Matches * matchesOut);
+  /// Keep the consistent matches of a pair in the shared data.
+  void storePairMatches(int dataAindex, int dataBindex,
+                        const Matches & matches);
+  /// Match the given pairs of elements (by index) in parallel, see
+  /// setNumThreads().
+  bool matchPairs(const std::vector<std::pair<int, int> > & pairs);
+  /// Build the matcher index of the elements of pairs that have none, in
+  /// parallel, so that each is built once however many pairs it is in.
+  void buildViewIndices(const std::vector<std::pair<int, int> > & pairs);
+  /// Free the descriptors of the named element, and its matcher index.
+  void releaseDescriptors(const string & data);
+
+  /// Write the descriptors of the named element in rows, one per feature.
+  /// Return their dimension.
+  int getViewDescriptorRows(const string & data, std::vector<float> * rows);
+
   /// Input data names
   libmv::vector<string> m_vec_InputNames;
   /// Data that represent each named element.
   map<string,FeatureSet> m_ViewData;
+  /// Quantized descriptors of each named element.
+  map<string,QuantizedDescriptors> m_ViewDescriptors;
+  /// Matcher of the descriptors of each named element, built on the first
+  /// pair it is matched in.
+  map<string,FeatureMatcherIndex> m_ViewIndices;
+  /// Whether the descriptors are stored quantized.
+  bool m_bQuantizedDescriptors;
+  /// Whether the matches are searched again guided by the fitted model.
+  bool m_bGuidedMatching;
+  /// Whether the descriptors are freed once all their pairs are matched.
+  bool m_bReleaseDescriptors;
+  /// Number of threads matching pairs.
+  int m_iNumThreads;
+  /// One detector and describer per extraction thread, if set.
+  std::vector<detector::Detector *> m_vec_Detectors;
+  std::vector<descriptor::Describer *> m_vec_Describers;
+  /// Where the consistent matches of every pair are written, if anywhere.
+  std::ostream * m_pPairMatchesOutput;
+  /// Where and for which parameters the features are cached, if they are.
+  bool m_bFeatureCache;
+  string m_featureCacheDirectory;
+  string m_featureCacheParameters;
   /// Matches between element named element <A,B>.
   map< pair<string,string>, Matches> m_sharedData;
 
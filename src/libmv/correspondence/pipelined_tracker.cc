@@ -0,0 +1,141 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/correspondence/pipelined_tracker.h"
+
+namespace libmv {
+namespace tracker {
+
+PipelinedTracker::PipelinedTracker(Tracker *tracker,
+                                   ImageSequence *images,
+                                   int look_ahead,
+                                   int num_threads)
+    : tracker_(tracker),
+      images_(images),
+      length_(images->Length()),
+      look_ahead_(look_ahead),
+      stopping_(false),
+      next_frame_(0),
+      next_to_extract_(0) {
+  if (look_ahead_ < 1) {
+    look_ahead_ = 1;
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    pthread_t worker;
+    if (pthread_create(&worker, NULL, &WorkerEntry, this) != 0) {
+      break;
+    }
+    workers_.push_back(worker);
+  }
+}
+
+PipelinedTracker::~PipelinedTracker() {
+  mutex_.Lock();
+  stopping_ = true;
+  work_ready_.Broadcast();
+  mutex_.Unlock();
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    pthread_join(workers_[i], NULL);
+  }
+  std::map<int, FeatureSet *>::iterator it = ready_.begin();
+  for (; it != ready_.end(); ++it) {
+    delete it->second;
+  }
+}
+
+bool PipelinedTracker::TrackNext(const FeaturesGraph &known_features_graph,
+                                 FeaturesGraph *new_features_graph,
+                                 Matches::ImageID *image_id,
+                                 bool keep_single_feature) {
+  if (next_frame_ >= length_) {
+    return false;
+  }
+  FeatureSet *feature_set = NULL;
+  if (workers_.size() == 0) {
+    // Nobody extracts ahead; do it in place.
+    feature_set = Extract(next_frame_);
+    ++next_frame_;
+  } else {
+    MutexLock lock(&mutex_);
+    while (!ready_.count(next_frame_)) {
+      frame_ready_.Wait(&mutex_);
+    }
+    feature_set = ready_[next_frame_];
+    ready_.erase(next_frame_);
+    ++next_frame_;
+    work_ready_.Broadcast();
+  }
+  if (!feature_set) {
+    return false;
+  }
+  return tracker_->Track(feature_set,
+                         known_features_graph,
+                         new_features_graph,
+                         image_id,
+                         keep_single_feature);
+}
+
+FeatureSet *PipelinedTracker::Extract(int i) {
+  Image *image;
+  {
+    MutexLock lock(&images_mutex_);
+    image = images_->GetImage(i);
+  }
+  if (!image) {
+    return NULL;
+  }
+  FeatureSet *feature_set = new FeatureSet();
+  tracker_->DetectAndDescribe(*image, feature_set);
+  MutexLock lock(&images_mutex_);
+  images_->Unpin(i);
+  return feature_set;
+}
+
+void *PipelinedTracker::WorkerEntry(void *self) {
+  static_cast<PipelinedTracker *>(self)->RunWorker();
+  return NULL;
+}
+
+void PipelinedTracker::RunWorker() {
+  for (;;) {
+    mutex_.Lock();
+    // The queue of extracted frames is bounded by the look ahead.
+    while (!stopping_ && (next_to_extract_ >= length_ ||
+                          next_to_extract_ >= next_frame_ + look_ahead_)) {
+      work_ready_.Wait(&mutex_);
+    }
+    if (stopping_) {
+      mutex_.Unlock();
+      return;
+    }
+    int i = next_to_extract_++;
+    mutex_.Unlock();
+
+    FeatureSet *feature_set = Extract(i);
+
+    mutex_.Lock();
+    ready_[i] = feature_set;
+    frame_ready_.Broadcast();
+    mutex_.Unlock();
+  }
+}
+
+} // using namespace tracker
+} // using namespace libmv
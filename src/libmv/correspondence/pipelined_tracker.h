@@ -0,0 +1,98 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_CORRESPONDENCE_PIPELINED_TRACKER_H_
+#define LIBMV_CORRESPONDENCE_PIPELINED_TRACKER_H_
+
+#include <map>
+#include <pthread.h>
+
+#include "libmv/base/thread.h"
+#include "libmv/base/vector.h"
+#include "libmv/correspondence/tracker.h"
+#include "libmv/image/image.h"
+#include "libmv/image/image_sequence.h"
+
+namespace libmv {
+namespace tracker {
+
+// Tracks the frames of a sequence in order, extracting the features of the
+// next frames on worker threads while the current frame is matched. Only the
+// matching (and the filtering of a RobustTracker) stays sequential: up to
+// look_ahead frames past the one being tracked are read, detected and
+// described by num_threads workers through Tracker::DetectAndDescribe().
+//
+// Neither the tracker nor the sequence are owned. The sequence is only read by
+// the workers, one at a time, and must not be used by others while tracking.
+class PipelinedTracker {
+ public:
+  PipelinedTracker(Tracker *tracker,
+                   ImageSequence *images,
+                   int look_ahead,
+                   int num_threads = 1);
+  ~PipelinedTracker();
+
+  // Tracks the features of frame NextFrame() as Tracker::Track() does, then
+  // moves to the next frame. Returns false when the sequence is over, when
+  // the frame could not be read or when the tracker failed.
+  bool TrackNext(const FeaturesGraph &known_features_graph,
+                 FeaturesGraph *new_features_graph,
+                 Matches::ImageID *image_id,
+                 bool keep_single_feature = true);
+
+  int NextFrame() const { return next_frame_; }
+
+ private:
+  // Reads frame i and extracts its features. Returns NULL if the frame could
+  // not be read.
+  FeatureSet *Extract(int i);
+
+  static void *WorkerEntry(void *self);
+  void RunWorker();
+
+  Tracker *tracker_;
+  ImageSequence *images_;
+  int length_;
+  int look_ahead_;
+  vector<pthread_t> workers_;
+
+  // Serializes the accesses to images_.
+  Mutex images_mutex_;
+  // Protects all the members below.
+  Mutex mutex_;
+  ConditionVariable work_ready_;
+  ConditionVariable frame_ready_;
+  bool stopping_;
+  // The frame to track next.
+  int next_frame_;
+  // The first frame not yet claimed by a worker.
+  int next_to_extract_;
+  // Features extracted ahead, by frame.
+  std::map<int, FeatureSet *> ready_;
+
+  // Not copyable.
+  PipelinedTracker(const PipelinedTracker &);
+  PipelinedTracker &operator=(const PipelinedTracker &);
+};
+
+} // using namespace tracker
+} // using namespace libmv
+
+#endif  // LIBMV_CORRESPONDENCE_PIPELINED_TRACKER_H_
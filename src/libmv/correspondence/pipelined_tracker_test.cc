@@ -0,0 +1,215 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/base/vector.h"
+#include "libmv/correspondence/pipelined_tracker.h"
+#include "libmv/image/image.h"
+#include "libmv/image/image_sequence.h"
+#include "testing/testing.h"
+
+namespace {
+
+using namespace libmv;
+using namespace libmv::tracker;
+
+const int kNumFeatures = 5;
+
+// Detects the same features in every frame, shifted by the value of the first
+// pixel, and counts the calls.
+class ShiftedDetector : public detector::Detector {
+ public:
+  explicit ShiftedDetector(int *num_calls) : num_calls_(num_calls) {}
+  virtual ~ShiftedDetector() {}
+  virtual void Detect(const Image &image,
+                      vector<Feature *> *features,
+                      detector::DetectorData **data) const {
+    (void) data;
+    ++*num_calls_;
+    float shift = (*image.AsArray3Du())(0, 0);
+    for (int k = 0; k < kNumFeatures; ++k) {
+      features->push_back(new PointFeature(10 * k + shift, 20 * k));
+    }
+  }
+ private:
+  int *num_calls_;
+};
+
+// Describes a feature by its vertical position, which does not change.
+class RowDescriber : public descriptor::Describer {
+ public:
+  virtual ~RowDescriber() {}
+  virtual void Describe(const vector<Feature *> &features,
+                        const Image &image,
+                        const detector::DetectorData *detector_data,
+                        vector<descriptor::Descriptor *> *descriptors) const {
+    (void) image;
+    (void) detector_data;
+    for (size_t i = 0; i < features.size(); ++i) {
+      descriptor::VecfDescriptor *descriptor =
+          new descriptor::VecfDescriptor(2);
+      descriptor->coords << static_cast<PointFeature *>(features[i])->y(), 0;
+      descriptors->push_back(descriptor);
+    }
+  }
+};
+
+// A sequence of one pixel images, frame i having the value i.
+class ConstantSequence : public ImageSequence {
+ public:
+  explicit ConstantSequence(int length) {
+    for (int i = 0; i < length; ++i) {
+      ByteImage *array = new ByteImage(1, 1);
+      (*array)(0, 0) = i;
+      images_.push_back(new Image(array));
+    }
+  }
+  virtual ~ConstantSequence() {
+    for (size_t i = 0; i < images_.size(); ++i) {
+      delete images_[i];
+    }
+  }
+  virtual Image *GetImage(int i) { return images_[i]; }
+  virtual void Unpin(int i) { (void) i; }
+  virtual int Length() { return images_.size(); }
+ private:
+  vector<Image *> images_;
+};
+
+Tracker *MakeTracker(int *num_detections) {
+  return new Tracker(new ShiftedDetector(num_detections),
+                     new RowDescriber(),
+                     NULL);
+}
+
+// Tracks every frame against the previous one, as the tracker tool does, and
+// records the number of new tracks of each frame.
+void TrackSequence(Tracker *tracker,
+                   ImageSequence *images,
+                   PipelinedTracker *pipelined,
+                   FeaturesGraph *all_features_graph,
+                   vector<int> *num_new_tracks) {
+  FeaturesGraph current_previous_fg[2];
+  int i_prev = 0, i_new = 1;
+  for (int i = 0; i < images->Length(); ++i) {
+    Matches::ImageID image_id = 0;
+    if (pipelined) {
+      EXPECT_EQ(i, pipelined->NextFrame());
+      EXPECT_TRUE(pipelined->TrackNext(current_previous_fg[i_prev],
+                                       &current_previous_fg[i_new],
+                                       &image_id));
+    } else {
+      EXPECT_TRUE(tracker->Track(*images->GetImage(i),
+                                 current_previous_fg[i_prev],
+                                 &current_previous_fg[i_new],
+                                 &image_id));
+      images->Unpin(i);
+    }
+    current_previous_fg[i_prev].Clear();
+    all_features_graph->Merge(current_previous_fg[i_new]);
+    num_new_tracks->push_back(current_previous_fg[i_new].matches_.NumTracks());
+    i_prev = i_prev ^ 1;
+    i_new  = i_prev ^ 1;
+  }
+}
+
+TEST(PipelinedTracker, MatchesSequentialTracking) {
+  const int kLength = 7;
+  ConstantSequence images(kLength);
+
+  int num_detections = 0;
+  scoped_ptr<Tracker> tracker(MakeTracker(&num_detections));
+  FeaturesGraph expected_graph;
+  vector<int> expected_new_tracks;
+  TrackSequence(tracker.get(), &images, NULL, &expected_graph,
+                &expected_new_tracks);
+
+  for (int num_threads = 0; num_threads <= 3; ++num_threads) {
+    int num_pipelined_detections = 0;
+    scoped_ptr<Tracker> pipelined_tracker(
+        MakeTracker(&num_pipelined_detections));
+    FeaturesGraph graph;
+    vector<int> new_tracks;
+    {
+      PipelinedTracker pipelined(pipelined_tracker.get(), &images, 2,
+                                 num_threads);
+      TrackSequence(NULL, &images, &pipelined, &graph, &new_tracks);
+      FeaturesGraph unused;
+      Matches::ImageID image_id;
+      EXPECT_FALSE(pipelined.TrackNext(graph, &unused, &image_id));
+    }
+
+    // Every frame is extracted once.
+    EXPECT_EQ(kLength, num_pipelined_detections);
+    ASSERT_EQ(expected_new_tracks.size(), new_tracks.size());
+    for (size_t i = 0; i < new_tracks.size(); ++i) {
+      EXPECT_EQ(expected_new_tracks[i], new_tracks[i]);
+    }
+    EXPECT_EQ(expected_graph.matches_.NumTracks(), graph.matches_.NumTracks());
+    EXPECT_EQ(expected_graph.matches_.NumImages(), graph.matches_.NumImages());
+    graph.DeleteAndClear();
+  }
+  EXPECT_EQ(kNumFeatures, expected_graph.matches_.NumTracks());
+  expected_graph.DeleteAndClear();
+}
+
+TEST(Tracker, TrackIndexMatchesEveryImage) {
+  const int kLength = 7;
+  ConstantSequence images(kLength);
+
+  int num_detections = 0;
+  scoped_ptr<Tracker> tracker(MakeTracker(&num_detections));
+  FeaturesGraph expected_graph;
+  vector<int> expected_new_tracks;
+  TrackSequence(tracker.get(), &images, NULL, &expected_graph,
+                &expected_new_tracks);
+
+  scoped_ptr<Tracker> indexed_tracker(MakeTracker(&num_detections));
+  indexed_tracker->set_use_track_index(true);
+  FeaturesGraph graph;
+  vector<int> new_tracks;
+  TrackSequence(indexed_tracker.get(), &images, NULL, &graph, &new_tracks);
+
+  ASSERT_EQ(expected_new_tracks.size(), new_tracks.size());
+  for (size_t i = 0; i < new_tracks.size(); ++i) {
+    EXPECT_EQ(expected_new_tracks[i], new_tracks[i]);
+  }
+  EXPECT_EQ(kNumFeatures, graph.matches_.NumTracks());
+  EXPECT_EQ(kLength, graph.matches_.NumImages());
+  expected_graph.DeleteAndClear();
+  graph.DeleteAndClear();
+}
+
+TEST(PipelinedTracker, DestroyedBeforeTheEnd) {
+  ConstantSequence images(10);
+  int num_detections = 0;
+  scoped_ptr<Tracker> tracker(MakeTracker(&num_detections));
+  FeaturesGraph known, graph;
+  {
+    PipelinedTracker pipelined(tracker.get(), &images, 3, 2);
+    Matches::ImageID image_id;
+    EXPECT_TRUE(pipelined.TrackNext(known, &graph, &image_id));
+    EXPECT_EQ(1, pipelined.NextFrame());
+  }
+  // No more than the look ahead was extracted past the tracked frame.
+  EXPECT_LE(num_detections, 1 + 3);
+  graph.DeleteAndClear();
+}
+
+}  // namespace
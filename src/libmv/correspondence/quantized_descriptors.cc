@@ -0,0 +1,177 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "libmv/correspondence/quantized_descriptors.h"
+
+namespace libmv {
+namespace {
+
+// The query expressed in the units of the codes of each dimension, so that
+// the distance to a row is sum_d weights[d] * (units[d] - code[d])^2 + bias;
+// the bias collects the dimensions of constant value (zero step).
+struct ScaledQuery {
+  std::vector<float> units;
+  std::vector<float> weights;
+  float bias;
+};
+
+void ScaleQuery(const float *query, const QuantizedDescriptors &dataset,
+                ScaledQuery *scaled) {
+  const int n = dataset.dimension;
+  scaled->units.resize(n);
+  scaled->weights.resize(n);
+  scaled->bias = 0;
+  for (int d = 0; d < n; ++d) {
+    float difference = query[d] - dataset.offsets[d];
+    float step = dataset.steps[d];
+    if (step > 0) {
+      scaled->units[d] = difference / step;
+      scaled->weights[d] = step * step;
+    } else {
+      scaled->units[d] = 0;
+      scaled->weights[d] = 0;
+      scaled->bias += difference * difference;
+    }
+  }
+}
+
+float ScaledDistance(const ScaledQuery &query, const unsigned char *codes,
+                     int n) {
+  const float *units = &query.units[0];
+  const float *weights = &query.weights[0];
+  int d = 0;
+  float sum = query.bias;
+#ifdef __SSE2__
+  __m128i zero = _mm_setzero_si128();
+  __m128 acc0 = _mm_setzero_ps();
+  __m128 acc1 = _mm_setzero_ps();
+  for (; d + 8 <= n; d += 8) {
+    __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(codes + d));
+    __m128i shorts = _mm_unpacklo_epi8(bytes, zero);
+    __m128 c0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(shorts, zero));
+    __m128 c1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(shorts, zero));
+    __m128 e0 = _mm_sub_ps(_mm_loadu_ps(units + d), c0);
+    __m128 e1 = _mm_sub_ps(_mm_loadu_ps(units + d + 4), c1);
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(weights + d),
+                                       _mm_mul_ps(e0, e0)));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(weights + d + 4),
+                                       _mm_mul_ps(e1, e1)));
+  }
+  float s[4];
+  _mm_storeu_ps(s, _mm_add_ps(acc0, acc1));
+  sum += (s[0] + s[1]) + (s[2] + s[3]);
+#endif
+  for (; d < n; ++d) {
+    float e = units[d] - codes[d];
+    sum += weights[d] * e * e;
+  }
+  return sum;
+}
+
+}  // namespace
+
+void QuantizedDescriptors::Dequantize(float *rows) const {
+  for (int i = 0; i < num_rows; ++i) {
+    const unsigned char *row = Row(i);
+    for (int d = 0; d < dimension; ++d) {
+      rows[i * dimension + d] = offsets[d] + steps[d] * row[d];
+    }
+  }
+}
+
+void QuantizeDescriptors(const float *rows, int num_rows, int dimension,
+                         QuantizedDescriptors *quantized) {
+  quantized->num_rows = num_rows;
+  quantized->dimension = dimension;
+  quantized->offsets.assign(dimension, 0);
+  quantized->steps.assign(dimension, 0);
+  quantized->codes.resize(num_rows * dimension);
+  if (num_rows == 0) {
+    return;
+  }
+  for (int d = 0; d < dimension; ++d) {
+    float low = rows[d], high = rows[d];
+    for (int i = 1; i < num_rows; ++i) {
+      low = std::min(low, rows[i * dimension + d]);
+      high = std::max(high, rows[i * dimension + d]);
+    }
+    quantized->offsets[d] = low;
+    quantized->steps[d] = (high - low) / 255;
+  }
+  for (int i = 0; i < num_rows; ++i) {
+    for (int d = 0; d < dimension; ++d) {
+      float step = quantized->steps[d];
+      int code = 0;
+      if (step > 0) {
+        code = static_cast<int>(
+            (rows[i * dimension + d] - quantized->offsets[d]) / step + 0.5f);
+        code = std::max(0, std::min(255, code));
+      }
+      quantized->codes[i * dimension + d] = code;
+    }
+  }
+}
+
+float AsymmetricSquaredDistance(const float *query,
+                                const QuantizedDescriptors &dataset,
+                                int i) {
+  ScaledQuery scaled;
+  ScaleQuery(query, dataset, &scaled);
+  return ScaledDistance(scaled, dataset.Row(i), dataset.dimension);
+}
+
+void QuantizedKnn(const QuantizedDescriptors &dataset,
+                  const float *queries, int num_queries, int k,
+                  int *ids, float *distances) {
+  const int n = dataset.dimension;
+  ScaledQuery scaled;
+  for (int q = 0; q < num_queries; ++q) {
+    int *best_ids = ids + q * k;
+    float *best_distances = distances + q * k;
+    std::fill(best_ids, best_ids + k, -1);
+    std::fill(best_distances, best_distances + k,
+              std::numeric_limits<float>::max());
+
+    ScaleQuery(queries + q * n, dataset, &scaled);
+    for (int i = 0; i < dataset.num_rows; ++i) {
+      float distance = ScaledDistance(scaled, dataset.Row(i), n);
+      if (distance >= best_distances[k - 1]) {
+        continue;
+      }
+      int j = k - 1;
+      for (; j > 0 && best_distances[j - 1] > distance; --j) {
+        best_ids[j] = best_ids[j - 1];
+        best_distances[j] = best_distances[j - 1];
+      }
+      best_ids[j] = i;
+      best_distances[j] = distance;
+    }
+  }
+}
+
+}  // namespace libmv
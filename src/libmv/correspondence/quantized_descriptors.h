@@ -0,0 +1,74 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_CORRESPONDENCE_QUANTIZED_DESCRIPTORS_H_
+#define LIBMV_CORRESPONDENCE_QUANTIZED_DESCRIPTORS_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace libmv {
+
+// A set of float descriptors stored with one byte per coordinate: coordinate
+// d of row i is approximated by offsets[d] + steps[d] * codes[i * dimension +
+// d], with the offset and step of each dimension chosen from the range of the
+// set. This is four times smaller than the floats, and the quantized rows are
+// compared directly with float queries (see QuantizedKnn()), so the float
+// descriptors of a set never need to be rebuilt for matching.
+struct QuantizedDescriptors {
+  QuantizedDescriptors() : num_rows(0), dimension(0) {}
+
+  const unsigned char *Row(int i) const { return &codes[i * dimension]; }
+
+  // Writes the approximated floats of all the rows in rows.
+  void Dequantize(float *rows) const;
+
+  size_t MemorySizeInBytes() const {
+    return codes.size() + (offsets.size() + steps.size()) * sizeof(float);
+  }
+
+  int num_rows;
+  int dimension;
+  std::vector<float> offsets;
+  std::vector<float> steps;
+  std::vector<unsigned char> codes;
+};
+
+// Quantizes the num_rows rows of dimension floats; the error on every
+// coordinate is at most half a step, i.e. 1/510 of the range of its dimension.
+void QuantizeDescriptors(const float *rows, int num_rows, int dimension,
+                         QuantizedDescriptors *quantized);
+
+// Squared distance between a float query and the quantized row i (the
+// "asymmetric" distance: only the dataset side is approximated).
+float AsymmetricSquaredDistance(const float *query,
+                                const QuantizedDescriptors &dataset,
+                                int i);
+
+// Same as BruteForceKnn() on quantized dataset rows: writes the ids and the
+// asymmetric squared distances of the k nearest rows of each query, closest
+// first; missing neighbors (k > num_rows) get an id of -1.
+void QuantizedKnn(const QuantizedDescriptors &dataset,
+                  const float *queries, int num_queries, int k,
+                  int *ids, float *distances);
+
+}  // namespace libmv
+
+#endif  // LIBMV_CORRESPONDENCE_QUANTIZED_DESCRIPTORS_H_
@@ -0,0 +1,151 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cmath>
+
+#include "libmv/base/vector.h"
+#include "libmv/correspondence/brute_force_matching.h"
+#include "libmv/correspondence/feature_matching.h"
+#include "libmv/correspondence/quantized_descriptors.h"
+#include "testing/testing.h"
+
+namespace {
+using namespace libmv;
+
+float Random(unsigned int *seed) {
+  *seed = *seed * 1103515245u + 12345u;
+  return ((*seed >> 16) & 0x7fff) / 32767.0f;
+}
+
+void RandomRows(int num_rows, int dimension, unsigned int seed,
+                vector<float> *rows) {
+  rows->resize(num_rows * dimension);
+  for (int i = 0; i < rows->size(); ++i) {
+    (*rows)[i] = 2 * Random(&seed) - 1;
+  }
+}
+
+TEST(QuantizedDescriptors, DequantizeIsWithinHalfAStep) {
+  const int num_rows = 50, dimension = 13;
+  vector<float> rows, dequantized(num_rows * dimension);
+  RandomRows(num_rows, dimension, 1, &rows);
+  // A constant dimension.
+  for (int i = 0; i < num_rows; ++i) {
+    rows[i * dimension + 3] = 0.25f;
+  }
+  QuantizedDescriptors quantized;
+  QuantizeDescriptors(&rows[0], num_rows, dimension, &quantized);
+  EXPECT_EQ(num_rows * dimension + 2 * dimension * sizeof(float),
+            quantized.MemorySizeInBytes());
+  quantized.Dequantize(&dequantized[0]);
+  for (int i = 0; i < rows.size(); ++i) {
+    EXPECT_NEAR(rows[i], dequantized[i],
+                0.5 * quantized.steps[i % dimension] + 1e-6);
+  }
+}
+
+TEST(QuantizedDescriptors, AsymmetricDistanceMatchesTheDequantizedRows) {
+  const int num_rows = 30, dimension = 21;
+  vector<float> rows, dequantized(num_rows * dimension), queries;
+  RandomRows(num_rows, dimension, 2, &rows);
+  RandomRows(5, dimension, 3, &queries);
+  QuantizedDescriptors quantized;
+  QuantizeDescriptors(&rows[0], num_rows, dimension, &quantized);
+  quantized.Dequantize(&dequantized[0]);
+  for (int q = 0; q < 5; ++q) {
+    for (int i = 0; i < num_rows; ++i) {
+      float expected = 0;
+      for (int d = 0; d < dimension; ++d) {
+        float e = queries[q * dimension + d] - dequantized[i * dimension + d];
+        expected += e * e;
+      }
+      EXPECT_NEAR(expected,
+                  AsymmetricSquaredDistance(&queries[q * dimension],
+                                            quantized, i), 1e-4);
+    }
+  }
+}
+
+TEST(QuantizedDescriptors, KnnAgreesWithTheFloatSearch) {
+  const int num_rows = 300, num_queries = 40, dimension = 64;
+  vector<float> rows, queries, norms(num_rows);
+  RandomRows(num_rows, dimension, 4, &rows);
+  RandomRows(num_queries, dimension, 5, &queries);
+  // Half the queries are noisy copies of rows.
+  unsigned int seed = 6;
+  for (int q = 0; q < num_queries; q += 2) {
+    for (int d = 0; d < dimension; ++d) {
+      queries[q * dimension + d] = rows[5 * q * dimension + d]
+                                 + 0.05f * (Random(&seed) - 0.5f);
+    }
+  }
+  QuantizedDescriptors quantized;
+  QuantizeDescriptors(&rows[0], num_rows, dimension, &quantized);
+
+  const int k = 2;
+  vector<int> ids(num_queries * k), float_ids(num_queries * k);
+  vector<float> distances(num_queries * k), float_distances(num_queries * k);
+  QuantizedKnn(quantized, &queries[0], num_queries, k, &ids[0],
+               &distances[0]);
+  SquaredRowNorms(&rows[0], num_rows, dimension, &norms[0]);
+  BruteForceKnn(&rows[0], &norms[0], num_rows, &queries[0], num_queries,
+                dimension, k, &float_ids[0], &float_distances[0]);
+  for (int q = 0; q < num_queries; ++q) {
+    EXPECT_LE(distances[q * k], distances[q * k + 1]);
+    if (q % 2 == 0) {
+      EXPECT_EQ(5 * q, ids[q * k]);
+    }
+    EXPECT_NEAR(float_distances[q * k], distances[q * k],
+                0.02 * float_distances[q * k] + 0.01);
+  }
+}
+
+TEST(QuantizedDescriptors, FindCandidateMatchesOnQuantizedSets) {
+  const int num_rows = 40, dimension = 16;
+  vector<float> rows;
+  RandomRows(num_rows, dimension, 7, &rows);
+  FeatureSet left, right;
+  left.features.resize(num_rows);
+  right.features.resize(num_rows);
+  // The right set is the left one in reverse order.
+  vector<float> reversed(num_rows * dimension);
+  for (int i = 0; i < num_rows; ++i) {
+    std::copy(&rows[i * dimension], &rows[(i + 1) * dimension],
+              &reversed[(num_rows - 1 - i) * dimension]);
+  }
+  QuantizedDescriptors left_descriptors, right_descriptors;
+  QuantizeDescriptors(&rows[0], num_rows, dimension, &left_descriptors);
+  QuantizeDescriptors(&reversed[0], num_rows, dimension, &right_descriptors);
+
+  Matches matches;
+  FindCandidateMatches(left, left_descriptors, right, right_descriptors,
+                       &matches);
+  EXPECT_EQ(num_rows, matches.NumTracks());
+  for (int t = 0; t < num_rows; ++t) {
+    int i = static_cast<const KeypointFeature *>(matches.Get(0, t))
+            - &left.features[0];
+    int j = static_cast<const KeypointFeature *>(matches.Get(1, t))
+            - &right.features[0];
+    EXPECT_EQ(num_rows - 1 - i, j);
+  }
+}
+
+}  // namespace
@@ -93,9 +93,34 @@ bool RobustTracker::Track(const Image &image,
                                     new_features_graph,
                                     image_id,
                                     keep_single_feature);
-  if (!is_track_ok)
-    return is_track_ok;
-  
+  if (is_track_ok) {
+    RemoveOutliers(known_features_graph, new_features_graph, *image_id,
+                   keep_single_feature);
+  }
+  return is_track_ok;
+}
+
+bool RobustTracker::Track(FeatureSet *feature_set,
+                          const FeaturesGraph &known_features_graph,
+                          FeaturesGraph *new_features_graph,
+                          Matches::ImageID *image_id,
+                          bool keep_single_feature) {
+  bool is_track_ok = Tracker::Track(feature_set,
+                                    known_features_graph,
+                                    new_features_graph,
+                                    image_id,
+                                    keep_single_feature);
+  if (is_track_ok) {
+    RemoveOutliers(known_features_graph, new_features_graph, *image_id,
+                   keep_single_feature);
+  }
+  return is_track_ok;
+}
+
+void RobustTracker::RemoveOutliers(const FeaturesGraph &known_features_graph,
+                                   FeaturesGraph *new_features_graph,
+                                   Matches::ImageID image_id,
+                                   bool keep_single_feature) {
   // TODO(jmichot) Avoid the conversion std::set <-> vector
   // Avoid to compute the fundamental btw images that does not share tracks
   std::set<Matches::ImageID>::const_iterator iter_image =
@@ -104,7 +129,7 @@ bool RobustTracker::Track(const Image &image,
    new_features_graph->matches_.get_tracks();
   for (; iter_image != known_features_graph.matches_.get_images().end();
       ++iter_image) {
-    if (*image_id != *iter_image) {
+    if (image_id != *iter_image) {
       // We remove wrong matches using an epipolar filtering
       vector<Mat> x(2);
       vector<Matches::TrackID> tracks;
@@ -116,7 +141,7 @@ bool RobustTracker::Track(const Image &image,
          known_features_graph.matches_.Get(*iter_image,
                                            *new_track_set_iter));
         const PointFeature *f2 = static_cast<const PointFeature *>(
-         new_features_graph->matches_.Get(*image_id, *new_track_set_iter));
+         new_features_graph->matches_.Get(image_id, *new_track_set_iter));
         if (f1 && f2) {
           tracks.push_back(*new_track_set_iter);
         }
@@ -127,7 +152,7 @@ bool RobustTracker::Track(const Image &image,
         const PointFeature *f1 = static_cast<const PointFeature *>(
          known_features_graph.matches_.Get(*iter_image, tracks[i]));
         const PointFeature *f2 = static_cast<const PointFeature *>(
-         new_features_graph->matches_.Get(*image_id, tracks[i]));
+         new_features_graph->matches_.Get(image_id, tracks[i]));
         if (f1 && f2) {
           x[0](0,i) = f1->x();
           x[0](1,i) = f1->y();          
@@ -161,10 +186,10 @@ bool RobustTracker::Track(const Image &image,
         }
         if (!is_inlier) {
           const Feature * feature_to_remove =
-          new_features_graph->matches_.Get(*image_id, tracks[i]);
-          new_features_graph->matches_.Remove(*image_id, tracks[i]);
+          new_features_graph->matches_.Get(image_id, tracks[i]);
+          new_features_graph->matches_.Remove(image_id, tracks[i]);
           if (keep_single_feature) {
-            new_features_graph->matches_.Insert(*image_id, 
+            new_features_graph->matches_.Insert(image_id, 
                                                 max_num_track,
                                                 feature_to_remove);
             max_num_track++;
@@ -173,5 +198,4 @@ bool RobustTracker::Track(const Image &image,
       }
     }
   }
-  return is_track_ok;
 }
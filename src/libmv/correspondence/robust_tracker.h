@@ -50,11 +50,26 @@ class RobustTracker : public Tracker {
              FeaturesGraph *new_features_graph,
              Matches::ImageID *image_id,
              bool keep_single_feature = true); 
+
+  // Tracks all features in an image, from features already detected and
+  // described by DetectAndDescribe().
+  bool Track(FeatureSet *feature_set,
+             const FeaturesGraph &known_features_graph,
+             FeaturesGraph *new_features_graph,
+             Matches::ImageID *image_id,
+             bool keep_single_feature = true);
              
   void set_rms_threshold_inlier(double threshold) {
     rms_threshold_inlier_ = threshold;
   }
  protected:
+  // Removes the matches of the image image_id of new_features_graph that
+  // do not fit the epipolar geometry with the known images.
+  void RemoveOutliers(const FeaturesGraph &known_features_graph,
+                      FeaturesGraph *new_features_graph,
+                      Matches::ImageID image_id,
+                      bool keep_single_feature);
+
   size_t  minimum_number_inliers_;
   // Maxmimum distance with the epipolar line (px) to be an inlier
   double  rms_threshold_inlier_;
@@ -0,0 +1,351 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cmath>
+
+#include "libmv/base/scoped_ptr.h"
+#include "libmv/correspondence/template_tracker.h"
+#include "libmv/image/image_converter.h"
+#include "libmv/image/image_pyramid.h"
+#include "libmv/image/sample.h"
+#include "libmv/logging/logging.h"
+
+using namespace libmv;
+using namespace tracker;
+
+namespace {
+
+// Coarsest levels smaller than this are not used.
+const int kMinLevelSize = 16;
+
+// The blur of the pyramid darkens the borders of its levels; the pixels this
+// close to them are not compared.
+const int kBorder = 4;
+
+// The pixels from the coordinates of a level, and back.
+Mat3 LevelScale(double factor) {
+  Mat3 S = Mat3::Identity();
+  S(0, 0) = S(1, 1) = factor;
+  return S;
+}
+
+// The warp of parameters p, the identity for p = 0.
+Mat3 WarpOfParameters(const Vec &p) {
+  Mat3 W;
+  W << 1 + p(0), p(2),     p(4),
+       p(1),     1 + p(3), p(5),
+       0,        0,        1;
+  if (p.rows() == 8) {
+    W(2, 0) = p(6);
+    W(2, 1) = p(7);
+  }
+  return W;
+}
+
+// A single channel float image of image.
+bool GrayFloatImage(const Image &image, FloatImage *gray) {
+  if (const Array3Du *bytes = image.AsArray3Du()) {
+    if (bytes->Depth() == 3) {
+      Array3Du byte_gray;
+      Rgb2Gray(*bytes, &byte_gray);
+      ByteArrayToScaledFloatArray(byte_gray, gray);
+    } else {
+      ByteArrayToScaledFloatArray(*bytes, gray);
+    }
+    return gray->Depth() == 1;
+  }
+  if (const Array3Df *floats = image.AsArray3Df()) {
+    if (floats->Depth() == 3) {
+      Rgb2Gray(*floats, gray);
+    } else {
+      gray->CopyFrom(*floats);
+    }
+    return gray->Depth() == 1;
+  }
+  return false;
+}
+
+Matches::ImageID NextImageID(const FeaturesGraph &known_features_graph) {
+  if (known_features_graph.matches_.NumImages() == 0) {
+    return 0;
+  }
+  return known_features_graph.matches_.GetMaxImageID() + 1;
+}
+
+}  // namespace
+
+TemplateTracker::TemplateTracker(detector::Detector *detector,
+                                 descriptor::Describer *describer,
+                                 correspondence::ArrayMatcher<float> *matcher,
+                                 WarpModel model)
+    : Tracker(detector, describer, matcher),
+      model_(model),
+      num_levels_(3),
+      sigma_(0.9),
+      max_iterations_(20),
+      max_rms_(0.1),
+      max_samples_(10000),
+      x0_(0), y0_(0), x1_(-1), y1_(-1),
+      warp_(Mat3::Identity()),
+      rms_(0) {
+}
+
+void TemplateTracker::SetRegion(int x0, int y0, int x1, int y1) {
+  x0_ = x0;
+  y0_ = y0;
+  x1_ = x1;
+  y1_ = y1;
+}
+
+void TemplateTracker::ResetTemplate() {
+  levels_.clear();
+  template_features_.clear();
+  template_tracks_.clear();
+  warp_.setIdentity();
+  rms_ = 0;
+}
+
+bool TemplateTracker::ComputeLevel(const FloatImage &level_image,
+                                   double factor,
+                                   Level *level) const {
+  double x0 = kBorder, y0 = kBorder;
+  double x1 = level_image.Width() - 1 - kBorder;
+  double y1 = level_image.Height() - 1 - kBorder;
+  if (x1_ >= 0) {
+    x0 = std::max(x0, x0_ * factor);
+    y0 = std::max(y0, y0_ * factor);
+    x1 = std::min(x1, x1_ * factor);
+    y1 = std::min(y1, y1_ * factor);
+  }
+  if (x1 - x0 < 2 || y1 - y0 < 2) {
+    return false;
+  }
+  double center_x = (x0 + x1) / 2, center_y = (y0 + y1) / 2;
+  double scale = std::max(x1 - x0, y1 - y0) / 2;
+  level->to_pixels << scale, 0,     center_x,
+                      0,     scale, center_y,
+                      0,     0,     1;
+
+  // A regular grid of at most max_samples_ pixels.
+  double area = (x1 - x0 + 1) * (y1 - y0 + 1);
+  int step = std::max(1, int(ceil(sqrt(area / max_samples_))));
+  vector<int> xs, ys;
+  for (int y = int(ceil(y0)); y <= y1; y += step) {
+    for (int x = int(ceil(x0)); x <= x1; x += step) {
+      xs.push_back(x);
+      ys.push_back(y);
+    }
+  }
+  int num_samples = xs.size();
+  int num_parameters = NumParameters();
+  level->q.resize(2, num_samples);
+  level->intensity.resize(num_samples);
+  Mat steepest_descent(num_samples, num_parameters);
+  for (int k = 0; k < num_samples; ++k) {
+    double qx = (xs[k] - center_x) / scale;
+    double qy = (ys[k] - center_y) / scale;
+    level->q(0, k) = qx;
+    level->q(1, k) = qy;
+    level->intensity(k) = level_image(ys[k], xs[k], 0);
+    // The gradient of the template with respect to q, times the Jacobian of
+    // the warp at the identity.
+    double gx = scale * level_image(ys[k], xs[k], 1);
+    double gy = scale * level_image(ys[k], xs[k], 2);
+    steepest_descent(k, 0) = gx * qx;
+    steepest_descent(k, 1) = gy * qx;
+    steepest_descent(k, 2) = gx * qy;
+    steepest_descent(k, 3) = gy * qy;
+    steepest_descent(k, 4) = gx;
+    steepest_descent(k, 5) = gy;
+    if (num_parameters == 8) {
+      double projective = gx * qx + gy * qy;
+      steepest_descent(k, 6) = -projective * qx;
+      steepest_descent(k, 7) = -projective * qy;
+    }
+  }
+
+  Mat hessian = steepest_descent.transpose() * steepest_descent;
+  Eigen::SelfAdjointEigenSolver<Mat> eigen_solver(hessian);
+  const Vec &eigenvalues = eigen_solver.eigenvalues();
+  if (!(eigenvalues.minCoeff() > 1e-8 * eigenvalues.maxCoeff())) {
+    VLOG(1) << "Too little texture in the template, eigenvalues "
+            << eigenvalues.transpose();
+    return false;
+  }
+  level->descent = hessian.inverse() * steepest_descent.transpose();
+  return true;
+}
+
+bool TemplateTracker::SetTemplate(const FloatImage &image) {
+  ResetTemplate();
+  int width = x1_ < 0 ? image.Width() : x1_ - x0_ + 1;
+  int height = y1_ < 0 ? image.Height() : y1_ - y0_ + 1;
+  int num_levels = 1;
+  while (num_levels < num_levels_ &&
+         std::min(width, height) >> num_levels >= kMinLevelSize) {
+    ++num_levels;
+  }
+  LIBMV_SCOPED_TIMER("template_tracker.template");
+  scoped_ptr<ImagePyramid> pyramid(MakeImagePyramid(image, num_levels,
+                                                    sigma_));
+  levels_.resize(num_levels);
+  for (int i = 0; i < num_levels; ++i) {
+    if (!ComputeLevel(pyramid->Level(i), 1.0 / (1 << i), &levels_[i])) {
+      levels_.clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TemplateTracker::TrackTemplate(const FloatImage &image, Mat3 *H) {
+  if (!HasTemplate()) {
+    return false;
+  }
+  LIBMV_SCOPED_TIMER("template_tracker.track");
+  scoped_ptr<ImagePyramid> pyramid(MakeImagePyramid(image, levels_.size(),
+                                                    sigma_));
+  Mat3 G = *H;
+  Vec error;
+  for (int i = levels_.size() - 1; i >= 0; --i) {
+    const Level &level = levels_[i];
+    const FloatImage &level_image = pyramid->Level(i);
+    Mat3 S = LevelScale(1.0 / (1 << i));
+    // The warp from the coordinates of the samples to the pixels of the
+    // level.
+    Mat3 M = S * G * S.inverse() * level.to_pixels;
+    int num_samples = level.q.cols();
+    error.resize(num_samples);
+    // Stop when the samples move by less than a hundredth of a pixel.
+    double tolerance = 0.01 / level.to_pixels(0, 0);
+    for (int iteration = 0; iteration < max_iterations_; ++iteration) {
+      int num_outside = 0;
+      for (int k = 0; k < num_samples; ++k) {
+        Vec3 p = M * Vec3(level.q(0, k), level.q(1, k), 1);
+        if (p(2) <= 0) {
+          return false;
+        }
+        double x = p(0) / p(2), y = p(1) / p(2);
+        if (!(x >= kBorder && y >= kBorder &&
+              x <= level_image.Width() - 1 - kBorder &&
+              y <= level_image.Height() - 1 - kBorder)) {
+          error(k) = 0;
+          ++num_outside;
+          continue;
+        }
+        error(k) = SampleLinear(level_image, y, x, 0) - level.intensity(k);
+      }
+      if (2 * num_outside > num_samples) {
+        VLOG(1) << "The template left the image.";
+        return false;
+      }
+      Vec step = level.descent * error;
+      M = M * WarpOfParameters(step).inverse();
+      if (step.norm() < tolerance) {
+        break;
+      }
+    }
+    G = S.inverse() * M * level.to_pixels.inverse() * S;
+  }
+  rms_ = sqrt(error.squaredNorm() / error.rows());
+  if (!(rms_ <= max_rms_) || G(2, 2) == 0) {
+    VLOG(1) << "The template was lost, RMS " << rms_;
+    return false;
+  }
+  *H = G / G(2, 2);
+  return true;
+}
+
+bool TemplateTracker::StartTemplate(const Image &image,
+                                    Matches::TrackID first_track,
+                                    Matches::ImageID image_id,
+                                    FeaturesGraph *new_features_graph) {
+  FloatImage gray;
+  if (!GrayFloatImage(image, &gray) || !SetTemplate(gray)) {
+    return false;
+  }
+  scoped_ptr<FeatureSet> detected(new FeatureSet());
+  DetectAndDescribe(image, detected.get());
+  for (int i = 0; i < detected->features.size(); ++i) {
+    const KeypointFeature &feature = detected->features[i];
+    if (x1_ < 0 || (x0_ <= feature.x() && feature.x() <= x1_ &&
+                    y0_ <= feature.y() && feature.y() <= y1_)) {
+      template_features_.push_back(feature);
+      template_tracks_.push_back(first_track + template_tracks_.size());
+    }
+  }
+
+  FeatureSet *feature_set = new_features_graph->CreateNewFeatureSet();
+  feature_set->features = template_features_;
+  for (int i = 0; i < feature_set->features.size(); ++i) {
+    new_features_graph->matches_.Insert(image_id, template_tracks_[i],
+                                        &feature_set->features[i]);
+  }
+  return true;
+}
+
+bool TemplateTracker::TrackToImage(const Image &image,
+                                   Matches::ImageID image_id,
+                                   FeaturesGraph *new_features_graph) {
+  FloatImage gray;
+  Mat3 H = warp_;
+  if (!GrayFloatImage(image, &gray) || !TrackTemplate(gray, &H)) {
+    return false;
+  }
+  warp_ = H;
+
+  FeatureSet *feature_set = new_features_graph->CreateNewFeatureSet();
+  feature_set->features = template_features_;
+  for (int i = 0; i < feature_set->features.size(); ++i) {
+    KeypointFeature &feature = feature_set->features[i];
+    Vec3 p = H * Vec3(feature.x(), feature.y(), 1);
+    feature.coords << p(0) / p(2), p(1) / p(2);
+    new_features_graph->matches_.Insert(image_id, template_tracks_[i],
+                                        &feature);
+  }
+  return true;
+}
+
+bool TemplateTracker::Track(const Image &image1,
+                            const Image &image2,
+                            FeaturesGraph *new_features_graph,
+                            bool keep_single_feature) {
+  (void) keep_single_feature;
+  return StartTemplate(image1, 0, 0, new_features_graph) &&
+         TrackToImage(image2, 1, new_features_graph);
+}
+
+bool TemplateTracker::Track(const Image &image,
+                            const FeaturesGraph &known_features_graph,
+                            FeaturesGraph *new_features_graph,
+                            Matches::ImageID *image_id,
+                            bool keep_single_feature) {
+  (void) keep_single_feature;
+  *image_id = NextImageID(known_features_graph);
+  if (!HasTemplate()) {
+    Matches::TrackID first_track = 0;
+    if (known_features_graph.matches_.NumTracks() > 0) {
+      first_track = known_features_graph.matches_.GetMaxTrackID() + 1;
+    }
+    return StartTemplate(image, first_track, *image_id, new_features_graph);
+  }
+  return TrackToImage(image, *image_id, new_features_graph);
+}
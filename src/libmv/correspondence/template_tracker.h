@@ -0,0 +1,153 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_CORRESPONDENCE_TEMPLATE_TRACKER_H_
+#define LIBMV_CORRESPONDENCE_TEMPLATE_TRACKER_H_
+
+#include "libmv/base/vector.h"
+#include "libmv/correspondence/tracker.h"
+#include "libmv/image/image.h"
+#include "libmv/numeric/numeric.h"
+
+namespace libmv {
+namespace tracker {
+
+// Tracks a planar region by aligning its pixels directly, instead of matching
+// features detected in every frame as PlanarTracker does. The region of the
+// first frame is the template; in every next frame the warp of the template
+// (an affinity or a homography) is refined from the warp of the previous
+// frame by inverse compositional Gauss-Newton, coarse to fine over an image
+// pyramid. The inverse compositional form linearizes around the template, so
+// the Hessian and the steepest descent images are computed once per template
+// and an iteration is a warp of the samples and a matrix-vector product.
+//
+// Features are only detected and described in the template frame; they are
+// carried to the next frames through the warp, keeping their tracks. Track()
+// fails when the alignment does not converge, the region leaves the frame or
+// the residual is too large; ResetTemplate() then starts over on the next
+// frame. The template is not updated, so the appearance of the region is
+// expected to stay the same (screen inserts, planar set pieces).
+class TemplateTracker : public Tracker {
+ public:
+  enum WarpModel {
+    AFFINE,
+    HOMOGRAPHY
+  };
+
+  TemplateTracker(detector::Detector *detector,
+                  descriptor::Describer *describer,
+                  correspondence::ArrayMatcher<float> *matcher,
+                  WarpModel model = HOMOGRAPHY);
+  virtual ~TemplateTracker() {}
+
+  // Starts a template on image1, and tracks it in image2.
+  virtual bool Track(const Image &image1,
+                     const Image &image2,
+                     FeaturesGraph *new_features_graph,
+                     bool keep_single_feature = true);
+
+  // Starts a template on image if there is none, otherwise tracks it in
+  // image. Only the features of the template frame are tracked, so
+  // keep_single_feature has no effect.
+  virtual bool Track(const Image &image,
+                     const FeaturesGraph &known_features_graph,
+                     FeaturesGraph *new_features_graph,
+                     Matches::ImageID *image_id,
+                     bool keep_single_feature = true);
+
+  // The part of the next template frame that is tracked, in pixels, from
+  // (x0, y0) to (x1, y1) included. The whole frame by default.
+  void SetRegion(int x0, int y0, int x1, int y1);
+
+  // Forgets the template; the next Track() starts a new one.
+  void ResetTemplate();
+
+  bool HasTemplate() const { return levels_.size() > 0; }
+
+  // Makes the region of a single channel image the template, without
+  // features. Returns false if the region has too little texture.
+  bool SetTemplate(const FloatImage &image);
+
+  // Refines H, the homography from the pixels of the template frame to those
+  // of image, starting from the H passed in. Returns false if the alignment
+  // failed, in which case H is left unchanged.
+  bool TrackTemplate(const FloatImage &image, Mat3 *H);
+
+  // The warp from the template frame to the last tracked frame.
+  const Mat3 &warp() const { return warp_; }
+  // The RMS of the intensity differences of the last TrackTemplate().
+  double rms() const { return rms_; }
+
+  void set_num_levels(int num_levels) { num_levels_ = num_levels; }
+  void set_sigma(double sigma) { sigma_ = sigma; }
+  void set_max_iterations(int max_iterations) {
+    max_iterations_ = max_iterations;
+  }
+  // Largest RMS residual, in intensity units, of a successful track.
+  void set_max_rms(double max_rms) { max_rms_ = max_rms; }
+  // The template is subsampled on a grid to at most this many samples per
+  // pyramid level.
+  void set_max_samples(int max_samples) { max_samples_ = max_samples; }
+
+ private:
+  // The samples of the template on a pyramid level. The warp parameters act
+  // on the coordinates q of the samples, centered on the region and scaled to
+  // about [-1, 1] so that the normal equations are well conditioned; the
+  // pixel of q is to_pixels * q.
+  struct Level {
+    Mat3 to_pixels;
+    Mat2X q;
+    Vec intensity;
+    // The Gauss-Newton step is descent * (warped image - template).
+    Mat descent;
+  };
+
+  int NumParameters() const { return model_ == AFFINE ? 6 : 8; }
+  bool ComputeLevel(const FloatImage &level_image, double factor,
+                    Level *level) const;
+  bool StartTemplate(const Image &image,
+                     Matches::TrackID first_track,
+                     Matches::ImageID image_id,
+                     FeaturesGraph *new_features_graph);
+  bool TrackToImage(const Image &image,
+                    Matches::ImageID image_id,
+                    FeaturesGraph *new_features_graph);
+
+  WarpModel model_;
+  int num_levels_;
+  double sigma_;
+  int max_iterations_;
+  double max_rms_;
+  int max_samples_;
+  // The region, or x1_ < 0 for the whole frame.
+  int x0_, y0_, x1_, y1_;
+
+  vector<Level> levels_;
+  // The features of the template frame, and their tracks.
+  vector<KeypointFeature> template_features_;
+  vector<Matches::TrackID> template_tracks_;
+  Mat3 warp_;
+  double rms_;
+};
+
+}  // namespace tracker
+}  // namespace libmv
+
+#endif  // LIBMV_CORRESPONDENCE_TEMPLATE_TRACKER_H_
@@ -0,0 +1,176 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cmath>
+
+#include "libmv/correspondence/template_tracker.h"
+#include "libmv/image/image.h"
+#include "testing/testing.h"
+
+using namespace libmv;
+using namespace libmv::tracker;
+
+namespace {
+
+// A smooth texture, without repeating patterns at the scale of the region.
+float Texture(double x, double y) {
+  return 0.5 + 0.15 * sin(0.21 * x + 0.05 * y) +
+               0.15 * sin(0.07 * x - 0.19 * y + 1) +
+               0.1 * cos(0.013 * x * y / 7 + 0.3 * y);
+}
+
+Vec2 Apply(const Mat3 &H, double x, double y) {
+  Vec3 p = H * Vec3(x, y, 1);
+  return Vec2(p(0) / p(2), p(1) / p(2));
+}
+
+// The texture, as seen through H.
+void MakeImage(const Mat3 &H, FloatImage *image) {
+  Mat3 inverse = H.inverse();
+  image->Resize(120, 160, 1);
+  for (int y = 0; y < image->Height(); ++y) {
+    for (int x = 0; x < image->Width(); ++x) {
+      Vec2 t = Apply(inverse, x, y);
+      (*image)(y, x) = Texture(t(0), t(1));
+    }
+  }
+}
+
+double MaxCornerDistance(const Mat3 &A, const Mat3 &B) {
+  double corners[4][2] = { {30, 30}, {129, 30}, {30, 89}, {129, 89} };
+  double distance = 0;
+  for (int i = 0; i < 4; ++i) {
+    Vec2 a = Apply(A, corners[i][0], corners[i][1]);
+    Vec2 b = Apply(B, corners[i][0], corners[i][1]);
+    distance = std::max(distance, (a - b).norm());
+  }
+  return distance;
+}
+
+// Features at fixed positions of the template frame.
+class GridDetector : public detector::Detector {
+ public:
+  virtual ~GridDetector() {}
+  virtual void Detect(const Image &image,
+                      vector<Feature *> *features,
+                      detector::DetectorData **data) const {
+    (void) image;
+    (void) data;
+    features->push_back(new PointFeature(10, 10));
+    features->push_back(new PointFeature(50, 40));
+    features->push_back(new PointFeature(100, 70));
+  }
+};
+
+class EmptyDescriber : public descriptor::Describer {
+ public:
+  virtual ~EmptyDescriber() {}
+  virtual void Describe(const vector<Feature *> &features,
+                        const Image &image,
+                        const detector::DetectorData *detector_data,
+                        vector<descriptor::Descriptor *> *descriptors) const {
+    (void) image;
+    (void) detector_data;
+    for (size_t i = 0; i < features.size(); ++i) {
+      descriptors->push_back(new descriptor::VecfDescriptor(1));
+    }
+  }
+};
+
+TEST(TemplateTracker, RecoversHomography) {
+  FloatImage template_image, image;
+  MakeImage(Mat3::Identity(), &template_image);
+  Mat3 H;
+  H << 1.02,  -0.03,  4.5,
+       0.025,  0.99, -3.2,
+       1e-4,  -5e-5,  1;
+  MakeImage(H, &image);
+
+  TemplateTracker tracker(NULL, NULL, NULL);
+  tracker.SetRegion(30, 30, 129, 89);
+  ASSERT_TRUE(tracker.SetTemplate(template_image));
+  Mat3 estimated = Mat3::Identity();
+  ASSERT_TRUE(tracker.TrackTemplate(image, &estimated));
+  EXPECT_LT(MaxCornerDistance(H, estimated), 0.05);
+  EXPECT_LT(tracker.rms(), 0.01);
+}
+
+TEST(TemplateTracker, RecoversAffinity) {
+  FloatImage template_image, image;
+  MakeImage(Mat3::Identity(), &template_image);
+  Mat3 A;
+  A << 0.98, 0.04, -2.5,
+      -0.03, 1.01,  3.0,
+       0,    0,     1;
+  MakeImage(A, &image);
+
+  TemplateTracker tracker(NULL, NULL, NULL, TemplateTracker::AFFINE);
+  tracker.SetRegion(30, 30, 129, 89);
+  ASSERT_TRUE(tracker.SetTemplate(template_image));
+  Mat3 estimated = Mat3::Identity();
+  ASSERT_TRUE(tracker.TrackTemplate(image, &estimated));
+  EXPECT_LT(MaxCornerDistance(A, estimated), 0.05);
+  EXPECT_EQ(0, estimated(2, 0));
+  EXPECT_EQ(0, estimated(2, 1));
+}
+
+TEST(TemplateTracker, FlatTemplateIsRejected) {
+  FloatImage flat(120, 160);
+  flat.Fill(0.5);
+  TemplateTracker tracker(NULL, NULL, NULL);
+  EXPECT_FALSE(tracker.SetTemplate(flat));
+  EXPECT_FALSE(tracker.HasTemplate());
+}
+
+TEST(TemplateTracker, CarriesTemplateFeatures) {
+  Mat3 H1 = Mat3::Identity(), H2 = Mat3::Identity();
+  H1(0, 2) = 2;
+  H2(0, 2) = 4;
+  H2(1, 2) = 1.5;
+  FloatImage *frames[3] = { new FloatImage, new FloatImage, new FloatImage };
+  MakeImage(Mat3::Identity(), frames[0]);
+  MakeImage(H1, frames[1]);
+  MakeImage(H2, frames[2]);
+  Image images[3] = { Image(frames[0]), Image(frames[1]), Image(frames[2]) };
+
+  TemplateTracker tracker(new GridDetector, new EmptyDescriber, NULL);
+  FeaturesGraph graphs[3], empty;
+  Matches::ImageID image_id;
+  ASSERT_TRUE(tracker.Track(images[0], empty, &graphs[0], &image_id));
+  EXPECT_EQ(0, image_id);
+  EXPECT_EQ(3, graphs[0].matches_.NumTracks());
+  for (int i = 1; i < 3; ++i) {
+    ASSERT_TRUE(tracker.Track(images[i], graphs[i - 1], &graphs[i],
+                              &image_id));
+    EXPECT_EQ(i, image_id);
+    EXPECT_EQ(3, graphs[i].matches_.NumTracks());
+  }
+  const PointFeature *feature = static_cast<const PointFeature *>(
+      graphs[2].matches_.Get(2, 1));
+  ASSERT_TRUE(feature != NULL);
+  EXPECT_NEAR(54, feature->x(), 0.05);
+  EXPECT_NEAR(41.5, feature->y(), 0.05);
+
+  for (int i = 0; i < 3; ++i) {
+    graphs[i].DeleteAndClear();
+  }
+}
+
+}  // namespace
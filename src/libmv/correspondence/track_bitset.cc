@@ -0,0 +1,374 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+
+#include "libmv/correspondence/feature.h"
+#include "libmv/correspondence/hamming.h"
+#include "libmv/correspondence/track_bitset.h"
+#include "libmv/logging/logging.h"
+
+namespace libmv {
+namespace {
+
+bool MoreSharedTracks(const CovisibilityIndex::Neighbor &a,
+                      const CovisibilityIndex::Neighbor &b) {
+  return a.num_shared_tracks > b.num_shared_tracks ||
+         (a.num_shared_tracks == b.num_shared_tracks && a.image < b.image);
+}
+
+inline bool BitIsSet(const std::vector<unsigned int> &bits, int value) {
+  return (bits[value >> 5] >> (value & 31)) & 1;
+}
+
+}  // namespace
+
+void TrackBitset::Assign(const std::vector<int> &tracks) {
+  Clear();
+  for (size_t i = 0; i < tracks.size(); ++i) {
+    CHECK_GE(tracks[i], 0);
+    unsigned short key = tracks[i] >> 16;
+    if (containers_.empty() || containers_.back().key != key) {
+      DCHECK(containers_.empty() || containers_.back().key < key);
+      containers_.push_back(Container());
+      containers_.back().key = key;
+      containers_.back().cardinality = 0;
+    }
+    Container &container = containers_.back();
+    container.values.push_back(tracks[i] & 0xffff);
+    ++container.cardinality;
+  }
+  for (size_t i = 0; i < containers_.size(); ++i) {
+    if (containers_[i].cardinality > kMaxArraySize) {
+      ToBitmap(&containers_[i]);
+    }
+  }
+  cardinality_ = tracks.size();
+}
+
+void TrackBitset::Clear() {
+  containers_.clear();
+  cardinality_ = 0;
+}
+
+bool TrackBitset::Contains(int track) const {
+  if (track < 0) {
+    return false;
+  }
+  unsigned short key = track >> 16, value = track & 0xffff;
+  for (size_t i = 0; i < containers_.size(); ++i) {
+    if (containers_[i].key == key) {
+      const Container &container = containers_[i];
+      if (container.IsBitmap()) {
+        return BitIsSet(container.bits, value);
+      }
+      return std::binary_search(container.values.begin(),
+                                container.values.end(), value);
+    }
+  }
+  return false;
+}
+
+void TrackBitset::ToVector(std::vector<int> *tracks) const {
+  tracks->clear();
+  tracks->reserve(cardinality_);
+  for (size_t i = 0; i < containers_.size(); ++i) {
+    const Container &container = containers_[i];
+    int high = int(container.key) << 16;
+    if (container.IsBitmap()) {
+      for (int word = 0; word < kBitmapWords; ++word) {
+        unsigned int bits = container.bits[word];
+        for (int bit = 0; bits; ++bit, bits >>= 1) {
+          if (bits & 1) {
+            tracks->push_back(high | (word << 5) | bit);
+          }
+        }
+      }
+    } else {
+      for (size_t j = 0; j < container.values.size(); ++j) {
+        tracks->push_back(high | container.values[j]);
+      }
+    }
+  }
+}
+
+void TrackBitset::ToBitmap(Container *container) {
+  container->bits.assign(kBitmapWords, 0);
+  for (size_t i = 0; i < container->values.size(); ++i) {
+    int value = container->values[i];
+    container->bits[value >> 5] |= 1u << (value & 31);
+  }
+  std::vector<unsigned short>().swap(container->values);
+}
+
+int TrackBitset::IntersectionCount(const Container &a, const Container &b) {
+  if (a.IsBitmap() && b.IsBitmap()) {
+    int count = 0;
+    for (int i = 0; i < kBitmapWords; ++i) {
+      count += Popcount(a.bits[i] & b.bits[i]);
+    }
+    return count;
+  }
+  if (a.IsBitmap() || b.IsBitmap()) {
+    const Container &array = a.IsBitmap() ? b : a;
+    const Container &bitmap = a.IsBitmap() ? a : b;
+    int count = 0;
+    for (size_t i = 0; i < array.values.size(); ++i) {
+      count += BitIsSet(bitmap.bits, array.values[i]);
+    }
+    return count;
+  }
+  int count = 0;
+  size_t i = 0, j = 0;
+  while (i < a.values.size() && j < b.values.size()) {
+    if (a.values[i] < b.values[j]) {
+      ++i;
+    } else if (b.values[j] < a.values[i]) {
+      ++j;
+    } else {
+      ++count;
+      ++i;
+      ++j;
+    }
+  }
+  return count;
+}
+
+void TrackBitset::Intersect(const Container &a, const Container &b,
+                            Container *result) {
+  result->key = a.key;
+  std::vector<unsigned short> values;
+  std::vector<unsigned int> bits;
+  if (a.IsBitmap() && b.IsBitmap()) {
+    bits.resize(kBitmapWords);
+    int count = 0;
+    for (int i = 0; i < kBitmapWords; ++i) {
+      bits[i] = a.bits[i] & b.bits[i];
+      count += Popcount(bits[i]);
+    }
+    result->cardinality = count;
+    if (count > kMaxArraySize) {
+      result->bits.swap(bits);
+      std::vector<unsigned short>().swap(result->values);
+      return;
+    }
+    // Few enough for an array.
+    for (int i = 0; i < kBitmapWords; ++i) {
+      for (int bit = 0; bit < 32; ++bit) {
+        if ((bits[i] >> bit) & 1) {
+          values.push_back((i << 5) | bit);
+        }
+      }
+    }
+  } else if (a.IsBitmap() || b.IsBitmap()) {
+    const Container &array = a.IsBitmap() ? b : a;
+    const Container &bitmap = a.IsBitmap() ? a : b;
+    for (size_t i = 0; i < array.values.size(); ++i) {
+      if (BitIsSet(bitmap.bits, array.values[i])) {
+        values.push_back(array.values[i]);
+      }
+    }
+  } else {
+    values.resize(std::min(a.values.size(), b.values.size()));
+    values.resize(std::set_intersection(a.values.begin(), a.values.end(),
+                                        b.values.begin(), b.values.end(),
+                                        values.begin()) - values.begin());
+  }
+  result->cardinality = values.size();
+  result->values.swap(values);
+  std::vector<unsigned int>().swap(result->bits);
+}
+
+int TrackBitset::IntersectionCount(const TrackBitset &a,
+                                   const TrackBitset &b) {
+  int count = 0;
+  size_t i = 0, j = 0;
+  while (i < a.containers_.size() && j < b.containers_.size()) {
+    if (a.containers_[i].key < b.containers_[j].key) {
+      ++i;
+    } else if (b.containers_[j].key < a.containers_[i].key) {
+      ++j;
+    } else {
+      count += IntersectionCount(a.containers_[i], b.containers_[j]);
+      ++i;
+      ++j;
+    }
+  }
+  return count;
+}
+
+void TrackBitset::Intersect(const TrackBitset &a, const TrackBitset &b,
+                            TrackBitset *result) {
+  std::vector<Container> containers;
+  int cardinality = 0;
+  size_t i = 0, j = 0;
+  while (i < a.containers_.size() && j < b.containers_.size()) {
+    if (a.containers_[i].key < b.containers_[j].key) {
+      ++i;
+    } else if (b.containers_[j].key < a.containers_[i].key) {
+      ++j;
+    } else {
+      Container container;
+      Intersect(a.containers_[i], b.containers_[j], &container);
+      if (container.cardinality > 0) {
+        cardinality += container.cardinality;
+        containers.push_back(Container());
+        containers.back().key = container.key;
+        containers.back().cardinality = container.cardinality;
+        containers.back().values.swap(container.values);
+        containers.back().bits.swap(container.bits);
+      }
+      ++i;
+      ++j;
+    }
+  }
+  result->containers_.swap(containers);
+  result->cardinality_ = cardinality;
+}
+
+void CovisibilityIndex::Build(const Matches &matches) {
+  // The matches are iterated in (image, track) order.
+  std::map<ImageID, std::vector<TrackID> > image_tracks;
+  for (Matches::Points r = matches.All<PointFeature>(); r; ++r) {
+    image_tracks[r.image()].push_back(r.track());
+  }
+  Build(image_tracks);
+}
+
+void CovisibilityIndex::Build(const TrackStore &store) {
+  std::map<ImageID, std::vector<TrackID> > image_tracks;
+  for (int i = 0; i < store.NumImages(); ++i) {
+    TrackStore::Range observations = store.InImage(store.Images()[i]);
+    std::vector<TrackID> &tracks = image_tracks[store.Images()[i]];
+    for (int j = 0; j < observations.size(); ++j) {
+      if (observations[j].point) {
+        tracks.push_back(observations[j].track);
+      }
+    }
+  }
+  Build(image_tracks);
+}
+
+void CovisibilityIndex::Build(
+    const std::map<ImageID, std::vector<TrackID> > &image_tracks) {
+  images_.clear();
+  tracks_.clear();
+  neighbors_.clear();
+  std::map<TrackID, std::vector<int> > track_images;
+  for (std::map<ImageID, std::vector<TrackID> >::const_iterator it =
+       image_tracks.begin(); it != image_tracks.end(); ++it) {
+    if (it->second.empty()) {
+      continue;
+    }
+    int index = images_.size();
+    images_.push_back(it->first);
+    tracks_.push_back(TrackBitset(it->second));
+    for (size_t i = 0; i < it->second.size(); ++i) {
+      track_images[it->second[i]].push_back(index);
+    }
+  }
+
+  // Count the images of the tracks of every image in a dense array, which
+  // only the counted images are reset in.
+  neighbors_.resize(images_.size());
+  std::vector<int> counts(images_.size(), 0);
+  std::vector<int> counted;
+  for (int i = 0; i < images_.size(); ++i) {
+    const std::vector<TrackID> &tracks = image_tracks.find(images_[i])->second;
+    for (size_t t = 0; t < tracks.size(); ++t) {
+      const std::vector<int> &images = track_images[tracks[t]];
+      for (size_t j = 0; j < images.size(); ++j) {
+        if (images[j] != i && counts[images[j]]++ == 0) {
+          counted.push_back(images[j]);
+        }
+      }
+    }
+    std::vector<Neighbor> &neighbors = neighbors_[i];
+    neighbors.resize(counted.size());
+    for (size_t j = 0; j < counted.size(); ++j) {
+      neighbors[j].image = images_[counted[j]];
+      neighbors[j].num_shared_tracks = counts[counted[j]];
+      counts[counted[j]] = 0;
+    }
+    counted.clear();
+    std::sort(neighbors.begin(), neighbors.end(), MoreSharedTracks);
+  }
+}
+
+int CovisibilityIndex::Index(ImageID image) const {
+  std::vector<ImageID>::const_iterator it =
+      std::lower_bound(images_.begin(), images_.end(), image);
+  if (it == images_.end() || *it != image) {
+    return -1;
+  }
+  return it - images_.begin();
+}
+
+const TrackBitset *CovisibilityIndex::Tracks(ImageID image) const {
+  int index = Index(image);
+  return index < 0 ? NULL : &tracks_[index];
+}
+
+int CovisibilityIndex::NumSharedTracks(ImageID image_a,
+                                       ImageID image_b) const {
+  const TrackBitset *a = Tracks(image_a), *b = Tracks(image_b);
+  if (!a || !b) {
+    return 0;
+  }
+  return TrackBitset::IntersectionCount(*a, *b);
+}
+
+void CovisibilityIndex::TracksInAllImages(const vector<ImageID> &images,
+                                          vector<TrackID> *tracks) const {
+  if (!images.size()) {
+    return;
+  }
+  // Start from the smallest set, which bounds the intersections.
+  std::vector<const TrackBitset *> sets;
+  for (int i = 0; i < images.size(); ++i) {
+    const TrackBitset *set = Tracks(images[i]);
+    if (!set) {
+      return;
+    }
+    sets.push_back(set);
+  }
+  for (size_t i = 1; i < sets.size(); ++i) {
+    if (sets[i]->Cardinality() < sets[0]->Cardinality()) {
+      std::swap(sets[0], sets[i]);
+    }
+  }
+  TrackBitset intersection = *sets[0];
+  for (size_t i = 1; i < sets.size() && intersection.Cardinality() > 0; ++i) {
+    TrackBitset::Intersect(intersection, *sets[i], &intersection);
+  }
+  std::vector<int> ids;
+  intersection.ToVector(&ids);
+  for (size_t i = 0; i < ids.size(); ++i) {
+    tracks->push_back(ids[i]);
+  }
+}
+
+const std::vector<CovisibilityIndex::Neighbor> &CovisibilityIndex::Neighbors(
+    ImageID image) const {
+  int index = Index(image);
+  return index < 0 ? no_neighbors_ : neighbors_[index];
+}
+
+}  // namespace libmv
@@ -0,0 +1,137 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_CORRESPONDENCE_TRACK_BITSET_H_
+#define LIBMV_CORRESPONDENCE_TRACK_BITSET_H_
+
+#include <map>
+#include <vector>
+
+#include "libmv/correspondence/matches.h"
+#include "libmv/correspondence/track_store.h"
+
+namespace libmv {
+
+// A compressed set of track ids, for the queries that intersect the tracks
+// of several images. As in a roaring bitmap, the ids are split by their high
+// 16 bits into containers, each holding the low 16 bits of its ids either as
+// a sorted array, while it has at most kMaxArraySize ids, or as a bitmap of
+// 2^16 bits. Intersections go container by container: merging two arrays,
+// probing a bitmap with an array, or ANDing two bitmaps a word at a time.
+// The ids must not be negative.
+class TrackBitset {
+ public:
+  static const int kMaxArraySize = 4096;
+
+  TrackBitset() : cardinality_(0) {}
+  // tracks must be sorted and without duplicates.
+  explicit TrackBitset(const std::vector<int> &tracks) { Assign(tracks); }
+
+  void Assign(const std::vector<int> &tracks);
+  void Clear();
+
+  int Cardinality() const { return cardinality_; }
+  bool Contains(int track) const;
+  // The tracks of the set, sorted.
+  void ToVector(std::vector<int> *tracks) const;
+
+  // The number of tracks of both a and b, without building the intersection.
+  static int IntersectionCount(const TrackBitset &a, const TrackBitset &b);
+  // result may be a or b.
+  static void Intersect(const TrackBitset &a, const TrackBitset &b,
+                        TrackBitset *result);
+
+ private:
+  static const int kBitmapWords = 65536 / 32;
+
+  struct Container {
+    unsigned short key;
+    int cardinality;
+    // The sorted low bits of an array container, empty for a bitmap.
+    std::vector<unsigned short> values;
+    // The kBitmapWords words of a bitmap container, empty for an array.
+    std::vector<unsigned int> bits;
+
+    bool IsBitmap() const { return !bits.empty(); }
+  };
+
+  static int IntersectionCount(const Container &a, const Container &b);
+  static void Intersect(const Container &a, const Container &b,
+                        Container *result);
+  // Turns an array of more than kMaxArraySize values into a bitmap.
+  static void ToBitmap(Container *container);
+
+  std::vector<Container> containers_;
+  int cardinality_;
+};
+
+// The tracks of every image as TrackBitsets, and the co-visibility graph of
+// the images: two images are neighbors if they share tracks. The graph is
+// built once, by counting the images of the tracks of every image, so that
+// keyframe selection and local bundle adjustment only look it up. Unlike the
+// ViewGraph of the reconstruction, no model is fitted to the pairs.
+class CovisibilityIndex {
+ public:
+  typedef Matches::ImageID ImageID;
+  typedef Matches::TrackID TrackID;
+
+  struct Neighbor {
+    ImageID image;
+    int num_shared_tracks;
+  };
+
+  CovisibilityIndex() {}
+
+  // Replaces the index by the one of the point tracks of matches or store.
+  void Build(const Matches &matches);
+  void Build(const TrackStore &store);
+
+  int NumImages() const { return images_.size(); }
+  // The images of the index, sorted.
+  const std::vector<ImageID> &Images() const { return images_; }
+  // The tracks of image, NULL if it has none.
+  const TrackBitset *Tracks(ImageID image) const;
+
+  // The number of tracks seen in both images.
+  int NumSharedTracks(ImageID image_a, ImageID image_b) const;
+  // The tracks seen in all the images, sorted, as ::TracksInAllImages().
+  void TracksInAllImages(const vector<ImageID> &images,
+                         vector<TrackID> *tracks) const;
+
+  // The images that share tracks with image, by decreasing number of shared
+  // tracks then increasing id.
+  const std::vector<Neighbor> &Neighbors(ImageID image) const;
+
+ private:
+  // Builds the index from the sorted tracks of every image.
+  void Build(const std::map<ImageID, std::vector<TrackID> > &image_tracks);
+  // The index of image in images_, -1 if it is not there.
+  int Index(ImageID image) const;
+
+  std::vector<ImageID> images_;
+  std::vector<TrackBitset> tracks_;
+  std::vector<std::vector<Neighbor> > neighbors_;
+  // The neighbors of the images outside of the index.
+  std::vector<Neighbor> no_neighbors_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_CORRESPONDENCE_TRACK_BITSET_H_
@@ -0,0 +1,139 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "libmv/correspondence/feature.h"
+#include "libmv/correspondence/feature_matching.h"
+#include "libmv/correspondence/track_bitset.h"
+#include "testing/testing.h"
+
+namespace {
+
+using namespace libmv;
+
+// Sorted distinct random tracks below max_track.
+void RandomTracks(int n, int max_track, std::vector<int> *tracks) {
+  tracks->clear();
+  for (int i = 0; i < n; ++i) {
+    tracks->push_back(rand() % max_track);
+  }
+  std::sort(tracks->begin(), tracks->end());
+  tracks->erase(std::unique(tracks->begin(), tracks->end()), tracks->end());
+}
+
+TEST(TrackBitset, ArraysAndBitmapsIntersectLikeSortedVectors) {
+  srand(3);
+  std::vector<int> dense, sparse, expected, result;
+  // Dense in the first containers, so they become bitmaps.
+  RandomTracks(30000, 100000, &dense);
+  RandomTracks(3000, 300000, &sparse);
+  TrackBitset dense_set(dense), sparse_set(sparse);
+  EXPECT_EQ(dense.size(), dense_set.Cardinality());
+  dense_set.ToVector(&result);
+  EXPECT_TRUE(dense == result);
+
+  std::set_intersection(dense.begin(), dense.end(),
+                        sparse.begin(), sparse.end(),
+                        std::back_inserter(expected));
+  EXPECT_EQ(expected.size(),
+            TrackBitset::IntersectionCount(dense_set, sparse_set));
+  TrackBitset intersection;
+  TrackBitset::Intersect(dense_set, sparse_set, &intersection);
+  intersection.ToVector(&result);
+  EXPECT_TRUE(expected == result);
+
+  // Two bitmaps, intersected in place.
+  std::vector<int> other;
+  RandomTracks(30000, 100000, &other);
+  TrackBitset other_set(other);
+  expected.clear();
+  std::set_intersection(dense.begin(), dense.end(),
+                        other.begin(), other.end(),
+                        std::back_inserter(expected));
+  EXPECT_EQ(expected.size(),
+            TrackBitset::IntersectionCount(dense_set, other_set));
+  TrackBitset::Intersect(dense_set, other_set, &dense_set);
+  dense_set.ToVector(&result);
+  EXPECT_TRUE(expected == result);
+
+  EXPECT_TRUE(sparse_set.Contains(sparse[10]));
+  EXPECT_FALSE(sparse_set.Contains(-1));
+  EXPECT_FALSE(sparse_set.Contains(400000));
+}
+
+class CovisibilityIndexTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    // Image 1 sees tracks 1 to 3, image 4 tracks 1 to 3 and 6, image 7
+    // tracks 2, 3, 5 and 6.
+    const int observations[][2] = { {1, 1}, {1, 2}, {1, 3},
+                                    {4, 1}, {4, 2}, {4, 3}, {4, 6},
+                                    {7, 2}, {7, 3}, {7, 5}, {7, 6} };
+    features.features.resize(11);
+    for (int i = 0; i < 11; ++i) {
+      matches.Insert(observations[i][0], observations[i][1],
+                     &features.features[i]);
+    }
+  }
+
+  FeatureSet features;
+  Matches matches;
+};
+
+TEST_F(CovisibilityIndexTest, TracksInAllImagesAsMatches) {
+  CovisibilityIndex index;
+  index.Build(matches);
+  EXPECT_EQ(3, index.NumImages());
+
+  vector<Matches::ImageID> images;
+  images.push_back(1);
+  images.push_back(4);
+  images.push_back(7);
+  vector<Matches::TrackID> tracks, expected;
+  index.TracksInAllImages(images, &tracks);
+  TracksInAllImages(matches, images, &expected);
+  ASSERT_EQ(2, tracks.size());
+  EXPECT_EQ(expected[0], tracks[0]);
+  EXPECT_EQ(expected[1], tracks[1]);
+
+  EXPECT_EQ(3, index.NumSharedTracks(1, 4));
+  EXPECT_EQ(3, index.NumSharedTracks(7, 4));
+  EXPECT_EQ(0, index.NumSharedTracks(1, 2));
+}
+
+TEST_F(CovisibilityIndexTest, NeighborsByDecreasingSharedTracks) {
+  CovisibilityIndex index;
+  index.Build(TrackStore(matches));
+  const std::vector<CovisibilityIndex::Neighbor> &neighbors =
+      index.Neighbors(4);
+  ASSERT_EQ(2, neighbors.size());
+  EXPECT_EQ(1, neighbors[0].image);
+  EXPECT_EQ(3, neighbors[0].num_shared_tracks);
+  EXPECT_EQ(7, neighbors[1].image);
+  EXPECT_EQ(3, neighbors[1].num_shared_tracks);
+  ASSERT_EQ(2, index.Neighbors(1).size());
+  EXPECT_EQ(4, index.Neighbors(1)[0].image);
+  EXPECT_EQ(2, index.Neighbors(1)[1].num_shared_tracks);
+  EXPECT_EQ(0, index.Neighbors(5).size());
+}
+
+}  // namespace
@@ -0,0 +1,222 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+
+#include "libmv/correspondence/feature.h"
+#include "libmv/correspondence/track_builder.h"
+#include "libmv/logging/logging.h"
+
+namespace libmv {
+namespace {
+
+// Sets *value to new_value if it is still old_value.
+inline bool CompareAndSwap(int *value, int old_value, int new_value) {
+#if defined(__GNUC__)
+  return __sync_bool_compare_and_swap(value, old_value, new_value);
+#else
+  if (*value != old_value) {
+    return false;
+  }
+  *value = new_value;
+  return true;
+#endif
+}
+
+}  // namespace
+
+struct TrackBuilder::MatchAdder {
+  void operator()(int i) const {
+    const FeatureMatch &match = matches[i];
+    builder->AddMatch(match.image_a, match.feature_a,
+                      match.image_b, match.feature_b);
+  }
+  TrackBuilder *builder;
+  const FeatureMatch *matches;
+};
+
+struct TrackBuilder::RootFinder {
+  void operator()(int id) const {
+    (*roots)[id] = builder->Find(id);
+  }
+  TrackBuilder *builder;
+  std::vector<int> *roots;
+};
+
+TrackBuilder::TrackBuilder(const std::vector<int> &num_features) {
+  image_offsets_.push_back(0);
+  for (size_t i = 0; i < num_features.size(); ++i) {
+    image_offsets_.push_back(image_offsets_.back() + num_features[i]);
+    images_.insert(images_.end(), num_features[i], int(i));
+  }
+  parents_.resize(image_offsets_.back());
+  for (int i = 0; i < parents_.size(); ++i) {
+    parents_[i] = i;
+  }
+}
+
+int TrackBuilder::Find(int id) {
+  // Read through volatile, since other threads may link the parents.
+  volatile int *parents = &parents_[0];
+  for (;;) {
+    int parent = parents[id];
+    if (parent == id) {
+      return id;
+    }
+    // Path halving: an ancestor stays an ancestor whatever the other threads
+    // link meanwhile, so a failed swap is harmless.
+    int grandparent = parents[parent];
+    if (grandparent != parent) {
+      CompareAndSwap(&parents_[id], parent, grandparent);
+    }
+    id = grandparent;
+  }
+}
+
+void TrackBuilder::AddMatch(int image_a, int feature_a,
+                            int image_b, int feature_b) {
+  DCHECK_LT(feature_a, image_offsets_[image_a + 1] - image_offsets_[image_a]);
+  DCHECK_LT(feature_b, image_offsets_[image_b + 1] - image_offsets_[image_b]);
+#if !defined(__GNUC__)
+  MutexLock lock(&mutex_);
+#endif
+  int a = Id(image_a, feature_a);
+  int b = Id(image_b, feature_b);
+  for (;;) {
+    a = Find(a);
+    b = Find(b);
+    if (a == b) {
+      return;
+    }
+    if (a < b) {
+      std::swap(a, b);
+    }
+    // Fails if another thread linked a meanwhile: find the roots again.
+    if (CompareAndSwap(&parents_[a], a, b)) {
+      return;
+    }
+  }
+}
+
+void TrackBuilder::AddMatches(const FeatureMatch *matches, int num_matches,
+                              int num_threads) {
+  MatchAdder adder;
+  adder.builder = this;
+  adder.matches = matches;
+  ParallelFor(0, num_matches, num_threads, &adder);
+}
+
+int TrackBuilder::Build(int num_threads, FeatureTracks *tracks) {
+  const int num_features = NumFeatures();
+  std::vector<int> roots(num_features);
+#if !defined(__GNUC__)
+  // The path halving of Find() needs compare and swap to run concurrently.
+  num_threads = 1;
+#endif
+  RootFinder finder;
+  finder.builder = this;
+  finder.roots = &roots;
+  ParallelFor(0, num_features, num_threads, &finder);
+
+  // The root of a set is its smallest id, so numbering the sets by root
+  // orders them by their first feature.
+  std::vector<int> sizes(num_features, 0);
+  for (int i = 0; i < num_features; ++i) {
+    ++sizes[roots[i]];
+  }
+  // The offset of the features of every set of at least two features, by
+  // root, -1 for the others.
+  std::vector<int> offsets(num_features, -1);
+  int num_tracked = 0;
+  for (int i = 0; i < num_features; ++i) {
+    if (sizes[i] > 1) {
+      offsets[i] = num_tracked;
+      num_tracked += sizes[i];
+    }
+  }
+  // Filled in increasing ids, hence sorted by image within a set.
+  std::vector<TrackFeature> features(num_tracked);
+  std::vector<int> ends(offsets);
+  for (int i = 0; i < num_features; ++i) {
+    int &end = ends[roots[i]];
+    if (end >= 0) {
+      features[end].image = images_[i];
+      features[end].feature = i - image_offsets_[images_[i]];
+      ++end;
+    }
+  }
+
+  tracks->offsets.assign(1, 0);
+  tracks->features.clear();
+  tracks->features.reserve(num_tracked);
+  int num_dropped = 0;
+  for (int i = 0; i < num_features; ++i) {
+    if (offsets[i] < 0) {
+      continue;
+    }
+    const TrackFeature *begin = &features[0] + offsets[i];
+    const TrackFeature *end = &features[0] + ends[i];
+    bool consistent = true;
+    for (const TrackFeature *f = begin + 1; f < end; ++f) {
+      if (f->image == (f - 1)->image) {
+        consistent = false;
+        break;
+      }
+    }
+    if (!consistent) {
+      ++num_dropped;
+      continue;
+    }
+    tracks->features.insert(tracks->features.end(), begin, end);
+    tracks->offsets.push_back(tracks->features.size());
+  }
+  return num_dropped;
+}
+
+void InsertTracks(const FeatureTracks &tracks,
+                  const std::vector<const FeatureSet *> &features,
+                  Matches *matches) {
+  for (int t = 0; t < tracks.NumTracks(); ++t) {
+    for (int i = tracks.offsets[t]; i < tracks.offsets[t + 1]; ++i) {
+      const TrackFeature &f = tracks.features[i];
+      matches->Insert(f.image, t,
+                      &features[f.image]->features[f.feature]);
+    }
+  }
+}
+
+void BuildTrackStore(const FeatureTracks &tracks,
+                     const std::vector<const FeatureSet *> &features,
+                     TrackStore *store) {
+  std::vector<TrackStore::Observation> observations(tracks.features.size());
+  for (int t = 0; t < tracks.NumTracks(); ++t) {
+    for (int i = tracks.offsets[t]; i < tracks.offsets[t + 1]; ++i) {
+      const TrackFeature &f = tracks.features[i];
+      const KeypointFeature *feature = &features[f.image]->features[f.feature];
+      observations[i].image = f.image;
+      observations[i].track = t;
+      observations[i].feature = feature;
+      observations[i].point = feature;
+    }
+  }
+  store->Build(observations);
+}
+
+}  // namespace libmv
@@ -0,0 +1,113 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_CORRESPONDENCE_TRACK_BUILDER_H_
+#define LIBMV_CORRESPONDENCE_TRACK_BUILDER_H_
+
+#include <vector>
+
+#include "libmv/base/thread.h"
+#include "libmv/correspondence/feature_matching.h"
+#include "libmv/correspondence/matches.h"
+#include "libmv/correspondence/track_store.h"
+
+namespace libmv {
+
+// A feature of a track: the index of the feature in the features of image.
+struct TrackFeature {
+  int image;
+  int feature;
+};
+
+// Tracks stored flat: the features of track t are features[offsets[t]] to
+// features[offsets[t + 1] - 1], sorted by image.
+struct FeatureTracks {
+  FeatureTracks() : offsets(1, 0) {}
+
+  int NumTracks() const { return offsets.size() - 1; }
+
+  std::vector<int> offsets;
+  std::vector<TrackFeature> features;
+};
+
+// A match between feature_a of image_a and feature_b of image_b.
+struct FeatureMatch {
+  int image_a, feature_a;
+  int image_b, feature_b;
+};
+
+// Builds tracks from pairwise feature matches with a union-find over flat
+// feature ids, the features of every image being numbered after those of the
+// previous images. The matches can be added from several threads at once:
+// the parents are linked with compare and swap, always from the larger root
+// to the smaller, so the tracks do not depend on the order of the matches.
+// Compared to merging the pairwise Matches with Matches::Merge(), there is no
+// map and no per match allocation, so millions of matches take seconds.
+class TrackBuilder {
+ public:
+  // num_features[i] is the number of features of image i.
+  explicit TrackBuilder(const std::vector<int> &num_features);
+
+  int NumImages() const { return image_offsets_.size() - 1; }
+  int NumFeatures() const { return parents_.size(); }
+
+  // Safe to call from several threads at once.
+  void AddMatch(int image_a, int feature_a, int image_b, int feature_b);
+  // Adds the matches on num_threads threads of the global pool.
+  void AddMatches(const FeatureMatch *matches, int num_matches,
+                  int num_threads);
+
+  // Fills tracks with the sets of matched features, ordered by their first
+  // feature. The sets that hold two features of the same image are
+  // inconsistent and dropped. Returns the number of sets dropped.
+  int Build(int num_threads, FeatureTracks *tracks);
+
+ private:
+  struct MatchAdder;
+  struct RootFinder;
+
+  int Id(int image, int feature) const {
+    return image_offsets_[image] + feature;
+  }
+  int Find(int id);
+
+  std::vector<int> image_offsets_;
+  std::vector<int> images_;
+  std::vector<int> parents_;
+#if !defined(__GNUC__)
+  // Without compare and swap the links are made one at a time.
+  Mutex mutex_;
+#endif
+};
+
+// Inserts the tracks in matches, track t being the features of tracks.
+// features[i] holds the features of image i, and must outlive matches.
+void InsertTracks(const FeatureTracks &tracks,
+                  const std::vector<const FeatureSet *> &features,
+                  Matches *matches);
+
+// Same, into a TrackStore, without building a Matches.
+void BuildTrackStore(const FeatureTracks &tracks,
+                     const std::vector<const FeatureSet *> &features,
+                     TrackStore *store);
+
+}  // namespace libmv
+
+#endif  // LIBMV_CORRESPONDENCE_TRACK_BUILDER_H_
@@ -0,0 +1,143 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstdlib>
+
+#include "libmv/correspondence/feature.h"
+#include "libmv/correspondence/track_builder.h"
+#include "testing/testing.h"
+
+namespace {
+
+using namespace libmv;
+
+FeatureMatch Match(int image_a, int feature_a, int image_b, int feature_b) {
+  FeatureMatch match;
+  match.image_a = image_a;
+  match.feature_a = feature_a;
+  match.image_b = image_b;
+  match.feature_b = feature_b;
+  return match;
+}
+
+TEST(TrackBuilder, ChainsOfMatchesAreTracks) {
+  std::vector<int> num_features(3, 4);
+  TrackBuilder builder(num_features);
+  EXPECT_EQ(3, builder.NumImages());
+  EXPECT_EQ(12, builder.NumFeatures());
+  builder.AddMatch(2, 1, 1, 3);
+  builder.AddMatch(0, 2, 1, 3);
+  builder.AddMatch(0, 0, 2, 0);
+
+  FeatureTracks tracks;
+  EXPECT_EQ(0, builder.Build(1, &tracks));
+  ASSERT_EQ(2, tracks.NumTracks());
+  // Ordered by first feature, and by image within a track.
+  ASSERT_EQ(2, tracks.offsets[1]);
+  EXPECT_EQ(0, tracks.features[0].image);
+  EXPECT_EQ(0, tracks.features[0].feature);
+  EXPECT_EQ(2, tracks.features[1].image);
+  EXPECT_EQ(0, tracks.features[1].feature);
+  ASSERT_EQ(5, tracks.offsets[2]);
+  EXPECT_EQ(0, tracks.features[2].image);
+  EXPECT_EQ(2, tracks.features[2].feature);
+  EXPECT_EQ(1, tracks.features[3].image);
+  EXPECT_EQ(3, tracks.features[3].feature);
+  EXPECT_EQ(2, tracks.features[4].image);
+  EXPECT_EQ(1, tracks.features[4].feature);
+}
+
+TEST(TrackBuilder, TracksThroughAnImageTwiceAreDropped) {
+  std::vector<int> num_features(3, 2);
+  TrackBuilder builder(num_features);
+  builder.AddMatch(0, 0, 1, 0);
+  builder.AddMatch(1, 0, 2, 0);
+  builder.AddMatch(2, 0, 0, 1);
+  builder.AddMatch(1, 1, 2, 1);
+
+  FeatureTracks tracks;
+  EXPECT_EQ(1, builder.Build(1, &tracks));
+  ASSERT_EQ(1, tracks.NumTracks());
+  EXPECT_EQ(1, tracks.features[0].image);
+  EXPECT_EQ(1, tracks.features[0].feature);
+}
+
+TEST(TrackBuilder, ParallelMatchesGiveTheSameTracks) {
+  const int kNumImages = 20, kNumFeatures = 500, kNumMatches = 20000;
+  std::vector<int> num_features(kNumImages, kNumFeatures);
+  std::vector<FeatureMatch> matches;
+  srand(5);
+  for (int i = 0; i < kNumMatches; ++i) {
+    matches.push_back(Match(rand() % kNumImages, rand() % kNumFeatures,
+                            rand() % kNumImages, rand() % kNumFeatures));
+  }
+  TrackBuilder sequential(num_features), parallel(num_features);
+  for (int i = 0; i < kNumMatches; ++i) {
+    sequential.AddMatch(matches[i].image_a, matches[i].feature_a,
+                        matches[i].image_b, matches[i].feature_b);
+  }
+  parallel.AddMatches(&matches[0], kNumMatches, 8);
+
+  FeatureTracks sequential_tracks, parallel_tracks;
+  EXPECT_EQ(sequential.Build(1, &sequential_tracks),
+            parallel.Build(8, &parallel_tracks));
+  EXPECT_TRUE(sequential_tracks.offsets == parallel_tracks.offsets);
+  ASSERT_EQ(sequential_tracks.features.size(),
+            parallel_tracks.features.size());
+  for (size_t i = 0; i < sequential_tracks.features.size(); ++i) {
+    EXPECT_EQ(sequential_tracks.features[i].image,
+              parallel_tracks.features[i].image);
+    EXPECT_EQ(sequential_tracks.features[i].feature,
+              parallel_tracks.features[i].feature);
+  }
+}
+
+TEST(TrackBuilder, TracksToMatchesAndTrackStore) {
+  FeatureSet features[2];
+  features[0].features.resize(2);
+  features[1].features.resize(1);
+  features[0].features[1].coords << 1, 2;
+  features[1].features[0].coords << 3, 4;
+  std::vector<const FeatureSet *> feature_sets;
+  feature_sets.push_back(&features[0]);
+  feature_sets.push_back(&features[1]);
+
+  std::vector<int> num_features;
+  num_features.push_back(2);
+  num_features.push_back(1);
+  TrackBuilder builder(num_features);
+  builder.AddMatch(1, 0, 0, 1);
+  FeatureTracks tracks;
+  builder.Build(1, &tracks);
+
+  Matches matches;
+  InsertTracks(tracks, feature_sets, &matches);
+  EXPECT_EQ(1, matches.NumTracks());
+  EXPECT_EQ(&features[0].features[1], matches.Get(0, 0));
+  EXPECT_EQ(&features[1].features[0], matches.Get(1, 0));
+
+  TrackStore store;
+  BuildTrackStore(tracks, feature_sets, &store);
+  EXPECT_EQ(2, store.NumObservations());
+  EXPECT_EQ(&features[1].features[0], store.Get(1, 0));
+  EXPECT_EQ(3, store.InTrack(0)[1].point->x());
+}
+
+}  // namespace
@@ -0,0 +1,194 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+
+#include "libmv/correspondence/feature.h"
+#include "libmv/correspondence/track_store.h"
+
+namespace libmv {
+namespace {
+
+bool ImageThenTrack(const TrackStore::Observation &a,
+                    const TrackStore::Observation &b) {
+  return a.image < b.image || (a.image == b.image && a.track < b.track);
+}
+
+}  // namespace
+
+void TrackStore::Build(const Matches &matches) {
+  by_image_.clear();
+  image_ids_.clear();
+  image_offsets_.clear();
+
+  // The matches are iterated in (image, track) order.
+  for (Matches::Features<Feature> r = matches.All<Feature>(); r; ++r) {
+    Observation observation;
+    observation.image = r.image();
+    observation.track = r.track();
+    observation.feature = r.feature();
+    observation.point = dynamic_cast<const PointFeature *>(r.feature());
+    if (image_ids_.empty() || image_ids_.back() != observation.image) {
+      image_ids_.push_back(observation.image);
+      image_offsets_.push_back(by_image_.size());
+    }
+    by_image_.push_back(observation);
+  }
+  image_offsets_.push_back(by_image_.size());
+  BuildTrackIndex();
+}
+
+void TrackStore::Build(const std::vector<Observation> &observations) {
+  by_image_ = observations;
+  image_ids_.clear();
+  image_offsets_.clear();
+  for (size_t i = 1; i < by_image_.size(); ++i) {
+    if (ImageThenTrack(by_image_[i], by_image_[i - 1])) {
+      std::sort(by_image_.begin(), by_image_.end(), ImageThenTrack);
+      break;
+    }
+  }
+  for (size_t i = 0; i < by_image_.size(); ++i) {
+    if (image_ids_.empty() || image_ids_.back() != by_image_[i].image) {
+      image_ids_.push_back(by_image_[i].image);
+      image_offsets_.push_back(i);
+    }
+  }
+  image_offsets_.push_back(by_image_.size());
+  BuildTrackIndex();
+}
+
+void TrackStore::BuildTrackIndex() {
+  for (size_t i = 0; i < by_image_.size(); ++i) {
+    Observation &observation = by_image_[i];
+    observation.x = observation.point ? observation.point->x() : 0;
+    observation.y = observation.point ? observation.point->y() : 0;
+  }
+
+  // Tracks, and the number of observations of each.
+  track_ids_.resize(by_image_.size());
+  for (size_t i = 0; i < by_image_.size(); ++i) {
+    track_ids_[i] = by_image_[i].track;
+  }
+  std::sort(track_ids_.begin(), track_ids_.end());
+  track_ids_.erase(std::unique(track_ids_.begin(), track_ids_.end()),
+                   track_ids_.end());
+  std::vector<int> track_index(by_image_.size());
+  track_offsets_.assign(track_ids_.size() + 1, 0);
+  for (size_t i = 0; i < by_image_.size(); ++i) {
+    track_index[i] = std::lower_bound(track_ids_.begin(), track_ids_.end(),
+                                      by_image_[i].track) - track_ids_.begin();
+    track_offsets_[track_index[i] + 1]++;
+  }
+  for (size_t t = 0; t < track_ids_.size(); ++t) {
+    track_offsets_[t + 1] += track_offsets_[t];
+  }
+
+  // Counting sort by track; it is stable, hence images stay sorted.
+  by_track_.resize(by_image_.size());
+  std::vector<int> next(track_offsets_.begin(), track_offsets_.end() - 1);
+  for (size_t i = 0; i < by_image_.size(); ++i) {
+    by_track_[next[track_index[i]]++] = by_image_[i];
+  }
+}
+
+const Feature *TrackStore::Get(ImageID image, TrackID track) const {
+  Range range = InImage(image);
+  int begin = 0, end = range.size();
+  while (begin < end) {
+    int middle = (begin + end) / 2;
+    if (range[middle].track < track) {
+      begin = middle + 1;
+    } else {
+      end = middle;
+    }
+  }
+  if (begin < range.size() && range[begin].track == track) {
+    return range[begin].feature;
+  }
+  return NULL;
+}
+
+void TrackStore::TracksInAllImages(const std::vector<ImageID> &images,
+                                   std::vector<TrackID> *tracks,
+                                   std::vector<int> *positions) const {
+  tracks->clear();
+  positions->clear();
+  const int num_images = images.size();
+  if (num_images == 0) {
+    return;
+  }
+  // Walk the observations of the image with the fewest, and advance a
+  // cursor in the (sorted by track) observations of the others.
+  std::vector<Range> ranges(num_images);
+  int pivot = 0;
+  for (int i = 0; i < num_images; ++i) {
+    ranges[i] = InImage(images[i]);
+    if (ranges[i].size() < ranges[pivot].size()) {
+      pivot = i;
+    }
+  }
+  std::vector<int> cursors(num_images, 0);
+  const Range &pivot_range = ranges[pivot];
+  for (int p = 0; p < pivot_range.size(); ++p) {
+    const Observation &observation = pivot_range[p];
+    if (!observation.point) {
+      continue;
+    }
+    cursors[pivot] = p;
+    bool in_all_images = true;
+    for (int i = 0; i < num_images && in_all_images; ++i) {
+      if (i == pivot) {
+        continue;
+      }
+      const Range &range = ranges[i];
+      int &cursor = cursors[i];
+      while (cursor < range.size() && range[cursor].track < observation.track) {
+        ++cursor;
+      }
+      if (cursor == range.size()) {
+        // No later track of the pivot is in this image either.
+        return;
+      }
+      in_all_images = range[cursor].track == observation.track &&
+                      range[cursor].point;
+    }
+    if (in_all_images) {
+      tracks->push_back(observation.track);
+      positions->insert(positions->end(), cursors.begin(), cursors.end());
+    }
+  }
+}
+
+TrackStore::Range TrackStore::Find(const std::vector<int> &ids,
+                                   const std::vector<int> &offsets,
+                                   const std::vector<Observation> &observations,
+                                   int id) {
+  std::vector<int>::const_iterator it =
+      std::lower_bound(ids.begin(), ids.end(), id);
+  if (it == ids.end() || *it != id) {
+    return Range();
+  }
+  int i = it - ids.begin();
+  const Observation *base = &observations[0];
+  return Range(base + offsets[i], base + offsets[i + 1]);
+}
+
+}  // namespace libmv
@@ -0,0 +1,180 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_CORRESPONDENCE_TRACK_STORE_H_
+#define LIBMV_CORRESPONDENCE_TRACK_STORE_H_
+
+#include <vector>
+
+#include "libmv/correspondence/matches.h"
+
+namespace libmv {
+
+class Feature;
+class PointFeature;
+
+// A compact, read-only copy of the observations of a Matches, for the stages
+// (like reconstruction) that query tracks many times without modifying them.
+//
+// The observations are stored twice in contiguous arrays: once sorted by
+// image then track, once sorted by track then image. Offset tables index the
+// first observation of each image and track (as in a compressed sparse row
+// matrix), hence InImage() and InTrack() cost one binary search over the ids
+// and then O(1) per observation. Whether a feature is a PointFeature is
+// determined once when building, not on every access.
+class TrackStore {
+ public:
+  typedef Matches::ImageID ImageID;
+  typedef Matches::TrackID TrackID;
+
+  struct Observation {
+    ImageID image;
+    TrackID track;
+    const Feature *feature;
+    // The feature if it is a PointFeature, NULL otherwise.
+    const PointFeature *point;
+    // The coordinates of point, copied by Build() so that they are gathered
+    // without touching the features.
+    float x, y;
+  };
+
+  // A contiguous range of observations.
+  class Range {
+   public:
+    Range() : begin_(NULL), end_(NULL) {}
+    Range(const Observation *begin, const Observation *end)
+        : begin_(begin), end_(end) {}
+
+    const Observation *begin() const { return begin_; }
+    const Observation *end()   const { return end_;   }
+    int size() const { return end_ - begin_; }
+    bool empty() const { return begin_ == end_; }
+    const Observation &operator[](int i) const { return begin_[i]; }
+
+   private:
+    const Observation *begin_;
+    const Observation *end_;
+  };
+
+  TrackStore() {}
+  explicit TrackStore(const Matches &matches) { Build(matches); }
+
+  // Replace the content of the store by the observations in matches.
+  void Build(const Matches &matches);
+  // Same, from observations in any order, e.g. loaded from a file. There must
+  // be at most one observation per (image, track).
+  void Build(const std::vector<Observation> &observations);
+
+  int NumObservations() const { return by_image_.size(); }
+  int NumImages() const { return image_ids_.size(); }
+  int NumTracks() const { return track_ids_.size(); }
+
+  // Ids of the images and tracks that have observations, sorted.
+  const std::vector<ImageID> &Images() const { return image_ids_; }
+  const std::vector<TrackID> &Tracks() const { return track_ids_; }
+
+  // All observations, sorted by image then track.
+  Range All() const {
+    return by_image_.empty() ? Range() :
+        Range(&by_image_[0], &by_image_[0] + by_image_.size());
+  }
+  // Observations in an image, sorted by track.
+  Range InImage(ImageID image) const {
+    return Find(image_ids_, image_offsets_, by_image_, image);
+  }
+  // Observations of a track, sorted by image.
+  Range InTrack(TrackID track) const {
+    return Find(track_ids_, track_offsets_, by_track_, track);
+  }
+
+  int NumFeatureImage(ImageID image) const { return InImage(image).size(); }
+  int NumFeatureTrack(TrackID track) const { return InTrack(track).size(); }
+
+  // The feature of track in image, or NULL if the track is not in the image.
+  const Feature *Get(ImageID image, TrackID track) const;
+
+  // The tracks with a point feature in all the images, sorted, as
+  // ::TracksInAllImages(). The observation of track j in image i is
+  // InImage(images[i])[(*positions)[j * images.size() + i]].
+  void TracksInAllImages(const std::vector<ImageID> &images,
+                         std::vector<TrackID> *tracks,
+                         std::vector<int> *positions) const;
+
+  // Same as ::PointMatchMatrices(): (*xs)[i] gets the coordinates of the
+  // tracks in images[i], one column per track. Matrix is Mat or Mat2X. The
+  // coordinates are copied from the observations, with no lookup per track,
+  // and the matrices are only reallocated when the number of tracks changes,
+  // so that buffers passed again and again are reused.
+  template<typename Matrix>
+  void PointMatchMatrices(const std::vector<ImageID> &images,
+                          std::vector<TrackID> *tracks,
+                          std::vector<Matrix> *xs) const {
+    std::vector<int> positions;
+    TracksInAllImages(images, tracks, &positions);
+    const int num_images = images.size(), num_tracks = tracks->size();
+    xs->resize(num_images);
+    for (int i = 0; i < num_images; ++i) {
+      Matrix &x = (*xs)[i];
+      if (x.rows() != 2 || x.cols() != num_tracks) {
+        x.resize(2, num_tracks);
+      }
+      const Observation *observations = InImage(images[i]).begin();
+      for (int j = 0; j < num_tracks; ++j) {
+        const Observation &observation =
+            observations[positions[j * num_images + i]];
+        x(0, j) = observation.x;
+        x(1, j) = observation.y;
+      }
+    }
+  }
+
+  // Same as ::TwoViewPointMatchMatrices().
+  template<typename Matrix>
+  void TwoViewPointMatchMatrices(ImageID image1, ImageID image2,
+                                 std::vector<Matrix> *xs) const {
+    std::vector<ImageID> images(2);
+    images[0] = image1;
+    images[1] = image2;
+    std::vector<TrackID> tracks;
+    PointMatchMatrices(images, &tracks, xs);
+  }
+
+ private:
+  // Fills the coordinates of the observations and the track index from
+  // by_image_, which is sorted by image then track.
+  void BuildTrackIndex();
+
+  static Range Find(const std::vector<int> &ids,
+                    const std::vector<int> &offsets,
+                    const std::vector<Observation> &observations,
+                    int id);
+
+  std::vector<ImageID> image_ids_;
+  std::vector<int> image_offsets_;
+  std::vector<Observation> by_image_;
+
+  std::vector<TrackID> track_ids_;
+  std::vector<int> track_offsets_;
+  std::vector<Observation> by_track_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_CORRESPONDENCE_TRACK_STORE_H_
@@ -0,0 +1,185 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+
+#include "libmv/correspondence/feature.h"
+#include "libmv/correspondence/matches.h"
+#include "libmv/correspondence/track_store.h"
+#include "testing/testing.h"
+
+namespace {
+
+using namespace libmv;
+
+struct OtherFeature : public Feature {
+  virtual ~OtherFeature() {}
+};
+
+class TrackStoreTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    // Inserted out of order on purpose.
+    Add(7, 2, new PointFeature(8, 80));
+    Add(1, 3, new PointFeature(3, 30));
+    Add(4, 6, new OtherFeature);
+    Add(1, 1, new PointFeature(1, 10));
+    Add(4, 1, new PointFeature(4, 40));
+    Add(7, 6, new PointFeature(10, 100));
+    Add(4, 2, new PointFeature(5, 50));
+    store.Build(matches);
+  }
+  virtual void TearDown() {
+    for (size_t i = 0; i < features.size(); ++i) {
+      delete features[i];
+    }
+  }
+  void Add(int image, int track, Feature *feature) {
+    matches.Insert(image, track, feature);
+    features.push_back(feature);
+  }
+
+  std::vector<Feature *> features;
+  Matches matches;
+  TrackStore store;
+};
+
+TEST_F(TrackStoreTest, Sizes) {
+  EXPECT_EQ(7, store.NumObservations());
+  ASSERT_EQ(3, store.NumImages());
+  ASSERT_EQ(4, store.NumTracks());
+  EXPECT_EQ(1, store.Images()[0]);
+  EXPECT_EQ(4, store.Images()[1]);
+  EXPECT_EQ(7, store.Images()[2]);
+  EXPECT_EQ(1, store.Tracks()[0]);
+  EXPECT_EQ(6, store.Tracks()[3]);
+}
+
+TEST_F(TrackStoreTest, InImageIsSortedByTrack) {
+  TrackStore::Range r = store.InImage(4);
+  ASSERT_EQ(3, r.size());
+  EXPECT_EQ(1, r[0].track);
+  EXPECT_EQ(2, r[1].track);
+  EXPECT_EQ(6, r[2].track);
+  EXPECT_EQ(4, r[0].image);
+  EXPECT_EQ(4.f, r[0].point->x());
+  EXPECT_TRUE(r[2].point == NULL);
+  EXPECT_TRUE(r[2].feature != NULL);
+  EXPECT_TRUE(store.InImage(2).empty());
+  EXPECT_TRUE(store.InImage(9).empty());
+}
+
+TEST_F(TrackStoreTest, InTrackIsSortedByImage) {
+  TrackStore::Range r = store.InTrack(6);
+  ASSERT_EQ(2, r.size());
+  EXPECT_EQ(4, r[0].image);
+  EXPECT_EQ(7, r[1].image);
+  EXPECT_EQ(100.f, r[1].point->y());
+  EXPECT_EQ(2, store.NumFeatureTrack(1));
+  EXPECT_EQ(0, store.NumFeatureTrack(5));
+}
+
+TEST_F(TrackStoreTest, MatchesTheMatches) {
+  for (int image = 0; image < 9; ++image) {
+    EXPECT_EQ(matches.NumFeatureImage(image), store.NumFeatureImage(image));
+    for (int track = 0; track < 8; ++track) {
+      EXPECT_EQ(matches.Get(image, track), store.Get(image, track));
+    }
+  }
+  for (int track = 0; track < 8; ++track) {
+    EXPECT_EQ(matches.NumFeatureTrack(track), store.NumFeatureTrack(track));
+  }
+}
+
+TEST_F(TrackStoreTest, BuildFromUnsortedObservations) {
+  std::vector<TrackStore::Observation> observations(store.All().begin(),
+                                                    store.All().end());
+  std::reverse(observations.begin(), observations.end());
+  TrackStore other;
+  other.Build(observations);
+  EXPECT_EQ(store.NumObservations(), other.NumObservations());
+  EXPECT_TRUE(store.Images() == other.Images());
+  EXPECT_TRUE(store.Tracks() == other.Tracks());
+  for (int image = 0; image < 9; ++image) {
+    for (int track = 0; track < 8; ++track) {
+      EXPECT_EQ(store.Get(image, track), other.Get(image, track));
+    }
+  }
+  TrackStore::Range r = other.InTrack(1);
+  ASSERT_EQ(2, r.size());
+  EXPECT_EQ(1, r[0].image);
+  EXPECT_EQ(4, r[1].image);
+}
+
+TEST_F(TrackStoreTest, PointMatchMatricesMatchTheMatches) {
+  std::vector<TrackStore::ImageID> images;
+  images.push_back(4);
+  images.push_back(1);
+  std::vector<TrackStore::TrackID> tracks;
+  std::vector<Mat2X> xs;
+  store.PointMatchMatrices(images, &tracks, &xs);
+  ASSERT_EQ(1, tracks.size());
+  EXPECT_EQ(1, tracks[0]);
+  ASSERT_EQ(2, xs.size());
+  EXPECT_EQ(1, xs[0].cols());
+  EXPECT_EQ(4, xs[0](0, 0));
+  EXPECT_EQ(40, xs[0](1, 0));
+  EXPECT_EQ(1, xs[1](0, 0));
+  EXPECT_EQ(10, xs[1](1, 0));
+
+  // Track 6 is in both images, but not a point in image 4.
+  for (int a = 0; a < 9; ++a) {
+    for (int b = 0; b < 9; ++b) {
+      vector<Mat> expected;
+      TwoViewPointMatchMatrices(matches, a, b, &expected);
+      std::vector<Mat> xs2;
+      store.TwoViewPointMatchMatrices(a, b, &xs2);
+      ASSERT_EQ(2, xs2.size());
+      EXPECT_EQ(expected[0].cols(), xs2[0].cols());
+      EXPECT_EQ(expected[0], xs2[0]);
+      EXPECT_EQ(expected[1], xs2[1]);
+    }
+  }
+}
+
+TEST_F(TrackStoreTest, PointMatchMatricesReuseTheBuffers) {
+  std::vector<TrackStore::ImageID> images;
+  images.push_back(1);
+  images.push_back(4);
+  std::vector<TrackStore::TrackID> tracks;
+  std::vector<Mat2X> xs;
+  store.PointMatchMatrices(images, &tracks, &xs);
+  const double *data = xs[1].data();
+  store.PointMatchMatrices(images, &tracks, &xs);
+  EXPECT_EQ(data, xs[1].data());
+  EXPECT_EQ(1, tracks.size());
+}
+
+TEST(TrackStore, Empty) {
+  Matches matches;
+  TrackStore store(matches);
+  EXPECT_EQ(0, store.NumObservations());
+  EXPECT_TRUE(store.All().empty());
+  EXPECT_TRUE(store.InImage(0).empty());
+  EXPECT_TRUE(store.InTrack(0).empty());
+  EXPECT_TRUE(store.Get(0, 0) == NULL);
+}
+
+}  // namespace
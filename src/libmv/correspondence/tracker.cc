@@ -25,43 +25,40 @@
 using namespace libmv;
 using namespace tracker;
  
-bool Tracker::Track(const Image &image1,
-                    const Image &image2, 
-                    FeaturesGraph *new_features_graph,
-                    bool keep_single_feature) {
+void Tracker::DetectAndDescribe(const Image &image, FeatureSet *feature_set) {
   // we detect good features to track
-  detector::DetectorData **data = NULL;
-  vector<Feature *> features1;
-  detector_->Detect(image1, &features1, data);
-        
-  vector<Feature *> features2;
-  detector_->Detect(image2, &features2, data);
+  detector::DetectorData *data = NULL;
+  vector<Feature *> features;
+  detector_->Detect(image, &features, &data);
+  // The frame products of the detector, such as the integral image of SURF,
+  // are reused by the describer.
+  scoped_ptr<detector::DetectorData> detector_data(data);
 
   // we compute the feature descriptors on every feature
-  detector::DetectorData *detector_data = NULL;
-  vector<descriptor::Descriptor *> descriptors1;
-  
-  describer_->Describe(features1, image1, detector_data, &descriptors1);
-  vector<descriptor::Descriptor *> descriptors2;
-  describer_->Describe(features2, image2, detector_data, &descriptors2);
-  
+  vector<descriptor::Descriptor *> descriptors;
+  describer_->Describe(features, image, detector_data.get(), &descriptors);
+
   // Copy data form generic feature to Keypoints since the matcher is
   // a point matcher
-  FeatureSet *feature_set1 = new_features_graph->CreateNewFeatureSet();
-  feature_set1->features.resize(descriptors1.size());
-  for (size_t i = 0; i < descriptors1.size(); i++) {
-    KeypointFeature& feature = feature_set1->features[i];
-    feature.descriptor = *(descriptor::VecfDescriptor*) descriptors1[i];
-    *(PointFeature*)(&feature) = *(PointFeature*)features1[i];
+  feature_set->features.resize(descriptors.size());
+  for (size_t i = 0; i < descriptors.size(); i++) {
+    KeypointFeature& feature = feature_set->features[i];
+    feature.descriptor = *(descriptor::VecfDescriptor*) descriptors[i];
+    *(PointFeature*)(&feature) = *(PointFeature*)features[i];
   }
-  
+
+  DeleteElements(&descriptors);
+  DeleteElements(&features);
+}
+
+bool Tracker::Track(const Image &image1,
+                    const Image &image2, 
+                    FeaturesGraph *new_features_graph,
+                    bool keep_single_feature) {
+  FeatureSet *feature_set1 = new_features_graph->CreateNewFeatureSet();
+  DetectAndDescribe(image1, feature_set1);
   FeatureSet *feature_set2 = new_features_graph->CreateNewFeatureSet();
-  feature_set2->features.resize(descriptors2.size());
-  for (size_t i = 0; i < descriptors2.size(); i++) {
-    KeypointFeature& feature = feature_set2->features[i];
-    feature.descriptor = *(descriptor::VecfDescriptor*) descriptors2[i];
-    *(PointFeature*)(&feature) = *(PointFeature*)features2[i];
-  }
+  DetectAndDescribe(image2, feature_set2);
   
   // we match them
   //TODO (jmichot) use the matcher_ to match and not the generic function
@@ -109,11 +106,6 @@ bool Tracker::Track(const Image &image1,
     }
   }
   
-  DeleteElements(&descriptors1);
-  DeleteElements(&descriptors2);
-  DeleteElements(&features1);
-  DeleteElements(&features2);
-  
   return true;
 }
 
@@ -122,29 +114,31 @@ bool Tracker::Track(const Image &image,
                     FeaturesGraph *new_features_graph,
                     Matches::ImageID *image_id,
                     bool keep_single_feature) {
-  // we detect good features to track
-  detector::DetectorData **data = NULL;
-  vector<Feature *> features;
-  detector_->Detect(image, &features, data);
-  
-  // we compute the feature descriptors on every feature
-  detector::DetectorData *detector_data = NULL;
-  vector<descriptor::Descriptor *> descriptors;
-  describer_->Describe(features, image, detector_data, &descriptors);
-  
-  // Copy data form generic feature to Keypoints since the matcher is
-  // a point matcher
-  FeatureSet *feature_set = new_features_graph->CreateNewFeatureSet();
-  feature_set->features.resize(descriptors.size());
-  for (size_t i = 0; i < descriptors.size(); i++) {
-    KeypointFeature& feature = feature_set->features[i];
-    feature.descriptor = *(descriptor::VecfDescriptor*) descriptors[i];
-    *(PointFeature*)(&feature) = *(PointFeature*)features[i];
-  }
+  FeatureSet *feature_set = new FeatureSet();
+  DetectAndDescribe(image, feature_set);
+  // Not virtual, so that the subclasses can call this method before filtering
+  // the matches.
+  return Tracker::Track(feature_set,
+                        known_features_graph,
+                        new_features_graph,
+                        image_id,
+                        keep_single_feature);
+}
+
+bool Tracker::Track(FeatureSet *feature_set,
+                    const FeaturesGraph &known_features_graph,
+                    FeaturesGraph *new_features_graph,
+                    Matches::ImageID *image_id,
+                    bool keep_single_feature) {
+  new_features_graph->features_sets_.push_back(feature_set);
   if (known_features_graph.matches_.NumImages() == 0)
     *image_id = 0;
   else
     *image_id = known_features_graph.matches_.GetMaxImageID() + 1;
+  if (use_track_index_) {
+    return TrackWithIndex(feature_set, known_features_graph,
+                          new_features_graph, *image_id, keep_single_feature);
+  }
     
   //TODO (jmichot) Use the matcher_ to match and not the generic function
   // FindCorrespondences(*feature_set1, *feature_set2, correspondences);
@@ -208,8 +202,106 @@ bool Tracker::Track(const Image &image,
     }
   }
   
-  DeleteElements(&descriptors);
-  DeleteElements(&features);  
-  
+  return true;
+}
+
+void Tracker::UpdateTrackIndex(const FeaturesGraph &known_features_graph) {
+  // The last feature of every track.
+  std::map<Matches::TrackID, const KeypointFeature *> last_features;
+  std::map<Matches::TrackID, Matches::ImageID> last_images;
+  Matches::Features<KeypointFeature> known_features =
+   known_features_graph.matches_.All<KeypointFeature>();
+  for (; known_features; ++known_features) {
+    std::map<Matches::TrackID, Matches::ImageID>::iterator last =
+     last_images.find(known_features.track());
+    if (last == last_images.end() || last->second < known_features.image()) {
+      last_images[known_features.track()] = known_features.image();
+      last_features[known_features.track()] = known_features.feature();
+    }
+  }
+
+  // Dead tracks.
+  std::map<Matches::TrackID, Matches::ImageID>::iterator indexed =
+   indexed_images_.begin();
+  while (indexed != indexed_images_.end()) {
+    if (last_images.count(indexed->first) == 0) {
+      track_index_.Remove(indexed->first);
+      indexed_images_.erase(indexed++);
+    } else {
+      ++indexed;
+    }
+  }
+
+  // New tracks, and tracks seen in a new image.
+  std::map<Matches::TrackID, Matches::ImageID>::iterator last =
+   last_images.begin();
+  for (; last != last_images.end(); ++last) {
+    indexed = indexed_images_.find(last->first);
+    if (indexed != indexed_images_.end() && indexed->second == last->second) {
+      continue;
+    }
+    const Vecf &descriptor = last_features[last->first]->descriptor.coords;
+    if (track_index_.Size() == 0) {
+      track_index_.SetDimensions(descriptor.size());
+    }
+    track_index_.Remove(last->first);
+    track_index_.Insert(descriptor.data(), last->first);
+    indexed_images_[last->first] = last->second;
+  }
+}
+
+bool Tracker::TrackWithIndex(FeatureSet *feature_set,
+                             const FeaturesGraph &known_features_graph,
+                             FeaturesGraph *new_features_graph,
+                             Matches::ImageID image_id,
+                             bool keep_single_feature) {
+  UpdateTrackIndex(known_features_graph);
+
+  // Each feature is matched to its nearest track if it passes the ratio test
+  // of FindCorrespondences(), and each track keeps its closest feature.
+  const int kNN = 2, kMaxLeafs = 64;
+  const float kRatio = 0.8f;
+  std::map<Matches::TrackID, std::pair<float, size_t> > matched_tracks;
+  std::vector<Matches::TrackID> tracks;
+  std::vector<float> distances;
+  if (track_index_.Size() > 0) {
+    for (size_t i = 0; i < feature_set->features.size(); ++i) {
+      const Vecf &descriptor = feature_set->features[i].descriptor.coords;
+      track_index_.Knn(descriptor.data(), kNN, kMaxLeafs, &tracks, &distances);
+      if (tracks.size() == kNN && !(distances[0] < kRatio * distances[1])) {
+        continue;
+      }
+      std::map<Matches::TrackID, std::pair<float, size_t> >::iterator match =
+       matched_tracks.find(tracks[0]);
+      if (match == matched_tracks.end() || distances[0] < match->second.first) {
+        matched_tracks[tracks[0]] = std::make_pair(distances[0], i);
+      }
+    }
+  }
+
+  std::vector<bool> is_matched(feature_set->features.size(), false);
+  std::map<Matches::TrackID, std::pair<float, size_t> >::iterator match =
+   matched_tracks.begin();
+  for (; match != matched_tracks.end(); ++match) {
+    new_features_graph->matches_.Insert(image_id,
+                                        match->first,
+                                        &feature_set->features[
+                                         match->second.second]);
+    is_matched[match->second.second] = true;
+  }
+
+  if (keep_single_feature) {
+    size_t max_num_track = known_features_graph.matches_.GetMaxTrackID()+1;
+    if (known_features_graph.matches_.NumTracks() == 0)
+      max_num_track = 0;
+    for (size_t i = 0; i < feature_set->features.size(); ++i) {
+      if (!is_matched[i]) {
+        new_features_graph->matches_.Insert(image_id,
+                                            max_num_track,
+                                            &feature_set->features[i]);
+        max_num_track++;
+      }
+    }
+  }
   return true;
 }
@@ -25,8 +25,10 @@
 #include <list>
 
 #include "libmv/base/scoped_ptr.h"
+#include "libmv/base/thread.h"
 #include "libmv/base/vector.h"
 #include "libmv/correspondence/ArrayMatcher.h"
+#include "libmv/correspondence/dynamic_kdtree.h"
 #include "libmv/correspondence/feature_matching.h"
 #include "libmv/correspondence/matches.h"
 #include "libmv/descriptor/descriptor.h"
@@ -82,9 +84,10 @@ class Tracker {
           correspondence::ArrayMatcher<float> *matcher) : 
            detector_(detector),
            describer_(describer),
-           matcher_(matcher) {
-    //TODO(jmichot) Do a copy of the classes so that the Tracker class will have
-    // its own Detector, Describer & Matcher.
+           matcher_(matcher),
+           use_track_index_(false) {
+    //TODO(jmichot) Do a copy of the matcher so that the Tracker class will
+    // have its own Matcher.
   };
             
   virtual ~Tracker() {}
@@ -102,10 +105,52 @@ class Tracker {
                      Matches::ImageID *image_id,
                      bool keep_single_feature = true); 
 
+  // Tracks all features in an image, from features already detected and
+  // described by DetectAndDescribe(). The feature set is added to (and owned
+  // by) new_features_graph.
+  virtual bool Track(FeatureSet *feature_set,
+                     const FeaturesGraph &known_features_graph,
+                     FeaturesGraph *new_features_graph,
+                     Matches::ImageID *image_id,
+                     bool keep_single_feature = true);
+
+  // Detects and describes the features of an image, the part of tracking that
+  // does not depend on the other images. Detectors and describers are
+  // reentrant (see Detector::Detect()), so several threads can extract the
+  // features of different images at once.
+  void DetectAndDescribe(const Image &image, FeatureSet *feature_set);
+
+  // By default the features of an image are matched against those of every
+  // known image, with matchers built for each image. With a track index, they
+  // are matched against the last descriptor of every known track, kept in a
+  // DynamicKdTree from one image to the next: the index is brought up to date
+  // with the tracks of known_features_graph, which only inserts the tracks
+  // seen since the last image and removes the dead ones.
+  void set_use_track_index(bool use_track_index) {
+    use_track_index_ = use_track_index;
+    track_index_.Clear();
+    indexed_images_.clear();
+  }
+  bool use_track_index() const { return use_track_index_; }
+
  protected:
+  // Track() with the track index.
+  bool TrackWithIndex(FeatureSet *feature_set,
+                      const FeaturesGraph &known_features_graph,
+                      FeaturesGraph *new_features_graph,
+                      Matches::ImageID image_id,
+                      bool keep_single_feature);
+  // Updates the track index to the last features of the known tracks.
+  void UpdateTrackIndex(const FeaturesGraph &known_features_graph);
+
    scoped_ptr<detector::Detector> detector_;
    scoped_ptr<descriptor::Describer> describer_;
    scoped_ptr<correspondence::ArrayMatcher<float> > matcher_;
+
+   bool use_track_index_;
+   DynamicKdTree<float, Matches::TrackID> track_index_;
+   // The image of the feature indexed for each track.
+   std::map<Matches::TrackID, Matches::ImageID> indexed_images_;
 };
 
 } // using namespace tracker
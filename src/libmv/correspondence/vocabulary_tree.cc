@@ -0,0 +1,294 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <map>
+
+#include "libmv/correspondence/vocabulary_tree.h"
+
+namespace libmv {
+
+namespace {
+
+float SquaredDistance(const float *a, const float *b, int dimension) {
+  float sum = 0;
+  for (int d = 0; d < dimension; ++d) {
+    float difference = a[d] - b[d];
+    sum += difference * difference;
+  }
+  return sum;
+}
+
+// Index of the nearest of the num_centers rows of centers.
+int Nearest(const float *centers, int num_centers, int dimension,
+            const float *row) {
+  int best = 0;
+  float best_distance = std::numeric_limits<float>::max();
+  for (int c = 0; c < num_centers; ++c) {
+    float distance = SquaredDistance(centers + c * dimension, row, dimension);
+    if (distance < best_distance) {
+      best_distance = distance;
+      best = c;
+    }
+  }
+  return best;
+}
+
+// Best scores first, then lowest image ids.
+bool BetterResult(const std::pair<float, int> &a,
+                  const std::pair<float, int> &b) {
+  if (a.first != b.first) {
+    return a.first > b.first;
+  }
+  return a.second < b.second;
+}
+
+}  // namespace
+
+void VocabularyTree::Build(const float *rows, int num_rows, int dimension,
+                           int branching, int depth, int max_iterations) {
+  assert(branching >= 2);
+  dimension_ = dimension;
+  num_words_ = 0;
+  nodes_.clear();
+  centers_.clear();
+  images_.clear();
+  finalized_ = false;
+
+  Node root;
+  root.first_child = -1;
+  root.num_children = 0;
+  root.word = -1;
+  nodes_.push_back(root);
+  // The root center is never compared to.
+  centers_.resize(dimension, 0.f);
+
+  std::vector<int> indices(num_rows);
+  for (int i = 0; i < num_rows; ++i) {
+    indices[i] = i;
+  }
+  Split(rows, &indices, 0, num_rows, 0, branching, depth, max_iterations);
+}
+
+void VocabularyTree::Split(const float *rows, std::vector<int> *indices,
+                           int begin, int end, int node, int branching,
+                           int levels_left, int max_iterations) {
+  int n = end - begin;
+  if (levels_left == 0 || n <= branching) {
+    nodes_[node].word = num_words_++;
+    return;
+  }
+
+  // k-means of the descriptors of the node, seeded with evenly spaced ones.
+  int k = branching;
+  std::vector<float> centers(k * dimension_);
+  for (int c = 0; c < k; ++c) {
+    const float *seed = rows + (*indices)[begin + (c * n) / k] * dimension_;
+    std::copy(seed, seed + dimension_, &centers[c * dimension_]);
+  }
+  std::vector<int> labels(n, -1);
+  std::vector<int> counts(k);
+  for (int iteration = 0; iteration < max_iterations; ++iteration) {
+    bool changed = false;
+    for (int i = 0; i < n; ++i) {
+      int label = Nearest(&centers[0], k, dimension_,
+                          rows + (*indices)[begin + i] * dimension_);
+      if (label != labels[i]) {
+        labels[i] = label;
+        changed = true;
+      }
+    }
+    if (!changed) {
+      break;
+    }
+    std::vector<float> sums(k * dimension_, 0.f);
+    std::fill(counts.begin(), counts.end(), 0);
+    for (int i = 0; i < n; ++i) {
+      const float *row = rows + (*indices)[begin + i] * dimension_;
+      float *sum = &sums[labels[i] * dimension_];
+      for (int d = 0; d < dimension_; ++d) {
+        sum[d] += row[d];
+      }
+      ++counts[labels[i]];
+    }
+    for (int c = 0; c < k; ++c) {
+      // An empty cluster keeps its center.
+      if (counts[c] > 0) {
+        for (int d = 0; d < dimension_; ++d) {
+          centers[c * dimension_ + d] = sums[c * dimension_ + d] / counts[c];
+        }
+      }
+    }
+  }
+
+  // Group the descriptors of every child.
+  std::fill(counts.begin(), counts.end(), 0);
+  for (int i = 0; i < n; ++i) {
+    ++counts[labels[i]];
+  }
+  std::vector<int> child_begin(k + 1, begin);
+  for (int c = 0; c < k; ++c) {
+    child_begin[c + 1] = child_begin[c] + counts[c];
+  }
+  std::vector<int> sorted(n);
+  std::vector<int> next(child_begin.begin(), child_begin.end() - 1);
+  for (int i = 0; i < n; ++i) {
+    sorted[next[labels[i]]++ - begin] = (*indices)[begin + i];
+  }
+  std::copy(sorted.begin(), sorted.end(), indices->begin() + begin);
+
+  int first_child = nodes_.size();
+  nodes_[node].first_child = first_child;
+  nodes_[node].num_children = k;
+  for (int c = 0; c < k; ++c) {
+    Node child;
+    child.first_child = -1;
+    child.num_children = 0;
+    child.word = -1;
+    nodes_.push_back(child);
+  }
+  centers_.insert(centers_.end(), centers.begin(), centers.end());
+  for (int c = 0; c < k; ++c) {
+    Split(rows, indices, child_begin[c], child_begin[c + 1], first_child + c,
+          branching, levels_left - 1, max_iterations);
+  }
+}
+
+int VocabularyTree::Quantize(const float *descriptor) const {
+  assert(!nodes_.empty());
+  int node = 0;
+  while (nodes_[node].first_child >= 0) {
+    const Node &parent = nodes_[node];
+    node = parent.first_child +
+        Nearest(&centers_[parent.first_child * dimension_],
+                parent.num_children, dimension_, descriptor);
+  }
+  return nodes_[node].word;
+}
+
+void VocabularyTree::MakeHistogram(const float *rows, int num_rows,
+                                   Histogram *histogram) const {
+  std::map<int, float> counts;
+  for (int i = 0; i < num_rows; ++i) {
+    counts[Quantize(rows + i * dimension_)] += 1;
+  }
+  histogram->assign(counts.begin(), counts.end());
+}
+
+int VocabularyTree::AddImage(const float *rows, int num_rows) {
+  images_.push_back(Histogram());
+  MakeHistogram(rows, num_rows, &images_.back());
+  finalized_ = false;
+  return images_.size() - 1;
+}
+
+void VocabularyTree::Normalize(Histogram *histogram) const {
+  float sum = 0;
+  for (size_t i = 0; i < histogram->size(); ++i) {
+    std::pair<int, float> &entry = (*histogram)[i];
+    entry.second *= idf_[entry.first];
+    sum += entry.second;
+  }
+  if (sum > 0) {
+    for (size_t i = 0; i < histogram->size(); ++i) {
+      (*histogram)[i].second /= sum;
+    }
+  }
+}
+
+void VocabularyTree::Finalize() {
+  int num_images = images_.size();
+  std::vector<int> frequencies(num_words_, 0);
+  for (int i = 0; i < num_images; ++i) {
+    for (size_t j = 0; j < images_[i].size(); ++j) {
+      ++frequencies[images_[i][j].first];
+    }
+  }
+  // The words seen in many images tell them apart less. The smoothed
+  // log(1 + N / N_w) keeps a weight for the words of all the images, which
+  // matters for small sets.
+  idf_.resize(num_words_);
+  for (int w = 0; w < num_words_; ++w) {
+    idf_[w] = frequencies[w] ?
+        std::log(1 + float(num_images) / frequencies[w]) : 0;
+  }
+  normalized_images_ = images_;
+  inverted_file_.assign(num_words_, Histogram());
+  for (int i = 0; i < num_images; ++i) {
+    Normalize(&normalized_images_[i]);
+    for (size_t j = 0; j < normalized_images_[i].size(); ++j) {
+      const std::pair<int, float> &entry = normalized_images_[i][j];
+      if (entry.second > 0) {
+        inverted_file_[entry.first].push_back(
+            std::make_pair(i, entry.second));
+      }
+    }
+  }
+  finalized_ = true;
+}
+
+void VocabularyTree::Score(const Histogram &query, int excluded,
+                           int max_results,
+                           std::vector<std::pair<float, int> > *results) const {
+  // For histograms of unit L1 norm, |q - d| = 2 - 2 sum_w min(q_w, d_w), and
+  // only the words of the query contribute to the sum.
+  std::vector<float> scores(images_.size(), 0.f);
+  for (size_t i = 0; i < query.size(); ++i) {
+    const Histogram &images = inverted_file_[query[i].first];
+    for (size_t j = 0; j < images.size(); ++j) {
+      scores[images[j].first] += std::min(query[i].second, images[j].second);
+    }
+  }
+  results->clear();
+  for (size_t i = 0; i < scores.size(); ++i) {
+    if (scores[i] > 0 && static_cast<int>(i) != excluded) {
+      results->push_back(std::make_pair(scores[i], static_cast<int>(i)));
+    }
+  }
+  int num_results = std::min(max_results, static_cast<int>(results->size()));
+  std::partial_sort(results->begin(), results->begin() + num_results,
+                    results->end(), BetterResult);
+  results->resize(num_results);
+}
+
+void VocabularyTree::Query(const float *rows, int num_rows, int max_results,
+                           std::vector<std::pair<float, int> > *results) {
+  if (!finalized_) {
+    Finalize();
+  }
+  Histogram histogram;
+  MakeHistogram(rows, num_rows, &histogram);
+  Normalize(&histogram);
+  Score(histogram, -1, max_results, results);
+}
+
+void VocabularyTree::QueryImage(int image, int max_results,
+                                std::vector<std::pair<float, int> > *results) {
+  assert(0 <= image && image < NumImages());
+  if (!finalized_) {
+    Finalize();
+  }
+  Score(normalized_images_[image], image, max_results, results);
+}
+
+}  // namespace libmv
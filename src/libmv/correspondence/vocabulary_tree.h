@@ -0,0 +1,113 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_CORRESPONDENCE_VOCABULARY_TREE_H_
+#define LIBMV_CORRESPONDENCE_VOCABULARY_TREE_H_
+
+#include <utility>
+#include <vector>
+
+namespace libmv {
+
+// A vocabulary tree with an inverted file, to find which images of a set are
+// likely to share features without matching them, from "Scalable Recognition
+// with a Vocabulary Tree" by Nister and Stewenius (CVPR 2006).
+//
+// The tree is built by hierarchical k-means on a sample of descriptors: every
+// node splits its descriptors into branching clusters, down to depth levels,
+// and the leaves are the visual words. Each image is then described by the
+// tf-idf weighted histogram of the words of its descriptors, and two images
+// are compared with the L1 distance of their normalized histograms, computed
+// from the inverted file of every word.
+class VocabularyTree {
+ public:
+  VocabularyTree() : dimension_(0), num_words_(0), finalized_(true) {}
+
+  // Builds the tree from the num_rows rows of dimension floats of rows. A
+  // node with no more than branching descriptors is not split further. This
+  // clears the image database.
+  void Build(const float *rows, int num_rows, int dimension,
+             int branching, int depth, int max_iterations = 10);
+
+  int Dimension() const { return dimension_; }
+  int NumWords() const { return num_words_; }
+  int NumImages() const { return images_.size(); }
+
+  // The word (leaf) of a descriptor, found by descending the tree to the
+  // nearest child at every level.
+  int Quantize(const float *descriptor) const;
+
+  // Adds an image described by num_rows descriptors to the database and
+  // returns its id, numbered from 0. The weights of the database are only
+  // updated by the next Query().
+  int AddImage(const float *rows, int num_rows);
+
+  // Scores an image described by num_rows descriptors against the database
+  // and writes at most max_results (score, image id) pairs, best first. The
+  // score is 1 for identical histograms and 0 for images without a common
+  // word.
+  void Query(const float *rows, int num_rows, int max_results,
+             std::vector<std::pair<float, int> > *results);
+
+  // Same as above for an image of the database, which is not returned.
+  void QueryImage(int image, int max_results,
+                  std::vector<std::pair<float, int> > *results);
+
+ private:
+  struct Node {
+    int first_child;  // Index of the first child, or -1 for a leaf.
+    int num_children;
+    int word;         // The word of a leaf, -1 otherwise.
+  };
+
+  typedef std::vector<std::pair<int, float> > Histogram;
+
+  void Split(const float *rows, std::vector<int> *indices, int begin, int end,
+             int node, int branching, int levels_left, int max_iterations);
+  void MakeHistogram(const float *rows, int num_rows,
+                     Histogram *histogram) const;
+  // Weighs a histogram of word counts by idf and normalizes it to unit L1
+  // norm.
+  void Normalize(Histogram *histogram) const;
+  // Recomputes the idf of the words and the normalized histograms of the
+  // images, and rebuilds the inverted file.
+  void Finalize();
+  void Score(const Histogram &query, int excluded, int max_results,
+             std::vector<std::pair<float, int> > *results) const;
+
+  int dimension_;
+  int num_words_;
+  std::vector<Node> nodes_;
+  // The centers of the nodes, in the order of nodes_.
+  std::vector<float> centers_;
+
+  // The word counts of every image.
+  std::vector<Histogram> images_;
+  // What Finalize() computes.
+  bool finalized_;
+  std::vector<float> idf_;
+  std::vector<Histogram> normalized_images_;
+  // The (image, weight) pairs of every word.
+  std::vector<Histogram> inverted_file_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_CORRESPONDENCE_VOCABULARY_TREE_H_
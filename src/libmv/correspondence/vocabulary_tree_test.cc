@@ -0,0 +1,113 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstdlib>
+#include <vector>
+
+#include "libmv/correspondence/vocabulary_tree.h"
+#include "testing/testing.h"
+
+namespace {
+
+using namespace libmv;
+
+const int kDimension = 8;
+
+float Uniform() {
+  return rand() / float(RAND_MAX);
+}
+
+// Two views of num_scenes scenes: the descriptors of a scene are random, and
+// its views see them with some noise.
+void MakeViews(int num_scenes, int num_features,
+               std::vector<std::vector<float> > *views) {
+  srand(5);
+  views->resize(2 * num_scenes);
+  for (int s = 0; s < num_scenes; ++s) {
+    std::vector<float> scene(num_features * kDimension);
+    for (size_t i = 0; i < scene.size(); ++i) {
+      scene[i] = Uniform();
+    }
+    for (int v = 0; v < 2; ++v) {
+      std::vector<float> &view = (*views)[2 * s + v];
+      view = scene;
+      for (size_t i = 0; i < view.size(); ++i) {
+        view[i] += 0.01 * (Uniform() - 0.5);
+      }
+    }
+  }
+}
+
+TEST(VocabularyTree, Build) {
+  std::vector<std::vector<float> > views;
+  MakeViews(4, 50, &views);
+  VocabularyTree tree;
+  tree.Build(&views[0][0], 50, kDimension, 3, 3);
+  EXPECT_EQ(kDimension, tree.Dimension());
+  EXPECT_LT(1, tree.NumWords());
+  EXPECT_GE(3 * 3 * 3, tree.NumWords());
+  for (int i = 0; i < 50; ++i) {
+    int word = tree.Quantize(&views[0][i * kDimension]);
+    EXPECT_LE(0, word);
+    EXPECT_GT(tree.NumWords(), word);
+  }
+
+  // Few descriptors make a single leaf.
+  tree.Build(&views[0][0], 2, kDimension, 3, 3);
+  EXPECT_EQ(1, tree.NumWords());
+  EXPECT_EQ(0, tree.Quantize(&views[1][0]));
+}
+
+TEST(VocabularyTree, FindsTheOtherViewOfEveryScene) {
+  const int kNumScenes = 6, kNumFeatures = 40;
+  std::vector<std::vector<float> > views;
+  MakeViews(kNumScenes, kNumFeatures, &views);
+
+  std::vector<float> all;
+  for (size_t i = 0; i < views.size(); ++i) {
+    all.insert(all.end(), views[i].begin(), views[i].end());
+  }
+  VocabularyTree tree;
+  tree.Build(&all[0], all.size() / kDimension, kDimension, 4, 4);
+  for (size_t i = 0; i < views.size(); ++i) {
+    EXPECT_EQ(i, tree.AddImage(&views[i][0], kNumFeatures));
+  }
+  EXPECT_EQ(2 * kNumScenes, tree.NumImages());
+
+  std::vector<std::pair<float, int> > results;
+  for (int i = 0; i < tree.NumImages(); ++i) {
+    tree.QueryImage(i, 3, &results);
+    ASSERT_LT(0, results.size());
+    EXPECT_GE(3, results.size());
+    EXPECT_EQ(i ^ 1, results[0].second);
+    for (size_t k = 1; k < results.size(); ++k) {
+      EXPECT_NE(i, results[k].second);
+      EXPECT_GE(results[k - 1].first, results[k].first);
+    }
+  }
+
+  // An image of the database is its own best match, with a score of 1.
+  tree.Query(&views[3][0], kNumFeatures, 1, &results);
+  ASSERT_EQ(1, results.size());
+  EXPECT_EQ(3, results[0].second);
+  EXPECT_NEAR(1.0, results[0].first, 1e-5);
+}
+
+}  // namespace
@@ -0,0 +1,50 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_DESCRIPTOR_BINARY_DESCRIPTOR_H
+#define LIBMV_DESCRIPTOR_BINARY_DESCRIPTOR_H
+
+#include "libmv/descriptor/descriptor.h"
+
+namespace libmv {
+namespace descriptor {
+
+// A 256 bit descriptor packed in 32 bit words, compared with the Hamming
+// distance (see correspondence/hamming.h).
+struct BinaryDescriptor : public Descriptor {
+  enum { kNumBits = 256, kNumWords = kNumBits / 32 };
+
+  virtual ~BinaryDescriptor() {}
+  BinaryDescriptor() {
+    for (int i = 0; i < kNumWords; ++i) {
+      words[i] = 0;
+    }
+  }
+
+  bool Bit(int i) const { return (words[i / 32] >> (i % 32)) & 1; }
+  void SetBit(int i) { words[i / 32] |= 1u << (i % 32); }
+
+  unsigned int words[kNumWords];
+};
+
+}  // namespace descriptor
+}  // namespace libmv
+
+#endif  // LIBMV_DESCRIPTOR_BINARY_DESCRIPTOR_H
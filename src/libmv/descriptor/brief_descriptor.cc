@@ -0,0 +1,140 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cmath>
+
+#include "libmv/base/vector.h"
+#include "libmv/correspondence/feature.h"
+#include "libmv/descriptor/binary_descriptor.h"
+#include "libmv/descriptor/brief_descriptor.h"
+#include "libmv/descriptor/descriptor.h"
+#include "libmv/detector/frame_cache.h"
+#include "libmv/image/convolve.h"
+#include "libmv/image/image.h"
+#include "libmv/logging/logging.h"
+
+namespace libmv {
+namespace descriptor {
+namespace {
+
+// Half size of the 31x31 patch, and the smoothing of the image (from [1]).
+const int kPatchRadius = 15;
+const double kSmoothingSigma = 2.0;
+
+// Distance from the feature that the rotated pattern can reach.
+const int kRotatedRadius = 22;  // ceil(15 * sqrt(2)).
+
+struct PointPair {
+  float x1, y1, x2, y2;
+};
+
+// Linear congruential generator, so that every build samples the same
+// pattern.
+double UniformRandom(unsigned *state) {
+  *state = *state * 1103515245u + 12345u;
+  return (((*state >> 8) & 0xffffff) + 0.5) / 16777216.0;
+}
+
+// Isotropic gaussian samples of sigma S / 5 (configuration G II of [1]),
+// clamped to the patch.
+float PatternCoordinate(unsigned *state) {
+  double u = UniformRandom(state), v = UniformRandom(state);
+  double x = sqrt(-2 * log(u)) * cos(2 * M_PI * v) * (2 * kPatchRadius + 1) / 5;
+  return std::max(-kPatchRadius + 0.0, std::min(kPatchRadius + 0.0, x));
+}
+
+void MakePattern(vector<PointPair> *pattern) {
+  unsigned state = 1;
+  pattern->resize(BinaryDescriptor::kNumBits);
+  for (int i = 0; i < BinaryDescriptor::kNumBits; ++i) {
+    (*pattern)[i].x1 = PatternCoordinate(&state);
+    (*pattern)[i].y1 = PatternCoordinate(&state);
+    (*pattern)[i].x2 = PatternCoordinate(&state);
+    (*pattern)[i].y2 = PatternCoordinate(&state);
+  }
+}
+
+}  // namespace
+
+class BriefDescriber : public Describer {
+ public:
+  BriefDescriber() {
+    MakePattern(&pattern_);
+  }
+
+  virtual void Describe(const vector<Feature *> &features,
+                        const Image &image,
+                        const detector::DetectorData *detector_data,
+                        vector<Descriptor *> *descriptors) const {
+    LIBMV_SCOPED_TIMER("describe.brief");
+    // The smoothed image of the frame cache, if the detector made one.
+    const detector::FrameCache *cache =
+        dynamic_cast<const detector::FrameCache *>(detector_data);
+    FloatImage own_smoothed;
+    const FloatImage *smoothed_image = &own_smoothed;
+    if (cache && cache->IsOf(image)) {
+      smoothed_image = &cache->Smoothed(kSmoothingSigma);
+    } else {
+      FloatImage float_image;
+      ByteArrayToScaledFloatArray(*image.AsArray3Du(), &float_image);
+      ConvolveGaussian(float_image, kSmoothingSigma, &own_smoothed);
+    }
+    const FloatImage &smoothed = *smoothed_image;
+
+    descriptors->resize(features.size());
+    for (int i = 0; i < features.size(); ++i) {
+      PointFeature *point = dynamic_cast<PointFeature *>(features[i]);
+      (*descriptors)[i] = NULL;
+      if (!point) {
+        continue;
+      }
+      int x = lround(point->x());
+      int y = lround(point->y());
+      if (x < kRotatedRadius || x >= smoothed.Width() - kRotatedRadius ||
+          y < kRotatedRadius || y >= smoothed.Height() - kRotatedRadius) {
+        continue;
+      }
+      float co = cos(point->orientation);
+      float si = sin(point->orientation);
+      BinaryDescriptor *descriptor = new BinaryDescriptor;
+      for (int b = 0; b < BinaryDescriptor::kNumBits; ++b) {
+        const PointPair &p = pattern_[b];
+        int x1 = x + lround(co * p.x1 - si * p.y1);
+        int y1 = y + lround(si * p.x1 + co * p.y1);
+        int x2 = x + lround(co * p.x2 - si * p.y2);
+        int y2 = y + lround(si * p.x2 + co * p.y2);
+        if (smoothed(y1, x1) < smoothed(y2, x2)) {
+          descriptor->SetBit(b);
+        }
+      }
+      (*descriptors)[i] = descriptor;
+    }
+  }
+
+ private:
+  vector<PointPair> pattern_;
+};
+
+Describer *CreateBriefDescriber() {
+  return new BriefDescriber;
+}
+
+}  // namespace descriptor
+}  // namespace libmv
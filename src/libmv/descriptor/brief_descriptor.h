@@ -0,0 +1,48 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_DESCRIPTOR_BRIEF_DESCRIPTOR_H
+#define LIBMV_DESCRIPTOR_BRIEF_DESCRIPTOR_H
+
+namespace libmv {
+namespace descriptor {
+
+class Describer;
+
+/**
+ * Creates a BRIEF describer [1], steered by the orientation of the features
+ * as in ORB [2]. Each feature is described by 256 intensity comparisons
+ * between pairs of pixels of the smoothed image, drawn once from an isotropic
+ * gaussian around the feature in a 31x31 patch, and stored as a
+ * BinaryDescriptor. The pattern does not depend on the feature scale.
+ * Features too close to the border to fit the rotated pattern get a NULL
+ * descriptor.
+ *
+ * [1] BRIEF: Binary Robust Independent Elementary Features.
+ *     M. Calonder, V. Lepetit, C. Strecha and P. Fua, ECCV 2010.
+ * [2] ORB: an efficient alternative to SIFT or SURF.
+ *     E. Rublee, V. Rabaud, K. Konolige and G. Bradski, ICCV 2011.
+ */
+Describer *CreateBriefDescriber();
+
+}  // namespace descriptor
+}  // namespace libmv
+
+#endif  // LIBMV_DESCRIPTOR_BRIEF_DESCRIPTOR_H
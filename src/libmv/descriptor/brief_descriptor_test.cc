@@ -0,0 +1,131 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cmath>
+
+#include "libmv/base/scoped_ptr.h"
+#include "libmv/base/vector.h"
+#include "libmv/base/vector_utils.h"
+#include "libmv/correspondence/feature.h"
+#include "libmv/correspondence/hamming.h"
+#include "libmv/descriptor/binary_descriptor.h"
+#include "libmv/descriptor/brief_descriptor.h"
+#include "libmv/descriptor/descriptor.h"
+#include "libmv/image/image.h"
+#include "testing/testing.h"
+
+namespace libmv {
+namespace descriptor {
+namespace {
+
+// Smooth random-looking texture.
+void MakeImage(int height, int width, int dx, int dy, Array3Du *image) {
+  image->Resize(height, width);
+  for (int r = 0; r < height; ++r) {
+    for (int c = 0; c < width; ++c) {
+      double x = c + dx, y = r + dy;
+      (*image)(r, c) = 128 + 50 * sin(0.31 * x) * cos(0.19 * y + 0.07 * x)
+                           + 40 * sin(0.11 * y - 0.23 * x);
+    }
+  }
+}
+
+unsigned int Distance(Descriptor *a, Descriptor *b) {
+  return HammingDistance(static_cast<BinaryDescriptor *>(a)->words,
+                         static_cast<BinaryDescriptor *>(b)->words,
+                         BinaryDescriptor::kNumWords);
+}
+
+TEST(BriefDescriber, NoDescriptorNearTheBorder) {
+  Array3Du array;
+  MakeImage(80, 80, 0, 0, &array);
+  Image image(new Array3Du(array));
+  vector<Feature *> features;
+  features.push_back(new PointFeature(5, 40));
+  features.push_back(new PointFeature(40, 40));
+  features.push_back(new PointFeature(40, 75));
+
+  scoped_ptr<Describer> describer(CreateBriefDescriber());
+  vector<Descriptor *> descriptors;
+  describer->Describe(features, image, NULL, &descriptors);
+  ASSERT_EQ(3, descriptors.size());
+  EXPECT_TRUE(descriptors[0] == NULL);
+  EXPECT_TRUE(descriptors[1] != NULL);
+  EXPECT_TRUE(descriptors[2] == NULL);
+  DeleteElements(&features);
+  DeleteElements(&descriptors);
+}
+
+TEST(BriefDescriber, TranslatedImageGivesTheSameDescriptor) {
+  Array3Du array, shifted_array;
+  MakeImage(80, 80, 0, 0, &array);
+  MakeImage(80, 80, 7, 3, &shifted_array);
+  Image image(new Array3Du(array)), shifted(new Array3Du(shifted_array));
+  vector<Feature *> features, shifted_features;
+  features.push_back(new PointFeature(40, 40));
+  features.push_back(new PointFeature(30, 50));
+  shifted_features.push_back(new PointFeature(33, 37));
+  shifted_features.push_back(new PointFeature(40, 40));
+
+  scoped_ptr<Describer> describer(CreateBriefDescriber());
+  vector<Descriptor *> descriptors, shifted_descriptors;
+  describer->Describe(features, image, NULL, &descriptors);
+  describer->Describe(shifted_features, shifted, NULL, &shifted_descriptors);
+  EXPECT_EQ(0, Distance(descriptors[0], shifted_descriptors[0]));
+  // Unrelated points are far apart.
+  EXPECT_LT(64, Distance(descriptors[1], shifted_descriptors[1]));
+  DeleteElements(&features);
+  DeleteElements(&shifted_features);
+  DeleteElements(&descriptors);
+  DeleteElements(&shifted_descriptors);
+}
+
+TEST(BriefDescriber, SteeredByTheOrientation) {
+  Array3Du array, rotated_array;
+  MakeImage(80, 90, 0, 0, &array);
+  // Rotate the image by 90 degrees: (x, y) goes to (y, width - 1 - x).
+  rotated_array.Resize(array.Width(), array.Height());
+  for (int r = 0; r < rotated_array.Height(); ++r) {
+    for (int c = 0; c < rotated_array.Width(); ++c) {
+      rotated_array(r, c) = array(c, array.Width() - 1 - r);
+    }
+  }
+  Image image(new Array3Du(array)), rotated(new Array3Du(rotated_array));
+  vector<Feature *> features, rotated_features;
+  features.push_back(new PointFeature(45, 40));
+  PointFeature *rotated_feature = new PointFeature(40, 90 - 1 - 45);
+  rotated_feature->orientation = -M_PI / 2;
+  rotated_features.push_back(rotated_feature);
+
+  scoped_ptr<Describer> describer(CreateBriefDescriber());
+  vector<Descriptor *> descriptors, rotated_descriptors;
+  describer->Describe(features, image, NULL, &descriptors);
+  describer->Describe(rotated_features, rotated, NULL, &rotated_descriptors);
+  ASSERT_TRUE(rotated_descriptors[0] != NULL);
+  EXPECT_GT(8, Distance(descriptors[0], rotated_descriptors[0]));
+  DeleteElements(&features);
+  DeleteElements(&rotated_features);
+  DeleteElements(&descriptors);
+  DeleteElements(&rotated_descriptors);
+}
+
+}  // namespace
+}  // namespace descriptor
+}  // namespace libmv
@@ -18,7 +18,16 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+#include "libmv/base/memory_budget.h"
+#include "libmv/base/scoped_ptr.h"
+#include "libmv/base/thread.h"
 #include "libmv/logging/logging.h"
+#include "libmv/descriptor/daisy_descriptor.h"
 #include "libmv/descriptor/descriptor.h"
 #include "libmv/descriptor/vector_descriptor.h"
 #include "libmv/correspondence/feature.h"
@@ -28,51 +37,261 @@
 namespace libmv {
 namespace descriptor {
 
-// TODO(keir): This is utterly untested!
-class DaisyDescriber : public Describer {
- public:
-  virtual void Describe(const vector<Feature *> &features,
-                        const Image &image,
-                        const detector::DetectorData *detector_data,
-                        vector<Descriptor *> *descriptors) {
-    (void) detector_data;  // There is no matching detector for DAISY.
+namespace {
+
+// The parameters of the descriptors, from the README of DAISY: radius,
+// radius quantization, angular quantization and histogram quantization.
+const int kDaisyRadius = 15;
+const int kDaisyRadiusBins = 3;
+const int kDaisyAngleBins = 8;
+const int kDaisyHistogramBins = 8;
 
-    daisy desc;
+void SetDaisyParameters(daisy *desc) {
+  desc->set_parameters(kDaisyRadius, kDaisyRadiusBins, kDaisyAngleBins,
+                       kDaisyHistogramBins);
+}
+
+// Describes one of num_ranges contiguous ranges of the features.
+struct DescribeRange {
+  daisy *desc;
+  const vector<Feature *> *features;
+  vector<Descriptor *> *descriptors;
+  int num_ranges;
 
+  void operator()(int range) const {
+    int size = features->size();
+    int begin = size * range / num_ranges;
+    int end = size * (range + 1) / num_ranges;
+    for (int i = begin; i < end; ++i) {
+      PointFeature *point = dynamic_cast<PointFeature *>((*features)[i]);
+      VecfDescriptor *descriptor = NULL;
+      if (point) {
+        // DAISY takes the orientation in whole degrees, in [0, 360).
+        int orientation =
+            static_cast<int>(floor(point->orientation * 180.0 / M_PI)) % 360;
+        if (orientation < 0) {
+          orientation += 360;
+        }
+        descriptor = new VecfDescriptor(desc->descriptor_size());
+        desc->get_descriptor(point->y(),
+                             point->x(),
+                             orientation,
+                             descriptor->coords.data());
+      }
+      (*descriptors)[i] = descriptor;
+    }
+  }
+};
+
+}  // namespace
+
+// The smoothed gradient layers of an image; reading descriptors from them
+// does not modify the daisy object.
+class DaisySession : public DescriberSession {
+ public:
+  DaisySession(const Image &image)
+      : desc_(new daisy), memory_(MEMORY_DESCRIPTORS) {
     // TODO(keir): DAISY has extensive configuration options; consider exposing
     // them via some sort of config system.
 
-    // Defaults from README.
-    desc.set_parameters(15, 3, 8, 8);
-    //desc.scale_invariant(true);
+    SetDaisyParameters(desc_.get());
+    //desc_->scale_invariant(true);
 
     // Push the image into daisy. This will make a copy and convert to float.
     ByteImage *byte_image = image.AsArray3Du();
-    desc.set_image(byte_image->Data(),
-                   byte_image->Height(),
-                   byte_image->Width());
+    desc_->set_image(byte_image->Data(),
+                     byte_image->Height(),
+                     byte_image->Width());
 
     // Only use sparse descriptors; the default is dense.
-    desc.initialize_single_descriptor_mode();
+    desc_->initialize_single_descriptor_mode();
+    // The smoothed gradient layers of the image.
+    memory_.Set(static_cast<long long>(desc_->compute_workspace_memory()) *
+                sizeof(float));
+    ReclaimMemoryOverBudget();
+  }
 
+  virtual void Describe(const vector<Feature *> &features,
+                        int num_threads,
+                        vector<Descriptor *> *descriptors) const {
+    LIBMV_SCOPED_TIMER("describe.daisy.session");
     descriptors->resize(features.size());
-    for (int i = 0; i < features.size(); ++i) {
-      PointFeature *point = dynamic_cast<PointFeature *>(features[i]);
-      VecfDescriptor *descriptor = NULL;
-      if (point) {
-        descriptor = new VecfDescriptor(desc.descriptor_size());
-        desc.get_descriptor(point->y(),
-                            point->x(),
-                            point->orientation * 180.0 / 3.14159f,
-                            descriptor->coords.data());
+    DescribeRange describe;
+    describe.desc = desc_.get();
+    describe.features = &features;
+    describe.descriptors = descriptors;
+    describe.num_ranges = std::max(1, std::min(num_threads,
+                                               int(features.size())));
+    ParallelFor(0, describe.num_ranges, describe.num_ranges, &describe);
+  }
+
+ private:
+  scoped_ptr<daisy> desc_;
+  MemoryUsage memory_;
+};
+
+// TODO(keir): This is utterly untested!
+class DaisyDescriber : public Describer {
+ public:
+  DaisyDescriber(int num_threads) : num_threads_(num_threads) {}
+
+  virtual void Describe(const vector<Feature *> &features,
+                        const Image &image,
+                        const detector::DetectorData *detector_data,
+                        vector<Descriptor *> *descriptors) const {
+    LIBMV_SCOPED_TIMER("describe.daisy");
+    scoped_ptr<DescriberSession> session(CreateSession(image, detector_data));
+    session->Describe(features, num_threads_, descriptors);
+  }
+
+  virtual DescriberSession *CreateSession(
+      const Image &image,
+      const detector::DetectorData *detector_data) const {
+    (void) detector_data;  // There is no matching detector for DAISY.
+    return new DaisySession(image);
+  }
+
+ private:
+  int num_threads_;
+};
+
+Describer *CreateDaisyDescriber(int num_threads) {
+  return new DaisyDescriber(num_threads);
+}
+
+namespace {
+
+// Gathers the descriptors of one row of a field.
+struct DescribeFieldRows {
+  void operator()(int row) const {
+    std::vector<float> values(descriptor_size);
+    unsigned char *out = descriptors + static_cast<size_t>(row) * width *
+                                       descriptor_size;
+    for (int c = 0; c < width; ++c) {
+      // DAISY leaves the values of grid points outside of the image as they
+      // are.
+      std::fill(values.begin(), values.end(), 0.0f);
+      desc->get_descriptor(row + row_offset, c + column_offset, 0, &values[0]);
+      for (int i = 0; i < descriptor_size; ++i) {
+        float v = values[i] * DaisyField::kScale + 0.5f;
+        *out++ = static_cast<unsigned char>(
+            std::max(0.0f, std::min<float>(DaisyField::kScale, v)));
       }
-      (*descriptors)[i] = descriptor;
     }
   }
+  daisy *desc;
+  int descriptor_size;
+  int width;
+  int row_offset;
+  int column_offset;
+  unsigned char *descriptors;
 };
 
-Describer *CreateDaisyDescriber() {
-  return new DaisyDescriber;
+}  // namespace
+
+DaisyField::DaisyField()
+    : descriptor_size_(0), x_(0), y_(0), width_(0), height_(0),
+      memory_(MEMORY_DESCRIPTORS) {
+}
+
+void DaisyField::Clear() {
+  descriptor_size_ = x_ = y_ = width_ = height_ = 0;
+  std::vector<unsigned char>().swap(descriptors_);
+  memory_.Set(0);
+}
+
+bool DaisyField::Compute(const Image &image, int num_threads) {
+  ByteImage *byte_image = image.AsArray3Du();
+  if (!byte_image) {
+    Clear();
+    return false;
+  }
+  return Compute(image, 0, 0, byte_image->Width(), byte_image->Height(),
+                 num_threads);
+}
+
+bool DaisyField::Compute(const Image &image, int x, int y, int width,
+                         int height, int num_threads) {
+  LIBMV_SCOPED_TIMER("describe.daisy.field");
+  Clear();
+  ByteImage *byte_image = image.AsArray3Du();
+  if (!byte_image || byte_image->Depth() != 1) {
+    return false;
+  }
+  int x_end = std::min(x + width, byte_image->Width());
+  int y_end = std::min(y + height, byte_image->Height());
+  x = std::max(x, 0);
+  y = std::max(y, 0);
+  if (x >= x_end || y >= y_end) {
+    return false;
+  }
+
+  // Only the rectangle and a margin around it are convolved. The grids reach
+  // one radius out of the rectangle, and the widest smoothing, of sigma half
+  // the radius, about two and a half radii further.
+  const int margin = 4 * kDaisyRadius;
+  int crop_x = std::max(0, x - margin);
+  int crop_y = std::max(0, y - margin);
+  int crop_width = std::min(byte_image->Width(), x_end + margin) - crop_x;
+  int crop_height = std::min(byte_image->Height(), y_end + margin) - crop_y;
+  std::vector<unsigned char> crop(static_cast<size_t>(crop_width) *
+                                  crop_height);
+  for (int r = 0; r < crop_height; ++r) {
+    for (int c = 0; c < crop_width; ++c) {
+      crop[r * crop_width + c] = (*byte_image)(crop_y + r, crop_x + c);
+    }
+  }
+
+  daisy desc;
+  SetDaisyParameters(&desc);
+  desc.set_image(&crop[0], crop_height, crop_width);
+  desc.initialize_single_descriptor_mode();
+  std::vector<unsigned char>().swap(crop);
+
+  descriptor_size_ = desc.descriptor_size();
+  x_ = x;
+  y_ = y;
+  width_ = x_end - x;
+  height_ = y_end - y;
+  descriptors_.resize(static_cast<size_t>(width_) * height_ *
+                      descriptor_size_);
+  memory_.Set(descriptors_.size() +
+              static_cast<long long>(desc.compute_workspace_memory()) *
+              sizeof(float));
+  ReclaimMemoryOverBudget();
+
+  DescribeFieldRows describe;
+  describe.desc = &desc;
+  describe.descriptor_size = descriptor_size_;
+  describe.width = width_;
+  describe.row_offset = y_ - crop_y;
+  describe.column_offset = x_ - crop_x;
+  describe.descriptors = &descriptors_[0];
+  ParallelFor(0, height_, num_threads, &describe);
+
+  // The smoothed gradient layers are released with desc.
+  memory_.Set(descriptors_.size());
+  return true;
+}
+
+void DaisyField::GetDescriptor(int x, int y, float *descriptor) const {
+  const unsigned char *values = Descriptor(x, y);
+  for (int i = 0; i < descriptor_size_; ++i) {
+    descriptor[i] = values[i] * (1.0f / kScale);
+  }
+}
+
+float DaisyField::SquaredDistance(int x, int y, const DaisyField &other,
+                                  int other_x, int other_y) const {
+  assert(descriptor_size_ == other.descriptor_size_);
+  const unsigned char *a = Descriptor(x, y);
+  const unsigned char *b = other.Descriptor(other_x, other_y);
+  int sum = 0;
+  for (int i = 0; i < descriptor_size_; ++i) {
+    int d = a[i] - b[i];
+    sum += d * d;
+  }
+  return sum * (1.0f / (kScale * kScale));
 }
 
 }  // namespace descriptor
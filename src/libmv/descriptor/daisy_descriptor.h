@@ -21,7 +21,14 @@
 #ifndef LIBMV_DESCRIPTOR_DAISY_DESCRIPTOR_H
 #define LIBMV_DESCRIPTOR_DAISY_DESCRIPTOR_H
 
+#include <vector>
+
+#include "libmv/base/memory_budget.h"
+
 namespace libmv {
+
+class Image;
+
 namespace descriptor {
 
 class Describer;
@@ -31,8 +38,69 @@ class Describer;
  *
  * TODO(keir): DAISY supports extensive configuration. Add support for tweaking
  * parameters once the JSON configuration framework is added.
+ *
+ * \param num_threads The number of threads the features are described on.
+ */
+Describer *CreateDaisyDescriber(int num_threads = 1);
+
+/**
+ * Dense DAISY descriptors of every pixel of a rectangle of an image, for dense
+ * wide baseline matching. The smoothed gradient layers are convolved once for
+ * the rectangle and a margin around it, then the descriptors of all its pixels
+ * are gathered from them on several threads. They are stored row after row,
+ * quantized to one byte per value, so reading the descriptor of any pixel is a
+ * lookup. The descriptors have the same parameters as CreateDaisyDescriber(),
+ * with orientation 0.
  */
-Describer *CreateDaisyDescriber();
+class DaisyField {
+ public:
+  // The quantized value of a normalized descriptor value v is v * kScale.
+  static const int kScale = 255;
+
+  DaisyField();
+
+  /**
+   * Computes the descriptors of the pixels of [x, x + width) x [y, y + height)
+   * clipped to the image. Returns false, leaving the field empty, if the image
+   * is not a single channel byte image or the rectangle is outside of it.
+   */
+  bool Compute(const Image &image, int x, int y, int width, int height,
+               int num_threads = 1);
+  // Same as above, over the whole image.
+  bool Compute(const Image &image, int num_threads = 1);
+
+  void Clear();
+
+  int descriptor_size() const { return descriptor_size_; }
+  int x() const { return x_; }
+  int y() const { return y_; }
+  int width() const { return width_; }
+  int height() const { return height_; }
+
+  bool Contains(int x, int y) const {
+    return x >= x_ && x < x_ + width_ && y >= y_ && y < y_ + height_;
+  }
+
+  // The descriptor_size() quantized values of pixel (x, y) of the image, which
+  // must be in the field.
+  const unsigned char *Descriptor(int x, int y) const {
+    return &descriptors_[(static_cast<size_t>(y - y_) * width_ + (x - x_)) *
+                         descriptor_size_];
+  }
+  // The normalized values of pixel (x, y).
+  void GetDescriptor(int x, int y, float *descriptor) const;
+
+  // The squared distance between the normalized descriptors of pixel (x, y)
+  // of this field and pixel (other_x, other_y) of the other field.
+  float SquaredDistance(int x, int y, const DaisyField &other,
+                        int other_x, int other_y) const;
+
+ private:
+  int descriptor_size_;
+  int x_, y_, width_, height_;
+  std::vector<unsigned char> descriptors_;
+  MemoryUsage memory_;
+};
 
 }  // namespace descriptor
 }  // namespace libmv
@@ -18,16 +18,148 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "libmv/base/scoped_ptr.h"
+#include "libmv/base/vector.h"
+#include "libmv/base/vector_utils.h"
+#include "libmv/correspondence/feature.h"
 #include "libmv/descriptor/daisy_descriptor.h"
+#include "libmv/descriptor/descriptor.h"
+#include "libmv/descriptor/vector_descriptor.h"
 #include "libmv/image/image.h"
 #include "testing/testing.h"
 
 namespace libmv {
 namespace {
 
+using namespace descriptor;
+
 TEST(DaisyDescriptor, DescribesStuff) {
   // Does it blend? Stay tuned to find out!
 }
 
+TEST(DaisyDescriptor, SessionGivesTheSameDescriptorsOnAnyThreads) {
+  Array3Du *array = new Array3Du(80, 100);
+  for (int r = 0; r < array->Height(); ++r) {
+    for (int c = 0; c < array->Width(); ++c) {
+      (*array)(r, c) = 128 + 60 * sin(0.3 * c) * cos(0.17 * r + 0.05 * c);
+    }
+  }
+  Image image(array);
+  vector<Feature *> features;
+  for (int i = 0; i < 7; ++i) {
+    PointFeature *feature = new PointFeature(20 + 8 * i, 30 + 3 * i);
+    feature->orientation = 0.9 * i - 2;
+    features.push_back(feature);
+  }
+
+  scoped_ptr<Describer> describer(CreateDaisyDescriber());
+  vector<Descriptor *> descriptors, session_descriptors;
+  describer->Describe(features, image, NULL, &descriptors);
+  scoped_ptr<DescriberSession> session(describer->CreateSession(image, NULL));
+  ASSERT_TRUE(session.get() != NULL);
+  for (int num_threads = 1; num_threads <= 4; num_threads += 3) {
+    session->Describe(features, num_threads, &session_descriptors);
+    ASSERT_EQ(features.size(), session_descriptors.size());
+    for (int i = 0; i < features.size(); ++i) {
+      Vecf &coords = static_cast<VecfDescriptor *>(descriptors[i])->coords;
+      Vecf &session_coords =
+          static_cast<VecfDescriptor *>(session_descriptors[i])->coords;
+      ASSERT_EQ(coords.size(), session_coords.size());
+      for (int j = 0; j < coords.size(); ++j) {
+        EXPECT_EQ(coords(j), session_coords(j));
+      }
+    }
+    DeleteElements(&session_descriptors);
+  }
+  DeleteElements(&features);
+  DeleteElements(&descriptors);
+}
+
+Image WavyImage(int height, int width) {
+  Array3Du *array = new Array3Du(height, width);
+  for (int r = 0; r < array->Height(); ++r) {
+    for (int c = 0; c < array->Width(); ++c) {
+      (*array)(r, c) = 128 + 60 * sin(0.3 * c) * cos(0.17 * r + 0.05 * c);
+    }
+  }
+  return Image(array);
+}
+
+TEST(DaisyField, MatchesTheSparseDescriptors) {
+  Image image = WavyImage(60, 70);
+  DaisyField field;
+  ASSERT_TRUE(field.Compute(image, 3));
+  EXPECT_EQ(70, field.width());
+  EXPECT_EQ(60, field.height());
+
+  // The grids of the features are inside of the image, where the sparse
+  // descriptors are defined.
+  vector<Feature *> features;
+  for (int i = 0; i < 5; ++i) {
+    features.push_back(new PointFeature(20 + 7 * i, 20 + 4 * i));
+  }
+  scoped_ptr<Describer> describer(CreateDaisyDescriber());
+  vector<Descriptor *> descriptors;
+  describer->Describe(features, image, NULL, &descriptors);
+  std::vector<float> values(field.descriptor_size());
+  for (int i = 0; i < features.size(); ++i) {
+    Vecf &coords = static_cast<VecfDescriptor *>(descriptors[i])->coords;
+    ASSERT_EQ(coords.size(), field.descriptor_size());
+    int x = static_cast<PointFeature *>(features[i])->x();
+    int y = static_cast<PointFeature *>(features[i])->y();
+    field.GetDescriptor(x, y, &values[0]);
+    for (int j = 0; j < coords.size(); ++j) {
+      EXPECT_NEAR(coords(j), values[j], 0.5 / DaisyField::kScale);
+    }
+    EXPECT_EQ(0, field.SquaredDistance(x, y, field, x, y));
+  }
+  DeleteElements(&features);
+  DeleteElements(&descriptors);
+}
+
+TEST(DaisyField, RegionMatchesTheWholeImageOnAnyThreads) {
+  Image image = WavyImage(120, 130);
+  DaisyField whole;
+  ASSERT_TRUE(whole.Compute(image, 1));
+  for (int num_threads = 1; num_threads <= 4; num_threads += 3) {
+    DaisyField region;
+    ASSERT_TRUE(region.Compute(image, 50, 40, 30, 200, num_threads));
+    EXPECT_EQ(50, region.x());
+    EXPECT_EQ(40, region.y());
+    EXPECT_EQ(30, region.width());
+    EXPECT_EQ(80, region.height());
+    EXPECT_TRUE(region.Contains(79, 119));
+    EXPECT_FALSE(region.Contains(80, 60));
+    EXPECT_FALSE(region.Contains(60, 39));
+    int max_difference = 0;
+    for (int y = 40; y < 120; ++y) {
+      for (int x = 50; x < 80; ++x) {
+        const unsigned char *a = region.Descriptor(x, y);
+        const unsigned char *b = whole.Descriptor(x, y);
+        for (int i = 0; i < region.descriptor_size(); ++i) {
+          max_difference = std::max(max_difference, std::abs(a[i] - b[i]));
+        }
+      }
+    }
+    EXPECT_LE(max_difference, 1);
+  }
+}
+
+TEST(DaisyField, RejectsEmptyRegions) {
+  Image image = WavyImage(40, 40);
+  DaisyField field;
+  EXPECT_FALSE(field.Compute(image, 40, 0, 10, 10));
+  EXPECT_FALSE(field.Compute(image, -20, 5, 10, 10));
+  EXPECT_EQ(0, field.width());
+  EXPECT_TRUE(field.Compute(image, -5, -5, 10, 10));
+  EXPECT_EQ(0, field.x());
+  EXPECT_EQ(5, field.width());
+}
+
 }  // namespace
 }  // namespace libmv
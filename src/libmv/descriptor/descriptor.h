@@ -41,8 +41,35 @@ public:
   virtual ~Descriptor() {};
 };
 
+/**
+ * Per image state of a describer, such as the scale space of the image, built
+ * once by Describer::CreateSession() and shared by all the descriptions
+ * computed in that image. Describe() does not modify the session, so several
+ * threads can call it at once.
+ */
+class DescriberSession {
+ public:
+  virtual ~DescriberSession() {};
+  /**
+   * Describes features of the image of the session.
+   *
+   * \param[in]  features     The features to find descriptions for.
+   * \param[in]  num_threads  The number of threads to split the features on.
+   * \param[out] descriptors  The computed descriptors, as in
+   *                          Describer::Describe().
+   */
+  virtual void Describe(const vector<Feature *> &features,
+                        int num_threads,
+                        vector<Descriptor *> *descriptors) const = 0;
+};
+
 /**
  * Interface for computing descriptors of features in images.
+ *
+ * Describe() and CreateSession() are const and keep their scratch memory to
+ * the call or to the session: a describer only holds its configuration once
+ * created, so one instance can describe several images at once from
+ * different threads.
  */
 class Describer {
  public:
@@ -68,7 +95,25 @@ class Describer {
   virtual void Describe(const vector<Feature *> &features,
                         const Image &image,
                         const detector::DetectorData *detector_data,
-                        vector<Descriptor *> *descriptors) = 0;
+                        vector<Descriptor *> *descriptors) const = 0;
+
+  /**
+   * Prepares the description of features in an image for several calls.
+   *
+   * \param[in] image         The image to compute descriptions from. It must
+   *                          outlive the session.
+   * \param[in] detector_data Data from the detector or NULL.
+   *
+   * \return A session to delete by the caller, or NULL if the describer has
+   *         no per image state to share between calls.
+   */
+  virtual DescriberSession *CreateSession(
+      const Image &image,
+      const detector::DetectorData *detector_data) const {
+    (void) image;
+    (void) detector_data;
+    return NULL;
+  }
 };
 
 }  // namespace descriptor
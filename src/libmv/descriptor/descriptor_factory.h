@@ -31,7 +31,8 @@ enum eDescriber
   SIMPLEST_DESCRIBER,
   DIPOLE_DESCRIBER,
   SURF_DESCRIBER,
-  DAISY_DESCRIBER
+  DAISY_DESCRIBER,
+  BRIEF_DESCRIBER
 };
 /**
  * Creates the corresponding describer (descriptor computing interface).
@@ -32,8 +32,10 @@ class Describer;
  * [1] A. Joly. New local descriptor based on dissociated dipoles.
  * In CIVR, pages 573-580, 2007.
  * Naive implementation : Use native image instead of gaussian smoothed image.
+ *
+ * \param num_threads The number of threads the features are described on.
  */
-Describer *CreateDipoleDescriber();
+Describer *CreateDipoleDescriber(int num_threads = 1);
 
 }  // namespace descriptor
 }  // namespace libmv
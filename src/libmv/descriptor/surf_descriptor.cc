@@ -18,9 +18,14 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <algorithm>
+#include <utility>
+
+#include "libmv/base/thread.h"
 #include "libmv/correspondence/feature.h"
 #include "libmv/descriptor/descriptor.h"
 #include "libmv/descriptor/vector_descriptor.h"
+#include "libmv/detector/frame_cache.h"
 #include "libmv/image/convolve.h"
 #include "libmv/image/image.h"
 #include "libmv/image/integral_image.h"
@@ -153,33 +158,207 @@ void MSURFDescriptor(const TImage &integral_image,
   descriptor->normalize();
 }
 
+namespace {
+
+// Layout of MSURFDescriptor<4, 9>, as used by SurfDescriber.
+const int kBlocks = 4;
+const int kSamplesPerBlock = 9;
+const int kHalfRegion = kBlocks * (kSamplesPerBlock - (kBlocks - 1)) / 2;
+const int kNumBlocks = kBlocks * kBlocks;
+// The 81 samples of a block, padded with zero weight samples so that the
+// accumulation runs on whole SIMD packets.
+const int kBlockSamples = 84;
+
+typedef Eigen::Array<float, kBlockSamples, 1> BlockSamples;
+
+// The parts of MSURFDescriptor<4, 9> that only depend on the scale of the
+// feature: the unrotated offsets of the samples of every block, their
+// gaussian weights, and the weights of the blocks.
+struct MSurfSamplingTable {
+  float scale;
+  int int_scale;
+  BlockSamples row_offsets[kNumBlocks];
+  BlockSamples col_offsets[kNumBlocks];
+  BlockSamples weights[kNumBlocks];
+  float block_weights[kNumBlocks];
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+void BuildSamplingTable(float scale, MSurfSamplingTable *table) {
+  table->scale = scale;
+  table->int_scale = lround(2*scale);
+
+  Matrix<float, 2*kHalfRegion, 1> gaussian;
+  for (int i = -kHalfRegion; i < kHalfRegion; ++i) {
+    gaussian(i + kHalfRegion) = Gaussian(i, 2*scale);
+  }
+
+  int block = 0;
+  for (int row = -kHalfRegion; row < kHalfRegion - kBlocks;
+       row += (kSamplesPerBlock - kBlocks)) {
+    for (int col = -kHalfRegion; col < kHalfRegion - kBlocks;
+         col += (kSamplesPerBlock - kBlocks), ++block) {
+      table->row_offsets[block].setZero();
+      table->col_offsets[block].setZero();
+      table->weights[block].setZero();
+      int sample = 0;
+      for (int r = row; r < row + kSamplesPerBlock; ++r) {
+        for (int c = col; c < col + kSamplesPerBlock; ++c, ++sample) {
+          table->row_offsets[block](sample) = r*scale;
+          table->col_offsets[block](sample) = c*scale;
+          table->weights[block](sample) = gaussian(r + kHalfRegion)
+                                        * gaussian(c + kHalfRegion);
+        }
+      }
+      table->block_weights[block] =
+          Gaussian2D(row/kHalfRegion, col/kHalfRegion, 1.0f);
+    }
+  }
+}
+
+// Same as MSURFDescriptor<4, 9>, with the sampling pattern taken from table.
+// Upright descriptors are sampled on the unrotated grid, as if the
+// orientation of the feature was 0.
+void MSURFDescriptorFromTable(const Matu &integral_image,
+                              const MSurfSamplingTable &table,
+                              const PointFeature &feature,
+                              bool upright,
+                              Vecf *descriptor) {
+  float x = feature.x();
+  float y = feature.y();
+
+  BlockSamples rrx, rry;
+  if (upright) {
+    for (int block = 0; block < kNumBlocks; ++block) {
+      const BlockSamples &rs = table.row_offsets[block];
+      const BlockSamples &cs = table.col_offsets[block];
+      for (int i = 0; i < kBlockSamples; ++i) {
+        int sample_col = lround(x + cs(i));
+        int sample_row = lround(y + rs(i));
+        rrx(i) = HarrX(integral_image, sample_row, sample_col, table.int_scale);
+        rry(i) = HarrY(integral_image, sample_row, sample_col, table.int_scale);
+      }
+      BlockSamples dx = table.weights[block] * rry;
+      BlockSamples dy = table.weights[block] * rrx;
+      Vec4f components(dx.sum(), dy.sum(), dx.abs().sum(), dy.abs().sum());
+      (*descriptor).segment<4>(4 * block) =
+          components * table.block_weights[block];
+    }
+    descriptor->normalize();
+    return;
+  }
+
+  float co = cos(feature.orientation);
+  float si = sin(feature.orientation);
+  for (int block = 0; block < kNumBlocks; ++block) {
+    const BlockSamples &rs = table.row_offsets[block];
+    const BlockSamples &cs = table.col_offsets[block];
+    // Haar responses on the sample points of the rotated grid.
+    for (int i = 0; i < kBlockSamples; ++i) {
+      int sample_col = lround(x + (-rs(i)*si + cs(i)*co));
+      int sample_row = lround(y + ( rs(i)*co + cs(i)*si));
+      rrx(i) = HarrX(integral_image, sample_row, sample_col, table.int_scale);
+      rry(i) = HarrY(integral_image, sample_row, sample_col, table.int_scale);
+    }
+    // Responses on the rotated axis, weighted and accumulated.
+    BlockSamples dx = table.weights[block] * (co*rry - si*rrx);
+    BlockSamples dy = table.weights[block] * (si*rry + co*rrx);
+    Vec4f components(dx.sum(), dy.sum(), dx.abs().sum(), dy.abs().sum());
+    (*descriptor).segment<4>(4 * block) =
+        components * table.block_weights[block];
+  }
+  descriptor->normalize();
+}
+
+// Describes the features of a contiguous range of the scale sorted order,
+// rebuilding the sampling table only when the scale changes. Range i only
+// writes the descriptors of its own features.
+struct DescribeRange {
+  const Matu *integral_image;
+  const vector<Feature *> *features;
+  const vector<std::pair<float, int> > *order;
+  int num_ranges;
+  bool upright;
+  vector<Descriptor *> *descriptors;
+
+  void operator()(int range) const {
+    int size = order->size();
+    int begin = size * range / num_ranges;
+    int end = size * (range + 1) / num_ranges;
+    MSurfSamplingTable *table = new MSurfSamplingTable;
+    for (int i = begin; i < end; ++i) {
+      float scale = (*order)[i].first;
+      int feature = (*order)[i].second;
+      if (i == begin || scale != table->scale) {
+        BuildSamplingTable(scale, table);
+      }
+      VecfDescriptor *descriptor = new VecfDescriptor(64);
+      MSURFDescriptorFromTable(*integral_image, *table,
+                               *static_cast<PointFeature *>((*features)[feature]),
+                               upright, &descriptor->coords);
+      (*descriptors)[feature] = descriptor;
+    }
+    delete table;
+  }
+};
+
+}  // namespace
+
+// Computes MSURFDescriptor<4, 9> for all the features at once: the features
+// are sorted by scale so that the sampling pattern and weights are computed
+// once per scale, and the features are split between num_threads threads
+// sharing the integral image.
 class SurfDescriber : public Describer {
  public:
+  SurfDescriber(int num_threads, bool upright)
+      : num_threads_(num_threads), upright_(upright) {}
+
   virtual void Describe(const vector<Feature *> &features,
                         const Image &image,
                         const detector::DetectorData *detector_data,
-                        vector<Descriptor *> *descriptors) {
-    // TODO(keir): Make the descriptor data the SURF detector integral image.
-    (void) detector_data;
-
-    Matu integral_image;
-    IntegralImage(*(image.AsArray3Du()), &integral_image);
+                        vector<Descriptor *> *descriptors) const {
+    LIBMV_SCOPED_TIMER("describe.surf");
+    // The integral image of the SURF detector, if it comes from it.
+    const detector::FrameCache *cache =
+        dynamic_cast<const detector::FrameCache *>(detector_data);
+    Matu own_integral_image;
+    const Matu *integral_image = &own_integral_image;
+    if (cache && cache->IsOf(image)) {
+      integral_image = &cache->Integral();
+    } else {
+      IntegralImage(*(image.AsArray3Du()), &own_integral_image);
+    }
 
     descriptors->resize(features.size());
+    vector<std::pair<float, int> > order;
     for (int i = 0; i < features.size(); ++i) {
       PointFeature *point = dynamic_cast<PointFeature *>(features[i]);
-      VecfDescriptor *descriptor = NULL;
+      (*descriptors)[i] = NULL;
       if (point) {
-        descriptor = new VecfDescriptor(64);
-        MSURFDescriptor<4, 9>(integral_image, *point, &descriptor->coords);
+        order.push_back(std::make_pair(point->scale, i));
       }
-      (*descriptors)[i] = descriptor;
     }
+    std::sort(order.begin(), order.end());
+
+    DescribeRange describe;
+    describe.integral_image = integral_image;
+    describe.features = &features;
+    describe.order = &order;
+    describe.num_ranges = std::max(1, std::min(num_threads_,
+                                               int(order.size())));
+    describe.upright = upright_;
+    describe.descriptors = descriptors;
+    ParallelFor(0, describe.num_ranges, describe.num_ranges, &describe);
   }
+
+ private:
+  int num_threads_;
+  bool upright_;
 };
 
-Describer *CreateSurfDescriber() {
-  return new SurfDescriber;
+Describer *CreateSurfDescriber(int num_threads, bool upright) {
+  return new SurfDescriber(num_threads, upright);
 }
 
 }  // namespace descriptor
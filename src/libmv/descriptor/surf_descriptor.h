@@ -28,8 +28,13 @@ class Describer;
 
 /**
  * Creates a SURF describer.
+ *
+ * \param num_threads The number of threads the features are described on.
+ * \param upright     If true, the orientation of the features is ignored and
+ *                    the descriptors are sampled on the unrotated grid
+ *                    (U-SURF), for sequences which do not rotate.
  */
-Describer *CreateSurfDescriber();
+Describer *CreateSurfDescriber(int num_threads = 1, bool upright = false);
 
 }  // namespace descriptor
 }  // namespace libmv
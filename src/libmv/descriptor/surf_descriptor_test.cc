@@ -0,0 +1,140 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/base/scoped_ptr.h"
+#include "libmv/base/vector.h"
+#include "libmv/base/vector_utils.h"
+#include "libmv/correspondence/feature.h"
+#include "libmv/descriptor/descriptor.h"
+#include "libmv/descriptor/surf_descriptor.h"
+#include "libmv/descriptor/vector_descriptor.h"
+#include "libmv/detector/frame_cache.h"
+#include "libmv/image/image.h"
+#include "testing/testing.h"
+
+namespace libmv {
+namespace descriptor {
+namespace {
+
+// Smooth random blobs, and features at a few scales and orientations.
+void MakeImageAndFeatures(Array3Du *image, vector<Feature *> *features) {
+  image->Resize(80, 100);
+  for (int r = 0; r < image->Height(); ++r) {
+    for (int c = 0; c < image->Width(); ++c) {
+      (*image)(r, c) = 128 + 60 * sin(0.3 * c) * cos(0.17 * r + 0.05 * c);
+    }
+  }
+  const float scales[] = { 1.2f, 2.0f, 1.2f, 1.6f, 2.0f, 1.2f };
+  for (int i = 0; i < 6; ++i) {
+    PointFeature *feature = new PointFeature(20 + 10 * i, 25 + 5 * i);
+    feature->scale = scales[i];
+    feature->orientation = 0.4 * i;
+    features->push_back(feature);
+  }
+}
+
+TEST(SurfDescriber, ThreadsGiveTheSameDescriptors) {
+  Array3Du array;
+  vector<Feature *> features;
+  MakeImageAndFeatures(&array, &features);
+  Image image(new Array3Du(array));
+
+  scoped_ptr<Describer> serial(CreateSurfDescriber());
+  scoped_ptr<Describer> parallel(CreateSurfDescriber(4));
+  vector<Descriptor *> descriptors, parallel_descriptors;
+  serial->Describe(features, image, NULL, &descriptors);
+  parallel->Describe(features, image, NULL, &parallel_descriptors);
+
+  ASSERT_EQ(features.size(), descriptors.size());
+  ASSERT_EQ(features.size(), parallel_descriptors.size());
+  for (int i = 0; i < descriptors.size(); ++i) {
+    Vecf &coords = static_cast<VecfDescriptor *>(descriptors[i])->coords;
+    Vecf &parallel_coords =
+        static_cast<VecfDescriptor *>(parallel_descriptors[i])->coords;
+    ASSERT_EQ(64, coords.size());
+    EXPECT_NEAR(1.0, coords.norm(), 1e-5);
+    for (int j = 0; j < 64; ++j) {
+      EXPECT_EQ(coords(j), parallel_coords(j));
+    }
+  }
+  DeleteElements(&features);
+  DeleteElements(&descriptors);
+  DeleteElements(&parallel_descriptors);
+}
+
+TEST(SurfDescriber, FrameCacheGivesTheSameDescriptors) {
+  Array3Du array;
+  vector<Feature *> features;
+  MakeImageAndFeatures(&array, &features);
+  Image image(new Array3Du(array));
+
+  scoped_ptr<Describer> describer(CreateSurfDescriber());
+  detector::FrameCache cache(image);
+  vector<Descriptor *> descriptors, cached_descriptors;
+  describer->Describe(features, image, NULL, &descriptors);
+  describer->Describe(features, image, &cache, &cached_descriptors);
+  EXPECT_LT(0, cache.MemorySizeInBytes());
+
+  ASSERT_EQ(descriptors.size(), cached_descriptors.size());
+  for (int i = 0; i < descriptors.size(); ++i) {
+    Vecf &coords = static_cast<VecfDescriptor *>(descriptors[i])->coords;
+    Vecf &cached_coords =
+        static_cast<VecfDescriptor *>(cached_descriptors[i])->coords;
+    for (int j = 0; j < 64; ++j) {
+      EXPECT_EQ(coords(j), cached_coords(j));
+    }
+  }
+  DeleteElements(&features);
+  DeleteElements(&descriptors);
+  DeleteElements(&cached_descriptors);
+}
+
+TEST(SurfDescriber, UprightIgnoresTheOrientation) {
+  Array3Du array;
+  vector<Feature *> features;
+  MakeImageAndFeatures(&array, &features);
+  Image image(new Array3Du(array));
+
+  scoped_ptr<Describer> upright(CreateSurfDescriber(1, true));
+  scoped_ptr<Describer> describer(CreateSurfDescriber());
+  vector<Descriptor *> upright_descriptors, descriptors;
+  upright->Describe(features, image, NULL, &upright_descriptors);
+  for (int i = 0; i < features.size(); ++i) {
+    static_cast<PointFeature *>(features[i])->orientation = 0;
+  }
+  describer->Describe(features, image, NULL, &descriptors);
+
+  ASSERT_EQ(descriptors.size(), upright_descriptors.size());
+  for (int i = 0; i < descriptors.size(); ++i) {
+    Vecf &coords = static_cast<VecfDescriptor *>(descriptors[i])->coords;
+    Vecf &upright_coords =
+        static_cast<VecfDescriptor *>(upright_descriptors[i])->coords;
+    for (int j = 0; j < 64; ++j) {
+      EXPECT_EQ(coords(j), upright_coords(j));
+    }
+  }
+  DeleteElements(&features);
+  DeleteElements(&descriptors);
+  DeleteElements(&upright_descriptors);
+}
+
+}  // namespace
+}  // namespace descriptor
+}  // namespace libmv
@@ -0,0 +1,344 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "libmv/base/scoped_ptr.h"
+#include "libmv/base/thread.h"
+#include "libmv/base/vector.h"
+#include "libmv/correspondence/feature.h"
+#include "libmv/detector/censure_detector.h"
+#include "libmv/detector/detector.h"
+#include "libmv/detector/frame_cache.h"
+#include "libmv/detector/orientation_detector.h"
+#include "libmv/image/image.h"
+#include "libmv/image/non_maximal_suppression.h"
+#include "libmv/logging/logging.h"
+#include "libmv/numeric/numeric.h"
+
+namespace libmv {
+namespace detector {
+
+namespace {
+
+// The half sizes of the boxes, and the (outer, inner) boxes of the bilevel
+// filters, as in the STAR detector.
+const int kBoxSizes[] = {1, 2, 3, 4, 6, 8, 11, 12, 16, 22, 23, 32, 45, 46,
+                         64, 90, 128};
+const int kNumBoxes = sizeof(kBoxSizes) / sizeof(kBoxSizes[0]);
+const int kFilters[][2] = {{1, 0}, {3, 1}, {4, 2}, {5, 3}, {7, 4}, {8, 5},
+                           {9, 6}, {11, 8}, {13, 10}, {14, 11}, {15, 12},
+                           {16, 14}};
+const int kMaxFilters = sizeof(kFilters) / sizeof(kFilters[0]);
+
+// The size of the non maximum suppression window, and the thresholds of the
+// line suppression of STAR.
+const int kNonMaxWidth = 5;
+const float kLineThresholdProjected = 10;
+const int kLineThresholdBinarized = 8;
+
+// box[r] = the sum of the (2s + 1) x (2s + 1) box centered on (r, c) for r in
+// [begin, end), where right and left are the columns c + s and c - s - 1 of
+// the column major integral image. The unsigned sums wrap around on large
+// images, but their differences do not.
+void BoxSums(const unsigned int *right, const unsigned int *left, int s,
+             int begin, int end, float *box) {
+  int r = begin;
+#ifdef __SSE2__
+  for (; r + 4 <= end; r += 4) {
+    __m128i a = _mm_loadu_si128((const __m128i *)(right + r + s));
+    __m128i b = _mm_loadu_si128((const __m128i *)(right + r - s - 1));
+    __m128i c = _mm_loadu_si128((const __m128i *)(left + r + s));
+    __m128i d = _mm_loadu_si128((const __m128i *)(left + r - s - 1));
+    __m128i sum = _mm_add_epi32(_mm_sub_epi32(a, b), _mm_sub_epi32(d, c));
+    _mm_storeu_ps(box + r, _mm_cvtepi32_ps(sum));
+  }
+#endif
+  for (; r < end; ++r) {
+    unsigned int sum = right[r + s] - right[r - s - 1]
+                     - left[r + s] + left[r - s - 1];
+    box[r] = float(int(sum));
+  }
+}
+
+// Where the filter inner_weight * inner - outer_weight * outer responds more
+// strongly than response, i.e. in absolute value, replaces response and size.
+void KeepStrongerResponses(const float *inner, const float *outer,
+                           float inner_weight, float outer_weight,
+                           float filter_size, int begin, int end,
+                           float *response, float *size) {
+  int r = begin;
+#ifdef __SSE2__
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  const __m128 iw = _mm_set1_ps(inner_weight);
+  const __m128 ow = _mm_set1_ps(outer_weight);
+  const __m128 fs = _mm_set1_ps(filter_size);
+  for (; r + 4 <= end; r += 4) {
+    __m128 value = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(inner + r), iw),
+                              _mm_mul_ps(_mm_loadu_ps(outer + r), ow));
+    __m128 best = _mm_loadu_ps(response + r);
+    __m128 stronger = _mm_cmpgt_ps(_mm_andnot_ps(sign, value),
+                                   _mm_andnot_ps(sign, best));
+    _mm_storeu_ps(response + r, _mm_or_ps(_mm_and_ps(stronger, value),
+                                          _mm_andnot_ps(stronger, best)));
+    __m128 best_size = _mm_loadu_ps(size + r);
+    _mm_storeu_ps(size + r, _mm_or_ps(_mm_and_ps(stronger, fs),
+                                      _mm_andnot_ps(stronger, best_size)));
+  }
+#endif
+  for (; r < end; ++r) {
+    float value = inner[r] * inner_weight - outer[r] * outer_weight;
+    if (std::fabs(value) > std::fabs(response[r])) {
+      response[r] = value;
+      size[r] = filter_size;
+    }
+  }
+}
+
+// Computes the strongest response of the filters, and its size, for the
+// columns of a block. The responses are transposed: the column c of the image
+// is the row c of responses and sizes.
+struct ResponseColumns {
+  void operator()(int block) {
+    int rows = integral->rows(), cols = integral->cols();
+    int num_columns = cols - 2 * border;
+    int begin = border + (num_columns * block) / num_blocks;
+    int end   = border + (num_columns * (block + 1)) / num_blocks;
+
+    bool used[kNumBoxes] = {false};
+    for (int i = 0; i < num_filters; ++i) {
+      used[kFilters[i][0]] = used[kFilters[i][1]] = true;
+    }
+    vector<vector<float> > boxes(kNumBoxes);
+    for (int i = 0; i < kNumBoxes; ++i) {
+      if (used[i]) {
+        boxes[i].resize(rows);
+      }
+    }
+
+    const unsigned int *data = integral->data();
+    for (int c = begin; c < end; ++c) {
+      for (int i = 0; i < kNumBoxes; ++i) {
+        if (used[i]) {
+          int s = kBoxSizes[i];
+          BoxSums(data + (c + s) * rows, data + (c - s - 1) * rows, s,
+                  border, rows - border, &boxes[i][0]);
+        }
+      }
+      float *response = &(*responses)(c, 0);
+      float *size = &(*sizes)(c, 0);
+      for (int i = 0; i < num_filters; ++i) {
+        KeepStrongerResponses(&boxes[kFilters[i][1]][0],
+                              &boxes[kFilters[i][0]][0],
+                              inner_weights[i], outer_weights[i],
+                              filter_sizes[i], border, rows - border,
+                              response, size);
+      }
+    }
+  }
+
+  const Matu *integral;
+  int border;
+  int num_blocks;
+  int num_filters;
+  float inner_weights[kMaxFilters];
+  float outer_weights[kMaxFilters];
+  float filter_sizes[kMaxFilters];
+  Array3Df *responses;
+  Array3Df *sizes;
+};
+
+// Whether the extremum at (row, col) lies on an edge rather than on a blob,
+// from the second moments of the gradients of the responses and of the
+// filter sizes around it, as the line suppression of STAR. The test does not
+// change when the images are transposed.
+bool IsOnLine(const Array3Df &responses, const Array3Df &sizes,
+              int row, int col) {
+  float size = sizes(row, col);
+  int delta = int(size) / 4, radius = delta * 4;
+  float lxx = 0, lyy = 0, lxy = 0;
+  for (int r = row - radius; r <= row + radius; r += delta) {
+    for (int c = col - radius; c <= col + radius; c += delta) {
+      float lx = responses(r, c + 1) - responses(r, c - 1);
+      float ly = responses(r + 1, c) - responses(r - 1, c);
+      lxx += lx * lx;
+      lyy += ly * ly;
+      lxy += lx * ly;
+    }
+  }
+  if ((lxx + lyy) * (lxx + lyy) >=
+      kLineThresholdProjected * (lxx * lyy - lxy * lxy)) {
+    return true;
+  }
+
+  int lxxb = 0, lyyb = 0, lxyb = 0;
+  for (int r = row - radius; r <= row + radius; r += delta) {
+    for (int c = col - radius; c <= col + radius; c += delta) {
+      int lx = (sizes(r, c + 1) == size) - (sizes(r, c - 1) == size);
+      int ly = (sizes(r + 1, c) == size) - (sizes(r - 1, c) == size);
+      lxxb += lx * lx;
+      lyyb += ly * ly;
+      lxyb += lx * ly;
+    }
+  }
+  return (lxxb + lyyb) * (lxxb + lyyb) >=
+         kLineThresholdBinarized * (lxxb * lyyb - lxyb * lxyb);
+}
+
+// Whether a pixel of the window before (row, col) in raster order has the
+// same value, so that only the first pixel of a plateau is kept.
+bool IsPlateauRepeat(const Array3Df &f, int row, int col) {
+  const int half = kNonMaxWidth / 2;
+  float value = f(row, col);
+  for (int r = row - half; r <= row; ++r) {
+    for (int c = col - half; c <= col + half; ++c) {
+      if (r == row && c == col) {
+        return false;
+      }
+      if (f(r, c) == value) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+class CensureDetector : public Detector {
+ public:
+  CensureDetector(int max_size, float response_threshold,
+                  bool rotation_invariant)
+    : max_size_(max_size), response_threshold_(response_threshold),
+      rotation_invariant_(rotation_invariant) {}
+  virtual ~CensureDetector() {}
+
+  virtual void Detect(const Image &image,
+                      vector<Feature *> *features,
+                      DetectorData **data) const {
+    LIBMV_SCOPED_TIMER("detect.censure");
+    scoped_ptr<FrameCache> cache(new FrameCache(image));
+    const Matu &integral = cache->Integral();
+    int rows = integral.rows(), cols = integral.cols();
+
+    // The filters up to the first one of max_size, whose outer box fits in
+    // the image.
+    int num_filters = 0;
+    while (num_filters < kMaxFilters) {
+      int s = kBoxSizes[kFilters[num_filters][0]];
+      if (2 * s + 2 >= std::min(rows, cols)) {
+        break;
+      }
+      ++num_filters;
+      if (s >= max_size_) {
+        break;
+      }
+    }
+
+    if (num_filters > 0) {
+      // The responses are transposed so that, as in the column major integral
+      // image, the columns of the image are contiguous.
+      Array3Df responses(cols, rows, 1), sizes(cols, rows, 1);
+      responses.Fill(0);
+      sizes.Fill(0);
+
+      ResponseColumns columns;
+      columns.integral = &integral;
+      columns.border = kBoxSizes[kFilters[num_filters - 1][0]] + 1;
+      columns.num_blocks = NumThreads();
+      columns.num_filters = num_filters;
+      for (int i = 0; i < num_filters; ++i) {
+        int inner = 2 * kBoxSizes[kFilters[i][1]] + 1;
+        int outer = 2 * kBoxSizes[kFilters[i][0]] + 1;
+        float ring_area = outer * outer - inner * inner;
+        columns.inner_weights[i] = 1.0f / (inner * inner) + 1.0f / ring_area;
+        columns.outer_weights[i] = 1.0f / ring_area;
+        columns.filter_sizes[i] = kBoxSizes[kFilters[i][0]];
+      }
+      // Negate the sizes at the ends of the range, so that the features of
+      // the smallest and largest filters, which are not extrema across
+      // scales, are rejected.
+      columns.filter_sizes[0] = -columns.filter_sizes[0];
+      columns.filter_sizes[num_filters - 1] =
+          -std::fabs(columns.filter_sizes[num_filters - 1]);
+      columns.responses = &responses;
+      columns.sizes = &sizes;
+      ParallelFor(0, columns.num_blocks, &columns);
+
+      Array3Df magnitudes(cols, rows, 1);
+      for (int i = 0; i < magnitudes.Size(); ++i) {
+        magnitudes.Data()[i] = std::fabs(responses.Data()[i]);
+      }
+      vector<Vec2i> maxima;
+      FindLocalMaximaMaxFilter(magnitudes, kNonMaxWidth,
+                               response_threshold_, &maxima);
+
+      for (int i = 0; i < maxima.size(); ++i) {
+        // Maxima are (x, y) in the transposed responses, i.e. (row, column)
+        // in the image.
+        int row = maxima[i](0), col = maxima[i](1);
+        float size = sizes(col, row);
+        if (size < 4 ||
+            IsPlateauRepeat(magnitudes, col, row) ||
+            IsOnLine(responses, sizes, col, row)) {
+          continue;
+        }
+        PointFeature *f = new PointFeature(col, row);
+        f->scale = size;
+        f->orientation = 0.0;
+        features->push_back(f);
+      }
+
+      if (rotation_invariant_) {
+        // Rotation response is more stable on response image.
+        FloatImage upright(rows, cols, 1);
+        for (int r = 0; r < rows; ++r) {
+          for (int c = 0; c < cols; ++c) {
+            upright(r, c) = responses(c, r);
+          }
+        }
+        gradientBoxesRotationEstimation(upright, *features);
+      }
+    }
+
+    if (data) {
+      *data = cache.release();
+    }
+  }
+
+ private:
+  int max_size_;
+  float response_threshold_;
+  bool rotation_invariant_;
+};
+
+Detector *CreateCensureDetector(int max_size,
+                                float response_threshold,
+                                bool rotation_invariant) {
+  return new CensureDetector(max_size, response_threshold,
+                             rotation_invariant);
+}
+
+}  // namespace detector
+}  // namespace libmv
@@ -0,0 +1,52 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_DETECTOR_CENSURE_DETECTOR_H
+#define LIBMV_DETECTOR_CENSURE_DETECTOR_H
+
+namespace libmv {
+namespace detector {
+
+class Detector;
+
+/**
+ * Creates a detector of center surround extrema (CenSurE, Agrawal et al.
+ * "CenSurE: Center Surround Extremas for Realtime Feature Detection and
+ * Matching", ECCV 2008), on the scales of the STAR detector.
+ *
+ * The bilevel responses of all the scales are computed a column at a time
+ * from the integral image of the shared FrameCache, which is returned as the
+ * detector data, and the extrema are found by the SIMD max filter of
+ * FindLocalMaximaMaxFilter(). The filters are upright boxes rather than the
+ * octagons of STAR, which need tilted integral images.
+ *
+ * \param max_size The half size of the largest filter explored, in pixels.
+ * \param response_threshold The minimum absolute response of a feature.
+ * \param rotation_invariant Tell if orientation of detected features must
+ *                           be estimated.
+ */
+Detector *CreateCensureDetector(int max_size = 45,
+                                float response_threshold = 30,
+                                bool rotation_invariant = false);
+
+}  // namespace detector
+}  // namespace libmv
+
+#endif  // LIBMV_DETECTOR_CENSURE_DETECTOR_H
@@ -0,0 +1,161 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cmath>
+
+#include "libmv/base/scoped_ptr.h"
+#include "libmv/base/thread.h"
+#include "libmv/base/vector.h"
+#include "libmv/base/vector_utils.h"
+#include "libmv/correspondence/feature.h"
+#include "libmv/detector/censure_detector.h"
+#include "libmv/detector/detector.h"
+#include "libmv/detector/detector_factory.h"
+#include "libmv/detector/frame_cache.h"
+#include "libmv/image/image.h"
+#include "testing/testing.h"
+
+namespace libmv {
+namespace detector {
+namespace {
+
+void DrawDisk(float x, float y, float radius, int value, Array3Du *image) {
+  for (int r = 0; r < image->Height(); ++r) {
+    for (int c = 0; c < image->Width(); ++c) {
+      if ((c - x) * (c - x) + (r - y) * (r - y) <= radius * radius) {
+        (*image)(r, c) = value;
+      }
+    }
+  }
+}
+
+// A dark and a bright blob on a gray background.
+Array3Du *TwoBlobs() {
+  Array3Du *array = new Array3Du(130, 170);
+  array->fill(128);
+  DrawDisk(50, 60, 4, 20, array);     // Dark blob.
+  DrawDisk(115, 70, 9, 240, array);   // Bright blob.
+  return array;
+}
+
+TEST(CensureDetector, FindsDarkAndBrightBlobs) {
+  Image image(TwoBlobs());
+  scoped_ptr<Detector> detector(detectorFactory(CENSURE_DETECTOR));
+  vector<Feature *> features;
+  DetectorData *data = NULL;
+  detector->Detect(image, &features, &data);
+
+  int dark = 0, bright = 0;
+  for (int i = 0; i < features.size(); ++i) {
+    PointFeature *point = static_cast<PointFeature *>(features[i]);
+    EXPECT_EQ(0, point->orientation);
+    if (fabs(point->x() - 50) <= 1 && fabs(point->y() - 60) <= 1) {
+      EXPECT_LE(4, point->scale);
+      EXPECT_GE(8, point->scale);
+      ++dark;
+    } else if (fabs(point->x() - 115) <= 1 && fabs(point->y() - 70) <= 1) {
+      EXPECT_LE(8, point->scale);
+      EXPECT_GE(16, point->scale);
+      ++bright;
+    }
+  }
+  EXPECT_EQ(1, dark);
+  EXPECT_EQ(1, bright);
+  EXPECT_EQ(2, features.size());
+  DeleteElements(&features);
+
+  // The integral image is shared with the describers.
+  FrameCache *cache = dynamic_cast<FrameCache *>(data);
+  ASSERT_TRUE(cache != NULL);
+  EXPECT_TRUE(cache->IsOf(image));
+  delete data;
+}
+
+TEST(CensureDetector, TransposedImageGivesTransposedFeatures) {
+  Array3Du *array = TwoBlobs();
+  DrawDisk(40, 100, 6, 200, array);
+  DrawDisk(140, 30, 3, 60, array);
+  Array3Du *transposed = new Array3Du(array->Width(), array->Height());
+  for (int r = 0; r < array->Height(); ++r) {
+    for (int c = 0; c < array->Width(); ++c) {
+      (*transposed)(c, r) = (*array)(r, c);
+    }
+  }
+  Image image(array), image_transposed(transposed);
+
+  scoped_ptr<Detector> detector(CreateCensureDetector());
+  vector<Feature *> features, features_transposed;
+  detector->Detect(image, &features, NULL);
+  detector->Detect(image_transposed, &features_transposed, NULL);
+
+  EXPECT_LE(2, features.size());
+  ASSERT_EQ(features.size(), features_transposed.size());
+  for (int i = 0; i < features.size(); ++i) {
+    PointFeature *a = static_cast<PointFeature *>(features[i]);
+    bool found = false;
+    for (int j = 0; j < features_transposed.size(); ++j) {
+      PointFeature *b = static_cast<PointFeature *>(features_transposed[j]);
+      if (a->x() == b->y() && a->y() == b->x() && a->scale == b->scale) {
+        found = true;
+      }
+    }
+    EXPECT_TRUE(found);
+  }
+  DeleteElements(&features);
+  DeleteElements(&features_transposed);
+}
+
+TEST(CensureDetector, SameFeaturesWithAnyNumberOfThreads) {
+  Image image(TwoBlobs());
+  scoped_ptr<Detector> detector(CreateCensureDetector());
+  int num_threads = NumThreads();
+
+  vector<Feature *> serial, parallel;
+  SetNumThreads(1);
+  detector->Detect(image, &serial, NULL);
+  SetNumThreads(4);
+  detector->Detect(image, &parallel, NULL);
+  SetNumThreads(num_threads);
+
+  ASSERT_EQ(serial.size(), parallel.size());
+  for (int i = 0; i < serial.size(); ++i) {
+    PointFeature *a = static_cast<PointFeature *>(serial[i]);
+    PointFeature *b = static_cast<PointFeature *>(parallel[i]);
+    EXPECT_EQ(a->x(), b->x());
+    EXPECT_EQ(a->y(), b->y());
+    EXPECT_EQ(a->scale, b->scale);
+  }
+  DeleteElements(&serial);
+  DeleteElements(&parallel);
+}
+
+TEST(CensureDetector, ImageSmallerThanTheFilters) {
+  Array3Du *array = new Array3Du(5, 5);
+  array->fill(0);
+  Image image(array);
+  scoped_ptr<Detector> detector(CreateCensureDetector());
+  vector<Feature *> features;
+  detector->Detect(image, &features, NULL);
+  EXPECT_EQ(0, features.size());
+}
+
+}  // namespace
+}  // namespace detector
+}  // namespace libmv
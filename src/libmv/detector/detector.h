@@ -41,6 +41,10 @@ class DetectorData {
 
 /**
  * Interface for feature detectors.
+ *
+ * Detect() is const and keeps its scratch memory to the call: a detector
+ * only holds its configuration once created, so one instance can detect the
+ * features of several images at once from different threads.
  */
 class Detector {
  public:
@@ -67,7 +71,7 @@ class Detector {
    */
   virtual void Detect(const Image &image,
                       vector<Feature *> *features,
-                      DetectorData **data) = 0;
+                      DetectorData **data) const = 0;
 };
 
 }  // namespace detector
@@ -18,9 +18,11 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include "libmv/detector/censure_detector.h"
 #include "libmv/detector/detector.h"
 #include "libmv/detector/detector_factory.h"
 #include "libmv/detector/fast_detector.h"
+#include "libmv/detector/mser_detector.h"
 #include "libmv/detector/star_detector.h"
 #include "libmv/detector/surf_detector.h"
 #include "libmv/logging/logging.h"
@@ -38,6 +40,9 @@ Detector *detectorFactory(eDetector edetector)  {
   case FAST_LIMITED_DETECTOR:
     return detector::CreateFastDetectorLimited();
     break;
+  case FAST_PYRAMID_DETECTOR:
+    return detector::CreateFastDetectorPyramid();
+    break;
   case SURF_DETECTOR:
     return detector::CreateSURFDetector();
     break;
@@ -46,6 +51,12 @@ Detector *detectorFactory(eDetector edetector)  {
     break;
   case MSER_DETECTOR:
     break;
+  case MSER_LINEAR_DETECTOR:
+    return detector::CreateMserDetectorLinear();
+    break;
+  case CENSURE_DETECTOR:
+    return detector::CreateCensureDetector();
+    break;
   default:
     LOG(FATAL) << "ERROR : undefined Detector value : " << edetector;
   }
@@ -30,9 +30,12 @@ enum eDetector
 {
   FAST_DETECTOR,
   FAST_LIMITED_DETECTOR,
+  FAST_PYRAMID_DETECTOR,
   SURF_DETECTOR,
   STAR_DETECTOR,
-  MSER_DETECTOR
+  MSER_DETECTOR,
+  MSER_LINEAR_DETECTOR,
+  CENSURE_DETECTOR
 };
 /**
  * Creates the corresponding detector.
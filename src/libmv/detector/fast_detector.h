@@ -21,7 +21,13 @@
 #ifndef LIBMV_DETECTOR_FAST_DETECTOR_H
 #define LIBMV_DETECTOR_FAST_DETECTOR_H
 
+#include "libmv/base/vector.h"
+
 namespace libmv {
+
+class Feature;
+class FixedPointPyramid;
+
 namespace detector {
 
 class Detector;
@@ -60,6 +66,61 @@ Detector *CreateFastDetectorLimited(int threshold = 30,
                               bool bRotationInvariant = false,
                               int nKeypointMax = 256);
 
+/**
+ * Creates a detector that uses the FAST detection algorithm on a grid of
+ * cells, each detected independently on a tile grown by the support of the
+ * detector, so that the corners found are the ones of a whole image
+ * detection. Keeping the strongest corners of each cell spreads the features
+ * uniformly over the image. The implementation never returns detection data.
+ *
+ * \param size      The size of features to detect in pixels {9,10,11,12}.
+ * \param threshold Threshold for detecting features (barrier). See the FAST
+ *                  paper for details [1].
+ * \param bRotationInvariant Tell if orientation of detected features must
+ *                            be estimated.
+ * \param cell_size Side of the grid cells in pixels.
+ * \param nKeypointMaxPerCell How many points could be kept per cell, sorted
+ *                            by decreasing score (<= 0 keeps them all).
+ * \param num_threads Number of threads the cells are detected on.
+ */
+Detector *CreateFastDetectorTiled(int size = 9, int threshold = 30,
+                                  bool bRotationInvariant = false,
+                                  int cell_size = 64,
+                                  int nKeypointMaxPerCell = 16,
+                                  int num_threads = 1);
+
+/**
+ * Creates a detector that uses the FAST detection algorithm on the levels of
+ * the image pyramid tracked by the KLT, for corners at several scales. The
+ * pyramid is taken from a FrameCache, which is returned as detection data.
+ * See DetectFastInPyramid().
+ *
+ * \param size      The size of features to detect in pixels {9,10,11,12}.
+ * \param threshold Threshold for detecting features (barrier). See the FAST
+ *                  paper for details [1].
+ * \param bRotationInvariant Tell if orientation of detected features must
+ *                            be estimated.
+ * \param num_levels Number of pyramid levels, the first being the image.
+ */
+Detector *CreateFastDetectorPyramid(int size = 9, int threshold = 30,
+                                    bool bRotationInvariant = false,
+                                    int num_levels = 3);
+
+/**
+ * Detects the FAST corners of every level of pyramid, for callers which
+ * already have one. Each level is detected with its own non maximum
+ * suppression, then a corner is only kept if its score beats the ones of the
+ * corners of the levels above and below it within one pixel of the coarser
+ * of the two levels; a tie goes to the finer level.
+ *
+ * The features are in the coordinates of the first level, with a scale of
+ * 3 * 2^level as the single scale detector uses 3, and appended to features
+ * from the finest level to the coarsest. The caller owns them.
+ */
+void DetectFastInPyramid(const FixedPointPyramid &pyramid,
+                         int size, int threshold, bool bRotationInvariant,
+                         vector<Feature *> *features);
+
 }  // namespace detector
 }  // namespace libmv
 
@@ -88,7 +88,8 @@ class FastDetectorLimited : public Detector {
 
   virtual void Detect(const Image &image,
                       vector<Feature *> *features,
-                      DetectorData **data) {
+                      DetectorData **data) const {
+    LIBMV_SCOPED_TIMER("detect.fast_limited");
     int num_corners = 0;
     ByteImage *byte_image = image.AsArray3Du();
     if (byte_image) {
@@ -0,0 +1,232 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstdlib>
+#include <vector>
+
+#include "libmv/base/scoped_ptr.h"
+#include "libmv/base/vector.h"
+#include "libmv/correspondence/feature.h"
+#include "libmv/detector/detector.h"
+#include "libmv/detector/fast_detector.h"
+#include "libmv/detector/frame_cache.h"
+#include "libmv/detector/orientation_detector.h"
+#include "libmv/image/fixed_point_pyramid.h"
+#include "libmv/image/image.h"
+#include "libmv/logging/logging.h"
+#include "third_party/fast/fast.h"
+
+namespace libmv {
+namespace detector {
+
+typedef xy* (*FastDetectCall)(const unsigned char *, int, int, int, int, int *);
+typedef int* (*FastScoreCall)(const unsigned char *, int, xy *, int, int);
+
+namespace {
+
+struct ScoredCorner {
+  int x, y, score;
+};
+
+// The corners of one level after the non maximum suppression, and their
+// scores by pixel, -1 where there is no corner.
+struct LevelCorners {
+  int width, height;
+  vector<ScoredCorner> corners;
+  std::vector<int> scores;
+
+  int ScoreAt(int x, int y) const {
+    if (x < 0 || y < 0 || x >= width || y >= height) {
+      return -1;
+    }
+    return scores[y * width + x];
+  }
+};
+
+void DetectLevel(const ByteImage &image, FastDetectCall detect,
+                 FastScoreCall score, int threshold, LevelCorners *level) {
+  level->width = image.Width();
+  level->height = image.Height();
+  level->scores.assign(level->width * level->height, -1);
+
+  int num_corners = 0;
+  xy *detections = detect(image.Data(), image.Width(), image.Height(),
+                          image.Width(), threshold, &num_corners);
+  int *scores = score(image.Data(), image.Width(), detections, num_corners,
+                      threshold);
+  int num_nonmax = 0;
+  xy *nonmax = nonmax_suppression(detections, scores, num_corners,
+                                  &num_nonmax);
+  free(scores);
+  free(detections);
+
+  scores = score(image.Data(), image.Width(), nonmax, num_nonmax, threshold);
+  for (int i = 0; i < num_nonmax; ++i) {
+    ScoredCorner corner;
+    corner.x = nonmax[i].x;
+    corner.y = nonmax[i].y;
+    corner.score = scores[i];
+    level->corners.push_back(corner);
+    level->scores[corner.y * level->width + corner.x] = corner.score;
+  }
+  free(scores);
+  free(nonmax);
+}
+
+// Whether a corner of the level below beats corner, i.e. has a larger score
+// at pixel (u, v) with u / 2 and v / 2 within one pixel of corner.
+bool BeatenByFiner(const ScoredCorner &corner, const LevelCorners &finer) {
+  for (int v = 2 * corner.y - 2; v <= 2 * corner.y + 3; ++v) {
+    for (int u = 2 * corner.x - 2; u <= 2 * corner.x + 3; ++u) {
+      if (finer.ScoreAt(u, v) >= corner.score) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Same with the level above: ties go to the finer, so only a strictly
+// larger score beats corner.
+bool BeatenByCoarser(const ScoredCorner &corner,
+                     const LevelCorners &coarser) {
+  for (int y = corner.y / 2 - 1; y <= corner.y / 2 + 1; ++y) {
+    for (int x = corner.x / 2 - 1; x <= corner.x / 2 + 1; ++x) {
+      if (coarser.ScoreAt(x, y) > corner.score) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void DetectFastInPyramid(const FixedPointPyramid &pyramid,
+                         FastDetectCall detect, FastScoreCall score,
+                         int threshold, bool bRotationInvariant,
+                         vector<Feature *> *features) {
+  int num_levels = pyramid.NumLevels();
+  vector<LevelCorners> levels(num_levels);
+  for (int i = 0; i < num_levels; ++i) {
+    DetectLevel(pyramid.Level(i).image, detect, score, threshold, &levels[i]);
+  }
+
+  for (int i = 0; i < num_levels; ++i) {
+    // In the coordinates of the level until the orientation is estimated.
+    vector<Feature *> level_features;
+    const vector<ScoredCorner> &corners = levels[i].corners;
+    for (int j = 0; j < corners.size(); ++j) {
+      if ((i > 0 && BeatenByFiner(corners[j], levels[i - 1])) ||
+          (i + 1 < num_levels && BeatenByCoarser(corners[j], levels[i + 1]))) {
+        continue;
+      }
+      PointFeature *f = new PointFeature(corners[j].x, corners[j].y);
+      f->scale = 3.0 * (1 << i);
+      f->orientation = 0.0;
+      level_features.push_back(f);
+    }
+    if (bRotationInvariant) {
+      fastRotationEstimation(pyramid.Level(i).image, level_features);
+    }
+    // A pixel of level i covers 2^i x 2^i pixels of the first level.
+    float factor = 1 << i;
+    for (int j = 0; j < level_features.size(); ++j) {
+      PointFeature *f = (PointFeature *)level_features[j];
+      f->coords = (f->coords.array() + 0.5f) * factor - 0.5f;
+      features->push_back(f);
+    }
+  }
+}
+
+bool FastCalls(int size, FastDetectCall *detect, FastScoreCall *score) {
+  *detect = NULL;
+  *score = NULL;
+  if (size ==  9) { *detect =  fast9_detect; *score =  fast9_score; }
+  if (size == 10) { *detect = fast10_detect; *score = fast10_score; }
+  if (size == 11) { *detect = fast11_detect; *score = fast11_score; }
+  if (size == 12) { *detect = fast12_detect; *score = fast12_score; }
+  return *detect != NULL;
+}
+
+}  // namespace
+
+class FastDetectorPyramid : public Detector {
+ public:
+  virtual ~FastDetectorPyramid() {}
+  FastDetectorPyramid(FastDetectCall detect, FastScoreCall score,
+                      int threshold, bool bRotationInvariant, int num_levels)
+    : detect_(detect), score_(score), threshold_(threshold),
+      bRotationInvariant_(bRotationInvariant), num_levels_(num_levels) {}
+
+  virtual void Detect(const Image &image,
+                      vector<Feature *> *features,
+                      DetectorData **data) const {
+    LIBMV_SCOPED_TIMER("detect.fast_pyramid");
+    scoped_ptr<FrameCache> cache(NULL);
+    if (image.AsArray3Du()) {
+      cache.reset(new FrameCache(image));
+      DetectFastInPyramid(cache->Pyramid(num_levels_), detect_, score_,
+                          threshold_, bRotationInvariant_, features);
+    }
+    else  {
+      LOG(ERROR) << "Invalid input image type for FastDetectorPyramid detector";
+    }
+
+    // The describers can reuse the pyramid and the products it was built
+    // from.
+    if (data) {
+      *data = cache.release();
+    }
+  }
+
+ private:
+  FastDetectCall detect_;
+  FastScoreCall score_;
+  int threshold_; // Threshold called barrier in Fast paper (cf. [1]).
+  bool bRotationInvariant_;
+  int num_levels_;
+};
+
+Detector *CreateFastDetectorPyramid(int size, int threshold,
+                                    bool bRotationInvariant,
+                                    int num_levels) {
+  FastDetectCall detect;
+  FastScoreCall score;
+  if (!FastCalls(size, &detect, &score)) {
+    LOG(FATAL) << "Invalid size for FAST detector: " << size;
+  }
+  CHECK_GT(num_levels, 0);
+  return new FastDetectorPyramid(detect, score, threshold, bRotationInvariant,
+                                 num_levels);
+}
+
+void DetectFastInPyramid(const FixedPointPyramid &pyramid,
+                         int size, int threshold, bool bRotationInvariant,
+                         vector<Feature *> *features) {
+  FastDetectCall detect;
+  FastScoreCall score;
+  if (!FastCalls(size, &detect, &score)) {
+    LOG(FATAL) << "Invalid size for FAST detector: " << size;
+  }
+  DetectFastInPyramid(pyramid, detect, score, threshold, bRotationInvariant,
+                      features);
+}
+
+}  // namespace detector
+}  // namespace libmv
@@ -18,12 +18,19 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
 #include "libmv/base/scoped_ptr.h"
+#include "libmv/base/thread.h"
 #include "libmv/base/vector.h"
 #include "libmv/base/vector_utils.h"
 #include "libmv/correspondence/feature.h"
 #include "libmv/detector/fast_detector.h"
 #include "libmv/detector/detector.h"
+#include "libmv/detector/frame_cache.h"
+#include "libmv/image/fixed_point_pyramid.h"
 #include "libmv/image/image.h"
 #include "testing/testing.h"
 
@@ -98,6 +105,225 @@ TEST(FastDetector, Localisation2) {
   DeleteElements(&features);
 }
 
+// Noise with enough contrast for FAST to fire all over the image.
+void RandomImage(int width, int height, Array3Du *image) {
+  image->Resize(height, width);
+  unsigned seed = 1;
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      seed = seed * 1103515245u + 12345u;
+      (*image)(y, x) = (seed >> 16) & 0xff;
+    }
+  }
+}
+
+vector<std::pair<int, int> > SortedPositions(const vector<Feature *> &features) {
+  vector<std::pair<int, int> > positions;
+  for (int i = 0; i < features.size(); ++i) {
+    PointFeature *f = (PointFeature *)features[i];
+    positions.push_back(std::make_pair(int(f->y()), int(f->x())));
+  }
+  std::sort(positions.begin(), positions.end());
+  return positions;
+}
+
+TEST(FastDetectorTiled, SameCornersAsWholeImage) {
+  Array3Du image;
+  RandomImage(100, 70, &image);
+  Image im(new Array3Du(image));
+
+  scoped_ptr<Detector> whole(CreateFastDetector(9, 40));
+  vector<Feature *> expected;
+  whole->Detect(im, &expected, NULL);
+  ASSERT_GT(expected.size(), 20);
+
+  // Cells that divide neither dimension, all the corners of each cell.
+  scoped_ptr<Detector> tiled(CreateFastDetectorTiled(9, 40, false, 16, 0, 3));
+  vector<Feature *> features;
+  tiled->Detect(im, &features, NULL);
+
+  vector<std::pair<int, int> > expected_positions = SortedPositions(expected);
+  vector<std::pair<int, int> > positions = SortedPositions(features);
+  ASSERT_EQ(expected_positions.size(), positions.size());
+  for (int i = 0; i < positions.size(); ++i) {
+    EXPECT_EQ(expected_positions[i].first, positions[i].first);
+    EXPECT_EQ(expected_positions[i].second, positions[i].second);
+  }
+  DeleteElements(&expected);
+  DeleteElements(&features);
+}
+
+TEST(FastDetectorTiled, KeepsTheStrongestPerCell) {
+  Array3Du image;
+  RandomImage(64, 64, &image);
+  Image im(new Array3Du(image));
+
+  scoped_ptr<Detector> serial(CreateFastDetectorTiled(9, 40, false, 16, 2, 1));
+  scoped_ptr<Detector> parallel(
+      CreateFastDetectorTiled(9, 40, false, 16, 2, 4));
+  vector<Feature *> features, parallel_features;
+  serial->Detect(im, &features, NULL);
+  parallel->Detect(im, &parallel_features, NULL);
+
+  ASSERT_GT(features.size(), 16);
+  int per_cell[16] = { 0 };
+  for (int i = 0; i < features.size(); ++i) {
+    PointFeature *f = (PointFeature *)features[i];
+    per_cell[int(f->y()) / 16 * 4 + int(f->x()) / 16]++;
+  }
+  for (int i = 0; i < 16; ++i) {
+    EXPECT_LE(per_cell[i], 2);
+  }
+
+  // The threads do not change the result, nor its order.
+  ASSERT_EQ(features.size(), parallel_features.size());
+  for (int i = 0; i < features.size(); ++i) {
+    PointFeature *a = (PointFeature *)features[i];
+    PointFeature *b = (PointFeature *)parallel_features[i];
+    EXPECT_EQ(a->x(), b->x());
+    EXPECT_EQ(a->y(), b->y());
+  }
+  DeleteElements(&features);
+  DeleteElements(&parallel_features);
+}
+
+// Detects the features of one image per call with the same detector.
+struct DetectImage {
+  const Detector *detector;
+  const vector<Image> *images;
+  vector<vector<Feature *> > *features;
+
+  void operator()(int i) const {
+    detector->Detect((*images)[i], &(*features)[i], NULL);
+  }
+};
+
+TEST(FastDetector, SharedBetweenThreads) {
+  const int kNumImages = 8;
+  vector<Image> images;
+  for (int i = 0; i < kNumImages; ++i) {
+    Array3Du image;
+    RandomImage(60 + 4 * i, 50, &image);
+    images.push_back(Image(new Array3Du(image)));
+  }
+  scoped_ptr<Detector> detector(CreateFastDetectorTiled(9, 40, true, 16, 2, 2));
+
+  vector<vector<Feature *> > expected(kNumImages), features(kNumImages);
+  DetectImage detect;
+  detect.detector = detector.get();
+  detect.images = &images;
+  detect.features = &expected;
+  ParallelFor(0, kNumImages, 1, &detect);
+  detect.features = &features;
+  ParallelFor(0, kNumImages, 4, &detect);
+
+  for (int i = 0; i < kNumImages; ++i) {
+    ASSERT_EQ(expected[i].size(), features[i].size());
+    for (int j = 0; j < features[i].size(); ++j) {
+      PointFeature *a = (PointFeature *)expected[i][j];
+      PointFeature *b = (PointFeature *)features[i][j];
+      EXPECT_EQ(a->x(), b->x());
+      EXPECT_EQ(a->y(), b->y());
+      EXPECT_EQ(a->orientation, b->orientation);
+    }
+    DeleteElements(&expected[i]);
+    DeleteElements(&features[i]);
+  }
+}
+
+TEST(FastDetectorPyramid, OneLevelIsTheBlurredImage) {
+  Array3Du image;
+  RandomImage(100, 70, &image);
+  Image im(new Array3Du(image));
+
+  scoped_ptr<Detector> pyramid(CreateFastDetectorPyramid(9, 40, false, 1));
+  vector<Feature *> features;
+  DetectorData *data = NULL;
+  pyramid->Detect(im, &features, &data);
+  scoped_ptr<DetectorData> detector_data(data);
+
+  // The pyramid comes from the returned cache.
+  FrameCache *cache = dynamic_cast<FrameCache *>(data);
+  ASSERT_TRUE(cache != NULL);
+  EXPECT_TRUE(cache->IsOf(im));
+  const FixedPointPyramid &levels = cache->Pyramid(1);
+  ASSERT_EQ(1, levels.NumLevels());
+
+  scoped_ptr<Detector> whole(CreateFastDetector(9, 40));
+  vector<Feature *> expected;
+  whole->Detect(Image(new Array3Du(levels.Level(0).image)), &expected, NULL);
+  ASSERT_GT(expected.size(), 20);
+
+  vector<std::pair<int, int> > expected_positions = SortedPositions(expected);
+  vector<std::pair<int, int> > positions = SortedPositions(features);
+  ASSERT_EQ(expected_positions.size(), positions.size());
+  for (int i = 0; i < positions.size(); ++i) {
+    EXPECT_EQ(expected_positions[i].first, positions[i].first);
+    EXPECT_EQ(expected_positions[i].second, positions[i].second);
+  }
+  DeleteElements(&expected);
+  DeleteElements(&features);
+}
+
+TEST(FastDetectorPyramid, FindsCornersOfTheCoarseLevels) {
+  // A FAST ring of 4x4 blocks, which only the third level sees as a corner.
+  Array3Du image(80, 80);
+  image.fill(0);
+  for (int j = 0; j < 16; ++j) {
+    for (int r = 0; r < 4; ++r) {
+      for (int c = 0; c < 4; ++c) {
+        image(4 * (10 + indY[j]) + r, 4 * (10 + indX[j]) + c) = 255;
+      }
+    }
+  }
+  Image im(new Array3Du(image));
+
+  scoped_ptr<Detector> detector(CreateFastDetectorPyramid(9, 20, false, 3));
+  vector<Feature *> features;
+  detector->Detect(im, &features, NULL);
+
+  // The center of pixel (10, 10) of the third level.
+  int num_found = 0;
+  for (int i = 0; i < features.size(); ++i) {
+    PointFeature *f = (PointFeature *)features[i];
+    if (f->scale == 12.0) {
+      EXPECT_NEAR(41.5, f->x(), 1e-6);
+      EXPECT_NEAR(41.5, f->y(), 1e-6);
+      ++num_found;
+    }
+  }
+  EXPECT_EQ(1, num_found);
+  DeleteElements(&features);
+}
+
+TEST(FastDetectorPyramid, KeepsTheStrongestAcrossLevels) {
+  Array3Du image;
+  RandomImage(128, 96, &image);
+  FloatImage scaled;
+  ByteArrayToScaledFloatArray(image, &scaled);
+  FixedPointPyramid pyramid(scaled, 3);
+
+  vector<Feature *> features;
+  DetectFastInPyramid(pyramid, 9, 20, false, &features);
+  ASSERT_GT(features.size(), 20);
+
+  // A feature is two pixels of the coarser level away from the features of
+  // the level above, i.e. more than three of its own.
+  for (int i = 0; i < features.size(); ++i) {
+    PointFeature *a = (PointFeature *)features[i];
+    for (int j = 0; j < features.size(); ++j) {
+      PointFeature *b = (PointFeature *)features[j];
+      if (b->scale != 2 * a->scale) {
+        continue;
+      }
+      float distance = std::max(std::abs(a->x() - b->x()),
+                                std::abs(a->y() - b->y()));
+      EXPECT_GT(distance, a->scale);
+    }
+  }
+  DeleteElements(&features);
+}
+
 }  // namespace
 }  // namespace detector
 }  // namespace libmv
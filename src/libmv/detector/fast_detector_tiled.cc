@@ -0,0 +1,204 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "libmv/base/thread.h"
+#include "libmv/base/vector.h"
+#include "libmv/correspondence/feature.h"
+#include "libmv/detector/detector.h"
+#include "libmv/detector/fast_detector.h"
+#include "libmv/detector/orientation_detector.h"
+#include "libmv/image/image.h"
+#include "libmv/logging/logging.h"
+#include "third_party/fast/fast.h"
+
+namespace libmv {
+namespace detector {
+
+typedef xy* (*FastDetectCall)(const unsigned char *, int, int, int, int, int *);
+typedef int* (*FastScoreCall)(const unsigned char *, int, xy *, int, int);
+
+namespace {
+
+// FAST tests a ring of radius 3 and the non maximum suppression compares a
+// corner with its 8 neighbors: a cell is detected on a tile grown by this many
+// pixels on every side so that its corners match a whole image detection.
+const int kTileBorder = 4;
+
+struct ScoredCorner {
+  int x, y, score;
+};
+
+// Strongest first; ties are broken by position to keep the output stable.
+bool StrongerCorner(const ScoredCorner &a, const ScoredCorner &b) {
+  if (a.score != b.score) return a.score > b.score;
+  if (a.y != b.y) return a.y < b.y;
+  return a.x < b.x;
+}
+
+// Detects the corners of each grid cell independently; cell i only writes to
+// corners[i], so the cells can be processed in parallel.
+struct DetectCells {
+  const ByteImage *image;
+  FastDetectCall detect;
+  FastScoreCall score;
+  int threshold;
+  int cell_size;
+  int cells_per_row;
+  int max_per_cell;
+  vector<ScoredCorner> *corners;
+
+  void operator()(int i) const {
+    int width = image->Width(), height = image->Height();
+    int x0 = (i % cells_per_row) * cell_size;
+    int y0 = (i / cells_per_row) * cell_size;
+    int x1 = std::min(width, x0 + cell_size);
+    int y1 = std::min(height, y0 + cell_size);
+
+    int tile_x0 = std::max(0, x0 - kTileBorder);
+    int tile_y0 = std::max(0, y0 - kTileBorder);
+    int tile_x1 = std::min(width, x1 + kTileBorder);
+    int tile_y1 = std::min(height, y1 + kTileBorder);
+    const unsigned char *tile = image->Data() + tile_y0 * width + tile_x0;
+
+    int num_corners = 0;
+    xy *detections = detect(tile, tile_x1 - tile_x0, tile_y1 - tile_y0, width,
+                            threshold, &num_corners);
+    int *scores = score(tile, width, detections, num_corners, threshold);
+    int num_nonmax = 0;
+    xy *nonmax = nonmax_suppression(detections, scores, num_corners,
+                                    &num_nonmax);
+    free(scores);
+    free(detections);
+
+    // Strongest corners inside the cell; the others belong to the neighbors.
+    scores = score(tile, width, nonmax, num_nonmax, threshold);
+    vector<ScoredCorner> &cell = corners[i];
+    for (int j = 0; j < num_nonmax; ++j) {
+      ScoredCorner corner;
+      corner.x = nonmax[j].x + tile_x0;
+      corner.y = nonmax[j].y + tile_y0;
+      corner.score = scores[j];
+      if (x0 <= corner.x && corner.x < x1 && y0 <= corner.y && corner.y < y1) {
+        cell.push_back(corner);
+      }
+    }
+    free(scores);
+    free(nonmax);
+
+    std::sort(cell.begin(), cell.end(), StrongerCorner);
+    if (max_per_cell > 0 && cell.size() > max_per_cell) {
+      cell.resize(max_per_cell);
+    }
+  }
+};
+
+}  // namespace
+
+class FastDetectorTiled : public Detector {
+ public:
+  virtual ~FastDetectorTiled() {}
+  FastDetectorTiled(FastDetectCall detect, FastScoreCall score,
+                    int threshold, bool bRotationInvariant,
+                    int cell_size, int max_per_cell, int num_threads)
+    : detect_(detect), score_(score), threshold_(threshold),
+      bRotationInvariant_(bRotationInvariant), cell_size_(cell_size),
+      max_per_cell_(max_per_cell), num_threads_(num_threads) {}
+
+  virtual void Detect(const Image &image,
+                      vector<Feature *> *features,
+                      DetectorData **data) const {
+    LIBMV_SCOPED_TIMER("detect.fast_tiled");
+    ByteImage *byte_image = image.AsArray3Du();
+    if (byte_image) {
+      int cells_per_row = (byte_image->Width() + cell_size_ - 1) / cell_size_;
+      int cells_per_column =
+          (byte_image->Height() + cell_size_ - 1) / cell_size_;
+      int num_cells = cells_per_row * cells_per_column;
+      vector<vector<ScoredCorner> > corners(num_cells);
+
+      DetectCells detect_cells;
+      detect_cells.image = byte_image;
+      detect_cells.detect = detect_;
+      detect_cells.score = score_;
+      detect_cells.threshold = threshold_;
+      detect_cells.cell_size = cell_size_;
+      detect_cells.cells_per_row = cells_per_row;
+      detect_cells.max_per_cell = max_per_cell_;
+      detect_cells.corners = &corners[0];
+      ParallelFor(0, num_cells, num_threads_, &detect_cells);
+
+      // Cells in raster order, strongest corners first within a cell.
+      for (int i = 0; i < num_cells; ++i) {
+        for (int j = 0; j < corners[i].size(); ++j) {
+          PointFeature *f = new PointFeature(corners[i][j].x, corners[i][j].y);
+          f->scale = 3.0;
+          f->orientation = 0.0;
+          features->push_back(f);
+        }
+      }
+
+      if (bRotationInvariant_) {
+        fastRotationEstimation(*byte_image, *features);
+      }
+    }
+    else  {
+      LOG(ERROR) << "Invalid input image type for FastDetectorTiled detector";
+    }
+
+    // FAST doesn't have a corresponding descriptor, so there's no extra data
+    // to export.
+    if (data) {
+      *data = NULL;
+    }
+  }
+
+ private:
+  FastDetectCall detect_;
+  FastScoreCall score_;
+  int threshold_; // Threshold called barrier in Fast paper (cf. [1]).
+  bool bRotationInvariant_;
+  int cell_size_;     // Side of the grid cells in pixels.
+  int max_per_cell_;  // Max number of features kept per cell, <= 0 for all.
+  int num_threads_;
+};
+
+Detector *CreateFastDetectorTiled(int size, int threshold,
+                                  bool bRotationInvariant,
+                                  int cell_size, int nKeypointMaxPerCell,
+                                  int num_threads) {
+  FastDetectCall detect = NULL;
+  FastScoreCall score = NULL;
+  if (size ==  9) { detect =  fast9_detect; score =  fast9_score; }
+  if (size == 10) { detect = fast10_detect; score = fast10_score; }
+  if (size == 11) { detect = fast11_detect; score = fast11_score; }
+  if (size == 12) { detect = fast12_detect; score = fast12_score; }
+  if (!detect) {
+    LOG(FATAL) << "Invalid size for FAST detector: " << size;
+  }
+  CHECK_GT(cell_size, 0);
+  return new FastDetectorTiled(detect, score, threshold, bRotationInvariant,
+                               cell_size, nKeypointMaxPerCell, num_threads);
+}
+
+}  // namespace detector
+}  // namespace libmv
@@ -0,0 +1,103 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/detector/frame_cache.h"
+#include "libmv/image/convolve.h"
+#include "libmv/image/integral_image.h"
+
+namespace libmv {
+namespace detector {
+
+FrameCache::FrameCache(const Image &image)
+    : image_(image), integral_(NULL) {}
+
+FrameCache::~FrameCache() {
+  FloatProducts::iterator it = float_products_.begin();
+  for (; it != float_products_.end(); ++it) {
+    delete it->second;
+  }
+  PyramidProducts::iterator pyramid = pyramids_.begin();
+  for (; pyramid != pyramids_.end(); ++pyramid) {
+    delete pyramid->second;
+  }
+}
+
+const Matu &FrameCache::Integral() const {
+  MutexLock lock(&mutex_);
+  if (!integral_.get()) {
+    integral_.reset(new Matu);
+    IntegralImage(*image_.AsArray3Du(), integral_.get());
+  }
+  return *integral_;
+}
+
+const FloatImage &FrameCache::ScaledLocked() const {
+  FloatImage *&scaled = float_products_[ProductKey(SCALED, 0)];
+  if (!scaled) {
+    scaled = new FloatImage;
+    ByteArrayToScaledFloatArray(*image_.AsArray3Du(), scaled);
+  }
+  return *scaled;
+}
+
+const FloatImage &FrameCache::Scaled() const {
+  MutexLock lock(&mutex_);
+  return ScaledLocked();
+}
+
+const FloatImage &FrameCache::Smoothed(double sigma) const {
+  MutexLock lock(&mutex_);
+  FloatImage *&smoothed = float_products_[ProductKey(SMOOTHED, sigma)];
+  if (!smoothed) {
+    smoothed = new FloatImage;
+    ConvolveGaussian(ScaledLocked(), sigma, smoothed);
+  }
+  return *smoothed;
+}
+
+const FixedPointPyramid &FrameCache::Pyramid(int num_levels,
+                                             double sigma) const {
+  MutexLock lock(&mutex_);
+  FixedPointPyramid *&pyramid = pyramids_[ProductKey(num_levels, sigma)];
+  if (!pyramid) {
+    pyramid = new FixedPointPyramid(ScaledLocked(), num_levels, sigma);
+  }
+  return *pyramid;
+}
+
+size_t FrameCache::MemorySizeInBytes() const {
+  MutexLock lock(&mutex_);
+  size_t size = 0;
+  if (integral_.get()) {
+    size += integral_->size() * sizeof(unsigned int);
+  }
+  FloatProducts::const_iterator it = float_products_.begin();
+  for (; it != float_products_.end(); ++it) {
+    size += it->second->Size() * sizeof(float);
+  }
+  PyramidProducts::const_iterator pyramid = pyramids_.begin();
+  for (; pyramid != pyramids_.end(); ++pyramid) {
+    size += pyramid->second->MemorySizeInBytes();
+  }
+  return size;
+}
+
+}  // namespace detector
+}  // namespace libmv
@@ -0,0 +1,98 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_DETECTOR_FRAME_CACHE_H
+#define LIBMV_DETECTOR_FRAME_CACHE_H
+
+#include <map>
+#include <utility>
+
+#include "libmv/base/scoped_ptr.h"
+#include "libmv/base/thread.h"
+#include "libmv/detector/detector.h"
+#include "libmv/image/array_nd.h"
+#include "libmv/image/fixed_point_pyramid.h"
+#include "libmv/image/image.h"
+#include "libmv/numeric/numeric.h"
+
+namespace libmv {
+namespace detector {
+
+/**
+ * The products derived from one frame that detectors and describers both
+ * need, computed on first use and kept for the life of the cache. The
+ * detectors which compute such products return them in a FrameCache as
+ * their detector data, and the describers look for one in the detector data
+ * before computing the products themselves.
+ *
+ * A product is identified by its kind and its parameters, so that two
+ * stages asking for the same smoothing share it. The products are computed
+ * under a lock and never change once computed, so several threads can use
+ * the cache at once. The cache keeps a copy of the frame, which shares its
+ * pixels.
+ */
+class FrameCache : public DetectorData {
+ public:
+  explicit FrameCache(const Image &image);
+  virtual ~FrameCache();
+
+  const Image &image() const { return image_; }
+  // Whether the products are those of image, i.e. it shares the pixels of
+  // the frame.
+  bool IsOf(const Image &image) const {
+    return image.AsArray3Du() == image_.AsArray3Du();
+  }
+
+  // The integral image of the first channel, as IntegralImage().
+  const Matu &Integral() const;
+  // The first channel scaled to [0, 1], as ByteArrayToScaledFloatArray().
+  const FloatImage &Scaled() const;
+  // Scaled() convolved with a gaussian, as ConvolveGaussian().
+  const FloatImage &Smoothed(double sigma) const;
+  // The pyramid of Scaled(), as FixedPointPyramid(Scaled(), num_levels,
+  // sigma), whose byte levels are those tracked by the KLT.
+  const FixedPointPyramid &Pyramid(int num_levels, double sigma = 0.9) const;
+
+  // The memory taken by the products computed so far.
+  size_t MemorySizeInBytes() const;
+
+ private:
+  enum ProductKind { SCALED, SMOOTHED };
+  typedef std::pair<int, double> ProductKey;
+  typedef std::map<ProductKey, FloatImage *> FloatProducts;
+  typedef std::map<ProductKey, FixedPointPyramid *> PyramidProducts;
+
+  // The mutex must be held.
+  const FloatImage &ScaledLocked() const;
+
+  Image image_;
+  mutable Mutex mutex_;
+  mutable scoped_ptr<Matu> integral_;
+  mutable FloatProducts float_products_;
+  mutable PyramidProducts pyramids_;
+
+  FrameCache(const FrameCache &);
+  FrameCache &operator=(const FrameCache &);
+};
+
+}  // namespace detector
+}  // namespace libmv
+
+#endif  // LIBMV_DETECTOR_FRAME_CACHE_H
@@ -0,0 +1,93 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/base/scoped_ptr.h"
+#include "libmv/base/vector.h"
+#include "libmv/base/vector_utils.h"
+#include "libmv/correspondence/feature.h"
+#include "libmv/detector/detector.h"
+#include "libmv/detector/frame_cache.h"
+#include "libmv/detector/surf_detector.h"
+#include "libmv/image/convolve.h"
+#include "libmv/image/image.h"
+#include "libmv/image/integral_image.h"
+#include "testing/testing.h"
+
+namespace libmv {
+namespace detector {
+namespace {
+
+Image MakeImage() {
+  Array3Du *array = new Array3Du(40, 50);
+  for (int r = 0; r < array->Height(); ++r) {
+    for (int c = 0; c < array->Width(); ++c) {
+      (*array)(r, c) = (7 * r + 3 * c) % 256;
+    }
+  }
+  return Image(array);
+}
+
+TEST(FrameCache, ProductsAreComputedOnce) {
+  Image image = MakeImage();
+  FrameCache cache(image);
+  EXPECT_TRUE(cache.IsOf(image));
+  EXPECT_FALSE(cache.IsOf(MakeImage()));
+  EXPECT_EQ(0, cache.MemorySizeInBytes());
+
+  Matu integral_image;
+  IntegralImage(*image.AsArray3Du(), &integral_image);
+  const Matu &cached_integral_image = cache.Integral();
+  EXPECT_EQ(integral_image, cached_integral_image);
+  EXPECT_EQ(&cached_integral_image, &cache.Integral());
+
+  FloatImage scaled, smoothed;
+  ByteArrayToScaledFloatArray(*image.AsArray3Du(), &scaled);
+  ConvolveGaussian(scaled, 2.0, &smoothed);
+  const FloatImage &cached_smoothed = cache.Smoothed(2.0);
+  EXPECT_EQ(&cached_smoothed, &cache.Smoothed(2.0));
+  EXPECT_NE(&cached_smoothed, &cache.Smoothed(1.0));
+  ASSERT_EQ(smoothed.Size(), cached_smoothed.Size());
+  for (int i = 0; i < smoothed.Size(); ++i) {
+    EXPECT_EQ(smoothed.Data()[i], cached_smoothed.Data()[i]);
+  }
+  // The integral image, the scaled image and two smoothings.
+  EXPECT_EQ(integral_image.size() * sizeof(unsigned int) +
+            3 * smoothed.Size() * sizeof(float), cache.MemorySizeInBytes());
+}
+
+TEST(FrameCache, SurfDetectorReturnsItsIntegralImage) {
+  Image image = MakeImage();
+  scoped_ptr<Detector> detector(CreateSURFDetector());
+  vector<Feature *> features;
+  DetectorData *data = NULL;
+  detector->Detect(image, &features, &data);
+  scoped_ptr<DetectorData> detector_data(data);
+
+  FrameCache *cache = dynamic_cast<FrameCache *>(data);
+  ASSERT_TRUE(cache != NULL);
+  EXPECT_TRUE(cache->IsOf(image));
+  EXPECT_EQ(cache->Integral().size() * sizeof(unsigned int),
+            cache->MemorySizeInBytes());
+  DeleteElements(&features);
+}
+
+}  // namespace
+}  // namespace detector
+}  // namespace libmv
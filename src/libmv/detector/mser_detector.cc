@@ -24,6 +24,7 @@
 #include "libmv/detector/detector.h"
 #include "libmv/detector/orientation_detector.h"
 #include "libmv/image/image.h"
+#include "libmv/logging/logging.h"
 #include "third_party/MserDetector/cvMserDetector.h"
 #include "libmv/numeric/numeric.h"
 #include <Eigen/QR>
@@ -39,8 +40,8 @@ class MserDetector : public Detector {
 
   virtual void Detect(const Image &image,
                       vector<Feature *> *vec_features,
-                      DetectorData **data) {
-
+                      DetectorData **data) const {
+    LIBMV_SCOPED_TIMER("detect.mser");
     ByteImage *byte_image = image.AsArray3Du();
 
     vector<sMserProperties> vec_ellipses;
@@ -35,6 +35,18 @@ class Detector;
  */
 Detector *CreateMserDetector(bool bRotationInvariant = true);
 
+/**
+ * Creates a detector of the same maximally stable extremal regions as
+ * CreateMserDetector(), without the third_party code: the component tree is
+ * built by union-find over the pixels sorted by value, with the area and the
+ * moments of every region accumulated in place of its pixel list, so the
+ * ellipses are computed without visiting the regions again.
+ *
+ * \param bRotationInvariant Tell if orientation of detected features must
+ *                            be estimated (the major axis of the ellipse).
+ */
+Detector *CreateMserDetectorLinear(bool bRotationInvariant = true);
+
 } // namespace detector
 } // namespace libmv
 
@@ -0,0 +1,324 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "libmv/base/vector.h"
+#include "libmv/correspondence/feature.h"
+#include "libmv/detector/detector.h"
+#include "libmv/detector/mser_detector.h"
+#include "libmv/image/image.h"
+#include "libmv/logging/logging.h"
+
+namespace libmv {
+namespace detector {
+namespace {
+
+// The parameters of the third_party (OpenCV) detector.
+const int kDelta = 5;
+const int kMinArea = 60;
+const int kMaxArea = 14400;
+const float kMaxVariation = 0.25f;
+const float kMinDiversity = 0.2f;
+
+// A node of the component tree: the connected component of the pixels of
+// value <= level that appeared (or grew by merging) at that level. The area
+// and the moments include the pixels of all the children.
+struct Region {
+  int level;
+  int parent;  // -1 at the root.
+  int area;
+  double sum_x, sum_y, sum_xx, sum_xy, sum_yy;
+  float variation;
+  bool merged;  // Absorbed by its parent region, at the same level.
+  bool stable;
+};
+
+// The arrays of the union-find over the pixels and of the component tree,
+// kept between the two passes of a detection.
+struct ComponentTree {
+  std::vector<int> order;      // Pixels sorted by value.
+  std::vector<int> parent;     // Union-find forest; -1 for pixels not seen.
+  std::vector<unsigned char> rank;
+  std::vector<int> region_of;  // Region of each union-find root.
+  std::vector<Region> regions;
+
+  int Find(int i) {
+    while (parent[i] != i) {
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+    return i;
+  }
+
+  // Joins the components of the roots a and b and returns the new root; at
+  // least one of their regions is at level, as it holds the new pixel.
+  int Merge(int a, int b, int level) {
+    int region_a = region_of[a], region_b = region_of[b];
+    if (rank[a] < rank[b]) {
+      std::swap(a, b);
+    }
+    parent[b] = a;
+    if (rank[a] == rank[b]) {
+      ++rank[a];
+    }
+    // Keep the region at this level, or the largest one if both are: the
+    // chains of merged regions stay short.
+    if (regions[region_a].level != level ||
+        (regions[region_b].level == level &&
+         regions[region_b].area > regions[region_a].area)) {
+      std::swap(region_a, region_b);
+    }
+    Region &region = regions[region_a];
+    Region &other = regions[region_b];
+    region.area += other.area;
+    region.sum_x += other.sum_x;
+    region.sum_y += other.sum_y;
+    region.sum_xx += other.sum_xx;
+    region.sum_xy += other.sum_xy;
+    region.sum_yy += other.sum_yy;
+    other.parent = region_a;
+    other.merged = other.level == level;
+    region_of[a] = region_a;
+    return a;
+  }
+
+  // Builds the tree of the image, or of its negative.
+  void Build(const ByteImage &image, bool negative) {
+    const int width = image.Width(), height = image.Height();
+    const int n = width * height;
+
+    // Counting sort of the pixels.
+    int histogram[257] = { 0 };
+    for (int i = 0; i < n; ++i) {
+      ++histogram[Value(image, i, negative) + 1];
+    }
+    for (int v = 0; v < 256; ++v) {
+      histogram[v + 1] += histogram[v];
+    }
+    order.resize(n);
+    for (int i = 0; i < n; ++i) {
+      order[histogram[Value(image, i, negative)]++] = i;
+    }
+
+    parent.assign(n, -1);
+    rank.assign(n, 0);
+    region_of.resize(n);
+    regions.clear();
+    regions.reserve(n);
+    for (int k = 0; k < n; ++k) {
+      const int i = order[k];
+      const int level = Value(image, i, negative);
+      const int x = i % width, y = i / width;
+
+      const int neighbors[4] = { i - 1, i + 1, i - width, i + width };
+      const bool inside[4] = { x > 0, x < width - 1, y > 0, y < height - 1 };
+      bool active[4];
+      for (int j = 0; j < 4; ++j) {
+        active[j] = inside[j] && parent[neighbors[j]] >= 0;
+      }
+
+      int roots[4];
+      for (int j = 0; j < 4; ++j) {
+        roots[j] = active[j] ? Find(neighbors[j]) : -1;
+      }
+
+      // Join the region of a neighbor at this level if there is one, else
+      // start a new region.
+      int root = -1;
+      for (int j = 0; j < 4 && root < 0; ++j) {
+        if (roots[j] >= 0 && regions[region_of[roots[j]]].level == level) {
+          root = roots[j];
+        }
+      }
+      if (root >= 0) {
+        parent[i] = root;
+      } else {
+        Region region;
+        region.level = level;
+        region.parent = -1;
+        region.area = 0;
+        region.sum_x = region.sum_y = 0;
+        region.sum_xx = region.sum_xy = region.sum_yy = 0;
+        region.merged = false;
+        region.stable = false;
+        parent[i] = i;
+        region_of[i] = regions.size();
+        regions.push_back(region);
+        root = i;
+      }
+      Region &region = regions[region_of[root]];
+      ++region.area;
+      region.sum_x += x;
+      region.sum_y += y;
+      region.sum_xx += x * x;
+      region.sum_xy += x * y;
+      region.sum_yy += y * y;
+
+      for (int j = 0; j < 4; ++j) {
+        if (roots[j] < 0) {
+          continue;
+        }
+        int b = Find(roots[j]);
+        if (root != b) {
+          root = Merge(root, b, level);
+        }
+      }
+    }
+
+    // Skip the merged regions in the parent links.
+    for (int r = 0; r < regions.size(); ++r) {
+      regions[r].parent = Resolve(regions[r].parent);
+    }
+  }
+
+  // The region that absorbed the region r, or r itself. The chain of merged
+  // regions is compressed on the way.
+  int Resolve(int r) {
+    int survivor = r;
+    while (survivor >= 0 && regions[survivor].merged) {
+      survivor = regions[survivor].parent;
+    }
+    while (r != survivor) {
+      int next = regions[r].parent;
+      regions[r].parent = survivor;
+      r = next;
+    }
+    return survivor;
+  }
+
+  static int Value(const ByteImage &image, int i, bool negative) {
+    int value = image.Data()[i];
+    return negative ? 255 - value : value;
+  }
+
+  // Flags the maximally stable regions: the area variation between a region
+  // and its ancestor delta levels above is a local minimum along the tree.
+  void FindStableRegions() {
+    for (int r = 0; r < regions.size(); ++r) {
+      Region &region = regions[r];
+      if (region.merged) {
+        continue;
+      }
+      int top = r;
+      while (regions[top].parent >= 0 &&
+             regions[regions[top].parent].level <= region.level + kDelta) {
+        top = regions[top].parent;
+      }
+      bool complete = regions[top].parent >= 0 ||
+                      regions[top].level >= region.level + kDelta;
+      region.variation = complete ?
+          float(regions[top].area - region.area) / region.area : 1e30f;
+      region.stable = true;
+    }
+    for (int r = 0; r < regions.size(); ++r) {
+      Region &region = regions[r];
+      if (region.merged || region.parent < 0) {
+        continue;
+      }
+      Region &parent_region = regions[region.parent];
+      if (region.variation <= parent_region.variation) {
+        parent_region.stable = false;
+      } else {
+        region.stable = false;
+      }
+    }
+    for (int r = 0; r < regions.size(); ++r) {
+      Region &region = regions[r];
+      region.stable = region.stable && !region.merged &&
+                      region.variation < kMaxVariation &&
+                      kMinArea < region.area && region.area < kMaxArea;
+    }
+    // Drop the regions too similar to a smaller stable region they contain.
+    for (int r = 0; r < regions.size(); ++r) {
+      if (!regions[r].stable) {
+        continue;
+      }
+      const double max_area = regions[r].area / (1 - kMinDiversity);
+      for (int p = regions[r].parent;
+           p >= 0 && regions[p].area < max_area; p = regions[p].parent) {
+        regions[p].stable = false;
+      }
+    }
+  }
+};
+
+// Emits the ellipse of a region, from its moments, as a feature.
+PointFeature *RegionFeature(const Region &region, bool rotation_invariant) {
+  const double n = region.area;
+  const double x = region.sum_x / n, y = region.sum_y / n;
+  const double xx = region.sum_xx / n - x * x;
+  const double xy = region.sum_xy / n - x * y;
+  const double yy = region.sum_yy / n - y * y;
+  PointFeature *feature = new PointFeature(x, y);
+  // Same square approximation sqrt(axis1 * axis2) of the ellipse as the
+  // third_party detector, with axes twice the square roots of the
+  // eigenvalues of the covariance.
+  feature->scale = 2 * pow(std::max(0.0, xx * yy - xy * xy), 0.25);
+  feature->orientation = rotation_invariant ? 0.5 * atan2(2 * xy, xx - yy)
+                                            : 0.0;
+  return feature;
+}
+
+class MserDetectorLinear : public Detector {
+ public:
+  MserDetectorLinear(bool rotation_invariant)
+      : rotation_invariant_(rotation_invariant) {}
+  virtual ~MserDetectorLinear() {}
+
+  virtual void Detect(const Image &image,
+                      vector<Feature *> *features,
+                      DetectorData **data) const {
+    LIBMV_SCOPED_TIMER("detect.mser_linear");
+    ByteImage *byte_image = image.AsArray3Du();
+    ComponentTree tree;
+    // Dark regions (MSER-), then bright regions (MSER+).
+    for (int pass = 0; pass < 2; ++pass) {
+      tree.Build(*byte_image, pass == 1);
+      tree.FindStableRegions();
+      for (int r = 0; r < tree.regions.size(); ++r) {
+        if (tree.regions[r].stable) {
+          features->push_back(RegionFeature(tree.regions[r],
+                                            rotation_invariant_));
+        }
+      }
+    }
+
+    // MSER doesn't have a corresponding descriptor, so there's no extra data
+    // to export.
+    if (data) {
+      *data = NULL;
+    }
+  }
+
+ private:
+  bool rotation_invariant_;
+};
+
+}  // namespace
+
+Detector *CreateMserDetectorLinear(bool bRotationInvariant) {
+  return new MserDetectorLinear(bRotationInvariant);
+}
+
+}  // namespace detector
+}  // namespace libmv
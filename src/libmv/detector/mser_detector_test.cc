@@ -0,0 +1,102 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cmath>
+
+#include "libmv/base/scoped_ptr.h"
+#include "libmv/base/vector.h"
+#include "libmv/base/vector_utils.h"
+#include "libmv/correspondence/feature.h"
+#include "libmv/detector/detector.h"
+#include "libmv/detector/mser_detector.h"
+#include "libmv/image/image.h"
+#include "testing/testing.h"
+
+namespace libmv {
+namespace detector {
+namespace {
+
+void DrawDisk(float x, float y, float radius, int value, Array3Du *image) {
+  for (int r = 0; r < image->Height(); ++r) {
+    for (int c = 0; c < image->Width(); ++c) {
+      if ((c - x) * (c - x) + (r - y) * (r - y) <= radius * radius) {
+        (*image)(r, c) = value;
+      }
+    }
+  }
+}
+
+TEST(MserDetectorLinear, FindsDarkAndBrightBlobs) {
+  // Larger than the maximum area, so that the background is not a region.
+  Array3Du *array = new Array3Du(150, 120);
+  array->fill(128);
+  DrawDisk(30, 40, 8, 20, array);    // Dark blob.
+  DrawDisk(85, 60, 12, 240, array);  // Bright blob.
+  Image image(array);
+
+  scoped_ptr<Detector> detector(CreateMserDetectorLinear(false));
+  vector<Feature *> features;
+  detector->Detect(image, &features, NULL);
+
+  int dark = 0, bright = 0;
+  for (int i = 0; i < features.size(); ++i) {
+    PointFeature *point = static_cast<PointFeature *>(features[i]);
+    EXPECT_EQ(0, point->orientation);
+    if (fabs(point->x() - 30) < 0.5 && fabs(point->y() - 40) < 0.5) {
+      EXPECT_NEAR(8, point->scale, 0.5);
+      ++dark;
+    } else if (fabs(point->x() - 85) < 0.5 && fabs(point->y() - 60) < 0.5) {
+      EXPECT_NEAR(12, point->scale, 0.5);
+      ++bright;
+    }
+  }
+  EXPECT_EQ(1, dark);
+  EXPECT_EQ(1, bright);
+  EXPECT_EQ(2, features.size());
+  DeleteElements(&features);
+}
+
+TEST(MserDetectorLinear, OrientationOfAnElongatedRegion) {
+  Array3Du *array = new Array3Du(150, 150);
+  array->fill(200);
+  // A dark 30x6 bar along the diagonal, on its own: a single region.
+  for (int t = -15; t <= 15; ++t) {
+    for (int s = -3; s <= 3; ++s) {
+      int c = 75 + lround((t - s) / sqrt(2.0));
+      int r = 75 + lround((t + s) / sqrt(2.0));
+      (*array)(r, c) = 40;
+    }
+  }
+  Image image(array);
+
+  scoped_ptr<Detector> detector(CreateMserDetectorLinear(true));
+  vector<Feature *> features;
+  detector->Detect(image, &features, NULL);
+  ASSERT_EQ(1, features.size());
+  PointFeature *point = static_cast<PointFeature *>(features[0]);
+  EXPECT_NEAR(75, point->x(), 0.5);
+  EXPECT_NEAR(75, point->y(), 0.5);
+  EXPECT_NEAR(M_PI / 4, point->orientation, 0.1);
+  DeleteElements(&features);
+}
+
+}  // namespace
+}  // namespace detector
+}  // namespace libmv
@@ -21,8 +21,13 @@
 #ifndef LIBMV_DETECTOR_ORIENTATION_DETECTOR_H
 #define LIBMV_DETECTOR_ORIENTATION_DETECTOR_H
 
+#include <algorithm>
+#include <cmath>
+
 #include "libmv/base/vector.h"
 #include "libmv/correspondence/feature.h"
+#include "libmv/image/integral_image.h"
+#include "libmv/numeric/numeric.h"
 
 namespace libmv {
 
@@ -138,6 +143,88 @@ void gradientBoxesRotationEstimation(const Image & ima, vector<Feature *> & feat
 }
 
 
+/// Detect the orientation of the features from Haar wavelet responses on an
+/// integral image, as SURF does (Bay et al. "Speeded-Up Robust Features",
+/// CVIU 2008, section 4.1):
+/// The x and y responses of size 4s are sampled every s in a disc of radius
+///   6s around the keypoint of scale s, and weighted by a gaussian of 2s.
+/// A sliding window of PI/3 sums the responses whose direction it covers;
+///   the orientation is the direction of the longest sum.
+///
+/// The sampling pattern and its weights are built once for all the features,
+/// and the responses of a feature are weighted and swept as whole arrays.
+template<class TIntegralImage>
+void haarRotationEstimation(const TIntegralImage & integral_image,
+                            vector<Feature *> & features)
+{
+  const int kRadius = 6;
+  std::vector<Vec2f> pattern;
+  for (int r = -kRadius; r <= kRadius; ++r) {
+    for (int c = -kRadius; c <= kRadius; ++c) {
+      if (r*r + c*c <= kRadius*kRadius) {
+        pattern.push_back(Vec2f(r, c));
+      }
+    }
+  }
+  const int num_samples = pattern.size();
+  Eigen::ArrayXf weights(num_samples);
+  for (int i = 0; i < num_samples; ++i) {
+    weights(i) = exp(-pattern[i].squaredNorm() / (2 * 2.0 * 2.0));
+  }
+
+  Eigen::ArrayXf dx(num_samples), dy(num_samples);
+  std::vector<std::pair<float, int> > angles(num_samples);
+  for (int j = 0; j < features.size(); ++j) {
+    PointFeature *point = (PointFeature*)features[j];
+    const float scale = point->scale;
+    const int size = std::max(2, 2 * int(lround(2 * scale)));
+    const int half = size / 2;
+    for (int i = 0; i < num_samples; ++i) {
+      int row = lround(point->y() + scale * pattern[i](0));
+      int col = lround(point->x() + scale * pattern[i](1));
+      dx(i) = float(BoxIntegral(integral_image, row - half, col, size, half))
+            - float(BoxIntegral(integral_image, row - half, col - half,
+                                size, half));
+      dy(i) = float(BoxIntegral(integral_image, row, col - half, half, size))
+            - float(BoxIntegral(integral_image, row - half, col - half,
+                                half, size));
+    }
+    dx *= weights;
+    dy *= weights;
+
+    for (int i = 0; i < num_samples; ++i) {
+      angles[i] = std::make_pair(float(atan2(dy(i), dx(i))), i);
+    }
+    std::sort(angles.begin(), angles.end());
+
+    // Sweep the window over the sorted directions; the end of the window
+    // wraps around past PI.
+    double sum_x = 0, sum_y = 0, best_x = 0, best_y = 0, best = -1;
+    int end = 0;
+    for (int begin = 0; begin < num_samples; ++begin) {
+      while (end < begin + num_samples) {
+        int k = end % num_samples;
+        float angle = angles[k].first + (end >= num_samples ? 2 * M_PI : 0);
+        if (angle >= angles[begin].first + M_PI / 3) {
+          break;
+        }
+        sum_x += dx(angles[k].second);
+        sum_y += dy(angles[k].second);
+        ++end;
+      }
+      double length = sum_x * sum_x + sum_y * sum_y;
+      if (length > best) {
+        best = length;
+        best_x = sum_x;
+        best_y = sum_y;
+      }
+      sum_x -= dx(angles[begin].second);
+      sum_y -= dy(angles[begin].second);
+    }
+    point->orientation = getCoterminalAngle(atan2(best_y, best_x));
+  }
+}
+
 }  // namespace detector
 }  // namespace libmv
 
@@ -21,6 +21,7 @@
 #include "libmv/detector/orientation_detector.h"
 #include "libmv/detector/detector.h"
 #include "libmv/image/image.h"
+#include "libmv/image/integral_image.h"
 #include "testing/testing.h"
 
 namespace libmv {
@@ -159,6 +160,51 @@ TEST(GradientOrientationDetector, GradientRotEstimatorDegree45)  {
 }
 
 
+TEST(HaarOrientationDetector, HaarRotEstimatorFollowsTheGradient)  {
+  // Half planes bright on the side the gradient points to, with features on
+  // their edge.
+  const double angles[] = { 0.3, M_PI/2.0, 2.5, 4.0, 5.5 };
+  for (int a = 0; a < 5; ++a) {
+    Array3Du test(64,64);
+    for(int r = 0; r < 64; ++r)  {
+      for(int c = 0; c < 64; ++c)  {
+        double side = (c - 32) * cos(angles[a]) + (r - 32) * sin(angles[a]);
+        test(r,c) = side > 0 ? 255 : 0;
+      }
+    }
+    Matu integral_image;
+    IntegralImage(test, &integral_image);
+
+    PointFeature ptFeat(32,32);
+    ptFeat.scale = 2.0;
+    PointFeature ptFeatSmall(32,32);
+    ptFeatSmall.scale = 1.2;
+    vector<Feature *> vec_Feature;
+    vec_Feature.push_back(&ptFeat);
+    vec_Feature.push_back(&ptFeatSmall);
+
+    haarRotationEstimation(integral_image, vec_Feature);
+    EXPECT_NEAR( ptFeat.orientation, angles[a], 1e-1);
+    // The samples of small scales are rounded to a coarse grid.
+    EXPECT_NEAR( ptFeatSmall.orientation, angles[a], 2e-1);
+  }
+}
+
+TEST(HaarOrientationDetector, HaarRotEstimatorFlatImage)  {
+  Array3Du test(32,32);
+  test.fill(100);
+  Matu integral_image;
+  IntegralImage(test, &integral_image);
+
+  PointFeature ptFeat(16,16);
+  ptFeat.scale = 1.0;
+  ptFeat.orientation = 1.0;
+  vector<Feature *> vec_Feature;
+  vec_Feature.push_back(&ptFeat);
+  haarRotationEstimation(integral_image, vec_Feature);
+  EXPECT_NEAR( ptFeat.orientation, 0.0, 1e-5);
+}
+
 } // namespace
 } // namespace detector
 } // namespace libmv
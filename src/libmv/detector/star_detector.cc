@@ -24,6 +24,7 @@
 #include "libmv/detector/detector.h"
 #include "libmv/detector/orientation_detector.h"
 #include "libmv/image/image.h"
+#include "libmv/logging/logging.h"
 #include "third_party/StarDetector/cvStarDetector.h"
 
 namespace libmv {
@@ -36,8 +37,8 @@ class StarDetector : public Detector {
 
   virtual void Detect(const Image &image,
                       vector<Feature *> *features,
-                      DetectorData **data) {
-
+                      DetectorData **data) const {
+    LIBMV_SCOPED_TIMER("detect.star");
     ByteImage *byte_image = image.AsArray3Du();
 
     FloatImage responses( byte_image->Height(), byte_image->Width(), 1 );
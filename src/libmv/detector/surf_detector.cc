@@ -18,8 +18,11 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include "libmv/base/scoped_ptr.h"
 #include "libmv/logging/logging.h"
 #include "libmv/detector/detector.h"
+#include "libmv/detector/frame_cache.h"
+#include "libmv/detector/orientation_detector.h"
 #include "libmv/correspondence/feature.h"
 #include "libmv/image/image.h"
 #include "libmv/image/surf.h"
@@ -30,42 +33,55 @@ namespace detector {
 class SurfDetector : public Detector {
  public:
   virtual ~SurfDetector() {}
-  SurfDetector(int num_octaves, int num_intervals)
-    :num_octaves_(num_octaves), num_intervals_(num_intervals) {}
+  SurfDetector(int num_octaves, int num_intervals, int num_threads,
+               bool bRotationInvariant)
+    :num_octaves_(num_octaves), num_intervals_(num_intervals),
+     num_threads_(num_threads), bRotationInvariant_(bRotationInvariant) {}
 
   virtual void Detect(const Image &image,
                       vector<Feature *> *features,
-                      DetectorData **data) {
-    ByteImage *byte_image = image.AsArray3Du();
-    //TODO(pmoulon) Assert that byte_image is valid.
+                      DetectorData **data) const {
+    LIBMV_SCOPED_TIMER("detect.surf");
+    //TODO(pmoulon) Assert that image is a byte image.
 
-    Matu integral_image;
-    IntegralImage(*byte_image, &integral_image);
+    // The integral image is returned for the describers.
+    scoped_ptr<FrameCache> cache(new FrameCache(image));
+    const Matu &integral_image = cache->Integral();
 
     libmv::vector<PointFeature> detections;
     MultiscaleDetectFeatures(integral_image, num_octaves_, num_intervals_,
-                           &detections);
+                           &detections, num_threads_);
 
+    vector<Feature *> new_features;
     for (int i = 0; i < detections.size(); ++i) {
       PointFeature *f = new PointFeature(detections[i].x(), detections[i].y());
       f->scale = detections[i].scale;
       f->orientation = detections[i].orientation;
-      features->push_back(f);
+      new_features.push_back(f);
+    }
+    if (bRotationInvariant_) {
+      haarRotationEstimation(integral_image, new_features);
+    }
+    for (int i = 0; i < new_features.size(); ++i) {
+      features->push_back(new_features[i]);
     }
 
-    //data can contain the integral image that can be use for descriptor computation
     if (data) {
-      *data = NULL;
+      *data = cache.release();
     }
   }
 
  private:
   int num_octaves_;
   int num_intervals_;
+  int num_threads_;
+  bool bRotationInvariant_;
 };
 
-Detector *CreateSURFDetector(int num_octaves, int num_intervals) {
-  return new SurfDetector(num_octaves, num_intervals);
+Detector *CreateSURFDetector(int num_octaves, int num_intervals,
+                             int num_threads, bool bRotationInvariant) {
+  return new SurfDetector(num_octaves, num_intervals, num_threads,
+                          bRotationInvariant);
 }
 
 }  // namespace detector
@@ -31,8 +31,15 @@ class Detector;
  *
  * \param num_octaves   The number of octave to consider.
  * \param num_intervals The number of intervals.
+ * \param num_threads   The number of threads the octaves are computed on.
+ * \param bRotationInvariant If false, the features are upright (orientation
+ *                      0) and no orientation is estimated; otherwise it is
+ *                      estimated from the Haar responses of the integral image,
+ *                      see haarRotationEstimation().
  */
-Detector *CreateSURFDetector(int num_octaves = 4, int num_intervals = 4);
+Detector *CreateSURFDetector(int num_octaves = 4, int num_intervals = 4,
+                             int num_threads = 1,
+                             bool bRotationInvariant = false);
 
 }  // namespace detector
 }  // namespace libmv
@@ -0,0 +1,273 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+// The buffers of ArrayND are allocated through the functions below. By
+// default they go straight to the heap. With the pool enabled, freed buffers
+// are kept in power of two size classes and handed out again, so that a
+// video pipeline which recreates the same temporaries every frame stops
+// allocating once the first frames have been processed. With the placement
+// of large buffers enabled, the buffers of whole frames come straight from
+// the pages of the operating system, placed on the NUMA nodes of the threads
+// of the global pool rather than on the node of the allocating thread.
+
+#ifndef LIBMV_IMAGE_ARRAY_BUFFER_POOL_H_
+#define LIBMV_IMAGE_ARRAY_BUFFER_POOL_H_
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+#include "libmv/base/numa.h"
+#include "libmv/base/thread.h"
+
+namespace libmv {
+
+struct ArrayBufferPoolStats {
+  ArrayBufferPoolStats()
+      : bytes_in_use(0), high_water_bytes(0), pooled_bytes(0),
+        num_heap_allocations(0), num_pool_hits(0), num_page_allocations(0) {}
+
+  // Bytes of the buffers currently owned by arrays.
+  size_t bytes_in_use;
+  // Largest bytes_in_use since the last ResetArrayBufferHighWaterMark().
+  size_t high_water_bytes;
+  // Bytes of the free buffers held by the pool.
+  size_t pooled_bytes;
+  // Buffers that were allocated on the heap, and taken from the pool.
+  size_t num_heap_allocations;
+  size_t num_pool_hits;
+  // The heap allocations that were large buffers from AllocatePages().
+  size_t num_page_allocations;
+};
+
+namespace array_buffer_pool {
+
+// Every buffer is preceded by a header holding its capacity, and the bytes
+// of its pages if it is a large buffer from AllocatePages(), or else 0. The
+// header is 16 bytes to keep the alignment of operator new for SSE loads.
+struct BufferInfo {
+  size_t capacity;
+  size_t page_bytes;
+};
+union BufferHeader {
+  BufferInfo info;
+  char padding[16];
+};
+
+const int kNumSizeClasses = 8 * sizeof(size_t);
+
+// The buffers from which the placement of large buffers applies, e.g. a gray
+// float frame of 1024x1024 pixels.
+const size_t kLargeBufferBytes = 4 << 20;
+
+class Pool {
+ public:
+  Pool()
+      : enabled_(false), first_touch_(false), huge_pages_(false),
+        free_buffers_(kNumSizeClasses) {}
+  ~Pool() { ReleaseFreeBuffers(); }
+
+  void *Allocate(size_t bytes) {
+    size_t capacity = bytes;
+    bool first_touch, huge_pages;
+    {
+      MutexLock lock(&mutex_);
+      if (enabled_) {
+        int size_class = SizeClass(bytes);
+        capacity = size_t(1) << size_class;
+        std::vector<BufferHeader *> &buffers = free_buffers_[size_class];
+        if (buffers.size() > 0) {
+          // A pooled buffer keeps the placement of its pages.
+          BufferHeader *header = buffers.back();
+          buffers.pop_back();
+          stats_.pooled_bytes -= capacity;
+          stats_.num_pool_hits++;
+          AddInUse(capacity);
+          return header + 1;
+        }
+      }
+      stats_.num_heap_allocations++;
+      AddInUse(capacity);
+      first_touch = first_touch_;
+      huge_pages = huge_pages_;
+    }
+    size_t total_bytes = sizeof(BufferHeader) + capacity;
+    BufferHeader *header = NULL;
+    if ((first_touch || huge_pages) && capacity >= kLargeBufferBytes) {
+      header = static_cast<BufferHeader *>(
+          AllocatePages(total_bytes, huge_pages));
+    }
+    if (header == NULL) {
+      header = static_cast<BufferHeader *>(::operator new(total_bytes));
+      header->info.capacity = capacity;
+      header->info.page_bytes = 0;
+      return header + 1;
+    }
+    header->info.capacity = capacity;
+    header->info.page_bytes = total_bytes;
+    if (first_touch) {
+      // Outside of the lock, since the threads of the pool may allocate.
+      FirstTouchPages(header + 1, capacity, NumThreads());
+    }
+    MutexLock lock(&mutex_);
+    stats_.num_page_allocations++;
+    return header + 1;
+  }
+
+  void Free(void *buffer) {
+    if (buffer == NULL) {
+      return;
+    }
+    BufferHeader *header = static_cast<BufferHeader *>(buffer) - 1;
+    size_t capacity = header->info.capacity;
+    MutexLock lock(&mutex_);
+    stats_.bytes_in_use -= capacity;
+    int size_class = SizeClass(capacity);
+    if (enabled_ && (size_t(1) << size_class) == capacity) {
+      free_buffers_[size_class].push_back(header);
+      stats_.pooled_bytes += capacity;
+      return;
+    }
+    ReleaseBuffer(header);
+  }
+
+  void SetEnabled(bool enabled) {
+    {
+      MutexLock lock(&mutex_);
+      enabled_ = enabled;
+    }
+    if (!enabled) {
+      ReleaseFreeBuffers();
+    }
+  }
+
+  // Allocate the buffers of at least kLargeBufferBytes from AllocatePages().
+  // With first_touch, their pages are first touched by FirstTouchPages() on
+  // the threads of the global pool; with huge_pages, they are backed by huge
+  // pages where the system allows it. The buffers already allocated keep
+  // their pages.
+  void SetLargeBufferPlacement(bool first_touch, bool huge_pages) {
+    MutexLock lock(&mutex_);
+    first_touch_ = first_touch;
+    huge_pages_ = huge_pages;
+  }
+
+  void ReleaseFreeBuffers() {
+    MutexLock lock(&mutex_);
+    for (int i = 0; i < kNumSizeClasses; ++i) {
+      for (size_t j = 0; j < free_buffers_[i].size(); ++j) {
+        ReleaseBuffer(free_buffers_[i][j]);
+      }
+      std::vector<BufferHeader *>().swap(free_buffers_[i]);
+    }
+    stats_.pooled_bytes = 0;
+  }
+
+  ArrayBufferPoolStats Stats() {
+    MutexLock lock(&mutex_);
+    return stats_;
+  }
+
+  void ResetHighWaterMark() {
+    MutexLock lock(&mutex_);
+    stats_.high_water_bytes = stats_.bytes_in_use;
+  }
+
+ private:
+  // Smallest i such that bytes <= 2^i.
+  static int SizeClass(size_t bytes) {
+    int size_class = 0;
+    while ((size_t(1) << size_class) < bytes) {
+      ++size_class;
+    }
+    return size_class;
+  }
+
+  static void ReleaseBuffer(BufferHeader *header) {
+    if (header->info.page_bytes > 0) {
+      FreePages(header, header->info.page_bytes);
+    } else {
+      ::operator delete(header);
+    }
+  }
+
+  void AddInUse(size_t bytes) {
+    stats_.bytes_in_use += bytes;
+    if (stats_.bytes_in_use > stats_.high_water_bytes) {
+      stats_.high_water_bytes = stats_.bytes_in_use;
+    }
+  }
+
+  Mutex mutex_;
+  bool enabled_;
+  bool first_touch_;
+  bool huge_pages_;
+  std::vector<std::vector<BufferHeader *> > free_buffers_;
+  ArrayBufferPoolStats stats_;
+};
+
+// The process wide pool. It is never destroyed, so that arrays with static
+// storage duration can still free their buffers at exit.
+inline Pool &GlobalPool() {
+  static Pool *pool = new Pool;
+  return *pool;
+}
+
+}  // namespace array_buffer_pool
+
+// Allocate and free the storage of an array. Buffers are aligned like the
+// ones of operator new.
+inline void *AllocateArrayBuffer(size_t bytes) {
+  return array_buffer_pool::GlobalPool().Allocate(bytes);
+}
+inline void FreeArrayBuffer(void *buffer) {
+  array_buffer_pool::GlobalPool().Free(buffer);
+}
+
+// Keep freed array buffers for reuse instead of returning them to the heap.
+// Disabling the pool releases the buffers it holds.
+inline void SetArrayBufferPoolEnabled(bool enabled) {
+  array_buffer_pool::GlobalPool().SetEnabled(enabled);
+}
+
+// Place the large array buffers on the NUMA nodes of the threads that first
+// touch them, and back them by huge pages; both are off by default. See
+// array_buffer_pool::Pool::SetLargeBufferPlacement().
+inline void SetLargeArrayBufferPlacement(bool first_touch, bool huge_pages) {
+  array_buffer_pool::GlobalPool().SetLargeBufferPlacement(first_touch,
+                                                          huge_pages);
+}
+
+// Return the free buffers held by the pool to the heap.
+inline void ReleasePooledArrayBuffers() {
+  array_buffer_pool::GlobalPool().ReleaseFreeBuffers();
+}
+
+inline ArrayBufferPoolStats GetArrayBufferPoolStats() {
+  return array_buffer_pool::GlobalPool().Stats();
+}
+
+inline void ResetArrayBufferHighWaterMark() {
+  array_buffer_pool::GlobalPool().ResetHighWaterMark();
+}
+
+}  // namespace libmv
+
+#endif  // LIBMV_IMAGE_ARRAY_BUFFER_POOL_H_
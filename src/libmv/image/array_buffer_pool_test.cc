@@ -0,0 +1,112 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/image/array_buffer_pool.h"
+#include "libmv/image/array_nd.h"
+#include "libmv/image/convolve.h"
+#include "testing/testing.h"
+
+using namespace libmv;
+
+namespace {
+
+TEST(ArrayBufferPool, DisabledPoolTracksBytesInUse) {
+  SetArrayBufferPoolEnabled(false);
+  ArrayBufferPoolStats before = GetArrayBufferPoolStats();
+  {
+    Array3Df array(10, 10);
+    ArrayBufferPoolStats stats = GetArrayBufferPoolStats();
+    EXPECT_EQ(before.bytes_in_use + 400, stats.bytes_in_use);
+    EXPECT_EQ(before.num_heap_allocations + 1, stats.num_heap_allocations);
+    EXPECT_LE(stats.bytes_in_use, stats.high_water_bytes);
+  }
+  ArrayBufferPoolStats after = GetArrayBufferPoolStats();
+  EXPECT_EQ(before.bytes_in_use, after.bytes_in_use);
+  EXPECT_EQ(0, after.pooled_bytes);
+}
+
+TEST(ArrayBufferPool, ReshapeKeepsTheBuffer) {
+  Array3Df array(10, 20);
+  const float *data = array.Data();
+  ArrayBufferPoolStats before = GetArrayBufferPoolStats();
+  array.Resize(20, 10);
+  EXPECT_EQ(data, array.Data());
+  EXPECT_EQ(10, array.Stride(0));
+  EXPECT_EQ(before.num_heap_allocations,
+            GetArrayBufferPoolStats().num_heap_allocations);
+}
+
+TEST(ArrayBufferPool, SteadyStateFramesDoNotAllocate) {
+  SetArrayBufferPoolEnabled(true);
+  Array3Df image(60, 80);
+  for (int i = 0; i < image.Height(); ++i) {
+    for (int j = 0; j < image.Width(); ++j) {
+      image(i, j) = (i * j) % 7;
+    }
+  }
+  size_t heap_allocations = 0;
+  for (int frame = 0; frame < 4; ++frame) {
+    Array3Df blurred_and_gradients;
+    BlurredImageAndDerivativesChannels(image, 1.0, &blurred_and_gradients);
+    Array3Df half(30, 40, 3);
+    if (frame == 1) {
+      heap_allocations = GetArrayBufferPoolStats().num_heap_allocations;
+    }
+  }
+  ArrayBufferPoolStats stats = GetArrayBufferPoolStats();
+  EXPECT_EQ(heap_allocations, stats.num_heap_allocations);
+  EXPECT_LT(0, stats.num_pool_hits);
+  EXPECT_LT(0, stats.pooled_bytes);
+
+  ReleasePooledArrayBuffers();
+  EXPECT_EQ(0, GetArrayBufferPoolStats().pooled_bytes);
+  SetArrayBufferPoolEnabled(false);
+}
+
+TEST(ArrayBufferPool, HighWaterMark) {
+  ResetArrayBufferHighWaterMark();
+  size_t base = GetArrayBufferPoolStats().bytes_in_use;
+  {
+    Array3Du big(100, 100);
+  }
+  Array3Du small(10, 10);
+  ArrayBufferPoolStats stats = GetArrayBufferPoolStats();
+  EXPECT_EQ(base + 100, stats.bytes_in_use);
+  EXPECT_EQ(base + 10000, stats.high_water_bytes);
+}
+
+TEST(ArrayBufferPool, LargeBuffersComeFromPages) {
+  SetLargeArrayBufferPlacement(true, true);
+  ArrayBufferPoolStats before = GetArrayBufferPoolStats();
+  {
+    Array3Df frame(1024, 1024);
+    frame(1023, 1023) = 1;
+    Array3Df small(10, 10);
+    EXPECT_EQ(1, frame(1023, 1023));
+    EXPECT_EQ(0, frame(512, 512));
+  }
+  ArrayBufferPoolStats after = GetArrayBufferPoolStats();
+  EXPECT_EQ(before.num_page_allocations + 1, after.num_page_allocations);
+  EXPECT_EQ(before.num_heap_allocations + 2, after.num_heap_allocations);
+  EXPECT_EQ(before.bytes_in_use, after.bytes_in_use);
+  SetLargeArrayBufferPlacement(false, false);
+}
+
+}  // namespace
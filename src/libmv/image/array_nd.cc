@@ -20,6 +20,10 @@
 
 #include <iostream>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "libmv/image/image.h"
 
 namespace libmv {
@@ -57,12 +61,31 @@ void FloatArrayToScaledByteArray(const Array3Df &float_array,
 void ByteArrayToScaledFloatArray(const Array3Du &byte_array,
                                  Array3Df *float_array) {
   float_array->ResizeLike(byte_array);
-  for (int i = 0; i < byte_array.Height(); ++i) {
-    for (int j = 0; j < byte_array.Width(); ++j) {
-      for (int k = 0; k < byte_array.Depth(); ++k) {
-	      (*float_array)(i,j,k) = float(byte_array(i,j,k)) / 255.0f;
-      }
-    }
+  const unsigned char *in = byte_array.Data();
+  float *out = float_array->Data();
+  int size = byte_array.Size();
+  int i = 0;
+#ifdef __SSE2__
+  // 16 bytes at a time; dividing rather than multiplying by 1 / 255 gives the
+  // same floats as the scalar loop.
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 denominator = _mm_set1_ps(255.0f);
+  for (; i + 16 <= size; i += 16) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    __m128i low = _mm_unpacklo_epi8(bytes, zero);
+    __m128i high = _mm_unpackhi_epi8(bytes, zero);
+    _mm_storeu_ps(out + i, _mm_div_ps(
+        _mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)), denominator));
+    _mm_storeu_ps(out + i + 4, _mm_div_ps(
+        _mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)), denominator));
+    _mm_storeu_ps(out + i + 8, _mm_div_ps(
+        _mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)), denominator));
+    _mm_storeu_ps(out + i + 12, _mm_div_ps(
+        _mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)), denominator));
+  }
+#endif
+  for (; i < size; ++i) {
+    out[i] = float(in[i]) / 255.0f;
   }
 }
 
@@ -24,7 +24,10 @@
 #include <cassert>
 #include <cstdio>
 #include <cstring>
+#include <algorithm>
 
+#include "libmv/base/vector.h"
+#include "libmv/image/array_buffer_pool.h"
 #include "libmv/image/tuple.h"
 
 namespace libmv {
@@ -41,27 +44,40 @@ class ArrayND : public BaseArray {
   typedef Tuple<int, N> Index;
 
   /// Create an empty array.
-  ArrayND() : data_(NULL) { Resize(Index(0)); }
+  ArrayND() : data_(NULL), wraps_data_(false), release_(NULL),
+              release_context_(NULL) { Resize(Index(0)); }
 
   /// Create an array with the specified shape.
-  ArrayND(const Index &shape) : data_(NULL) { Resize(shape); }
+  ArrayND(const Index &shape)
+      : data_(NULL), wraps_data_(false), release_(NULL),
+        release_context_(NULL) { Resize(shape); }
 
   /// Create an array with the specified shape.
-  ArrayND(int *shape) : data_(NULL) { Resize(shape); }
+  ArrayND(int *shape)
+      : data_(NULL), wraps_data_(false), release_(NULL),
+        release_context_(NULL) { Resize(shape); }
 
   /// Copy constructor.
-  ArrayND(const ArrayND<T, N> &b) : data_(NULL) {
+  ArrayND(const ArrayND<T, N> &b)
+      : data_(NULL), wraps_data_(false), release_(NULL),
+        release_context_(NULL) {
     ResizeLike(b);
     std::memcpy(Data(), b.Data(), sizeof(T) * Size());
   }
 
-  ArrayND(int s0) : data_(NULL) { Resize(s0); }
-  ArrayND(int s0, int s1) : data_(NULL) { Resize(s0, s1); }
-  ArrayND(int s0, int s1, int s2) : data_(NULL) { Resize(s0, s1, s2); }
+  ArrayND(int s0)
+      : data_(NULL), wraps_data_(false), release_(NULL),
+        release_context_(NULL) { Resize(s0); }
+  ArrayND(int s0, int s1)
+      : data_(NULL), wraps_data_(false), release_(NULL),
+        release_context_(NULL) { Resize(s0, s1); }
+  ArrayND(int s0, int s1, int s2)
+      : data_(NULL), wraps_data_(false), release_(NULL),
+        release_context_(NULL) { Resize(s0, s1, s2); }
 
   /// Destructor deletes pixel data.
   ~ArrayND() {
-    delete [] data_;
+    FreeData();
   }
 
   /// Assignation copies pixel data.
@@ -72,6 +88,42 @@ class ArrayND : public BaseArray {
     return *this;
   }
 
+  /// Exchange the contents of two arrays without copying pixel data. This is
+  /// the cheap way to hand an array over, e.g. to return one from a function:
+  /// fill a local array and swap it into the output argument.
+  void Swap(ArrayND<T, N> *other) {
+    std::swap(shape_, other->shape_);
+    std::swap(strides_, other->strides_);
+    std::swap(data_, other->data_);
+    std::swap(wraps_data_, other->wraps_data_);
+    std::swap(release_, other->release_);
+    std::swap(release_context_, other->release_context_);
+  }
+
+  /// Called by the arrays which wrap memory once they give it up.
+  typedef void (*ReleaseFunction)(void *context);
+
+  /// Refer to memory owned by the caller, holding the elements of an array of
+  /// shape s laid out as this array lays them out, rather than to a copy.
+  /// The memory must stay valid until the array gives it up, by being
+  /// destroyed, resized (even to the same shape) or wrapping other memory;
+  /// then release(context) is called, unless release is NULL. Writing to the
+  /// elements writes to the memory.
+  void WrapData(T *data, const Index &s, ReleaseFunction release,
+                void *context) {
+    FreeData();
+    SetShape(s);
+    data_ = data;
+    wraps_data_ = true;
+    release_ = release;
+    release_context_ = context;
+  }
+
+  /// Whether the elements are in memory wrapped by WrapData().
+  bool WrapsData() const {
+    return wraps_data_;
+  }
+
   const Index &Shapes() const {
     return shape_;
   }
@@ -82,19 +134,22 @@ class ArrayND : public BaseArray {
 
   /// Create an array of shape s.
   void Resize(const Index &new_shape) {
-    if (data_ != NULL && shape_ == new_shape) {
+    if (data_ != NULL && !wraps_data_ && shape_ == new_shape) {
       // Don't bother realloacting if the shapes match.
       return;
     }
-    shape_.Reset(new_shape);
-    strides_(N - 1) = 1;
-    for (int i = N - 1; i > 0; --i) {
-      strides_(i - 1) = strides_(i) * shape_(i);
+    // Only reshape if the number of elements doesn't change.
+    int new_size = 1;
+    for (int i = 0; i < N; ++i) {
+      new_size *= new_shape(i);
     }
-    delete [] data_;
-    data_ = NULL;
-    if (Size() > 0) {
-      data_ = new T[Size()];
+    bool reuse_data = data_ != NULL && !wraps_data_ && Size() == new_size;
+    if (!reuse_data) {
+      FreeData();
+    }
+    SetShape(new_shape);
+    if (!reuse_data && Size() > 0) {
+      AllocateData();
     }
   }
 
@@ -318,6 +373,45 @@ class ArrayND : public BaseArray {
   }
 
  protected:
+  /// Allocate Size() elements through the array buffer pool.
+  void AllocateData() {
+    data_ = static_cast<T *>(AllocateArrayBuffer(sizeof(T) * Size()));
+    for (int i = 0; i < Size(); ++i) {
+      new (data_ + i) T;
+    }
+  }
+
+  /// Set the shape and the matching strides.
+  void SetShape(const Index &new_shape) {
+    shape_.Reset(new_shape);
+    strides_(N - 1) = 1;
+    for (int i = N - 1; i > 0; --i) {
+      strides_(i - 1) = strides_(i) * shape_(i);
+    }
+  }
+
+  /// Destroy the Size() elements of the current shape and free the buffer,
+  /// or release the wrapped memory.
+  void FreeData() {
+    if (wraps_data_) {
+      if (release_) {
+        release_(release_context_);
+      }
+      data_ = NULL;
+      wraps_data_ = false;
+      release_ = NULL;
+      return;
+    }
+    if (data_ == NULL) {
+      return;
+    }
+    for (int i = 0; i < Size(); ++i) {
+      data_[i].~T();
+    }
+    FreeArrayBuffer(data_);
+    data_ = NULL;
+  }
+
   /// The number of element in each dimension.
   Index shape_;
 
@@ -326,6 +420,11 @@ class ArrayND : public BaseArray {
 
   /// Pointer to the first element of the array.
   T *data_;
+
+  /// The elements are not owned; see WrapData().
+  bool wraps_data_;
+  ReleaseFunction release_;
+  void *release_context_;
 };
 
 /// 3D array (row, column, channel).
@@ -344,6 +443,14 @@ class Array3D : public ArrayND<T, 3> {
     Base::Resize(height, width, depth);
   }
 
+  /// Wrap the pixels of an image of that size held by the caller; see
+  /// ArrayND::WrapData().
+  void WrapData(T *data, int height, int width, int depth,
+                typename Base::ReleaseFunction release, void *context) {
+    int shape[3] = {height, width, depth};
+    Base::WrapData(data, typename Base::Index(shape), release, context);
+  }
+
   int Height() const {
     return Base::Shape(0);
   }
@@ -375,11 +482,219 @@ class Array3D : public ArrayND<T, 3> {
   }
 };
 
+/// 3D array (row, column, channel) with D channels, D fixed at compile time:
+/// an element is found with a single multiply-add on the row and the column,
+/// and loops over the channels of a pixel have a constant trip count, so that
+/// the compiler unrolls or vectorizes them. It is an Array3D and can be passed
+/// to the functions taking one, as long as they keep D channels.
+template <typename T, int D>
+class FixedDepthArray3D : public Array3D<T> {
+  typedef Array3D<T> Base;
+ public:
+  enum { kDepth = D };
+
+  FixedDepthArray3D()
+      : Base(0, 0, D) {
+  }
+  FixedDepthArray3D(int height, int width)
+      : Base(height, width, D) {
+  }
+
+  void Resize(int height, int width) {
+    Base::Resize(height, width, D);
+  }
+  /// For the code written for Array3D; depth must be D.
+  void Resize(int height, int width, int depth) {
+    assert(depth == D);
+    Base::Resize(height, width, D);
+  }
+
+  int Depth() const { return D; }
+  int depth() const { return D; }
+
+  /// The D channels of pixel (i0, i1).
+  T *Pixel(int i0, int i1) {
+    assert(0 <= i0 && i0 < Base::Height());
+    assert(0 <= i1 && i1 < Base::Width());
+    assert(Base::Shape(2) == D);
+    return Base::Data() + (i0 * Base::Width() + i1) * D;
+  }
+  const T *Pixel(int i0, int i1) const {
+    assert(0 <= i0 && i0 < Base::Height());
+    assert(0 <= i1 && i1 < Base::Width());
+    assert(Base::Shape(2) == D);
+    return Base::Data() + (i0 * Base::Width() + i1) * D;
+  }
+
+  T &operator()(int i0, int i1, int i2 = 0) {
+    assert(0 <= i2 && i2 < D);
+    return Pixel(i0, i1)[i2];
+  }
+  const T &operator()(int i0, int i1, int i2 = 0) const {
+    assert(0 <= i2 && i2 < D);
+    return Pixel(i0, i1)[i2];
+  }
+};
+
+// The arrays only own heap memory, so libmv::vector moves them with memcpy.
+template <typename T, int N>
+struct IsRelocatable<ArrayND<T, N> > {
+  enum { value = 1 };
+};
+template <typename T>
+struct IsRelocatable<Array3D<T> > {
+  enum { value = 1 };
+};
+template <typename T, int D>
+struct IsRelocatable<FixedDepthArray3D<T, D> > {
+  enum { value = 1 };
+};
+
 typedef Array3D<unsigned char> Array3Du;
 typedef Array3D<unsigned int> Array3Dui;
 typedef Array3D<int> Array3Di;
 typedef Array3D<float> Array3Df;
 typedef Array3D<short> Array3Ds;
+typedef FixedDepthArray3D<float, 1> Array3Df1;
+typedef FixedDepthArray3D<float, 3> Array3Df3;
+
+/// A non-owning view of a 3D array (row, column, channel) with arbitrary
+/// strides. Views of sub-rectangles, single channels and single planes of an
+/// array refer to its pixels without copying them; the viewed array must
+/// outlive the view and must not be resized while it is viewed. Writing
+/// through a view writes into the array. Use ArrayView3D<const T> for read
+/// only views.
+template <typename T>
+class ArrayView3D {
+ public:
+  typedef T Scalar;
+
+  ArrayView3D(T *data, int height, int width, int depth,
+              int row_stride, int column_stride, int channel_stride)
+      : data_(data) {
+    int shape[3] = {height, width, depth};
+    int strides[3] = {row_stride, column_stride, channel_stride};
+    shape_.Reset(shape);
+    strides_.Reset(strides);
+  }
+
+  /// View the whole array.
+  template <typename D>
+  explicit ArrayView3D(ArrayND<D, 3> &array)
+      : shape_(array.Shape()), strides_(array.Strides()),
+        data_(array.Data()) {
+  }
+  template <typename D>
+  explicit ArrayView3D(const ArrayND<D, 3> &array)
+      : shape_(array.Shape()), strides_(array.Strides()),
+        data_(array.Data()) {
+  }
+
+  /// Views of T convert to views of const T.
+  template <typename D>
+  ArrayView3D(const ArrayView3D<D> &other)
+      : data_(other.Data()) {
+    for (int i = 0; i < 3; ++i) {
+      shape_(i) = other.Shape(i);
+      strides_(i) = other.Stride(i);
+    }
+  }
+
+  int Height() const { return shape_(0); }
+  int Width() const { return shape_(1); }
+  int Depth() const { return shape_(2); }
+
+  // Match Eigen's API, like Array3D.
+  int rows() const { return Height(); }
+  int cols() const { return Width(); }
+  int depth() const { return Depth(); }
+
+  int Shape(int axis) const { return shape_(axis); }
+  int Stride(int axis) const { return strides_(axis); }
+  int Size() const { return Height() * Width() * Depth(); }
+
+  /// Pointer to the element (0, 0, 0).
+  T *Data() const { return data_; }
+
+  T &operator()(int i0, int i1, int i2 = 0) const {
+    assert(0 <= i0 && i0 < Height());
+    assert(0 <= i1 && i1 < Width());
+    assert(0 <= i2 && i2 < Depth());
+    return data_[i0 * strides_(0) + i1 * strides_(1) + i2 * strides_(2)];
+  }
+
+  bool Contains(int i0, int i1, int i2 = 0) const {
+    return 0 <= i0 && i0 < Height()
+        && 0 <= i1 && i1 < Width()
+        && 0 <= i2 && i2 < Depth();
+  }
+
+  /// A view can't be reallocated; this only checks that the shape matches, so
+  /// that views can be passed to functions which size their output.
+  void resize(int rows, int cols) {
+    (void) rows;
+    (void) cols;
+    assert(rows == Height() && cols == Width());
+  }
+
+  /// The height x width sub-rectangle whose top left corner is (row, column).
+  ArrayView3D Block(int row, int column, int height, int width) const {
+    assert(0 <= row && 0 <= height && row + height <= Height());
+    assert(0 <= column && 0 <= width && column + width <= Width());
+    return ArrayView3D(&(*this)(row, column), height, width, Depth(),
+                       Stride(0), Stride(1), Stride(2));
+  }
+
+  /// The single channel image of channel c.
+  ArrayView3D Channel(int c) const {
+    assert(0 <= c && c < Depth());
+    return ArrayView3D(data_ + c * Stride(2), Height(), Width(), 1,
+                       Stride(0), Stride(1), Stride(2));
+  }
+
+  /// True if the elements are stored densely in row major order.
+  bool IsContiguous() const {
+    return Stride(2) == 1
+        && Stride(1) == Depth()
+        && Stride(0) == Width() * Depth();
+  }
+
+  /// Copy the viewed elements into a dense array.
+  template <typename D>
+  void CopyTo(ArrayND<D, 3> *array) const {
+    array->Resize(Height(), Width(), Depth());
+    D *out = array->Data();
+    for (int i = 0; i < Height(); ++i) {
+      for (int j = 0; j < Width(); ++j) {
+        for (int k = 0; k < Depth(); ++k) {
+          *out++ = D((*this)(i, j, k));
+        }
+      }
+    }
+  }
+
+ private:
+  Tuple<int, 3> shape_;
+  Tuple<int, 3> strides_;
+  T *data_;
+};
+
+/// View plane i0 of a 3D array, i.e. the elements (i0, *, *), as a single
+/// channel image. This is how SURF octaves store one interval per plane.
+template <typename T>
+ArrayView3D<T> Plane(ArrayND<T, 3> &array, int i0) {
+  assert(0 <= i0 && i0 < array.Shape(0));
+  return ArrayView3D<T>(array.Data() + i0 * array.Stride(0),
+                        array.Shape(1), array.Shape(2), 1,
+                        array.Stride(1), array.Stride(2), 1);
+}
+template <typename T>
+ArrayView3D<const T> Plane(const ArrayND<T, 3> &array, int i0) {
+  assert(0 <= i0 && i0 < array.Shape(0));
+  return ArrayView3D<const T>(array.Data() + i0 * array.Stride(0),
+                              array.Shape(1), array.Shape(2), 1,
+                              array.Stride(1), array.Stride(2), 1);
+}
 
 void SplitChannels(const Array3Df &input,
                    Array3Df *channel0,
@@ -399,6 +714,7 @@ void FloatArrayToScaledByteArray(const Array3Df &float_array,
                                  bool automatic_range_detection = false);
 
 //! Convert a byte array into a float array by dividing values by 255.
+//! Uses SSE2 when available, with the same results.
 void ByteArrayToScaledFloatArray(const Array3Du &byte_array,
                                  Array3Df *float_array);
 
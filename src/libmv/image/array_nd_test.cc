@@ -24,6 +24,8 @@
 using libmv::ArrayND;
 using libmv::Array3D;
 using libmv::Array3Df;
+using libmv::ArrayView3D;
+using libmv::FixedDepthArray3D;
 
 namespace {
 
@@ -294,6 +296,83 @@ TEST(Array3Df, SplitChannels) {
   }
 }
 
+TEST(ArrayND, Swap) {
+  Array3D<int> a(2, 3), b(4, 5, 2);
+  a(1, 2) = 7;
+  b(3, 4, 1) = 9;
+  const int *a_data = a.Data();
+  a.Swap(&b);
+  EXPECT_EQ(4, a.Height());
+  EXPECT_EQ(2, a.Depth());
+  EXPECT_EQ(9, a(3, 4, 1));
+  EXPECT_EQ(10, a.Stride(0));
+  EXPECT_EQ(2, b.Height());
+  EXPECT_EQ(7, b(1, 2));
+  EXPECT_EQ(a_data, b.Data());
+}
+
+TEST(ArrayView3D, WholeArray) {
+  Array3Df array(3, 4, 2);
+  array.Fill(1);
+  ArrayView3D<float> view(array);
+  EXPECT_EQ(3, view.Height());
+  EXPECT_EQ(4, view.Width());
+  EXPECT_EQ(2, view.Depth());
+  EXPECT_TRUE(view.IsContiguous());
+  view(2, 3, 1) = 5;
+  EXPECT_EQ(5, array(2, 3, 1));
+
+  const Array3Df &const_array = array;
+  ArrayView3D<const float> const_view(const_array);
+  EXPECT_EQ(5, const_view(2, 3, 1));
+}
+
+TEST(ArrayView3D, BlockAndChannel) {
+  Array3D<int> array(5, 6, 3);
+  for (int i = 0; i < 5; ++i) {
+    for (int j = 0; j < 6; ++j) {
+      for (int k = 0; k < 3; ++k) {
+        array(i, j, k) = 100 * i + 10 * j + k;
+      }
+    }
+  }
+  ArrayView3D<int> block = ArrayView3D<int>(array).Block(1, 2, 3, 4);
+  EXPECT_EQ(3, block.Height());
+  EXPECT_EQ(4, block.Width());
+  EXPECT_EQ(3, block.Depth());
+  EXPECT_FALSE(block.IsContiguous());
+  EXPECT_EQ(120, block(0, 0, 0));
+  EXPECT_EQ(352, block(2, 3, 2));
+
+  ArrayView3D<int> channel = block.Channel(1);
+  EXPECT_EQ(1, channel.Depth());
+  EXPECT_EQ(121, channel(0, 0));
+  EXPECT_EQ(341, channel(2, 2));
+  channel(1, 1) = -1;
+  EXPECT_EQ(-1, array(2, 3, 1));
+
+  Array3D<int> copy;
+  channel.CopyTo(&copy);
+  EXPECT_EQ(3, copy.Height());
+  EXPECT_EQ(4, copy.Width());
+  EXPECT_EQ(1, copy.Depth());
+  EXPECT_EQ(-1, copy(1, 1));
+  EXPECT_EQ(351, copy(2, 3));
+}
+
+TEST(ArrayView3D, Plane) {
+  Array3Df array(3, 4, 5);
+  array.Fill(0);
+  ArrayView3D<float> plane = Plane(array, 2);
+  EXPECT_EQ(4, plane.Height());
+  EXPECT_EQ(5, plane.Width());
+  EXPECT_EQ(1, plane.Depth());
+  EXPECT_TRUE(plane.IsContiguous());
+  plane(3, 4) = 2;
+  EXPECT_EQ(2, array(2, 3, 4));
+  EXPECT_EQ(2, Plane(static_cast<const Array3Df &>(array), 2)(3, 4));
+}
+
 TEST( ArrayND, MultiplyElementsGeneric) {
   ArrayND<double, 5> A;
   ArrayND<int, 5> B;
@@ -321,4 +400,66 @@ TEST( ArrayND, MultiplyElementsGeneric) {
       }
 }
 
+void CountRelease(void *context) {
+  ++*static_cast<int *>(context);
+}
+
+TEST(ArrayND, WrapData) {
+  float data[2 * 3] = { 0, 1, 2, 3, 4, 5 };
+  int released = 0;
+  {
+    Array3Df array;
+    array.WrapData(data, 2, 3, 1, &CountRelease, &released);
+    EXPECT_TRUE(array.WrapsData());
+    EXPECT_EQ(data, array.Data());
+    EXPECT_EQ(5, array(1, 2));
+    EXPECT_EQ(3, array.Stride(0));
+
+    // Copies own their elements.
+    Array3Df copy(array);
+    EXPECT_FALSE(copy.WrapsData());
+    EXPECT_EQ(5, copy(1, 2));
+
+    // Resizing, even to the same shape, gives the memory up.
+    array.Resize(2, 3);
+    EXPECT_FALSE(array.WrapsData());
+    EXPECT_NE(data, array.Data());
+    EXPECT_EQ(1, released);
+
+    array.WrapData(data, 3, 2, 1, &CountRelease, &released);
+    Array3Df other;
+    other.Swap(&array);
+    EXPECT_FALSE(array.WrapsData());
+  }
+  EXPECT_EQ(2, released);
+}
+
+TEST(FixedDepthArray3D, IndexesLikeArray3D) {
+  FixedDepthArray3D<float, 3> fixed(4, 5);
+  EXPECT_EQ(4, fixed.Height());
+  EXPECT_EQ(5, fixed.Width());
+  EXPECT_EQ(3, fixed.Depth());
+  EXPECT_EQ(3, fixed.Shape(2));
+  for (int i = 0; i < fixed.Size(); ++i) {
+    fixed.Data()[i] = i;
+  }
+  const Array3Df &array = fixed;
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 5; ++j) {
+      EXPECT_EQ(&array(i, j, 0), fixed.Pixel(i, j));
+      for (int k = 0; k < 3; ++k) {
+        EXPECT_EQ(array(i, j, k), fixed(i, j, k));
+      }
+    }
+  }
+
+  // Functions taking an Array3D keep the depth.
+  fixed.Resize(2, 3);
+  EXPECT_EQ(3, fixed.Shape(2));
+  EXPECT_EQ(2 * 3 * 3, fixed.Size());
+  FixedDepthArray3D<float, 1> gray;
+  EXPECT_EQ(1, gray.Shape(2));
+  EXPECT_EQ(0, gray.Size());
+}
+
 }  // namespace
@@ -0,0 +1,98 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "libmv/image/blob_response.h"
+
+namespace libmv {
+namespace {
+
+#ifdef __SSE2__
+// Box sums of four consecutive rows, as UnsafeBoxIntegral() computes them,
+// for a column major integral image with the given number of rows.
+inline __m128i BoxIntegralFour(const unsigned int *ii, int ii_rows,
+                               int row, int col, int rows, int cols) {
+  const unsigned int *left = ii + (col - 1) * ii_rows;
+  const unsigned int *right = ii + (col + cols - 1) * ii_rows;
+  int r1 = row - 1;
+  int r2 = row + rows - 1;
+  __m128i A = _mm_loadu_si128((const __m128i *)(left + r1));
+  __m128i B = _mm_loadu_si128((const __m128i *)(right + r1));
+  __m128i C = _mm_loadu_si128((const __m128i *)(left + r2));
+  __m128i D = _mm_loadu_si128((const __m128i *)(right + r2));
+  // Wraps around in the intermediate results, but not in the sum.
+  return _mm_add_epi32(_mm_sub_epi32(_mm_sub_epi32(D, B), C), A);
+}
+
+inline __m128 ToFloat(__m128i x) {
+  return _mm_cvtepi32_ps(x);
+}
+
+inline __m128i TimesThree(__m128i x) {
+  return _mm_add_epi32(_mm_add_epi32(x, x), x);
+}
+#endif
+
+}  // namespace
+
+void BoxFilterResponses(const Matu &integral_image,
+                        int lobe_size,
+                        int row, int col, int step, int num_samples,
+                        float *Dxx, float *Dyy, float *Dxy) {
+  int i = 0;
+#ifdef __SSE2__
+  if (step == 1) {
+    const int L = lobe_size;
+    const int W = 3 * L;
+    const int B = W / 2;
+    const int c = col;
+    const unsigned int *ii = integral_image.data();
+    const int n = integral_image.rows();
+    for (; i + 4 <= num_samples; i += 4) {
+      int r = row + i;
+      __m128 dxx = _mm_sub_ps(
+          ToFloat(BoxIntegralFour(ii, n, r - L + 1, c - B, 2 * L - 1, W)),
+          ToFloat(TimesThree(
+              BoxIntegralFour(ii, n, r - L + 1, c - L / 2, 2 * L - 1, L))));
+      __m128 dyy = _mm_sub_ps(
+          ToFloat(BoxIntegralFour(ii, n, r - B, c - L + 1, W, 2 * L - 1)),
+          ToFloat(TimesThree(
+              BoxIntegralFour(ii, n, r - L / 2, c - L + 1, L, 2 * L - 1))));
+      __m128 dxy = _mm_sub_ps(_mm_sub_ps(_mm_add_ps(
+          ToFloat(BoxIntegralFour(ii, n, r - L, c + 1, L, L)),
+          ToFloat(BoxIntegralFour(ii, n, r + 1, c - L, L, L))),
+          ToFloat(BoxIntegralFour(ii, n, r - L, c - L, L, L))),
+          ToFloat(BoxIntegralFour(ii, n, r + 1, c + 1, L, L)));
+      _mm_storeu_ps(Dxx + i, dxx);
+      _mm_storeu_ps(Dyy + i, dyy);
+      _mm_storeu_ps(Dxy + i, dxy);
+    }
+  }
+#endif
+  // The remaining samples, and the strided ones, go through the generic path.
+  BoxFilterResponses<Matu, float>(integral_image, lobe_size,
+                                  row + i * step, col, step, num_samples - i,
+                                  Dxx + i, Dyy + i, Dxy + i);
+}
+
+}  // namespace libmv
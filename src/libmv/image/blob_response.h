@@ -21,6 +21,7 @@
 #ifndef LIBMV_IMAGE_BLOB_RESPONSE_H
 #define LIBMV_IMAGE_BLOB_RESPONSE_H
 
+#include <algorithm>
 #include <cmath>
 
 #include "libmv/image/integral_image.h"
@@ -29,6 +30,45 @@
 
 namespace libmv {
 
+// Compute the unnormalized approximate second derivatives Dxx, Dyy and Dxy
+// of a lobe_size box filter (see BlobResponse() below) at num_samples samples
+// of column col, starting at row and every step rows. integral_image must be
+// an integral image as computed by IntegralImage(), and the filters must fit
+// in it.
+template<typename TImage, typename Scalar>
+inline void BoxFilterResponses(const TImage &integral_image,
+                               int lobe_size,
+                               int row, int col, int step, int num_samples,
+                               Scalar *Dxx, Scalar *Dyy, Scalar *Dxy) {
+  const int L = lobe_size;
+  const int W = 3 * L;
+  const int B = W / 2;
+  const TImage &ii = integral_image;
+  for (int i = 0, r = row; i < num_samples; ++i, r += step) {
+    const int c = col;
+    // Compute filter responses, which approximate filtering by the
+    // derivative of a gaussian kernel (like in the KLT code).
+    Dxx[i] =   Scalar(UnsafeBoxIntegral(ii, r - L + 1, c - B,     2 * L - 1, W))
+             - Scalar(UnsafeBoxIntegral(ii, r - L + 1, c - L / 2, 2 * L - 1, L)*3);
+    Dyy[i] =   Scalar(UnsafeBoxIntegral(ii, r - B,     c - L + 1, W, 2 * L - 1))
+             - Scalar(UnsafeBoxIntegral(ii, r - L / 2, c - L + 1, L, 2 * L - 1)*3);
+    Dxy[i] = + Scalar(UnsafeBoxIntegral(ii, r - L, c + 1, L, L))
+             + Scalar(UnsafeBoxIntegral(ii, r + 1, c - L, L, L))
+             - Scalar(UnsafeBoxIntegral(ii, r - L, c - L, L, L))
+             - Scalar(UnsafeBoxIntegral(ii, r + 1, c + 1, L, L));
+  }
+}
+
+// Same as above for the column major unsigned integral images of byte images
+// used by SURF. The samples of a column are contiguous in memory, so with a
+// step of 1 four of them are evaluated at once with SSE2. The box sums are
+// exact in 32 bit integer arithmetic and must be below 2^31; the results are
+// identical to the generic version.
+void BoxFilterResponses(const Matu &integral_image,
+                        int lobe_size,
+                        int row, int col, int step, int num_samples,
+                        float *Dxx, float *Dyy, float *Dxy);
+
 // Compute the 'interestingness' of an image at a certain scale
 // Compute an approximate hessian for each pixel for the image used to generate
 // integral_image. integral_image must be an integral image as computed by
@@ -64,34 +104,34 @@ inline void BlobResponse(const TImage &integral_image,
   //blob_response->fill(0.);  // TODO(keir): Make border clearing smarter.
 
   int B = W / 2;
-  // Make the top left border so that UnsafeBoxIntegral is in bounds.
-  for (int r = B + 1; r < integral_image.rows() - B; r += scale) {
-    for (int c = B + 1; c < integral_image.cols() - B; c += scale) {
-      // Compute filter responses, which approximate filtering by the
-      // derivative of a gaussian kernel (like in the KLT code).
-      const TImage &ii = integral_image;
-      Scalar Dxx, Dxy, Dyy;
-      Dxx =   Scalar(UnsafeBoxIntegral(ii, r - L + 1, c - B,     2 * L - 1, W))
-            - Scalar(UnsafeBoxIntegral(ii, r - L + 1, c - L / 2, 2 * L - 1, L)*3);
-      Dyy =   Scalar(UnsafeBoxIntegral(ii, r - B,     c - L + 1, W, 2 * L - 1))
-            - Scalar(UnsafeBoxIntegral(ii, r - L / 2, c - L + 1, L, 2 * L - 1)*3);
-      Dxy = + Scalar(UnsafeBoxIntegral(ii, r - L, c + 1, L, L))
-            + Scalar(UnsafeBoxIntegral(ii, r + 1, c - L, L, L))
-            - Scalar(UnsafeBoxIntegral(ii, r - L, c - L, L, L))
-            - Scalar(UnsafeBoxIntegral(ii, r + 1, c + 1, L, L));
-
-      // Filter size should not affect response, so normalize by area.
-      Dxx *= Scalar(inverse_area);
-      Dyy *= Scalar(inverse_area);
-      Dxy *= Scalar(inverse_area);
-
-      // The 0.91 magic number is from the SURF paper; Equation 4 on page 4.
-      Scalar determinant = Dxx * Dyy - pow(0.91 * Dxy, 2);
-
-      // Clamp negative determinants, which indicate an edge rather than a blob.
-      (*blob_response)(r / scale, c / scale) = determinant > 0.0
-                                             ? determinant
-                                             : 0.0;
+  // Make the top left border so that UnsafeBoxIntegral is in bounds. The
+  // filters are evaluated a batch of samples of a column at a time.
+  const int kBatch = 64;
+  Scalar Dxx[kBatch], Dyy[kBatch], Dxy[kBatch];
+  int r_begin = B + 1;
+  int r_end = integral_image.rows() - B;
+  for (int c = B + 1; c < integral_image.cols() - B; c += scale) {
+    for (int r0 = r_begin; r0 < r_end; r0 += kBatch * scale) {
+      int num_samples = std::min(kBatch, (r_end - r0 + scale - 1) / scale);
+      BoxFilterResponses(integral_image, L, r0, c, scale, num_samples,
+                         Dxx, Dyy, Dxy);
+      for (int i = 0; i < num_samples; ++i) {
+        int r = r0 + i * scale;
+
+        // Filter size should not affect response, so normalize by area.
+        Dxx[i] *= Scalar(inverse_area);
+        Dyy[i] *= Scalar(inverse_area);
+        Dxy[i] *= Scalar(inverse_area);
+
+        // The 0.91 magic number is from the SURF paper; Equation 4 on page 4.
+        Scalar determinant = Dxx[i] * Dyy[i] - pow(0.91 * Dxy[i], 2);
+
+        // Clamp negative determinants, which indicate an edge rather than a
+        // blob.
+        (*blob_response)(r / scale, c / scale) = determinant > 0.0
+                                               ? determinant
+                                               : 0.0;
+      }
     }
   }
 }
@@ -109,4 +109,34 @@ TEST(SimpleCase, TwoPeaksScaled) {
   EXPECT_EQ(20, response.cols());
 }
 
+TEST(BoxFilterResponses, ByteIntegralImageMatchesGenericVersion) {
+  Array3Du image(60, 50);
+  unsigned seed = 1;
+  for (int r = 0; r < image.Height(); ++r) {
+    for (int c = 0; c < image.Width(); ++c) {
+      seed = seed * 1103515245u + 12345u;
+      image(r, c) = (seed >> 16) & 0xff;
+    }
+  }
+  Matu integral_image;
+  IntegralImage(image, &integral_image);
+
+  const int lobe_size = 5, row = 9, col = 20, num_samples = 23;
+  for (int step = 1; step <= 2; ++step) {
+    float Dxx[num_samples], Dyy[num_samples], Dxy[num_samples];
+    float expected_Dxx[num_samples], expected_Dyy[num_samples],
+          expected_Dxy[num_samples];
+    BoxFilterResponses(integral_image, lobe_size, row, col, step, num_samples,
+                       Dxx, Dyy, Dxy);
+    BoxFilterResponses<Matu, float>(integral_image, lobe_size, row, col, step,
+                                    num_samples, expected_Dxx, expected_Dyy,
+                                    expected_Dxy);
+    for (int i = 0; i < num_samples; ++i) {
+      EXPECT_EQ(expected_Dxx[i], Dxx[i]);
+      EXPECT_EQ(expected_Dyy[i], Dyy[i]);
+      EXPECT_EQ(expected_Dxy[i], Dxy[i]);
+    }
+  }
+}
+
 }  // namespace
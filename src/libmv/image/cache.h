@@ -23,11 +23,20 @@
 
 // A generic cache interface.
 
+#include <cstddef>
+#include <utility>
+
 namespace libmv {
 
 // Cache key / value pairs.  Pinned objects count toward maximum size
 // allowance, but do not prevent new pinned objects from being added (even if
-// maximum memory is exceeded). The units of size are deliberately unspecified.
+// maximum memory is exceeded). The units of size are deliberately unspecified;
+// sizes are 64 bits so that caches of bytes can exceed 2 GB.
+//
+// The cost passed with an item is a hint of what recomputing it would take,
+// in units of the caller's choosing, for the caches whose eviction policy is
+// cost aware; the others ignore it. A cost of 0 stands for a cost
+// proportional to the size of the item.
 template<typename K, typename V>
 class Cache {
  public:
@@ -35,15 +44,46 @@ class Cache {
   virtual void StoreAndPin(const K &key, V *value) {
     StoreAndPinSized(key, value, 1);
   }
-  virtual void StoreAndPinSized(const K &key, V *value, const int size) = 0;
+  virtual void StoreAndPinSized(const K &key, V *value, const long long size,
+                                const double cost = 0) = 0;
   virtual void Unpin(const K &key) = 0;
   virtual void MassUnpin() = 0;
   virtual bool ContainsKey(const K &key) = 0;
-  virtual void SetMaxSize(const int size) = 0;
-  virtual int MaxSize() const = 0;
-  virtual int Size() const = 0;
+  virtual void SetMaxSize(const long long size) = 0;
+  virtual long long MaxSize() const = 0;
+  virtual long long Size() const = 0;
   virtual ~Cache() {}
 };
+
+namespace cache {
+
+inline size_t HashValue(int x) {
+  return static_cast<size_t>(x);
+}
+
+inline size_t HashValue(const void *pointer) {
+  // Allocations are aligned; drop the low bits that are always zero.
+  size_t x = reinterpret_cast<size_t>(pointer);
+  return x ^ (x >> 4);
+}
+
+template<typename A, typename B>
+inline size_t HashValue(const std::pair<A, B> &pair) {
+  return HashValue(pair.first) * 31 + HashValue(pair.second);
+}
+
+// Default hash functor of the hashed caches; extend by adding a HashValue()
+// overload.
+template<typename K>
+struct Hash {
+  size_t operator()(const K &key) const {
+    // Mix the bits, since shards and buckets are picked with a modulo.
+    size_t h = HashValue(key) * 2654435761u;
+    return h ^ (h >> 15);
+  }
+};
+
+}  // namespace cache
 }  // namespace libmv
 
 #endif  // LIBMV_IMAGE_CACHE_H_
@@ -0,0 +1,301 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <zlib.h>
+
+#include "libmv/image/cached_image_sequence.h"
+#include "libmv/image/half.h"
+
+namespace libmv {
+
+namespace {
+
+// Fills bytes and returns true if ByteArrayToScaledFloatArray(bytes) gives
+// floats back exactly.
+bool UnscaleToBytes(const Array3Df &floats, Array3Du *bytes) {
+  bytes->ResizeLike(floats);
+  const float *in = floats.Data();
+  unsigned char *out = bytes->Data();
+  for (int i = 0; i < floats.Size(); ++i) {
+    int value = int(in[i] * 255.0f + 0.5f);
+    if (value < 0 || value > 255 || float(value) / 255.0f != in[i]) {
+      return false;
+    }
+    out[i] = value;
+  }
+  return true;
+}
+
+// Also returns the shape of the array.
+template<typename T>
+bool Deflate(const Array3D<T> &array, int *height, int *width, int *depth,
+             std::vector<unsigned char> *out) {
+  *height = array.Height();
+  *width = array.Width();
+  *depth = array.Depth();
+  uLong data_size = array.Size() * sizeof(T);
+  uLongf size = compressBound(data_size);
+  std::vector<unsigned char> buffer(size);
+  if (compress2(&buffer[0], &size,
+                reinterpret_cast<const Bytef *>(array.Data()), data_size,
+                Z_BEST_SPEED) != Z_OK) {
+    return false;
+  }
+  // Only keep the compressed bytes.
+  out->assign(buffer.begin(), buffer.begin() + size);
+  return true;
+}
+
+// The array must have the size of the deflated one.
+template<typename T>
+bool Inflate(const std::vector<unsigned char> &data, Array3D<T> *array) {
+  uLongf size = array->Size() * sizeof(T);
+  return uncompress(reinterpret_cast<Bytef *>(array->Data()), &size,
+                    &data[0], data.size()) == Z_OK &&
+         size == uLongf(array->Size() * sizeof(T));
+}
+
+}  // namespace
+
+CompressedImageStore::CompressedImageStore(long long max_size_in_bytes)
+    : images_(max_size_in_bytes) {
+  images_.SetMemoryCategory(MEMORY_FRAMES);
+}
+
+void CompressedImageStore::Store(const TaggedImageKey &key,
+                                 const Image &image) {
+  if (ContainsKey(key)) {
+    return;
+  }
+  LIBMV_SCOPED_TIMER("image_cache.deflate");
+  scoped_ptr<CompressedImage> compressed(new CompressedImage);
+  compressed->type = image.Type();
+  compressed->scaled_bytes = false;
+  int *height = &compressed->height;
+  int *width = &compressed->width;
+  int *depth = &compressed->depth;
+  std::vector<unsigned char> *data = &compressed->data;
+  bool deflated = false;
+  if (const Array3Du *byte_array = image.AsArray3Du()) {
+    deflated = Deflate(*byte_array, height, width, depth, data);
+  } else if (const Array3Df *float_array = image.AsArray3Df()) {
+    Array3Du bytes;
+    compressed->scaled_bytes = UnscaleToBytes(*float_array, &bytes);
+    deflated = compressed->scaled_bytes ?
+        Deflate(bytes, height, width, depth, data) :
+        Deflate(*float_array, height, width, depth, data);
+  } else if (const Array3Dh *half_array = image.AsArray3Dh()) {
+    deflated = Deflate(*half_array, height, width, depth, data);
+  }
+  if (!deflated) {
+    return;
+  }
+
+  MutexLock lock(&mutex_);
+  if (images_.ContainsKey(key)) {
+    return;
+  }
+  long long size = sizeof(CompressedImage) + compressed->data.size();
+  images_.StoreAndPinSized(key, compressed.release(), size);
+  images_.Unpin(key);
+}
+
+Image *CompressedImageStore::Load(const TaggedImageKey &key) {
+  CompressedImage *compressed;
+  {
+    MutexLock lock(&mutex_);
+    if (!images_.FetchAndPin(key, &compressed)) {
+      return NULL;
+    }
+  }
+  // The pin keeps the image from being evicted while it is inflated.
+  LIBMV_SCOPED_TIMER("image_cache.inflate");
+  Image *image = NULL;
+  int height = compressed->height;
+  int width = compressed->width;
+  int depth = compressed->depth;
+  if (compressed->type == Image::BYTE || compressed->scaled_bytes) {
+    Array3Du *bytes = new Array3Du(height, width, depth);
+    if (!Inflate(compressed->data, bytes)) {
+      delete bytes;
+    } else if (compressed->scaled_bytes) {
+      Array3Df *floats = new Array3Df;
+      ByteArrayToScaledFloatArray(*bytes, floats);
+      delete bytes;
+      image = new Image(floats);
+    } else {
+      image = new Image(bytes);
+    }
+  } else if (compressed->type == Image::FLOAT) {
+    Array3Df *floats = new Array3Df(height, width, depth);
+    if (Inflate(compressed->data, floats)) {
+      image = new Image(floats);
+    } else {
+      delete floats;
+    }
+  } else {
+    Array3Dh *halfs = new Array3Dh(height, width, depth);
+    if (Inflate(compressed->data, halfs)) {
+      image = new Image(halfs);
+    } else {
+      delete halfs;
+    }
+  }
+  MutexLock lock(&mutex_);
+  images_.Unpin(key);
+  return image;
+}
+
+bool CompressedImageStore::ContainsKey(const TaggedImageKey &key) {
+  MutexLock lock(&mutex_);
+  return images_.ContainsKey(key);
+}
+
+void CompressedImageStore::SetMaxSize(long long size) {
+  MutexLock lock(&mutex_);
+  images_.SetMaxSize(size);
+}
+
+long long CompressedImageStore::MaxSize() {
+  MutexLock lock(&mutex_);
+  return images_.MaxSize();
+}
+
+long long CompressedImageStore::Size() {
+  MutexLock lock(&mutex_);
+  return images_.Size();
+}
+
+CachedImageSequence::~CachedImageSequence() {
+  std::map<int, PinnedFrame>::iterator it;
+  for (it = pinned_.begin(); it != pinned_.end(); ++it) {
+    delete it->second.decoded;
+  }
+}
+
+Image *CachedImageSequence::GetImage(int i) {
+  Image *image;
+  TaggedImageKey cache_key(this, i);
+  if (!cache_->FetchAndPin(cache_key, &image)) {
+    image = LoadThroughCompressedTier(i);
+    if (!image) {
+      return 0;
+    }
+    if (half_precision_ && image->Type() == Image::FLOAT) {
+      Array3Dh *half_array = new Array3Dh;
+      FloatArrayToHalfArray(*image->AsArray3Df(), half_array);
+      delete image;
+      image = new Image(half_array);
+    }
+    // Another thread may have loaded the same image meanwhile.
+    image = cache_->InsertAndPinSized(cache_key, image,
+                                      image->MemorySizeInBytes());
+  }
+  if (half_precision_) {
+    MutexLock lock(&mutex_);
+    pinned_[i].pins++;
+  }
+  return image;
+}
+
+Image *CachedImageSequence::LoadThroughCompressedTier(int i) {
+  CompressedImageStore *tier = cache_->CompressedTier();
+  if (!tier) {
+    return LoadImage(i);
+  }
+  // The frame is stored as loaded, before any conversion to half precision.
+  TaggedImageKey key(this, i);
+  Image *image = tier->Load(key);
+  if (image) {
+    LIBMV_COUNTER("image_cache.compressed_hits", 1);
+    return image;
+  }
+  image = LoadImage(i);
+  if (image) {
+    tier->Store(key, *image);
+  }
+  return image;
+}
+
+FloatImage *CachedImageSequence::GetConvertedFloatImage(int i,
+                                                         const Image &image) {
+  Image *converted;
+  TaggedImageKey cache_key(ConvertedTag(), i);
+  if (!cache_->FetchAndPin(cache_key, &converted)) {
+    FloatImage *float_array = new FloatImage;
+    ByteArrayToScaledFloatArray(*image.AsArray3Du(), float_array);
+    converted = new Image(float_array);
+    converted = cache_->InsertAndPinSized(cache_key, converted,
+                                          converted->MemorySizeInBytes());
+  }
+  MutexLock lock(&mutex_);
+  pinned_[i].converted_pins++;
+  return converted->AsArray3Df();
+}
+
+FloatImage *CachedImageSequence::GetFloatImage(int i) {
+  Image *image = GetImage(i);
+  assert(image);
+  if (image->Type() == Image::BYTE) {
+    return GetConvertedFloatImage(i, *image);
+  }
+  if (image->Type() != Image::HALF) {
+    return image->AsArray3Df();
+  }
+  MutexLock lock(&mutex_);
+  PinnedFrame &frame = pinned_[i];
+  if (!frame.decoded) {
+    frame.decoded = new FloatImage;
+    HalfArrayToFloatArray(*image->AsArray3Dh(), frame.decoded);
+  }
+  return frame.decoded;
+}
+
+void CachedImageSequence::Unpin(int i) {
+  // GetImage() and GetFloatImage() are unpinned alike, so the pins of a
+  // converted frame are released with the first unpins of the frame.
+  bool unpin_converted = false;
+  {
+    MutexLock lock(&mutex_);
+    std::map<int, PinnedFrame>::iterator it = pinned_.find(i);
+    assert(!half_precision_ || it != pinned_.end());
+    if (it != pinned_.end()) {
+      PinnedFrame &frame = it->second;
+      if (half_precision_ && --frame.pins == 0) {
+        delete frame.decoded;
+        frame.decoded = NULL;
+      }
+      if (frame.converted_pins > 0) {
+        frame.converted_pins--;
+        unpin_converted = true;
+      }
+      if (frame.pins == 0 && frame.converted_pins == 0) {
+        pinned_.erase(it);
+      }
+    }
+  }
+  if (unpin_converted) {
+    cache_->Unpin(TaggedImageKey(ConvertedTag(), i));
+  }
+  TaggedImageKey cache_key(this, i);
+  cache_->Unpin(cache_key);
+}
+
+}  // namespace libmv
@@ -21,59 +21,246 @@
 #ifndef LIBMV_IMAGE_CACHED_IMAGE_SEQUENCE_H_
 #define LIBMV_IMAGE_CACHED_IMAGE_SEQUENCE_H_
 
+#include <map>
+#include <vector>
+
+#include "libmv/base/memory_budget.h"
+#include "libmv/base/scoped_ptr.h"
+#include "libmv/base/thread.h"
 #include "libmv/image/image.h"
 #include "libmv/image/lru_cache.h"
+#include "libmv/image/sharded_lru_cache.h"
 #include "libmv/image/image_sequence.h"
 
 namespace libmv {
 
+class DiskImageCache;
+
 // A key for a shared image cache. Typically the void * will be a pointer to
 // the image sequence that is using the cache.
 typedef std::pair<void *, int> TaggedImageKey;
 
-// A image cache that is shared among many image sequences (or anything that
-// produces images).
-class ImageCache : public LRUCache<TaggedImageKey, Image> {
+// A second tier below an ImageCache, which keeps frames deflated in memory by
+// zlib at its fastest level. A frame evicted from the cache is brought back by
+// inflating it, rather than by reading and decoding its file again.
+//
+// Float images holding the bytes scaled by ByteArrayToScaledFloatArray(), as
+// the frames read from 8 bit files do, are stored as the bytes, which are four
+// times smaller and deflate better; Load() returns the same floats. Sizes are
+// compressed bytes, accounted as MEMORY_FRAMES, and the least recently stored
+// or loaded images are dropped past the maximum size. Thread safe.
+class CompressedImageStore {
  public:
-  typedef LRUCache<TaggedImageKey, Image> Base;
-  ImageCache() : Base(10*1024*1024) {}
-  ImageCache(int max_cache_size_in_bytes) : Base(max_cache_size_in_bytes) {}
+  CompressedImageStore(long long max_size_in_bytes);
+
+  // Compresses a BYTE, FLOAT or HALF image, unless key is already stored.
+  void Store(const TaggedImageKey &key, const Image &image);
+  // Returns a new image inflated from the one stored under key, or NULL.
+  Image *Load(const TaggedImageKey &key);
+  bool ContainsKey(const TaggedImageKey &key);
+
+  void SetMaxSize(long long size);
+  long long MaxSize();
+  long long Size();
+
+ private:
+  struct CompressedImage {
+    Image::DataType type;
+    // A FLOAT image stored as its unscaled bytes.
+    bool scaled_bytes;
+    int height, width, depth;
+    std::vector<unsigned char> data;
+  };
+
+  Mutex mutex_;
+  LRUCache<TaggedImageKey, CompressedImage> images_;
 };
 
-class CachedImageSequence : public ImageSequence {
+// A image cache that is shared among many image sequences (or anything that
+// produces images). Sizes are in bytes. By default the cache does no locking;
+// a THREAD_SAFE cache can be used by several threads at the same time.
+//
+// The images are accounted as MEMORY_FRAMES (see libmv/base/memory_budget.h)
+// unless SetMemoryCategory() says otherwise, and are evicted under the memory
+// budget as well as under the maximum size. With SetCompressedTierSize(), the
+// sequences using the cache also keep their frames in a CompressedImageStore,
+// so that evicted frames are not loaded again. With SetDiskCache(), the
+// filtered sequences using the cache keep their frames across runs.
+class ImageCache : public Cache<TaggedImageKey, Image> {
  public:
-  virtual ~CachedImageSequence() {}
-  CachedImageSequence(ImageCache *cache)
-      : cache_(cache) {}
-
-  virtual Image *GetImage(int i) {
-    Image *image;
-    TaggedImageKey cache_key(this, i);
-    if (!cache_->FetchAndPin(cache_key, &image)) {
-      image = LoadImage(i);
-      if (!image) {
-        return 0;
-      }
-      cache_->StoreAndPinSized(cache_key, image, image->MemorySizeInBytes());
+  enum Locking {
+    SINGLE_THREADED,
+    THREAD_SAFE
+  };
+  typedef LRUCache<TaggedImageKey, Image> Base;
+  typedef ShardedLRUCache<TaggedImageKey, Image> ThreadSafeBase;
+
+  ImageCache()
+      : cache_storage_(NULL), thread_safe_cache_(NULL),
+        compressed_tier_(NULL), disk_cache_(NULL) {
+    Init(10*1024*1024, SINGLE_THREADED);
+  }
+  ImageCache(long long max_cache_size_in_bytes)
+      : cache_storage_(NULL), thread_safe_cache_(NULL),
+        compressed_tier_(NULL), disk_cache_(NULL) {
+    Init(max_cache_size_in_bytes, SINGLE_THREADED);
+  }
+  ImageCache(long long max_cache_size_in_bytes, Locking locking)
+      : cache_storage_(NULL), thread_safe_cache_(NULL),
+        compressed_tier_(NULL), disk_cache_(NULL) {
+    Init(max_cache_size_in_bytes, locking);
+  }
+
+  virtual bool FetchAndPin(const TaggedImageKey &key, Image **value) {
+    return cache_->FetchAndPin(key, value);
+  }
+  virtual void StoreAndPinSized(const TaggedImageKey &key,
+                                Image *value,
+                                const long long size,
+                                const double cost = 0) {
+    cache_->StoreAndPinSized(key, value, size, cost);
+  }
+  // Store an image, unless another thread already stored one for the same key
+  // in which case image is deleted. Returns the pinned image in the cache.
+  Image *InsertAndPinSized(const TaggedImageKey &key,
+                           Image *image,
+                           const long long size,
+                           const double cost = 0) {
+    if (thread_safe_cache_.get()) {
+      return thread_safe_cache_->InsertAndPinSized(key, image, size, cost);
     }
+    cache_->StoreAndPinSized(key, image, size, cost);
     return image;
   }
+  virtual void Unpin(const TaggedImageKey &key) {
+    cache_->Unpin(key);
+  }
+  virtual void MassUnpin() {
+    cache_->MassUnpin();
+  }
+  virtual bool ContainsKey(const TaggedImageKey &key) {
+    return cache_->ContainsKey(key);
+  }
+  virtual void SetMaxSize(const long long size) {
+    cache_->SetMaxSize(size);
+  }
+  virtual long long MaxSize() const {
+    return cache_->MaxSize();
+  }
+  virtual long long Size() const {
+    return cache_->Size();
+  }
+  bool IsThreadSafe() const {
+    return thread_safe_cache_.get() != NULL;
+  }
+  void SetMemoryCategory(MemoryCategory category) {
+    if (thread_safe_cache_.get()) {
+      thread_safe_cache_->SetMemoryCategory(category);
+    } else {
+      cache_storage_->SetMemoryCategory(category);
+    }
+  }
+  // Keeps the frames loaded through the cache in a compressed tier of at most
+  // max_size_in_bytes; 0 removes the tier. Call this before accessing any
+  // frame.
+  void SetCompressedTierSize(long long max_size_in_bytes) {
+    compressed_tier_.reset(max_size_in_bytes > 0 ?
+        new CompressedImageStore(max_size_in_bytes) : NULL);
+  }
+  // NULL without a compressed tier.
+  CompressedImageStore *CompressedTier() {
+    return compressed_tier_.get();
+  }
+  // The disk cache is not owned, and can be shared by several image caches.
+  // NULL, the default, stores nothing on disk.
+  void SetDiskCache(DiskImageCache *disk_cache) {
+    disk_cache_ = disk_cache;
+  }
+  DiskImageCache *DiskCache() {
+    return disk_cache_;
+  }
 
-  virtual void Unpin(int i) {
-    TaggedImageKey cache_key(this, i);
-    cache_->Unpin(cache_key);
+ private:
+  void Init(long long max_cache_size_in_bytes, Locking locking) {
+    if (locking == THREAD_SAFE) {
+      thread_safe_cache_.reset(new ThreadSafeBase(max_cache_size_in_bytes));
+      cache_ = thread_safe_cache_.get();
+    } else {
+      cache_storage_.reset(new Base(max_cache_size_in_bytes));
+      cache_ = cache_storage_.get();
+    }
+    SetMemoryCategory(MEMORY_FRAMES);
   }
 
+  scoped_ptr<Base> cache_storage_;
+  scoped_ptr<ThreadSafeBase> thread_safe_cache_;
+  Cache<TaggedImageKey, Image> *cache_;
+  scoped_ptr<CompressedImageStore> compressed_tier_;
+  DiskImageCache *disk_cache_;
+};
+
+class CachedImageSequence : public ImageSequence {
+ public:
+  virtual ~CachedImageSequence();
+  CachedImageSequence(ImageCache *cache)
+      : cache_(cache), half_precision_(false) {}
+
+  virtual Image *GetImage(int i);
+
+  // Same as ImageSequence::GetFloatImage(), but half precision frames are
+  // decoded into a float frame that is kept until the last pin on the frame
+  // is released, and byte frames are converted by
+  // ByteArrayToScaledFloatArray() into a float frame stored in the cache next
+  // to the byte frame, so that they are only converted again once evicted.
+  virtual FloatImage *GetFloatImage(int i);
+
+  virtual void Unpin(int i);
+
   virtual ImageCache *Cache() {
     return cache_;
   }
 
+  // Store the float frames returned by LoadImage() at half precision, so that
+  // the cache holds twice as many of them. GetImage() then returns HALF
+  // images; use GetFloatImage() to read them as floats. Call this before
+  // accessing any frame.
+  void SetHalfPrecisionStorage(bool half_precision) {
+    half_precision_ = half_precision;
+  }
+  bool HalfPrecisionStorage() const {
+    return half_precision_;
+  }
+
   // Subclasses must override these. The cached image sequence will take care
   // of storing the generated
   virtual Image *LoadImage(int i) = 0;
 
  private:
+  // A frame pinned by GetImage() or GetFloatImage() while using half
+  // precision storage. decoded is the float version of the frame, once
+  // GetFloatImage() was called. converted_pins counts the pins on the
+  // converted float frame of a byte frame, whatever the storage.
+  struct PinnedFrame {
+    PinnedFrame() : pins(0), decoded(NULL), converted_pins(0) {}
+    int pins;
+    FloatImage *decoded;
+    int converted_pins;
+  };
+
+  // LoadImage(), through the compressed tier of the cache if it has one.
+  Image *LoadThroughCompressedTier(int i);
+  FloatImage *GetConvertedFloatImage(int i, const Image &image);
+
+  // The converted float frames are cached under this tag rather than this,
+  // which tags the frames themselves.
+  void *ConvertedTag() {
+    return &pinned_;
+  }
+
   ImageCache *cache_;
+  bool half_precision_;
+  Mutex mutex_;
+  std::map<int, PinnedFrame> pinned_;
 };
 
 }  // namespace libmv
@@ -0,0 +1,189 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/image/cached_image_sequence.h"
+#include "libmv/image/half.h"
+#include "libmv/image/image.h"
+#include "testing/testing.h"
+
+using libmv::Array3Df;
+using libmv::Array3Du;
+using libmv::Array3Dh;
+using libmv::CachedImageSequence;
+using libmv::CompressedImageStore;
+using libmv::Image;
+using libmv::ImageCache;
+using libmv::TaggedImageKey;
+
+namespace {
+
+// Byte frames filled with 10 times their index.
+class ByteSequence : public CachedImageSequence {
+ public:
+  ByteSequence(ImageCache *cache) : CachedImageSequence(cache), loads(0) {}
+
+  virtual Image *LoadImage(int i) {
+    ++loads;
+    Array3Du *array = new Array3Du(3, 5);
+    array->Fill(10 * i);
+    return new Image(array);
+  }
+  virtual int Length() {
+    return 4;
+  }
+
+  int loads;
+};
+
+// The cache size of a frame and of its float conversion.
+int FrameSize() {
+  return Image(new Array3Du(3, 5)).MemorySizeInBytes() +
+         Image(new Array3Df(3, 5)).MemorySizeInBytes();
+}
+
+TEST(CachedImageSequence, ByteFramesAreConvertedOnce) {
+  ImageCache cache;
+  ByteSequence sequence(&cache);
+
+  Array3Df *image = sequence.GetFloatImage(2);
+  ASSERT_TRUE(image);
+  EXPECT_EQ(5, image->Width());
+  EXPECT_EQ(3, image->Height());
+  EXPECT_EQ(20 / 255.0f, (*image)(1, 3));
+  // The float frame is cached next to the byte frame.
+  EXPECT_EQ(FrameSize(), cache.Size());
+  EXPECT_EQ(image, sequence.GetFloatImage(2));
+  sequence.Unpin(2);
+  sequence.Unpin(2);
+
+  // Still cached once unpinned.
+  EXPECT_EQ(image, sequence.GetFloatImage(2));
+  EXPECT_EQ(Image::BYTE, sequence.GetImage(2)->Type());
+  sequence.Unpin(2);
+  sequence.Unpin(2);
+  EXPECT_EQ(1, sequence.loads);
+}
+
+TEST(CachedImageSequence, ConvertedFramesAreUnpinned) {
+  // Room for a single frame and its conversion.
+  ImageCache cache(FrameSize());
+  ByteSequence sequence(&cache);
+  for (int i = 0; i < sequence.Length(); ++i) {
+    ASSERT_TRUE(sequence.GetFloatImage(i));
+    sequence.Unpin(i);
+  }
+  // The earlier frames and their conversions were evicted.
+  EXPECT_EQ(FrameSize(), cache.Size());
+  Array3Df *image = sequence.GetFloatImage(0);
+  EXPECT_EQ(0.0f, (*image)(0, 0));
+  sequence.Unpin(0);
+  EXPECT_EQ(5, sequence.loads);
+}
+
+TEST(CachedImageSequence, EvictedFramesComeFromTheCompressedTier) {
+  ImageCache cache(FrameSize());
+  cache.SetCompressedTierSize(1024 * 1024);
+  ByteSequence sequence(&cache);
+  for (int i = 0; i < sequence.Length(); ++i) {
+    ASSERT_TRUE(sequence.GetFloatImage(i));
+    sequence.Unpin(i);
+  }
+  EXPECT_LT(0, cache.CompressedTier()->Size());
+
+  // Frame 0 was evicted, but is inflated rather than loaded again.
+  Array3Df *image = sequence.GetFloatImage(0);
+  EXPECT_EQ(0.0f, (*image)(0, 0));
+  sequence.Unpin(0);
+  EXPECT_EQ(Image::BYTE, sequence.GetImage(1)->Type());
+  EXPECT_EQ(10, (*sequence.GetImage(1)->AsArray3Du())(2, 4));
+  sequence.Unpin(1);
+  sequence.Unpin(1);
+  EXPECT_EQ(4, sequence.loads);
+}
+
+TEST(CompressedImageStore, ScaledBytesAreStoredAsBytes) {
+  CompressedImageStore store(1024 * 1024);
+  Array3Du bytes(16, 16, 3);
+  for (int i = 0; i < bytes.Size(); ++i) {
+    bytes.Data()[i] = i % 7 * 30;
+  }
+  Array3Df *floats = new Array3Df;
+  libmv::ByteArrayToScaledFloatArray(bytes, floats);
+  Image image(floats);
+  int a;
+  TaggedImageKey key(&a, 0);
+  store.Store(key, image);
+  EXPECT_TRUE(store.ContainsKey(key));
+  // Much smaller than the bytes, let alone the floats.
+  EXPECT_GT(bytes.Size(), store.Size());
+
+  Image *loaded = store.Load(key);
+  ASSERT_TRUE(loaded);
+  ASSERT_EQ(Image::FLOAT, loaded->Type());
+  EXPECT_TRUE(*floats == *loaded->AsArray3Df());
+  delete loaded;
+  EXPECT_FALSE(store.Load(TaggedImageKey(&a, 1)));
+}
+
+TEST(CompressedImageStore, OtherFloatsAndHalfsAreLossless) {
+  CompressedImageStore store(1024 * 1024);
+  Array3Df *floats = new Array3Df(9, 7);
+  for (int i = 0; i < floats->Size(); ++i) {
+    floats->Data()[i] = i * 0.123f - 2;
+  }
+  Image float_image(floats);
+  Array3Dh *halfs = new Array3Dh;
+  libmv::FloatArrayToHalfArray(*floats, halfs);
+  Image half_image(halfs);
+  int a;
+  store.Store(TaggedImageKey(&a, 0), float_image);
+  store.Store(TaggedImageKey(&a, 1), half_image);
+
+  Image *loaded = store.Load(TaggedImageKey(&a, 0));
+  ASSERT_TRUE(loaded && loaded->AsArray3Df());
+  EXPECT_TRUE(*floats == *loaded->AsArray3Df());
+  delete loaded;
+  loaded = store.Load(TaggedImageKey(&a, 1));
+  ASSERT_TRUE(loaded && loaded->AsArray3Dh());
+  EXPECT_TRUE(*halfs == *loaded->AsArray3Dh());
+  delete loaded;
+}
+
+TEST(CompressedImageStore, DropsTheLeastRecentlyUsed) {
+  Array3Du *bytes = new Array3Du(32, 32);
+  for (int i = 0; i < bytes->Size(); ++i) {
+    bytes->Data()[i] = i * 97;
+  }
+  Image image(bytes);
+  int a;
+  CompressedImageStore store(1024 * 1024);
+  store.Store(TaggedImageKey(&a, 0), image);
+  long long size = store.Size();
+  store.SetMaxSize(2 * size);
+  store.Store(TaggedImageKey(&a, 1), image);
+  delete store.Load(TaggedImageKey(&a, 0));
+  store.Store(TaggedImageKey(&a, 2), image);
+  EXPECT_EQ(2 * size, store.Size());
+  EXPECT_TRUE(store.ContainsKey(TaggedImageKey(&a, 0)));
+  EXPECT_FALSE(store.ContainsKey(TaggedImageKey(&a, 1)));
+  EXPECT_TRUE(store.ContainsKey(TaggedImageKey(&a, 2)));
+}
+
+}  // namespace
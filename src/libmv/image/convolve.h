@@ -32,11 +32,11 @@ namespace libmv {
 inline double Gaussian(double x, double sigma) {
   return 1/sqrt(2*M_PI*sigma*sigma) * exp(-(x*x/2/sigma/sigma));
 }
-// 2D gaussian (zero mean)
-// (9) in http://mathworld.wolfram.com/GaussianFunction.html
-inline double Gaussian2D(double x, double y, double sigma)
-{
-  return 1.0/(2.0*M_PI*sigma*sigma) * exp( -(x*x+y*y)/(2.0*sigma*sigma));
+// 2D gaussian (zero mean)
+// (9) in http://mathworld.wolfram.com/GaussianFunction.html
+inline double Gaussian2D(double x, double y, double sigma)
+{
+  return 1.0/(2.0*M_PI*sigma*sigma) * exp( -(x*x+y*y)/(2.0*sigma*sigma));
 }
 inline double GaussianDerivative(double x, double sigma) {
   return -x / sigma / sigma * Gaussian(x, sigma);
@@ -55,6 +55,18 @@ void ConvolveVertical(const FloatImage &in,
                       const Vec &kernel,
                       FloatImage *out_pointer,
                       int plane = -1);
+// Same as above for strided images, such as the views of a PaddedArray3D.
+// Every channel of in is convolved into the same channel of out, which must
+// have the same shape and must not overlap in. The vectorized paths are taken
+// when the pixels of a channel are contiguous, i.e. for planar layouts and
+// single channel images.
+void ConvolveHorizontal(const ArrayView3D<const float> &in,
+                        const Vec &kernel,
+                        const ArrayView3D<float> &out);
+void ConvolveVertical(const ArrayView3D<const float> &in,
+                      const Vec &kernel,
+                      const ArrayView3D<float> &out);
+
 void ConvolveGaussian(const FloatImage &in,
                       double sigma,
                       FloatImage *out_pointer);
@@ -76,6 +88,33 @@ void BlurredImageAndDerivativesChannels(const FloatImage &in,
                                         double sigma,
                                         FloatImage *blurred_and_gradxy);
 
+// Same as above for strided images. in must have one channel and
+// blurred_and_gradxy must have three channels and the same size; they can use
+// any layout.
+void BlurredImageAndDerivativesChannels(
+    const ArrayView3D<const float> &in,
+    double sigma,
+    const ArrayView3D<float> &blurred_and_gradxy);
+
+// Same as DownsampleChannelsBy2() followed by
+// BlurredImageAndDerivativesChannels() on the result, but in a single pass:
+// the rows of the downsampled image are produced as the blur requires them.
+// Used to build the next level of an image pyramid.
+void DownsampleBy2AndBlurredImageAndDerivativesChannels(
+    const FloatImage &in,
+    double sigma,
+    FloatImage *downsampled,
+    FloatImage *blurred_and_gradxy);
+
+// Gaussian blur followed by keeping every other row and column, computing
+// only the samples that are kept. The output has (Height() + 1) / 2 rows and
+// (Width() + 1) / 2 columns and the channels of in. Unlike ConvolveGaussian(),
+// the image is extended by repeating its border pixels, so the borders of the
+// result do not get darker.
+void BlurAndDownsampleBy2(const FloatImage &in,
+                          double sigma,
+                          FloatImage *out);
+
 void BoxFilterHorizontal(const FloatImage &in,
                          int window_size,
                          FloatImage *out_pointer);
@@ -18,10 +18,13 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <algorithm>
 #include <iostream>
 
 #include "libmv/image/convolve.h"
 #include "libmv/image/image.h"
+#include "libmv/image/padded_array.h"
+#include "libmv/image/sample.h"
 #include "libmv/numeric/numeric.h"
 #include "testing/testing.h"
 
@@ -107,4 +110,271 @@ TEST(Convolve, BlurredImageAndDerivativesChannelsVerticalSlope) {
   EXPECT_NEAR(blurred_and_derivatives(5, 5, 2),  2.0, 1e-7);
 }
 
+// Straightforward convolution with zero padding, used as a reference.
+static float ReferenceConvolve(const FloatImage &in, const Vec &kernel,
+                               int row, int column, bool horizontal) {
+  int halfwidth = kernel.size() / 2;
+  double sum = 0;
+  for (int l = 0; l < kernel.size(); ++l) {
+    int r = horizontal ? row : row - halfwidth + l;
+    int c = horizontal ? column - halfwidth + l : column;
+    if (in.Contains(r, c)) {
+      sum += in(r, c) * kernel(kernel.size() - 1 - l);
+    }
+  }
+  return static_cast<float>(sum);
+}
+
+TEST(Convolve, MatchesReferenceForAllKernelSizes) {
+  // Odd sizes, wider than a vertical tile, non-multiples of the SIMD width.
+  FloatImage image(23, 301);
+  for (int i = 0; i < image.Height(); ++i) {
+    for (int j = 0; j < image.Width(); ++j) {
+      image(i, j) = sin(0.37 * i) + cos(0.11 * j * i);
+    }
+  }
+  for (int size = 1; size <= 19; size += 2) {
+    Vec kernel(size);
+    for (int l = 0; l < size; ++l) {
+      kernel(l) = 1.0 / (l + 1);
+    }
+    FloatImage horizontal, vertical;
+    ConvolveHorizontal(image, kernel, &horizontal);
+    ConvolveVertical(image, kernel, &vertical);
+    for (int i = 0; i < image.Height(); ++i) {
+      for (int j = 0; j < image.Width(); ++j) {
+        EXPECT_EQ(ReferenceConvolve(image, kernel, i, j, true),
+                  horizontal(i, j)) << size << " " << i << " " << j;
+        EXPECT_EQ(ReferenceConvolve(image, kernel, i, j, false),
+                  vertical(i, j)) << size << " " << i << " " << j;
+      }
+    }
+  }
+}
+
+TEST(Convolve, ConvolveIntoChannel) {
+  FloatImage image(9, 13);
+  for (int i = 0; i < image.Height(); ++i) {
+    for (int j = 0; j < image.Width(); ++j) {
+      image(i, j) = i * j;
+    }
+  }
+  Vec kernel, derivative;
+  ComputeGaussianKernel(1, &kernel, &derivative);
+  FloatImage single, channels(9, 13, 3);
+  channels.Fill(-1);
+  ConvolveVertical(image, kernel, &single);
+  ConvolveVertical(image, kernel, &channels, 1);
+  for (int i = 0; i < image.Height(); ++i) {
+    for (int j = 0; j < image.Width(); ++j) {
+      EXPECT_EQ(single(i, j), channels(i, j, 1));
+      EXPECT_EQ(-1, channels(i, j, 0));
+      EXPECT_EQ(-1, channels(i, j, 2));
+    }
+  }
+}
+
+TEST(Convolve, BoxFilterVerticalMatchesConvolution) {
+  FloatImage image(17, 6, 3), filtered, convolved;
+  for (int i = 0; i < image.Height(); ++i) {
+    for (int j = 0; j < image.Width(); ++j) {
+      for (int k = 0; k < 3; ++k) {
+        image(i, j, k) = i + 2 * j + 3 * k;
+      }
+    }
+  }
+  BoxFilterVertical(image, 5, &filtered);
+  for (int i = 0; i < image.Height(); ++i) {
+    for (int j = 0; j < image.Width(); ++j) {
+      for (int k = 0; k < 3; ++k) {
+        float sum = 0;
+        for (int ii = std::max(0, i - 2); ii <= std::min(16, i + 2); ++ii) {
+          sum += image(ii, j, k);
+        }
+        EXPECT_EQ(sum, filtered(i, j, k));
+      }
+    }
+  }
+}
+
+// The fused single pass version must match separate separable convolutions.
+static void CheckFusedBlurMatchesSeparatePasses(const FloatImage &in,
+                                                double sigma,
+                                                const FloatImage &fused) {
+  Vec kernel, derivative;
+  ComputeGaussianKernel(sigma, &kernel, &derivative);
+  FloatImage tmp, blurred, gradient_x, gradient_y;
+  ConvolveVertical(in, kernel, &tmp);
+  ConvolveHorizontal(tmp, kernel, &blurred);
+  ConvolveHorizontal(tmp, derivative, &gradient_x);
+  ConvolveHorizontal(in, kernel, &tmp);
+  ConvolveVertical(tmp, derivative, &gradient_y);
+
+  ASSERT_EQ(in.Height(), fused.Height());
+  ASSERT_EQ(in.Width(), fused.Width());
+  ASSERT_EQ(3, fused.Depth());
+  for (int i = 0; i < in.Height(); ++i) {
+    for (int j = 0; j < in.Width(); ++j) {
+      EXPECT_EQ(blurred(i, j), fused(i, j, 0));
+      EXPECT_EQ(gradient_x(i, j), fused(i, j, 1));
+      EXPECT_NEAR(gradient_y(i, j), fused(i, j, 2), 1e-5);
+    }
+  }
+}
+
+static void MakeTestImage(int height, int width, FloatImage *image) {
+  image->Resize(height, width);
+  for (int i = 0; i < height; ++i) {
+    for (int j = 0; j < width; ++j) {
+      (*image)(i, j) = ((i * 7 + j * 13) % 17) / 17.0f + 0.01f * i;
+    }
+  }
+}
+
+TEST(Convolve, BlurredImageAndDerivativesChannelsMatchesSeparatePasses) {
+  FloatImage image, fused;
+  MakeTestImage(21, 37, &image);
+  // Sigmas giving specialized kernel sizes, a generic one, and a kernel
+  // larger than the image.
+  double sigmas[] = { 0.9, 1.5, 3.0, 9.0 };
+  for (int s = 0; s < 4; ++s) {
+    BlurredImageAndDerivativesChannels(image, sigmas[s], &fused);
+    CheckFusedBlurMatchesSeparatePasses(image, sigmas[s], fused);
+  }
+}
+
+TEST(Convolve, StridedImagesMatchDenseArrays) {
+  FloatImage image, fused, horizontal, vertical;
+  MakeTestImage(21, 37, &image);
+  Vec kernel, derivative;
+  ComputeGaussianKernel(1.5, &kernel, &derivative);
+  BlurredImageAndDerivativesChannels(image, 1.5, &fused);
+  ConvolveHorizontal(image, kernel, &horizontal);
+  ConvolveVertical(image, kernel, &vertical);
+
+  PaddedArray3D<float>::Layout layouts[] = {
+    PaddedArray3D<float>::INTERLEAVED,
+    PaddedArray3D<float>::PLANAR,
+  };
+  for (int l = 0; l < 2; ++l) {
+    PaddedArray3Df padded(1, 1, 1, layouts[l], 32);
+    padded.CopyFrom(image, 32);
+    EXPECT_EQ(0, reinterpret_cast<size_t>(padded.Data()) % 32);
+    EXPECT_EQ(0, padded.RowStride() % 8);
+
+    PaddedArray3Df padded_fused(21, 37, 3, layouts[l], 32);
+    BlurredImageAndDerivativesChannels(padded.View(), 1.5,
+                                       padded_fused.View());
+    PaddedArray3Df padded_horizontal(21, 37, 1, layouts[l], 32);
+    ConvolveHorizontal(padded.View(), kernel, padded_horizontal.View());
+    PaddedArray3Df padded_vertical(21, 37, 1, layouts[l], 32);
+    ConvolveVertical(padded.View(), kernel, padded_vertical.View());
+    for (int i = 0; i < 21; ++i) {
+      for (int j = 0; j < 37; ++j) {
+        for (int k = 0; k < 3; ++k) {
+          EXPECT_EQ(fused(i, j, k), padded_fused(i, j, k));
+        }
+        EXPECT_EQ(horizontal(i, j), padded_horizontal(i, j));
+        EXPECT_EQ(vertical(i, j), padded_vertical(i, j));
+        EXPECT_EQ(fused(i, j, 1),
+                  SampleLinear(padded_fused.View(), i, j, 1));
+      }
+    }
+  }
+}
+
+TEST(Convolve, DownsampleBy2AndBlurredImageAndDerivativesChannels) {
+  FloatImage image, expected_downsampled, downsampled, fused;
+  MakeTestImage(42, 30, &image);
+  DownsampleBy2AndBlurredImageAndDerivativesChannels(image, 0.9,
+                                                     &downsampled, &fused);
+  DownsampleChannelsBy2(image, &expected_downsampled);
+  ASSERT_EQ(expected_downsampled.Height(), downsampled.Height());
+  ASSERT_EQ(expected_downsampled.Width(), downsampled.Width());
+  for (int i = 0; i < downsampled.Height(); ++i) {
+    for (int j = 0; j < downsampled.Width(); ++j) {
+      EXPECT_EQ(expected_downsampled(i, j), downsampled(i, j));
+    }
+  }
+  CheckFusedBlurMatchesSeparatePasses(expected_downsampled, 0.9, fused);
+}
+
+TEST(Convolve, DownsampleBy2AndBlurredImageAndDerivativesChannelsOddSize) {
+  FloatImage image, expected_downsampled, downsampled, fused;
+  MakeTestImage(43, 31, &image);
+  DownsampleBy2AndBlurredImageAndDerivativesChannels(image, 0.9,
+                                                     &downsampled, &fused);
+  DownsampleChannelsBy2(image, &expected_downsampled);
+  ASSERT_EQ(22, downsampled.Height());
+  ASSERT_EQ(16, downsampled.Width());
+  for (int i = 0; i < downsampled.Height(); ++i) {
+    for (int j = 0; j < downsampled.Width(); ++j) {
+      EXPECT_EQ(expected_downsampled(i, j), downsampled(i, j));
+    }
+  }
+  CheckFusedBlurMatchesSeparatePasses(expected_downsampled, 0.9, fused);
+}
+
+TEST(Convolve, BlurAndDownsampleBy2) {
+  FloatImage image;
+  MakeTestImage(23, 30, &image);
+  Vec kernel, derivative;
+  ComputeGaussianKernel(1.2, &kernel, &derivative);
+  const int half_width = kernel.size() / 2;
+
+  FloatImage downsampled;
+  BlurAndDownsampleBy2(image, 1.2, &downsampled);
+  ASSERT_EQ(12, downsampled.Height());
+  ASSERT_EQ(15, downsampled.Width());
+  for (int r = 0; r < downsampled.Height(); ++r) {
+    for (int c = 0; c < downsampled.Width(); ++c) {
+      double expected = 0;
+      for (int k = 0; k < kernel.size(); ++k) {
+        for (int l = 0; l < kernel.size(); ++l) {
+          int y = std::min(std::max(2 * r + k - half_width, 0), 22);
+          int x = std::min(std::max(2 * c + l - half_width, 0), 29);
+          expected += kernel(k) * kernel(l) * image(y, x);
+        }
+      }
+      EXPECT_NEAR(expected, downsampled(r, c), 1e-5);
+    }
+  }
+
+  // Borders are extended, so constant images stay constant.
+  FloatImage constant(9, 7, 3);
+  constant.Fill(0.5);
+  BlurAndDownsampleBy2(constant, 2.0, &downsampled);
+  EXPECT_EQ(3, downsampled.Depth());
+  for (int i = 0; i < downsampled.Size(); ++i) {
+    EXPECT_NEAR(0.5, downsampled.Data()[i], 1e-6);
+  }
+}
+
+TEST(Convolve, BoxFilterHorizontalChannels) {
+  // The unrolled depths and the generic one give the channels of
+  // single channel filtering.
+  for (int depth = 1; depth <= 4; ++depth) {
+    FloatImage image(6, 11, depth), filtered;
+    for (int i = 0; i < image.Size(); ++i) {
+      image.Data()[i] = (i * 5) % 9;
+    }
+    BoxFilterHorizontal(image, 5, &filtered);
+    ASSERT_EQ(depth, filtered.Depth());
+    for (int k = 0; k < depth; ++k) {
+      FloatImage channel(6, 11), filtered_channel;
+      for (int i = 0; i < 6; ++i) {
+        for (int j = 0; j < 11; ++j) {
+          channel(i, j) = image(i, j, k);
+        }
+      }
+      BoxFilterHorizontal(channel, 5, &filtered_channel);
+      for (int i = 0; i < 6; ++i) {
+        for (int j = 0; j < 11; ++j) {
+          EXPECT_EQ(filtered_channel(i, j), filtered(i, j, k));
+        }
+      }
+    }
+  }
+}
+
 }  // namespace
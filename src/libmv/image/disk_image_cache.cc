@@ -0,0 +1,417 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+#include "libmv/image/disk_image_cache.h"
+#include "libmv/image/half.h"
+#include "libmv/logging/logging.h"
+
+namespace libmv {
+
+namespace {
+
+const char kMagic[4] = { 'L', 'M', 'V', 'A' };
+const unsigned int kVersion = 1;
+const int kHeaderFields = 6;
+const int kAlignment = 16;
+const char kExtension[] = ".array";
+
+unsigned int Fnv1a(const char *data, size_t size, unsigned int hash) {
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+const unsigned int kFnvOffset = 2166136261u;
+
+size_t Padding(size_t size) {
+  return (kAlignment - size % kAlignment) % kAlignment;
+}
+
+// The pixels of an image, whatever their type.
+struct Pixels {
+  Pixels() : data(NULL), size(0), height(0), width(0), depth(0) {}
+  template<typename T>
+  explicit Pixels(const Array3D<T> &array)
+      : data(array.Data()), size(array.Size() * sizeof(T)),
+        height(array.Height()), width(array.Width()), depth(array.Depth()) {}
+  const void *data;
+  size_t size;
+  int height, width, depth;
+};
+
+bool GetPixels(const Image &image, Pixels *pixels) {
+  if (image.AsArray3Du()) {
+    *pixels = Pixels(*image.AsArray3Du());
+  } else if (image.AsArray3Df()) {
+    *pixels = Pixels(*image.AsArray3Df());
+  } else if (image.AsArray3Dh()) {
+    *pixels = Pixels(*image.AsArray3Dh());
+  } else {
+    return false;
+  }
+  return true;
+}
+
+template<typename T>
+Image *ReadArray(FILE *file, int height, int width, int depth) {
+  Array3D<T> *array = new Array3D<T>(height, width, depth);
+  size_t size = array->Size();
+  if (fread(array->Data(), sizeof(T), size, file) != size) {
+    delete array;
+    return NULL;
+  }
+  return new Image(array);
+}
+
+long long FileSize(FILE *file) {
+  if (fseek(file, 0, SEEK_END) != 0) {
+    return 0;
+  }
+  return ftell(file);
+}
+
+// Returns NULL if the file does not exist, is not an image file or was
+// written for another key.
+Image *ReadImageFile(const std::string &filename, const std::string &key,
+                     long long *file_size) {
+  FILE *file = fopen(filename.c_str(), "rb");
+  if (!file) {
+    return NULL;
+  }
+  char magic[sizeof(kMagic)];
+  unsigned int header[kHeaderFields];
+  bool ok = fread(magic, sizeof(magic), 1, file) == 1 &&
+            memcmp(magic, kMagic, sizeof(kMagic)) == 0 &&
+            fread(header, sizeof(header), 1, file) == 1 &&
+            header[0] == kVersion &&
+            header[5] == key.size();
+  if (ok) {
+    size_t key_size = key.size() +
+        Padding(sizeof(kMagic) + sizeof(header) + key.size());
+    std::vector<char> stored_key(key_size + 1);
+    ok = fread(&stored_key[0], 1, key_size, file) == key_size &&
+         key.compare(0, key.size(), &stored_key[0], key.size()) == 0;
+  }
+  Image *image = NULL;
+  if (ok) {
+    int height = header[2], width = header[3], depth = header[4];
+    switch (header[1]) {
+      case Image::BYTE:
+        image = ReadArray<unsigned char>(file, height, width, depth);
+        break;
+      case Image::FLOAT:
+        image = ReadArray<float>(file, height, width, depth);
+        break;
+      case Image::HALF:
+        image = ReadArray<unsigned short>(file, height, width, depth);
+        break;
+    }
+  }
+  if (image) {
+    *file_size = FileSize(file);
+  }
+  fclose(file);
+  return image;
+}
+
+bool WriteImageFile(const std::string &filename, const std::string &key,
+                    const Image &image, long long *file_size) {
+  Pixels pixels;
+  if (!GetPixels(image, &pixels)) {
+    LOG(ERROR) << "Cannot store images of type " << image.Type()
+               << " in the disk cache.";
+    return false;
+  }
+  std::string temporary = filename + ".tmp";
+  FILE *file = fopen(temporary.c_str(), "wb");
+  if (!file) {
+    LOG(ERROR) << "Cannot write the image cache file " << temporary;
+    return false;
+  }
+  unsigned int header[kHeaderFields] = {
+    kVersion, image.Type(), pixels.height, pixels.width, pixels.depth,
+    key.size()
+  };
+  std::string padded_key = key;
+  padded_key.resize(key.size() +
+                    Padding(sizeof(kMagic) + sizeof(header) + key.size()),
+                    '\0');
+  bool ok = fwrite(kMagic, sizeof(kMagic), 1, file) == 1 &&
+            fwrite(header, sizeof(header), 1, file) == 1 &&
+            fwrite(padded_key.data(), 1, padded_key.size(), file) ==
+                padded_key.size() &&
+            fwrite(pixels.data, 1, pixels.size, file) == pixels.size;
+  ok = fclose(file) == 0 && ok;
+  if (ok && std::rename(temporary.c_str(), filename.c_str()) != 0) {
+    // Windows does not replace an existing file.
+    std::remove(filename.c_str());
+    ok = std::rename(temporary.c_str(), filename.c_str()) == 0;
+  }
+  if (!ok) {
+    std::remove(temporary.c_str());
+    LOG(ERROR) << "Cannot write the image cache file " << filename;
+    return false;
+  }
+  *file_size = sizeof(kMagic) + sizeof(header) + padded_key.size() +
+               pixels.size;
+  return true;
+}
+
+}  // namespace
+
+bool MakeFileContentKey(const std::string &filename, std::string *key) {
+  FILE *file = fopen(filename.c_str(), "rb");
+  if (!file) {
+    return false;
+  }
+  long long size = 0;
+  unsigned int hash = kFnvOffset;
+  char buffer[1 << 16];
+  size_t num_read;
+  while ((num_read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    hash = Fnv1a(buffer, num_read, hash);
+    size += num_read;
+  }
+  bool ok = !ferror(file);
+  fclose(file);
+  if (!ok) {
+    return false;
+  }
+  char content_key[64];
+  sprintf(content_key, "%lld:%08x", size, hash);
+  *key = content_key;
+  return true;
+}
+
+DiskImageCache::DiskImageCache(const std::string &directory,
+                               long long max_size_in_bytes)
+    : directory_(directory), max_size_(max_size_in_bytes), size_(0) {
+#ifdef _WIN32
+  _mkdir(directory_.c_str());
+#else
+  mkdir(directory_.c_str(), 0755);
+#endif
+  ScanDirectory();
+  MutexLock lock(&mutex_);
+  RemoveFilesIfNecessary();
+}
+
+DiskImageCache::~DiskImageCache() {
+  MassUnpin();
+}
+
+std::string DiskImageCache::Filename(const std::string &key) const {
+  char name[32];
+  sprintf(name, "%08x", Fnv1a(key.data(), key.size(), kFnvOffset));
+  return directory_ + "/" + name + kExtension;
+}
+
+bool DiskImageCache::FetchAndPin(const std::string &key, Image **value) {
+  MutexLock lock(&mutex_);
+  std::map<std::string, PinnedImage>::iterator it = pinned_.find(key);
+  if (it != pinned_.end()) {
+    it->second.pins++;
+    *value = it->second.image;
+    return true;
+  }
+  std::string filename = Filename(key);
+  long long file_size;
+  Image *image = ReadImageFile(filename, key, &file_size);
+  if (!image) {
+    LIBMV_COUNTER("disk_cache.misses", 1);
+    return false;
+  }
+  LIBMV_COUNTER("disk_cache.hits", 1);
+  Touch(filename, file_size);
+  PinnedImage &pinned = pinned_[key];
+  pinned.image = image;
+  pinned.pins = 1;
+  *value = image;
+  return true;
+}
+
+void DiskImageCache::StoreAndPinSized(const std::string &key, Image *value,
+                                      const long long size,
+                                      const double cost) {
+  (void) size;
+  (void) cost;
+  MutexLock lock(&mutex_);
+  assert(!pinned_.count(key));
+  std::string filename = Filename(key);
+  long long file_size;
+  if (WriteImageFile(filename, key, *value, &file_size)) {
+    Touch(filename, file_size);
+  }
+  // The image is pinned even if it could not be written.
+  PinnedImage &pinned = pinned_[key];
+  pinned.image = value;
+  pinned.pins = 1;
+  RemoveFilesIfNecessary();
+}
+
+void DiskImageCache::Unpin(const std::string &key) {
+  MutexLock lock(&mutex_);
+  std::map<std::string, PinnedImage>::iterator it = pinned_.find(key);
+  assert(it != pinned_.end());
+  if (--it->second.pins == 0) {
+    delete it->second.image;
+    pinned_.erase(it);
+    RemoveFilesIfNecessary();
+  }
+}
+
+void DiskImageCache::MassUnpin() {
+  MutexLock lock(&mutex_);
+  std::map<std::string, PinnedImage>::iterator it;
+  for (it = pinned_.begin(); it != pinned_.end(); ++it) {
+    delete it->second.image;
+  }
+  pinned_.clear();
+  RemoveFilesIfNecessary();
+}
+
+bool DiskImageCache::ContainsKey(const std::string &key) {
+  MutexLock lock(&mutex_);
+  if (pinned_.count(key)) {
+    return true;
+  }
+  // A file of another key with the same name is only told apart by reading
+  // it, which FetchAndPin() does.
+  std::string filename = Filename(key);
+  if (files_.count(filename)) {
+    return true;
+  }
+  FILE *file = fopen(filename.c_str(), "rb");
+  if (file) {
+    fclose(file);
+  }
+  return file != NULL;
+}
+
+void DiskImageCache::SetMaxSize(const long long size) {
+  MutexLock lock(&mutex_);
+  max_size_ = size;
+  RemoveFilesIfNecessary();
+}
+
+long long DiskImageCache::MaxSize() const {
+  MutexLock lock(&mutex_);
+  return max_size_;
+}
+
+long long DiskImageCache::Size() const {
+  MutexLock lock(&mutex_);
+  return size_;
+}
+
+void DiskImageCache::ScanDirectory() {
+#ifndef _WIN32
+  // Without a scan the files of earlier runs are still found, but they only
+  // count toward the size once used.
+  DIR *dir = opendir(directory_.c_str());
+  if (!dir) {
+    LOG(ERROR) << "Cannot open the image cache directory " << directory_;
+    return;
+  }
+  // The oldest files are the first to go.
+  std::multimap<time_t, std::string> by_time;
+  std::map<std::string, long long> sizes;
+  size_t extension_size = strlen(kExtension);
+  while (struct dirent *entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    if (name.size() <= extension_size ||
+        name.compare(name.size() - extension_size, extension_size,
+                     kExtension) != 0) {
+      continue;
+    }
+    std::string filename = directory_ + "/" + name;
+    struct stat status;
+    if (stat(filename.c_str(), &status) == 0) {
+      by_time.insert(std::make_pair(status.st_mtime, filename));
+      sizes[filename] = status.st_size;
+    }
+  }
+  closedir(dir);
+  MutexLock lock(&mutex_);
+  std::multimap<time_t, std::string>::iterator it;
+  for (it = by_time.begin(); it != by_time.end(); ++it) {
+    Touch(it->second, sizes[it->second]);
+  }
+#endif
+}
+
+void DiskImageCache::Touch(const std::string &filename, long long size) {
+  Forget(filename);
+  use_order_.push_front(filename);
+  File &file = files_[filename];
+  file.size = size;
+  file.use = use_order_.begin();
+  size_ += size;
+}
+
+void DiskImageCache::Forget(const std::string &filename) {
+  std::map<std::string, File>::iterator it = files_.find(filename);
+  if (it != files_.end()) {
+    size_ -= it->second.size;
+    use_order_.erase(it->second.use);
+    files_.erase(it);
+  }
+}
+
+void DiskImageCache::RemoveFilesIfNecessary() {
+  if (size_ <= max_size_) {
+    return;
+  }
+  std::set<std::string> pinned_files;
+  std::map<std::string, PinnedImage>::iterator p;
+  for (p = pinned_.begin(); p != pinned_.end(); ++p) {
+    pinned_files.insert(Filename(p->first));
+  }
+  UseOrder::iterator it = use_order_.end();
+  while (size_ > max_size_ && it != use_order_.begin()) {
+    --it;
+    if (pinned_files.count(*it)) {
+      continue;
+    }
+    std::string filename = *it;
+    // Forget() erases the file from the use order; keep the next one.
+    ++it;
+    std::remove(filename.c_str());
+    Forget(filename);
+  }
+}
+
+}  // namespace libmv
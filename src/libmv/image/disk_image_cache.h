@@ -0,0 +1,108 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_IMAGE_DISK_IMAGE_CACHE_H_
+#define LIBMV_IMAGE_DISK_IMAGE_CACHE_H_
+
+#include <list>
+#include <map>
+#include <string>
+
+#include "libmv/base/thread.h"
+#include "libmv/image/cache.h"
+#include "libmv/image/image.h"
+
+namespace libmv {
+
+// Fills a key identifying the contents of a file, "<size>:<FNV-1a hash>", for
+// ImageSequence::FrameKey(). Returns false if the file cannot be read.
+bool MakeFileContentKey(const std::string &filename, std::string *key);
+
+// A cache of images kept in files of a directory, so that derived frames
+// survive from one run to the next. The keys describe the contents of the
+// images, such as the content key of a source file followed by the
+// parameters of the filters applied to it (see FilteredImageSequence), so a
+// key never needs to be invalidated: an image is found again exactly when it
+// would be computed again the same way.
+//
+// FetchAndPin() reads the file into an image owned by the cache until the
+// last Unpin(); StoreAndPinSized() writes the image at once and takes
+// ownership of it, whose key must not be pinned. Sizes are bytes of files; the size passed to
+// StoreAndPinSized() is ignored. Past the maximum size, the least recently
+// used files that are not pinned are removed, including the files found in
+// the directory when the cache was created. Only BYTE, FLOAT and HALF images
+// can be stored. Thread safe.
+//
+// Each file holds, in native byte order: "LMVA", the version, the image type,
+// height, width, depth and key length as 32 bit unsigned integers; the key,
+// padded with zeros to a multiple of 16 bytes; and the pixels, laid out like
+// the array. The pixels are aligned so the file can be mapped and read in
+// place. Files are written under a temporary name and renamed, so that an
+// interrupted run never leaves a truncated file.
+class DiskImageCache : public Cache<std::string, Image> {
+ public:
+  // The directory is created if needed.
+  DiskImageCache(const std::string &directory, long long max_size_in_bytes);
+  virtual ~DiskImageCache();
+
+  virtual bool FetchAndPin(const std::string &key, Image **value);
+  virtual void StoreAndPinSized(const std::string &key, Image *value,
+                                const long long size, const double cost = 0);
+  virtual void Unpin(const std::string &key);
+  virtual void MassUnpin();
+  virtual bool ContainsKey(const std::string &key);
+  virtual void SetMaxSize(const long long size);
+  virtual long long MaxSize() const;
+  virtual long long Size() const;
+
+  // The file of a key in the directory.
+  std::string Filename(const std::string &key) const;
+
+ private:
+  struct PinnedImage {
+    PinnedImage() : image(NULL), pins(0) {}
+    Image *image;
+    int pins;
+  };
+  // The files, the most recently used first, by file name.
+  typedef std::list<std::string> UseOrder;
+  struct File {
+    long long size;
+    UseOrder::iterator use;
+  };
+
+  void ScanDirectory();
+  // Moves the file to the front of the use order, adding it if needed.
+  void Touch(const std::string &filename, long long size);
+  void Forget(const std::string &filename);
+  void RemoveFilesIfNecessary();
+
+  std::string directory_;
+  long long max_size_;
+  long long size_;
+  std::map<std::string, PinnedImage> pinned_;
+  std::map<std::string, File> files_;
+  UseOrder use_order_;
+  mutable Mutex mutex_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_IMAGE_DISK_IMAGE_CACHE_H_
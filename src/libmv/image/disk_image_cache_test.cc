@@ -0,0 +1,172 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstdio>
+#include <string>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "libmv/image/disk_image_cache.h"
+#include "libmv/image/filtered_sequence.h"
+#include "libmv/image/image.h"
+#include "libmv/image/mock_image_sequence.h"
+#include "testing/testing.h"
+
+using namespace libmv;
+using std::string;
+
+namespace {
+
+string CacheDirectory() {
+  return string(THIS_SOURCE_DIR) + "/disk_image_cache_test";
+}
+
+// Removes the files of the cache and its directory.
+void RemoveCache(DiskImageCache *cache) {
+  cache->MassUnpin();
+  cache->SetMaxSize(0);
+  EXPECT_EQ(0, cache->Size());
+#ifndef _WIN32
+  rmdir(CacheDirectory().c_str());
+#endif
+}
+
+Image *RampImage(int height, int width) {
+  Array3Df *array = new Array3Df(height, width, 2);
+  for (int i = 0; i < array->Size(); ++i) {
+    array->Data()[i] = i * 0.25f;
+  }
+  return new Image(array);
+}
+
+TEST(DiskImageCache, ImagesOutliveTheCache) {
+  Image *image = RampImage(3, 5);
+  Array3Df expected(*image->AsArray3Df());
+  {
+    DiskImageCache cache(CacheDirectory(), 1 << 20);
+    cache.StoreAndPinSized("frame 0|blur", image, 0);
+    cache.Unpin("frame 0|blur");
+    EXPECT_LT(expected.Size() * 4, cache.Size());
+  }
+  DiskImageCache cache(CacheDirectory(), 1 << 20);
+  // The file of the earlier run was found.
+  EXPECT_LT(expected.Size() * 4, cache.Size());
+  EXPECT_TRUE(cache.ContainsKey("frame 0|blur"));
+  Image *stored;
+  ASSERT_TRUE(cache.FetchAndPin("frame 0|blur", &stored));
+  ASSERT_TRUE(stored->AsArray3Df());
+  EXPECT_TRUE(expected == *stored->AsArray3Df());
+  // Pinned again, the image is not read again.
+  Image *again;
+  ASSERT_TRUE(cache.FetchAndPin("frame 0|blur", &again));
+  EXPECT_EQ(stored, again);
+  cache.Unpin("frame 0|blur");
+  cache.Unpin("frame 0|blur");
+
+  EXPECT_FALSE(cache.FetchAndPin("frame 1|blur", &stored));
+  RemoveCache(&cache);
+}
+
+TEST(DiskImageCache, ByteImages) {
+  DiskImageCache cache(CacheDirectory(), 1 << 20);
+  Array3Du *bytes = new Array3Du(4, 4, 3);
+  bytes->Fill(7);
+  cache.StoreAndPinSized("bytes", new Image(bytes), 0);
+  cache.Unpin("bytes");
+  Image *stored;
+  ASSERT_TRUE(cache.FetchAndPin("bytes", &stored));
+  ASSERT_TRUE(stored->AsArray3Du());
+  EXPECT_EQ(7, (*stored->AsArray3Du())(3, 3, 2));
+  cache.Unpin("bytes");
+  RemoveCache(&cache);
+}
+
+TEST(DiskImageCache, RemovesTheLeastRecentlyUsedFiles) {
+  DiskImageCache cache(CacheDirectory(), 1 << 20);
+  cache.StoreAndPinSized("a", RampImage(8, 8), 0);
+  long long file_size = cache.Size();
+  cache.SetMaxSize(2 * file_size);
+  cache.StoreAndPinSized("b", RampImage(8, 8), 0);
+  cache.Unpin("a");
+  cache.Unpin("b");
+  Image *stored;
+  ASSERT_TRUE(cache.FetchAndPin("a", &stored));
+  cache.Unpin("a");
+  cache.StoreAndPinSized("c", RampImage(8, 8), 0);
+  cache.Unpin("c");
+  EXPECT_EQ(2 * file_size, cache.Size());
+  EXPECT_TRUE(cache.ContainsKey("a"));
+  EXPECT_FALSE(cache.ContainsKey("b"));
+  EXPECT_TRUE(cache.ContainsKey("c"));
+  RemoveCache(&cache);
+}
+
+// Frames whose contents are known.
+class KeyedSequence : public MockImageSequence {
+ public:
+  KeyedSequence(ImageCache *cache) : MockImageSequence(cache) {}
+  virtual std::string FrameKey(int i) {
+    return i == 0 ? "frame 0" : "";
+  }
+};
+
+class CountingFilter : public Filter {
+ public:
+  CountingFilter(int *runs) : runs_(runs) {}
+  virtual void RunFilter(const Array3Df &source, Array3Df *destination) {
+    ++*runs_;
+    destination->ResizeLike(source);
+    for (int i = 0; i < source.Size(); ++i) {
+      destination->Data()[i] = 2 * source.Data()[i];
+    }
+  }
+  virtual std::string Parameters() const {
+    return "double";
+  }
+  int *runs_;
+};
+
+TEST(DiskImageCache, FilteredFramesAreNotComputedAgain) {
+  DiskImageCache disk_cache(CacheDirectory(), 1 << 20);
+  Array3Df frame0(3, 3), frame1(3, 3);
+  frame0.Fill(1);
+  frame1.Fill(2);
+  int runs = 0;
+  for (int run = 0; run < 2; ++run) {
+    ImageCache cache;
+    cache.SetDiskCache(&disk_cache);
+    KeyedSequence source(&cache);
+    source.Append(&frame0);
+    source.Append(&frame1);
+    FilteredImageSequence filtered(&source, new CountingFilter(&runs));
+    EXPECT_EQ("frame 0|double", filtered.FrameKey(0));
+    EXPECT_EQ(2.0, (*filtered.GetFloatImage(0))(1, 1));
+    EXPECT_EQ(4.0, (*filtered.GetFloatImage(1))(1, 1));
+    filtered.Unpin(0);
+    filtered.Unpin(1);
+  }
+  // Frame 1 has no key, so is filtered by both runs.
+  EXPECT_EQ(3, runs);
+  RemoveCache(&disk_cache);
+}
+
+}  // namespace
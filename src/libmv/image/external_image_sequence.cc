@@ -0,0 +1,66 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstring>
+
+#include "libmv/image/external_image_sequence.h"
+#include "libmv/logging/logging.h"
+
+namespace libmv {
+
+namespace {
+
+template<typename T>
+Image *WrapOrCopyFrame(const ExternalFrame &frame) {
+  Array3D<T> *array = new Array3D<T>;
+  int row_size = frame.width * frame.depth * sizeof(T);
+  if (frame.row_stride == 0 || frame.row_stride == row_size) {
+    array->WrapData(static_cast<T *>(frame.data),
+                    frame.height, frame.width, frame.depth,
+                    frame.release, frame.context);
+  } else {
+    LIBMV_SCOPED_TIMER("external_image_sequence.copy");
+    array->Resize(frame.height, frame.width, frame.depth);
+    const char *row = static_cast<const char *>(frame.data);
+    for (int y = 0; y < frame.height; ++y, row += frame.row_stride) {
+      memcpy(&(*array)(y, 0, 0), row, row_size);
+    }
+    if (frame.release) {
+      frame.release(frame.context);
+    }
+  }
+  return new Image(array);
+}
+
+}  // namespace
+
+Image *ExternalImageSequence::LoadImage(int i) {
+  ExternalFrame frame;
+  if (!source_->GetFrame(i, &frame)) {
+    LOG(ERROR) << "No buffer for frame " << i;
+    return NULL;
+  }
+  if (frame.format == ExternalFrame::FLOAT) {
+    return WrapOrCopyFrame<float>(frame);
+  }
+  return WrapOrCopyFrame<unsigned char>(frame);
+}
+
+}  // namespace libmv
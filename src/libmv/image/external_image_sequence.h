@@ -0,0 +1,108 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_IMAGE_EXTERNAL_IMAGE_SEQUENCE_H_
+#define LIBMV_IMAGE_EXTERNAL_IMAGE_SEQUENCE_H_
+
+#include <string>
+
+#include "libmv/image/cached_image_sequence.h"
+
+namespace libmv {
+
+// A frame in memory owned by the application embedding the library.
+struct ExternalFrame {
+  enum Format {
+    BYTE,   // unsigned char samples, as ByteImage.
+    FLOAT   // float samples, as FloatImage.
+  };
+
+  ExternalFrame()
+      : data(NULL), height(0), width(0), depth(1), row_stride(0),
+        format(BYTE), release(NULL), context(NULL) {}
+
+  // The first sample of the top row. The channels of a pixel are
+  // interleaved, and the pixels of a row follow each other.
+  void *data;
+  int height, width, depth;
+  // Bytes from the start of a row to the start of the next one; 0 for rows
+  // without padding.
+  int row_stride;
+  Format format;
+  // Called with context once the library is done with data, from whichever
+  // thread drops the last image using it. NULL if data outlives the
+  // sequence.
+  void (*release)(void *context);
+  void *context;
+};
+
+// Where an ExternalImageSequence gets its frames from. Called from any thread
+// asking the sequence for a frame, so it must be thread safe if the sequence
+// is used by several threads.
+class ExternalFrameSource {
+ public:
+  virtual ~ExternalFrameSource() {}
+
+  virtual int Length() = 0;
+
+  // Describes the buffer holding frame i. Returns false if there is none.
+  // A frame may be asked for again after its buffer was released.
+  virtual bool GetFrame(int i, ExternalFrame *frame) = 0;
+
+  // See ImageSequence::FrameKey().
+  virtual std::string FrameKey(int i) {
+    (void) i;
+    return "";
+  }
+};
+
+// An image sequence over frames held by the caller. Frames without row
+// padding are wrapped without copying them (see ArrayND::WrapData()), and
+// their buffers are released once the frames are evicted from the cache and
+// no longer used; frames with padded rows are copied, and their buffers
+// released at once. Byte frames are returned as BYTE images, so
+// GetFloatImage() converts them once as other cached sequences do.
+//
+// The frames are cached like any other, so the filtered and pyramid
+// sequences built on this sequence work unchanged. The library does not
+// write to the wrapped buffers through the images of the sequence, which
+// must only be read.
+class ExternalImageSequence : public CachedImageSequence {
+ public:
+  // The source is not owned.
+  ExternalImageSequence(ExternalFrameSource *source, ImageCache *cache)
+      : CachedImageSequence(cache), source_(source) {}
+  virtual ~ExternalImageSequence() {}
+
+  virtual Image *LoadImage(int i);
+  virtual int Length() {
+    return source_->Length();
+  }
+  virtual std::string FrameKey(int i) {
+    return source_->FrameKey(i);
+  }
+
+ private:
+  ExternalFrameSource *source_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_IMAGE_EXTERNAL_IMAGE_SEQUENCE_H_
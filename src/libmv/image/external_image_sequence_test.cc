@@ -0,0 +1,132 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <vector>
+
+#include "libmv/image/external_image_sequence.h"
+#include "libmv/image/filtered_sequence.h"
+#include "libmv/image/image.h"
+#include "testing/testing.h"
+
+using namespace libmv;
+
+namespace {
+
+void CountRelease(void *context) {
+  ++*static_cast<int *>(context);
+}
+
+// Frames of 4 x 3 pixels, stored with rows of row_stride bytes.
+class HostFrames : public ExternalFrameSource {
+ public:
+  HostFrames(int length, int row_stride, ExternalFrame::Format format)
+      : row_stride_(row_stride), format_(format), released(length, 0) {
+    buffers.resize(length, std::vector<float>(4 * 8));
+    for (int i = 0; i < length; ++i) {
+      for (int j = 0; j < 4 * 8; ++j) {
+        buffers[i][j] = i + j;
+      }
+    }
+  }
+
+  virtual int Length() {
+    return buffers.size();
+  }
+
+  virtual bool GetFrame(int i, ExternalFrame *frame) {
+    frame->data = &buffers[i][0];
+    frame->height = 4;
+    frame->width = 3;
+    frame->row_stride = row_stride_;
+    frame->format = format_;
+    frame->release = &CountRelease;
+    frame->context = &released[i];
+    return true;
+  }
+
+  int row_stride_;
+  ExternalFrame::Format format_;
+  std::vector<std::vector<float> > buffers;
+  std::vector<int> released;
+};
+
+TEST(ExternalImageSequence, PackedFramesAreWrapped) {
+  HostFrames host(3, 0, ExternalFrame::FLOAT);
+  // Room for one frame.
+  ImageCache cache(Image(new Array3Df(4, 3)).MemorySizeInBytes());
+  ExternalImageSequence sequence(&host, &cache);
+
+  FloatImage *frame = sequence.GetFloatImage(0);
+  ASSERT_TRUE(frame);
+  EXPECT_EQ(&host.buffers[0][0], frame->Data());
+  EXPECT_EQ(4, frame->Height());
+  EXPECT_EQ(3, frame->Width());
+  EXPECT_EQ(5, (*frame)(1, 2));
+  sequence.Unpin(0);
+  EXPECT_EQ(0, host.released[0]);
+
+  // Evicting frame 0 releases its buffer.
+  sequence.GetFloatImage(1);
+  sequence.Unpin(1);
+  EXPECT_EQ(1, host.released[0]);
+  EXPECT_EQ(0, host.released[1]);
+}
+
+TEST(ExternalImageSequence, PaddedRowsAreCopied) {
+  // Byte rows of 3 pixels padded to 8 bytes.
+  HostFrames host(1, 8, ExternalFrame::BYTE);
+  unsigned char *bytes =
+      reinterpret_cast<unsigned char *>(&host.buffers[0][0]);
+  for (int i = 0; i < 4 * 8; ++i) {
+    bytes[i] = i;
+  }
+  ImageCache cache;
+  ExternalImageSequence sequence(&host, &cache);
+  Image *frame = sequence.GetImage(0);
+  ASSERT_TRUE(frame && frame->AsArray3Du());
+  const Array3Du &array = *frame->AsArray3Du();
+  EXPECT_NE(bytes, array.Data());
+  EXPECT_EQ(2 * 8 + 1, array(2, 1));
+  EXPECT_EQ(1, host.released[0]);
+  sequence.Unpin(0);
+}
+
+class NegateFilter : public Filter {
+ public:
+  virtual void RunFilter(const Array3Df &source, Array3Df *destination) {
+    destination->ResizeLike(source);
+    for (int i = 0; i < source.Size(); ++i) {
+      destination->Data()[i] = -source.Data()[i];
+    }
+  }
+};
+
+TEST(ExternalImageSequence, Filters) {
+  HostFrames host(2, 0, ExternalFrame::FLOAT);
+  ImageCache cache;
+  ExternalImageSequence sequence(&host, &cache);
+  FilteredImageSequence filtered(&sequence, new NegateFilter);
+  FloatImage *frame = filtered.GetFloatImage(1);
+  ASSERT_TRUE(frame);
+  EXPECT_EQ(-(1 + 3 * 2 + 1), (*frame)(2, 1));
+  filtered.Unpin(1);
+}
+
+}  // namespace
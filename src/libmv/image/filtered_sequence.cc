@@ -18,12 +18,17 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include "libmv/image/disk_image_cache.h"
 #include "libmv/image/filtered_sequence.h"
 
 namespace libmv {
 
 Filter::~Filter() {}
 
+std::string Filter::Parameters() const {
+  return "";
+}
+
 FilteredImageSequence::FilteredImageSequence(ImageSequence *source,
                                              Filter *filter)
       : CachedImageSequence(source->Cache()),
@@ -34,13 +39,44 @@ FilteredImageSequence::~FilteredImageSequence() {
   delete filter_;
 }
 
+std::string FilteredImageSequence::FrameKey(int i) {
+  std::string parameters = filter_->Parameters();
+  if (parameters.empty()) {
+    return "";
+  }
+  std::string source_key = source_->FrameKey(i);
+  if (source_key.empty()) {
+    return "";
+  }
+  return source_key + "|" + parameters;
+}
+
 Image *FilteredImageSequence::LoadImage(int i) {
+  DiskImageCache *disk_cache = Cache() ? Cache()->DiskCache() : NULL;
+  std::string key = disk_cache ? FrameKey(i) : "";
+  if (!key.empty()) {
+    Image *stored;
+    if (disk_cache->FetchAndPin(key, &stored)) {
+      // The copy shares the array, which outlives the pin.
+      Image *image = stored->AsArray3Df() ? new Image(*stored) : NULL;
+      disk_cache->Unpin(key);
+      if (image) {
+        return image;
+      }
+    }
+  }
+
   Array3Df *destination_image = new Array3Df;
   // TODO(keir): Make this not specfic to float images...
   Array3Df *source_image = source_->GetFloatImage(i);
   filter_->RunFilter(*source_image, destination_image);
   source_->Unpin(i);
-  return new Image(destination_image);
+  Image *image = new Image(destination_image);
+  if (!key.empty()) {
+    disk_cache->StoreAndPinSized(key, new Image(*image), 0);
+    disk_cache->Unpin(key);
+  }
+  return image;
 }
 
 }  // namespace libmv
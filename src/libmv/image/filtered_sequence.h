@@ -21,6 +21,8 @@
 #ifndef LIBMV_IMAGE_FILTERED_SEQUENCE_H_
 #define LIBMV_IMAGE_FILTERED_SEQUENCE_H_
 
+#include <string>
+
 #include "libmv/image/cached_image_sequence.h"
 
 namespace libmv {
@@ -29,8 +31,16 @@ class Filter {
  public:
   virtual ~Filter();
   virtual void RunFilter(const Array3Df &source, Array3Df *destination) = 0;
+
+  // The name and parameters of the filter, which tell its output apart from
+  // that of any other filter; see FilteredImageSequence::FrameKey(). Empty,
+  // the default, if the output cannot be stored across runs.
+  virtual std::string Parameters() const;
 };
 
+// The frames of source, filtered. If the cache has a disk cache (see
+// ImageCache::SetDiskCache()), the filtered frames are read from it when they
+// were stored by an earlier run, and stored otherwise.
 class FilteredImageSequence : public CachedImageSequence {
  public:
   FilteredImageSequence(ImageSequence *source, Filter *filter);
@@ -39,6 +49,9 @@ class FilteredImageSequence : public CachedImageSequence {
   virtual int Length() {
     return source_->Length();
   }
+  // The key of the source frame followed by the filter parameters, or empty
+  // if either is.
+  virtual std::string FrameKey(int i);
 
  private:
   ImageSequence *source_;
@@ -0,0 +1,99 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cmath>
+
+#include "libmv/image/convolve.h"
+#include "libmv/image/fixed_point_pyramid.h"
+
+namespace libmv {
+
+namespace {
+
+inline int RoundAndClamp(float value, int min_value, int max_value) {
+  int rounded = int(floor(value + 0.5f));
+  return std::min(max_value, std::max(min_value, rounded));
+}
+
+}  // namespace
+
+void QuantizeBlurredImageAndDerivatives(const FloatImage &blurred_and_gradxy,
+                                        float intensity_scale,
+                                        FixedPointLevel *level) {
+  assert(blurred_and_gradxy.Depth() == 3);
+  int height = blurred_and_gradxy.Height();
+  int width = blurred_and_gradxy.Width();
+  level->image.Resize(height, width);
+  level->gradient_x.Resize(height, width);
+  level->gradient_y.Resize(height, width);
+  float gradient_scale = intensity_scale * kFixedPointGradientScale;
+  for (int r = 0; r < height; ++r) {
+    const float *in = blurred_and_gradxy.Data() +
+                      blurred_and_gradxy.Offset(r, 0, 0);
+    unsigned char *image = level->image.Data() + level->image.Offset(r, 0, 0);
+    short *gx = level->gradient_x.Data() + level->gradient_x.Offset(r, 0, 0);
+    short *gy = level->gradient_y.Data() + level->gradient_y.Offset(r, 0, 0);
+    for (int c = 0; c < width; ++c, in += 3) {
+      image[c] = RoundAndClamp(in[0] * intensity_scale, 0, 255);
+      gx[c] = RoundAndClamp(in[1] * gradient_scale, -32768, 32767);
+      gy[c] = RoundAndClamp(in[2] * gradient_scale, -32768, 32767);
+    }
+  }
+}
+
+void FixedPointPyramid::Init(const FloatImage &image,
+                             int num_levels,
+                             double sigma,
+                             float intensity_scale) {
+  assert(image.Depth() == 1);
+  intensity_scale_ = intensity_scale;
+  levels_.resize(num_levels);
+
+  // Only one float level is alive at a time.
+  FloatImage blurred_and_gradxy;
+  BlurredImageAndDerivativesChannels(image, sigma, &blurred_and_gradxy);
+  QuantizeBlurredImageAndDerivatives(blurred_and_gradxy, intensity_scale,
+                                     &levels_[0]);
+
+  FloatImage downsamples[2];
+  const FloatImage *previous = &image;
+  for (int i = 1; i < NumLevels(); ++i) {
+    FloatImage *current = &downsamples[i % 2];
+    DownsampleBy2AndBlurredImageAndDerivativesChannels(*previous, sigma,
+                                                       current,
+                                                       &blurred_and_gradxy);
+    QuantizeBlurredImageAndDerivatives(blurred_and_gradxy, intensity_scale,
+                                       &levels_[i]);
+    previous = current;
+  }
+  memory_.Set(MemorySizeInBytes());
+  ReclaimMemoryOverBudget();
+}
+
+int FixedPointPyramid::MemorySizeInBytes() const {
+  int sum = 0;
+  for (int i = 0; i < NumLevels(); ++i) {
+    sum += levels_[i].MemorySizeInBytes();
+  }
+  return sum;
+}
+
+}  // namespace libmv
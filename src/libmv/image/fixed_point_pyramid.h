@@ -0,0 +1,101 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_IMAGE_FIXED_POINT_PYRAMID_H
+#define LIBMV_IMAGE_FIXED_POINT_PYRAMID_H
+
+#include "libmv/base/memory_budget.h"
+#include "libmv/base/vector.h"
+#include "libmv/image/image.h"
+
+namespace libmv {
+
+// Gradients are stored in units of 1/kFixedPointGradientScale intensity levels
+// per pixel, which leaves room for the steepest edges of a byte image.
+const int kFixedPointGradientScale = 32;
+
+// A level of a FixedPointPyramid: the blurred image and its gradients, as in
+// the levels of an ImagePyramid, but in 5 bytes per pixel instead of 12. The
+// three planes are stored separately so that the pixels of each are
+// contiguous.
+struct FixedPointLevel {
+  ByteImage image;        // Blurred intensity, times the intensity scale.
+  ShortImage gradient_x;  // Gradients, times the intensity scale and
+  ShortImage gradient_y;  // kFixedPointGradientScale.
+
+  int Height() const { return image.Height(); }
+  int Width() const { return image.Width(); }
+
+  int MemorySizeInBytes() const {
+    return image.MemorySizeInBytes() +
+           gradient_x.MemorySizeInBytes() +
+           gradient_y.MemorySizeInBytes();
+  }
+};
+
+// Round and clamp the channels of blurred_and_gradxy, as computed by
+// BlurredImageAndDerivativesChannels(), into level. Intensities are multiplied
+// by intensity_scale, e.g. 255 for float images in [0, 1].
+void QuantizeBlurredImageAndDerivatives(const FloatImage &blurred_and_gradxy,
+                                        float intensity_scale,
+                                        FixedPointLevel *level);
+
+// A pyramid of blurred images and gradients in fixed point, for tracking with
+// the integer kernels of KLTContext. The levels are built like the ones of
+// MakeImagePyramid(), in float, and quantized as they are produced.
+class FixedPointPyramid {
+ public:
+  FixedPointPyramid()
+      : intensity_scale_(255), memory_(MEMORY_PYRAMIDS) {}
+  FixedPointPyramid(const FloatImage &image,
+                    int num_levels,
+                    double sigma = 0.9,
+                    float intensity_scale = 255)
+      : memory_(MEMORY_PYRAMIDS) {
+    Init(image, num_levels, sigma, intensity_scale);
+  }
+
+  void Init(const FloatImage &image,
+            int num_levels,
+            double sigma = 0.9,
+            float intensity_scale = 255);
+
+  const FixedPointLevel &Level(int i) const {
+    assert(0 <= i && i < NumLevels());
+    return levels_[i];
+  }
+
+  int NumLevels() const { return levels_.size(); }
+
+  // The factor that maps the intensities of the source image to the bytes of
+  // the levels.
+  float IntensityScale() const { return intensity_scale_; }
+
+  int MemorySizeInBytes() const;
+
+ private:
+  vector<FixedPointLevel> levels_;
+  float intensity_scale_;
+  MemoryUsage memory_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_IMAGE_FIXED_POINT_PYRAMID_H
@@ -0,0 +1,87 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/image/convolve.h"
+#include "libmv/image/fixed_point_pyramid.h"
+#include "libmv/image/image_pyramid.h"
+#include "libmv/base/scoped_ptr.h"
+#include "testing/testing.h"
+
+using namespace libmv;
+
+namespace {
+
+void MakeTestImage(FloatImage *image) {
+  image->Resize(32, 48);
+  for (int i = 0; i < image->Height(); ++i) {
+    for (int j = 0; j < image->Width(); ++j) {
+      (*image)(i, j) = 0.5 + 0.4 * sin(0.3 * i + 0.2 * j) * cos(0.25 * j);
+    }
+  }
+}
+
+TEST(FixedPointPyramid, LevelsMatchTheFloatPyramid) {
+  FloatImage image;
+  MakeTestImage(&image);
+  FixedPointPyramid pyramid(image, 3, 0.9);
+  scoped_ptr<ImagePyramid> float_pyramid(MakeImagePyramid(image, 3, 0.9));
+  EXPECT_EQ(3, pyramid.NumLevels());
+  EXPECT_EQ(255, pyramid.IntensityScale());
+
+  for (int l = 0; l < 3; ++l) {
+    const FixedPointLevel &level = pyramid.Level(l);
+    const FloatImage &expected = float_pyramid->Level(l);
+    EXPECT_EQ(expected.Height(), level.Height());
+    EXPECT_EQ(expected.Width(), level.Width());
+    float gradient_scale = 255 * kFixedPointGradientScale;
+    for (int i = 0; i < level.Height(); ++i) {
+      for (int j = 0; j < level.Width(); ++j) {
+        EXPECT_NEAR(expected(i, j, 0), level.image(i, j) / 255., 0.51 / 255);
+        EXPECT_NEAR(expected(i, j, 1), level.gradient_x(i, j) / gradient_scale,
+                    0.51 / gradient_scale);
+        EXPECT_NEAR(expected(i, j, 2), level.gradient_y(i, j) / gradient_scale,
+                    0.51 / gradient_scale);
+      }
+    }
+  }
+  // 5 bytes per pixel instead of 12.
+  EXPECT_LT(pyramid.MemorySizeInBytes() * 2,
+            float_pyramid->MemorySizeInBytes());
+}
+
+TEST(FixedPointPyramid, QuantizationClamps) {
+  FloatImage blurred_and_gradxy(1, 2, 3);
+  blurred_and_gradxy(0, 0, 0) = 2;
+  blurred_and_gradxy(0, 0, 1) = 100;
+  blurred_and_gradxy(0, 0, 2) = -100;
+  blurred_and_gradxy(0, 1, 0) = -1;
+  blurred_and_gradxy(0, 1, 1) = 0.5;
+  blurred_and_gradxy(0, 1, 2) = -0.25;
+  FixedPointLevel level;
+  QuantizeBlurredImageAndDerivatives(blurred_and_gradxy, 255, &level);
+  EXPECT_EQ(255, level.image(0, 0));
+  EXPECT_EQ(32767, level.gradient_x(0, 0));
+  EXPECT_EQ(-32768, level.gradient_y(0, 0));
+  EXPECT_EQ(0, level.image(0, 1));
+  EXPECT_EQ(4080, level.gradient_x(0, 1));
+  EXPECT_EQ(-2040, level.gradient_y(0, 1));
+}
+
+}  // namespace
@@ -0,0 +1,277 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstring>
+
+#include "libmv/base/cpu_features.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__F16C__) || defined(LIBMV_HAVE_TARGET_X86)
+#include <immintrin.h>
+#endif
+
+#include "libmv/image/half.h"
+
+namespace libmv {
+
+namespace {
+
+inline unsigned int FloatBits(float value) {
+  unsigned int bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+inline float BitsToFloat(unsigned int bits) {
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// The conversions below follow Fabian Giesen's branch light float <-> half
+// routines, which map directly to SSE2.
+
+// Smallest float that overflows a half, and the float that turns the
+// exponent of a denormal half into the right place.
+const unsigned int kHalfOverflow = (127 + 16) << 23;
+const unsigned int kDenormalMagic = ((127 - 15) + (23 - 10) + 1) << 23;
+// Floats below 2^-14 are denormal or zero as halves.
+const unsigned int kHalfNormalMin = (127 - 14) << 23;
+const unsigned int kFloatInfinity = 255 << 23;
+
+#ifdef __SSE2__
+inline __m128i Select(__m128i mask, __m128i a, __m128i b) {
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// Four floats to four halves, in the low 16 bits of 32 bit lanes.
+inline __m128i FloatToHalf4(__m128 values) {
+  __m128i f = _mm_castps_si128(values);
+  __m128i sign = _mm_and_si128(f, _mm_set1_epi32(0x80000000));
+  f = _mm_xor_si128(f, sign);
+
+  // Infinities and NaNs. The comparisons are signed, but f has no sign bit.
+  __m128i overflow = _mm_cmpgt_epi32(_mm_set1_epi32(kHalfOverflow),
+                                     f);  // Inverted: not overflowing.
+  __m128i nan = _mm_cmpgt_epi32(f, _mm_set1_epi32(kFloatInfinity));
+  __m128i special = Select(nan, _mm_set1_epi32(0x7e00),
+                           _mm_set1_epi32(0x7c00));
+
+  // Denormals and zeros, by letting the float adder do the rounding.
+  __m128i denormal_mask = _mm_cmpgt_epi32(_mm_set1_epi32(kHalfNormalMin), f);
+  __m128 magic = _mm_castsi128_ps(_mm_set1_epi32(kDenormalMagic));
+  __m128i denormal = _mm_sub_epi32(
+      _mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(f), magic)),
+      _mm_set1_epi32(kDenormalMagic));
+
+  // Normals: rebias the exponent and round the mantissa to nearest even.
+  __m128i mantissa_odd = _mm_and_si128(_mm_srli_epi32(f, 13),
+                                       _mm_set1_epi32(1));
+  __m128i normal = _mm_add_epi32(
+      f, _mm_set1_epi32(((15 - 127) << 23) + 0xfff));
+  normal = _mm_srli_epi32(_mm_add_epi32(normal, mantissa_odd), 13);
+
+  __m128i finite = Select(denormal_mask, denormal, normal);
+  __m128i half = Select(overflow, finite, special);
+  return _mm_or_si128(half, _mm_srli_epi32(sign, 16));
+}
+
+// Four halves, in the low 16 bits of 32 bit lanes, to four floats.
+inline __m128 HalfToFloat4(__m128i halves) {
+  const __m128i shifted_exponent = _mm_set1_epi32(0x7c00 << 13);
+  __m128i o = _mm_slli_epi32(_mm_and_si128(halves, _mm_set1_epi32(0x7fff)),
+                             13);
+  __m128i exponent = _mm_and_si128(o, shifted_exponent);
+  o = _mm_add_epi32(o, _mm_set1_epi32((127 - 15) << 23));
+
+  // Infinities and NaNs get the maximum exponent.
+  __m128i special = _mm_cmpeq_epi32(exponent, shifted_exponent);
+  o = _mm_add_epi32(o, _mm_and_si128(special,
+                                     _mm_set1_epi32((128 - 16) << 23)));
+
+  // Denormals and zeros are renormalized by the float subtraction.
+  __m128i denormal_mask = _mm_cmpeq_epi32(exponent, _mm_setzero_si128());
+  __m128 magic = _mm_castsi128_ps(_mm_set1_epi32(113 << 23));
+  __m128i denormal = _mm_castps_si128(_mm_sub_ps(
+      _mm_castsi128_ps(_mm_add_epi32(o, _mm_set1_epi32(1 << 23))), magic));
+  o = Select(denormal_mask, denormal, o);
+
+  __m128i sign = _mm_slli_epi32(_mm_and_si128(halves, _mm_set1_epi32(0x8000)),
+                                16);
+  return _mm_castsi128_ps(_mm_or_si128(o, sign));
+}
+#endif
+
+}  // namespace
+
+unsigned short FloatToHalf(float value) {
+  unsigned int f = FloatBits(value);
+  unsigned int sign = f & 0x80000000u;
+  f ^= sign;
+  unsigned int half;
+  if (f >= kHalfOverflow) {
+    half = f > kFloatInfinity ? 0x7e00 : 0x7c00;
+  } else if (f < kHalfNormalMin) {
+    half = FloatBits(BitsToFloat(f) + BitsToFloat(kDenormalMagic)) -
+           kDenormalMagic;
+  } else {
+    unsigned int mantissa_odd = (f >> 13) & 1;
+    f += ((15 - 127) << 23) + 0xfff;
+    f += mantissa_odd;
+    half = f >> 13;
+  }
+  return static_cast<unsigned short>(half | (sign >> 16));
+}
+
+float HalfToFloat(unsigned short half) {
+  const unsigned int shifted_exponent = 0x7c00 << 13;
+  unsigned int o = (half & 0x7fff) << 13;
+  unsigned int exponent = shifted_exponent & o;
+  o += (127 - 15) << 23;
+  if (exponent == shifted_exponent) {
+    o += (128 - 16) << 23;
+  } else if (exponent == 0) {
+    o += 1 << 23;
+    o = FloatBits(BitsToFloat(o) - BitsToFloat(113 << 23));
+  }
+  o |= (half & 0x8000) << 16;
+  return BitsToFloat(o);
+}
+
+namespace {
+
+typedef void (*FloatToHalfFunction)(const float *in, int size,
+                                    unsigned short *out);
+typedef void (*HalfToFloatFunction)(const unsigned short *in, int size,
+                                    float *out);
+
+void FloatsToHalvesScalar(const float *in, int size, unsigned short *out) {
+  for (int i = 0; i < size; ++i) {
+    out[i] = FloatToHalf(in[i]);
+  }
+}
+
+void HalvesToFloatsScalar(const unsigned short *in, int size, float *out) {
+  for (int i = 0; i < size; ++i) {
+    out[i] = HalfToFloat(in[i]);
+  }
+}
+
+#ifdef __SSE2__
+void FloatsToHalvesSSE2(const float *in, int size, unsigned short *out) {
+  int i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m128i low = FloatToHalf4(_mm_loadu_ps(in + i));
+    __m128i high = FloatToHalf4(_mm_loadu_ps(in + i + 4));
+    // Sign extend the 16 bit values so that the saturating pack keeps them.
+    low = _mm_srai_epi32(_mm_slli_epi32(low, 16), 16);
+    high = _mm_srai_epi32(_mm_slli_epi32(high, 16), 16);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+                     _mm_packs_epi32(low, high));
+  }
+  FloatsToHalvesScalar(in + i, size - i, out + i);
+}
+
+void HalvesToFloatsSSE2(const unsigned short *in, int size, float *out) {
+  const __m128i zero = _mm_setzero_si128();
+  int i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m128i halves = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    _mm_storeu_ps(out + i, HalfToFloat4(_mm_unpacklo_epi16(halves, zero)));
+    _mm_storeu_ps(out + i + 4, HalfToFloat4(_mm_unpackhi_epi16(halves, zero)));
+  }
+  HalvesToFloatsScalar(in + i, size - i, out + i);
+}
+#endif
+
+// F16C comes with every AVX2 processor. It keeps the payload of NaNs, which
+// stay NaNs.
+#if defined(LIBMV_HAVE_TARGET_X86)
+#define LIBMV_HALF_F16C LIBMV_TARGET_AVX2
+#elif defined(__F16C__)
+#define LIBMV_HALF_F16C
+#endif
+
+#ifdef LIBMV_HALF_F16C
+LIBMV_HALF_F16C
+void FloatsToHalvesF16C(const float *in, int size, unsigned short *out) {
+  int i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m128i halves = _mm256_cvtps_ph(_mm256_loadu_ps(in + i),
+                                     _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), halves);
+  }
+  FloatsToHalvesScalar(in + i, size - i, out + i);
+}
+
+LIBMV_HALF_F16C
+void HalvesToFloatsF16C(const unsigned short *in, int size, float *out) {
+  int i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m128i halves = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    _mm256_storeu_ps(out + i, _mm256_cvtph_ps(halves));
+  }
+  HalvesToFloatsScalar(in + i, size - i, out + i);
+}
+#endif
+
+const SimdDispatch<FloatToHalfFunction> &FloatsToHalves() {
+  static const SimdDispatch<FloatToHalfFunction> dispatch =
+      SimdDispatch<FloatToHalfFunction>(FloatsToHalvesScalar)
+#ifdef __SSE2__
+          .Add(SIMD_SSE2, FloatsToHalvesSSE2)
+#endif
+#ifdef LIBMV_HALF_F16C
+          .Add(SIMD_AVX2, FloatsToHalvesF16C)
+#endif
+      ;
+  return dispatch;
+}
+
+const SimdDispatch<HalfToFloatFunction> &HalvesToFloats() {
+  static const SimdDispatch<HalfToFloatFunction> dispatch =
+      SimdDispatch<HalfToFloatFunction>(HalvesToFloatsScalar)
+#ifdef __SSE2__
+          .Add(SIMD_SSE2, HalvesToFloatsSSE2)
+#endif
+#ifdef LIBMV_HALF_F16C
+          .Add(SIMD_AVX2, HalvesToFloatsF16C)
+#endif
+      ;
+  return dispatch;
+}
+
+}  // namespace
+
+void FloatArrayToHalfArray(const Array3Df &float_array, Array3Dh *half_array) {
+  half_array->ResizeLike(float_array);
+  FloatsToHalves().Get()(float_array.Data(), float_array.Size(),
+                         half_array->Data());
+}
+
+void HalfArrayToFloatArray(const Array3Dh &half_array, Array3Df *float_array) {
+  float_array->ResizeLike(half_array);
+  HalvesToFloats().Get()(half_array.Data(), half_array.Size(),
+                         float_array->Data());
+}
+
+}  // namespace libmv
@@ -0,0 +1,49 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_IMAGE_HALF_H
+#define LIBMV_IMAGE_HALF_H
+
+#include "libmv/image/array_nd.h"
+
+namespace libmv {
+
+// IEEE 754 half precision floats (1 sign, 5 exponent and 10 mantissa bits),
+// stored as their bit patterns. They hold about 3 decimal digits, which is
+// plenty for cached frames and halves their size.
+typedef Array3D<unsigned short> Array3Dh;
+typedef Array3Dh HalfImage;
+
+// Round to the nearest half, ties to even. Values too large for a half become
+// infinities and NaNs stay NaNs.
+unsigned short FloatToHalf(float value);
+
+// Exact: every half is a float.
+float HalfToFloat(unsigned short half);
+
+// Convert whole arrays. These use F16C or SSE2 when the processor has them
+// (see libmv/base/cpu_features.h), and agree with the scalar functions above
+// bit for bit, except for the payload of NaNs.
+void FloatArrayToHalfArray(const Array3Df &float_array, Array3Dh *half_array);
+void HalfArrayToFloatArray(const Array3Dh &half_array, Array3Df *float_array);
+
+}  // namespace libmv
+
+#endif  // LIBMV_IMAGE_HALF_H
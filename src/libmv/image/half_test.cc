@@ -0,0 +1,146 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cmath>
+#include <limits>
+
+#include "libmv/base/cpu_features.h"
+#include "libmv/image/half.h"
+#include "testing/testing.h"
+
+using namespace libmv;
+
+namespace {
+
+bool IsHalfNaN(unsigned short half) {
+  return (half & 0x7c00) == 0x7c00 && (half & 0x03ff) != 0;
+}
+
+TEST(Half, RoundTripsEveryHalf) {
+  for (int i = 0; i < 65536; ++i) {
+    unsigned short half = static_cast<unsigned short>(i);
+    float value = HalfToFloat(half);
+    if (IsHalfNaN(half)) {
+      EXPECT_TRUE(value != value);
+      EXPECT_TRUE(IsHalfNaN(FloatToHalf(value)));
+    } else {
+      EXPECT_EQ(half, FloatToHalf(value));
+    }
+  }
+}
+
+TEST(Half, KnownValues) {
+  EXPECT_EQ(0x0000, FloatToHalf(0.f));
+  EXPECT_EQ(0x8000, FloatToHalf(-0.f));
+  EXPECT_EQ(0x3c00, FloatToHalf(1.f));
+  EXPECT_EQ(0xc000, FloatToHalf(-2.f));
+  EXPECT_EQ(0x3800, FloatToHalf(0.5f));
+  EXPECT_EQ(0x7bff, FloatToHalf(65504.f));
+  EXPECT_EQ(0x0001, FloatToHalf(std::ldexp(1.f, -24)));
+  EXPECT_EQ(0x0400, FloatToHalf(std::ldexp(1.f, -14)));
+  EXPECT_EQ(0x7c00, FloatToHalf(std::numeric_limits<float>::infinity()));
+  EXPECT_EQ(0xfc00, FloatToHalf(-std::numeric_limits<float>::infinity()));
+  EXPECT_EQ(1.f, HalfToFloat(0x3c00));
+  EXPECT_EQ(-2.f, HalfToFloat(0xc000));
+  EXPECT_EQ(65504.f, HalfToFloat(0x7bff));
+  EXPECT_EQ(std::ldexp(1.f, -24), HalfToFloat(0x0001));
+}
+
+TEST(Half, RoundsToNearestEven) {
+  // Halfway between 1 and the next half; 1 has the even mantissa.
+  EXPECT_EQ(0x3c00, FloatToHalf(1.f + std::ldexp(1.f, -11)));
+  // Halfway between 0x3c01 and 0x3c02.
+  EXPECT_EQ(0x3c02, FloatToHalf(1.f + 3 * std::ldexp(1.f, -11)));
+  // Just above halfway rounds up.
+  EXPECT_EQ(0x3c01, FloatToHalf(1.f + std::ldexp(1.f, -11) +
+                                std::ldexp(1.f, -20)));
+  // The same for denormals.
+  EXPECT_EQ(0x0000, FloatToHalf(std::ldexp(1.f, -25)));
+  EXPECT_EQ(0x0002, FloatToHalf(3 * std::ldexp(1.f, -25)));
+  // Rounding up past the largest half overflows.
+  EXPECT_EQ(0x7bff, FloatToHalf(65519.f));
+  EXPECT_EQ(0x7c00, FloatToHalf(65520.f));
+}
+
+void ExpectArraysMatchScalarConversions() {
+  // Odd sizes exercise the scalar tails of the vectorized loops.
+  Array3Df float_array(7, 5, 3);
+  for (int i = 0; i < float_array.Size(); ++i) {
+    float_array.Data()[i] = std::ldexp(1.f + 0.37f * i, i % 40 - 28) *
+                            (i % 3 ? 1 : -1);
+  }
+  float_array.Data()[1] = std::numeric_limits<float>::infinity();
+  float_array.Data()[2] = 1e6f;
+
+  Array3Dh half_array;
+  FloatArrayToHalfArray(float_array, &half_array);
+  EXPECT_TRUE(half_array.Shape() == float_array.Shape());
+  for (int i = 0; i < float_array.Size(); ++i) {
+    EXPECT_EQ(FloatToHalf(float_array.Data()[i]), half_array.Data()[i]) << i;
+  }
+
+  Array3Df decoded;
+  HalfArrayToFloatArray(half_array, &decoded);
+  EXPECT_TRUE(decoded.Shape() == half_array.Shape());
+  for (int i = 0; i < half_array.Size(); ++i) {
+    EXPECT_EQ(HalfToFloat(half_array.Data()[i]), decoded.Data()[i]) << i;
+  }
+}
+
+void ExpectArraysConvertEveryHalf() {
+  Array3Dh half_array(256, 256);
+  for (int i = 0; i < half_array.Size(); ++i) {
+    half_array.Data()[i] = static_cast<unsigned short>(i);
+  }
+  Array3Df float_array;
+  HalfArrayToFloatArray(half_array, &float_array);
+  Array3Dh round_tripped;
+  FloatArrayToHalfArray(float_array, &round_tripped);
+  for (int i = 0; i < half_array.Size(); ++i) {
+    if (IsHalfNaN(half_array.Data()[i])) {
+      EXPECT_TRUE(IsHalfNaN(round_tripped.Data()[i]));
+    } else {
+      EXPECT_EQ(half_array.Data()[i], round_tripped.Data()[i]);
+    }
+  }
+}
+
+// Every implementation the processor supports.
+TEST(Half, ArraysMatchScalarConversions) {
+  SimdLevel max_level = MaxSimdLevel();
+  for (int i = 0; i < NUM_SIMD_LEVELS; ++i) {
+    SCOPED_TRACE(SimdLevelName(static_cast<SimdLevel>(i)));
+    SetMaxSimdLevel(static_cast<SimdLevel>(i));
+    ExpectArraysMatchScalarConversions();
+  }
+  SetMaxSimdLevel(max_level);
+}
+
+TEST(Half, ArraysConvertEveryHalf) {
+  SimdLevel max_level = MaxSimdLevel();
+  for (int i = 0; i < NUM_SIMD_LEVELS; ++i) {
+    SCOPED_TRACE(SimdLevelName(static_cast<SimdLevel>(i)));
+    SetMaxSimdLevel(static_cast<SimdLevel>(i));
+    ExpectArraysConvertEveryHalf();
+  }
+  SetMaxSimdLevel(max_level);
+}
+
+}  // namespace
@@ -20,10 +20,113 @@
 
 #include <iostream>
 
+#include "libmv/base/thread.h"
 #include "libmv/image/image.h"
 
 namespace libmv {
 
-// TODO(keir): put something useful here!
+namespace {
+
+// Guards the reference counts of all images. Images are copied far less often
+// than their pixels are processed, so a single lock is enough.
+Mutex *ReferenceCountMutex() {
+  static Mutex *mutex = new Mutex;
+  return mutex;
+}
+
+template<typename T>
+int TypedMemorySizeInBytes(const BaseArray *array) {
+  return reinterpret_cast<const Array3D<T> *>(array)->MemorySizeInBytes();
+}
+
+template<typename T>
+BaseArray *TypedCopy(const BaseArray *array) {
+  return new Array3D<T>(*reinterpret_cast<const Array3D<T> *>(array));
+}
+
+template<typename T>
+void TypedDelete(BaseArray *array) {
+  delete reinterpret_cast<Array3D<T> *>(array);
+}
+
+}  // namespace
+
+int Image::MemorySizeInBytes() const {
+  int size;
+  switch (Type()) {
+    case BYTE:  size = TypedMemorySizeInBytes<unsigned char>(storage_->array);
+      break;
+    case FLOAT: size = TypedMemorySizeInBytes<float>(storage_->array); break;
+    case INT:   size = TypedMemorySizeInBytes<int>(storage_->array);   break;
+    case SHORT: size = TypedMemorySizeInBytes<short>(storage_->array); break;
+    case HALF:
+      size = TypedMemorySizeInBytes<unsigned short>(storage_->array);
+      break;
+    default:
+      size = 0;
+      assert(0);
+  }
+  size += sizeof(*this);
+  return size;
+}
+
+int Image::UseCount() const {
+  if (!storage_) {
+    return 0;
+  }
+  MutexLock lock(ReferenceCountMutex());
+  return storage_->ref_count;
+}
+
+void Image::MakeUnique() {
+  if (!IsShared()) {
+    return;
+  }
+  BaseArray *copy;
+  switch (Type()) {
+    case BYTE:  copy = TypedCopy<unsigned char>(storage_->array); break;
+    case FLOAT: copy = TypedCopy<float>(storage_->array);         break;
+    case INT:   copy = TypedCopy<int>(storage_->array);           break;
+    case SHORT: copy = TypedCopy<short>(storage_->array);         break;
+    case HALF:  copy = TypedCopy<unsigned short>(storage_->array); break;
+    default:
+      copy = NULL;
+      assert(0);
+  }
+  Storage *unique = new Storage(Type(), copy);
+  Release();
+  storage_ = unique;
+}
+
+void Image::Acquire() {
+  if (storage_) {
+    MutexLock lock(ReferenceCountMutex());
+    ++storage_->ref_count;
+  }
+}
+
+void Image::Release() {
+  if (!storage_) {
+    return;
+  }
+  {
+    MutexLock lock(ReferenceCountMutex());
+    if (--storage_->ref_count > 0) {
+      storage_ = NULL;
+      return;
+    }
+  }
+  switch (storage_->type) {
+    case BYTE:  TypedDelete<unsigned char>(storage_->array); break;
+    case FLOAT: TypedDelete<float>(storage_->array);         break;
+    case INT:   TypedDelete<int>(storage_->array);           break;
+    case SHORT: TypedDelete<short>(storage_->array);         break;
+    case HALF:  TypedDelete<unsigned short>(storage_->array); break;
+    default:
+      assert(0);
+  }
+  delete storage_;
+  storage_ = NULL;
+}
 
 }  // namespace libmv
@@ -0,0 +1,91 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstdlib>
+
+#include "libmv/image/convolve.h"
+#include "libmv/image/image.h"
+#include "libmv/image/image_pyramid.h"
+#include "testing/benchmark.h"
+
+namespace {
+
+using namespace libmv;
+using libmv::benchmark::DoNotOptimize;
+
+// A VGA image of uniform noise, the same in every run.
+void MakeNoiseImage(FloatImage *image) {
+  srand(1);
+  image->Resize(480, 640);
+  for (int y = 0; y < image->Height(); ++y) {
+    for (int x = 0; x < image->Width(); ++x) {
+      (*image)(y, x) = rand() / static_cast<float>(RAND_MAX);
+    }
+  }
+}
+
+const double kPixels = 640.0 * 480.0;
+
+BENCHMARK(BM_ConvolveGaussian) {
+  FloatImage image, blurred;
+  MakeNoiseImage(&image);
+  state->ResetTiming();
+  for (int i = 0; i < state->iterations(); ++i) {
+    ConvolveGaussian(image, 0.9, &blurred);
+  }
+  state->SetItemsProcessed(state->iterations() * kPixels);
+  DoNotOptimize(blurred(240, 320));
+}
+
+BENCHMARK(BM_BlurredImageAndDerivativesChannels) {
+  FloatImage image, blurred_and_gradxy;
+  MakeNoiseImage(&image);
+  state->ResetTiming();
+  for (int i = 0; i < state->iterations(); ++i) {
+    BlurredImageAndDerivativesChannels(image, 0.9, &blurred_and_gradxy);
+  }
+  state->SetItemsProcessed(state->iterations() * kPixels);
+  DoNotOptimize(blurred_and_gradxy(240, 320, 1));
+}
+
+BENCHMARK(BM_BlurAndDownsampleBy2) {
+  FloatImage image, downsampled;
+  MakeNoiseImage(&image);
+  state->ResetTiming();
+  for (int i = 0; i < state->iterations(); ++i) {
+    BlurAndDownsampleBy2(image, 0.9, &downsampled);
+  }
+  state->SetItemsProcessed(state->iterations() * kPixels);
+  DoNotOptimize(downsampled(120, 160));
+}
+
+BENCHMARK(BM_MakeImagePyramid) {
+  FloatImage image;
+  MakeNoiseImage(&image);
+  state->ResetTiming();
+  for (int i = 0; i < state->iterations(); ++i) {
+    ImagePyramid *pyramid = MakeImagePyramid(image, 4, 0.9);
+    DoNotOptimize(pyramid->Level(3)(30, 40, 0));
+    delete pyramid;
+  }
+  state->SetItemsProcessed(state->iterations() * kPixels);
+}
+
+}  // namespace
@@ -0,0 +1,72 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cmath>
+
+#include "libmv/image/image_converter.h"
+
+namespace libmv {
+
+namespace {
+
+// The weights of RGB2GRAY() times 2^16; they sum to 2^16 so that a gray
+// pixel keeps its value.
+const int kRedWeight = 13933;
+const int kGreenWeight = 46871;
+const int kBlueWeight = 4732;
+
+}  // namespace
+
+void Rgb2Gray(const Array3Du &imaIn, Array3Du *imaOut) {
+  assert(imaIn.Depth() == 3);
+  imaOut->Resize(imaIn.Height(), imaIn.Width(), 1);
+  const unsigned char *in = imaIn.Data();
+  unsigned char *out = imaOut->Data();
+  int num_pixels = imaIn.Height() * imaIn.Width();
+  for (int i = 0; i < num_pixels; ++i, in += 3) {
+    out[i] = (kRedWeight * in[0] +
+              kGreenWeight * in[1] +
+              kBlueWeight * in[2]) >> 16;
+  }
+}
+
+void MakeByteToFloatTable(float gamma, float scale, float table[256]) {
+  for (int i = 0; i < 256; ++i) {
+    float value = float(i) / 255.0f;
+    if (gamma != 1.0f) {
+      value = pow(value, gamma);
+    }
+    table[i] = scale * value;
+  }
+}
+
+void ByteArrayToFloatArray(const Array3Du &byte_array,
+                           const float table[256],
+                           Array3Df *float_array) {
+  float_array->ResizeLike(byte_array);
+  const unsigned char *in = byte_array.Data();
+  float *out = float_array->Data();
+  int size = byte_array.Size();
+  for (int i = 0; i < size; ++i) {
+    out[i] = table[in[i]];
+  }
+}
+
+}  // namespace libmv
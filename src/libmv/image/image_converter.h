@@ -55,6 +55,22 @@ void Rgb2Gray(const ImageIn & imaIn, ImageOut * imaOut) {
   }
 }
 
+// Rgb2Gray() of a byte image, with the weights in 16 bit fixed point. The
+// rows are converted in one pass over the interleaved channels instead of
+// going through the accessors of the arrays.
+void Rgb2Gray(const Array3Du &imaIn, Array3Du *imaOut);
+
+// Fills table with the floats scale * (value / 255)^gamma of the 256 byte
+// values, for ByteArrayToFloatArray(). A gamma of 1 and a scale of 1 give the
+// values of ByteArrayToScaledFloatArray().
+void MakeByteToFloatTable(float gamma, float scale, float table[256]);
+
+// Converts every channel of byte_array through table, e.g. to undo the gamma
+// of an 8 bit frame while converting it.
+void ByteArrayToFloatArray(const Array3Du &byte_array,
+                           const float table[256],
+                           Array3Df *float_array);
+
 } // namespace libmv
 
 #endif  // LIBMV_IMAGE_IMAGE_CONVERTER_H
@@ -19,6 +19,8 @@
 // IN THE SOFTWARE.
 
 
+#include <cmath>
+
 #include "libmv/image/image_converter.h"
 #include "libmv/logging/logging.h"
 #include "testing/testing.h"
@@ -83,6 +85,61 @@ TEST(Image_Converter, ImaConvert_RGBFloat_2_GrayUchar) {
   // Do not test color conversion code since it is yet tested.
 }
 
+TEST(Image_Converter, ByteRgb2GrayMatchesTheFormula) {
+  Array3Du imageColor(7, 13, 3);
+  for (int i = 0; i < imageColor.Size(); ++i) {
+    imageColor.Data()[i] = (i * 37 + 11) % 256;
+  }
+  Array3Du imageGray;
+  Rgb2Gray(imageColor, &imageGray);
+
+  EXPECT_EQ(1, imageGray.Depth());
+  EXPECT_EQ(13, imageGray.Width());
+  EXPECT_EQ(7, imageGray.Height());
+  // Up to the fixed point weights.
+  for (int j = 0; j < imageColor.Height(); ++j)
+  for (int i = 0; i < imageColor.Width(); ++i)  {
+    double gray = RGB2GRAY<double>(imageColor(j, i, 0), imageColor(j, i, 1),
+                                   imageColor(j, i, 2));
+    EXPECT_NEAR(gray, imageGray(j, i), 1.0);
+  }
+}
+
+TEST(Image_Converter, ScaledFloatArrayIsExact) {
+  // Not a multiple of the vector width.
+  Array3Du bytes(3, 7, 5);
+  for (int i = 0; i < bytes.Size(); ++i) {
+    bytes.Data()[i] = (i * 53) % 256;
+  }
+  Array3Df floats;
+  ByteArrayToScaledFloatArray(bytes, &floats);
+  ASSERT_EQ(bytes.Size(), floats.Size());
+  EXPECT_EQ(5, floats.Depth());
+  for (int i = 0; i < bytes.Size(); ++i) {
+    EXPECT_EQ(float(bytes.Data()[i]) / 255.0f, floats.Data()[i]);
+  }
+}
+
+TEST(Image_Converter, ByteToFloatTable) {
+  float table[256];
+  MakeByteToFloatTable(1.0f, 1.0f, table);
+  Array3Du bytes(4, 4);
+  for (int i = 0; i < bytes.Size(); ++i) {
+    bytes.Data()[i] = i * 17;
+  }
+  Array3Df floats, scaled;
+  ByteArrayToFloatArray(bytes, table, &floats);
+  ByteArrayToScaledFloatArray(bytes, &scaled);
+  for (int i = 0; i < bytes.Size(); ++i) {
+    EXPECT_EQ(scaled.Data()[i], floats.Data()[i]);
+  }
+
+  MakeByteToFloatTable(2.2f, 255.0f, table);
+  EXPECT_EQ(0.0f, table[0]);
+  EXPECT_FLOAT_EQ(255.0f, table[255]);
+  EXPECT_NEAR(255.0f * pow(128 / 255.0, 2.2), table[128], 1e-3);
+}
+
 // TODO(pmoulon): Add a real image case. Read back the image and assert
 // that the depth is 1.
 // Include that it will require
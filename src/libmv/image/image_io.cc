@@ -18,6 +18,7 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <algorithm>
 #include <cstring>
 
 #include <iostream>
@@ -121,19 +122,29 @@ int WriteImage(const FloatImage &im, const char *filename){
 }
 
 int ReadJpg(const char *filename, ByteImage *im) {
+  return ReadJpg(filename, JpgReadOptions(), im);
+}
+
+int ReadJpg(const char *filename, FloatImage *image) {
+  return ReadJpg(filename, JpgReadOptions(), image);
+}
+
+int ReadJpg(const char *filename, const JpgReadOptions &options,
+            ByteImage *im) {
   FILE *file = fopen(filename, "rb");
   if (!file) {
     LOG(ERROR) << "Error: Couldn't open " << filename << " fopen returned 0";
     return 0;
   }
-  int res = ReadJpgStream(file, im);
+  int res = ReadJpgStream(file, options, im);
   fclose(file);
   return res;
 }
 
-int ReadJpg(const char *filename, FloatImage *image) {
+int ReadJpg(const char *filename, const JpgReadOptions &options,
+            FloatImage *image) {
   ByteImage byte_image;
-  int res = ReadJpg(filename, &byte_image);
+  int res = ReadJpg(filename, options, &byte_image);
   if (!res) {
     return res;
   }
@@ -155,6 +166,16 @@ jpeg_error (j_common_ptr cinfo)
 }
 
 int ReadJpgStream(FILE *file, ByteImage *im) {
+  return ReadJpgStream(file, JpgReadOptions(), im);
+}
+
+int ReadJpgStream(FILE *file, const JpgReadOptions &options, ByteImage *im) {
+  int scale = options.scale_denominator;
+  if (scale != 1 && scale != 2 && scale != 4 && scale != 8) {
+    LOG(ERROR) << "Error: Unsupported JPEG scale 1/" << scale;
+    return 0;
+  }
+
   jpeg_decompress_struct cinfo;
   struct my_error_mgr jerr;
   JSAMPARRAY buffer;
@@ -169,28 +190,51 @@ int ReadJpgStream(FILE *file, ByteImage *im) {
   jpeg_create_decompress(&cinfo);
   jpeg_stdio_src(&cinfo, file);
   jpeg_read_header(&cinfo, TRUE);
+  cinfo.scale_num = 1;
+  cinfo.scale_denom = scale;
   jpeg_start_decompress(&cinfo);
 
-  int row_stride = cinfo.output_width * cinfo.output_components;
+  int width = cinfo.output_width;
+  int height = cinfo.output_height;
+  int x0 = options.region_x;
+  int y0 = options.region_y;
+  int x1 = options.region_width ? x0 + options.region_width : width;
+  int y1 = options.region_height ? y0 + options.region_height : height;
+  if (x0 < 0 || y0 < 0 || x1 > width || y1 > height || x0 >= x1 || y0 >= y1) {
+    LOG(ERROR) << "Error: JPEG region is outside the " << width << "x"
+               << height << " image";
+    jpeg_destroy_decompress(&cinfo);
+    return 0;
+  }
+
+  int depth = cinfo.output_components;
+  int row_stride = width * depth;
 
   buffer = (*cinfo.mem->alloc_sarray)
     ((j_common_ptr) &cinfo, JPOOL_IMAGE, row_stride, 1);
 
-  im->Resize(cinfo.output_height, cinfo.output_width, cinfo.output_components);
+  im->Resize(y1 - y0, x1 - x0, depth);
 
   unsigned char *ptr = im->Data();
+  int region_row_bytes = (x1 - x0) * depth;
 
-  while (cinfo.output_scanline < cinfo.output_height) {
+  // Rows above the region still have to be decoded to reach it.
+  while (cinfo.output_scanline < static_cast<unsigned>(y1)) {
+    int y = cinfo.output_scanline;
     jpeg_read_scanlines(&cinfo, buffer, 1);
-
-    int i;
-    for (i = 0; i < row_stride; ++i) {
-      *ptr = (*buffer)[i];
-      ptr++;
+    if (y < y0) {
+      continue;
     }
+    memcpy(ptr, *buffer + x0 * depth, region_row_bytes);
+    ptr += region_row_bytes;
   }
 
-  jpeg_finish_decompress(&cinfo);
+  if (cinfo.output_scanline < cinfo.output_height) {
+    // Skip decoding the rows below the region.
+    jpeg_abort_decompress(&cinfo);
+  } else {
+    jpeg_finish_decompress(&cinfo);
+  }
   jpeg_destroy_decompress(&cinfo);
   return 1;
 }
@@ -432,12 +476,13 @@ int ReadPnm(const char *filename, FloatImage *image) {
 // Comment handling as per the description provided at
 //   http://netpbm.sourceforge.net/doc/pgm.html
 // and http://netpbm.sourceforge.net/doc/pbm.html
-int ReadPnmStream(FILE *file, ByteImage *im) {
-
+//
+// Reads the header of a binary PGM or PPM, leaving file at the first pixel.
+static int ReadPnmHeader(FILE *file, int *width, int *height, int *depth) {
   const int NUM_VALUES = 3 ;
   const int INT_BUFFER_SIZE = 256 ;
 
-  int magicnumber, depth ;
+  int magicnumber;
   char intBuffer[INT_BUFFER_SIZE];
   int values[NUM_VALUES], valuesIndex = 0, intIndex = 0, inToken = 0 ;
   int res;
@@ -449,9 +494,9 @@ int ReadPnmStream(FILE *file, ByteImage *im) {
     return 0;
   }
   if (magicnumber == 5) {
-    depth = 1;
+    *depth = 1;
   } else if (magicnumber == 6) {
-    depth = 3;
+    *depth = 3;
   } else {
     return 0;
   }
@@ -500,9 +545,20 @@ int ReadPnmStream(FILE *file, ByteImage *im) {
   // use this line if image class aloows 2-byte grey-scale
 //  if (values[2] > 255 && magicnumber == 5) depth = 2 ;
 
+  *width = values[0];
+  *height = values[1];
+  return 1;
+}
+
+int ReadPnmStream(FILE *file, ByteImage *im) {
+  int width, height, depth;
+  if (!ReadPnmHeader(file, &width, &height, &depth)) {
+    return 0;
+  }
+
   // Read pixels.
-  im->Resize(values[1],values[0], depth);
-  res = fread(im->Data(), 1, im->Size(), file);
+  im->Resize(height, width, depth);
+  int res = fread(im->Data(), 1, im->Size(), file);
   if (res != im->Size()) {
     return 0;
   }
@@ -551,4 +607,418 @@ int WritePnmStream(const ByteImage &im, FILE *file) {
   return 1;
 }
 
+int ImageRowReader::ReadRows(int num_rows, FloatImage *rows) {
+  ByteImage byte_rows;
+  int rows_read = ReadRows(num_rows, &byte_rows);
+  if (rows_read) {
+    ByteArrayToScaledFloatArray(byte_rows, rows);
+  }
+  return rows_read;
+}
+
+bool ImageRowWriter::WriteRows(const FloatImage &rows) {
+  ByteImage byte_rows;
+  FloatArrayToScaledByteArray(rows, &byte_rows);
+  return WriteRows(byte_rows);
+}
+
+namespace {
+
+// The row readers and writers own their file. Subclasses set the size of the
+// image in Init() and read or write rows in ReadRowsInto() or WriteRowsFrom().
+class BaseRowReader : public ImageRowReader {
+ public:
+  BaseRowReader(FILE *file)
+      : file_(file), height_(0), width_(0), depth_(0), next_row_(0) {}
+  virtual ~BaseRowReader() {
+    fclose(file_);
+  }
+
+  virtual bool Init() = 0;
+
+  virtual int Height() const { return height_; }
+  virtual int Width() const { return width_; }
+  virtual int Depth() const { return depth_; }
+  virtual int NextRow() const { return next_row_; }
+
+  virtual int ReadRows(int num_rows, ByteImage *rows) {
+    int rows_read = std::min(num_rows, height_ - next_row_);
+    if (rows_read <= 0) {
+      return 0;
+    }
+    rows->Resize(rows_read, width_, depth_);
+    if (!ReadRowsInto(rows_read, rows->Data())) {
+      // The rest of the file is unusable.
+      next_row_ = height_;
+      return 0;
+    }
+    next_row_ += rows_read;
+    return rows_read;
+  }
+
+ protected:
+  virtual bool ReadRowsInto(int num_rows, unsigned char *data) = 0;
+
+  FILE *file_;
+  int height_, width_, depth_;
+  int next_row_;
+};
+
+class PnmRowReader : public BaseRowReader {
+ public:
+  PnmRowReader(FILE *file) : BaseRowReader(file) {}
+
+  virtual bool Init() {
+    return ReadPnmHeader(file_, &width_, &height_, &depth_);
+  }
+
+ protected:
+  virtual bool ReadRowsInto(int num_rows, unsigned char *data) {
+    size_t size = static_cast<size_t>(num_rows) * width_ * depth_;
+    return fread(data, 1, size, file_) == size;
+  }
+};
+
+class PngRowReader : public BaseRowReader {
+ public:
+  PngRowReader(FILE *file)
+      : BaseRowReader(file), png_ptr_(NULL), info_ptr_(NULL) {}
+  virtual ~PngRowReader() {
+    if (png_ptr_) {
+      png_destroy_read_struct(&png_ptr_, info_ptr_ ? &info_ptr_ : NULL, NULL);
+    }
+  }
+
+  virtual bool Init() {
+    png_byte header[8];
+    if (fread(header, 1, 8, file_) != 8 || png_sig_cmp(header, 0, 8)) {
+      return false;
+    }
+    png_ptr_ = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (!png_ptr_) {
+      return false;
+    }
+    info_ptr_ = png_create_info_struct(png_ptr_);
+    if (!info_ptr_) {
+      return false;
+    }
+    if (setjmp(png_jmpbuf(png_ptr_))) {
+      return false;
+    }
+    png_init_io(png_ptr_, file_);
+    png_set_sig_bytes(png_ptr_, 8);
+    png_read_info(png_ptr_, info_ptr_);
+    if (info_ptr_->interlace_type != PNG_INTERLACE_NONE) {
+      LOG(ERROR) << "Error: Interlaced PNGs can not be read by rows";
+      return false;
+    }
+    png_read_update_info(png_ptr_, info_ptr_);
+    if (info_ptr_->rowbytes != info_ptr_->width * info_ptr_->channels) {
+      LOG(ERROR) << "Error: Only 8 bit PNGs can be read by rows";
+      return false;
+    }
+    height_ = info_ptr_->height;
+    width_ = info_ptr_->width;
+    depth_ = info_ptr_->channels;
+    return true;
+  }
+
+ protected:
+  virtual bool ReadRowsInto(int num_rows, unsigned char *data) {
+    if (setjmp(png_jmpbuf(png_ptr_))) {
+      return false;
+    }
+    for (int i = 0; i < num_rows; ++i) {
+      png_read_row(png_ptr_, data + i * width_ * depth_, NULL);
+    }
+    return true;
+  }
+
+ private:
+  png_structp png_ptr_;
+  png_infop info_ptr_;
+};
+
+class JpgRowReader : public BaseRowReader {
+ public:
+  JpgRowReader(FILE *file) : BaseRowReader(file) {
+    cinfo_.err = jpeg_std_error(&jerr_.pub);
+    jerr_.pub.error_exit = &jpeg_error;
+    jpeg_create_decompress(&cinfo_);
+  }
+  virtual ~JpgRowReader() {
+    jpeg_destroy_decompress(&cinfo_);
+  }
+
+  virtual bool Init() {
+    if (setjmp(jerr_.setjmp_buffer)) {
+      return false;
+    }
+    jpeg_stdio_src(&cinfo_, file_);
+    jpeg_read_header(&cinfo_, TRUE);
+    jpeg_start_decompress(&cinfo_);
+    height_ = cinfo_.output_height;
+    width_ = cinfo_.output_width;
+    depth_ = cinfo_.output_components;
+    return true;
+  }
+
+ protected:
+  virtual bool ReadRowsInto(int num_rows, unsigned char *data) {
+    if (setjmp(jerr_.setjmp_buffer)) {
+      return false;
+    }
+    for (int i = 0; i < num_rows; ++i) {
+      JSAMPROW row = data + i * width_ * depth_;
+      jpeg_read_scanlines(&cinfo_, &row, 1);
+    }
+    return true;
+  }
+
+ private:
+  jpeg_decompress_struct cinfo_;
+  my_error_mgr jerr_;
+};
+
+class BaseRowWriter : public ImageRowWriter {
+ public:
+  BaseRowWriter(FILE *file, int height, int width, int depth)
+      : file_(file), height_(height), width_(width), depth_(depth),
+        next_row_(0), failed_(false) {}
+  virtual ~BaseRowWriter() {
+    if (file_) {
+      fclose(file_);
+    }
+  }
+
+  virtual bool Init() = 0;
+
+  virtual bool WriteRows(const ByteImage &rows) {
+    if (!file_ || failed_ || rows.Width() != width_ ||
+        rows.Depth() != depth_ || next_row_ + rows.Height() > height_) {
+      return false;
+    }
+    if (!WriteRowsFrom(rows.Height(), rows.Data())) {
+      failed_ = true;
+      return false;
+    }
+    next_row_ += rows.Height();
+    return true;
+  }
+
+  virtual bool Close() {
+    if (!file_) {
+      return false;
+    }
+    bool success = !failed_ && next_row_ == height_ && Finish();
+    success = fclose(file_) == 0 && success;
+    file_ = NULL;
+    return success;
+  }
+
+ protected:
+  virtual bool WriteRowsFrom(int num_rows, const unsigned char *data) = 0;
+  // Called by Close() once every row is written.
+  virtual bool Finish() {
+    return true;
+  }
+
+  FILE *file_;
+  int height_, width_, depth_;
+  int next_row_;
+  bool failed_;
+};
+
+class PnmRowWriter : public BaseRowWriter {
+ public:
+  PnmRowWriter(FILE *file, int height, int width, int depth)
+      : BaseRowWriter(file, height, width, depth) {}
+
+  virtual bool Init() {
+    if (depth_ != 1 && depth_ != 3) {
+      return false;
+    }
+    return fprintf(file_, "P%d\n%d %d %d\n", depth_ == 1 ? 5 : 6,
+                   width_, height_, 255) > 0;
+  }
+
+ protected:
+  virtual bool WriteRowsFrom(int num_rows, const unsigned char *data) {
+    size_t size = static_cast<size_t>(num_rows) * width_ * depth_;
+    return fwrite(data, 1, size, file_) == size;
+  }
+};
+
+class PngRowWriter : public BaseRowWriter {
+ public:
+  PngRowWriter(FILE *file, int height, int width, int depth)
+      : BaseRowWriter(file, height, width, depth),
+        png_ptr_(NULL), info_ptr_(NULL) {}
+  virtual ~PngRowWriter() {
+    if (png_ptr_) {
+      png_destroy_write_struct(&png_ptr_, info_ptr_ ? &info_ptr_ : NULL);
+    }
+  }
+
+  virtual bool Init() {
+    int colour;
+    if (depth_ == 3) {
+      colour = PNG_COLOR_TYPE_RGB;
+    } else if (depth_ == 1) {
+      colour = PNG_COLOR_TYPE_GRAY;
+    } else {
+      return false;
+    }
+    png_ptr_ = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (!png_ptr_) {
+      return false;
+    }
+    info_ptr_ = png_create_info_struct(png_ptr_);
+    if (!info_ptr_) {
+      return false;
+    }
+    if (setjmp(png_jmpbuf(png_ptr_))) {
+      return false;
+    }
+    png_init_io(png_ptr_, file_);
+    png_set_IHDR(png_ptr_, info_ptr_, width_, height_,
+                 8, colour, PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+    png_write_info(png_ptr_, info_ptr_);
+    return true;
+  }
+
+ protected:
+  virtual bool WriteRowsFrom(int num_rows, const unsigned char *data) {
+    if (setjmp(png_jmpbuf(png_ptr_))) {
+      return false;
+    }
+    for (int i = 0; i < num_rows; ++i) {
+      png_write_row(png_ptr_,
+                    const_cast<png_bytep>(data + i * width_ * depth_));
+    }
+    return true;
+  }
+
+  virtual bool Finish() {
+    if (setjmp(png_jmpbuf(png_ptr_))) {
+      return false;
+    }
+    png_write_end(png_ptr_, NULL);
+    return true;
+  }
+
+ private:
+  png_structp png_ptr_;
+  png_infop info_ptr_;
+};
+
+class JpgRowWriter : public BaseRowWriter {
+ public:
+  JpgRowWriter(FILE *file, int height, int width, int depth, int quality)
+      : BaseRowWriter(file, height, width, depth), quality_(quality) {
+    cinfo_.err = jpeg_std_error(&jerr_.pub);
+    jerr_.pub.error_exit = &jpeg_error;
+    jpeg_create_compress(&cinfo_);
+  }
+  virtual ~JpgRowWriter() {
+    jpeg_destroy_compress(&cinfo_);
+  }
+
+  virtual bool Init() {
+    if (depth_ != 1 && depth_ != 3) {
+      return false;
+    }
+    if (setjmp(jerr_.setjmp_buffer)) {
+      return false;
+    }
+    jpeg_stdio_dest(&cinfo_, file_);
+    cinfo_.image_width = width_;
+    cinfo_.image_height = height_;
+    cinfo_.input_components = depth_;
+    cinfo_.in_color_space = depth_ == 3 ? JCS_RGB : JCS_GRAYSCALE;
+    jpeg_set_defaults(&cinfo_);
+    jpeg_set_quality(&cinfo_, quality_, TRUE);
+    jpeg_start_compress(&cinfo_, TRUE);
+    return true;
+  }
+
+ protected:
+  virtual bool WriteRowsFrom(int num_rows, const unsigned char *data) {
+    if (setjmp(jerr_.setjmp_buffer)) {
+      return false;
+    }
+    for (int i = 0; i < num_rows; ++i) {
+      JSAMPROW row = const_cast<JSAMPROW>(data + i * width_ * depth_);
+      jpeg_write_scanlines(&cinfo_, &row, 1);
+    }
+    return true;
+  }
+
+  virtual bool Finish() {
+    if (setjmp(jerr_.setjmp_buffer)) {
+      return false;
+    }
+    jpeg_finish_compress(&cinfo_);
+    return true;
+  }
+
+ private:
+  int quality_;
+  jpeg_compress_struct cinfo_;
+  my_error_mgr jerr_;
+};
+
+}  // namespace
+
+ImageRowReader *OpenImageRowReader(const char *filename) {
+  Format format = GetFormat(filename);
+  if (format == Unknown) {
+    return NULL;
+  }
+  FILE *file = fopen(filename, "rb");
+  if (!file) {
+    LOG(ERROR) << "Error: Couldn't open " << filename << " fopen returned 0";
+    return NULL;
+  }
+  BaseRowReader *reader;
+  switch (format) {
+    case Pnm: reader = new PnmRowReader(file); break;
+    case Png: reader = new PngRowReader(file); break;
+    default:  reader = new JpgRowReader(file); break;
+  }
+  if (!reader->Init()) {
+    delete reader;
+    return NULL;
+  }
+  return reader;
+}
+
+ImageRowWriter *CreateImageRowWriter(const char *filename,
+                                     int height, int width, int depth,
+                                     int quality) {
+  Format format = GetFormat(filename);
+  if (format == Unknown) {
+    return NULL;
+  }
+  FILE *file = fopen(filename, "wb");
+  if (!file) {
+    LOG(ERROR) << "Error: Couldn't open " << filename << " fopen returned 0";
+    return NULL;
+  }
+  BaseRowWriter *writer;
+  switch (format) {
+    case Pnm: writer = new PnmRowWriter(file, height, width, depth); break;
+    case Png: writer = new PngRowWriter(file, height, width, depth); break;
+    default:
+      writer = new JpgRowWriter(file, height, width, depth, quality);
+      break;
+  }
+  if (!writer->Init()) {
+    delete writer;
+    return NULL;
+  }
+  return writer;
+}
+
 }  // namespace libmv
@@ -48,6 +48,27 @@ int WritePngStream(const ByteImage &, FILE *);
 int ReadJpg(const char *, ByteImage *);
 int ReadJpg(const char *, FloatImage *);
 int ReadJpgStream(FILE *, ByteImage *);
+
+// Options for decoding a JPEG at a reduced size, or only part of it.
+struct JpgReadOptions {
+  JpgReadOptions()
+      : scale_denominator(1), region_x(0), region_y(0),
+        region_width(0), region_height(0) {}
+
+  // Decode at 1/scale_denominator of the full size, rounding up; must be 1,
+  // 2, 4 or 8. libjpeg scales in the DCT domain, which is much cheaper than
+  // decoding at full size and downsampling.
+  int scale_denominator;
+
+  // Region of the scaled image to return. A width or height of 0 extends the
+  // region to the image border. Rows below the region are not decoded.
+  int region_x, region_y;
+  int region_width, region_height;
+};
+
+int ReadJpg(const char *, const JpgReadOptions &, ByteImage *);
+int ReadJpg(const char *, const JpgReadOptions &, FloatImage *);
+int ReadJpgStream(FILE *, const JpgReadOptions &, ByteImage *);
 int WriteJpg(const ByteImage &, const char *, int quality=90);
 int WriteJpg(const FloatImage &, const char *, int quality=90);
 int WriteJpgStream(const ByteImage &, FILE *, int quality=90);
@@ -59,6 +80,53 @@ int WritePnm(const ByteImage &im, const char *filename);
 int WritePnm(const FloatImage &im, const char *filename);
 int WritePnmStream(const ByteImage &im, FILE *file);
 
+// Reads an image a band of rows at a time, so that images larger than memory
+// can be processed with bounded memory. Supports the same formats as
+// ReadImage(), except interlaced PNGs.
+class ImageRowReader {
+ public:
+  virtual ~ImageRowReader() {}
+
+  // Size of the whole image.
+  virtual int Height() const = 0;
+  virtual int Width() const = 0;
+  virtual int Depth() const = 0;
+
+  // Reads the next num_rows rows, or fewer at the bottom of the image, into
+  // rows, resized to the number of rows read. Returns that number: 0 after
+  // the last row or on errors.
+  virtual int ReadRows(int num_rows, ByteImage *rows) = 0;
+  // Same as above, with the values scaled to [0, 1] like ReadImage().
+  int ReadRows(int num_rows, FloatImage *rows);
+
+  // Number of rows read so far.
+  virtual int NextRow() const = 0;
+};
+
+// Returns NULL if the file cannot be opened or is not a supported image.
+ImageRowReader *OpenImageRowReader(const char *filename);
+
+// Writes an image of a known size a band of rows at a time.
+class ImageRowWriter {
+ public:
+  virtual ~ImageRowWriter() {}
+
+  // Appends rows, which must have the width and depth of the image.
+  virtual bool WriteRows(const ByteImage &rows) = 0;
+  // Same as above, with values in [0, 1] scaled like WriteImage().
+  bool WriteRows(const FloatImage &rows);
+
+  // Completes the file once all the rows are written. Returns false if rows
+  // are missing or the file could not be written.
+  virtual bool Close() = 0;
+};
+
+// Returns NULL if the file cannot be created, the format is unknown or depth
+// is not supported by the format. quality is only used for JPEGs.
+ImageRowWriter *CreateImageRowWriter(const char *filename,
+                                     int height, int width, int depth,
+                                     int quality = 90);
+
 }  // namespace libmv
 
 #endif  // LIBMV_IMAGE_IMAGE_IMAGE_IO_H
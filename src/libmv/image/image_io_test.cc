@@ -18,6 +18,8 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <string>
 
@@ -28,7 +30,11 @@
 using libmv::Array3Df;
 using libmv::Array3Du;
 using libmv::FloatImage;
+using libmv::CreateImageRowWriter;
 using libmv::GetFormat;
+using libmv::ImageRowReader;
+using libmv::ImageRowWriter;
+using libmv::OpenImageRowReader;
 using std::string;
 
 #include <cstdio>
@@ -226,6 +232,146 @@ TEST_F(ImageIOTest, Jpg) {
   EXPECT_TRUE(read_image == image);
 }
 
+TEST_F(ImageIOTest, JpgScaled) {
+  Array3Du image(48, 64);
+  for (int i = 0; i < image.Height(); ++i) {
+    for (int j = 0; j < image.Width(); ++j) {
+      image(i, j) = 2 * i + j;
+    }
+  }
+  string out_filename = TmpFile("test_scaled_jpg.jpg");
+  EXPECT_TRUE(WriteJpg(image, out_filename.c_str(), 100));
+
+  libmv::JpgReadOptions options;
+  for (int scale = 2; scale <= 8; scale *= 2) {
+    options.scale_denominator = scale;
+    Array3Du scaled;
+    EXPECT_TRUE(ReadJpg(out_filename.c_str(), options, &scaled));
+    EXPECT_EQ(48 / scale, scaled.Height());
+    EXPECT_EQ(64 / scale, scaled.Width());
+    // Each pixel is about the mean of the block it covers.
+    for (int i = 0; i < scaled.Height(); ++i) {
+      for (int j = 0; j < scaled.Width(); ++j) {
+        float mean = 2 * (scale * i + (scale - 1) / 2.f) +
+                     scale * j + (scale - 1) / 2.f;
+        EXPECT_NEAR(mean, scaled(i, j), 3);
+      }
+    }
+  }
+  options.scale_denominator = 3;
+  Array3Du scaled;
+  EXPECT_FALSE(ReadJpg(out_filename.c_str(), options, &scaled));
+}
+
+TEST_F(ImageIOTest, JpgRegion) {
+  Array3Du image(48, 64);
+  for (int i = 0; i < image.Height(); ++i) {
+    for (int j = 0; j < image.Width(); ++j) {
+      image(i, j) = 2 * i + j;
+    }
+  }
+  string out_filename = TmpFile("test_region_jpg.jpg");
+  EXPECT_TRUE(WriteJpg(image, out_filename.c_str(), 90));
+
+  libmv::JpgReadOptions options;
+  options.scale_denominator = 2;
+  Array3Du full;
+  EXPECT_TRUE(ReadJpg(out_filename.c_str(), options, &full));
+
+  options.region_x = 5;
+  options.region_y = 3;
+  options.region_width = 10;
+  options.region_height = 7;
+  Array3Du region;
+  EXPECT_TRUE(ReadJpg(out_filename.c_str(), options, &region));
+  EXPECT_EQ(7, region.Height());
+  EXPECT_EQ(10, region.Width());
+  for (int i = 0; i < region.Height(); ++i) {
+    for (int j = 0; j < region.Width(); ++j) {
+      EXPECT_EQ(full(i + 3, j + 5), region(i, j));
+    }
+  }
+
+  // A zero size extends the region to the border.
+  options.region_width = 0;
+  options.region_height = 0;
+  EXPECT_TRUE(ReadJpg(out_filename.c_str(), options, &region));
+  EXPECT_EQ(24 - 3, region.Height());
+  EXPECT_EQ(32 - 5, region.Width());
+
+  options.region_width = 30;
+  EXPECT_FALSE(ReadJpg(out_filename.c_str(), options, &region));
+}
+
+TEST_F(ImageIOTest, RowReaderAndWriter) {
+  Array3Du image(37, 21, 3);
+  for (int i = 0; i < image.Size(); ++i) {
+    image.Data()[i] = (7 * i) % 251;
+  }
+  const char *names[] = {
+    "test_rows.ppm", "test_rows.png", "test_rows.jpg"
+  };
+  for (int f = 0; f < 3; ++f) {
+    string filename = TmpFile(names[f]);
+    ImageRowWriter *writer =
+        CreateImageRowWriter(filename.c_str(), 37, 21, 3, 100);
+    ASSERT_TRUE(writer) << names[f];
+    // Bands of 8 rows, the last one shorter.
+    for (int row = 0; row < image.Height(); row += 8) {
+      int rows = std::min(8, image.Height() - row);
+      Array3Du band(rows, 21, 3);
+      memcpy(band.Data(), &image(row, 0, 0), band.Size());
+      EXPECT_TRUE(writer->WriteRows(band));
+    }
+    EXPECT_TRUE(writer->Close());
+    delete writer;
+
+    Array3Du whole;
+    EXPECT_TRUE(ReadImage(filename.c_str(), &whole));
+    if (f < 2) {
+      EXPECT_TRUE(whole == image) << names[f];
+    }
+
+    ImageRowReader *reader = OpenImageRowReader(filename.c_str());
+    ASSERT_TRUE(reader) << names[f];
+    EXPECT_EQ(37, reader->Height());
+    EXPECT_EQ(21, reader->Width());
+    EXPECT_EQ(3, reader->Depth());
+    Array3Du band;
+    int row = 0;
+    int rows;
+    while ((rows = reader->ReadRows(10, &band)) > 0) {
+      EXPECT_EQ(rows, band.Height());
+      for (int i = 0; i < band.Height(); ++i) {
+        for (int j = 0; j < band.Width(); ++j) {
+          for (int k = 0; k < band.Depth(); ++k) {
+            EXPECT_EQ(whole(row + i, j, k), band(i, j, k));
+          }
+        }
+      }
+      row += rows;
+      EXPECT_EQ(row, reader->NextRow());
+    }
+    EXPECT_EQ(37, row);
+    delete reader;
+  }
+}
+
+TEST_F(ImageIOTest, RowWriterChecksRows) {
+  string filename = TmpFile("test_rows_missing.pgm");
+  ImageRowWriter *writer =
+      CreateImageRowWriter(filename.c_str(), 4, 3, 1);
+  ASSERT_TRUE(writer);
+  EXPECT_FALSE(writer->WriteRows(Array3Du(2, 4, 1)));
+  EXPECT_TRUE(writer->WriteRows(Array3Du(3, 3, 1)));
+  EXPECT_FALSE(writer->WriteRows(Array3Du(2, 3, 1)));
+  EXPECT_FALSE(writer->Close());
+  delete writer;
+
+  EXPECT_FALSE(CreateImageRowWriter(filename.c_str(), 4, 3, 2));
+  EXPECT_FALSE(OpenImageRowReader("hopefully_unexisting_file.png"));
+}
+
 TEST(GetFormat, filenames) {
   EXPECT_EQ(GetFormat("something.jpg"), libmv::Jpg);
   EXPECT_EQ(GetFormat("something.png"), libmv::Png);
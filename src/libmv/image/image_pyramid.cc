@@ -19,20 +19,23 @@
 // IN THE SOFTWARE.
 
 
+#include "libmv/base/memory_budget.h"
 #include "libmv/base/vector.h"
 #include "libmv/image/image_pyramid.h"
 #include "libmv/image/convolve.h"
 #include "libmv/image/sample.h"
+#include "libmv/logging/logging.h"
 
 namespace libmv {
 
 class ConcreteImagePyramid : public ImagePyramid {
  public:
-  ConcreteImagePyramid() {}
+  ConcreteImagePyramid() : memory_(MEMORY_PYRAMIDS) {}
 
   ConcreteImagePyramid(const FloatImage &image,
                        int num_levels,
-                       double sigma = 0.9) {
+                       double sigma = 0.9)
+      : memory_(MEMORY_PYRAMIDS) {
     Init(image, num_levels, sigma);
   }
 
@@ -40,19 +43,25 @@ class ConcreteImagePyramid : public ImagePyramid {
   }
 
   void Init(const FloatImage &image, int num_levels, double sigma = 0.9) {
+    LIBMV_SCOPED_TIMER("image.pyramid");
     assert(image.Depth() == 1);
 
     levels_.resize(num_levels);
 
     BlurredImageAndDerivativesChannels(image, sigma, &levels_[0]);
 
-    vector<FloatImage> downsamples(num_levels);
-    downsamples[0] = image;
-
+    // Only the previous downsampled level is needed to build the next one.
+    const FloatImage *previous = &image;
     for (int i = 1; i < NumLevels(); ++i) {
-      DownsampleChannelsBy2(downsamples[i-1], &downsamples[i]);
-      BlurredImageAndDerivativesChannels(downsamples[i], sigma, &levels_[i]);
+      FloatImage *current = &downsamples_[i % 2];
+      DownsampleBy2AndBlurredImageAndDerivativesChannels(*previous, sigma,
+                                                         current,
+                                                         &levels_[i]);
+      previous = current;
     }
+    memory_.Set(MemorySizeInBytes() + downsamples_[0].MemorySizeInBytes() +
+                downsamples_[1].MemorySizeInBytes());
+    ReclaimMemoryOverBudget();
   }
 
   virtual const FloatImage &Level(int i) {
@@ -74,6 +83,9 @@ class ConcreteImagePyramid : public ImagePyramid {
 
  private:
   vector<FloatImage> levels_;
+  // Kept between the calls to Init(), which reuses their storage.
+  FloatImage downsamples_[2];
+  MemoryUsage memory_;
 };
 
 ImagePyramid *MakeImagePyramid(const FloatImage &image,
@@ -82,5 +94,18 @@ ImagePyramid *MakeImagePyramid(const FloatImage &image,
   return new ConcreteImagePyramid(image, num_levels, sigma);
 }
 
+bool RebuildImagePyramid(const FloatImage &image,
+                         int num_levels,
+                         double sigma,
+                         ImagePyramid *pyramid) {
+  ConcreteImagePyramid *concrete =
+      dynamic_cast<ConcreteImagePyramid *>(pyramid);
+  if (!concrete) {
+    return false;
+  }
+  concrete->Init(image, num_levels, sigma);
+  return true;
+}
+
 }  // namespace libmv
 
@@ -36,6 +36,16 @@ class ImagePyramid {
 ImagePyramid *MakeImagePyramid(const FloatImage &image,
                                int num_levels,
                                double sigma);
+
+// Rebuilds a pyramid made by MakeImagePyramid() from another image, in place:
+// the storage of the levels, and of the downsampled frames they are built
+// from, is reused when the image has the size of the previous one, so that
+// pyramids recycled along a sequence do not allocate. Returns false, leaving
+// the pyramid alone, if it was not made by MakeImagePyramid().
+bool RebuildImagePyramid(const FloatImage &image,
+                         int num_levels,
+                         double sigma,
+                         ImagePyramid *pyramid);
 }  // namespace libmv
 
 #endif  // LIBMV_IMAGE_IMAGE_PYRAMID_H
@@ -25,6 +25,7 @@
 using libmv::Array3Df;
 using libmv::ImagePyramid;
 using libmv::MakeImagePyramid;
+using libmv::RebuildImagePyramid;
 
 namespace {
 
@@ -39,4 +40,32 @@ TEST(ImagePyramid, Init) {
   delete ip;
 }
 
+TEST(ImagePyramid, RebuildReusesTheLevels) {
+  Array3Df image(32, 40), other(32, 40);
+  for (int r = 0; r < 32; ++r) {
+    for (int c = 0; c < 40; ++c) {
+      image(r, c) = r + 2 * c;
+      other(r, c) = (r * c) % 7;
+    }
+  }
+  ImagePyramid *ip = MakeImagePyramid(image, 3, 0.9);
+  const float *data[3];
+  for (int i = 0; i < 3; ++i) {
+    data[i] = ip->Level(i).Data();
+  }
+  EXPECT_TRUE(RebuildImagePyramid(other, 3, 0.9, ip));
+
+  ImagePyramid *expected = MakeImagePyramid(other, 3, 0.9);
+  for (int i = 0; i < 3; ++i) {
+    const Array3Df &level = ip->Level(i);
+    EXPECT_EQ(data[i], level.Data());
+    ASSERT_TRUE(level.Shape() == expected->Level(i).Shape());
+    for (int j = 0; j < level.Size(); ++j) {
+      EXPECT_EQ(expected->Level(i).Data()[j], level.Data()[j]);
+    }
+  }
+  delete expected;
+  delete ip;
+}
+
 }  // namespace
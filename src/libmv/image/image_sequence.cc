@@ -36,5 +36,9 @@ Array3Df *ImageSequence::GetFloatImage(int i) {
 ImageCache *ImageSequence::Cache() {
   return NULL;
 }
+std::string ImageSequence::FrameKey(int i) {
+  (void) i;
+  return "";
+}
 
 }  // namespace libmv
@@ -21,6 +21,8 @@
 #ifndef LIBMV_IMAGE_IMAGE_SEQUENCE_H_
 #define LIBMV_IMAGE_IMAGE_SEQUENCE_H_
 
+#include <string>
+
 namespace libmv {
 
 class Image;
@@ -46,6 +48,11 @@ class ImageSequence {
 
   // The image cache. Null if the sequence is uncached.
   virtual ImageCache *Cache();
+
+  // A key describing the contents of frame i, which changes whenever the
+  // frame would; see DiskImageCache. Empty, the default, if the sequence
+  // cannot tell.
+  virtual std::string FrameKey(int i);
 };
 
 }  // namespace libmv
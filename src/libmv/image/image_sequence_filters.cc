@@ -19,6 +19,7 @@
 // IN THE SOFTWARE.
 
 #include <cstdio>
+#include <string>
 
 #include "libmv/image/convolve.h"
 #include "libmv/image/filtered_sequence.h"
@@ -28,6 +29,13 @@ namespace libmv {
 
 namespace {
 
+std::string ParametersWithSigma(const char *name, double sigma) {
+  char parameters[64];
+  // Enough digits to tell any two sigmas apart.
+  sprintf(parameters, "%s sigma=%.17g", name, sigma);
+  return parameters;
+}
+
 class BlurAndTakeDerivativesFilter : public Filter {
  public:
   BlurAndTakeDerivativesFilter(double sigma)
@@ -36,6 +44,9 @@ class BlurAndTakeDerivativesFilter : public Filter {
   virtual void RunFilter(const Array3Df &source, Array3Df *destination) {
     BlurredImageAndDerivativesChannels(source, sigma_, destination);
   }
+  virtual std::string Parameters() const {
+    return ParametersWithSigma("blur_and_derivatives", sigma_);
+  }
   double sigma_;
 };
 
@@ -45,6 +56,23 @@ class DownSampleBy2Filter : public Filter {
   void RunFilter(const Array3Df &source, Array3Df *destination) {
     DownsampleChannelsBy2(source, destination);
   }
+  virtual std::string Parameters() const {
+    return "downsample_by_2";
+  }
+};
+
+class BlurAndDownsampleBy2Filter : public Filter {
+ public:
+  BlurAndDownsampleBy2Filter(double sigma)
+      : sigma_(sigma) {}
+  virtual ~BlurAndDownsampleBy2Filter() {}
+  void RunFilter(const Array3Df &source, Array3Df *destination) {
+    BlurAndDownsampleBy2(source, sigma_, destination);
+  }
+  virtual std::string Parameters() const {
+    return ParametersWithSigma("blur_and_downsample_by_2", sigma_);
+  }
+  double sigma_;
 };
 
 }  // namespace
@@ -59,4 +87,9 @@ ImageSequence *DownsampleSequenceBy2(ImageSequence *source) {
   return new FilteredImageSequence(source, new DownSampleBy2Filter());
 }
 
+ImageSequence *DownsampleSequenceBy2(ImageSequence *source, double sigma) {
+  return new FilteredImageSequence(source,
+                                   new BlurAndDownsampleBy2Filter(sigma));
+}
+
 }  // namespace libmv
@@ -35,6 +35,10 @@ ImageSequence *BlurSequenceAndTakeDerivatives(ImageSequence *source,
 // Downsample each image in source by 2 in each dimension.
 ImageSequence *DownsampleSequenceBy2(ImageSequence *source);
 
+// Same as above, with a Gaussian prefilter of the given sigma instead of a box
+// filter; see BlurAndDownsampleBy2().
+ImageSequence *DownsampleSequenceBy2(ImageSequence *source, double sigma);
+
 }  // namespace libmv
 
 #endif  // LIBMV_IMAGE_IMAGE_SEQUENCE_FILTERS_H_
@@ -80,4 +80,23 @@ TEST(DownsampleBy2, Simple) {
   delete filtered;
 }
 
+TEST(DownsampleBy2, Gaussian) {
+  ImageCache cache;
+  MockImageSequence source(&cache);
+  Array3Df image0(5, 3);
+  image0.Fill(0.75);
+  source.Append(&image0);
+
+  ImageSequence *filtered = DownsampleSequenceBy2(&source, 1.0);
+
+  const Array3Df filtered_image = *filtered->GetFloatImage(0);
+  ASSERT_EQ(3, filtered_image.Height());
+  ASSERT_EQ(2, filtered_image.Width());
+  ASSERT_EQ(1, filtered_image.Depth());
+  EXPECT_NEAR(0.75, filtered_image(2, 1), 1e-6);
+  filtered->Unpin(0);
+
+  delete filtered;
+}
+
 }  // namespace
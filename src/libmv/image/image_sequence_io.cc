@@ -18,12 +18,55 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <deque>
+#include <pthread.h>
+#include <set>
+
+#include "libmv/base/thread.h"
+#include "libmv/base/timer.h"
 #include "libmv/image/image_io.h"
 #include "libmv/image/image_sequence_io.h"
 #include "libmv/image/cached_image_sequence.h"
+#include "libmv/image/disk_image_cache.h"
+#include "libmv/image/video_sequence.h"
+#include "libmv/logging/logging.h"
 
 namespace libmv {
 
+static Image *LoadImageFromFile(const std::vector<std::string> &filenames,
+                                int i) {
+  Array3Df *image = new Array3Df;
+  if (!ReadImage(filenames[i].c_str(), image)) {
+    delete image;
+    // TODO(keir): Better error reporting?
+    fprintf(stderr, "Failed loading image %d: %s\n",
+            i, filenames[i].c_str());
+    return 0;
+  }
+  return new Image(image);
+}
+
+// The content keys of the files of a sequence, computed once each.
+class FileContentKeys {
+ public:
+  FileContentKeys(const std::vector<std::string> &filenames)
+      : filenames_(filenames), keys_(filenames.size()) {}
+
+  // Empty if the file cannot be read.
+  std::string Key(int i) {
+    MutexLock lock(&mutex_);
+    if (keys_[i].empty()) {
+      MakeFileContentKey(filenames_[i], &keys_[i]);
+    }
+    return keys_[i];
+  }
+
+ private:
+  std::vector<std::string> filenames_;
+  std::vector<std::string> keys_;
+  Mutex mutex_;
+};
+
 // An image sequence loaded from disk with caching behaviour.
 class LazyImageSequenceFromFiles : public CachedImageSequence {
  public:
@@ -32,31 +75,229 @@ class LazyImageSequenceFromFiles : public CachedImageSequence {
   LazyImageSequenceFromFiles(const std::vector<std::string> &image_filenames,
                         ImageCache *cache)
       : CachedImageSequence(cache),
-        filenames_(image_filenames) {}
+        filenames_(image_filenames),
+        keys_(image_filenames) {}
 
   virtual int Length() {
     return filenames_.size();
   }
 
   virtual Image *LoadImage(int i) {
-    Array3Df *image = new Array3Df;
-    if (!ReadImage(filenames_[i].c_str(), image)) {
-      delete image;
-      // TODO(keir): Better error reporting?
-      fprintf(stderr, "Failed loading image %d: %s\n",
-              i, filenames_[i].c_str());
-      return 0;
-    }
-    return new Image(image);
+    return LoadImageFromFile(filenames_, i);
+  }
+
+  virtual std::string FrameKey(int i) {
+    return keys_.Key(i);
   }
 
  private:
   std::vector<std::string> filenames_;
+  FileContentKeys keys_;
 };
 
 ImageSequence *ImageSequenceFromFiles(const std::vector<std::string> &filenames,
+                                      ImageCache *cache,
+                                      bool half_precision) {
+  LazyImageSequenceFromFiles *sequence =
+      new LazyImageSequenceFromFiles(filenames, cache);
+  sequence->SetHalfPrecisionStorage(half_precision);
+  return sequence;
+}
+
+// An image sequence loaded from disk, where frames following the requested
+// one are decoded by background threads. All the state shared with the
+// decoder threads is protected by mutex_; the cache does its own locking.
+class PrefetchingImageSequenceFromFilesImpl : public PrefetchingImageSequence {
+ public:
+  PrefetchingImageSequenceFromFilesImpl(
+      const std::vector<std::string> &image_filenames,
+      ImageCache *cache,
+      int look_ahead,
+      int num_threads)
+      : filenames_(image_filenames),
+        keys_(image_filenames),
+        cache_(cache),
+        look_ahead_(look_ahead),
+        stopping_(false) {
+    assert(cache->IsThreadSafe());
+    for (int t = 0; t < num_threads; ++t) {
+      pthread_t thread;
+      if (pthread_create(&thread, NULL, &DecoderEntry, this) == 0) {
+        threads_.push_back(thread);
+      }
+    }
+    if (threads_.empty()) {
+      // Nobody would decode the queued frames; load everything on demand.
+      look_ahead_ = 0;
+    }
+  }
+
+  virtual ~PrefetchingImageSequenceFromFilesImpl() {
+    mutex_.Lock();
+    stopping_ = true;
+    work_ready_.Broadcast();
+    mutex_.Unlock();
+    for (size_t t = 0; t < threads_.size(); ++t) {
+      pthread_join(threads_[t], NULL);
+    }
+  }
+
+  virtual Image *GetImage(int i) {
+    WallTimer timer;
+    bool hit = true;
+    TaggedImageKey key(this, i);
+    {
+      MutexLock lock(&mutex_);
+      for (int j = i + 1; j <= i + look_ahead_; ++j) {
+        Schedule(j);
+      }
+      if (pending_.count(i)) {
+        LIBMV_SCOPED_TIMER("image_sequence.prefetch_stall");
+        hit = false;
+        while (pending_.count(i)) {
+          frame_done_.Wait(&mutex_);
+        }
+      }
+    }
+    Image *image;
+    if (!cache_->FetchAndPin(key, &image)) {
+      hit = false;
+      image = LoadFrame(i);
+      if (image) {
+        image = cache_->InsertAndPinSized(key, image,
+                                          image->MemorySizeInBytes());
+      }
+    }
+    MutexLock lock(&mutex_);
+    if (hit) {
+      statistics_.hits++;
+    } else {
+      statistics_.misses++;
+      statistics_.stall_seconds += timer.ElapsedSeconds();
+    }
+    return image;
+  }
+
+  virtual void Unpin(int i) {
+    TaggedImageKey key(this, i);
+    cache_->Unpin(key);
+  }
+
+  virtual int Length() {
+    return filenames_.size();
+  }
+
+  virtual ImageCache *Cache() {
+    return cache_;
+  }
+
+  virtual std::string FrameKey(int i) {
+    return keys_.Key(i);
+  }
+
+  virtual PrefetchStatistics Statistics() {
+    MutexLock lock(&mutex_);
+    return statistics_;
+  }
+
+ private:
+  // Queue frame i for decoding unless it is known or about to be. The mutex
+  // must be held.
+  void Schedule(int i) {
+    if (i >= Length() || pending_.count(i) ||
+        cache_->ContainsKey(TaggedImageKey(this, i))) {
+      return;
+    }
+    queue_.push_back(i);
+    pending_.insert(i);
+    work_ready_.Signal();
+  }
+
+  // Loads frame i through the compressed tier of the cache, if it has one.
+  Image *LoadFrame(int i) {
+    CompressedImageStore *tier = cache_->CompressedTier();
+    if (!tier) {
+      return LoadImageFromFile(filenames_, i);
+    }
+    TaggedImageKey key(this, i);
+    Image *image = tier->Load(key);
+    if (image) {
+      LIBMV_COUNTER("image_cache.compressed_hits", 1);
+      return image;
+    }
+    image = LoadImageFromFile(filenames_, i);
+    if (image) {
+      tier->Store(key, *image);
+    }
+    return image;
+  }
+
+  static void *DecoderEntry(void *self) {
+    static_cast<PrefetchingImageSequenceFromFilesImpl *>(self)->DecodeFrames();
+    return NULL;
+  }
+
+  void DecodeFrames() {
+    for (;;) {
+      mutex_.Lock();
+      while (!stopping_ && queue_.empty()) {
+        work_ready_.Wait(&mutex_);
+      }
+      if (stopping_) {
+        mutex_.Unlock();
+        return;
+      }
+      int i = queue_.front();
+      queue_.pop_front();
+      mutex_.Unlock();
+
+      LIBMV_SCOPED_TIMER("image_sequence.decode");
+      TaggedImageKey key(this, i);
+      Image *image = LoadFrame(i);
+      if (image) {
+        cache_->InsertAndPinSized(key, image, image->MemorySizeInBytes());
+        cache_->Unpin(key);
+      }
+
+      mutex_.Lock();
+      pending_.erase(i);
+      frame_done_.Broadcast();
+      mutex_.Unlock();
+    }
+  }
+
+  std::vector<std::string> filenames_;
+  FileContentKeys keys_;
+  ImageCache *cache_;
+  int look_ahead_;
+  std::vector<pthread_t> threads_;
+
+  Mutex mutex_;
+  ConditionVariable work_ready_;
+  ConditionVariable frame_done_;
+  bool stopping_;
+  // Frames waiting for a decoder thread.
+  std::deque<int> queue_;
+  // Frames queued or being decoded.
+  std::set<int> pending_;
+  PrefetchStatistics statistics_;
+};
+
+PrefetchingImageSequence *PrefetchingImageSequenceFromFiles(
+    const std::vector<std::string> &filenames,
+    ImageCache *cache,
+    int look_ahead,
+    int num_threads) {
+  return new PrefetchingImageSequenceFromFilesImpl(filenames, cache,
+                                                   look_ahead, num_threads);
+}
+
+ImageSequence *ImageSequenceFromPaths(const std::vector<std::string> &paths,
                                       ImageCache *cache) {
-  return new LazyImageSequenceFromFiles(filenames, cache);
+  if (paths.size() == 1 && IsVideoFile(paths[0])) {
+    return ImageSequenceFromVideo(paths[0], cache);
+  }
+  return ImageSequenceFromFiles(paths, cache);
 }
 
 }  // namespace libmv
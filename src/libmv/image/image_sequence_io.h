@@ -24,16 +24,54 @@
 #include <string>
 #include <vector>
 
+#include "libmv/image/image.h"
+#include "libmv/image/image_sequence.h"
+
 namespace libmv {
 
-class ImageSequence;
 class ImageCache;
 
 // An image sequence loaded from disk. Images in the sequerce are float images.
+// With half_precision, the frames are kept in the cache as half precision
+// images; see CachedImageSequence::SetHalfPrecisionStorage().
 ImageSequence *ImageSequenceFromFiles(const std::vector<std::string> &filenames,
-                                      ImageCache *cache);
+                                      ImageCache *cache,
+                                      bool half_precision = false);
+
+struct PrefetchStatistics {
+  PrefetchStatistics() : hits(0), misses(0), stall_seconds(0) {}
+
+  // Frames that were in the cache when requested.
+  int hits;
+  // Frames that were still being decoded, or not scheduled at all.
+  int misses;
+  // Total time spent waiting for frames in GetImage().
+  double stall_seconds;
+};
 
-// TODO(keir): Add a from AVI or from MOV here.
+// An image sequence that decodes frames ahead of the consumer.
+class PrefetchingImageSequence : public ImageSequence {
+ public:
+  virtual ~PrefetchingImageSequence() {}
+  virtual PrefetchStatistics Statistics() = 0;
+};
+
+// Like ImageSequenceFromFiles(), but each GetImage(i) queues the frames
+// i + 1 to i + look_ahead for decoding by num_threads background threads,
+// which store them unpinned in the cache. The cache must be thread safe
+// (constructed with ImageCache::THREAD_SAFE) and be large enough to hold the
+// look ahead window, otherwise prefetched frames get evicted before use.
+PrefetchingImageSequence *PrefetchingImageSequenceFromFiles(
+    const std::vector<std::string> &filenames,
+    ImageCache *cache,
+    int look_ahead,
+    int num_threads = 1);
+
+// A video when paths is a single video file (see IsVideoFile()), otherwise
+// the sequence of the image files in paths. Returns NULL if the video cannot
+// be opened.
+ImageSequence *ImageSequenceFromPaths(const std::vector<std::string> &paths,
+                                      ImageCache *cache);
 
 }  // namespace libmv
 
@@ -18,6 +18,7 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <cstdio>
 #include <string>
 #include <vector>
 
@@ -30,6 +31,9 @@ using libmv::Image;
 using libmv::ImageCache;
 using libmv::ImageSequence;
 using libmv::ImageSequenceFromFiles;
+using libmv::PrefetchingImageSequence;
+using libmv::PrefetchingImageSequenceFromFiles;
+using libmv::PrefetchStatistics;
 using libmv::Array3Df;
 using std::string;
 
@@ -78,4 +82,89 @@ TEST(ImageSequenceIO, FromFiles) {
   unlink(image2_fn.c_str());
 }
 
+TEST(ImageSequenceIO, HalfPrecisionFromFiles) {
+  Array3Df image1(4, 6);
+  for (int i = 0; i < image1.Height(); ++i) {
+    for (int j = 0; j < image1.Width(); ++j) {
+      image1(i, j) = (10 * i + j) / 255.f;
+    }
+  }
+  string image1_fn = string(THIS_SOURCE_DIR) + "/half1.pgm";
+  WritePnm(image1, image1_fn.c_str());
+
+  std::vector<std::string> files;
+  files.push_back(image1_fn);
+  ImageCache float_cache, half_cache;
+  ImageSequence *float_sequence = ImageSequenceFromFiles(files, &float_cache);
+  ImageSequence *half_sequence =
+      ImageSequenceFromFiles(files, &half_cache, true);
+
+  Array3Df *float_image = float_sequence->GetFloatImage(0);
+  ASSERT_TRUE(float_image);
+  EXPECT_EQ(Image::HALF, half_sequence->GetImage(0)->Type());
+  Array3Df *half_image = half_sequence->GetFloatImage(0);
+  ASSERT_TRUE(half_image);
+  // Each pixel takes two bytes instead of four.
+  EXPECT_EQ(2 * half_image->Size(), float_cache.Size() - half_cache.Size());
+
+  EXPECT_EQ(float_image->Height(), half_image->Height());
+  EXPECT_EQ(float_image->Width(), half_image->Width());
+  for (int i = 0; i < half_image->Height(); ++i) {
+    for (int j = 0; j < half_image->Width(); ++j) {
+      EXPECT_NEAR((*float_image)(i, j), (*half_image)(i, j), 1e-3);
+    }
+  }
+  // The decoded frame is kept while the frame is pinned.
+  EXPECT_EQ(half_image, half_sequence->GetFloatImage(0));
+
+  float_sequence->Unpin(0);
+  half_sequence->Unpin(0);
+  half_sequence->Unpin(0);
+  half_sequence->Unpin(0);
+  delete float_sequence;
+  delete half_sequence;
+  unlink(image1_fn.c_str());
+}
+
+TEST(ImageSequenceIO, PrefetchingFromFiles) {
+  const int kNumFrames = 6;
+  std::vector<std::string> files;
+  for (int i = 0; i < kNumFrames; ++i) {
+    Array3Df frame(3, 4);
+    frame.Fill(i / 10.f);
+    char name[32];
+    sprintf(name, "/prefetch_%d.pgm", i);
+    files.push_back(string(THIS_SOURCE_DIR) + name);
+    WritePnm(frame, files.back().c_str());
+  }
+
+  ImageCache cache(10*1024*1024, ImageCache::THREAD_SAFE);
+  PrefetchingImageSequence *sequence =
+      PrefetchingImageSequenceFromFiles(files, &cache, 3, 2);
+  EXPECT_EQ(kNumFrames, sequence->Length());
+  EXPECT_EQ(&cache, sequence->Cache());
+
+  for (int pass = 0; pass < 2; ++pass) {
+    for (int i = 0; i < kNumFrames; ++i) {
+      Array3Df *image = sequence->GetFloatImage(i);
+      ASSERT_TRUE(image);
+      EXPECT_EQ(4, image->Width());
+      EXPECT_EQ(3, image->Height());
+      EXPECT_NEAR(i / 10.f, (*image)(1, 2), 1. / 255);
+      sequence->Unpin(i);
+    }
+  }
+  PrefetchStatistics statistics = sequence->Statistics();
+  EXPECT_EQ(2 * kNumFrames, statistics.hits + statistics.misses);
+  // The first frame is never prefetched; the second pass only hits.
+  EXPECT_LE(1, statistics.misses);
+  EXPECT_LE(kNumFrames, statistics.hits);
+  EXPECT_LE(0, statistics.stall_seconds);
+  delete sequence;
+
+  for (int i = 0; i < kNumFrames; ++i) {
+    unlink(files[i].c_str());
+  }
+}
+
 }  // namespace
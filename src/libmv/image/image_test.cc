@@ -25,6 +25,7 @@
 
 using libmv::Image;
 using libmv::Array3Df;
+using libmv::Array3Du;
 
 namespace {
 
@@ -42,4 +43,41 @@ TEST(Image, MemorySizeInBytes) {
   EXPECT_EQ(size, image.MemorySizeInBytes());
 }
 
+TEST(Image, CopiesShareTheArray) {
+  Array3Du *array = new Array3Du(2, 3);
+  Image image(array);
+  EXPECT_EQ(1, image.UseCount());
+  {
+    Image copy(image);
+    Image assigned;
+    EXPECT_EQ(0, assigned.UseCount());
+    EXPECT_EQ(Image::NONE, assigned.Type());
+    assigned = copy;
+    EXPECT_EQ(array, copy.AsArray3Du());
+    EXPECT_EQ(array, assigned.AsArray3Du());
+    EXPECT_EQ(3, image.UseCount());
+    EXPECT_TRUE(image.IsShared());
+  }
+  EXPECT_EQ(1, image.UseCount());
+  EXPECT_FALSE(image.IsShared());
+}
+
+TEST(Image, MutableArrayCopiesOnWrite) {
+  Array3Df *array = new Array3Df(2, 3);
+  array->Fill(1);
+  Image image(array);
+  // Not shared: no copy.
+  EXPECT_EQ(array, image.MutableArray3Df());
+
+  Image copy = image;
+  Array3Df *unique = copy.MutableArray3Df();
+  EXPECT_NE(array, unique);
+  EXPECT_EQ(1, image.UseCount());
+  EXPECT_EQ(1, copy.UseCount());
+  (*unique)(1, 2) = 5;
+  EXPECT_EQ(1, (*image.AsArray3Df())(1, 2));
+  EXPECT_EQ(5, (*copy.AsArray3Df())(1, 2));
+  EXPECT_TRUE(NULL == copy.MutableArray3Du());
+}
+
 }  // namespace
@@ -20,6 +20,10 @@
 
 #include "libmv/image/image_transform_linear.h"
 
+#include <algorithm>
+#include <vector>
+
+#include "libmv/base/thread.h"
 #include "libmv/image/image_drawing.h"
 #include "libmv/image/sample.h"
 #include "libmv/logging/logging.h"
@@ -128,13 +132,121 @@ void RotateImage(const FloatImage &image_in,
   WarpImage(image_in, H, image_out);
 }
 
+namespace {
+
+// Columns are warped in blocks of this many pixels, whose source coordinates
+// are computed before sampling.
+const int kWarpBlockSize = 64;
+
+// Warps the rows of the output bounding box, for ParallelFor(). Each row is
+// split into blocks; for each block the source coordinates are computed from
+// the inverse homography, incrementally along the row, then sampled in one
+// batch.
+struct WarpRows {
+  const FloatImage *image_in;
+  FloatImage *image_out;
+  Mat3 Hinv;
+  int x_begin, x_end;
+  bool blend;
+  float blending_ratio;
+
+  void operator()(int row) const {
+    const int depth = image_out->Depth();
+    float xs[kWarpBlockSize], ys[kWarpBlockSize];
+    bool inside[kWarpBlockSize];
+    float samples[kWarpBlockSize * 4];
+    std::vector<float> wide_samples;
+    float *sample_buffer = samples;
+    if (depth > 4) {
+      wide_samples.resize(kWarpBlockSize * depth);
+      sample_buffer = &wide_samples[0];
+    }
+
+    // Hinv * (x, row, 1) is row_origin + x * column_step.
+    const Vec3 row_origin = Hinv.col(1) * row + Hinv.col(2);
+    const Vec3 column_step = Hinv.col(0);
+    for (int block = x_begin; block < x_end; block += kWarpBlockSize) {
+      const int n = std::min(kWarpBlockSize, x_end - block);
+      int num_inside = 0;
+      for (int c = 0; c < n; ++c) {
+        const Vec3 q = row_origin + (block + c) * column_step;
+        const double x = q(0) / q(2);
+        const double y = q(1) / q(2);
+        xs[c] = x;
+        ys[c] = y;
+        inside[c] = image_in->Contains(static_cast<int>(y),
+                                       static_cast<int>(x));
+        num_inside += inside[c];
+      }
+      if (num_inside == 0) {
+        continue;
+      }
+      SampleLinear(*image_in, ys, xs, n, sample_buffer);
+      for (int c = 0; c < n; ++c) {
+        if (!inside[c]) {
+          continue;
+        }
+        float *out = &(*image_out)(row, block + c, 0);
+        const float *sample = sample_buffer + c * depth;
+        bool out_contributes = false;
+        if (blend) {
+          for (int d = 0; d < depth; ++d) {
+            if (out[d] > 0) {
+              out_contributes = true;
+              break;
+            }
+          }
+        }
+        if (out_contributes) {
+          // Let's fade the previous frames.
+          for (int d = 0; d < depth; ++d) {
+            out[d] = (1 - blending_ratio) * out[d] +
+                     blending_ratio * sample[d];
+          }
+        } else {
+          for (int d = 0; d < depth; ++d) {
+            out[d] = sample[d];
+          }
+        }
+      }
+    }
+  }
+};
+
+// Backward mapping of the bounding box bbox of the warp into image_out: for
+// each destination pixel, find which pixel of image_in contributes.
+void WarpBoundingBox(const FloatImage &image_in,
+                     const Mat3 &Hinv,
+                     const Vec4i &bbox,
+                     bool blend,
+                     float blending_ratio,
+                     int num_threads,
+                     FloatImage *image_out) {
+  WarpRows warp;
+  warp.image_in = &image_in;
+  warp.image_out = image_out;
+  warp.Hinv = Hinv;
+  warp.x_begin = std::max(bbox(0), 0);
+  warp.x_end = std::min(bbox(1) + 1, image_out->Width());
+  warp.blend = blend;
+  warp.blending_ratio = blending_ratio;
+  if (warp.x_begin >= warp.x_end) {
+    return;
+  }
+  ParallelFor(std::max(bbox(2), 0), std::min(bbox(3) + 1, image_out->Height()),
+              num_threads, &warp);
+}
+
+}  // namespace
+
 /**
  * Warps an input image by a 3x3 matrix H and write the result in another image.
  */
 void WarpImage(const FloatImage &image_in,
                const Mat3 &H,
                FloatImage *image_out,
-               bool adapt_img_size) {
+               bool adapt_img_size,
+               int num_threads) {
   assert(image_out != NULL);
   assert(image_in.Depth() == image_out->Depth());
   Vec4i bbox;
@@ -146,23 +258,8 @@ void WarpImage(const FloatImage &image_in,
   } else {
     ComputeBoundingBox(image_size, H, &bbox);
   }
-  const Mat3 Hinv = Hbis.inverse();
-  //-- (Backward mapping. For the destination pixel search which pixel
-  //    contribute ?).
-  Vec3 qi, qm;
-  for (int j = bbox(2); j <= bbox(3); ++j)
-    for (int i = bbox(0); i <= bbox(1); ++i)
-      if (image_out->Contains(j, i)) {
-        qm << i, j, 1.0;
-        qi = Hinv * qm;
-        qi /= qi(2);
-        const int xImage = static_cast<int>(qi(0));
-        const int yImage = static_cast<int>(qi(1));
-        if (image_in.Contains(yImage, xImage)) {
-          for (int d = 0; d < image_out->Depth(); ++d) 
-            (*image_out)(j, i, d) = SampleLinear(image_in, qi(1), qi(0), d);
-        }
-      }
+  WarpBoundingBox(image_in, Hbis.inverse(), bbox, false, 0, num_threads,
+                  image_out);
 }
 
 /**
@@ -171,54 +268,29 @@ void WarpImage(const FloatImage &image_in,
 void WarpImageBlend(const FloatImage &image_in,
                     const Mat3 &H,
                     FloatImage *image_out,
-                    float blending_ratio) {
+                    float blending_ratio,
+                    int num_threads) {
   assert(image_out != NULL);
   assert(image_in.Depth() == image_out->Depth());
   Vec4i bbox;
-  const Mat3 Hinv = H.inverse();
   Vec2u image_size;
   image_size << image_in.Width(), image_in.Height();
   ComputeBoundingBox(image_size, H, &bbox);
-  
-  //-- Fill destination image
-  //-- (Backward mapping. For the destination pixel search which pixel
-  //    contribute ?).
-  Vec3 qi, qm;
-  bool bOutContrib=false;
-  for (int j = bbox(2); j <= bbox(3); ++j)
-    for (int i = bbox(0); i <= bbox(1); ++i)
-      if (image_out->Contains(j, i)) {
-        //- Algo :
-        // For the destination pixel (i,j) search which pixel from image_in
-        //  and image_out contribute.
-        // Perform a mean blending in the overlap zone, transfert original
-        //  value in the other part.
-        qm << i, j, 1.0;
-        qi = Hinv * qm;
-        qi /= qi(2);
-        const int xImage = static_cast<int>(qi(0));
-        const int yImage = static_cast<int>(qi(1));
-        if (image_in.Contains(yImage, xImage)) {
-          bOutContrib = false;
-          for (int d = 0; d < image_out->Depth(); ++d) 
-            if ((*image_out)(j, i, d) > 0) {
-              bOutContrib = true;
-              break;
-            }
-          if(bOutContrib) { //mean blending between image_out and image_in
-            for (int d = 0; d < image_out->Depth(); ++d) {
-              // Let's fade the previous frames
-              (*image_out)(j, i, d) = 
-                 (1 - blending_ratio) * (*image_out)(j, i, d) +
-                 blending_ratio * SampleLinear(image_in, qi(1), qi(0), d);
-            }
-            continue;
-          } else { //only image_in contrib
-            for (int d = 0; d < image_out->Depth(); ++d) 
-              (*image_out)(j, i, d) = SampleLinear(image_in, qi(1), qi(0), d);
-            continue;
-          }
-        }
-      }
+  //-- Black pixels of image_out are overwritten, others are mean blended
+  //   with image_in in the overlap zone.
+  WarpBoundingBox(image_in, H.inverse(), bbox, true, blending_ratio,
+                  num_threads, image_out);
+}
+
+void WarpImageBlend(const FloatImage &image_in,
+                    const Mat3 &H,
+                    const Vec4i &bbox,
+                    FloatImage *image_out,
+                    float blending_ratio,
+                    int num_threads) {
+  assert(image_out != NULL);
+  assert(image_in.Depth() == image_out->Depth());
+  WarpBoundingBox(image_in, H.inverse(), bbox, true, blending_ratio,
+                  num_threads, image_out);
 }
 } // namespace libmv 
@@ -107,6 +107,9 @@ void RotateImage(const FloatImage &image_in,
  * \param image_out The output image that will contains the warpped input image
  * \param adapt_img_size The output image will be resized to contain all 
  *                       the rotated input image
+ * \param num_threads Threads warping the rows of the output image
+ *
+ * Only the pixels of the bounding box of the warp are touched.
  *
  * \note image_out SHOULD NOT be the image_in! (no local copy)
  *                 use XXX instead (TODO(julien) make a WarpImageMe function
@@ -114,7 +117,8 @@ void RotateImage(const FloatImage &image_in,
 void WarpImage(const FloatImage &image_in,
                const Mat3 &H,
                FloatImage *image_out,
-               bool adapt_img_size = false);
+               bool adapt_img_size = false,
+               int num_threads = 1);
 
 /**
  * Warps an input image and blend it with the content of the output image.
@@ -126,6 +130,7 @@ void WarpImage(const FloatImage &image_in,
  * \param image_out The output image that will contains the warpped input image
  * \param blending_ratio The blending ratio for overlapping zones, 
  *                       a typical value is 0.5
+ * \param num_threads Threads warping the rows of the output image
  *
  * \note image_out SHOULD NOT be the image_in! (no local copy)
  * \note image_out is not resized.
@@ -134,5 +139,18 @@ void WarpImage(const FloatImage &image_in,
 void WarpImageBlend(const FloatImage &image_in,
                     const Mat3 &H,
                     FloatImage *image_out,
-                    float blending_ratio = 0.5);
+                    float blending_ratio = 0.5,
+                    int num_threads = 1);
+
+/**
+ * Same as WarpImageBlend() above, but only the pixels of image_out in bbox
+ * (xmin, xmax, ymin, ymax) are touched instead of the ones in the bounding box
+ * of the warp. This lets a part of a larger output be warped on its own.
+ */
+void WarpImageBlend(const FloatImage &image_in,
+                    const Mat3 &H,
+                    const Vec4i &bbox,
+                    FloatImage *image_out,
+                    float blending_ratio = 0.5,
+                    int num_threads = 1);
 } // namespace libmv 
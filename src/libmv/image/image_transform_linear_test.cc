@@ -24,6 +24,7 @@
 #include "libmv/image/image_drawing.h"
 #include "libmv/image/image_io.h"
 #include "libmv/image/image_transform_linear.h"
+#include "libmv/image/sample.h"
 #include "libmv/logging/logging.h"
 #include "testing/testing.h"
 
@@ -34,10 +35,113 @@ using namespace libmv;
  * 
  * - ComputeBoundingBox TODO(julien) Add a unit test
  * - RotateImage        TODO(julien) Correct bug that fails the unit test
- * - WarpImage          TODO(julien) Add a unit test
- * - WarpImageBlend     TODO(julien) Add a unit test
+ * - WarpImage          Compared against a per pixel reference
+ * - WarpImageBlend     Compared against a per pixel reference
  */
 
+namespace {
+
+// The per pixel warp, as WarpImage() and WarpImageBlend() used to be.
+void ReferenceWarp(const FloatImage &image_in, const Mat3 &H, bool blend,
+                   float blending_ratio, FloatImage *image_out) {
+  Vec4i bbox;
+  Vec2u image_size;
+  image_size << image_in.Width(), image_in.Height();
+  ComputeBoundingBox(image_size, H, &bbox);
+  const Mat3 Hinv = H.inverse();
+  for (int j = bbox(2); j <= bbox(3); ++j) {
+    for (int i = bbox(0); i <= bbox(1); ++i) {
+      if (!image_out->Contains(j, i)) {
+        continue;
+      }
+      Vec3 qm, qi;
+      qm << i, j, 1.0;
+      qi = Hinv * qm;
+      qi /= qi(2);
+      if (!image_in.Contains(static_cast<int>(qi(1)),
+                             static_cast<int>(qi(0)))) {
+        continue;
+      }
+      bool out_contributes = false;
+      for (int d = 0; blend && d < image_out->Depth(); ++d) {
+        out_contributes |= (*image_out)(j, i, d) > 0;
+      }
+      for (int d = 0; d < image_out->Depth(); ++d) {
+        float sample = SampleLinear(image_in, qi(1), qi(0), d);
+        if (out_contributes) {
+          (*image_out)(j, i, d) = (1 - blending_ratio) * (*image_out)(j, i, d)
+                                  + blending_ratio * sample;
+        } else {
+          (*image_out)(j, i, d) = sample;
+        }
+      }
+    }
+  }
+}
+
+void MakeWarpTestImage(int depth, FloatImage *image) {
+  image->Resize(37, 53, depth);
+  for (int i = 0; i < image->Height(); ++i) {
+    for (int j = 0; j < image->Width(); ++j) {
+      for (int d = 0; d < depth; ++d) {
+        (*image)(i, j, d) = 0.5 + 0.4 * sin(0.3 * i + 0.17 * j + d);
+      }
+    }
+  }
+}
+
+TEST(ImageTransform, WarpImageMatchesReference) {
+  Mat3 H;
+  H << 0.9,  0.2,  3.5,
+      -0.15, 1.05, -2.25,
+       1e-3, -5e-4, 1;
+  for (int depth = 1; depth <= 3; depth += 2) {
+    FloatImage image;
+    MakeWarpTestImage(depth, &image);
+    for (int num_threads = 1; num_threads <= 3; num_threads += 2) {
+      FloatImage expected(41, 47, depth), warped(41, 47, depth);
+      expected.Fill(0);
+      warped.Fill(0);
+      ReferenceWarp(image, H, false, 0, &expected);
+      WarpImage(image, H, &warped, false, num_threads);
+      for (int i = 0; i < expected.Size(); ++i) {
+        EXPECT_NEAR(expected.Data()[i], warped.Data()[i], 1e-5) << i;
+      }
+    }
+  }
+}
+
+TEST(ImageTransform, WarpImageBlendMatchesReference) {
+  Mat3 H;
+  H << 1.1, -0.1,  -4,
+       0.05, 0.95,  6,
+       0,    0,     1;
+  for (int depth = 1; depth <= 3; depth += 2) {
+    FloatImage image;
+    MakeWarpTestImage(depth, &image);
+    // Half of the mosaic is black, the other half is blended.
+    FloatImage mosaic(40, 60, depth);
+    mosaic.Fill(0);
+    for (int i = 0; i < 40; ++i) {
+      for (int j = 0; j < 30; ++j) {
+        for (int d = 0; d < depth; ++d) {
+          mosaic(i, j, d) = 0.25;
+        }
+      }
+    }
+    FloatImage expected, warped;
+    expected.CopyFrom(mosaic);
+    warped.CopyFrom(mosaic);
+    ReferenceWarp(image, H, true, 0.3, &expected);
+    WarpImageBlend(image, H, &warped, 0.3, 2);
+    for (int i = 0; i < expected.Size(); ++i) {
+      EXPECT_NEAR(expected.Data()[i], warped.Data()[i], 1e-5) << i;
+    }
+  }
+}
+
+}  // namespace
+
 // Assert that pixels was drawn at the good place
 TEST(ImageTransform, RotateImage90) {
 
@@ -0,0 +1,116 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "libmv/image/integral_image.h"
+
+namespace libmv {
+namespace {
+
+// Number of rows of the integral image computed before being transposed into
+// the column major output; every column then receives contiguous writes.
+const int kBlockRows = 16;
+
+// column_sums[c] += row[c * depth] for c in [0, cols).
+void AccumulateRow(const unsigned char *row, int cols, int depth,
+                   unsigned int *column_sums) {
+  int c = 0;
+#ifdef __SSE2__
+  if (depth == 1) {
+    const __m128i zero = _mm_setzero_si128();
+    for (; c + 16 <= cols; c += 16) {
+      __m128i pixels = _mm_loadu_si128((const __m128i *)(row + c));
+      __m128i low = _mm_unpacklo_epi8(pixels, zero);
+      __m128i high = _mm_unpackhi_epi8(pixels, zero);
+      __m128i *sums = (__m128i *)(column_sums + c);
+      _mm_storeu_si128(sums + 0, _mm_add_epi32(_mm_loadu_si128(sums + 0),
+                                               _mm_unpacklo_epi16(low, zero)));
+      _mm_storeu_si128(sums + 1, _mm_add_epi32(_mm_loadu_si128(sums + 1),
+                                               _mm_unpackhi_epi16(low, zero)));
+      _mm_storeu_si128(sums + 2, _mm_add_epi32(_mm_loadu_si128(sums + 2),
+                                               _mm_unpacklo_epi16(high, zero)));
+      _mm_storeu_si128(sums + 3, _mm_add_epi32(_mm_loadu_si128(sums + 3),
+                                               _mm_unpackhi_epi16(high, zero)));
+    }
+  }
+#endif
+  for (; c < cols; ++c) {
+    column_sums[c] += row[c * depth];
+  }
+}
+
+// out[c] = column_sums[0] + ... + column_sums[c].
+void PrefixSum(const unsigned int *column_sums, int cols, unsigned int *out) {
+  int c = 0;
+  unsigned int sum = 0;
+#ifdef __SSE2__
+  __m128i carry = _mm_setzero_si128();
+  for (; c + 4 <= cols; c += 4) {
+    __m128i x = _mm_loadu_si128((const __m128i *)(column_sums + c));
+    x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+    x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+    x = _mm_add_epi32(x, carry);
+    _mm_storeu_si128((__m128i *)(out + c), x);
+    carry = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+  }
+  sum = _mm_cvtsi128_si32(carry);
+#endif
+  for (; c < cols; ++c) {
+    sum += column_sums[c];
+    out[c] = sum;
+  }
+}
+
+}  // namespace
+
+void IntegralImage(const Array3Du &image, Matu *integral_image) {
+  int rows = image.Height();
+  int cols = image.Width();
+  int depth = image.Depth();
+  integral_image->resize(rows, cols);
+  if (rows == 0 || cols == 0) {
+    return;
+  }
+
+  std::vector<unsigned int> column_sums(cols, 0);
+  std::vector<unsigned int> block(kBlockRows * cols);
+  for (int r0 = 0; r0 < rows; r0 += kBlockRows) {
+    int num_rows = std::min(kBlockRows, rows - r0);
+    for (int i = 0; i < num_rows; ++i) {
+      AccumulateRow(image.Data() + (r0 + i) * cols * depth, cols, depth,
+                    &column_sums[0]);
+      PrefixSum(&column_sums[0], cols, &block[i * cols]);
+    }
+    unsigned int *out = integral_image->data() + r0;
+    for (int c = 0; c < cols; ++c, out += rows) {
+      for (int i = 0; i < num_rows; ++i) {
+        out[i] = block[i * cols + c];
+      }
+    }
+  }
+}
+
+}  // namespace libmv
@@ -23,6 +23,7 @@
 
 #include "libmv/image/array_nd.h"
 #include "libmv/logging/logging.h"
+#include "libmv/numeric/numeric.h"
 
 namespace libmv {
 
@@ -49,6 +50,13 @@ inline void IntegralImage(const TImage &image, TIntegralImage *integral_image) {
   }
 }
 
+// Same as above for the first channel of a byte image, which is how the SURF
+// detector and describers build their integral images. The column sums are
+// accumulated and the rows prefix summed with SSE2 when available, and the
+// result is written to the column major Matu by blocks of rows. The result is
+// identical to the generic version.
+void IntegralImage(const Array3Du &image, Matu *integral_image);
+
 // The sum of the pixels in an area bounded by row, column, width, and height.
 // If the bounding box exceeds the image, then the partial sum is returned (or
 // zero if the box completely misses the image).
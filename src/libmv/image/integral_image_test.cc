@@ -63,4 +63,26 @@ TEST(BoxIntegral, ThreeByThree) {
   EXPECT_EQ(0,  BoxIntegral(integral_image, 7, 0, 2, 9));
 }
 
+TEST(IntegralImage, ByteImageMatchesGenericVersion) {
+  // Sizes that are not multiples of the SIMD widths nor of the row blocks.
+  Array3Du image(37, 45);
+  unsigned seed = 1;
+  for (int r = 0; r < image.Height(); ++r) {
+    for (int c = 0; c < image.Width(); ++c) {
+      seed = seed * 1103515245u + 12345u;
+      image(r, c) = (seed >> 16) & 0xff;
+    }
+  }
+  Matu expected, integral_image;
+  IntegralImage<Array3Du, Matu>(image, &expected);
+  IntegralImage(image, &integral_image);
+  ASSERT_EQ(expected.rows(), integral_image.rows());
+  ASSERT_EQ(expected.cols(), integral_image.cols());
+  for (int r = 0; r < expected.rows(); ++r) {
+    for (int c = 0; c < expected.cols(); ++c) {
+      EXPECT_EQ(expected(r, c), integral_image(r, c));
+    }
+  }
+}
+
 }  // namespace
@@ -21,16 +21,29 @@
 // A simple LRU cache. It uses a fair amount of space per-item, so do not use
 // this to store many small items. Instead, use this for heavy-weight objects
 // like images.
+//
+// Items are found by the hash of their keys, and the unpinned items are
+// ordered by an eviction policy (see below) which picks the one to evict:
+// the least recently unpinned by default, as the name says.
+//
+// With SetMemoryCategory(), the sizes are bytes of memory that are accounted in
+// a category of libmv/base/memory_budget.h, and unpinned items are evicted
+// whenever the accounted memory exceeds the budget. The cache is not thread
+// safe, so it only evicts during its own calls.
 
 #ifndef LIBMV_IMAGE_LRU_CACHE_H_
 #define LIBMV_IMAGE_LRU_CACHE_H_
 
 #include <map>
 #include <list>
+#include <vector>
 #include <cassert>
 #include <cstdio>
 
+#include "libmv/base/memory_budget.h"
+#include "libmv/base/scoped_ptr.h"
 #include "libmv/image/cache.h"
+#include "libmv/logging/logging.h"
 
 using std::map;
 using std::list;
@@ -88,140 +101,455 @@ class SetQueue {
   Map queue_positions_;
 };
 
+// Eviction policies of LRUCache. A policy keeps the unpinned items, whose
+// bookkeeping is its Entry, embedded in the items, and has:
+//
+//   // The entry is no longer pinned, after being used. cost is the hint
+//   // given to StoreAndPinSized().
+//   void Unpinned(Entry *entry, long long size, double cost);
+//   // The unpinned entry is pinned again.
+//   void Pinned(Entry *entry);
+//   // Removes and returns the unpinned entry to evict, NULL if there is none.
+//   Entry *Evict();
+
+// Evicts the least recently unpinned item. O(1).
+class LeastRecentlyUnpinned {
+ public:
+  struct Entry {
+    Entry *newer, *older;
+    Entry() : newer(NULL), older(NULL) {}
+  };
+
+  LeastRecentlyUnpinned() : newest_(NULL), oldest_(NULL) {}
+
+  void Unpinned(Entry *entry, long long size, double cost) {
+    entry->older = newest_;
+    entry->newer = NULL;
+    if (newest_) {
+      newest_->newer = entry;
+    } else {
+      oldest_ = entry;
+    }
+    newest_ = entry;
+  }
+  void Pinned(Entry *entry) {
+    if (entry->newer) {
+      entry->newer->older = entry->older;
+    } else {
+      newest_ = entry->older;
+    }
+    if (entry->older) {
+      entry->older->newer = entry->newer;
+    } else {
+      oldest_ = entry->newer;
+    }
+    entry->newer = entry->older = NULL;
+  }
+  Entry *Evict() {
+    Entry *entry = oldest_;
+    if (entry) {
+      Pinned(entry);
+    }
+    return entry;
+  }
+
+ private:
+  Entry *newest_;
+  Entry *oldest_;
+};
+
+// CLOCK: the items stay on a ring once unpinned, and pinning one again only
+// marks it referenced, without moving it. The hand sweeps the ring, sparing
+// the referenced items once and skipping the pinned ones. An item used once
+// is evicted before the items used again since they were unpinned. O(1)
+// amortized, as long as few of the items on the ring are pinned.
+class Clock {
+ public:
+  struct Entry {
+    Entry *next, *previous;
+    bool referenced;
+    bool unpinned;
+    Entry() : next(NULL), previous(NULL), referenced(false), unpinned(false) {}
+  };
+
+  Clock() : hand_(NULL), num_unpinned_(0) {}
+
+  void Unpinned(Entry *entry, long long size, double cost) {
+    if (!entry->next) {
+      // Behind the hand, so that the sweep reaches it last.
+      if (hand_) {
+        entry->next = hand_;
+        entry->previous = hand_->previous;
+        hand_->previous->next = entry;
+        hand_->previous = entry;
+      } else {
+        entry->next = entry->previous = entry;
+        hand_ = entry;
+      }
+    }
+    entry->unpinned = true;
+    ++num_unpinned_;
+  }
+  void Pinned(Entry *entry) {
+    entry->unpinned = false;
+    entry->referenced = true;
+    --num_unpinned_;
+  }
+  Entry *Evict() {
+    if (num_unpinned_ == 0) {
+      return NULL;
+    }
+    for (;;) {
+      Entry *entry = hand_;
+      hand_ = hand_->next;
+      if (!entry->unpinned) {
+        continue;
+      }
+      if (entry->referenced) {
+        entry->referenced = false;
+        continue;
+      }
+      Remove(entry);
+      --num_unpinned_;
+      return entry;
+    }
+  }
+
+ private:
+  void Remove(Entry *entry) {
+    if (entry->next == entry) {
+      hand_ = NULL;
+    } else {
+      entry->previous->next = entry->next;
+      entry->next->previous = entry->previous;
+      if (hand_ == entry) {
+        hand_ = entry->next;
+      }
+    }
+    entry->next = entry->previous = NULL;
+  }
+
+  Entry *hand_;
+  int num_unpinned_;
+};
+
+// GreedyDual-Size: an unpinned item is worth L + cost / size, and the item of
+// least worth is evicted, raising L to its worth. Items which are expensive
+// to recompute for their size are kept longer, and the others age as L grows.
+// With the default cost, proportional to the size, this is the least
+// recently unpinned order. O(log n).
+class GreedyDual {
+ public:
+  struct Entry {
+    double worth;
+    unsigned long tick;
+    int heap_index;
+    Entry() : worth(0), tick(0), heap_index(-1) {}
+  };
+
+  GreedyDual() : inflation_(0), tick_(0) {}
+
+  void Unpinned(Entry *entry, long long size, double cost) {
+    if (size < 1) {
+      size = 1;
+    }
+    entry->worth = inflation_ + (cost > 0 ? cost / size : 1.0);
+    entry->tick = ++tick_;
+    entry->heap_index = heap_.size();
+    heap_.push_back(entry);
+    SiftUp(entry->heap_index);
+  }
+  void Pinned(Entry *entry) {
+    int i = entry->heap_index;
+    assert(0 <= i && i < int(heap_.size()) && heap_[i] == entry);
+    Entry *last = heap_.back();
+    heap_.pop_back();
+    entry->heap_index = -1;
+    if (last != entry) {
+      heap_[i] = last;
+      last->heap_index = i;
+      SiftDown(SiftUp(i));
+    }
+  }
+  Entry *Evict() {
+    if (heap_.empty()) {
+      return NULL;
+    }
+    Entry *entry = heap_[0];
+    inflation_ = entry->worth;
+    Pinned(entry);
+    return entry;
+  }
+
+ private:
+  // Least worth first, then least recently unpinned.
+  static bool Before(const Entry *a, const Entry *b) {
+    if (a->worth != b->worth) {
+      return a->worth < b->worth;
+    }
+    return a->tick < b->tick;
+  }
+  void Place(int i, Entry *entry) {
+    heap_[i] = entry;
+    entry->heap_index = i;
+  }
+  int SiftUp(int i) {
+    Entry *entry = heap_[i];
+    while (i > 0 && Before(entry, heap_[(i - 1) / 2])) {
+      Place(i, heap_[(i - 1) / 2]);
+      i = (i - 1) / 2;
+    }
+    Place(i, entry);
+    return i;
+  }
+  void SiftDown(int i) {
+    Entry *entry = heap_[i];
+    int n = heap_.size();
+    for (;;) {
+      int child = 2 * i + 1;
+      if (child >= n) {
+        break;
+      }
+      if (child + 1 < n && Before(heap_[child + 1], heap_[child])) {
+        ++child;
+      }
+      if (!Before(heap_[child], entry)) {
+        break;
+      }
+      Place(i, heap_[child]);
+      i = child;
+    }
+    Place(i, entry);
+  }
+
+  std::vector<Entry *> heap_;
+  double inflation_;
+  unsigned long tick_;
+};
+
 }  // namespace lru_cache
 
 template<typename K, typename V> class Cache;
 
-template<typename K, typename V>
+template<typename K, typename V,
+         typename Policy = lru_cache::LeastRecentlyUnpinned,
+         typename H = cache::Hash<K> >
 class LRUCache : public Cache<K, V> {
  public:
   // O(1)
-  LRUCache(int max_size)
-    : max_size_(max_size),
-      size_(0) {}
-  // O(n log n)
+  LRUCache(long long max_size)
+    : num_items_(0),
+      max_size_(max_size),
+      size_(0),
+      memory_(NULL) {}
+  // O(1), plus the evictions.
   void Pin(const K &key) {
-    assert(ContainsKey(key));
-    CachedItem *item = &(items_[key]);
-    if (Pin(key, item))
+    CachedItem *item = Find(key);
+    assert(item);
+    if (Pin(item))
       DeleteUnpinnedItemsIfNecessary();
   }
-  // O(n log n)
+  // O(1), plus the evictions.
   virtual void Unpin(const K &key) {
-    assert(ContainsKey(key));
-    CachedItem *item = &(items_[key]);
-    if (Unpin(key, item))
+    CachedItem *item = Find(key);
+    assert(item);
+    if (Unpin(item))
       DeleteUnpinnedItemsIfNecessary();
   }
-  // O(n log n)
+  // O(n)
   virtual void MassUnpin() {
     bool possible_delete_needed = false;
-    for (typename CacheMap::iterator it = items_.begin();
-        it != items_.end(); ++it) {
-      possible_delete_needed |= Unpin(it->first, &it->second);
+    for (size_t b = 0; b < buckets_.size(); ++b) {
+      for (CachedItem *item = buckets_[b]; item; item = item->next_in_bucket) {
+        possible_delete_needed |= Unpin(item);
+      }
     }
     if (possible_delete_needed)
       DeleteUnpinnedItemsIfNecessary();
   }
-  // O(n log n)
+  // O(1)
   virtual bool FetchAndPin(const K &key, V **value) {
-    if (!ContainsKey(key)) {
+    CachedItem *item = Find(key);
+    if (!item) {
+      LIBMV_COUNTER("cache.misses", 1);
       return false;
     } 
-    Pin(key);
-    *value = items_[key].ptr;
+    LIBMV_COUNTER("cache.hits", 1);
+    Pin(item);
+    *value = item->ptr;
     return true;
   }
-  // O(n log n)
-  virtual void StoreAndPinSized(const K &key, V *value, const int size) {
-    size_ += size;
-    CachedItem new_item;
-    new_item.ptr = value;
-    new_item.use_count = 1;
-    new_item.size = size;
-    items_[key] = new_item;
+  // O(1), plus the evictions. The key must not be in the cache already.
+  virtual void StoreAndPinSized(const K &key, V *value, const long long size,
+                                const double cost = 0) {
+    assert(!ContainsKey(key));
+    AddSize(size);
+    CachedItem *item = new CachedItem;
+    item->key = key;
+    item->hash = hash_(key);
+    item->ptr = value;
+    item->use_count = 1;
+    item->size = size;
+    item->cost = cost;
+    Insert(item);
     DeleteUnpinnedItemsIfNecessary();
+    if (memory_.get()) {
+      ReclaimMemoryOverBudget();
+    }
   }
   // O(1)
   virtual bool ContainsKey(const K &key) {
-    return items_.find(key) != items_.end();
+    return Find(key) != NULL;
   }
   // O(1)
-  virtual int MaxSize() const {
+  virtual long long MaxSize() const {
     return max_size_;
   }
   // O(1)
-  virtual int Size() const {
+  virtual long long Size() const {
     return size_;
   }
-  // O(n log n)
-  virtual void SetMaxSize(const int max_size) {
+  // O(1), plus the evictions.
+  virtual void SetMaxSize(const long long max_size) {
     max_size_ = max_size;
     DeleteUnpinnedItemsIfNecessary();
   }
+  // O(1), plus the evictions.
+  void SetMemoryCategory(MemoryCategory category) {
+    memory_.reset(new MemoryUsage(category, size_));
+    DeleteUnpinnedItemsIfNecessary();
+  }
   // O(n)
   virtual ~LRUCache() {
-    typename CacheMap::iterator it;
-    for (it = items_.begin(); it != items_.end(); ++it)
-      delete it->second.ptr;
+    for (size_t b = 0; b < buckets_.size(); ++b) {
+      CachedItem *item = buckets_[b];
+      while (item) {
+        CachedItem *next = item->next_in_bucket;
+        delete item->ptr;
+        delete item;
+        item = next;
+      }
+    }
   }
 
  private:
-  // O(n log n)
+  struct CachedItem : public Policy::Entry {
+    K key;
+    size_t hash;
+    V *ptr;
+    int use_count;
+    long long size;
+    double cost;
+    CachedItem *next_in_bucket;
+    CachedItem()
+      : ptr(NULL), use_count(0), size(0), cost(0), next_in_bucket(NULL) {}
+  };
+
+  // O(1) per eviction.
   void DeleteUnpinnedItemsIfNecessary() {
-    while (!unpinned_items_.Empty() &&
-           size_ > max_size_) {
-      K key_to_remove;
-      unpinned_items_.Dequeue(&key_to_remove);
-      typename CacheMap::iterator it = items_.find(key_to_remove);
-      assert(it != items_.end());
-      CachedItem *item = &it->second;
+    while (size_ > max_size_ || (memory_.get() && MemoryOverBudget() > 0)) {
+      typename Policy::Entry *entry = policy_.Evict();
+      if (!entry) {
+        return;
+      }
+      CachedItem *item = static_cast<CachedItem *>(entry);
+      Erase(item);
       delete item->ptr;
-      size_ -= item->size;
-      items_.erase(it);
+      AddSize(-item->size);
+      delete item;
     }
   }
-  
-  struct CachedItem {
-    V *ptr;
-    int use_count;
-    int size;
-    CachedItem() : ptr(NULL) {}
-  };
-  // O(log n)
-  bool Pin(const K &key, CachedItem *item) {
-    assert(ContainsKey(key));
+
+  void AddSize(long long size) {
+    size_ += size;
+    if (memory_.get()) {
+      memory_->Set(size_);
+    }
+  }
+
+  // Returns whether the item was unpinned, and hence removed from the
+  // policy.
+  bool Pin(CachedItem *item) {
     bool res = false;
     if (item->use_count == 0) {
-      unpinned_items_.Remove(key);
+      policy_.Pinned(item);
       res = true;
     }
     item->use_count++;
     return res;
   }
-  // O(log n)
-  // Using this function prevents the need to do a lookup for the CachedItem
-  // (when not debugging). It returns whether the item was entirely unpinned
-  // and hence whether DeleteUnpinnedItemsIfNecessary() should be called.
-  bool Unpin(const K &key, CachedItem *item) {
-    assert(ContainsKey(key));
+  // Returns whether the item was entirely unpinned and hence whether
+  // DeleteUnpinnedItemsIfNecessary() should be called.
+  bool Unpin(CachedItem *item) {
     assert(item->use_count > 0);
-    assert(item == &(items_[key]));
     bool res = false;
     if (item->use_count == 1) {
-      unpinned_items_.Enqueue(key);
+      policy_.Unpinned(item, item->size, item->cost);
       res = true;
     }
     item->use_count--;
     return res;
   }
-  
-  lru_cache::SetQueue<K> unpinned_items_;
-  typedef map<const K, CachedItem> CacheMap;
-  CacheMap items_;
 
-  int max_size_;
-  int size_;
+  // A hash table with chaining, as in the shards of ShardedLRUCache.
+  CachedItem *Find(const K &key) const {
+    if (buckets_.empty()) {
+      return NULL;
+    }
+    size_t hash = hash_(key);
+    CachedItem *item = buckets_[hash % buckets_.size()];
+    for (; item; item = item->next_in_bucket) {
+      if (item->hash == hash && item->key == key) {
+        return item;
+      }
+    }
+    return NULL;
+  }
+  void Insert(CachedItem *item) {
+    if (num_items_ >= buckets_.size()) {
+      Rehash(2 * buckets_.size() + 8);
+    }
+    size_t b = item->hash % buckets_.size();
+    item->next_in_bucket = buckets_[b];
+    buckets_[b] = item;
+    ++num_items_;
+  }
+  void Erase(CachedItem *item) {
+    CachedItem **link = &buckets_[item->hash % buckets_.size()];
+    while (*link != item) {
+      link = &(*link)->next_in_bucket;
+    }
+    *link = item->next_in_bucket;
+    --num_items_;
+  }
+  void Rehash(size_t num_buckets) {
+    std::vector<CachedItem *> old_buckets(num_buckets, NULL);
+    old_buckets.swap(buckets_);
+    for (size_t b = 0; b < old_buckets.size(); ++b) {
+      CachedItem *item = old_buckets[b];
+      while (item) {
+        CachedItem *next = item->next_in_bucket;
+        size_t nb = item->hash % buckets_.size();
+        item->next_in_bucket = buckets_[nb];
+        buckets_[nb] = item;
+        item = next;
+      }
+    }
+  }
+
+  // No copying allowed.
+  LRUCache(const LRUCache &);
+  LRUCache &operator=(const LRUCache &);
+
+  H hash_;
+  std::vector<CachedItem *> buckets_;
+  size_t num_items_;
+  Policy policy_;
+
+  long long max_size_;
+  long long size_;
+  // The accounting of size_, if it is in bytes.
+  scoped_ptr<MemoryUsage> memory_;
 };
 
 }  // namespace libmv
@@ -18,6 +18,9 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <utility>
+
+#include "libmv/base/memory_budget.h"
 #include "libmv/image/lru_cache.h"
 #include "testing/testing.h"
 
@@ -201,4 +204,136 @@ TEST(LRUCache, SizeDecreaseWhenMaxSizeChanged) {
   EXPECT_EQ(cache.Size(), 1);
 }
 
+TEST(LRUCache, AccountsAndEvictsUnderTheMemoryBudget) {
+  using namespace libmv;
+  long long frames = MemoryInUse(MEMORY_FRAMES);
+  TestCache cache(1000);
+  cache.SetMemoryCategory(MEMORY_FRAMES);
+  cache.StoreAndPinSized(4, new int(40), 100);
+  cache.StoreAndPinSized(5, new int(50), 100);
+  EXPECT_EQ(frames + 200, MemoryInUse(MEMORY_FRAMES));
+
+  // The pinned items stay, the unpinned ones go to meet the budget.
+  SetMemoryBudget(TotalMemoryInUse() + 50);
+  cache.Unpin(4);
+  cache.StoreAndPinSized(6, new int(60), 100);
+  EXPECT_FALSE(cache.ContainsKey(4));
+  EXPECT_TRUE(cache.ContainsKey(5));
+  EXPECT_TRUE(cache.ContainsKey(6));
+  EXPECT_EQ(frames + 200, MemoryInUse(MEMORY_FRAMES));
+  SetMemoryBudget(0);
+}
+
+TEST(LRUCache, SizesBeyondTwoGigabytes) {
+  const long long kGigabyte = 1LL << 30;
+  TestCache cache(4 * kGigabyte);
+  cache.StoreAndPinSized(1, new int(10), 3 * kGigabyte);
+  cache.StoreAndPinSized(2, new int(20), 3 * kGigabyte);
+  EXPECT_EQ(6 * kGigabyte, cache.Size());
+  EXPECT_EQ(4 * kGigabyte, cache.MaxSize());
+  cache.Unpin(1);
+  EXPECT_EQ(3 * kGigabyte, cache.Size());
+  EXPECT_FALSE(cache.ContainsKey(1));
+}
+
+TEST(LRUCache, HashedKeys) {
+  typedef std::pair<void *, int> Key;
+  libmv::LRUCache<Key, int> cache(1000);
+  int tags[2];
+  for (int i = 0; i < 100; ++i) {
+    cache.StoreAndPin(Key(&tags[i % 2], i), new int(i));
+  }
+  cache.MassUnpin();
+  EXPECT_EQ(100, cache.Size());
+  for (int i = 0; i < 100; ++i) {
+    int *value = NULL;
+    ASSERT_TRUE(cache.FetchAndPin(Key(&tags[i % 2], i), &value));
+    EXPECT_EQ(i, *value);
+    EXPECT_FALSE(cache.ContainsKey(Key(&tags[(i + 1) % 2], i)));
+    cache.Unpin(Key(&tags[i % 2], i));
+  }
+}
+
+// Stores keys 0 to n - 1 unpinned, in order.
+template<typename Cache>
+void StoreUnpinned(int n, Cache *cache) {
+  for (int i = 0; i < n; ++i) {
+    cache->StoreAndPin(i, new int(i));
+    cache->Unpin(i);
+  }
+}
+
+template<typename Cache>
+void FetchAndUnpin(int key, Cache *cache) {
+  int *value;
+  ASSERT_TRUE(cache->FetchAndPin(key, &value));
+  cache->Unpin(key);
+}
+
+TEST(LRUCache, EvictsTheLeastRecentlyUnpinned) {
+  TestCache cache(3);
+  StoreUnpinned(3, &cache);
+  FetchAndUnpin(0, &cache);
+  cache.StoreAndPin(3, new int(3));
+  EXPECT_FALSE(cache.ContainsKey(1));
+  cache.StoreAndPin(4, new int(4));
+  EXPECT_FALSE(cache.ContainsKey(2));
+  EXPECT_TRUE(cache.ContainsKey(0));
+}
+
+TEST(LRUCache, ClockSparesTheItemsUsedAgain) {
+  libmv::LRUCache<int, int, libmv::lru_cache::Clock> cache(3);
+  StoreUnpinned(3, &cache);
+  FetchAndUnpin(0, &cache);
+  FetchAndUnpin(1, &cache);
+  cache.StoreAndPin(3, new int(3));
+  EXPECT_FALSE(cache.ContainsKey(2));
+  EXPECT_EQ(3, cache.Size());
+
+  // The pinned items are skipped; 0 and 1 lost their second chance.
+  int *value;
+  ASSERT_TRUE(cache.FetchAndPin(0, &value));
+  cache.StoreAndPin(4, new int(4));
+  EXPECT_TRUE(cache.ContainsKey(0));
+  EXPECT_FALSE(cache.ContainsKey(1));
+  cache.Unpin(3);
+  cache.Unpin(4);
+  cache.Unpin(0);
+  cache.SetMaxSize(0);
+  EXPECT_EQ(0, cache.Size());
+}
+
+TEST(LRUCache, GreedyDualKeepsTheCostlyItems) {
+  typedef libmv::LRUCache<int, int, libmv::lru_cache::GreedyDual> GDCache;
+  GDCache cache(3);
+  cache.StoreAndPinSized(0, new int(0), 1, 100);
+  cache.StoreAndPinSized(1, new int(1), 1, 1);
+  cache.StoreAndPinSized(2, new int(2), 1, 1);
+  cache.MassUnpin();
+  for (int i = 3; i < 20; ++i) {
+    cache.StoreAndPinSized(i, new int(i), 1, 1);
+    cache.Unpin(i);
+    EXPECT_TRUE(cache.ContainsKey(0));
+    EXPECT_EQ(3, cache.Size());
+  }
+  // The cheap items came and went, aging the costly one: it goes once
+  // enough of them did.
+  for (int i = 20; i < 400; ++i) {
+    cache.StoreAndPinSized(i, new int(i), 1, 1);
+    cache.Unpin(i);
+  }
+  EXPECT_FALSE(cache.ContainsKey(0));
+}
+
+TEST(LRUCache, GreedyDualDefaultsToTheLeastRecentlyUnpinned) {
+  libmv::LRUCache<int, int, libmv::lru_cache::GreedyDual> cache(3);
+  StoreUnpinned(3, &cache);
+  FetchAndUnpin(0, &cache);
+  cache.StoreAndPin(3, new int(3));
+  EXPECT_FALSE(cache.ContainsKey(1));
+  cache.StoreAndPin(4, new int(4));
+  EXPECT_FALSE(cache.ContainsKey(2));
+  EXPECT_TRUE(cache.ContainsKey(0));
+}
+
 }  // namespace
@@ -0,0 +1,169 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <vector>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "libmv/image/mapped_pnm.h"
+#include "libmv/logging/logging.h"
+
+namespace libmv {
+
+bool ParsePnmHeader(const unsigned char *data, size_t size,
+                    int *width, int *height, int *depth, size_t *header_size) {
+  if (size < 2 || data[0] != 'P' || (data[1] != '5' && data[1] != '6')) {
+    return false;
+  }
+  *depth = data[1] == '5' ? 1 : 3;
+
+  // Width, height and maximum value, separated by whitespace, with comments
+  // running from '#' to the end of the line. Exactly one whitespace character
+  // follows the maximum value.
+  int values[3];
+  int num_values = 0;
+  size_t i = 2;
+  while (num_values < 3) {
+    if (i >= size) {
+      return false;
+    }
+    if (isspace(data[i])) {
+      ++i;
+    } else if (data[i] == '#') {
+      while (i < size && data[i] != '\n') {
+        ++i;
+      }
+    } else if (isdigit(data[i])) {
+      int value = 0;
+      while (i < size && isdigit(data[i])) {
+        value = 10 * value + (data[i] - '0');
+        if (value > 65535) {
+          return false;
+        }
+        ++i;
+      }
+      if (i >= size || !isspace(data[i])) {
+        return false;
+      }
+      values[num_values++] = value;
+    } else {
+      return false;
+    }
+  }
+  if (values[2] > 255) {
+    return false;
+  }
+  *width = values[0];
+  *height = values[1];
+  *header_size = i + 1;
+  return true;
+}
+
+MappedPnm::MappedPnm()
+    : mapping_(NULL), mapping_size_(0), pixels_(NULL),
+      height_(0), width_(0), depth_(0) {
+}
+
+MappedPnm::~MappedPnm() {
+  Close();
+}
+
+void MappedPnm::Close() {
+  if (mapping_) {
+#ifdef _WIN32
+    delete static_cast<std::vector<unsigned char> *>(mapping_);
+#else
+    munmap(mapping_, mapping_size_);
+#endif
+  }
+  mapping_ = NULL;
+  mapping_size_ = 0;
+  pixels_ = NULL;
+  height_ = width_ = depth_ = 0;
+}
+
+bool MappedPnm::Open(const char *filename) {
+  Close();
+#ifdef _WIN32
+  FILE *file = fopen(filename, "rb");
+  if (!file) {
+    LOG(ERROR) << "Error: Couldn't open " << filename;
+    return false;
+  }
+  std::vector<unsigned char> *buffer = new std::vector<unsigned char>;
+  unsigned char chunk[65536];
+  size_t read;
+  while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+    buffer->insert(buffer->end(), chunk, chunk + read);
+  }
+  fclose(file);
+  mapping_ = buffer;
+  mapping_size_ = buffer->size();
+  const unsigned char *data = mapping_size_ ? &(*buffer)[0] : NULL;
+#else
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    LOG(ERROR) << "Error: Couldn't open " << filename;
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0 || status.st_size == 0) {
+    close(fd);
+    return false;
+  }
+  mapping_size_ = status.st_size;
+  void *mapping = mmap(NULL, mapping_size_, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping stays valid after the descriptor is closed.
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    LOG(ERROR) << "Error: Couldn't map " << filename;
+    mapping_size_ = 0;
+    return false;
+  }
+  mapping_ = mapping;
+  const unsigned char *data = static_cast<const unsigned char *>(mapping);
+#endif
+
+  int width, height, depth;
+  size_t header_size;
+  if (!ParsePnmHeader(data, mapping_size_, &width, &height, &depth,
+                      &header_size) ||
+      mapping_size_ - header_size <
+          static_cast<size_t>(width) * height * depth) {
+    Close();
+    return false;
+  }
+  pixels_ = data + header_size;
+  width_ = width;
+  height_ = height;
+  depth_ = depth;
+  return true;
+}
+
+}  // namespace libmv
@@ -0,0 +1,77 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_IMAGE_MAPPED_PNM_H
+#define LIBMV_IMAGE_MAPPED_PNM_H
+
+#include <cstddef>
+
+#include "libmv/image/array_nd.h"
+
+namespace libmv {
+
+// A binary PGM or PPM file (P5 or P6, 8 bit samples) mapped into memory. The
+// pixels are read straight from the pages of the file, so opening a frame
+// costs no decoding and no copy; pages are only loaded when touched. The view
+// is valid until the file is closed.
+//
+// Where mmap() is not available the file is read into memory instead.
+class MappedPnm {
+ public:
+  MappedPnm();
+  ~MappedPnm();
+
+  // Returns false if the file cannot be mapped or is not a binary PGM or PPM
+  // with at most 255 levels. Closes any previously opened file.
+  bool Open(const char *filename);
+  void Close();
+
+  bool IsOpen() const {
+    return pixels_ != NULL;
+  }
+
+  // The pixels, laid out like a ByteImage of the same size.
+  ArrayView3D<const unsigned char> View() const {
+    return ArrayView3D<const unsigned char>(pixels_, height_, width_, depth_,
+                                            width_ * depth_, depth_, 1);
+  }
+
+  int Height() const { return height_; }
+  int Width()  const { return width_; }
+  int Depth()  const { return depth_; }
+
+ private:
+  MappedPnm(const MappedPnm &);
+  MappedPnm &operator=(const MappedPnm &);
+
+  void *mapping_;
+  size_t mapping_size_;
+  const unsigned char *pixels_;
+  int height_, width_, depth_;
+};
+
+// Parse the header of a binary PGM or PPM held in memory, with the same rules
+// as ReadPnmStream(). On success, *header_size is the offset of the pixels.
+bool ParsePnmHeader(const unsigned char *data, size_t size,
+                    int *width, int *height, int *depth, size_t *header_size);
+
+}  // namespace libmv
+
+#endif  // LIBMV_IMAGE_MAPPED_PNM_H
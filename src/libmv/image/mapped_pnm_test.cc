@@ -0,0 +1,98 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+
+#include "libmv/image/image_io.h"
+#include "libmv/image/mapped_pnm.h"
+#include "testing/testing.h"
+
+using namespace libmv;
+using std::string;
+
+namespace {
+
+string TmpFile(const char *name) {
+  return string(THIS_SOURCE_DIR) + "/" + name;
+}
+
+TEST(MappedPnm, MatchesReadPnm) {
+  Array3Du image(5, 7, 3);
+  for (int i = 0; i < image.Size(); ++i) {
+    image.Data()[i] = (13 * i) % 256;
+  }
+  string filename = TmpFile("mapped.ppm");
+  EXPECT_TRUE(WritePnm(image, filename.c_str()));
+
+  MappedPnm mapped;
+  ASSERT_TRUE(mapped.Open(filename.c_str()));
+  EXPECT_EQ(5, mapped.Height());
+  EXPECT_EQ(7, mapped.Width());
+  EXPECT_EQ(3, mapped.Depth());
+
+  Array3Du read;
+  EXPECT_TRUE(ReadPnm(filename.c_str(), &read));
+  ArrayView3D<const unsigned char> view = mapped.View();
+  EXPECT_TRUE(view.IsContiguous());
+  Array3Du copy;
+  view.CopyTo(&copy);
+  EXPECT_TRUE(copy == read);
+
+  mapped.Close();
+  EXPECT_FALSE(mapped.IsOpen());
+  unlink(filename.c_str());
+}
+
+TEST(MappedPnm, HeaderWithComments) {
+  const char data[] = "P5\n# a comment\n3 # inside\n2\n255\nabcdef";
+  int width, height, depth;
+  size_t header_size;
+  EXPECT_TRUE(ParsePnmHeader(reinterpret_cast<const unsigned char *>(data),
+                             sizeof(data) - 1, &width, &height, &depth,
+                             &header_size));
+  EXPECT_EQ(3, width);
+  EXPECT_EQ(2, height);
+  EXPECT_EQ(1, depth);
+  EXPECT_EQ('a', data[header_size]);
+}
+
+TEST(MappedPnm, InvalidFiles) {
+  MappedPnm mapped;
+  EXPECT_FALSE(mapped.Open("hopefully_unexisting_file"));
+
+  string filename = TmpFile("mapped_invalid.pgm");
+  const char *contents[] = {
+    "P2\n2 1\n255\n01",  // ASCII.
+    "P5\n2 1\n65535\n0123",  // 16 bit.
+    "P5\n2 2\n255\n012",  // Truncated.
+  };
+  for (int i = 0; i < 3; ++i) {
+    FILE *file = fopen(filename.c_str(), "wb");
+    fputs(contents[i], file);
+    fclose(file);
+    EXPECT_FALSE(mapped.Open(filename.c_str())) << contents[i];
+    EXPECT_FALSE(mapped.IsOpen());
+  }
+  unlink(filename.c_str());
+}
+
+}  // namespace
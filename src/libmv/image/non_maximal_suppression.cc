@@ -0,0 +1,187 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "libmv/image/non_maximal_suppression.h"
+
+namespace libmv {
+namespace {
+
+// dst[i] = max(src[i - r], ..., src[i + r]) for i in [r, n - r).
+void SlidingMax(const float *src, int n, int r, float *dst) {
+  int i = r;
+#ifdef __SSE2__
+  for (; i + 4 <= n - r; i += 4) {
+    __m128 m = _mm_loadu_ps(src + i - r);
+    for (int k = 1; k <= 2 * r; ++k) {
+      m = _mm_max_ps(m, _mm_loadu_ps(src + i - r + k));
+    }
+    _mm_storeu_ps(dst + i, m);
+  }
+#endif
+  for (; i < n - r; ++i) {
+    float m = src[i - r];
+    for (int k = 1; k <= 2 * r; ++k) {
+      m = std::max(m, src[i - r + k]);
+    }
+    dst[i] = m;
+  }
+}
+
+// dst[i] = max(rows[0][i], ..., rows[num_rows - 1][i]) for i in [begin, end).
+void ElementwiseMax(const float *const *rows, int num_rows,
+                    int begin, int end, float *dst) {
+  int i = begin;
+#ifdef __SSE2__
+  for (; i + 4 <= end; i += 4) {
+    __m128 m = _mm_loadu_ps(rows[0] + i);
+    for (int k = 1; k < num_rows; ++k) {
+      m = _mm_max_ps(m, _mm_loadu_ps(rows[k] + i));
+    }
+    _mm_storeu_ps(dst + i, m);
+  }
+#endif
+  for (; i < end; ++i) {
+    float m = rows[0][i];
+    for (int k = 1; k < num_rows; ++k) {
+      m = std::max(m, rows[k][i]);
+    }
+    dst[i] = m;
+  }
+}
+
+// Writes the indices i in [begin, end) where values[i] == maxima[i] and
+// values[i] >= min_value to indices, and returns their number.
+int CompareWithMaxima(const float *values, const float *maxima,
+                      int begin, int end, float min_value, int *indices) {
+  int count = 0;
+  int i = begin;
+#ifdef __SSE2__
+  __m128 threshold = _mm_set1_ps(min_value);
+  for (; i + 4 <= end; i += 4) {
+    __m128 v = _mm_loadu_ps(values + i);
+    __m128 is_max = _mm_and_ps(_mm_cmpeq_ps(v, _mm_loadu_ps(maxima + i)),
+                               _mm_cmpge_ps(v, threshold));
+    int mask = _mm_movemask_ps(is_max);
+    if (mask) {
+      for (int j = 0; j < 4; ++j) {
+        if ((mask >> j) & 1) {
+          indices[count++] = i + j;
+        }
+      }
+    }
+  }
+#endif
+  for (; i < end; ++i) {
+    if (values[i] == maxima[i] && values[i] >= min_value) {
+      indices[count++] = i;
+    }
+  }
+  return count;
+}
+
+}  // namespace
+
+void FindLocalMaximaMaxFilter(const Array3Df &f,
+                              int width,
+                              float min_value,
+                              vector<Vec2i> *maxima) {
+  assert(width % 2 == 1);
+  assert(f.Depth() == 1);
+  const int r = width / 2;
+  const int w = f.Width(), h = f.Height();
+  if (w < width || h < width) {
+    return;
+  }
+
+  // The horizontal maxima of the last width rows, in a ring.
+  std::vector<float> ring(width * w);
+  std::vector<float> column_max(w);
+  std::vector<int> columns(w);
+  std::vector<const float *> rows(width);
+  for (int y = 0; y < 2 * r; ++y) {
+    SlidingMax(f.Data() + y * w, w, r, &ring[(y % width) * w]);
+  }
+  for (int y = r; y < h - r; ++y) {
+    SlidingMax(f.Data() + (y + r) * w, w, r, &ring[((y + r) % width) * w]);
+    for (int k = 0; k < width; ++k) {
+      rows[k] = &ring[((y - r + k) % width) * w];
+    }
+    ElementwiseMax(&rows[0], width, r, w - r, &column_max[0]);
+    int count = CompareWithMaxima(f.Data() + y * w, &column_max[0], r, w - r,
+                                  min_value, &columns[0]);
+    for (int i = 0; i < count; ++i) {
+      maxima->push_back(Vec2i(columns[i], y));
+    }
+  }
+}
+
+void FindLocalMaximaMaxFilter3D(const Array3Df &f,
+                                int width,
+                                float min_value,
+                                vector<Vec3i> *maxima) {
+  assert(width % 2 == 1);
+  const int r = width / 2;
+  const int n0 = f.Shape(0), n1 = f.Shape(1), n2 = f.Shape(2);
+  if (n0 < width || n1 < width || n2 < width) {
+    return;
+  }
+  const float *data = f.Data();
+
+  // Maxima along z, then along y and z, of every (x, y) line.
+  std::vector<float> max_z(n0 * n1 * n2), max_yz(n0 * n1 * n2);
+  for (int line = 0; line < n0 * n1; ++line) {
+    SlidingMax(data + line * n2, n2, r, &max_z[line * n2]);
+  }
+  std::vector<const float *> lines(width);
+  for (int x = 0; x < n0; ++x) {
+    for (int y = r; y < n1 - r; ++y) {
+      for (int k = 0; k < width; ++k) {
+        lines[k] = &max_z[(x * n1 + y - r + k) * n2];
+      }
+      ElementwiseMax(&lines[0], width, r, n2 - r, &max_yz[(x * n1 + y) * n2]);
+    }
+  }
+
+  // Maxima along x, y and z, compared with the values one line at a time.
+  std::vector<float> max_xyz(n2);
+  std::vector<int> zs(n2);
+  for (int x = r; x < n0 - r; ++x) {
+    for (int y = r; y < n1 - r; ++y) {
+      for (int k = 0; k < width; ++k) {
+        lines[k] = &max_yz[((x - r + k) * n1 + y) * n2];
+      }
+      ElementwiseMax(&lines[0], width, r, n2 - r, &max_xyz[0]);
+      int count = CompareWithMaxima(data + (x * n1 + y) * n2, &max_xyz[0],
+                                    r, n2 - r, min_value, &zs[0]);
+      for (int i = 0; i < count; ++i) {
+        maxima->push_back(Vec3i(x, y, zs[i]));
+      }
+    }
+  }
+}
+
+}  // namespace libmv
@@ -24,6 +24,7 @@
 #include <cmath>
 
 #include "libmv/base/vector.h"
+#include "libmv/image/array_nd.h"
 #include "libmv/logging/logging.h"
 #include "libmv/numeric/numeric.h"
 
@@ -107,6 +108,26 @@ inline void FindLocalMaxima3D(const TArray &f,
   }
 }
 
+// Find the pixels of the single channel image f that are >= min_value and >=
+// all the pixels of the width x width window around them, ignoring a border
+// of width / 2 pixels. The maximum of every window is computed by a separable
+// max filter and compared with the pixels a row of 4 at a time, so the cost
+// does not depend on the content of the image. The (x, y) location of each
+// maximum is appended to maxima in row major order; reserve() it to avoid
+// reallocations.
+void FindLocalMaximaMaxFilter(const Array3Df &f,
+                              int width,
+                              float min_value,
+                              vector<Vec2i> *maxima);
+
+// Same as FindLocalMaximaMaxFilter() for the width^3 neighborhoods of the
+// volume f(x, y, z), ignoring a border of width / 2 along each axis. The
+// (x, y, z) locations are appended in the order of the array.
+void FindLocalMaximaMaxFilter3D(const Array3Df &f,
+                                int width,
+                                float min_value,
+                                vector<Vec3i> *maxima);
+
 }  // namespace libmv
 
 #endif  // LIBMV_IMAGE_NON_MAXIMAL_SUPPRESSION_H
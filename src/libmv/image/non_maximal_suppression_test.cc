@@ -131,5 +131,71 @@ TEST(FindLocalMaxima3D, MultipleMaxesInSameBlock) {
   EXPECT_EQ(2, results[1][2]);
   EXPECT_EQ(2, results.size());
 }
+
+// Small integer values, so that there are plateaus of equal maxima.
+void RandomFill(unsigned int seed, Array3Df *A) {
+  for (int i = 0; i < A->Size(); ++i) {
+    seed = seed * 1103515245u + 12345u;
+    A->Data()[i] = (seed >> 16) % 7;
+  }
+}
+
+TEST(FindLocalMaximaMaxFilter, MatchesNaiveSearch) {
+  Array3Df A(23, 37);
+  RandomFill(1, &A);
+  for (int width = 1; width <= 5; width += 2) {
+    int r = width / 2;
+    vector<Vec2i> results, expected;
+    FindLocalMaximaMaxFilter(A, width, 3.0f, &results);
+    for (int y = r; y < A.Height() - r; ++y) {
+      for (int x = r; x < A.Width() - r; ++x) {
+        bool is_max = A(y, x) >= 3.0f;
+        for (int yy = y - r; yy <= y + r; ++yy) {
+          for (int xx = x - r; xx <= x + r; ++xx) {
+            is_max = is_max && A(y, x) >= A(yy, xx);
+          }
+        }
+        if (is_max) {
+          expected.push_back(Vec2i(x, y));
+        }
+      }
+    }
+    ASSERT_EQ(expected.size(), results.size());
+    for (int i = 0; i < expected.size(); ++i) {
+      EXPECT_EQ(expected[i](0), results[i](0));
+      EXPECT_EQ(expected[i](1), results[i](1));
+    }
+  }
+}
+
+TEST(FindLocalMaximaMaxFilter3D, MatchesNaiveSearch) {
+  Array3Df A(9, 11, 14);
+  RandomFill(2, &A);
+  const int width = 3, r = 1;
+  vector<Vec3i> results, expected;
+  FindLocalMaximaMaxFilter3D(A, width, 4.0f, &results);
+  for (int x = r; x < A.Shape(0) - r; ++x) {
+    for (int y = r; y < A.Shape(1) - r; ++y) {
+      for (int z = r; z < A.Shape(2) - r; ++z) {
+        bool is_max = A(x, y, z) >= 4.0f;
+        for (int xx = x - r; xx <= x + r; ++xx) {
+          for (int yy = y - r; yy <= y + r; ++yy) {
+            for (int zz = z - r; zz <= z + r; ++zz) {
+              is_max = is_max && A(x, y, z) >= A(xx, yy, zz);
+            }
+          }
+        }
+        if (is_max) {
+          expected.push_back(Vec3i(x, y, z));
+        }
+      }
+    }
+  }
+  ASSERT_EQ(expected.size(), results.size());
+  for (int i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i], results[i]);
+  }
+}
+
 }  // namespace libmv
 }  // namespace
@@ -0,0 +1,196 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_IMAGE_PADDED_ARRAY_H_
+#define LIBMV_IMAGE_PADDED_ARRAY_H_
+
+#include <cassert>
+#include <cstddef>
+
+#include "libmv/image/array_buffer_pool.h"
+#include "libmv/image/array_nd.h"
+
+namespace libmv {
+
+/// A 3D array (row, column, channel) whose rows start on aligned addresses.
+/// Rows are padded to a multiple of the alignment, so that SIMD loads of a
+/// row never straddle the start of the next one. With the planar layout each
+/// channel is stored as its own padded image, which makes the pixels of a
+/// channel contiguous; the interleaved layout matches Array3D.
+///
+/// Kernels access the pixels through View() and the strides it carries. The
+/// padding elements are not initialized and are excluded from the views. T
+/// must be a plain scalar type; elements are not constructed.
+template <typename T>
+class PaddedArray3D {
+ public:
+  typedef T Scalar;
+
+  enum Layout {
+    INTERLEAVED,  // (r, c, k) follows (r, c, k - 1).
+    PLANAR        // Channel k is a separate height x width image.
+  };
+
+  PaddedArray3D()
+      : buffer_(NULL), data_(NULL), height_(0), width_(0), depth_(0),
+        layout_(INTERLEAVED), row_stride_(0), channel_stride_(0) {
+  }
+
+  /// Alignment is in bytes and must be a power of two.
+  PaddedArray3D(int height, int width, int depth = 1,
+                Layout layout = INTERLEAVED, int alignment = 16)
+      : buffer_(NULL), data_(NULL) {
+    Resize(height, width, depth, layout, alignment);
+  }
+
+  ~PaddedArray3D() {
+    FreeArrayBuffer(buffer_);
+  }
+
+  /// Reallocate the array. All data is lost.
+  void Resize(int height, int width, int depth = 1,
+              Layout layout = INTERLEAVED, int alignment = 16) {
+    assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+    assert(alignment % sizeof(T) == 0);
+    FreeArrayBuffer(buffer_);
+    buffer_ = NULL;
+    data_ = NULL;
+    height_ = height;
+    width_ = width;
+    depth_ = depth;
+    layout_ = layout;
+
+    int row_length = layout == PLANAR ? width : width * depth;
+    int alignment_in_elements = alignment / sizeof(T);
+    row_stride_ = (row_length + alignment_in_elements - 1)
+                / alignment_in_elements * alignment_in_elements;
+    channel_stride_ = layout == PLANAR ? height * row_stride_ : 1;
+    int num_planes = layout == PLANAR ? depth : 1;
+    size_t size = size_t(row_stride_) * height * num_planes;
+    if (size == 0) {
+      return;
+    }
+    buffer_ = AllocateArrayBuffer(size * sizeof(T) + alignment);
+    size_t address = reinterpret_cast<size_t>(buffer_);
+    address = (address + alignment - 1) & ~size_t(alignment - 1);
+    data_ = reinterpret_cast<T *>(address);
+  }
+
+  template <typename D>
+  void ResizeLike(const ArrayND<D, 3> &other,
+                  Layout layout = INTERLEAVED, int alignment = 16) {
+    Resize(other.Shape(0), other.Shape(1), other.Shape(2), layout, alignment);
+  }
+
+  int Height() const { return height_; }
+  int Width() const { return width_; }
+  int Depth() const { return depth_; }
+  Layout GetLayout() const { return layout_; }
+
+  /// Distances between neighboring rows, columns and channels, in elements.
+  int RowStride() const { return row_stride_; }
+  int ColumnStride() const { return layout_ == PLANAR ? 1 : depth_; }
+  int ChannelStride() const { return channel_stride_; }
+
+  /// Pointer to the element (0, 0, 0), which is aligned.
+  T *Data() { return data_; }
+  const T *Data() const { return data_; }
+
+  T &operator()(int i0, int i1, int i2 = 0) {
+    assert(0 <= i0 && i0 < Height());
+    assert(0 <= i1 && i1 < Width());
+    assert(0 <= i2 && i2 < Depth());
+    return data_[i0 * RowStride() + i1 * ColumnStride() +
+                 i2 * ChannelStride()];
+  }
+  const T &operator()(int i0, int i1, int i2 = 0) const {
+    assert(0 <= i0 && i0 < Height());
+    assert(0 <= i1 && i1 < Width());
+    assert(0 <= i2 && i2 < Depth());
+    return data_[i0 * RowStride() + i1 * ColumnStride() +
+                 i2 * ChannelStride()];
+  }
+
+  ArrayView3D<T> View() {
+    return ArrayView3D<T>(data_, height_, width_, depth_,
+                          RowStride(), ColumnStride(), ChannelStride());
+  }
+  ArrayView3D<const T> View() const {
+    return ArrayView3D<const T>(data_, height_, width_, depth_,
+                                RowStride(), ColumnStride(), ChannelStride());
+  }
+
+  void Fill(T value) {
+    ArrayView3D<T> view = View();
+    for (int i = 0; i < height_; ++i) {
+      for (int j = 0; j < width_; ++j) {
+        for (int k = 0; k < depth_; ++k) {
+          view(i, j, k) = value;
+        }
+      }
+    }
+  }
+
+  /// Copy a dense array, keeping the layout and alignment of this array.
+  template <typename D>
+  void CopyFrom(const ArrayND<D, 3> &other, int alignment = 16) {
+    Resize(other.Shape(0), other.Shape(1), other.Shape(2), layout_,
+           alignment);
+    for (int i = 0; i < height_; ++i) {
+      for (int j = 0; j < width_; ++j) {
+        for (int k = 0; k < depth_; ++k) {
+          (*this)(i, j, k) = T(other(i, j, k));
+        }
+      }
+    }
+  }
+
+  /// Exchange the contents of two arrays without copying pixel data.
+  void Swap(PaddedArray3D<T> *other) {
+    std::swap(buffer_, other->buffer_);
+    std::swap(data_, other->data_);
+    std::swap(height_, other->height_);
+    std::swap(width_, other->width_);
+    std::swap(depth_, other->depth_);
+    std::swap(layout_, other->layout_);
+    std::swap(row_stride_, other->row_stride_);
+    std::swap(channel_stride_, other->channel_stride_);
+  }
+
+ private:
+  // Not copyable, use CopyFrom() or Swap().
+  PaddedArray3D(const PaddedArray3D &);
+  PaddedArray3D &operator=(const PaddedArray3D &);
+
+  void *buffer_;
+  T *data_;
+  int height_;
+  int width_;
+  int depth_;
+  Layout layout_;
+  int row_stride_;
+  int channel_stride_;
+};
+
+typedef PaddedArray3D<float> PaddedArray3Df;
+
+}  // namespace libmv
+
+#endif  // LIBMV_IMAGE_PADDED_ARRAY_H_
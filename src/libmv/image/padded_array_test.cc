@@ -0,0 +1,82 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/image/padded_array.h"
+#include "testing/testing.h"
+
+using libmv::ArrayView3D;
+using libmv::Array3Df;
+using libmv::PaddedArray3Df;
+
+namespace {
+
+TEST(PaddedArray3D, InterleavedRowsAreAligned) {
+  PaddedArray3Df array(5, 7, 3, PaddedArray3Df::INTERLEAVED, 32);
+  EXPECT_EQ(5, array.Height());
+  EXPECT_EQ(7, array.Width());
+  EXPECT_EQ(3, array.Depth());
+  EXPECT_EQ(24, array.RowStride());
+  EXPECT_EQ(3, array.ColumnStride());
+  EXPECT_EQ(1, array.ChannelStride());
+  for (int i = 0; i < array.Height(); ++i) {
+    EXPECT_EQ(0, reinterpret_cast<size_t>(&array(i, 0)) % 32);
+  }
+  array(4, 6, 2) = 3;
+  EXPECT_EQ(3, array.Data()[4 * 24 + 6 * 3 + 2]);
+}
+
+TEST(PaddedArray3D, PlanarChannelsAreSeparateImages) {
+  PaddedArray3Df array(5, 7, 3, PaddedArray3Df::PLANAR);
+  EXPECT_EQ(8, array.RowStride());
+  EXPECT_EQ(1, array.ColumnStride());
+  EXPECT_EQ(40, array.ChannelStride());
+  for (int k = 0; k < array.Depth(); ++k) {
+    for (int i = 0; i < array.Height(); ++i) {
+      EXPECT_EQ(0, reinterpret_cast<size_t>(&array(i, 0, k)) % 16);
+    }
+  }
+  ArrayView3D<float> channel = array.View().Channel(2);
+  EXPECT_EQ(1, channel.Stride(1));
+  EXPECT_EQ(8, channel.Stride(0));
+  channel(1, 2) = 5;
+  EXPECT_EQ(5, array(1, 2, 2));
+}
+
+TEST(PaddedArray3D, CopyFromAndSwap) {
+  Array3Df dense(4, 6, 2);
+  for (int i = 0; i < dense.Size(); ++i) {
+    dense.Data()[i] = i;
+  }
+  PaddedArray3Df planar(1, 1, 1, PaddedArray3Df::PLANAR);
+  planar.CopyFrom(dense);
+  EXPECT_EQ(PaddedArray3Df::PLANAR, planar.GetLayout());
+  Array3Df copy;
+  planar.View().CopyTo(&copy);
+  EXPECT_TRUE(dense == copy);
+
+  PaddedArray3Df other;
+  const float *data = planar.Data();
+  other.Swap(&planar);
+  EXPECT_EQ(data, other.Data());
+  EXPECT_EQ(0, planar.Height());
+  EXPECT_EQ(dense(3, 5, 1), other(3, 5, 1));
+}
+
+}  // namespace
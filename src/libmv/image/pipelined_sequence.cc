@@ -0,0 +1,177 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <deque>
+#include <pthread.h>
+#include <set>
+
+#include "libmv/base/thread.h"
+#include "libmv/image/cached_image_sequence.h"
+#include "libmv/image/pipelined_sequence.h"
+#include "libmv/logging/logging.h"
+
+namespace libmv {
+
+namespace {
+
+// All the state shared with the worker is protected by mutex_; the cache and
+// the source sequence do their own locking.
+class PipelinedImageSequence : public ImageSequence {
+ public:
+  PipelinedImageSequence(ImageSequence *source, int look_ahead)
+      : source_(source),
+        look_ahead_(look_ahead),
+        stopping_(false),
+        has_worker_(false) {
+    assert(source->Cache() && source->Cache()->IsThreadSafe());
+    has_worker_ = look_ahead_ > 0 &&
+        pthread_create(&worker_, NULL, &WorkerEntry, this) == 0;
+    if (!has_worker_) {
+      // Nobody would run the queued frames; load everything on demand.
+      look_ahead_ = 0;
+    }
+  }
+
+  virtual ~PipelinedImageSequence() {
+    mutex_.Lock();
+    stopping_ = true;
+    work_ready_.Broadcast();
+    mutex_.Unlock();
+    if (has_worker_) {
+      pthread_join(worker_, NULL);
+    }
+  }
+
+  virtual Image *GetImage(int i) {
+    WaitFor(i);
+    return source_->GetImage(i);
+  }
+
+  virtual FloatImage *GetFloatImage(int i) {
+    WaitFor(i);
+    return source_->GetFloatImage(i);
+  }
+
+  virtual void Unpin(int i) {
+    source_->Unpin(i);
+  }
+
+  virtual int Length() {
+    return source_->Length();
+  }
+
+  virtual ImageCache *Cache() {
+    return source_->Cache();
+  }
+
+  virtual std::string FrameKey(int i) {
+    return source_->FrameKey(i);
+  }
+
+ private:
+  // Queue the frames after i and wait until frame i is not being loaded by
+  // the worker, so that it is not computed twice.
+  void WaitFor(int i) {
+    MutexLock lock(&mutex_);
+    for (int j = i + 1; j <= i + look_ahead_; ++j) {
+      Schedule(j);
+    }
+    if (pending_.count(i)) {
+      LIBMV_SCOPED_TIMER("image_sequence.pipeline_stall");
+      while (pending_.count(i)) {
+        frame_done_.Wait(&mutex_);
+      }
+    }
+  }
+
+  // Queue frame i unless it is known or about to be. The mutex must be held.
+  void Schedule(int i) {
+    if (i >= Length() || pending_.count(i) || done_.count(i)) {
+      return;
+    }
+    queue_.push_back(i);
+    pending_.insert(i);
+    work_ready_.Signal();
+  }
+
+  static void *WorkerEntry(void *self) {
+    static_cast<PipelinedImageSequence *>(self)->RunStage();
+    return NULL;
+  }
+
+  void RunStage() {
+    for (;;) {
+      mutex_.Lock();
+      while (!stopping_ && queue_.empty()) {
+        work_ready_.Wait(&mutex_);
+      }
+      if (stopping_) {
+        mutex_.Unlock();
+        return;
+      }
+      int i = queue_.front();
+      queue_.pop_front();
+      mutex_.Unlock();
+
+      // Loads the frame into the cache, through the earlier stages.
+      {
+        LIBMV_SCOPED_TIMER("image_sequence.pipeline_stage");
+        if (source_->GetImage(i)) {
+          source_->Unpin(i);
+        }
+      }
+
+      mutex_.Lock();
+      pending_.erase(i);
+      done_.insert(i);
+      // Only the frames near the consumer are remembered; older ones may have
+      // been evicted anyway.
+      while (done_.size() > static_cast<size_t>(2 * look_ahead_ + 1)) {
+        done_.erase(done_.begin());
+      }
+      frame_done_.Broadcast();
+      mutex_.Unlock();
+    }
+  }
+
+  ImageSequence *source_;
+  int look_ahead_;
+  pthread_t worker_;
+
+  Mutex mutex_;
+  ConditionVariable work_ready_;
+  ConditionVariable frame_done_;
+  bool stopping_;
+  bool has_worker_;
+  // Frames waiting for the worker.
+  std::deque<int> queue_;
+  // Frames queued or being loaded.
+  std::set<int> pending_;
+  // Frames recently loaded by the worker.
+  std::set<int> done_;
+};
+
+}  // namespace
+
+ImageSequence *PipelineSequence(ImageSequence *source, int look_ahead) {
+  return new PipelinedImageSequence(source, look_ahead);
+}
+
+}  // namespace libmv
@@ -0,0 +1,51 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_IMAGE_PIPELINED_SEQUENCE_H_
+#define LIBMV_IMAGE_PIPELINED_SEQUENCE_H_
+
+#include "libmv/image/image_sequence.h"
+
+namespace libmv {
+
+// Wrap source so that each GetImage(i) queues the frames i + 1 to
+// i + look_ahead on a worker thread of this stage, which loads them from
+// source and leaves them unpinned in its cache. Wrapping every stage of a
+// chain of filtered sequences, e.g.
+//
+//   ImageSequence *frames = PipelineSequence(files, 4);
+//   ImageSequence *half = PipelineSequence(DownsampleSequenceBy2(frames), 4);
+//   ImageSequence *blurred = PipelineSequence(
+//       BlurSequenceAndTakeDerivatives(half, sigma), 4);
+//
+// runs each stage on its own thread, so the decoding, downsampling and
+// blurring of the next frames overlap with the consumer working on frame i.
+// The number of frames in flight per stage is bounded by look_ahead.
+//
+// The cache of source must be thread safe (constructed with
+// ImageCache::THREAD_SAFE) and large enough for the look ahead windows of all
+// the stages. Frames of a stage may be loaded by its worker and by the
+// consumer at the same time, so the filters must not keep state between
+// frames. source is not owned and must outlive the returned sequence.
+ImageSequence *PipelineSequence(ImageSequence *source, int look_ahead);
+
+}  // namespace libmv
+
+#endif  // LIBMV_IMAGE_PIPELINED_SEQUENCE_H_
@@ -0,0 +1,128 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/base/thread.h"
+#include "libmv/image/filtered_sequence.h"
+#include "libmv/image/image_sequence_filters.h"
+#include "libmv/image/mock_image_sequence.h"
+#include "libmv/image/pipelined_sequence.h"
+#include "testing/testing.h"
+
+using namespace libmv;
+
+namespace {
+
+// Adds 1 to every pixel and counts the frames it filtered.
+class CountingFilter : public Filter {
+ public:
+  CountingFilter(int *count, Mutex *mutex) : count_(count), mutex_(mutex) {}
+  virtual void RunFilter(const Array3Df &source, Array3Df *destination) {
+    destination->ResizeLike(source);
+    for (int i = 0; i < source.Size(); ++i) {
+      destination->Data()[i] = source.Data()[i] + 1;
+    }
+    MutexLock lock(mutex_);
+    ++*count_;
+  }
+ private:
+  int *count_;
+  Mutex *mutex_;
+};
+
+void MakeFrames(int n, std::vector<Array3Df> *frames) {
+  frames->resize(n);
+  for (int f = 0; f < n; ++f) {
+    (*frames)[f].Resize(16, 12);
+    for (int i = 0; i < (*frames)[f].Size(); ++i) {
+      (*frames)[f].Data()[i] = f + 0.01 * i;
+    }
+  }
+}
+
+TEST(PipelinedSequence, MatchesUnpipelinedChain) {
+  const int n = 9;
+  std::vector<Array3Df> frames;
+  MakeFrames(n, &frames);
+
+  ImageCache cache(64 * 1024 * 1024, ImageCache::THREAD_SAFE);
+  MockImageSequence source(&cache);
+  for (int f = 0; f < n; ++f) {
+    source.Append(&frames[f]);
+  }
+
+  ImageSequence *plain_half = DownsampleSequenceBy2(&source);
+  ImageSequence *plain = BlurSequenceAndTakeDerivatives(plain_half, 0.9);
+
+  ImageSequence *stage0 = PipelineSequence(&source, 3);
+  ImageSequence *half = DownsampleSequenceBy2(stage0);
+  ImageSequence *stage1 = PipelineSequence(half, 3);
+  ImageSequence *blurred = BlurSequenceAndTakeDerivatives(stage1, 0.9);
+  ImageSequence *stage2 = PipelineSequence(blurred, 3);
+  EXPECT_EQ(n, stage2->Length());
+  EXPECT_EQ(&cache, stage2->Cache());
+
+  for (int f = 0; f < n; ++f) {
+    Array3Df *expected = plain->GetFloatImage(f);
+    Array3Df *pipelined = stage2->GetFloatImage(f);
+    ASSERT_TRUE(pipelined);
+    EXPECT_TRUE(expected->Shape() == pipelined->Shape());
+    for (int i = 0; i < expected->Size(); ++i) {
+      EXPECT_EQ(expected->Data()[i], pipelined->Data()[i]);
+    }
+    plain->Unpin(f);
+    stage2->Unpin(f);
+  }
+
+  delete stage2;
+  delete blurred;
+  delete stage1;
+  delete half;
+  delete stage0;
+  delete plain;
+  delete plain_half;
+}
+
+TEST(PipelinedSequence, FiltersEachFrameOnce) {
+  const int n = 12;
+  std::vector<Array3Df> frames;
+  MakeFrames(n, &frames);
+
+  ImageCache cache(64 * 1024 * 1024, ImageCache::THREAD_SAFE);
+  MockImageSequence source(&cache);
+  for (int f = 0; f < n; ++f) {
+    source.Append(&frames[f]);
+  }
+
+  Mutex mutex;
+  int count = 0;
+  FilteredImageSequence filtered(&source, new CountingFilter(&count, &mutex));
+  ImageSequence *pipelined = PipelineSequence(&filtered, 4);
+  for (int f = 0; f < n; ++f) {
+    Array3Df *image = pipelined->GetFloatImage(f);
+    ASSERT_TRUE(image);
+    EXPECT_EQ(f + 1, (*image)(0, 0));
+    pipelined->Unpin(f);
+  }
+  delete pipelined;
+  MutexLock lock(&mutex);
+  EXPECT_EQ(n, count);
+}
+
+}  // namespace
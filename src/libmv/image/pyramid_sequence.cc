@@ -18,13 +18,17 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <algorithm>
 #include <vector>
 
+#include "libmv/image/cached_image_sequence.h"
+#include "libmv/image/convolve.h"
 #include "libmv/image/image_pyramid.h"
 #include "libmv/image/image_sequence.h"
 #include "libmv/image/image_sequence_filters.h"
 #include "libmv/image/pyramid_sequence.h"
 #include "libmv/image/lru_cache.h"
+#include "libmv/image/sample.h"
 
 namespace libmv {
 
@@ -84,7 +88,8 @@ class ConcretePyramidSequence : public PyramidSequence {
     }
   }
 
-  ConcretePyramidSequence(ImageSequence *source, int levels, double sigma) {
+  ConcretePyramidSequence(ImageSequence *source, int levels, double sigma)
+      : source_(source) {
     downsamples_.resize(levels);
     downsamples_[0] = source;
     for (int i = 1; i < levels; ++i) {
@@ -125,6 +130,257 @@ PyramidSequence *MakePyramidSequence(ImageSequence *source,
   return new ConcretePyramidSequence(source, levels, sigma);
 }
 
+// A pyramid whose levels are fetched from, or built into, an image cache on
+// first use. Building level i needs the downsampled frame of level i, which is
+// cached as well (unpinned) so that other levels can be built from it later.
+class LazyImagePyramid : public ImagePyramid {
+ public:
+  // Cache keys for level i are (&tags[2 * i], frame) for the blurred level and
+  // (&tags[2 * i + 1], frame) for the downsampled frame.
+  LazyImagePyramid(ImageSequence *source,
+                   int levels,
+                   double sigma,
+                   const char *tags,
+                   int frame)
+      : source_(source),
+        cache_(source->Cache()),
+        sigma_(sigma),
+        tags_(tags),
+        frame_(frame),
+        blurred_(levels, static_cast<Image *>(NULL)) {}
+
+  virtual ~LazyImagePyramid() {
+    for (int i = 0; i < NumLevels(); ++i) {
+      if (blurred_[i]) {
+        cache_->Unpin(BlurredKey(i));
+      }
+    }
+  }
+
+  virtual const FloatImage &Level(int i) {
+    assert(0 <= i && i < NumLevels());
+    if (!blurred_[i] && !cache_->FetchAndPin(BlurredKey(i), &blurred_[i])) {
+      const FloatImage *downsampled = PinDownsampled(i, &blurred_[i]);
+      if (!blurred_[i]) {
+        // The downsampled frame was cached, but not the blurred level.
+        FloatImage *blurred = new FloatImage;
+        BlurredImageAndDerivativesChannels(*downsampled, sigma_, blurred);
+        blurred_[i] = Store(BlurredKey(i), blurred);
+      }
+      UnpinDownsampled(i);
+    }
+    return *blurred_[i]->AsArray3Df();
+  }
+
+  virtual int NumLevels() const {
+    return blurred_.size();
+  }
+
+  virtual int MemorySizeInBytes() const {
+    int sum = 0;
+    for (int i = 0; i < NumLevels(); ++i) {
+      if (blurred_[i]) {
+        sum += blurred_[i]->MemorySizeInBytes();
+      }
+    }
+    return sum;
+  }
+
+ private:
+  TaggedImageKey BlurredKey(int i) const {
+    return TaggedImageKey(const_cast<char *>(tags_ + 2 * i), frame_);
+  }
+  TaggedImageKey DownsampledKey(int i) const {
+    return TaggedImageKey(const_cast<char *>(tags_ + 2 * i + 1), frame_);
+  }
+
+  Image *Store(const TaggedImageKey &key, FloatImage *array) {
+    Image *image = new Image(array);
+    return cache_->InsertAndPinSized(key, image, image->MemorySizeInBytes());
+  }
+
+  // Returns the pinned downsampled frame of level i. If blurred is not NULL
+  // and the frame has to be built, the blurred level i is built in the same
+  // pass and stored in *blurred; otherwise *blurred is left alone. The source
+  // frame is read with GetFloatImage(), so that it can be stored at half
+  // precision.
+  const FloatImage *PinDownsampled(int i, Image **blurred) {
+    if (i == 0) {
+      return source_->GetFloatImage(frame_);
+    }
+    Image *downsampled;
+    if (cache_->FetchAndPin(DownsampledKey(i), &downsampled)) {
+      return downsampled->AsArray3Df();
+    }
+    const FloatImage *previous = PinDownsampled(i - 1, NULL);
+    FloatImage *downsampled_array = new FloatImage;
+    if (blurred) {
+      FloatImage *blurred_array = new FloatImage;
+      DownsampleBy2AndBlurredImageAndDerivativesChannels(
+          *previous, sigma_, downsampled_array, blurred_array);
+      *blurred = Store(BlurredKey(i), blurred_array);
+    } else {
+      DownsampleChannelsBy2(*previous, downsampled_array);
+    }
+    UnpinDownsampled(i - 1);
+    Store(DownsampledKey(i), downsampled_array);
+    return downsampled_array;
+  }
+
+  void UnpinDownsampled(int i) {
+    if (i == 0) {
+      source_->Unpin(frame_);
+    } else {
+      cache_->Unpin(DownsampledKey(i));
+    }
+  }
+
+  ImageSequence *source_;
+  ImageCache *cache_;
+  double sigma_;
+  const char *tags_;
+  int frame_;
+  // Pinned blurred levels, or NULL when not used yet.
+  std::vector<Image *> blurred_;
+};
+
+class LazyPyramidSequence : public PyramidSequence {
+ public:
+  LazyPyramidSequence(ImageSequence *source, int levels, double sigma)
+      : source_(source),
+        levels_(levels),
+        sigma_(sigma),
+        tags_(2 * levels),
+        pyramids_(source->Length(), static_cast<ImagePyramid *>(NULL)) {
+    assert(source->Cache());
+  }
+
+  virtual ~LazyPyramidSequence() {
+    for (size_t i = 0; i < pyramids_.size(); ++i) {
+      delete pyramids_[i];
+    }
+  }
+
+  virtual int Length() {
+    return source_->Length();
+  }
+
+  virtual ImagePyramid *Pyramid(int frame) {
+    if (!pyramids_[frame]) {
+      pyramids_[frame] = new LazyImagePyramid(source_, levels_, sigma_,
+                                              &tags_[0], frame);
+    }
+    return pyramids_[frame];
+  }
+
+  virtual void Unpin(int frame) {
+    delete pyramids_[frame];
+    pyramids_[frame] = NULL;
+  }
+
+ private:
+  ImageSequence *source_;
+  int levels_;
+  double sigma_;
+  // Only the addresses matter; they tag the cache entries of this sequence.
+  std::vector<char> tags_;
+  std::vector<ImagePyramid *> pyramids_;
+};
+
+PyramidSequence *MakeLazyPyramidSequence(ImageSequence *source,
+                                         int levels,
+                                         double sigma) {
+  return new LazyPyramidSequence(source, levels, sigma);
+}
+
+class RecyclingPyramidSequence : public PyramidSequence {
+ public:
+  RecyclingPyramidSequence(ImageSequence *source,
+                           int levels,
+                           double sigma,
+                           int ring_size)
+      : source_(source), levels_(levels), sigma_(sigma), clock_(0),
+        ring_(std::max(ring_size, 1)) {}
+
+  virtual ~RecyclingPyramidSequence() {
+    for (size_t i = 0; i < ring_.size(); ++i) {
+      delete ring_[i].pyramid;
+    }
+  }
+
+  virtual int Length() {
+    return source_->Length();
+  }
+
+  virtual ImagePyramid *Pyramid(int frame) {
+    Slot *recycled = NULL;
+    for (size_t i = 0; i < ring_.size(); ++i) {
+      Slot &slot = ring_[i];
+      if (slot.pyramid && slot.frame == frame) {
+        Pin(&slot);
+        return slot.pyramid;
+      }
+      if (!slot.pinned &&
+          (!recycled || !slot.pyramid ||
+           (recycled->pyramid && slot.last_use < recycled->last_use))) {
+        recycled = &slot;
+      }
+    }
+    if (!recycled) {
+      ring_.push_back(Slot());
+      recycled = &ring_.back();
+    }
+
+    FloatImage *image = source_->GetFloatImage(frame);
+    if (!image) {
+      return NULL;
+    }
+    if (!recycled->pyramid ||
+        !RebuildImagePyramid(*image, levels_, sigma_, recycled->pyramid)) {
+      delete recycled->pyramid;
+      recycled->pyramid = MakeImagePyramid(*image, levels_, sigma_);
+    }
+    source_->Unpin(frame);
+    recycled->frame = frame;
+    Pin(recycled);
+    return recycled->pyramid;
+  }
+
+  virtual void Unpin(int frame) {
+    for (size_t i = 0; i < ring_.size(); ++i) {
+      if (ring_[i].pyramid && ring_[i].frame == frame) {
+        ring_[i].pinned = false;
+      }
+    }
+  }
+
+ private:
+  struct Slot {
+    Slot() : pyramid(NULL), frame(-1), pinned(false), last_use(0) {}
+    ImagePyramid *pyramid;
+    int frame;
+    bool pinned;
+    unsigned long last_use;
+  };
+
+  void Pin(Slot *slot) {
+    slot->pinned = true;
+    slot->last_use = ++clock_;
+  }
+
+  ImageSequence *source_;
+  int levels_;
+  double sigma_;
+  unsigned long clock_;
+  std::vector<Slot> ring_;
+};
+
+PyramidSequence *MakeRecyclingPyramidSequence(ImageSequence *source,
+                                              int levels,
+                                              double sigma,
+                                              int ring_size) {
+  return new RecyclingPyramidSequence(source, levels, sigma, ring_size);
+}
 
 /////////////////////////////////////////////////////////////
 // This is pau trying things.
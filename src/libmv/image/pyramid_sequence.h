@@ -24,6 +24,7 @@
 namespace libmv {
 
 class ImagePyramid;
+class ImageSequence;
 
 class PyramidSequence {
  public:
@@ -37,12 +38,39 @@ class PyramidSequence {
   // not delete it). The ImagePyramid remains valid while the PyramidSequence
   // is in scope.
   virtual ImagePyramid *Pyramid(int frame_number) = 0;
+
+  // Tell the sequence that the pyramid of frame_number is not used anymore.
+  // Sequences that pin pyramid levels in a cache release them here; the
+  // pyramid and its levels must not be used after this call.
+  virtual void Unpin(int frame_number) { (void) frame_number; }
 };
 
 PyramidSequence *MakePyramidSequence(ImageSequence *sequence,
                                      int levels,
                                      double sigma);
 
+// A pyramid sequence that only builds the levels that are asked for, and
+// stores them in the cache of the source sequence; hence one maximum size
+// applies to frames and pyramids together. Levels stay pinned until Unpin() is
+// called for the frame. Asking only for coarse levels skips blurring the finer
+// ones (the frame still gets downsampled). The source must be cached.
+PyramidSequence *MakeLazyPyramidSequence(ImageSequence *source,
+                                         int levels,
+                                         double sigma);
+
+// A pyramid sequence that keeps a ring of ring_size pyramids, built from the
+// frames of the source. The pyramid of a frame that is not in the ring is
+// rebuilt in place (see RebuildImagePyramid()) over the least recently used
+// pyramid that is not pinned, so that a tracker that pins at most ring_size
+// frames at a time, e.g. the previous and the current ones for ring_size 2,
+// allocates no pyramid storage once the ring is full. Pyramids stay pinned
+// until Unpin() is called for their frame; when all the pyramids of the ring
+// are pinned, the ring grows by one.
+PyramidSequence *MakeRecyclingPyramidSequence(ImageSequence *source,
+                                              int levels,
+                                              double sigma,
+                                              int ring_size = 2);
+
 // This is pau trying things
 PyramidSequence *MakeSimplePyramidSequence(ImageSequence *sequence,
                                            int levels,
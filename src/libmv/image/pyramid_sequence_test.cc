@@ -30,6 +30,9 @@ using libmv::ImagePyramid;
 using libmv::ImageCache;
 using libmv::MockImageSequence;
 using libmv::PyramidSequence;
+using libmv::MakeImagePyramid;
+using libmv::MakeLazyPyramidSequence;
+using libmv::MakeRecyclingPyramidSequence;
 
 namespace {
 
@@ -136,4 +139,113 @@ TEST(SimpleFilteredSequence, TwoLevelFilters) {
 }
 
 
+TEST(LazyPyramidSequence, MatchesImagePyramid) {
+  ImageCache cache;
+  MockImageSequence source(&cache);
+  Array3Df image0(32, 16);
+  for (int i = 0; i < image0.Height(); ++i) {
+    for (int j = 0; j < image0.Width(); ++j) {
+      image0(i, j) = (i * 3 + j * 5) % 7;
+    }
+  }
+  source.Append(&image0);
+
+  PyramidSequence *pyramid_sequence = MakeLazyPyramidSequence(&source, 3, 0.9);
+  EXPECT_EQ(1, pyramid_sequence->Length());
+  ImagePyramid *expected = MakeImagePyramid(image0, 3, 0.9);
+
+  // Ask for the levels out of order, coarsest first.
+  ImagePyramid *pyramid = pyramid_sequence->Pyramid(0);
+  ASSERT_EQ(3, pyramid->NumLevels());
+  int levels[] = { 2, 0, 1 };
+  for (int l = 0; l < 3; ++l) {
+    const Array3Df &level = pyramid->Level(levels[l]);
+    const Array3Df &expected_level = expected->Level(levels[l]);
+    ASSERT_EQ(expected_level.Height(), level.Height());
+    ASSERT_EQ(expected_level.Width(), level.Width());
+    ASSERT_EQ(3, level.Depth());
+    for (int i = 0; i < level.Height(); ++i) {
+      for (int j = 0; j < level.Width(); ++j) {
+        for (int k = 0; k < 3; ++k) {
+          EXPECT_EQ(expected_level(i, j, k), level(i, j, k));
+        }
+      }
+    }
+  }
+  pyramid_sequence->Unpin(0);
+  delete expected;
+  delete pyramid_sequence;
+}
+
+TEST(LazyPyramidSequence, CoarseLevelOnlyUsesTheCache) {
+  ImageCache cache;
+  MockImageSequence source(&cache);
+  Array3Df image0(64, 64);
+  image0.Fill(3);
+  source.Append(&image0);
+
+  PyramidSequence *pyramid_sequence = MakeLazyPyramidSequence(&source, 3, 0.9);
+  const Array3Df &coarse = pyramid_sequence->Pyramid(0)->Level(2);
+  EXPECT_EQ(16, coarse.Height());
+  EXPECT_NEAR(3.0, coarse(8, 8, 0), 1e-6);
+
+  // Only the frame, two downsampled frames and the coarse level are cached;
+  // the finer blurred levels (which have 3 channels) are never built.
+  int frame_size = image0.MemorySizeInBytes();
+  EXPECT_GT(cache.Size(), frame_size);
+  EXPECT_LT(cache.Size(), 2 * frame_size);
+
+  pyramid_sequence->Unpin(0);
+  delete pyramid_sequence;
+}
+
+TEST(RecyclingPyramidSequence, RebuildsTheUnpinnedPyramidsInPlace) {
+  ImageCache cache;
+  MockImageSequence source(&cache);
+  Array3Df images[4];
+  for (int f = 0; f < 4; ++f) {
+    images[f].Resize(32, 24);
+    for (int i = 0; i < images[f].Height(); ++i) {
+      for (int j = 0; j < images[f].Width(); ++j) {
+        images[f](i, j) = (i * (f + 2) + j * 5) % 7;
+      }
+    }
+    source.Append(&images[f]);
+  }
+
+  PyramidSequence *pyramid_sequence =
+      MakeRecyclingPyramidSequence(&source, 2, 0.9, 2);
+  EXPECT_EQ(4, pyramid_sequence->Length());
+  ImagePyramid *pyramid0 = pyramid_sequence->Pyramid(0);
+  const float *level0 = pyramid0->Level(0).Data();
+  ImagePyramid *pyramid1 = pyramid_sequence->Pyramid(1);
+  EXPECT_NE(pyramid0, pyramid1);
+  // A pinned frame gets its pyramid back.
+  EXPECT_EQ(pyramid0, pyramid_sequence->Pyramid(0));
+
+  // Frame 2 takes over the storage of frame 0, like a tracker advancing.
+  pyramid_sequence->Unpin(0);
+  ImagePyramid *pyramid2 = pyramid_sequence->Pyramid(2);
+  EXPECT_EQ(pyramid0, pyramid2);
+  EXPECT_EQ(level0, pyramid2->Level(0).Data());
+  ImagePyramid *expected = MakeImagePyramid(images[2], 2, 0.9);
+  for (int l = 0; l < 2; ++l) {
+    const Array3Df &level = pyramid2->Level(l);
+    ASSERT_TRUE(expected->Level(l).Shape() == level.Shape());
+    for (int i = 0; i < level.Size(); ++i) {
+      EXPECT_EQ(expected->Level(l).Data()[i], level.Data()[i]);
+    }
+  }
+  delete expected;
+
+  // With every pyramid pinned, the ring grows.
+  ImagePyramid *pyramid3 = pyramid_sequence->Pyramid(3);
+  EXPECT_NE(pyramid1, pyramid3);
+  EXPECT_NE(pyramid2, pyramid3);
+  pyramid_sequence->Unpin(1);
+  pyramid_sequence->Unpin(2);
+  pyramid_sequence->Unpin(3);
+  delete pyramid_sequence;
+}
+
 }  // namespace
@@ -0,0 +1,291 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "libmv/image/sample.h"
+
+namespace libmv {
+
+namespace {
+
+#ifdef __SSE2__
+// Same as LinearInitAxis() for 4 coordinates.
+inline void LinearInitAxis4(__m128 fx, int width,
+                            __m128i *x1, __m128i *x2,
+                            __m128 *dx1, __m128 *dx2) {
+  const __m128i ix = _mm_cvttps_epi32(fx);
+  const __m128i last = _mm_set1_epi32(width - 1);
+  const __m128i below = _mm_cmplt_epi32(ix, _mm_setzero_si128());
+  const __m128i above = _mm_cmpgt_epi32(ix, _mm_set1_epi32(width - 2));
+  const __m128i inside = _mm_andnot_si128(_mm_or_si128(below, above),
+                                          _mm_set1_epi32(-1));
+  const __m128i next = _mm_add_epi32(ix, _mm_set1_epi32(1));
+  // Outside the image both samples are the nearest border pixel.
+  *x1 = _mm_or_si128(_mm_and_si128(inside, ix), _mm_and_si128(above, last));
+  *x2 = _mm_or_si128(_mm_and_si128(inside, next), _mm_and_si128(above, last));
+  const __m128 inside_ps = _mm_castsi128_ps(inside);
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 d1 = _mm_sub_ps(_mm_cvtepi32_ps(next), fx);
+  *dx1 = _mm_or_ps(_mm_and_ps(inside_ps, d1), _mm_andnot_ps(inside_ps, one));
+  *dx2 = _mm_sub_ps(one, *dx1);
+}
+
+// Same as LinearInitAxis() for 4 coordinates inside the image.
+inline void LinearInitAxisInterior4(__m128 fx, __m128i *x1,
+                                    __m128 *dx1, __m128 *dx2) {
+  *x1 = _mm_cvttps_epi32(fx);
+  const __m128 one = _mm_set1_ps(1.0f);
+  *dx1 = _mm_sub_ps(_mm_add_ps(_mm_cvtepi32_ps(*x1), one), fx);
+  *dx2 = _mm_sub_ps(one, *dx1);
+}
+
+// dy1 * (dx1 * im11 + dx2 * im12) + dy2 * (dx1 * im21 + dx2 * im22), in the
+// same order as SampleLinear().
+inline __m128 Blend4(__m128 dx1, __m128 dx2, __m128 dy1, __m128 dy2,
+                     __m128 im11, __m128 im12, __m128 im21, __m128 im22) {
+  const __m128 top = _mm_add_ps(_mm_mul_ps(dx1, im11), _mm_mul_ps(dx2, im12));
+  const __m128 bottom = _mm_add_ps(_mm_mul_ps(dx1, im21),
+                                   _mm_mul_ps(dx2, im22));
+  return _mm_add_ps(_mm_mul_ps(dy1, top), _mm_mul_ps(dy2, bottom));
+}
+
+// Samples 4 points of a single channel image, given the rows and columns of
+// their neighbours. There is no gather in SSE2; the pixels are loaded per
+// lane.
+inline __m128 Sample4(const float *data, int width,
+                      __m128i y1, __m128i y2, __m128i x1, __m128i x2,
+                      __m128 dx1, __m128 dx2, __m128 dy1, __m128 dy2) {
+  int row1[4], row2[4], col1[4], col2[4];
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(row1), y1);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(row2), y2);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(col1), x1);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(col2), x2);
+  float im11[4], im12[4], im21[4], im22[4];
+  for (int k = 0; k < 4; ++k) {
+    const float *line1 = data + row1[k] * width;
+    const float *line2 = data + row2[k] * width;
+    im11[k] = line1[col1[k]];
+    im12[k] = line1[col2[k]];
+    im21[k] = line2[col1[k]];
+    im22[k] = line2[col2[k]];
+  }
+  return Blend4(dx1, dx2, dy1, dy2,
+                _mm_loadu_ps(im11), _mm_loadu_ps(im12),
+                _mm_loadu_ps(im21), _mm_loadu_ps(im22));
+}
+#endif
+
+// Samples all the channels at one point, given its neighbours.
+inline void SampleChannels(const Array3Df &image,
+                           int y1, int y2, int x1, int x2,
+                           float dy1, float dy2, float dx1, float dx2,
+                           float *samples) {
+  const float *im11 = &image(y1, x1, 0);
+  const float *im12 = &image(y1, x2, 0);
+  const float *im21 = &image(y2, x1, 0);
+  const float *im22 = &image(y2, x2, 0);
+  for (int d = 0; d < image.Depth(); ++d) {
+    samples[d] = dy1 * (dx1 * im11[d] + dx2 * im12[d]) +
+                 dy2 * (dx1 * im21[d] + dx2 * im22[d]);
+  }
+}
+
+}  // namespace
+
+void SampleLinear(const Array3Df &image,
+                  const float *ys, const float *xs, int n,
+                  float *samples) {
+  const int height = image.Height();
+  const int width = image.Width();
+  const int depth = image.Depth();
+  int i = 0;
+#ifdef __SSE2__
+  if (depth == 1) {
+    for (; i + 4 <= n; i += 4) {
+      __m128i x1, x2, y1, y2;
+      __m128 dx1, dx2, dy1, dy2;
+      LinearInitAxis4(_mm_loadu_ps(xs + i), width, &x1, &x2, &dx1, &dx2);
+      LinearInitAxis4(_mm_loadu_ps(ys + i), height, &y1, &y2, &dy1, &dy2);
+      _mm_storeu_ps(samples + i, Sample4(image.Data(), width, y1, y2, x1, x2,
+                                         dx1, dx2, dy1, dy2));
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    int x1, y1, x2, y2;
+    float dx1, dy1, dx2, dy2;
+    LinearInitAxis(ys[i], height, &y1, &y2, &dy1, &dy2);
+    LinearInitAxis(xs[i], width,  &x1, &x2, &dx1, &dx2);
+    SampleChannels(image, y1, y2, x1, x2, dy1, dy2, dx1, dx2,
+                   samples + i * depth);
+  }
+}
+
+void SampleLinearInterior(const Array3Df &image,
+                          const float *ys, const float *xs, int n,
+                          float *samples) {
+  const int width = image.Width();
+  const int depth = image.Depth();
+  int i = 0;
+#ifdef __SSE2__
+  if (depth == 1) {
+    const __m128i one = _mm_set1_epi32(1);
+    for (; i + 4 <= n; i += 4) {
+      __m128i x1, y1;
+      __m128 dx1, dx2, dy1, dy2;
+      LinearInitAxisInterior4(_mm_loadu_ps(xs + i), &x1, &dx1, &dx2);
+      LinearInitAxisInterior4(_mm_loadu_ps(ys + i), &y1, &dy1, &dy2);
+      _mm_storeu_ps(samples + i,
+                    Sample4(image.Data(), width,
+                            y1, _mm_add_epi32(y1, one),
+                            x1, _mm_add_epi32(x1, one),
+                            dx1, dx2, dy1, dy2));
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    const int x1 = int(xs[i]);
+    const int y1 = int(ys[i]);
+    const float dx1 = x1 + 1 - xs[i];
+    const float dy1 = y1 + 1 - ys[i];
+    assert(0 <= x1 && x1 < width - 1);
+    assert(0 <= y1 && y1 < image.Height() - 1);
+    SampleChannels(image, y1, y1 + 1, x1, x1 + 1, dy1, 1 - dy1, dx1, 1 - dx1,
+                   samples + i * depth);
+  }
+}
+
+void SampleLinearPatch(const Array3Df &image,
+                       float y, float x,
+                       int patch_height, int patch_width,
+                       float *samples) {
+  const int depth = image.Depth();
+  const int row_size = patch_width * depth;
+  const bool inside = y >= 0 && x >= 0 &&
+                      y + patch_height - 1 < image.Height() - 1 &&
+                      x + patch_width - 1 < image.Width() - 1;
+  if (!inside) {
+    // Points near the border are clamped individually.
+    std::vector<float> ys(patch_width), xs(patch_width);
+    for (int r = 0; r < patch_height; ++r) {
+      for (int c = 0; c < patch_width; ++c) {
+        ys[c] = y + r;
+        xs[c] = x + c;
+      }
+      SampleLinear(image, &ys[0], &xs[0], patch_width,
+                   samples + r * row_size);
+    }
+    return;
+  }
+
+  // Every point has the same fractional offset, so the weights are shared,
+  // and the pixels of a patch row are contiguous in the image.
+  const int x1 = int(x);
+  const int y1 = int(y);
+  const float dx1 = x1 + 1 - x;
+  const float dx2 = 1 - dx1;
+  const float dy1 = y1 + 1 - y;
+  const float dy2 = 1 - dy1;
+  for (int r = 0; r < patch_height; ++r) {
+    const float *line1 = &image(y1 + r, x1, 0);
+    const float *line2 = &image(y1 + r + 1, x1, 0);
+    float *out = samples + r * row_size;
+    int i = 0;
+#ifdef __SSE2__
+    const __m128 dx1_4 = _mm_set1_ps(dx1);
+    const __m128 dx2_4 = _mm_set1_ps(dx2);
+    const __m128 dy1_4 = _mm_set1_ps(dy1);
+    const __m128 dy2_4 = _mm_set1_ps(dy2);
+    for (; i + 4 <= row_size; i += 4) {
+      _mm_storeu_ps(out + i, Blend4(dx1_4, dx2_4, dy1_4, dy2_4,
+                                    _mm_loadu_ps(line1 + i),
+                                    _mm_loadu_ps(line1 + i + depth),
+                                    _mm_loadu_ps(line2 + i),
+                                    _mm_loadu_ps(line2 + i + depth)));
+    }
+#endif
+    for (; i < row_size; ++i) {
+      out[i] = dy1 * (dx1 * line1[i] + dx2 * line1[i + depth]) +
+               dy2 * (dx1 * line2[i] + dx2 * line2[i + depth]);
+    }
+  }
+}
+
+void DownsampleRowBy2(const float *top, const float *bottom,
+                      int width, int depth, float *out) {
+  const int pairs = width / 2;
+  int c = 0;
+#ifdef __SSE2__
+  if (depth == 1) {
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    for (; c + 4 <= pairs; c += 4) {
+      const __m128 t0 = _mm_loadu_ps(top + 2 * c);
+      const __m128 t1 = _mm_loadu_ps(top + 2 * c + 4);
+      const __m128 b0 = _mm_loadu_ps(bottom + 2 * c);
+      const __m128 b1 = _mm_loadu_ps(bottom + 2 * c + 4);
+      const __m128 top_even = _mm_shuffle_ps(t0, t1, _MM_SHUFFLE(2, 0, 2, 0));
+      const __m128 top_odd = _mm_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 1, 3, 1));
+      const __m128 bottom_even = _mm_shuffle_ps(b0, b1,
+                                                _MM_SHUFFLE(2, 0, 2, 0));
+      const __m128 bottom_odd = _mm_shuffle_ps(b0, b1,
+                                               _MM_SHUFFLE(3, 1, 3, 1));
+      // Same order of additions as the scalar loop. Dividing by 4 is exact.
+      __m128 sum = _mm_add_ps(top_even, bottom_even);
+      sum = _mm_add_ps(_mm_add_ps(sum, top_odd), bottom_odd);
+      _mm_storeu_ps(out + c, _mm_mul_ps(sum, quarter));
+    }
+  }
+#endif
+  for (; c < pairs; ++c) {
+    const float *t = top + 2 * c * depth;
+    const float *b = bottom + 2 * c * depth;
+    for (int k = 0; k < depth; ++k) {
+      out[c * depth + k] = (t[k] + b[k] + t[k + depth] + b[k + depth]) / 4.0f;
+    }
+  }
+  if (width % 2) {
+    const float *t = top + 2 * pairs * depth;
+    const float *b = bottom + 2 * pairs * depth;
+    for (int k = 0; k < depth; ++k) {
+      out[pairs * depth + k] = (t[k] + b[k] + t[k] + b[k]) / 4.0f;
+    }
+  }
+}
+
+void DownsampleChannelsBy2(const Array3Df &in, Array3Df *out) {
+  const int height = (in.Height() + 1) / 2;
+  const int width = (in.Width() + 1) / 2;
+  const int depth = in.Depth();
+
+  out->Resize(height, width, depth);
+
+  for (int r = 0; r < height; ++r) {
+    const float *top = &in(2 * r, 0, 0);
+    const float *bottom = 2 * r + 1 < in.Height() ? &in(2 * r + 1, 0, 0) : top;
+    DownsampleRowBy2(top, bottom, in.Width(), depth, &(*out)(r, 0, 0));
+  }
+}
+
+}  // namespace libmv
@@ -74,32 +74,114 @@ inline T SampleLinear(const Array3D<T> &image, float y, float x, int v = 0) {
            dy2 * ( dx1 * im21 + dx2 * im22 ));
 }
 
-// Downsample all channels by 2. Input image must have even size in width and
-// height.
-inline void DownsampleChannelsBy2(const Array3Df &in, Array3Df *out) {
-  assert(in.Height() % 2 == 0);
-  assert(in.Width() % 2 == 0);
-
-  int height = in.Height() / 2;
-  int width = in.Width() / 2;
-  int depth = in.Depth();
-
-  out->Resize(height, width, depth);
-
-  // 2x2 box filter downsampling.
-  for (int r = 0; r < height; ++r) {
-    for (int c = 0; c < width; ++c) {
-      for (int k = 0; k < depth; ++k) {
-        (*out)(r, c, k) = (in(2 * r,     2 * c,     k) +
-                           in(2 * r + 1, 2 * c,     k) +
-                           in(2 * r,     2 * c + 1, k) +
-                           in(2 * r + 1, 2 * c + 1, k)) / 4.0f;
-      }
-    }
+/// Same as above for images with a fixed number of channels.
+template<typename T, int D>
+inline T SampleLinear(const FixedDepthArray3D<T, D> &image,
+                      float y, float x, int v = 0) {
+  int x1, y1, x2, y2;
+  float dx1, dy1, dx2, dy2;
+
+  LinearInitAxis(y, image.Height(), &y1, &y2, &dy1, &dy2);
+  LinearInitAxis(x, image.Width(),  &x1, &x2, &dx1, &dx2);
+
+  const T im11 = image(y1, x1, v);
+  const T im12 = image(y1, x2, v);
+  const T im21 = image(y2, x1, v);
+  const T im22 = image(y2, x2, v);
+
+  return T(dy1 * ( dx1 * im11 + dx2 * im12 ) +
+           dy2 * ( dx1 * im21 + dx2 * im22 ));
+}
+
+/// Linear interpolation of the D channels of image at (y, x) into
+/// samples[0..D-1], equal to SampleLinear(image, y, x, channel). The clamping
+/// is set up once for all the channels, and the loop over the channels is
+/// unrolled, e.g. for a blurred image and its gradients.
+template<typename T, int D>
+inline void SampleLinearChannels(const FixedDepthArray3D<T, D> &image,
+                                 float y, float x, T *samples) {
+  int x1, y1, x2, y2;
+  float dx1, dy1, dx2, dy2;
+
+  LinearInitAxis(y, image.Height(), &y1, &y2, &dy1, &dy2);
+  LinearInitAxis(x, image.Width(),  &x1, &x2, &dx1, &dx2);
+
+  const T *im11 = image.Pixel(y1, x1);
+  const T *im12 = image.Pixel(y1, x2);
+  const T *im21 = image.Pixel(y2, x1);
+  const T *im22 = image.Pixel(y2, x2);
+  for (int v = 0; v < D; ++v) {
+    samples[v] = T(dy1 * ( dx1 * im11[v] + dx2 * im12[v] ) +
+                   dy2 * ( dx1 * im21[v] + dx2 * im22[v] ));
   }
+}
 
+/// Same as above for strided images.
+template<typename T>
+inline T SampleNearest(const ArrayView3D<T> &image,
+                       float y, float x, int v = 0) {
+  const int i = int(round(y));
+  const int j = int(round(x));
+  return image(i, j, v);
+}
+
+/// Same as above for strided images.
+template<typename T>
+inline T SampleLinear(const ArrayView3D<T> &image,
+                      float y, float x, int v = 0) {
+  int x1, y1, x2, y2;
+  float dx1, dy1, dx2, dy2;
+
+  LinearInitAxis(y, image.Height(), &y1, &y2, &dy1, &dy2);
+  LinearInitAxis(x, image.Width(),  &x1, &x2, &dx1, &dx2);
+
+  const T im11 = image(y1, x1, v);
+  const T im12 = image(y1, x2, v);
+  const T im21 = image(y2, x1, v);
+  const T im22 = image(y2, x2, v);
+
+  return T(dy1 * ( dx1 * im11 + dx2 * im12 ) +
+           dy2 * ( dx1 * im21 + dx2 * im22 ));
 }
 
+// Downsample all channels by 2 with a 2x2 box filter. The output has
+// (Height() + 1) / 2 rows and (Width() + 1) / 2 columns; for odd sizes the
+// last row or column is averaged with itself.
+void DownsampleChannelsBy2(const Array3Df &in, Array3Df *out);
+
+// One output row of DownsampleChannelsBy2(): averages the rows top and bottom
+// of an image with width columns and depth interleaved channels into
+// (width + 1) / 2 columns. Single channel rows are done 4 columns at a time
+// with SSE2.
+void DownsampleRowBy2(const float *top, const float *bottom,
+                      int width, int depth, float *out);
+
+// Bilinear samples of all the channels of image at the n points
+// (ys[i], xs[i]), stored in samples[i * image.Depth() + channel]. The values
+// are the same as SampleLinear(image, ys[i], xs[i], channel); the clamping is
+// set up once per point rather than per channel, and single channel images
+// are sampled 4 points at a time with SSE2.
+void SampleLinear(const Array3Df &image,
+                  const float *ys, const float *xs, int n,
+                  float *samples);
+
+// Same as above for points with 0 <= y < Height() - 1 and
+// 0 <= x < Width() - 1, skipping the border clamping.
+void SampleLinearInterior(const Array3Df &image,
+                          const float *ys, const float *xs, int n,
+                          float *samples);
+
+// Bilinear samples of the patch_height x patch_width grid of pixels whose top
+// left corner is at (y, x), stored in
+//   samples[(r * patch_width + c) * image.Depth() + channel]
+// and equal to SampleLinear(image, y + r, x + c, channel) up to float
+// rounding. When the patch is inside the image all the points share the
+// same weights and consecutive pixels are loaded with vector loads.
+void SampleLinearPatch(const Array3Df &image,
+                       float y, float x,
+                       int patch_height, int patch_width,
+                       float *samples);
+
 }  // namespace libmv
 
 #endif  // LIBMV_IMAGE_SAMPLE_H_
@@ -18,6 +18,9 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <algorithm>
+#include <vector>
+
 #include "libmv/image/sample.h"
 #include "testing/testing.h"
 
@@ -86,4 +89,122 @@ TEST(Image, DownsampleBy2MultiChannel) {
   EXPECT_FLOAT_EQ((5+6+7+8)/4.,    resampled_image(0, 0, 1));
   EXPECT_FLOAT_EQ((9+10+11+12)/4., resampled_image(0, 0, 2));
 }
+void MakeSampleTestImage(int depth, Array3Df *image) {
+  image->Resize(9, 11, depth);
+  for (int i = 0; i < image->Size(); ++i) {
+    image->Data()[i] = (i * 37) % 17 / 4.0f;
+  }
+}
+
+TEST(Image, LinearBatchMatchesLinear) {
+  for (int depth = 1; depth <= 3; depth += 2) {
+    Array3Df image;
+    MakeSampleTestImage(depth, &image);
+    // Points inside, on and outside the border.
+    const int n = 23;
+    float ys[n], xs[n];
+    for (int i = 0; i < n; ++i) {
+      ys[i] = -1.3f + 0.51f * i;
+      xs[i] = 12.1f - 0.63f * i;
+    }
+    std::vector<float> samples(n * depth);
+    SampleLinear(image, ys, xs, n, &samples[0]);
+    for (int i = 0; i < n; ++i) {
+      for (int d = 0; d < depth; ++d) {
+        EXPECT_EQ(SampleLinear(image, ys[i], xs[i], d),
+                  samples[i * depth + d]) << i;
+      }
+    }
+  }
+}
+
+TEST(Image, LinearInteriorMatchesLinear) {
+  for (int depth = 1; depth <= 3; depth += 2) {
+    Array3Df image;
+    MakeSampleTestImage(depth, &image);
+    const int n = 13;
+    float ys[n], xs[n];
+    for (int i = 0; i < n; ++i) {
+      ys[i] = 0.1f + 0.6f * i;
+      xs[i] = 9.9f - 0.7f * i;
+    }
+    std::vector<float> samples(n * depth);
+    SampleLinearInterior(image, ys, xs, n, &samples[0]);
+    for (int i = 0; i < n; ++i) {
+      for (int d = 0; d < depth; ++d) {
+        EXPECT_FLOAT_EQ(SampleLinear(image, ys[i], xs[i], d),
+                        samples[i * depth + d]) << i;
+      }
+    }
+  }
+}
+
+TEST(Image, LinearPatchMatchesLinear) {
+  for (int depth = 1; depth <= 3; depth += 2) {
+    Array3Df image;
+    MakeSampleTestImage(depth, &image);
+    // An interior patch, then one crossing the border.
+    float corners[2][2] = {{1.25f, 2.75f}, {5.5f, 6.3f}};
+    for (int k = 0; k < 2; ++k) {
+      const float y = corners[k][0], x = corners[k][1];
+      const int height = 5, width = 7;
+      std::vector<float> samples(height * width * depth);
+      SampleLinearPatch(image, y, x, height, width, &samples[0]);
+      for (int r = 0; r < height; ++r) {
+        for (int c = 0; c < width; ++c) {
+          for (int d = 0; d < depth; ++d) {
+            EXPECT_NEAR(SampleLinear(image, y + r, x + c, d),
+                        samples[(r * width + c) * depth + d], 1e-5);
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(Image, DownsampleBy2OddSizes) {
+  // Wide enough for the vectorized loop, with odd sizes.
+  for (int depth = 1; depth <= 2; ++depth) {
+    Array3Df image(7, 21, depth);
+    for (int i = 0; i < image.Size(); ++i) {
+      image.Data()[i] = (i * 13) % 7;
+    }
+    Array3Df downsampled;
+    DownsampleChannelsBy2(image, &downsampled);
+    ASSERT_EQ(4, downsampled.Height());
+    ASSERT_EQ(11, downsampled.Width());
+    ASSERT_EQ(depth, downsampled.Depth());
+    for (int r = 0; r < 4; ++r) {
+      for (int c = 0; c < 11; ++c) {
+        const int r2 = std::min(2 * r + 1, 6), c2 = std::min(2 * c + 1, 20);
+        for (int k = 0; k < depth; ++k) {
+          EXPECT_EQ((image(2 * r, 2 * c, k) + image(r2, 2 * c, k) +
+                     image(2 * r, c2, k) + image(r2, c2, k)) / 4.0f,
+                    downsampled(r, c, k));
+        }
+      }
+    }
+  }
+}
+
+TEST(SampleLinearChannels, SameAsSampleLinear) {
+  FloatImage3 image(5, 6);
+  for (int i = 0; i < image.Size(); ++i) {
+    image.Data()[i] = (i * 7) % 11;
+  }
+  const Array3Df &array = image;
+  // Inside the image, and clamped at the borders.
+  float ys[4] = { 1.25f, 3.5f, -0.5f, 4.75f };
+  float xs[4] = { 2.5f, 0.75f, 5.5f, -1.0f };
+  for (int p = 0; p < 4; ++p) {
+    float samples[3];
+    SampleLinearChannels(image, ys[p], xs[p], samples);
+    for (int k = 0; k < 3; ++k) {
+      EXPECT_EQ(SampleLinear(array, ys[p], xs[p], k), samples[k]);
+      EXPECT_EQ(SampleLinear(array, ys[p], xs[p], k),
+                SampleLinear(image, ys[p], xs[p], k));
+    }
+  }
+}
+
 }  // namespace
@@ -0,0 +1,467 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// A thread safe LRU cache, with the same interface as LRUCache. Items are
+// spread over several shards by the hash of their keys; every shard has its
+// own lock, hash table and queue of unpinned items, so threads working on
+// different keys rarely wait for each other. Lookups are O(1) on average.
+//
+// The maximum size is shared by all shards. When the cache is too large, the
+// least recently unpinned item among all shards is evicted first. Values are
+// deleted outside of the locks.
+//
+// With SetMemoryCategory(), the sizes are bytes of memory that are accounted in
+// a category of libmv/base/memory_budget.h. The cache then evicts unpinned
+// items whenever the accounted memory exceeds the budget, including when the
+// other containers ask it to.
+//
+// Single threaded code should keep using LRUCache, which does no locking.
+
+#ifndef LIBMV_IMAGE_SHARDED_LRU_CACHE_H_
+#define LIBMV_IMAGE_SHARDED_LRU_CACHE_H_
+
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "libmv/base/memory_budget.h"
+#include "libmv/base/scoped_ptr.h"
+#include "libmv/base/thread.h"
+#include "libmv/image/cache.h"
+#include "libmv/logging/logging.h"
+
+namespace libmv {
+namespace sharded_lru_cache {
+
+// The hash now lives with the cache interface, shared with LRUCache.
+using cache::Hash;
+
+}  // namespace sharded_lru_cache
+
+template<typename K, typename V, typename H = sharded_lru_cache::Hash<K> >
+class ShardedLRUCache : public Cache<K, V> {
+ public:
+  // O(num_shards)
+  ShardedLRUCache(long long max_size, int num_shards = 8)
+    : num_shards_(num_shards < 1 ? 1 : num_shards),
+      shards_(new Shard[num_shards_]),
+      max_size_(max_size),
+      size_(0),
+      tick_(0),
+      memory_(NULL) {
+    reclaimer_.cache = this;
+  }
+
+  // O(n)
+  virtual ~ShardedLRUCache() {
+    if (memory_.get()) {
+      UnregisterMemoryReclaimer(&reclaimer_);
+    }
+    for (int s = 0; s < num_shards_; ++s) {
+      Shard &shard = shards_[s];
+      for (size_t b = 0; b < shard.buckets.size(); ++b) {
+        CachedItem *item = shard.buckets[b];
+        while (item) {
+          CachedItem *next = item->next_in_bucket;
+          delete item->ptr;
+          delete item;
+          item = next;
+        }
+      }
+    }
+    delete [] shards_;
+  }
+
+  // O(1)
+  void Pin(const K &key) {
+    size_t hash = hash_(key);
+    Shard &shard = ShardFor(hash);
+    MutexLock lock(&shard.mutex);
+    CachedItem *item = shard.Find(key, hash, num_shards_);
+    assert(item);
+    PinLocked(&shard, item);
+  }
+  // O(1), plus the evictions.
+  virtual void Unpin(const K &key) {
+    size_t hash = hash_(key);
+    Shard &shard = ShardFor(hash);
+    bool possible_delete_needed;
+    {
+      MutexLock lock(&shard.mutex);
+      CachedItem *item = shard.Find(key, hash, num_shards_);
+      assert(item);
+      possible_delete_needed = UnpinLocked(&shard, item);
+    }
+    if (possible_delete_needed)
+      DeleteUnpinnedItemsIfNecessary();
+  }
+  // O(n)
+  virtual void MassUnpin() {
+    for (int s = 0; s < num_shards_; ++s) {
+      Shard &shard = shards_[s];
+      MutexLock lock(&shard.mutex);
+      for (size_t b = 0; b < shard.buckets.size(); ++b) {
+        for (CachedItem *item = shard.buckets[b]; item;
+             item = item->next_in_bucket) {
+          if (item->use_count > 0) {
+            UnpinLocked(&shard, item);
+          }
+        }
+      }
+    }
+    DeleteUnpinnedItemsIfNecessary();
+  }
+  // O(1)
+  virtual bool FetchAndPin(const K &key, V **value) {
+    size_t hash = hash_(key);
+    Shard &shard = ShardFor(hash);
+    MutexLock lock(&shard.mutex);
+    CachedItem *item = shard.Find(key, hash, num_shards_);
+    if (!item) {
+      LIBMV_COUNTER("cache.misses", 1);
+      return false;
+    }
+    LIBMV_COUNTER("cache.hits", 1);
+    PinLocked(&shard, item);
+    *value = item->ptr;
+    return true;
+  }
+  // O(1), plus the evictions. The key must not be in the cache already; when
+  // several threads may produce the same item, use InsertAndPinSized(). The
+  // eviction is by recency only, so the cost is ignored.
+  virtual void StoreAndPinSized(const K &key, V *value, const long long size,
+                                const double cost = 0) {
+    V *resident = InsertAndPinSized(key, value, size);
+    assert(resident == value);
+    (void) resident;
+  }
+  // Store value unless another thread stored one for the key first. In that
+  // case, value is deleted and the resident value is pinned instead. Returns
+  // the value in the cache.
+  // O(1), plus the evictions.
+  V *InsertAndPinSized(const K &key, V *value, const long long size,
+                       const double cost = 0) {
+    size_t hash = hash_(key);
+    Shard &shard = ShardFor(hash);
+    V *resident;
+    {
+      MutexLock lock(&shard.mutex);
+      CachedItem *item = shard.Find(key, hash, num_shards_);
+      if (item) {
+        PinLocked(&shard, item);
+        resident = item->ptr;
+      } else {
+        item = new CachedItem;
+        item->key = key;
+        item->hash = hash;
+        item->ptr = value;
+        item->use_count = 1;
+        item->size = size;
+        shard.Insert(item, num_shards_);
+        MutexLock size_lock(&size_mutex_);
+        AddSizeLocked(size);
+        resident = value;
+      }
+    }
+    if (resident != value) {
+      delete value;
+    } else {
+      DeleteUnpinnedItemsIfNecessary();
+      ReclaimMemoryOverBudget();
+    }
+    return resident;
+  }
+  // O(1)
+  virtual bool ContainsKey(const K &key) {
+    size_t hash = hash_(key);
+    Shard &shard = ShardFor(hash);
+    MutexLock lock(&shard.mutex);
+    return shard.Find(key, hash, num_shards_) != NULL;
+  }
+  // O(1)
+  virtual long long MaxSize() const {
+    MutexLock lock(&size_mutex_);
+    return max_size_;
+  }
+  // O(1)
+  virtual long long Size() const {
+    MutexLock lock(&size_mutex_);
+    return size_;
+  }
+  // O(1), plus the evictions.
+  virtual void SetMaxSize(const long long max_size) {
+    {
+      MutexLock lock(&size_mutex_);
+      max_size_ = max_size;
+    }
+    DeleteUnpinnedItemsIfNecessary();
+  }
+  // Must be called before the cache is shared by several threads.
+  // O(1), plus the evictions.
+  void SetMemoryCategory(MemoryCategory category) {
+    bool registered;
+    {
+      MutexLock lock(&size_mutex_);
+      registered = memory_.get() != NULL;
+      memory_.reset(new MemoryUsage(category, size_));
+    }
+    if (!registered) {
+      RegisterMemoryReclaimer(&reclaimer_);
+    }
+    DeleteUnpinnedItemsIfNecessary();
+  }
+  int NumShards() const {
+    return num_shards_;
+  }
+
+ private:
+  struct CachedItem {
+    K key;
+    size_t hash;
+    V *ptr;
+    int use_count;
+    long long size;
+    // Unpinned items of a shard form a queue, most recently unpinned first.
+    unsigned long unpin_tick;
+    CachedItem *newer;
+    CachedItem *older;
+    CachedItem *next_in_bucket;
+    CachedItem()
+      : ptr(NULL), use_count(0), size(0), unpin_tick(0),
+        newer(NULL), older(NULL), next_in_bucket(NULL) {}
+  };
+
+  // A hash table with chaining, plus the queue of unpinned items.
+  struct Shard {
+    Mutex mutex;
+    std::vector<CachedItem *> buckets;
+    int num_items;
+    CachedItem *newest_unpinned;
+    CachedItem *oldest_unpinned;
+
+    Shard() : num_items(0), newest_unpinned(NULL), oldest_unpinned(NULL) {}
+
+    // The low bits of the hash pick the shard, use the others for buckets.
+    size_t Bucket(size_t hash, size_t num_shards) const {
+      return (hash / num_shards) % buckets.size();
+    }
+    CachedItem *Find(const K &key, size_t hash, size_t num_shards) const {
+      if (buckets.empty()) {
+        return NULL;
+      }
+      CachedItem *item = buckets[Bucket(hash, num_shards)];
+      for (; item; item = item->next_in_bucket) {
+        if (item->hash == hash && item->key == key) {
+          return item;
+        }
+      }
+      return NULL;
+    }
+    void Insert(CachedItem *item, size_t num_shards) {
+      if (num_items >= static_cast<int>(buckets.size())) {
+        Rehash(2 * buckets.size() + 8, num_shards);
+      }
+      size_t b = Bucket(item->hash, num_shards);
+      item->next_in_bucket = buckets[b];
+      buckets[b] = item;
+      ++num_items;
+    }
+    void Erase(CachedItem *item, size_t num_shards) {
+      CachedItem **link = &buckets[Bucket(item->hash, num_shards)];
+      while (*link != item) {
+        link = &(*link)->next_in_bucket;
+      }
+      *link = item->next_in_bucket;
+      --num_items;
+    }
+    void Rehash(size_t num_buckets, size_t num_shards) {
+      std::vector<CachedItem *> old_buckets(num_buckets, NULL);
+      old_buckets.swap(buckets);
+      for (size_t b = 0; b < old_buckets.size(); ++b) {
+        CachedItem *item = old_buckets[b];
+        while (item) {
+          CachedItem *next = item->next_in_bucket;
+          size_t nb = Bucket(item->hash, num_shards);
+          item->next_in_bucket = buckets[nb];
+          buckets[nb] = item;
+          item = next;
+        }
+      }
+    }
+    void PushUnpinned(CachedItem *item) {
+      item->older = newest_unpinned;
+      item->newer = NULL;
+      if (newest_unpinned) {
+        newest_unpinned->newer = item;
+      } else {
+        oldest_unpinned = item;
+      }
+      newest_unpinned = item;
+    }
+    void RemoveUnpinned(CachedItem *item) {
+      if (item->newer) {
+        item->newer->older = item->older;
+      } else {
+        newest_unpinned = item->older;
+      }
+      if (item->older) {
+        item->older->newer = item->newer;
+      } else {
+        oldest_unpinned = item->newer;
+      }
+      item->newer = item->older = NULL;
+    }
+  };
+
+  // No copying allowed.
+  ShardedLRUCache(const ShardedLRUCache &);
+  ShardedLRUCache &operator=(const ShardedLRUCache &);
+
+  Shard &ShardFor(size_t hash) {
+    return shards_[hash % num_shards_];
+  }
+
+  // The shard mutex must be held.
+  void PinLocked(Shard *shard, CachedItem *item) {
+    if (item->use_count == 0) {
+      shard->RemoveUnpinned(item);
+    }
+    item->use_count++;
+  }
+  // The shard mutex must be held. Returns whether the item was entirely
+  // unpinned and hence whether DeleteUnpinnedItemsIfNecessary() should be
+  // called (after releasing the shard mutex).
+  bool UnpinLocked(Shard *shard, CachedItem *item) {
+    assert(item->use_count > 0);
+    item->use_count--;
+    if (item->use_count > 0) {
+      return false;
+    }
+    {
+      MutexLock lock(&size_mutex_);
+      item->unpin_tick = ++tick_;
+    }
+    shard->PushUnpinned(item);
+    return true;
+  }
+
+  // Evicts the least recently unpinned items of all the shards, as in
+  // DeleteUnpinnedItemsIfNecessary(), until bytes of them are freed.
+  struct Reclaimer : public MemoryReclaimer {
+    virtual long long ReclaimMemory(long long bytes) {
+      long long freed = 0;
+      while (freed < bytes) {
+        long long size = cache->EvictLeastRecentlyUnpinned();
+        if (size < 0) {
+          break;
+        }
+        freed += size;
+      }
+      return freed;
+    }
+    ShardedLRUCache *cache;
+  };
+
+  bool OverBudget() const {
+    MutexLock lock(&size_mutex_);
+    return size_ > max_size_ || (memory_.get() && MemoryOverBudget() > 0);
+  }
+
+  // The size mutex must be held.
+  void AddSizeLocked(long long size) {
+    size_ += size;
+    if (memory_.get()) {
+      memory_->Set(size_);
+    }
+  }
+
+  // Must be called without holding any shard mutex. Shard mutexes are only
+  // taken one at a time, and the size mutex is always taken last.
+  void DeleteUnpinnedItemsIfNecessary() {
+    while (OverBudget()) {
+      if (EvictLeastRecentlyUnpinned() < 0) {
+        return;
+      }
+    }
+  }
+
+  // Returns the size of the evicted item, or -1 if all the items are pinned.
+  // The same locking rules as DeleteUnpinnedItemsIfNecessary() apply.
+  long long EvictLeastRecentlyUnpinned() {
+    for (;;) {
+      // Find the shard holding the least recently unpinned item.
+      Shard *oldest_shard = NULL;
+      unsigned long oldest_tick = 0;
+      for (int s = 0; s < num_shards_; ++s) {
+        MutexLock lock(&shards_[s].mutex);
+        CachedItem *item = shards_[s].oldest_unpinned;
+        if (item && (!oldest_shard || item->unpin_tick < oldest_tick)) {
+          oldest_shard = &shards_[s];
+          oldest_tick = item->unpin_tick;
+        }
+      }
+      if (!oldest_shard) {
+        return -1;
+      }
+      // Another thread may have pinned or evicted it meanwhile; in that case,
+      // this evicts the next oldest item of the shard, or looks again.
+      V *evicted = NULL;
+      long long size = -1;
+      {
+        MutexLock lock(&oldest_shard->mutex);
+        CachedItem *item = oldest_shard->oldest_unpinned;
+        if (item) {
+          oldest_shard->RemoveUnpinned(item);
+          oldest_shard->Erase(item, num_shards_);
+          {
+            MutexLock size_lock(&size_mutex_);
+            AddSizeLocked(-item->size);
+          }
+          evicted = item->ptr;
+          size = item->size;
+          delete item;
+        }
+      }
+      if (size >= 0) {
+        delete evicted;
+        return size;
+      }
+    }
+  }
+
+  H hash_;
+  const int num_shards_;
+  Shard *shards_;
+
+  // Protects the fields below.
+  mutable Mutex size_mutex_;
+  long long max_size_;
+  long long size_;
+  unsigned long tick_;
+  // The accounting of size_, if it is in bytes.
+  scoped_ptr<MemoryUsage> memory_;
+
+  Reclaimer reclaimer_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_IMAGE_SHARDED_LRU_CACHE_H_
@@ -0,0 +1,189 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <utility>
+
+#include "libmv/base/memory_budget.h"
+#include "libmv/base/thread.h"
+#include "libmv/image/sharded_lru_cache.h"
+#include "testing/testing.h"
+
+namespace {
+
+typedef libmv::ShardedLRUCache<int, int> TestCache;
+
+TEST(ShardedLRUCache, NullOnEmptyKey) {
+  TestCache cache(10);
+  int *ptr = NULL;
+  EXPECT_FALSE(cache.FetchAndPin(4, &ptr));
+  EXPECT_FALSE(cache.ContainsKey(4));
+}
+
+TEST(ShardedLRUCache, StoreAndRetreiveManyItems) {
+  TestCache cache(1000);
+  for (int i = 0; i < 100; ++i) {
+    cache.StoreAndPin(i, new int(10 * i));
+  }
+  EXPECT_EQ(cache.Size(), 100);
+  for (int i = 0; i < 100; ++i) {
+    int *ptr = NULL;
+    EXPECT_TRUE(cache.FetchAndPin(i, &ptr));
+    EXPECT_EQ(*ptr, 10 * i);
+  }
+}
+
+TEST(ShardedLRUCache, MaxSizeExceededWhenItemsPinned) {
+  TestCache cache(3);
+  cache.StoreAndPin(4, new int(40));
+  cache.StoreAndPin(5, new int(50));
+  cache.StoreAndPin(6, new int(60));
+  cache.StoreAndPin(7, new int(70));
+  EXPECT_EQ(cache.Size(), 4);
+}
+
+// The eviction order must be least recently unpinned first, across shards.
+TEST(ShardedLRUCache, EvictsLeastRecentlyUnpinned) {
+  TestCache cache(3, 2);
+  cache.StoreAndPin(4, new int(40));
+  cache.StoreAndPin(5, new int(50));
+  cache.StoreAndPin(6, new int(60));
+  cache.Unpin(4);
+  cache.Unpin(5);
+  cache.Unpin(6);
+  cache.StoreAndPinSized(7, new int(70), 1);
+  EXPECT_EQ(cache.Size(), 3);
+  EXPECT_TRUE(cache.ContainsKey(5));
+  EXPECT_TRUE(cache.ContainsKey(6));
+  EXPECT_TRUE(cache.ContainsKey(7));
+
+  int *ptr = NULL;
+  EXPECT_TRUE(cache.FetchAndPin(5, &ptr));
+  cache.Unpin(7);
+  cache.Unpin(5);
+  cache.SetMaxSize(2);
+  EXPECT_EQ(cache.Size(), 2);
+  EXPECT_FALSE(cache.ContainsKey(6));
+  EXPECT_TRUE(cache.ContainsKey(7));
+  EXPECT_TRUE(cache.ContainsKey(5));
+
+  cache.SetMaxSize(1);
+  EXPECT_FALSE(cache.ContainsKey(7));
+  EXPECT_TRUE(cache.ContainsKey(5));
+}
+
+TEST(ShardedLRUCache, MassUnpin) {
+  TestCache cache(2);
+  cache.StoreAndPin(4, new int(40));
+  cache.StoreAndPin(5, new int(50));
+  cache.StoreAndPin(6, new int(60));
+  int *ptr = NULL;
+  EXPECT_TRUE(cache.FetchAndPin(6, &ptr));
+  EXPECT_EQ(cache.Size(), 3);
+  cache.MassUnpin();
+  EXPECT_EQ(cache.Size(), 2);
+  EXPECT_TRUE(cache.ContainsKey(6));
+}
+
+TEST(ShardedLRUCache, InsertKeepsResidentValue) {
+  TestCache cache(10);
+  int *first = new int(1);
+  EXPECT_EQ(first, cache.InsertAndPinSized(3, first, 1));
+  EXPECT_EQ(first, cache.InsertAndPinSized(3, new int(2), 1));
+  EXPECT_EQ(cache.Size(), 1);
+  cache.Unpin(3);
+  cache.Unpin(3);
+  cache.SetMaxSize(0);
+  EXPECT_FALSE(cache.ContainsKey(3));
+}
+
+// Another container going over the budget makes the cache evict.
+TEST(ShardedLRUCache, ReclaimsMemoryOverTheBudget) {
+  using namespace libmv;
+  long long frames = MemoryInUse(MEMORY_FRAMES);
+  {
+    TestCache cache(1000, 2);
+    cache.SetMemoryCategory(MEMORY_FRAMES);
+    cache.StoreAndPinSized(4, new int(40), 100);
+    cache.StoreAndPinSized(5, new int(50), 100);
+    cache.StoreAndPinSized(6, new int(60), 100);
+    cache.Unpin(4);
+    cache.Unpin(5);
+    EXPECT_EQ(frames + 300, MemoryInUse(MEMORY_FRAMES));
+
+    SetMemoryBudget(TotalMemoryInUse());
+    {
+      MemoryUsage bundle(MEMORY_BUNDLE, 150);
+      ReclaimMemoryOverBudget();
+      EXPECT_FALSE(cache.ContainsKey(4));
+      EXPECT_FALSE(cache.ContainsKey(5));
+      EXPECT_TRUE(cache.ContainsKey(6));
+      EXPECT_EQ(frames + 100, MemoryInUse(MEMORY_FRAMES));
+    }
+    SetMemoryBudget(0);
+  }
+  EXPECT_EQ(frames, MemoryInUse(MEMORY_FRAMES));
+}
+
+TEST(ShardedLRUCache, PairKeys) {
+  int tag;
+  libmv::ShardedLRUCache<std::pair<void *, int>, int> cache(10);
+  cache.StoreAndPin(std::make_pair(static_cast<void *>(&tag), 1), new int(1));
+  int *ptr = NULL;
+  EXPECT_TRUE(cache.FetchAndPin(std::make_pair(static_cast<void *>(&tag), 1),
+                                &ptr));
+  EXPECT_EQ(*ptr, 1);
+  EXPECT_FALSE(cache.ContainsKey(std::make_pair(static_cast<void *>(&tag), 2)));
+}
+
+// Every thread repeatedly fetches, or loads, and releases a small set of keys.
+struct HammerCache {
+  TestCache *cache;
+  int num_keys;
+  int num_errors;
+  libmv::Mutex mutex;
+
+  void operator()(int i) {
+    for (int j = 0; j < 200; ++j) {
+      int key = (i * 7 + j) % num_keys;
+      int *value;
+      if (!cache->FetchAndPin(key, &value)) {
+        value = cache->InsertAndPinSized(key, new int(key), 1);
+      }
+      if (*value != key) {
+        libmv::MutexLock lock(&mutex);
+        ++num_errors;
+      }
+      cache->Unpin(key);
+    }
+  }
+};
+
+TEST(ShardedLRUCache, ConcurrentFetchAndStore) {
+  TestCache cache(16);
+  HammerCache hammer;
+  hammer.cache = &cache;
+  hammer.num_keys = 40;
+  hammer.num_errors = 0;
+  libmv::ParallelFor(0, 64, 8, &hammer);
+  EXPECT_EQ(hammer.num_errors, 0);
+  EXPECT_LE(cache.Size(), 16);
+}
+
+}  // namespace
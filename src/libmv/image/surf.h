@@ -23,6 +23,7 @@
 
 #include <cmath>
 
+#include "libmv/base/thread.h"
 #include "libmv/base/vector.h"
 #include "libmv/correspondence/feature.h"
 #include "libmv/image/array_nd.h"
@@ -45,30 +46,50 @@ struct SurfFeature : public PointFeature {
   float operator[](int i) const { return descriptor(i); }
 };
 
+namespace surf_internal {
+
+// Computes the blob response of one interval of an octave; intervals are
+// independent and each call writes a different slice of the octave.
+template<typename TImage, typename TOctave>
+struct OctaveInterval {
+  const TImage *integral_image;
+  int lobe_start;
+  int lobe_increment;
+  int scale;
+  TOctave *octave;
+
+  void operator()(int i) const {
+    int lobe_size = lobe_start + i * lobe_increment;
+    VLOG(1) << "Filtering interval " << i
+            << " with lobe size " << lobe_size;
+    // Write straight into plane i of the octave.
+    ArrayView3D<typename TOctave::Scalar> blobiness = Plane(*octave, i);
+    BlobResponse(*integral_image, lobe_size, scale, &blobiness);
+  }
+};
+
+}  // namespace surf_internal
+
 template<typename TImage, typename TOctave>
 void MakeSURFOctave(const TImage &integral_image, 
                     int num_intervals,
                     int lobe_start,
                     int lobe_increment,
                     int scale,
-                    TOctave *octave) {
+                    TOctave *octave,
+                    int num_threads = 1) {
   assert(lobe_increment % 2 == 0);
   int rows = integral_image.rows();
   int cols = integral_image.cols();
   octave->Resize(num_intervals, rows / scale, cols / scale);
   octave->fill(0);
-  for (int i = 0, lobe_size = lobe_start;
-       i < num_intervals; ++i, lobe_size += lobe_increment) {
-    VLOG(1) << "Filtering interval " << i
-            << " with lobe size " << lobe_size;
-    // Map a row-major eigen matrix into the array to avoid copying.
-    // TODO(keir): Really, the right way to do this is to add some sort of
-    // slicing semantics to the array class. Add slicing!
-    Map<RMatf> blobiness(octave->Data() + octave->Offset(i, 0, 0),
-                         rows / scale,
-                         cols / scale);
-    BlobResponse(integral_image, lobe_size, scale, &blobiness);
-  }
+  surf_internal::OctaveInterval<TImage, TOctave> interval;
+  interval.integral_image = &integral_image;
+  interval.lobe_start = lobe_start;
+  interval.lobe_increment = lobe_increment;
+  interval.scale = scale;
+  interval.octave = octave;
+  ParallelFor(0, num_intervals, num_threads, &interval);
 }
 
 // Do a single newton step toward the maximum.
@@ -91,23 +112,14 @@ inline float GaussianScaleForInterval(float interval,
   return filter_width * 1.2 / 9.0;
 }
 
-// Detect features. Each result colum stores x, y, s.
-template<typename TImage, typename TPointFeature>
-void DetectFeatures(const TImage &integral_image,
-                    int num_intervals,
-                    int lobe_start,
-                    int lobe_increment,
-                    int scale,
-                    vector<TPointFeature> *features) {
-
-  Array3Df blob_responses;
-  MakeSURFOctave(integral_image,
-                 num_intervals,
-                 lobe_start,
-                 lobe_increment,
-                 scale,
-                 &blob_responses);
-
+// Detect features in the blob responses of an octave, as computed by
+// MakeSURFOctave(). Each result colum stores x, y, s.
+template<typename TPointFeature>
+void DetectFeaturesInOctave(const Array3Df &blob_responses,
+                            int lobe_start,
+                            int lobe_increment,
+                            int scale,
+                            vector<TPointFeature> *features) {
   vector<Vec3i> maxima;
   int parameter_maxima_region = 7;
   FindLocalMaxima3D(blob_responses, parameter_maxima_region, &maxima);
@@ -154,21 +166,111 @@ void DetectFeatures(const TImage &integral_image,
 
 // Detect features. Each result colum stores x, y, s.
 template<typename TImage, typename TPointFeature>
+void DetectFeatures(const TImage &integral_image,
+                    int num_intervals,
+                    int lobe_start,
+                    int lobe_increment,
+                    int scale,
+                    vector<TPointFeature> *features,
+                    int num_threads = 1) {
+
+  Array3Df blob_responses;
+  MakeSURFOctave(integral_image,
+                 num_intervals,
+                 lobe_start,
+                 lobe_increment,
+                 scale,
+                 &blob_responses,
+                 num_threads);
+  DetectFeaturesInOctave(blob_responses, lobe_start, lobe_increment, scale,
+                         features);
+}
+
+namespace surf_internal {
+
+// Lobe sizes and sampling of octave i of a multiscale detection.
+inline void OctaveParameters(int i, int *lobe_start, int *lobe_increment,
+                             int *scale) {
+  *scale = 1;
+  *lobe_start = 5;
+  *lobe_increment = 2;
+  for (int j = 0; j < i; ++j) {
+    *scale *= 2;
+    *lobe_start += *lobe_increment;
+    *lobe_increment *= 2;
+  }
+}
+
+// Computes interval i % num_intervals of octave i / num_intervals, so that
+// all the intervals of all the octaves are filtered by a single ParallelFor.
+template<typename TImage>
+struct MultiscaleInterval {
+  const TImage *integral_image;
+  int num_intervals;
+  Array3Df *octaves;
+
+  void operator()(int i) const {
+    int o = i / num_intervals;
+    OctaveInterval<TImage, Array3Df> interval;
+    interval.integral_image = integral_image;
+    OctaveParameters(o, &interval.lobe_start, &interval.lobe_increment,
+                     &interval.scale);
+    interval.octave = &octaves[o];
+    interval(i % num_intervals);
+  }
+};
+
+// Non maximum suppression and refinement of octave o.
+template<typename TPointFeature>
+struct OctaveDetection {
+  const Array3Df *octaves;
+  vector<TPointFeature> *features;
+
+  void operator()(int o) const {
+    int lobe_start, lobe_increment, scale;
+    OctaveParameters(o, &lobe_start, &lobe_increment, &scale);
+    DetectFeaturesInOctave(octaves[o], lobe_start, lobe_increment, scale,
+                           &features[o]);
+  }
+};
+
+}  // namespace surf_internal
+
+// Detect features. Each result colum stores x, y, s.
+// The intervals of all the octaves are filtered concurrently, and then the
+// octaves are searched for maxima concurrently, on num_threads threads; the
+// features are the same, in the same order, for any number of threads.
+template<typename TImage, typename TPointFeature>
 void MultiscaleDetectFeatures(const TImage &integral_image,
                               int num_octaves,
                               int num_intervals,
-                              vector<TPointFeature> *features) {
-  int scale = 1;
-  int lobe_start = 5;
-  int lobe_increment = 2;
-  for (int i = 0; i < num_octaves; ++i) {
-    DetectFeatures(integral_image,
-                   num_intervals,
-                   lobe_start, lobe_increment, scale,
-                   features);
-    scale *= 2;
-    lobe_start += lobe_increment;
-    lobe_increment *= 2;
+                              vector<TPointFeature> *features,
+                              int num_threads = 1) {
+  vector<Array3Df> octaves(num_octaves);
+  for (int o = 0; o < num_octaves; ++o) {
+    int lobe_start, lobe_increment, scale;
+    surf_internal::OctaveParameters(o, &lobe_start, &lobe_increment, &scale);
+    octaves[o].Resize(num_intervals,
+                      integral_image.rows() / scale,
+                      integral_image.cols() / scale);
+    octaves[o].fill(0);
+  }
+  surf_internal::MultiscaleInterval<TImage> interval;
+  interval.integral_image = &integral_image;
+  interval.num_intervals = num_intervals;
+  interval.octaves = &octaves[0];
+  ParallelFor(0, num_octaves * num_intervals, num_threads, &interval);
+
+  vector<vector<TPointFeature> > octave_features(num_octaves);
+  surf_internal::OctaveDetection<TPointFeature> detection;
+  detection.octaves = &octaves[0];
+  detection.features = &octave_features[0];
+  ParallelFor(0, num_octaves, num_threads, &detection);
+
+  for (int o = 0; o < num_octaves; ++o) {
+    for (int i = 0; i < octave_features[o].size(); ++i) {
+      features->push_back(octave_features[o][i]);
+    }
   }
   // TODO(keir): Right now, this can find nearly-identical features in scale
   // space if there are enough intervals and octaves. If there aren't many
@@ -57,4 +57,55 @@ TEST(RefineMaxima3D, SimpleRefinement) {
   }
 }
 
+// Dark disks of several radii on a bright background.
+void BlobImage(Array3Du *image) {
+  image->Resize(96, 128);
+  image->Fill(200);
+  const int disks[][3] = { {30, 30, 4}, {90, 40, 7}, {60, 70, 10},
+                           {100, 80, 5} };
+  for (int d = 0; d < 4; ++d) {
+    for (int y = 0; y < image->Height(); ++y) {
+      for (int x = 0; x < image->Width(); ++x) {
+        int dx = x - disks[d][0], dy = y - disks[d][1];
+        if (dx * dx + dy * dy <= disks[d][2] * disks[d][2]) {
+          (*image)(y, x) = 20;
+        }
+      }
+    }
+  }
+}
+
+TEST(MakeSURFOctave, ThreadsGiveTheSameOctave) {
+  Array3Du image;
+  BlobImage(&image);
+  Matu integral_image;
+  IntegralImage(image, &integral_image);
+
+  Array3Df serial, parallel;
+  MakeSURFOctave(integral_image, 4, 5, 2, 1, &serial);
+  MakeSURFOctave(integral_image, 4, 5, 2, 1, &parallel, 3);
+  ASSERT_EQ(serial.Shape(0), parallel.Shape(0));
+  for (int i = 0; i < serial.Size(); ++i) {
+    EXPECT_EQ(serial.Data()[i], parallel.Data()[i]);
+  }
+}
+
+TEST(MultiscaleDetectFeatures, ThreadsGiveTheSameFeatures) {
+  Array3Du image;
+  BlobImage(&image);
+  Matu integral_image;
+  IntegralImage(image, &integral_image);
+
+  vector<PointFeature> serial, parallel;
+  MultiscaleDetectFeatures(integral_image, 3, 4, &serial);
+  MultiscaleDetectFeatures(integral_image, 3, 4, &parallel, 4);
+  EXPECT_GT(serial.size(), 0);
+  ASSERT_EQ(serial.size(), parallel.size());
+  for (int i = 0; i < serial.size(); ++i) {
+    EXPECT_EQ(serial[i].x(), parallel[i].x());
+    EXPECT_EQ(serial[i].y(), parallel[i].y());
+    EXPECT_EQ(serial[i].scale, parallel[i].scale);
+  }
+}
+
 }  // namespace
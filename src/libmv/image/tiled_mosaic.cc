@@ -0,0 +1,189 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+#include <algorithm>
+#include <cmath>
+
+#include "libmv/base/thread.h"
+#include "libmv/image/image_transform_linear.h"
+#include "libmv/image/tiled_mosaic.h"
+#include "libmv/logging/logging.h"
+
+namespace libmv {
+
+TiledMosaic::TiledMosaic(int width, int height, int depth, int tile_size)
+    : width_(width), height_(height), depth_(depth),
+      tile_size_(std::max(tile_size, 1)) {
+  num_tile_columns_ = (width_ + tile_size_ - 1) / tile_size_;
+  num_tile_rows_ = (height_ + tile_size_ - 1) / tile_size_;
+  tiles_.assign(num_tile_columns_ * num_tile_rows_, NULL);
+}
+
+TiledMosaic::~TiledMosaic() {
+  for (size_t i = 0; i < tiles_.size(); ++i) {
+    delete tiles_[i];
+  }
+}
+
+void TiledMosaic::TouchedTiles(const Vec4i &bbox,
+                               std::vector<int> *tiles) const {
+  tiles->clear();
+  int x0 = std::max(bbox(0), 0);
+  int x1 = std::min(bbox(1), width_ - 1);
+  int y0 = std::max(bbox(2), 0);
+  int y1 = std::min(bbox(3), height_ - 1);
+  if (x0 > x1 || y0 > y1) {
+    return;
+  }
+  for (int row = y0 / tile_size_; row <= y1 / tile_size_; ++row) {
+    for (int column = x0 / tile_size_; column <= x1 / tile_size_; ++column) {
+      tiles->push_back(row * num_tile_columns_ + column);
+    }
+  }
+}
+
+namespace {
+
+// The pixels WarpImageBlend() can write: the ones of the bounding box of the
+// warp whose backward mapping lands in (-1, width) x (-1, height), since the
+// source pixel is found by truncation.
+void WarpFootprint(const Vec2u &image_size, const Mat3 &H, Vec4i *bbox) {
+  ComputeBoundingBox(image_size, H, bbox);
+
+  Mat34 corners;
+  corners << -1,                 -1, image_size(0), image_size(0),
+             -1,      image_size(1), image_size(1),            -1,
+              1,                  1,             1,             1;
+  Mat3X q = H * corners;
+  for (int i = 0; i < 4; ++i) {
+    q.col(i) /= q(2, i);
+  }
+  (*bbox)(0) = std::max((*bbox)(0),
+                        static_cast<int>(floor(q.row(0).minCoeff())));
+  (*bbox)(1) = std::min((*bbox)(1),
+                        static_cast<int>(ceil(q.row(0).maxCoeff())));
+  (*bbox)(2) = std::max((*bbox)(2),
+                        static_cast<int>(floor(q.row(1).minCoeff())));
+  (*bbox)(3) = std::min((*bbox)(3),
+                        static_cast<int>(ceil(q.row(1).maxCoeff())));
+}
+
+}  // namespace
+
+void TiledMosaic::TouchedTiles(const Vec2u &image_size, const Mat3 &H,
+                               std::vector<int> *tiles) const {
+  Vec4i bbox;
+  WarpFootprint(image_size, H, &bbox);
+  TouchedTiles(bbox, tiles);
+}
+
+void TiledMosaic::TileBounds(int tile, int *x, int *y,
+                             int *width, int *height) const {
+  *x = (tile % num_tile_columns_) * tile_size_;
+  *y = (tile / num_tile_columns_) * tile_size_;
+  *width = std::min(tile_size_, width_ - *x);
+  *height = std::min(tile_size_, height_ - *y);
+}
+
+FloatImage *TiledMosaic::MutableTile(int tile) {
+  if (!tiles_[tile]) {
+    int x, y, width, height;
+    TileBounds(tile, &x, &y, &width, &height);
+    tiles_[tile] = new FloatImage(height, width, depth_);
+    tiles_[tile]->Fill(0);
+  }
+  return tiles_[tile];
+}
+
+void TiledMosaic::ReleaseTile(int tile) {
+  delete tiles_[tile];
+  tiles_[tile] = NULL;
+}
+
+namespace {
+
+// Blends the frame into the touched tile i, for ParallelFor.
+struct BlendTiles {
+  void operator()(int i) const {
+    int x, y, width, height;
+    mosaic->TileBounds(tiles[i], &x, &y, &width, &height);
+    Mat3 T;
+    T << 1, 0, -x,
+         0, 1, -y,
+         0, 0, 1;
+    Vec4i tile_bbox;
+    tile_bbox << bbox(0) - x, bbox(1) - x, bbox(2) - y, bbox(3) - y;
+    WarpImageBlend(*image, T * H, tile_bbox, outputs[i], blending_ratio);
+  }
+  const TiledMosaic *mosaic;
+  const FloatImage *image;
+  Mat3 H;
+  Vec4i bbox;
+  float blending_ratio;
+  const int *tiles;
+  FloatImage **outputs;
+};
+
+}  // namespace
+
+void TiledMosaic::WarpBlend(const FloatImage &image, const Mat3 &H,
+                            float blending_ratio, int num_threads) {
+  CHECK_EQ(image.Depth(), depth_);
+  Vec2u image_size;
+  image_size << image.Width(), image.Height();
+  Vec4i bbox;
+  WarpFootprint(image_size, H, &bbox);
+  std::vector<int> tiles;
+  TouchedTiles(bbox, &tiles);
+  if (tiles.empty()) {
+    return;
+  }
+  // The tiles are allocated here, so that the threads only touch pixels.
+  std::vector<FloatImage *> outputs(tiles.size());
+  for (size_t i = 0; i < tiles.size(); ++i) {
+    outputs[i] = MutableTile(tiles[i]);
+  }
+  BlendTiles blend;
+  blend.mosaic = this;
+  blend.image = &image;
+  blend.H = H;
+  blend.bbox = bbox;
+  blend.blending_ratio = blending_ratio;
+  blend.tiles = &tiles[0];
+  blend.outputs = &outputs[0];
+  ParallelForDynamic(0, tiles.size(), num_threads, &blend);
+}
+
+void TiledMosaic::Assemble(FloatImage *mosaic) const {
+  mosaic->Resize(height_, width_, depth_);
+  mosaic->Fill(0);
+  for (int tile = 0; tile < NumTiles(); ++tile) {
+    if (!tiles_[tile]) {
+      continue;
+    }
+    int x, y, width, height;
+    TileBounds(tile, &x, &y, &width, &height);
+    for (int r = 0; r < height; ++r) {
+      std::copy(&(*tiles_[tile])(r, 0, 0), &(*tiles_[tile])(r, 0, 0)
+                + width * depth_, &(*mosaic)(y + r, x, 0));
+    }
+  }
+}
+
+}  // namespace libmv
@@ -0,0 +1,90 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+#ifndef LIBMV_IMAGE_TILED_MOSAIC_H_
+#define LIBMV_IMAGE_TILED_MOSAIC_H_
+
+#include <vector>
+
+#include "libmv/image/image.h"
+#include "libmv/numeric/numeric.h"
+
+namespace libmv {
+
+/**
+ * A mosaic canvas split into square tiles of tile_size pixels (smaller on the
+ * right and bottom edges). A tile is only allocated, black, when a frame is
+ * first blended into it, and can be released once no more frames touch it, so
+ * the memory follows the area being composited rather than the extent of the
+ * mosaic.
+ *
+ * WarpBlend() gives the same pixels as WarpImageBlend() on the whole canvas:
+ * each tile the bounding box of the warp touches is blended independently,
+ * and the tiles of a frame are processed in parallel.
+ */
+class TiledMosaic {
+ public:
+  TiledMosaic(int width, int height, int depth, int tile_size);
+  ~TiledMosaic();
+
+  int Width() const     { return width_;  }
+  int Height() const    { return height_; }
+  int Depth() const     { return depth_;  }
+  int NumTiles() const  { return tiles_.size(); }
+
+  // The tiles intersecting bbox (xmin, xmax, ymin, ymax), in mosaic pixels.
+  void TouchedTiles(const Vec4i &bbox, std::vector<int> *tiles) const;
+
+  // The tiles touched by an image of image_size (width, height) warped by H
+  // into the mosaic.
+  void TouchedTiles(const Vec2u &image_size, const Mat3 &H,
+                    std::vector<int> *tiles) const;
+
+  // Blends image warped by H into the mosaic, see WarpImageBlend().
+  void WarpBlend(const FloatImage &image, const Mat3 &H,
+                 float blending_ratio, int num_threads = 1);
+
+  // Position of the top left pixel of tile in the mosaic, and its size.
+  void TileBounds(int tile, int *x, int *y, int *width, int *height) const;
+
+  // The tile, or NULL if nothing was blended into it since it was created or
+  // released.
+  const FloatImage *Tile(int tile) const { return tiles_[tile]; }
+
+  // Frees the tile; it is black again if more frames are blended into it.
+  void ReleaseTile(int tile);
+
+  // Copies the whole mosaic into one image; released tiles are black.
+  void Assemble(FloatImage *mosaic) const;
+
+ private:
+  FloatImage *MutableTile(int tile);
+
+  int width_, height_, depth_;
+  int tile_size_;
+  int num_tile_columns_, num_tile_rows_;
+  std::vector<FloatImage *> tiles_;
+
+  TiledMosaic(const TiledMosaic &);
+  TiledMosaic &operator=(const TiledMosaic &);
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_IMAGE_TILED_MOSAIC_H_
@@ -0,0 +1,112 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+#include <vector>
+
+#include "libmv/image/image.h"
+#include "libmv/image/image_transform_linear.h"
+#include "libmv/image/tiled_mosaic.h"
+#include "testing/testing.h"
+
+using namespace libmv;
+
+namespace {
+
+void MakeFrame(int width, int height, int seed, FloatImage *frame) {
+  frame->Resize(height, width, 3);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      for (int d = 0; d < 3; ++d) {
+        (*frame)(y, x, d) = 0.1 + ((x * 7 + y * 13 + d * 5 + seed) % 17) / 20.0;
+      }
+    }
+  }
+}
+
+TEST(TiledMosaic, SameAsBlendingIntoOneImage) {
+  const int kWidth = 230, kHeight = 170;
+  Mat3 Hs[3];
+  Hs[0] << 1, 0, 10,
+           0, 1, 5,
+           0, 0, 1;
+  Hs[1] << 0.98, -0.17, 60,
+           0.17,  0.98, 30,
+           0,     0,    1;
+  Hs[2] << 1.1,  0.02, 120,
+          -0.03, 0.9,  70,
+           1e-4, 0,    1;
+  FloatImage reference(kHeight, kWidth, 3);
+  reference.Fill(0);
+  TiledMosaic mosaic(kWidth, kHeight, 3, 64);
+  EXPECT_EQ(4 * 3, mosaic.NumTiles());
+  for (int i = 0; i < 3; ++i) {
+    FloatImage frame;
+    MakeFrame(100, 80, i, &frame);
+    WarpImageBlend(frame, Hs[i], &reference, 0.7);
+    mosaic.WarpBlend(frame, Hs[i], 0.7, 1 + i);
+  }
+  FloatImage assembled;
+  mosaic.Assemble(&assembled);
+  ASSERT_EQ(kWidth, assembled.Width());
+  ASSERT_EQ(kHeight, assembled.Height());
+  for (int y = 0; y < kHeight; ++y) {
+    for (int x = 0; x < kWidth; ++x) {
+      for (int d = 0; d < 3; ++d) {
+        EXPECT_NEAR(reference(y, x, d), assembled(y, x, d), 1e-4);
+      }
+    }
+  }
+}
+
+TEST(TiledMosaic, OnlyTouchedTilesAreAllocated) {
+  TiledMosaic mosaic(300, 200, 1, 100);
+  FloatImage frame(50, 50, 1);
+  frame.Fill(1);
+  Mat3 H;
+  H << 1, 0, 120,
+       0, 1, 20,
+       0, 0, 1;
+  Vec2u frame_size(50, 50);
+  std::vector<int> tiles;
+  mosaic.TouchedTiles(frame_size, H, &tiles);
+  ASSERT_EQ(1, tiles.size());
+  EXPECT_EQ(1, tiles[0]);
+  mosaic.WarpBlend(frame, H, 0.5);
+  for (int tile = 0; tile < mosaic.NumTiles(); ++tile) {
+    EXPECT_EQ(tile == 1, mosaic.Tile(tile) != NULL);
+  }
+
+  int x, y, width, height;
+  mosaic.TileBounds(1, &x, &y, &width, &height);
+  EXPECT_EQ(100, x);
+  EXPECT_EQ(0, y);
+  EXPECT_EQ(100, width);
+  EXPECT_EQ(100, height);
+  EXPECT_EQ(1, (*mosaic.Tile(1))(30, 40, 0));
+
+  mosaic.ReleaseTile(1);
+  EXPECT_TRUE(mosaic.Tile(1) == NULL);
+
+  // Off the canvas.
+  H(0, 2) = -500;
+  mosaic.TouchedTiles(frame_size, H, &tiles);
+  EXPECT_EQ(0, tiles.size());
+}
+
+}  // namespace
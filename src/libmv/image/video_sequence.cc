@@ -0,0 +1,324 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cctype>
+
+#ifdef LIBMV_HAVE_FFMPEG
+// The FFmpeg headers are C, and expect the C99 integer macros.
+#ifndef __STDC_CONSTANT_MACROS
+#define __STDC_CONSTANT_MACROS
+#endif
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
+}
+#endif
+
+#include "libmv/base/thread.h"
+#include "libmv/image/cached_image_sequence.h"
+#include "libmv/image/video_sequence.h"
+#include "libmv/logging/logging.h"
+
+namespace libmv {
+
+bool IsVideoFile(const std::string &filename) {
+  static const char *kExtensions[] = {
+    "avi", "m4v", "mkv", "mov", "mp4", "mxf", "webm"
+  };
+  size_t dot = filename.find_last_of('.');
+  if (dot == std::string::npos) {
+    return false;
+  }
+  std::string extension = filename.substr(dot + 1);
+  for (size_t i = 0; i < extension.size(); ++i) {
+    extension[i] = tolower(extension[i]);
+  }
+  for (size_t i = 0; i < sizeof(kExtensions) / sizeof(*kExtensions); ++i) {
+    if (extension == kExtensions[i]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+#ifdef LIBMV_HAVE_FFMPEG
+
+namespace {
+
+// Frames further ahead than this are reached by seeking when the container
+// has no index telling where the keyframes are.
+const int kMaxDecodeForward = 32;
+
+class VideoImageSequence : public CachedImageSequence {
+ public:
+  VideoImageSequence(ImageCache *cache, int decode_ahead)
+      : CachedImageSequence(cache),
+        decode_ahead_(decode_ahead),
+        format_(NULL),
+        codec_(NULL),
+        frame_(NULL),
+        packet_(NULL),
+        scaler_(NULL),
+        stream_(-1),
+        num_frames_(0),
+        start_time_(0),
+        next_frame_(-1),
+        flushing_(false) {}
+
+  virtual ~VideoImageSequence() {
+    sws_freeContext(scaler_);
+    av_packet_free(&packet_);
+    av_frame_free(&frame_);
+    avcodec_free_context(&codec_);
+    avformat_close_input(&format_);
+  }
+
+  bool Open(const std::string &filename) {
+    if (avformat_open_input(&format_, filename.c_str(), NULL, NULL) < 0) {
+      LOG(ERROR) << "Cannot open the video " << filename;
+      return false;
+    }
+    if (avformat_find_stream_info(format_, NULL) < 0) {
+      LOG(ERROR) << "Cannot read the streams of " << filename;
+      return false;
+    }
+    stream_ = av_find_best_stream(format_, AVMEDIA_TYPE_VIDEO, -1, -1,
+                                  NULL, 0);
+    if (stream_ < 0) {
+      LOG(ERROR) << "No video stream in " << filename;
+      return false;
+    }
+    AVStream *stream = format_->streams[stream_];
+    const AVCodec *decoder = avcodec_find_decoder(stream->codecpar->codec_id);
+    if (!decoder) {
+      LOG(ERROR) << "No decoder for the video stream of " << filename;
+      return false;
+    }
+    codec_ = avcodec_alloc_context3(decoder);
+    if (!codec_ ||
+        avcodec_parameters_to_context(codec_, stream->codecpar) < 0) {
+      return false;
+    }
+    // Let the decoder pick its number of threads.
+    codec_->thread_count = 0;
+    if (avcodec_open2(codec_, decoder, NULL) < 0) {
+      LOG(ERROR) << "Cannot open the decoder of " << filename;
+      return false;
+    }
+    frame_ = av_frame_alloc();
+    packet_ = av_packet_alloc();
+    if (!frame_ || !packet_) {
+      return false;
+    }
+
+    time_base_ = stream->time_base;
+    frame_duration_ = av_inv_q(av_guess_frame_rate(format_, stream, NULL));
+    if (frame_duration_.num <= 0 || frame_duration_.den <= 0) {
+      LOG(ERROR) << "Unknown frame rate in " << filename;
+      return false;
+    }
+    start_time_ = stream->start_time == AV_NOPTS_VALUE ? 0 :
+                                                         stream->start_time;
+    if (stream->nb_frames > 0) {
+      num_frames_ = stream->nb_frames;
+    } else if (stream->duration != AV_NOPTS_VALUE) {
+      num_frames_ = av_rescale_q(stream->duration, time_base_,
+                                 frame_duration_);
+    } else if (format_->duration != AV_NOPTS_VALUE) {
+      num_frames_ = av_rescale_q(format_->duration, AV_TIME_BASE_Q,
+                                 frame_duration_);
+    }
+    return num_frames_ > 0;
+  }
+
+  virtual int Length() {
+    return num_frames_;
+  }
+
+  virtual Image *LoadImage(int i) {
+    MutexLock lock(&decoder_mutex_);
+    LIBMV_SCOPED_TIMER("video_sequence.decode");
+    if (!CanDecodeForwardTo(i)) {
+      Seek(i);
+    }
+    // Decode up to frame i, skipping the frames before it.
+    int index;
+    do {
+      if (!DecodeNext(&index)) {
+        LOG(ERROR) << "Cannot decode frame " << i;
+        return NULL;
+      }
+      // A missing frame i is replaced by the first one after it.
+    } while (index < i);
+    Image *image = ConvertFrame();
+
+    TaggedImageKey key(this, 0);
+    for (int ahead = 0; ahead < decode_ahead_ && next_frame_ < num_frames_;
+         ++ahead) {
+      key.second = next_frame_;
+      if (Cache()->ContainsKey(key) || !DecodeNext(&index)) {
+        break;
+      }
+      key.second = index;
+      Image *decoded = ConvertFrame();
+      Cache()->InsertAndPinSized(key, decoded, decoded->MemorySizeInBytes());
+      Cache()->Unpin(key);
+    }
+    return image;
+  }
+
+ private:
+  int64_t FramePts(int i) const {
+    return start_time_ + av_rescale_q(i, frame_duration_, time_base_);
+  }
+
+  int FrameIndex(int64_t pts) const {
+    return av_rescale_q_rnd(pts - start_time_, time_base_, frame_duration_,
+                            AV_ROUND_NEAR_INF);
+  }
+
+  // Whether decoding from the current position reaches frame i sooner than
+  // seeking: i is ahead, and the last keyframe before i is not after the
+  // next frame to decode.
+  bool CanDecodeForwardTo(int i) {
+    if (next_frame_ < 0 || i < next_frame_) {
+      return false;
+    }
+    if (i == next_frame_) {
+      return true;
+    }
+    const AVIndexEntry *keyframe = avformat_index_get_entry_from_timestamp(
+        format_->streams[stream_], FramePts(i), AVSEEK_FLAG_BACKWARD);
+    if (keyframe) {
+      return FrameIndex(keyframe->timestamp) <= next_frame_;
+    }
+    return i - next_frame_ <= kMaxDecodeForward;
+  }
+
+  void Seek(int i) {
+    LIBMV_SCOPED_TIMER("video_sequence.seek");
+    av_seek_frame(format_, stream_, FramePts(i), AVSEEK_FLAG_BACKWARD);
+    avcodec_flush_buffers(codec_);
+    flushing_ = false;
+    next_frame_ = -1;
+  }
+
+  // Decodes the next frame into frame_, and returns its index.
+  bool DecodeNext(int *index) {
+    for (;;) {
+      int status = avcodec_receive_frame(codec_, frame_);
+      if (status == 0) {
+        int64_t pts = frame_->best_effort_timestamp;
+        // Without timestamps, count the frames.
+        *index = pts != AV_NOPTS_VALUE ? FrameIndex(pts) :
+                 std::max(next_frame_, 0);
+        next_frame_ = *index + 1;
+        return true;
+      }
+      if (status != AVERROR(EAGAIN) || flushing_) {
+        return false;
+      }
+      // The decoder needs more packets of the stream.
+      if (av_read_frame(format_, packet_) < 0) {
+        // The end of the file; drain the frames the decoder holds.
+        flushing_ = true;
+        avcodec_send_packet(codec_, NULL);
+        continue;
+      }
+      if (packet_->stream_index == stream_) {
+        avcodec_send_packet(codec_, packet_);
+      }
+      av_packet_unref(packet_);
+    }
+  }
+
+  // The frame in frame_, as RGB bytes.
+  Image *ConvertFrame() {
+    int width = frame_->width, height = frame_->height;
+    scaler_ = sws_getCachedContext(
+        scaler_, width, height, static_cast<AVPixelFormat>(frame_->format),
+        width, height, AV_PIX_FMT_RGB24, SWS_BILINEAR, NULL, NULL, NULL);
+    Array3Du *rgb = new Array3Du(height, width, 3);
+    uint8_t *planes[4] = { rgb->Data(), NULL, NULL, NULL };
+    int strides[4] = { 3 * width, 0, 0, 0 };
+    sws_scale(scaler_, frame_->data, frame_->linesize, 0, height,
+              planes, strides);
+    return new Image(rgb);
+  }
+
+  int decode_ahead_;
+
+  // The decoder state, protected by decoder_mutex_.
+  Mutex decoder_mutex_;
+  AVFormatContext *format_;
+  AVCodecContext *codec_;
+  AVFrame *frame_;
+  AVPacket *packet_;
+  SwsContext *scaler_;
+  int stream_;
+  int num_frames_;
+  AVRational time_base_;
+  AVRational frame_duration_;
+  int64_t start_time_;
+  // The index of the frame the decoder gives next, or -1 after a seek.
+  int next_frame_;
+  // The end of the file was reached, and the decoder is being drained.
+  bool flushing_;
+};
+
+}  // namespace
+
+bool VideoDecodingSupported() {
+  return true;
+}
+
+ImageSequence *ImageSequenceFromVideo(const std::string &filename,
+                                      ImageCache *cache,
+                                      int decode_ahead) {
+  VideoImageSequence *sequence = new VideoImageSequence(cache, decode_ahead);
+  if (!sequence->Open(filename)) {
+    delete sequence;
+    return NULL;
+  }
+  return sequence;
+}
+
+#else  // LIBMV_HAVE_FFMPEG
+
+bool VideoDecodingSupported() {
+  return false;
+}
+
+ImageSequence *ImageSequenceFromVideo(const std::string &filename,
+                                      ImageCache *cache,
+                                      int decode_ahead) {
+  (void) cache;
+  (void) decode_ahead;
+  LOG(ERROR) << "Cannot read " << filename
+             << ": libmv was built without FFmpeg.";
+  return NULL;
+}
+
+#endif  // LIBMV_HAVE_FFMPEG
+
+}  // namespace libmv
@@ -0,0 +1,62 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_IMAGE_VIDEO_SEQUENCE_H_
+#define LIBMV_IMAGE_VIDEO_SEQUENCE_H_
+
+#include <string>
+
+#include "libmv/image/image_sequence.h"
+
+namespace libmv {
+
+class ImageCache;
+
+// Whether the extension of filename is that of a video container read by
+// ImageSequenceFromVideo(): .avi, .m4v, .mkv, .mov, .mp4, .mxf or .webm.
+bool IsVideoFile(const std::string &filename);
+
+// Whether ImageSequenceFromVideo() can decode anything, i.e. the library was
+// built with FFmpeg (WITH_FFMPEG in CMake).
+bool VideoDecodingSupported();
+
+// An image sequence over the frames of the video stream of a container,
+// decoded by FFmpeg into BYTE RGB images; use GetFloatImage() for floats.
+//
+// The frames are decoded as a stream: asking for the frame after the last one
+// decoded only decodes that frame, as does asking for a frame a little ahead
+// when no keyframe lies in between. Other frames are reached by seeking to
+// the last keyframe before them and decoding forward from there. Each time a
+// frame is decoded, the decode_ahead frames after it are decoded as well and
+// left unpinned in the cache, since they cost little more than the frame
+// itself; to decode them on a thread of their own instead, wrap the sequence
+// with PipelineSequence().
+//
+// The frames are numbered from the frame rate of the stream, so streams with
+// a variable frame rate get approximate numbers. Decoding is serialized, so
+// the sequence can be used by several threads. Returns NULL if the file has
+// no video stream that can be decoded, or without FFmpeg.
+ImageSequence *ImageSequenceFromVideo(const std::string &filename,
+                                      ImageCache *cache,
+                                      int decode_ahead = 0);
+
+}  // namespace libmv
+
+#endif  // LIBMV_IMAGE_VIDEO_SEQUENCE_H_
@@ -0,0 +1,46 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/base/scoped_ptr.h"
+#include "libmv/image/cached_image_sequence.h"
+#include "libmv/image/video_sequence.h"
+#include "testing/testing.h"
+
+using namespace libmv;
+
+namespace {
+
+TEST(VideoSequence, IsVideoFile) {
+  EXPECT_TRUE(IsVideoFile("shot.mov"));
+  EXPECT_TRUE(IsVideoFile("/footage/shot.v2.MP4"));
+  EXPECT_TRUE(IsVideoFile("shot.webm"));
+  EXPECT_FALSE(IsVideoFile("shot.0001.png"));
+  EXPECT_FALSE(IsVideoFile("mov"));
+  EXPECT_FALSE(IsVideoFile("shot.mov.txt"));
+}
+
+TEST(VideoSequence, MissingFile) {
+  ImageCache cache;
+  scoped_ptr<ImageSequence> sequence(
+      ImageSequenceFromVideo("/nonexistent/shot.mov", &cache));
+  EXPECT_TRUE(sequence.get() == NULL);
+}
+
+}  // namespace
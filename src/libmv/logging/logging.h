@@ -28,4 +28,56 @@
 #define V1 LOG(INFO)
 #define V2 LOG(INFO)
 
+// Instrumentation of the hot paths, recorded only when LIBMV_INSTRUMENTATION
+// is defined (the WITH_INSTRUMENTATION build option) and printed when the
+// process exits; otherwise the macros expand to nothing and their arguments
+// are not evaluated. The names are string literals, the statistics of the
+// same name being shared:
+//
+//   void Track(...) {
+//     LIBMV_SCOPED_TIMER("klt.track");  // Time of the enclosing scope.
+//     ...
+//     LIBMV_COUNTER("klt.lost_features", num_lost);
+//     LIBMV_HISTOGRAM("klt.iterations", iterations);
+//   }
+//
+// The statistics are looked up once per call site, so that recording costs
+// an atomic addition for a counter, and a lock for a histogram or a timer.
+#ifdef LIBMV_INSTRUMENTATION
+
+#include "libmv/base/instrumentation.h"
+
+#define LIBMV_INSTRUMENTATION_CONCAT_(a, b) a ## b
+#define LIBMV_INSTRUMENTATION_CONCAT(a, b) LIBMV_INSTRUMENTATION_CONCAT_(a, b)
+
+#define LIBMV_SCOPED_TIMER(name) \
+  static ::libmv::instrumentation::Histogram * \
+      LIBMV_INSTRUMENTATION_CONCAT(libmv_timer_, __LINE__) = \
+      ::libmv::instrumentation::GetTimer(name); \
+  ::libmv::instrumentation::ScopedTimer \
+      LIBMV_INSTRUMENTATION_CONCAT(libmv_scoped_timer_, __LINE__)( \
+          LIBMV_INSTRUMENTATION_CONCAT(libmv_timer_, __LINE__))
+
+#define LIBMV_COUNTER(name, amount) \
+  do { \
+    static ::libmv::instrumentation::Counter *libmv_counter = \
+        ::libmv::instrumentation::GetCounter(name); \
+    libmv_counter->Add(amount); \
+  } while (0)
+
+#define LIBMV_HISTOGRAM(name, value) \
+  do { \
+    static ::libmv::instrumentation::Histogram *libmv_histogram = \
+        ::libmv::instrumentation::GetHistogram(name); \
+    libmv_histogram->Add(value); \
+  } while (0)
+
+#else  // LIBMV_INSTRUMENTATION
+
+#define LIBMV_SCOPED_TIMER(name)
+#define LIBMV_COUNTER(name, amount) do {} while (0)
+#define LIBMV_HISTOGRAM(name, value) do {} while (0)
+
+#endif  // LIBMV_INSTRUMENTATION
+
 #endif  // LIBMV_LOGGING_LOGGING_H
@@ -20,6 +20,7 @@
 
 #include "libmv/multiview/affine_kernel.h"
 #include "libmv/multiview/affine.h"
+#include "libmv/multiview/affine_parameterization.h"
 
 namespace libmv {
 namespace affine {
@@ -33,6 +34,33 @@ void ThreePointSolver::Solve(const Mat &x1, const Mat &x2, vector<Mat3> *Hs) {
   }
 }
 
+// Same system as Affine2DFromCorrespondencesLinear(), with fixed sizes.
+void ThreePointSolver::SolveMinimal(const MinimalSample &x1,
+                                    const MinimalSample &x2,
+                                    vector<Mat3> *Hs) {
+  Eigen::Matrix<double, 6, 6> A = Eigen::Matrix<double, 6, 6>::Zero();
+  Vec6 b;
+  for (int i = 0; i < MINIMUM_SAMPLES; ++i) {
+    const int j = i * 2;
+    A(j, 0) = x1(0, i);
+    A(j, 1) = x1(1, i);
+    A(j, 4) = 1.0;
+
+    A(j + 1, 2) = x1(0, i);
+    A(j + 1, 3) = x1(1, i);
+    A(j + 1, 5) = 1.0;
+
+    b(j)     = x2(0, i);
+    b(j + 1) = x2(1, i);
+  }
+  Vec6 x = A.fullPivLu().solve(b);
+  if ((A * x).isApprox(b)) {
+    Mat3 M;
+    Affine2DGenericParameterization<double>::To(x, &M);
+    Hs->push_back(M);
+  }
+}
+
 }  // namespace kernel
 }  // namespace affine2D
 }  // namespace affine
@@ -34,6 +34,11 @@ namespace kernel {
 struct ThreePointSolver {
   enum { MINIMUM_SAMPLES = 3 };
   static void Solve(const Mat &x1, const Mat &x2, vector<Mat3> *Hs);
+
+  typedef Matrix<double, 2, MINIMUM_SAMPLES> MinimalSample;
+  static void SolveMinimal(const MinimalSample &x1,
+                           const MinimalSample &x2,
+                           vector<Mat3> *Hs);
 };
 
 typedef two_view::kernel::Kernel<
@@ -46,8 +51,25 @@ typedef two_view::kernel::Kernel<
         UnnormalizerI>,
         homography::homography2D::AsymmetricError,
         Mat3>
+  NormalizedKernel;
+
+// The points are normalized once, when the kernel is built.
+typedef two_view::kernel::PrenormalizedKernel<
+        affine2D::kernel::ThreePointSolver,
+        UnnormalizerI,
+        homography::homography2D::AsymmetricError,
+        Mat3>
   Kernel;
 
+// Fits affinities to single correspondences of local affine frames (see
+// two_view::kernel::AffineFrameKernel).
+typedef two_view::kernel::AffineFrameKernel<
+        two_view::kernel::NormalizedSolver<affine2D::kernel::ThreePointSolver,
+        UnnormalizerI>,
+        homography::homography2D::AsymmetricError,
+        Mat3>
+  AffineFrameKernel;
+
 }  // namespace kernel
 }  // namespace affine2D
 }  // namespace affine
@@ -36,6 +36,7 @@ struct AffineKernelTest : public testing::Test {
 };
 
 typedef Types<Kernel,
+              NormalizedKernel,
               UnnormalizedKernel>
   AffineKernelImplementations;
 
@@ -84,4 +85,27 @@ TYPED_TEST(AffineKernelTest, Fitting) {
   }
 }
 
+TYPED_TEST(AffineKernelTest, MinimalSample) {
+  Mat3 H_gt;
+  H_gt << 1, -2,  3,
+          4,  5, -6,
+          0,  0,  1;
+  Mat x(2, 5), xh;
+  x << 0, 2, 1, 0, 2,
+       0, 0, 1, 2, 1;
+  EuclideanToHomogeneous(x, &xh);
+  Mat y, yh = H_gt * xh;
+  HomogeneousToEuclidean(yh, &y);
+
+  TypeParam kernel(x, y);
+  vector<int> samples;
+  samples.push_back(4);
+  samples.push_back(0);
+  samples.push_back(3);
+  vector<Mat3> Hs;
+  kernel.Fit(samples, &Hs);
+  ASSERT_EQ(1, Hs.size());
+  EXPECT_MATRIX_PROP(H_gt, Hs[0], 5e-8);
+}
+
 }  // namespace
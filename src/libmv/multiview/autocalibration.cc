@@ -52,21 +52,40 @@ void K_From_AbsoluteConic(const Mat3 &W, Mat3 *K) {
   }
 }
 
+AutoCalibrationLinear::AutoCalibrationLinear()
+    : normal_equations_(NormalEquations::Zero()) {
+}
+
 int AutoCalibrationLinear::AddProjection(const Mat34 &P,
                                          double width, double height) {
   Mat34 P_normalized;
   NormalizeProjection(P, width, height, &P_normalized);
 
-  AddProjectionConstraints(P_normalized);
+  ProjectionConstraints constraints;
+  ProjectionConstraintsFromProjection(P_normalized, &constraints);
+  normal_equations_ += constraints.transpose() * constraints;
 
   // Store input
   projections_.push_back(P_normalized);
   widths_.push_back(width);
   heights_.push_back(height);
+  constraints_.push_back(constraints);
+  weights_.push_back(1);
   
   return projections_.size() - 1;
 }
 
+void AutoCalibrationLinear::RemoveProjection(int index) {
+  SetProjectionWeight(index, 0);
+}
+
+void AutoCalibrationLinear::SetProjectionWeight(int index, double weight) {
+  CHECK(0 <= index && index < NumProjections());
+  const ProjectionConstraints &C = constraints_[index];
+  normal_equations_ += (weight - weights_[index]) * (C.transpose() * C);
+  weights_[index] = weight;
+}
+
 // TODO(pau): make this generic and move it to numeric.h
 static void SortEigenVectors(const Vec &values,
                              const Mat &vectors,
@@ -88,15 +107,17 @@ static void SortEigenVectors(const Vec &values,
   }
 }
 
+Vec10 AutoCalibrationLinear::AbsoluteQuadricVec() const {
+  // The least squares solution of A q = 0, |q| = 1, is the eigen vector of
+  // A^T A of smallest eigen value; the solver sorts them in increasing order.
+  Eigen::SelfAdjointEigenSolver<NormalEquations> eigen_solver(
+      normal_equations_);
+  return eigen_solver.eigenvectors().col(0);
+}
+
 Mat4 AutoCalibrationLinear::MetricTransformation() {
   // Compute the dual absolute quadric, Q.
-  Mat A(constraints_.size(), 10);
-  for (int i = 0; i < A.rows(); ++i) {
-    A.row(i) = constraints_[i];
-  }
-  Vec q;
-  Nullspace(&A, &q);
-  Mat4 Q = AbsoluteQuadricMatFromVec(q);
+  Mat4 Q = AbsoluteQuadricMatFromVec(AbsoluteQuadricVec());
   // TODO(pau) force rank 3.
 
   // Compute a transformation to a metric frame by decomposing Q.
@@ -127,22 +148,61 @@ Mat4 AutoCalibrationLinear::MetricTransformation() {
   return H;
 }
 
-void AutoCalibrationLinear::AddProjectionConstraints(const Mat34 &P) {
+// The residual of the constraints of a projection, which does not depend on
+// the scale of the projection matrix.
+static double RelativeResidual(const Eigen::Matrix<double, 6, 10> &C,
+                               const Vec10 &q) {
+  return (C * q).norm() / C.norm();
+}
+
+Mat4 AutoCalibrationLinear::RobustMetricTransformation(int num_iterations) {
+  vector<double> residuals;
+  for (int iteration = 0; iteration < num_iterations; ++iteration) {
+    Vec10 q = AbsoluteQuadricVec();
+    residuals.clear();
+    for (int i = 0; i < NumProjections(); ++i) {
+      if (weights_[i] > 0) {
+        residuals.push_back(RelativeResidual(constraints_[i], q));
+      }
+    }
+    if (residuals.size() == 0) {
+      break;
+    }
+    std::nth_element(residuals.begin(),
+                     residuals.begin() + residuals.size() / 2,
+                     residuals.end());
+    // The median residual, as a robust estimate of the residuals scale.
+    double scale = residuals[residuals.size() / 2];
+    if (scale <= 0) {
+      break;
+    }
+    for (int i = 0; i < NumProjections(); ++i) {
+      if (weights_[i] > 0) {
+        double r = RelativeResidual(constraints_[i], q) / scale;
+        SetProjectionWeight(i, 1 / (1 + r * r));
+      }
+    }
+  }
+  return MetricTransformation();
+}
+
+void AutoCalibrationLinear::ProjectionConstraintsFromProjection(
+    const Mat34 &P, ProjectionConstraints *constraints) {
   double nu = 1;
   
   // Non-extreme focal lenght.
-  constraints_.push_back((wc(P, 0, 0) - wc(P, 2, 2)) / 9 / nu);
-  constraints_.push_back((wc(P, 1, 1) - wc(P, 2, 2)) / 9 / nu);
+  constraints->row(0) = (wc(P, 0, 0) - wc(P, 2, 2)) / 9 / nu;
+  constraints->row(1) = (wc(P, 1, 1) - wc(P, 2, 2)) / 9 / nu;
 
   // Aspect ratio is near 1.
-  constraints_.push_back((wc(P, 0, 0) - wc(P, 1, 1)) / 0.2 / nu);
+  constraints->row(2) = (wc(P, 0, 0) - wc(P, 1, 1)) / 0.2 / nu;
 
   // No skew and principal point near 0,0.
   // Note that there is a typo in the Pollefeys' paper: the 0.01 is not at the
   // correct equation.
-  constraints_.push_back(wc(P, 0, 1) / 0.01 / nu);
-  constraints_.push_back(wc(P, 0, 2) / 0.1 / nu);
-  constraints_.push_back(wc(P, 1, 2) / 0.1 / nu);
+  constraints->row(3) = wc(P, 0, 1) / 0.01 / nu;
+  constraints->row(4) = wc(P, 0, 2) / 0.1 / nu;
+  constraints->row(5) = wc(P, 1, 2) / 0.1 / nu;
 }
 
 Vec AutoCalibrationLinear::wc(const Mat34 &P, int i, int j) {
@@ -42,9 +42,16 @@ void K_From_AbsoluteConic(const Mat3 &W, Mat3 *K);
  * [1] M. Pollefeys, L. Van Gool, M. Vergauwen, F. Verbiest, K. Cornelis,
  *     J. Tops, R. Koch, "Visual modeling with a hand-held camera",
  *     International Journal of Computer Vision 59(3), 207-232, 2004.
+ *
+ * The constraints of all the projections are accumulated in the 10x10 normal
+ * equations A^T W A of the weighted system, so that adding, removing or
+ * reweighting a projection is O(1) and a query only solves a 10x10 symmetric
+ * eigenproblem whatever the number of projections.
  */
 class AutoCalibrationLinear {
  public:
+  AutoCalibrationLinear();
+
   /** \brief Add a projection to be used for autocalibration.
    *
    *  \param P The projection matrix.
@@ -55,6 +62,23 @@ class AutoCalibrationLinear {
    *  matrix for improving numerical stability.  The don't need to be exact.
    */
   int AddProjection(const Mat34 &P, double width, double height);
+
+  /** \brief Removes the constraints of the projection index.
+   *
+   *  The indices of the other projections are unchanged.
+   */
+  void RemoveProjection(int index);
+
+  /** \brief Scales the constraints of the projection index by weight.
+   *
+   *  The projections are added with a weight of 1; a null weight ignores the
+   *  projection.
+   */
+  void SetProjectionWeight(int index, double weight);
+
+  double ProjectionWeight(int index) const { return weights_[index]; }
+
+  int NumProjections() const { return projections_.size(); }
   
   /** \brief Computes the metric updating transformation.
    *
@@ -66,13 +90,33 @@ class AutoCalibrationLinear {
    */
   Mat4 MetricTransformation();
 
+  /** \brief Same as MetricTransformation() but robust to the projections
+   *         that do not fit the assumptions on the intrinsic parameters.
+   *
+   *  The weights of the projections are computed by iteratively reweighted
+   *  least squares, with a Cauchy function of the residuals of the
+   *  constraints of each projection scaled by their median. The weights are
+   *  kept, the removed projections still being ignored.
+   */
+  Mat4 RobustMetricTransformation(int num_iterations = 5);
+
  private:
-  /** \brief Add constraints on the absolute quadric based assumptions on the
-   *         parameters of one camera.
+  typedef Eigen::Matrix<double, 6, 10> ProjectionConstraints;
+  typedef Eigen::Matrix<double, 10, 10> NormalEquations;
+
+  /** \brief Computes the absolute quadric, as a vector, minimizing the
+   *         weighted constraints.
+   */
+  Vec10 AbsoluteQuadricVec() const;
+
+  /** \brief Computes the constraints on the absolute quadric based on
+   *         assumptions on the parameters of one camera.
    *
    *  \param P The projection matrix of the camera in projective coordinates.
+   *  \param constraints The six constraints, one per row.
    */
-  void AddProjectionConstraints(const Mat34 &P);
+  static void ProjectionConstraintsFromProjection(
+      const Mat34 &P, ProjectionConstraints *constraints);
 
   /** \brief Computes the constraint associated to elements of the DIAC.
    *
@@ -102,7 +146,12 @@ class AutoCalibrationLinear {
   vector<Mat34> projections_; // The *normalized* projection matrices.
   vector<double> widths_;
   vector<double> heights_;
-  vector<Vec> constraints_;  // Linear constraints on q.
+  vector<ProjectionConstraints> constraints_;  // Linear constraints on q.
+  vector<double> weights_;
+  NormalEquations normal_equations_;  // The sum of w C^T C.
+
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
 
 } // namespace libmv
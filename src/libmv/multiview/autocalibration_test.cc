@@ -138,4 +138,72 @@ TEST(AutoCalibrationLinear, RandomInput) {
 }
 
 
+// Cameras seeing the space through H_real, the intrinsics of the outliers
+// being far from the assumptions of the linear autocalibration.
+void AddDistortedCameras(const Mat3 &K, const Mat4 &H_real, int num_cams,
+                         double width, double height,
+                         AutoCalibrationLinear *a, vector<Mat34> *Ps) {
+  for (int i = 0; i < num_cams; ++i) {
+    Mat3 R = RotationAroundX(double(rand()) / RAND_MAX * 3)
+           * RotationAroundY(double(rand()) / RAND_MAX * 3)
+           * RotationAroundZ(double(rand()) / RAND_MAX * 3);
+    Vec3 t(double(rand()) / RAND_MAX,
+           double(rand()) / RAND_MAX,
+           double(rand()) / RAND_MAX);
+    Mat34 P_metric;
+    P_From_KRt(K, R, t, &P_metric);
+    Ps->push_back(P_metric * H_real.inverse());
+    a->AddProjection(Ps->back(), width, height);
+  }
+}
+
+void ExpectIntrinsics(const Mat3 &K, const vector<Mat34> &Ps, int num_cams,
+                      const Mat4 &H_computed) {
+  for (int i = 0; i < num_cams; ++i) {
+    Mat34 P_metric = Ps[i] * H_computed;  // Undistort cameras.
+    Mat3 K_computed, R;
+    Vec3 t;
+    KRt_From_P(P_metric, &K_computed, &R, &t);
+    EXPECT_MATRIX_NEAR(K, K_computed, 10);
+  }
+}
+
+TEST(AutoCalibrationLinear, RemovedAndReweightedProjections) {
+  const int num_cams = 10, num_outliers = 4;
+  double width = 1000, height = 800;
+  Mat3 K, K_outlier;
+  K << width,     0,  width / 2,
+           0, width, height / 2,
+           0,     0,          1;
+  K_outlier << 0.2 * width, 0.1 * width, 0.9 * width,
+                         0, 0.4 * width, 0.1 * height,
+                         0,           0,           1;
+  Mat4 H_real;
+  H_real << 1,  0, -4,  2,
+            1, -1,  1, -7,
+           -4,  0,  2,  0,
+            1,  2,  3,  1;
+
+  AutoCalibrationLinear a;
+  vector<Mat34> Ps;
+  AddDistortedCameras(K, H_real, num_cams, width, height, &a, &Ps);
+  AddDistortedCameras(K_outlier, H_real, num_outliers, width, height, &a, &Ps);
+  EXPECT_EQ(num_cams + num_outliers, a.NumProjections());
+
+  // Robust reweighting downweights the outliers.
+  AutoCalibrationLinear robust = a;
+  ExpectIntrinsics(K, Ps, num_cams, robust.RobustMetricTransformation());
+  for (int i = num_cams; i < num_cams + num_outliers; ++i) {
+    for (int j = 0; j < num_cams; ++j) {
+      EXPECT_LT(robust.ProjectionWeight(i), robust.ProjectionWeight(j));
+    }
+  }
+
+  // Without the outliers, the inliers are enough.
+  for (int i = num_cams; i < num_cams + num_outliers; ++i) {
+    a.RemoveProjection(i);
+  }
+  ExpectIntrinsics(K, Ps, num_cams, a.MetricTransformation());
+}
+
 } // namespace
@@ -0,0 +1,123 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <Eigen/Eigenvalues>
+
+#include "libmv/base/thread.h"
+#include "libmv/logging/logging.h"
+#include "libmv/multiview/batch_triangulation.h"
+
+namespace libmv {
+namespace {
+
+struct PointTriangulator {
+  void operator()(int i) const {
+    // Normal equations of the algebraic design matrix; each view contributes
+    // the two rows of [x]_x P, scaled to unit norm.
+    Mat4 A = Mat4::Zero();
+    for (int j = (*offsets)[i]; j < (*offsets)[i + 1]; ++j) {
+      const Mat34 &P = (*Ps)[(*cameras)[j]];
+      Vec4 rows[2];
+      rows[0] = x->coeff(1, j) * P.row(2) - P.row(1);
+      rows[1] = P.row(0) - x->coeff(0, j) * P.row(2);
+      for (int k = 0; k < 2; ++k) {
+        double norm = rows[k].norm();
+        if (norm > 0) {
+          rows[k] /= norm;
+        }
+        A += rows[k] * rows[k].transpose();
+      }
+    }
+    Eigen::SelfAdjointEigenSolver<Mat4> solver(A);
+    Vec4 X_i = solver.eigenvectors().col(0);
+    X->col(i) = X_i;
+
+    double squared_error = 0;
+    int behind = 0;
+    for (int j = (*offsets)[i]; j < (*offsets)[i + 1]; ++j) {
+      const Mat34 &P = (*Ps)[(*cameras)[j]];
+      Vec3 projected = P * X_i;
+      squared_error += (projected.head<2>() / projected(2) -
+                        x->col(j)).squaredNorm();
+      if (projected(2) * X_i(3) * (*camera_signs)[(*cameras)[j]] <= 0) {
+        ++behind;
+      }
+    }
+    int num_views = (*offsets)[i + 1] - (*offsets)[i];
+    if (rms_errors) {
+      (*rms_errors)(i) = num_views ? sqrt(squared_error / num_views) : 0;
+    }
+    if (num_behind) {
+      (*num_behind)[i] = behind;
+    }
+  }
+
+  const vector<Mat34> *Ps;
+  const vector<int> *offsets;
+  const vector<int> *cameras;
+  const Mat2X *x;
+  // The sign of the determinant of the left 3x3 block of each camera, which
+  // makes the depths of the points in front of it positive.
+  const vector<double> *camera_signs;
+  Mat4X *X;
+  Vec *rms_errors;
+  vector<int> *num_behind;
+};
+
+}  // namespace
+
+void TriangulatePoints(const vector<Mat34> &Ps,
+                       const vector<int> &offsets,
+                       const vector<int> &cameras,
+                       const Mat2X &x,
+                       int num_threads,
+                       Mat4X *X,
+                       Vec *rms_errors,
+                       vector<int> *num_behind) {
+  CHECK(offsets.size() > 0);
+  CHECK(cameras.size() == x.cols());
+  CHECK(offsets[offsets.size() - 1] == x.cols());
+  int num_points = offsets.size() - 1;
+  X->resize(4, num_points);
+  if (rms_errors) {
+    rms_errors->resize(num_points);
+  }
+  if (num_behind) {
+    num_behind->resize(num_points);
+  }
+
+  vector<double> camera_signs(Ps.size());
+  for (int i = 0; i < Ps.size(); ++i) {
+    camera_signs[i] = Ps[i].block<3, 3>(0, 0).determinant() < 0 ? -1 : 1;
+  }
+
+  PointTriangulator triangulator;
+  triangulator.Ps = &Ps;
+  triangulator.offsets = &offsets;
+  triangulator.cameras = &cameras;
+  triangulator.x = &x;
+  triangulator.camera_signs = &camera_signs;
+  triangulator.X = X;
+  triangulator.rms_errors = rms_errors;
+  triangulator.num_behind = num_behind;
+  ParallelFor(0, num_points, num_threads, &triangulator);
+}
+
+}  // namespace libmv
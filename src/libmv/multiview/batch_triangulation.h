@@ -0,0 +1,57 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_MULTIVIEW_BATCH_TRIANGULATION_H_
+#define LIBMV_MULTIVIEW_BATCH_TRIANGULATION_H_
+
+#include "libmv/base/vector.h"
+#include "libmv/numeric/numeric.h"
+
+namespace libmv {
+
+// Triangulate many points at once, e.g. all the tracks of a reconstruction.
+//
+// The observations are given as a compressed sparse row list: the
+// observations of point i are the columns [offsets[i], offsets[i + 1]) of x,
+// and cameras[j] is the index in Ps of the camera of observation j. Hence
+// offsets has one more element than there are points.
+//
+// Each point is triangulated with the algebraic method of
+// NViewTriangulateAlgebraic(), with the rows of the design matrix normalized,
+// by a 4x4 fixed size solve whatever its number of views. The points are split
+// between num_threads threads.
+//
+// In the same pass, the RMS reprojection error of each point (in the units of
+// x) is stored in rms_errors, and the number of its views in which it does not
+// have a positive depth (see Depth()) in num_behind; a point is in front of
+// all its cameras if num_behind is 0. Both rms_errors and num_behind can be
+// NULL.
+void TriangulatePoints(const vector<Mat34> &Ps,
+                       const vector<int> &offsets,
+                       const vector<int> &cameras,
+                       const Mat2X &x,
+                       int num_threads,
+                       Mat4X *X,
+                       Vec *rms_errors = NULL,
+                       vector<int> *num_behind = NULL);
+
+}  // namespace libmv
+
+#endif  // LIBMV_MULTIVIEW_BATCH_TRIANGULATION_H_
@@ -0,0 +1,113 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/base/vector.h"
+#include "libmv/multiview/batch_triangulation.h"
+#include "libmv/multiview/projection.h"
+#include "libmv/multiview/test_data_sets.h"
+#include "libmv/numeric/numeric.h"
+#include "testing/testing.h"
+
+namespace {
+
+using namespace libmv;
+
+// Point i is seen by the views [i % nviews, nviews), i.e. by 1 to nviews views.
+void MakeObservations(NViewDataSet &d, int nviews, int npoints,
+                      vector<Mat34> *Ps,
+                      vector<int> *offsets,
+                      vector<int> *cameras,
+                      Mat2X *x) {
+  Ps->resize(nviews);
+  for (int j = 0; j < nviews; ++j) {
+    (*Ps)[j] = d.P(j);
+  }
+  offsets->resize(npoints + 1);
+  int num_observations = 0;
+  for (int i = 0; i < npoints; ++i) {
+    num_observations += nviews - i % nviews;
+  }
+  cameras->resize(num_observations);
+  x->resize(2, num_observations);
+  int k = 0;
+  for (int i = 0; i < npoints; ++i) {
+    (*offsets)[i] = k;
+    for (int j = i % nviews; j < nviews; ++j, ++k) {
+      (*cameras)[k] = j;
+      x->col(k) = d.x[j].col(i);
+    }
+  }
+  (*offsets)[npoints] = k;
+}
+
+TEST(TriangulatePoints, MatchesTheTruePoints) {
+  int nviews = 4;
+  int npoints = 40;
+  NViewDataSet d = NRealisticCamerasFull(nviews, npoints);
+  vector<Mat34> Ps;
+  vector<int> offsets, cameras;
+  Mat2X x;
+  MakeObservations(d, nviews, npoints, &Ps, &offsets, &cameras, &x);
+
+  Mat4X X;
+  Vec rms_errors;
+  vector<int> num_behind;
+  TriangulatePoints(Ps, offsets, cameras, x, 1, &X, &rms_errors, &num_behind);
+  ASSERT_EQ(npoints, X.cols());
+  for (int i = 0; i < npoints; ++i) {
+    if (i % nviews == nviews - 1) {
+      // A single view does not constrain the depth.
+      continue;
+    }
+    Vec3 X_i = X.col(i).head<3>() / X(3, i);
+    EXPECT_MATRIX_NEAR(d.X.col(i), X_i, 1e-7);
+    EXPECT_NEAR(0, rms_errors(i), 1e-7);
+    EXPECT_EQ(0, num_behind[i]);
+  }
+
+  // The threads do not change the results.
+  Mat4X X_threads;
+  Vec rms_errors_threads;
+  TriangulatePoints(Ps, offsets, cameras, x, 3, &X_threads,
+                    &rms_errors_threads);
+  EXPECT_MATRIX_NEAR(X, X_threads, 0);
+  EXPECT_MATRIX_NEAR(rms_errors, rms_errors_threads, 0);
+}
+
+TEST(TriangulatePoints, PointBehindACamera) {
+  int nviews = 3;
+  NViewDataSet d = NRealisticCamerasFull(nviews, 1);
+  // Move the point behind the first camera, and keep its images consistent.
+  d.X.col(0) = d.C[0] + 0.5 * (d.C[0] - d.X.col(0));
+  d.Reproject();
+  vector<Mat34> Ps;
+  vector<int> offsets, cameras;
+  Mat2X x;
+  MakeObservations(d, nviews, 1, &Ps, &offsets, &cameras, &x);
+
+  Mat4X X;
+  Vec rms_errors;
+  vector<int> num_behind;
+  TriangulatePoints(Ps, offsets, cameras, x, 1, &X, &rms_errors, &num_behind);
+  EXPECT_NEAR(0, rms_errors(0), 1e-7);
+  EXPECT_LT(0, num_behind[0]);
+}
+
+}  // namespace
@@ -23,6 +23,7 @@
 #include <map>
 
 #include "libmv/multiview/bundle.h"
+#include "libmv/multiview/sparse_bundle.h"
 #include "libmv/numeric/numeric.h"
 #include "libmv/logging/logging.h"
 #include "third_party/ssba/Math/v3d_linear.h"
@@ -71,15 +72,60 @@ uint ConvertTypeV3D(eLibmvBundleType type) {
   return 0;
 }
 
+// Metric bundle adjustment (the calibrations are not refined) with the
+// native sparse adjuster. x_ids is NULL if all the points are seen in all the
+// images.
+static double MetricBA(const vector<Mat2X> &x,
+                       const vector<Vecu> *x_ids,
+                       vector<Mat3> *Ks,
+                       vector<Mat3> *Rs,
+                       vector<Vec3> *ts,
+                       Mat3X *X,
+                       int num_threads) {
+  int num_cameras = Rs->size();
+  int num_points = X->cols();
+  assert(x.size() == num_cameras);
+
+  SparseBundleAdjuster bundle;
+  vector<Vec3> points(num_points);
+  for (int j = 0; j < num_points; ++j) {
+    points[j] = X->col(j);
+    bundle.AddPoint(&points[j]);
+  }
+  for (int i = 0; i < num_cameras; ++i) {
+    bundle.AddCamera((*Ks)[i], &(*Rs)[i], &(*ts)[i]);
+    for (int k = 0; k < x[i].cols(); ++k) {
+      int j = x_ids ? (*x_ids)[i][k] : k;
+      assert(j < num_points);
+      bundle.AddObservation(i, j, x[i].col(k));
+    }
+  }
+  VLOG(3) << "mean reprojection error (in pixels): "
+          << bundle.RootMeanSquareError();
+  SparseBundleAdjuster::Options options;
+  options.num_threads = num_threads;
+  double rms = bundle.Solve(options);
+  VLOG(3) << "mean reprojection error (in pixels): " << rms;
+  for (int j = 0; j < num_points; ++j) {
+    X->col(j) = points[j];
+  }
+  return rms;
+}
 
 void EuclideanBAFull(const vector<Mat2X> &x,
                      vector<Mat3> *Ks,
                      vector<Mat3> *Rs,
                      vector<Vec3> *ts,
                      Mat3X *X,
-                     eLibmvBundleType type) {
+                     eLibmvBundleType type,
+                     int num_threads) {
   using namespace V3D;
 
+  if (type == eBUNDLE_METRIC) {
+    MetricBA(x, NULL, Ks, Rs, ts, X, num_threads);
+    return;
+  }
+
   int mode = ConvertTypeV3D(type);
 
   //////////////////////////////////////////////////
@@ -234,9 +280,14 @@ double EuclideanBA(const vector<Mat2X> &x,
                    vector<Mat3> *Rs,
                    vector<Vec3> *ts,
                    Mat3X *X,
-                   eLibmvBundleType type) {
+                   eLibmvBundleType type,
+                   int num_threads) {
   using namespace V3D;
 
+  if (type == eBUNDLE_METRIC) {
+    return MetricBA(x, &x_ids, Ks, Rs, ts, X, num_threads);
+  }
+
   int mode = ConvertTypeV3D(type);
 
   //////////////////////////////////////////////////
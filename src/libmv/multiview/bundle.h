@@ -49,16 +49,20 @@ enum eLibmvBundleType
  * \param[in/out] ts The translation vectors.
  * \param[in/out] X  The point structure.
  * \param[in]     type  The type of bundle (instrinsic parameters)
+ * \param[in]     num_threads  Threads assembling the normal equations
  *
  * All the points are assumed to be observed in all images.
  * We use the convention x = Ks * (Rs * X + ts).
+ * With eBUNDLE_METRIC the calibrations are kept and SparseBundleAdjuster is
+ * used instead of SSBA; num_threads only applies to this mode.
  */
 void EuclideanBAFull(const vector<Mat2X> &x,
                      vector<Mat3> *Ks,
                      vector<Mat3> *Rs,
                      vector<Vec3> *ts,
                      Mat3X *X,
-                     eLibmvBundleType type = eBUNDLE_FOCAL_LENGTH);
+                     eLibmvBundleType type = eBUNDLE_FOCAL_LENGTH,
+                     int num_threads = 1);
 
 /**
  * \brief Euclidean bundle adjustment given a full observation.
@@ -76,10 +80,13 @@ void EuclideanBAFull(const vector<Mat2X> &x,
  * \param[in/out] ts The translation vectors.
  * \param[in/out] X  The point structure.
  * \param[in]     type  The type of bundle (instrinsic parameters)
+ * \param[in]     num_threads  Threads assembling the normal equations
  * \return        rms The root mean square error
  *
  * All the points are assumed to be observed in all images.
  * We use the convention x = Ks * (Rs * X + ts).
+ * With eBUNDLE_METRIC the calibrations are kept and SparseBundleAdjuster is
+ * used instead of SSBA; num_threads only applies to this mode.
  */
 double EuclideanBA(const vector<Mat2X> &x,
                    const vector<Vecu> &x_ids,
@@ -87,7 +94,8 @@ double EuclideanBA(const vector<Mat2X> &x,
                    vector<Mat3> *Rs,
                    vector<Vec3> *ts,
                    Mat3X *X,
-                   eLibmvBundleType type = eBUNDLE_FOCAL_LENGTH);
+                   eLibmvBundleType type = eBUNDLE_FOCAL_LENGTH,
+                   int num_threads = 1);
                                                   
 } // namespace libmv
 
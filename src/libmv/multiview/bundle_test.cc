@@ -112,4 +112,54 @@ TEST(EuclideanBA, NViews) {
     EXPECT_LT(FrobeniusNorm(error), 1e-3);
   }
 }
+
+TEST(EuclideanBA, NViewsMetric) {
+  int nviews = 5;
+  int npoints = 30;
+  NViewDataSet  d = NRealisticCamerasSparse(nviews, npoints);
+  vector<Mat3>  K = d.K;
+  vector<Mat3>  R = d.R;
+  vector<Vec3>  t = d.t;
+  vector<Mat2X> x = d.x;
+  const vector<Vecu>   &x_ids = d.x_ids;
+
+  Mat3X X;
+  X = d.X;
+  
+  for (int i = 0; i < nviews; ++i) {               // Add noise to motion.
+    R[i] *= RotationAroundX(0.01 * i) * RotationAroundZ(-0.02);
+    t[i] += Vec3::Random() * 0.1;
+  }
+  X += Mat3X::Random(3, X.cols()) * 0.1;  // and structure.
+
+  double rms = EuclideanBA(x, x_ids, &K, &R, &t, &X, eBUNDLE_METRIC);
+  EXPECT_LT(rms, 1e-6);
+
+  Mat34 P;
+  Mat2X error;
+  for (int i = 0; i < nviews; ++i) {                // Check there is no error.
+    EXPECT_EQ(d.K[i], K[i]);
+    P_From_KRt(K[i], R[i], t[i], &P);
+    error = x[i] - Project(P, X, x_ids[i]);
+    EXPECT_LT(FrobeniusNorm(error), 1e-5);
+  }
+}
+
+TEST(EuclideanBA, NViewsMetricThreaded) {
+  int nviews = 5;
+  int npoints = 30;
+  NViewDataSet  d = NRealisticCamerasSparse(nviews, npoints);
+  vector<Mat3>  K = d.K;
+  vector<Mat3>  R = d.R;
+  vector<Vec3>  t = d.t;
+  Mat3X X = d.X;
+  for (int i = 0; i < nviews; ++i) {
+    R[i] *= RotationAroundX(0.01 * i) * RotationAroundZ(-0.02);
+    t[i] += Vec3::Random() * 0.1;
+  }
+  X += Mat3X::Random(3, X.cols()) * 0.1;
+
+  double rms = EuclideanBA(d.x, d.x_ids, &K, &R, &t, &X, eBUNDLE_METRIC, 4);
+  EXPECT_LT(rms, 1e-6);
+}
 }
@@ -24,10 +24,10 @@
 namespace libmv {
  
 // HZ 4.4.4 pag.109: Point conditioning (non isotropic)
-void PreconditionerFromPoints(const Mat &points, Mat3 *T) {
-  Vec mean, variance;
-  MeanAndVarianceAlongRows(points, &mean, &variance);
-
+void PreconditionerFromMeanAndVariance(const Vec2 &mean_arg,
+                                       const Vec2 &variance,
+                                       Mat3 *T) {
+  Vec2 mean = mean_arg;
   double xfactor = sqrt(2.0 / variance(0));
   double yfactor = sqrt(2.0 / variance(1));
 
@@ -42,11 +42,18 @@ void PreconditionerFromPoints(const Mat &points, Mat3 *T) {
         0,       yfactor, -yfactor * mean(1),
         0,       0,        1;
 }
-// HZ 4.4.4 pag.107: Point conditioning (isotropic)
-void IsotropicPreconditionerFromPoints(const Mat &points, Mat3 *T) {
+
+void PreconditionerFromPoints(const Mat &points, Mat3 *T) {
   Vec mean, variance;
   MeanAndVarianceAlongRows(points, &mean, &variance);
+  PreconditionerFromMeanAndVariance(mean.head<2>(), variance.head<2>(), T);
+}
 
+// HZ 4.4.4 pag.107: Point conditioning (isotropic)
+void IsotropicPreconditionerFromMeanAndVariance(const Vec2 &mean_arg,
+                                                const Vec2 &variance,
+                                                Mat3 *T) {
+  Vec2 mean = mean_arg;
   double var_norm = variance.norm();
   double factor = sqrt(2.0 / var_norm);
 
@@ -62,6 +69,13 @@ void IsotropicPreconditionerFromPoints(const Mat &points, Mat3 *T) {
         0,       0,        1;
 }
 
+void IsotropicPreconditionerFromPoints(const Mat &points, Mat3 *T) {
+  Vec mean, variance;
+  MeanAndVarianceAlongRows(points, &mean, &variance);
+  IsotropicPreconditionerFromMeanAndVariance(mean.head<2>(),
+                                             variance.head<2>(), T);
+}
+
 void ApplyTransformationToPoints(const Mat &points,
                                  const Mat3 &T,
                                  Mat *transformed_points) {
@@ -96,4 +110,16 @@ void UnnormalizerI::Unnormalize(const Mat3 &T1, const Mat3 &T2, Mat3 *H)  {
   *H = T2.inverse() * (*H) * T1;
 }
 
+NormalizedCorrespondences::NormalizedCorrespondences(const Mat &x1,
+                                                     const Mat &x2,
+                                                     bool isotropic) {
+  if (isotropic) {
+    NormalizeIsotropicPoints(x1, &x1_, &T1_);
+    NormalizeIsotropicPoints(x2, &x2_, &T2_);
+  } else {
+    NormalizePoints(x1, &x1_, &T1_);
+    NormalizePoints(x2, &x2_, &T2_);
+  }
+}
+
 } // namespace libmv
@@ -42,6 +42,58 @@ void NormalizeIsotropicPoints(const Mat &points,
                               Mat *normalized_points,
                               Mat3 *T);
 
+// The preconditioners from the mean and the variance of 2D points, as
+// computed by MeanAndVarianceAlongRows().
+void PreconditionerFromMeanAndVariance(const Vec2 &mean,
+                                       const Vec2 &variance,
+                                       Mat3 *T);
+void IsotropicPreconditionerFromMeanAndVariance(const Vec2 &mean,
+                                                const Vec2 &variance,
+                                                Mat3 *T);
+
+namespace conditioning {
+
+template<int N>
+void MeanAndVariance(const Matrix<double, 2, N> &points,
+                     Vec2 *mean, Vec2 *variance) {
+  *mean = points.rowwise().sum() / N;
+  *variance = points.array().square().rowwise().sum().matrix() / N;
+  *variance -= mean->cwiseProduct(*mean);
+}
+
+template<int N>
+void ApplyAffine(const Mat3 &T,
+                 const Matrix<double, 2, N> &points,
+                 Matrix<double, 2, N> *transformed_points) {
+  *transformed_points = T.block<2, 2>(0, 0) * points;
+  transformed_points->colwise() += T.block<2, 1>(0, 2);
+}
+
+}  // namespace conditioning
+
+// Same as NormalizePoints() for a fixed number of points, without allocation.
+template<int N>
+void NormalizePoints(const Matrix<double, 2, N> &points,
+                     Matrix<double, 2, N> *normalized_points,
+                     Mat3 *T) {
+  Vec2 mean, variance;
+  conditioning::MeanAndVariance(points, &mean, &variance);
+  PreconditionerFromMeanAndVariance(mean, variance, T);
+  conditioning::ApplyAffine(*T, points, normalized_points);
+}
+
+// Same as NormalizeIsotropicPoints() for a fixed number of points, without
+// allocation.
+template<int N>
+void NormalizeIsotropicPoints(const Matrix<double, 2, N> &points,
+                              Matrix<double, 2, N> *normalized_points,
+                              Mat3 *T) {
+  Vec2 mean, variance;
+  conditioning::MeanAndVariance(points, &mean, &variance);
+  IsotropicPreconditionerFromMeanAndVariance(mean, variance, T);
+  conditioning::ApplyAffine(*T, points, normalized_points);
+}
+
 /// Use inverse for unnormalize
 struct UnnormalizerI {
   // Denormalize the results. See HZ page 109.
@@ -54,6 +106,28 @@ struct UnnormalizerT {
   static void Unnormalize(const Mat3 &T1, const Mat3 &T2, Mat3 *H);
 };
 
+// Two sets of corresponding points normalized once, so that models can be
+// fitted on many subsets of them without normalizing each subset:
+//
+//   x1() = T1() * x1,  x2() = T2() * x2.
+//
+// The models fitted on these are unnormalized with T1() and T2() by the
+// unnormalizers above.
+class NormalizedCorrespondences {
+ public:
+  NormalizedCorrespondences(const Mat &x1, const Mat &x2,
+                            bool isotropic = false);
+
+  const Mat &x1() const { return x1_; }
+  const Mat &x2() const { return x2_; }
+  const Mat3 &T1() const { return T1_; }
+  const Mat3 &T2() const { return T2_; }
+
+ private:
+  Mat x1_, x2_;
+  Mat3 T1_, T2_;
+};
+
 } //namespace libmv
 
 
@@ -20,6 +20,7 @@
 
 #include "libmv/multiview/euclidean_kernel.h"
 #include "libmv/multiview/euclidean.h"
+#include "libmv/multiview/euclidean_parameterization.h"
 
 namespace libmv {
 namespace euclidean {
@@ -33,6 +34,33 @@ void TwoPointSolver::Solve(const Mat &x1, const Mat &x2, vector<Mat3> *Hs) {
   }
 }
 
+// Same system as Euclidean2DFromCorrespondencesLinear(), with fixed sizes.
+void TwoPointSolver::SolveMinimal(const MinimalSample &x1,
+                                  const MinimalSample &x2,
+                                  vector<Mat3> *Hs) {
+  Mat4 A = Mat4::Zero();
+  Vec4 b;
+  for (int i = 0; i < MINIMUM_SAMPLES; ++i) {
+    const int j = i * 2;
+    A(j, 0) = -x1(1, i);
+    A(j, 1) =  x1(0, i);
+    A(j, 2) =  1.0;
+
+    A(j + 1, 0) = x1(0, i);
+    A(j + 1, 1) = x1(1, i);
+    A(j + 1, 3) = 1.0;
+
+    b(j)     = x2(0, i);
+    b(j + 1) = x2(1, i);
+  }
+  Vec4 x = A.fullPivLu().solve(b);
+  if ((A * x).isApprox(b)) {
+    Mat3 M;
+    Euclidean2DSCParameterization<double>::To(x, &M);
+    Hs->push_back(M);
+  }
+}
+
 }  // namespace kernel
 }  // namespace euclidean2D
 }  // namespace euclidean
@@ -34,6 +34,11 @@ namespace kernel {
 struct TwoPointSolver {
   enum { MINIMUM_SAMPLES = 2 };
   static void Solve(const Mat &x1, const Mat &x2, vector<Mat3> *Hs);
+
+  typedef Matrix<double, 2, MINIMUM_SAMPLES> MinimalSample;
+  static void SolveMinimal(const MinimalSample &x1,
+                           const MinimalSample &x2,
+                           vector<Mat3> *Hs);
 };
 
 typedef two_view::kernel::Kernel<
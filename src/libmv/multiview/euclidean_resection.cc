@@ -18,6 +18,7 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <algorithm>
 #include <cmath>
 
 #include <Eigen/SVD>
@@ -27,7 +28,9 @@
 #include "libmv/logging/logging.h"
 #include "libmv/multiview/euclidean_resection.h"
 #include "libmv/multiview/projection.h"
-
+#include "libmv/multiview/rotation_parameterization.h"
+#include "libmv/numeric/levenberg_marquardt.h"
+#include "libmv/numeric/poly.h"
 
 namespace libmv {
 namespace euclidean_resection {
@@ -630,5 +633,241 @@ void EuclideanResectionEPnP(const Mat2X &x_camera, const Mat3X &X_world,
   *R = Rs[n];
   *t = ts[n];
 }
+
+int EuclideanResectionP3P(const Mat2X &x_camera, const Mat3X &X_world,
+                          vector<Mat3> *Rs, vector<Vec3> *ts) {
+  CHECK(x_camera.cols() == 3);
+  CHECK(X_world.cols() == 3);
+  Rs->clear();
+  ts->clear();
+
+  Vec3 P1 = X_world.col(0);
+  Vec3 P2 = X_world.col(1);
+  Vec3 P3 = X_world.col(2);
+  if ((P2 - P1).cross(P3 - P1).norm() == 0) {
+    return 0;
+  }
+  Vec3 f1, f2, f3;
+  f1 << x_camera.col(0), 1;
+  f2 << x_camera.col(1), 1;
+  f3 << x_camera.col(2), 1;
+  f1.normalize();
+  f2.normalize();
+  f3.normalize();
+
+  // Intermediate camera frame, with e1 along f1 and f2 in the (e1, e2) plane.
+  // f3 must end up on the negative side of e3, which fixes the order of the
+  // first two points.
+  Vec3 e1 = f1;
+  Vec3 e3 = f1.cross(f2).normalized();
+  Vec3 e2 = e3.cross(e1);
+  Mat3 T;
+  T << e1.transpose(), e2.transpose(), e3.transpose();
+  Vec3 f3_T = T * f3;
+  if (f3_T(2) > 0) {
+    std::swap(f1, f2);
+    std::swap(P1, P2);
+    e1 = f1;
+    e3 = f1.cross(f2).normalized();
+    e2 = e3.cross(e1);
+    T << e1.transpose(), e2.transpose(), e3.transpose();
+    f3_T = T * f3;
+  }
+
+  // Intermediate world frame, with n1 along P1P2 and P3 in the (n1, n2) plane.
+  Vec3 n1 = (P2 - P1).normalized();
+  Vec3 n3 = n1.cross(P3 - P1).normalized();
+  Vec3 n2 = n3.cross(n1);
+  Mat3 N;
+  N << n1.transpose(), n2.transpose(), n3.transpose();
+  Vec3 P3_N = N * (P3 - P1);
+
+  double d_12 = (P2 - P1).norm();
+  double f_1 = f3_T(0) / f3_T(2);
+  double f_2 = f3_T(1) / f3_T(2);
+  double p_1 = P3_N(0);
+  double p_2 = P3_N(1);
+
+  // b is the cotangent of the angle between the two first bearings.
+  double cos_beta = f1.dot(f2);
+  double b = 1 / (1 - Square(cos_beta)) - 1;
+  b = cos_beta < 0 ? -sqrt(b) : sqrt(b);
+
+  double f_1_pw2 = Square(f_1);
+  double f_2_pw2 = Square(f_2);
+  double p_1_pw2 = Square(p_1);
+  double p_1_pw3 = p_1_pw2 * p_1;
+  double p_1_pw4 = p_1_pw3 * p_1;
+  double p_2_pw2 = Square(p_2);
+  double p_2_pw3 = p_2_pw2 * p_2;
+  double p_2_pw4 = p_2_pw3 * p_2;
+  double d_12_pw2 = Square(d_12);
+  double b_pw2 = Square(b);
+
+  // Quartic in cos(theta), theta being the angle between the (n1, n2) plane
+  // and the plane through the camera center and P1P2.
+  double coeffs[5];
+  coeffs[4] = -f_2_pw2 * p_2_pw4 - p_2_pw4 * f_1_pw2 - p_2_pw4;
+  coeffs[3] = 2 * p_2_pw3 * d_12 * b
+            + 2 * f_2_pw2 * p_2_pw3 * d_12 * b
+            - 2 * f_2 * p_2_pw3 * f_1 * d_12;
+  coeffs[2] = -f_2_pw2 * p_2_pw2 * p_1_pw2
+            - f_2_pw2 * p_2_pw2 * d_12_pw2 * b_pw2
+            - f_2_pw2 * p_2_pw2 * d_12_pw2
+            + f_2_pw2 * p_2_pw4
+            + p_2_pw4 * f_1_pw2
+            + 2 * p_1 * p_2_pw2 * d_12
+            + 2 * f_1 * f_2 * p_1 * p_2_pw2 * d_12 * b
+            - p_2_pw2 * p_1_pw2 * f_1_pw2
+            + 2 * p_1 * p_2_pw2 * f_2_pw2 * d_12
+            - p_2_pw2 * d_12_pw2 * b_pw2
+            - 2 * p_1_pw2 * p_2_pw2;
+  coeffs[1] = 2 * p_1_pw2 * p_2 * d_12 * b
+            + 2 * f_2 * p_2_pw3 * f_1 * d_12
+            - 2 * f_2_pw2 * p_2_pw3 * d_12 * b
+            - 2 * p_1 * p_2 * d_12_pw2 * b;
+  coeffs[0] = -2 * f_2 * p_2_pw2 * f_1 * p_1 * d_12 * b
+            + f_2_pw2 * p_2_pw2 * d_12_pw2
+            + 2 * p_1_pw3 * d_12
+            - p_1_pw2 * d_12_pw2
+            + f_2_pw2 * p_2_pw2 * p_1_pw2
+            - p_1_pw4
+            - 2 * f_2_pw2 * p_2_pw2 * p_1 * d_12
+            + p_2_pw2 * f_1_pw2 * p_1_pw2
+            + f_2_pw2 * p_2_pw2 * d_12_pw2 * b_pw2;
+
+  double roots[4];
+  int num_roots = FindRealPolynomialRoots<4>(coeffs, roots);
+  for (int i = 0; i < num_roots; ++i) {
+    double cos_theta = roots[i];
+    if (std::abs(cos_theta) > 1) {
+      continue;
+    }
+    double sin_theta = sqrt(1 - Square(cos_theta));
+    double cot_alpha = (-f_1 * p_1 / f_2 - cos_theta * p_2 + d_12 * b) /
+                       (-f_1 * cos_theta * p_2 / f_2 + p_1 - d_12);
+    double sin_alpha = sqrt(1 / (Square(cot_alpha) + 1));
+    double cos_alpha = sqrt(1 - Square(sin_alpha));
+    if (cot_alpha < 0) {
+      cos_alpha = -cos_alpha;
+    }
+
+    // Camera center and orientation in the intermediate world frame.
+    double k = d_12 * (sin_alpha * b + cos_alpha);
+    Vec3 C(cos_alpha * k, cos_theta * sin_alpha * k, sin_theta * sin_alpha * k);
+    Mat3 Q;
+    Q << -cos_alpha, -sin_alpha * cos_theta, -sin_alpha * sin_theta,
+          sin_alpha, -cos_alpha * cos_theta, -cos_alpha * sin_theta,
+                  0,             -sin_theta,              cos_theta;
+
+    // Back to the world frame; R_wc maps camera to world coordinates.
+    C = P1 + N.transpose() * C;
+    Mat3 R_wc = N.transpose() * Q.transpose() * T;
+    Mat3 R = R_wc.transpose();
+    Vec3 t = -R * C;
+    if (R == R && t == t) {  // Not NaN.
+      Rs->push_back(R);
+      ts->push_back(t);
+    }
+  }
+  return Rs->size();
+}
+
+namespace {
+
+// Reprojection error of the points for the pose (exp([w]) R0, t0 + dt), the
+// parameters being w and dt. The rotation is built once per evaluation from a
+// Rotation3DLocalParameterization around R0, whose products with the points
+// are cached.
+class ResectionReprojectionError {
+ public:
+  typedef Vec FMatrixType;
+  typedef Vec6 XMatrixType;
+  typedef Rotation3DLocalParameterization<double> RotationParameterization;
+
+  ResectionReprojectionError(const Mat2X &x_camera,
+                             const Mat3X &X_world,
+                             const Mat3 &R0, const Vec3 &t0)
+      : x_camera_(x_camera), t0_(t0) {
+    R0X_ = R0 * X_world;
+  }
+
+  int NumResiduals() const { return 2 * x_camera_.cols(); }
+
+  Vec operator()(const Vec6 &p) const {
+    Mat3 dR;
+    RotationParameterization::Exp(p.head<3>(), &dR);
+    Vec3 t = t0_ + p.tail<3>();
+    Vec residuals(NumResiduals());
+    for (int i = 0; i < x_camera_.cols(); ++i) {
+      Vec3 x = dR * R0X_.col(i) + t;
+      residuals(2 * i + 0) = x(0) / x(2) - x_camera_(0, i);
+      residuals(2 * i + 1) = x(1) / x(2) - x_camera_(1, i);
+    }
+    return residuals;
+  }
+
+  Matrix<double, Dynamic, 6> Jacobian(const Vec6 &p) const {
+    Mat3 dR, J;
+    RotationParameterization::Exp(p.head<3>(), &dR);
+    RotationParameterization::LeftJacobian(p.head<3>(), &J);
+    Vec3 t = t0_ + p.tail<3>();
+    Matrix<double, Dynamic, 6> jacobian(NumResiduals(), 6);
+    for (int i = 0; i < x_camera_.cols(); ++i) {
+      Vec3 rotated = dR * R0X_.col(i);
+      Vec3 x = rotated + t;
+      Mat3 dx_dw;
+      RotationParameterization::RotatedPointJacobian(rotated, J, &dx_dw);
+      // Derivatives of the projection (x0 / x2, x1 / x2).
+      Mat23 dprojection;
+      dprojection << 1 / x(2), 0, -x(0) / Square(x(2)),
+                     0, 1 / x(2), -x(1) / Square(x(2));
+      jacobian.block<2, 3>(2 * i, 0) = dprojection * dx_dw;
+      jacobian.block<2, 3>(2 * i, 3) = dprojection;
+    }
+    return jacobian;
+  }
+
+ private:
+  const Mat2X &x_camera_;
+  Mat3X R0X_;
+  Vec3 t0_;
+};
+
+// The Jacobian policy of LevenbergMarquardt for ResectionReprojectionError.
+class ResectionReprojectionJacobian {
+ public:
+  ResectionReprojectionJacobian(const ResectionReprojectionError &f)
+      : f_(f) {}
+
+  Matrix<double, Dynamic, 6> operator()(const Vec6 &p) const {
+    return f_.Jacobian(p);
+  }
+
+ private:
+  const ResectionReprojectionError &f_;
+};
+
+}  // namespace
+
+void EuclideanResectionRefine(const Mat2X &x_camera, const Mat3X &X_world,
+                              Mat3 *R, Vec3 *t) {
+  CHECK(x_camera.cols() == X_world.cols());
+  typedef LevenbergMarquardt<ResectionReprojectionError,
+                             ResectionReprojectionJacobian> Solver;
+  ResectionReprojectionError reprojection_error(x_camera, X_world, *R, *t);
+  Solver::SolverParameters params;
+  Solver lm(reprojection_error);
+  Vec6 p = Vec6::Zero();
+  Solver::Results results = lm.minimize(params, &p);
+  VLOG(3) << "Refined pose, error " << results.error_magnitude
+          << " after " << results.iterations << " iterations.";
+
+  ResectionReprojectionError::RotationParameterization rotation(*R);
+  rotation.Update(p.head<3>());
+  *R = rotation.base();
+  *t += p.tail<3>();
+}
+
 } // namespace resection
 } // namespace libmv
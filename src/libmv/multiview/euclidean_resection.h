@@ -21,6 +21,7 @@
 #ifndef LIBMV_MULTIVIEW_EUCLIDEAN_RESECTION_H_
 #define LIBMV_MULTIVIEW_EUCLIDEAN_RESECTION_H_
 
+#include "libmv/base/vector.h"
 #include "libmv/numeric/numeric.h"
 #include "libmv/multiview/projection.h"
 
@@ -117,6 +118,42 @@ void EuclideanResectionAnsarDaniilidis(const Mat2X &x_camera,
 void EuclideanResectionEPnP(const Mat2X &x_camera, const Mat3X &X_world, 
                             Mat3 *R, Vec3 *t);
 
+/**
+ * Computes the extrinsic parameters, R and t for a calibrated camera
+ * from exactly 3 3D points and their images. There are up to four solutions;
+ * a fourth point is needed to tell them apart.
+ *
+ * \param x_camera Image points in normalized camera coordinates,
+ *       e.g. x_camera=inv(K)*x_image
+ * \param X_world 3D points in the world coordinate system
+ * \param Rs      Solutions for the camera rotation matrix
+ * \param ts      Solutions for the camera translation vector
+ * \return        The number of solutions, 0 if the 3D points are collinear
+ *
+ * This is the algorithm described in:
+ * "A Novel Parametrization of the Perspective-Three-Point Problem for a
+ *  Direct Computation of Absolute Camera Position and Orientation", by
+ *  L. Kneip, D. Scaramuzza and R. Siegwart, CVPR 2011
+ */
+int EuclideanResectionP3P(const Mat2X &x_camera, const Mat3X &X_world,
+                          vector<Mat3> *Rs, vector<Vec3> *ts);
+
+/**
+ * Refines the extrinsic parameters R and t of a calibrated camera by
+ * minimizing the reprojection error of the points in normalized camera
+ * coordinates with Levenberg-Marquardt. The rotation is updated through a
+ * Rotation3DLocalParameterization, with analytic Jacobians. Typically used
+ * after a linear method such as EuclideanResectionEPnP().
+ *
+ * \param x_camera Image points in normalized camera coordinates,
+ *       e.g. x_camera=inv(K)*x_image
+ * \param X_world 3D points in the world coordinate system
+ * \param R       Initial and refined camera rotation matrix
+ * \param t       Initial and refined camera translation vector
+ */
+void EuclideanResectionRefine(const Mat2X &x_camera, const Mat3X &X_world,
+                              Mat3 *R, Vec3 *t);
+
 } // namespace euclidean_resection
 } // namespace libmv
 
@@ -55,19 +55,45 @@ class Kernel {
     models->push_back(P);
   }
   double Error(int sample, const Model &model) const {
-    Mat3X X = X_.col(sample);
-    Mat2X error = Project(model, X) - x_camera_.col(sample);
-    return error.col(0).norm();
+    return sqrt(ReprojectionErrorSquared(model, X_.col(sample),
+                                         x_camera_.col(sample)));
   }
   int NumSamples() const {
     return x_camera_.cols();
   }
- private:
+ protected:
   // x_camera_ contains the normalized camera coordinates 
         Mat2X  x_camera_;
   const Mat3X &X_;
 };
 
+// Same as Kernel with the minimal P3P solver, which gives up to four models
+// per sample. The fewer samples make for fewer RANSAC iterations; the final
+// model is best refitted on all the inliers with EuclideanResectionEPnP().
+class P3PKernel : public Kernel {
+ public:
+  enum { MINIMUM_SAMPLES = 3 };
+  P3PKernel(const Mat2X &x_camera, const Mat3X &X) : Kernel(x_camera, X) {}
+  P3PKernel(const Mat2X &x_image, const Mat3X &X, const Mat3 &K)
+      : Kernel(x_image, X, K) {}
+  void Fit(const vector<int> &samples, vector<Model> *models) const {
+    Mat2X x = ExtractColumns(x_camera_, samples);
+    Mat3X X = ExtractColumns(X_, samples);
+    vector<Mat3> Rs;
+    vector<Vec3> ts;
+    int num_solutions = EuclideanResectionP3P(x, X, &Rs, &ts);
+    for (int i = 0; i < num_solutions; ++i) {
+      Mat34 P;
+      P << Rs[i], ts[i];
+      models->push_back(P);
+    }
+  }
+  // The normalized camera coordinates, e.g. to refit on the inliers.
+  const Mat2X &x_camera() const {
+    return x_camera_;
+  }
+};
+
 }  // namespace kernel
 }  // namespace resection
 }  // namespace libmv
@@ -30,6 +30,7 @@ namespace libmv {
 namespace {
 
 using libmv::euclidean_resection::kernel::Kernel;
+using libmv::euclidean_resection::kernel::P3PKernel;
 
 TEST(EuclideanResectionKernel, RobustEuclideanResection) {
   int nviews = 5;
@@ -60,5 +61,27 @@ TEST(EuclideanResectionKernel, RobustEuclideanResection) {
   }
 }
 
+TEST(EuclideanResectionKernel, RobustEuclideanResectionP3P) {
+  int nviews = 5;
+  int npoints = 60;
+  int noutliers = 0.3*npoints;
+  // On the distance in normalized camera coordinates, i.e. a few pixels.
+  double threshold_inlier = 1e-3;
+  NViewDataSet d = NRealisticCamerasFull(nviews, npoints);
+  for (int i = 0; i < nviews; ++i) {
+    Mat2X x = d.x[i];
+    x.block(0, 0, 2, noutliers).setRandom();
+
+    P3PKernel kernel(x, d.X, d.K[i]);
+    vector<int> inliers;
+    Mat34 P = Estimate(kernel,
+                       MLEScorer<P3PKernel>(threshold_inlier),
+                       &inliers);
+    Mat34 P_expected = d.K[i].inverse() * d.P(i);
+    EXPECT_MATRIX_PROP(P_expected, P, 1e-6);
+    EXPECT_EQ(npoints-noutliers, inliers.size());
+  }
+}
+
 }  // namespace
 }  // namespace libmv
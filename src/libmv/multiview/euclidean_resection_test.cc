@@ -226,4 +226,67 @@ TEST(EuclideanResection, Points6AllRandomInput) {
  
   EXPECT_MATRIX_NEAR(T_output, T_expected, 1e-5);
   EXPECT_MATRIX_NEAR(R_output, R_expected, 1e-7);
-}
\ No newline at end of file
+}
+TEST(EuclideanResection, RefinePerturbedPose) {
+  int num_points = 10;
+  Mat3 R_expected = RotationAroundX(0.3) * RotationAroundY(-0.2);
+  Vec3 t_expected(0.5, -0.2, 10);
+  Mat3X X_world = 2 * Mat3X::Random(3, num_points);
+  Mat2X x_camera(2, num_points);
+  for (int i = 0; i < num_points; ++i) {
+    Vec3 x = R_expected * X_world.col(i) + t_expected;
+    x_camera.col(i) = x.head<2>() / x(2);
+  }
+
+  Mat3 R = R_expected * RotationAroundZ(0.05);
+  Vec3 t = t_expected + Vec3(0.1, 0.1, -0.2);
+  EuclideanResectionRefine(x_camera, X_world, &R, &t);
+
+  EXPECT_MATRIX_NEAR(R, R_expected, 1e-8);
+  EXPECT_MATRIX_NEAR(t, t_expected, 1e-7);
+  EXPECT_NEAR(1, R.determinant(), 1e-12);
+}
+
+TEST(EuclideanResection, P3PContainsTheTruePose) {
+  // Some random configurations are close to degenerate and less accurate.
+  int num_accurate = 0;
+  for (int trial = 0; trial < 100; ++trial) {
+    Mat3 R_expected = RotationAroundX(0.1 * trial) * RotationAroundY(0.3);
+    Vec3 t_expected(0.5, -0.2, 10);
+    Mat3X X_world = 2 * Mat3X::Random(3, 3);
+    Mat2X x_camera(2, 3);
+    for (int i = 0; i < 3; ++i) {
+      Vec3 x = R_expected * X_world.col(i) + t_expected;
+      x_camera.col(i) = x.head<2>() / x(2);
+    }
+
+    vector<Mat3> Rs;
+    vector<Vec3> ts;
+    int num_solutions = EuclideanResectionP3P(x_camera, X_world, &Rs, &ts);
+    ASSERT_LE(num_solutions, 4);
+    double best_error = HUGE_VAL;
+    for (int i = 0; i < num_solutions; ++i) {
+      EXPECT_NEAR(1, Rs[i].determinant(), 1e-9);
+      best_error = std::min(best_error, (Rs[i] - R_expected).norm() +
+                                        (ts[i] - t_expected).norm());
+    }
+    if (best_error < 1e-6) {
+      ++num_accurate;
+    }
+  }
+  EXPECT_GE(num_accurate, 98);
+}
+
+TEST(EuclideanResection, P3PCollinearPoints) {
+  Mat3X X_world(3, 3);
+  X_world << 0, 1, 2,
+             0, 1, 2,
+             5, 6, 7;
+  Mat2X x_camera(2, 3);
+  x_camera.row(0) = X_world.row(0).cwiseQuotient(X_world.row(2));
+  x_camera.row(1) = X_world.row(1).cwiseQuotient(X_world.row(2));
+
+  vector<Mat3> Rs;
+  vector<Vec3> ts;
+  EXPECT_EQ(0, EuclideanResectionP3P(x_camera, X_world, &Rs, &ts));
+}
@@ -23,10 +23,19 @@
 #include "libmv/multiview/fundamental.h"
 #include "libmv/multiview/fundamental_kernel.h"
 #include "libmv/multiview/five_point.h"
+#include "libmv/numeric/poly.h"
 
 namespace libmv {
 
-Mat FivePointsNullspaceBasis(const Mat2X &x1, const Mat2X &x2) {
+Mat94 FivePointsNullspaceBasis(const Mat2X &x1, const Mat2X &x2) {
+  if (x1.cols() == 5) {
+    Matrix<double, 5, 9> A;
+    fundamental::kernel::EncodeEpipolarEquation(x1, x2, &A);
+    Mat94 basis;
+    if (MinimalNullspace(A, &basis)) {
+      return basis;
+    }
+  }
   Matrix<double, 9, 9> A;
   A.setZero();  // Make A square until Eigen supports rectangular SVD.
   fundamental::kernel::EncodeEpipolarEquation(x1, x2, &A);
@@ -34,8 +43,8 @@ Mat FivePointsNullspaceBasis(const Mat2X &x1, const Mat2X &x2) {
   return svd.compute(A, Eigen::ComputeFullV).matrixV().topRightCorner<9,4>();
 }
 
-Vec o1(const Vec &a, const Vec &b) {
-  Vec res = Vec::Zero(20);
+Vec20 o1(const Vec20 &a, const Vec20 &b) {
+  Vec20 res = Vec20::Zero();
 
   res(coef_xx) = a(coef_x) * b(coef_x);
   res(coef_xy) = a(coef_x) * b(coef_y)
@@ -57,8 +66,8 @@ Vec o1(const Vec &a, const Vec &b) {
   return res;
 }
 
-Vec o2(const Vec &a, const Vec &b) {
-  Vec res(20);
+Vec20 o2(const Vec20 &a, const Vec20 &b) {
+  Vec20 res;
 
   res(coef_xxx) = a(coef_xx) * b(coef_x);
   res(coef_xxy) = a(coef_xx) * b(coef_y)
@@ -104,12 +113,12 @@ Vec o2(const Vec &a, const Vec &b) {
   return res;
 }
 
-Mat FivePointsPolynomialConstraints(const Mat &E_basis) {
+Mat1020 FivePointsPolynomialConstraints(const Mat94 &E_basis) {
   // Build the polynomial form of E (equation (8) in Stewenius et al. [1])
-  Vec E[3][3];
+  Vec20 E[3][3];
   for (int i = 0; i < 3; ++i) {
     for (int j = 0; j < 3; ++j) {
-      E[i][j] = Vec::Zero(20);
+      E[i][j] = Vec20::Zero();
       E[i][j](coef_x) = E_basis(3 * i + j, 0);
       E[i][j](coef_y) = E_basis(3 * i + j, 1);
       E[i][j](coef_z) = E_basis(3 * i + j, 2);
@@ -118,7 +127,7 @@ Mat FivePointsPolynomialConstraints(const Mat &E_basis) {
   }
 
   // The constraint matrix.
-  Mat M(10, 20);
+  Mat1020 M;
   int mrow = 0;
 
   // Determinant constraint det(E) = 0; equation (19) of Nister [2].
@@ -128,7 +137,7 @@ Mat FivePointsPolynomialConstraints(const Mat &E_basis) {
 
   // Cubic singular values constraint.
   // Equation (20).
-  Vec EET[3][3];
+  Vec20 EET[3][3];
   for (int i = 0; i < 3; ++i) {    // Since EET is symmetric, we only compute
     for (int j = 0; j < 3; ++j) {  // its upper triangular part.
       if (i <= j) {
@@ -142,8 +151,8 @@ Mat FivePointsPolynomialConstraints(const Mat &E_basis) {
   }
 
   // Equation (21).
-  Vec (&L)[3][3] = EET;
-  Vec trace  = 0.5 * (EET[0][0] + EET[1][1] + EET[2][2]);
+  Vec20 (&L)[3][3] = EET;
+  Vec20 trace  = 0.5 * (EET[0][0] + EET[1][1] + EET[2][2]);
   for (int i = 0; i < 3; ++i) {
     L[i][i] -= trace;
   }
@@ -151,7 +160,7 @@ Mat FivePointsPolynomialConstraints(const Mat &E_basis) {
   // Equation (23).
   for (int i = 0; i < 3; ++i) {
     for (int j = 0; j < 3; ++j) {
-      Vec LEij = o2(L[i][0], E[0][j])
+      Vec20 LEij = o2(L[i][0], E[0][j])
                + o2(L[i][1], E[1][j])
                + o2(L[i][2], E[2][j]);
       M.row(mrow++) = LEij;
@@ -161,33 +170,14 @@ Mat FivePointsPolynomialConstraints(const Mat &E_basis) {
   return M;
 }
 
-void FivePointsGaussJordan(Mat *Mp) {
-  Mat &M = *Mp;
-
-  // Gauss Elimination.
-  for (int i = 0; i < 10; ++i) {
-    M.row(i) /= M(i,i);
-    for (int j = i + 1; j < 10; ++j) {
-      M.row(j) = M.row(j) / M(j,i) - M.row(i);
-    }
-  }
-
-  // Backsubstitution.
-  for (int i = 9; i >= 0; --i) {
-    for (int j = 0; j < i; ++j) {
-      M.row(j) = M.row(j) - M(j,i) * M.row(i);
-    }
-  }
-}
-
 void FivePointsRelativePose(const Mat2X &x1,
                             const Mat2X &x2,
                             vector<Mat3> *Es) {
   // Step 1: Nullspace Exrtraction.
-  Mat E_basis = FivePointsNullspaceBasis(x1, x2);
+  Mat94 E_basis = FivePointsNullspaceBasis(x1, x2);
 
   // Step 2: Constraint Expansion.
-  Mat M = FivePointsPolynomialConstraints(E_basis);
+  Mat1020 M = FivePointsPolynomialConstraints(E_basis);
 
   // Step 3: Gauss-Jordan Elimination.
   FivePointsGaussJordan(&M);
@@ -195,8 +185,9 @@ void FivePointsRelativePose(const Mat2X &x1,
   // For next steps we follow the matlab code given in Stewenius et al [1].
 
   // Build action matrix.
-  Mat B = M.topRightCorner<10,10>();
-  Mat At = Mat::Zero(10,10);
+  typedef Matrix<double, 10, 10> Mat10;
+  Mat10 B = M.topRightCorner<10,10>();
+  Mat10 At = Mat10::Zero();
   At.row(0) = -B.row(0);
   At.row(1) = -B.row(1);
   At.row(2) = -B.row(2);
@@ -209,17 +200,18 @@ void FivePointsRelativePose(const Mat2X &x1,
   At(9,6) = 1;
 
   // Compute solutions from action matrix's eigenvectors.
-  Eigen::EigenSolver<Mat> es(At);
-  typedef Eigen::EigenSolver<Mat>::EigenvectorsType Matc;
+  Eigen::EigenSolver<Mat10> es(At);
+  typedef Eigen::EigenSolver<Mat10>::EigenvectorsType Matc;
+  typedef Matc::Scalar Complex;
   Matc V = es.eigenvectors();
-  Matc SOLS(4, 10);
+  Matrix<Complex, 4, 10> SOLS;
   SOLS.row(0) = V.row(6).array() / V.row(9).array();
   SOLS.row(1) = V.row(7).array() / V.row(9).array();
   SOLS.row(2) = V.row(8).array() / V.row(9).array();
   SOLS.row(3).setOnes();
 
   // Get the ten candidate E matrices in vector form.
-  Matc Evec = E_basis * SOLS;
+  Matrix<Complex, 9, 10> Evec = E_basis.cast<Complex>() * SOLS;
 
   // Build essential matrices for the real solutions.
   Es->reserve(10);
@@ -243,6 +235,194 @@ void FivePointsRelativePose(const Mat2X &x1,
     }
   }
 }
-  
-} // namespace libmv
 
+namespace {
+
+// The monomials in the order of Nister [2], section 3.2.2: the first ten are
+// eliminated, and the last ten are products of x, y or 1 with powers of z.
+const int kNisterMonomials[20] = {
+  coef_xxx, coef_yyy, coef_xxy, coef_xyy, coef_xxz,
+  coef_xx,  coef_yyz, coef_yy,  coef_xyz, coef_xy,
+  coef_xzz, coef_xz,  coef_x,   coef_yzz, coef_yz,
+  coef_y,   coef_zzz, coef_zz,  coef_z,   coef_1
+};
+
+// Polynomials in z with the coefficients in ascending powers.
+void PolynomialProduct(const double *a, int degree_a,
+                       const double *b, int degree_b,
+                       double *product) {
+  for (int i = 0; i <= degree_a + degree_b; ++i) {
+    product[i] = 0;
+  }
+  for (int i = 0; i <= degree_a; ++i) {
+    for (int j = 0; j <= degree_b; ++j) {
+      product[i + j] += a[i] * b[j];
+    }
+  }
+}
+
+double EvaluatePolynomial(const double *p, int degree, double z) {
+  double value = p[degree];
+  for (int i = degree - 1; i >= 0; --i) {
+    value = value * z + p[i];
+  }
+  return value;
+}
+
+// The rows <e> - z<f>, <g> - z<h> and <i> - z<j> of Nister [2], as a 3x3
+// matrix B(z) of polynomials such that B(z) [x y 1]^T = 0. The columns are the
+// coefficients of x and y (degree 3) and 1 (degree 4).
+struct HiddenVariableMatrix {
+  double b[3][3][5];
+
+  explicit HiddenVariableMatrix(const Mat1020 &M) {
+    for (int i = 0; i < 3; ++i) {
+      int r = 4 + 2 * i;
+      // Coefficients of z^0 .. z^2 (z^3 for the last column) in each row.
+      double top[3][4] = {
+        { M(r, 12), M(r, 11), M(r, 10), 0 },
+        { M(r, 15), M(r, 14), M(r, 13), 0 },
+        { M(r, 19), M(r, 18), M(r, 17), M(r, 16) },
+      };
+      double bottom[3][4] = {
+        { M(r + 1, 12), M(r + 1, 11), M(r + 1, 10), 0 },
+        { M(r + 1, 15), M(r + 1, 14), M(r + 1, 13), 0 },
+        { M(r + 1, 19), M(r + 1, 18), M(r + 1, 17), M(r + 1, 16) },
+      };
+      for (int j = 0; j < 3; ++j) {
+        b[i][j][0] = top[j][0];
+        for (int k = 1; k < 4; ++k) {
+          b[i][j][k] = top[j][k] - bottom[j][k - 1];
+        }
+        b[i][j][4] = -bottom[j][3];
+      }
+    }
+  }
+
+  static int Degree(int column) { return column == 2 ? 4 : 3; }
+
+  // det(B(z)), of degree 10.
+  void Determinant(double *determinant) const {
+    for (int i = 0; i <= 10; ++i) {
+      determinant[i] = 0;
+    }
+    // Cofactor expansion along the first row.
+    for (int j = 0; j < 3; ++j) {
+      int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+      double minor[11], product[11];
+      PolynomialProduct(b[1][j1], Degree(j1), b[2][j2], Degree(j2), minor);
+      PolynomialProduct(b[1][j2], Degree(j2), b[2][j1], Degree(j1), product);
+      int degree_minor = Degree(j1) + Degree(j2);
+      for (int k = 0; k <= degree_minor; ++k) {
+        minor[k] -= product[k];
+      }
+      PolynomialProduct(b[0][j], Degree(j), minor, degree_minor, product);
+      for (int k = 0; k <= Degree(j) + degree_minor; ++k) {
+        determinant[k] += product[k];
+      }
+    }
+  }
+
+  Mat3 Evaluate(double z) const {
+    Mat3 B;
+    for (int i = 0; i < 3; ++i) {
+      for (int j = 0; j < 3; ++j) {
+        B(i, j) = EvaluatePolynomial(b[i][j], Degree(j), z);
+      }
+    }
+    return B;
+  }
+};
+
+// One Gauss-Newton step on the ten polynomial constraints, which recovers the
+// precision lost by the elimination and the degree 10 polynomial.
+void RefineSolution(const Mat1020 &constraints, Vec3 *xyz) {
+  double x = (*xyz)(0), y = (*xyz)(1), z = (*xyz)(2);
+  Matrix<double, 20, 4> monomials = Matrix<double, 20, 4>::Zero();
+  // The monomials and their derivatives with respect to x, y and z.
+  monomials.row(coef_xxx) << x*x*x, 3*x*x,     0,         0;
+  monomials.row(coef_xxy) << x*x*y, 2*x*y,     x*x,       0;
+  monomials.row(coef_xyy) << x*y*y, y*y,       2*x*y,     0;
+  monomials.row(coef_yyy) << y*y*y, 0,         3*y*y,     0;
+  monomials.row(coef_xxz) << x*x*z, 2*x*z,     0,         x*x;
+  monomials.row(coef_xyz) << x*y*z, y*z,       x*z,       x*y;
+  monomials.row(coef_yyz) << y*y*z, 0,         2*y*z,     y*y;
+  monomials.row(coef_xzz) << x*z*z, z*z,       0,         2*x*z;
+  monomials.row(coef_yzz) << y*z*z, 0,         z*z,       2*y*z;
+  monomials.row(coef_zzz) << z*z*z, 0,         0,         3*z*z;
+  monomials.row(coef_xx)  << x*x,   2*x,       0,         0;
+  monomials.row(coef_xy)  << x*y,   y,         x,         0;
+  monomials.row(coef_yy)  << y*y,   0,         2*y,       0;
+  monomials.row(coef_xz)  << x*z,   z,         0,         x;
+  monomials.row(coef_yz)  << y*z,   0,         z,         y;
+  monomials.row(coef_zz)  << z*z,   0,         0,         2*z;
+  monomials.row(coef_x)   << x,     1,         0,         0;
+  monomials.row(coef_y)   << y,     0,         1,         0;
+  monomials.row(coef_z)   << z,     0,         0,         1;
+  monomials.row(coef_1)   << 1,     0,         0,         0;
+  Matrix<double, 10, 4> values = constraints * monomials;
+  Matrix<double, 10, 3> J = values.rightCols<3>();
+  Mat3 JtJ = J.transpose() * J;
+  Eigen::LDLT<Mat3> ldlt(JtJ);
+  Vec3 step = ldlt.solve(J.transpose() * values.col(0));
+  if (step == step) {  // Not NaN.
+    *xyz -= step;
+  }
+}
+
+}  // namespace
+
+void FivePointsRelativePoseNister(const Mat2X &x1,
+                                  const Mat2X &x2,
+                                  vector<Mat3> *Es) {
+  // Nullspace extraction and constraint expansion as above.
+  Mat94 E_basis = FivePointsNullspaceBasis(x1, x2);
+  Mat1020 constraints = FivePointsPolynomialConstraints(E_basis);
+
+  // Gauss-Jordan elimination with the monomials in the order of Nister.
+  Mat1020 M;
+  for (int i = 0; i < 20; ++i) {
+    M.col(i) = constraints.col(kNisterMonomials[i]);
+  }
+  FivePointsGaussJordan(&M);
+
+  // z is a root of the degree 10 polynomial det(B(z)) = 0.
+  HiddenVariableMatrix B(M);
+  double determinant[11];
+  B.Determinant(determinant);
+  double z[10];
+  int num_roots = FindRealPolynomialRoots<10>(determinant, z);
+
+  // For each z, [x y 1] is the nullspace of B(z), taken from the largest
+  // cross product of two of its rows.
+  Matrix<double, 4, 10> solutions;
+  int num_solutions = 0;
+  for (int s = 0; s < num_roots; ++s) {
+    Mat3 Bz = B.Evaluate(z[s]);
+    Vec3 xy1 = Bz.row(0).cross(Bz.row(1)).transpose();
+    Vec3 other = Bz.row(0).cross(Bz.row(2)).transpose();
+    if (other.squaredNorm() > xy1.squaredNorm()) {
+      xy1 = other;
+    }
+    other = Bz.row(1).cross(Bz.row(2)).transpose();
+    if (other.squaredNorm() > xy1.squaredNorm()) {
+      xy1 = other;
+    }
+    if (xy1(2) == 0) {
+      continue;
+    }
+    Vec3 xyz(xy1(0) / xy1(2), xy1(1) / xy1(2), z[s]);
+    RefineSolution(constraints, &xyz);
+    solutions.col(num_solutions++) << xyz, 1;
+  }
+
+  // All the candidate E matrices in vector form at once.
+  Matrix<double, 9, 10> Evec = E_basis * solutions;
+  Es->reserve(Es->size() + num_solutions);
+  for (int s = 0; s < num_solutions; ++s) {
+    Evec.col(s) /= Evec.col(s).norm();
+    Es->push_back(Map<RMat3>(Evec.col(s).data()));
+  }
+}
+
+} // namespace libmv
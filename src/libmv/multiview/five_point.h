@@ -47,6 +47,17 @@ namespace libmv {
 void FivePointsRelativePose(const Mat2X &x1, const Mat2X &x2,
                             vector<Mat3> *E);
 
+/** Same as FivePointsRelativePose(), solved as in Nister [2].
+ *
+ * After the Gauss-Jordan elimination, z is found as a real root of a degree
+ * 10 polynomial isolated with a Sturm sequence, and x and y from the
+ * nullspace of a 3x3 matrix, instead of computing the eigenvectors of the
+ * 10x10 action matrix. Only real solutions are computed, with fixed size
+ * storage; see five_point_benchmark for the speed and accuracy of both.
+ */
+void FivePointsRelativePoseNister(const Mat2X &x1, const Mat2X &x2,
+                                  vector<Mat3> *E);
+
 
 // In the following code, polynomials are expressed as vectors containing
 // their coeficients in the basis of monomials:
@@ -84,22 +95,46 @@ enum {
   coef_1
 };
 
+// The steps below use fixed size matrices, so that solving a minimal sample
+// inside RANSAC does not allocate.
+typedef Eigen::Matrix<double, 20, 1> Vec20;
+typedef Eigen::Matrix<double, 9, 4> Mat94;
+typedef Eigen::Matrix<double, 10, 20> Mat1020;
+
 // Compute the nullspace of the linear constraints given by the matches.
-Mat FivePointsNullspaceBasis(const Mat2X &x1, const Mat2X &x2);
+Mat94 FivePointsNullspaceBasis(const Mat2X &x1, const Mat2X &x2);
 
 // Multiply two polynomials of degree 1.
-Vec o1(const Vec &a, const Vec &b);
+Vec20 o1(const Vec20 &a, const Vec20 &b);
 
 // Multiply a polynomial of degree 2, a, by a polynomial of degree 1, b.
-Vec o2(const Vec &a, const Vec &b);
+Vec20 o2(const Vec20 &a, const Vec20 &b);
 
 // Builds the polynomial constraint matrix M.
-Mat FivePointsPolynomialConstraints(const Mat &E_basis);
+Mat1020 FivePointsPolynomialConstraints(const Mat94 &E_basis);
+
+// Gauss--Jordan elimination for the constraint matrix. TMat is a Mat1020 or
+// a 10x20 Mat.
+template <typename TMat>
+void FivePointsGaussJordan(TMat *Mp) {
+  TMat &M = *Mp;
+
+  // Gauss Elimination.
+  for (int i = 0; i < 10; ++i) {
+    M.row(i) /= M(i,i);
+    for (int j = i + 1; j < 10; ++j) {
+      M.row(j) = M.row(j) / M(j,i) - M.row(i);
+    }
+  }
+
+  // Backsubstitution.
+  for (int i = 9; i >= 0; --i) {
+    for (int j = 0; j < i; ++j) {
+      M.row(j) = M.row(j) - M(j,i) * M.row(i);
+    }
+  }
+}
 
-// Gauss--Jordan elimination for the constraint matrix.
-void FivePointsGaussJordan(Mat *Mp);
-  
 } // namespace libmv
 
 #endif  // LIBMV_MULTIVIEW_FIVE_POINT_H_
-
@@ -1,149 +1,197 @@
-// Copyright (c) 2010 libmv authors.
-// 
-// Permission is hereby granted, free of charge, to any person obtaining a copy
-// of this software and associated documentation files (the "Software"), to
-// deal in the Software without restriction, including without limitation the
-// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
-// sell copies of the Software, and to permit persons to whom the Software is
-// furnished to do so, subject to the following conditions:
-// 
-// The above copyright notice and this permission notice shall be included in
-// all copies or substantial portions of the Software.
-// 
-// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
-// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
-// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
-// IN THE SOFTWARE.
-
-#include "libmv/multiview/five_point_kernel.h"
-#include "libmv/multiview/fundamental.h"
-#include "libmv/multiview/test_data_sets.h"
-#include "testing/testing.h"
-
-namespace {
-using namespace libmv;
-
-/// Check that the E matrix fit the Essential Matrix properties
-/// Determinant is 0
-///
-#define EXPECT_ESSENTIAL_MATRIX_PROPERTIES(E, expectedPrecision) { \
-  EXPECT_NEAR(0, E.determinant(), expectedPrecision); \
-  Mat3 O = 2 * E * E.transpose() * E - (E * E.transpose()).trace() * E; \
-  Mat3 zero3x3 = Mat3::Zero(); \
-  EXPECT_MATRIX_NEAR(zero3x3, O, expectedPrecision);\
-}
-
-/*TEST(FivePointKernelTest, EasyCase) {
-
-  Mat x1(2, 5), x2(2, 5);
-  x1 << 0,   0,  0, .8, .8,
-        0, -.5, .8,  0, .8;
-  x2 << 0,    0,  0, .8, .8,
-        .1, -.4, .9,  0, .9; // Y Translated camera.
-  typedef essential::kernel::FivePointKernel Kernel;
-  Kernel kernel(x1,x2, Mat3::Identity(), Mat3::Identity());
-
-  bool bOk = true;
-  vector<int> samples;
-  for (int i = 0; i < x1.cols(); ++i) {
-    samples.push_back(i);
-  }
-  vector<Mat3> Es;
-  kernel.Fit(samples, &Es);
-
-  bOk &= (Es.size() != 0);
-  for (int i = 0; i < Es.size(); ++i) {
-
-    EXPECT_ESSENTIAL_MATRIX_PROPERTIES(Es[i], 1e-4);
-
-    for(int j = 0; j < x1.cols(); ++j)
-      EXPECT_NEAR(0.0, kernel.Error(j,Es[i]), 1e-8);
-  }
-}*/
-
-TEST(FivePointsRelativePose_Kernel, test_data_sets) {
-
-  typedef essential::kernel::FivePointKernel Kernel;
-
-  int focal = 1000;
-  int principal_Point = 500;
-  Mat3 K;
-  K << focal,     0, principal_Point,
-           0, focal, principal_Point,
-           0,     0, 1;
-
-
-  //int focal = 1;
-  //int principal_Point = 0;
-  //Mat3 K = Mat3::Identity();
-
-
-  //-- Setup a circular camera rig and assert that 5PT relative pose works.
-  const int iNviews = 5;
-  NViewDataSet d = NRealisticCamerasFull(iNviews, Kernel::MINIMUM_SAMPLES,
-    nViewDatasetConfigator(focal,focal,principal_Point,principal_Point,5,0));
-
-  for (int i=0; i <iNviews; ++i)  {
-
-    vector<Mat3> Es, Rs;  // Essential, Rotation matrix.
-    vector<Vec3> ts;      // Translation matrix.
-   
-    // Direct value do not work.
-    // As we use reference, it cannot convert Mat2X& to Mat&
-    Mat x0 = d.x[0];
-    Mat x1 = d.x[1];
-
-    Kernel kernel( x0, x1, K, K);
-    vector<int> samples;
-    for (int k = 0; k < Kernel::MINIMUM_SAMPLES; ++k) {
-      samples.push_back(k);
-    }
-    kernel.Fit(samples, &Es);
-
-    // Recover rotation and translation from E.
-    Rs.resize(Es.size());
-    ts.resize(Es.size());
-    for (int s = 0; s < Es.size(); ++s) {
-      Vec2 x1Col, x2Col;
-      x1Col << d.x[0].col(i)(0), d.x[0].col((i+1)%iNviews)(1);
-      x2Col << d.x[1].col(i)(0), d.x[1].col((i+1)%iNviews)(1);
-      CHECK(
-        MotionFromEssentialAndCorrespondence(Es[s],
-        d.K[0],
-        x1Col,
-        d.K[1],
-        x2Col,
-        &Rs[s],
-        &ts[s]));
-    }
-    //-- Compute Ground Truth motion
-    Mat3 R;
-    Vec3 t, t0 = Vec3::Zero(), t1 = Vec3::Zero();
-    RelativeCameraMotion(d.R[i], d.t[i], d.R[(i+1)%iNviews], d.t[(i+1)%iNviews], &R, &t);
-
-    // Assert that found relative motion is correct for almost one model.
-    bool bsolution_found = false;
-    for (size_t nModel = 0; nModel < Es.size(); ++nModel) {
-
-      // Check that E holds the essential matrix constraints.
-      EXPECT_ESSENTIAL_MATRIX_PROPERTIES(Es[nModel], 1e-8);
-
-      // Check residuals
-      for(int j = 0; j < x1.cols(); ++j)
-        EXPECT_NEAR(0.0, kernel.Error(j,Es[nModel]), 1e-8);
-
-      // Check that we find the correct relative orientation.
-      if (FrobeniusDistance(R, Rs[nModel]) < 1e-3
-        && (t / t.norm() - ts[nModel] / ts[nModel].norm()).norm() < 1e-3 ) {
-          bsolution_found = true;
-      }
-    }
-    //-- Almost one solution must find the correct relative orientation
-    CHECK(bsolution_found);
-  }
-}
-
-}
+// Copyright (c) 2010 libmv authors.
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/multiview/five_point_kernel.h"
+#include "libmv/multiview/fundamental.h"
+#include "libmv/multiview/test_data_sets.h"
+#include "testing/testing.h"
+
+namespace {
+using namespace libmv;
+
+/// Check that the E matrix fit the Essential Matrix properties
+/// Determinant is 0
+///
+#define EXPECT_ESSENTIAL_MATRIX_PROPERTIES(E, expectedPrecision) { \
+  EXPECT_NEAR(0, E.determinant(), expectedPrecision); \
+  Mat3 O = 2 * E * E.transpose() * E - (E * E.transpose()).trace() * E; \
+  Mat3 zero3x3 = Mat3::Zero(); \
+  EXPECT_MATRIX_NEAR(zero3x3, O, expectedPrecision);\
+}
+
+/*TEST(FivePointKernelTest, EasyCase) {
+
+  Mat x1(2, 5), x2(2, 5);
+  x1 << 0,   0,  0, .8, .8,
+        0, -.5, .8,  0, .8;
+  x2 << 0,    0,  0, .8, .8,
+        .1, -.4, .9,  0, .9; // Y Translated camera.
+  typedef essential::kernel::FivePointKernel Kernel;
+  Kernel kernel(x1,x2, Mat3::Identity(), Mat3::Identity());
+
+  bool bOk = true;
+  vector<int> samples;
+  for (int i = 0; i < x1.cols(); ++i) {
+    samples.push_back(i);
+  }
+  vector<Mat3> Es;
+  kernel.Fit(samples, &Es);
+
+  bOk &= (Es.size() != 0);
+  for (int i = 0; i < Es.size(); ++i) {
+
+    EXPECT_ESSENTIAL_MATRIX_PROPERTIES(Es[i], 1e-4);
+
+    for(int j = 0; j < x1.cols(); ++j)
+      EXPECT_NEAR(0.0, kernel.Error(j,Es[i]), 1e-8);
+  }
+}*/
+
+TEST(FivePointsRelativePose_Kernel, test_data_sets) {
+
+  typedef essential::kernel::FivePointKernel Kernel;
+
+  int focal = 1000;
+  int principal_Point = 500;
+  Mat3 K;
+  K << focal,     0, principal_Point,
+           0, focal, principal_Point,
+           0,     0, 1;
+
+
+  //int focal = 1;
+  //int principal_Point = 0;
+  //Mat3 K = Mat3::Identity();
+
+
+  //-- Setup a circular camera rig and assert that 5PT relative pose works.
+  const int iNviews = 5;
+  NViewDataSet d = NRealisticCamerasFull(iNviews, Kernel::MINIMUM_SAMPLES,
+    nViewDatasetConfigator(focal,focal,principal_Point,principal_Point,5,0));
+
+  for (int i=0; i <iNviews; ++i)  {
+
+    vector<Mat3> Es, Rs;  // Essential, Rotation matrix.
+    vector<Vec3> ts;      // Translation matrix.
+   
+    // Direct value do not work.
+    // As we use reference, it cannot convert Mat2X& to Mat&
+    Mat x0 = d.x[0];
+    Mat x1 = d.x[1];
+
+    Kernel kernel( x0, x1, K, K);
+    vector<int> samples;
+    for (int k = 0; k < Kernel::MINIMUM_SAMPLES; ++k) {
+      samples.push_back(k);
+    }
+    kernel.Fit(samples, &Es);
+
+    // Recover rotation and translation from E.
+    Rs.resize(Es.size());
+    ts.resize(Es.size());
+    for (int s = 0; s < Es.size(); ++s) {
+      Vec2 x1Col, x2Col;
+      x1Col << d.x[0].col(i)(0), d.x[0].col((i+1)%iNviews)(1);
+      x2Col << d.x[1].col(i)(0), d.x[1].col((i+1)%iNviews)(1);
+      CHECK(
+        MotionFromEssentialAndCorrespondence(Es[s],
+        d.K[0],
+        x1Col,
+        d.K[1],
+        x2Col,
+        &Rs[s],
+        &ts[s]));
+    }
+    //-- Compute Ground Truth motion
+    Mat3 R;
+    Vec3 t, t0 = Vec3::Zero(), t1 = Vec3::Zero();
+    RelativeCameraMotion(d.R[i], d.t[i], d.R[(i+1)%iNviews], d.t[(i+1)%iNviews], &R, &t);
+
+    // Assert that found relative motion is correct for almost one model.
+    bool bsolution_found = false;
+    for (size_t nModel = 0; nModel < Es.size(); ++nModel) {
+
+      // Check that E holds the essential matrix constraints.
+      EXPECT_ESSENTIAL_MATRIX_PROPERTIES(Es[nModel], 1e-8);
+
+      // Check residuals
+      for(int j = 0; j < x1.cols(); ++j)
+        EXPECT_NEAR(0.0, kernel.Error(j,Es[nModel]), 1e-8);
+
+      // Check that we find the correct relative orientation.
+      if (FrobeniusDistance(R, Rs[nModel]) < 1e-3
+        && (t / t.norm() - ts[nModel] / ts[nModel].norm()).norm() < 1e-3 ) {
+          bsolution_found = true;
+      }
+    }
+    //-- Almost one solution must find the correct relative orientation
+    CHECK(bsolution_found);
+  }
+}
+
+TEST(FivePointsRelativePose_Kernel, NisterFindsTheMotion) {
+  typedef essential::kernel::FivePointNisterKernel Kernel;
+
+  int focal = 1000;
+  int principal_Point = 500;
+  Mat3 K;
+  K << focal,     0, principal_Point,
+           0, focal, principal_Point,
+           0,     0, 1;
+  const int iNviews = 5;
+  NViewDataSet d = NRealisticCamerasFull(iNviews, Kernel::MINIMUM_SAMPLES,
+    nViewDatasetConfigator(focal,focal,principal_Point,principal_Point,5,0));
+
+  for (int i = 0; i < iNviews - 1; ++i) {
+    Mat x0 = d.x[i];
+    Mat x1 = d.x[i + 1];
+    Kernel kernel(x0, x1, K, K);
+    vector<int> samples;
+    for (int k = 0; k < Kernel::MINIMUM_SAMPLES; ++k) {
+      samples.push_back(k);
+    }
+    vector<Mat3> Es;
+    kernel.Fit(samples, &Es);
+
+    Mat3 R;
+    Vec3 t;
+    RelativeCameraMotion(d.R[i], d.t[i], d.R[i + 1], d.t[i + 1], &R, &t);
+    bool solution_found = false;
+    for (size_t nModel = 0; nModel < Es.size(); ++nModel) {
+      EXPECT_ESSENTIAL_MATRIX_PROPERTIES(Es[nModel], 1e-8);
+      for (int j = 0; j < x1.cols(); ++j) {
+        EXPECT_NEAR(0.0, kernel.Error(j, Es[nModel]), 1e-8);
+      }
+      Mat3 R_model;
+      Vec3 t_model;
+      if (MotionFromEssentialAndCorrespondence(Es[nModel],
+                                               d.K[i], d.x[i].col(0),
+                                               d.K[i + 1], d.x[i + 1].col(0),
+                                               &R_model, &t_model) &&
+          FrobeniusDistance(R, R_model) < 1e-3 &&
+          (t / t.norm() - t_model / t_model.norm()).norm() < 1e-3) {
+        solution_found = true;
+      }
+    }
+    EXPECT_TRUE(solution_found);
+  }
+}
+
+}  // namespace
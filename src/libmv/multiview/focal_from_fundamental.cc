@@ -21,6 +21,11 @@
 // 
 // http://axiom.anu.edu.au/~hartley/Papers/focal-lengths/focal.pdf
 
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "libmv/base/thread.h"
 #include "libmv/base/vector.h"
 #include "libmv/numeric/numeric.h"
 #include "libmv/multiview/projection.h"
@@ -92,11 +97,15 @@ void FundamentalShiftPrincipalPoints(const Mat3 &F,
   *F_new = T2.inverse().transpose() * F * T1.inverse();
 }
 
-void FocalFromFundamental(const Mat3 &F,
-                          const Vec2 &principal_point1,
-                          const Vec2 &principal_point2,
-                          double *f1,
-                          double *f2) {
+namespace {
+
+// The squares of the focal lengths of FocalFromFundamental(), which are not
+// positive when F has no such focal lengths.
+void FocalSquaresFromFundamental(const Mat3 &F,
+                                 const Vec2 &principal_point1,
+                                 const Vec2 &principal_point2,
+                                 double *f1_square,
+                                 double *f2_square) {
   Mat3 F_shifted, F_rotated;
   Vec2 zero2;
   zero2 << 0, 0;
@@ -126,10 +135,42 @@ void FocalFromFundamental(const Mat3 &F,
   double d = A(1,1);
 
   // TODO(pau) Should check we are not dividing by 0.
-  double f1_square = - (a * c * Square(e1(0)))
-                     / (a * c * Square(e1(2)) + b * d);
-  double f2_square = - (a * b * Square(e2(0)))
-                     / (a * b * Square(e2(2)) + c * d);
+  *f1_square = - (a * c * Square(e1(0)))
+               / (a * c * Square(e1(2)) + b * d);
+  *f2_square = - (a * b * Square(e2(0)))
+               / (a * b * Square(e2(2)) + c * d);
+}
+
+// Computes the focal lengths of the fundamental matrices i, and stores the
+// real and finite ones in votes[2 i] and votes[2 i + 1], or else 0.
+struct FocalVoter {
+  void operator()(int i) const {
+    double f_squares[2];
+    FocalSquaresFromFundamental((*Fs)[i], principal_point, principal_point,
+                                &f_squares[0], &f_squares[1]);
+    for (int j = 0; j < 2; ++j) {
+      // Also rejects the NaNs.
+      bool is_real = f_squares[j] > 0 &&
+                     f_squares[j] < std::numeric_limits<double>::infinity();
+      (*votes)[2 * i + j] = is_real ? sqrt(f_squares[j]) : 0;
+    }
+  }
+
+  const vector<Mat3> *Fs;
+  Vec2 principal_point;
+  std::vector<double> *votes;
+};
+
+}  // namespace
+
+void FocalFromFundamental(const Mat3 &F,
+                          const Vec2 &principal_point1,
+                          const Vec2 &principal_point2,
+                          double *f1,
+                          double *f2) {
+  double f1_square, f2_square;
+  FocalSquaresFromFundamental(F, principal_point1, principal_point2,
+                              &f1_square, &f2_square);
 
   // TODO(keir) deterimne a sensible thing to do in this case.
   assert(f1_square > 0.);
@@ -138,7 +179,56 @@ void FocalFromFundamental(const Mat3 &F,
   *f2 = sqrt(f2_square);
 }
 
+int FocalFromFundamentals(const vector<Mat3> &Fs,
+                          const Vec2 &principal_point,
+                          double min_focal,
+                          double max_focal,
+                          double tolerance,
+                          int num_threads,
+                          double *focal) {
+  std::vector<double> votes(2 * Fs.size());
+  FocalVoter voter;
+  voter.Fs = &Fs;
+  voter.principal_point = principal_point;
+  voter.votes = &votes;
+  ParallelFor(0, Fs.size(), num_threads, &voter);
+
+  // The votes are compared by their logarithm, so that the window is
+  // relative to the focal length.
+  std::vector<double> log_votes;
+  log_votes.reserve(votes.size());
+  for (int i = 0; i < votes.size(); ++i) {
+    if (votes[i] >= min_focal && votes[i] <= max_focal && votes[i] > 0) {
+      log_votes.push_back(log(votes[i]));
+    }
+  }
+  if (log_votes.empty()) {
+    return 0;
+  }
+  std::sort(log_votes.begin(), log_votes.end());
 
+  // The window of width 2 log(1 + tolerance) with the most votes, found by
+  // sliding it over the sorted votes; the first one wins the ties.
+  double width = 2 * log(1 + tolerance);
+  int best_begin = 0, best_end = 1;
+  for (int begin = 0, end = 0; begin < log_votes.size(); ++begin) {
+    while (end < log_votes.size() &&
+           log_votes[end] - log_votes[begin] <= width) {
+      ++end;
+    }
+    if (end - begin > best_end - best_begin) {
+      best_begin = begin;
+      best_end = end;
+    }
+  }
+  // The median of the window.
+  int count = best_end - best_begin;
+  int middle = best_begin + count / 2;
+  double log_focal = count % 2 ? log_votes[middle]
+                               : (log_votes[middle - 1] + log_votes[middle]) / 2;
+  *focal = exp(log_focal);
+  return count;
+}
 
 //TODO(pau) Move this libmv/numeric and add tests.
 template<class Tf, typename T>
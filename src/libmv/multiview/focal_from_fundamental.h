@@ -23,6 +23,7 @@
 #ifndef LIBMV_MULTIVIEW_FOCAL_FROM_FUNDAMENTAL_H_
 #define LIBMV_MULTIVIEW_FOCAL_FROM_FUNDAMENTAL_H_
 
+#include "libmv/base/vector.h"
 #include "libmv/numeric/numeric.h"
 
 namespace libmv {
@@ -44,6 +45,22 @@ void FocalFromFundamental(const Mat3 &F,
                           double *f1,
                           double *f2);
                           
+// Estimates the focal length shared by the cameras of many image pairs, e.g.
+// of a shoot without zoom, from their fundamental matrices. The two focal
+// lengths of every F are computed in closed form as above, on num_threads
+// threads, and vote if they are real and between min_focal and max_focal.
+// The focal is the median of the most votes that agree within a relative
+// tolerance (e.g. 0.05); the other votes, from bad Fs or pairs close to the
+// degenerate configurations, are ignored. Returns the number of agreeing
+// votes, and 0 without any vote.
+int FocalFromFundamentals(const vector<Mat3> &Fs,
+                          const Vec2 &principal_point,
+                          double min_focal,
+                          double max_focal,
+                          double tolerance,
+                          int num_threads,
+                          double *focal);
+
 void FocalFromFundamentalExhaustive(const Mat3 &F,
                                     const Vec2 &principal_point,
                                     const Mat2X &x1,
@@ -231,6 +231,57 @@ TEST(FocalFromFundamental, TwoViewReconstruction) {
   EXPECT_LE(DistanceL2(t, t_estimated), 1e-8);
 }
 
+// The fundamental matrices of pairs of cameras of focal f in varied poses.
+void FundamentalsOfPairs(double f, int num_pairs, int seed, vector<Mat3> *Fs) {
+  Mat3 K;
+  K << f, 0, 320,
+       0, f, 240,
+       0, 0, 1;
+  for (int i = 0; i < num_pairs; ++i) {
+    double s = seed + i;
+    Mat3 R1 = RotationAroundY(0.2 * sin(s)) * RotationAroundX(0.1 * cos(s));
+    Mat3 R2 = RotationAroundY(-0.3 * cos(1.7 * s)) *
+              RotationAroundX(0.2 * sin(2.3 * s));
+    Vec3 t1(sin(3 * s), 0.5 * cos(s), 10);
+    Vec3 t2(1 + cos(5 * s), sin(0.7 * s), 9);
+    Mat34 P1, P2;
+    P_From_KRt(K, R1, t1, &P1);
+    P_From_KRt(K, R2, t2, &P2);
+    Mat3 F;
+    FundamentalFromProjections(P1, P2, &F);
+    Fs->push_back(F);
+  }
+}
+
+TEST(FocalFromFundamentals, VotesForTheSharedFocal) {
+  vector<Mat3> Fs;
+  FundamentalsOfPairs(800, 20, 1, &Fs);
+  // Pairs of another camera and pure noise are outvoted.
+  FundamentalsOfPairs(500, 5, 100, &Fs);
+  for (int i = 0; i < 5; ++i) {
+    Fs.push_back(Mat3::Random());
+  }
+  Vec2 principal_point(320, 240);
+  double focal = 0;
+  int num_votes = FocalFromFundamentals(Fs, principal_point, 100, 5000, 0.05,
+                                        4, &focal);
+  EXPECT_GE(num_votes, 40);
+  EXPECT_NEAR(800, focal, 1e-3);
+
+  // The same with one thread.
+  double focal_one_thread = 0;
+  EXPECT_EQ(num_votes, FocalFromFundamentals(Fs, principal_point, 100, 5000,
+                                             0.05, 1, &focal_one_thread));
+  EXPECT_EQ(focal, focal_one_thread);
+
+  // Only the votes in range count.
+  EXPECT_EQ(0, FocalFromFundamentals(Fs, principal_point, 900, 1000, 0.05,
+                                     4, &focal));
+  vector<Mat3> none;
+  EXPECT_EQ(0, FocalFromFundamentals(none, principal_point, 100, 5000, 0.05,
+                                     4, &focal));
+}
+
 TEST(FocalFromFundamentalExhaustive, TwoViewReconstruction) {
   // Two cameras at (0,0,-10) and (2,1,-10) looking towards z+.
   TwoViewDataSet d = TwoRealisticCameras(true);
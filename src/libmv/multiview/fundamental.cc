@@ -231,7 +231,7 @@ void NormalizeFundamental(const Mat3 &F, Mat3 *F_normalized) {
 
 // Approximation of reprojection error; page 287 of HZ equation 11.9. This
 // avoids triangulating the point, relying only on the entries in F.
-double SampsonDistance2(const Mat &F, const Vec2 &x1, const Vec2 &x2) {
+double SampsonDistance2(const Mat3 &F, const Vec2 &x1, const Vec2 &x2) {
   Vec3 x(x1(0), x1(1), 1.0);
   Vec3 y(x2(0), x2(1), 1.0);
 
@@ -245,7 +245,7 @@ double SampsonDistance2(const Mat &F, const Vec2 &x1, const Vec2 &x2) {
 
 // Sum of the squared distances from the points to the epipolar lines; page 288
 // of HZ equation 11.10.
-double SymmetricEpipolarDistance2(const Mat &F,
+double SymmetricEpipolarDistance2(const Mat3 &F,
                                   const Vec2 &x1,
                                   const Vec2 &x2) {
   Vec3 x(x1(0), x1(1), 1.0);
@@ -31,20 +31,35 @@
 namespace libmv {
 namespace fundamental {
 namespace kernel {
+namespace {
 
-void SevenPointSolver::Solve(const Mat &x1, const Mat &x2, vector<Mat3> *F) {
+// The solvers work on either Mat or on fixed size matrices of exactly
+// MINIMUM_SAMPLES points (see SolveMinimal()).
+template<typename TMatX>
+void SevenPoint(const TMatX &x1, const TMatX &x2, vector<Mat3> *F) {
   assert(2 == x1.rows());
   assert(7 <= x1.cols());
   assert(x1.rows() == x2.rows());
   assert(x1.cols() == x2.cols());
 
-  // Set up the homogeneous system Af = 0 from the equations x'T*F*x = 0.
-  MatX9 A(x1.cols(), 9);
-  EncodeEpipolarEquation(x1, x2, &A);
-
-  // Find the two F matrices in the nullspace of A.
+  // Set up the homogeneous system Af = 0 from the equations x'T*F*x = 0, and
+  // find the two F matrices in the nullspace of A.
   Vec9 f1, f2;
-  Nullspace2(&A, &f1, &f2);
+  bool solved = false;
+  if (x1.cols() == SevenPointSolver::MINIMUM_SAMPLES) {
+    // Fixed sizes for the minimal samples of the robust estimation.
+    Matrix<double, 7, 9> A;
+    EncodeEpipolarEquation(x1, x2, &A);
+    Matrix<double, 9, 2> basis;
+    solved = MinimalNullspace(A, &basis);
+    f1 = basis.col(0);
+    f2 = basis.col(1);
+  }
+  if (!solved) {
+    MatX9 A(x1.cols(), 9);
+    EncodeEpipolarEquation(x1, x2, &A);
+    Nullspace2(&A, &f1, &f2);
+  }
   Mat3 F1 = Map<RMat3>(f1.data());
   Mat3 F2 = Map<RMat3>(f2.data());
 
@@ -82,17 +97,28 @@ void SevenPointSolver::Solve(const Mat &x1, const Mat &x2, vector<Mat3> *F) {
 }
 
 //template<bool force_essential_constraint>
-void EightPointSolver::Solve(const Mat &x1, const Mat &x2, vector<Mat3> *Fs) {
+template<typename TMatX>
+void EightPoint(const TMatX &x1, const TMatX &x2, vector<Mat3> *Fs) {
   assert(2 == x1.rows());
   assert(8 <= x1.cols());
   assert(x1.rows() == x2.rows());
   assert(x1.cols() == x2.cols());
 
-  MatX9 A(x1.cols(), 9);
-  EncodeEpipolarEquation(x1, x2, &A);
-
   Vec9 f;
-  Nullspace(&A, &f);
+  bool solved = false;
+  if (x1.cols() == EightPointSolver::MINIMUM_SAMPLES) {
+    // Fixed sizes for the minimal samples of the robust estimation.
+    Matrix<double, 8, 9> A;
+    EncodeEpipolarEquation(x1, x2, &A);
+    Matrix<double, 9, 1> basis;
+    solved = MinimalNullspace(A, &basis);
+    f = basis;
+  }
+  if (!solved) {
+    MatX9 A(x1.cols(), 9);
+    EncodeEpipolarEquation(x1, x2, &A);
+    Nullspace(&A, &f);
+  }
   Mat3 F = Map<RMat3>(f.data());
 
   // Force the fundamental property if the A matrix has full rank.
@@ -105,6 +131,28 @@ void EightPointSolver::Solve(const Mat &x1, const Mat &x2, vector<Mat3> *Fs) {
   Fs->push_back(F);
 }
 
+}  // namespace
+
+void SevenPointSolver::Solve(const Mat &x1, const Mat &x2, vector<Mat3> *F) {
+  SevenPoint(x1, x2, F);
+}
+
+void SevenPointSolver::SolveMinimal(const MinimalSample &x1,
+                                    const MinimalSample &x2,
+                                    vector<Mat3> *F) {
+  SevenPoint(x1, x2, F);
+}
+
+void EightPointSolver::Solve(const Mat &x1, const Mat &x2, vector<Mat3> *Fs) {
+  EightPoint(x1, x2, Fs);
+}
+
+void EightPointSolver::SolveMinimal(const MinimalSample &x1,
+                                    const MinimalSample &x2,
+                                    vector<Mat3> *Fs) {
+  EightPoint(x1, x2, Fs);
+}
+
 }  // namespace kernel
 }  // namespace fundamental
 }  // namespace libmv
@@ -23,6 +23,10 @@
 #ifndef LIBMV_MULTIVIEW_FUNDAMENTAL_KERNEL_H_
 #define LIBMV_MULTIVIEW_FUNDAMENTAL_KERNEL_H_
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "libmv/base/vector.h"
 #include "libmv/multiview/conditioning.h"
 #include "libmv/multiview/two_view_kernel.h"
@@ -44,6 +48,92 @@ struct SampsonError {
     return Square(y.dot(F_x)) / (  F_x.head<2>().squaredNorm()
                                 + Ft_y.head<2>().squaredNorm());
   }
+  // Batch version of Error(), see two_view::kernel::HasBatchErrors.
+  static void Errors(const Mat3 &F,
+                     const double *x1, const double *y1,
+                     const double *x2, const double *y2,
+                     int count, double *errors) {
+    int i = 0;
+#ifdef __SSE2__
+    __m128d f00 = _mm_set1_pd(F(0, 0)), f01 = _mm_set1_pd(F(0, 1));
+    __m128d f02 = _mm_set1_pd(F(0, 2)), f10 = _mm_set1_pd(F(1, 0));
+    __m128d f11 = _mm_set1_pd(F(1, 1)), f12 = _mm_set1_pd(F(1, 2));
+    __m128d f20 = _mm_set1_pd(F(2, 0)), f21 = _mm_set1_pd(F(2, 1));
+    __m128d f22 = _mm_set1_pd(F(2, 2));
+    for (; i + 2 <= count; i += 2) {
+      __m128d u1 = _mm_loadu_pd(x1 + i), v1 = _mm_loadu_pd(y1 + i);
+      __m128d u2 = _mm_loadu_pd(x2 + i), v2 = _mm_loadu_pd(y2 + i);
+      // F * x1 and the first two coordinates of F^T * x2.
+      __m128d a = _mm_add_pd(_mm_add_pd(_mm_mul_pd(f00, u1),
+                                        _mm_mul_pd(f01, v1)), f02);
+      __m128d b = _mm_add_pd(_mm_add_pd(_mm_mul_pd(f10, u1),
+                                        _mm_mul_pd(f11, v1)), f12);
+      __m128d c = _mm_add_pd(_mm_add_pd(_mm_mul_pd(f20, u1),
+                                        _mm_mul_pd(f21, v1)), f22);
+      __m128d d = _mm_add_pd(_mm_add_pd(_mm_mul_pd(f00, u2),
+                                        _mm_mul_pd(f10, v2)), f20);
+      __m128d e = _mm_add_pd(_mm_add_pd(_mm_mul_pd(f01, u2),
+                                        _mm_mul_pd(f11, v2)), f21);
+      __m128d r = _mm_add_pd(_mm_add_pd(_mm_mul_pd(u2, a),
+                                        _mm_mul_pd(v2, b)), c);
+      __m128d n = _mm_add_pd(_mm_add_pd(_mm_mul_pd(a, a), _mm_mul_pd(b, b)),
+                             _mm_add_pd(_mm_mul_pd(d, d), _mm_mul_pd(e, e)));
+      _mm_storeu_pd(errors + i, _mm_div_pd(_mm_mul_pd(r, r), n));
+    }
+#endif
+    for (; i < count; ++i) {
+      double a = F(0, 0) * x1[i] + F(0, 1) * y1[i] + F(0, 2);
+      double b = F(1, 0) * x1[i] + F(1, 1) * y1[i] + F(1, 2);
+      double c = F(2, 0) * x1[i] + F(2, 1) * y1[i] + F(2, 2);
+      double d = F(0, 0) * x2[i] + F(1, 0) * y2[i] + F(2, 0);
+      double e = F(0, 1) * x2[i] + F(1, 1) * y2[i] + F(2, 1);
+      double r = x2[i] * a + y2[i] * b + c;
+      errors[i] = r * r / (a * a + b * b + d * d + e * e);
+    }
+  }
+  // Same as above in single precision, four samples at a time.
+  static void Errors(const Mat3 &F,
+                     const float *x1, const float *y1,
+                     const float *x2, const float *y2,
+                     int count, float *errors) {
+    Mat3f Ff = F.cast<float>();
+    int i = 0;
+#ifdef __SSE2__
+    __m128 f00 = _mm_set1_ps(Ff(0, 0)), f01 = _mm_set1_ps(Ff(0, 1));
+    __m128 f02 = _mm_set1_ps(Ff(0, 2)), f10 = _mm_set1_ps(Ff(1, 0));
+    __m128 f11 = _mm_set1_ps(Ff(1, 1)), f12 = _mm_set1_ps(Ff(1, 2));
+    __m128 f20 = _mm_set1_ps(Ff(2, 0)), f21 = _mm_set1_ps(Ff(2, 1));
+    __m128 f22 = _mm_set1_ps(Ff(2, 2));
+    for (; i + 4 <= count; i += 4) {
+      __m128 u1 = _mm_loadu_ps(x1 + i), v1 = _mm_loadu_ps(y1 + i);
+      __m128 u2 = _mm_loadu_ps(x2 + i), v2 = _mm_loadu_ps(y2 + i);
+      __m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(f00, u1),
+                                       _mm_mul_ps(f01, v1)), f02);
+      __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(f10, u1),
+                                       _mm_mul_ps(f11, v1)), f12);
+      __m128 c = _mm_add_ps(_mm_add_ps(_mm_mul_ps(f20, u1),
+                                       _mm_mul_ps(f21, v1)), f22);
+      __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(f00, u2),
+                                       _mm_mul_ps(f10, v2)), f20);
+      __m128 e = _mm_add_ps(_mm_add_ps(_mm_mul_ps(f01, u2),
+                                       _mm_mul_ps(f11, v2)), f21);
+      __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(u2, a),
+                                       _mm_mul_ps(v2, b)), c);
+      __m128 n = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b)),
+                            _mm_add_ps(_mm_mul_ps(d, d), _mm_mul_ps(e, e)));
+      _mm_storeu_ps(errors + i, _mm_div_ps(_mm_mul_ps(r, r), n));
+    }
+#endif
+    for (; i < count; ++i) {
+      float a = Ff(0, 0) * x1[i] + Ff(0, 1) * y1[i] + Ff(0, 2);
+      float b = Ff(1, 0) * x1[i] + Ff(1, 1) * y1[i] + Ff(1, 2);
+      float c = Ff(2, 0) * x1[i] + Ff(2, 1) * y1[i] + Ff(2, 2);
+      float d = Ff(0, 0) * x2[i] + Ff(1, 0) * y2[i] + Ff(2, 0);
+      float e = Ff(0, 1) * x2[i] + Ff(1, 1) * y2[i] + Ff(2, 1);
+      float r = x2[i] * a + y2[i] * b + c;
+      errors[i] = r * r / (a * a + b * b + d * d + e * e);
+    }
+  }
 };
 
 struct SymmetricEpipolarDistanceError {
@@ -72,11 +162,21 @@ struct SymmetricEpipolarDistanceError {
 struct SevenPointSolver {
   enum { MINIMUM_SAMPLES = 7 };
   static void Solve(const Mat &x1, const Mat &x2, vector<Mat3> *F);
+
+  typedef Matrix<double, 2, MINIMUM_SAMPLES> MinimalSample;
+  static void SolveMinimal(const MinimalSample &x1,
+                           const MinimalSample &x2,
+                           vector<Mat3> *F);
 };
 
 struct EightPointSolver {
   enum { MINIMUM_SAMPLES = 8 };
   static void Solve(const Mat &x1, const Mat &x2, vector<Mat3> *Fs);
+
+  typedef Matrix<double, 2, MINIMUM_SAMPLES> MinimalSample;
+  static void SolveMinimal(const MinimalSample &x1,
+                           const MinimalSample &x2,
+                           vector<Mat3> *Fs);
 };
 
 typedef two_view::kernel::Kernel<SevenPointSolver, SampsonError, Mat3>
@@ -97,9 +197,25 @@ typedef two_view::kernel::Kernel<
     Mat3>
   NormalizedEightPointKernel;
 
+// Same as the above, with the points normalized once when the kernel is
+// built rather than for each sample.
+typedef two_view::kernel::PrenormalizedKernel<
+    SevenPointSolver, UnnormalizerT, SampsonError, Mat3>
+  PrenormalizedSevenPointKernel;
+
+typedef two_view::kernel::PrenormalizedKernel<
+    EightPointSolver, UnnormalizerT, SampsonError, Mat3>
+  PrenormalizedEightPointKernel;
+
 // Set the default kernel to normalized 7 point, because it is the fastest (in
 // a robust estimation context) and most robust of the above kernels.
-typedef NormalizedSevenPointKernel Kernel;
+typedef PrenormalizedSevenPointKernel Kernel;
+
+// Same as Kernel, but the Sampson errors of the scoring are computed in single
+// precision. The fundamental matrices are still fitted in double.
+typedef two_view::kernel::PrenormalizedKernel<
+    SevenPointSolver, UnnormalizerT, SampsonError, Mat3, false, float>
+  FloatScoringKernel;
 
 // TODO(keir): Convert this to a solver that enforces the essential
 // constraints; in particular det(F) = 0 and the two nonzero singular values
@@ -96,6 +96,7 @@ struct SevenPointTest : public testing::Test {
 };
 typedef Types<SevenPointKernel,
               NormalizedSevenPointKernel,
+              PrenormalizedSevenPointKernel,
               Kernel>
   SevenPointImplementations;
 
@@ -138,7 +139,8 @@ struct EightPointTest : public SevenPointTest<Kernel> {
 };
 
 typedef Types<EightPointKernel,
-              NormalizedEightPointKernel>
+              NormalizedEightPointKernel,
+              PrenormalizedEightPointKernel>
   EightPointImplementations;
 
 TYPED_TEST_CASE(EightPointTest, EightPointImplementations);
@@ -200,4 +202,93 @@ TYPED_TEST(FundamentalErrorTest, FundamentalErrorTest2) {
   EXPECT_EQ(2 * Square(10. / 2), dists[5]);
 }
 
+TEST(SampsonError, BatchErrorsMatchError) {
+  Mat3 F;
+  F << 0.1, -2.0,  0.3,
+       1.5,  0.2, -1.0,
+      -0.4,  2.0,  0.5;
+  const int n = 7;  // Odd, to exercise the scalar tail.
+  Mat x1 = Mat::Random(2, n), x2 = Mat::Random(2, n);
+  typedef two_view::kernel::Kernel<EightPointSolver, SampsonError> Kernel;
+  EXPECT_TRUE(two_view::kernel::HasBatchErrors<SampsonError>::value);
+  EXPECT_FALSE(two_view::kernel::HasBatchErrors<
+      SymmetricEpipolarDistanceError>::value);
+  Kernel kernel(x1, x2);
+  double errors[n];
+  kernel.Errors(F, 0, n, errors);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_NEAR(kernel.Error(i, F), errors[i], 1e-12);
+  }
+  kernel.Errors(F, 3, 2, errors);
+  EXPECT_NEAR(kernel.Error(3, F), errors[0], 1e-12);
+  EXPECT_NEAR(kernel.Error(4, F), errors[1], 1e-12);
+}
+
+TEST(SampsonError, FloatBatchErrorsMatchError) {
+  Mat3 F;
+  F << 0.1, -2.0,  0.3,
+       1.5,  0.2, -1.0,
+      -0.4,  2.0,  0.5;
+  const int n = 11;  // Not a multiple of 4, to exercise the scalar tail.
+  Mat x1 = Mat::Random(2, n), x2 = Mat::Random(2, n);
+  EXPECT_TRUE((two_view::kernel::HasBatchErrors<SampsonError, float>::value));
+  FloatScoringKernel kernel(x1, x2);
+  EXPECT_TRUE(FloatScoringKernel::BATCH_ERRORS);
+  double errors[n];
+  kernel.Errors(F, 0, n, errors);
+  for (int i = 0; i < n; ++i) {
+    double error = kernel.Error(i, F);
+    EXPECT_NEAR(error, errors[i], 1e-5 * std::max(1.0, error));
+  }
+  kernel.Errors(F, 5, 3, errors);
+  EXPECT_NEAR(kernel.Error(5, F), errors[0], 1e-5);
+}
+
+TEST(SymmetricEpipolarDistanceError, KernelErrorsWithoutBatch) {
+  Mat3 F;
+  F << 0.1, -2.0,  0.3,
+       1.5,  0.2, -1.0,
+      -0.4,  2.0,  0.5;
+  Mat x1 = Mat::Random(2, 5), x2 = Mat::Random(2, 5);
+  typedef two_view::kernel::Kernel<EightPointSolver,
+                                   SymmetricEpipolarDistanceError> Kernel;
+  Kernel kernel(x1, x2);
+  double errors[5];
+  kernel.Errors(F, 0, 5, errors);
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(kernel.Error(i, F), errors[i]);
+  }
+}
+
+TEST(NormalizedSevenPointKernel, MinimalSampleFitMatchesSolve) {
+  EXPECT_TRUE(two_view::kernel::HasSolveMinimal<SevenPointSolver>::value);
+  typedef two_view::kernel::NormalizedSolver<SevenPointSolver,
+                                             UnnormalizerT> Solver;
+  EXPECT_TRUE(two_view::kernel::HasSolveMinimal<Solver>::value);
+  EXPECT_FALSE(two_view::kernel::HasSolveMinimal<
+      fundamental::kernel::SampsonError>::value);
+  Mat x1 = Mat::Random(2, 10), x2 = Mat::Random(2, 10);
+  NormalizedSevenPointKernel kernel(x1, x2);
+  vector<int> samples;
+  samples.push_back(9);
+  samples.push_back(2);
+  samples.push_back(5);
+  samples.push_back(0);
+  samples.push_back(7);
+  samples.push_back(3);
+  samples.push_back(8);
+
+  // Fitting appends to the models already there.
+  vector<Mat3> Fs(1, Mat3::Identity()), Fs_expected;
+  kernel.Fit(samples, &Fs);
+  NormalizedSevenPointKernel::Solve(ExtractColumns(x1, samples),
+                                    ExtractColumns(x2, samples),
+                                    &Fs_expected);
+  ASSERT_EQ(Fs_expected.size() + 1, Fs.size());
+  EXPECT_MATRIX_NEAR(Mat3::Identity(), Fs[0], 0);
+  for (int i = 0; i < Fs_expected.size(); ++i) {
+    EXPECT_MATRIX_PROP(Fs_expected[i], Fs[i + 1], 1e-6);
+  }
+}
+
 } // namespace
@@ -26,6 +26,8 @@
 #include "libmv/multiview/homography_error.h"
 #include "libmv/multiview/homography_parameterization.h"
 #include "libmv/multiview/projection.h"
+#include "libmv/numeric/levenberg_marquardt.h"
+#include "libmv/optimize/jet_jacobian.h"
 
 #include <iostream>
 
@@ -99,6 +101,42 @@ bool Homography2DFromCorrespondencesLinearEuc(
   }
 }
 
+bool Homography2DFromFourCorrespondences(const Matrix<double, 2, 4> &x1,
+                                         const Matrix<double, 2, 4> &x2,
+                                         Mat3 *H) {
+  // Two equations per correspondence of the cross product x2 x (H * x1) = 0,
+  // with h the coefficients of H in row major order. Solving for the
+  // nullspace rather than fixing h(8) = 1 also works when the homography of
+  // the (normalized) points has H(2, 2) close to 0.
+  Matrix<double, 8, 9> A = Matrix<double, 8, 9>::Zero();
+  for (int i = 0; i < 4; ++i) {
+    int j = 2 * i;
+    A(j, 0) = x1(0, i);
+    A(j, 1) = x1(1, i);
+    A(j, 2) = 1.0;
+    A(j, 6) = -x2(0, i) * x1(0, i);
+    A(j, 7) = -x2(0, i) * x1(1, i);
+    A(j, 8) = -x2(0, i);
+
+    ++j;
+    A(j, 3) = x1(0, i);
+    A(j, 4) = x1(1, i);
+    A(j, 5) = 1.0;
+    A(j, 6) = -x2(1, i) * x1(0, i);
+    A(j, 7) = -x2(1, i) * x1(1, i);
+    A(j, 8) = -x2(1, i);
+  }
+  Vec9 h;
+  if (!MinimalNullspace(A, &h)) {
+    return false;
+  }
+  *H = Map<RMat3>(h.data());
+  if ((*H)(2, 2) != 0) {
+    *H /= (*H)(2, 2);
+  }
+  return true;
+}
+
 /** 2D Homography transformation estimation in the case that points are in 
  * homogeneous coordinates.
  *
@@ -273,4 +311,133 @@ bool Homography3DFromCorrespondencesLinear(const Mat &x1,
     return false;
   }
 }
+
+namespace {
+
+// Transfer error of the 8 parameters a, ... h of H (H(2, 2) == 1), see
+// Homography2DNormalizedParameterization.
+class Homography2DTransferError {
+ public:
+  typedef Vec FMatrixType;
+  typedef Vec8 XMatrixType;
+
+  Homography2DTransferError(const Mat &x1, const Mat &x2) : x1_(x1), x2_(x2) {}
+
+  int NumResiduals() const { return 2 * x1_.cols(); }
+
+  template<typename T>
+  void Evaluate(const T *h, T *residuals) const {
+    for (int i = 0; i < x1_.cols(); ++i) {
+      double w1 = x1_.rows() == 3 ? x1_(2, i) : 1.0;
+      double w2 = x2_.rows() == 3 ? x2_(2, i) : 1.0;
+      T x = h[0] * x1_(0, i) + h[1] * x1_(1, i) + h[2] * w1;
+      T y = h[3] * x1_(0, i) + h[4] * x1_(1, i) + h[5] * w1;
+      T z = h[6] * x1_(0, i) + h[7] * x1_(1, i) + T(w1);
+      residuals[2 * i + 0] = x / z - x2_(0, i) / w2;
+      residuals[2 * i + 1] = y / z - x2_(1, i) / w2;
+    }
+  }
+
+  Vec operator()(const Vec8 &h) const {
+    Vec residuals(NumResiduals());
+    Evaluate(h.data(), residuals.data());
+    return residuals;
+  }
+
+ private:
+  const Mat &x1_;
+  const Mat &x2_;
+};
+
+// Same as Homography2DTransferError for euclidean points, with the opposite
+// sign, through the batch AsymmetricError::BatchResiduals().
+class Homography2DBatchTransferError {
+ public:
+  typedef Vec FMatrixType;
+  typedef Vec8 XMatrixType;
+
+  Homography2DBatchTransferError(const Mat2X &x1, const Mat2X &x2)
+      : x1_(x1), x2_(x2) {}
+
+  int NumResiduals() const { return 2 * x1_.cols(); }
+
+  Vec operator()(const Vec8 &h) const {
+    Mat3 H;
+    Homography2DNormalizedParameterization<double>::To(h, &H);
+    Vec residuals(NumResiduals());
+    AsymmetricError::BatchResiduals(H, x1_, x2_, 0, x1_.cols(),
+                                    residuals.data());
+    return residuals;
+  }
+
+  // Analytic Jacobian, computed in the same pass as the residuals.
+  Matrix<double, Dynamic, 8> Jacobian(const Vec8 &h) const {
+    Mat3 H;
+    Homography2DNormalizedParameterization<double>::To(h, &H);
+    Vec residuals(NumResiduals());
+    Matrix<double, Dynamic, 8> jacobian(NumResiduals(), 8);
+    AsymmetricError::BatchResiduals(H, x1_, x2_, 0, x1_.cols(),
+                                    residuals.data(),
+                                    jacobian.data(), jacobian.rows());
+    return jacobian;
+  }
+
+ private:
+  const Mat2X &x1_;
+  const Mat2X &x2_;
+};
+
+// The Jacobian policy of LevenbergMarquardt for Homography2DBatchTransferError.
+class Homography2DBatchTransferJacobian {
+ public:
+  Homography2DBatchTransferJacobian(const Homography2DBatchTransferError &f)
+      : f_(f) {}
+
+  Matrix<double, Dynamic, 8> operator()(const Vec8 &h) const {
+    return f_.Jacobian(h);
+  }
+
+ private:
+  const Homography2DBatchTransferError &f_;
+};
+
+}  // namespace
+
+bool Homography2DFromCorrespondencesRefine(const Mat &x1,
+                                           const Mat &x2,
+                                           Mat3 *H) {
+  assert(x1.cols() == x2.cols());
+  if ((*H)(2, 2) == 0) {
+    return false;
+  }
+  Mat3 normalized = *H / (*H)(2, 2);
+  Vec8 h;
+  Homography2DNormalizedParameterization<double>::From(normalized, &h);
+
+  if (x1.rows() == 2 && x2.rows() == 2) {
+    // Euclidean points: batch residuals and analytic Jacobian.
+    Mat2X x1_euclidean = x1, x2_euclidean = x2;
+    typedef LevenbergMarquardt<Homography2DBatchTransferError,
+                               Homography2DBatchTransferJacobian> Solver;
+    Homography2DBatchTransferError transfer_error(x1_euclidean, x2_euclidean);
+    Solver::SolverParameters params;
+    Solver lm(transfer_error);
+    Solver::Results results = lm.minimize(params, &h);
+    VLOG(3) << "Refined homography, error " << results.error_magnitude
+            << " after " << results.iterations << " iterations.";
+  } else {
+    typedef LevenbergMarquardt<Homography2DTransferError,
+                               JetJacobian<Homography2DTransferError> > Solver;
+    Homography2DTransferError transfer_error(x1, x2);
+    Solver::SolverParameters params;
+    Solver lm(transfer_error);
+    Solver::Results results = lm.minimize(params, &h);
+    VLOG(3) << "Refined homography, error " << results.error_magnitude
+            << " after " << results.iterations << " iterations.";
+  }
+
+  Homography2DNormalizedParameterization<double>::To(h, H);
+  return true;
+}
+
 }  // namespace libmv
@@ -52,6 +52,20 @@ bool Homography2DFromCorrespondencesLinear(const Mat &x1,
                                            double expected_precision = 
                                              EigenDouble::dummy_precision());
 
+/** 2D Homography transformation estimation from exactly 4 correspondences.
+ *
+ * Same as Homography2DFromCorrespondencesLinear() for 2x4 matrices of
+ * euclidean points, but the points and the 8x9 homogeneous system given by
+ * the first two equations of each correspondence have fixed sizes, hence no
+ * allocation. Used by the minimal solver of the robust estimation.
+ * H is normalized so that H(2, 2) == 1, unless H(2, 2) is 0.
+ *
+ * \return false if three of the points are aligned (rank deficient system)
+ */
+bool Homography2DFromFourCorrespondences(const Matrix<double, 2, 4> &x1,
+                                         const Matrix<double, 2, 4> &x2,
+                                         Mat3 *H);
+
 /** 3D Homography transformation estimation.
  * 
  * This function can be used in order to estimate the homography transformation
@@ -77,6 +91,22 @@ bool Homography3DFromCorrespondencesLinear(const Mat &x1,
                                            Mat4 *H,
                                            double expected_precision = 
                                              EigenDouble::dummy_precision());
+
+/** 2D Homography refinement.
+ *
+ * Minimizes the transfer error in the second image, sum ||x2 - Psi(H x1)||^2,
+ * by Levenberg-Marquardt starting from H, with the Jacobian computed by
+ * automatic differentiation (JetJacobian).
+ *
+ * \param[in] x1 The first 2xN or 3xN matrix of euclidean or homogeneous points
+ * \param[in] x2 The second 2xN or 3xN matrix of euclidean or homogeneous points
+ * \param[in/out] H The 3x3 homography, normalized so that H(2, 2) == 1
+ *
+ * \return false if H cannot be normalized (H(2, 2) == 0)
+ */
+bool Homography2DFromCorrespondencesRefine(const Mat &x1,
+                                           const Mat &x2,
+                                           Mat3 *H);
 } // namespace libmv
 
 #endif  // LIBMV_MULTIVIEW_HOMOGRAPHY_H_
@@ -21,6 +21,12 @@
 #ifndef LIBMV_MULTIVIEW_HOMOGRAPHY_ERRORS_H_
 #define LIBMV_MULTIVIEW_HOMOGRAPHY_ERRORS_H_
 
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "libmv/multiview/projection.h"
 
 namespace libmv {
@@ -49,18 +55,16 @@ struct AsymmetricError {
    */
   static void Residuals(const Mat &H, const Mat &x1, 
                         const Mat &x2, Mat2X *dx) {
+    // Column by column in fixed size vectors, without temporary matrices.
     dx->resize(2, x1.cols());
-    Mat3X x2h_est;
-    if (x1.rows() == 2)
-      x2h_est = H * EuclideanToHomogeneous(static_cast<Mat2X>(x1));
-    else
-      x2h_est = H * x1;
-    dx->row(0) = x2h_est.row(0).array() / x2h_est.row(2).array();
-    dx->row(1) = x2h_est.row(1).array() / x2h_est.row(2).array();
-    if (x2.rows() == 2)
-      *dx = x2 - *dx;
-    else
-      *dx = HomogeneousToEuclidean(static_cast<Mat3X>(x2)) - *dx;
+    Mat3 H3 = H;
+    for (int c = 0; c < x1.cols(); ++c) {
+      Vec3 x1h(x1(0, c), x1(1, c), x1.rows() == 2 ? 1.0 : x1(2, c));
+      Vec3 x2h_est = H3 * x1h;
+      double w2 = x2.rows() == 2 ? 1.0 : x2(2, c);
+      (*dx)(0, c) = x2(0, c) / w2 - x2h_est(0) / x2h_est(2);
+      (*dx)(1, c) = x2(1, c) / w2 - x2h_est(1) / x2h_est(2);
+    }
   }
   /**
    * Computes the asymmetric residuals between a 2D point x2 and the transformed 
@@ -119,6 +123,186 @@ struct AsymmetricError {
     Residuals(H, x1, x2, &dx);
     return dx.squaredNorm();
   }
+  /**
+   * Computes the squared norms of the residuals of count correspondences,
+   * given as structure of arrays (see two_view::kernel::HasBatchErrors).
+   *
+   * \param[in]  H The 3x3 homography matrix.
+   * \param[in]  x1,y1 The coordinates of the 2D points x1.
+   * \param[in]  x2,y2 The coordinates of the 2D points x2.
+   * \param[out] errors The count squared norms of the residuals.
+   */
+  static void Errors(const Mat3 &H,
+                     const double *x1, const double *y1,
+                     const double *x2, const double *y2,
+                     int count, double *errors) {
+    int i = 0;
+#ifdef __SSE2__
+    __m128d h00 = _mm_set1_pd(H(0, 0)), h01 = _mm_set1_pd(H(0, 1));
+    __m128d h02 = _mm_set1_pd(H(0, 2)), h10 = _mm_set1_pd(H(1, 0));
+    __m128d h11 = _mm_set1_pd(H(1, 1)), h12 = _mm_set1_pd(H(1, 2));
+    __m128d h20 = _mm_set1_pd(H(2, 0)), h21 = _mm_set1_pd(H(2, 1));
+    __m128d h22 = _mm_set1_pd(H(2, 2));
+    for (; i + 2 <= count; i += 2) {
+      __m128d u = _mm_loadu_pd(x1 + i), v = _mm_loadu_pd(y1 + i);
+      __m128d a = _mm_add_pd(_mm_add_pd(_mm_mul_pd(h00, u),
+                                        _mm_mul_pd(h01, v)), h02);
+      __m128d b = _mm_add_pd(_mm_add_pd(_mm_mul_pd(h10, u),
+                                        _mm_mul_pd(h11, v)), h12);
+      __m128d c = _mm_add_pd(_mm_add_pd(_mm_mul_pd(h20, u),
+                                        _mm_mul_pd(h21, v)), h22);
+      __m128d dx = _mm_sub_pd(_mm_loadu_pd(x2 + i), _mm_div_pd(a, c));
+      __m128d dy = _mm_sub_pd(_mm_loadu_pd(y2 + i), _mm_div_pd(b, c));
+      _mm_storeu_pd(errors + i, _mm_add_pd(_mm_mul_pd(dx, dx),
+                                           _mm_mul_pd(dy, dy)));
+    }
+#endif
+    for (; i < count; ++i) {
+      double a = H(0, 0) * x1[i] + H(0, 1) * y1[i] + H(0, 2);
+      double b = H(1, 0) * x1[i] + H(1, 1) * y1[i] + H(1, 2);
+      double c = H(2, 0) * x1[i] + H(2, 1) * y1[i] + H(2, 2);
+      double dx = x2[i] - a / c;
+      double dy = y2[i] - b / c;
+      errors[i] = dx * dx + dy * dy;
+    }
+  }
+  /**
+   * Same as above in single precision, four correspondences at a time.
+   */
+  static void Errors(const Mat3 &H,
+                     const float *x1, const float *y1,
+                     const float *x2, const float *y2,
+                     int count, float *errors) {
+    Mat3f Hf = H.cast<float>();
+    int i = 0;
+#ifdef __SSE2__
+    __m128 h00 = _mm_set1_ps(Hf(0, 0)), h01 = _mm_set1_ps(Hf(0, 1));
+    __m128 h02 = _mm_set1_ps(Hf(0, 2)), h10 = _mm_set1_ps(Hf(1, 0));
+    __m128 h11 = _mm_set1_ps(Hf(1, 1)), h12 = _mm_set1_ps(Hf(1, 2));
+    __m128 h20 = _mm_set1_ps(Hf(2, 0)), h21 = _mm_set1_ps(Hf(2, 1));
+    __m128 h22 = _mm_set1_ps(Hf(2, 2));
+    for (; i + 4 <= count; i += 4) {
+      __m128 u = _mm_loadu_ps(x1 + i), v = _mm_loadu_ps(y1 + i);
+      __m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(h00, u),
+                                       _mm_mul_ps(h01, v)), h02);
+      __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(h10, u),
+                                       _mm_mul_ps(h11, v)), h12);
+      __m128 c = _mm_add_ps(_mm_add_ps(_mm_mul_ps(h20, u),
+                                       _mm_mul_ps(h21, v)), h22);
+      __m128 dx = _mm_sub_ps(_mm_loadu_ps(x2 + i), _mm_div_ps(a, c));
+      __m128 dy = _mm_sub_ps(_mm_loadu_ps(y2 + i), _mm_div_ps(b, c));
+      _mm_storeu_ps(errors + i, _mm_add_ps(_mm_mul_ps(dx, dx),
+                                           _mm_mul_ps(dy, dy)));
+    }
+#endif
+    for (; i < count; ++i) {
+      float a = Hf(0, 0) * x1[i] + Hf(0, 1) * y1[i] + Hf(0, 2);
+      float b = Hf(1, 0) * x1[i] + Hf(1, 1) * y1[i] + Hf(1, 2);
+      float c = Hf(2, 0) * x1[i] + Hf(2, 1) * y1[i] + Hf(2, 2);
+      float dx = x2[i] - a / c;
+      float dy = y2[i] - b / c;
+      errors[i] = dx * dx + dy * dy;
+    }
+  }
+  /**
+   * Computes the asymmetric residuals of the correspondences
+   * [first, first + count) of two sets of 2D points, such that
+   *   Residuals_i = x2_i - Psi(H * x1_i)
+   * and optionally their Jacobian with respect to the 8 parameters of
+   * Homography2DNormalizedParameterization, i.e. the entries of H but H(2, 2).
+   *
+   * \param[in]  H The 3x3 homography matrix.
+   * \param[in]  x1 The first 2xN matrix of euclidean points.
+   * \param[in]  x2 The second 2xN matrix of euclidean points.
+   * \param[in]  first,count The range of correspondences.
+   * \param[out] residuals The 2 * count residuals, laid out as the columns of
+   *             a 2 x count matrix.
+   * \param[out] jacobian If not NULL, the (2 * count) x 8 Jacobian of the
+   *             residuals, stored column major with jacobian_stride between
+   *             the columns (e.g. a block of a Mat).
+   */
+  static void BatchResiduals(const Mat3 &H, const Mat2X &x1, const Mat2X &x2,
+                             int first, int count, double *residuals,
+                             double *jacobian = NULL,
+                             int jacobian_stride = 0) {
+    assert(0 <= first && first + count <= x1.cols());
+    const double *p1 = x1.data() + 2 * first;
+    const double *p2 = x2.data() + 2 * first;
+    int i = 0;
+#ifdef __SSE2__
+    __m128d h00 = _mm_set1_pd(H(0, 0)), h01 = _mm_set1_pd(H(0, 1));
+    __m128d h02 = _mm_set1_pd(H(0, 2)), h10 = _mm_set1_pd(H(1, 0));
+    __m128d h11 = _mm_set1_pd(H(1, 1)), h12 = _mm_set1_pd(H(1, 2));
+    __m128d h20 = _mm_set1_pd(H(2, 0)), h21 = _mm_set1_pd(H(2, 1));
+    __m128d h22 = _mm_set1_pd(H(2, 2));
+    __m128d zero = _mm_setzero_pd();
+    for (; i + 2 <= count; i += 2) {
+      // Two points at a time: (x, y) pairs to (x_i, x_i+1) and (y_i, y_i+1).
+      __m128d q0 = _mm_loadu_pd(p1 + 2 * i), q1 = _mm_loadu_pd(p1 + 2 * i + 2);
+      __m128d u = _mm_unpacklo_pd(q0, q1), v = _mm_unpackhi_pd(q0, q1);
+      __m128d a = _mm_add_pd(_mm_add_pd(_mm_mul_pd(h00, u),
+                                        _mm_mul_pd(h01, v)), h02);
+      __m128d b = _mm_add_pd(_mm_add_pd(_mm_mul_pd(h10, u),
+                                        _mm_mul_pd(h11, v)), h12);
+      __m128d c = _mm_add_pd(_mm_add_pd(_mm_mul_pd(h20, u),
+                                        _mm_mul_pd(h21, v)), h22);
+      __m128d inv_c = _mm_div_pd(_mm_set1_pd(1.0), c);
+      __m128d a_c = _mm_mul_pd(a, inv_c), b_c = _mm_mul_pd(b, inv_c);
+      q0 = _mm_loadu_pd(p2 + 2 * i);
+      q1 = _mm_loadu_pd(p2 + 2 * i + 2);
+      __m128d dx = _mm_sub_pd(_mm_unpacklo_pd(q0, q1), a_c);
+      __m128d dy = _mm_sub_pd(_mm_unpackhi_pd(q0, q1), b_c);
+      _mm_storeu_pd(residuals + 2 * i, _mm_unpacklo_pd(dx, dy));
+      _mm_storeu_pd(residuals + 2 * i + 2, _mm_unpackhi_pd(dx, dy));
+      if (jacobian) {
+        // d(dx)/dh = -(x, y, 1, 0, 0, 0, -x a/c, -y a/c) / c, and
+        // d(dy)/dh = -(0, 0, 0, x, y, 1, -x b/c, -y b/c) / c.
+        __m128d minus_inv_c = _mm_sub_pd(zero, inv_c);
+        __m128d ju = _mm_mul_pd(u, minus_inv_c);
+        __m128d jv = _mm_mul_pd(v, minus_inv_c);
+        __m128d columns_x[3] = { ju, jv, minus_inv_c };
+        for (int k = 0; k < 3; ++k) {
+          double *column = jacobian + k * jacobian_stride + 2 * i;
+          _mm_storeu_pd(column, _mm_unpacklo_pd(columns_x[k], zero));
+          _mm_storeu_pd(column + 2, _mm_unpackhi_pd(columns_x[k], zero));
+          column = jacobian + (k + 3) * jacobian_stride + 2 * i;
+          _mm_storeu_pd(column, _mm_unpacklo_pd(zero, columns_x[k]));
+          _mm_storeu_pd(column + 2, _mm_unpackhi_pd(zero, columns_x[k]));
+        }
+        __m128d jw[2] = { _mm_sub_pd(zero, ju), _mm_sub_pd(zero, jv) };
+        for (int k = 0; k < 2; ++k) {
+          __m128d jx = _mm_mul_pd(jw[k], a_c), jy = _mm_mul_pd(jw[k], b_c);
+          double *column = jacobian + (k + 6) * jacobian_stride + 2 * i;
+          _mm_storeu_pd(column, _mm_unpacklo_pd(jx, jy));
+          _mm_storeu_pd(column + 2, _mm_unpackhi_pd(jx, jy));
+        }
+      }
+    }
+#endif
+    for (; i < count; ++i) {
+      double u = p1[2 * i], v = p1[2 * i + 1];
+      double a = H(0, 0) * u + H(0, 1) * v + H(0, 2);
+      double b = H(1, 0) * u + H(1, 1) * v + H(1, 2);
+      double c = H(2, 0) * u + H(2, 1) * v + H(2, 2);
+      double inv_c = 1.0 / c;
+      double a_c = a * inv_c, b_c = b * inv_c;
+      residuals[2 * i + 0] = p2[2 * i + 0] - a_c;
+      residuals[2 * i + 1] = p2[2 * i + 1] - b_c;
+      if (jacobian) {
+        double j[3] = { -u * inv_c, -v * inv_c, -inv_c };
+        for (int k = 0; k < 3; ++k) {
+          jacobian[k * jacobian_stride + 2 * i + 0] = j[k];
+          jacobian[k * jacobian_stride + 2 * i + 1] = 0;
+          jacobian[(k + 3) * jacobian_stride + 2 * i + 0] = 0;
+          jacobian[(k + 3) * jacobian_stride + 2 * i + 1] = j[k];
+        }
+        for (int k = 0; k < 2; ++k) {
+          jacobian[(k + 6) * jacobian_stride + 2 * i + 0] = -j[k] * a_c;
+          jacobian[(k + 6) * jacobian_stride + 2 * i + 1] = -j[k] * b_c;
+        }
+      }
+    }
+  }
 };
 
  /**
@@ -148,6 +332,48 @@ struct SymmetricError {
     return AsymmetricError::Error(H,    x1, x2) +
            AsymmetricError::Error(Hinv, x2, x1);
   }
+  /**
+   * Computes the squared norms of the symmetric residuals of count
+   * correspondences, given as structure of arrays (see
+   * two_view::kernel::HasBatchErrors). H is only inverted once.
+   *
+   * \param[in]  H The 3x3 homography matrix.
+   * \param[in]  x1,y1 The coordinates of the 2D points x1.
+   * \param[in]  x2,y2 The coordinates of the 2D points x2.
+   * \param[out] errors The count squared norms of the residuals.
+   */
+  static void Errors(const Mat3 &H,
+                     const double *x1, const double *y1,
+                     const double *x2, const double *y2,
+                     int count, double *errors) {
+    BatchErrors(H, x1, y1, x2, y2, count, errors);
+  }
+  static void Errors(const Mat3 &H,
+                     const float *x1, const float *y1,
+                     const float *x2, const float *y2,
+                     int count, float *errors) {
+    BatchErrors(H, x1, y1, x2, y2, count, errors);
+  }
+ private:
+  template<typename T>
+  static void BatchErrors(const Mat3 &H,
+                          const T *x1, const T *y1,
+                          const T *x2, const T *y2,
+                          int count, T *errors) {
+    const int kChunk = 64;
+    T backward[kChunk];
+    Mat3 Hinv = H.inverse();
+    AsymmetricError::Errors(H, x1, y1, x2, y2, count, errors);
+    for (int first = 0; first < count; first += kChunk) {
+      int n = std::min(kChunk, count - first);
+      AsymmetricError::Errors(Hinv, x2 + first, y2 + first,
+                              x1 + first, y1 + first, n, backward);
+      for (int i = 0; i < n; ++i) {
+        errors[first + i] += backward[i];
+      }
+    }
+  }
+ public:
   // TODO(julien) Add residuals function \see AsymmetricError
 };
  /**
@@ -236,6 +462,56 @@ struct AlgebraicError {
     Residuals(H, x1, x2, &dx);
     return dx.squaredNorm();
   }
+  /**
+   * Computes the squared norms of the algebraic residuals of count
+   * correspondences, given as structure of arrays (see
+   * two_view::kernel::HasBatchErrors).
+   *
+   * \param[in]  H The 3x3 homography matrix.
+   * \param[in]  x1,y1 The coordinates of the 2D points x1.
+   * \param[in]  x2,y2 The coordinates of the 2D points x2.
+   * \param[out] errors The count squared norms of the residuals.
+   */
+  static void Errors(const Mat3 &H,
+                     const double *x1, const double *y1,
+                     const double *x2, const double *y2,
+                     int count, double *errors) {
+    int i = 0;
+#ifdef __SSE2__
+    __m128d h00 = _mm_set1_pd(H(0, 0)), h01 = _mm_set1_pd(H(0, 1));
+    __m128d h02 = _mm_set1_pd(H(0, 2)), h10 = _mm_set1_pd(H(1, 0));
+    __m128d h11 = _mm_set1_pd(H(1, 1)), h12 = _mm_set1_pd(H(1, 2));
+    __m128d h20 = _mm_set1_pd(H(2, 0)), h21 = _mm_set1_pd(H(2, 1));
+    __m128d h22 = _mm_set1_pd(H(2, 2));
+    for (; i + 2 <= count; i += 2) {
+      __m128d u = _mm_loadu_pd(x1 + i), v = _mm_loadu_pd(y1 + i);
+      __m128d a = _mm_add_pd(_mm_add_pd(_mm_mul_pd(h00, u),
+                                        _mm_mul_pd(h01, v)), h02);
+      __m128d b = _mm_add_pd(_mm_add_pd(_mm_mul_pd(h10, u),
+                                        _mm_mul_pd(h11, v)), h12);
+      __m128d c = _mm_add_pd(_mm_add_pd(_mm_mul_pd(h20, u),
+                                        _mm_mul_pd(h21, v)), h22);
+      __m128d p = _mm_loadu_pd(x2 + i), q = _mm_loadu_pd(y2 + i);
+      // (p, q, 1) x (a, b, c).
+      __m128d r0 = _mm_sub_pd(_mm_mul_pd(q, c), b);
+      __m128d r1 = _mm_sub_pd(a, _mm_mul_pd(p, c));
+      __m128d r2 = _mm_sub_pd(_mm_mul_pd(p, b), _mm_mul_pd(q, a));
+      _mm_storeu_pd(errors + i,
+                    _mm_add_pd(_mm_add_pd(_mm_mul_pd(r0, r0),
+                                          _mm_mul_pd(r1, r1)),
+                               _mm_mul_pd(r2, r2)));
+    }
+#endif
+    for (; i < count; ++i) {
+      double a = H(0, 0) * x1[i] + H(0, 1) * y1[i] + H(0, 2);
+      double b = H(1, 0) * x1[i] + H(1, 1) * y1[i] + H(1, 2);
+      double c = H(2, 0) * x1[i] + H(2, 1) * y1[i] + H(2, 2);
+      double r0 = y2[i] * c - b;
+      double r1 = a - x2[i] * c;
+      double r2 = x2[i] * b - y2[i] * a;
+      errors[i] = r0 * r0 + r1 * r1 + r2 * r2;
+    }
+  }
 };
 // TODO(keir): Add error based on ideal points.
 
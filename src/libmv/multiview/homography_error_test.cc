@@ -120,4 +120,102 @@ TEST(Homography2D, AlgebraicError) {
     EXPECT_NEAR(norm4, norm_err, 1e-8);
   }
 }
+
+// Random correspondences under a projective H, with an odd count so that the
+// scalar tail of the batch functions is used.
+void MakeCorrespondences(int n, Mat3 *H, Mat2X *x1, Mat2X *x2) {
+  *H << 1.2, 0.1, -4,
+        -0.2, 0.9, 5,
+        1e-3, -2e-3, 1;
+  *x1 = 100 * Mat2X::Random(2, n);
+  Mat3X x2h = *H * EuclideanToHomogeneous(*x1);
+  *x2 = HomogeneousToEuclidean(x2h) + Mat2X::Random(2, n);
+}
+
+TEST(Homography2D, BatchErrorsMatchErrors) {
+  const int n = 131;
+  Mat3 H;
+  Mat2X x1, x2;
+  MakeCorrespondences(n, &H, &x1, &x2);
+  Vec xs1 = x1.row(0).transpose(), ys1 = x1.row(1).transpose();
+  Vec xs2 = x2.row(0).transpose(), ys2 = x2.row(1).transpose();
+
+  Vec asymmetric(n), symmetric(n), algebraic(n);
+  AsymmetricError::Errors(H, xs1.data(), ys1.data(), xs2.data(), ys2.data(),
+                          n, asymmetric.data());
+  SymmetricError::Errors(H, xs1.data(), ys1.data(), xs2.data(), ys2.data(),
+                         n, symmetric.data());
+  AlgebraicError::Errors(H, xs1.data(), ys1.data(), xs2.data(), ys2.data(),
+                         n, algebraic.data());
+  for (int i = 0; i < n; ++i) {
+    Vec p1 = x1.col(i), p2 = x2.col(i);
+    double e = AsymmetricError::Error(H, p1, p2);
+    EXPECT_NEAR(e, asymmetric(i), 1e-9 * (1 + e));
+    e = SymmetricError::Error(H, p1, p2);
+    EXPECT_NEAR(e, symmetric(i), 1e-9 * (1 + e));
+    e = AlgebraicError::Error(H, p1, p2);
+    EXPECT_NEAR(e, algebraic(i), 1e-9 * (1 + e));
+  }
+}
+
+TEST(Homography2D, FloatBatchErrorsMatchErrors) {
+  const int n = 131;
+  Mat3 H;
+  Mat2X x1, x2;
+  MakeCorrespondences(n, &H, &x1, &x2);
+  Vecf xs1 = x1.row(0).transpose().cast<float>();
+  Vecf ys1 = x1.row(1).transpose().cast<float>();
+  Vecf xs2 = x2.row(0).transpose().cast<float>();
+  Vecf ys2 = x2.row(1).transpose().cast<float>();
+
+  Vecf asymmetric(n), symmetric(n);
+  AsymmetricError::Errors(H, xs1.data(), ys1.data(), xs2.data(), ys2.data(),
+                          n, asymmetric.data());
+  SymmetricError::Errors(H, xs1.data(), ys1.data(), xs2.data(), ys2.data(),
+                         n, symmetric.data());
+  for (int i = 0; i < n; ++i) {
+    Vec p1 = x1.col(i), p2 = x2.col(i);
+    double e = AsymmetricError::Error(H, p1, p2);
+    EXPECT_NEAR(e, asymmetric(i), 1e-4 * (1 + e));
+    e = SymmetricError::Error(H, p1, p2);
+    EXPECT_NEAR(e, symmetric(i), 1e-4 * (1 + e));
+  }
+}
+
+TEST(Homography2D, BatchResidualsAndJacobian) {
+  const int n = 7;
+  Mat3 H;
+  Mat2X x1, x2;
+  MakeCorrespondences(n, &H, &x1, &x2);
+
+  // A range that starts on an odd column.
+  const int first = 1, count = n - 1;
+  Mat2X residuals(2, count);
+  Mat jacobian(2 * count, 8);
+  AsymmetricError::BatchResiduals(H, x1, x2, first, count, residuals.data(),
+                                  jacobian.data(), jacobian.rows());
+  Mat2X expected;
+  AsymmetricError::Residuals(H, x1, x2, &expected);
+  EXPECT_MATRIX_NEAR(expected.block(0, first, 2, count), residuals, 1e-9);
+
+  // Central differences on the 8 first entries of H, in row major order.
+  const double eps = 1e-7;
+  for (int k = 0; k < 8; ++k) {
+    Mat3 H_plus = H, H_minus = H;
+    H_plus(k / 3, k % 3) += eps;
+    H_minus(k / 3, k % 3) -= eps;
+    Mat2X plus(2, count), minus(2, count);
+    AsymmetricError::BatchResiduals(H_plus, x1, x2, first, count, plus.data());
+    AsymmetricError::BatchResiduals(H_minus, x1, x2, first, count,
+                                    minus.data());
+    Mat2X derivative = (plus - minus) / (2 * eps);
+    for (int i = 0; i < count; ++i) {
+      for (int r = 0; r < 2; ++r) {
+        double expected_derivative = derivative(r, i);
+        EXPECT_NEAR(expected_derivative, jacobian(2 * i + r, k),
+                    1e-5 * (1 + std::abs(expected_derivative)));
+      }
+    }
+  }
+}
 }  // namespace
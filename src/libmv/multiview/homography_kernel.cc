@@ -29,12 +29,48 @@ namespace homography2D {
 namespace kernel {
 
 void FourPointSolver::Solve(const Mat &x, const Mat &y, vector<Mat3> *Hs) {
+  if (x.rows() == 2 && x.cols() == MINIMUM_SAMPLES) {
+    SolveMinimal(x, y, Hs);
+    return;
+  }
   Mat3 M;
-  if (Homography2DFromCorrespondencesLinear(x,y, &M)) {
+  if (Homography2DFromCorrespondencesLinear(x, y, &M)) {
     Hs->push_back(M);
   }
 }
 
+void FourPointSolver::SolveMinimal(const MinimalSample &x,
+                                   const MinimalSample &y,
+                                   vector<Mat3> *Hs) {
+  Mat3 M;
+  if (Homography2DFromFourCorrespondences(x, y, &M)) {
+    Hs->push_back(M);
+  }
+}
+
+void LeastSquaresSolver::Solve(const Mat &x, const Mat &y, vector<Mat3> *Hs) {
+  assert(x.rows() == 2 && y.rows() == 2 && x.cols() == y.cols());
+  assert(x.cols() >= MINIMUM_SAMPLES);
+  // Two rows of [y]_x H x = 0 per correspondence, in the entries of H
+  // stored row major.
+  int n = x.cols();
+  MatX9 A = MatX9::Zero(2 * n, 9);
+  for (int i = 0; i < n; ++i) {
+    Vec3 p(x(0, i), x(1, i), 1);
+    A.block<1, 3>(2 * i, 3) = -p.transpose();
+    A.block<1, 3>(2 * i, 6) = y(1, i) * p.transpose();
+    A.block<1, 3>(2 * i + 1, 0) = p.transpose();
+    A.block<1, 3>(2 * i + 1, 6) = -y(0, i) * p.transpose();
+  }
+  Vec9 h;
+  Nullspace(&A, &h);
+  Mat3 H;
+  H << h(0), h(1), h(2),
+       h(3), h(4), h(5),
+       h(6), h(7), h(8);
+  Hs->push_back(H);
+}
+
 }  // namespace kernel
 }  // namespace homography2D
 }  // namespace homography
@@ -23,6 +23,7 @@
 
 #include "libmv/base/vector.h"
 #include "libmv/multiview/conditioning.h"
+#include "libmv/multiview/homography.h"
 #include "libmv/multiview/homography_error.h"
 #include "libmv/multiview/two_view_kernel.h"
 #include "libmv/numeric/numeric.h"
@@ -48,6 +49,20 @@ struct FourPointSolver {
    */
   // TODO(keir): Fix \see above.
   static void Solve(const Mat &x, const Mat &y, vector<Mat3> *Hs);
+
+  typedef Matrix<double, 2, MINIMUM_SAMPLES> MinimalSample;
+  static void SolveMinimal(const MinimalSample &x,
+                           const MinimalSample &y,
+                           vector<Mat3> *Hs);
+};
+
+// The homogeneous DLT in the least squares sense, over at least 4
+// correspondences. Unlike FourPointSolver::Solve(), it keeps the homographies
+// that do not fit the points exactly, as for the points of affine frames,
+// which a homography only maps to first order.
+struct LeastSquaresSolver {
+  enum { MINIMUM_SAMPLES = 4 };
+  static void Solve(const Mat &x, const Mat &y, vector<Mat3> *Hs);
 };
 
 typedef two_view::kernel::Kernel<FourPointSolver, AsymmetricError, Mat3>
@@ -60,12 +75,82 @@ typedef two_view::kernel::Kernel<
     Mat3>
   IsotropicNormalizedKernel;
   
-// By default use the normalized version for increased robustness.
 typedef two_view::kernel::Kernel<
     two_view::kernel::NormalizedSolver<FourPointSolver, UnnormalizerI>,
     AsymmetricError,
     Mat3>
-  Kernel;
+  NormalizedKernel;
+
+//! Normalizes the points once, when the kernel is built
+typedef two_view::kernel::PrenormalizedKernel<
+    FourPointSolver, UnnormalizerI, AsymmetricError, Mat3>
+  PrenormalizedKernel;
+
+// By default use the normalized version for increased robustness. The models
+// can be refined on their inliers (see Estimate() local optimization) with
+// Homography2DFromCorrespondencesRefine(). ErrorScalar is the precision of the
+// scoring errors (see two_view::kernel::Kernel); the refinement is always done
+// in double.
+template<typename ErrorScalar>
+class RefinedKernel : public two_view::kernel::PrenormalizedKernel<
+    FourPointSolver, UnnormalizerI, AsymmetricError, Mat3, false,
+    ErrorScalar> {
+  typedef two_view::kernel::PrenormalizedKernel<
+      FourPointSolver, UnnormalizerI, AsymmetricError, Mat3, false,
+      ErrorScalar> Base;
+ public:
+  typedef typename Base::Model Model;
+  RefinedKernel(const Mat &x1, const Mat &x2) : Base(x1, x2) {}
+  // Redeclared so that the estimators find it (see HasErrors).
+  void Errors(const Model &model, int first, int count,
+              double *errors) const {
+    Base::Errors(model, first, count, errors);
+  }
+  void Refine(const vector<int> &inliers, Model *H) const {
+    Mat x1 = ExtractColumns(this->x1_, inliers);
+    Mat x2 = ExtractColumns(this->x2_, inliers);
+    Mat3 H_refined = *H;
+    if (Homography2DFromCorrespondencesRefine(x1, x2, &H_refined)) {
+      *H = H_refined;
+    }
+  }
+};
+
+typedef RefinedKernel<double> Kernel;
+
+// Same as Kernel, with the errors of the scoring in single precision.
+typedef RefinedKernel<float> FloatScoringKernel;
+
+// Fits homographies to 2 correspondences of local affine frames (see
+// two_view::kernel::AffineFrameKernel), and refines them on the centers of
+// their inliers.
+class AffineFrameKernel : public two_view::kernel::AffineFrameKernel<
+    two_view::kernel::NormalizedSolver<LeastSquaresSolver, UnnormalizerI>,
+    AsymmetricError, Mat3> {
+  typedef two_view::kernel::AffineFrameKernel<
+      two_view::kernel::NormalizedSolver<LeastSquaresSolver, UnnormalizerI>,
+      AsymmetricError, Mat3> Base;
+ public:
+  typedef Base::Model Model;
+  AffineFrameKernel(const Mat &x1, const Mat &frames1,
+                    const Mat &x2, const Mat &frames2)
+      : Base(x1, frames1, x2, frames2) {}
+  void Errors(const Model &model, int first, int count,
+              double *errors) const {
+    Base::Errors(model, first, count, errors);
+  }
+  void Refine(const vector<int> &inliers, Model *H) const {
+    if (inliers.size() < FourPointSolver::MINIMUM_SAMPLES) {
+      return;
+    }
+    Mat x1 = ExtractColumns(this->x1_, inliers);
+    Mat x2 = ExtractColumns(this->x2_, inliers);
+    Mat3 H_refined = *H;
+    if (Homography2DFromCorrespondencesRefine(x1, x2, &H_refined)) {
+      *H = H_refined;
+    }
+  }
+};
 
 }  // namespace kernel
 }  // namespace homography2D
@@ -21,6 +21,7 @@
 #include "libmv/base/vector.h"
 #include "libmv/logging/logging.h"
 #include "libmv/multiview/homography_kernel.h"
+#include "libmv/multiview/projection.h"
 #include "libmv/numeric/numeric.h"
 #include "testing/testing.h"
 
@@ -36,6 +37,7 @@ struct HomographyKernelTest : public testing::Test {
 };
 
 typedef Types<Kernel,
+              NormalizedKernel,
               UnnormalizedKernel>
   HomographyKernelImplementations;
 
@@ -83,4 +85,84 @@ TYPED_TEST(HomographyKernelTest, Fitting) {
     }
   }
 }
+
+TYPED_TEST(HomographyKernelTest, MinimalSample) {
+  Mat3 H_gt;
+  H_gt << 1, -2,  3,
+          4,  5, -6,
+         -7,  8,  1;
+  Mat x(2, 4), xh;
+  x << 0, 2, 0, 2,
+       0, 0, 2, 1;
+  EuclideanToHomogeneous(x, &xh);
+  Mat y, yh = H_gt * xh;
+  HomogeneousToEuclidean(yh, &y);
+
+  TypeParam kernel(x, y);
+  vector<int> samples;
+  for (int i = 0; i < 4; ++i) {
+    samples.push_back(i);
+  }
+  vector<Mat3> Hs;
+  kernel.Fit(samples, &Hs);
+  ASSERT_EQ(1, Hs.size());
+  EXPECT_MATRIX_PROP(H_gt, Hs[0], 5e-8);
+}
+
+TEST(PrenormalizedKernel, MatchesNormalizedKernelOnAllSamples) {
+  Mat3 H_gt;
+  H_gt << 1.1, 0.1, 30,
+          -0.2, 0.9, -15,
+          1e-4, 2e-4, 1;
+  Mat x1 = 100 * Mat::Random(2, 10), x1h, x2;
+  EuclideanToHomogeneous(x1, &x1h);
+  HomogeneousToEuclidean(Mat(H_gt * x1h), &x2);
+  PrenormalizedKernel prenormalized_kernel(x1, x2);
+  NormalizedKernel normalized_kernel(x1, x2);
+  vector<int> samples;
+  for (int i = 0; i < 10; ++i) {
+    samples.push_back(i);
+  }
+  vector<Mat3> Hs, Hs_expected;
+  prenormalized_kernel.Fit(samples, &Hs);
+  normalized_kernel.Fit(samples, &Hs_expected);
+  ASSERT_EQ(1, Hs.size());
+  ASSERT_EQ(1, Hs_expected.size());
+  EXPECT_MATRIX_PROP(Hs_expected[0], Hs[0], 1e-6);
+
+  Hs.clear();
+  PrenormalizedKernel::Solve(x1, x2, &Hs);
+  ASSERT_EQ(1, Hs.size());
+  EXPECT_MATRIX_PROP(Hs_expected[0], Hs[0], 1e-6);
+}
+
+TEST(AsymmetricError, BatchErrorsMatchError) {
+  Mat3 H;
+  H << 1, -2,  3,
+       4,  5, -6,
+      -7,  8,  1;
+  const int n = 9;
+  Mat x1 = Mat::Random(2, n), x2 = Mat::Random(2, n);
+  Kernel kernel(x1, x2);
+  double errors[n];
+  kernel.Errors(H, 0, n, errors);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_NEAR(kernel.Error(i, H), errors[i], 1e-9 * (1 + errors[i]));
+  }
+}
+
+TEST(AsymmetricError, FloatScoringKernelMatchesError) {
+  Mat3 H;
+  H << 1, -2,  3,
+       4,  5, -6,
+      -7,  8,  1;
+  const int n = 9;
+  Mat x1 = Mat::Random(2, n), x2 = Mat::Random(2, n);
+  FloatScoringKernel kernel(x1, x2);
+  double errors[n];
+  kernel.Errors(H, 0, n, errors);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_NEAR(kernel.Error(i, H), errors[i], 1e-4 * (1 + errors[i]));
+  }
+}
 }  // namespace
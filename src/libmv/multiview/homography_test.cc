@@ -130,6 +130,55 @@ TEST(Homography2DTest, HomographyGeneral) {
   EXPECT_MATRIX_NEAR(homography_mat, m, 1e-8);
 }
 
+TEST(Homography2DTest, FourCorrespondences) {
+  Mat x1(3, 4);
+  x1 <<  0, 1, 0, 5,
+         0, 0, 2, 3,
+         1, 1, 1, 1;
+  Mat3 m;
+  m <<   3, -1,  4,
+         6, -2, -3,
+         1, -3,  1;
+  Mat x2 = m * x1;
+  Mat eX1, eX2;
+  HomogeneousToEuclidean(x1, &eX1);
+  HomogeneousToEuclidean(x2, &eX2);
+
+  Mat3 homography_mat, linear_mat;
+  EXPECT_TRUE(Homography2DFromFourCorrespondences(eX1, eX2, &homography_mat));
+  EXPECT_MATRIX_NEAR(homography_mat, m, 1e-8);
+  EXPECT_TRUE(Homography2DFromCorrespondencesLinear(eX1, eX2, &linear_mat));
+  EXPECT_MATRIX_NEAR(homography_mat, linear_mat, 1e-8);
+
+  // Three aligned points do not define a homography.
+  x1.col(3) << 2, 0, 1;
+  HomogeneousToEuclidean(x1, &eX1);
+  HomogeneousToEuclidean(m * x1, &eX2);
+  EXPECT_FALSE(Homography2DFromFourCorrespondences(eX1, eX2, &homography_mat));
+}
+
+TEST(Homography2DTest, RefineNoisyHomography) {
+  const int n = 20;
+  Mat3 m;
+  m <<   1.1, -0.1,  4,
+         0.2,  0.9, -3,
+       1e-3, 2e-3,  1;
+  Mat x1 = 10 * Mat::Random(2, n);
+  Mat x2(2, n);
+  for (int i = 0; i < n; ++i) {
+    Vec3 x = m * Vec3(x1(0, i), x1(1, i), 1);
+    x2.col(i) = x.head<2>() / x(2);
+  }
+
+  // The refinement recovers the exact homography from a perturbed one.
+  Mat3 homography_mat = m;
+  homography_mat(0, 2) += 0.1;
+  homography_mat(2, 0) -= 1e-4;
+  homography_mat *= 2;
+  EXPECT_TRUE(Homography2DFromCorrespondencesRefine(x1, x2, &homography_mat));
+  EXPECT_MATRIX_NEAR(homography_mat, m, 1e-8);
+}
+
 TEST(Homography3DTest, RotationAndTranslationXYZ) {
   Mat x1(4, 5);
   x1 <<  0, 0, 1, 5, 2,
@@ -0,0 +1,107 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstdlib>
+
+#include "libmv/base/vector.h"
+#include "libmv/multiview/five_point.h"
+#include "libmv/multiview/projection.h"
+#include "libmv/multiview/sparse_bundle.h"
+#include "libmv/multiview/test_data_sets.h"
+#include "libmv/numeric/numeric.h"
+#include "testing/benchmark.h"
+
+namespace {
+
+using namespace libmv;
+using libmv::benchmark::DoNotOptimize;
+using libmv::benchmark::State;
+
+typedef void (*FivePointSolver)(const Mat2X &, const Mat2X &, vector<Mat3> *);
+
+// Five points seen by two calibrated cameras, in normalized coordinates.
+void SolveFivePoints(FivePointSolver solver, State *state) {
+  srand(1);
+  NViewDataSet d = NRealisticCamerasFull(2, 5);
+  Mat3X h1 = d.K[0].inverse() * EuclideanToHomogeneous(d.x[0]);
+  Mat3X h2 = d.K[1].inverse() * EuclideanToHomogeneous(d.x[1]);
+  Mat2X x1 = HomogeneousToEuclidean(h1);
+  Mat2X x2 = HomogeneousToEuclidean(h2);
+  state->ResetTiming();
+  int num_solutions = 0;
+  for (int i = 0; i < state->iterations(); ++i) {
+    vector<Mat3> E;
+    solver(x1, x2, &E);
+    num_solutions += E.size();
+  }
+  state->SetItemsProcessed(state->iterations());
+  DoNotOptimize(num_solutions);
+}
+
+BENCHMARK(BM_FivePointsRelativePose) {
+  SolveFivePoints(FivePointsRelativePose, state);
+}
+
+BENCHMARK(BM_FivePointsRelativePoseNister) {
+  SolveFivePoints(FivePointsRelativePoseNister, state);
+}
+
+// Refines a perturbed sparse scene of 20 cameras and 500 points; the items are
+// the observations.
+BENCHMARK(BM_SparseBundleAdjuster) {
+  srand(1);
+  const int kNumViews = 20;
+  const int kNumPoints = 500;
+  NViewDataSet d = NRealisticCamerasSparse(kNumViews, kNumPoints);
+  double num_observations = 0;
+  double rms = 0;
+  for (int i = 0; i < state->iterations(); ++i) {
+    state->PauseTiming();
+    vector<Mat3> R = d.R;
+    vector<Vec3> t = d.t;
+    for (int k = 0; k < kNumViews; ++k) {
+      R[k] *= RotationAroundY(0.01 * (k % 3 - 1));
+      t[k] += Vec3::Random() * 0.05;
+    }
+    vector<Vec3> X(kNumPoints);
+    for (int j = 0; j < kNumPoints; ++j) {
+      X[j] = d.X.col(j) + Vec3::Random() * 0.05;
+    }
+    SparseBundleAdjuster bundle;
+    for (int k = 0; k < kNumViews; ++k) {
+      bundle.AddCamera(d.K[k], &R[k], &t[k]);
+    }
+    for (int j = 0; j < kNumPoints; ++j) {
+      bundle.AddPoint(&X[j]);
+    }
+    for (int k = 0; k < kNumViews; ++k) {
+      for (int o = 0; o < d.x_ids[k].size(); ++o) {
+        bundle.AddObservation(k, d.x_ids[k][o], d.x[k].col(o));
+      }
+    }
+    num_observations += bundle.NumObservations();
+    state->ResumeTiming();
+    rms += bundle.Solve();
+  }
+  state->SetItemsProcessed(num_observations);
+  DoNotOptimize(rms);
+}
+
+}  // namespace
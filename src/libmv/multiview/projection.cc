@@ -197,16 +197,23 @@ void EuclideanToHomogeneous(const Vec3 &X, Vec4 *H) {
 }
 
 // TODO(julien) Call conditioning.h/ApplyTransformationToPoints ?
+// Column by column, without temporary matrices; x and n can be the same.
 void EuclideanToNormalizedCamera(const Mat2X &x, const Mat3 &K, Mat2X *n) {
- Mat3X x_image_h;
- EuclideanToHomogeneous(x, &x_image_h);
- Mat3X x_camera_h = K.inverse() * x_image_h;
- HomogeneousToEuclidean(x_camera_h, n);
+  Mat3 K_inverse = K.inverse();
+  n->resize(2, x.cols());
+  for (int c = 0; c < x.cols(); ++c) {
+    Vec3 h = K_inverse * Vec3(x(0, c), x(1, c), 1);
+    n->col(c) << h(0) / h(2), h(1) / h(2);
+  }
 }
 
 void HomogeneousToNormalizedCamera(const Mat3X &x, const Mat3 &K, Mat2X *n) {
- Mat3X x_camera_h = K.inverse() * x;
- HomogeneousToEuclidean(x_camera_h, n);
+  Mat3 K_inverse = K.inverse();
+  n->resize(2, x.cols());
+  for (int c = 0; c < x.cols(); ++c) {
+    Vec3 h = K_inverse * x.col(c);
+    n->col(c) << h(0) / h(2), h(1) / h(2);
+  }
 }
 
 double Depth(const Mat3 &R, const Vec3 &t, const Vec3 &X) {
@@ -122,7 +122,7 @@ inline void Project(const Mat34 &P, const Vec3 &X, Vec3 *x) {
 
 inline void Project(const Mat34 &P, const Vec3 &X, Vec2 *x) {
   Vec3 hx;
-  Project(P, X, x);
+  Project(P, X, &hx);
   *x = hx.head<2>() / hx(2);
 }
 
@@ -173,6 +173,75 @@ inline Mat2X Project(const Mat34 &P, const Mat3X &X, const Vecu &ids) {
   return x;
 }
 
+namespace projection_internal {
+
+// P * X for a euclidean (3 rows) or homogeneous (4 rows) point X.
+template<int Rows>
+struct HomogeneousProjection;
+
+template<>
+struct HomogeneousProjection<3> {
+  template<typename TX>
+  static Vec3 Apply(const Mat34 &P, const Eigen::MatrixBase<TX> &X) {
+    return P.block<3, 3>(0, 0) * X + P.col(3);
+  }
+};
+
+template<>
+struct HomogeneousProjection<4> {
+  template<typename TX>
+  static Vec3 Apply(const Mat34 &P, const Eigen::MatrixBase<TX> &X) {
+    return P * X;
+  }
+};
+
+}  // namespace projection_internal
+
+// The residual x - Psi(P * X) of the projection of a 3D point X, euclidean or
+// homogeneous, to a 2D point x. X and x can be columns of a Mat3X or Mat4X
+// and a Mat2X: everything is computed in fixed size vectors, on the stack.
+template<typename TX, typename Tx>
+inline Vec2 ReprojectionResidual(const Mat34 &P,
+                                 const Eigen::MatrixBase<TX> &X,
+                                 const Eigen::MatrixBase<Tx> &x) {
+  Vec3 hx = projection_internal::HomogeneousProjection<
+      TX::RowsAtCompileTime>::Apply(P, X);
+  return Vec2(x(0) - hx(0) / hx(2), x(1) - hx(1) / hx(2));
+}
+
+template<typename TX, typename Tx>
+inline double ReprojectionErrorSquared(const Mat34 &P,
+                                       const Eigen::MatrixBase<TX> &X,
+                                       const Eigen::MatrixBase<Tx> &x) {
+  return ReprojectionResidual(P, X, x).squaredNorm();
+}
+
+// The sum over the columns of X (a Mat3X or Mat4X) and x of the squared
+// reprojection errors, without allocating.
+template<typename TX>
+inline double SumOfSquaredReprojectionErrors(const Mat34 &P,
+                                             const Eigen::MatrixBase<TX> &X,
+                                             const Mat2X &x) {
+  double sum = 0;
+  for (int c = 0; c < x.cols(); ++c) {
+    sum += ReprojectionErrorSquared(P, X.col(c), x.col(c));
+  }
+  return sum;
+}
+
+// The residuals of all the columns, in residuals, which is only reallocated
+// when its number of columns changes.
+template<typename TX>
+inline void ReprojectionResiduals(const Mat34 &P,
+                                  const Eigen::MatrixBase<TX> &X,
+                                  const Mat2X &x,
+                                  Mat2X *residuals) {
+  residuals->resize(2, x.cols());
+  for (int c = 0; c < x.cols(); ++c) {
+    residuals->col(c) = ReprojectionResidual(P, X.col(c), x.col(c));
+  }
+}
+
 double Depth(const Mat3 &R, const Vec3 &t, const Vec3 &X);
 double Depth(const Mat3 &R, const Vec3 &t, const Vec4 &X);
 
@@ -210,8 +279,8 @@ inline double RootMeanSquareError(const Mat2X &x_image,
                                   const Mat4X &X_world,               
                                   const Mat34 &P) {
   size_t num_points = x_image.cols();
-  Mat2X dx = Project(P, X_world) - x_image;
-  return dx.norm() / num_points;
+  return sqrt(SumOfSquaredReprojectionErrors(P, X_world, x_image)) /
+         num_points;
 }
 
 /// Estimates the root mean square error (2D)
@@ -223,8 +292,8 @@ inline double RootMeanSquareError(const Mat2X &x_image,
   Mat34 P;
   P_From_KRt(K, R, t, &P);
   size_t num_points = x_image.cols();
-  Mat2X dx = Project(P, X_world) - x_image;
-  return dx.norm() / num_points;
+  return sqrt(SumOfSquaredReprojectionErrors(P, X_world, x_image)) /
+         num_points;
 }
 } // namespace libmv
 
@@ -114,4 +114,59 @@ TEST(AutoCalibration, ProjectionChangeAspectRatio) {
   EXPECT_MATRIX_EQ(P2, P2_computed);
 }
 
+TEST(Projection, ReprojectionResiduals) {
+  Mat34 P;
+  P_From_KRt(Mat3::Identity() * 2, RotationAroundY(0.1), Vec3(1, 2, 10), &P);
+  Mat3X X(3, 5);
+  X << 1, 2, 3, 4, 5,
+       0, 1, 0, 1, 0,
+       1, 1, 2, 2, 3;
+  Mat4X X_homogeneous;
+  EuclideanToHomogeneous(X, &X_homogeneous);
+  X_homogeneous.col(2) *= 3;
+  Mat2X x = Project(P, X);
+  x(0, 1) += 0.5;
+  x(1, 3) -= 2;
+
+  Mat2X expected = x - Project(P, X);
+  Mat2X residuals;
+  ReprojectionResiduals(P, X, x, &residuals);
+  EXPECT_MATRIX_NEAR(expected, residuals, 1e-12);
+  ReprojectionResiduals(P, X_homogeneous, x, &residuals);
+  EXPECT_MATRIX_NEAR(expected, residuals, 1e-12);
+
+  EXPECT_NEAR(4.25, SumOfSquaredReprojectionErrors(P, X, x), 1e-12);
+  EXPECT_NEAR(4.25, SumOfSquaredReprojectionErrors(P, X_homogeneous, x),
+              1e-12);
+  EXPECT_NEAR(4, ReprojectionErrorSquared(P, X.col(3), x.col(3)), 1e-12);
+  EXPECT_NEAR(0, ReprojectionErrorSquared(P, X_homogeneous.col(2), x.col(2)),
+              1e-12);
+
+  Vec2 projected;
+  Project(P, Vec3(X.col(1)), &projected);
+  Vec2 expected_projected = x.col(1);
+  expected_projected(0) -= 0.5;
+  EXPECT_MATRIX_NEAR(expected_projected, projected, 1e-12);
+}
+
+TEST(Projection, EuclideanToNormalizedCamera) {
+  Mat3 K;
+  K << 10,  1, 30,
+        0, 20, 40,
+        0,  0,  1;
+  Mat2X x(2, 3);
+  x << 1, 2, 3,
+       4, 5, 6;
+  Mat2X expected = HomogeneousToEuclidean(
+      Mat3X(K.inverse() * EuclideanToHomogeneous(x)));
+  Mat2X n;
+  EuclideanToNormalizedCamera(x, K, &n);
+  EXPECT_MATRIX_NEAR(expected, n, 1e-12);
+  HomogeneousToNormalizedCamera(EuclideanToHomogeneous(x), K, &n);
+  EXPECT_MATRIX_NEAR(expected, n, 1e-12);
+  // In place.
+  EuclideanToNormalizedCamera(x, K, &x);
+  EXPECT_MATRIX_NEAR(expected, x, 1e-12);
+}
+
 } // namespace
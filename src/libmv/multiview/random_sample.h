@@ -21,18 +21,97 @@
 #ifndef LIBMV_MULTIVIEW_RANDOM_SAMPLE_H_
 #define LIBMV_MULTIVIEW_RANDOM_SAMPLE_H_
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
 #include "libmv/base/vector.h"
 #include "libmv/logging/logging.h"
 
 namespace libmv {
 
+// A seedable generator of 32 bit integers, PCG-XSH-RR (O'Neill, "PCG: A
+// Family of Simple Fast Space-Efficient Statistically Good Algorithms for
+// Random Number Generation", 2014). The stream selects one of 2^63
+// independent sequences for the same seed, e.g. one per thread.
+class RandomGenerator {
+ public:
+  explicit RandomGenerator(unsigned long long seed = 0,
+                           unsigned long long stream = 0) {
+    Seed(seed, stream);
+  }
+
+  void Seed(unsigned long long seed, unsigned long long stream = 0) {
+    state_ = 0;
+    increment_ = (stream << 1) | 1;
+    Next();
+    state_ += seed;
+    Next();
+  }
+
+  unsigned int Next() {
+    unsigned long long state = state_;
+    state_ = state * 6364136223846793005ULL + increment_;
+    unsigned int xorshifted =
+        static_cast<unsigned int>(((state >> 18) ^ state) >> 27);
+    unsigned int rotation = static_cast<unsigned int>(state >> 59);
+    return (xorshifted >> rotation) | (xorshifted << ((32 - rotation) & 31));
+  }
+
+  // A random integer in [0, n), by a multiplication instead of a division.
+  int Uniform(int n) {
+    return static_cast<int>((static_cast<unsigned long long>(Next()) *
+                             static_cast<unsigned int>(n)) >> 32);
+  }
+
+ private:
+  unsigned long long state_;
+  unsigned long long increment_;
+};
+
+// The global rand() state, as a generator.
+struct RandGenerator {
+  int Uniform(int n) { return rand() % n; }
+};
+
 /**
- * Pick a random subset of the integers [0, total), in random order.
- * Note that this can behave badly if num_samples is close to total; runtime
- * could be unlimited!
+ * Pick a random subset of the integers [0, total), in random order, with
+ * exactly num_samples draws from generator (Floyd's permutation algorithm,
+ * from Bentley and Floyd, "A Sample of Brilliance", CACM 1987). The cost is
+ * quadratic in num_samples, which is meant to be small.
  *
- * This uses a quadratic rejection strategy and should only be used for small
- * num_samples.
+ * \param num_samples   The number of samples to produce, at most total.
+ * \param total_samples The number of samples available.
+ * \param generator     Provides int Uniform(int n), in [0, n).
+ * \param samples       num_samples of numbers in [0, total_samples) is placed
+ *                      here on return.
+ */
+template<typename Generator>
+void FloydSample(int num_samples, int total_samples, Generator *generator,
+                 vector<int> *samples) {
+  samples->resize(0);
+  for (int j = total_samples - num_samples; j < total_samples; ++j) {
+    int t = generator->Uniform(j + 1);
+    int position = -1;
+    for (int k = 0; k < samples->size() && position < 0; ++k) {
+      if ((*samples)[k] == t) {
+        position = k;
+      }
+    }
+    // t goes first, or j right after t if t was already drawn.
+    int inserted = position < 0 ? t : j;
+    samples->push_back(inserted);
+    for (int k = samples->size() - 1; k > position + 1; --k) {
+      (*samples)[k] = (*samples)[k - 1];
+    }
+    (*samples)[position + 1] = inserted;
+  }
+}
+
+/**
+ * FloydSample() from the global rand() state.
  *
  * \param num_samples   The number of samples to produce.
  * \param total_samples The number of samples available.
@@ -40,20 +119,146 @@ namespace libmv {
  *                      here on return.
  */
 static void UniformSample(int num_samples, int total_samples, vector<int> *samples) {
-  samples->resize(0);
-  while (samples->size() < num_samples) {
-    int sample = rand() % total_samples;
-    bool found = false;
-    for (int j = 0; j < samples->size(); ++j) {
-      found = (*samples)[j] == sample;
-      if (found) {
-        break;
+  RandGenerator generator;
+  FloydSample(num_samples, total_samples, &generator, samples);
+}
+
+// Draws uniform samples; the default sampler of the robust estimators.
+struct UniformSampler {
+  void Sample(int num_samples, int total_samples, vector<int> *samples) {
+    UniformSample(num_samples, total_samples, samples);
+  }
+};
+
+// Draws uniform samples from its own RandomGenerator instead of rand(), whose
+// state is shared and locked; one StreamSampler per thread, each on its own
+// stream, gives independent samples which do not depend on the scheduling.
+class StreamSampler {
+ public:
+  explicit StreamSampler(unsigned int seed = 0, unsigned int stream = 0)
+    : generator_(seed, stream) {}
+
+  void Seed(unsigned int seed, unsigned int stream = 0) {
+    generator_.Seed(seed, stream);
+  }
+
+  // A random integer in [0, n).
+  int Uniform(int n) {
+    return generator_.Uniform(n);
+  }
+
+  // Same as UniformSample().
+  void Sample(int num_samples, int total_samples, vector<int> *samples) {
+    FloydSample(num_samples, total_samples, &generator_, samples);
+  }
+
+ private:
+  RandomGenerator generator_;
+};
+
+/**
+ * Progressive sampling (PROSAC, from Chum and Matas "Matching with PROSAC -
+ * Progressive Sample Consensus", CVPR 2005). The samples are assumed to be
+ * sorted by decreasing quality, or are given in that order. The first subsets
+ * are drawn from the best samples only; the pool grows with the number of
+ * drawn subsets, until it contains all the samples and sampling becomes
+ * uniform.
+ *
+ * With a good ordering (such as the distance ratio of putative matches),
+ * an all-inlier subset is found after far fewer iterations than with uniform
+ * sampling.
+ */
+class ProsacSampler {
+ public:
+  // max_iterations is the number of draws after which all samples are in the
+  // pool (T_N in the paper).
+  // The subsets are drawn from a StreamSampler seeded from rand(), see
+  // Seed().
+  explicit ProsacSampler(int max_iterations = 200000)
+    : max_iterations_(max_iterations), num_samples_(0), total_samples_(0),
+      uniform_(rand()) {}
+
+  // Use the samples in the given order, best first, instead of 0, 1, ...
+  ProsacSampler(const vector<int> &order, int max_iterations = 200000)
+    : max_iterations_(max_iterations), num_samples_(0), total_samples_(0),
+      order_(order), uniform_(rand()) {}
+
+  void Seed(unsigned int seed, unsigned int stream = 0) {
+    uniform_.Seed(seed, stream);
+  }
+
+  void Sample(int num_samples, int total_samples, vector<int> *samples) {
+    if (num_samples != num_samples_ || total_samples != total_samples_) {
+      Reset(num_samples, total_samples);
+    }
+    int m = num_samples_;
+    ++t_;
+    if (t_ > t_n_prime_ && n_ < total_samples_) {
+      ++n_;
+      double t_n_next = t_n_ * n_ / (n_ - m);
+      t_n_prime_ += static_cast<int>(ceil(t_n_next - t_n_));
+      t_n_ = t_n_next;
+    }
+    if (t_n_prime_ < t_ && n_ < total_samples_) {
+      // The newest sample of the pool, plus m - 1 of the others.
+      uniform_.Sample(m - 1, n_ - 1, samples);
+      samples->push_back(n_ - 1);
+    } else {
+      uniform_.Sample(m, n_, samples);
+    }
+    if (order_.size()) {
+      for (int i = 0; i < samples->size(); ++i) {
+        (*samples)[i] = order_[(*samples)[i]];
       }
     }
-    if (!found) {
-      samples->push_back(sample);
+  }
+
+  // Size of the pool the last sample was drawn from.
+  int PoolSize() const { return n_; }
+
+ private:
+  void Reset(int num_samples, int total_samples) {
+    CHECK(order_.size() == 0 || order_.size() == total_samples);
+    num_samples_ = num_samples;
+    total_samples_ = total_samples;
+    n_ = num_samples;
+    t_ = 0;
+    t_n_prime_ = 1;
+    // Expected number of draws from the first m samples among
+    // max_iterations_ uniform draws from all of them.
+    t_n_ = max_iterations_;
+    for (int i = 0; i < num_samples; ++i) {
+      t_n_ *= double(num_samples - i) / (total_samples - i);
     }
   }
+
+  int max_iterations_;
+  int num_samples_;
+  int total_samples_;
+  vector<int> order_;
+  StreamSampler uniform_;
+
+  int n_;            // Size of the pool.
+  int t_;            // Number of drawn subsets.
+  int t_n_prime_;    // Draws after which the pool grows.
+  double t_n_;
+};
+
+/**
+ * Order samples by increasing score (for instance the distance ratio of
+ * matches), hence by decreasing quality, for ProsacSampler.
+ */
+inline void OrderByIncreasingScore(const vector<float> &scores,
+                                   vector<int> *order) {
+  std::vector<std::pair<float, int> > sorted(scores.size());
+  for (int i = 0; i < scores.size(); ++i) {
+    sorted[i] = std::make_pair(scores[i], i);
+  }
+  std::stable_sort(sorted.begin(), sorted.end());
+  order->resize(scores.size());
+  for (int i = 0; i < scores.size(); ++i) {
+    (*order)[i] = sorted[i].second;
+  }
 }
 
 }  // namespace libmv
@@ -47,9 +47,7 @@ class Kernel {
     models->push_back(P);
   }
   double Error(int sample, const Model &model) const {
-    Mat4X X = X_.col(sample);
-    Mat2X error = Project(model, X) - x_.col(sample);
-    return error.col(0).squaredNorm();
+    return ReprojectionErrorSquared(model, X_.col(sample), x_.col(sample));
   }
   int NumSamples() const {
     return x_.cols();
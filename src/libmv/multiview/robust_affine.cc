@@ -41,12 +41,38 @@ double Affine2DFromCorrespondences3PointRobust(
   double best_score = HUGE_VAL;
   typedef affine::affine2D::kernel::Kernel KernelH;
   KernelH kernel(x1, x2);
-  *H = Estimate(kernel, MLEScorer<KernelH>(threshold), inliers, 
-                &best_score, outliers_probability);
+  RobustEstimationOptions options;
+  options.outliers_probability = outliers_probability;
+  *H = EstimateFast(kernel, MLEScorer<KernelH>(threshold), options,
+                    inliers, &best_score);
   if (best_score == HUGE_VAL)
     return HUGE_VAL;
   else
     return std::sqrt(best_score / 2.0);  
 }
 
+double Affine2DFromAffineFramesRobust(
+    const Mat &x1,
+    const Mat &frames1,
+    const Mat &x2,
+    const Mat &frames2,
+    double max_error,
+    Mat3 *H,
+    vector<int> *inliers,
+    double outliers_probability)
+{
+  double threshold = 2 * Square(max_error);
+  double best_score = HUGE_VAL;
+  typedef affine::affine2D::kernel::AffineFrameKernel KernelH;
+  KernelH kernel(x1, frames1, x2, frames2);
+  RobustEstimationOptions options;
+  options.outliers_probability = outliers_probability;
+  *H = EstimateFast(kernel, MLEScorer<KernelH>(threshold), options,
+                    inliers, &best_score);
+  if (best_score == HUGE_VAL)
+    return HUGE_VAL;
+  else
+    return std::sqrt(best_score / 2.0);
+}
+
 } // namespace libmv
@@ -60,6 +60,24 @@ double Affine2DFromCorrespondences3PointRobust(
     vector<int> *inliers = NULL,
     double outliers_probability = 1e-2);
 
+/** Robust 2D affine transformation estimation from local affine frames
+ *
+ * Same as Affine2DFromCorrespondences3PointRobust(), for correspondences of
+ * local affine frames given as in Homography2DFromAffineFramesRobust(): every
+ * hypothesis is fitted to a single frame correspondence.
+ *
+ * \note The function needs at least 1 frame
+ */
+double Affine2DFromAffineFramesRobust(
+    const Mat &x1,
+    const Mat &frames1,
+    const Mat &x2,
+    const Mat &frames2,
+    double max_error,
+    Mat3 *H,
+    vector<int> *inliers = NULL,
+    double outliers_probability = 1e-2);
+
 } // namespace libmv
 
 #endif  // LIBMV_MULTIVIEW_ROBUST_AFFINE_H_
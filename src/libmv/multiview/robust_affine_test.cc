@@ -73,4 +73,39 @@ TEST(RobustAffine, Affine2DFromCorrespondences2PointRobust) {
   EXPECT_MATRIX_NEAR(H_gt[2], H[2], 1e-8);
 }
 
+TEST(RobustAffine, Affine2DFromAffineFramesRobust) {
+  Mat3 H_gt;
+  H_gt << 1.2, -0.3,  14,
+          0.4,  0.9, -21,
+          0,    0,     1;
+  int n = 20;
+  Mat x1(2, n), frames1(4, n);
+  for (int i = 0; i < n; ++i) {
+    x1.col(i) << 10 * (i % 5) + i, 12 * (i / 5) - i % 3;
+    frames1.col(i) << 2 + i % 3, 1, -1, 3;
+  }
+  Mat2 A = H_gt.block<2, 2>(0, 0);
+  Mat x2 = A * x1;
+  x2.colwise() += H_gt.block<2, 1>(0, 2);
+  Mat frames2(4, n);
+  for (int i = 0; i < n; ++i) {
+    frames2.block<2, 1>(0, i) = A * frames1.block<2, 1>(0, i);
+    frames2.block<2, 1>(2, i) = A * frames1.block<2, 1>(2, i);
+  }
+  // Even indices are outliers.
+  for (int i = 0; i < n; i += 2) {
+    x2(0, i) += 30 + i;
+  }
+
+  Mat3 H;
+  vector<int> inliers;
+  Affine2DFromAffineFramesRobust(x1, frames1, x2, frames2, 0.01, &H,
+                                 &inliers);
+  ASSERT_EQ(n / 2, inliers.size());
+  for (int i = 0; i < inliers.size(); ++i) {
+    EXPECT_EQ(1, inliers[i] % 2);
+  }
+  EXPECT_MATRIX_NEAR(H_gt, H, 1e-8);
+}
+
 }  // namespace
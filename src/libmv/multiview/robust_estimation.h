@@ -21,8 +21,14 @@
 #ifndef LIBMV_MULTIVIEW_ROBUST_ESTIMATION_H_
 #define LIBMV_MULTIVIEW_ROBUST_ESTIMATION_H_
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <set>
+#include <vector>
 
+#include "libmv/base/thread.h"
+#include "libmv/base/timer.h"
 #include "libmv/base/vector.h"
 #include "libmv/logging/logging.h"
 #include "libmv/multiview/random_sample.h"
@@ -30,6 +36,45 @@
 
 namespace libmv {
 
+namespace robust_estimation {
+
+// Whether Kernel has the optional batch entry point
+//   void Errors(const Model &model, int first, int count, double *errors) const
+// computing the errors of the samples [first, first + count) at once.
+template<typename Kernel>
+class HasErrors {
+  typedef char Yes;
+  typedef char No[2];
+  template<typename U,
+           void (U::*)(const typename U::Model &, int, int, double *) const>
+  struct Check {};
+  template<typename U> static Yes &Test(Check<U, &U::Errors> *);
+  template<typename U> static No &Test(...);
+ public:
+  enum { value = sizeof(Test<Kernel>(0)) == sizeof(Yes) };
+};
+
+// Whether Kernel has the optional refinement
+//   void Refine(const vector<int> &inliers, Model *model) const
+// improving a model on its inliers, e.g. by non-linear least squares.
+template<typename Kernel>
+class HasRefine {
+  typedef char Yes;
+  typedef char No[2];
+  template<typename U,
+           void (U::*)(const vector<int> &, typename U::Model *) const>
+  struct Check {};
+  template<typename U> static Yes &Test(Check<U, &U::Refine> *);
+  template<typename U> static No &Test(...);
+ public:
+  enum { value = sizeof(Test<Kernel>(0)) == sizeof(Yes) };
+};
+
+template<bool kValue>
+struct BoolTag {};
+
+}  // namespace robust_estimation
+
 template<typename Kernel>
 class MLEScorer {
  public:
@@ -38,8 +83,34 @@ class MLEScorer {
                const typename Kernel::Model &model,
                const vector<int> &samples,
                vector<int> *inliers) const {
+    return ScoreBounded(kernel, model, samples, HUGE_VAL, inliers);
+  }
+  // Same as Score(), but stops as soon as the cost reaches max_cost, in which
+  // case the returned cost is at least max_cost and inliers is incomplete.
+  double ScoreBounded(const Kernel &kernel,
+                      const typename Kernel::Model &model,
+                      const vector<int> &samples,
+                      double max_cost,
+                      vector<int> *inliers) const {
+    return ScoreBounded(kernel, model, samples, max_cost, inliers,
+        robust_estimation::BoolTag<
+            robust_estimation::HasErrors<Kernel>::value>());
+  }
+  bool IsInlier(const Kernel &kernel,
+                const typename Kernel::Model &model,
+                int sample) const {
+    return kernel.Error(sample, model) < threshold_;
+  }
+ private:
+  // One error at a time through Kernel::Error().
+  double ScoreBounded(const Kernel &kernel,
+                      const typename Kernel::Model &model,
+                      const vector<int> &samples,
+                      double max_cost,
+                      vector<int> *inliers,
+                      robust_estimation::BoolTag<false>) const {
     double cost = 0.0;
-    for (int j = 0; j < samples.size(); ++j) {
+    for (int j = 0; j < samples.size() && cost < max_cost; ++j) {
       double error = kernel.Error(samples[j], model);
       if (error < threshold_) {
         cost += error;
@@ -50,10 +121,95 @@ class MLEScorer {
     }
     return cost;
   }
- private:
+  // Runs of consecutive samples through Kernel::Errors(). The runs start
+  // short so that bad models are still rejected after a few samples.
+  double ScoreBounded(const Kernel &kernel,
+                      const typename Kernel::Model &model,
+                      const vector<int> &samples,
+                      double max_cost,
+                      vector<int> *inliers,
+                      robust_estimation::BoolTag<true>) const {
+    const int kMaxRun = 256;
+    double errors[kMaxRun];
+    int max_run = 16;
+    double cost = 0.0;
+    int j = 0;
+    while (j < samples.size() && cost < max_cost) {
+      int first = samples[j];
+      int run = 1;
+      while (run < max_run && j + run < samples.size() &&
+             samples[j + run] == first + run) {
+        ++run;
+      }
+      kernel.Errors(model, first, run, errors);
+      for (int k = 0; k < run && cost < max_cost; ++k) {
+        if (errors[k] < threshold_) {
+          cost += errors[k];
+          inliers->push_back(first + k);
+        } else {
+          cost += threshold_;
+        }
+      }
+      j += run;
+      max_run = std::min(2 * max_run, kMaxRun);
+    }
+    return cost;
+  }
+
   double threshold_;
 };
 
+// What a robust estimation did, for tuning the options and the thresholds.
+// The estimators fill it when given one.
+struct RobustEstimationStatistics {
+  RobustEstimationStatistics()
+    : iterations(0),
+      num_hypotheses(0),
+      num_pre_verification_rejections(0),
+      num_cost_rejections(0),
+      inlier_ratio(0),
+      seconds(0),
+      deadline_reached(false) {}
+
+  // Minimal subsets sampled, and models fitted on them.
+  size_t iterations;
+  size_t num_hypotheses;
+
+  // Hypotheses which failed the pre-verification test, and hypotheses which
+  // were scored but did not beat the best model; with ScoreBounded(), most of
+  // these are stopped before all the samples are scored.
+  size_t num_pre_verification_rejections;
+  size_t num_cost_rejections;
+
+  // The iteration at which every new best model was found, and its inlier
+  // ratio after the local optimization, if any.
+  std::vector<size_t> improvement_iterations;
+  std::vector<double> improvement_inlier_ratios;
+
+  // The inlier ratio of the returned model.
+  double inlier_ratio;
+
+  double seconds;
+
+  // Whether the estimation stopped at the deadline of the options, rather
+  // than after the iterations its inlier ratio required. The returned model
+  // is then the best one found so far.
+  bool deadline_reached;
+};
+
+namespace robust_estimation {
+
+inline void RecordImprovement(size_t iteration,
+                              double inlier_ratio,
+                              RobustEstimationStatistics *statistics) {
+  if (statistics) {
+    statistics->improvement_iterations.push_back(iteration);
+    statistics->improvement_inlier_ratios.push_back(inlier_ratio);
+  }
+}
+
+}  // namespace robust_estimation
+
 static uint IterationsRequired(int min_samples,
                         double outliers_probability,
                         double inlier_ratio) {
@@ -70,12 +226,22 @@ static uint IterationsRequired(int min_samples,
 // 2. Kernel::MINIMUM_SAMPLES
 // 3. Kernel::Fit(vector<int>, vector<Kernel::Model> *)
 // 4. Kernel::Error(Model, int) -> error
+//
+// The estimation stops at the deadline, if any (see libmv/base/timer.h),
+// after at least one iteration. The subsets are drawn from a StreamSampler
+// seeded from rand(), which is only called once.
 template<typename Kernel, typename Scorer>
 typename Kernel::Model Estimate(const Kernel &kernel,
                                 const Scorer &scorer,
                                 vector<int> *best_inliers = NULL,
                                 double *best_score = NULL,
-                                double outliers_probability = 1e-2) {
+                                double outliers_probability = 1e-2,
+                                RobustEstimationStatistics *statistics = NULL,
+                                double deadline = 0) {
+  LIBMV_SCOPED_TIMER("ransac");
+  WallTimer timer;
+  if (statistics)
+    *statistics = RobustEstimationStatistics();
   CHECK(outliers_probability < 1.0);
   CHECK(outliers_probability > 0.0);
   size_t iteration = 0;
@@ -94,6 +260,8 @@ typename Kernel::Model Estimate(const Kernel &kernel,
   if (total_samples < min_samples)  {
     if (best_inliers)
       best_inliers->resize(0);
+    if (statistics)
+      statistics->seconds = timer.ElapsedSeconds();
     return best_model;
   }
 
@@ -104,15 +272,23 @@ typename Kernel::Model Estimate(const Kernel &kernel,
     all_samples.push_back(i);
   }
 
+  StreamSampler sampler(rand());
   vector<int> sample;
   for (iteration = 0;
        iteration < max_iterations &&
        iteration < really_max_iterations; ++iteration) {
-    UniformSample(min_samples, total_samples, &sample);
+    if (iteration > 0 && DeadlineReached(deadline)) {
+      if (statistics)
+        statistics->deadline_reached = true;
+      break;
+    }
+    sampler.Sample(min_samples, total_samples, &sample);
 
     vector<typename Kernel::Model> models;
     kernel.Fit(sample, &models);
     VLOG(4) << "Fitted subset; found " << models.size() << " model(s).";
+    if (statistics)
+      statistics->num_hypotheses += models.size();
 
     // Compute costs for each fit.
     for (int i = 0; i < models.size(); ++i) {
@@ -129,9 +305,13 @@ typename Kernel::Model Estimate(const Kernel &kernel,
         if (best_inliers) {
           best_inliers->swap(inliers);
         }
+        robust_estimation::RecordImprovement(iteration, best_inlier_ratio,
+                                             statistics);
         VLOG(4) << "New best cost: " << best_cost << " with "
                 << best_num_inliers << " inlying of "
                 << total_samples << " total samples.";
+      } else if (statistics) {
+        statistics->num_cost_rejections++;
       }
       if (best_inlier_ratio)
         max_iterations = IterationsRequired(min_samples, 
@@ -142,6 +322,694 @@ typename Kernel::Model Estimate(const Kernel &kernel,
         << max_iterations << "; best inlier ratio: " << best_inlier_ratio;
     }
   }
+  LIBMV_HISTOGRAM("ransac.iterations", iteration);
+  if (statistics) {
+    statistics->iterations = iteration;
+    statistics->inlier_ratio = best_inlier_ratio;
+    statistics->seconds = timer.ElapsedSeconds();
+  }
+  if (best_score)
+    *best_score = best_cost;
+  return best_model;
+}
+
+struct RobustEstimationOptions {
+  RobustEstimationOptions()
+    : outliers_probability(1e-2),
+      max_iterations(1000),
+      pre_verification_samples(1),
+      local_optimization_iterations(0),
+      local_optimization_sample_size(0),
+      warm_start_iterations(10),
+      warm_start_inlier_ratio(0.5),
+      deadline(0),
+      seed(0) {}
+
+  // Probability to miss the best model; controls the adaptive number of
+  // iterations (see IterationsRequired()).
+  double outliers_probability;
+
+  // Hard limit on the number of sampled subsets.
+  size_t max_iterations;
+
+  // Number of random samples a model must explain before being scored on
+  // all the data (the T(d,d) test). 0 disables the test.
+  int pre_verification_samples;
+
+  // Number of models fitted on random subsets of the inliers every time a new
+  // best model is found (the inner RANSAC of LO-RANSAC), before the optional
+  // Kernel::Refine(). 0 disables the local optimization.
+  int local_optimization_iterations;
+
+  // Size of these subsets; 0 means 4 * MINIMUM_SAMPLES. The subsets never
+  // take more than half the inliers, so that they differ.
+  int local_optimization_sample_size;
+
+  // Number of minimal subsets of the inliers of the prior model fitted by
+  // EstimateWarmStart() before it accepts a model.
+  int warm_start_iterations;
+
+  // Fraction of the samples the warm started model must explain for
+  // EstimateWarmStart() not to fall back to EstimateFast().
+  double warm_start_inlier_ratio;
+
+  // WallTimeInSeconds() at which the estimation returns the best model found
+  // so far, after at least one iteration; 0, the default, waits for the
+  // iterations required by the inlier ratio. See DeadlineInSeconds().
+  double deadline;
+
+  // Seed of the random streams of the estimators, which then give the same
+  // results for the same seed (and number of threads, for EstimateParallel())
+  // whatever else uses rand(). 0, the default, takes the seed from rand().
+  unsigned int seed;
+};
+
+namespace robust_estimation {
+
+// The streams of the RandomGenerator of an estimation, for a given seed. The
+// threads of EstimateParallel() sample from the streams kThreadStreams + t.
+enum {
+  kSamplingStream = 0,
+  kPreVerificationStream,
+  kLocalOptimizationStream,
+  kThreadStreams
+};
+
+inline unsigned int Seed(const RobustEstimationOptions &options) {
+  return options.seed ? options.seed : rand();
+}
+
+// Same as IterationsRequired(), without overflow for small inlier ratios.
+inline size_t IterationsRequired(int min_samples,
+                                 double outliers_probability,
+                                 double inlier_ratio,
+                                 size_t max_iterations) {
+  double all_inliers = pow(inlier_ratio, min_samples);
+  if (all_inliers >= 1.0) {
+    return 1;
+  }
+  double n = log(outliers_probability) / log(1.0 - all_inliers);
+  return n < max_iterations ? static_cast<size_t>(n) : max_iterations;
+}
+
+// The local optimization of LO-RANSAC (Chum, Matas and Kittler, "Locally
+// Optimized RANSAC", DAGM 2003). Given a new best model and its inliers, fits
+// models on random subsets of the inliers with the non-minimal Kernel::Fit(),
+// then refines the best one on its inliers with Kernel::Refine() if the
+// kernel has one. The model, its cost and its inliers are replaced whenever
+// the cost decreases. The buffers are kept from one call to the next. The
+// subsets are drawn from the kLocalOptimizationStream of seed.
+template<typename Kernel, typename Scorer>
+class LocalOptimizer {
+ public:
+  LocalOptimizer(const Kernel &kernel,
+                 const Scorer &scorer,
+                 const RobustEstimationOptions &options,
+                 const vector<int> &all_samples,
+                 unsigned int seed)
+    : kernel_(kernel),
+      scorer_(scorer),
+      all_samples_(all_samples),
+      iterations_(options.local_optimization_iterations),
+      sample_size_(options.local_optimization_sample_size),
+      generator_(seed, kLocalOptimizationStream) {
+    if (sample_size_ <= 0) {
+      sample_size_ = 4 * Kernel::MINIMUM_SAMPLES;
+    }
+  }
+
+  bool enabled() const { return iterations_ > 0; }
+
+  void Optimize(typename Kernel::Model *model,
+                double *cost,
+                vector<int> *inliers) {
+    for (int iteration = 0; iteration < iterations_; ++iteration) {
+      int sample_size = std::min(sample_size_, int(inliers->size()) / 2);
+      if (sample_size <= Kernel::MINIMUM_SAMPLES) {
+        break;
+      }
+      // Partial Fisher-Yates shuffle of the inliers.
+      pool_ = *inliers;
+      sample_.resize(sample_size);
+      for (int i = 0; i < sample_size; ++i) {
+        int j = i + generator_.Uniform(pool_.size() - i);
+        std::swap(pool_[i], pool_[j]);
+        sample_[i] = pool_[i];
+      }
+      models_.resize(0);
+      kernel_.Fit(sample_, &models_);
+      for (int i = 0; i < models_.size(); ++i) {
+        Update(models_[i], model, cost, inliers);
+      }
+    }
+    Refine(model, cost, inliers, BoolTag<HasRefine<Kernel>::value>());
+  }
+
+ private:
+  void Update(const typename Kernel::Model &candidate,
+              typename Kernel::Model *model,
+              double *cost,
+              vector<int> *inliers) {
+    candidate_inliers_.resize(0);
+    double candidate_cost = scorer_.ScoreBounded(kernel_, candidate,
+                                                 all_samples_, *cost,
+                                                 &candidate_inliers_);
+    if (candidate_cost < *cost) {
+      VLOG(4) << "Local optimization: cost " << *cost << " -> "
+              << candidate_cost;
+      *cost = candidate_cost;
+      *model = candidate;
+      inliers->swap(candidate_inliers_);
+    }
+  }
+
+  void Refine(typename Kernel::Model *model,
+              double *cost,
+              vector<int> *inliers,
+              BoolTag<true>) {
+    if (inliers->size() <= Kernel::MINIMUM_SAMPLES) {
+      return;
+    }
+    typename Kernel::Model refined = *model;
+    kernel_.Refine(*inliers, &refined);
+    Update(refined, model, cost, inliers);
+  }
+  void Refine(typename Kernel::Model *, double *, vector<int> *,
+              BoolTag<false>) {}
+
+  const Kernel &kernel_;
+  const Scorer &scorer_;
+  const vector<int> &all_samples_;
+  int iterations_;
+  int sample_size_;
+  RandomGenerator generator_;
+  vector<int> pool_, sample_, candidate_inliers_;
+  vector<typename Kernel::Model> models_;
+};
+
+}  // namespace robust_estimation
+
+// Faster version of Estimate(), for the same kernels. The differences are:
+//
+//  - A model which makes the cost go above the best cost so far is rejected
+//    without scoring the remaining samples (Scorer::ScoreBounded()). This does
+//    not change the result.
+//  - Unless disabled in the options, a model is only scored on all the data
+//    after a few random samples have been found to be inliers
+//    (Scorer::IsInlier()). The iteration bound is increased accordingly, since
+//    a good model can fail the test.
+//  - Buffers are allocated once and reused across iterations.
+//  - If enabled in the options, every new best model goes through the local
+//    optimization of LO-RANSAC (see robust_estimation::LocalOptimizer). The
+//    iteration bound follows the inliers of the optimized model, which makes
+//    it stop much earlier.
+//
+// The scorer must provide ScoreBounded() and IsInlier(), like MLEScorer. The
+// sampler draws the minimal subsets, see StreamSampler and ProsacSampler; the
+// other random draws come from options.seed.
+template<typename Kernel, typename Scorer, typename Sampler>
+typename Kernel::Model EstimateFast(const Kernel &kernel,
+                                    const Scorer &scorer,
+                                    const RobustEstimationOptions &options,
+                                    Sampler *sampler,
+                                    vector<int> *best_inliers = NULL,
+                                    double *best_score = NULL,
+                                    RobustEstimationStatistics *statistics =
+                                        NULL) {
+  LIBMV_SCOPED_TIMER("ransac");
+  WallTimer timer;
+  if (statistics)
+    *statistics = RobustEstimationStatistics();
+  CHECK(options.outliers_probability < 1.0);
+  CHECK(options.outliers_probability > 0.0);
+  const int min_samples = Kernel::MINIMUM_SAMPLES;
+  const int total_samples = kernel.NumSamples();
+  const int pre_verification_samples = options.pre_verification_samples;
+
+  double best_cost = HUGE_VAL;
+  typename Kernel::Model best_model;
+  if (best_inliers)
+    best_inliers->resize(0);
+
+  if (total_samples < min_samples)  {
+    if (best_score)
+      *best_score = best_cost;
+    if (statistics)
+      statistics->seconds = timer.ElapsedSeconds();
+    return best_model;
+  }
+
+  vector<int> all_samples;
+  all_samples.reserve(total_samples);
+  for (int i = 0; i < total_samples; ++i) {
+    all_samples.push_back(i);
+  }
+  vector<int> sample, inliers, best_inliers_so_far;
+  inliers.reserve(total_samples);
+  best_inliers_so_far.reserve(total_samples);
+  vector<typename Kernel::Model> models;
+  const unsigned int seed = robust_estimation::Seed(options);
+  RandomGenerator generator(seed, robust_estimation::kPreVerificationStream);
+  robust_estimation::LocalOptimizer<Kernel, Scorer> local_optimizer(
+      kernel, scorer, options, all_samples, seed);
+
+  size_t max_iterations = options.max_iterations;
+  size_t iteration = 0;
+  for (; iteration < max_iterations; ++iteration) {
+    if (iteration > 0 && DeadlineReached(options.deadline)) {
+      if (statistics)
+        statistics->deadline_reached = true;
+      break;
+    }
+    sampler->Sample(min_samples, total_samples, &sample);
+    models.resize(0);
+    kernel.Fit(sample, &models);
+    if (statistics)
+      statistics->num_hypotheses += models.size();
+
+    for (int i = 0; i < models.size(); ++i) {
+      bool passed = true;
+      for (int j = 0; j < pre_verification_samples && passed; ++j) {
+        passed = scorer.IsInlier(kernel, models[i],
+                                 generator.Uniform(total_samples));
+      }
+      if (!passed) {
+        if (statistics)
+          statistics->num_pre_verification_rejections++;
+        continue;
+      }
+      inliers.resize(0);
+      double cost = scorer.ScoreBounded(kernel, models[i], all_samples,
+                                        best_cost, &inliers);
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_model = models[i];
+        inliers.swap(best_inliers_so_far);
+        if (local_optimizer.enabled()) {
+          local_optimizer.Optimize(&best_model, &best_cost,
+                                   &best_inliers_so_far);
+        }
+        double inlier_ratio = best_inliers_so_far.size() /
+                              double(total_samples);
+        max_iterations = robust_estimation::IterationsRequired(
+            min_samples + pre_verification_samples,
+            options.outliers_probability,
+            inlier_ratio,
+            options.max_iterations);
+        robust_estimation::RecordImprovement(iteration, inlier_ratio,
+                                             statistics);
+        VLOG(4) << "New best cost: " << best_cost << " with "
+                << best_inliers_so_far.size() << " inlying of "
+                << total_samples << " total samples; iterations needed: "
+                << max_iterations;
+      } else if (statistics) {
+        statistics->num_cost_rejections++;
+      }
+    }
+  }
+  LIBMV_HISTOGRAM("ransac.iterations", iteration);
+  if (statistics) {
+    statistics->iterations = iteration;
+    statistics->inlier_ratio = best_inliers_so_far.size() /
+                               double(total_samples);
+    statistics->seconds = timer.ElapsedSeconds();
+  }
+  if (best_inliers)
+    best_inliers->swap(best_inliers_so_far);
+  if (best_score)
+    *best_score = best_cost;
+  return best_model;
+}
+
+template<typename Kernel, typename Scorer>
+typename Kernel::Model EstimateFast(const Kernel &kernel,
+                                    const Scorer &scorer,
+                                    const RobustEstimationOptions &options,
+                                    vector<int> *best_inliers = NULL,
+                                    double *best_score = NULL,
+                                    RobustEstimationStatistics *statistics =
+                                        NULL) {
+  RobustEstimationOptions seeded_options = options;
+  seeded_options.seed = robust_estimation::Seed(options);
+  StreamSampler sampler(seeded_options.seed,
+                        robust_estimation::kSamplingStream);
+  return EstimateFast(kernel, scorer, seeded_options, &sampler,
+                      best_inliers, best_score, statistics);
+}
+
+// Same as EstimateFast(), warm started from a prior model which is likely
+// close to the solution, such as the motion between the previous two frames of
+// a video:
+//
+//  1. The prior is scored on all the samples.
+//  2. options.warm_start_iterations minimal subsets of the inliers of the best
+//     model so far are fitted and scored, then the best model goes through the
+//     local optimization if it is enabled. It is returned if it explains
+//     options.warm_start_inlier_ratio of the samples. The prior itself only
+//     needs a few inliers, so that a motion which drifted beyond the
+//     threshold is still recovered from them.
+//  3. Otherwise EstimateFast() runs from scratch.
+//
+// When the prior holds, this costs a handful of hypotheses instead of a full
+// RANSAC. Past options.deadline, the model of step 2 is returned without the
+// fallback even if it explains fewer samples. warm_started tells whether the
+// fallback was avoided. The statistics count the hypotheses of both steps.
+template<typename Kernel, typename Scorer>
+typename Kernel::Model EstimateWarmStart(
+    const Kernel &kernel,
+    const Scorer &scorer,
+    const RobustEstimationOptions &options,
+    const typename Kernel::Model &prior,
+    vector<int> *best_inliers = NULL,
+    double *best_score = NULL,
+    bool *warm_started = NULL,
+    RobustEstimationStatistics *statistics = NULL) {
+  WallTimer timer;
+  RobustEstimationStatistics warm_start_statistics;
+  const int min_samples = Kernel::MINIMUM_SAMPLES;
+  const int total_samples = kernel.NumSamples();
+  const int min_inliers = static_cast<int>(
+      ceil(options.warm_start_inlier_ratio * total_samples));
+  if (warm_started)
+    *warm_started = false;
+
+  if (total_samples >= min_samples) {
+    vector<int> all_samples;
+    all_samples.reserve(total_samples);
+    for (int i = 0; i < total_samples; ++i) {
+      all_samples.push_back(i);
+    }
+    vector<int> inliers;
+    inliers.reserve(total_samples);
+    double cost = scorer.Score(kernel, prior, all_samples, &inliers);
+    typename Kernel::Model model = prior;
+    if (inliers.size() >= min_samples) {
+      const unsigned int seed = robust_estimation::Seed(options);
+      RandomGenerator generator(seed, robust_estimation::kSamplingStream);
+      vector<int> pool, sample, candidate_inliers;
+      candidate_inliers.reserve(total_samples);
+      vector<typename Kernel::Model> models;
+      for (int iteration = 0;
+           iteration < options.warm_start_iterations &&
+           inliers.size() >= min_samples;
+           ++iteration) {
+        // Partial Fisher-Yates shuffle of the inliers.
+        pool = inliers;
+        sample.resize(min_samples);
+        for (int i = 0; i < min_samples; ++i) {
+          int j = i + generator.Uniform(pool.size() - i);
+          std::swap(pool[i], pool[j]);
+          sample[i] = pool[i];
+        }
+        models.resize(0);
+        kernel.Fit(sample, &models);
+        warm_start_statistics.iterations++;
+        warm_start_statistics.num_hypotheses += models.size();
+        for (int i = 0; i < models.size(); ++i) {
+          candidate_inliers.resize(0);
+          double candidate_cost = scorer.ScoreBounded(kernel, models[i],
+                                                      all_samples, cost,
+                                                      &candidate_inliers);
+          if (candidate_cost < cost) {
+            cost = candidate_cost;
+            model = models[i];
+            inliers.swap(candidate_inliers);
+            robust_estimation::RecordImprovement(
+                iteration, inliers.size() / double(total_samples),
+                &warm_start_statistics);
+          } else {
+            warm_start_statistics.num_cost_rejections++;
+          }
+        }
+      }
+      robust_estimation::LocalOptimizer<Kernel, Scorer> local_optimizer(
+          kernel, scorer, options, all_samples, seed);
+      if (local_optimizer.enabled()) {
+        local_optimizer.Optimize(&model, &cost, &inliers);
+      }
+      // Past the deadline, the warm started model is the best one so far.
+      bool deadline_reached = inliers.size() < min_inliers &&
+                              DeadlineReached(options.deadline);
+      if (inliers.size() >= min_inliers || deadline_reached) {
+        VLOG(4) << "Warm started with cost " << cost << " and "
+                << inliers.size() << " inlying of " << total_samples
+                << " total samples.";
+        if (statistics) {
+          *statistics = warm_start_statistics;
+          statistics->deadline_reached = deadline_reached;
+          statistics->inlier_ratio = inliers.size() / double(total_samples);
+          statistics->seconds = timer.ElapsedSeconds();
+        }
+        if (best_inliers)
+          best_inliers->swap(inliers);
+        if (best_score)
+          *best_score = cost;
+        if (warm_started)
+          *warm_started = true;
+        return model;
+      }
+    }
+  }
+  VLOG(4) << "The prior does not hold, falling back to EstimateFast().";
+  typename Kernel::Model model = EstimateFast(kernel, scorer, options,
+                                              best_inliers, best_score,
+                                              statistics);
+  if (statistics) {
+    // The iterations of the fallback are numbered after the warm start ones.
+    for (size_t i = 0; i < statistics->improvement_iterations.size(); ++i) {
+      statistics->improvement_iterations[i] += warm_start_statistics.iterations;
+    }
+    statistics->improvement_iterations.insert(
+        statistics->improvement_iterations.begin(),
+        warm_start_statistics.improvement_iterations.begin(),
+        warm_start_statistics.improvement_iterations.end());
+    statistics->improvement_inlier_ratios.insert(
+        statistics->improvement_inlier_ratios.begin(),
+        warm_start_statistics.improvement_inlier_ratios.begin(),
+        warm_start_statistics.improvement_inlier_ratios.end());
+    statistics->iterations += warm_start_statistics.iterations;
+    statistics->num_hypotheses += warm_start_statistics.num_hypotheses;
+    statistics->num_cost_rejections +=
+        warm_start_statistics.num_cost_rejections;
+    statistics->seconds = timer.ElapsedSeconds();
+  }
+  return model;
+}
+
+namespace robust_estimation {
+
+// Generates and scores a batch of hypotheses per thread for
+// EstimateParallel(). Thread t only uses samplers[t] and writes slot t of the
+// results, so the outcome of a round does not depend on the scheduling.
+template<typename Kernel, typename Scorer>
+struct ParallelHypotheses {
+  ParallelHypotheses(const Kernel &kernel,
+                     const Scorer &scorer,
+                     const vector<int> &all_samples,
+                     int pre_verification_samples,
+                     int num_threads)
+    : kernel(kernel),
+      scorer(scorer),
+      all_samples(all_samples),
+      pre_verification_samples(pre_verification_samples),
+      batch_size(0),
+      max_cost(HUGE_VAL),
+      samplers(num_threads),
+      costs(num_threads),
+      num_inliers(num_threads),
+      num_hypotheses(num_threads, 0),
+      num_pre_verification_rejections(num_threads, 0),
+      num_cost_rejections(num_threads, 0) {
+    models.resize(num_threads);
+  }
+
+  void operator()(int t) {
+    const int min_samples = Kernel::MINIMUM_SAMPLES;
+    const int total_samples = all_samples.size();
+    StreamSampler &sampler = samplers[t];
+    vector<int> sample, inliers;
+    inliers.reserve(total_samples);
+    vector<typename Kernel::Model> fitted;
+
+    costs[t] = HUGE_VAL;
+    double best_cost = max_cost;
+    for (int b = 0; b < batch_size; ++b) {
+      sampler.Sample(min_samples, total_samples, &sample);
+      fitted.resize(0);
+      kernel.Fit(sample, &fitted);
+      num_hypotheses[t] += fitted.size();
+      for (int i = 0; i < fitted.size(); ++i) {
+        bool passed = true;
+        for (int j = 0; j < pre_verification_samples && passed; ++j) {
+          passed = scorer.IsInlier(kernel, fitted[i],
+                                   sampler.Uniform(total_samples));
+        }
+        if (!passed) {
+          num_pre_verification_rejections[t]++;
+          continue;
+        }
+        inliers.resize(0);
+        double cost = scorer.ScoreBounded(kernel, fitted[i], all_samples,
+                                          best_cost, &inliers);
+        if (cost < best_cost) {
+          best_cost = cost;
+          costs[t] = cost;
+          models[t] = fitted[i];
+          num_inliers[t] = inliers.size();
+        } else {
+          num_cost_rejections[t]++;
+        }
+      }
+    }
+  }
+
+  const Kernel &kernel;
+  const Scorer &scorer;
+  const vector<int> &all_samples;
+  int pre_verification_samples;
+
+  // Set before each round.
+  int batch_size;
+  double max_cost;
+
+  // One slot per thread.
+  std::vector<StreamSampler> samplers;
+  std::vector<double> costs;
+  std::vector<int> num_inliers;
+  vector<typename Kernel::Model> models;
+
+  // One slot per thread, accumulated over the rounds.
+  std::vector<size_t> num_hypotheses;
+  std::vector<size_t> num_pre_verification_rejections;
+  std::vector<size_t> num_cost_rejections;
+};
+
+}  // namespace robust_estimation
+
+// Multi-threaded version of EstimateFast(). Hypotheses are generated and
+// scored in rounds of a small batch per thread, each thread drawing from its
+// own stream of options.seed; the best model of a round is reduced at the end
+// of the round, and raises the bar for the next one. For a given seed and
+// thread count the result is deterministic.
+//
+// The kernel and the scorer are used concurrently through their const
+// methods. The local optimization, if enabled, runs on the calling thread at
+// the end of the rounds which improve the best model. With num_threads <= 1
+// this is EstimateFast().
+template<typename Kernel, typename Scorer>
+typename Kernel::Model EstimateParallel(const Kernel &kernel,
+                                        const Scorer &scorer,
+                                        const RobustEstimationOptions &options,
+                                        int num_threads,
+                                        vector<int> *best_inliers = NULL,
+                                        double *best_score = NULL,
+                                        RobustEstimationStatistics *statistics
+                                            = NULL) {
+  if (num_threads <= 1) {
+    return EstimateFast(kernel, scorer, options, best_inliers, best_score,
+                        statistics);
+  }
+  LIBMV_SCOPED_TIMER("ransac");
+  WallTimer timer;
+  if (statistics)
+    *statistics = RobustEstimationStatistics();
+  CHECK(options.outliers_probability < 1.0);
+  CHECK(options.outliers_probability > 0.0);
+  const int min_samples = Kernel::MINIMUM_SAMPLES;
+  const int total_samples = kernel.NumSamples();
+  // Hypotheses per thread and round; large enough to hide the cost of the
+  // round, small enough to share a good model early.
+  const size_t kMaxBatchSize = 16;
+
+  double best_cost = HUGE_VAL;
+  int best_num_inliers = 0;
+  typename Kernel::Model best_model;
+  if (best_inliers)
+    best_inliers->resize(0);
+
+  if (total_samples < min_samples)  {
+    if (best_score)
+      *best_score = best_cost;
+    return best_model;
+  }
+
+  vector<int> all_samples;
+  all_samples.reserve(total_samples);
+  for (int i = 0; i < total_samples; ++i) {
+    all_samples.push_back(i);
+  }
+  robust_estimation::ParallelHypotheses<Kernel, Scorer> hypotheses(
+      kernel, scorer, all_samples, options.pre_verification_samples,
+      num_threads);
+  const unsigned int seed = robust_estimation::Seed(options);
+  for (int t = 0; t < num_threads; ++t) {
+    hypotheses.samplers[t].Seed(seed, robust_estimation::kThreadStreams + t);
+  }
+  robust_estimation::LocalOptimizer<Kernel, Scorer> local_optimizer(
+      kernel, scorer, options, all_samples, seed);
+  vector<int> inliers;
+
+  size_t max_iterations = options.max_iterations;
+  size_t iteration = 0;
+  while (iteration < max_iterations) {
+    // The deadline is checked between rounds.
+    if (iteration > 0 && DeadlineReached(options.deadline)) {
+      if (statistics)
+        statistics->deadline_reached = true;
+      break;
+    }
+    size_t remaining = max_iterations - iteration;
+    size_t batch_size = (remaining + num_threads - 1) / num_threads;
+    hypotheses.batch_size = std::min(batch_size, kMaxBatchSize);
+    hypotheses.max_cost = best_cost;
+    ParallelFor(0, num_threads, num_threads, &hypotheses);
+    iteration += hypotheses.batch_size * num_threads;
+
+    bool improved = false;
+    for (int t = 0; t < num_threads; ++t) {
+      if (hypotheses.costs[t] < best_cost) {
+        best_cost = hypotheses.costs[t];
+        best_model = hypotheses.models[t];
+        best_num_inliers = hypotheses.num_inliers[t];
+        improved = true;
+      }
+    }
+    if (improved && local_optimizer.enabled()) {
+      // Done once per round by this thread, so the rounds stay deterministic.
+      inliers.resize(0);
+      scorer.Score(kernel, best_model, all_samples, &inliers);
+      local_optimizer.Optimize(&best_model, &best_cost, &inliers);
+      best_num_inliers = inliers.size();
+    }
+    if (improved) {
+      robust_estimation::RecordImprovement(
+          iteration, best_num_inliers / double(total_samples), statistics);
+      max_iterations = robust_estimation::IterationsRequired(
+          min_samples + options.pre_verification_samples,
+          options.outliers_probability,
+          best_num_inliers / double(total_samples),
+          options.max_iterations);
+      VLOG(4) << "New best cost: " << best_cost << " with "
+              << best_num_inliers << " inlying of "
+              << total_samples << " total samples; iterations needed: "
+              << max_iterations;
+    }
+  }
+  LIBMV_HISTOGRAM("ransac.iterations", iteration);
+  if (statistics) {
+    statistics->iterations = iteration;
+    for (int t = 0; t < num_threads; ++t) {
+      statistics->num_hypotheses += hypotheses.num_hypotheses[t];
+      statistics->num_pre_verification_rejections +=
+          hypotheses.num_pre_verification_rejections[t];
+      statistics->num_cost_rejections += hypotheses.num_cost_rejections[t];
+    }
+    statistics->inlier_ratio = best_num_inliers / double(total_samples);
+    statistics->seconds = timer.ElapsedSeconds();
+  }
+  // The inliers are only gathered once, for the final model.
+  if (best_inliers && best_cost < HUGE_VAL)
+    scorer.Score(kernel, best_model, all_samples, best_inliers);
   if (best_score)
     *best_score = best_cost;
   return best_model;
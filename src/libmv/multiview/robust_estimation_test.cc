@@ -43,6 +43,56 @@ TEST(UniformSampleTest, NoRepetions) {
   }
 }
 
+TEST(ProsacSamplerTest, StartsWithTheBestSamples) {
+  ProsacSampler sampler;
+  vector<int> samples;
+  sampler.Sample(3, 100, &samples);
+  ASSERT_EQ(3, samples.size());
+  std::vector<bool> in_set(3, false);
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_LT(samples[i], 3);
+    EXPECT_FALSE(in_set[samples[i]]);
+    in_set[samples[i]] = true;
+  }
+}
+
+TEST(ProsacSamplerTest, PoolGrowsToAllSamples) {
+  ProsacSampler sampler(1000);
+  vector<int> samples;
+  int previous_pool_size = 0;
+  for (int i = 0; i < 2000; ++i) {
+    sampler.Sample(2, 50, &samples);
+    ASSERT_EQ(2, samples.size());
+    EXPECT_NE(samples[0], samples[1]);
+    EXPECT_LT(samples[0], sampler.PoolSize());
+    EXPECT_LT(samples[1], sampler.PoolSize());
+    EXPECT_LE(previous_pool_size, sampler.PoolSize());
+    previous_pool_size = sampler.PoolSize();
+  }
+  EXPECT_EQ(50, sampler.PoolSize());
+}
+
+TEST(ProsacSamplerTest, UsesTheGivenOrder) {
+  vector<float> scores;
+  scores.push_back(0.9);
+  scores.push_back(0.1);
+  scores.push_back(0.5);
+  scores.push_back(0.3);
+  vector<int> order;
+  OrderByIncreasingScore(scores, &order);
+  ASSERT_EQ(4, order.size());
+  EXPECT_EQ(1, order[0]);
+  EXPECT_EQ(3, order[1]);
+  EXPECT_EQ(2, order[2]);
+  EXPECT_EQ(0, order[3]);
+
+  ProsacSampler sampler(order);
+  vector<int> samples;
+  sampler.Sample(2, 4, &samples);
+  ASSERT_EQ(2, samples.size());
+  EXPECT_EQ(4, samples[0] + samples[1]);
+}
+
 struct LineKernel {
   LineKernel(const Mat2X &xs) : xs_(xs) {}
 
@@ -151,4 +201,483 @@ TEST(RobustLineFitter, TooFewPoints) {
   ASSERT_EQ(0, inliers.size());
 }
 
+TEST(RobustLineFitterFast, OneOutlier) {
+  Mat2X xy(2, 6);
+  // y = 2x + 1 with an outlier
+  xy << 1, 2, 3, 4,  5, /* outlier! */  100,
+        3, 5, 7, 9, 11, /* outlier! */ -123;
+
+  LineKernel kernel(xy);
+  vector<int> inliers;
+  double score;
+  Vec2 ba = EstimateFast(kernel, MLEScorer<LineKernel>(4),
+                         RobustEstimationOptions(), &inliers, &score);
+  EXPECT_NEAR(2.0, ba[1], 1e-9);
+  EXPECT_NEAR(1.0, ba[0], 1e-9);
+  ASSERT_EQ(5, inliers.size());
+  EXPECT_NEAR(4.0, score, 1e-9);
+}
+
+TEST(RobustLineFitterFast, ManyOutliers) {
+  // y = -x + 3, with 40% of gross outliers.
+  const int n = 100;
+  Mat2X xy(2, n);
+  srand(5);
+  for (int i = 0; i < n; ++i) {
+    xy(0, i) = i;
+    xy(1, i) = (i % 5 < 2) ? 1000 + (rand() % 1000) : -i + 3;
+  }
+  LineKernel kernel(xy);
+  for (int d = 0; d < 3; ++d) {
+    RobustEstimationOptions options;
+    options.pre_verification_samples = d;
+    vector<int> inliers;
+    Vec2 ba = EstimateFast(kernel, MLEScorer<LineKernel>(0.5), options,
+                           &inliers);
+    EXPECT_NEAR(-1.0, ba[1], 1e-9);
+    EXPECT_NEAR(3.0, ba[0], 1e-9);
+    EXPECT_EQ(60, inliers.size());
+  }
+}
+
+TEST(RobustLineFitterFast, ProsacWithOutliersLast) {
+  // y = 2x + 1; the last half of the points, the worst ranked, are outliers.
+  const int n = 100;
+  Mat2X xy(2, n);
+  srand(7);
+  for (int i = 0; i < n; ++i) {
+    xy(0, i) = i;
+    xy(1, i) = (i >= n / 2) ? 1000 + (rand() % 1000) : 2 * i + 1;
+  }
+  LineKernel kernel(xy);
+  ProsacSampler sampler;
+  vector<int> inliers;
+  Vec2 ba = EstimateFast(kernel, MLEScorer<LineKernel>(0.5),
+                         RobustEstimationOptions(), &sampler, &inliers);
+  EXPECT_NEAR(2.0, ba[1], 1e-9);
+  EXPECT_NEAR(1.0, ba[0], 1e-9);
+  EXPECT_EQ(n / 2, inliers.size());
+  // The first draw is all-inlier and the estimation stops early.
+  EXPECT_LT(sampler.PoolSize(), n / 2);
+}
+
+TEST(RobustLineFitterParallel, ManyOutliers) {
+  // y = -x + 3, with 40% of gross outliers.
+  const int n = 100;
+  Mat2X xy(2, n);
+  srand(5);
+  for (int i = 0; i < n; ++i) {
+    xy(0, i) = i;
+    xy(1, i) = (i % 5 < 2) ? 1000 + (rand() % 1000) : -i + 3;
+  }
+  LineKernel kernel(xy);
+  for (int num_threads = 1; num_threads <= 4; ++num_threads) {
+    vector<int> inliers;
+    double score;
+    Vec2 ba = EstimateParallel(kernel, MLEScorer<LineKernel>(0.5),
+                               RobustEstimationOptions(), num_threads,
+                               &inliers, &score);
+    EXPECT_NEAR(-1.0, ba[1], 1e-9);
+    EXPECT_NEAR(3.0, ba[0], 1e-9);
+    EXPECT_EQ(60, inliers.size());
+    EXPECT_NEAR(40 * 0.5, score, 1e-9);
+  }
+}
+
+void ExpectConsistent(const RobustEstimationStatistics &statistics,
+                      double inlier_ratio) {
+  EXPECT_GT(statistics.iterations, 0);
+  EXPECT_GE(statistics.num_hypotheses, statistics.iterations);
+  EXPECT_LE(statistics.num_pre_verification_rejections +
+            statistics.num_cost_rejections, statistics.num_hypotheses);
+  ASSERT_EQ(statistics.improvement_iterations.size(),
+            statistics.improvement_inlier_ratios.size());
+  ASSERT_GT(statistics.improvement_iterations.size(), 0);
+  for (int i = 1; i < statistics.improvement_iterations.size(); ++i) {
+    EXPECT_LE(statistics.improvement_iterations[i - 1],
+              statistics.improvement_iterations[i]);
+  }
+  EXPECT_DOUBLE_EQ(inlier_ratio, statistics.inlier_ratio);
+  EXPECT_GE(statistics.seconds, 0);
+}
+
+TEST(RobustLineFitterStatistics, AllEstimators) {
+  // y = -x + 3, with 40% of gross outliers.
+  const int n = 100;
+  Mat2X xy(2, n);
+  srand(5);
+  for (int i = 0; i < n; ++i) {
+    xy(0, i) = i;
+    xy(1, i) = (i % 5 < 2) ? 1000 + (rand() % 1000) : -i + 3;
+  }
+  LineKernel kernel(xy);
+  MLEScorer<LineKernel> scorer(0.5);
+  RobustEstimationOptions options;
+  RobustEstimationStatistics statistics;
+
+  EstimateFast(kernel, scorer, options, NULL, NULL, &statistics);
+  ExpectConsistent(statistics, 0.6);
+
+  options.pre_verification_samples = 2;
+  EstimateFast(kernel, scorer, options, NULL, NULL, &statistics);
+  ExpectConsistent(statistics, 0.6);
+  EXPECT_GT(statistics.num_pre_verification_rejections, 0);
+
+  EstimateParallel(kernel, scorer, options, 3, NULL, NULL, &statistics);
+  ExpectConsistent(statistics, 0.6);
+  EXPECT_GT(statistics.num_pre_verification_rejections, 0);
+
+  bool warm_started;
+  EstimateWarmStart(kernel, scorer, options, Vec2(3.0, -1.0), NULL, NULL,
+                    &warm_started, &statistics);
+  EXPECT_TRUE(warm_started);
+  EXPECT_EQ(options.warm_start_iterations, statistics.iterations);
+  EXPECT_DOUBLE_EQ(0.6, statistics.inlier_ratio);
+
+  // The fallback counts the iterations of both steps.
+  EstimateWarmStart(kernel, scorer, options, Vec2(0.0, 1.0), NULL, NULL,
+                    &warm_started, &statistics);
+  EXPECT_FALSE(warm_started);
+  ExpectConsistent(statistics, 0.6);
+}
+
+TEST(RobustLineFitterParallel, SameSeedSameResult) {
+  const int n = 50;
+  Mat2X xy(2, n);
+  for (int i = 0; i < n; ++i) {
+    xy(0, i) = i;
+    xy(1, i) = 0.5 * i + (i % 7) * 0.01;
+  }
+  LineKernel kernel(xy);
+  Vec2 first, second;
+  srand(3);
+  first = EstimateParallel(kernel, MLEScorer<LineKernel>(0.5),
+                           RobustEstimationOptions(), 3);
+  srand(3);
+  second = EstimateParallel(kernel, MLEScorer<LineKernel>(0.5),
+                            RobustEstimationOptions(), 3);
+  EXPECT_EQ(first, second);
+}
+
+TEST(RobustLineFitterParallel, TooFewPoints) {
+  Mat2X xy(2, 1);
+  xy << 1,
+        3;
+  LineKernel kernel(xy);
+  vector<int> inliers(3);
+  double score = 0;
+  EstimateParallel(kernel, MLEScorer<LineKernel>(4),
+                   RobustEstimationOptions(), 4, &inliers, &score);
+  ASSERT_EQ(0, inliers.size());
+  EXPECT_EQ(HUGE_VAL, score);
+}
+
+TEST(StreamSamplerTest, NoRepetitions) {
+  StreamSampler sampler(42);
+  vector<int> samples;
+  for (int total = 1; total < 500; total *= 2) {
+    for (int num_samples = 1; num_samples <= total; num_samples *= 2) {
+      sampler.Sample(num_samples, total, &samples);
+      ASSERT_EQ(num_samples, samples.size());
+      std::vector<bool> in_set(total, false);
+      for (int i = 0; i < num_samples; ++i) {
+        ASSERT_LT(samples[i], total);
+        EXPECT_FALSE(in_set[samples[i]]);
+        in_set[samples[i]] = true;
+      }
+    }
+  }
+}
+
+TEST(RandomGeneratorTest, SeedsAndStreamsGiveIndependentSequences) {
+  RandomGenerator a(7), b(7), c(8), d(7, 1);
+  int same_seed = 0, other_seed = 0, other_stream = 0;
+  for (int i = 0; i < 100; ++i) {
+    unsigned int x = a.Next();
+    same_seed += x == b.Next();
+    other_seed += x == c.Next();
+    other_stream += x == d.Next();
+  }
+  EXPECT_EQ(100, same_seed);
+  EXPECT_EQ(0, other_seed);
+  EXPECT_EQ(0, other_stream);
+
+  // Uniform() covers [0, n) evenly.
+  std::vector<int> counts(10, 0);
+  for (int i = 0; i < 10000; ++i) {
+    int x = a.Uniform(10);
+    ASSERT_GE(x, 0);
+    ASSERT_LT(x, 10);
+    counts[x]++;
+  }
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_NEAR(1000, counts[i], 150);
+  }
+}
+
+TEST(FloydSampleTest, DrawsEverySubsetInEveryOrder) {
+  // The 6 ordered pairs of 3 samples are equally likely.
+  RandomGenerator generator(1);
+  std::vector<int> counts(9, 0);
+  vector<int> samples;
+  for (int i = 0; i < 6000; ++i) {
+    FloydSample(2, 3, &generator, &samples);
+    ASSERT_EQ(2, samples.size());
+    ASSERT_NE(samples[0], samples[1]);
+    counts[samples[0] * 3 + samples[1]]++;
+  }
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      if (i != j) {
+        EXPECT_NEAR(1000, counts[i * 3 + j], 150);
+      }
+    }
+  }
+}
+
+TEST(RobustLineFitterFast, SeedIgnoresRand) {
+  // y = -x + 3, with 40% of gross outliers, and a few inliers off the line
+  // so that the result depends on the drawn subsets.
+  const int n = 100;
+  Mat2X xy(2, n);
+  srand(5);
+  for (int i = 0; i < n; ++i) {
+    xy(0, i) = i;
+    xy(1, i) = (i % 5 < 2) ? 1000 + (rand() % 1000) : -i + 3 + 0.1 * (i % 3);
+  }
+  LineKernel kernel(xy);
+  MLEScorer<LineKernel> scorer(0.5);
+  RobustEstimationOptions options;
+  options.seed = 11;
+  options.local_optimization_iterations = 5;
+  srand(1);
+  Vec2 first = EstimateFast(kernel, scorer, options);
+  srand(2);
+  Vec2 second = EstimateFast(kernel, scorer, options);
+  EXPECT_EQ(first, second);
+  for (int num_threads = 2; num_threads <= 3; ++num_threads) {
+    srand(1);
+    first = EstimateParallel(kernel, scorer, options, num_threads);
+    srand(2);
+    second = EstimateParallel(kernel, scorer, options, num_threads);
+    EXPECT_EQ(first, second);
+  }
+}
+
+TEST(RobustLineFitterFast, TooFewPoints) {
+  Mat2X xy(2, 1);
+  xy << 1,
+        3;
+  LineKernel kernel(xy);
+  vector<int> inliers(3);
+  double score = 0;
+  EstimateFast(kernel, MLEScorer<LineKernel>(4), RobustEstimationOptions(),
+               &inliers, &score);
+  ASSERT_EQ(0, inliers.size());
+  EXPECT_EQ(HUGE_VAL, score);
+}
+
+// LineKernel with the batch entry point.
+struct BatchLineKernel : public LineKernel {
+  BatchLineKernel(const Mat2X &xs) : LineKernel(xs) {}
+  void Errors(const Model &model, int first, int count,
+              double *errors) const {
+    for (int i = 0; i < count; ++i) {
+      errors[i] = Error(first + i, model);
+    }
+  }
+};
+
+TEST(MLEScorer, UsesBatchErrorsWhenAvailable) {
+  EXPECT_FALSE(robust_estimation::HasErrors<LineKernel>::value);
+  EXPECT_TRUE(robust_estimation::HasErrors<BatchLineKernel>::value);
+
+  const int n = 1000;
+  Mat2X xy(2, n);
+  for (int i = 0; i < n; ++i) {
+    xy(0, i) = i;
+    xy(1, i) = (i % 3) ? 2 * i : 0;
+  }
+  LineKernel kernel(xy);
+  BatchLineKernel batch_kernel(xy);
+  MLEScorer<LineKernel> scorer(1);
+  MLEScorer<BatchLineKernel> batch_scorer(1);
+  Vec2 ba(0, 2);
+
+  // Non consecutive samples are split in several runs.
+  vector<int> samples;
+  for (int i = 0; i < n; ++i) {
+    if (i % 100 != 50) {
+      samples.push_back(i);
+    }
+  }
+  vector<int> inliers, batch_inliers;
+  EXPECT_EQ(scorer.Score(kernel, ba, samples, &inliers),
+            batch_scorer.Score(batch_kernel, ba, samples, &batch_inliers));
+  ASSERT_EQ(inliers.size(), batch_inliers.size());
+  for (int i = 0; i < inliers.size(); ++i) {
+    EXPECT_EQ(inliers[i], batch_inliers[i]);
+  }
+
+  for (double max_cost = 0.5; max_cost < 400; max_cost *= 3) {
+    inliers.resize(0);
+    batch_inliers.resize(0);
+    EXPECT_EQ(scorer.ScoreBounded(kernel, ba, samples, max_cost, &inliers),
+              batch_scorer.ScoreBounded(batch_kernel, ba, samples, max_cost,
+                                        &batch_inliers));
+    EXPECT_EQ(inliers.size(), batch_inliers.size());
+  }
+}
+
+TEST(MLEScorer, ScoreBoundedStopsAtMaxCost) {
+  Mat2X xy(2, 4);
+  xy << 0, 1, 2, 3,
+        0, 5, 0, 5;
+  LineKernel kernel(xy);
+  MLEScorer<LineKernel> scorer(1);
+  vector<int> samples, inliers;
+  for (int i = 0; i < 4; ++i) {
+    samples.push_back(i);
+  }
+  Vec2 ba(0, 0);
+  EXPECT_EQ(2.0, scorer.Score(kernel, ba, samples, &inliers));
+  EXPECT_EQ(2, inliers.size());
+  inliers.resize(0);
+  EXPECT_EQ(1.0, scorer.ScoreBounded(kernel, ba, samples, 0.5, &inliers));
+  EXPECT_EQ(1, inliers.size());
+  EXPECT_TRUE(scorer.IsInlier(kernel, ba, 0));
+  EXPECT_FALSE(scorer.IsInlier(kernel, ba, 1));
+}
+
+// LineKernel with a least squares refinement on the inliers.
+struct RefineLineKernel : public LineKernel {
+  RefineLineKernel(const Mat2X &xs) : LineKernel(xs), num_refinements(0) {}
+  void Refine(const vector<int> &inliers, Model *ba) const {
+    vector<Vec2> lines;
+    Fit(inliers, &lines);
+    *ba = lines[0];
+    ++num_refinements;
+  }
+  mutable int num_refinements;
+};
+
+TEST(RobustLineFitterFast, LocalOptimization) {
+  EXPECT_FALSE(robust_estimation::HasRefine<LineKernel>::value);
+  EXPECT_TRUE(robust_estimation::HasRefine<RefineLineKernel>::value);
+
+  // y = 2x + 1 with some noise, and 30% of gross outliers.
+  const int n = 200;
+  Mat2X xy(2, n);
+  srand(11);
+  for (int i = 0; i < n; ++i) {
+    xy(0, i) = i;
+    double noise = 0.2 * (rand() / double(RAND_MAX) - 0.5);
+    xy(1, i) = (i % 10 < 3) ? 1000 + (rand() % 1000) : 2 * i + 1 + noise;
+  }
+  MLEScorer<LineKernel> scorer(0.05);
+  MLEScorer<RefineLineKernel> refine_scorer(0.05);
+  LineKernel kernel(xy);
+  RefineLineKernel refine_kernel(xy);
+
+  RobustEstimationOptions options;
+  double cost;
+  srand(3);
+  EstimateFast(kernel, scorer, options, NULL, &cost);
+
+  options.local_optimization_iterations = 10;
+  double optimized_cost, refined_cost;
+  vector<int> inliers;
+  srand(3);
+  EstimateFast(kernel, scorer, options, NULL, &optimized_cost);
+  srand(3);
+  Vec2 ba = EstimateFast(refine_kernel, refine_scorer, options, &inliers,
+                         &refined_cost);
+  EXPECT_LE(optimized_cost, cost);
+  EXPECT_LE(refined_cost, optimized_cost);
+  EXPECT_LT(0, refine_kernel.num_refinements);
+  EXPECT_NEAR(2.0, ba[1], 1e-3);
+  EXPECT_NEAR(1.0, ba[0], 1e-1);
+  EXPECT_EQ(140, inliers.size());
+
+  // Same with the threads.
+  srand(3);
+  ba = EstimateParallel(refine_kernel, refine_scorer, options, 3, &inliers);
+  EXPECT_NEAR(2.0, ba[1], 1e-3);
+  EXPECT_EQ(140, inliers.size());
+}
+
+TEST(RobustLineFitterWarmStart, PriorHoldsOrNot) {
+  // y = 2x + 1 with 30% of gross outliers.
+  const int n = 100;
+  Mat2X xy(2, n);
+  for (int i = 0; i < n; ++i) {
+    xy(0, i) = i;
+    xy(1, i) = (i % 10 < 3) ? 1000 + i : 2 * i + 1;
+  }
+  LineKernel kernel(xy);
+  MLEScorer<LineKernel> scorer(0.01);
+  RobustEstimationOptions options;
+
+  // A slightly wrong prior is fixed by the fits on its inliers.
+  vector<int> inliers;
+  double score;
+  bool warm_started;
+  Vec2 ba = EstimateWarmStart(kernel, scorer, options, Vec2(1.0, 2.001),
+                              &inliers, &score, &warm_started);
+  EXPECT_TRUE(warm_started);
+  EXPECT_NEAR(2.0, ba[1], 1e-9);
+  EXPECT_NEAR(1.0, ba[0], 1e-9);
+  EXPECT_EQ(70, inliers.size());
+  EXPECT_NEAR(30 * 0.01, score, 1e-9);
+
+  // A wrong prior falls back to the full estimation.
+  ba = EstimateWarmStart(kernel, scorer, options, Vec2(0.0, -1.0),
+                         &inliers, &score, &warm_started);
+  EXPECT_FALSE(warm_started);
+  EXPECT_NEAR(2.0, ba[1], 1e-9);
+  EXPECT_NEAR(1.0, ba[0], 1e-9);
+  EXPECT_EQ(70, inliers.size());
+}
+
+TEST(RobustLineFitterDeadline, StopsAfterOneIterationOncePassed) {
+  // y = -x + 3, with 90% of gross outliers, which takes many iterations.
+  const int n = 100;
+  Mat2X xy(2, n);
+  srand(5);
+  for (int i = 0; i < n; ++i) {
+    xy(0, i) = i;
+    xy(1, i) = (i % 10 < 9) ? 1000 + (rand() % 1000) : -i + 3;
+  }
+  LineKernel kernel(xy);
+  MLEScorer<LineKernel> scorer(0.5);
+  RobustEstimationOptions options;
+  options.pre_verification_samples = 0;
+  // Any positive time in the past.
+  options.deadline = 1e-9;
+
+  RobustEstimationStatistics statistics;
+  EstimateFast(kernel, scorer, options, NULL, NULL, &statistics);
+  EXPECT_TRUE(statistics.deadline_reached);
+  EXPECT_EQ(1, statistics.iterations);
+
+  // A single round of a batch per thread.
+  EstimateParallel(kernel, scorer, options, 2, NULL, NULL, &statistics);
+  EXPECT_TRUE(statistics.deadline_reached);
+  EXPECT_LE(statistics.iterations, 32);
+
+  Estimate(kernel, scorer, NULL, NULL, 1e-2, &statistics, options.deadline);
+  EXPECT_TRUE(statistics.deadline_reached);
+  EXPECT_EQ(1, statistics.iterations);
+
+  // A deadline far away does not change the result.
+  options.deadline = DeadlineInSeconds(3600);
+  vector<int> inliers;
+  Vec2 ba = EstimateFast(kernel, scorer, options, &inliers, NULL,
+                         &statistics);
+  EXPECT_FALSE(statistics.deadline_reached);
+  EXPECT_NEAR(-1.0, ba[1], 1e-9);
+  EXPECT_NEAR(3.0, ba[0], 1e-9);
+  EXPECT_EQ(10, inliers.size());
+}
+
 }  // namespace
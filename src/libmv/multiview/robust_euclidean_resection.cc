@@ -24,29 +24,89 @@
 #include "libmv/numeric/numeric.h"
 
 namespace libmv {
+namespace {
+
+typedef euclidean_resection::kernel::P3PKernel Kernel;
+
+double EstimateResection(const Kernel &kernel,
+                         const Mat3X &X_world,
+                         double max_error,
+                         Mat3 *R, Vec3 *t,
+                         vector<int> *inliers,
+                         double outliers_probability,
+                         int num_threads) {
+  // The threshold is on the sum of the squared errors.
+  double threshold = Square(max_error);
+  double best_score = HUGE_VAL;
+  RobustEstimationOptions options;
+  options.outliers_probability = outliers_probability;
+  vector<int> local_inliers;
+  if (!inliers) {
+    inliers = &local_inliers;
+  }
+  MLEScorer<Kernel> scorer(threshold);
+  Mat34 P = EstimateParallel(kernel, scorer, options, num_threads, inliers,
+                             &best_score);
+  if (best_score == HUGE_VAL)
+    return HUGE_VAL;
+
+  *R = P.block<3, 3>(0, 0);
+  *t = P.col(3);
+  if (inliers->size() > 3) {
+    Mat3 R_refined;
+    Vec3 t_refined;
+    euclidean_resection::EuclideanResectionEPnP(
+        ExtractColumns(kernel.x_camera(), *inliers),
+        ExtractColumns(X_world, *inliers), &R_refined, &t_refined);
+
+    // Keep the refitted pose unless the inliers disagree with it.
+    Mat34 P_refined;
+    P_refined << R_refined, t_refined;
+    vector<int> samples(kernel.NumSamples()), refined_inliers;
+    for (int i = 0; i < samples.size(); ++i) {
+      samples[i] = i;
+    }
+    double refined_score = scorer.Score(kernel, P_refined, samples,
+                                        &refined_inliers);
+    if (refined_score <= best_score) {
+      *R = R_refined;
+      *t = t_refined;
+      *inliers = refined_inliers;
+      best_score = refined_score;
+    }
+  }
+  return std::sqrt(best_score / 2.0);  
+}
+
+}  // namespace
+
 // Estimate robustly the the extrinsic parameters, R and t for a calibrated
 // camera from 4 or more 3D points and their images.
-// The euclidean resection solver relies on the EPnP method.
+// The hypotheses come from the P3P solver; the EPnP method is only used to
+// refit the best hypothesis on its inliers.
 double EuclideanResectionEPnPRobust(const Mat2X &x_image, 
                                     const Mat3X &X_world,
                                     const Mat3  &K,
                                     double max_error,
                                     Mat3 *R, Vec3 *t,
                                     vector<int> *inliers,
-                                    double outliers_probability) {
-  // The threshold is on the sum of the squared errors.
-  double threshold = Square(max_error);
-  double best_score = HUGE_VAL;
-  typedef libmv::euclidean_resection::kernel::Kernel Kernel;
+                                    double outliers_probability,
+                                    int num_threads) {
   Kernel kernel(x_image, X_world, K);
-  Mat34 P = Estimate(kernel, MLEScorer<Kernel>(threshold), 
-                     inliers, &best_score, outliers_probability);
-  Mat3 K_unused;
-  KRt_From_P(P, &K_unused, R, t);
-  if (best_score == HUGE_VAL)
-    return HUGE_VAL;
-  else
-    return std::sqrt(best_score / 2.0);  
+  return EstimateResection(kernel, X_world, max_error, R, t, inliers,
+                           outliers_probability, num_threads);
+}
+
+double EuclideanResectionEPnPRobust(const Mat2X &x_camera,
+                                    const Mat3X &X_world,
+                                    double max_error,
+                                    Mat3 *R, Vec3 *t,
+                                    vector<int> *inliers,
+                                    double outliers_probability,
+                                    int num_threads) {
+  Kernel kernel(x_camera, X_world);
+  return EstimateResection(kernel, X_world, max_error, R, t, inliers,
+                           outliers_probability, num_threads);
 }
 
 }  // namespace libmv
@@ -28,7 +28,9 @@ namespace libmv {
 
 // Estimate robustly the the extrinsic parameters, R and t for a calibrated
 // camera from 4 or more 3D points and their images.
-// The euclidean resection solver relies on the EPnP method.
+// The hypotheses come from the P3P solver, and the best one is refitted on its
+// inliers with the EPnP method.
+// Hypotheses are scored with num_threads threads (see EstimateParallel()).
 // Returns the score associated to the solution (R,t)
 double EuclideanResectionEPnPRobust(const Mat2X &x_image, 
                                     const Mat3X &X_world,
@@ -36,7 +38,19 @@ double EuclideanResectionEPnPRobust(const Mat2X &x_image,
                                     double max_error,
                                     Mat3 *R, Vec3 *t,
                                     vector<int> *inliers = NULL,
-                                    double outliers_probability = 1e-2);
+                                    double outliers_probability = 1e-2,
+                                    int num_threads = 1);
+
+// Same as above from the normalized camera coordinates x_camera of the images
+// (e.g. precomputed by a ReconstructedTrackIndex), so that they are not
+// normalized again.
+double EuclideanResectionEPnPRobust(const Mat2X &x_camera,
+                                    const Mat3X &X_world,
+                                    double max_error,
+                                    Mat3 *R, Vec3 *t,
+                                    vector<int> *inliers = NULL,
+                                    double outliers_probability = 1e-2,
+                                    int num_threads = 1);
 
 } // namespace libmv
 
@@ -31,15 +31,18 @@ double FundamentalFromCorrespondences8PointRobust(const Mat &x1,
                                                   double max_error,
                                                   Mat3 *F,
                                                   vector<int> *inliers,
-                                                  double outliers_probability) {
+                                                  double outliers_probability,
+                                                  int num_threads) {
   // The threshold is on the sum of the squared errors in the two images.
   // Actually, Sampson's approximation of this error.
   double threshold = 2 * Square(max_error);
   double best_score = HUGE_VAL;
   typedef fundamental::kernel::NormalizedEightPointKernel Kernel;
   Kernel kernel(x1, x2);
-  *F = Estimate(kernel, MLEScorer<Kernel>(threshold), inliers, 
-                &best_score, outliers_probability);
+  RobustEstimationOptions options;
+  options.outliers_probability = outliers_probability;
+  *F = EstimateParallel(kernel, MLEScorer<Kernel>(threshold), options,
+                        num_threads, inliers, &best_score);
   if (best_score == HUGE_VAL)
     return HUGE_VAL;
   else
@@ -51,15 +54,18 @@ double FundamentalFromCorrespondences7PointRobust(const Mat &x1,
                                                   double max_error,
                                                   Mat3 * F,
                                                   vector<int> *inliers,
-                                                  double outliers_probability) {
+                                                  double outliers_probability,
+                                                  int num_threads) {
   // The threshold is on the sum of the squared errors in the two images.
   // Actually, Sampson's approximation of this error.
   double threshold = 2 * Square(max_error);
   double best_score = HUGE_VAL;
   typedef fundamental::kernel::NormalizedSevenPointKernel Kernel;
   Kernel kernel(x1, x2);
-  *F = Estimate(kernel, MLEScorer<Kernel>(threshold), inliers, 
-                &best_score, outliers_probability);
+  RobustEstimationOptions options;
+  options.outliers_probability = outliers_probability;
+  *F = EstimateParallel(kernel, MLEScorer<Kernel>(threshold), options,
+                        num_threads, inliers, &best_score);
   if (best_score == HUGE_VAL)
     return HUGE_VAL;
   else
@@ -28,6 +28,7 @@ namespace libmv {
 
 // Estimate robustly the fundamental matrix between two dataset of 2D point
 // (image coords space). The fundamental solver relies on the 8 point solution.
+// Hypotheses are scored with num_threads threads (see EstimateParallel()).
 // Returns the score associated to the solution F
 double FundamentalFromCorrespondences8PointRobust(
     const Mat &x1,
@@ -35,10 +36,12 @@ double FundamentalFromCorrespondences8PointRobust(
     double max_error,
     Mat3 *F,
     vector<int> *inliers = NULL,
-    double outliers_probability = 1e-2);
+    double outliers_probability = 1e-2,
+    int num_threads = 1);
 
 // Estimate robustly the fundamental matrix between two dataset of 2D point
 // (image coords space). The fundamental solver relies on the 7 point solution.
+// Hypotheses are scored with num_threads threads (see EstimateParallel()).
 // Returns the score associated to the solution F
 double FundamentalFromCorrespondences7PointRobust(
     const Mat &x1,
@@ -46,7 +49,8 @@ double FundamentalFromCorrespondences7PointRobust(
     double max_error,
     Mat3 * F,
     vector<int> *inliers = NULL,
-    double outliers_probability = 1e-2);
+    double outliers_probability = 1e-2,
+    int num_threads = 1);
 
 } // namespace libmv
 
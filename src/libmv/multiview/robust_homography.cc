@@ -32,18 +32,48 @@ double Homography2DFromCorrespondences4PointRobust(const Mat &x1,
                                                    double max_error,
                                                    Mat3 *H,
                                                    vector<int> *inliers,
-                                                   double outliers_probability) {
+                                                   double outliers_probability,
+                                                   int num_threads) {
   // The threshold is on the sum of the squared errors in the two images.
   double threshold = 2 * Square(max_error);
   double best_score = HUGE_VAL;
   typedef homography::homography2D::kernel::Kernel KernelH;
   KernelH kernel(x1, x2);
-  *H = Estimate(kernel, MLEScorer<KernelH>(threshold), inliers, 
-                &best_score, outliers_probability);
+  RobustEstimationOptions options;
+  options.outliers_probability = outliers_probability;
+  // LO-RANSAC: the new best models are refined on their inliers, which gives
+  // a stable H after far fewer samples.
+  options.local_optimization_iterations = 10;
+  *H = EstimateParallel(kernel, MLEScorer<KernelH>(threshold), options,
+                        num_threads, inliers, &best_score);
   if (best_score == HUGE_VAL)
     return HUGE_VAL;
   else
     return std::sqrt(best_score / 2.0);  
 }
 
+double Homography2DFromAffineFramesRobust(const Mat &x1,
+                                          const Mat &frames1,
+                                          const Mat &x2,
+                                          const Mat &frames2,
+                                          double max_error,
+                                          Mat3 *H,
+                                          vector<int> *inliers,
+                                          double outliers_probability,
+                                          int num_threads) {
+  double threshold = 2 * Square(max_error);
+  double best_score = HUGE_VAL;
+  typedef homography::homography2D::kernel::AffineFrameKernel KernelH;
+  KernelH kernel(x1, frames1, x2, frames2);
+  RobustEstimationOptions options;
+  options.outliers_probability = outliers_probability;
+  options.local_optimization_iterations = 10;
+  *H = EstimateParallel(kernel, MLEScorer<KernelH>(threshold), options,
+                        num_threads, inliers, &best_score);
+  if (best_score == HUGE_VAL)
+    return HUGE_VAL;
+  else
+    return std::sqrt(best_score / 2.0);
+}
+
 }  // namespace libmv
@@ -50,10 +50,14 @@ namespace libmv {
  * The number of iterations is controlled using the following equation:
  *    n_iter = log(outliers_prob) / log(1.0 - pow(inlier_ratio, min_samples)))
  * The more this value is high, the less the function selects ramdom samples.
+ * \param[in] num_threads number of threads generating and scoring hypotheses
+ *            (see EstimateParallel()).
  * 
  * \return the best error found (in pixels), associated to the solution H
  * 
  * \note The function needs at least 4 points 
+ * \note The new best models are locally optimized on their inliers
+ *       (LO-RANSAC, see RobustEstimationOptions)
  * \note The overall iteration limit is 1000
  */
 double Homography2DFromCorrespondences4PointRobust(
@@ -62,7 +66,36 @@ double Homography2DFromCorrespondences4PointRobust(
     double max_error,
     Mat3 *H,
     vector<int> *inliers = NULL,
-    double outliers_probability = 1e-2);
+    double outliers_probability = 1e-2,
+    int num_threads = 1);
+
+/** Robust 2D homography estimation from local affine frames
+ *
+ * Same as Homography2DFromCorrespondences4PointRobust(), for correspondences
+ * of local affine frames (see two_view::kernel::AffineFrameKernel): the
+ * hypotheses are fitted to 2 frame correspondences instead of 4 point
+ * correspondences, so far fewer samples are needed at low inlier ratios. The
+ * errors are the ones of the centers of the frames.
+ *
+ * \param[in] x1 The first 2xN matrix of euclidean points, the frame centers
+ * \param[in] frames1 The 4xN matrix of the frames in the first image: column
+ *                    i is the column major 2x2 matrix mapping the unit disc
+ *                    to the region around x1(:, i)
+ * \param[in] x2 The second 2xN matrix of euclidean points
+ * \param[in] frames2 The 4xN matrix of the frames in the second image
+ *
+ * \note The function needs at least 2 frames
+ */
+double Homography2DFromAffineFramesRobust(
+    const Mat &x1,
+    const Mat &frames1,
+    const Mat &x2,
+    const Mat &frames2,
+    double max_error,
+    Mat3 *H,
+    vector<int> *inliers = NULL,
+    double outliers_probability = 1e-2,
+    int num_threads = 1);
 
 } // namespace libmv
 
@@ -18,6 +18,9 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <cmath>
+#include <vector>
+
 #include "libmv/base/vector.h"
 #include "libmv/logging/logging.h"
 #include "libmv/multiview/robust_homography.h"
@@ -72,4 +75,98 @@ TEST(RobustHomography, Homography2DFromCorrespondences4PointRobust) {
   EXPECT_MATRIX_NEAR(H_gt[2], H[2], 1e-8);
 }
 
+TEST(RobustHomography, ParallelWithOutliers) {
+  Mat3 H_gt;
+  H_gt << 1, -2,  3,
+          4,  5, -6,
+         -7,  8,  1;
+  int n = 40;
+  Mat x(2, n), xh;
+  for (int i = 0; i < n; ++i) {
+    x(0, i) = i % 8;
+    x(1, i) = i / 8;
+  }
+  EuclideanToHomogeneous(x, &xh);
+  Mat y;
+  HomogeneousToEuclidean(H_gt * xh, &y);
+  // The first 10 points are outliers.
+  for (int j = 0; j < 10; ++j) {
+    y(0, j) += 3 + j;
+    y(1, j) -= 7;
+  }
+
+  srand(1);
+  Mat3 H;
+  vector<int> inliers;
+  Homography2DFromCorrespondences4PointRobust(x, y, 0.1, &H, &inliers,
+                                              1e-2, 4);
+  H /= H(2, 2);
+  EXPECT_MATRIX_NEAR(H_gt, H, 1e-8);
+  ASSERT_EQ(n - 10, inliers.size());
+  for (int i = 0; i < inliers.size(); ++i) {
+    EXPECT_EQ(10 + i, inliers[i]);
+  }
+}
+
+// Frames mapped by the local affine approximation of H at their centers.
+void MapFrames(const Mat3 &H, const Mat &x1, const Mat &frames1,
+               Mat *x2, Mat *frames2) {
+  x2->resize(2, x1.cols());
+  frames2->resize(4, x1.cols());
+  for (int i = 0; i < x1.cols(); ++i) {
+    Vec3 y = H * Vec3(x1(0, i), x1(1, i), 1);
+    Vec2 y2 = y.head<2>() / y(2);
+    Mat2 J = (H.block<2, 2>(0, 0) - y2 * H.block<1, 2>(2, 0)) / y(2);
+    Mat2 A;
+    A << frames1(0, i), frames1(2, i),
+         frames1(1, i), frames1(3, i);
+    Mat2 A2 = J * A;
+    x2->col(i) = y2;
+    (*frames2)(0, i) = A2(0, 0);
+    (*frames2)(1, i) = A2(1, 0);
+    (*frames2)(2, i) = A2(0, 1);
+    (*frames2)(3, i) = A2(1, 1);
+  }
+}
+
+TEST(RobustHomography, Homography2DFromAffineFramesRobust) {
+  Mat3 H_gt;
+  H_gt << 1.1,  0.05,  10,
+          0.02, 0.95,  -5,
+          1e-4, 2e-4,   1;
+  int n = 50, num_outliers = 30;
+  Mat x1(2, n), frames1(4, n);
+  for (int i = 0; i < n; ++i) {
+    x1(0, i) = 20 + 37 * (i % 10);
+    x1(1, i) = 15 + 53 * (i / 10) + 3 * (i % 3);
+    // Similarity frames, as from the scale and orientation of features.
+    double scale = 2 + i % 4, angle = 0.7 * i;
+    frames1.col(i) << scale * cos(angle), scale * sin(angle),
+                      -scale * sin(angle), scale * cos(angle);
+  }
+  Mat x2, frames2;
+  MapFrames(H_gt, x1, frames1, &x2, &frames2);
+  std::vector<bool> is_outlier(n, false);
+  for (int i = 0; i < num_outliers; ++i) {
+    x2(0, 3 * i % n) += 25 + 7 * i;
+    x2(1, 3 * i % n) -= 40 - 3 * i;
+    is_outlier[3 * i % n] = true;
+  }
+
+  Mat3 H;
+  vector<int> inliers;
+  Homography2DFromAffineFramesRobust(x1, frames1, x2, frames2, 0.1, &H,
+                                     &inliers);
+  EXPECT_EQ(n - num_outliers, inliers.size());
+  for (int i = 0; i < inliers.size(); ++i) {
+    EXPECT_FALSE(is_outlier[inliers[i]]);
+  }
+  for (int i = 0; i < n; ++i) {
+    Vec3 y = H * Vec3(x1(0, i), x1(1, i), 1);
+    Vec3 y_gt = H_gt * Vec3(x1(0, i), x1(1, i), 1);
+    EXPECT_NEAR(0, (y.head<2>() / y(2) - y_gt.head<2>() / y_gt(2)).norm(),
+                1e-3);
+  }
+}
+
 }  // namespace
@@ -0,0 +1,542 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cmath>
+
+#include "libmv/base/thread.h"
+#include "libmv/multiview/affine_kernel.h"
+#include "libmv/multiview/euclidean_kernel.h"
+#include "libmv/multiview/homography_kernel.h"
+#include "libmv/multiview/robust_estimation.h"
+#include "libmv/multiview/random_sample.h"
+#include "libmv/multiview/robust_motion2d.h"
+#include "libmv/multiview/similarity_kernel.h"
+#include "libmv/numeric/numeric.h"
+
+namespace libmv {
+namespace {
+
+template<typename Kernel>
+double EstimateMotion(const Mat &x1,
+                      const Mat &x2,
+                      double max_error,
+                      double outliers_probability,
+                      const Mat3 *prior,
+                      Mat3 *H,
+                      vector<int> *inliers,
+                      bool *warm_started) {
+  // The threshold is on the sum of the squared errors in the two images.
+  double threshold = 2 * Square(max_error);
+  double best_score = HUGE_VAL;
+  Kernel kernel(x1, x2);
+  RobustEstimationOptions options;
+  options.outliers_probability = outliers_probability;
+  *warm_started = false;
+  if (prior) {
+    *H = EstimateWarmStart(kernel, MLEScorer<Kernel>(threshold), options,
+                           *prior, inliers, &best_score, warm_started);
+  } else {
+    *H = EstimateFast(kernel, MLEScorer<Kernel>(threshold), options,
+                      inliers, &best_score);
+  }
+  if (best_score == HUGE_VAL)
+    return HUGE_VAL;
+  else
+    return std::sqrt(best_score / 2.0);
+}
+
+}  // namespace
+
+Motion2DEstimator::Motion2DEstimator(MotionModel model,
+                                     double max_error,
+                                     double outliers_probability)
+    : model_(model),
+      max_error_(max_error),
+      outliers_probability_(outliers_probability),
+      has_prior_(false),
+      warm_started_(false) {
+}
+
+double Motion2DEstimator::Estimate(const Mat &x1,
+                                   const Mat &x2,
+                                   Mat3 *H,
+                                   vector<int> *inliers) {
+  warm_started_ = false;
+  if (x1.cols() < MinimumSamples()) {
+    Reset();
+    if (inliers)
+      inliers->resize(0);
+    return HUGE_VAL;
+  }
+  const Mat3 *prior = has_prior_ ? &prior_ : NULL;
+  double error = HUGE_VAL;
+  switch (model_) {
+    case EUCLIDEAN:
+      error = EstimateMotion<euclidean::euclidean2D::kernel::Kernel>(
+          x1, x2, max_error_, outliers_probability_, prior, H, inliers,
+          &warm_started_);
+      break;
+    case SIMILARITY:
+      error = EstimateMotion<similarity::similarity2D::kernel::Kernel>(
+          x1, x2, max_error_, outliers_probability_, prior, H, inliers,
+          &warm_started_);
+      break;
+    case AFFINE:
+      error = EstimateMotion<affine::affine2D::kernel::Kernel>(
+          x1, x2, max_error_, outliers_probability_, prior, H, inliers,
+          &warm_started_);
+      break;
+    case HOMOGRAPHY:
+      error = EstimateMotion<homography::homography2D::kernel::Kernel>(
+          x1, x2, max_error_, outliers_probability_, prior, H, inliers,
+          &warm_started_);
+      break;
+  }
+  has_prior_ = error != HUGE_VAL;
+  if (has_prior_) {
+    prior_ = *H;
+  }
+  return error;
+}
+
+void Motion2DEstimator::Reset() {
+  has_prior_ = false;
+}
+
+int Motion2DEstimator::MinimumSamples() const {
+  switch (model_) {
+    case EUCLIDEAN:
+    case SIMILARITY:
+      return 2;
+    case AFFINE:
+      return 3;
+    case HOMOGRAPHY:
+      return 4;
+  }
+  return 4;
+}
+
+namespace {
+
+// The problems estimated together by EstimateMotion2DBatch().
+const int kLanes = 4;
+
+// Below this, a minimal sample is degenerate. The points are normalized.
+const double kDegenerate = 1e-10;
+
+int MinimumSamples(Motion2DEstimator::MotionModel model) {
+  return Motion2DEstimator(model, 1.0).MinimumSamples();
+}
+
+// The points of kLanes problems, with the j-th point of lane l at
+// j * kLanes + l. The points of each problem are centered in each frame and
+// scaled by the same factor in both frames, so that the motion keeps its
+// type; num_points[l] is 0 for the lanes without a problem.
+struct ProblemGroup {
+  int problems[kLanes];
+  int num_points[kLanes];
+  int max_points;
+  double scale[kLanes];
+  Vec2 center1[kLanes], center2[kLanes];
+  std::vector<double> x1, y1, x2, y2;
+  // 1 for the points of the problems, 0 for the padding.
+  std::vector<double> mask;
+};
+
+// The k-th point of the minimal sample of every lane.
+struct MinimalSamples {
+  double x1[4][kLanes], y1[4][kLanes], x2[4][kLanes], y2[4][kLanes];
+};
+
+// One model per lane; h[r * 3 + c][l] is H(r, c) of lane l.
+struct Models {
+  double h[9][kLanes];
+  bool valid[kLanes];
+};
+
+// x2 = s R x1 + t, or x2 = R x1 + t if rigid, from the first two points. The
+// rotation of the rigid motion is the one of the similarity, and its
+// translation aligns the centers of the two points.
+void FitSimilarities(const MinimalSamples &s, bool rigid, Models *m) {
+  for (int l = 0; l < kLanes; ++l) {
+    double d1x = s.x1[1][l] - s.x1[0][l], d1y = s.y1[1][l] - s.y1[0][l];
+    double d2x = s.x2[1][l] - s.x2[0][l], d2y = s.y2[1][l] - s.y2[0][l];
+    double a = d1x * d2x + d1y * d2y;
+    double b = d1x * d2y - d1y * d2x;
+    double n = rigid ? std::sqrt(a * a + b * b) : d1x * d1x + d1y * d1y;
+    m->valid[l] = n > kDegenerate;
+    a /= n;
+    b /= n;
+    double c1x = 0.5 * (s.x1[0][l] + s.x1[1][l]);
+    double c1y = 0.5 * (s.y1[0][l] + s.y1[1][l]);
+    double c2x = 0.5 * (s.x2[0][l] + s.x2[1][l]);
+    double c2y = 0.5 * (s.y2[0][l] + s.y2[1][l]);
+    m->h[0][l] = a;  m->h[1][l] = -b;  m->h[2][l] = c2x - a * c1x + b * c1y;
+    m->h[3][l] = b;  m->h[4][l] =  a;  m->h[5][l] = c2y - b * c1x - a * c1y;
+    m->h[6][l] = 0;  m->h[7][l] =  0;  m->h[8][l] = 1;
+  }
+}
+
+// x2 = A x1 + t from the first three points: A maps the edges of the first
+// triangle to the ones of the second.
+void FitAffinities(const MinimalSamples &s, Models *m) {
+  for (int l = 0; l < kLanes; ++l) {
+    double e1x = s.x1[1][l] - s.x1[0][l], e1y = s.y1[1][l] - s.y1[0][l];
+    double f1x = s.x1[2][l] - s.x1[0][l], f1y = s.y1[2][l] - s.y1[0][l];
+    double e2x = s.x2[1][l] - s.x2[0][l], e2y = s.y2[1][l] - s.y2[0][l];
+    double f2x = s.x2[2][l] - s.x2[0][l], f2y = s.y2[2][l] - s.y2[0][l];
+    double det = e1x * f1y - f1x * e1y;
+    m->valid[l] = std::abs(det) > kDegenerate;
+    // A = [e2 f2] * inverse([e1 f1]).
+    double a = (e2x * f1y - f2x * e1y) / det;
+    double b = (f2x * e1x - e2x * f1x) / det;
+    double c = (e2y * f1y - f2y * e1y) / det;
+    double d = (f2y * e1x - e2y * f1x) / det;
+    m->h[0][l] = a;  m->h[1][l] = b;  m->h[2][l] = s.x2[0][l] - a * s.x1[0][l]
+                                                   - b * s.y1[0][l];
+    m->h[3][l] = c;  m->h[4][l] = d;  m->h[5][l] = s.y2[0][l] - c * s.x1[0][l]
+                                                   - d * s.y1[0][l];
+    m->h[6][l] = 0;  m->h[7][l] = 0;  m->h[8][l] = 1;
+  }
+}
+
+// The homography M mapping the corners (0,0), (1,0), (1,1) and (0,1) of the
+// unit square to the four points (Heckbert, "Fundamentals of Texture Mapping
+// and Image Warping", 1989). Returns the denominator, 0 when three of the
+// points are aligned.
+inline double SquareToQuad(const double x[4], const double y[4], double M[9]) {
+  double sx = x[0] - x[1] + x[2] - x[3];
+  double sy = y[0] - y[1] + y[2] - y[3];
+  double dx1 = x[1] - x[2], dx2 = x[3] - x[2];
+  double dy1 = y[1] - y[2], dy2 = y[3] - y[2];
+  double den = dx1 * dy2 - dx2 * dy1;
+  double g = (sx * dy2 - dx2 * sy) / den;
+  double h = (dx1 * sy - sx * dy1) / den;
+  M[0] = x[1] - x[0] + g * x[1];  M[1] = x[3] - x[0] + h * x[3];  M[2] = x[0];
+  M[3] = y[1] - y[0] + g * y[1];  M[4] = y[3] - y[0] + h * y[3];  M[5] = y[0];
+  M[6] = g;                       M[7] = h;                       M[8] = 1;
+  return den;
+}
+
+// x2 = H x1 from the four points, as H = M2 * inverse(M1) where M1 and M2 map
+// the unit square to the points of each frame. The adjugate of M1 replaces
+// its inverse, since the scale of H does not matter.
+void FitHomographies(const MinimalSamples &s, Models *m) {
+  for (int l = 0; l < kLanes; ++l) {
+    double x1[4], y1[4], x2[4], y2[4];
+    for (int k = 0; k < 4; ++k) {
+      x1[k] = s.x1[k][l];  y1[k] = s.y1[k][l];
+      x2[k] = s.x2[k][l];  y2[k] = s.y2[k][l];
+    }
+    double M1[9], M2[9];
+    double den1 = SquareToQuad(x1, y1, M1);
+    double den2 = SquareToQuad(x2, y2, M2);
+    double A[9];
+    A[0] = M1[4] * M1[8] - M1[5] * M1[7];
+    A[1] = M1[2] * M1[7] - M1[1] * M1[8];
+    A[2] = M1[1] * M1[5] - M1[2] * M1[4];
+    A[3] = M1[5] * M1[6] - M1[3] * M1[8];
+    A[4] = M1[0] * M1[8] - M1[2] * M1[6];
+    A[5] = M1[2] * M1[3] - M1[0] * M1[5];
+    A[6] = M1[3] * M1[7] - M1[4] * M1[6];
+    A[7] = M1[1] * M1[6] - M1[0] * M1[7];
+    A[8] = M1[0] * M1[4] - M1[1] * M1[3];
+    double det1 = M1[0] * A[0] + M1[1] * A[3] + M1[2] * A[6];
+    m->valid[l] = std::abs(den1) > kDegenerate &&
+                  std::abs(den2) > kDegenerate &&
+                  std::abs(det1) > kDegenerate;
+    for (int r = 0; r < 3; ++r) {
+      for (int c = 0; c < 3; ++c) {
+        m->h[r * 3 + c][l] = M2[r * 3 + 0] * A[0 * 3 + c] +
+                             M2[r * 3 + 1] * A[1 * 3 + c] +
+                             M2[r * 3 + 2] * A[2 * 3 + c];
+      }
+    }
+  }
+}
+
+// The squared error of AsymmetricError of the j-th point of lane l.
+inline double Error(const ProblemGroup &group, const Models &m,
+                    int j, int l) {
+  int i = j * kLanes + l;
+  double x = group.x1[i], y = group.y1[i];
+  double w = m.h[6][l] * x + m.h[7][l] * y + m.h[8][l];
+  double u = (m.h[0][l] * x + m.h[1][l] * y + m.h[2][l]) / w - group.x2[i];
+  double v = (m.h[3][l] * x + m.h[4][l] * y + m.h[5][l]) / w - group.y2[i];
+  return u * u + v * v;
+}
+
+// The MLEScorer costs and the inlier counts of the models of every lane. An
+// error which is not a number counts as an outlier.
+void Score(const ProblemGroup &group, const Models &m,
+           const double thresholds[kLanes],
+           double costs[kLanes], double num_inliers[kLanes]) {
+  for (int l = 0; l < kLanes; ++l) {
+    costs[l] = 0;
+    num_inliers[l] = 0;
+  }
+  for (int j = 0; j < group.max_points; ++j) {
+    const double *mask = &group.mask[j * kLanes];
+    for (int l = 0; l < kLanes; ++l) {
+      double error = Error(group, m, j, l);
+      bool inlier = error < thresholds[l];
+      costs[l] += mask[l] * (inlier ? error : thresholds[l]);
+      num_inliers[l] += mask[l] * (inlier ? 1.0 : 0.0);
+    }
+  }
+}
+
+// Stores the normalized points of the problems in group.
+void MakeGroup(const vector<Mat> &x1s,
+               const vector<Mat> &x2s,
+               const int problems[kLanes],
+               ProblemGroup *group) {
+  group->max_points = 0;
+  for (int l = 0; l < kLanes; ++l) {
+    group->problems[l] = problems[l];
+    group->num_points[l] = problems[l] < 0 ? 0 : x1s[problems[l]].cols();
+    group->max_points = std::max(group->max_points, group->num_points[l]);
+  }
+  int size = group->max_points * kLanes;
+  group->x1.assign(size, 0.0);
+  group->y1.assign(size, 0.0);
+  group->x2.assign(size, 0.0);
+  group->y2.assign(size, 0.0);
+  group->mask.assign(size, 0.0);
+  for (int l = 0; l < kLanes; ++l) {
+    int n = group->num_points[l];
+    group->scale[l] = 1.0;
+    group->center1[l].setZero();
+    group->center2[l].setZero();
+    if (n == 0) {
+      continue;
+    }
+    const Mat &x1 = x1s[problems[l]];
+    const Mat &x2 = x2s[problems[l]];
+    group->center1[l] = x1.block(0, 0, 2, n).rowwise().mean();
+    group->center2[l] = x2.block(0, 0, 2, n).rowwise().mean();
+    double distance = 0;
+    for (int j = 0; j < n; ++j) {
+      distance += (x1.block<2, 1>(0, j) - group->center1[l]).norm() +
+                  (x2.block<2, 1>(0, j) - group->center2[l]).norm();
+    }
+    distance /= 2 * n;
+    if (distance > 0) {
+      group->scale[l] = std::sqrt(2.0) / distance;
+    }
+    double s = group->scale[l];
+    for (int j = 0; j < n; ++j) {
+      int i = j * kLanes + l;
+      group->x1[i] = s * (x1(0, j) - group->center1[l](0));
+      group->y1[i] = s * (x1(1, j) - group->center1[l](1));
+      group->x2[i] = s * (x2(0, j) - group->center2[l](0));
+      group->y2[i] = s * (x2(1, j) - group->center2[l](1));
+      group->mask[i] = 1.0;
+    }
+  }
+}
+
+// Estimates the problems of one group per call.
+struct GroupEstimator {
+  void operator()(int g) const {
+    int problems[kLanes];
+    for (int l = 0; l < kLanes; ++l) {
+      int k = g * kLanes + l;
+      problems[l] = k < int(order->size()) ? (*order)[k] : -1;
+    }
+    ProblemGroup group;
+    MakeGroup(*x1s, *x2s, problems, &group);
+    const int min_samples = MinimumSamples(model);
+
+    // The threshold is on the sum of the squared errors in the two images,
+    // as in Motion2DEstimator; the errors are in the second frame.
+    double thresholds[kLanes], best_costs[kLanes];
+    size_t required_iterations[kLanes];
+    for (int l = 0; l < kLanes; ++l) {
+      thresholds[l] = 2 * Square(max_error * group.scale[l]);
+      best_costs[l] = HUGE_VAL;
+      required_iterations[l] =
+          group.num_points[l] >= min_samples ? max_iterations : 0;
+    }
+
+    StreamSampler sampler(g);
+    vector<int> sample;
+    MinimalSamples samples;
+    Models models, best_models;
+    double costs[kLanes], num_inliers[kLanes];
+    for (size_t iteration = 0; ; ++iteration) {
+      bool running[kLanes], any_running = false;
+      for (int l = 0; l < kLanes; ++l) {
+        running[l] = iteration < required_iterations[l];
+        any_running = any_running || running[l];
+      }
+      if (!any_running) {
+        break;
+      }
+      // The lanes which are done fit on their first point, and are ignored.
+      for (int l = 0; l < kLanes; ++l) {
+        if (running[l]) {
+          sampler.Sample(min_samples, group.num_points[l], &sample);
+        } else {
+          sample.resize(min_samples);
+          std::fill(sample.begin(), sample.end(), 0);
+        }
+        for (int k = 0; k < min_samples; ++k) {
+          int i = sample[k] * kLanes + l;
+          samples.x1[k][l] = group.x1[i];
+          samples.y1[k][l] = group.y1[i];
+          samples.x2[k][l] = group.x2[i];
+          samples.y2[k][l] = group.y2[i];
+        }
+      }
+      switch (model) {
+        case Motion2DEstimator::EUCLIDEAN:
+          FitSimilarities(samples, true, &models);
+          break;
+        case Motion2DEstimator::SIMILARITY:
+          FitSimilarities(samples, false, &models);
+          break;
+        case Motion2DEstimator::AFFINE:
+          FitAffinities(samples, &models);
+          break;
+        case Motion2DEstimator::HOMOGRAPHY:
+          FitHomographies(samples, &models);
+          break;
+      }
+      Score(group, models, thresholds, costs, num_inliers);
+      for (int l = 0; l < kLanes; ++l) {
+        if (!running[l] || !models.valid[l] || !(costs[l] < best_costs[l])) {
+          continue;
+        }
+        best_costs[l] = costs[l];
+        for (int k = 0; k < 9; ++k) {
+          best_models.h[k][l] = models.h[k][l];
+        }
+        double inlier_ratio = num_inliers[l] / group.num_points[l];
+        required_iterations[l] = robust_estimation::IterationsRequired(
+            min_samples, outliers_probability, inlier_ratio, max_iterations);
+      }
+    }
+
+    for (int l = 0; l < kLanes; ++l) {
+      if (problems[l] < 0) {
+        continue;
+      }
+      int problem = problems[l];
+      Mat3 &H = (*Hs)[problem];
+      H.setIdentity();
+      (*errors)[problem] = HUGE_VAL;
+      if (inliers) {
+        (*inliers)[problem].resize(0);
+      }
+      if (best_costs[l] == HUGE_VAL) {
+        continue;
+      }
+      Mat3 Hn, T1, T2inv;
+      for (int k = 0; k < 9; ++k) {
+        Hn(k / 3, k % 3) = best_models.h[k][l];
+      }
+      double s = group.scale[l];
+      T1 << s, 0, -s * group.center1[l](0),
+            0, s, -s * group.center1[l](1),
+            0, 0, 1;
+      T2inv << 1 / s, 0, group.center2[l](0),
+               0, 1 / s, group.center2[l](1),
+               0, 0, 1;
+      H = T2inv * Hn * T1;
+      H /= H(2, 2);
+      (*errors)[problem] = std::sqrt(best_costs[l] / Square(s) / 2.0);
+      if (inliers) {
+        for (int j = 0; j < group.num_points[l]; ++j) {
+          if (Error(group, best_models, j, l) < thresholds[l]) {
+            (*inliers)[problem].push_back(j);
+          }
+        }
+      }
+    }
+  }
+
+  const vector<Mat> *x1s, *x2s;
+  const std::vector<int> *order;
+  Motion2DEstimator::MotionModel model;
+  double max_error;
+  double outliers_probability;
+  size_t max_iterations;
+  vector<Mat3> *Hs;
+  vector<double> *errors;
+  std::vector<vector<int> > *inliers;
+};
+
+struct FewerPoints {
+  bool operator()(int a, int b) const {
+    return (*x1s)[a].cols() < (*x1s)[b].cols();
+  }
+  const vector<Mat> *x1s;
+};
+
+}  // namespace
+
+void EstimateMotion2DBatch(const vector<Mat> &x1s,
+                           const vector<Mat> &x2s,
+                           Motion2DEstimator::MotionModel model,
+                           double max_error,
+                           double outliers_probability,
+                           vector<Mat3> *Hs,
+                           vector<double> *errors,
+                           std::vector<vector<int> > *inliers,
+                           int num_threads) {
+  CHECK(x1s.size() == x2s.size());
+  CHECK(outliers_probability < 1.0);
+  CHECK(outliers_probability > 0.0);
+  int num_problems = x1s.size();
+  Hs->resize(num_problems);
+  errors->resize(num_problems);
+  if (inliers) {
+    inliers->resize(num_problems);
+  }
+
+  // The problems of a group run as many iterations as the slowest one, and
+  // are scored on as many points as the largest one; grouping the problems
+  // of similar sizes wastes less of both.
+  std::vector<int> order(num_problems);
+  for (int i = 0; i < num_problems; ++i) {
+    order[i] = i;
+  }
+  FewerPoints fewer_points;
+  fewer_points.x1s = &x1s;
+  std::stable_sort(order.begin(), order.end(), fewer_points);
+
+  GroupEstimator estimator;
+  estimator.x1s = &x1s;
+  estimator.x2s = &x2s;
+  estimator.order = &order;
+  estimator.model = model;
+  estimator.max_error = max_error;
+  estimator.outliers_probability = outliers_probability;
+  estimator.max_iterations = RobustEstimationOptions().max_iterations;
+  estimator.Hs = Hs;
+  estimator.errors = errors;
+  estimator.inliers = inliers;
+  int num_groups = (num_problems + kLanes - 1) / kLanes;
+  ParallelForDynamic(0, num_groups, num_threads, &estimator);
+}
+
+}  // namespace libmv
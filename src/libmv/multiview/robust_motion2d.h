@@ -0,0 +1,136 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_MULTIVIEW_ROBUST_MOTION2D_H_
+#define LIBMV_MULTIVIEW_ROBUST_MOTION2D_H_
+
+#include <vector>
+
+#include "libmv/numeric/numeric.h"
+#include "libmv/base/vector.h"
+
+namespace libmv {
+
+/** Streaming robust estimation of the 2D motion between video frames.
+ *
+ * Estimates the motion x2 = H * x1 between consecutive frames, for instance
+ * for video stabilization. Each estimation is warm started from the motion of
+ * the previous frames (see EstimateWarmStart()): a few hypotheses fitted on
+ * the inliers of the previous motion are verified first, and the full RANSAC
+ * only runs when the motion changed too much. The per frame cost then stays
+ * small and roughly constant.
+ *
+ * The errors and the thresholds are the ones of
+ * Euclidean2DFromCorrespondences2PointRobust() and of the similarity, affine
+ * and homography equivalents.
+ */
+class Motion2DEstimator {
+ public:
+  enum MotionModel {
+    EUCLIDEAN = 0,  // 2 translations + 1 rotation
+    SIMILARITY,     // EUCLIDEAN + scale
+    AFFINE,         // 6 dof
+    HOMOGRAPHY,     // 8 dof
+  };
+
+  /**
+   * \param model The motion model
+   * \param max_error The maximum error (in pixels)
+   * \param outliers_probability The outliers probability (in ]0,1[)
+   */
+  Motion2DEstimator(MotionModel model,
+                    double max_error,
+                    double outliers_probability = 1e-2);
+
+  /**
+   * Estimates the motion between the next two frames.
+   *
+   * \param[in] x1 The 2xN matrix of the points in the first frame
+   * \param[in] x2 The 2xN matrix of the points in the second frame
+   * \param[out] H The motion, such that x2 = H * x1
+   * \param[out] inliers The indexes of the inliers
+   *
+   * \return the best error found (in pixels), or HUGE_VAL if there are too
+   *         few points, in which case the next estimation is not warm started.
+   */
+  double Estimate(const Mat &x1,
+                  const Mat &x2,
+                  Mat3 *H,
+                  vector<int> *inliers = NULL);
+
+  /// Forgets the previous motion, e.g. at a scene cut.
+  void Reset();
+
+  /// The minimum number of points of Estimate().
+  int MinimumSamples() const;
+
+  /// Whether the last estimation avoided the full RANSAC.
+  bool warm_started() const { return warm_started_; }
+
+ private:
+  MotionModel model_;
+  double max_error_;
+  double outliers_probability_;
+  bool has_prior_;
+  Mat3 prior_;
+  bool warm_started_;
+};
+
+/** Robust estimation of the 2D motions of many independent pairs of frames.
+ *
+ * Runs a RANSAC with the errors and the thresholds of Motion2DEstimator (but
+ * no warm start) on every problem, several problems at a time. The problems
+ * are grouped by their number of points into groups of 4 whose points are
+ * stored interleaved: the j-th point of the 4 problems are next to each
+ * other. The minimal solvers (in closed form) and the scoring are loops over
+ * the 4 problems of a group, which the compiler vectorizes. This is much
+ * faster than one Motion2DEstimator per problem when there are many small
+ * problems, e.g. all the consecutive frames of a video, each too small to
+ * vectorize on its own.
+ *
+ * \param[in] x1s The 2xN matrices of the points of each problem in the first
+ *                frame
+ * \param[in] x2s The 2xN matrices of the points of each problem in the second
+ *                frame
+ * \param[in] model The motion model
+ * \param[in] max_error The maximum error (in pixels)
+ * \param[in] outliers_probability The outliers probability (in ]0,1[)
+ * \param[out] Hs The motions, such that x2s[i] = Hs[i] * x1s[i]
+ * \param[out] errors The best errors found (in pixels), as returned by
+ *                    Motion2DEstimator::Estimate(); HUGE_VAL for the problems
+ *                    with too few points, whose motion is the identity
+ * \param[out] inliers The indexes of the inliers of each problem, or NULL
+ * \param[in] num_threads Threads estimating groups of problems
+ *
+ * The results only depend on the problems, not on the number of threads.
+ */
+void EstimateMotion2DBatch(const vector<Mat> &x1s,
+                           const vector<Mat> &x2s,
+                           Motion2DEstimator::MotionModel model,
+                           double max_error,
+                           double outliers_probability,
+                           vector<Mat3> *Hs,
+                           vector<double> *errors,
+                           std::vector<vector<int> > *inliers = NULL,
+                           int num_threads = 1);
+
+} // namespace libmv
+
+#endif  // LIBMV_MULTIVIEW_ROBUST_MOTION2D_H_
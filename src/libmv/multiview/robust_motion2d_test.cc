@@ -0,0 +1,162 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/base/vector.h"
+#include "libmv/logging/logging.h"
+#include "libmv/multiview/projection.h"
+#include "libmv/multiview/robust_motion2d.h"
+#include "libmv/numeric/numeric.h"
+#include "testing/testing.h"
+
+namespace {
+
+using namespace libmv;
+
+Mat3 Similarity(double scale, double angle, double tx, double ty) {
+  Mat3 S;
+  S << scale * cos(angle), -scale * sin(angle), tx,
+       scale * sin(angle),  scale * cos(angle), ty,
+       0,                   0,                  1;
+  return S;
+}
+
+// Moves the points by H, with one gross outlier every 5 points.
+void MakeFrame(const Mat3 &H, Mat *x1, Mat *x2) {
+  const int n = 100;
+  *x1 = 320 * (Mat::Random(2, n).array() + 1).matrix();
+  Mat x1h, x2h;
+  EuclideanToHomogeneous(*x1, &x1h);
+  x2h = H * x1h;
+  HomogeneousToEuclidean(x2h, x2);
+  for (int i = 0; i < n; i += 5) {
+    x2->col(i) = 320 * (Vec2::Random().array() + 1).matrix();
+  }
+}
+
+TEST(Motion2DEstimator, WarmStartsOnSmoothMotion) {
+  Motion2DEstimator estimator(Motion2DEstimator::SIMILARITY, 1.0);
+  EXPECT_EQ(2, estimator.MinimumSamples());
+  for (int frame = 0; frame < 10; ++frame) {
+    SCOPED_TRACE(frame);
+    Mat3 S = Similarity(1 + 0.001 * frame, 0.01 * frame, 2.0 + 0.1 * frame,
+                        -1.0);
+    Mat x1, x2;
+    MakeFrame(S, &x1, &x2);
+    Mat3 H;
+    vector<int> inliers;
+    EXPECT_LT(estimator.Estimate(x1, x2, &H, &inliers), HUGE_VAL);
+    EXPECT_EQ(frame > 0, estimator.warm_started());
+    EXPECT_EQ(80, inliers.size());
+    EXPECT_MATRIX_NEAR(S, H, 1e-6);
+  }
+
+  // A sudden motion falls back to the full estimation.
+  Mat3 S = Similarity(1.2, 1.0, 50, 20);
+  Mat x1, x2;
+  MakeFrame(S, &x1, &x2);
+  Mat3 H;
+  EXPECT_LT(estimator.Estimate(x1, x2, &H), HUGE_VAL);
+  EXPECT_FALSE(estimator.warm_started());
+  EXPECT_MATRIX_NEAR(S, H, 1e-6);
+}
+
+TEST(Motion2DEstimator, TooFewPointsResets) {
+  Motion2DEstimator estimator(Motion2DEstimator::AFFINE, 1.0);
+  Mat3 A;
+  A << 1.1, 0.1,  3,
+      -0.1, 0.9, -2,
+       0,   0,    1;
+  Mat x1, x2;
+  MakeFrame(A, &x1, &x2);
+  Mat3 H;
+  EXPECT_LT(estimator.Estimate(x1, x2, &H), HUGE_VAL);
+  EXPECT_MATRIX_NEAR(A, H, 1e-6);
+
+  Mat y1 = x1.leftCols(2), y2 = x2.leftCols(2);
+  EXPECT_EQ(HUGE_VAL, estimator.Estimate(y1, y2, &H));
+
+  EXPECT_LT(estimator.Estimate(x1, x2, &H), HUGE_VAL);
+  EXPECT_FALSE(estimator.warm_started());
+  EXPECT_MATRIX_NEAR(A, H, 1e-6);
+}
+
+TEST(EstimateMotion2DBatch, FindsTheMotionOfEveryProblem) {
+  Motion2DEstimator::MotionModel models[] = {
+    Motion2DEstimator::EUCLIDEAN, Motion2DEstimator::SIMILARITY,
+    Motion2DEstimator::AFFINE, Motion2DEstimator::HOMOGRAPHY
+  };
+  for (int m = 0; m < 4; ++m) {
+    SCOPED_TRACE(m);
+    // Problems of uneven sizes, and one with too few points.
+    const int num_problems = 11;
+    vector<Mat> x1s(num_problems), x2s(num_problems);
+    vector<Mat3> motions(num_problems);
+    for (int i = 0; i < num_problems; ++i) {
+      double angle = 0.05 * i;
+      motions[i] = Similarity(m == 0 ? 1.0 : 1.0 + 0.01 * i, angle, 3.0 * i,
+                              -2.0);
+      if (m >= 2) {
+        motions[i](0, 1) += 0.05;
+      }
+      if (m == 3) {
+        motions[i](2, 0) = 1e-4;
+        motions[i](2, 1) = -2e-4;
+      }
+      MakeFrame(motions[i], &x1s[i], &x2s[i]);
+      int n = 20 + 10 * (i % 5);
+      x1s[i] = Mat(x1s[i].leftCols(n));
+      x2s[i] = Mat(x2s[i].leftCols(n));
+    }
+    x1s[5] = Mat(x1s[5].leftCols(1));
+    x2s[5] = Mat(x2s[5].leftCols(1));
+
+    vector<Mat3> Hs;
+    vector<double> errors;
+    std::vector<vector<int> > inliers;
+    EstimateMotion2DBatch(x1s, x2s, models[m], 1.0, 1e-2, &Hs, &errors,
+                          &inliers);
+    ASSERT_EQ(num_problems, Hs.size());
+    for (int i = 0; i < num_problems; ++i) {
+      SCOPED_TRACE(i);
+      if (i == 5) {
+        EXPECT_EQ(HUGE_VAL, errors[i]);
+        EXPECT_EQ(0, inliers[i].size());
+        continue;
+      }
+      EXPECT_LT(errors[i], HUGE_VAL);
+      EXPECT_EQ(x1s[i].cols() * 4 / 5, inliers[i].size());
+      Mat3 H = Hs[i], motion = motions[i] / motions[i](2, 2);
+      EXPECT_MATRIX_NEAR(motion, H, 1e-6);
+    }
+
+    // The same results with several threads.
+    vector<Mat3> threaded_Hs;
+    vector<double> threaded_errors;
+    EstimateMotion2DBatch(x1s, x2s, models[m], 1.0, 1e-2, &threaded_Hs,
+                          &threaded_errors, NULL, 3);
+    for (int i = 0; i < num_problems; ++i) {
+      EXPECT_EQ(errors[i], threaded_errors[i]);
+      Mat3 H = Hs[i], threaded_H = threaded_Hs[i];
+      EXPECT_MATRIX_NEAR(H, threaded_H, 0);
+    }
+  }
+}
+
+}  // namespace
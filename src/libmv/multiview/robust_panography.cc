@@ -0,0 +1,303 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+
+#include "libmv/logging/logging.h"
+#include "libmv/multiview/panography.h"
+#include "libmv/multiview/panography_kernel.h"
+#include "libmv/multiview/robust_estimation.h"
+#include "libmv/multiview/robust_panography.h"
+#include "libmv/multiview/rotation_parameterization.h"
+#include "libmv/numeric/levenberg_marquardt.h"
+#include "libmv/numeric/numeric.h"
+
+namespace libmv {
+
+double PanographyFromCorrespondences2PointRobust(const Mat &x1,
+                                                 const Mat &x2,
+                                                 double max_error,
+                                                 Mat3 *H,
+                                                 vector<int> *inliers,
+                                                 double outliers_probability,
+                                                 int num_threads) {
+  // The threshold is on the squared transfer error in the second image.
+  double threshold = Square(max_error);
+  double best_score = HUGE_VAL;
+  typedef panography::kernel::UnnormalizedKernel KernelH;
+  KernelH kernel(x1, x2);
+  RobustEstimationOptions options;
+  options.outliers_probability = outliers_probability;
+  *H = EstimateParallel(kernel, MLEScorer<KernelH>(threshold), options,
+                        num_threads, inliers, &best_score);
+  if (best_score == HUGE_VAL)
+    return HUGE_VAL;
+  else
+    return std::sqrt(best_score);
+}
+
+namespace {
+
+// Appends the two equations a + f^2 * b = 0 telling that the first two
+// columns of K^-1 * H * K are orthogonal and have the same norm.
+void AppendFocalEquations(const Mat3 &H_arg, Vec *a, Vec *b, int *n) {
+  Mat3 H = H_arg / H_arg.norm();
+  (*a)(*n) = H(0, 0) * H(0, 1) + H(1, 0) * H(1, 1);
+  (*b)(*n) = H(2, 0) * H(2, 1);
+  ++*n;
+  (*a)(*n) = Square(H(0, 0)) + Square(H(1, 0))
+           - Square(H(0, 1)) - Square(H(1, 1));
+  (*b)(*n) = Square(H(2, 0)) - Square(H(2, 1));
+  ++*n;
+}
+
+// The rotation exp([w]) * R.
+Mat3 RotationUpdate(const Vec3 &w, const Mat3 &R) {
+  Mat3 updated;
+  Rotation3DLocalParameterization<double>(R).To(w, &updated);
+  return updated;
+}
+
+// The transfer errors of the matches of a panorama, for the rotation only
+// bundle adjustment. The parameters are the rotation updates w of the images
+// 1 to n - 1 and the logarithm of the focal length update, such that
+//
+//   Rs[i] = exp([w_i]) * Rs0[i],  focal = focal0 * exp(s).
+//
+// They all start at 0.
+class PanoramaTransferError {
+ public:
+  typedef Vec FMatrixType;
+  typedef Vec XMatrixType;
+
+  PanoramaTransferError(const vector<PanoramaMatches> &matches,
+                        const vector<Mat3> &Rs0,
+                        double focal0)
+      : matches_(matches), Rs0_(Rs0), focal0_(focal0), num_residuals_(0) {
+    for (int i = 0; i < matches.size(); ++i) {
+      num_residuals_ += 2 * matches[i].x1.cols();
+    }
+  }
+
+  int NumParameters() const { return 3 * (Rs0_.size() - 1) + 1; }
+  int NumResiduals() const { return num_residuals_; }
+
+  void Unpack(const Vec &x, vector<Mat3> *Rs, double *focal) const {
+    Rs->resize(Rs0_.size());
+    (*Rs)[0] = Rs0_[0];
+    for (int i = 1; i < Rs0_.size(); ++i) {
+      (*Rs)[i] = RotationUpdate(x.segment<3>(3 * (i - 1)), Rs0_[i]);
+    }
+    *focal = focal0_ * exp(x(x.rows() - 1));
+  }
+
+  Vec operator()(const Vec &x) const {
+    vector<Mat3> Rs;
+    double focal;
+    Unpack(x, &Rs, &focal);
+    Vec residuals(num_residuals_);
+    int r = 0;
+    for (int i = 0; i < matches_.size(); ++i) {
+      const PanoramaMatches &m = matches_[i];
+      // K * R2 * R1^T * K^-1 * (x, y, 1) is K * R2 * R1^T * (x, y, f) / f.
+      Mat3 R = Rs[m.image2] * Rs[m.image1].transpose();
+      for (int k = 0; k < m.x1.cols(); ++k) {
+        Vec3 ray = R * Vec3(m.x1(0, k), m.x1(1, k), focal);
+        residuals(r++) = focal * ray(0) / ray(2) - m.x2(0, k);
+        residuals(r++) = focal * ray(1) / ray(2) - m.x2(1, k);
+      }
+    }
+    return residuals;
+  }
+
+ private:
+  const vector<PanoramaMatches> &matches_;
+  const vector<Mat3> &Rs0_;
+  double focal0_;
+  int num_residuals_;
+};
+
+// A pair of images fitted by PanoramaFromMatches().
+struct PanoramaEdge {
+  int match;
+  int num_inliers;
+};
+
+bool MoreInliers(const PanoramaEdge &a, const PanoramaEdge &b) {
+  return a.num_inliers > b.num_inliers;
+}
+
+}  // namespace
+
+bool PanographyFocalFromHomography(const Mat3 &H, double *focal) {
+  // K^-1 * H^-1 * K is the inverse rotation, which gives two more equations.
+  Vec a(4), b(4);
+  int n = 0;
+  AppendFocalEquations(H, &a, &b, &n);
+  AppendFocalEquations(H.inverse(), &a, &b, &n);
+  double bb = b.squaredNorm();
+  if (bb < 1e-24) {
+    return false;
+  }
+  double f2 = -a.dot(b) / bb;
+  if (!(f2 > 0)) {
+    return false;
+  }
+  *focal = sqrt(f2);
+  return true;
+}
+
+double PanoramaBundleAdjust(const vector<PanoramaMatches> &matches,
+                            vector<Mat3> *Rs,
+                            double *focal,
+                            int max_iterations) {
+  assert(Rs->size() >= 1);
+  vector<Mat3> Rs0 = *Rs;
+  PanoramaTransferError transfer_error(matches, Rs0, *focal);
+  if (transfer_error.NumResiduals() == 0) {
+    return 0;
+  }
+  Vec x = Vec::Zero(transfer_error.NumParameters());
+
+  typedef LevenbergMarquardt<PanoramaTransferError> Solver;
+  Solver::SolverParameters params;
+  params.max_iterations = max_iterations;
+  Solver lm(transfer_error);
+  Solver::Results results = lm.minimize(params, &x);
+  VLOG(2) << "Panorama bundle adjustment, error " << results.error_magnitude
+          << " after " << results.iterations << " iterations.";
+
+  transfer_error.Unpack(x, Rs, focal);
+  return sqrt(transfer_error(x).squaredNorm() /
+              (transfer_error.NumResiduals() / 2));
+}
+
+double PanoramaFromMatches(const vector<PanoramaMatches> &matches,
+                           int num_images,
+                           double max_error,
+                           vector<Mat3> *Rs,
+                           double *focal,
+                           int num_threads) {
+  assert(num_images >= 1);
+  Rs->resize(num_images);
+  for (int i = 0; i < num_images; ++i) {
+    (*Rs)[i] = Mat3::Identity();
+  }
+
+  // Fit each pair with the 2 points solver, keeping its inliers.
+  vector<PanoramaMatches> inlier_matches;
+  vector<PanoramaEdge> edges;
+  vector<double> focals;
+  for (int i = 0; i < matches.size(); ++i) {
+    const PanoramaMatches &m = matches[i];
+    assert(0 <= m.image1 && m.image1 < num_images);
+    assert(0 <= m.image2 && m.image2 < num_images);
+    if (m.x1.cols() < 2) {
+      continue;
+    }
+    Mat3 H;
+    vector<int> inliers;
+    double error = PanographyFromCorrespondences2PointRobust(
+        m.x1, m.x2, max_error, &H, &inliers, 1e-2, num_threads);
+    if (error == HUGE_VAL || inliers.size() < 2) {
+      continue;
+    }
+    double f;
+    if (PanographyFocalFromHomography(H, &f)) {
+      focals.push_back(f);
+    }
+    PanoramaMatches inlier_match;
+    inlier_match.image1 = m.image1;
+    inlier_match.image2 = m.image2;
+    inlier_match.x1 = ExtractColumns(m.x1, inliers);
+    inlier_match.x2 = ExtractColumns(m.x2, inliers);
+    inlier_matches.push_back(inlier_match);
+    PanoramaEdge edge;
+    edge.match = inlier_matches.size() - 1;
+    edge.num_inliers = inliers.size();
+    edges.push_back(edge);
+  }
+  if (focals.size() == 0) {
+    LOG(ERROR) << "No pair of images gives the focal length.";
+    return HUGE_VAL;
+  }
+  std::nth_element(focals.begin(), focals.begin() + focals.size() / 2,
+                   focals.end());
+  *focal = focals[focals.size() / 2];
+
+  // Chain the rotations from image 0, going through the pairs with the most
+  // inliers first.
+  std::sort(edges.begin(), edges.end(), MoreInliers);
+  std::vector<bool> placed(num_images, false);
+  placed[0] = true;
+  int num_placed = 1;
+  bool progress = true;
+  while (progress && num_placed < num_images) {
+    progress = false;
+    for (int i = 0; i < edges.size(); ++i) {
+      const PanoramaMatches &m = inlier_matches[edges[i].match];
+      if (placed[m.image1] == placed[m.image2]) {
+        continue;
+      }
+      Mat x1h, x2h;
+      EuclideanToHomogeneous(m.x1, &x1h);
+      EuclideanToHomogeneous(m.x2, &x2h);
+      Mat3 R;
+      GetR_FixedCameraCenter(x1h, x2h, *focal, &R);
+      if (placed[m.image1]) {
+        (*Rs)[m.image2] = R * (*Rs)[m.image1];
+        placed[m.image2] = true;
+      } else {
+        (*Rs)[m.image1] = R.transpose() * (*Rs)[m.image2];
+        placed[m.image1] = true;
+      }
+      ++num_placed;
+      progress = true;
+      break;
+    }
+  }
+  if (num_placed < num_images) {
+    LOG(ERROR) << num_images - num_placed
+               << " images are not connected to image 0.";
+    return HUGE_VAL;
+  }
+  return PanoramaBundleAdjust(inlier_matches, Rs, focal);
+}
+
+void PanoramaHomographies(const vector<Mat3> &Rs,
+                          double focal,
+                          const Vec2 &principal_point,
+                          vector<Mat3> *Hs) {
+  Mat3 K, T;
+  K << focal, 0, 0,
+       0, focal, 0,
+       0, 0, 1;
+  T << 1, 0, principal_point(0),
+       0, 1, principal_point(1),
+       0, 0, 1;
+  Mat3 KT = T * K;
+  Mat3 KT_inverse = KT.inverse();
+  Hs->resize(Rs.size());
+  for (int i = 0; i < Rs.size(); ++i) {
+    (*Hs)[i] = KT * Rs[0] * Rs[i].transpose() * KT_inverse;
+  }
+}
+
+}  // namespace libmv
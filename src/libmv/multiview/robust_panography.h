@@ -0,0 +1,146 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_MULTIVIEW_ROBUST_PANOGRAPHY_H_
+#define LIBMV_MULTIVIEW_ROBUST_PANOGRAPHY_H_
+
+#include "libmv/base/vector.h"
+#include "libmv/numeric/numeric.h"
+
+namespace libmv {
+
+/** Robust panography estimation from 2 point correspondences.
+ *
+ * This function estimates robustly the homography H = K * R * K^-1 between
+ * two images taken by a camera rotating about its center, with the shared
+ * focal length f of K = diag(f, f, 1) unknown. The minimal solver relies on
+ * the 2 points solution of panography.h, so far fewer samples are needed than
+ * with the 4 points homography solver.
+ *
+ * \param[in] x1 The first 2xN matrix of euclidean points, in pixels centered
+ *               on the principal point
+ * \param[in] x2 The second 2xN matrix of euclidean points, in pixels centered
+ *               on the principal point
+ * \param[in] max_error maximum error (in pixels)
+ * \param[out] H The 3x3 homography such that x2 = H * x1
+ * \param[out] inliers the indexes list of the detected inliers
+ * \param[in] outliers_probability outliers probability (in ]0,1[).
+ * \param[in] num_threads number of threads generating and scoring hypotheses
+ *            (see EstimateParallel()).
+ *
+ * \return the best error found (in pixels), associated to the solution H
+ *
+ * \note The function needs at least 2 points
+ * \note The points are not normalized, since moving the principal point
+ *       breaks the rotation only model.
+ */
+double PanographyFromCorrespondences2PointRobust(
+    const Mat &x1,
+    const Mat &x2,
+    double max_error,
+    Mat3 *H,
+    vector<int> *inliers = NULL,
+    double outliers_probability = 1e-2,
+    int num_threads = 1);
+
+/** Focal length of a panography.
+ *
+ * Finds f such that K^-1 * H * K, with K = diag(f, f, 1), is a scaled
+ * rotation, from the orthogonality and the equal norms of the first two
+ * columns of K^-1 * H * K and of its inverse (least squares in f^2).
+ *
+ * \return false if f is not observable from H, e.g. for a rotation about the
+ *         optical axis.
+ */
+bool PanographyFocalFromHomography(const Mat3 &H, double *focal);
+
+/// The correspondences between two images of a panorama, in pixels centered
+/// on the principal point: x1.col(k) in image1 matches x2.col(k) in image2.
+struct PanoramaMatches {
+  int image1;
+  int image2;
+  Mat x1;
+  Mat x2;
+};
+
+/** Rotation only bundle adjustment of a panorama.
+ *
+ * Refines the rotations of the cameras and their shared focal length by
+ * minimizing the transfer errors ||x2 - K * R2 * R1^T * K^-1 * x1|| of all the
+ * matches, with R1 and R2 the rotations of image1 and image2. There are 3
+ * parameters per image and the focal length, instead of the 8 per pair of
+ * homographies. Rs[0] is kept fixed.
+ *
+ * \param[in] matches The (inlier) matches between pairs of images
+ * \param[in/out] Rs The rotations of the cameras, ray_i = Rs[i] * ray_0
+ * \param[in/out] focal The shared focal length (in pixels)
+ * \param[in] max_iterations The iteration limit of the Levenberg Marquardt
+ *
+ * \return the root mean square transfer error (in pixels)
+ */
+double PanoramaBundleAdjust(const vector<PanoramaMatches> &matches,
+                            vector<Mat3> *Rs,
+                            double *focal,
+                            int max_iterations = 100);
+
+/** Rotation only stitching of a panorama.
+ *
+ * 1. Each pair of images is fitted with the robust 2 points panography
+ *    solver (see PanographyFromCorrespondences2PointRobust()).
+ * 2. The focal length is the median of the focal lengths of these fits.
+ * 3. The rotations are chained from image 0 along the pairs with the most
+ *    inliers, each relative rotation being fitted on the inliers with
+ *    GetR_FixedCameraCenter().
+ * 4. Everything is refined on the inliers by PanoramaBundleAdjust().
+ *
+ * \param[in] matches The matches between pairs of images
+ * \param[in] num_images The number of images
+ * \param[in] max_error The inlier threshold (in pixels)
+ * \param[out] Rs The rotations of the cameras, Rs[0] is the identity
+ * \param[out] focal The shared focal length (in pixels)
+ * \param[in] num_threads The threads of each robust estimation
+ *
+ * \return the root mean square transfer error of the inliers (in pixels), or
+ *         HUGE_VAL if the focal length could not be found or if some images
+ *         are not connected to image 0 (their rotations are then left to the
+ *         identity).
+ */
+double PanoramaFromMatches(const vector<PanoramaMatches> &matches,
+                           int num_images,
+                           double max_error,
+                           vector<Mat3> *Rs,
+                           double *focal,
+                           int num_threads = 1);
+
+/** The homographies mapping each image of a panorama into image 0.
+ *
+ * Hs[i] = T * K * Rs[0] * Rs[i]^T * K^-1 * T^-1, with T the translation to
+ * the principal point, maps the pixels of image i to the pixels of image 0. The
+ * images can then be composited with WarpImageBlend(), which warps the rows
+ * in parallel.
+ */
+void PanoramaHomographies(const vector<Mat3> &Rs,
+                          double focal,
+                          const Vec2 &principal_point,
+                          vector<Mat3> *Hs);
+
+} // namespace libmv
+
+#endif  // LIBMV_MULTIVIEW_ROBUST_PANOGRAPHY_H_
@@ -0,0 +1,132 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/base/vector.h"
+#include "libmv/logging/logging.h"
+#include "libmv/multiview/robust_panography.h"
+#include "libmv/numeric/numeric.h"
+#include "testing/testing.h"
+
+namespace {
+
+using namespace libmv;
+
+// Matches between two images of a panorama with shared focal length, made of
+// the projections of random rays of the first camera; the matches whose index
+// is a multiple of outlier_period are moved to random positions.
+void MakeMatches(const Mat3 &R1, const Mat3 &R2, double focal,
+                 int n, int outlier_period,
+                 int image1, int image2, PanoramaMatches *m) {
+  m->image1 = image1;
+  m->image2 = image2;
+  m->x1.resize(2, n);
+  m->x2.resize(2, n);
+  Mat3 R = R2 * R1.transpose();
+  for (int i = 0; i < n; ++i) {
+    Vec2 uv = 0.3 * Vec2::Random();
+    Vec3 ray = R * Vec3(uv(0), uv(1), 1);
+    m->x1.col(i) = focal * uv;
+    m->x2.col(i) = focal * ray.head<2>() / ray(2);
+    if (outlier_period && i % outlier_period == 0) {
+      m->x2.col(i) = 300 * Vec2::Random();
+    }
+  }
+}
+
+TEST(RobustPanography, PanographyFromCorrespondences2PointRobust) {
+  const double focal = 600;
+  Mat3 R = RotationAroundY(0.2) * RotationAroundX(0.05);
+  PanoramaMatches m;
+  MakeMatches(Mat3::Identity(), R, focal, 50, 5, 0, 1, &m);
+
+  Mat3 H;
+  vector<int> inliers;
+  double error = PanographyFromCorrespondences2PointRobust(m.x1, m.x2, 1.0,
+                                                           &H, &inliers);
+  // Each of the 10 outliers costs the squared max_error.
+  EXPECT_NEAR(sqrt(10.0), error, 1e-6);
+  EXPECT_EQ(40, inliers.size());
+
+  Mat3 K = Mat3::Identity();
+  K(0, 0) = K(1, 1) = focal;
+  Mat3 H_gt = K * R * K.inverse();
+  EXPECT_MATRIX_PROP(H_gt, H, 1e-6);
+
+  double f;
+  EXPECT_TRUE(PanographyFocalFromHomography(H, &f));
+  EXPECT_NEAR(focal, f, 1e-5);
+}
+
+TEST(RobustPanography, PanographyFocalFromHomographyOpticalAxisRotation) {
+  Mat3 K = Mat3::Identity();
+  K(0, 0) = K(1, 1) = 600;
+  Mat3 H = K * RotationAroundZ(0.3) * K.inverse();
+  double f;
+  EXPECT_FALSE(PanographyFocalFromHomography(H, &f));
+}
+
+TEST(RobustPanography, PanoramaFromMatches) {
+  const double focal = 600;
+  vector<Mat3> Rs_gt(3);
+  Rs_gt[0] = Mat3::Identity();
+  Rs_gt[1] = RotationAroundY(0.2);
+  Rs_gt[2] = RotationAroundY(0.4) * RotationAroundX(0.05);
+
+  vector<PanoramaMatches> matches(3);
+  MakeMatches(Rs_gt[0], Rs_gt[1], focal, 40, 4, 0, 1, &matches[0]);
+  MakeMatches(Rs_gt[2], Rs_gt[1], focal, 40, 4, 2, 1, &matches[1]);
+  MakeMatches(Rs_gt[0], Rs_gt[2], focal, 40, 4, 0, 2, &matches[2]);
+
+  vector<Mat3> Rs;
+  double f;
+  double rms = PanoramaFromMatches(matches, 3, 1.0, &Rs, &f);
+  EXPECT_LT(rms, 1e-6);
+  EXPECT_NEAR(focal, f, 1e-4);
+  ASSERT_EQ(3, Rs.size());
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_MATRIX_NEAR(Rs_gt[i], Rs[i], 1e-8);
+  }
+
+  // The homographies map image 2 onto image 0.
+  Vec2 principal_point(320, 240);
+  vector<Mat3> Hs;
+  PanoramaHomographies(Rs, f, principal_point, &Hs);
+  ASSERT_EQ(3, Hs.size());
+  EXPECT_MATRIX_NEAR(Mat3::Identity(), Hs[0], 1e-8);
+  const Mat &x0 = matches[2].x1, &x2 = matches[2].x2;
+  for (int i = 1; i < x0.cols(); i += 4) {
+    Vec3 q = Hs[2] * Vec3(x2(0, i) + principal_point(0),
+                          x2(1, i) + principal_point(1), 1);
+    EXPECT_NEAR(x0(0, i) + principal_point(0), q(0) / q(2), 1e-6);
+    EXPECT_NEAR(x0(1, i) + principal_point(1), q(1) / q(2), 1e-6);
+  }
+}
+
+TEST(RobustPanography, PanoramaFromMatchesDisconnected) {
+  vector<PanoramaMatches> matches(1);
+  MakeMatches(Mat3::Identity(), RotationAroundY(0.2), 600, 20, 0, 0, 1,
+              &matches[0]);
+  vector<Mat3> Rs;
+  double f;
+  EXPECT_EQ(HUGE_VAL, PanoramaFromMatches(matches, 3, 1.0, &Rs, &f));
+  EXPECT_EQ(3, Rs.size());
+}
+
+}  // namespace
@@ -31,14 +31,17 @@ double ResectionRobust(const Mat2X &x_image,
                        double max_error,
                        Mat34 *P,
                        vector<int> *inliers,
-                       double outliers_probability) {
+                       double outliers_probability,
+                       int num_threads) {
   // The threshold is on the sum of the squared errors.
   double threshold = Square(max_error);
   double best_score = HUGE_VAL;
   typedef libmv::resection::kernel::Kernel Kernel;
   Kernel kernel(x_image, X_world);
-  *P = Estimate(kernel, MLEScorer<Kernel>(threshold), inliers, 
-                &best_score, outliers_probability);
+  RobustEstimationOptions options;
+  options.outliers_probability = outliers_probability;
+  *P = EstimateParallel(kernel, MLEScorer<Kernel>(threshold), options,
+                        num_threads, inliers, &best_score);
   if (best_score == HUGE_VAL)
     return HUGE_VAL;
   else
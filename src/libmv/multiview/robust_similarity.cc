@@ -41,8 +41,10 @@ double Similarity2DFromCorrespondences2PointRobust(
   double best_score = HUGE_VAL;
   typedef similarity::similarity2D::kernel::Kernel KernelH;
   KernelH kernel(x1, x2);
-  *H = Estimate(kernel, MLEScorer<KernelH>(threshold), inliers, 
-                &best_score, outliers_probability);
+  RobustEstimationOptions options;
+  options.outliers_probability = outliers_probability;
+  *H = EstimateFast(kernel, MLEScorer<KernelH>(threshold), options,
+                    inliers, &best_score);
   if (best_score == HUGE_VAL)
     return HUGE_VAL;
   else
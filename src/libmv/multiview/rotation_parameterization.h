@@ -226,6 +226,126 @@ class Rotation3DExponentialMapParameterization {
 };
 
 
+/** A local parameterization of the 3D rotation matrix around a base rotation
+ * R0, for the optimizers which update a rotation by small steps
+ * w = (w0, w1, w2). The rotation matrix R is built as follows
+ *
+ *   R = exp([w]) * R0,  with [w] is the matrix cross product
+ *
+ * and the Jacobians of rotated points follow from
+ *
+ *   d(exp([w]) Y) / dw = -[exp([w]) Y] * J(w),
+ *
+ * J(w) being the left Jacobian of SO(3), which is the identity at w = 0.
+ * An optimizer which folds each step into the base with Update() only ever
+ * evaluates at w = 0, where R = R0 and the Jacobian of R0 X is -[R0 X]; the
+ * product R0 X can then be cached for each point instead of rebuilding a
+ * rotation per residual.
+ */
+template<typename T = double>
+class Rotation3DLocalParameterization {
+ public:
+  typedef Eigen::Matrix<T, 3, 1> Parameters;     // w = (w0, w1, w2)
+  typedef Eigen::Matrix<T, 3, 3> Parameterized;  // R
+
+  Rotation3DLocalParameterization() : R0_(Parameterized::Identity()) {}
+  explicit Rotation3DLocalParameterization(const Parameterized &R0)
+      : R0_(R0) {}
+
+  const Parameterized &base() const { return R0_; }
+
+  /// Convert from the local update w to the rotation matrix exp([w]) * R0.
+  void To(const Parameters &w, Parameterized *R) const {
+    Exp(w, R);
+    *R = *R * R0_;
+  }
+
+  /// Convert from a rotation matrix R to the update w bringing R0 to R.
+  void From(const Parameterized &R, Parameters *w) const {
+    Log(R * R0_.transpose(), w);
+  }
+
+  /// Fold the update w into the base rotation, so that w = 0 stands for the
+  /// updated rotation.
+  void Update(const Parameters &w) {
+    Parameterized R;
+    To(w, &R);
+    R0_ = R;
+  }
+
+  /// The rotation matrix exp([w]) by Rodrigues' formula, with the Taylor
+  /// series of its coefficients for the small angles.
+  static void Exp(const Parameters &w, Parameterized *R) {
+    const T theta2 = w.squaredNorm();
+    T a, b;
+    if (theta2 > T(1e-8)) {
+      const T theta = sqrt(theta2);
+      a = sin(theta) / theta;
+      b = (T(1) - cos(theta)) / theta2;
+    } else {
+      a = T(1) - theta2 / T(6);
+      b = T(0.5) - theta2 / T(24);
+    }
+    Parameterized W;
+    W <<     T(0), -w(2),  w(1),
+             w(2),  T(0), -w(0),
+            -w(1),  w(0),  T(0);
+    *R = Parameterized::Identity() + a * W + b * W * W;
+  }
+
+  /// The w such that R = exp([w]), with |w| <= pi. It goes through the
+  /// quaternion of R, which unlike the trace keeps the small angles accurate.
+  static void Log(const Parameterized &R, Parameters *w) {
+    Eigen::Quaternion<T> q(R);
+    if (q.w() < T(0)) {
+      q.coeffs() = -q.coeffs();
+    }
+    const T s = q.vec().norm();
+    if (s > T(0)) {
+      *w = q.vec() * (T(2) * atan2(s, q.w()) / s);
+    } else {
+      w->setZero();
+    }
+  }
+
+  /// The left Jacobian J(w) of SO(3),
+  ///
+  ///   J(w) = I + (1 - cos(theta)) / theta^2 [w]
+  ///            + (theta - sin(theta)) / theta^3 [w]^2,  theta = |w|.
+  static void LeftJacobian(const Parameters &w, Parameterized *J) {
+    const T theta2 = w.squaredNorm();
+    T b, c;
+    if (theta2 > T(1e-8)) {
+      const T theta = sqrt(theta2);
+      b = (T(1) - cos(theta)) / theta2;
+      c = (theta - sin(theta)) / (theta2 * theta);
+    } else {
+      b = T(0.5) - theta2 / T(24);
+      c = T(1) / T(6) - theta2 / T(120);
+    }
+    Parameterized W;
+    W <<     T(0), -w(2),  w(1),
+             w(2),  T(0), -w(0),
+            -w(1),  w(0),  T(0);
+    *J = Parameterized::Identity() + b * W + c * W * W;
+  }
+
+  /// The Jacobian d(exp([w]) Y) / dw of a rotated point, given the rotated
+  /// point RY = exp([w]) Y and the left Jacobian J = J(w).
+  static void RotatedPointJacobian(const Eigen::Matrix<T, 3, 1> &RY,
+                                   const Parameterized &J,
+                                   Parameterized *dRY_dw) {
+    Parameterized RY_cross;
+    RY_cross <<  T(0), -RY(2),  RY(1),
+                RY(2),   T(0), -RY(0),
+               -RY(1),  RY(0),   T(0);
+    *dRY_dw = -RY_cross * J;
+  }
+
+ private:
+  Parameterized R0_;
+};
+
 } // namespace libmv
 
 #endif  // LIBMV_MULTIVIEW_ROTATION_PARAMETERIZATION_H_
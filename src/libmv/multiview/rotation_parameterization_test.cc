@@ -140,4 +140,64 @@ TEST(Rotation3DExponentialMapParameterization, Roundtripping) {
   // Check that going from H to p and back to H goes in a circle.
   EXPECT_MATRIX_PROP(h, h_roundtrip, 1.5e-8);
 }
+TEST(Rotation3DLocalParameterization, Roundtripping) {
+  Vec3 w0; w0 << 0.3, -0.2, 0.5;
+  Mat3 R0 = RotationRodrigues(w0);
+  Rotation3DLocalParameterization<double> rotation(R0);
+
+  Vec3 w; w << -0.1, 0.4, 0.2;
+  Mat3 R, R_roundtrip;
+  rotation.To(w, &R);
+  Mat3 expected = RotationRodrigues(w) * R0;
+  EXPECT_MATRIX_NEAR(expected, R, 1e-12);
+
+  Vec3 w_roundtrip;
+  rotation.From(R, &w_roundtrip);
+  EXPECT_MATRIX_NEAR(w, w_roundtrip, 1e-12);
+
+  // After the update, w = 0 stands for R.
+  rotation.Update(w);
+  rotation.To(Vec3::Zero(), &R_roundtrip);
+  EXPECT_MATRIX_NEAR(R, R_roundtrip, 1e-12);
+}
+
+TEST(Rotation3DLocalParameterization, SmallAngles) {
+  Vec3 w; w << 1e-6, -2e-6, 3e-7;
+  Mat3 R;
+  Rotation3DLocalParameterization<double>::Exp(w, &R);
+  Mat3 expected = RotationRodrigues(w);
+  EXPECT_MATRIX_NEAR(expected, R, 1e-15);
+
+  Vec3 w_roundtrip;
+  Rotation3DLocalParameterization<double>::Log(R, &w_roundtrip);
+  EXPECT_MATRIX_NEAR(w, w_roundtrip, 1e-15);
+
+  Rotation3DLocalParameterization<double>::Exp(Vec3::Zero(), &R);
+  Mat3 identity = Mat3::Identity();
+  EXPECT_MATRIX_NEAR(identity, R, 0);
+}
+
+TEST(Rotation3DLocalParameterization, RotatedPointJacobian) {
+  typedef Rotation3DLocalParameterization<double> Parameterization;
+  Vec3 Y; Y << 1, -2, 3;
+  Vec3 w; w << 0.4, 0.1, -0.7;
+
+  Mat3 R, J, dRY_dw;
+  Parameterization::Exp(w, &R);
+  Parameterization::LeftJacobian(w, &J);
+  Parameterization::RotatedPointJacobian(R * Y, J, &dRY_dw);
+
+  // Central differences.
+  const double kStep = 1e-6;
+  for (int i = 0; i < 3; ++i) {
+    Vec3 dw = Vec3::Zero();
+    dw(i) = kStep;
+    Mat3 R_plus, R_minus;
+    Parameterization::Exp(w + dw, &R_plus);
+    Parameterization::Exp(w - dw, &R_minus);
+    Vec3 expected = (R_plus * Y - R_minus * Y) / (2 * kStep);
+    Vec3 column = dRY_dw.col(i);
+    EXPECT_MATRIX_NEAR(expected, column, 1e-8);
+  }
+}
 } // namespace
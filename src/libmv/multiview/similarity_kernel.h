@@ -34,6 +34,11 @@ namespace kernel {
 struct TwoPointSolver {
   enum { MINIMUM_SAMPLES = 2 };
   static void Solve(const Mat &x1, const Mat &x2, vector<Mat3> *Hs);
+
+  typedef Matrix<double, 2, MINIMUM_SAMPLES> MinimalSample;
+  static void SolveMinimal(const MinimalSample &x1,
+                           const MinimalSample &x2,
+                           vector<Mat3> *Hs);
 };
 
 typedef two_view::kernel::Kernel<
@@ -47,6 +52,15 @@ typedef two_view::kernel::Kernel<
       UnnormalizerI>,
     homography::homography2D::AsymmetricError,
     Mat3>
+  NormalizedKernel;
+
+// The points are normalized once, when the kernel is built.
+typedef two_view::kernel::PrenormalizedKernel<
+    similarity2D::kernel::TwoPointSolver,
+    UnnormalizerI,
+    homography::homography2D::AsymmetricError,
+    Mat3,
+    true>
   Kernel;
 
 }  // namespace kernel
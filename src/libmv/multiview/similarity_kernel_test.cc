@@ -36,6 +36,7 @@ struct SimilarityKernelTest : public testing::Test {
 };
 
 typedef Types<Kernel,
+              NormalizedKernel,
               UnnormalizedKernel>
   SimilarityKernelImplementations;
 
@@ -0,0 +1,1125 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "colamd.h"
+extern "C" {
+#include "ldl.h"
+}
+
+#include "libmv/base/thread.h"
+#include "libmv/base/timer.h"
+#include "libmv/logging/logging.h"
+#include "libmv/multiview/sparse_bundle.h"
+
+namespace libmv {
+namespace {
+
+// Number of parameters of a camera (rotation and translation) and of a point.
+const int kCameraSize = 6;
+const int kPointSize = 3;
+
+// Levenberg-Marquardt damping of the diagonal of a block; parameters without
+// curvature are still damped, so that the systems stay positive definite.
+template<typename MatrixType>
+void Damp(double lambda, MatrixType *block) {
+  const double kMinDiagonal = 1e-6;
+  for (int i = 0; i < block->rows(); ++i) {
+    (*block)(i, i) += lambda * std::max((*block)(i, i), kMinDiagonal);
+  }
+}
+
+// Calls (object->*method)(thread) for each thread, see RunShares().
+template<typename Object, typename Method>
+struct CallShare {
+  Object *object;
+  Method method;
+  void operator()(int thread) {
+    (object->*method)(thread);
+  }
+};
+
+template<typename T>
+long long CapacityInBytes(const std::vector<T> &v) {
+  return v.capacity() * sizeof(T);
+}
+
+template<typename T>
+long long CapacityInBytes(const vector<T> &v) {
+  return v.capacity() * sizeof(T);
+}
+
+// Runs the method of the object on num_threads threads; the method gets the
+// index of the thread, and processes the corresponding share of the work.
+template<typename Object, typename Method>
+void RunShares(Object *object, Method method, int num_threads) {
+  CallShare<Object, Method> call = { object, method };
+  ParallelFor(0, num_threads, num_threads, &call);
+}
+
+// Residual of the projection of X in the camera (K, R, t) observed at x. If
+// dx is not NULL, it receives the derivative of the projection with respect
+// to the point in the camera frame, and RX the rotated point.
+Vec2 ProjectionResidual(const Mat3 &K, const Mat3 &R, const Vec3 &t,
+                        const Vec3 &X, const Vec2 &x,
+                        Vec3 *RX = NULL, Mat23 *dx = NULL) {
+  Vec3 rotated = R * X;
+  Vec3 projected = K * (rotated + t);
+  double u = projected(0) / projected(2);
+  double v = projected(1) / projected(2);
+  if (dx) {
+    dx->row(0) = (K.row(0) - u * K.row(2)) / projected(2);
+    dx->row(1) = (K.row(1) - v * K.row(2)) / projected(2);
+    *RX = rotated;
+  }
+  return Vec2(u - x(0), v - x(1));
+}
+
+// Derivative of a projection with respect to the rotation and the
+// translation of the camera. The rotation is updated as R <- exp([w]) R,
+// hence the derivative -[R X] with respect to w.
+Eigen::Matrix<double, 2, 6> CameraJacobian(const Vec3 &RX, const Mat23 &dx) {
+  Eigen::Matrix<double, 2, 6> J;
+  J.block<2, 3>(0, 0) = -dx * CrossProductMatrix(RX);
+  J.block<2, 3>(0, 3) = dx;
+  return J;
+}
+
+// The motion only problem of a camera: its observations of fixed points.
+struct CameraBlock {
+  typedef Eigen::Matrix<double, kCameraSize, kCameraSize> Hessian;
+  typedef Eigen::Matrix<double, kCameraSize, 1> Gradient;
+
+  const Mat3 *K;
+  Mat3 *R;
+  Vec3 *t;
+  std::vector<const Vec3 *> X;
+  std::vector<Vec2> x;
+  Mat3 saved_R;
+  Vec3 saved_t;
+
+  double Cost() const {
+    double cost = 0;
+    for (size_t k = 0; k < x.size(); ++k) {
+      cost += ProjectionResidual(*K, *R, *t, *X[k], x[k]).squaredNorm();
+    }
+    return cost;
+  }
+  double Linearize(Hessian *H, Gradient *g) const {
+    H->setZero();
+    g->setZero();
+    double cost = 0;
+    Vec3 RX;
+    Mat23 dx;
+    for (size_t k = 0; k < x.size(); ++k) {
+      Vec2 r = ProjectionResidual(*K, *R, *t, *X[k], x[k], &RX, &dx);
+      Eigen::Matrix<double, 2, 6> J = CameraJacobian(RX, dx);
+      *H += J.transpose() * J;
+      *g += J.transpose() * r;
+      cost += r.squaredNorm();
+    }
+    return cost;
+  }
+  void Save() {
+    saved_R = *R;
+    saved_t = *t;
+  }
+  void Restore() {
+    *R = saved_R;
+    *t = saved_t;
+  }
+  void Apply(const Gradient &step) {
+    Vec3 w = step.head<3>();
+    if (w.squaredNorm() > 0) {
+      *R = RotationRodrigues(w) * *R;
+    }
+    *t += step.tail<3>();
+  }
+};
+
+// The structure only problem of a point: its observations by fixed cameras.
+struct PointBlock {
+  typedef Mat3 Hessian;
+  typedef Vec3 Gradient;
+
+  Vec3 *X;
+  std::vector<const Mat3 *> K, R;
+  std::vector<const Vec3 *> t;
+  std::vector<Vec2> x;
+  Vec3 saved_X;
+
+  double Cost() const {
+    double cost = 0;
+    for (size_t k = 0; k < x.size(); ++k) {
+      cost += ProjectionResidual(*K[k], *R[k], *t[k], *X, x[k]).squaredNorm();
+    }
+    return cost;
+  }
+  double Linearize(Hessian *H, Gradient *g) const {
+    H->setZero();
+    g->setZero();
+    double cost = 0;
+    Vec3 RX;
+    Mat23 dx;
+    for (size_t k = 0; k < x.size(); ++k) {
+      Vec2 r = ProjectionResidual(*K[k], *R[k], *t[k], *X, x[k], &RX, &dx);
+      Mat23 J = dx * *R[k];
+      *H += J.transpose() * J;
+      *g += J.transpose() * r;
+      cost += r.squaredNorm();
+    }
+    return cost;
+  }
+  void Save() {
+    saved_X = *X;
+  }
+  void Restore() {
+    *X = saved_X;
+  }
+  void Apply(const Gradient &step) {
+    *X += step;
+  }
+};
+
+// Levenberg-Marquardt on the small dense problem of a block, with the
+// iterations and the stopping rules of SparseBundleAdjuster::Solve(). The
+// block is left at its best parameters. Returns whether it stopped at the
+// deadline.
+template<typename Block>
+bool MinimizeBlock(const SparseBundleAdjuster::Options &options,
+                   Block *block, int *iterations, int *accepted_steps) {
+  typename Block::Hessian H, A;
+  typename Block::Gradient g;
+  double cost = block->Linearize(&H, &g);
+  double lambda = options.initial_lambda;
+  bool linearized = true;
+  *iterations = 0;
+  *accepted_steps = 0;
+  while (*iterations < options.max_iterations && cost > 0) {
+    if (DeadlineReached(options.deadline)) {
+      return true;
+    }
+    ++*iterations;
+    if (!linearized) {
+      block->Linearize(&H, &g);
+      linearized = true;
+    }
+    A = H;
+    Damp(lambda, &A);
+    Eigen::LDLT<typename Block::Hessian> ldlt(A);
+    if (!ldlt.isPositive()) {
+      lambda *= 10;
+      continue;
+    }
+    block->Save();
+    block->Apply(ldlt.solve(-g));
+    double new_cost = block->Cost();
+    if (new_cost < cost) {
+      double decrease = (cost - new_cost) / cost;
+      cost = new_cost;
+      ++*accepted_steps;
+      lambda = std::max(lambda / 10, 1e-16);
+      linearized = false;
+      if (decrease < options.function_tolerance) {
+        break;
+      }
+    } else {
+      block->Restore();
+      lambda *= 10;
+      if (lambda > 1e16) {
+        break;
+      }
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+SparseBundleAdjuster::Options::Options()
+  : max_iterations(50),
+    initial_lambda(1e-3),
+    function_tolerance(1e-10),
+    num_threads(1),
+    linear_solver(SPARSE_LDLT),
+    preconditioner(SCHUR_JACOBI),
+    max_linear_iterations(500),
+    linear_tolerance(1e-6),
+    deadline(0) {}
+
+SparseBundleAdjuster::SparseBundleAdjuster()
+  : analyzed_(false),
+    observations_analyzed_(false),
+    num_threads_(1),
+    lambda_(0),
+    linear_solver_(Options::SPARSE_LDLT),
+    preconditioner_(Options::SCHUR_JACOBI),
+    max_linear_iterations_(0),
+    linear_tolerance_(0),
+    damped_U_(NULL),
+    memory_(MEMORY_BUNDLE) {}
+
+SparseBundleAdjuster::Statistics::Statistics()
+  : iterations(0),
+    accepted_steps(0),
+    singular_steps(0),
+    linear_iterations(0),
+    initial_rms(0),
+    final_rms(0),
+    linearization_seconds(0),
+    elimination_seconds(0),
+    linear_solver_seconds(0),
+    total_seconds(0),
+    num_free_cameras(0),
+    num_blocks(0),
+    num_nonzeros(0),
+    num_factor_nonzeros(0),
+    deadline_reached(false) {}
+
+long long SparseBundleAdjuster::WorkspaceSizeInBytes() const {
+  long long bytes = 0;
+  bytes += CapacityInBytes(block_column_begin_) + CapacityInBytes(block_rows_);
+  bytes += CapacityInBytes(column_begin_) + CapacityInBytes(rows_);
+  bytes += CapacityInBytes(values_);
+  bytes += CapacityInBytes(permutation_) +
+           CapacityInBytes(inverse_permutation_);
+  bytes += CapacityInBytes(l_column_begin_) + CapacityInBytes(l_rows_) +
+           CapacityInBytes(parent_) + CapacityInBytes(l_nonzeros_);
+  bytes += CapacityInBytes(flag_) + CapacityInBytes(pattern_);
+  bytes += CapacityInBytes(l_values_) + CapacityInBytes(d_) +
+           CapacityInBytes(y_);
+  bytes += CapacityInBytes(residuals_) + CapacityInBytes(camera_jacobians_) +
+           CapacityInBytes(point_jacobians_);
+  for (size_t i = 0; i < systems_.size(); ++i) {
+    bytes += CapacityInBytes(systems_[i].U) +
+             CapacityInBytes(systems_[i].values) +
+             systems_[i].rhs.size() * sizeof(double);
+  }
+  bytes += CapacityInBytes(inverse_V_) + CapacityInBytes(point_gradients_) +
+           CapacityInBytes(W_);
+  for (size_t i = 0; i < systems_.size(); ++i) {
+    bytes += CapacityInBytes(systems_[i].schur_diagonal);
+  }
+  bytes += CapacityInBytes(inverse_preconditioner_) +
+           CapacityInBytes(schur_points_);
+  bytes += (schur_input_.size() + schur_output_.size()) * sizeof(double);
+  bytes += (camera_step_.size() + point_step_.size()) * sizeof(double);
+  return bytes;
+}
+
+int SparseBundleAdjuster::AddCamera(const Mat3 &K, Mat3 *R, Vec3 *t) {
+  Camera camera;
+  camera.K = K;
+  camera.R = R;
+  camera.t = t;
+  camera.fixed = false;
+  cameras_.push_back(camera);
+  analyzed_ = false;
+  observations_analyzed_ = false;
+  return cameras_.size() - 1;
+}
+
+void SparseBundleAdjuster::SetCameraFixed(int camera, bool fixed) {
+  assert(0 <= camera && camera < NumCameras());
+  if (cameras_[camera].fixed != fixed) {
+    cameras_[camera].fixed = fixed;
+    analyzed_ = false;
+    observations_analyzed_ = false;
+  }
+}
+
+bool SparseBundleAdjuster::IsCameraFixed(int camera) const {
+  assert(0 <= camera && camera < NumCameras());
+  return cameras_[camera].fixed;
+}
+
+int SparseBundleAdjuster::AddPoint(Vec3 *X) {
+  points_.push_back(X);
+  analyzed_ = false;
+  observations_analyzed_ = false;
+  return points_.size() - 1;
+}
+
+void SparseBundleAdjuster::AddObservation(int camera, int point,
+                                          const Vec2 &x) {
+  assert(0 <= camera && camera < NumCameras());
+  assert(0 <= point && point < NumPoints());
+  Observation observation;
+  observation.camera = camera;
+  observation.point = point;
+  observation.x = x;
+  observations_.push_back(observation);
+  analyzed_ = false;
+  observations_analyzed_ = false;
+}
+
+void SparseBundleAdjuster::GroupObservations(
+    bool by_camera,
+    std::vector<int> *begin,
+    std::vector<int> *observations) const {
+  const int num_groups = by_camera ? NumCameras() : NumPoints();
+  const int num_observations = NumObservations();
+  begin->assign(num_groups + 1, 0);
+  for (int k = 0; k < num_observations; ++k) {
+    const Observation &observation = observations_[k];
+    ++(*begin)[(by_camera ? observation.camera : observation.point) + 1];
+  }
+  for (int i = 0; i < num_groups; ++i) {
+    (*begin)[i + 1] += (*begin)[i];
+  }
+  observations->resize(num_observations);
+  std::vector<int> next(begin->begin(), begin->end() - 1);
+  for (int k = 0; k < num_observations; ++k) {
+    const Observation &observation = observations_[k];
+    int group = by_camera ? observation.camera : observation.point;
+    (*observations)[next[group]++] = k;
+  }
+}
+
+void SparseBundleAdjuster::AnalyzeObservations() {
+  free_cameras_.clear();
+  reduced_index_.assign(NumCameras(), -1);
+  for (int i = 0; i < NumCameras(); ++i) {
+    if (!cameras_[i].fixed) {
+      reduced_index_[i] = free_cameras_.size();
+      free_cameras_.push_back(i);
+    }
+  }
+  GroupObservations(false, &point_begin_, &point_observations_);
+  GroupObservations(true, &camera_begin_, &camera_observations_);
+  observations_analyzed_ = true;
+}
+
+void SparseBundleAdjuster::Analyze() {
+  const int num_points = NumPoints();
+
+  AnalyzeObservations();
+  const int num_free = free_cameras_.size();
+
+  // Two free cameras are coupled in the reduced system when they see a
+  // common point. The diagonal blocks are always present.
+  std::vector<std::vector<int> > columns(num_free);
+  for (int c = 0; c < num_free; ++c) {
+    columns[c].push_back(c);
+  }
+  std::vector<int> seen_by;
+  for (int j = 0; j < num_points; ++j) {
+    seen_by.clear();
+    for (int o = point_begin_[j]; o < point_begin_[j + 1]; ++o) {
+      int c = reduced_index_[observations_[point_observations_[o]].camera];
+      if (c >= 0) {
+        seen_by.push_back(c);
+      }
+    }
+    for (int a = 0; a < seen_by.size(); ++a) {
+      for (int b = 0; b < seen_by.size(); ++b) {
+        if (a != b) {
+          columns[seen_by[b]].push_back(seen_by[a]);
+        }
+      }
+    }
+  }
+  block_column_begin_.assign(num_free + 1, 0);
+  block_rows_.clear();
+  for (int c = 0; c < num_free; ++c) {
+    std::sort(columns[c].begin(), columns[c].end());
+    columns[c].erase(std::unique(columns[c].begin(), columns[c].end()),
+                     columns[c].end());
+    block_rows_.insert(block_rows_.end(),
+                       columns[c].begin(), columns[c].end());
+    block_column_begin_[c + 1] = block_rows_.size();
+  }
+
+  // Expand the blocks into scalars; the rows of block j of column c are
+  // 6 * block_rows_[j] ... 6 * block_rows_[j] + 5.
+  const int n = kCameraSize * num_free;
+  column_begin_.resize(n + 1);
+  rows_.resize(kCameraSize * kCameraSize * block_rows_.size());
+  column_begin_[0] = 0;
+  int entry = 0;
+  for (int c = 0; c < num_free; ++c) {
+    for (int a = 0; a < kCameraSize; ++a) {
+      for (int b = block_column_begin_[c]; b < block_column_begin_[c + 1];
+           ++b) {
+        for (int q = 0; q < kCameraSize; ++q) {
+          rows_[entry++] = kCameraSize * block_rows_[b] + q;
+        }
+      }
+      column_begin_[kCameraSize * c + a + 1] = entry;
+    }
+  }
+  values_.resize(rows_.size());
+
+  // Order the cameras to reduce the fill in, keeping blocks together.
+  permutation_.resize(n);
+  inverse_permutation_.resize(n);
+  if (num_free > 0) {
+    std::vector<int> block_permutation(num_free + 1);
+    int stats[COLAMD_STATS];
+    if (!symamd(num_free, &block_rows_[0], &block_column_begin_[0],
+                &block_permutation[0], NULL, stats, &calloc, &free)) {
+      LOG(ERROR) << "symamd failed; using the natural ordering.";
+      for (int c = 0; c < num_free; ++c) {
+        block_permutation[c] = c;
+      }
+    }
+    for (int c = 0; c < num_free; ++c) {
+      for (int a = 0; a < kCameraSize; ++a) {
+        permutation_[kCameraSize * c + a] =
+            kCameraSize * block_permutation[c] + a;
+      }
+    }
+    for (int i = 0; i < n; ++i) {
+      inverse_permutation_[permutation_[i]] = i;
+    }
+  }
+
+  // Symbolic factorization.
+  l_column_begin_.resize(n + 1);
+  parent_.resize(n);
+  l_nonzeros_.resize(n);
+  flag_.resize(n);
+  pattern_.resize(n);
+  d_.resize(n);
+  y_.resize(n);
+  if (n > 0) {
+    ldl_symbolic(n, &column_begin_[0], &rows_[0], &l_column_begin_[0],
+                 &parent_[0], &l_nonzeros_[0], &flag_[0],
+                 &permutation_[0], &inverse_permutation_[0]);
+  } else {
+    l_column_begin_[0] = 0;
+  }
+  l_rows_.resize(std::max(l_column_begin_[n], 1));
+  l_values_.resize(std::max(l_column_begin_[n], 1));
+
+  VLOG(2) << "Reduced camera system: " << num_free << " cameras, "
+          << block_rows_.size() << " blocks, "
+          << l_column_begin_[n] << " nonzeros in the factor.";
+  analyzed_ = true;
+}
+
+int SparseBundleAdjuster::BlockIndex(int row, int column) const {
+  std::vector<int>::const_iterator begin =
+      block_rows_.begin() + block_column_begin_[column];
+  std::vector<int>::const_iterator end =
+      block_rows_.begin() + block_column_begin_[column + 1];
+  std::vector<int>::const_iterator it = std::lower_bound(begin, end, row);
+  assert(it != end && *it == row);
+  return it - block_rows_.begin();
+}
+
+void SparseBundleAdjuster::Share(int thread, int n,
+                                 int *begin, int *end) const {
+  *begin = (n * thread) / num_threads_;
+  *end = (n * (thread + 1)) / num_threads_;
+}
+
+void SparseBundleAdjuster::CostShare(int thread) const {
+  int begin, end;
+  Share(thread, NumObservations(), &begin, &end);
+  double cost = 0;
+  for (int k = begin; k < end; ++k) {
+    const Observation &observation = observations_[k];
+    const Camera &camera = cameras_[observation.camera];
+    Vec3 x = camera.K * (*camera.R * *points_[observation.point] + *camera.t);
+    cost += (x.head<2>() / x(2) - observation.x).squaredNorm();
+  }
+  thread_costs_[thread] = cost;
+}
+
+double SparseBundleAdjuster::Cost() const {
+  thread_costs_.resize(num_threads_);
+  RunShares(this, &SparseBundleAdjuster::CostShare, num_threads_);
+  double cost = 0;
+  for (int t = 0; t < num_threads_; ++t) {
+    cost += thread_costs_[t];
+  }
+  return cost;
+}
+
+double SparseBundleAdjuster::RootMeanSquareError() const {
+  if (NumObservations() == 0) {
+    return 0;
+  }
+  return sqrt(Cost() / NumObservations());
+}
+
+void SparseBundleAdjuster::LinearizeShare(int thread) {
+  int begin, end;
+  Share(thread, NumObservations(), &begin, &end);
+  for (int k = begin; k < end; ++k) {
+    const Observation &observation = observations_[k];
+    const Camera &camera = cameras_[observation.camera];
+    Vec3 RX;
+    Mat23 dx;
+    residuals_[k] = ProjectionResidual(camera.K, *camera.R, *camera.t,
+                                       *points_[observation.point],
+                                       observation.x, &RX, &dx);
+    camera_jacobians_[k] = CameraJacobian(RX, dx);
+    point_jacobians_[k] = dx * *camera.R;
+  }
+}
+
+void SparseBundleAdjuster::Linearize() {
+  const int num_observations = NumObservations();
+  residuals_.resize(num_observations);
+  camera_jacobians_.resize(num_observations);
+  point_jacobians_.resize(num_observations);
+  RunShares(this, &SparseBundleAdjuster::LinearizeShare, num_threads_);
+}
+
+// The system is
+//
+//   [ U  W ] [dc]   [-gc]
+//   [ W' V ] [dp] = [-gp]
+//
+// with U and V block diagonal. Eliminating the points gives
+//
+//   (U - W V^-1 W') dc = -gc + W V^-1 gp.
+//
+// Each thread eliminates a share of the points into its own CameraSystem;
+// the systems are summed afterwards.
+void SparseBundleAdjuster::EliminateShare(int thread) {
+  const int num_free = free_cameras_.size();
+  CameraSystem &system = systems_[thread];
+  system.U.resize(num_free);
+  for (int c = 0; c < num_free; ++c) {
+    system.U[c].setZero();
+  }
+  system.rhs.setZero(kCameraSize * num_free);
+  const bool iterative = linear_solver_ == Options::ITERATIVE_SCHUR;
+  const bool schur_diagonal =
+      iterative && preconditioner_ == Options::SCHUR_JACOBI;
+  if (iterative) {
+    system.values.clear();
+  } else {
+    system.values.assign(values_.size(), 0.0);
+  }
+  system.schur_diagonal.resize(schur_diagonal ? num_free : 0);
+  for (int c = 0; c < system.schur_diagonal.size(); ++c) {
+    system.schur_diagonal[c].setZero();
+  }
+
+  int begin, end;
+  Share(thread, NumPoints(), &begin, &end);
+  vector<Mat63> Y;
+  for (int j = begin; j < end; ++j) {
+    Mat3 V = Mat3::Zero();
+    Vec3 &gp = point_gradients_[j];
+    gp.setZero();
+    for (int o = point_begin_[j]; o < point_begin_[j + 1]; ++o) {
+      int k = point_observations_[o];
+      const Mat23 &Jp = point_jacobians_[k];
+      V += Jp.transpose() * Jp;
+      gp += Jp.transpose() * residuals_[k];
+      int c = reduced_index_[observations_[k].camera];
+      if (c >= 0) {
+        const Mat26 &Jc = camera_jacobians_[k];
+        system.U[c] += Jc.transpose() * Jc;
+        system.rhs.segment<kCameraSize>(kCameraSize * c) -=
+            Jc.transpose() * residuals_[k];
+        W_[k] = Jc.transpose() * Jp;
+      }
+    }
+    if (point_begin_[j] == point_begin_[j + 1]) {
+      inverse_V_[j].setZero();
+      continue;
+    }
+    Damp(lambda_, &V);
+    inverse_V_[j] = V.inverse();
+    if (iterative) {
+      // The products by the Schur complement only need W and V^-1.
+      for (int a = point_begin_[j]; a < point_begin_[j + 1]; ++a) {
+        int ka = point_observations_[a];
+        int ca = reduced_index_[observations_[ka].camera];
+        if (ca < 0) {
+          continue;
+        }
+        Mat63 Ya = W_[ka] * inverse_V_[j];
+        system.rhs.segment<kCameraSize>(kCameraSize * ca) += Ya * gp;
+        if (schur_diagonal) {
+          system.schur_diagonal[ca] -= Ya * W_[ka].transpose();
+        }
+      }
+      continue;
+    }
+
+    // Schur complement contributions of the point.
+    Y.resize(point_begin_[j + 1] - point_begin_[j]);
+    for (int a = point_begin_[j]; a < point_begin_[j + 1]; ++a) {
+      int ka = point_observations_[a];
+      int ca = reduced_index_[observations_[ka].camera];
+      if (ca < 0) {
+        continue;
+      }
+      Mat63 &Ya = Y[a - point_begin_[j]];
+      Ya = W_[ka] * inverse_V_[j];
+      system.rhs.segment<kCameraSize>(kCameraSize * ca) += Ya * gp;
+      for (int b = point_begin_[j]; b < point_begin_[j + 1]; ++b) {
+        int kb = point_observations_[b];
+        int cb = reduced_index_[observations_[kb].camera];
+        if (cb >= 0) {
+          AddBlock(-Ya * W_[kb].transpose(), ca, cb, &system.values);
+        }
+      }
+    }
+  }
+}
+
+void SparseBundleAdjuster::ReduceShare(int thread) {
+  int begin, end;
+  Share(thread, values_.size(), &begin, &end);
+  for (int i = begin; i < end; ++i) {
+    double sum = 0;
+    for (int t = 0; t < num_threads_; ++t) {
+      sum += systems_[t].values[i];
+    }
+    values_[i] = sum;
+  }
+}
+
+void SparseBundleAdjuster::BackSubstituteShare(int thread) {
+  int begin, end;
+  Share(thread, NumPoints(), &begin, &end);
+  // dp = V^-1 (-gp - W' dc).
+  for (int j = begin; j < end; ++j) {
+    Vec3 b = -point_gradients_[j];
+    for (int o = point_begin_[j]; o < point_begin_[j + 1]; ++o) {
+      int k = point_observations_[o];
+      int c = reduced_index_[observations_[k].camera];
+      if (c >= 0) {
+        b -= W_[k].transpose() * camera_step_.segment<kCameraSize>(
+            kCameraSize * c);
+      }
+    }
+    point_step_.segment<kPointSize>(kPointSize * j) = inverse_V_[j] * b;
+  }
+}
+
+void SparseBundleAdjuster::AddBlock(const Mat6 &block, int row, int column,
+                                    std::vector<double> *values) const {
+  int index = BlockIndex(row, column);
+  int count = block_column_begin_[column + 1] - block_column_begin_[column];
+  double *entries = &(*values)[kCameraSize * kCameraSize *
+                               block_column_begin_[column]] +
+                    kCameraSize * (index - block_column_begin_[column]);
+  for (int s = 0; s < kCameraSize; ++s) {
+    for (int r = 0; r < kCameraSize; ++r) {
+      entries[s * kCameraSize * count + r] += block(r, s);
+    }
+  }
+}
+
+bool SparseBundleAdjuster::ComputeStep(double lambda) {
+  const int num_free = free_cameras_.size();
+  const int n = kCameraSize * num_free;
+
+  WallTimer timer;
+  lambda_ = lambda;
+  systems_.resize(num_threads_);
+  inverse_V_.resize(NumPoints());
+  point_gradients_.resize(NumPoints());
+  W_.resize(NumObservations());
+  RunShares(this, &SparseBundleAdjuster::EliminateShare, num_threads_);
+  const bool iterative = linear_solver_ == Options::ITERATIVE_SCHUR;
+  if (!iterative) {
+    RunShares(this, &SparseBundleAdjuster::ReduceShare, num_threads_);
+  }
+
+  Vec rhs = systems_[0].rhs;
+  for (int t = 1; t < num_threads_; ++t) {
+    rhs += systems_[t].rhs;
+  }
+  vector<Mat6> damped_U(iterative ? num_free : 0);
+  for (int c = 0; c < num_free; ++c) {
+    Mat6 U = systems_[0].U[c];
+    for (int t = 1; t < num_threads_; ++t) {
+      U += systems_[t].U[c];
+    }
+    Damp(lambda, &U);
+    if (iterative) {
+      damped_U[c] = U;
+    } else {
+      AddBlock(U, c, c, &values_);
+    }
+  }
+
+  // Solve the reduced camera system.
+  statistics_.elimination_seconds += timer.ElapsedSeconds();
+  timer.Reset();
+  camera_step_.resize(n);
+  if (iterative) {
+    bool solved = SolveIterativeSchur(damped_U, rhs);
+    statistics_.linear_solver_seconds += timer.ElapsedSeconds();
+    if (!solved) {
+      return false;
+    }
+  } else if (n > 0) {
+    int d = ldl_numeric(n, &column_begin_[0], &rows_[0], &values_[0],
+                        &l_column_begin_[0], &parent_[0], &l_nonzeros_[0],
+                        &l_rows_[0], &l_values_[0], &d_[0], &y_[0],
+                        &pattern_[0], &flag_[0],
+                        &permutation_[0], &inverse_permutation_[0]);
+    if (d != n) {
+      VLOG(3) << "Reduced camera system is singular at column " << d;
+      statistics_.linear_solver_seconds += timer.ElapsedSeconds();
+      return false;
+    }
+    Vec permuted(n);
+    ldl_perm(n, permuted.data(), rhs.data(), &permutation_[0]);
+    ldl_lsolve(n, permuted.data(), &l_column_begin_[0], &l_rows_[0],
+               &l_values_[0]);
+    ldl_dsolve(n, permuted.data(), &d_[0]);
+    ldl_ltsolve(n, permuted.data(), &l_column_begin_[0], &l_rows_[0],
+                &l_values_[0]);
+    ldl_permt(n, camera_step_.data(), permuted.data(), &permutation_[0]);
+    statistics_.linear_solver_seconds += timer.ElapsedSeconds();
+  }
+
+  timer.Reset();
+  point_step_.resize(kPointSize * NumPoints());
+  RunShares(this, &SparseBundleAdjuster::BackSubstituteShare, num_threads_);
+  statistics_.elimination_seconds += timer.ElapsedSeconds();
+  return true;
+}
+
+void SparseBundleAdjuster::SchurPointsShare(int thread) {
+  int begin, end;
+  Share(thread, NumPoints(), &begin, &end);
+  // V^-1 W' x for each point.
+  for (int j = begin; j < end; ++j) {
+    Vec3 y = Vec3::Zero();
+    for (int o = point_begin_[j]; o < point_begin_[j + 1]; ++o) {
+      int k = point_observations_[o];
+      int c = reduced_index_[observations_[k].camera];
+      if (c >= 0) {
+        y += W_[k].transpose() * schur_input_.segment<kCameraSize>(
+            kCameraSize * c);
+      }
+    }
+    schur_points_[j] = inverse_V_[j] * y;
+  }
+}
+
+void SparseBundleAdjuster::SchurCamerasShare(int thread) {
+  int begin, end;
+  Share(thread, free_cameras_.size(), &begin, &end);
+  // (U - W V^-1 W') x for each free camera.
+  for (int c = begin; c < end; ++c) {
+    int camera = free_cameras_[c];
+    Vec6 y = (*damped_U_)[c] *
+             schur_input_.segment<kCameraSize>(kCameraSize * c);
+    for (int o = camera_begin_[camera]; o < camera_begin_[camera + 1]; ++o) {
+      int k = camera_observations_[o];
+      y -= W_[k] * schur_points_[observations_[k].point];
+    }
+    schur_output_.segment<kCameraSize>(kCameraSize * c) = y;
+  }
+}
+
+bool SparseBundleAdjuster::SolveIterativeSchur(const vector<Mat6> &U,
+                                               const Vec &rhs) {
+  const int num_free = free_cameras_.size();
+  const int n = kCameraSize * num_free;
+  camera_step_.setZero(n);
+  if (n == 0) {
+    return true;
+  }
+  inverse_preconditioner_.resize(num_free);
+  for (int c = 0; c < num_free; ++c) {
+    Mat6 M = U[c];
+    if (preconditioner_ == Options::SCHUR_JACOBI) {
+      for (int t = 0; t < num_threads_; ++t) {
+        M += systems_[t].schur_diagonal[c];
+      }
+    }
+    inverse_preconditioner_[c] = M.inverse();
+  }
+  damped_U_ = &U;
+  schur_points_.resize(NumPoints());
+  schur_output_.resize(n);
+
+  // Conjugate gradients on S dc = rhs, from dc = 0.
+  Vec r = rhs, z(n);
+  for (int c = 0; c < num_free; ++c) {
+    z.segment<kCameraSize>(kCameraSize * c) = inverse_preconditioner_[c] *
+        r.segment<kCameraSize>(kCameraSize * c);
+  }
+  schur_input_ = z;
+  double rz = r.dot(z);
+  const double tolerance = linear_tolerance_ * rhs.norm();
+  bool positive = true;
+  int iteration = 0;
+  while (iteration < max_linear_iterations_ && r.norm() > tolerance) {
+    ++iteration;
+    RunShares(this, &SparseBundleAdjuster::SchurPointsShare, num_threads_);
+    RunShares(this, &SparseBundleAdjuster::SchurCamerasShare, num_threads_);
+    double curvature = schur_input_.dot(schur_output_);
+    if (!(curvature > 0)) {
+      positive = false;
+      break;
+    }
+    double alpha = rz / curvature;
+    camera_step_ += alpha * schur_input_;
+    r -= alpha * schur_output_;
+    for (int c = 0; c < num_free; ++c) {
+      z.segment<kCameraSize>(kCameraSize * c) = inverse_preconditioner_[c] *
+          r.segment<kCameraSize>(kCameraSize * c);
+    }
+    double next_rz = r.dot(z);
+    schur_input_ = z + (next_rz / rz) * schur_input_;
+    rz = next_rz;
+  }
+  damped_U_ = NULL;
+  statistics_.linear_iterations += iteration;
+  VLOG(3) << "Conjugate gradients: " << iteration << " iterations, residual "
+          << r.norm() << " for " << rhs.norm();
+  // A direction without curvature on the first iteration leaves no step.
+  return positive || iteration > 1;
+}
+
+void SparseBundleAdjuster::ApplyStep() {
+  for (int c = 0; c < free_cameras_.size(); ++c) {
+    Camera &camera = cameras_[free_cameras_[c]];
+    Vec3 w = camera_step_.segment<3>(kCameraSize * c);
+    if (w.squaredNorm() > 0) {
+      *camera.R = RotationRodrigues(w) * *camera.R;
+    }
+    *camera.t += camera_step_.segment<3>(kCameraSize * c + 3);
+  }
+  for (int j = 0; j < NumPoints(); ++j) {
+    *points_[j] += point_step_.segment<kPointSize>(kPointSize * j);
+  }
+}
+
+double SparseBundleAdjuster::Solve(const Options &options) {
+  LIBMV_SCOPED_TIMER("bundle.sparse");
+  WallTimer total_timer;
+  statistics_ = Statistics();
+  if (NumObservations() == 0) {
+    return 0;
+  }
+  linear_solver_ = options.linear_solver;
+  preconditioner_ = options.preconditioner;
+  max_linear_iterations_ = options.max_linear_iterations;
+  linear_tolerance_ = options.linear_tolerance;
+  if (linear_solver_ == Options::ITERATIVE_SCHUR) {
+    if (!observations_analyzed_) {
+      AnalyzeObservations();
+    }
+  } else if (!analyzed_) {
+    Analyze();
+  }
+  num_threads_ = std::max(options.num_threads, 1);
+  double cost = Cost();
+  VLOG(2) << "Initial RMS: " << sqrt(cost / NumObservations());
+  statistics_.initial_rms = sqrt(cost / NumObservations());
+  statistics_.num_free_cameras = free_cameras_.size();
+  if (linear_solver_ != Options::ITERATIVE_SCHUR) {
+    statistics_.num_blocks = block_rows_.size();
+    statistics_.num_nonzeros = rows_.size();
+    statistics_.num_factor_nonzeros =
+        l_column_begin_.empty() ? 0 : l_column_begin_.back();
+  }
+
+  vector<Mat3> saved_R(free_cameras_.size());
+  vector<Vec3> saved_t(free_cameras_.size());
+  vector<Vec3> saved_X(NumPoints());
+  double lambda = options.initial_lambda;
+  bool linearized = false;
+  int iteration = 0;
+  for (; iteration < options.max_iterations; ++iteration) {
+    if (DeadlineReached(options.deadline)) {
+      statistics_.deadline_reached = true;
+      break;
+    }
+    if (!linearized) {
+      WallTimer timer;
+      Linearize();
+      statistics_.linearization_seconds += timer.ElapsedSeconds();
+      linearized = true;
+    }
+    bool computed = ComputeStep(lambda);
+    if (iteration == 0) {
+      // The workspace is allocated by the first step.
+      memory_.Set(WorkspaceSizeInBytes());
+      ReclaimMemoryOverBudget();
+    }
+    if (!computed) {
+      statistics_.singular_steps++;
+      lambda *= 10;
+      continue;
+    }
+    for (int c = 0; c < free_cameras_.size(); ++c) {
+      saved_R[c] = *cameras_[free_cameras_[c]].R;
+      saved_t[c] = *cameras_[free_cameras_[c]].t;
+    }
+    for (int j = 0; j < NumPoints(); ++j) {
+      saved_X[j] = *points_[j];
+    }
+    ApplyStep();
+    double new_cost = Cost();
+    VLOG(3) << "Iteration " << iteration << ": cost " << new_cost
+            << ", lambda " << lambda;
+    if (new_cost < cost) {
+      double decrease = (cost - new_cost) / cost;
+      cost = new_cost;
+      statistics_.accepted_steps++;
+      statistics_.costs.push_back(cost);
+      lambda = std::max(lambda / 10, 1e-16);
+      linearized = false;
+      if (decrease < options.function_tolerance) {
+        break;
+      }
+    } else {
+      for (int c = 0; c < free_cameras_.size(); ++c) {
+        *cameras_[free_cameras_[c]].R = saved_R[c];
+        *cameras_[free_cameras_[c]].t = saved_t[c];
+      }
+      for (int j = 0; j < NumPoints(); ++j) {
+        *points_[j] = saved_X[j];
+      }
+      lambda *= 10;
+      if (lambda > 1e16) {
+        break;
+      }
+    }
+  }
+  LIBMV_HISTOGRAM("bundle.sparse.iterations", iteration);
+  num_threads_ = 1;
+  double rms = sqrt(cost / NumObservations());
+  VLOG(2) << "Final RMS: " << rms;
+  // A break leaves the loop before the increment, except at the deadline
+  // where the iteration did not start.
+  statistics_.iterations = statistics_.deadline_reached ? iteration :
+      std::min(iteration + 1, options.max_iterations);
+  statistics_.final_rms = rms;
+  statistics_.total_seconds = total_timer.ElapsedSeconds();
+  return rms;
+}
+
+void SparseBundleAdjuster::RefineCamera(int camera) {
+  int &iterations = block_iterations_[camera];
+  int &accepted_steps = block_accepted_steps_[camera];
+  iterations = accepted_steps = 0;
+  block_deadline_reached_[camera] = false;
+  Camera &c = cameras_[camera];
+  int begin = block_begin_[camera], end = block_begin_[camera + 1];
+  if (c.fixed || begin == end) {
+    return;
+  }
+  CameraBlock block;
+  block.K = &c.K;
+  block.R = c.R;
+  block.t = c.t;
+  block.X.reserve(end - begin);
+  block.x.reserve(end - begin);
+  for (int o = begin; o < end; ++o) {
+    const Observation &observation = observations_[block_observations_[o]];
+    block.X.push_back(points_[observation.point]);
+    block.x.push_back(observation.x);
+  }
+  block_deadline_reached_[camera] =
+      MinimizeBlock(block_options_, &block, &iterations, &accepted_steps);
+}
+
+void SparseBundleAdjuster::RefinePoint(int point) {
+  int &iterations = block_iterations_[point];
+  int &accepted_steps = block_accepted_steps_[point];
+  iterations = accepted_steps = 0;
+  block_deadline_reached_[point] = false;
+  int begin = block_begin_[point], end = block_begin_[point + 1];
+  // A single view does not constrain the depth.
+  if (end - begin < 2) {
+    return;
+  }
+  PointBlock block;
+  block.X = points_[point];
+  for (int o = begin; o < end; ++o) {
+    const Observation &observation = observations_[block_observations_[o]];
+    const Camera &camera = cameras_[observation.camera];
+    block.K.push_back(&camera.K);
+    block.R.push_back(camera.R);
+    block.t.push_back(camera.t);
+    block.x.push_back(observation.x);
+  }
+  block_deadline_reached_[point] =
+      MinimizeBlock(block_options_, &block, &iterations, &accepted_steps);
+}
+
+double SparseBundleAdjuster::SolveBlocks(
+    int n,
+    void (SparseBundleAdjuster::*refine)(int),
+    const Options &options) {
+  WallTimer total_timer;
+  statistics_ = Statistics();
+  if (NumObservations() == 0) {
+    return 0;
+  }
+  num_threads_ = std::max(options.num_threads, 1);
+  statistics_.initial_rms = sqrt(Cost() / NumObservations());
+  VLOG(2) << "Initial RMS: " << statistics_.initial_rms;
+
+  block_options_ = options;
+  block_iterations_.resize(n);
+  block_accepted_steps_.resize(n);
+  block_deadline_reached_.resize(n);
+  // The blocks are independent, and each one only writes its own parameters
+  // and counters.
+  CallShare<SparseBundleAdjuster, void (SparseBundleAdjuster::*)(int)>
+      call = { this, refine };
+  ParallelForDynamic(0, n, num_threads_, &call);
+  for (int i = 0; i < n; ++i) {
+    statistics_.iterations += block_iterations_[i];
+    statistics_.accepted_steps += block_accepted_steps_[i];
+    statistics_.deadline_reached |= block_deadline_reached_[i] != 0;
+  }
+
+  double rms = sqrt(Cost() / NumObservations());
+  num_threads_ = 1;
+  VLOG(2) << "Final RMS: " << rms;
+  statistics_.final_rms = rms;
+  statistics_.total_seconds = total_timer.ElapsedSeconds();
+  return rms;
+}
+
+double SparseBundleAdjuster::SolveMotion(const Options &options) {
+  LIBMV_SCOPED_TIMER("bundle.motion");
+  GroupObservations(true, &block_begin_, &block_observations_);
+  int num_free_cameras = 0;
+  for (int i = 0; i < NumCameras(); ++i) {
+    num_free_cameras += !cameras_[i].fixed;
+  }
+  double rms = SolveBlocks(NumCameras(), &SparseBundleAdjuster::RefineCamera,
+                           options);
+  statistics_.num_free_cameras = num_free_cameras;
+  return rms;
+}
+
+double SparseBundleAdjuster::SolveStructure(const Options &options) {
+  LIBMV_SCOPED_TIMER("bundle.structure");
+  GroupObservations(false, &block_begin_, &block_observations_);
+  return SolveBlocks(NumPoints(), &SparseBundleAdjuster::RefinePoint,
+                     options);
+}
+
+}  // namespace libmv
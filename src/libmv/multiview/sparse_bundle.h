@@ -0,0 +1,387 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_MULTIVIEW_SPARSE_BUNDLE_H_
+#define LIBMV_MULTIVIEW_SPARSE_BUNDLE_H_
+
+#include <vector>
+
+#include "libmv/base/memory_budget.h"
+#include "libmv/base/vector.h"
+#include "libmv/numeric/numeric.h"
+
+namespace libmv {
+
+/**
+ * Sparse bundle adjustment of calibrated cameras and 3D points.
+ *
+ * The squared reprojection error of the observations, with the convention
+ * x = K * (R * X + t), is minimized with Levenberg-Marquardt over the camera
+ * rotations and translations and the points; the calibrations are fixed. At
+ * each iteration the points are eliminated from the normal equations (Schur
+ * complement) and the reduced camera system is solved with a sparse LDL^T
+ * factorization (colamd ordering, ldl factorization).
+ *
+ * The fill in of that factorization grows faster than the number of cameras.
+ * For problems too large for it, the ITERATIVE_SCHUR linear solver instead
+ * solves the reduced camera system inexactly with preconditioned conjugate
+ * gradients: the products by the Schur complement are computed from the
+ * Jacobians without forming it, so that the memory is linear in the number
+ * of observations, and each conjugate gradient iteration is parallel over
+ * the points and the cameras.
+ *
+ * The parameters are not copied: the adjuster reads and updates in place the
+ * rotations, translations and points it is given pointers to, which must stay
+ * valid until the last call to Solve(). The ordering and the symbolic
+ * factorization only depend on which cameras see which points; they are
+ * computed once, and again only after cameras, points or observations are
+ * added or a camera is fixed or released.
+ *
+ * Usage:
+ *
+ *   SparseBundleAdjuster bundle;
+ *   int camera = bundle.AddCamera(K, &R, &t);
+ *   int point = bundle.AddPoint(&X);
+ *   bundle.AddObservation(camera, point, x);
+ *   ...
+ *   double rms = bundle.Solve();
+ *
+ * After Solve(), statistics() tells where the time went and how the reduced
+ * camera system filled in, to tune the options and the problem size.
+ *
+ * SolveMotion() and SolveStructure() are fast paths for the problems where
+ * only the cameras or only the points move, such as the localization of a
+ * new camera against a known structure or the refinement of retriangulated
+ * points: each camera or point is then an independent problem of 6 or 3
+ * parameters, and there is no reduced camera system to factorize.
+ */
+class SparseBundleAdjuster {
+ public:
+  struct Options {
+    Options();
+
+    // Maximum number of Levenberg-Marquardt iterations.
+    int max_iterations;
+
+    // Initial damping, relative to the diagonal of the normal equations.
+    double initial_lambda;
+
+    // Stop when an accepted step decreases the cost by less than this
+    // fraction.
+    double function_tolerance;
+
+    // Number of threads computing the residuals and the Jacobians and
+    // assembling the reduced camera system. For a given number of threads
+    // the result is deterministic.
+    int num_threads;
+
+    enum LinearSolver {
+      // Sparse LDL^T factorization of the reduced camera system.
+      SPARSE_LDLT,
+      // Conjugate gradients on the implicit reduced camera system.
+      ITERATIVE_SCHUR
+    };
+    LinearSolver linear_solver;
+
+    // Preconditioner of ITERATIVE_SCHUR: BLOCK_JACOBI inverts the 6x6
+    // blocks of the cameras in the normal equations, and SCHUR_JACOBI the
+    // diagonal blocks of the reduced camera system, which costs one more
+    // pass over the points but takes fewer iterations.
+    enum Preconditioner {
+      BLOCK_JACOBI,
+      SCHUR_JACOBI
+    };
+    Preconditioner preconditioner;
+
+    // Conjugate gradients of ITERATIVE_SCHUR stop after this many
+    // iterations, or when the norm of the residual of the reduced camera
+    // system drops below this fraction of the norm of its right hand side.
+    int max_linear_iterations;
+    double linear_tolerance;
+
+    // WallTimeInSeconds() at which the iterations stop, the parameters being
+    // left at the best ones found so far; 0, the default, has no deadline.
+    // See DeadlineInSeconds(). SolveMotion() and SolveStructure() check it
+    // in each block.
+    double deadline;
+  };
+
+  // What the last call to Solve() did.
+  struct Statistics {
+    Statistics();
+
+    // Levenberg-Marquardt iterations, the steps which decreased the cost and
+    // were kept, and the iterations whose reduced system was singular.
+    int iterations;
+    int accepted_steps;
+    int singular_steps;
+
+    // Conjugate gradient iterations of ITERATIVE_SCHUR, over all the steps.
+    int linear_iterations;
+
+    // Root mean square reprojection errors, in pixels, and the cost (sum of
+    // the squared errors) after each accepted step.
+    double initial_rms;
+    double final_rms;
+    std::vector<double> costs;
+
+    // Seconds spent computing the residuals and the Jacobians, eliminating
+    // the points and assembling the reduced camera system, factorizing and
+    // solving it, and in the whole of Solve().
+    double linearization_seconds;
+    double elimination_seconds;
+    double linear_solver_seconds;
+    double total_seconds;
+
+    // Size of the reduced camera system: the free cameras, its nonzero 6x6
+    // blocks and scalars (both triangles), and the nonzeros of the strictly
+    // lower triangular factor L. ITERATIVE_SCHUR forms neither, and leaves
+    // the last three at 0.
+    int num_free_cameras;
+    int num_blocks;
+    int num_nonzeros;
+    int num_factor_nonzeros;
+
+    // Whether the iterations stopped at the deadline of the options.
+    bool deadline_reached;
+  };
+
+  SparseBundleAdjuster();
+
+  // Adds a camera and returns its index. K is copied; R and t are updated by
+  // Solve().
+  int AddCamera(const Mat3 &K, Mat3 *R, Vec3 *t);
+
+  // A fixed camera constrains the points it sees, but is not optimized.
+  void SetCameraFixed(int camera, bool fixed);
+  bool IsCameraFixed(int camera) const;
+
+  // Adds a point and returns its index. X is updated by Solve().
+  int AddPoint(Vec3 *X);
+
+  // The projection of point in camera is observed at x (in pixels).
+  void AddObservation(int camera, int point, const Vec2 &x);
+
+  int NumCameras() const      { return cameras_.size(); }
+  int NumPoints() const       { return points_.size(); }
+  int NumObservations() const { return observations_.size(); }
+
+  // Computes the ordering and the symbolic factorization of the reduced
+  // camera system. Solve() calls it when needed, unless the linear solver
+  // is ITERATIVE_SCHUR, which needs neither.
+  void Analyze();
+
+  // Runs the optimization and returns the final root mean square
+  // reprojection error, in pixels.
+  double Solve(const Options &options = Options());
+
+  // Motion only adjustment: the points are fixed, and each free camera is
+  // refined alone from its observations, the cameras in parallel on
+  // options.num_threads threads. Returns the final root mean square
+  // reprojection error, in pixels.
+  double SolveMotion(const Options &options = Options());
+
+  // Structure only adjustment: the cameras are fixed, and each point seen by
+  // at least two observations is refined alone, the points in parallel on
+  // options.num_threads threads. Returns the final root mean square
+  // reprojection error, in pixels.
+  double SolveStructure(const Options &options = Options());
+
+  // Root mean square reprojection error of the current parameters.
+  double RootMeanSquareError() const;
+
+  const Statistics &statistics() const { return statistics_; }
+
+ private:
+  struct Camera {
+    Mat3 K;
+    Mat3 *R;
+    Vec3 *t;
+    bool fixed;
+  };
+  struct Observation {
+    int camera;
+    int point;
+    Vec2 x;
+  };
+
+  typedef Eigen::Matrix<double, 2, 6> Mat26;
+  typedef Eigen::Matrix<double, 6, 3> Mat63;
+  typedef Eigen::Matrix<double, 6, 6> Mat6;
+
+  // Part of the reduced camera system accumulated by one thread.
+  struct CameraSystem {
+    vector<Mat6> U;               // Diagonal blocks J_c' J_c.
+    Vec rhs;
+    std::vector<double> values;   // Schur complement, laid out as values_.
+    vector<Mat6> schur_diagonal;  // Diagonal blocks of -W V^-1 W', for the
+                                  // SCHUR_JACOBI preconditioner.
+  };
+
+  // Sum of the squared reprojection errors.
+  double Cost() const;
+
+  // Computes the residuals and the Jacobians at the current parameters.
+  void Linearize();
+
+  // Builds the normal equations from the last linearization, with the
+  // diagonal augmented by lambda, reduces them to the cameras and computes
+  // camera_step_ and point_step_. Returns false if the reduced system could
+  // not be factorized.
+  bool ComputeStep(double lambda);
+
+  // Solves the reduced camera system for camera_step_ by preconditioned
+  // conjugate gradients, from the damped blocks of the cameras. Returns
+  // false if the system is not positive definite.
+  bool SolveIterativeSchur(const vector<Mat6> &U, const Vec &rhs);
+
+  // Frees the cameras and groups the observations, the part of Analyze()
+  // that ITERATIVE_SCHUR needs.
+  void AnalyzeObservations();
+
+  // Adds the last step to the parameters.
+  void ApplyStep();
+
+  // Groups the indices of the observations by camera or by point: those of
+  // camera or point i are observations[begin[i]], ...,
+  // observations[begin[i + 1] - 1].
+  void GroupObservations(bool by_camera,
+                         std::vector<int> *begin,
+                         std::vector<int> *observations) const;
+
+  // The problems of SolveMotion() and SolveStructure(), minimized with
+  // block_options_ from the observations grouped in block_begin_ and
+  // block_observations_.
+  void RefineCamera(int camera);
+  void RefinePoint(int point);
+
+  // Runs RefineCamera() or RefinePoint() on the n blocks, and fills the
+  // statistics.
+  double SolveBlocks(int n, void (SparseBundleAdjuster::*refine)(int),
+                     const Options &options);
+
+  // The work of the stages above, split in num_threads_ shares; each method
+  // does the share of the given thread (see RunShares() in the .cc).
+  void Share(int thread, int n, int *begin, int *end) const;
+  void CostShare(int thread) const;
+  void LinearizeShare(int thread);
+  void EliminateShare(int thread);
+  void ReduceShare(int thread);
+  void BackSubstituteShare(int thread);
+  // The product schur_output_ = S schur_input_ by the reduced camera system
+  // S, in a pass over the points then one over the free cameras.
+  void SchurPointsShare(int thread);
+  void SchurCamerasShare(int thread);
+
+  // Position of block (row, column) of the reduced camera system in the
+  // block column storage.
+  int BlockIndex(int row, int column) const;
+
+  // The memory allocated for the reduced system, its factorization and the
+  // linearization.
+  long long WorkspaceSizeInBytes() const;
+
+  // Adds block to block (row, column) of values, laid out as values_.
+  void AddBlock(const Mat6 &block, int row, int column,
+                std::vector<double> *values) const;
+
+  vector<Camera> cameras_;
+  vector<Vec3 *> points_;
+  vector<Observation> observations_;
+  bool analyzed_;
+  bool observations_analyzed_;
+
+  // Cameras which are optimized, and the index of each camera in the reduced
+  // system (-1 for fixed cameras).
+  std::vector<int> free_cameras_;
+  std::vector<int> reduced_index_;
+
+  // Observations grouped by point and by camera.
+  std::vector<int> point_begin_;
+  std::vector<int> point_observations_;
+  std::vector<int> camera_begin_;
+  std::vector<int> camera_observations_;
+
+  // Pattern of the 6x6 blocks of the reduced camera system, by block column;
+  // the rows of each column are sorted.
+  std::vector<int> block_column_begin_;
+  std::vector<int> block_rows_;
+
+  // Scalar pattern and values of the reduced camera system, in compressed
+  // column form.
+  std::vector<int> column_begin_;
+  std::vector<int> rows_;
+  std::vector<double> values_;
+
+  // Fill reducing ordering and LDL^T factorization of the reduced camera
+  // system (see ldl.h).
+  std::vector<int> permutation_, inverse_permutation_;
+  std::vector<int> l_column_begin_, l_rows_, parent_, l_nonzeros_;
+  std::vector<int> flag_, pattern_;
+  std::vector<double> l_values_, d_, y_;
+
+  // Residuals and Jacobians of the observations, from Linearize().
+  vector<Vec2> residuals_;
+  vector<Mat26> camera_jacobians_;
+  vector<Mat23> point_jacobians_;
+
+  // State of ComputeStep(): the per thread systems, the elimination of the
+  // points and the step.
+  int num_threads_;
+  double lambda_;
+  std::vector<CameraSystem> systems_;
+  vector<Mat3> inverse_V_;
+  vector<Vec3> point_gradients_;
+  vector<Mat63> W_;
+  Vec camera_step_;
+  Vec point_step_;
+  mutable std::vector<double> thread_costs_;
+
+  // State of SolveIterativeSchur(): the options, the damped camera blocks,
+  // the inverse preconditioner blocks, the vectors of the Schur products
+  // and the intermediate point vectors of the products.
+  Options::LinearSolver linear_solver_;
+  Options::Preconditioner preconditioner_;
+  int max_linear_iterations_;
+  double linear_tolerance_;
+  const vector<Mat6> *damped_U_;
+  vector<Mat6> inverse_preconditioner_;
+  Vec schur_input_;
+  Vec schur_output_;
+  vector<Vec3> schur_points_;
+
+  // State of SolveMotion() and SolveStructure(), and the iterations, the
+  // accepted steps and whether the deadline stopped each block.
+  Options block_options_;
+  std::vector<int> block_begin_;
+  std::vector<int> block_observations_;
+  std::vector<int> block_iterations_;
+  std::vector<int> block_accepted_steps_;
+  std::vector<char> block_deadline_reached_;
+
+  // The workspace, as MEMORY_BUNDLE, updated by Solve().
+  MemoryUsage memory_;
+
+  Statistics statistics_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_MULTIVIEW_SPARSE_BUNDLE_H_
@@ -0,0 +1,441 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/base/timer.h"
+#include "libmv/multiview/projection.h"
+#include "libmv/multiview/sparse_bundle.h"
+#include "libmv/multiview/test_data_sets.h"
+#include "libmv/numeric/numeric.h"
+#include "testing/testing.h"
+
+namespace {
+
+using namespace libmv;
+
+// Perturbs the motion and the structure of a data set.
+void AddNoise(vector<Mat3> *R, vector<Vec3> *t, Mat3X *X) {
+  for (int i = 0; i < R->size(); ++i) {
+    (*R)[i] *= RotationAroundX(0.02 * (i % 3))
+             * RotationAroundY(-0.03)
+             * RotationAroundZ(0.01 * (i % 2));
+    (*t)[i] += Vec3::Random() * 0.1;
+  }
+  *X += Mat3X::Random(3, X->cols()) * 0.1;
+}
+
+double MaxReprojectionError(const NViewDataSet &d,
+                            const vector<Mat3> &R,
+                            const vector<Vec3> &t,
+                            const Mat3X &X) {
+  double max_error = 0;
+  for (int i = 0; i < R.size(); ++i) {
+    Mat34 P;
+    P_From_KRt(d.K[i], R[i], t[i], &P);
+    Mat2X error = d.x[i] - Project(P, X, d.x_ids[i]);
+    max_error = std::max(max_error, FrobeniusNorm(error));
+  }
+  return max_error;
+}
+
+void AddProblem(const NViewDataSet &d,
+                vector<Mat3> *R,
+                vector<Vec3> *t,
+                vector<Vec3> *X,
+                SparseBundleAdjuster *bundle) {
+  for (int i = 0; i < R->size(); ++i) {
+    EXPECT_EQ(i, bundle->AddCamera(d.K[i], &(*R)[i], &(*t)[i]));
+  }
+  for (int j = 0; j < X->size(); ++j) {
+    EXPECT_EQ(j, bundle->AddPoint(&(*X)[j]));
+  }
+  for (int i = 0; i < R->size(); ++i) {
+    for (int k = 0; k < d.x_ids[i].size(); ++k) {
+      bundle->AddObservation(i, d.x_ids[i][k], d.x[i].col(k));
+    }
+  }
+}
+
+TEST(SparseBundleAdjuster, NViews) {
+  int nviews = 5;
+  int npoints = 30;
+  NViewDataSet d = NRealisticCamerasSparse(nviews, npoints);
+  vector<Mat3> R = d.R;
+  vector<Vec3> t = d.t;
+  Mat3X X = d.X;
+  AddNoise(&R, &t, &X);
+
+  vector<Vec3> points(npoints);
+  for (int j = 0; j < npoints; ++j) {
+    points[j] = X.col(j);
+  }
+  SparseBundleAdjuster bundle;
+  AddProblem(d, &R, &t, &points, &bundle);
+  EXPECT_GT(bundle.RootMeanSquareError(), 1);
+
+  double rms = bundle.Solve();
+  EXPECT_LT(rms, 1e-6);
+  EXPECT_NEAR(rms, bundle.RootMeanSquareError(), 1e-12);
+
+  // The parameters were updated in place.
+  for (int j = 0; j < npoints; ++j) {
+    X.col(j) = points[j];
+  }
+  EXPECT_LT(MaxReprojectionError(d, R, t, X), 1e-5);
+  for (int i = 0; i < nviews; ++i) {
+    EXPECT_NEAR(1, R[i].determinant(), 1e-9);
+  }
+}
+
+TEST(SparseBundleAdjuster, StatisticsDescribeTheLastSolve) {
+  int nviews = 5;
+  int npoints = 30;
+  NViewDataSet d = NRealisticCamerasSparse(nviews, npoints);
+  vector<Mat3> R = d.R;
+  vector<Vec3> t = d.t;
+  Mat3X X = d.X;
+  AddNoise(&R, &t, &X);
+
+  vector<Vec3> points(npoints);
+  for (int j = 0; j < npoints; ++j) {
+    points[j] = X.col(j);
+  }
+  SparseBundleAdjuster bundle;
+  AddProblem(d, &R, &t, &points, &bundle);
+  double initial_rms = bundle.RootMeanSquareError();
+  double rms = bundle.Solve();
+
+  const SparseBundleAdjuster::Statistics &statistics = bundle.statistics();
+  EXPECT_DOUBLE_EQ(initial_rms, statistics.initial_rms);
+  EXPECT_DOUBLE_EQ(rms, statistics.final_rms);
+  EXPECT_GT(statistics.accepted_steps, 0);
+  EXPECT_LE(statistics.accepted_steps + statistics.singular_steps,
+            statistics.iterations);
+  ASSERT_EQ(statistics.accepted_steps, statistics.costs.size());
+  for (int i = 1; i < statistics.costs.size(); ++i) {
+    EXPECT_LT(statistics.costs[i], statistics.costs[i - 1]);
+  }
+  EXPECT_NEAR(rms * rms * bundle.NumObservations(),
+              statistics.costs.back(), 1e-12);
+  EXPECT_EQ(nviews, statistics.num_free_cameras);
+  EXPECT_EQ(36 * statistics.num_blocks, statistics.num_nonzeros);
+  EXPECT_LE(statistics.num_factor_nonzeros, 36 * nviews * (nviews - 1) / 2 +
+                                            15 * nviews);
+  EXPECT_LE(statistics.linear_solver_seconds, statistics.total_seconds);
+
+  // Solving again starts over.
+  bundle.Solve();
+  EXPECT_DOUBLE_EQ(rms, bundle.statistics().initial_rms);
+}
+
+TEST(SparseBundleAdjuster, FixedCamerasAreNotMoved) {
+  int nviews = 6;
+  int npoints = 40;
+  NViewDataSet d = NRealisticCamerasSparse(nviews, npoints);
+  vector<Mat3> R = d.R;
+  vector<Vec3> t = d.t;
+  Mat3X X = d.X;
+  AddNoise(&R, &t, &X);
+  // The first two cameras are exact, and fixed.
+  for (int i = 0; i < 2; ++i) {
+    R[i] = d.R[i];
+    t[i] = d.t[i];
+  }
+
+  vector<Vec3> points(npoints);
+  for (int j = 0; j < npoints; ++j) {
+    points[j] = X.col(j);
+  }
+  SparseBundleAdjuster bundle;
+  AddProblem(d, &R, &t, &points, &bundle);
+  bundle.SetCameraFixed(0, true);
+  bundle.SetCameraFixed(1, true);
+  EXPECT_TRUE(bundle.IsCameraFixed(1));
+  EXPECT_FALSE(bundle.IsCameraFixed(2));
+
+  EXPECT_LT(bundle.Solve(), 1e-6);
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ(d.R[i], R[i]);
+    EXPECT_EQ(d.t[i], t[i]);
+  }
+  // With two exact cameras the gauge is fixed, and the solution is the
+  // ground truth.
+  for (int i = 2; i < nviews; ++i) {
+    EXPECT_MATRIX_NEAR(d.R[i], R[i], 1e-6);
+    EXPECT_MATRIX_NEAR(d.t[i], t[i], 1e-6);
+  }
+}
+
+TEST(SparseBundleAdjuster, SolveAgainReusesTheAnalysis) {
+  int nviews = 4;
+  int npoints = 25;
+  NViewDataSet d = NRealisticCamerasSparse(nviews, npoints);
+  vector<Mat3> R = d.R;
+  vector<Vec3> t = d.t;
+  Mat3X X = d.X;
+  vector<Vec3> points(npoints);
+  for (int j = 0; j < npoints; ++j) {
+    points[j] = X.col(j);
+  }
+  SparseBundleAdjuster bundle;
+  AddProblem(d, &R, &t, &points, &bundle);
+  EXPECT_LT(bundle.Solve(), 1e-6);
+
+  // Perturb the parameters in place and solve again.
+  AddNoise(&R, &t, &X);
+  for (int j = 0; j < npoints; ++j) {
+    points[j] += Vec3(0.05, -0.02, 0.03);
+  }
+  EXPECT_GT(bundle.RootMeanSquareError(), 1);
+  EXPECT_LT(bundle.Solve(), 1e-6);
+}
+
+TEST(SparseBundleAdjuster, ThreadsGiveTheSameSolution) {
+  int nviews = 6;
+  int npoints = 40;
+  NViewDataSet d = NRealisticCamerasSparse(nviews, npoints);
+  vector<Mat3> R = d.R;
+  vector<Vec3> t = d.t;
+  Mat3X X = d.X;
+  AddNoise(&R, &t, &X);
+
+  vector<Mat3> serial_R = R, threaded_R = R;
+  vector<Vec3> serial_t = t, threaded_t = t;
+  vector<Vec3> serial_X(npoints), threaded_X(npoints);
+  for (int j = 0; j < npoints; ++j) {
+    serial_X[j] = threaded_X[j] = X.col(j);
+  }
+  SparseBundleAdjuster serial, threaded;
+  AddProblem(d, &serial_R, &serial_t, &serial_X, &serial);
+  AddProblem(d, &threaded_R, &threaded_t, &threaded_X, &threaded);
+
+  SparseBundleAdjuster::Options options;
+  options.max_iterations = 3;
+  serial.Solve(options);
+  options.num_threads = 3;
+  threaded.Solve(options);
+
+  // Only the order of the summations differs.
+  for (int i = 0; i < nviews; ++i) {
+    EXPECT_MATRIX_NEAR(serial_R[i], threaded_R[i], 1e-9);
+    EXPECT_MATRIX_NEAR(serial_t[i], threaded_t[i], 1e-9);
+  }
+  for (int j = 0; j < npoints; ++j) {
+    EXPECT_MATRIX_NEAR(serial_X[j], threaded_X[j], 1e-9);
+  }
+
+  options.max_iterations = 50;
+  EXPECT_LT(threaded.Solve(options), 1e-6);
+}
+
+TEST(SparseBundleAdjuster, IterativeSchurConverges) {
+  int nviews = 8;
+  int npoints = 60;
+  NViewDataSet d = NRealisticCamerasSparse(nviews, npoints);
+  for (int p = 0; p < 2; ++p) {
+    vector<Mat3> R = d.R;
+    vector<Vec3> t = d.t;
+    Mat3X X = d.X;
+    AddNoise(&R, &t, &X);
+    // Two exact cameras fix the gauge.
+    for (int i = 0; i < 2; ++i) {
+      R[i] = d.R[i];
+      t[i] = d.t[i];
+    }
+    vector<Vec3> points(npoints);
+    for (int j = 0; j < npoints; ++j) {
+      points[j] = X.col(j);
+    }
+    SparseBundleAdjuster bundle;
+    AddProblem(d, &R, &t, &points, &bundle);
+    bundle.SetCameraFixed(0, true);
+    bundle.SetCameraFixed(1, true);
+
+    SparseBundleAdjuster::Options options;
+    options.linear_solver = SparseBundleAdjuster::Options::ITERATIVE_SCHUR;
+    options.preconditioner = p == 0 ?
+        SparseBundleAdjuster::Options::BLOCK_JACOBI :
+        SparseBundleAdjuster::Options::SCHUR_JACOBI;
+    options.num_threads = 3;
+    EXPECT_LT(bundle.Solve(options), 1e-6);
+    for (int i = 2; i < nviews; ++i) {
+      EXPECT_MATRIX_NEAR(d.R[i], R[i], 1e-6);
+      EXPECT_MATRIX_NEAR(d.t[i], t[i], 1e-6);
+    }
+
+    // The reduced camera system was never formed.
+    const SparseBundleAdjuster::Statistics &statistics = bundle.statistics();
+    EXPECT_GT(statistics.linear_iterations, 0);
+    EXPECT_EQ(nviews - 2, statistics.num_free_cameras);
+    EXPECT_EQ(0, statistics.num_blocks);
+    EXPECT_EQ(0, statistics.num_factor_nonzeros);
+  }
+}
+
+TEST(SparseBundleAdjuster, IterativeSchurStepsMatchTheDirectSolver) {
+  int nviews = 6;
+  int npoints = 40;
+  NViewDataSet d = NRealisticCamerasSparse(nviews, npoints);
+  vector<Mat3> R = d.R;
+  vector<Vec3> t = d.t;
+  Mat3X X = d.X;
+  AddNoise(&R, &t, &X);
+
+  vector<Mat3> direct_R = R, iterative_R = R;
+  vector<Vec3> direct_t = t, iterative_t = t;
+  vector<Vec3> direct_X(npoints), iterative_X(npoints);
+  for (int j = 0; j < npoints; ++j) {
+    direct_X[j] = iterative_X[j] = X.col(j);
+  }
+  SparseBundleAdjuster direct, iterative;
+  AddProblem(d, &direct_R, &direct_t, &direct_X, &direct);
+  AddProblem(d, &iterative_R, &iterative_t, &iterative_X, &iterative);
+
+  // With a tight tolerance the steps are the same.
+  SparseBundleAdjuster::Options options;
+  options.max_iterations = 2;
+  direct.Solve(options);
+  options.linear_solver = SparseBundleAdjuster::Options::ITERATIVE_SCHUR;
+  options.linear_tolerance = 1e-12;
+  options.max_linear_iterations = 1000;
+  iterative.Solve(options);
+  for (int i = 0; i < nviews; ++i) {
+    EXPECT_MATRIX_NEAR(direct_R[i], iterative_R[i], 1e-6);
+    EXPECT_MATRIX_NEAR(direct_t[i], iterative_t[i], 1e-6);
+  }
+  for (int j = 0; j < npoints; ++j) {
+    EXPECT_MATRIX_NEAR(direct_X[j], iterative_X[j], 1e-6);
+  }
+}
+
+TEST(SparseBundleAdjuster, SolveMotionRefinesTheCamerasAlone) {
+  int nviews = 5;
+  int npoints = 30;
+  NViewDataSet d = NRealisticCamerasSparse(nviews, npoints);
+  vector<Mat3> R = d.R;
+  vector<Vec3> t = d.t;
+  Mat3X X = d.X;
+  AddNoise(&R, &t, &X);
+  // The points are exact, and the first camera fixed.
+  vector<Vec3> points(npoints);
+  for (int j = 0; j < npoints; ++j) {
+    points[j] = d.X.col(j);
+  }
+  SparseBundleAdjuster bundle;
+  AddProblem(d, &R, &t, &points, &bundle);
+  bundle.SetCameraFixed(0, true);
+  Mat3 R0 = R[0];
+  Vec3 t0 = t[0];
+
+  SparseBundleAdjuster::Options options;
+  options.num_threads = 3;
+  bundle.SolveMotion(options);
+  for (int j = 0; j < npoints; ++j) {
+    EXPECT_EQ(d.X.col(j), points[j]);
+  }
+  EXPECT_EQ(R0, R[0]);
+  EXPECT_EQ(t0, t[0]);
+  for (int i = 1; i < nviews; ++i) {
+    EXPECT_MATRIX_NEAR(d.R[i], R[i], 1e-6);
+    EXPECT_MATRIX_NEAR(d.t[i], t[i], 1e-6);
+    EXPECT_NEAR(1, R[i].determinant(), 1e-9);
+  }
+  EXPECT_EQ(nviews - 1, bundle.statistics().num_free_cameras);
+  EXPECT_GT(bundle.statistics().accepted_steps, 0);
+}
+
+TEST(SparseBundleAdjuster, SolveStructureRefinesThePointsAlone) {
+  int nviews = 4;
+  int npoints = 30;
+  NViewDataSet d = NRealisticCamerasSparse(nviews, npoints);
+  vector<Mat3> R = d.R;
+  vector<Vec3> t = d.t;
+  vector<Vec3> points(npoints);
+  for (int j = 0; j < npoints; ++j) {
+    points[j] = d.X.col(j) + Vec3(0.05, -0.02, 0.03);
+  }
+  SparseBundleAdjuster bundle;
+  AddProblem(d, &R, &t, &points, &bundle);
+  EXPECT_GT(bundle.RootMeanSquareError(), 1);
+
+  SparseBundleAdjuster::Options options;
+  options.num_threads = 3;
+  bundle.SolveStructure(options);
+  for (int i = 0; i < nviews; ++i) {
+    EXPECT_EQ(d.R[i], R[i]);
+    EXPECT_EQ(d.t[i], t[i]);
+  }
+  // The points seen once are left where they were.
+  std::vector<int> num_views(npoints, 0);
+  for (int i = 0; i < nviews; ++i) {
+    for (int k = 0; k < d.x_ids[i].size(); ++k) {
+      ++num_views[d.x_ids[i][k]];
+    }
+  }
+  for (int j = 0; j < npoints; ++j) {
+    if (num_views[j] >= 2) {
+      EXPECT_MATRIX_NEAR(d.X.col(j), points[j], 1e-6);
+    } else {
+      EXPECT_EQ(d.X.col(j) + Vec3(0.05, -0.02, 0.03), points[j]);
+    }
+  }
+}
+
+TEST(SparseBundleAdjuster, StopsAtTheDeadline) {
+  int nviews = 4;
+  int npoints = 30;
+  NViewDataSet d = NRealisticCamerasSparse(nviews, npoints);
+  vector<Mat3> R = d.R;
+  vector<Vec3> t = d.t;
+  Mat3X X = d.X;
+  AddNoise(&R, &t, &X);
+  vector<Vec3> points(npoints);
+  for (int j = 0; j < npoints; ++j) {
+    points[j] = X.col(j);
+  }
+  SparseBundleAdjuster bundle;
+  AddProblem(d, &R, &t, &points, &bundle);
+  bundle.SetCameraFixed(0, true);
+  double initial_rms = bundle.RootMeanSquareError();
+
+  // A deadline in the past leaves the parameters as they are.
+  SparseBundleAdjuster::Options options;
+  options.deadline = 1e-9;
+  EXPECT_EQ(initial_rms, bundle.Solve(options));
+  EXPECT_TRUE(bundle.statistics().deadline_reached);
+  EXPECT_EQ(0, bundle.statistics().iterations);
+  EXPECT_EQ(initial_rms, bundle.SolveMotion(options));
+  EXPECT_TRUE(bundle.statistics().deadline_reached);
+  EXPECT_EQ(0, bundle.statistics().iterations);
+
+  // A deadline far away does not change the solution.
+  options.deadline = DeadlineInSeconds(3600);
+  EXPECT_LT(bundle.Solve(options), 1e-6);
+  EXPECT_FALSE(bundle.statistics().deadline_reached);
+}
+
+TEST(SparseBundleAdjuster, Empty) {
+  SparseBundleAdjuster bundle;
+  EXPECT_EQ(0, bundle.Solve());
+  EXPECT_EQ(0, bundle.RootMeanSquareError());
+  EXPECT_EQ(0, bundle.SolveMotion());
+  EXPECT_EQ(0, bundle.SolveStructure());
+}
+
+}  // namespace
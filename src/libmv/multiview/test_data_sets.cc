@@ -18,7 +18,10 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
+#include <vector>
 
 #include "libmv/numeric/numeric.h"
 #include "libmv/multiview/projection.h"
@@ -192,5 +195,111 @@ NViewDataSet NRealisticCamerasSparse(int nviews, int npoints,
   return d;
 }
 
+SyntheticVideoOptions::SyntheticVideoOptions()
+    : num_frames(30),
+      num_points(200),
+      width(640),
+      height(480),
+      focal(500),
+      path_length(2),
+      depth(6),
+      noise(0),
+      outlier_ratio(0),
+      min_track_length(5) {
+}
+
+namespace {
+
+// Uniform in [0, 1).
+double RandomUniform() {
+  return rand() / (RAND_MAX + 1.0);
+}
+
+// Standard normal, by the Box-Muller transform.
+double RandomGaussian() {
+  double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+  double v = (rand() + 1.0) / (RAND_MAX + 2.0);
+  return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+}  // namespace
+
+NViewDataSet SyntheticVideo(const SyntheticVideoOptions &options) {
+  int nframes = options.num_frames;
+  int npoints = options.num_points;
+  assert(nframes >= 2);
+  int min_length = std::max(1, std::min(options.min_track_length, nframes));
+
+  NViewDataSet d;
+  d.n = nframes;
+  d.K.resize(nframes);
+  d.R.resize(nframes);
+  d.t.resize(nframes);
+  d.C.resize(nframes);
+  d.x.resize(nframes);
+  d.x_ids.resize(nframes);
+
+  Vec3 center;
+  center << 0, 0, options.depth;
+  d.X.resize(3, npoints);
+  d.X.setRandom();
+  d.X *= 0.5 * options.depth;
+  d.X.colwise() += center;
+
+  // The frames at which every point is tracked.
+  std::vector<int> first(npoints), last(npoints);
+  for (int j = 0; j < npoints; ++j) {
+    int length = min_length + static_cast<int>(
+        RandomUniform() * (nframes - min_length + 1));
+    first[j] = static_cast<int>(RandomUniform() * (nframes - length + 1));
+    last[j] = first[j] + length - 1;
+  }
+
+  Mat3 K;
+  K << options.focal, 0,             options.width / 2.0 - 0.5,
+       0,             options.focal, options.height / 2.0 - 0.5,
+       0,             0,             1;
+  for (int i = 0; i < nframes; ++i) {
+    double s = double(i) / (nframes - 1) - 0.5;
+    d.C[i] << s * options.path_length, 0, 0;
+    d.K[i] = K;
+    d.R[i] = LookAt(center - d.C[i]);
+    d.t[i] = -d.R[i] * d.C[i];
+
+    Mat34 P = d.P(i);
+    std::vector<int> ids;
+    std::vector<Vec2> projections;
+    for (int j = 0; j < npoints; ++j) {
+      if (i < first[j] || i > last[j]) {
+        continue;
+      }
+      Vec3 X = d.X.col(j);
+      Vec3 h = P * EuclideanToHomogeneous(X);
+      if (h(2) <= 0) {
+        continue;
+      }
+      Vec2 x = HomogeneousToEuclidean(h);
+      x(0) += options.noise * RandomGaussian();
+      x(1) += options.noise * RandomGaussian();
+      if (x(0) < 0 || x(0) > options.width - 1 ||
+          x(1) < 0 || x(1) > options.height - 1) {
+        continue;
+      }
+      if (RandomUniform() < options.outlier_ratio) {
+        x << RandomUniform() * (options.width - 1),
+             RandomUniform() * (options.height - 1);
+      }
+      ids.push_back(j);
+      projections.push_back(x);
+    }
+    d.x[i].resize(2, projections.size());
+    d.x_ids[i].resize(ids.size());
+    for (int k = 0; k < ids.size(); ++k) {
+      d.x[i].col(k) = projections[k];
+      d.x_ids[i][k] = ids[k];
+    }
+  }
+  return d;
+}
 
 }  // namespace libmv
@@ -101,6 +101,42 @@ NViewDataSet NRealisticCamerasSparse(int nviews, int npoints,
                                      const nViewDatasetConfigator
                                        config = nViewDatasetConfigator());
 
+// Options of SyntheticVideo().
+struct SyntheticVideoOptions {
+  SyntheticVideoOptions();
+
+  int num_frames;
+  int num_points;
+
+  // Size of the images, in pixels, and focal length of the camera, whose
+  // principal point is at the center of the images.
+  int width, height;
+  double focal;
+
+  // The camera moves along the x axis, by path_length in total, while looking
+  // at the center of the scene, which is at depth from the path. The points
+  // are uniformly distributed in a cube of side depth around the center.
+  double path_length;
+  double depth;
+
+  // Standard deviation of the noise added to the projections, in pixels.
+  double noise;
+
+  // Fraction of the observations replaced by a random position in the image,
+  // as a tracker that jumped to another feature would give.
+  double outlier_ratio;
+
+  // Every point is tracked for a random interval of at least min_track_length
+  // consecutive frames, as if it was occluded, or not detected, at the other
+  // frames. Its projections outside of the images are dropped as well.
+  int min_track_length;
+};
+
+// A video of a static scene taken by a moving camera, as a sparse data set
+// whose view i is the frame i. All the cameras have the same K.
+NViewDataSet SyntheticVideo(const SyntheticVideoOptions &options =
+                              SyntheticVideoOptions());
+
 } // namespace libmv
 
 #endif  // LIBMV_MULTIVIEW_TEST_DATA_SETS_H_
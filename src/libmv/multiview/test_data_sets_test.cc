@@ -0,0 +1,107 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstdlib>
+#include <vector>
+
+#include "libmv/multiview/projection.h"
+#include "libmv/multiview/test_data_sets.h"
+#include "libmv/numeric/numeric.h"
+#include "testing/testing.h"
+
+namespace {
+
+using namespace libmv;
+
+TEST(SyntheticVideo, NoiseFreeProjectionsAreInTheImages) {
+  srand(1);
+  SyntheticVideoOptions options;
+  NViewDataSet d = SyntheticVideo(options);
+  EXPECT_EQ(options.num_frames, d.n);
+  int num_observations = 0;
+  for (int i = 0; i < d.n; ++i) {
+    Mat2X projections = Project(d.P(i), d.X, d.x_ids[i]);
+    Mat2X x = d.x[i];
+    EXPECT_MATRIX_NEAR(projections, x, 1e-9);
+    for (int k = 0; k < x.cols(); ++k) {
+      EXPECT_LE(0, x(0, k));
+      EXPECT_LE(0, x(1, k));
+      EXPECT_GE(options.width - 1, x(0, k));
+      EXPECT_GE(options.height - 1, x(1, k));
+    }
+    num_observations += x.cols();
+  }
+  // Most of the points are seen in most of their interval.
+  EXPECT_GT(num_observations, options.num_points * options.min_track_length);
+}
+
+TEST(SyntheticVideo, TracksAreIntervalsOfMinimumLength) {
+  srand(2);
+  SyntheticVideoOptions options;
+  options.num_frames = 20;
+  options.min_track_length = 7;
+  // Nothing leaves these images.
+  options.width = options.height = 100000;
+  NViewDataSet d = SyntheticVideo(options);
+
+  std::vector<std::vector<int> > frames(options.num_points);
+  for (int i = 0; i < d.n; ++i) {
+    for (int k = 0; k < d.x_ids[i].size(); ++k) {
+      frames[d.x_ids[i][k]].push_back(i);
+    }
+  }
+  for (int j = 0; j < options.num_points; ++j) {
+    ASSERT_LE(options.min_track_length, frames[j].size());
+    EXPECT_EQ(frames[j].back() - frames[j].front() + 1, frames[j].size());
+  }
+}
+
+TEST(SyntheticVideo, NoiseAndOutliers) {
+  srand(3);
+  SyntheticVideoOptions options;
+  options.num_points = 1000;
+  options.noise = 0.5;
+  options.outlier_ratio = 0.2;
+  NViewDataSet d = SyntheticVideo(options);
+
+  int num_observations = 0, num_outliers = 0;
+  double inlier_squared_error = 0;
+  for (int i = 0; i < d.n; ++i) {
+    Mat2X projections = Project(d.P(i), d.X, d.x_ids[i]);
+    for (int k = 0; k < d.x[i].cols(); ++k) {
+      double squared_error = (d.x[i].col(k) - projections.col(k)).squaredNorm();
+      // Noise of 10 sigmas is very unlikely.
+      if (squared_error > 25) {
+        ++num_outliers;
+      } else {
+        inlier_squared_error += squared_error;
+      }
+      ++num_observations;
+    }
+  }
+  int num_inliers = num_observations - num_outliers;
+  EXPECT_NEAR(options.outlier_ratio,
+              double(num_outliers) / num_observations, 0.02);
+  // Two coordinates of variance noise^2.
+  EXPECT_NEAR(2 * options.noise * options.noise,
+              inlier_squared_error / num_inliers, 0.05);
+}
+
+}  // namespace
@@ -21,6 +21,8 @@
 #ifndef LIBMV_MULTIVIEW_TWO_VIEW_KERNEL_H_
 #define LIBMV_MULTIVIEW_TWO_VIEW_KERNEL_H_
 
+#include <algorithm>
+
 #include "libmv/base/vector.h"
 #include "libmv/logging/logging.h"
 #include "libmv/multiview/conditioning.h"
@@ -30,6 +32,53 @@ namespace libmv {
 namespace two_view {
 namespace kernel {
 
+// Solvers can optionally provide an entry point for exactly MINIMUM_SAMPLES
+// euclidean points, stored in fixed size matrices so that minimal samples are
+// fitted without allocating:
+//
+//   typedef Matrix<double, 2, MINIMUM_SAMPLES> MinimalSample;
+//   static void SolveMinimal(const MinimalSample &x1,
+//                            const MinimalSample &x2,
+//                            vector<Mat3> *models);
+//
+// HasSolveMinimal<Solver>::value tells whether it does.
+template<typename Solver>
+class HasSolveMinimal {
+  typedef char Yes;
+  typedef char No[2];
+  template<typename U,
+           void (*)(const typename U::MinimalSample &,
+                    const typename U::MinimalSample &,
+                    vector<Mat3> *)>
+  struct Check {};
+  template<typename U> static Yes &Test(Check<U, &U::SolveMinimal> *);
+  template<typename U> static No &Test(...);
+ public:
+  enum { value = sizeof(Test<Solver>(0)) == sizeof(Yes) };
+};
+
+namespace minimal_solve {
+
+template<bool kHasSolveMinimal>
+struct Dispatch {
+  template<typename Solver, typename Sample, typename Model>
+  static void Solve(const Sample &x1, const Sample &x2,
+                    vector<Model> *models) {
+    Solver::SolveMinimal(x1, x2, models);
+  }
+};
+
+template<>
+struct Dispatch<false> {
+  template<typename Solver, typename Sample, typename Model>
+  static void Solve(const Sample &x1, const Sample &x2,
+                    vector<Model> *models) {
+    Solver::Solve(Mat(x1), Mat(x2), models);
+  }
+};
+
+}  // namespace minimal_solve
+
 template<typename Solver, typename Unnormalizer>
 struct NormalizedSolver {
   enum { MINIMUM_SAMPLES = Solver::MINIMUM_SAMPLES };
@@ -51,6 +100,24 @@ struct NormalizedSolver {
       Unnormalizer::Unnormalize(T1, T2, &(*models)[i]);
     }
   }
+
+  typedef Matrix<double, 2, MINIMUM_SAMPLES> MinimalSample;
+  static void SolveMinimal(const MinimalSample &x1,
+                           const MinimalSample &x2,
+                           vector<Mat3> *models) {
+    Mat3 T1, T2;
+    MinimalSample x1_normalized, x2_normalized;
+    NormalizePoints(x1, &x1_normalized, &T1);
+    NormalizePoints(x2, &x2_normalized, &T2);
+
+    int first_model = models->size();
+    minimal_solve::Dispatch<HasSolveMinimal<Solver>::value>::
+        template Solve<Solver>(x1_normalized, x2_normalized, models);
+
+    for (int i = first_model; i < models->size(); ++i) {
+      Unnormalizer::Unnormalize(T1, T2, &(*models)[i]);
+    }
+  }
 };
 
 template<typename Solver, typename Unnormalizer>
@@ -74,7 +141,95 @@ struct IsotropicNormalizedSolver {
       Unnormalizer::Unnormalize(T1, T2, &(*models)[i]);
     }
   }
+
+  typedef Matrix<double, 2, MINIMUM_SAMPLES> MinimalSample;
+  static void SolveMinimal(const MinimalSample &x1,
+                           const MinimalSample &x2,
+                           vector<Mat3> *models) {
+    Mat3 T1, T2;
+    MinimalSample x1_normalized, x2_normalized;
+    NormalizeIsotropicPoints(x1, &x1_normalized, &T1);
+    NormalizeIsotropicPoints(x2, &x2_normalized, &T2);
+
+    int first_model = models->size();
+    minimal_solve::Dispatch<HasSolveMinimal<Solver>::value>::
+        template Solve<Solver>(x1_normalized, x2_normalized, models);
+
+    for (int i = first_model; i < models->size(); ++i) {
+      Unnormalizer::Unnormalize(T1, T2, &(*models)[i]);
+    }
+  }
+};
+
+// Error functors can optionally provide a batch entry point, working on
+// coordinates stored as structure of arrays:
+//
+//   static void Errors(const Mat3 &model,
+//                      const Scalar *x1, const Scalar *y1,
+//                      const Scalar *x2, const Scalar *y2,
+//                      int count, Scalar *errors);
+//
+// for Scalar double and optionally float. HasBatchErrors<ErrorArg>::value
+// tells whether it does for double, HasBatchErrors<ErrorArg, float>::value
+// for float.
+template<typename ErrorArg, typename Scalar = double>
+class HasBatchErrors {
+  typedef char Yes;
+  typedef char No[2];
+  template<typename U,
+           void (*)(const Mat3 &, const Scalar *, const Scalar *,
+                    const Scalar *, const Scalar *, int, Scalar *)>
+  struct Check {};
+  template<typename U> static Yes &Test(Check<U, &U::Errors> *);
+  template<typename U> static No &Test(...);
+ public:
+  enum { value = sizeof(Test<ErrorArg>(0)) == sizeof(Yes) };
+};
+
+namespace batch_errors {
+
+template<bool kHasBatchErrors>
+struct Dispatch {
+  template<typename ErrorArg>
+  static void Errors(const Mat3 &model,
+                     const Matrix<double, Dynamic, 4> &points,
+                     int first, int count, double *errors) {
+    ErrorArg::Errors(model,
+                     &points(first, 0), &points(first, 1),
+                     &points(first, 2), &points(first, 3),
+                     count, errors);
+  }
+  // The errors are computed in single precision by chunks, and widened for
+  // the scorers.
+  template<typename ErrorArg>
+  static void Errors(const Mat3 &model,
+                     const Matrix<float, Dynamic, 4> &points,
+                     int first, int count, double *errors) {
+    const int kChunk = 256;
+    float chunk_errors[kChunk];
+    for (int i = 0; i < count; i += kChunk) {
+      int n = std::min(kChunk, count - i);
+      ErrorArg::Errors(model,
+                       &points(first + i, 0), &points(first + i, 1),
+                       &points(first + i, 2), &points(first + i, 3),
+                       n, chunk_errors);
+      for (int j = 0; j < n; ++j) {
+        errors[i + j] = chunk_errors[j];
+      }
+    }
+  }
+};
+
+template<>
+struct Dispatch<false> {
+  template<typename ErrorArg, typename Points>
+  static void Errors(const Mat3 &, const Points &, int, int, double *) {
+    assert(false);
+  }
 };
+
+}  // namespace batch_errors
+
 // This is one example (targeted at solvers that operate on correspondences
 // between two views) that shows the "kernel" part of a robust fitting
 // problem:
@@ -97,27 +252,55 @@ struct IsotropicNormalizedSolver {
 //   3. Kernel::Fit(vector<int>, vector<Kernel::Model> *)
 //   4. Kernel::Error(int, Model) -> error
 //
+// and optionally
+//
+//   5. Kernel::Errors(Model, first, count, double *errors), the errors of the
+//      samples [first, first + count), which the scorers use when present.
+//
+// ErrorScalarArg is the precision of the batch errors. With float, ErrorArg
+// must have the float batch entry point to benefit: the scoring then
+// processes twice as many samples per SSE instruction, while the models are
+// still fitted (and refined) in double. The errors of Error() are always
+// computed in double.
+//
+// Minimal samples of euclidean points are fitted through
+// Solver::SolveMinimal() when the solver has it (see HasSolveMinimal).
+//
 // The fit routine must not clear existing entries in the vector of models; it
 // should append new solutions to the end.
 template<typename SolverArg,
          typename ErrorArg,
-         typename ModelArg = Mat3>
+         typename ModelArg = Mat3,
+         typename ErrorScalarArg = double>
 class Kernel {
  public:
-  Kernel(const Mat &x1, const Mat &x2) : x1_(x1), x2_(x2) {}
+  typedef ErrorScalarArg ErrorScalar;
+  enum { BATCH_ERRORS = HasBatchErrors<ErrorArg, ErrorScalar>::value };
+
+  Kernel(const Mat &x1, const Mat &x2) : x1_(x1), x2_(x2) {
+    if (BATCH_ERRORS && x1.rows() == 2 && x2.rows() == 2) {
+      points_.resize(x1.cols(), 4);
+      points_.col(0) = x1.row(0).transpose().template cast<ErrorScalar>();
+      points_.col(1) = x1.row(1).transpose().template cast<ErrorScalar>();
+      points_.col(2) = x2.row(0).transpose().template cast<ErrorScalar>();
+      points_.col(3) = x2.row(1).transpose().template cast<ErrorScalar>();
+    }
+  }
   typedef SolverArg Solver;
   typedef ModelArg  Model;
   enum { MINIMUM_SAMPLES = Solver::MINIMUM_SAMPLES };
   void Fit(const vector<int> &samples, vector<Model> *models) const {
-    Mat x1 = ExtractColumns(x1_, samples);
-    Mat x2 = ExtractColumns(x2_, samples);
-    Solver::Solve(x1, x2, models);
+    FitColumns(x1_, x2_, samples, models);
   }
   double Error(int sample, const Model &model) const {
     return ErrorArg::Error(model, 
                            static_cast<Vec>(x1_.col(sample)),
                            static_cast<Vec>(x2_.col(sample)));
   }
+  void Errors(const Model &model, int first, int count,
+              double *errors) const {
+    ModelErrors(model, first, count, errors);
+  }
   int NumSamples() const {
     return x1_.cols();
   }
@@ -126,8 +309,152 @@ class Kernel {
     Solver::Solve(x1, x2, models);
   }
  protected:
+  // Fits the models of the given columns of x1 and x2.
+  static void FitColumns(const Mat &x1_all, const Mat &x2_all,
+                         const vector<int> &samples, vector<Model> *models) {
+    if (HasSolveMinimal<Solver>::value &&
+        samples.size() == MINIMUM_SAMPLES &&
+        x1_all.rows() == 2 && x2_all.rows() == 2) {
+      // Gather the minimal sample into fixed size matrices on the stack.
+      Matrix<double, 2, MINIMUM_SAMPLES> x1, x2;
+      for (int i = 0; i < MINIMUM_SAMPLES; ++i) {
+        x1.col(i) = x1_all.block<2, 1>(0, samples[i]);
+        x2.col(i) = x2_all.block<2, 1>(0, samples[i]);
+      }
+      minimal_solve::Dispatch<HasSolveMinimal<Solver>::value>::
+          template Solve<Solver>(x1, x2, models);
+      return;
+    }
+    Mat x1 = ExtractColumns(x1_all, samples);
+    Mat x2 = ExtractColumns(x2_all, samples);
+    Solver::Solve(x1, x2, models);
+  }
+
+  // Errors of the samples [first, first + count) under the model given to
+  // ErrorArg, through its batch entry point when it has one.
+  template<typename ErrorModel>
+  void ModelErrors(const ErrorModel &model, int first, int count,
+                   double *errors) const {
+    assert(0 <= first && first + count <= NumSamples());
+    if (points_.rows()) {
+      batch_errors::Dispatch<BATCH_ERRORS>::
+          template Errors<ErrorArg>(model, points_, first, count, errors);
+      return;
+    }
+    for (int i = 0; i < count; ++i) {
+      errors[i] = ErrorArg::Error(model,
+                                  static_cast<Vec>(x1_.col(first + i)),
+                                  static_cast<Vec>(x2_.col(first + i)));
+    }
+  }
+
   const Mat &x1_;
   const Mat &x2_;
+
+  // Columns x1, y1, x2, y2 of the samples, for the batch errors; empty when
+  // ErrorArg has no batch entry point for ErrorScalar.
+  Matrix<ErrorScalar, Dynamic, 4> points_;
+};
+
+// Same as Kernel<NormalizedSolver<SolverArg, UnnormalizerArg>, ...>, but the
+// points are normalized once when the kernel is built (see
+// NormalizedCorrespondences) instead of for every fitted sample. SolverArg
+// works on the normalized points, and only the fitted models are
+// unnormalized. The errors are computed on the original points.
+template<typename SolverArg,
+         typename UnnormalizerArg,
+         typename ErrorArg,
+         typename ModelArg = Mat3,
+         bool kIsotropic = false,
+         typename ErrorScalarArg = double>
+class PrenormalizedKernel
+    : public Kernel<SolverArg, ErrorArg, ModelArg, ErrorScalarArg> {
+  typedef Kernel<SolverArg, ErrorArg, ModelArg, ErrorScalarArg> Base;
+ public:
+  PrenormalizedKernel(const Mat &x1, const Mat &x2)
+      : Base(x1, x2), normalized_(x1, x2, kIsotropic) {}
+  typedef typename Base::Model Model;
+  enum { MINIMUM_SAMPLES = Base::MINIMUM_SAMPLES };
+  void Fit(const vector<int> &samples, vector<Model> *models) const {
+    int first_model = models->size();
+    Base::FitColumns(normalized_.x1(), normalized_.x2(), samples, models);
+    for (int i = first_model; i < models->size(); ++i) {
+      UnnormalizerArg::Unnormalize(normalized_.T1(), normalized_.T2(),
+                                   &(*models)[i]);
+    }
+  }
+  // Redeclared so that the estimators find it (see HasErrors).
+  void Errors(const Model &model, int first, int count,
+              double *errors) const {
+    Base::Errors(model, first, count, errors);
+  }
+  static void Solve(const Mat &x1, const Mat &x2, vector<Model> *models) {
+    NormalizedCorrespondences normalized(x1, x2, kIsotropic);
+    int first_model = models->size();
+    SolverArg::Solve(normalized.x1(), normalized.x2(), models);
+    for (int i = first_model; i < models->size(); ++i) {
+      UnnormalizerArg::Unnormalize(normalized.T1(), normalized.T2(),
+                                   &(*models)[i]);
+    }
+  }
+
+ private:
+  NormalizedCorrespondences normalized_;
+};
+
+// Kernel over correspondences of local affine frames, e.g. the ellipses of
+// MSER regions or the scale and orientation of similarity covariant features.
+// Frame i is the point x(:, i) and the 2x2 matrix mapping the unit disc onto
+// the region around it, stored column major in frames(:, i). Every frame is
+// fitted as three point correspondences, its center and the ends of its two
+// axes, so the points fitted by SolverArg come three by three and far fewer
+// samples are drawn: 2 frames for a homography, 1 for an affinity. The errors
+// are the ones of the centers.
+template<typename SolverArg,
+         typename ErrorArg,
+         typename ModelArg = Mat3>
+class AffineFrameKernel : public Kernel<SolverArg, ErrorArg, ModelArg> {
+  typedef Kernel<SolverArg, ErrorArg, ModelArg> Base;
+ public:
+  AffineFrameKernel(const Mat &x1, const Mat &frames1,
+                    const Mat &x2, const Mat &frames2)
+      : Base(x1, x2) {
+    FramePoints(x1, frames1, &frame_points1_);
+    FramePoints(x2, frames2, &frame_points2_);
+  }
+  typedef typename Base::Model Model;
+  enum { MINIMUM_SAMPLES = (SolverArg::MINIMUM_SAMPLES + 2) / 3 };
+  void Fit(const vector<int> &samples, vector<Model> *models) const {
+    vector<int> columns(3 * samples.size());
+    for (int i = 0; i < samples.size(); ++i) {
+      for (int j = 0; j < 3; ++j) {
+        columns[3 * i + j] = 3 * samples[i] + j;
+      }
+    }
+    SolverArg::Solve(ExtractColumns(frame_points1_, columns),
+                     ExtractColumns(frame_points2_, columns), models);
+  }
+  // Redeclared so that the estimators find it (see HasErrors).
+  void Errors(const Model &model, int first, int count,
+              double *errors) const {
+    Base::Errors(model, first, count, errors);
+  }
+
+  // The centers and the ends of the axes of the frames, three columns per
+  // frame.
+  static void FramePoints(const Mat &x, const Mat &frames, Mat *points) {
+    assert(x.rows() == 2 && frames.rows() == 4 && x.cols() == frames.cols());
+    points->resize(2, 3 * x.cols());
+    for (int i = 0; i < x.cols(); ++i) {
+      points->col(3 * i) = x.col(i);
+      points->col(3 * i + 1) = x.col(i) + frames.block<2, 1>(0, i);
+      points->col(3 * i + 2) = x.col(i) + frames.block<2, 1>(2, i);
+    }
+  }
+
+ protected:
+  Mat frame_points1_;
+  Mat frame_points2_;
 };
 
 }  // namespace kernel
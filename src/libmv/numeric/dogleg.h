@@ -34,13 +34,21 @@
 
 #include "libmv/numeric/numeric.h"
 #include "libmv/numeric/function_derivative.h"
+#include "libmv/numeric/normal_equations.h"
 #include "libmv/logging/logging.h"
 
 namespace libmv {
 
+// Solver is either an Eigen decomposition of the dense J'J, or a normal
+// equations policy (see normal_equations.h). J'J is symmetric positive
+// semi-definite, so the default is an LDLT.
+//
+// J, J'J and J'f, as well as the Gauss-Newton step and the Cauchy point, are
+// only recomputed when a step is accepted; a rejected step only shrinks the
+// trust region and blends the same two steps again.
 template<typename Function,
          typename Jacobian = NumericJacobian<Function>,
-         typename Solver = Eigen::PartialPivLU<
+         typename Solver = Eigen::LDLT<
            Matrix<typename Function::FMatrixType::RealScalar, 
                   Function::XMatrixType::RowsAtCompileTime,
                   Function::XMatrixType::RowsAtCompileTime> > >
@@ -55,6 +63,9 @@ class Dogleg {
   typedef Matrix<typename JMatrixType::RealScalar, 
                  JMatrixType::ColsAtCompileTime, 
                  JMatrixType::ColsAtCompileTime> AMatrixType;
+  typedef typename normal_equations::Select<Solver, JMatrixType,
+                                            AMatrixType>::Type
+          NormalEquations;
 
   enum Status {
     RUNNING,
@@ -96,15 +107,19 @@ class Dogleg {
   };
 
   Status Update(const Parameters &x, const SolverParameters &params,
-                JMatrixType *J, AMatrixType *A, FVec *error, Parameters *g) {
-    *J = df_(x);
-    // TODO(keir): In the case of m = n, avoid computing A and just do J^-1 directly.
-    *A = (*J).transpose() * (*J);
+                FVec *error, Parameters *g) {
     *error = f_(x);
-    *g = (*J).transpose() * *error;
+    return Linearize(x, params, *error, g);
+  }
+
+  // Update() at x, where error = f(x) is already known.
+  Status Linearize(const Parameters &x, const SolverParameters &params,
+                   const FVec &error, Parameters *g) {
+    // TODO(keir): In the case of m = n, avoid computing A and just do J^-1 directly.
+    normal_equations_.Linearize(df_(x), error, g);
     if (g->array().abs().maxCoeff() < params.gradient_threshold) {
       return GRADIENT_TOO_SMALL;
-    } else if (error->array().abs().maxCoeff() < params.error_threshold) {
+    } else if (error.array().abs().maxCoeff() < params.error_threshold) {
       return ERROR_TOO_SMALL;
     }
     return RUNNING;
@@ -152,45 +167,44 @@ class Dogleg {
 
   Results minimize(const SolverParameters &params, Parameters *x_and_min) {
     Parameters &x = *x_and_min;
-    JMatrixType J;
-    AMatrixType A;
     FVec error;
     Parameters g;
 
     Results results;
-    results.status = Update(x, params, &J, &A, &error, &g);
+    results.status = Update(x, params, &error, &g);
 
     Scalar radius = params.initial_trust_radius;
     bool x_updated = true;
 
     Parameters x_new;
+    FVec error_new;
     Parameters dx_sd;  // Steepest descent step.
     Parameters dx_dl;  // Dogleg step.
     Parameters dx_gn;  // Gauss-Newton step.
+    Scalar alpha = 0;  // Step length to the Cauchy point along dx_sd.
       printf("iteration     ||f(x)||      max(g)       radius\n");
     int i = 0;
     for (; results.status == RUNNING && i < params.max_iterations; ++i) {
       printf("%9d %12g %12g %12g",
-          i, f_(x).norm(), g.array().abs().maxCoeff(), radius);
+          i, error.norm(), g.array().abs().maxCoeff(), radius);
 
       //LG << "iteration: " << i;
       //LG << "||f(x)||: " << f_(x).norm();
       //LG << "max(g): " << g.cwise().abs().maxCoeff();
       //LG << "radius: " << radius;
-      // Eqn 3.19 from [1]
-      Scalar alpha = g.squaredNorm() / (J*g).squaredNorm();
+      // Solve for Gauss-Newton direction dx_gn and the Cauchy point.
+      if (x_updated) {
+        // Eqn 3.19 from [1]
+        alpha = g.squaredNorm() / normal_equations_.JSquaredNorm(g);
 
-      // Solve for steepest descent direction dx_sd.
-      dx_sd = -g;
+        // Solve for steepest descent direction dx_sd.
+        dx_sd = -g;
 
-      // Solve for Gauss-Newton direction dx_gn.
-      if (x_updated) {
         // TODO(keir): See Appendix B of [1] for discussion of when A is
         // singular and there are many solutions. Solving that involves the SVD
         // and is slower, but should still work.
-        Solver solver(A);
-        dx_gn = solver.solve(-g);
-        if (!(A * dx_gn).isApprox(-g)) {
+        Parameters minus_g = -g;
+        if (!normal_equations_.Solve(Scalar(0), minus_g, &dx_gn)) {
           LOG(ERROR) << "Failed to solve normal eqns. TODO: Solve via SVD.";
           return results;
         }
@@ -209,15 +223,16 @@ class Dogleg {
       }
 
       x_new = x + dx_dl;
-      Scalar actual = f_(x).squaredNorm() - f_(x_new).squaredNorm();
+      error_new = f_(x_new);
+      Scalar actual = error.squaredNorm() - error_new.squaredNorm();
       Scalar predicted = 0;
       if (step == GAUSS_NEWTON) {
-        predicted = f_(x).squaredNorm();
+        predicted = error.squaredNorm();
       } else if (step == STEEPEST_DESCENT) {
         predicted = radius * (2*alpha*g.norm() - radius) / 2 / alpha;
       } else if (step == DOGLEG) {
         predicted = 0.5 * alpha * (1-beta)*(1-beta)*g.squaredNorm() +
-                    beta*(2-beta)*f_(x).squaredNorm();
+                    beta*(2-beta)*error.squaredNorm();
       }
       Scalar rho = actual / predicted;
 
@@ -230,7 +245,8 @@ class Dogleg {
       if (rho > 0) {
         // Accept update because the linear model is a good fit.
         x = x_new;
-        results.status = Update(x, params, &J, &A, &error, &g);
+        error = error_new;
+        results.status = Linearize(x, params, error, &g);
         x_updated = true;
       }
       if (rho > 0.75) {
@@ -251,9 +267,13 @@ class Dogleg {
     return results;
   }
 
+  // The linear solver, e.g. to set the options of the conjugate gradients.
+  NormalEquations *normal_equations() { return &normal_equations_; }
+
  private:
   const Function &f_;
   Jacobian df_;
+  NormalEquations normal_equations_;
 };
 
 }  // namespace mv
@@ -22,8 +22,11 @@
 #define LIBMV_NUMERIC_DERIVATIVE_H
 
 #include <cmath>
+#include <vector>
 
+#include "libmv/base/thread.h"
 #include "libmv/numeric/numeric.h"
+#include "libmv/numeric/sparse_matrix.h"
 #include "libmv/logging/logging.h"
 
 namespace libmv {
@@ -36,6 +39,59 @@ enum NumericJacobianMode {
   FORWARD,
 };
 
+namespace numeric_jacobian {
+
+// The step of the finite differences for every parameter.
+template<typename Parameters>
+void StepSizes(const Parameters &x, Parameters *eps) {
+  typedef typename Parameters::RealScalar XScalar;
+  // Empirically determined constant.
+  *eps = x.array().abs() * XScalar(1e-5);
+  // To handle cases where a paremeter is exactly zero, instead use the mean
+  // eps for the other dimensions.
+  XScalar mean_eps = eps->sum() / eps->rows();
+  if (mean_eps == XScalar(0)) {
+    // TODO(keir): Do something better here.
+    mean_eps = 1e-8; // ~sqrt(machine precision).
+  }
+  for (int c = 0; c < eps->rows(); ++c) {
+    if ((*eps)(c) == XScalar(0)) {
+      (*eps)(c) = mean_eps;
+    }
+  }
+}
+
+// Computes the columns of a dense Jacobian, for ParallelFor().
+template<typename Function, typename JMatrixType, NumericJacobianMode mode>
+struct DenseColumns {
+  typedef typename Function::XMatrixType Parameters;
+  typedef typename Function::FMatrixType FMatrixType;
+  typedef typename Parameters::RealScalar XScalar;
+
+  void operator()(int c) const {
+    Parameters x_plus_delta = *x;
+    x_plus_delta(c) = (*x)(c) + (*eps)(c);
+    FMatrixType difference = (*f)(x_plus_delta);
+    XScalar one_over_h = 1 / (*eps)(c);
+    if (mode == CENTRAL) {
+      x_plus_delta(c) = (*x)(c) - (*eps)(c);
+      difference -= (*f)(x_plus_delta);
+      one_over_h /= 2;
+    } else {
+      difference -= *fx;
+    }
+    jacobian->col(c) = difference * one_over_h;
+  }
+
+  const Function *f;
+  const Parameters *x;
+  const Parameters *eps;
+  const FMatrixType *fx;  // Only for FORWARD.
+  JMatrixType *jacobian;
+};
+
+}  // namespace numeric_jacobian
+
 template<typename Function, NumericJacobianMode mode=CENTRAL>
 class NumericJacobian {
  public:
@@ -49,48 +105,252 @@ class NumericJacobian {
 
   NumericJacobian(const Function &f) : f_(f) {}
 
-  // TODO(keir): Perhaps passing the jacobian back by value is not a good idea.
   JMatrixType operator()(const Parameters &x) {
-    // Empirically determined constant.
-    Parameters eps = x.array().abs() * XScalar(1e-5);
-    // To handle cases where a paremeter is exactly zero, instead use the mean
-    // eps for the other dimensions.
-    XScalar mean_eps = eps.sum() / eps.rows();
-    if (mean_eps == XScalar(0)) {
-      // TODO(keir): Do something better here.
-      mean_eps = 1e-8; // ~sqrt(machine precision).
+    JMatrixType jacobian;
+    (*this)(x, &jacobian);
+    return jacobian;
+  }
+
+  // Same as above, but stores the Jacobian in a buffer of the caller, which is
+  // only resized if necessary.
+  void operator()(const Parameters &x, JMatrixType *jacobian) {
+    Parameters eps;
+    numeric_jacobian::StepSizes(x, &eps);
+    // The central differences do not need f(x); the number of residuals is
+    // then known from the first evaluation.
+    FMatrixType fx;
+    if (mode == FORWARD) {
+      fx = f_(x);
     }
-    // TODO(keir): Elimininate this needless function evaluation for the
-    // central difference case.
-    FMatrixType fx = f_(x);
-    const int rows = fx.rows();
-    const int cols = x.rows();
-    JMatrixType jacobian(rows, cols);
     Parameters x_plus_delta = x;
+    const int cols = x.rows();
     for (int c = 0; c < cols; ++c) {
-      if (eps(c) == XScalar(0)) {
-        eps(c) = mean_eps;
-      }
       x_plus_delta(c) = x(c) + eps(c);
-      jacobian.col(c) = f_(x_plus_delta);
+      FMatrixType difference = f_(x_plus_delta);
+      if (c == 0) {
+        jacobian->resize(difference.rows(), cols);
+      }
 
       XScalar one_over_h = 1 / eps(c);
       if (mode == CENTRAL) {
         x_plus_delta(c) = x(c) - eps(c);
-        jacobian.col(c) -= f_(x_plus_delta);
+        difference -= f_(x_plus_delta);
         one_over_h /= 2;
       } else {
-        jacobian.col(c) -= fx;
+        difference -= fx;
       }
       x_plus_delta(c) = x(c);
-      jacobian.col(c) = jacobian.col(c) * one_over_h;
+      jacobian->col(c) = difference * one_over_h;
     }
+  }
+ private:
+  const Function &f_;
+};
+
+// Same as NumericJacobian, but the columns are computed on kNumThreads
+// threads (see ParallelFor()). The operator() of the function must then be
+// safe to call concurrently, which it is when it does not modify the function.
+template<typename Function,
+         NumericJacobianMode mode = CENTRAL,
+         int kNumThreads = 4>
+class ParallelNumericJacobian {
+ public:
+  typedef typename Function::XMatrixType Parameters;
+  typedef typename Function::FMatrixType FMatrixType;
+  typedef typename NumericJacobian<Function, mode>::JMatrixType JMatrixType;
+
+  ParallelNumericJacobian(const Function &f) : f_(f) {}
+
+  JMatrixType operator()(const Parameters &x) {
+    JMatrixType jacobian;
+    (*this)(x, &jacobian);
     return jacobian;
   }
+
+  void operator()(const Parameters &x, JMatrixType *jacobian) {
+    Parameters eps;
+    numeric_jacobian::StepSizes(x, &eps);
+    FMatrixType fx = f_(x);
+    jacobian->resize(fx.rows(), x.rows());
+
+    numeric_jacobian::DenseColumns<Function, JMatrixType, mode> columns;
+    columns.f = &f_;
+    columns.x = &x;
+    columns.eps = &eps;
+    columns.fx = &fx;
+    columns.jacobian = jacobian;
+    ParallelFor(0, x.rows(), kNumThreads, &columns);
+  }
+
  private:
   const Function &f_;
 };
 
+// Numeric Jacobian of a function whose Jacobian is sparse, with a known
+// pattern, as a CompressedColumnMatrix for the sparse normal equations (see
+// normal_equations.h). The columns that have no nonzero row in common are
+// perturbed together, so the function is evaluated twice (once for FORWARD)
+// per group of columns instead of per column: a function made of small
+// independent blocks of residuals needs as many groups as the largest block
+// has parameters. The groups come from a greedy coloring of the columns.
+//
+// The function must provide, besides the usual types and operator(),
+//
+//   void JacobianPattern(CompressedColumnMatrix *pattern) const;
+//
+// which sets the nonzero entries of the Jacobian (the values are ignored).
+// The groups are evaluated on num_threads threads, see ParallelNumericJacobian
+// for what this requires of the function.
+template<typename Function, NumericJacobianMode mode = CENTRAL>
+class GroupedNumericJacobian {
+ public:
+  typedef typename Function::XMatrixType Parameters;
+  typedef typename Function::XMatrixType::RealScalar XScalar;
+  typedef typename Function::FMatrixType FMatrixType;
+  typedef CompressedColumnMatrix JMatrixType;
+
+  GroupedNumericJacobian(const Function &f, int num_threads = 1)
+      : f_(f), num_threads_(num_threads) {
+    f.JacobianPattern(&jacobian_);
+    GroupColumns();
+  }
+
+  GroupedNumericJacobian(const Function &f,
+                         const CompressedColumnMatrix &pattern,
+                         int num_threads = 1)
+      : f_(f), num_threads_(num_threads), jacobian_(pattern) {
+    GroupColumns();
+  }
+
+  // The Jacobian is stored in the object, and valid until the next call.
+  const JMatrixType &operator()(const Parameters &x) {
+    assert(x.rows() == jacobian_.cols());
+    Parameters eps;
+    numeric_jacobian::StepSizes(x, &eps);
+    FMatrixType fx;
+    if (mode == FORWARD) {
+      fx = f_(x);
+    }
+    Groups groups;
+    groups.self = this;
+    groups.x = &x;
+    groups.eps = &eps;
+    groups.fx = &fx;
+    ParallelFor(0, NumGroups(), num_threads_, &groups);
+    return jacobian_;
+  }
+
+  // The number of groups of columns, i.e. of finite differences.
+  int NumGroups() const { return group_begin_.size() - 1; }
+
+ private:
+  // Computes the columns of the groups, for ParallelFor().
+  struct Groups {
+    void operator()(int g) const {
+      self->EvaluateGroup(g, *x, *eps, *fx);
+    }
+    GroupedNumericJacobian *self;
+    const Parameters *x;
+    const Parameters *eps;
+    const FMatrixType *fx;
+  };
+
+  void EvaluateGroup(int g, const Parameters &x, const Parameters &eps,
+                     const FMatrixType &fx) {
+    Parameters x_plus_delta = x;
+    for (int k = group_begin_[g]; k < group_begin_[g + 1]; ++k) {
+      int c = group_columns_[k];
+      x_plus_delta(c) = x(c) + eps(c);
+    }
+    FMatrixType difference = f_(x_plus_delta);
+    XScalar one_over_2 = 1;
+    if (mode == CENTRAL) {
+      for (int k = group_begin_[g]; k < group_begin_[g + 1]; ++k) {
+        int c = group_columns_[k];
+        x_plus_delta(c) = x(c) - eps(c);
+      }
+      difference -= f_(x_plus_delta);
+      one_over_2 = 0.5;
+    } else {
+      difference -= fx;
+    }
+    // The columns of a group have distinct rows, so every entry of the
+    // difference belongs to at most one of them.
+    const std::vector<int> &begin = jacobian_.column_begin();
+    const std::vector<int> &rows = jacobian_.row_indices();
+    std::vector<double> &values = jacobian_.values();
+    for (int k = group_begin_[g]; k < group_begin_[g + 1]; ++k) {
+      int c = group_columns_[k];
+      XScalar one_over_h = one_over_2 / eps(c);
+      for (int i = begin[c]; i < begin[c + 1]; ++i) {
+        values[i] = difference(rows[i]) * one_over_h;
+      }
+    }
+  }
+
+  // Greedy coloring of the graph where two columns are adjacent when they
+  // have a nonzero row in common.
+  void GroupColumns() {
+    const int cols = jacobian_.cols();
+    const std::vector<int> &begin = jacobian_.column_begin();
+    const std::vector<int> &rows = jacobian_.row_indices();
+
+    // The columns of every row.
+    std::vector<std::vector<int> > row_columns(jacobian_.rows());
+    for (int c = 0; c < cols; ++c) {
+      for (int i = begin[c]; i < begin[c + 1]; ++i) {
+        row_columns[rows[i]].push_back(c);
+      }
+    }
+
+    std::vector<int> group(cols, -1);
+    // forbidden[g] == c when column c cannot go in group g.
+    std::vector<int> forbidden;
+    int num_groups = 0;
+    for (int c = 0; c < cols; ++c) {
+      for (int i = begin[c]; i < begin[c + 1]; ++i) {
+        const std::vector<int> &neighbors = row_columns[rows[i]];
+        for (int j = 0; j < neighbors.size(); ++j) {
+          if (group[neighbors[j]] >= 0) {
+            forbidden[group[neighbors[j]]] = c;
+          }
+        }
+      }
+      int g = 0;
+      while (g < num_groups && forbidden[g] == c) {
+        ++g;
+      }
+      if (g == num_groups) {
+        forbidden.push_back(-1);
+        ++num_groups;
+      }
+      group[c] = g;
+    }
+
+    // The columns sorted by group.
+    group_begin_.assign(num_groups + 1, 0);
+    for (int c = 0; c < cols; ++c) {
+      ++group_begin_[group[c] + 1];
+    }
+    for (int g = 0; g < num_groups; ++g) {
+      group_begin_[g + 1] += group_begin_[g];
+    }
+    group_columns_.resize(cols);
+    std::vector<int> next(group_begin_.begin(), group_begin_.end() - 1);
+    for (int c = 0; c < cols; ++c) {
+      group_columns_[next[group[c]]++] = c;
+    }
+  }
+
+  const Function &f_;
+  int num_threads_;
+  JMatrixType jacobian_;
+  // The columns of group g are group_columns_[group_begin_[g] ...
+  // group_begin_[g + 1] - 1].
+  std::vector<int> group_begin_;
+  std::vector<int> group_columns_;
+};
+
 template<typename Function, typename Jacobian>
 bool CheckJacobian(const Function &f, const typename Function::XMatrixType &x) {
   Jacobian j_analytic(f);
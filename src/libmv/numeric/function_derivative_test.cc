@@ -18,9 +18,12 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <vector>
+
 #include "testing/testing.h"
 #include "libmv/numeric/numeric.h"
 #include "libmv/numeric/function_derivative.h"
+#include "libmv/numeric/sparse_matrix.h"
 
 using namespace libmv;
 
@@ -54,4 +57,80 @@ TEST(FunctionDerivative, SimpleCase) {
   EXPECT_MATRIX_NEAR(f.J(x), J_forward(x), 1e-5);
 }
 
+TEST(FunctionDerivative, JacobianIntoBuffer) {
+  Vec3 x; x << 0.76026643, 0.01799744, 0.55192142;
+  F f;
+  NumericJacobian<F, CENTRAL> J(f);
+  Mat23 jacobian;
+  J(x, &jacobian);
+  EXPECT_MATRIX_NEAR(f.J(x), jacobian, 1e-8);
+}
+
+TEST(FunctionDerivative, ParallelMatchesSerial) {
+  Vec3 x; x << 0.76026643, 0.01799744, 0.55192142;
+  F f;
+  NumericJacobian<F, CENTRAL> J(f);
+  ParallelNumericJacobian<F, CENTRAL, 3> J_parallel(f);
+  EXPECT_MATRIX_NEAR(J(x), J_parallel(x), 1e-15);
+  NumericJacobian<F, FORWARD> J_forward(f);
+  ParallelNumericJacobian<F, FORWARD, 2> J_parallel_forward(f);
+  EXPECT_MATRIX_NEAR(J_forward(x), J_parallel_forward(x), 1e-15);
+}
+
+// Blocks of residuals x_i^2 x_{i+1} - 1 and sin(x_i + x_{i+1}), so that
+// every parameter only shares residuals with its neighbors.
+class Band {
+ public:
+  typedef Vec FMatrixType;
+  typedef Vec XMatrixType;
+
+  Band(int n) : n_(n) {}
+
+  Vec operator()(const Vec &x) const {
+    Vec fx(2 * (n_ - 1));
+    for (int i = 0; i + 1 < n_; ++i) {
+      fx(2 * i)     = x(i) * x(i) * x(i + 1) - 1;
+      fx(2 * i + 1) = sin(x(i) + x(i + 1));
+    }
+    return fx;
+  }
+
+  void JacobianPattern(CompressedColumnMatrix *pattern) const {
+    std::vector<int> rows, cols;
+    for (int i = 0; i + 1 < n_; ++i) {
+      for (int r = 2 * i; r < 2 * i + 2; ++r) {
+        rows.push_back(r); cols.push_back(i);
+        rows.push_back(r); cols.push_back(i + 1);
+      }
+    }
+    std::vector<double> values(rows.size(), 0.0);
+    pattern->SetFromTriplets(2 * (n_ - 1), n_, rows, cols, values);
+  }
+
+ private:
+  int n_;
+};
+
+TEST(FunctionDerivative, GroupedMatchesDense) {
+  const int n = 25;
+  Band f(n);
+  Vec x(n);
+  for (int i = 0; i < n; ++i) {
+    x(i) = 0.5 + 0.1 * i;
+  }
+  NumericJacobian<Band, CENTRAL> J(f);
+  GroupedNumericJacobian<Band, CENTRAL> J_grouped(f);
+  // Only the neighbors share rows.
+  EXPECT_EQ(2, J_grouped.NumGroups());
+  Mat expected = J(x);
+  EXPECT_MATRIX_NEAR(expected, J_grouped(x).ToDense(), 1e-12);
+
+  CompressedColumnMatrix pattern;
+  f.JacobianPattern(&pattern);
+  GroupedNumericJacobian<Band, FORWARD> J_forward(f, pattern, 4);
+  NumericJacobian<Band, FORWARD> J_dense_forward(f);
+  Mat expected_forward = J_dense_forward(x);
+  EXPECT_MATRIX_NEAR(expected_forward, J_forward(x).ToDense(), 1e-12);
+}
+
 }  // namespace
@@ -33,13 +33,23 @@
 
 #include "libmv/numeric/numeric.h"
 #include "libmv/numeric/function_derivative.h"
+#include "libmv/numeric/normal_equations.h"
 #include "libmv/logging/logging.h"
 
 namespace libmv {
 
+// Solver is either an Eigen decomposition of the dense J'J, or a normal
+// equations policy such as SparseCholeskyNormalEquations for large sparse
+// problems (see normal_equations.h); the Jacobian must then return the
+// policy's JMatrixType. The damped J'J + u I is symmetric positive definite,
+// so the default is an LDLT.
+//
+// J, J'J and J'f are only recomputed when a step is accepted; a rejected step
+// only solves the damped system again, and the residuals of an accepted step
+// are not evaluated twice.
 template<typename Function,
          typename Jacobian = NumericJacobian<Function>,
-         typename Solver = Eigen::PartialPivLU<
+         typename Solver = Eigen::LDLT<
            Matrix<typename Function::FMatrixType::RealScalar, 
                   Function::XMatrixType::RowsAtCompileTime,
                   Function::XMatrixType::RowsAtCompileTime> > >
@@ -54,6 +64,9 @@ class LevenbergMarquardt {
   typedef Matrix<typename JMatrixType::RealScalar, 
                  JMatrixType::ColsAtCompileTime, 
                  JMatrixType::ColsAtCompileTime> AMatrixType;
+  typedef typename normal_equations::Select<Solver, JMatrixType,
+                                            AMatrixType>::Type
+          NormalEquations;
 
   // TODO(keir): Some of these knobs can be derived from each other and
   // removed, instead of requiring the user to set them.
@@ -90,14 +103,18 @@ class LevenbergMarquardt {
   };
 
   Status Update(const Parameters &x, const SolverParameters &params,
-                JMatrixType *J, AMatrixType *A, FVec *error, Parameters *g) {
-    *J = df_(x);
-    *A = (*J).transpose() * (*J);
+                FVec *error, Parameters *g) {
     *error = -f_(x);
-    *g = (*J).transpose() * *error;
+    return Linearize(x, params, *error, g);
+  }
+
+  // Update() at x, where error = -f(x) is already known.
+  Status Linearize(const Parameters &x, const SolverParameters &params,
+                   const FVec &error, Parameters *g) {
+    normal_equations_.Linearize(df_(x), error, g);
     if (g->array().abs().maxCoeff() < params.gradient_threshold) {
       return GRADIENT_TOO_SMALL;
-    } else if (error->norm() < params.error_threshold) {
+    } else if (error.norm() < params.error_threshold) {
       return ERROR_TOO_SMALL;
     }
     return RUNNING;
@@ -105,35 +122,32 @@ class LevenbergMarquardt {
 
   Results minimize(Parameters *x_and_min) {
     SolverParameters params;
-    minimize(params, x_and_min);
+    return minimize(params, x_and_min);
   }
 
   Results minimize(const SolverParameters &params, Parameters *x_and_min) {
     Parameters &x = *x_and_min;
-    JMatrixType J;
-    AMatrixType A;
     FVec error;
     Parameters g;
 
     Results results;
-    results.status = Update(x, params, &J, &A, &error, &g);
+    results.status = Update(x, params, &error, &g);
 
-    Scalar u = Scalar(params.initial_scale_factor*A.diagonal().maxCoeff());
+    Scalar u = Scalar(params.initial_scale_factor *
+                      normal_equations_.MaxDiagonal());
     Scalar v = 2;
 
     Parameters dx, x_new;
+    FVec error_new;
     int i;
     for (i = 0; results.status == RUNNING && i < params.max_iterations; ++i) {
       LOG(INFO) << "iteration: " << i;
-      LOG(INFO) << "||f(x)||: " << f_(x).norm();
+      LOG(INFO) << "||f(x)||: " << error.norm();
       LOG(INFO) << "max(g): " << g.array().abs().maxCoeff();
       LOG(INFO) << "u: " << u;
       LOG(INFO) << "v: " << v;
 
-      AMatrixType A_augmented = A + u*AMatrixType::Identity(J.cols(), J.cols());
-      Solver solver(A_augmented);
-      dx = solver.solve(g);
-      bool solved = (A_augmented * dx).isApprox(g);
+      bool solved = normal_equations_.Solve(u, g, &dx);
       if (!solved) LOG(ERROR) << "Failed to solve";
       if (solved && dx.norm() <= params.relative_step_threshold * x.norm()) {
           results.status = RELATIVE_STEP_SIZE_TOO_SMALL;
@@ -141,15 +155,17 @@ class LevenbergMarquardt {
       } 
       if (solved) {
         x_new = x + dx;
+        error_new = -f_(x_new);
         // Rho is the ratio of the actual reduction in error to the reduction
         // in error that would be obtained if the problem was linear.
         // See [1] for details.
-        Scalar rho((error.squaredNorm() - f_(x_new).squaredNorm())
+        Scalar rho((error.squaredNorm() - error_new.squaredNorm())
                    / dx.dot(u*dx + g));
         if (rho > 0) {
           // Accept the Gauss-Newton step because the linear model fits well.
           x = x_new;
-          results.status = Update(x, params, &J, &A, &error, &g);
+          error = error_new;
+          results.status = Linearize(x, params, error, &g);
           Scalar tmp = Scalar(2*rho-1);
           u = u*std::max(1/3., 1 - (tmp*tmp*tmp));
           v = 2;
@@ -168,12 +184,17 @@ class LevenbergMarquardt {
     results.error_magnitude = error.norm();
     results.gradient_magnitude = g.norm();
     results.iterations = i;
+    LIBMV_HISTOGRAM("levenberg_marquardt.iterations", i);
     return results;
   }
 
+  // The linear solver, e.g. to set the options of the conjugate gradients.
+  NormalEquations *normal_equations() { return &normal_equations_; }
+
  private:
   const Function &f_;
   Jacobian df_;
+  NormalEquations normal_equations_;
 };
 
 }  // namespace mv
@@ -52,4 +52,45 @@ TEST(LevenbergMarquardt, SimpleCase) {
   EXPECT_MATRIX_NEAR(expected_min_x, x, 1e-5);
 }
 
+// F, counting its evaluations, with its analytic Jacobian.
+class CountingF : public F {
+ public:
+  CountingF() : num_evaluations(0) {}
+  Vec4 operator()(const Vec3 &x) const {
+    ++num_evaluations;
+    return F::operator()(x);
+  }
+  mutable int num_evaluations;
+};
+
+class CountingFJacobian {
+ public:
+  CountingFJacobian(const CountingF &) {}
+  Matrix<double, 4, 3> operator()(const Vec3 &x) const {
+    double x1 = x.x() - 2;
+    double y1 = x.y() - 5;
+    double z1 = x.z();
+    Matrix<double, 4, 3> J;
+    J << 2*x1,    0, 2*z1,
+            0, 2*y1, 2*z1,
+            0,    0, 2*z1,
+         2*x1,    0,    0;
+    return J;
+  }
+};
+
+TEST(LevenbergMarquardt, EvaluatesEachStepOnce) {
+  typedef LevenbergMarquardt<CountingF, CountingFJacobian> Solver;
+  Vec3 x(0.76026643, -30.01799744, 0.55192142);
+  CountingF f;
+  Solver::SolverParameters params;
+  Solver lm(f);
+  Solver::Results results = lm.minimize(params, &x);
+  Vec3 expected_min_x(2, 5, 0);
+
+  EXPECT_MATRIX_NEAR(expected_min_x, x, 1e-5);
+  // The initial point, then at most one evaluation per iteration.
+  EXPECT_LE(f.num_evaluations, results.iterations + 1);
+}
+
 }  // namespace
@@ -0,0 +1,172 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "colamd.h"
+extern "C" {
+#include "ldl.h"
+}
+
+#include "libmv/numeric/normal_equations.h"
+
+namespace libmv {
+
+SparseCholeskyNormalEquations::SparseCholeskyNormalEquations()
+    : num_analyses_(0) {}
+
+void SparseCholeskyNormalEquations::Linearize(const JMatrixType &J,
+                                              const double *error,
+                                              double *g) {
+  J_ = J;
+  J_.TransposeMultiply(error, g);
+  J_.TransposeTimesSelf(&A_);
+
+  // The diagonal is needed for the damping; add it to the pattern if a
+  // column of J is empty.
+  const int n = A_.cols();
+  if (!FindDiagonal()) {
+    std::vector<int> rows, cols;
+    std::vector<double> values;
+    for (int j = 0; j < n; ++j) {
+      for (int k = A_.column_begin()[j]; k < A_.column_begin()[j + 1]; ++k) {
+        rows.push_back(A_.row_indices()[k]);
+        cols.push_back(j);
+        values.push_back(A_.values()[k]);
+      }
+      rows.push_back(j);
+      cols.push_back(j);
+      values.push_back(0.0);
+    }
+    A_.SetFromTriplets(n, n, rows, cols, values);
+    FindDiagonal();
+  }
+
+  if (A_.column_begin() != analyzed_column_begin_ ||
+      A_.row_indices() != analyzed_rows_) {
+    Analyze();
+  }
+}
+
+bool SparseCholeskyNormalEquations::FindDiagonal() {
+  const int n = A_.cols();
+  diagonal_.resize(n);
+  for (int c = 0; c < n; ++c) {
+    std::vector<int>::const_iterator begin =
+        A_.row_indices().begin() + A_.column_begin()[c];
+    std::vector<int>::const_iterator end =
+        A_.row_indices().begin() + A_.column_begin()[c + 1];
+    std::vector<int>::const_iterator it = std::lower_bound(begin, end, c);
+    if (it == end || *it != c) {
+      return false;
+    }
+    diagonal_[c] = it - A_.row_indices().begin();
+  }
+  return true;
+}
+
+void SparseCholeskyNormalEquations::Analyze() {
+  const int n = A_.cols();
+  analyzed_column_begin_ = A_.column_begin();
+  analyzed_rows_ = A_.row_indices();
+
+  permutation_.resize(n + 1);
+  inverse_permutation_.resize(n);
+  if (n > 0) {
+    int stats[COLAMD_STATS];
+    if (!symamd(n, &analyzed_rows_[0], &analyzed_column_begin_[0],
+                &permutation_[0], NULL, stats, &calloc, &free)) {
+      LOG(ERROR) << "symamd failed; using the natural ordering.";
+      for (int i = 0; i < n; ++i) {
+        permutation_[i] = i;
+      }
+    }
+    for (int i = 0; i < n; ++i) {
+      inverse_permutation_[permutation_[i]] = i;
+    }
+  }
+
+  l_column_begin_.resize(n + 1);
+  parent_.resize(n);
+  l_nonzeros_.resize(n);
+  flag_.resize(n);
+  pattern_.resize(n);
+  d_.resize(n);
+  y_.resize(n);
+  permuted_.resize(n);
+  if (n > 0) {
+    ldl_symbolic(n, &analyzed_column_begin_[0], &analyzed_rows_[0],
+                 &l_column_begin_[0], &parent_[0], &l_nonzeros_[0], &flag_[0],
+                 &permutation_[0], &inverse_permutation_[0]);
+  } else {
+    l_column_begin_[0] = 0;
+  }
+  l_rows_.resize(std::max(l_column_begin_[n], 1));
+  l_values_.resize(std::max(l_column_begin_[n], 1));
+  ++num_analyses_;
+  VLOG(2) << "Normal equations: " << n << " parameters, " << A_.NumNonZeros()
+          << " nonzeros, " << l_column_begin_[n] << " in the factor.";
+}
+
+double SparseCholeskyNormalEquations::MaxDiagonal() const {
+  double max_diagonal = 0;
+  for (size_t i = 0; i < diagonal_.size(); ++i) {
+    max_diagonal = std::max(max_diagonal, A_.values()[diagonal_[i]]);
+  }
+  return max_diagonal;
+}
+
+bool SparseCholeskyNormalEquations::Solve(double u, const double *b,
+                                          double *dx) {
+  const int n = A_.cols();
+  if (n == 0) {
+    return true;
+  }
+  values_ = A_.values();
+  for (int i = 0; i < n; ++i) {
+    values_[diagonal_[i]] += u;
+  }
+  int d = ldl_numeric(n, &analyzed_column_begin_[0], &analyzed_rows_[0],
+                      &values_[0], &l_column_begin_[0], &parent_[0],
+                      &l_nonzeros_[0], &l_rows_[0], &l_values_[0], &d_[0],
+                      &y_[0], &pattern_[0], &flag_[0],
+                      &permutation_[0], &inverse_permutation_[0]);
+  if (d != n) {
+    VLOG(3) << "Normal equations are singular at column " << d;
+    return false;
+  }
+  ldl_perm(n, &permuted_[0], const_cast<double *>(b), &permutation_[0]);
+  ldl_lsolve(n, &permuted_[0], &l_column_begin_[0], &l_rows_[0],
+             &l_values_[0]);
+  ldl_dsolve(n, &permuted_[0], &d_[0]);
+  ldl_ltsolve(n, &permuted_[0], &l_column_begin_[0], &l_rows_[0],
+              &l_values_[0]);
+  ldl_permt(n, dx, &permuted_[0], &permutation_[0]);
+  return true;
+}
+
+double SparseCholeskyNormalEquations::JSquaredNorm(const double *v) {
+  Jv_.resize(J_.rows());
+  J_.Multiply(v, Jv_.data());
+  return Jv_.squaredNorm();
+}
+
+}  // namespace libmv
@@ -0,0 +1,307 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Linear solver policies for the normal equations (J'J + u I) dx = b of
+// LevenbergMarquardt and Dogleg. The third template parameter of both
+// optimizers is either an Eigen decomposition, used on the dense J'J as
+// before, or one of the classes below:
+//
+//  - SparseCholeskyNormalEquations: J is a CompressedColumnMatrix, J'J is
+//    formed sparse, ordered with symamd and factorized with ldl. The
+//    ordering and the symbolic factorization are kept while the sparsity
+//    pattern does not change.
+//  - ConjugateGradientNormalEquations: matrix free; J'J is never formed and
+//    the equations are solved by conjugate gradients preconditioned by the
+//    diagonal of J'J. J is a CompressedColumnMatrix or a dense matrix.
+//
+// A policy provides
+//
+//   typedef ... JMatrixType;
+//   template<typename FVec, typename Vec>
+//   void Linearize(const JMatrixType &J, const FVec &error, Vec *g);
+//   Scalar MaxDiagonal() const;                   // max(diag(J'J))
+//   template<typename Vec>
+//   bool Solve(Scalar u, const Vec &b, Vec *dx);  // (J'J + u I) dx = b
+//   template<typename Vec>
+//   Scalar JSquaredNorm(const Vec &v);            // ||J v||^2
+//
+// where Linearize() sets g = J' error.
+
+#ifndef LIBMV_NUMERIC_NORMAL_EQUATIONS_H
+#define LIBMV_NUMERIC_NORMAL_EQUATIONS_H
+
+#include <cmath>
+#include <vector>
+
+#include "libmv/logging/logging.h"
+#include "libmv/numeric/numeric.h"
+#include "libmv/numeric/sparse_matrix.h"
+
+namespace libmv {
+
+// The dense normal equations, solved with an Eigen decomposition.
+template<typename JType, typename AType, typename Decomposition>
+class DenseNormalEquations {
+ public:
+  typedef JType JMatrixType;
+  typedef typename JType::RealScalar Scalar;
+
+  template<typename FVec, typename Vec>
+  void Linearize(const JMatrixType &J, const FVec &error, Vec *g) {
+    J_ = J;
+    A_ = J.transpose() * J;
+    *g = J.transpose() * error;
+  }
+
+  Scalar MaxDiagonal() const {
+    return A_.diagonal().maxCoeff();
+  }
+
+  template<typename Vec>
+  bool Solve(Scalar u, const Vec &b, Vec *dx) {
+    AType A_augmented = A_ + u * AType::Identity(A_.rows(), A_.cols());
+    Decomposition solver(A_augmented);
+    *dx = solver.solve(b);
+    return (A_augmented * *dx).isApprox(b);
+  }
+
+  template<typename Vec>
+  Scalar JSquaredNorm(const Vec &v) const {
+    return (J_ * v).squaredNorm();
+  }
+
+ private:
+  JMatrixType J_;
+  AType A_;
+};
+
+// Sparse Cholesky (LDL') of the normal equations.
+class SparseCholeskyNormalEquations {
+ public:
+  typedef CompressedColumnMatrix JMatrixType;
+  typedef double Scalar;
+
+  SparseCholeskyNormalEquations();
+
+  template<typename FVec, typename Vec>
+  void Linearize(const JMatrixType &J, const FVec &error, Vec *g) {
+    g->resize(J.cols());
+    Linearize(J, error.data(), g->data());
+  }
+  void Linearize(const JMatrixType &J, const double *error, double *g);
+
+  Scalar MaxDiagonal() const;
+
+  template<typename Vec>
+  bool Solve(Scalar u, const Vec &b, Vec *dx) {
+    dx->resize(b.rows());
+    return Solve(u, b.data(), dx->data());
+  }
+  bool Solve(Scalar u, const double *b, double *dx);
+
+  template<typename Vec>
+  Scalar JSquaredNorm(const Vec &v) {
+    return JSquaredNorm(v.data());
+  }
+  Scalar JSquaredNorm(const double *v);
+
+  // Number of symbolic factorizations done so far.
+  int NumAnalyses() const { return num_analyses_; }
+
+ private:
+  // Sets diagonal_; returns false if A_ lacks diagonal entries.
+  bool FindDiagonal();
+  void Analyze();
+
+  JMatrixType J_;
+  CompressedColumnMatrix A_;
+  std::vector<int> diagonal_;  // Position of A(i, i) in A_.values().
+  Vec Jv_;
+  int num_analyses_;
+
+  // Ordering and factorization, see ldl.h.
+  std::vector<int> analyzed_column_begin_, analyzed_rows_;
+  std::vector<int> permutation_, inverse_permutation_;
+  std::vector<int> l_column_begin_, l_rows_, parent_, l_nonzeros_;
+  std::vector<int> flag_, pattern_;
+  std::vector<double> values_, l_values_, d_, y_, permuted_;
+};
+
+namespace normal_equations {
+
+// Products with the Jacobian, for the matrix free solver.
+inline void Multiply(const CompressedColumnMatrix &J, const double *x,
+                     double *y) {
+  J.Multiply(x, y);
+}
+
+inline void TransposeMultiply(const CompressedColumnMatrix &J, const double *x,
+                              double *y) {
+  J.TransposeMultiply(x, y);
+}
+
+inline void ColumnSquaredNorms(const CompressedColumnMatrix &J,
+                               double *norms) {
+  J.ColumnSquaredNorms(norms);
+}
+
+template<typename Matrix>
+void Multiply(const Matrix &J, const double *x, double *y) {
+  Eigen::Map<Vec>(y, J.rows()) = J * Eigen::Map<const Vec>(x, J.cols());
+}
+
+template<typename Matrix>
+void TransposeMultiply(const Matrix &J, const double *x, double *y) {
+  Eigen::Map<Vec>(y, J.cols()) =
+      J.transpose() * Eigen::Map<const Vec>(x, J.rows());
+}
+
+template<typename Matrix>
+void ColumnSquaredNorms(const Matrix &J, double *norms) {
+  for (int c = 0; c < J.cols(); ++c) {
+    norms[c] = J.col(c).squaredNorm();
+  }
+}
+
+}  // namespace normal_equations
+
+// Matrix free normal equations, solved by preconditioned conjugate gradients.
+template<typename JType = CompressedColumnMatrix>
+class ConjugateGradientNormalEquations {
+ public:
+  typedef JType JMatrixType;
+  typedef double Scalar;
+
+  ConjugateGradientNormalEquations()
+      : max_iterations_(500), tolerance_(1e-10), iterations_(0) {}
+
+  // The iterations stop when ||r|| < tolerance ||b||, or after
+  // max_iterations.
+  void set_max_iterations(int max_iterations) {
+    max_iterations_ = max_iterations;
+  }
+  void set_tolerance(double tolerance) { tolerance_ = tolerance; }
+
+  // Iterations done by the last Solve().
+  int iterations() const { return iterations_; }
+
+  template<typename FVec, typename Vec>
+  void Linearize(const JMatrixType &J, const FVec &error, Vec *g) {
+    J_ = J;
+    g->resize(J.cols());
+    normal_equations::TransposeMultiply(J_, error.data(), g->data());
+    diagonal_.resize(J.cols());
+    normal_equations::ColumnSquaredNorms(J_, diagonal_.data());
+  }
+
+  Scalar MaxDiagonal() const {
+    return diagonal_.size() > 0 ? diagonal_.maxCoeff() : 0;
+  }
+
+  template<typename V>
+  bool Solve(Scalar u, const V &b, V *dx) {
+    dx->resize(b.rows());
+    return Solve(u, b.data(), dx->data());
+  }
+
+  bool Solve(Scalar u, const double *b_data, double *dx_data) {
+    const int n = diagonal_.size();
+    Eigen::Map<const Vec> b(b_data, n);
+    Eigen::Map<Vec> x(dx_data, n);
+    x.setZero();
+    Vec r = b, z(n), p(n), q(n);
+    Jv_.resize(J_.rows());
+    Vec inverse_diagonal = (diagonal_.array() + u).inverse();
+    if (!(inverse_diagonal.array() < HUGE_VAL).all()) {
+      // Unpreconditioned on a zero diagonal.
+      inverse_diagonal.setOnes();
+    }
+    double threshold = tolerance_ * b.norm();
+    z = inverse_diagonal.cwiseProduct(r);
+    p = z;
+    double rz = r.dot(z);
+    for (iterations_ = 0; iterations_ < max_iterations_; ++iterations_) {
+      if (r.norm() <= threshold) {
+        break;
+      }
+      // q = (J'J + u I) p.
+      normal_equations::Multiply(J_, p.data(), Jv_.data());
+      normal_equations::TransposeMultiply(J_, Jv_.data(), q.data());
+      q += u * p;
+      double pq = p.dot(q);
+      if (!(pq > 0)) {
+        LOG(ERROR) << "Conjugate gradients broke down.";
+        return false;
+      }
+      double alpha = rz / pq;
+      x += alpha * p;
+      r -= alpha * q;
+      z = inverse_diagonal.cwiseProduct(r);
+      double rz_new = r.dot(z);
+      p = z + (rz_new / rz) * p;
+      rz = rz_new;
+    }
+    return true;
+  }
+
+  template<typename V>
+  Scalar JSquaredNorm(const V &v) {
+    Jv_.resize(J_.rows());
+    normal_equations::Multiply(J_, v.data(), Jv_.data());
+    return Jv_.squaredNorm();
+  }
+
+ private:
+  JMatrixType J_;
+  Vec diagonal_;
+  Vec Jv_;
+  int max_iterations_;
+  double tolerance_;
+  int iterations_;
+};
+
+namespace normal_equations {
+
+// Selects the policy: Solver itself if it is one (has a JMatrixType),
+// otherwise the dense normal equations solved with the decomposition Solver.
+template<typename T>
+struct IsPolicy {
+  typedef char Yes;
+  typedef char (&No)[2];
+  template<typename U> static Yes Test(typename U::JMatrixType *);
+  template<typename U> static No Test(...);
+  enum { value = sizeof(Test<T>(0)) == sizeof(Yes) };
+};
+
+template<typename Solver, typename JType, typename AType,
+         bool is_policy = IsPolicy<Solver>::value>
+struct Select {
+  typedef DenseNormalEquations<JType, AType, Solver> Type;
+};
+
+template<typename Solver, typename JType, typename AType>
+struct Select<Solver, JType, AType, true> {
+  typedef Solver Type;
+};
+
+}  // namespace normal_equations
+}  // namespace libmv
+
+#endif  // LIBMV_NUMERIC_NORMAL_EQUATIONS_H
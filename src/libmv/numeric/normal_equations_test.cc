@@ -0,0 +1,189 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <vector>
+
+#include "libmv/numeric/dogleg.h"
+#include "libmv/numeric/levenberg_marquardt.h"
+#include "libmv/numeric/normal_equations.h"
+#include "testing/testing.h"
+
+using namespace libmv;
+
+namespace {
+
+// A large problem with a sparse Jacobian: x_i^2 = a_i, with a smoothness
+// term w (x_{i+1} - x_i).
+class Chain {
+ public:
+  typedef Vec FMatrixType;
+  typedef Vec XMatrixType;
+
+  Chain(int n, double w) : n_(n), w_(w) {}
+
+  Vec operator()(const Vec &x) const {
+    Vec fx(2 * n_ - 1);
+    for (int i = 0; i < n_; ++i) {
+      fx(i) = x(i) * x(i) - Target(i);
+    }
+    for (int i = 0; i + 1 < n_; ++i) {
+      fx(n_ + i) = w_ * (x(i + 1) - x(i));
+    }
+    return fx;
+  }
+
+  double Target(int i) const { return 1 + double(i % 7) / 7; }
+
+  // For GroupedNumericJacobian.
+  void JacobianPattern(CompressedColumnMatrix *pattern) const {
+    std::vector<int> rows, cols;
+    for (int i = 0; i < n_; ++i) {
+      rows.push_back(i); cols.push_back(i);
+    }
+    for (int i = 0; i + 1 < n_; ++i) {
+      rows.push_back(n_ + i); cols.push_back(i);
+      rows.push_back(n_ + i); cols.push_back(i + 1);
+    }
+    std::vector<double> values(rows.size(), 0.0);
+    pattern->SetFromTriplets(2 * n_ - 1, n_, rows, cols, values);
+  }
+
+  int n_;
+  double w_;
+};
+
+class SparseChainJacobian {
+ public:
+  SparseChainJacobian(const Chain &f) : f_(f) {}
+
+  CompressedColumnMatrix operator()(const Vec &x) {
+    std::vector<int> rows, cols;
+    std::vector<double> values;
+    for (int i = 0; i < f_.n_; ++i) {
+      rows.push_back(i); cols.push_back(i); values.push_back(2 * x(i));
+    }
+    for (int i = 0; i + 1 < f_.n_; ++i) {
+      rows.push_back(f_.n_ + i); cols.push_back(i); values.push_back(-f_.w_);
+      rows.push_back(f_.n_ + i); cols.push_back(i + 1); values.push_back(f_.w_);
+    }
+    CompressedColumnMatrix J;
+    J.SetFromTriplets(2 * f_.n_ - 1, f_.n_, rows, cols, values);
+    return J;
+  }
+
+ private:
+  const Chain &f_;
+};
+
+class DenseChainJacobian {
+ public:
+  DenseChainJacobian(const Chain &f) : sparse_(f) {}
+  Mat operator()(const Vec &x) { return sparse_(x).ToDense(); }
+
+ private:
+  SparseChainJacobian sparse_;
+};
+
+const int kSize = 60;
+
+Vec DenseSolution(const Chain &f) {
+  Vec x = Vec::Ones(kSize) * 2;
+  LevenbergMarquardt<Chain, DenseChainJacobian> lm(f);
+  lm.minimize(&x);
+  return x;
+}
+
+TEST(SparseCholeskyNormalEquations, LevenbergMarquardt) {
+  Chain f(kSize, 0.3);
+  Vec x = Vec::Ones(kSize) * 2;
+  typedef LevenbergMarquardt<Chain, SparseChainJacobian,
+                             SparseCholeskyNormalEquations> Solver;
+  Solver lm(f);
+  Solver::Results results = lm.minimize(&x);
+  EXPECT_GT(results.iterations, 1);
+  Vec expected = DenseSolution(f);
+  EXPECT_MATRIX_NEAR(expected, x, 1e-8);
+  // The pattern of J does not change: it is analyzed once.
+  EXPECT_EQ(1, lm.normal_equations()->NumAnalyses());
+}
+
+TEST(SparseCholeskyNormalEquations, GroupedNumericJacobian) {
+  Chain f(kSize, 0.3);
+  Vec x = Vec::Ones(kSize) * 2;
+  typedef LevenbergMarquardt<Chain, GroupedNumericJacobian<Chain>,
+                             SparseCholeskyNormalEquations> Solver;
+  Solver lm(f);
+  lm.minimize(&x);
+  Vec expected = DenseSolution(f);
+  EXPECT_MATRIX_NEAR(expected, x, 1e-6);
+  EXPECT_EQ(1, lm.normal_equations()->NumAnalyses());
+}
+
+TEST(SparseCholeskyNormalEquations, Dogleg) {
+  Chain f(kSize, 0.3);
+  Vec x = Vec::Ones(kSize) * 2;
+  Dogleg<Chain, SparseChainJacobian, SparseCholeskyNormalEquations> dogleg(f);
+  dogleg.minimize(&x);
+  Vec expected = DenseSolution(f);
+  EXPECT_MATRIX_NEAR(expected, x, 1e-6);
+}
+
+TEST(ConjugateGradientNormalEquations, LevenbergMarquardt) {
+  Chain f(kSize, 0.3);
+  Vec x = Vec::Ones(kSize) * 2;
+  typedef LevenbergMarquardt<Chain, SparseChainJacobian,
+                             ConjugateGradientNormalEquations<> > Solver;
+  Solver lm(f);
+  lm.normal_equations()->set_tolerance(1e-12);
+  lm.minimize(&x);
+  Vec expected = DenseSolution(f);
+  EXPECT_MATRIX_NEAR(expected, x, 1e-8);
+}
+
+TEST(ConjugateGradientNormalEquations, DenseJacobian) {
+  Chain f(kSize, 0.3);
+  Vec x = Vec::Ones(kSize) * 2;
+  typedef LevenbergMarquardt<Chain, DenseChainJacobian,
+                             ConjugateGradientNormalEquations<Mat> > Solver;
+  Solver lm(f);
+  lm.normal_equations()->set_tolerance(1e-12);
+  lm.minimize(&x);
+  Vec expected = DenseSolution(f);
+  EXPECT_MATRIX_NEAR(expected, x, 1e-8);
+}
+
+TEST(ConjugateGradientNormalEquations, SolvesTheDampedSystem) {
+  Mat J = Mat::Random(8, 5);
+  Vec e = Vec::Random(8);
+  ConjugateGradientNormalEquations<Mat> equations;
+  equations.set_tolerance(1e-14);
+  Vec g, dx;
+  equations.Linearize(J, e, &g);
+  Vec expected_g = J.transpose() * e;
+  EXPECT_MATRIX_NEAR(expected_g, g, 1e-14);
+  EXPECT_TRUE(equations.Solve(0.5, g, &dx));
+  Mat A = J.transpose() * J + 0.5 * Mat::Identity(5, 5);
+  Vec Adx = A * dx;
+  EXPECT_MATRIX_NEAR(Adx, g, 1e-10);
+  // At most n iterations in exact arithmetic.
+  EXPECT_LE(equations.iterations(), 6);
+}
+
+}  // namespace
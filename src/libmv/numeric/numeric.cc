@@ -74,14 +74,6 @@ Mat3 LookAt(Vec3 center) {
   return R;
 }
 
-Mat3 CrossProductMatrix(const Vec3 &x) {
-  Mat3 X;
-  X <<     0, -x(2),  x(1),
-        x(2),     0, -x(0),
-       -x(1),  x(0),     0;
-  return X;
-}
-
 void MeanAndVarianceAlongRows(const Mat &A,
                               Vec *mean_pointer,
                               Vec *variance_pointer) {
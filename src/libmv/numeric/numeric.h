@@ -120,6 +120,10 @@ typedef Eigen::Matrix<double, 20, 1> Vec20;
 typedef Eigen::Vector2f Vec2f;
 typedef Eigen::Vector3f Vec3f;
 typedef Eigen::Vector4f Vec4f;
+typedef Eigen::Matrix<float, 6, 1>  Vec6f;
+typedef Eigen::Matrix<float, 8, 1>  Vec8f;
+typedef Eigen::Matrix<float, 9, 1>  Vec9f;
+typedef Eigen::Matrix<float, 16, 1> Vec16f;
 
 typedef Eigen::VectorXi VecXi;
 
@@ -147,34 +151,143 @@ inline void SVD(TMat *A, Vec *s, Mat *U, Mat *VT) {
   assert(0);
 }
 
+// The largest number of columns for which Nullspace() and Nullspace2() use
+// a QR reduction before the SVD.
+enum { MAX_NULLSPACE_QR_COLS = 16 };
+
+namespace nullspace {
+
+// Solves Ax = 0 with the SVD of A, for any size.
+template <typename TMat, bool kUseQR>
+struct Solver {
+  template <typename TVec>
+  static double Solve(TMat *A, TVec *nullspace) {
+    Eigen::JacobiSVD<TMat> svd(*A, Eigen::ComputeFullV);
+    (*nullspace) = svd.matrixV().col(A->cols()-1);
+    if (A->rows() >= A->cols())
+      return svd.singularValues()(A->cols()-1);
+    else
+      return 0.0;
+  }
+
+  template <typename TVec1, typename TVec2>
+  static double Solve2(TMat *A, TVec1 *x1, TVec2 *x2) {
+    Eigen::JacobiSVD<TMat> svd(*A, Eigen::ComputeFullV);
+    *x1 = svd.matrixV().col(A->cols() - 1);
+    *x2 = svd.matrixV().col(A->cols() - 2);
+    if (A->rows() >= A->cols())
+      return svd.singularValues()(A->cols()-1);
+    else
+      return 0.0;
+  }
+};
+
+// Solves Ax = 0 for a matrix A with a small fixed number of columns C and any
+// number of rows. A = QR is first reduced to its C x C triangular factor R,
+// which has the singular values and right singular vectors of A, and only R
+// goes through the SVD, with fixed size matrices. This costs about as much as
+// forming A^T A but keeps the accuracy of the SVD of A.
+template <typename TMat>
+struct Solver<TMat, true> {
+  typedef typename TMat::Scalar Scalar;
+  enum { C = TMat::ColsAtCompileTime };
+  typedef Eigen::Matrix<Scalar, C, C> SquareMatrix;
+
+  // Stores in R a C x C matrix with the same right singular vectors and
+  // singular values as A.
+  static void TriangularFactor(const TMat &A, SquareMatrix *R) {
+    R->setZero();
+    if (A.rows() < C) {
+      // A padded with zeros is already a C x C factor.
+      R->topRows(A.rows()) = A;
+      return;
+    }
+    Eigen::HouseholderQR<TMat> qr(A);
+    R->template triangularView<Eigen::Upper>() =
+        qr.matrixQR().template topRows<C>();
+  }
+
+  template <typename TVec>
+  static double Solve(TMat *A, TVec *nullspace) {
+    SquareMatrix R;
+    TriangularFactor(*A, &R);
+    Eigen::JacobiSVD<SquareMatrix> svd(R, Eigen::ComputeFullV);
+    (*nullspace) = svd.matrixV().col(C - 1);
+    if (A->rows() >= A->cols())
+      return svd.singularValues()(C - 1);
+    else
+      return 0.0;
+  }
+
+  template <typename TVec1, typename TVec2>
+  static double Solve2(TMat *A, TVec1 *x1, TVec2 *x2) {
+    SquareMatrix R;
+    TriangularFactor(*A, &R);
+    Eigen::JacobiSVD<SquareMatrix> svd(R, Eigen::ComputeFullV);
+    *x1 = svd.matrixV().col(C - 1);
+    *x2 = svd.matrixV().col(C - 2);
+    if (A->rows() >= A->cols())
+      return svd.singularValues()(C - 1);
+    else
+      return 0.0;
+  }
+};
+
+// Whether TMat has a small number of columns known at compile time and a
+// number of rows that is not, as the designs with one or two rows per
+// correspondence. The fully fixed size matrices keep the SVD, which does not
+// allocate for them.
+template <typename TMat>
+struct UseQR {
+  enum {
+    value = TMat::RowsAtCompileTime == Eigen::Dynamic &&
+            TMat::ColsAtCompileTime != Eigen::Dynamic &&
+            TMat::ColsAtCompileTime <= MAX_NULLSPACE_QR_COLS
+  };
+};
+
+}  // namespace nullspace
+
 // Solve the linear system Ax = 0 via SVD. Store the solution in x, such that
 // ||x|| = 1.0. Return the singluar value corresponding to the solution.
 // Destroys A and resizes x if necessary.
+// When the number of columns of TMat is fixed and small but not its number of
+// rows, as for the DLT designs (e.g. MatX9 or Matrix<double, Dynamic, 4>), the
+// SVD is only taken of the fixed size triangular factor of the QR decomposition
+// of A, which is chosen at compile time.
 // TODO(maclean): Take the SVD of the transpose instead of this zero padding.
 template <typename TMat, typename TVec>
 double Nullspace(TMat *A, TVec *nullspace) {
-  Eigen::JacobiSVD<TMat> svd(*A, Eigen::ComputeFullV);
-  (*nullspace) = svd.matrixV().col(A->cols()-1);
-  if (A->rows() >= A->cols())
-    return svd.singularValues()(A->cols()-1);
-  else
-    return 0.0;
+  return nullspace::Solver<
+      TMat, nullspace::UseQR<TMat>::value>::Solve(A, nullspace);
 }
 
 // Solve the linear system Ax = 0 via SVD. Finds two solutions, x1 and x2, such
 // that x1 is the best solution and x2 is the next best solution (in the L2
 // norm sense). Store the solution in x1 and x2, such that ||x|| = 1.0. Return
 // the singluar value corresponding to the solution x1.  Destroys A and resizes
-// x if necessary.
+// x if necessary. Like Nullspace(), small fixed numbers of columns use a QR
+// reduction first.
 template <typename TMat, typename TVec1, typename TVec2>
 double Nullspace2(TMat *A, TVec1 *x1, TVec2 *x2) {
-  Eigen::JacobiSVD<TMat> svd(*A, Eigen::ComputeFullV);
-  *x1 = svd.matrixV().col(A->cols() - 1);
-  *x2 = svd.matrixV().col(A->cols() - 2);
-  if (A->rows() >= A->cols())
-    return svd.singularValues()(A->cols()-1);
-  else
-    return 0.0;
+  return nullspace::Solver<
+      TMat, nullspace::UseQR<TMat>::value>::Solve2(A, x1, x2);
+}
+
+// Solve the linear system Ax = 0 for a fixed size R x C matrix A with R < C,
+// as found in minimal solvers. Stores an orthonormal basis of the nullspace in
+// the columns of basis, from the QR decomposition of the transpose of A: the
+// columns of Q past the first R are orthogonal to the rows of A. Unlike
+// Nullspace() this does not allocate and is cheaper than the SVD. Returns
+// false if A does not have full rank, in which case the nullspace is larger
+// than basis.
+template <int R, int C>
+bool MinimalNullspace(const Eigen::Matrix<double, R, C> &A,
+                      Eigen::Matrix<double, C, C - R> *basis) {
+  Eigen::ColPivHouseholderQR<Eigen::Matrix<double, C, R> > qr(A.transpose());
+  Eigen::Matrix<double, C, C> Q = qr.householderQ();
+  *basis = Q.template rightCols<C - R>();
+  return qr.rank() == R;
 }
 
 // In place transpose for square matrices.
@@ -199,16 +312,33 @@ inline double NormLInfinity(const TVec &x) {
 }
 
 template<typename TVec>
-inline double DistanceL1(const TVec &x, const TVec &y) {
+inline double SquaredNormL2(const TVec &x) {
+  return x.squaredNorm();
+}
+
+// The distances take any two vector expressions of the same scalar type and
+// size, e.g. a Vec2f and a column of a Matf, without copying them. For the
+// fixed size types (Vec2, Vec4f, Vec16f, ...) the difference is evaluated in
+// registers.
+template<typename TVec1, typename TVec2>
+inline double DistanceL1(const TVec1 &x, const TVec2 &y) {
   return (x - y).array().abs().sum();
 }
 
-template<typename TVec>
-inline double DistanceL2(const TVec &x, const TVec &y) {
+template<typename TVec1, typename TVec2>
+inline double DistanceL2(const TVec1 &x, const TVec2 &y) {
   return (x - y).norm();
 }
-template<typename TVec>
-inline double DistanceLInfinity(const TVec &x, const TVec &y) {
+
+// Cheaper than DistanceL2() when only comparing distances, as for nearest
+// neighbors and inlier thresholds.
+template<typename TVec1, typename TVec2>
+inline double SquaredDistanceL2(const TVec1 &x, const TVec2 &y) {
+  return (x - y).squaredNorm();
+}
+
+template<typename TVec1, typename TVec2>
+inline double DistanceLInfinity(const TVec1 &x, const TVec2 &y) {
   return (x - y).array().abs().maxCoeff();
 }
 
@@ -278,7 +408,13 @@ inline Vec3 CrossProduct(const Vec3 &x, const Vec3 &y) {
   return x.cross(y);
 }
 
-Mat3 CrossProductMatrix(const Vec3 &x);
+inline Mat3 CrossProductMatrix(const Vec3 &x) {
+  Mat3 X;
+  X <<     0, -x(2),  x(1),
+        x(2),     0, -x(0),
+       -x(1),  x(0),     0;
+  return X;
+}
 
 void MeanAndVarianceAlongRows(const Mat &A,
                               Vec *mean_pointer,
@@ -471,7 +607,7 @@ inline Mat3 SkewMat(const Vec3 &x) {
 inline Mat23 SkewMatMinimal(const Vec2 &x) {
   Mat23 skew;
   skew << 0,-1, x(1),
-          1, 0 -x(0);
+          1, 0, -x(0);
   return skew;
 }
 } // namespace libmv
@@ -90,6 +90,59 @@ TEST(Numeric, Nullspace2) {
   EXPECT_NEAR( 0.07168809, x2(2), 1e-8);
 }
 
+TEST(Numeric, DynamicRowsNullspaceMatchesSVD) {
+  // Goes through the QR reduction, unlike the Mat43 above.
+  Eigen::Matrix<double, Eigen::Dynamic, 3> A(4, 3);
+  A << 0.76026643, 0.01799744, 0.55192142,
+       0.8699745,  0.42016166, 0.97863392,
+       0.33711682, 0.14479271, 0.51016811,
+       0.66528302, 0.54395496, 0.57794893;
+  Vec3 x1, x2;
+  double s = Nullspace2(&A, &x1, &x2);
+  EXPECT_NEAR(1.0, x1.norm(), 1e-15);
+  EXPECT_NEAR(0.206694992663, s, 1e-9);
+  EXPECT_NEAR(0.206694992663, (A * x1).norm(), 1e-9);
+
+  if (x1(0) > 0) {
+    x1 *= -1;
+  }
+  EXPECT_NEAR(-0.64999717, x1(0), 1e-8);
+  EXPECT_NEAR(-0.18452646, x1(1), 1e-8);
+  EXPECT_NEAR( 0.7371931,  x1(2), 1e-8);
+
+  if (x2(0) < 0) {
+    x2 *= -1;
+  }
+  EXPECT_NEAR( 0.34679618, x2(0), 1e-8);
+  EXPECT_NEAR(-0.93519689, x2(1), 1e-8);
+  EXPECT_NEAR( 0.07168809, x2(2), 1e-8);
+
+  Vec3 x;
+  EXPECT_NEAR(s, Nullspace(&A, &x), 1e-12);
+  EXPECT_NEAR(1.0, std::abs(x.dot(x1)), 1e-12);
+}
+
+TEST(Numeric, DynamicRowsNullspaceFewerRowsThanColumns) {
+  Eigen::Matrix<double, Eigen::Dynamic, 4> A(3, 4);
+  A << 0.76026643, 0.01799744, 0.55192142, 0.8699745,
+       0.42016166, 0.97863392, 0.33711682, 0.14479271,
+       0.51016811, 0.66528302, 0.54395496, 0.57794893;
+  Vec4 x;
+  double s = Nullspace(&A, &x);
+  EXPECT_EQ(0.0, s);
+  EXPECT_NEAR(0.0, (A * x).norm(), 1e-15);
+  EXPECT_NEAR(1.0, x.norm(), 1e-15);
+}
+
+TEST(Numeric, SkewMatMinimal) {
+  Vec2 x(2, 3);
+  Vec3 y(5, 7, 1);
+  Vec3 cross = SkewMat(Vec3(x(0), x(1), 1)) * y;
+  Vec2 expected = cross.head<2>();
+  Vec2 minimal = SkewMatMinimal(x) * y;
+  EXPECT_MATRIX_NEAR(expected, minimal, 1e-15);
+}
+
 TEST(Numeric, TinyMatrixSquareTranspose) {
   Mat2 A;
   A << 1.0, 2.0, 3.0, 4.0;
@@ -20,4 +20,222 @@
 //
 // Routines for solving polynomials.
 
-// TODO(keir): Add a solver for degree > 3 polynomials.
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include "libmv/numeric/poly.h"
+
+namespace libmv {
+
+namespace {
+
+// Sturm sequence p_0 = p, p_1 = p', p_{i+1} = -(p_{i-1} mod p_i).
+struct SturmSequence {
+  double p[MAX_STURM_DEGREE + 1][MAX_STURM_DEGREE + 1];
+  int degree[MAX_STURM_DEGREE + 1];
+  int size;
+};
+
+double EvaluatePolynomial(const double *p, int degree, double x) {
+  double value = p[degree];
+  for (int i = degree - 1; i >= 0; --i) {
+    value = value * x + p[i];
+  }
+  return value;
+}
+
+// Scales p so that its largest coefficient is 1 in absolute value, which
+// keeps the signs and avoids overflows along the sequence, and drops the
+// leading coefficients that are negligible. Returns the degree, -1 if p is
+// zero.
+int NormalizePolynomial(double *p, int degree, double zero) {
+  double scale = 0;
+  for (int i = 0; i <= degree; ++i) {
+    scale = std::max(scale, std::fabs(p[i]));
+  }
+  if (scale <= zero) {
+    return -1;
+  }
+  for (int i = 0; i <= degree; ++i) {
+    p[i] /= scale;
+  }
+  while (degree >= 0 && std::fabs(p[degree]) <= 1e-12) {
+    --degree;
+  }
+  return degree;
+}
+
+void BuildSturmSequence(const double *coeffs, int degree,
+                        SturmSequence *sequence) {
+  double (*p)[MAX_STURM_DEGREE + 1] = sequence->p;
+  int *d = sequence->degree;
+  std::copy(coeffs, coeffs + degree + 1, p[0]);
+  d[0] = NormalizePolynomial(p[0], degree, 0);
+  for (int i = 1; i <= d[0]; ++i) {
+    p[1][i - 1] = i * p[0][i];
+  }
+  d[1] = NormalizePolynomial(p[1], d[0] - 1, 0);
+  sequence->size = 2;
+  while (d[sequence->size - 1] > 0) {
+    int i = sequence->size;
+    // The remainder of the division of p_{i-2} by p_{i-1}.
+    const double *a = p[i - 2], *b = p[i - 1];
+    double *r = p[i];
+    std::copy(a, a + d[i - 2] + 1, r);
+    for (int k = d[i - 2] - d[i - 1]; k >= 0; --k) {
+      double q = r[d[i - 1] + k] / b[d[i - 1]];
+      for (int j = 0; j <= d[i - 1]; ++j) {
+        r[j + k] -= q * b[j];
+      }
+    }
+    for (int j = 0; j < d[i - 1]; ++j) {
+      r[j] = -r[j];
+    }
+    // A vanishing remainder means p_{i-1} is the gcd of p and p', i.e. p has
+    // multiple roots; the sequence still counts distinct roots.
+    d[i] = NormalizePolynomial(r, d[i - 1] - 1, 1e-12);
+    if (d[i] < 0) {
+      break;
+    }
+    sequence->size++;
+  }
+}
+
+int SignChanges(const SturmSequence &sequence, double x) {
+  int changes = 0;
+  double previous = 0;
+  for (int i = 0; i < sequence.size; ++i) {
+    double value = EvaluatePolynomial(sequence.p[i], sequence.degree[i], x);
+    if (value != 0) {
+      if (previous != 0 && (value < 0) != (previous < 0)) {
+        ++changes;
+      }
+      previous = value;
+    }
+  }
+  return changes;
+}
+
+bool SmallInterval(double a, double b) {
+  return b - a <= 1e-14 * std::max(1.0, std::max(std::fabs(a),
+                                                  std::fabs(b)));
+}
+
+// Evaluates p and its derivative at x with the Horner scheme.
+void EvaluatePolynomialAndDerivative(const double *p, int degree, double x,
+                                     double *value, double *derivative) {
+  *value = p[degree];
+  *derivative = 0;
+  for (int i = degree - 1; i >= 0; --i) {
+    *derivative = *derivative * x + *value;
+    *value = *value * x + p[i];
+  }
+}
+
+// Refines the single root of p in [a, b], where p changes sign (fa = p(a)).
+// Newton steps converge quadratically near the root; a step that leaves the
+// bracket, or does not halve the previous one, is replaced by a bisection so
+// that the bracket always shrinks.
+double RefineRoot(const double *p, int degree, double a, double b,
+                  double fa) {
+  double x = 0.5 * (a + b);
+  double previous_step = b - a, step = previous_step;
+  for (int iteration = 0; iteration < 100; ++iteration) {
+    double fx, dfx;
+    EvaluatePolynomialAndDerivative(p, degree, x, &fx, &dfx);
+    if (fx == 0) {
+      return x;
+    }
+    // Keep the sign change inside [a, b].
+    if ((fx < 0) == (fa < 0)) {
+      a = x;
+      fa = fx;
+    } else {
+      b = x;
+    }
+    double newton = dfx != 0 ? x - fx / dfx : a;
+    if (newton <= a || newton >= b ||
+        std::fabs(newton - x) > 0.5 * std::fabs(previous_step)) {
+      previous_step = step;
+      step = 0.5 * (b - a);
+      x = a + step;
+    } else {
+      previous_step = step;
+      step = newton - x;
+      x = newton;
+    }
+    if (SmallInterval(a, b) ||
+        std::fabs(step) <= 1e-15 * std::max(1.0, std::fabs(x))) {
+      return x;
+    }
+  }
+  return x;
+}
+
+// Stores the roots in (a, b], where the sequence has va and vb sign changes.
+void IsolateRoots(const SturmSequence &sequence,
+                  double a, double b, int va, int vb,
+                  double *roots, int *num_roots) {
+  int count = va - vb;
+  if (count <= 0) {
+    return;
+  }
+  const double *p = sequence.p[0];
+  int degree = sequence.degree[0];
+  if (count == 1) {
+    double fa = EvaluatePolynomial(p, degree, a);
+    double fb = EvaluatePolynomial(p, degree, b);
+    if (fb == 0) {
+      roots[(*num_roots)++] = b;
+      return;
+    }
+    if ((fa < 0) != (fb < 0)) {
+      roots[(*num_roots)++] = RefineRoot(p, degree, a, b, fa);
+      return;
+    }
+  }
+  double middle = 0.5 * (a + b);
+  if (SmallInterval(a, b) || middle <= a || middle >= b) {
+    // A multiple root, or roots closer than the precision.
+    roots[(*num_roots)++] = middle;
+    return;
+  }
+  int vm = SignChanges(sequence, middle);
+  IsolateRoots(sequence, a, middle, va, vm, roots, num_roots);
+  IsolateRoots(sequence, middle, b, vm, vb, roots, num_roots);
+}
+
+}  // namespace
+
+int FindRealPolynomialRootsSturm(const double *coeffs, int degree,
+                                 double *roots) {
+  assert(degree <= MAX_STURM_DEGREE);
+  while (degree > 0 && coeffs[degree] == 0) {
+    --degree;
+  }
+  if (degree <= 0) {
+    return 0;
+  }
+  // All the roots are within the Cauchy bound.
+  double bound = 0;
+  for (int i = 0; i < degree; ++i) {
+    bound = std::max(bound, std::fabs(coeffs[i] / coeffs[degree]));
+  }
+  bound += 1;
+  if (!(bound <= std::numeric_limits<double>::max())) {
+    // Not a number, or a negligible leading coefficient.
+    return 0;
+  }
+
+  SturmSequence sequence;
+  BuildSturmSequence(coeffs, degree, &sequence);
+  int num_roots = 0;
+  IsolateRoots(sequence, -bound, bound,
+               SignChanges(sequence, -bound), SignChanges(sequence, bound),
+               roots, &num_roots);
+  return num_roots;
+}
+
+}  // namespace libmv
@@ -21,11 +21,48 @@
 #ifndef LIBMV_NUMERIC_POLY_H_
 #define LIBMV_NUMERIC_POLY_H_
 
+#include <algorithm>
 #include <cmath>
 #include <stdio.h>
 
+#include <Eigen/Eigenvalues>
+
 namespace libmv {
 
+// Solve the quadratic polynomial
+//
+//   a*x^2 + b*x + c = 0
+//
+// The number of real roots (zero to two; one if a is zero) is returned and the
+// roots are stored in ascending order. A double root is returned twice. The
+// roots are computed without the cancellation of the textbook formula.
+template<typename Real>
+int SolveQuadraticPolynomial(Real a, Real b, Real c, Real *x0, Real *x1) {
+  if (a == 0) {
+    if (b == 0) {
+      return 0;
+    }
+    *x0 = -c / b;
+    return 1;
+  }
+  Real delta = b * b - 4 * a * c;
+  if (delta < 0) {
+    return 0;
+  }
+  Real q = -(b + (b >= 0 ? 1 : -1) * sqrt(delta)) / 2;
+  if (q == 0) {
+    // b and c are zero.
+    *x0 = *x1 = 0;
+    return 2;
+  }
+  *x0 = q / a;
+  *x1 = c / q;
+  if (*x0 > *x1) {
+    std::swap(*x0, *x1);
+  }
+  return 2;
+}
+
 // Solve the cubic polynomial
 //
 //   x^3 + a*x^2 + b*x + c = 0
@@ -106,10 +143,10 @@ int SolveCubicPolynomial(Real a, Real b, Real c,
 // The coefficients are in ascending powers, i.e. coeffs[N]*x^N.
 template<typename Real>
 int SolveCubicPolynomial(const Real *coeffs, Real *solutions) {
-  if (coeffs[0] == 0.0) {
-    // TODO(keir): This is a quadratic not a cubic. Implement a quadratic
-    // solver!
-    return 0;
+  if (coeffs[3] == 0.0) {
+    // This is a quadratic not a cubic.
+    return SolveQuadraticPolynomial(coeffs[2], coeffs[1], coeffs[0],
+                                    solutions + 0, solutions + 1);
   }
   Real a = coeffs[2] / coeffs[3];
   Real b = coeffs[1] / coeffs[3];
@@ -119,5 +156,72 @@ int SolveCubicPolynomial(const Real *coeffs, Real *solutions) {
                               solutions + 1,
                               solutions + 2);
 }
+
+enum { MAX_STURM_DEGREE = 20 };
+
+// Find the real roots of a polynomial of degree at most MAX_STURM_DEGREE. The
+// coefficients are in ascending powers, i.e. coeffs[N]*x^N. The roots are
+// isolated with a Sturm sequence and then refined by Newton iterations kept
+// inside their bracket, falling back to bisection when a step leaves it; a
+// multiple root is returned once. The roots are stored in ascending order and
+// their number is returned. Nothing is allocated.
+int FindRealPolynomialRootsSturm(const double *coeffs, int degree,
+                                 double *roots);
+
+// Same as FindRealPolynomialRootsSturm() for a polynomial of degree Degree,
+// which may be lower if the leading coefficients are zero. The degrees one to
+// three are solved in closed form.
+template<int Degree>
+inline int FindRealPolynomialRoots(const double *coeffs, double *roots) {
+  return FindRealPolynomialRootsSturm(coeffs, Degree, roots);
+}
+
+template<>
+inline int FindRealPolynomialRoots<1>(const double *coeffs, double *roots) {
+  if (coeffs[1] == 0) {
+    return 0;
+  }
+  roots[0] = -coeffs[0] / coeffs[1];
+  return 1;
+}
+
+template<>
+inline int FindRealPolynomialRoots<2>(const double *coeffs, double *roots) {
+  int num_roots = SolveQuadraticPolynomial(coeffs[2], coeffs[1], coeffs[0],
+                                           roots + 0, roots + 1);
+  // A double root is returned once, as by the Sturm sequence.
+  return num_roots == 2 && roots[0] == roots[1] ? 1 : num_roots;
+}
+
+template<>
+inline int FindRealPolynomialRoots<3>(const double *coeffs, double *roots) {
+  int num_roots = SolveCubicPolynomial(coeffs, roots);
+  return std::unique(roots, roots + num_roots) - roots;
+}
+
+// Find all the roots, real and complex, of a polynomial of degree Degree as
+// the eigen values of its fixed size companion matrix. The coefficients are
+// in ascending powers and coeffs[Degree] must not be zero. The real and
+// imaginary parts of the Degree roots are stored in real and imaginary, in
+// no particular order.
+template<int Degree>
+void FindPolynomialRootsCompanionMatrix(const double *coeffs,
+                                        double *real,
+                                        double *imaginary) {
+  typedef Eigen::Matrix<double, Degree, Degree> CompanionMatrix;
+  CompanionMatrix companion = CompanionMatrix::Zero();
+  for (int i = 1; i < Degree; ++i) {
+    companion(i, i - 1) = 1;
+  }
+  for (int i = 0; i < Degree; ++i) {
+    companion(i, Degree - 1) = -coeffs[i] / coeffs[Degree];
+  }
+  Eigen::EigenSolver<CompanionMatrix> solver(companion, false);
+  for (int i = 0; i < Degree; ++i) {
+    real[i] = solver.eigenvalues()(i).real();
+    imaginary[i] = solver.eigenvalues()(i).imag();
+  }
+}
+
 }  // namespace libmv
 #endif  // LIBMV_NUMERIC_POLY_H_
@@ -18,6 +18,8 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <algorithm>
+
 #include "libmv/numeric/numeric.h"
 #include "libmv/numeric/poly.h"
 #include "testing/testing.h"
@@ -95,4 +97,132 @@ TEST(Poly, SolveCubicPolynomial) {
   EXPECT_NEAR(b, bb, 1e-10);
   EXPECT_NEAR(c, cc, 1e-10);
 }
+// Coefficients, in ascending powers, of the product of (x - roots[i]).
+void CoeffsForZeros(const double *roots, int num_roots, double *coeffs) {
+  coeffs[0] = 1;
+  for (int i = 0; i < num_roots; ++i) {
+    coeffs[i + 1] = coeffs[i];
+    for (int j = i; j > 0; --j) {
+      coeffs[j] = coeffs[j - 1] - roots[i] * coeffs[j];
+    }
+    coeffs[0] *= -roots[i];
+  }
+}
+
+TEST(Poly, FindRealPolynomialRootsSturmDegreeTen) {
+  double zeros[10] = { 3.5, -2, 0.1, -7.25, 1, 12, -0.5, 4, 0, -30 };
+  double coeffs[11];
+  CoeffsForZeros(zeros, 10, coeffs);
+  double roots[10];
+  ASSERT_EQ(10, FindRealPolynomialRootsSturm(coeffs, 10, roots));
+  std::sort(zeros, zeros + 10);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_NEAR(zeros[i], roots[i], 1e-8);
+  }
+}
+
+TEST(Poly, FindRealPolynomialRootsSturmComplexAndMultipleRoots) {
+  // (x^2 + 1) (x - 2) has a single real root.
+  double cubic[4] = { -2, 1, -2, 1 };
+  double roots[4];
+  ASSERT_EQ(1, FindRealPolynomialRootsSturm(cubic, 3, roots));
+  EXPECT_NEAR(2, roots[0], 1e-10);
+
+  // (x - 1)^2 (x + 3) has two distinct roots.
+  double zeros[3] = { 1, 1, -3 };
+  double coeffs[4];
+  CoeffsForZeros(zeros, 3, coeffs);
+  ASSERT_EQ(2, FindRealPolynomialRootsSturm(coeffs, 3, roots));
+  EXPECT_NEAR(-3, roots[0], 1e-10);
+  EXPECT_NEAR(1, roots[1], 1e-6);
+
+  // Leading zeros lower the degree; x^2 + 1 has no real roots.
+  double quadratic[4] = { 1, 0, 1, 0 };
+  EXPECT_EQ(0, FindRealPolynomialRootsSturm(quadratic, 3, roots));
+  double constant[2] = { 5, 0 };
+  EXPECT_EQ(0, FindRealPolynomialRootsSturm(constant, 1, roots));
+}
+
+TEST(Poly, SolveQuadraticPolynomial) {
+  double x0, x1;
+  // (x - 1e-8) (x - 1e8) loses the small root with the textbook formula.
+  ASSERT_EQ(2, SolveQuadraticPolynomial(1.0, -(1e8 + 1e-8), 1.0, &x0, &x1));
+  EXPECT_NEAR(1e-8, x0, 1e-20);
+  EXPECT_NEAR(1e8, x1, 1e-6);
+
+  ASSERT_EQ(2, SolveQuadraticPolynomial(2.0, 0.0, 0.0, &x0, &x1));
+  EXPECT_EQ(0, x0);
+  EXPECT_EQ(0, x1);
+  EXPECT_EQ(0, SolveQuadraticPolynomial(1.0, 0.0, 1.0, &x0, &x1));
+  ASSERT_EQ(1, SolveQuadraticPolynomial(0.0, 2.0, -3.0, &x0, &x1));
+  EXPECT_NEAR(1.5, x0, 1e-15);
+
+  // The cubic with a zero leading coefficient is a quadratic.
+  double coeffs[4] = { -2, 1, 1, 0 };
+  double roots[3];
+  ASSERT_EQ(2, SolveCubicPolynomial(coeffs, roots));
+  EXPECT_NEAR(-2, roots[0], 1e-15);
+  EXPECT_NEAR(1, roots[1], 1e-15);
+}
+
+TEST(Poly, FindRealPolynomialRootsIsPolished) {
+  double zeros[6] = { 0.3, -1.7, 2.25, 250, -0.01, 6 };
+  double coeffs[7];
+  CoeffsForZeros(zeros, 6, coeffs);
+  double roots[6];
+  ASSERT_EQ(6, FindRealPolynomialRoots<6>(coeffs, roots));
+  std::sort(zeros, zeros + 6);
+  for (int i = 0; i < 6; ++i) {
+    EXPECT_NEAR(zeros[i], roots[i], 1e-12 * std::max(1.0, fabs(zeros[i])));
+  }
+}
+
+TEST(Poly, FindRealPolynomialRootsClosedForms) {
+  double roots[3];
+  double linear[2] = { 3, -2 };
+  ASSERT_EQ(1, FindRealPolynomialRoots<1>(linear, roots));
+  EXPECT_NEAR(1.5, roots[0], 1e-15);
+
+  // (x - 3)^2 has a single distinct root, as with the Sturm sequence.
+  double square[3] = { 9, -6, 1 };
+  ASSERT_EQ(1, FindRealPolynomialRoots<2>(square, roots));
+  EXPECT_NEAR(3, roots[0], 1e-15);
+
+  double zeros[3] = { -4, 0.5, 7 };
+  double cubic[4];
+  CoeffsForZeros(zeros, 3, cubic);
+  ASSERT_EQ(3, FindRealPolynomialRoots<3>(cubic, roots));
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_NEAR(zeros[i], roots[i], 1e-12);
+  }
+}
+
+TEST(Poly, FindPolynomialRootsCompanionMatrix) {
+  // (x^2 + 4) (x - 1) (x + 2) (x - 5).
+  double zeros[3] = { 1, -2, 5 };
+  double real_factor[4];
+  CoeffsForZeros(zeros, 3, real_factor);
+  double coeffs[6] = { 0, 0, 0, 0, 0, 0 };
+  for (int i = 0; i < 4; ++i) {
+    coeffs[i] += 4 * real_factor[i];
+    coeffs[i + 2] += real_factor[i];
+  }
+  double real[5], imaginary[5];
+  FindPolynomialRootsCompanionMatrix<5>(coeffs, real, imaginary);
+  int num_real = 0, num_complex = 0;
+  for (int i = 0; i < 5; ++i) {
+    if (fabs(imaginary[i]) < 1e-10) {
+      EXPECT_NEAR(0, std::min(fabs(real[i] - 1),
+                     std::min(fabs(real[i] + 2), fabs(real[i] - 5))), 1e-10);
+      ++num_real;
+    } else {
+      EXPECT_NEAR(0, real[i], 1e-10);
+      EXPECT_NEAR(2, fabs(imaginary[i]), 1e-10);
+      ++num_complex;
+    }
+  }
+  EXPECT_EQ(3, num_real);
+  EXPECT_EQ(2, num_complex);
+}
+
 }  // namespace
@@ -0,0 +1,175 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+
+#include "libmv/numeric/sparse_matrix.h"
+
+namespace libmv {
+
+CompressedColumnMatrix::CompressedColumnMatrix()
+    : rows_(0), cols_(0), column_begin_(1, 0) {}
+
+CompressedColumnMatrix::CompressedColumnMatrix(int rows, int cols)
+    : rows_(rows), cols_(cols), column_begin_(cols + 1, 0) {}
+
+void CompressedColumnMatrix::SetFromTriplets(
+    int rows, int cols,
+    const std::vector<int> &row_indices,
+    const std::vector<int> &col_indices,
+    const std::vector<double> &values) {
+  assert(row_indices.size() == col_indices.size());
+  assert(row_indices.size() == values.size());
+  rows_ = rows;
+  cols_ = cols;
+
+  // Bucket the entries by column.
+  std::vector<int> begin(cols + 1, 0);
+  for (size_t k = 0; k < col_indices.size(); ++k) {
+    assert(0 <= col_indices[k] && col_indices[k] < cols);
+    assert(0 <= row_indices[k] && row_indices[k] < rows);
+    ++begin[col_indices[k] + 1];
+  }
+  for (int c = 0; c < cols; ++c) {
+    begin[c + 1] += begin[c];
+  }
+  std::vector<std::pair<int, double> > entries(values.size());
+  std::vector<int> next(begin.begin(), begin.end() - 1);
+  for (size_t k = 0; k < col_indices.size(); ++k) {
+    entries[next[col_indices[k]]++] =
+        std::make_pair(row_indices[k], values[k]);
+  }
+
+  // Sort each column by row and merge the duplicates.
+  column_begin_.assign(cols + 1, 0);
+  row_indices_.clear();
+  values_.clear();
+  row_indices_.reserve(entries.size());
+  values_.reserve(entries.size());
+  for (int c = 0; c < cols; ++c) {
+    std::sort(entries.begin() + begin[c], entries.begin() + begin[c + 1]);
+    for (int k = begin[c]; k < begin[c + 1]; ++k) {
+      if (k > begin[c] && entries[k].first == row_indices_.back()) {
+        values_.back() += entries[k].second;
+      } else {
+        row_indices_.push_back(entries[k].first);
+        values_.push_back(entries[k].second);
+      }
+    }
+    column_begin_[c + 1] = values_.size();
+  }
+}
+
+void CompressedColumnMatrix::Multiply(const double *x, double *y) const {
+  std::fill(y, y + rows_, 0.0);
+  for (int c = 0; c < cols_; ++c) {
+    for (int k = column_begin_[c]; k < column_begin_[c + 1]; ++k) {
+      y[row_indices_[k]] += values_[k] * x[c];
+    }
+  }
+}
+
+void CompressedColumnMatrix::TransposeMultiply(const double *x,
+                                               double *y) const {
+  for (int c = 0; c < cols_; ++c) {
+    double sum = 0;
+    for (int k = column_begin_[c]; k < column_begin_[c + 1]; ++k) {
+      sum += values_[k] * x[row_indices_[k]];
+    }
+    y[c] = sum;
+  }
+}
+
+void CompressedColumnMatrix::ColumnSquaredNorms(double *norms) const {
+  for (int c = 0; c < cols_; ++c) {
+    double sum = 0;
+    for (int k = column_begin_[c]; k < column_begin_[c + 1]; ++k) {
+      sum += values_[k] * values_[k];
+    }
+    norms[c] = sum;
+  }
+}
+
+void CompressedColumnMatrix::TransposeTimesSelf(
+    CompressedColumnMatrix *AtA) const {
+  // The rows of A, i.e. A' in compressed column storage.
+  std::vector<int> row_begin(rows_ + 1, 0);
+  for (size_t k = 0; k < row_indices_.size(); ++k) {
+    ++row_begin[row_indices_[k] + 1];
+  }
+  for (int r = 0; r < rows_; ++r) {
+    row_begin[r + 1] += row_begin[r];
+  }
+  std::vector<int> row_columns(values_.size());
+  std::vector<double> row_values(values_.size());
+  std::vector<int> next(row_begin.begin(), row_begin.end() - 1);
+  for (int c = 0; c < cols_; ++c) {
+    for (int k = column_begin_[c]; k < column_begin_[c + 1]; ++k) {
+      int r = row_indices_[k];
+      row_columns[next[r]] = c;
+      row_values[next[r]++] = values_[k];
+    }
+  }
+
+  // Column j of A' A is sum over the entries (r, j) of A of A(r, j) times
+  // row r of A; accumulated in a dense column with a list of its nonzeros.
+  AtA->rows_ = cols_;
+  AtA->cols_ = cols_;
+  AtA->column_begin_.assign(cols_ + 1, 0);
+  AtA->row_indices_.clear();
+  AtA->values_.clear();
+  std::vector<double> accumulator(cols_, 0.0);
+  std::vector<int> marker(cols_, -1);
+  std::vector<int> pattern;
+  for (int j = 0; j < cols_; ++j) {
+    pattern.clear();
+    for (int k = column_begin_[j]; k < column_begin_[j + 1]; ++k) {
+      int r = row_indices_[k];
+      double v = values_[k];
+      for (int q = row_begin[r]; q < row_begin[r + 1]; ++q) {
+        int i = row_columns[q];
+        if (marker[i] != j) {
+          marker[i] = j;
+          accumulator[i] = 0;
+          pattern.push_back(i);
+        }
+        accumulator[i] += v * row_values[q];
+      }
+    }
+    std::sort(pattern.begin(), pattern.end());
+    for (size_t p = 0; p < pattern.size(); ++p) {
+      AtA->row_indices_.push_back(pattern[p]);
+      AtA->values_.push_back(accumulator[pattern[p]]);
+    }
+    AtA->column_begin_[j + 1] = AtA->values_.size();
+  }
+}
+
+Mat CompressedColumnMatrix::ToDense() const {
+  Mat dense = Mat::Zero(rows_, cols_);
+  for (int c = 0; c < cols_; ++c) {
+    for (int k = column_begin_[c]; k < column_begin_[c + 1]; ++k) {
+      dense(row_indices_[k], c) = values_[k];
+    }
+  }
+  return dense;
+}
+
+}  // namespace libmv
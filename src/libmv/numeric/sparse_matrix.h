@@ -0,0 +1,78 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_NUMERIC_SPARSE_MATRIX_H
+#define LIBMV_NUMERIC_SPARSE_MATRIX_H
+
+#include <vector>
+
+#include "libmv/numeric/numeric.h"
+
+namespace libmv {
+
+// A sparse matrix in compressed column storage: the entries of column c are
+// values()[column_begin()[c] ... column_begin()[c + 1] - 1], in rows
+// row_indices()[...], sorted in increasing order. Used as the Jacobian of
+// large nonlinear least squares problems, see normal_equations.h.
+class CompressedColumnMatrix {
+ public:
+  CompressedColumnMatrix();
+  CompressedColumnMatrix(int rows, int cols);
+
+  // Builds the matrix from a list of entries (rows[k], cols[k], values[k]);
+  // the values of duplicated entries are summed.
+  void SetFromTriplets(int rows, int cols,
+                       const std::vector<int> &row_indices,
+                       const std::vector<int> &col_indices,
+                       const std::vector<double> &values);
+
+  int rows() const { return rows_; }
+  int cols() const { return cols_; }
+  int NumNonZeros() const { return values_.size(); }
+
+  const std::vector<int> &column_begin() const { return column_begin_; }
+  const std::vector<int> &row_indices() const { return row_indices_; }
+  const std::vector<double> &values() const { return values_; }
+  std::vector<double> &values() { return values_; }
+
+  // y = A x.
+  void Multiply(const double *x, double *y) const;
+
+  // y = A' x.
+  void TransposeMultiply(const double *x, double *y) const;
+
+  // Squared norms of the columns, which is the diagonal of A' A.
+  void ColumnSquaredNorms(double *norms) const;
+
+  // Computes A' A, with both triangles stored.
+  void TransposeTimesSelf(CompressedColumnMatrix *AtA) const;
+
+  Mat ToDense() const;
+
+ private:
+  int rows_, cols_;
+  std::vector<int> column_begin_;
+  std::vector<int> row_indices_;
+  std::vector<double> values_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_NUMERIC_SPARSE_MATRIX_H
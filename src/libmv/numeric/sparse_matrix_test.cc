@@ -0,0 +1,90 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <vector>
+
+#include "libmv/numeric/sparse_matrix.h"
+#include "testing/testing.h"
+
+using namespace libmv;
+
+namespace {
+
+CompressedColumnMatrix MakeMatrix() {
+  std::vector<int> rows, cols;
+  std::vector<double> values;
+  // Unordered, with a duplicate (1, 0) and an empty column 2.
+  rows.push_back(3); cols.push_back(1); values.push_back(4);
+  rows.push_back(1); cols.push_back(0); values.push_back(2);
+  rows.push_back(0); cols.push_back(0); values.push_back(1);
+  rows.push_back(1); cols.push_back(0); values.push_back(0.5);
+  rows.push_back(2); cols.push_back(3); values.push_back(-3);
+  rows.push_back(0); cols.push_back(3); values.push_back(5);
+  CompressedColumnMatrix A;
+  A.SetFromTriplets(4, 4, rows, cols, values);
+  return A;
+}
+
+TEST(CompressedColumnMatrix, SetFromTriplets) {
+  CompressedColumnMatrix A = MakeMatrix();
+  EXPECT_EQ(4, A.rows());
+  EXPECT_EQ(4, A.cols());
+  EXPECT_EQ(5, A.NumNonZeros());
+
+  Mat expected(4, 4);
+  expected << 1,   0, 0,  5,
+              2.5, 0, 0,  0,
+              0,   0, 0, -3,
+              0,   4, 0,  0;
+  Mat dense = A.ToDense();
+  EXPECT_MATRIX_EQ(expected, dense);
+  EXPECT_EQ(0, A.row_indices()[0]);
+  EXPECT_EQ(1, A.row_indices()[1]);
+}
+
+TEST(CompressedColumnMatrix, Products) {
+  CompressedColumnMatrix A = MakeMatrix();
+  Mat dense = A.ToDense();
+  Vec x(4);
+  x << 1, -2, 3, 0.5;
+
+  Vec y(4);
+  A.Multiply(x.data(), y.data());
+  Vec expected_y = dense * x;
+  EXPECT_MATRIX_NEAR(expected_y, y, 1e-15);
+  A.TransposeMultiply(x.data(), y.data());
+  expected_y = dense.transpose() * x;
+  EXPECT_MATRIX_NEAR(expected_y, y, 1e-15);
+
+  Mat expected_AtA = dense.transpose() * dense;
+  Vec expected_norms = expected_AtA.diagonal();
+  Vec norms(4);
+  A.ColumnSquaredNorms(norms.data());
+  EXPECT_MATRIX_NEAR(expected_norms, norms, 1e-15);
+
+  CompressedColumnMatrix AtA;
+  A.TransposeTimesSelf(&AtA);
+  Mat dense_AtA = AtA.ToDense();
+  EXPECT_MATRIX_NEAR(expected_AtA, dense_AtA, 1e-15);
+  // Only the structural nonzeros are stored.
+  EXPECT_EQ(5, AtA.NumNonZeros());
+}
+
+}  // namespace
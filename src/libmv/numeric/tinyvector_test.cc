@@ -238,4 +238,27 @@ TEST(TinyMatrix, TinyMatrixScalarProduct) {
   EXPECT_EQ(B, A);
 }
 
+TEST(TinyVector, FixedSizeFloatDistances) {
+  Vec16f x, y;
+  for (int i = 0; i < 16; ++i) {
+    x(i) = i;
+    y(i) = i + (i % 2 ? 1 : -1);
+  }
+  EXPECT_FLOAT_EQ(16, SquaredDistanceL2(x, y));
+  EXPECT_FLOAT_EQ(4, DistanceL2(x, y));
+  EXPECT_FLOAT_EQ(16, DistanceL1(x, y));
+  EXPECT_FLOAT_EQ(1, DistanceLInfinity(x, y));
+  EXPECT_FLOAT_EQ(1240, SquaredNormL2(x));
+}
+
+TEST(TinyVector, DistanceBetweenFixedAndDynamicVectors) {
+  Matf points(2, 2);
+  points << 1, 4,
+            2, 6;
+  Vec2f x(1, 2);
+  EXPECT_FLOAT_EQ(0, SquaredDistanceL2(x, points.col(0)));
+  EXPECT_FLOAT_EQ(25, SquaredDistanceL2(x, points.col(1)));
+  EXPECT_FLOAT_EQ(5, DistanceL2(points.col(1), x));
+}
+
 }  // namespace
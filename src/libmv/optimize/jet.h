@@ -24,14 +24,124 @@
 #include "libmv/logging/logging.h"
 #include "libmv/numeric/numeric.h"
 
-// TODO(keir): Consider wrapping some of these operations with eigen arrays to
-// exploit eigen's vectorization.
+#include <cmath>
+#include <cstdlib>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace libmv {
 
+// The jet overloads below would otherwise hide the ones for double in code
+// (in libmv) that calls sqrt(), cos(), ... unqualified.
+using std::abs;
+using std::cos;
+using std::exp;
+using std::log;
+using std::sin;
+using std::sqrt;
+
+namespace jet_internal {
+
+// The derivative parts of the jet operations all have the form
+// out = a * x + b * y, out = x + y or out = x - y, over N entries. The
+// generic versions work for any T, including nested jets; the double ones
+// process two entries per instruction.
+template<int N, typename T>
+inline void Add(const T *x, const T *y, T *out) {
+  for (int i = 0; i < N; ++i) {
+    out[i] = x[i] + y[i];
+  }
+}
+
+template<int N, typename T>
+inline void Subtract(const T *x, const T *y, T *out) {
+  for (int i = 0; i < N; ++i) {
+    out[i] = x[i] - y[i];
+  }
+}
+
+template<int N, typename T>
+inline void Scale(const T &a, const T *x, T *out) {
+  for (int i = 0; i < N; ++i) {
+    out[i] = a * x[i];
+  }
+}
+
+template<int N, typename T>
+inline void ScaleAdd(const T &a, const T *x, const T &b, const T *y, T *out) {
+  for (int i = 0; i < N; ++i) {
+    out[i] = a * x[i] + b * y[i];
+  }
+}
+
+#ifdef __SSE2__
+template<int N>
+inline void Add(const double *x, const double *y, double *out) {
+  int i = 0;
+  for (; i + 2 <= N; i += 2) {
+    _mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(x + i),
+                                      _mm_loadu_pd(y + i)));
+  }
+  for (; i < N; ++i) {
+    out[i] = x[i] + y[i];
+  }
+}
+
+template<int N>
+inline void Subtract(const double *x, const double *y, double *out) {
+  int i = 0;
+  for (; i + 2 <= N; i += 2) {
+    _mm_storeu_pd(out + i, _mm_sub_pd(_mm_loadu_pd(x + i),
+                                      _mm_loadu_pd(y + i)));
+  }
+  for (; i < N; ++i) {
+    out[i] = x[i] - y[i];
+  }
+}
+
+template<int N>
+inline void Scale(const double &a, const double *x, double *out) {
+  __m128d a2 = _mm_set1_pd(a);
+  int i = 0;
+  for (; i + 2 <= N; i += 2) {
+    _mm_storeu_pd(out + i, _mm_mul_pd(a2, _mm_loadu_pd(x + i)));
+  }
+  for (; i < N; ++i) {
+    out[i] = a * x[i];
+  }
+}
+
+template<int N>
+inline void ScaleAdd(const double &a, const double *x,
+                     const double &b, const double *y, double *out) {
+  __m128d a2 = _mm_set1_pd(a);
+  __m128d b2 = _mm_set1_pd(b);
+  int i = 0;
+  for (; i + 2 <= N; i += 2) {
+    _mm_storeu_pd(out + i,
+                  _mm_add_pd(_mm_mul_pd(a2, _mm_loadu_pd(x + i)),
+                             _mm_mul_pd(b2, _mm_loadu_pd(y + i))));
+  }
+  for (; i < N; ++i) {
+    out[i] = a * x[i] + b * y[i];
+  }
+}
+#endif  // __SSE2__
+
+}  // namespace jet_internal
+
 // Poor man's forward mode automatic differentaition.
+//
+// The value is x and the partial derivatives with respect to the N
+// independent variables are d. Besides the arithmetic operators, the usual
+// elementary functions are defined below so that templated code written for
+// double can be evaluated on jets as well (see JetJacobian).
 template<int N, typename T = double>
 struct Jet {
+  enum { kNumDerivatives = N };
+
   Jet() {}
 
   // Constant constructor; for things like 1.0.
@@ -53,41 +163,168 @@ struct Jet {
     d[independent] = T(1.0);
   }
 
-  // Operators: + * /
+  // Operators: + - * /
 
-  template<typename OtherJet>
-  Jet<N, T> operator*(const OtherJet &other) const {
+  Jet<N, T> operator*(const Jet<N, T> &other) const {
     Jet<N, T> res;
-    res.x = x * T(other.x);
-    for (int i = 0; i < N; ++i) {
-      res.d[i] = other.d[i] * x + d[i] * other.x;
-    }
+    res.x = x * other.x;
+    jet_internal::ScaleAdd<N>(other.x, d, x, other.d, res.d);
     return res;
   }
 
-  template<typename OtherJet>
-  Jet<N, T> operator+(const OtherJet &other) const {
+  Jet<N, T> operator+(const Jet<N, T> &other) const {
     Jet<N, T> res;
     res.x = x + other.x;
-    for (int i = 0; i < N; ++i) {
-      res.d[i] = d[i] + other.d[i];
-    }
+    jet_internal::Add<N>(d, other.d, res.d);
     return res;
   }
 
-  template<typename OtherJet>
-  Jet<N, T> operator/(const OtherJet &other) const {
+  Jet<N, T> operator-(const Jet<N, T> &other) const {
     Jet<N, T> res;
+    res.x = x - other.x;
+    jet_internal::Subtract<N>(d, other.d, res.d);
+    return res;
+  }
+
+  Jet<N, T> operator/(const Jet<N, T> &other) const {
+    Jet<N, T> res;
+    T inverse = T(1.0) / other.x;
     res.x = x / other.x;
-    for (int i = 0; i < N; ++i) {
-      res.d[i] = (other.x * d[i] - x * other.d[i]) / (other.x * other.x);
-    }
+    // (d - x/y * dy) / y.
+    jet_internal::ScaleAdd<N>(inverse, d, T(-res.x * inverse), other.d, res.d);
     return res;
   }
 
+  Jet<N, T> operator-() const {
+    Jet<N, T> res;
+    res.x = -x;
+    jet_internal::Scale<N>(T(-1.0), d, res.d);
+    return res;
+  }
+
+  // Operators with constants.
+
+  Jet<N, T> operator*(const T &s) const {
+    Jet<N, T> res;
+    res.x = x * s;
+    jet_internal::Scale<N>(s, d, res.d);
+    return res;
+  }
+
+  Jet<N, T> operator/(const T &s) const {
+    return *this * T(T(1.0) / s);
+  }
+
+  Jet<N, T> operator+(const T &s) const {
+    Jet<N, T> res = *this;
+    res.x = x + s;
+    return res;
+  }
+
+  Jet<N, T> operator-(const T &s) const {
+    Jet<N, T> res = *this;
+    res.x = x - s;
+    return res;
+  }
+
+  Jet<N, T> &operator+=(const Jet<N, T> &other) {
+    return *this = *this + other;
+  }
+
+  Jet<N, T> &operator-=(const Jet<N, T> &other) {
+    return *this = *this - other;
+  }
+
+  Jet<N, T> &operator*=(const Jet<N, T> &other) {
+    return *this = *this * other;
+  }
+
+  Jet<N, T> &operator/=(const Jet<N, T> &other) {
+    return *this = *this / other;
+  }
+
+  // Comparisons are on the value only, for branches in templated code.
+  bool operator<(const Jet<N, T> &other) const { return x < other.x; }
+  bool operator>(const Jet<N, T> &other) const { return x > other.x; }
+
   T x;
   T d[N];
 };
 
+template<int N, typename T>
+inline Jet<N, T> operator*(const T &s, const Jet<N, T> &f) {
+  return f * s;
+}
+
+template<int N, typename T>
+inline Jet<N, T> operator+(const T &s, const Jet<N, T> &f) {
+  return f + s;
+}
+
+template<int N, typename T>
+inline Jet<N, T> operator-(const T &s, const Jet<N, T> &f) {
+  Jet<N, T> res = -f;
+  res.x = s - f.x;
+  return res;
+}
+
+template<int N, typename T>
+inline Jet<N, T> operator/(const T &s, const Jet<N, T> &f) {
+  Jet<N, T> res;
+  T inverse = T(1.0) / f.x;
+  res.x = s / f.x;
+  jet_internal::Scale<N>(T(-res.x * inverse), f.d, res.d);
+  return res;
+}
+
+// Applies the chain rule for a function with value fx and derivative dfx at
+// f.x.
+template<int N, typename T>
+inline Jet<N, T> Chain(const T &fx, const T &dfx, const Jet<N, T> &f) {
+  Jet<N, T> res;
+  res.x = fx;
+  jet_internal::Scale<N>(dfx, f.d, res.d);
+  return res;
+}
+
+template<int N, typename T>
+inline Jet<N, T> sqrt(const Jet<N, T> &f) {
+  using std::sqrt;
+  T s = sqrt(f.x);
+  return Chain(s, T(T(0.5) / s), f);
+}
+
+template<int N, typename T>
+inline Jet<N, T> exp(const Jet<N, T> &f) {
+  using std::exp;
+  T e = exp(f.x);
+  return Chain(e, e, f);
+}
+
+template<int N, typename T>
+inline Jet<N, T> log(const Jet<N, T> &f) {
+  using std::log;
+  return Chain(T(log(f.x)), T(T(1.0) / f.x), f);
+}
+
+template<int N, typename T>
+inline Jet<N, T> sin(const Jet<N, T> &f) {
+  using std::sin;
+  using std::cos;
+  return Chain(T(sin(f.x)), T(cos(f.x)), f);
+}
+
+template<int N, typename T>
+inline Jet<N, T> cos(const Jet<N, T> &f) {
+  using std::sin;
+  using std::cos;
+  return Chain(T(cos(f.x)), T(-sin(f.x)), f);
+}
+
+template<int N, typename T>
+inline Jet<N, T> abs(const Jet<N, T> &f) {
+  return f.x < T(0.0) ? -f : f;
+}
+
 }  // namespace libmv
-#endif  // LIBMV_OPTIMIZE_RESIDUAL_H_
+#endif  // LIBMV_OPTIMIZE_JET_H_
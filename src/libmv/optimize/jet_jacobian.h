@@ -0,0 +1,105 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_OPTIMIZE_JET_JACOBIAN_H_
+#define LIBMV_OPTIMIZE_JET_JACOBIAN_H_
+
+#include <vector>
+
+#include "libmv/numeric/numeric.h"
+#include "libmv/optimize/jet.h"
+
+namespace libmv {
+namespace jet_jacobian {
+
+// Number of residuals of the function: fixed by FMatrixType if it has a
+// compile time size, otherwise given by f.NumResiduals().
+template<bool dynamic>
+struct NumResiduals {
+  template<typename Function>
+  static int Of(const Function &f) {
+    return Function::FMatrixType::RowsAtCompileTime;
+  }
+};
+
+template<>
+struct NumResiduals<true> {
+  template<typename Function>
+  static int Of(const Function &f) {
+    return f.NumResiduals();
+  }
+};
+
+}  // namespace jet_jacobian
+
+// Jacobian of a function by forward mode automatic differentiation, for use
+// as the Jacobian policy of LevenbergMarquardt and Dogleg in place of
+// NumericJacobian. The derivatives are exact, and one evaluation of the
+// function on jets replaces the 2N evaluations of the central differences.
+//
+// Besides the usual XMatrixType, FMatrixType and operator(), the function
+// must provide
+//
+//   template<typename T> void Evaluate(const T *x, T *fx) const;
+//
+// written for a generic scalar type T, and NumResiduals() if FMatrixType has
+// a dynamic size. XMatrixType must have a fixed size.
+template<typename Function>
+class JetJacobian {
+ public:
+  typedef typename Function::XMatrixType Parameters;
+  typedef typename Function::XMatrixType::RealScalar XScalar;
+  typedef typename Function::FMatrixType FMatrixType;
+  typedef Matrix<typename Function::FMatrixType::RealScalar,
+                 Function::FMatrixType::RowsAtCompileTime,
+                 Function::XMatrixType::RowsAtCompileTime>
+          JMatrixType;
+  enum { kNumParameters = Function::XMatrixType::RowsAtCompileTime };
+  typedef Jet<kNumParameters, XScalar> JetType;
+
+  JetJacobian(const Function &f) : f_(f) {}
+
+  JMatrixType operator()(const Parameters &x) {
+    JetType x_jets[kNumParameters];
+    for (int c = 0; c < kNumParameters; ++c) {
+      x_jets[c] = JetType(x(c), c);
+    }
+    const int rows = jet_jacobian::NumResiduals<
+        FMatrixType::RowsAtCompileTime == Eigen::Dynamic>::Of(f_);
+    f_jets_.resize(rows);
+    f_.Evaluate(x_jets, &f_jets_[0]);
+
+    JMatrixType jacobian(rows, int(kNumParameters));
+    for (int r = 0; r < rows; ++r) {
+      for (int c = 0; c < kNumParameters; ++c) {
+        jacobian(r, c) = f_jets_[r].d[c];
+      }
+    }
+    return jacobian;
+  }
+
+ private:
+  const Function &f_;
+  std::vector<JetType> f_jets_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_OPTIMIZE_JET_JACOBIAN_H_
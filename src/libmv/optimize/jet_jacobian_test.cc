@@ -0,0 +1,135 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/numeric/dogleg.h"
+#include "libmv/numeric/function_derivative.h"
+#include "libmv/numeric/levenberg_marquardt.h"
+#include "libmv/optimize/jet_jacobian.h"
+#include "testing/testing.h"
+
+using namespace libmv;
+
+namespace {
+
+// Same as in levenberg_marquardt_test.cc, with a templated evaluation.
+class F {
+ public:
+  typedef Vec4 FMatrixType;
+  typedef Vec3 XMatrixType;
+
+  template<typename T>
+  void Evaluate(const T *x, T *fx) const {
+    T x1 = x[0] - 2.0;
+    T y1 = x[1] - 5.0;
+    T z1 = x[2];
+    fx[0] = x1*x1 + z1*z1;
+    fx[1] = y1*y1 + z1*z1;
+    fx[2] = z1*z1;
+    fx[3] = x1*x1;
+  }
+
+  Vec4 operator()(const Vec3 &x) const {
+    Vec4 fx;
+    Evaluate(x.data(), fx.data());
+    return fx;
+  }
+};
+
+// A function with a dynamic number of residuals: fits a * exp(b * t).
+class ExponentialFit {
+ public:
+  typedef Vec FMatrixType;
+  typedef Vec2 XMatrixType;
+
+  ExponentialFit(const Vec &t, const Vec &y) : t_(t), y_(y) {}
+
+  int NumResiduals() const { return t_.rows(); }
+
+  template<typename T>
+  void Evaluate(const T *x, T *fx) const {
+    for (int i = 0; i < t_.rows(); ++i) {
+      fx[i] = x[0] * exp(x[1] * t_(i)) - y_(i);
+    }
+  }
+
+  Vec operator()(const Vec2 &x) const {
+    Vec fx(NumResiduals());
+    Evaluate(x.data(), fx.data());
+    return fx;
+  }
+
+ private:
+  Vec t_, y_;
+};
+
+TEST(JetJacobian, MatchesNumericJacobian) {
+  F f;
+  Vec3 x(0.76026643, -30.01799744, 0.55192142);
+  JetJacobian<F> jet_jacobian(f);
+  NumericJacobian<F> numeric_jacobian(f);
+  EXPECT_MATRIX_NEAR(numeric_jacobian(x), jet_jacobian(x), 1e-6);
+
+  // The analytic derivatives of the first residual.
+  Mat J = jet_jacobian(x);
+  EXPECT_NEAR(2 * (x(0) - 2), J(0, 0), 1e-15);
+  EXPECT_EQ(0, J(0, 1));
+  EXPECT_NEAR(2 * x(2), J(0, 2), 1e-15);
+}
+
+TEST(JetJacobian, DynamicResiduals) {
+  Vec t(5), y(5);
+  for (int i = 0; i < 5; ++i) {
+    t(i) = 0.25 * i;
+    y(i) = 2.0 * std::exp(-1.5 * t(i));
+  }
+  ExponentialFit f(t, y);
+  Vec2 x(1, 0);
+  Mat J = JetJacobian<ExponentialFit>(f)(x);
+  ASSERT_EQ(5, J.rows());
+  ASSERT_EQ(2, J.cols());
+  EXPECT_MATRIX_NEAR(NumericJacobian<ExponentialFit>(f)(x), J, 1e-6);
+}
+
+TEST(JetJacobian, LevenbergMarquardt) {
+  Vec3 x(0.76026643, -30.01799744, 0.55192142);
+  F f;
+  typedef LevenbergMarquardt<F, JetJacobian<F> > Solver;
+  Solver::SolverParameters params;
+  Solver lm(f);
+  lm.minimize(params, &x);
+  EXPECT_MATRIX_NEAR(Vec3(2, 5, 0), x, 1e-5);
+}
+
+TEST(JetJacobian, Dogleg) {
+  Vec t(8), y(8);
+  for (int i = 0; i < 8; ++i) {
+    t(i) = 0.25 * i;
+    y(i) = 2.0 * std::exp(-1.5 * t(i));
+  }
+  ExponentialFit f(t, y);
+  Vec2 x(1, 0);
+  typedef Dogleg<ExponentialFit, JetJacobian<ExponentialFit> > Solver;
+  Solver::SolverParameters params;
+  Solver dogleg(f);
+  dogleg.minimize(params, &x);
+  EXPECT_MATRIX_NEAR(Vec2(2, -1.5), x, 1e-6);
+}
+
+}  // namespace
@@ -114,3 +114,38 @@ TEST(JetTest, QuotentRulePartials) {
   EXPECT_EQ(-3./32./32.,      f.d[1]);
   EXPECT_EQ(-3./32./32.*2*5,  f.d[2]);
 }
+
+TEST(JetTest, ElementaryFunctions) {
+  Jet<2> x(0.5, 0);
+  Jet<2> y(2.0, 1);
+
+  Jet<2> f = sin(x) * sqrt(y);
+  EXPECT_NEAR(std::sin(0.5) * std::sqrt(2.0), f.x, 1e-15);
+  EXPECT_NEAR(std::cos(0.5) * std::sqrt(2.0), f.d[0], 1e-15);
+  EXPECT_NEAR(std::sin(0.5) * 0.5 / std::sqrt(2.0), f.d[1], 1e-15);
+
+  Jet<2> g = exp(x * 3.0) - log(y) / 2.0;
+  EXPECT_NEAR(std::exp(1.5) - std::log(2.0) / 2, g.x, 1e-14);
+  EXPECT_NEAR(3 * std::exp(1.5), g.d[0], 1e-14);
+  EXPECT_NEAR(-0.25, g.d[1], 1e-15);
+
+  Jet<2> h = 1.0 / (-y) + cos(x);
+  EXPECT_NEAR(-0.5 + std::cos(0.5), h.x, 1e-15);
+  EXPECT_NEAR(-std::sin(0.5), h.d[0], 1e-15);
+  EXPECT_NEAR(0.25, h.d[1], 1e-15);
+}
+
+// Odd sizes exercise the scalar tail of the vectorized derivatives.
+TEST(JetTest, OddNumberOfDerivatives) {
+  Jet<5> x[5];
+  for (int i = 0; i < 5; ++i) {
+    x[i] = Jet<5>(i + 1.0, i);
+  }
+  Jet<5> f = x[0] * x[1] - x[2] / x[3] + x[4] * x[4];
+  EXPECT_NEAR(2 - 0.75 + 25, f.x, 1e-15);
+  EXPECT_NEAR(2, f.d[0], 1e-15);
+  EXPECT_NEAR(1, f.d[1], 1e-15);
+  EXPECT_NEAR(-0.25, f.d[2], 1e-15);
+  EXPECT_NEAR(3.0 / 16, f.d[3], 1e-15);
+  EXPECT_NEAR(10, f.d[4], 1e-15);
+}
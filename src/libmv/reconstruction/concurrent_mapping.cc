@@ -0,0 +1,245 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+
+#include "libmv/camera/pinhole_camera.h"
+#include "libmv/logging/logging.h"
+#include "libmv/reconstruction/concurrent_mapping.h"
+#include "libmv/reconstruction/euclidean_reconstruction.h"
+#include "libmv/reconstruction/mapping.h"
+#include "libmv/reconstruction/optimization.h"
+#include "libmv/reconstruction/reconstruction_observer.h"
+
+namespace libmv {
+namespace {
+
+// The reconstruction does not delete its cameras and structures.
+void DeleteMap(Reconstruction *map) {
+  if (map) {
+    map->ClearCamerasMap();
+    map->ClearStructuresMap();
+    delete map;
+  }
+}
+
+// Copies the poses of the pinhole cameras and the coordinates of the point
+// structures of map that reconstruction has.
+void CopyMapInto(const Reconstruction &map, Reconstruction *reconstruction) {
+  std::map<CameraID, Camera *>::const_iterator camera_iter =
+    map.cameras().begin();
+  for (; camera_iter != map.cameras().end(); ++camera_iter) {
+    PinholeCamera *source =
+      dynamic_cast<PinholeCamera *>(camera_iter->second);
+    PinholeCamera *target = dynamic_cast<PinholeCamera *>(
+      reconstruction->GetCamera(camera_iter->first));
+    if (source && target) {
+      target->SetExtrinsicParameters(source->orientation_matrix(),
+                                     source->position());
+    }
+  }
+  std::map<StructureID, Structure *>::const_iterator track_iter =
+    map.structures().begin();
+  for (; track_iter != map.structures().end(); ++track_iter) {
+    PointStructure *source =
+      dynamic_cast<PointStructure *>(track_iter->second);
+    PointStructure *target = dynamic_cast<PointStructure *>(
+      reconstruction->GetStructure(track_iter->first));
+    if (source && target) {
+      target->set_coords(source->coords());
+    }
+  }
+}
+
+}  // namespace
+
+ConcurrentMapper::ConcurrentMapper(const Matches &matches)
+  : matches_(matches), pending_(NULL), published_(NULL), num_adjusted_(0),
+    num_dropped_(0), busy_(false), stop_(false) {
+  thread_started_ = pthread_create(&thread_, NULL,
+                                   &ConcurrentMapper::ThreadEntry,
+                                   this) == 0;
+}
+
+ConcurrentMapper::~ConcurrentMapper() {
+  if (thread_started_) {
+    {
+      MutexLock lock(&mutex_);
+      stop_ = true;
+      wake_up_.Signal();
+    }
+    pthread_join(thread_, NULL);
+  }
+  DeleteMap(pending_);
+  DeleteMap(published_);
+}
+
+void ConcurrentMapper::Submit(const Reconstruction &reconstruction,
+                              const vector<CameraID> &window) {
+  Reconstruction *map = new Reconstruction();
+  CopyReconstructionForExport(reconstruction, map);
+  if (!thread_started_) {
+    // Could not spawn the thread; adjust here instead.
+    Adjust(map, window);
+    return;
+  }
+  Reconstruction *replaced = NULL;
+  {
+    MutexLock lock(&mutex_);
+    if (pending_) {
+      replaced = pending_;
+      ++num_dropped_;
+    }
+    pending_ = map;
+    pending_window_ = window;
+    wake_up_.Signal();
+  }
+  DeleteMap(replaced);
+}
+
+bool ConcurrentMapper::ApplyLatest(Reconstruction *reconstruction) {
+  Reconstruction *map = NULL;
+  {
+    MutexLock lock(&mutex_);
+    std::swap(map, published_);
+  }
+  if (!map) {
+    return false;
+  }
+  CopyMapInto(*map, reconstruction);
+  DeleteMap(map);
+  return true;
+}
+
+void ConcurrentMapper::Flush() {
+  MutexLock lock(&mutex_);
+  while (pending_ || busy_) {
+    idle_.Wait(&mutex_);
+  }
+}
+
+int ConcurrentMapper::num_adjusted() const {
+  MutexLock lock(&mutex_);
+  return num_adjusted_;
+}
+
+int ConcurrentMapper::num_dropped() const {
+  MutexLock lock(&mutex_);
+  return num_dropped_;
+}
+
+void *ConcurrentMapper::ThreadEntry(void *mapper) {
+  static_cast<ConcurrentMapper *>(mapper)->Run();
+  return NULL;
+}
+
+void ConcurrentMapper::Run() {
+  for (;;) {
+    Reconstruction *map = NULL;
+    vector<CameraID> window;
+    {
+      MutexLock lock(&mutex_);
+      while (!pending_ && !stop_) {
+        wake_up_.Wait(&mutex_);
+      }
+      if (stop_) {
+        return;
+      }
+      map = pending_;
+      window = pending_window_;
+      pending_ = NULL;
+      busy_ = true;
+    }
+    Adjust(map, window);
+  }
+}
+
+void ConcurrentMapper::Adjust(Reconstruction *map,
+                              const vector<CameraID> &window) {
+  LocalMetricBundleAdjust(matches_, window, map);
+  Reconstruction *replaced = NULL;
+  {
+    MutexLock lock(&mutex_);
+    // A map not applied yet is superseded: the tracking thread only needs the
+    // newest one.
+    replaced = published_;
+    published_ = map;
+    ++num_adjusted_;
+    busy_ = false;
+    idle_.Broadcast();
+  }
+  DeleteMap(replaced);
+}
+
+bool ConcurrentReconstructionKeyframes(const Matches &matches,
+                                       const vector<Matches::ImageID> &kframes,
+                                       int first_keyframe_index,
+                                       const Mat3 &K,
+                                       const Vec2u &image_size,
+                                       Reconstruction *reconstruction,
+                                       int *keyframe_stopped_index,
+                                       int local_bundle_size) {
+  if (local_bundle_size < 1) {
+    local_bundle_size = 1;
+  }
+  ConcurrentMapper mapper(matches);
+  bool is_good = true;
+  int keyframe_index = first_keyframe_index;
+  for (; keyframe_index < kframes.size(); ++keyframe_index) {
+    *keyframe_stopped_index = keyframe_index;
+    Matches::ImageID image_id = kframes[keyframe_index];
+    if (mapper.ApplyLatest(reconstruction)) {
+      VLOG(2) << " -- Adjusted map applied --  " << std::endl;
+    }
+    VLOG(2) << " -- Incremental Resection --  " << std::endl;
+    Matches matches_inliers;
+    is_good = CalibratedCameraResection(matches, image_id, K,
+                                        &matches_inliers, reconstruction);
+    if (!is_good) {
+      VLOG(1) << "[Warning] Tracking lost!" << std::endl;
+      break;
+    }
+    PinholeCamera *camera =
+      dynamic_cast<PinholeCamera *>(reconstruction->GetCamera(image_id));
+    if (camera) {
+      camera->set_image_size(image_size);
+    }
+
+    VLOG(2) << " -- Incremental Intersection --  " << std::endl;
+    uint num_new_points = PointStructureTriangulationCalibrated(
+                          matches, image_id, 2, reconstruction);
+    VLOG(2) << num_new_points << " points reconstructed." << std::endl;
+    if (num_new_points > 0) {
+      vector<CameraID> window;
+      int first = std::max(0, keyframe_index - local_bundle_size + 1);
+      for (int i = first; i <= keyframe_index; ++i) {
+        if (reconstruction->ImageHasCamera(kframes[i])) {
+          window.push_back(kframes[i]);
+        }
+      }
+      mapper.Submit(*reconstruction, window);
+    }
+  }
+  mapper.Flush();
+  mapper.ApplyLatest(reconstruction);
+  return is_good;
+}
+
+}  // namespace libmv
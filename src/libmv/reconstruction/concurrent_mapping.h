@@ -0,0 +1,113 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_RECONSTRUCTION_CONCURRENT_MAPPING_H_
+#define LIBMV_RECONSTRUCTION_CONCURRENT_MAPPING_H_
+
+#include "libmv/base/thread.h"
+#include "libmv/base/vector.h"
+#include "libmv/correspondence/matches.h"
+#include "libmv/numeric/numeric.h"
+#include "libmv/reconstruction/reconstruction.h"
+
+namespace libmv {
+
+// Runs the local bundle adjustments of an incremental reconstruction on a
+// background thread (the mapping thread), so that the thread that localizes
+// the new images (the tracking thread) does not wait for them.
+//
+// Submit() copies the pinhole cameras and point structures of the
+// reconstruction (see CopyReconstructionForExport()); the mapping thread
+// adjusts the copy and publishes it. The tracking thread picks the last
+// published map up with ApplyLatest(), between two images, which copies the
+// adjusted poses and points back. Both only hold the mutex of the mapper to
+// exchange a pointer, never during a copy or an adjustment. As with
+// AsyncBlenderExportObserver, a submitted copy that the thread has not
+// started yet is replaced by a newer one, so that the adjustments never lag
+// more than one submission behind.
+class ConcurrentMapper {
+ public:
+  // matches must outlive the mapper and must not change while it runs.
+  explicit ConcurrentMapper(const Matches &matches);
+  // Waits for the adjustment in progress; a pending copy is dropped.
+  ~ConcurrentMapper();
+
+  // Queues a local bundle adjustment (see LocalMetricBundleAdjust()) of the
+  // cameras of window, on a copy of reconstruction.
+  void Submit(const Reconstruction &reconstruction,
+              const vector<CameraID> &window);
+
+  // Copies the poses and points of the last published map into
+  // reconstruction, and returns whether there was one not applied yet. The
+  // cameras and points added to reconstruction after the submission keep
+  // their values; they are refined by the next adjustments. Never waits.
+  bool ApplyLatest(Reconstruction *reconstruction);
+
+  // Blocks until every accepted submission has been published.
+  void Flush();
+
+  // The number of adjustments published and of submissions dropped so far.
+  int num_adjusted() const;
+  int num_dropped() const;
+
+ private:
+  static void *ThreadEntry(void *mapper);
+  void Run();
+  void Adjust(Reconstruction *map, const vector<CameraID> &window);
+
+  // No copying allowed.
+  ConcurrentMapper(const ConcurrentMapper &);
+  ConcurrentMapper &operator=(const ConcurrentMapper &);
+
+  const Matches &matches_;
+
+  // Protect the members below.
+  mutable Mutex mutex_;
+  ConditionVariable wake_up_;
+  ConditionVariable idle_;
+  Reconstruction *pending_;
+  vector<CameraID> pending_window_;
+  Reconstruction *published_;
+  int num_adjusted_;
+  int num_dropped_;
+  bool busy_;
+  bool stop_;
+  bool thread_started_;
+  pthread_t thread_;
+};
+
+// Same as IncrementalReconstructionKeyframes(), but the local bundle
+// adjustments of the last local_bundle_size keyframes run on a ConcurrentMapper
+// while the next keyframes are localized and triangulated: every keyframe is
+// resected against the last adjusted map published when it arrives. There is
+// no global bundle adjustment; the last adjustment is waited for and applied
+// before returning, also when the tracking is lost.
+bool ConcurrentReconstructionKeyframes(const Matches &matches,
+                                       const vector<Matches::ImageID> &kframes,
+                                       int first_keyframe_index,
+                                       const Mat3 &K,
+                                       const Vec2u &image_size,
+                                       Reconstruction *reconstruction,
+                                       int *keyframe_stopped_index,
+                                       int local_bundle_size = 5);
+
+}  // namespace libmv
+
+#endif  // LIBMV_RECONSTRUCTION_CONCURRENT_MAPPING_H_
@@ -0,0 +1,179 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <list>
+
+#include "libmv/camera/pinhole_camera.h"
+#include "libmv/multiview/projection.h"
+#include "libmv/multiview/test_data_sets.h"
+#include "libmv/numeric/numeric.h"
+#include "libmv/reconstruction/concurrent_mapping.h"
+#include "testing/testing.h"
+
+namespace libmv {
+namespace {
+
+void GenerateMatchesFromNViewDataSet(const NViewDataSet &d,
+                                     Matches *matches,
+                                     std::list<Feature *> *list_features) {
+  for (size_t n = 0; n < d.n; ++n) {
+    for (size_t p = 0; p < d.x[n].cols(); ++p) {
+      PointFeature * feature = new PointFeature(d.x[n](0, p), d.x[n](1, p));
+      list_features->push_back(feature);
+      matches->Insert(n, p, feature);
+    }
+  }
+}
+
+void DeleteFeatures(std::list<Feature *> *list_features) {
+  std::list<Feature *>::iterator features_iter = list_features->begin();
+  for (; features_iter != list_features->end(); ++features_iter)
+    delete *features_iter;
+  list_features->clear();
+}
+
+// The cameras of d, the two last ones perturbed, and its points perturbed.
+void PerturbedReconstruction(const NViewDataSet &d,
+                             Reconstruction *reconstruction) {
+  for (int i = 0; i < d.n; ++i) {
+    Mat3 R = d.R[i];
+    Vec3 t = d.t[i];
+    if (i >= d.n - 2) {
+      R *= RotationAroundX(0.01) * RotationAroundY(-0.02);
+      t += Vec3(0.05, -0.05, 0.02);
+    }
+    reconstruction->InsertCamera(i, new PinholeCamera(d.K[i], R, t));
+  }
+  for (int j = 0; j < d.X.cols(); ++j) {
+    Vec3 X = d.X.col(j) + Vec3::Random() * 0.05;
+    reconstruction->InsertTrack(j, new PointStructure(X));
+  }
+}
+
+TEST(ConcurrentMapper, PublishesTheAdjustedMap) {
+  int nviews = 6;
+  NViewDataSet d = NRealisticCamerasFull(nviews, 50);
+  Matches matches;
+  std::list<Feature *> list_features;
+  GenerateMatchesFromNViewDataSet(d, &matches, &list_features);
+  Reconstruction reconstruction;
+  PerturbedReconstruction(d, &reconstruction);
+
+  ConcurrentMapper mapper(matches);
+  EXPECT_FALSE(mapper.ApplyLatest(&reconstruction));
+  vector<CameraID> window;
+  window.push_back(nviews - 2);
+  window.push_back(nviews - 1);
+  mapper.Submit(reconstruction, window);
+  mapper.Flush();
+  EXPECT_EQ(1, mapper.num_adjusted());
+  EXPECT_EQ(0, mapper.num_dropped());
+
+  // Nothing moves until the map is applied.
+  PinholeCamera *camera =
+    dynamic_cast<PinholeCamera *>(reconstruction.GetCamera(nviews - 1));
+  EXPECT_GT((d.t[nviews - 1] - camera->position()).norm(), 1e-2);
+  EXPECT_TRUE(mapper.ApplyLatest(&reconstruction));
+  EXPECT_FALSE(mapper.ApplyLatest(&reconstruction));
+  for (int i = 0; i < nviews; ++i) {
+    camera = dynamic_cast<PinholeCamera *>(reconstruction.GetCamera(i));
+    EXPECT_MATRIX_NEAR(d.R[i], camera->orientation_matrix(), 1e-4);
+  }
+
+  reconstruction.ClearCamerasMap();
+  reconstruction.ClearStructuresMap();
+  DeleteFeatures(&list_features);
+}
+
+TEST(ConcurrentMapper, SkipsWhatTheReconstructionRemoved) {
+  int nviews = 6;
+  NViewDataSet d = NRealisticCamerasFull(nviews, 50);
+  Matches matches;
+  std::list<Feature *> list_features;
+  GenerateMatchesFromNViewDataSet(d, &matches, &list_features);
+  Reconstruction reconstruction;
+  PerturbedReconstruction(d, &reconstruction);
+
+  ConcurrentMapper mapper(matches);
+  vector<CameraID> window;
+  window.push_back(nviews - 2);
+  window.push_back(nviews - 1);
+  mapper.Submit(reconstruction, window);
+  reconstruction.RemoveCamera(nviews - 1);
+  reconstruction.RemoveTrack(0);
+  mapper.Flush();
+  EXPECT_TRUE(mapper.ApplyLatest(&reconstruction));
+  EXPECT_EQ(nviews - 1, reconstruction.GetNumberCameras());
+  EXPECT_EQ(49, reconstruction.GetNumberStructures());
+  PinholeCamera *camera =
+    dynamic_cast<PinholeCamera *>(reconstruction.GetCamera(nviews - 2));
+  EXPECT_MATRIX_NEAR(d.R[nviews - 2], camera->orientation_matrix(), 1e-4);
+
+  reconstruction.ClearCamerasMap();
+  reconstruction.ClearStructuresMap();
+  DeleteFeatures(&list_features);
+}
+
+TEST(ConcurrentReconstructionKeyframes, LocalizesEveryKeyframe) {
+  int nviews = 8;
+  int npoints = 80;
+  NViewDataSet d = NRealisticCamerasFull(nviews, npoints);
+  Matches matches;
+  std::list<Feature *> list_features;
+  GenerateMatchesFromNViewDataSet(d, &matches, &list_features);
+
+  // The two first keyframes and half of the points are known, the other
+  // points are triangulated along the way.
+  Reconstruction reconstruction;
+  for (int i = 0; i < 2; ++i) {
+    reconstruction.InsertCamera(i, new PinholeCamera(d.K[i], d.R[i], d.t[i]));
+  }
+  for (int j = 0; j < npoints / 2; ++j) {
+    reconstruction.InsertTrack(j, new PointStructure(Vec3(d.X.col(j))));
+  }
+  vector<Matches::ImageID> kframes;
+  for (int i = 0; i < nviews; ++i) {
+    kframes.push_back(i);
+  }
+  Vec2u image_size;
+  image_size << d.K[0](0, 2) * 2, d.K[0](1, 2) * 2;
+
+  int keyframe_stopped_index = -1;
+  EXPECT_TRUE(ConcurrentReconstructionKeyframes(matches, kframes, 2, d.K[0],
+                                                image_size, &reconstruction,
+                                                &keyframe_stopped_index, 3));
+  EXPECT_EQ(nviews - 1, keyframe_stopped_index);
+  EXPECT_EQ(nviews, reconstruction.GetNumberCameras());
+  EXPECT_GT(reconstruction.GetNumberStructures(), npoints / 2);
+  for (int i = 0; i < nviews; ++i) {
+    PinholeCamera *camera =
+      dynamic_cast<PinholeCamera *>(reconstruction.GetCamera(i));
+    ASSERT_TRUE(camera != NULL);
+    EXPECT_MATRIX_NEAR(d.R[i], camera->orientation_matrix(), 1e-4);
+    EXPECT_MATRIX_NEAR(d.t[i], camera->position(), 1e-3);
+  }
+
+  reconstruction.ClearCamerasMap();
+  reconstruction.ClearStructuresMap();
+  DeleteFeatures(&list_features);
+}
+
+}  // namespace
+}  // namespace libmv
@@ -0,0 +1,173 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/reconstruction/dense_reconstruction.h"
+
+namespace libmv {
+
+int DenseReconstruction::InsertCamera(CameraID id,
+                                      const Mat3 &K,
+                                      const Mat3 &R,
+                                      const Vec3 &t) {
+  std::map<CameraID, int>::iterator it = camera_indices_.find(id);
+  int camera;
+  if (it != camera_indices_.end()) {
+    camera = it->second;
+  } else {
+    camera = camera_ids_.size();
+    camera_indices_[id] = camera;
+    camera_ids_.push_back(id);
+    Ks_.push_back(K);
+    Rs_.push_back(R);
+    ts_.push_back(t);
+    image_sizes_.push_back(Vec2u::Zero());
+  }
+  Ks_[camera] = K;
+  Rs_[camera] = R;
+  ts_[camera] = t;
+  return camera;
+}
+
+int DenseReconstruction::InsertPoint(StructureID id, const Vec3 &X) {
+  std::map<StructureID, int>::iterator it = point_indices_.find(id);
+  if (it != point_indices_.end()) {
+    Xs_[it->second] = X;
+    return it->second;
+  }
+  int point = point_ids_.size();
+  point_indices_[id] = point;
+  point_ids_.push_back(id);
+  Xs_.push_back(X);
+  return point;
+}
+
+void DenseReconstruction::AddObservation(int camera,
+                                         int point,
+                                         const Vec2 &x) {
+  observation_cameras_.push_back(camera);
+  observation_points_.push_back(point);
+  observations_.push_back(x);
+}
+
+void DenseReconstruction::RemoveObservations(
+    const std::vector<char> &is_removed) {
+  int kept = 0;
+  for (int k = 0; k < observations_.size(); ++k) {
+    if (is_removed[k]) {
+      continue;
+    }
+    observation_cameras_[kept] = observation_cameras_[k];
+    observation_points_[kept] = observation_points_[k];
+    observations_[kept] = observations_[k];
+    ++kept;
+  }
+  observation_cameras_.resize(kept);
+  observation_points_.resize(kept);
+  observations_.resize(kept);
+}
+
+void DenseReconstruction::Clear() {
+  camera_indices_.clear();
+  point_indices_.clear();
+  camera_ids_.clear();
+  point_ids_.clear();
+  Ks_.clear();
+  Rs_.clear();
+  ts_.clear();
+  image_sizes_.clear();
+  Xs_.clear();
+  observation_cameras_.clear();
+  observation_points_.clear();
+  observations_.clear();
+}
+
+int DenseReconstruction::CameraIndex(CameraID id) const {
+  std::map<CameraID, int>::const_iterator it = camera_indices_.find(id);
+  return it != camera_indices_.end() ? it->second : -1;
+}
+
+int DenseReconstruction::PointIndex(StructureID id) const {
+  std::map<StructureID, int>::const_iterator it = point_indices_.find(id);
+  return it != point_indices_.end() ? it->second : -1;
+}
+
+bool DenseReconstructionFromReconstruction(const Matches &matches,
+                                           const Reconstruction &reconstruction,
+                                           DenseReconstruction *dense) {
+  dense->Clear();
+  bool all_converted = true;
+  std::map<StructureID, Structure *>::const_iterator str_iter =
+    reconstruction.structures().begin();
+  for (; str_iter != reconstruction.structures().end(); ++str_iter) {
+    PointStructure *pstructure =
+      dynamic_cast<PointStructure *>(str_iter->second);
+    if (pstructure) {
+      dense->InsertPoint(str_iter->first, pstructure->coords_affine());
+    } else {
+      all_converted = false;
+    }
+  }
+  std::map<CameraID, Camera *>::const_iterator cam_iter =
+    reconstruction.cameras().begin();
+  for (; cam_iter != reconstruction.cameras().end(); ++cam_iter) {
+    PinholeCamera *pcamera = dynamic_cast<PinholeCamera *>(cam_iter->second);
+    if (!pcamera) {
+      all_converted = false;
+      continue;
+    }
+    Mat3 K, R;
+    Vec3 t;
+    pcamera->GetIntrinsicExtrinsicParameters(&K, &R, &t);
+    int camera = dense->InsertCamera(cam_iter->first, K, R, t);
+    dense->image_sizes()[camera] = pcamera->image_size();
+    Matches::Features<PointFeature> fp =
+      matches.InImage<PointFeature>(cam_iter->first);
+    for (; fp; ++fp) {
+      int point = dense->PointIndex(fp.track());
+      if (point >= 0) {
+        dense->AddObservation(camera, point,
+                              fp.feature()->coords.cast<double>());
+      }
+    }
+  }
+  return all_converted;
+}
+
+void UpdateReconstruction(const DenseReconstruction &dense,
+                          Reconstruction *reconstruction) {
+  for (int c = 0; c < dense.NumCameras(); ++c) {
+    PinholeCamera *pcamera = dynamic_cast<PinholeCamera *>(
+        reconstruction->GetCamera(dense.camera_id(c)));
+    if (pcamera) {
+      pcamera->SetIntrinsicExtrinsicParameters(dense.Ks()[c],
+                                               dense.Rs()[c],
+                                               dense.ts()[c]);
+    }
+  }
+  for (int j = 0; j < dense.NumPoints(); ++j) {
+    PointStructure *pstructure = dynamic_cast<PointStructure *>(
+        reconstruction->GetStructure(dense.point_id(j)));
+    if (pstructure) {
+      pstructure->set_coords_affine(dense.Xs()[j]);
+    }
+  }
+}
+
+}  // namespace libmv
@@ -0,0 +1,134 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_RECONSTRUCTION_DENSE_RECONSTRUCTION_H_
+#define LIBMV_RECONSTRUCTION_DENSE_RECONSTRUCTION_H_
+
+#include <map>
+#include <vector>
+
+#include "libmv/base/vector.h"
+#include "libmv/correspondence/matches.h"
+#include "libmv/numeric/numeric.h"
+#include "libmv/reconstruction/reconstruction.h"
+
+namespace libmv {
+
+// A reconstruction of pinhole cameras and 3D points, stored as parallel
+// contiguous arrays instead of maps of heap allocated cameras and structures.
+// Cameras and points get dense indices in insertion order, which do not
+// change afterwards; inserting an id again replaces its values in place.
+// The observations (the features of the cameras on the points) are stored as
+// three parallel arrays as well.
+//
+// The bundle adjustment, the reprojection error and the exporters work on the
+// arrays directly, e.g.
+//
+//   DenseReconstruction dense;
+//   DenseReconstructionFromReconstruction(matches, reconstruction, &dense);
+//   MetricBundleAdjust(&dense);
+//   UpdateReconstruction(dense, &reconstruction);
+class DenseReconstruction {
+ public:
+  DenseReconstruction() {}
+
+  // Returns the index of the camera.
+  int InsertCamera(CameraID id, const Mat3 &K, const Mat3 &R, const Vec3 &t);
+
+  // Returns the index of the point.
+  int InsertPoint(StructureID id, const Vec3 &X);
+
+  // The feature x of camera is an image of point (both are indices).
+  void AddObservation(int camera, int point, const Vec2 &x);
+
+  // Removes the observations k for which is_removed[k] is true, keeping the
+  // order of the others, in one pass over the arrays.
+  void RemoveObservations(const std::vector<char> &is_removed);
+
+  // Removes everything.
+  void Clear();
+
+  // Return -1 if the id is not in the reconstruction.
+  int CameraIndex(CameraID id) const;
+  int PointIndex(StructureID id) const;
+
+  int NumCameras() const      { return camera_ids_.size(); }
+  int NumPoints() const       { return point_ids_.size(); }
+  int NumObservations() const { return observations_.size(); }
+
+  CameraID camera_id(int camera) const   { return camera_ids_[camera]; }
+  StructureID point_id(int point) const  { return point_ids_[point]; }
+
+  // The camera arrays, indexed by camera index, with the convention
+  // x = K * (R * X + t). The image sizes default to zero.
+  const vector<Mat3>  &Ks() const          { return Ks_; }
+  const vector<Mat3>  &Rs() const          { return Rs_; }
+  const vector<Vec3>  &ts() const          { return ts_; }
+  const vector<Vec2u> &image_sizes() const { return image_sizes_; }
+  vector<Mat3>  &Ks()          { return Ks_; }
+  vector<Mat3>  &Rs()          { return Rs_; }
+  vector<Vec3>  &ts()          { return ts_; }
+  vector<Vec2u> &image_sizes() { return image_sizes_; }
+
+  // The point coordinates, indexed by point index.
+  const vector<Vec3> &Xs() const { return Xs_; }
+  vector<Vec3> &Xs()             { return Xs_; }
+
+  // The observations, indexed by observation.
+  const vector<int>  &observation_cameras() const {
+    return observation_cameras_; }
+  const vector<int>  &observation_points() const {
+    return observation_points_; }
+  const vector<Vec2> &observations() const {
+    return observations_; }
+
+ private:
+  std::map<CameraID, int>     camera_indices_;
+  std::map<StructureID, int>  point_indices_;
+  vector<CameraID>    camera_ids_;
+  vector<StructureID> point_ids_;
+
+  vector<Mat3>  Ks_;
+  vector<Mat3>  Rs_;
+  vector<Vec3>  ts_;
+  vector<Vec2u> image_sizes_;
+  vector<Vec3>  Xs_;
+
+  vector<int>  observation_cameras_;
+  vector<int>  observation_points_;
+  vector<Vec2> observations_;
+};
+
+// Converts the pinhole cameras and point structures of reconstruction, in the
+// order of their ids, and the point features of matches observing them.
+// dense is cleared first. Returns false if reconstruction has other kinds of
+// cameras or structures, which are skipped.
+bool DenseReconstructionFromReconstruction(const Matches &matches,
+                                           const Reconstruction &reconstruction,
+                                           DenseReconstruction *dense);
+
+// Copies the camera poses, intrinsics and point coordinates of dense to the
+// cameras and structures of reconstruction with the same ids.
+void UpdateReconstruction(const DenseReconstruction &dense,
+                          Reconstruction *reconstruction);
+
+}  // namespace libmv
+
+#endif  // LIBMV_RECONSTRUCTION_DENSE_RECONSTRUCTION_H_
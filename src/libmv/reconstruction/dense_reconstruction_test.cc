@@ -0,0 +1,187 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <list>
+
+#include "libmv/multiview/test_data_sets.h"
+#include "libmv/numeric/numeric.h"
+#include "libmv/reconstruction/dense_reconstruction.h"
+#include "libmv/reconstruction/optimization.h"
+#include "libmv/reconstruction/tools.h"
+#include "libmv/reconstruction/track_index.h"
+#include "testing/testing.h"
+
+namespace libmv {
+namespace {
+
+TEST(DenseReconstruction, InsertKeepsIndices) {
+  DenseReconstruction dense;
+  EXPECT_EQ(0, dense.InsertCamera(5, Mat3::Identity(), Mat3::Identity(),
+                                  Vec3(1, 2, 3)));
+  EXPECT_EQ(1, dense.InsertCamera(2, Mat3::Identity(), Mat3::Identity(),
+                                  Vec3::Zero()));
+  EXPECT_EQ(0, dense.InsertPoint(9, Vec3(1, 1, 1)));
+  // Inserting an id again replaces its values in place.
+  EXPECT_EQ(0, dense.InsertCamera(5, Mat3::Identity(), Mat3::Identity(),
+                                  Vec3(4, 5, 6)));
+  EXPECT_EQ(0, dense.InsertPoint(9, Vec3(2, 2, 2)));
+
+  EXPECT_EQ(2, dense.NumCameras());
+  EXPECT_EQ(1, dense.NumPoints());
+  EXPECT_EQ(0, dense.CameraIndex(5));
+  EXPECT_EQ(1, dense.CameraIndex(2));
+  EXPECT_EQ(-1, dense.CameraIndex(3));
+  EXPECT_EQ(0, dense.PointIndex(9));
+  EXPECT_EQ(-1, dense.PointIndex(5));
+  EXPECT_EQ(5, dense.camera_id(0));
+  EXPECT_EQ(9, dense.point_id(0));
+  EXPECT_MATRIX_NEAR(Vec3(4, 5, 6), dense.ts()[0], 0);
+  EXPECT_MATRIX_NEAR(Vec3(2, 2, 2), dense.Xs()[0], 0);
+}
+
+TEST(DenseReconstruction, BundleAdjustOnTheArrays) {
+  int nviews = 4;
+  int npoints = 40;
+  NViewDataSet d = NRealisticCamerasFull(nviews, npoints);
+  Matches matches;
+  std::list<Feature *> features;
+  Reconstruction reconstruction;
+  for (int i = 0; i < nviews; ++i) {
+    Mat3 R = d.R[i];
+    Vec3 t = d.t[i];
+    if (i > 0) {
+      R *= RotationAroundX(0.01);
+      t += Vec3(0.02, -0.01, 0.01);
+    }
+    reconstruction.InsertCamera(i, new PinholeCamera(d.K[i], R, t));
+    for (int j = 0; j < npoints; ++j) {
+      PointFeature *feature = new PointFeature(d.x[i](0, j), d.x[i](1, j));
+      features.push_back(feature);
+      matches.Insert(i, j, feature);
+    }
+  }
+  for (int j = 0; j < npoints; ++j) {
+    reconstruction.InsertTrack(j, new PointStructure(Vec3(d.X.col(j))));
+  }
+
+  DenseReconstruction dense;
+  EXPECT_TRUE(DenseReconstructionFromReconstruction(matches, reconstruction,
+                                                    &dense));
+  EXPECT_EQ(nviews, dense.NumCameras());
+  EXPECT_EQ(npoints, dense.NumPoints());
+  EXPECT_EQ(nviews * npoints, dense.NumObservations());
+  EXPECT_NEAR(EstimateRootMeanSquareError(matches, &reconstruction),
+              EstimateRootMeanSquareError(dense), 1e-9);
+
+  double rms0 = EstimateRootMeanSquareError(dense);
+  double rms = MetricBundleAdjust(&dense);
+  EXPECT_LT(rms, rms0);
+  EXPECT_NEAR(rms, EstimateRootMeanSquareError(dense), 1e-9);
+
+  UpdateReconstruction(dense, &reconstruction);
+  EXPECT_NEAR(rms, EstimateRootMeanSquareError(matches, &reconstruction),
+              1e-9);
+
+  reconstruction.ClearCamerasMap();
+  reconstruction.ClearStructuresMap();
+  std::list<Feature *>::iterator it = features.begin();
+  for (; it != features.end(); ++it) {
+    delete *it;
+  }
+}
+
+TEST(RemoveAllOutliers, RemovesTheMatchesAndLonelyPoints) {
+  int nviews = 3;
+  int npoints = 20;
+  NViewDataSet d = NRealisticCamerasFull(nviews, npoints);
+  Matches matches;
+  std::list<Feature *> features;
+  Reconstruction reconstruction;
+  for (int i = 0; i < nviews; ++i) {
+    reconstruction.InsertCamera(i, new PinholeCamera(d.K[i], d.R[i], d.t[i]));
+    for (int j = 0; j < npoints; ++j) {
+      Vec2 x = d.x[i].col(j);
+      // Track 0 is wrong in two views and track 5 in one.
+      if ((j == 0 && i < 2) || (j == 5 && i == 2)) {
+        x += Vec2(10, -10);
+      }
+      PointFeature *feature = new PointFeature(x(0), x(1));
+      features.push_back(feature);
+      matches.Insert(i, j, feature);
+    }
+  }
+  for (int j = 0; j < npoints; ++j) {
+    reconstruction.InsertTrack(j, new PointStructure(Vec3(d.X.col(j))));
+  }
+  ReconstructedTrackIndex index(matches, reconstruction);
+  reconstruction.set_track_index(&index);
+
+  EXPECT_EQ(3, RemoveAllOutliers(&matches, &reconstruction, 2.0, 3));
+  EXPECT_TRUE(matches.Get(0, 0) == NULL);
+  EXPECT_TRUE(matches.Get(1, 0) == NULL);
+  EXPECT_TRUE(matches.Get(2, 5) == NULL);
+  EXPECT_TRUE(matches.Get(2, 0) != NULL);
+  // Track 0 has a single view left.
+  EXPECT_FALSE(reconstruction.TrackHasStructure(0));
+  EXPECT_TRUE(reconstruction.TrackHasStructure(5));
+  EXPECT_EQ(npoints - 1, reconstruction.GetNumberStructures());
+
+  // The index follows the removals.
+  vector<StructureID> ids;
+  SelectExistingPointStructures(matches, 2, reconstruction, &ids);
+  EXPECT_EQ(npoints - 2, ids.size());
+  SelectNonReconstructedPointStructures(matches, 2, reconstruction, &ids);
+  ASSERT_EQ(1, ids.size());
+  EXPECT_EQ(0, ids[0]);
+
+  EXPECT_EQ(0, RemoveAllOutliers(&matches, &reconstruction, 2.0, 3));
+
+  reconstruction.set_track_index(NULL);
+  reconstruction.ClearCamerasMap();
+  reconstruction.ClearStructuresMap();
+  std::list<Feature *>::iterator it = features.begin();
+  for (; it != features.end(); ++it) {
+    delete *it;
+  }
+}
+
+TEST(RemoveOutlierObservations, CompactsTheArrays) {
+  DenseReconstruction dense;
+  dense.InsertCamera(0, Mat3::Identity(), Mat3::Identity(), Vec3::Zero());
+  dense.InsertPoint(0, Vec3(0, 0, 1));
+  dense.InsertPoint(1, Vec3(1, 0, 1));
+  dense.AddObservation(0, 0, Vec2(0, 0));
+  dense.AddObservation(0, 1, Vec2(5, 0));
+  dense.AddObservation(0, 1, Vec2(1, 0.5));
+
+  std::vector<char> is_outlier;
+  EXPECT_EQ(1, RemoveOutlierObservations(&dense, 1.0, 2, &is_outlier));
+  ASSERT_EQ(3, is_outlier.size());
+  EXPECT_FALSE(is_outlier[0]);
+  EXPECT_TRUE(is_outlier[1]);
+  EXPECT_FALSE(is_outlier[2]);
+  ASSERT_EQ(2, dense.NumObservations());
+  EXPECT_EQ(0, dense.observation_points()[0]);
+  EXPECT_EQ(1, dense.observation_points()[1]);
+  EXPECT_MATRIX_NEAR(Vec2(1, 0.5), dense.observations()[1], 0);
+}
+
+}  // namespace
+}  // namespace libmv
@@ -18,22 +18,29 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <map>
+#include <vector>
+
+#include "libmv/base/thread.h"
 #include "libmv/base/vector_utils.h"
 #include "libmv/camera/pinhole_camera.h"
 #include "libmv/correspondence/matches.h"
 #include "libmv/logging/logging.h"
+#include "libmv/multiview/euclidean_resection.h"
 #include "libmv/multiview/five_point.h"
 #include "libmv/multiview/fundamental.h"
 #include "libmv/multiview/robust_euclidean_resection.h"
 #include "libmv/multiview/robust_fundamental.h"
 #include "libmv/reconstruction/euclidean_reconstruction.h"
-#include "libmv/reconstruction/export_blender.h"
 #include "libmv/reconstruction/export_ply.h"
+#include "libmv/reconstruction/global_reconstruction.h"
 #include "libmv/reconstruction/image_selection.h"
 #include "libmv/reconstruction/keyframe_selection.h"
 #include "libmv/reconstruction/mapping.h"
 #include "libmv/reconstruction/optimization.h"
+#include "libmv/reconstruction/reconstruction_checkpoint.h"
 #include "libmv/reconstruction/tools.h"
+#include "libmv/reconstruction/track_index.h"
 
 
 namespace libmv {
@@ -51,40 +58,70 @@ inline bool SetImageSize(Reconstruction &recons,
   return false;
 }
 
-bool CalibratedCameraResection(const Matches &matches, 
-                               Matches::ImageID image_id, 
-                               const Mat3 &K, 
-                               Matches *matches_inliers,
-                               Reconstruction *reconstruction) {
+namespace {
+
+// Estimates the pose of the camera of image_id from the already reconstructed
+// points, without modifying the reconstruction. structures_ids receives the
+// reconstructed tracks observed in the image.
+bool CalibratedCameraPoseByResection(const Matches &matches,
+                                     Matches::ImageID image_id,
+                                     const Mat3 &K,
+                                     const Reconstruction &reconstruction,
+                                     Mat3 *R,
+                                     Vec3 *t,
+                                     vector<StructureID> *structures_ids) {
   double rms_inliers_threshold = 1;// in pixels
-  vector<StructureID> structures_ids;
-  Mat2X x_image;
+  Mat2X x_image, x_camera;
   Mat4X X_world;
-  // Selects only the reconstructed tracks observed in the image
-  SelectExistingPointStructures(matches, image_id, *reconstruction,
-                                &structures_ids, &x_image);
+  // Selects only the reconstructed tracks observed in the image, with their
+  // normalized coordinates if the track index has them.
+  const ReconstructedTrackIndex *index = reconstruction.track_index();
+  bool has_bearings = index && &index->matches() == &matches &&
+                      index->HasIntrinsics(image_id);
+  if (has_bearings) {
+    index->SelectTracks(image_id, true, structures_ids, NULL, &x_camera);
+  } else {
+    SelectExistingPointStructures(matches, image_id, reconstruction,
+                                  structures_ids, &x_image);
+  }
  
   // TODO(julien) Also remove structures that are on the same location
-  if (structures_ids.size() < 5) {
+  if (structures_ids->size() < 5) {
     LOG(ERROR) << "Error: there are not enough points to estimate the pose ("
-               << structures_ids.size() << "<5).";
+               << structures_ids->size() << "<5).";
     // We need at least 5 tracks in order to do resection
     return false;
   }
-  MatrixOfPointStructureCoordinates(structures_ids, *reconstruction, &X_world);
-  CHECK(x_image.cols() == X_world.cols());
+  MatrixOfPointStructureCoordinates(*structures_ids, reconstruction, &X_world);
+  CHECK(structures_ids->size() == X_world.cols());
  
   Mat3X X;
   HomogeneousToEuclidean(X_world, &X);
-  Mat3 R;
-  Vec3 t;
   vector<int> inliers;
   
-  EuclideanResectionEPnPRobust(x_image, X, K, rms_inliers_threshold,
-                               &R, &t, &inliers, 1e-3);
+  if (has_bearings) {
+    EuclideanResectionEPnPRobust(x_camera, X, rms_inliers_threshold,
+                                 R, t, &inliers, 1e-3);
+  } else {
+    EuclideanResectionEPnPRobust(x_image, X, K, rms_inliers_threshold,
+                                 R, t, &inliers, 1e-3);
+  }
 
   // TODO(julien) Performs non-linear optimization of the pose.
-  
+  return true;
+}
+
+// Creates the camera of image_id with the pose (R, t), adds it to the
+// reconstruction and inserts the matches of structures_ids into
+// matches_inliers.
+void InsertResectedCamera(const Matches &matches,
+                          Matches::ImageID image_id,
+                          const Mat3 &K,
+                          const Mat3 &R,
+                          const Vec3 &t,
+                          const vector<StructureID> &structures_ids,
+                          Matches *matches_inliers,
+                          Reconstruction *reconstruction) {
   // Create a new camera and add it to the reconstruction
   PinholeCamera * camera = new PinholeCamera(K, R, t);
   reconstruction->InsertCamera(image_id, camera);
@@ -100,6 +137,162 @@ bool CalibratedCameraResection(const Matches &matches,
     matches_inliers->Insert(image_id, structures_ids[s], feature);
   }
   VLOG(1)   << "Inliers added: " << structures_ids.size() << std::endl;
+}
+
+// Resects the images of a keyframe interval against a reconstruction that is
+// not modified while the functor runs, so that the images can be processed
+// by several threads.
+struct IntervalResection {
+  const Matches *matches;
+  const Mat3 *K;
+  const Reconstruction *reconstruction;
+  const vector<Matches::ImageID> *images;
+  std::vector<Mat3> Rs;
+  std::vector<Vec3> ts;
+  std::vector<vector<StructureID> > structures_ids;
+  std::vector<int> is_localized;
+
+  void operator()(int i) {
+    is_localized[i] = CalibratedCameraPoseByResection(*matches,
+                                                      (*images)[i], *K,
+                                                      *reconstruction,
+                                                      &Rs[i], &ts[i],
+                                                      &structures_ids[i]);
+  }
+};
+
+// Localizes all the images of non_keyframes in parallel against the current
+// structure, then adds their cameras and refines them, either with a global
+// bundle adjustment or with a motion only adjustment.
+// Returns the number of localized images.
+int ResectKeyframeInterval(const Matches &matches,
+                           const vector<Matches::ImageID> &non_keyframes,
+                           const Mat3 &K,
+                           const Vec2u &image_size,
+                           bool global_bundle_adjustment,
+                           int num_threads,
+                           Reconstruction *reconstruction) {
+  int num_images = non_keyframes.size();
+  if (num_images == 0) {
+    return 0;
+  }
+  IntervalResection resection;
+  resection.matches = &matches;
+  resection.K = &K;
+  resection.reconstruction = reconstruction;
+  resection.images = &non_keyframes;
+  resection.Rs.resize(num_images);
+  resection.ts.resize(num_images);
+  resection.structures_ids.resize(num_images);
+  resection.is_localized.resize(num_images);
+  VLOG(2) << " -- Parallel Resection of " << num_images
+          << " images --  " << std::endl;
+  ParallelForDynamic(0, num_images, num_threads, &resection);
+
+  Matches matches_inliers;
+  vector<CameraID> cameras;
+  for (int i = 0; i < num_images; ++i) {
+    if (!resection.is_localized[i]) {
+      VLOG(1) << "[Warning] Image " << non_keyframes[i]
+              << " cannot be localized!" << std::endl;
+      continue;
+    }
+    InsertResectedCamera(matches, non_keyframes[i], K,
+                         resection.Rs[i], resection.ts[i],
+                         resection.structures_ids[i],
+                         &matches_inliers, reconstruction);
+    SetImageSize(*reconstruction, non_keyframes[i], image_size);
+    cameras.push_back(non_keyframes[i]);
+  }
+  if (cameras.size() > 0) {
+    if (global_bundle_adjustment) {
+      VLOG(2) << " -- Bundle adjustment --  " << std::endl;
+      MetricBundleAdjust(matches, reconstruction);
+    } else {
+      VLOG(2) << " -- Motion only adjustment --  " << std::endl;
+      MetricMotionAdjust(matches, cameras, reconstruction, num_threads);
+    }
+  }
+  return cameras.size();
+}
+
+// Same as ReconstructionNonKeyframes(), resecting the frames of each keyframe
+// interval with ResectKeyframeInterval().
+bool ReconstructionNonKeyframesByIntervals(
+    const Matches &matches,
+    const Mat3 &K,
+    const Vec2u &image_size,
+    std::list<Reconstruction *> *reconstructions,
+    int global_bundle_period,
+    int num_threads,
+    bool always_global_bundle,
+    ReconstructionObserver *observer) {
+  if (reconstructions->empty()) {
+    return true;
+  }
+  std::list<Reconstruction *>::iterator recons_iter = reconstructions->begin();
+  std::list<Reconstruction *>::iterator recons_iter_next = recons_iter;
+  recons_iter_next++;
+  int cpt_ba = 0, cpt_interval = 0;
+  // The images met since the last localized image of the reconstruction.
+  vector<Matches::ImageID> interval;
+  std::set<Matches::ImageID>::const_iterator img_iter = 
+    matches.get_images().begin();
+  for (;; ++img_iter) {
+    bool is_last_image = img_iter == matches.get_images().end();
+    bool is_frame_in_current_recons = !is_last_image &&
+        (*recons_iter)->ImageHasCamera(*img_iter);
+    bool is_frame_in_next_recons = !is_last_image &&
+        recons_iter_next != reconstructions->end() && 
+        (*recons_iter_next)->ImageHasCamera(*img_iter);
+    if (!is_last_image && 
+        !is_frame_in_current_recons && !is_frame_in_next_recons) {
+      interval.push_back(*img_iter);
+      continue;
+    }
+    // A keyframe (or the end of the sequence) closes the interval.
+    if (interval.size() > 0) {
+      cpt_ba++;
+      bool global = always_global_bundle ||
+          (global_bundle_period > 0 && cpt_ba % global_bundle_period == 0);
+      if (ResectKeyframeInterval(matches, interval, K, image_size, global,
+                                 num_threads, *recons_iter) > 0 && observer) {
+        std::stringstream s;
+        s << "out-noKF-interval-" << cpt_interval;
+        observer->OnReconstructionStep(**recons_iter, s.str());
+      }
+      cpt_interval++;
+      interval.clear();
+    }
+    if (is_last_image) {
+      break;
+    }
+    if (is_frame_in_next_recons) {
+      // The current image is the first keyframe of the next reconstruction.
+      recons_iter++;
+      recons_iter_next++;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+
+bool CalibratedCameraResection(const Matches &matches, 
+                               Matches::ImageID image_id, 
+                               const Mat3 &K, 
+                               Matches *matches_inliers,
+                               Reconstruction *reconstruction) {
+  vector<StructureID> structures_ids;
+  Mat3 R;
+  Vec3 t;
+  if (!CalibratedCameraPoseByResection(matches, image_id, K, *reconstruction,
+                                       &R, &t, &structures_ids)) {
+    return false;
+  }
+  InsertResectedCamera(matches, image_id, K, R, t, structures_ids,
+                       matches_inliers, reconstruction);
   return true;
 }
 
@@ -110,7 +303,8 @@ bool InitialReconstructionTwoViews(const Matches &matches,
                                    const Mat3 &K2,
                                    const Vec2u &image_size1,
                                    const Vec2u &image_size2,
-                                   Reconstruction *recons) {
+                                   Reconstruction *recons,
+                                   ReconstructionObserver *observer) {
   assert(image1 != image2);
   bool is_good = true;
   uint num_new_points = 0;
@@ -220,25 +414,56 @@ bool InitialReconstructionTwoViews(const Matches &matches,
                                                          recons);
   VLOG(2) << num_new_points << " points reconstructed." << std::endl;
   
-  ExportToBlenderScript(*recons, "init.py");
+  NotifyReconstructionStep(observer, *recons, "init");
   
   // Performs projective bundle adjustment
   if (num_new_points > 0) {
     VLOG(2) << " -- Bundle adjustment --  " << std::endl;
     MetricBundleAdjust(matches_inliers, recons);
-    ExportToBlenderScript(*recons, "init-ba.py");
+    NotifyReconstructionStep(observer, *recons, "init-ba");
     // TODO(julien) Remove outliers RemoveOutliers() + BA again
   }
   return is_good;
 }
 
-bool IncrementalReconstructionKeyframes(const Matches &matches,
-                                        const vector<Matches::ImageID> &kframes,
-                                        const int first_keyframe_index,
-                                        const Mat3 &K,
-                                        const Vec2u &image_size,
-                                        Reconstruction *reconstruction,
-                                        int *keyframe_stopped_index) {
+namespace {
+
+// Writes the checkpoints of the keyframe stage, if there is a checkpointer.
+struct KeyframeCheckpoint {
+  ReconstructionCheckpointer *checkpointer;
+  // The keyframes, and the reconstructions of which the last one is being
+  // reconstructed.
+  const vector<Matches::ImageID> *keyframes;
+  const std::list<Reconstruction *> *reconstructions;
+
+  // The last reconstruction goes on from keyframe_index.
+  void OnKeyframe(int keyframe_index, int sequence_start) const {
+    if (!checkpointer) {
+      return;
+    }
+    ReconstructionCheckpointState state;
+    state.keyframes = *keyframes;
+    state.keyframe_index = keyframe_index;
+    state.sequence_start = sequence_start;
+    checkpointer->OnKeyframe(state, *reconstructions);
+  }
+};
+
+// IncrementalReconstructionKeyframes() from first_keyframe_index, of a
+// sequence of keyframes that started at sequence_start: the schedule of the
+// bundle adjustments only depends on sequence_start, so that a resumed
+// reconstruction makes the same adjustments.
+bool IncrementalKeyframes(const Matches &matches,
+                          const vector<Matches::ImageID> &kframes,
+                          int first_keyframe_index,
+                          int sequence_start,
+                          const Mat3 &K,
+                          const Vec2u &image_size,
+                          Reconstruction *reconstruction,
+                          int *keyframe_stopped_index,
+                          int local_bundle_size,
+                          int global_bundle_period,
+                          const KeyframeCheckpoint *checkpoint) {
   bool is_good = true;
   int keyframe_index = first_keyframe_index;
   int min_num_views_for_triangulation = 2;
@@ -275,19 +500,66 @@ bool IncrementalReconstructionKeyframes(const Matches &matches,
     
     // Performs a bundle adjustment
     if (num_new_points > 0) {
-      VLOG(2) << " -- Bundle adjustment --  " << std::endl;
-      MetricBundleAdjust(matches, reconstruction);
-      // TODO(julien) is a local BA sufficient here?
+      int num_keyframes = keyframe_index - sequence_start + 1;
+      bool global = local_bundle_size <= 0 ||
+          (global_bundle_period > 0 &&
+           num_keyframes % global_bundle_period == 0);
+      if (global) {
+        VLOG(2) << " -- Bundle adjustment --  " << std::endl;
+        MetricBundleAdjust(matches, reconstruction);
+      } else {
+        VLOG(2) << " -- Local bundle adjustment --  " << std::endl;
+        vector<CameraID> window;
+        int first = std::max(0, keyframe_index - local_bundle_size + 1);
+        for (int i = first; i <= keyframe_index; ++i) {
+          if (reconstruction->ImageHasCamera(kframes[i])) {
+            window.push_back(kframes[i]);
+          }
+        }
+        LocalMetricBundleAdjust(matches, window, reconstruction);
+      }
       // TODO(julien) Remove outliers RemoveOutliers() + BA again
     }
+    if (checkpoint) {
+      checkpoint->OnKeyframe(keyframe_index + 1, sequence_start);
+    }
   }
   return true;
 }
 
+}  // namespace
+
+bool IncrementalReconstructionKeyframes(const Matches &matches,
+                                        const vector<Matches::ImageID> &kframes,
+                                        const int first_keyframe_index,
+                                        const Mat3 &K,
+                                        const Vec2u &image_size,
+                                        Reconstruction *reconstruction,
+                                        int *keyframe_stopped_index,
+                                        int local_bundle_size,
+                                        int global_bundle_period) {
+  return IncrementalKeyframes(matches, kframes, first_keyframe_index,
+                              first_keyframe_index, K, image_size,
+                              reconstruction, keyframe_stopped_index,
+                              local_bundle_size, global_bundle_period, NULL);
+}
+
 bool ReconstructionNonKeyframes(const Matches &matches,
                                 const Mat3 &K,
                                 const Vec2u &image_size,
-                                std::list<Reconstruction *> *reconstructions) {
+                                std::list<Reconstruction *> *reconstructions,
+                                int local_bundle_size,
+                                int global_bundle_period,
+                                int num_threads,
+                                ReconstructionObserver *observer) {
+  if (num_threads > 1) {
+    return ReconstructionNonKeyframesByIntervals(matches, K, image_size,
+                                                 reconstructions,
+                                                 global_bundle_period,
+                                                 num_threads,
+                                                 local_bundle_size <= 0,
+                                                 observer);
+  }
   bool is_recons_ok = true;
   // Perform a bundle adjustment every X new cameras
   int num_new_cameras_to_proceed_ba = 10; 
@@ -299,7 +571,7 @@ bool ReconstructionNonKeyframes(const Matches &matches,
   std::list<Reconstruction *>::iterator recons_iter = reconstructions->begin();
   std::list<Reconstruction *>::iterator recons_iter_next = recons_iter;
   recons_iter_next++;
-  int cpt_image_for_ba = 0, cpt_i = 0;
+  int cpt_image_for_ba = 0, cpt_i = 0, cpt_ba = 0;
   for (; img_iter != matches.get_images().end(); ++img_iter) {
     if (cpt_image_for_ba < num_new_cameras_to_proceed_ba - 1) {
       do_bundle_adjustment = false;
@@ -324,17 +596,32 @@ bool ReconstructionNonKeyframes(const Matches &matches,
                                                  *recons_iter);   
         if (is_recons_ok) {        
           // TODO(julien) remove outliers from matches using matches_inliers.
-          // Performs a bundle adjustment
+          // The structure comes from the keyframes: the new camera is
+          // refined alone, and a full bundle adjustment is performed only
+          // periodically.
+          bool global = false;
           if (do_bundle_adjustment) {
+            cpt_ba++;
+            global = local_bundle_size <= 0 ||
+                (global_bundle_period > 0 &&
+                 cpt_ba % global_bundle_period == 0);
+          }
+          if (global) {
             VLOG(2) << " -- Bundle adjustment --  " << std::endl;
             MetricBundleAdjust(matches, *recons_iter);
-            // TODO(julien) should be removed when camera only are optimized
             // TODO(julien) Remove outliers RemoveOutliers() + BA again
+          } else {
+            VLOG(2) << " -- Motion only adjustment --  " << std::endl;
+            vector<CameraID> cameras;
+            cameras.push_back(*img_iter);
+            MetricMotionAdjust(matches, cameras, *recons_iter);
           }
           SetImageSize(**recons_iter, *img_iter, image_size);
-          std::stringstream s;
-          s << "out-noKF-" << cpt_i << ".py";
-          ExportToBlenderScript(**recons_iter, s.str());
+          if (observer) {
+            std::stringstream s;
+            s << "out-noKF-" << cpt_i;
+            observer->OnReconstructionStep(**recons_iter, s.str());
+          }
         } else {
           VLOG(1) << "[Warning] Image " << *img_iter
                   << " cannot be localized!" << std::endl;
@@ -350,68 +637,203 @@ bool ReconstructionNonKeyframes(const Matches &matches,
   return true;
 }
 
-bool EuclideanReconstructionFromVideo(
-    const Matches &matches, 
-    int image_width, 
-    int image_height,
-    double focal,
-    std::list<Reconstruction *> *reconstructions) {
-  if (matches.NumImages() < 2)
-    return false;
-  Vec2u image_size;
-  image_size << image_width, image_height;
-  double cu = image_width/2 - 0.5,  cv = image_height/2 - 0.5;
-  Mat3 K;  K << focal, 0, cu, 0, focal, cv, 0,   0,   1;
-  
-  VLOG(2) << "Selecting keyframes." << std::endl;
-  libmv::vector<Matches::ImageID> keyframes;
-  SelectKeyframesBasedOnMatchesNumber(matches, &keyframes);
-  
-  VLOG(2) << "Keyframe list: ";
-  for (int i = 0; i < keyframes.size(); ++i)
-    VLOG(2) << keyframes[i] << " ";
-  VLOG(2) << std::endl;
-  
-  if (keyframes.size() < 2) {
-    VLOG(1) << "Not enough keyframes! " << std::endl;
-    return false;
-  }
-   
+namespace {
+
+// Attaches an index of the tracks of matches, appended to track_indices, to
+// reconstruction. All the images share the calibration K, with which the index
+// precomputes the normalized coordinates of the features for the resection.
+void AttachTrackIndex(const Matches &matches,
+                      const Mat3 &K,
+                      Reconstruction *reconstruction,
+                      std::list<ReconstructedTrackIndex *> *track_indices) {
+  track_indices->push_back(new ReconstructedTrackIndex(matches,
+                                                       *reconstruction));
+  track_indices->back()->SetIntrinsics(K);
+  reconstruction->set_track_index(track_indices->back());
+}
+
+// Reconstructs the keyframes from the first two ones by resection-
+// intersection. In the case that the tracking is lost, a new reconstruction
+// is created. Each reconstruction gets an index of the tracks of matches,
+// appended to track_indices, so that the selection of the reconstructed
+// tracks of an image is a linear scan.
+// With a checkpointer, checkpoints are written along the way, and if it
+// resumed in the keyframe stage, the reconstruction goes on from there.
+void ReconstructionKeyframeSequence(
+    const Matches &matches,
+    const vector<Matches::ImageID> &keyframes,
+    const Mat3 &K,
+    const Vec2u &image_size,
+    std::list<Reconstruction *> *reconstructions,
+    std::list<ReconstructedTrackIndex *> *track_indices,
+    ReconstructionObserver *observer,
+    ReconstructionCheckpointer *checkpointer = NULL) {
+  LIBMV_SCOPED_TIMER("reconstruction.keyframes");
   bool recons_ok = true;  
   bool all_keyframes_reconstructed = false;  
   int keyframe_index = 0;
+  KeyframeCheckpoint checkpoint;
+  checkpoint.checkpointer = checkpointer;
+  checkpoint.keyframes = &keyframes;
+  checkpoint.reconstructions = reconstructions;
+  if (checkpointer && checkpointer->resumed() &&
+      checkpointer->resumed_state().stage ==
+          ReconstructionCheckpointState::KEYFRAMES) {
+    const ReconstructionCheckpointState &state =
+      checkpointer->resumed_state();
+    checkpointer->TakeResumedReconstructions(reconstructions);
+    std::list<Reconstruction *>::iterator iter = reconstructions->begin();
+    for (; iter != reconstructions->end(); ++iter) {
+      AttachTrackIndex(matches, K, *iter, track_indices);
+    }
+    keyframe_index = state.keyframe_index;
+    if (!reconstructions->empty()) {
+      all_keyframes_reconstructed =
+        IncrementalKeyframes(matches, keyframes, keyframe_index,
+                             state.sequence_start, K, image_size,
+                             reconstructions->back(), &keyframe_index,
+                             5, 10, &checkpoint);
+    }
+    if (all_keyframes_reconstructed || keyframe_index + 1 >= keyframes.size()) {
+      return;
+    }
+  }
   do {
     Reconstruction *cur_recons = new Reconstruction();
     if (keyframe_index + 1 >= keyframes.size())
       break;
+    AttachTrackIndex(matches, K, cur_recons, track_indices);
     recons_ok = InitialReconstructionTwoViews(matches,
                                               keyframes[keyframe_index],
                                               keyframes[keyframe_index + 1],
                                               K,K,
                                               image_size, image_size,
-                                              cur_recons);    
+                                              cur_recons,
+                                              observer);    
     keyframe_index++;
     if (recons_ok) {    
       keyframe_index++;
       // If an initial reconstruction has been done, we keep it and
       // compute the next poses by intersection-resection
       reconstructions->push_back(cur_recons);
+      checkpoint.OnKeyframe(keyframe_index, keyframe_index);
       all_keyframes_reconstructed = 
-       IncrementalReconstructionKeyframes(matches,
-                                          keyframes,
-                                          keyframe_index,
-                                          K, image_size,
-                                          cur_recons,
-                                          &keyframe_index);
-      std::stringstream s;
-        s << "out-" << keyframe_index << ".py";
-      ExportToBlenderScript(*cur_recons, s.str());
+       IncrementalKeyframes(matches,
+                            keyframes,
+                            keyframe_index,
+                            keyframe_index,
+                            K, image_size,
+                            cur_recons,
+                            &keyframe_index,
+                            5, 10,
+                            &checkpoint);
+      if (observer) {
+        std::stringstream s;
+        s << "out-" << keyframe_index;
+        observer->OnReconstructionStep(*cur_recons, s.str());
+      }
     } else {
       // If the initial reconstruction can be estimated between the 
       // 2 first views, we try with the second image and the third (etc.)
     }
   }  while (!all_keyframes_reconstructed && 
             (keyframe_index < keyframes.size() - 1));
+}
+
+// Detaches the track indices from the reconstructions, which may outlive
+// matches, and deletes them.
+void DeleteTrackIndices(std::list<Reconstruction *> *reconstructions,
+                        std::list<ReconstructedTrackIndex *> *track_indices) {
+  std::list<Reconstruction *>::iterator recons_iter = reconstructions->begin();
+  for (; recons_iter != reconstructions->end(); ++recons_iter) {
+    (*recons_iter)->set_track_index(NULL);
+  }
+  std::list<ReconstructedTrackIndex *>::iterator index_iter =
+    track_indices->begin();
+  for (; index_iter != track_indices->end(); ++index_iter) {
+    delete *index_iter;
+  }
+  track_indices->clear();
+}
+
+// Reconstructs each segment of keyframes independently, so that the
+// segments can be processed by several threads.
+struct SegmentReconstruction {
+  const Matches *matches;
+  const Mat3 *K;
+  const Vec2u *image_size;
+  const std::vector<vector<Matches::ImageID> > *segments;
+  std::vector<std::list<Reconstruction *> > reconstructions;
+  std::vector<std::list<ReconstructedTrackIndex *> > track_indices;
+
+  void operator()(int i) {
+    ReconstructionKeyframeSequence(*matches, (*segments)[i], *K, *image_size,
+                                   &reconstructions[i], &track_indices[i],
+                                   NULL);
+  }
+};
+
+}  // namespace
+
+bool EuclideanReconstructionFromVideo(
+    const Matches &matches, 
+    int image_width, 
+    int image_height,
+    double focal,
+    std::list<Reconstruction *> *reconstructions,
+    int num_threads,
+    ReconstructionObserver *observer,
+    ReconstructionCheckpointer *checkpointer) {
+  LIBMV_SCOPED_TIMER("reconstruction.video");
+  if (matches.NumImages() < 2)
+    return false;
+  Vec2u image_size;
+  image_size << image_width, image_height;
+  double cu = image_width/2 - 0.5,  cv = image_height/2 - 0.5;
+  Mat3 K;  K << focal, 0, cu, 0, focal, cv, 0,   0,   1;
+
+  int stage = ReconstructionCheckpointState::KEYFRAMES;
+  libmv::vector<Matches::ImageID> keyframes;
+  if (checkpointer && checkpointer->resumed()) {
+    stage = checkpointer->resumed_state().stage;
+    keyframes = checkpointer->resumed_state().keyframes;
+    if (stage == ReconstructionCheckpointState::DONE) {
+      checkpointer->TakeResumedReconstructions(reconstructions);
+      return true;
+    }
+  } else {
+    VLOG(2) << "Selecting keyframes." << std::endl;
+    SelectKeyframesBasedOnMatchesNumber(matches, &keyframes);
+  }
+  
+  VLOG(2) << "Keyframe list: ";
+  for (int i = 0; i < keyframes.size(); ++i)
+    VLOG(2) << keyframes[i] << " ";
+  VLOG(2) << std::endl;
+  
+  if (keyframes.size() < 2) {
+    VLOG(1) << "Not enough keyframes! " << std::endl;
+    return false;
+  }
+   
+  std::list<ReconstructedTrackIndex *> track_indices;
+  ReconstructionCheckpointState state;
+  state.keyframes = keyframes;
+  if (stage == ReconstructionCheckpointState::KEYFRAMES) {
+    ReconstructionKeyframeSequence(matches, keyframes, K, image_size,
+                                   reconstructions, &track_indices, observer,
+                                   checkpointer);
+    if (checkpointer) {
+      state.stage = ReconstructionCheckpointState::NON_KEYFRAMES;
+      checkpointer->Write(state, *reconstructions);
+    }
+  } else {
+    checkpointer->TakeResumedReconstructions(reconstructions);
+    std::list<Reconstruction *>::iterator iter = reconstructions->begin();
+    for (; iter != reconstructions->end(); ++iter) {
+      AttachTrackIndex(matches, K, *iter, &track_indices);
+    }
+  }
   
   // Reconstructs non-keyframes by resection
   // NOTE(julien) are we sure that matches->images is ordered? it's a std:set?
@@ -419,7 +841,220 @@ bool EuclideanReconstructionFromVideo(
   VLOG(2) << " Non-keyframe reconstruction  " << std::endl;
   ReconstructionNonKeyframes(matches,
                              K, image_size,
-                             reconstructions);
+                             reconstructions,
+                             10, 10, num_threads, observer);
+  DeleteTrackIndices(reconstructions, &track_indices);
+  if (checkpointer) {
+    state.stage = ReconstructionCheckpointState::DONE;
+    checkpointer->Write(state, *reconstructions);
+  }
+  return true;
+}
+
+bool MergeReconstructions(Reconstruction *source,
+                          Reconstruction *target,
+                          int min_num_shared_points) {
+  vector<StructureID> shared_ids;
+  std::map<StructureID, Structure *>::const_iterator structure_iter =
+    source->structures().begin();
+  for (; structure_iter != source->structures().end(); ++structure_iter) {
+    if (dynamic_cast<PointStructure *>(structure_iter->second) &&
+        dynamic_cast<PointStructure *>(
+          target->GetStructure(structure_iter->first))) {
+      shared_ids.push_back(structure_iter->first);
+    }
+  }
+  int num_shared = shared_ids.size();
+  if (num_shared < std::max(min_num_shared_points, 3)) {
+    VLOG(1) << "Not enough shared points to merge the reconstructions ("
+            << num_shared << ")." << std::endl;
+    return false;
+  }
+  Mat3X X(3, num_shared), Xp(3, num_shared);
+  for (int i = 0; i < num_shared; ++i) {
+    X.col(i) = dynamic_cast<PointStructure *>(
+      source->GetStructure(shared_ids[i]))->coords_affine();
+    Xp.col(i) = dynamic_cast<PointStructure *>(
+      target->GetStructure(shared_ids[i]))->coords_affine();
+  }
+  // The scale is the ratio of the spreads of the points around their
+  // centroids; AbsoluteOrientation() then gives the rigid motion.
+  Vec3 mean = X.rowwise().sum() / num_shared;
+  Vec3 mean_p = Xp.rowwise().sum() / num_shared;
+  double spread = (X.colwise() - mean).squaredNorm();
+  double spread_p = (Xp.colwise() - mean_p).squaredNorm();
+  if (spread <= 0 || spread_p <= 0) {
+    VLOG(1) << "The shared points are all at the same location." << std::endl;
+    return false;
+  }
+  double scale = sqrt(spread_p / spread);
+  Mat3X X_scaled = scale * X;
+  Mat3 R;
+  Vec3 t;
+  euclidean_resection::AbsoluteOrientation(X_scaled, Xp, &R, &t);
+  VLOG(1) << "Merging " << source->GetNumberCameras() << " cameras with "
+          << num_shared << " shared points, scale = " << scale << std::endl
+          << "R = " << R << std::endl << "t = " << t.transpose() << std::endl;
+
+  // With Xp = s R X + t, the camera x = K (Rc X + tc) becomes
+  // x = K (Rc R' Xp + s tc - Rc R' t), up to the scale s.
+  std::map<CameraID, Camera *>::iterator camera_iter =
+    source->cameras().begin();
+  for (; camera_iter != source->cameras().end(); ++camera_iter) {
+    PinholeCamera *camera = dynamic_cast<PinholeCamera *>(camera_iter->second);
+    if (!camera || target->ImageHasCamera(camera_iter->first)) {
+      delete camera_iter->second;
+      continue;
+    }
+    Mat3 Rc = camera->orientation_matrix() * R.transpose();
+    Vec3 tc = scale * camera->position() - Rc * t;
+    camera->SetExtrinsicParameters(Rc, tc);
+    target->InsertCamera(camera_iter->first, camera);
+  }
+  std::map<StructureID, Structure *>::iterator point_iter =
+    source->structures().begin();
+  for (; point_iter != source->structures().end(); ++point_iter) {
+    PointStructure *point = dynamic_cast<PointStructure *>(point_iter->second);
+    if (!point || target->TrackHasStructure(point_iter->first)) {
+      delete point_iter->second;
+      continue;
+    }
+    point->set_coords_affine(scale * R * point->coords_affine() + t);
+    target->InsertTrack(point_iter->first, point);
+  }
+  source->cameras().clear();
+  source->structures().clear();
+  return true;
+}
+
+bool EuclideanReconstructionFromVideoBySegments(
+    const Matches &matches, 
+    int image_width, 
+    int image_height,
+    double focal,
+    std::list<Reconstruction *> *reconstructions,
+    int num_keyframes_per_segment,
+    int num_overlapping_keyframes,
+    int num_threads,
+    ReconstructionObserver *observer) {
+  CHECK_GE(num_overlapping_keyframes, 1);
+  CHECK_GT(num_keyframes_per_segment, num_overlapping_keyframes);
+  if (matches.NumImages() < 2)
+    return false;
+  Vec2u image_size;
+  image_size << image_width, image_height;
+  double cu = image_width/2 - 0.5,  cv = image_height/2 - 0.5;
+  Mat3 K;  K << focal, 0, cu, 0, focal, cv, 0,   0,   1;
+
+  libmv::vector<Matches::ImageID> keyframes;
+  SelectKeyframesBasedOnMatchesNumber(matches, &keyframes);
+  if (keyframes.size() < 2) {
+    VLOG(1) << "Not enough keyframes! " << std::endl;
+    return false;
+  }
+
+  // Consecutive segments share num_overlapping_keyframes keyframes.
+  std::vector<vector<Matches::ImageID> > segments;
+  int step = num_keyframes_per_segment - num_overlapping_keyframes;
+  for (int first = 0; ; first += step) {
+    int last = std::min(first + num_keyframes_per_segment,
+                        int(keyframes.size()));
+    vector<Matches::ImageID> segment;
+    for (int i = first; i < last; ++i) {
+      segment.push_back(keyframes[i]);
+    }
+    segments.push_back(segment);
+    if (last == keyframes.size()) {
+      break;
+    }
+  }
+  VLOG(2) << " -- Reconstruction of " << segments.size()
+          << " segments --  " << std::endl;
+  SegmentReconstruction segment_reconstruction;
+  segment_reconstruction.matches = &matches;
+  segment_reconstruction.K = &K;
+  segment_reconstruction.image_size = &image_size;
+  segment_reconstruction.segments = &segments;
+  segment_reconstruction.reconstructions.resize(segments.size());
+  segment_reconstruction.track_indices.resize(segments.size());
+  ParallelForDynamic(0, segments.size(), num_threads,
+                     &segment_reconstruction);
+
+  // Each reconstruction is merged into the previous one when they share
+  // enough points, otherwise it starts a new one.
+  std::list<ReconstructedTrackIndex *> track_indices;
+  Reconstruction *merged = NULL;
+  for (int i = 0; i < segments.size(); ++i) {
+    track_indices.splice(track_indices.end(),
+                         segment_reconstruction.track_indices[i]);
+    std::list<Reconstruction *> &segment_reconstructions =
+      segment_reconstruction.reconstructions[i];
+    std::list<Reconstruction *>::iterator recons_iter =
+      segment_reconstructions.begin();
+    for (; recons_iter != segment_reconstructions.end(); ++recons_iter) {
+      if (merged && MergeReconstructions(*recons_iter, merged)) {
+        delete *recons_iter;
+        continue;
+      }
+      merged = *recons_iter;
+      reconstructions->push_back(merged);
+    }
+    if (merged && observer) {
+      std::stringstream s;
+      s << "out-segment-" << i;
+      observer->OnReconstructionStep(*merged, s.str());
+    }
+  }
+
+  std::list<Reconstruction *>::iterator recons_iter = reconstructions->begin();
+  for (; recons_iter != reconstructions->end(); ++recons_iter) {
+    VLOG(2) << " -- Bundle adjustment --  " << std::endl;
+    MetricBundleAdjust(matches, *recons_iter);
+  }
+  VLOG(2) << " Non-keyframe reconstruction  " << std::endl;
+  ReconstructionNonKeyframes(matches,
+                             K, image_size,
+                             reconstructions,
+                             10, 10, num_threads, observer);
+  DeleteTrackIndices(reconstructions, &track_indices);
+  return true;
+}
+
+bool EuclideanReconstructionFromImageSet(
+    const Matches &matches, 
+    const vector<std::pair<size_t, size_t> > &image_sizes,
+    double focal,
+    std::list<Reconstruction *> *reconstructions,
+    int num_threads) {
+  LIBMV_SCOPED_TIMER("reconstruction.image_set");
+  if (matches.NumImages() < 2)
+    return false;
+  assert(image_sizes.size() == matches.NumImages());
+  vector<Mat3> Ks(image_sizes.size());
+  std::map<Matches::ImageID, Vec2u> sizes;
+  std::set<Matches::ImageID>::const_iterator image_iter =
+    matches.get_images().begin();
+  for (int i = 0; i < image_sizes.size(); ++i, ++image_iter) {
+    double cu = image_sizes[i].first/2 - 0.5,
+           cv = image_sizes[i].second/2 - 0.5;
+    Ks[i] << focal, 0, cu, 0, focal, cv, 0,   0,   1;
+    sizes[*image_iter] << image_sizes[i].first, image_sizes[i].second;
+  }
+  std::list<Reconstruction *> global_reconstructions;
+  if (!GlobalEuclideanReconstruction(matches, Ks, &global_reconstructions,
+                                     30, 0.1, num_threads)) {
+    return false;
+  }
+  std::list<Reconstruction *>::iterator recons_iter =
+    global_reconstructions.begin();
+  for (; recons_iter != global_reconstructions.end(); ++recons_iter) {
+    std::map<Matches::ImageID, Vec2u>::const_iterator size_iter =
+      sizes.begin();
+    for (; size_iter != sizes.end(); ++size_iter) {
+      SetImageSize(**recons_iter, size_iter->first, size_iter->second);
+    }
+    reconstructions->push_back(*recons_iter);
+  }
   return true;
 }
 } // namespace libmv
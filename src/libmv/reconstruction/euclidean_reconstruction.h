@@ -22,9 +22,12 @@
 #define LIBMV_RECONSTRUCTION_EUCLIDEAN_RECONSTRUCTION_H_
 
 #include "libmv/reconstruction/reconstruction.h"
+#include "libmv/reconstruction/reconstruction_observer.h"
 
 namespace libmv {
 
+class ReconstructionCheckpointer;
+
 // Estimates the pose of the camera using the already reconstructed points.
 // The method:
 //  - selects the tracks that have an already reconstructed structure
@@ -54,6 +57,7 @@ bool CalibratedCameraResection(const Matches &matches,
 //  - reconstructs only the inliers matches (point triangulation)
 //  - performs a metric bundle adjusment
 //    TODO(julien) remove outliers from matches or output matches_inliers.
+// The observer, if any, is notified of the "init" and "init-ba" steps.
 // Returns true if the initial reconstruction has succeed
 // Returns false if 
 //  - the number of common matches is less than 7
@@ -65,15 +69,19 @@ bool InitialReconstructionTwoViews(const Matches &matches,
                                    const Mat3 &K2,
                                    const Vec2u &image_size1,
                                    const Vec2u &image_size2,
-                                   Reconstruction *recons);
+                                   Reconstruction *recons,
+                                   ReconstructionObserver *observer = NULL);
                                
 // Estimates the pose of the keyframes using the already reconstructed points.
 // For every keyframes (starting the first_keyframe_index th):
 //  - the keyframe is localized (by resection)
 //  - if the resection has not failed, the inliers tracks are reconstructed
 //    by point triangulation
-//  - if new points are created, a global bundle adjustment is performed
-//    TODO(julien) a local bundle adjustment would be sufficient?
+//  - if new points are created, a local bundle adjustment of the last
+//    local_bundle_size keyframes is performed (the older cameras are kept
+//    fixed), and a global bundle adjustment every global_bundle_period
+//    keyframes. With local_bundle_size = 0 the bundle adjustment is always
+//    global.
 // The method stops when one keyframe cannot be localized (tracking lost),
 // keyframe_stopped_index is the index of this keyframe.
 // Returns true if all keyframes have been localized
@@ -84,33 +92,56 @@ bool IncrementalReconstructionKeyframes(const Matches &matches,
                                         const Mat3 &K,
                                         const Vec2u &image_size,
                                         Reconstruction *reconstruction,
-                                        int *keyframe_stopped_index);
+                                        int *keyframe_stopped_index,
+                                        int local_bundle_size = 5,
+                                        int global_bundle_period = 10);
                                
 // Estimates the pose of non already localized frames using the already 
 // reconstructed points by resection.
-// It performs also a bundle adjustment when X=10 new cameras are localized.
-// TODO(julien) a local bundle adjustment would be sufficient?
+// The points are kept fixed and each localized camera is refined alone by
+// MetricMotionAdjust(), except that when X=10 new cameras are localized, a
+// global bundle adjustment is performed every global_bundle_period times (or
+// always if local_bundle_size = 0).
 // The method automatically detect the reconstruction the frame may belongs.
+// With num_threads > 1, all the frames between two keyframes are instead
+// resected in parallel against the structure as it was before the interval,
+// then their cameras are added and refined once per interval: a motion only
+// adjustment of the new cameras, or a global bundle adjustment every
+// global_bundle_period intervals (always if local_bundle_size = 0).
 // NOTE: this method works only if the frame in the Matches class are ordered. 
 //       If it is not the case, it will fail.
+// The observer, if any, is notified after each resection ("out-noKF-N"), or
+// after each interval in the parallel mode ("out-noKF-interval-N").
 // Returns true.
 bool ReconstructionNonKeyframes(const Matches &matches,
                                 const Mat3 &K,
                                 const Vec2u &image_size,
-                                std::list<Reconstruction *> *reconstructions);
+                                std::list<Reconstruction *> *reconstructions,
+                                int local_bundle_size = 10,
+                                int global_bundle_period = 10,
+                                int num_threads = 1,
+                                ReconstructionObserver *observer = NULL);
 
 // Computes the trajectory of a camera using matches as input.
 //  - First keyframes are detected according a minimum number of shared tracks
 //  - Next the first two keyframes are used to estimate an initial structure
 //  - Then every other keyframe are reconstructed based on an euclidean resection
 //    algorithm with the previously recontructed structures and new structures
-//    are estimated (points triangulation). A bundle adjustment is performed on
-//    all the reconstruction each time a keyframe is localized.
-//    TODO(julien) a local bundle adjustment would be sufficient?
+//    are estimated (points triangulation). A local bundle adjustment is
+//    performed each time a keyframe is localized, and a global one
+//    periodically.
 //    TODO(julien) +a global bundle adjusment on all data at the end?
 //  - In a final step, non-keyframes are localized using the resection method.
-//    A bundle adjusment is periodically performed on all the data.
+//    Their poses are refined alone (motion only adjustment), and a global
+//    bundle adjustment is performed periodically on all the data.
 // In the case that the tracking is lost, a new reconstruction is created.
+// The non-keyframes are resected with num_threads threads (see
+// ReconstructionNonKeyframes()). The observer, if any, receives the
+// intermediate reconstructions; with no observer no snapshot is exported.
+// The checkpointer, if any, periodically saves the keyframe reconstruction,
+// and the results of the keyframe and non-keyframe stages. If it resumed
+// from a checkpoint (see ReconstructionCheckpointer::Resume()), the
+// reconstruction goes on from there, with the keyframes of the checkpoint.
 // TODO(julien) Add the calibration matrix K as input?
 // TODO(julien) remove outliers from matches or output inliers matches.
 bool EuclideanReconstructionFromVideo(
@@ -118,14 +149,55 @@ bool EuclideanReconstructionFromVideo(
     int image_width, 
     int image_height,
     double focal,
-    std::list<Reconstruction *> *reconstructions);
+    std::list<Reconstruction *> *reconstructions,
+    int num_threads = 1,
+    ReconstructionObserver *observer = NULL,
+    ReconstructionCheckpointer *checkpointer = NULL);
+
+// Merges source into target, using the points of the tracks reconstructed in
+// both to estimate the similarity between their coordinate frames (the scale
+// from the spreads of the points, then R and t by the absolute orientation).
+// The cameras and points of source that target does not have are moved to
+// target in its frame, the others are deleted, and source is left empty.
+// Returns false, and leaves both reconstructions unchanged, if they share
+// less than min_num_shared_points (at least 3) points.
+bool MergeReconstructions(Reconstruction *source,
+                          Reconstruction *target,
+                          int min_num_shared_points = 3);
+
+// Same as EuclideanReconstructionFromVideo(), but the keyframes are split in
+// segments of num_keyframes_per_segment keyframes, the consecutive segments
+// sharing num_overlapping_keyframes keyframes. The segments are reconstructed
+// independently on num_threads threads, then each is merged into the
+// previous one with MergeReconstructions() when they share enough points.
+// A bundle adjustment of every merged reconstruction is performed before
+// the non-keyframes are localized.
+// The observer, if any, is notified after the merge of each segment
+// ("out-segment-N") and by the non-keyframe localization, but not during
+// the reconstruction of the segments.
+bool EuclideanReconstructionFromVideoBySegments(
+    const Matches &matches, 
+    int image_width, 
+    int image_height,
+    double focal,
+    std::list<Reconstruction *> *reconstructions,
+    int num_keyframes_per_segment = 10,
+    int num_overlapping_keyframes = 3,
+    int num_threads = 1,
+    ReconstructionObserver *observer = NULL);
 
-// Computes the poses of all unordered images.
-// TODO(julien) implement me.
+// Computes the poses of all unordered images at once with
+// GlobalEuclideanReconstruction(), instead of adding the images one by one.
+// image_sizes[i] is the (width, height) of the i-th image of matches in
+// increasing id order; every image shares the same focal, with the principal
+// point at the center of the image. One reconstruction is added for each
+// connected group of images.
 bool EuclideanReconstructionFromImageSet(
     const Matches &matches, 
     const vector<std::pair<size_t, size_t> > &image_sizes,
-    std::list<Reconstruction *> *reconstructions);
+    double focal,
+    std::list<Reconstruction *> *reconstructions,
+    int num_threads = 1);
 }  // namespace libmv
 
 #endif  // LIBMV_RECONSTRUCTION_EUCLIDEAN_RECONSTRUCTION_H_
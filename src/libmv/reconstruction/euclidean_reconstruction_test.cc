@@ -177,5 +177,296 @@ TEST(CalibratedReconstruction, TestSynthetic6FullViews) {
     delete *features_iter;
   list_features.clear();
 }
+
+TEST(LocalMetricBundleAdjust, OnlyTheWindowMoves) {
+  int nviews = 6;
+  int npoints = 50;
+  NViewDataSet d = NRealisticCamerasFull(nviews, npoints);
+  Matches matches;
+  std::list<Feature *> list_features;
+  GenerateMatchesFromNViewDataSet(d, 0, &matches, &list_features);
+
+  // The two last cameras and the structure are perturbed.
+  Reconstruction reconstruction;
+  for (int i = 0; i < nviews; ++i) {
+    Mat3 R = d.R[i];
+    Vec3 t = d.t[i];
+    if (i >= nviews - 2) {
+      R *= RotationAroundX(0.01) * RotationAroundY(-0.02);
+      t += Vec3(0.05, -0.05, 0.02);
+    }
+    reconstruction.InsertCamera(i, new PinholeCamera(d.K[i], R, t));
+  }
+  for (int j = 0; j < npoints; ++j) {
+    Vec3 X = d.X.col(j) + Vec3::Random() * 0.05;
+    reconstruction.InsertTrack(j, new PointStructure(X));
+  }
+
+  vector<CameraID> window;
+  window.push_back(nviews - 2);
+  window.push_back(nviews - 1);
+  // The features are stored in single precision.
+  double rms = LocalMetricBundleAdjust(matches, window, &reconstruction);
+  EXPECT_LT(rms, 1e-4);
+
+  PinholeCamera *camera = NULL;
+  for (int i = 0; i < nviews - 2; ++i) {
+    camera = dynamic_cast<PinholeCamera *>(reconstruction.GetCamera(i));
+    EXPECT_MATRIX_NEAR(d.R[i], camera->orientation_matrix(), 1e-12);
+  }
+  for (int i = nviews - 2; i < nviews; ++i) {
+    camera = dynamic_cast<PinholeCamera *>(reconstruction.GetCamera(i));
+    EXPECT_MATRIX_NEAR(d.R[i], camera->orientation_matrix(), 1e-4);
+  }
+  EXPECT_NEAR(rms, EstimateRootMeanSquareError(matches, &reconstruction),
+              1e-9);
+
+  reconstruction.ClearCamerasMap();
+  reconstruction.ClearStructuresMap();
+  std::list<Feature *>::iterator features_iter = list_features.begin();
+  for (; features_iter != list_features.end(); ++features_iter)
+    delete *features_iter;
+  list_features.clear();
+}
+
+TEST(MetricMotionAdjust, OnlyTheCamerasMove) {
+  int nviews = 6;
+  int npoints = 50;
+  NViewDataSet d = NRealisticCamerasFull(nviews, npoints);
+  Matches matches;
+  std::list<Feature *> list_features;
+  GenerateMatchesFromNViewDataSet(d, 0, &matches, &list_features);
+
+  // The two last cameras are perturbed, the structure is exact.
+  Reconstruction reconstruction;
+  for (int i = 0; i < nviews; ++i) {
+    Mat3 R = d.R[i];
+    Vec3 t = d.t[i];
+    if (i >= nviews - 2) {
+      R *= RotationAroundX(0.01) * RotationAroundY(-0.02);
+      t += Vec3(0.05, -0.05, 0.02);
+    }
+    reconstruction.InsertCamera(i, new PinholeCamera(d.K[i], R, t));
+  }
+  for (int j = 0; j < npoints; ++j) {
+    reconstruction.InsertTrack(j, new PointStructure(Vec3(d.X.col(j))));
+  }
+
+  vector<CameraID> cameras;
+  cameras.push_back(nviews - 2);
+  cameras.push_back(nviews - 1);
+  double rms = MetricMotionAdjust(matches, cameras, &reconstruction, 2);
+  // The features are stored in single precision.
+  EXPECT_LT(rms, 1e-4);
+
+  PinholeCamera *camera = NULL;
+  for (int i = 0; i < nviews; ++i) {
+    camera = dynamic_cast<PinholeCamera *>(reconstruction.GetCamera(i));
+    EXPECT_MATRIX_NEAR(d.R[i], camera->orientation_matrix(), 1e-4);
+  }
+  for (int j = 0; j < npoints; ++j) {
+    PointStructure *point = dynamic_cast<PointStructure *>(
+        reconstruction.GetStructure(j));
+    EXPECT_EQ(Vec3(d.X.col(j)), point->coords_affine());
+  }
+  EXPECT_LT(EstimateRootMeanSquareError(matches, &reconstruction), 1e-4);
+
+  reconstruction.ClearCamerasMap();
+  reconstruction.ClearStructuresMap();
+  std::list<Feature *>::iterator features_iter = list_features.begin();
+  for (; features_iter != list_features.end(); ++features_iter)
+    delete *features_iter;
+  list_features.clear();
+}
+
+TEST(MetricStructureAdjust, OnlyThePointsMove) {
+  int nviews = 4;
+  int npoints = 50;
+  NViewDataSet d = NRealisticCamerasFull(nviews, npoints);
+  Matches matches;
+  std::list<Feature *> list_features;
+  GenerateMatchesFromNViewDataSet(d, 0, &matches, &list_features);
+
+  // The cameras are exact, the structure is perturbed.
+  Reconstruction reconstruction;
+  for (int i = 0; i < nviews; ++i) {
+    reconstruction.InsertCamera(i, new PinholeCamera(d.K[i], d.R[i], d.t[i]));
+  }
+  vector<StructureID> structures;
+  for (int j = 0; j < npoints; ++j) {
+    Vec3 X = d.X.col(j) + Vec3::Random() * 0.05;
+    reconstruction.InsertTrack(j, new PointStructure(X));
+    structures.push_back(j);
+  }
+  double rms = MetricStructureAdjust(matches, structures, &reconstruction, 2);
+  EXPECT_LT(rms, 1e-4);
+
+  for (int i = 0; i < nviews; ++i) {
+    PinholeCamera *camera = dynamic_cast<PinholeCamera *>(
+        reconstruction.GetCamera(i));
+    EXPECT_EQ(d.R[i], camera->orientation_matrix());
+  }
+  for (int j = 0; j < npoints; ++j) {
+    PointStructure *point = dynamic_cast<PointStructure *>(
+        reconstruction.GetStructure(j));
+    EXPECT_MATRIX_NEAR(d.X.col(j), point->coords_affine(), 1e-4);
+  }
+
+  reconstruction.ClearCamerasMap();
+  reconstruction.ClearStructuresMap();
+  std::list<Feature *>::iterator features_iter = list_features.begin();
+  for (; features_iter != list_features.end(); ++features_iter)
+    delete *features_iter;
+  list_features.clear();
+}
+
+TEST(ReconstructionNonKeyframes, ParallelIntervalResection) {
+  int nviews = 6;
+  int npoints = 60;
+  NViewDataSet d = NRealisticCamerasFull(nviews, npoints);
+  Matches matches;
+  std::list<Feature *> list_features;
+  GenerateMatchesFromNViewDataSet(d, 0, &matches, &list_features);
+
+  // Only the first and last views are keyframes, the structure is known.
+  Reconstruction *reconstruction = new Reconstruction();
+  reconstruction->InsertCamera(0, new PinholeCamera(d.K[0], d.R[0], d.t[0]));
+  reconstruction->InsertCamera(nviews - 1,
+                               new PinholeCamera(d.K[nviews - 1],
+                                                 d.R[nviews - 1],
+                                                 d.t[nviews - 1]));
+  for (int j = 0; j < npoints; ++j) {
+    reconstruction->InsertTrack(j, new PointStructure(Vec3(d.X.col(j))));
+  }
+  std::list<Reconstruction *> reconstructions;
+  reconstructions.push_back(reconstruction);
+  Vec2u image_size;
+  image_size << d.K[0](0, 2) * 2, d.K[0](1, 2) * 2;
+
+  EXPECT_TRUE(ReconstructionNonKeyframes(matches, d.K[0], image_size,
+                                         &reconstructions, 10, 10, 3));
+  EXPECT_EQ(nviews, reconstruction->GetNumberCameras());
+  PinholeCamera *camera = NULL;
+  for (int i = 1; i < nviews - 1; ++i) {
+    camera = dynamic_cast<PinholeCamera *>(reconstruction->GetCamera(i));
+    ASSERT_TRUE(camera != NULL);
+    EXPECT_MATRIX_NEAR(d.R[i], camera->orientation_matrix(), 1e-4);
+    EXPECT_MATRIX_NEAR(d.t[i], camera->position(), 1e-3);
+  }
+
+  reconstruction->ClearCamerasMap();
+  reconstruction->ClearStructuresMap();
+  delete reconstruction;
+  std::list<Feature *>::iterator features_iter = list_features.begin();
+  for (; features_iter != list_features.end(); ++features_iter)
+    delete *features_iter;
+  list_features.clear();
+}
+
+TEST(MergeReconstructions, RecoversTheSimilarity) {
+  int nviews = 6;
+  int npoints = 60;
+  NViewDataSet d = NRealisticCamerasFull(nviews, npoints);
+
+  // The target has the views 0 to 3 and the points 0 to 39 in the true frame,
+  // the source has the views 2 to 5 and the points 20 to 59 in the frame
+  // Xs = s * R * X + t.
+  double s = 0.3;
+  Mat3 R = RotationAroundZ(0.4) * RotationAroundX(-0.2);
+  Vec3 t(1, -2, 0.5);
+  Reconstruction target, source;
+  for (int i = 0; i < nviews; ++i) {
+    if (i < 4) {
+      target.InsertCamera(i, new PinholeCamera(d.K[i], d.R[i], d.t[i]));
+    }
+    if (i >= 2) {
+      Mat3 Rs = d.R[i] * R.transpose();
+      Vec3 ts = s * d.t[i] - Rs * t;
+      source.InsertCamera(i, new PinholeCamera(d.K[i], Rs, ts));
+    }
+  }
+  for (int j = 0; j < npoints; ++j) {
+    Vec3 X = d.X.col(j);
+    if (j < 40) {
+      target.InsertTrack(j, new PointStructure(X));
+    }
+    if (j >= 20) {
+      source.InsertTrack(j, new PointStructure(Vec3(s * R * X + t)));
+    }
+  }
+
+  EXPECT_FALSE(MergeReconstructions(&source, &target, 21));
+  EXPECT_EQ(4, source.GetNumberCameras());
+  ASSERT_TRUE(MergeReconstructions(&source, &target));
+  EXPECT_EQ(0, source.GetNumberCameras());
+  EXPECT_EQ(0, source.GetNumberStructures());
+  EXPECT_EQ(nviews, target.GetNumberCameras());
+  EXPECT_EQ(npoints, target.GetNumberStructures());
+  for (int i = 0; i < nviews; ++i) {
+    PinholeCamera *camera =
+      dynamic_cast<PinholeCamera *>(target.GetCamera(i));
+    ASSERT_TRUE(camera != NULL);
+    EXPECT_MATRIX_NEAR(d.R[i], camera->orientation_matrix(), 1e-8);
+    EXPECT_MATRIX_NEAR(d.t[i], camera->position(), 1e-8);
+  }
+  for (int j = 0; j < npoints; ++j) {
+    PointStructure *point =
+      dynamic_cast<PointStructure *>(target.GetStructure(j));
+    ASSERT_TRUE(point != NULL);
+    EXPECT_MATRIX_NEAR(Vec3(d.X.col(j)), point->coords_affine(), 1e-8);
+  }
+  target.ClearCamerasMap();
+  target.ClearStructuresMap();
+}
+
+TEST(PointStructureTriangulation, ParallelPassesAreDeterministic) {
+  int nviews = 5;
+  int npoints = 60;
+  NViewDataSet d = NRealisticCamerasFull(nviews, npoints);
+  Matches matches;
+  std::list<Feature *> list_features;
+  GenerateMatchesFromNViewDataSet(d, 0, &matches, &list_features);
+
+  Reconstruction reconstructions[2];
+  const int num_threads[2] = {1, 4};
+  uint num_triangulated[2][3];
+  for (int r = 0; r < 2; ++r) {
+    for (int i = 0; i < nviews; ++i) {
+      reconstructions[r].InsertCamera(i, new PinholeCamera(d.K[i], d.R[i],
+                                                           d.t[i]));
+    }
+    vector<StructureID> new_structures_ids;
+    num_triangulated[r][0] = PointStructureTriangulationUncalibrated(
+        matches, 0, 2, &reconstructions[r], &new_structures_ids,
+        num_threads[r]);
+    EXPECT_EQ(num_triangulated[r][0], new_structures_ids.size());
+    num_triangulated[r][1] = PointStructureRetriangulationCalibrated(
+        matches, 1, &reconstructions[r], num_threads[r]);
+    num_triangulated[r][2] = PointStructureRetriangulationUncalibrated(
+        matches, 2, &reconstructions[r], num_threads[r]);
+  }
+  EXPECT_GT(num_triangulated[0][0], 0);
+  for (int pass = 0; pass < 3; ++pass) {
+    EXPECT_EQ(num_triangulated[0][pass], num_triangulated[1][pass]);
+  }
+  EXPECT_EQ(reconstructions[0].GetNumberStructures(),
+            reconstructions[1].GetNumberStructures());
+  for (int j = 0; j < npoints; ++j) {
+    PointStructure *serial = dynamic_cast<PointStructure *>(
+        reconstructions[0].GetStructure(j));
+    PointStructure *parallel = dynamic_cast<PointStructure *>(
+        reconstructions[1].GetStructure(j));
+    ASSERT_EQ(serial == NULL, parallel == NULL);
+    if (serial)
+      EXPECT_MATRIX_NEAR(serial->coords(), parallel->coords(), 0);
+  }
+  for (int r = 0; r < 2; ++r) {
+    reconstructions[r].ClearCamerasMap();
+    reconstructions[r].ClearStructuresMap();
+  }
+  std::list<Feature *>::iterator features_iter = list_features.begin();
+  for (; features_iter != list_features.end(); ++features_iter)
+    delete *features_iter;
+}
 }
 }  // namespace libmv
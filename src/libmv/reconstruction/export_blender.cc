@@ -19,14 +19,17 @@
 // IN THE SOFTWARE.
 
 #include <stdio.h>
+#include <string.h>
 #include <locale.h>
+#include <algorithm>
 
 #include "libmv/reconstruction/export_blender.h"
 
 namespace libmv {
+namespace {
 
-void ExportToBlenderScript(const Reconstruction &reconstruct, 
-                           std::string out_file_name) {
+// Opens the script and writes its header.
+FILE *OpenBlenderScript(const std::string &out_file_name) {
   // Avoid to have comas instead of dots (foreign lang.) 
   setlocale(LC_ALL, "C");
 
@@ -44,65 +47,71 @@ void ExportToBlenderScript(const Reconstruction &reconstruct,
   //////////////////////////////////////////////////////////////////////////
   // Cameras.
   fprintf(fid, "# Cameras\n");
-  PinholeCamera *pcamera = NULL;
-  uint i = 0;
-  Mat3 K, R; Vec3 t;
-  std::map<CameraID, Camera *>::const_iterator camera_iter =  
-    reconstruct.cameras().begin();
-  for (; camera_iter != reconstruct.cameras().end(); ++camera_iter) {
-    pcamera = dynamic_cast<PinholeCamera *>(camera_iter->second);
-    // TODO(julien) how to export generic cameras ? 
-    if (pcamera) {
-      K = pcamera->intrinsic_matrix();
-      R = pcamera->orientation_matrix();
-      t = pcamera->position();
-      // Set up the camera
-      fprintf(fid, "c%04d = Camera.New('persp')\n", i);
-      // TODO(pau) we may want to take K(0,0)/K(1,1) and push that into the
-      // render aspect ratio settings.
-      double f = K(0,0);
-      double width = pcamera->image_width();
-      // WARNING: MAGIC CONSTANT from blender source
-      // Look for 32.0 in 'source/blender/render/intern/source/initrender.c'
-      double lens = f / width * 32.0;
-      fprintf(fid, "c%04d.lens = %g\n", i, lens);
-      fprintf(fid, "c%04d.setDrawSize(0.05)\n", i);
-      fprintf(fid, "o%04d = Object.New('Camera')\n", i);
-      fprintf(fid, "o%04d.name = 'libmv_cam%04d'\n", i, camera_iter->first);
-
-      // Camera world matrix, which is the inverse transpose of the typical
-      // 'projection' matrix as generally thought of by vision researchers.
-      // Usually it is x = K[R|t]X; but here it is the inverse of R|t stacked
-      // on [0,0,0,1], but then in fortran-order. So that is where the
-      // weirdness comes from.
-      fprintf(fid, "o%04d.setMatrix(Mathutils.Matrix(",i);
-      for (int j = 0; j < 3; ++j) {
-        fprintf(fid, "[");
-        for (int k = 0; k < 3; ++k) {
-          // Opengl's camera faces down the NEGATIVE z axis so we have to
-          // do a 180 degree X axis rotation. The math works out so that
-          // the following conditional nicely implements that.
-          if (j == 2 || j == 1)
-            fprintf(fid, "%g,", -R(j,k)); // transposed + opposite!
-          else
-            fprintf(fid, "%g,", R(j,k)); // transposed!
-        }
-        fprintf(fid, "0.0],");
-      }
-      libmv::Vec3 optical_center = -R.transpose() * t;
-      fprintf(fid, "[");
-      for (int j = 0; j < 3; ++j)
-        fprintf(fid, "%g,", optical_center(j));
-      fprintf(fid, "1.0]))\n");
-
-      // Link the scene and the camera together
-      fprintf(fid, "o%04d.link(c%04d)\n\n", i, i);
-      fprintf(fid, "cur.link(o%04d)\n\n", i);
-      i++;
+  return fid;
+}
+
+// The focal length of a Blender camera.
+double BlenderCameraLens(const Mat3 &K, double width) {
+  // TODO(pau) we may want to take K(0,0)/K(1,1) and push that into the
+  // render aspect ratio settings.
+  double f = K(0,0);
+  // WARNING: MAGIC CONSTANT from blender source
+  // Look for 32.0 in 'source/blender/render/intern/source/initrender.c'
+  return f / width * 32.0;
+}
+
+// Camera world matrix, which is the inverse transpose of the typical
+// 'projection' matrix as generally thought of by vision researchers.
+// Usually it is x = K[R|t]X; but here it is the inverse of R|t stacked
+// on [0,0,0,1], but then in fortran-order. So that is where the
+// weirdness comes from. The 16 entries are stored by rows.
+void BlenderCameraMatrix(const Mat3 &R, const Vec3 &t, double matrix[16]) {
+  for (int j = 0; j < 3; ++j) {
+    for (int k = 0; k < 3; ++k) {
+      // Opengl's camera faces down the NEGATIVE z axis so we have to
+      // do a 180 degree X axis rotation. The math works out so that
+      // the following conditional nicely implements that.
+      if (j == 2 || j == 1)
+        matrix[4 * j + k] = -R(j,k); // transposed + opposite!
+      else
+        matrix[4 * j + k] = R(j,k); // transposed!
+    }
+    matrix[4 * j + 3] = 0.0;
+  }
+  libmv::Vec3 optical_center = -R.transpose() * t;
+  for (int j = 0; j < 3; ++j)
+    matrix[12 + j] = optical_center(j);
+  matrix[15] = 1.0;
+}
+
+// Writes the i-th exported camera, of the given id.
+void WriteBlenderCamera(FILE *fid, uint i, CameraID id,
+                        const Mat3 &K, const Mat3 &R, const Vec3 &t,
+                        double width) {
+  // Set up the camera
+  fprintf(fid, "c%04d = Camera.New('persp')\n", i);
+  fprintf(fid, "c%04d.lens = %g\n", i, BlenderCameraLens(K, width));
+  fprintf(fid, "c%04d.setDrawSize(0.05)\n", i);
+  fprintf(fid, "o%04d = Object.New('Camera')\n", i);
+  fprintf(fid, "o%04d.name = 'libmv_cam%04d'\n", i, id);
+
+  double matrix[16];
+  BlenderCameraMatrix(R, t, matrix);
+  fprintf(fid, "o%04d.setMatrix(Mathutils.Matrix(",i);
+  for (int j = 0; j < 4; ++j) {
+    fprintf(fid, "[");
+    for (int k = 0; k < 3; ++k) {
+      fprintf(fid, "%g,", matrix[4 * j + k]);
     }
+    fprintf(fid, j < 3 ? "0.0]," : "1.0]))\n");
   }
-  uint num_cam_exported = i;
 
+  // Link the scene and the camera together
+  fprintf(fid, "o%04d.link(c%04d)\n\n", i, i);
+  fprintf(fid, "cur.link(o%04d)\n\n", i);
+}
+
+void BeginBlenderPointCloud(FILE *fid) {
   //////////////////////////////////////////////////////////////////////////
   // Point Cloud.
   fprintf(fid, "# Point cloud\n");
@@ -110,18 +119,14 @@ void ExportToBlenderScript(const Reconstruction &reconstruct,
   fprintf(fid, "ob.setLocation(0.0,0.0,0.0)\n");
   fprintf(fid, "mesh=ob.getData()\n");
   fprintf(fid, "cur.link(ob)\n");
-  std::map<StructureID, Structure *>::const_iterator track_iter =
-    reconstruct.structures().begin();
-  for (; track_iter != reconstruct.structures().end(); ++track_iter) {
-    PointStructure * point_s = 
-      dynamic_cast<PointStructure*>(track_iter->second);
-    if (point_s) {
-      fprintf(fid, "v = NMesh.Vert(%g,%g,%g)\n", point_s->coords_affine()(0),
-                                                 point_s->coords_affine()(1),
-                                                 point_s->coords_affine()(2));
-      fprintf(fid, "mesh.verts.append(v)\n");
-    }
-  }
+}
+
+void WriteBlenderPoint(FILE *fid, const Vec3 &X) {
+  fprintf(fid, "v = NMesh.Vert(%g,%g,%g)\n", X(0), X(1), X(2));
+  fprintf(fid, "mesh.verts.append(v)\n");
+}
+
+void CloseBlenderScript(FILE *fid, uint num_cam_exported) {
   fprintf(fid, "mesh.update()\n");
   fprintf(fid, "cur.update()\n\n");
 
@@ -145,4 +150,247 @@ void ExportToBlenderScript(const Reconstruction &reconstruct,
 
   fclose(fid);
 }
+
+// Writes the binary data of ExportToCompactBlenderScript(), converting the
+// values to little endian.
+class BlenderDataWriter {
+ public:
+  BlenderDataWriter(const std::string &out_file_name,
+                    int num_cameras, int num_points)
+    : ok_(true), swap_(false) {
+    const unsigned int one = 1;
+    swap_ = *reinterpret_cast<const unsigned char *>(&one) != 1;
+
+    data_file_name_ = out_file_name + ".bin";
+    data_ = fopen(data_file_name_.c_str(), "wb");
+    ok_ = data_ != NULL;
+    Write("LMVB", 4, 1);
+    unsigned int header[3] = { 1, num_cameras, num_points };
+    Write(header, sizeof(header[0]), 3);
+  }
+
+  ~BlenderDataWriter() {
+    if (data_) {
+      fclose(data_);
+    }
+  }
+
+  void WriteCamera(CameraID id, const Mat3 &K, const Mat3 &R, const Vec3 &t,
+                   double width) {
+    int id_value = id;
+    double values[17];
+    values[0] = BlenderCameraLens(K, width);
+    BlenderCameraMatrix(R, t, values + 1);
+    Write(&id_value, sizeof(id_value), 1);
+    Write(values, sizeof(values[0]), 17);
+  }
+
+  void WritePoint(const Vec3 &X) {
+    float values[3] = { X(0), X(1), X(2) };
+    Write(values, sizeof(values[0]), 3);
+  }
+
+  // Closes the data file and writes the script that loads it.
+  bool Close(const std::string &out_file_name) {
+    if (!data_) {
+      return false;
+    }
+    ok_ = fclose(data_) == 0 && ok_;
+    data_ = NULL;
+    if (!ok_) {
+      return false;
+    }
+    FILE *fid = fopen(out_file_name.c_str(), "wb");
+    if (!fid) {
+      return false;
+    }
+    // The data file is found by the path it was written to, relative paths
+    // being relative to the working directory of Blender.
+    std::string escaped;
+    for (size_t i = 0; i < data_file_name_.size(); ++i) {
+      if (data_file_name_[i] == '\\' || data_file_name_[i] == '\'') {
+        escaped += '\\';
+      }
+      escaped += data_file_name_[i];
+    }
+    fprintf(fid,
+      "# libmv blender camera track export; do not edit\n"
+      "import struct\n"
+      "import Blender\n"
+      "from Blender import Camera, Object, Scene, NMesh\n"
+      "from Blender import Mathutils\n"
+      "cur = Scene.GetCurrent()\n"
+      "f = open('%s', 'rb')\n"
+      "data = f.read()\n"
+      "f.close()\n"
+      "magic, version, num_cameras, num_points = "
+          "struct.unpack_from('<4sIII', data, 0)\n"
+      "offset = 16\n"
+      "# Cameras\n"
+      "objects = []\n"
+      "for i in range(num_cameras):\n"
+      "  values = struct.unpack_from('<i17d', data, offset)\n"
+      "  offset += 140\n"
+      "  c = Camera.New('persp')\n"
+      "  c.lens = values[1]\n"
+      "  c.setDrawSize(0.05)\n"
+      "  o = Object.New('Camera')\n"
+      "  o.name = 'libmv_cam%%04d' %% values[0]\n"
+      "  m = values[2:]\n"
+      "  o.setMatrix(Mathutils.Matrix(list(m[0:4]), list(m[4:8]), "
+          "list(m[8:12]), list(m[12:16])))\n"
+      "  o.link(c)\n"
+      "  cur.link(o)\n"
+      "  objects.append(o)\n"
+      "# Point cloud\n"
+      "ob = Object.New('Mesh', 'libmv_point_cloud')\n"
+      "ob.setLocation(0.0, 0.0, 0.0)\n"
+      "mesh = ob.getData()\n"
+      "cur.link(ob)\n"
+      "xyz = struct.unpack_from('<%%df' %% (3 * num_points), data, offset)\n"
+      "for j in range(num_points):\n"
+      "  mesh.verts.append(NMesh.Vert(xyz[3 * j], xyz[3 * j + 1], "
+          "xyz[3 * j + 2]))\n"
+      "mesh.update()\n"
+      "cur.update()\n"
+      "# Add a helper object to help manipulating joined camera and points\n"
+      "scene_dummy = Object.New('Empty', 'libmv_scene')\n"
+      "scene_dummy.setLocation(0.0, 0.0, 0.0)\n"
+      "cur.link(scene_dummy)\n"
+      "scene_dummy.makeParent([ob] + objects)\n"
+      "scene_dummy.SizeX = 1.0\n"
+      "scene_dummy.SizeY = 1.0\n"
+      "scene_dummy.SizeZ = 1.0\n", escaped.c_str());
+    return fclose(fid) == 0;
+  }
+
+ private:
+  void Write(const void *values, size_t size, size_t count) {
+    if (!ok_) {
+      return;
+    }
+    const char *bytes = static_cast<const char *>(values);
+    char swapped[8];
+    for (size_t i = 0; i < count; ++i, bytes += size) {
+      const char *value = bytes;
+      if (swap_ && size > 1) {
+        std::reverse_copy(bytes, bytes + size, swapped);
+        value = swapped;
+      }
+      if (fwrite(value, size, 1, data_) != 1) {
+        ok_ = false;
+        return;
+      }
+    }
+  }
+
+  std::string data_file_name_;
+  FILE *data_;
+  bool ok_;
+  bool swap_;
+};
+
+}  // namespace
+
+void ExportToBlenderScript(const Reconstruction &reconstruct, 
+                           std::string out_file_name) {
+  FILE* fid = OpenBlenderScript(out_file_name);
+  PinholeCamera *pcamera = NULL;
+  uint i = 0;
+  std::map<CameraID, Camera *>::const_iterator camera_iter =  
+    reconstruct.cameras().begin();
+  for (; camera_iter != reconstruct.cameras().end(); ++camera_iter) {
+    pcamera = dynamic_cast<PinholeCamera *>(camera_iter->second);
+    // TODO(julien) how to export generic cameras ? 
+    if (pcamera) {
+      WriteBlenderCamera(fid, i, camera_iter->first,
+                         pcamera->intrinsic_matrix(),
+                         pcamera->orientation_matrix(),
+                         pcamera->position(),
+                         pcamera->image_width());
+      i++;
+    }
+  }
+  BeginBlenderPointCloud(fid);
+  std::map<StructureID, Structure *>::const_iterator track_iter =
+    reconstruct.structures().begin();
+  for (; track_iter != reconstruct.structures().end(); ++track_iter) {
+    PointStructure * point_s = 
+      dynamic_cast<PointStructure*>(track_iter->second);
+    if (point_s) {
+      WriteBlenderPoint(fid, point_s->coords_affine());
+    }
+  }
+  CloseBlenderScript(fid, i);
+}
+
+void ExportToBlenderScript(const DenseReconstruction &reconstruct,
+                           std::string out_file_name) {
+  FILE* fid = OpenBlenderScript(out_file_name);
+  for (int c = 0; c < reconstruct.NumCameras(); ++c) {
+    WriteBlenderCamera(fid, c, reconstruct.camera_id(c),
+                       reconstruct.Ks()[c], reconstruct.Rs()[c],
+                       reconstruct.ts()[c], reconstruct.image_sizes()[c](0));
+  }
+  BeginBlenderPointCloud(fid);
+  for (int j = 0; j < reconstruct.NumPoints(); ++j) {
+    WriteBlenderPoint(fid, reconstruct.Xs()[j]);
+  }
+  CloseBlenderScript(fid, reconstruct.NumCameras());
+}
+
+bool ExportToCompactBlenderScript(const Reconstruction &reconstruct,
+                                  const std::string &out_file_name) {
+  // The header needs the number of cameras and points.
+  int num_cameras = 0, num_points = 0;
+  std::map<CameraID, Camera *>::const_iterator camera_iter =
+    reconstruct.cameras().begin();
+  for (; camera_iter != reconstruct.cameras().end(); ++camera_iter) {
+    num_cameras += dynamic_cast<PinholeCamera *>(camera_iter->second) != NULL;
+  }
+  std::map<StructureID, Structure *>::const_iterator track_iter =
+    reconstruct.structures().begin();
+  for (; track_iter != reconstruct.structures().end(); ++track_iter) {
+    num_points += dynamic_cast<PointStructure *>(track_iter->second) != NULL;
+  }
+
+  BlenderDataWriter writer(out_file_name, num_cameras, num_points);
+  camera_iter = reconstruct.cameras().begin();
+  for (; camera_iter != reconstruct.cameras().end(); ++camera_iter) {
+    PinholeCamera *pcamera =
+      dynamic_cast<PinholeCamera *>(camera_iter->second);
+    if (pcamera) {
+      writer.WriteCamera(camera_iter->first,
+                         pcamera->intrinsic_matrix(),
+                         pcamera->orientation_matrix(),
+                         pcamera->position(),
+                         pcamera->image_width());
+    }
+  }
+  track_iter = reconstruct.structures().begin();
+  for (; track_iter != reconstruct.structures().end(); ++track_iter) {
+    PointStructure *point_s =
+      dynamic_cast<PointStructure *>(track_iter->second);
+    if (point_s) {
+      writer.WritePoint(point_s->coords_affine());
+    }
+  }
+  return writer.Close(out_file_name);
+}
+
+bool ExportToCompactBlenderScript(const DenseReconstruction &reconstruct,
+                                  const std::string &out_file_name) {
+  BlenderDataWriter writer(out_file_name, reconstruct.NumCameras(),
+                           reconstruct.NumPoints());
+  for (int c = 0; c < reconstruct.NumCameras(); ++c) {
+    writer.WriteCamera(reconstruct.camera_id(c),
+                       reconstruct.Ks()[c], reconstruct.Rs()[c],
+                       reconstruct.ts()[c], reconstruct.image_sizes()[c](0));
+  }
+  for (int j = 0; j < reconstruct.NumPoints(); ++j) {
+    writer.WritePoint(reconstruct.Xs()[j]);
+  }
+  return writer.Close(out_file_name);
+}
+
 } // namespace libmv
@@ -21,12 +21,32 @@
 #ifndef LIBMV_RECONSTRUCTION_EXPORT_BLENDER_H_
 #define LIBMV_RECONSTRUCTION_EXPORT_BLENDER_H_
 
+#include "libmv/reconstruction/dense_reconstruction.h"
 #include "libmv/reconstruction/reconstruction.h"
 
 namespace libmv {
 // Exports the reconstruction in a Blender script format file
 void ExportToBlenderScript(const Reconstruction &reconstruct, 
                            std::string out_file_name);
+
+// Same as above for a dense reconstruction.
+void ExportToBlenderScript(const DenseReconstruction &reconstruct,
+                           std::string out_file_name);
+
+// Exports the reconstruction as a short Blender script that loads the cameras
+// and the points from a binary file, out_file_name + ".bin", written next to
+// it. This is much faster to write and to load in Blender than the script
+// above for large point clouds. The data file is little endian:
+//   "LMVB", version, number of cameras, number of points (uint32),
+//   per camera: id (int32), lens and 4x4 world matrix by rows (17 doubles),
+//   per point: x, y, z (3 floats).
+// Returns false if a file cannot be written.
+bool ExportToCompactBlenderScript(const Reconstruction &reconstruct,
+                                  const std::string &out_file_name);
+
+// Same as above for a dense reconstruction.
+bool ExportToCompactBlenderScript(const DenseReconstruction &reconstruct,
+                                  const std::string &out_file_name);
 }  // namespace libmv
 
 #endif  // LIBMV_RECONSTRUCTION_EXPORT_BLENDER_H_
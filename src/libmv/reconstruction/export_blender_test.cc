@@ -0,0 +1,88 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "libmv/reconstruction/export_blender.h"
+#include "testing/testing.h"
+
+namespace libmv {
+namespace {
+
+std::string ReadFile(const std::string &filename) {
+  std::string contents;
+  FILE *file = fopen(filename.c_str(), "rb");
+  if (file) {
+    char buffer[4096];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+      contents.append(buffer, size);
+    }
+    fclose(file);
+  }
+  return contents;
+}
+
+TEST(ExportBlender, CompactScript) {
+  Reconstruction reconstruction;
+  PinholeCamera *camera = new PinholeCamera(Mat3::Identity(), Vec3(1, 2, 3));
+  Vec2u size;
+  size << 640, 480;
+  camera->set_image_size(size);
+  reconstruction.InsertCamera(7, camera);
+  reconstruction.InsertTrack(0, new PointStructure(Vec4(2, 4, 6, 2)));
+
+  std::string filename = "export_blender_test.py";
+  EXPECT_TRUE(ExportToCompactBlenderScript(reconstruction, filename));
+  std::string script = ReadFile(filename);
+  std::string data = ReadFile(filename + ".bin");
+  remove(filename.c_str());
+  remove((filename + ".bin").c_str());
+
+  EXPECT_NE(std::string::npos,
+            script.find("open('export_blender_test.py.bin', 'rb')"));
+  ASSERT_EQ(16 + 140 + 12, data.size());
+  EXPECT_EQ("LMVB", data.substr(0, 4));
+  // Assumes a little endian host.
+  unsigned int header[3];
+  memcpy(header, data.data() + 4, sizeof(header));
+  EXPECT_EQ(1, header[0]);
+  EXPECT_EQ(1, header[1]);
+  EXPECT_EQ(1, header[2]);
+  int id;
+  memcpy(&id, data.data() + 16, sizeof(id));
+  EXPECT_EQ(7, id);
+  double values[17];
+  memcpy(values, data.data() + 20, sizeof(values));
+  EXPECT_EQ(1, values[16]);
+  float X[3];
+  memcpy(X, data.data() + 156, sizeof(X));
+  EXPECT_EQ(1, X[0]);
+  EXPECT_EQ(2, X[1]);
+  EXPECT_EQ(3, X[2]);
+
+  reconstruction.ClearCamerasMap();
+  reconstruction.ClearStructuresMap();
+}
+
+}  // namespace
+}  // namespace libmv
@@ -18,12 +18,69 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <locale.h>
 
 #include "libmv/reconstruction/export_ply.h"
 
 namespace libmv {
+namespace {
+
+bool IsLittleEndian() {
+  const unsigned int one = 1;
+  return *reinterpret_cast<const unsigned char *>(&one) == 1;
+}
+
+// Buffers the 15 byte vertices (x, y, z as little endian floats, then red,
+// green and blue) of a binary PLY file.
+class BinaryPLYVertexWriter {
+ public:
+  explicit BinaryPLYVertexWriter(FILE *file)
+    : file_(file), size_(0), ok_(true), swap_(!IsLittleEndian()) {}
+
+  void Add(const Vec3 &X, unsigned char red, unsigned char green,
+           unsigned char blue) {
+    if (size_ + kVertexSize > sizeof(buffer_)) {
+      Flush();
+    }
+    char *vertex = buffer_ + size_;
+    for (int i = 0; i < 3; ++i) {
+      float x = X(i);
+      memcpy(vertex + 4 * i, &x, 4);
+      if (swap_) {
+        std::swap(vertex[4 * i], vertex[4 * i + 3]);
+        std::swap(vertex[4 * i + 1], vertex[4 * i + 2]);
+      }
+    }
+    vertex[12] = red;
+    vertex[13] = green;
+    vertex[14] = blue;
+    size_ += kVertexSize;
+  }
+
+  // Returns false if any write failed.
+  bool Flush() {
+    if (size_ && fwrite(buffer_, 1, size_, file_) != size_) {
+      ok_ = false;
+    }
+    size_ = 0;
+    return ok_;
+  }
+
+ private:
+  static const size_t kVertexSize = 15;
+
+  FILE *file_;
+  char buffer_[kVertexSize * 4096];
+  size_t size_;
+  bool ok_;
+  bool swap_;
+};
+
+}  // namespace
 
 void ExportToPLY(const Reconstruction &reconstruct, std::string out_file_name) {
   std::ofstream outfile;
@@ -77,4 +134,58 @@ void ExportToPLY(const Reconstruction &reconstruct, std::string out_file_name) {
     outfile.close();
   }
 }
+
+bool ExportToBinaryPLY(const Reconstruction &reconstruct,
+                       const std::string &out_file_name) {
+  // The header needs the number of vertices.
+  int num_vertices = 0;
+  std::map<StructureID, Structure *>::const_iterator track_iter =
+    reconstruct.structures().begin();
+  for (; track_iter != reconstruct.structures().end(); ++track_iter) {
+    num_vertices += dynamic_cast<PointStructure *>(track_iter->second) != NULL;
+  }
+  std::map<CameraID, Camera *>::const_iterator camera_iter =
+    reconstruct.cameras().begin();
+  for (; camera_iter != reconstruct.cameras().end(); ++camera_iter) {
+    num_vertices += dynamic_cast<PinholeCamera *>(camera_iter->second) != NULL;
+  }
+
+  FILE *file = fopen(out_file_name.c_str(), "wb");
+  if (!file) {
+    return false;
+  }
+  bool ok = fprintf(file,
+                    "ply\n"
+                    "format binary_little_endian 1.0\n"
+                    "comment Made by libmv authors\n"
+                    "comment 3D points structure then cameras positions\n"
+                    "element vertex %d\n"
+                    "property float x\n"
+                    "property float y\n"
+                    "property float z\n"
+                    "property uchar red\n"
+                    "property uchar green\n"
+                    "property uchar blue\n"
+                    "end_header\n", num_vertices) > 0;
+  BinaryPLYVertexWriter vertices(file);
+  track_iter = reconstruct.structures().begin();
+  for (; track_iter != reconstruct.structures().end(); ++track_iter) {
+    PointStructure *point_s =
+      dynamic_cast<PointStructure *>(track_iter->second);
+    if (point_s) {
+      vertices.Add(point_s->coords_affine(), 255, 255, 255);
+    }
+  }
+  camera_iter = reconstruct.cameras().begin();
+  for (; camera_iter != reconstruct.cameras().end(); ++camera_iter) {
+    PinholeCamera *camera_pinhole =
+      dynamic_cast<PinholeCamera *>(camera_iter->second);
+    if (camera_pinhole) {
+      vertices.Add(camera_pinhole->position(), 255, 0, 0);
+    }
+  }
+  ok = vertices.Flush() && ok;
+  ok = fclose(file) == 0 && ok;
+  return ok;
+}
 } // namespace libmv
@@ -26,6 +26,13 @@
 namespace libmv {
 // Exports the reconstruction in a PLY format file
 void ExportToPLY(const Reconstruction &reconstruct, std::string out_file_name);
+
+// Exports the reconstruction in a binary little endian PLY file, with a
+// single vertex element: the points in white, then the camera positions in
+// red. The vertices are written as they are visited, through a fixed size
+// buffer. Returns false if the file cannot be written.
+bool ExportToBinaryPLY(const Reconstruction &reconstruct,
+                       const std::string &out_file_name);
 }  // namespace libmv
 
 #endif  // LIBMV_RECONSTRUCTION_EXPORT_PLY_H_
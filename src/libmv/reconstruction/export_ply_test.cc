@@ -0,0 +1,96 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "libmv/reconstruction/export_ply.h"
+#include "testing/testing.h"
+
+namespace libmv {
+namespace {
+
+std::string ReadFile(const std::string &filename) {
+  std::string contents;
+  FILE *file = fopen(filename.c_str(), "rb");
+  if (file) {
+    char buffer[4096];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+      contents.append(buffer, size);
+    }
+    fclose(file);
+  }
+  return contents;
+}
+
+float ReadFloat(const char *bytes) {
+  unsigned char b[4];
+  memcpy(b, bytes, 4);
+  unsigned int value = b[0] | (b[1] << 8) | (b[2] << 16) |
+                       (static_cast<unsigned int>(b[3]) << 24);
+  float x;
+  memcpy(&x, &value, 4);
+  return x;
+}
+
+TEST(ExportPLY, Binary) {
+  Reconstruction reconstruction;
+  reconstruction.InsertCamera(3, new PinholeCamera(Mat3::Identity(),
+                                                   Vec3(1, 2, 3)));
+  reconstruction.InsertTrack(0, new PointStructure(Vec4(2, 4, 6, 2)));
+  reconstruction.InsertTrack(1, new PointStructure(Vec4(-1, 0.5, 8, 1)));
+
+  std::string filename = "export_ply_test.ply";
+  EXPECT_TRUE(ExportToBinaryPLY(reconstruction, filename));
+  std::string contents = ReadFile(filename);
+  remove(filename.c_str());
+
+  std::string end_header = "end_header\n";
+  size_t data = contents.find(end_header);
+  ASSERT_NE(std::string::npos, data);
+  EXPECT_NE(std::string::npos,
+            contents.find("format binary_little_endian 1.0\n"));
+  EXPECT_NE(std::string::npos, contents.find("element vertex 3\n"));
+  data += end_header.size();
+  ASSERT_EQ(data + 3 * 15, contents.size());
+
+  const char *vertex = contents.data() + data;
+  EXPECT_EQ(1, ReadFloat(vertex));
+  EXPECT_EQ(2, ReadFloat(vertex + 4));
+  EXPECT_EQ(3, ReadFloat(vertex + 8));
+  EXPECT_EQ(255, static_cast<unsigned char>(vertex[13]));
+  vertex += 15;
+  EXPECT_EQ(-1, ReadFloat(vertex));
+  EXPECT_EQ(0.5, ReadFloat(vertex + 4));
+  EXPECT_EQ(8, ReadFloat(vertex + 8));
+  // The camera, in red.
+  vertex += 15;
+  EXPECT_EQ(255, static_cast<unsigned char>(vertex[12]));
+  EXPECT_EQ(0, vertex[13]);
+  EXPECT_EQ(0, vertex[14]);
+
+  reconstruction.ClearCamerasMap();
+  reconstruction.ClearStructuresMap();
+}
+
+}  // namespace
+}  // namespace libmv
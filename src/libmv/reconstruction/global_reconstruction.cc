@@ -0,0 +1,624 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+#include <algorithm>
+#include <map>
+#include <queue>
+
+#include "libmv/base/thread.h"
+#include "libmv/camera/pinhole_camera.h"
+#include "libmv/logging/logging.h"
+#include "libmv/multiview/batch_triangulation.h"
+#include "libmv/multiview/fundamental.h"
+#include "libmv/multiview/robust_fundamental.h"
+#include "libmv/reconstruction/global_reconstruction.h"
+#include "libmv/reconstruction/optimization.h"
+
+namespace libmv {
+namespace {
+
+Mat3 RotationExponential(const Vec3 &w) {
+  if (w.squaredNorm() > 0) {
+    return RotationRodrigues(w);
+  }
+  return Mat3::Identity();
+}
+
+// The w such that R = exp([w]), with |w| <= pi. Through the quaternion of R
+// with atan2(), which is accurate for small angles unlike acos().
+Vec3 RotationLogarithm(const Mat3 &R) {
+  Eigen::Quaterniond q(R);
+  if (q.w() < 0) {
+    q.coeffs() = -q.coeffs();
+  }
+  double s = q.vec().norm();
+  if (s == 0) {
+    return Vec3::Zero();
+  }
+  double angle = 2 * atan2(s, q.w());
+  return q.vec() * (angle / s);
+}
+
+// Estimates the relative pose of an edge of the view graph.
+struct PairMotion {
+  const Matches *matches;
+  const ViewGraph *graph;
+  const vector<Mat3> *Ks;
+  int min_num_inliers;
+  std::vector<RelativePose> *poses;
+  std::vector<char> *is_estimated;
+
+  void operator()(int e) {
+    (*is_estimated)[e] = 0;
+    const ViewGraphEdge &edge = graph->edge(e);
+    if (edge.num_matches < std::max(min_num_inliers, 7)) {
+      return;
+    }
+    vector<Matches::ImageID> images;
+    images.push_back(graph->image(edge.image1));
+    images.push_back(graph->image(edge.image2));
+    vector<Matches::TrackID> tracks;
+    vector<Mat> xs(2);
+    PointMatchMatrices(*matches, images, &tracks, &xs);
+    if (xs[0].cols() < 7) {
+      return;
+    }
+    // The thresholds of InitialReconstructionTwoViews().
+    const double kEpipolarThreshold = 1;
+    const double kOutliersProbability = 1e-3;
+    Mat3 F;
+    vector<int> inliers;
+    FundamentalFromCorrespondences7PointRobust(xs[0], xs[1],
+                                               kEpipolarThreshold,
+                                               &F, &inliers,
+                                               kOutliersProbability);
+    if (inliers.size() < std::max(min_num_inliers, 7)) {
+      return;
+    }
+    const Mat3 &K1 = (*Ks)[edge.image1];
+    const Mat3 &K2 = (*Ks)[edge.image2];
+    Mat3 E;
+    EssentialFromFundamental(F, K1, K2, &E);
+    RelativePose &pose = (*poses)[e];
+    Vec2 x1 = xs[0].col(inliers[0]), x2 = xs[1].col(inliers[0]);
+    if (!MotionFromEssentialAndCorrespondence(E, K1, x1, K2, x2,
+                                              &pose.R, &pose.t) ||
+        pose.t.norm() == 0) {
+      return;
+    }
+    pose.image1 = edge.image1;
+    pose.image2 = edge.image2;
+    pose.t.normalize();
+    pose.num_inliers = inliers.size();
+    (*is_estimated)[e] = 1;
+  }
+};
+
+// The normal equations of the least squares problem
+//
+//   sum_k a_k |x_j - R_k x_i - b_k|^2
+//
+// over the edges k = (i, j), the variables of the fixed nodes being 0. The
+// rotation averaging updates and the translation averaging (R_k = I) are
+// both of this form.
+struct EdgeSystem {
+  std::vector<int> i, j;
+  std::vector<Mat3> R;
+  std::vector<double> a;
+  std::vector<char> is_free;
+
+  int NumEdges() const { return i.size(); }
+
+  // y = A' W A x.
+  void Multiply(const vector<Vec3> &x, vector<Vec3> *y) const {
+    y->resize(x.size());
+    for (int n = 0; n < x.size(); ++n) {
+      (*y)[n].setZero();
+    }
+    for (int k = 0; k < NumEdges(); ++k) {
+      Vec3 r = a[k] * (x[j[k]] - R[k] * x[i[k]]);
+      (*y)[j[k]] += r;
+      (*y)[i[k]] -= R[k].transpose() * r;
+    }
+    for (int n = 0; n < x.size(); ++n) {
+      if (!is_free[n]) {
+        (*y)[n].setZero();
+      }
+    }
+  }
+
+  // A' W b.
+  void RightHandSide(const std::vector<Vec3> &b, vector<Vec3> *rhs) const {
+    for (int n = 0; n < rhs->size(); ++n) {
+      (*rhs)[n].setZero();
+    }
+    for (int k = 0; k < NumEdges(); ++k) {
+      (*rhs)[j[k]] += a[k] * b[k];
+      (*rhs)[i[k]] -= a[k] * R[k].transpose() * b[k];
+    }
+    for (int n = 0; n < rhs->size(); ++n) {
+      if (!is_free[n]) {
+        (*rhs)[n].setZero();
+      }
+    }
+  }
+
+  // Solves the normal equations by Jacobi preconditioned conjugate gradients
+  // from x; the diagonal blocks of A' W A are multiples of the identity.
+  void Solve(const std::vector<Vec3> &b, vector<Vec3> *x) const {
+    const int num_nodes = x->size();
+    std::vector<double> inverse_diagonal(num_nodes, 0);
+    for (int k = 0; k < NumEdges(); ++k) {
+      inverse_diagonal[i[k]] += a[k];
+      inverse_diagonal[j[k]] += a[k];
+    }
+    for (int n = 0; n < num_nodes; ++n) {
+      if (is_free[n] && inverse_diagonal[n] > 0) {
+        inverse_diagonal[n] = 1 / inverse_diagonal[n];
+      } else {
+        inverse_diagonal[n] = 0;
+        (*x)[n].setZero();
+      }
+    }
+    vector<Vec3> r(num_nodes), z(num_nodes), p(num_nodes), q;
+    RightHandSide(b, &r);
+    double rhs_norm2 = 0;
+    for (int n = 0; n < num_nodes; ++n) {
+      rhs_norm2 += r[n].squaredNorm();
+    }
+    Multiply(*x, &q);
+    double rz = 0;
+    for (int n = 0; n < num_nodes; ++n) {
+      r[n] -= q[n];
+      z[n] = inverse_diagonal[n] * r[n];
+      p[n] = z[n];
+      rz += r[n].dot(z[n]);
+    }
+    const double kTolerance2 = 1e-24;
+    const int max_iterations = 3 * num_nodes + 10;
+    for (int iteration = 0; iteration < max_iterations; ++iteration) {
+      double r_norm2 = 0;
+      for (int n = 0; n < num_nodes; ++n) {
+        r_norm2 += r[n].squaredNorm();
+      }
+      if (r_norm2 <= kTolerance2 * rhs_norm2 || rz <= 0) {
+        break;
+      }
+      Multiply(p, &q);
+      double curvature = 0;
+      for (int n = 0; n < num_nodes; ++n) {
+        curvature += p[n].dot(q[n]);
+      }
+      if (!(curvature > 0)) {
+        break;
+      }
+      double alpha = rz / curvature;
+      double next_rz = 0;
+      for (int n = 0; n < num_nodes; ++n) {
+        (*x)[n] += alpha * p[n];
+        r[n] -= alpha * q[n];
+        z[n] = inverse_diagonal[n] * r[n];
+        next_rz += r[n].dot(z[n]);
+      }
+      for (int n = 0; n < num_nodes; ++n) {
+        p[n] = z[n] + (next_rz / rz) * p[n];
+      }
+      rz = next_rz;
+    }
+  }
+};
+
+// Marks the images connected to the first one by the poses.
+void ReachFromFirstImage(int num_images,
+                         const std::vector<RelativePose> &poses,
+                         std::vector<char> *reached) {
+  std::vector<std::vector<int> > neighbors(num_images);
+  for (int k = 0; k < poses.size(); ++k) {
+    neighbors[poses[k].image1].push_back(poses[k].image2);
+    neighbors[poses[k].image2].push_back(poses[k].image1);
+  }
+  reached->assign(num_images, 0);
+  if (num_images == 0) {
+    return;
+  }
+  std::vector<int> stack(1, 0);
+  (*reached)[0] = 1;
+  while (stack.size() > 0) {
+    int i = stack.back();
+    stack.pop_back();
+    for (int n = 0; n < neighbors[i].size(); ++n) {
+      if (!(*reached)[neighbors[i][n]]) {
+        (*reached)[neighbors[i][n]] = 1;
+        stack.push_back(neighbors[i][n]);
+      }
+    }
+  }
+}
+
+int FindRoot(std::vector<int> *parent, int i) {
+  while ((*parent)[i] != i) {
+    (*parent)[i] = (*parent)[(*parent)[i]];
+    i = (*parent)[i];
+  }
+  return i;
+}
+
+// The connected components of the images of the poses, of at least two
+// images each, with the images in increasing order.
+void PoseComponents(int num_images,
+                    const std::vector<RelativePose> &poses,
+                    std::vector<std::vector<int> > *components) {
+  std::vector<int> parent(num_images);
+  for (int i = 0; i < num_images; ++i) {
+    parent[i] = i;
+  }
+  for (int k = 0; k < poses.size(); ++k) {
+    parent[FindRoot(&parent, poses[k].image1)] =
+        FindRoot(&parent, poses[k].image2);
+  }
+  std::map<int, std::vector<int> > roots;
+  for (int i = 0; i < num_images; ++i) {
+    roots[FindRoot(&parent, i)].push_back(i);
+  }
+  components->clear();
+  std::map<int, std::vector<int> >::const_iterator it = roots.begin();
+  for (; it != roots.end(); ++it) {
+    if (it->second.size() >= 2) {
+      components->push_back(it->second);
+    }
+  }
+}
+
+// The poses between the images, renumbered by their position in images.
+void PosesBetween(const std::vector<int> &images,
+                  const std::vector<RelativePose> &poses,
+                  std::vector<RelativePose> *selected) {
+  std::map<int, int> index;
+  for (int n = 0; n < images.size(); ++n) {
+    index[images[n]] = n;
+  }
+  selected->clear();
+  for (int k = 0; k < poses.size(); ++k) {
+    std::map<int, int>::const_iterator i = index.find(poses[k].image1);
+    std::map<int, int>::const_iterator j = index.find(poses[k].image2);
+    if (i != index.end() && j != index.end()) {
+      selected->push_back(poses[k]);
+      selected->back().image1 = i->second;
+      selected->back().image2 = j->second;
+    }
+  }
+}
+
+// Triangulates in one pass the tracks of matches seen by at least two
+// cameras of reconstruction, and adds the points in front of all their
+// cameras with a reprojection error below max_rms_error. Returns the number
+// of points added.
+int TriangulateAllTracks(const Matches &matches,
+                         double max_rms_error,
+                         int num_threads,
+                         Reconstruction *reconstruction) {
+  vector<Mat34> Ps;
+  std::map<CameraID, int> camera_indices;
+  vector<StructureID> track_ids;
+  vector<int> offsets, cameras;
+  vector<Vec2> xs;
+  offsets.push_back(0);
+  std::set<Matches::TrackID>::const_iterator track_iter =
+    matches.get_tracks().begin();
+  for (; track_iter != matches.get_tracks().end(); ++track_iter) {
+    Matches::Features<PointFeature> fp =
+        matches.InTrack<PointFeature>(*track_iter);
+    for (; fp; ++fp) {
+      PinholeCamera *camera = dynamic_cast<PinholeCamera *>(
+          reconstruction->GetCamera(fp.image()));
+      if (!camera) {
+        continue;
+      }
+      std::map<CameraID, int>::iterator it = camera_indices.find(fp.image());
+      if (it == camera_indices.end()) {
+        it = camera_indices.insert(
+            std::make_pair(fp.image(), int(Ps.size()))).first;
+        Ps.push_back(camera->projection_matrix());
+      }
+      cameras.push_back(it->second);
+      xs.push_back(Vec2(fp.feature()->x(), fp.feature()->y()));
+    }
+    if (cameras.size() - offsets[offsets.size() - 1] >= 2) {
+      offsets.push_back(cameras.size());
+      track_ids.push_back(*track_iter);
+    } else {
+      cameras.resize(offsets[offsets.size() - 1]);
+      xs.resize(offsets[offsets.size() - 1]);
+    }
+  }
+  Mat2X x(2, xs.size());
+  for (int k = 0; k < xs.size(); ++k) {
+    x.col(k) = xs[k];
+  }
+  Mat4X X;
+  Vec rms_errors;
+  vector<int> num_behind;
+  TriangulatePoints(Ps, offsets, cameras, x, num_threads, &X, &rms_errors,
+                    &num_behind);
+  int num_points = 0;
+  for (int t = 0; t < track_ids.size(); ++t) {
+    if (num_behind[t] > 0 || X(3, t) == 0 || !(rms_errors(t) < max_rms_error)) {
+      continue;
+    }
+    PointStructure *point = new PointStructure();
+    point->set_coords(X.col(t));
+    reconstruction->InsertTrack(track_ids[t], point);
+    ++num_points;
+  }
+  return num_points;
+}
+
+}  // namespace
+
+void EstimateRelativePoses(const Matches &matches,
+                           const ViewGraph &graph,
+                           const vector<Mat3> &Ks,
+                           int min_num_inliers,
+                           int num_threads,
+                           std::vector<RelativePose> *poses) {
+  LIBMV_SCOPED_TIMER("reconstruction.relative_poses");
+  std::vector<RelativePose> edge_poses(graph.NumEdges());
+  std::vector<char> is_estimated(graph.NumEdges(), 0);
+  PairMotion motion;
+  motion.matches = &matches;
+  motion.graph = &graph;
+  motion.Ks = &Ks;
+  motion.min_num_inliers = min_num_inliers;
+  motion.poses = &edge_poses;
+  motion.is_estimated = &is_estimated;
+  ParallelForDynamic(0, graph.NumEdges(), num_threads, &motion);
+  poses->clear();
+  for (int e = 0; e < graph.NumEdges(); ++e) {
+    if (is_estimated[e]) {
+      poses->push_back(edge_poses[e]);
+    }
+  }
+  VLOG(1) << poses->size() << " relative poses for " << graph.NumEdges()
+          << " pairs of images.";
+}
+
+int AverageRotations(int num_images,
+                     const std::vector<RelativePose> &poses,
+                     vector<Mat3> *Rs) {
+  LIBMV_SCOPED_TIMER("reconstruction.rotation_averaging");
+  Rs->resize(num_images);
+  for (int i = 0; i < num_images; ++i) {
+    (*Rs)[i].setIdentity();
+  }
+  if (num_images == 0) {
+    return 0;
+  }
+
+  // Maximum spanning tree from the first image, by number of inliers.
+  std::vector<std::vector<int> > incident(num_images);
+  for (int k = 0; k < poses.size(); ++k) {
+    incident[poses[k].image1].push_back(k);
+    incident[poses[k].image2].push_back(k);
+  }
+  std::vector<char> reached(num_images, 0);
+  std::priority_queue<std::pair<int, int> > queue;
+  reached[0] = 1;
+  int num_reached = 1;
+  for (int n = 0; n < incident[0].size(); ++n) {
+    queue.push(std::make_pair(poses[incident[0][n]].num_inliers,
+                              incident[0][n]));
+  }
+  while (!queue.empty()) {
+    const RelativePose &pose = poses[queue.top().second];
+    queue.pop();
+    int i = pose.image1, j = pose.image2;
+    if (reached[i] && reached[j]) {
+      continue;
+    }
+    int image = reached[i] ? j : i;
+    if (reached[i]) {
+      (*Rs)[j] = pose.R * (*Rs)[i];
+    } else {
+      (*Rs)[i] = pose.R.transpose() * (*Rs)[j];
+    }
+    reached[image] = 1;
+    ++num_reached;
+    for (int n = 0; n < incident[image].size(); ++n) {
+      queue.push(std::make_pair(poses[incident[image][n]].num_inliers,
+                                incident[image][n]));
+    }
+  }
+
+  // With R_i <- exp([w_i]) R_i, the error rotation R_k R_i R_j' of an edge
+  // becomes exp([e_k + R_k w_i - w_j]) to first order, e_k = log(R_k R_i R_j').
+  EdgeSystem system;
+  for (int k = 0; k < poses.size(); ++k) {
+    if (reached[poses[k].image1]) {
+      system.i.push_back(poses[k].image1);
+      system.j.push_back(poses[k].image2);
+      system.R.push_back(poses[k].R);
+    }
+  }
+  system.a.resize(system.NumEdges());
+  system.is_free = reached;
+  system.is_free[0] = 0;
+  std::vector<Vec3> errors(system.NumEdges());
+  vector<Vec3> w(num_images);
+  // The sum of the error angles is minimized by iteratively reweighted least
+  // squares, the cost being quadratic below sigma; sigma shrinks over the
+  // iterations so that the outliers do not bias the result.
+  double sigma = 1e-2;
+  const double kMinSigma = 1e-12;
+  const int kMaxIterations = 50;
+  for (int iteration = 0; iteration < kMaxIterations; ++iteration) {
+    for (int k = 0; k < system.NumEdges(); ++k) {
+      const Mat3 &Ri = (*Rs)[system.i[k]], &Rj = (*Rs)[system.j[k]];
+      errors[k] = RotationLogarithm(system.R[k] * Ri * Rj.transpose());
+      system.a[k] = 1 / sqrt(errors[k].squaredNorm() + Square(sigma));
+    }
+    sigma = std::max(sigma / 10, kMinSigma);
+    for (int n = 0; n < num_images; ++n) {
+      w[n].setZero();
+    }
+    system.Solve(errors, &w);
+    double max_update = 0;
+    for (int n = 0; n < num_images; ++n) {
+      (*Rs)[n] = RotationExponential(w[n]) * (*Rs)[n];
+      max_update = std::max(max_update, w[n].norm());
+    }
+    if (max_update < 1e-12 && sigma == kMinSigma) {
+      break;
+    }
+  }
+  return num_reached;
+}
+
+double RelativeRotationError(const RelativePose &pose,
+                             const vector<Mat3> &Rs) {
+  return RotationLogarithm(pose.R * Rs[pose.image1] *
+                           Rs[pose.image2].transpose()).norm();
+}
+
+void AverageTranslations(const vector<Mat3> &Rs,
+                         const std::vector<RelativePose> &poses,
+                         vector<Vec3> *centers) {
+  LIBMV_SCOPED_TIMER("reconstruction.translation_averaging");
+  const int num_images = Rs.size();
+  centers->resize(num_images);
+  for (int n = 0; n < num_images; ++n) {
+    (*centers)[n].setZero();
+  }
+  // With c = -R' t, t_j - R t_i = R_j (c_i - c_j): the baseline c_j - c_i
+  // is along -R_j' t.
+  std::vector<char> reached;
+  ReachFromFirstImage(num_images, poses, &reached);
+  EdgeSystem system;
+  std::vector<Vec3> directions;
+  for (int k = 0; k < poses.size(); ++k) {
+    if (reached[poses[k].image1]) {
+      system.i.push_back(poses[k].image1);
+      system.j.push_back(poses[k].image2);
+      system.R.push_back(Mat3::Identity());
+      directions.push_back(
+          -(Rs[poses[k].image2].transpose() * poses[k].t).normalized());
+    }
+  }
+  const int num_edges = system.NumEdges();
+  system.a.assign(num_edges, 1.0);
+  system.is_free = reached;
+  if (num_images > 0) {
+    system.is_free[0] = 0;
+  }
+  std::vector<double> scales(num_edges, 1.0);
+  std::vector<Vec3> baselines(num_edges);
+  const double kSigma = 1e-6;
+  const int kMaxIterations = 200;
+  for (int iteration = 0; iteration < kMaxIterations; ++iteration) {
+    for (int k = 0; k < num_edges; ++k) {
+      baselines[k] = scales[k] * directions[k];
+    }
+    vector<Vec3> previous = *centers;
+    system.Solve(baselines, centers);
+
+    // The scales and the weights of the least unsquared deviations.
+    double max_change = 0, max_norm = 0;
+    for (int n = 0; n < num_images; ++n) {
+      max_change = std::max(max_change, ((*centers)[n] - previous[n]).norm());
+      max_norm = std::max(max_norm, (*centers)[n].norm());
+    }
+    for (int k = 0; k < num_edges; ++k) {
+      Vec3 baseline = (*centers)[system.j[k]] - (*centers)[system.i[k]];
+      scales[k] = std::max(1.0, directions[k].dot(baseline));
+      double deviation = (baseline - scales[k] * directions[k]).norm();
+      system.a[k] = 1 / std::max(deviation, kSigma);
+    }
+    if (iteration > 0 && max_change <= 1e-9 * std::max(max_norm, 1.0)) {
+      break;
+    }
+  }
+}
+
+bool GlobalEuclideanReconstruction(const Matches &matches,
+                                   const vector<Mat3> &Ks,
+                                   std::list<Reconstruction *> *reconstructions,
+                                   int min_num_inliers,
+                                   double max_rotation_error,
+                                   int num_threads) {
+  LIBMV_SCOPED_TIMER("reconstruction.global");
+  ViewGraph graph;
+  graph.Build(matches, std::max(min_num_inliers, 7), num_threads);
+  assert(Ks.size() == graph.NumImages());
+  std::vector<RelativePose> poses;
+  EstimateRelativePoses(matches, graph, Ks, min_num_inliers, num_threads,
+                        &poses);
+
+  std::vector<std::vector<int> > components;
+  PoseComponents(graph.NumImages(), poses, &components);
+  bool reconstructed = false;
+  for (int c = 0; c < components.size(); ++c) {
+    std::vector<int> images = components[c];
+    std::vector<RelativePose> component_poses;
+    PosesBetween(images, poses, &component_poses);
+    vector<Mat3> Rs;
+    AverageRotations(images.size(), component_poses, &Rs);
+
+    // The poses which disagree with the rotations are outliers, and may
+    // disconnect some images from the first one.
+    std::vector<RelativePose> inlier_poses;
+    for (int k = 0; k < component_poses.size(); ++k) {
+      if (RelativeRotationError(component_poses[k], Rs) <=
+          max_rotation_error) {
+        inlier_poses.push_back(component_poses[k]);
+      }
+    }
+    VLOG(1) << "Component of " << images.size() << " images: "
+            << inlier_poses.size() << " of " << component_poses.size()
+            << " relative rotations agree.";
+    std::vector<char> reached;
+    ReachFromFirstImage(images.size(), inlier_poses, &reached);
+    vector<Vec3> centers;
+    AverageTranslations(Rs, inlier_poses, &centers);
+
+    Reconstruction *reconstruction = new Reconstruction();
+    int num_cameras = 0;
+    for (int n = 0; n < images.size(); ++n) {
+      if (reached[n]) {
+        reconstruction->InsertCamera(graph.image(images[n]),
+            new PinholeCamera(Ks[images[n]], Rs[n], -(Rs[n] * centers[n])));
+        ++num_cameras;
+      }
+    }
+    const double kMaxTriangulationError = 2.0;
+    int num_points = TriangulateAllTracks(matches, kMaxTriangulationError,
+                                          num_threads, reconstruction);
+    VLOG(1) << num_cameras << " cameras, " << num_points << " points.";
+    if (num_cameras < 2 || num_points == 0) {
+      delete reconstruction;
+      continue;
+    }
+    MetricBundleAdjust(matches, reconstruction);
+    reconstructions->push_back(reconstruction);
+    reconstructed = true;
+  }
+  return reconstructed;
+}
+
+}  // namespace libmv
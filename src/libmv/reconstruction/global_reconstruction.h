@@ -0,0 +1,107 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+#ifndef LIBMV_RECONSTRUCTION_GLOBAL_RECONSTRUCTION_H_
+#define LIBMV_RECONSTRUCTION_GLOBAL_RECONSTRUCTION_H_
+
+#include <list>
+#include <vector>
+
+#include "libmv/base/vector.h"
+#include "libmv/correspondence/matches.h"
+#include "libmv/numeric/numeric.h"
+#include "libmv/reconstruction/reconstruction.h"
+#include "libmv/reconstruction/view_graph.h"
+
+namespace libmv {
+
+// The relative motion of the images image1 and image2 of a view graph (as
+// indices in the graph). With the convention x = K * (R * X + t) of the
+// cameras, R2 = R * R1 and t2 = R * t1 + s * t for some scale s > 0; t has a
+// unit norm.
+struct RelativePose {
+  int image1;
+  int image2;
+  Mat3 R;
+  Vec3 t;
+  // The matches of the pair which agree with the motion.
+  int num_inliers;
+};
+
+// Estimates the relative pose of the images of each edge of graph, as
+// InitialReconstructionTwoViews() does: robust fundamental matrix, essential
+// matrix from the calibrations Ks of the images (indexed as in graph), then
+// motion. The edges are processed in parallel on num_threads threads; those
+// with less than min_num_inliers inliers give no pose.
+void EstimateRelativePoses(const Matches &matches,
+                           const ViewGraph &graph,
+                           const vector<Mat3> &Ks,
+                           int min_num_inliers,
+                           int num_threads,
+                           std::vector<RelativePose> *poses);
+
+// Robust rotation averaging: finds the rotations Rs of num_images images
+// which agree best with the relative rotations of poses. The rotations are
+// initialized along a maximum spanning tree of the poses weighted by their
+// number of inliers, then refined by iteratively reweighted least squares
+// on the tangent space, with weights that approximate an L1 cost so that
+// wrong relative poses do not bend the solution. The first image has the
+// identity rotation. Images which are not connected to it by the poses keep
+// the identity; returns the number of images that are.
+int AverageRotations(int num_images,
+                     const std::vector<RelativePose> &poses,
+                     vector<Mat3> *Rs);
+
+// Angle, in radians, between the relative rotation of pose and the one of
+// the rotations Rs.
+double RelativeRotationError(const RelativePose &pose, const vector<Mat3> &Rs);
+
+// Translation averaging: finds the centers of the cameras, whose rotations
+// Rs are known, such that the baseline of each pose is along its
+// translation direction. The least unsquared deviations cost of the
+// baselines, with every baseline at least 1, is minimized by alternating
+// the scales of the baselines and an iteratively reweighted least squares
+// solve of the centers; the first center is the origin. The centers of the
+// images without poses are left at the origin.
+void AverageTranslations(const vector<Mat3> &Rs,
+                         const std::vector<RelativePose> &poses,
+                         vector<Vec3> *centers);
+
+// Global structure from motion of an unordered image set: estimates the
+// relative poses of the pairs of images sharing at least min_num_inliers
+// matches, averages their rotations then their translations (the poses
+// whose rotation disagrees with the average by more than
+// max_rotation_error radians are left out of the translation averaging),
+// triangulates all the tracks seen by two cameras or more in one parallel
+// pass and performs a single bundle adjustment. Ks are the calibrations of
+// the images of matches, in the order of their ids. A reconstruction is
+// appended to reconstructions for each connected group of at least two
+// images. Returns false if there is none.
+bool GlobalEuclideanReconstruction(const Matches &matches,
+                                   const vector<Mat3> &Ks,
+                                   std::list<Reconstruction *> *reconstructions,
+                                   int min_num_inliers = 30,
+                                   double max_rotation_error = 0.1,
+                                   int num_threads = 1);
+
+}  // namespace libmv
+
+#endif  // LIBMV_RECONSTRUCTION_GLOBAL_RECONSTRUCTION_H_
@@ -0,0 +1,158 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+
+#include <list>
+
+#include "libmv/correspondence/feature.h"
+#include "libmv/multiview/projection.h"
+#include "libmv/multiview/test_data_sets.h"
+#include "libmv/numeric/numeric.h"
+#include "libmv/reconstruction/euclidean_reconstruction.h"
+#include "libmv/reconstruction/global_reconstruction.h"
+#include "libmv/reconstruction/optimization.h"
+#include "testing/testing.h"
+
+namespace libmv {
+namespace {
+
+// The exact relative poses between every pair of cameras of d.
+void ExactRelativePoses(const NViewDataSet &d,
+                        std::vector<RelativePose> *poses) {
+  for (int i = 0; i < d.n; ++i) {
+    for (int j = i + 1; j < d.n; ++j) {
+      RelativePose pose;
+      pose.image1 = i;
+      pose.image2 = j;
+      pose.R = d.R[j] * d.R[i].transpose();
+      pose.t = (d.t[j] - pose.R * d.t[i]).normalized();
+      pose.num_inliers = 100;
+      poses->push_back(pose);
+    }
+  }
+}
+
+TEST(AverageRotations, RecoversTheRotationsDespiteAnOutlier) {
+  NViewDataSet d = NRealisticCamerasFull(8, 10);
+  std::vector<RelativePose> poses;
+  ExactRelativePoses(d, &poses);
+  // A relative rotation off by about 30 degrees.
+  poses[3].R = RotationAroundZ(0.5) * poses[3].R;
+
+  vector<Mat3> Rs;
+  EXPECT_EQ(8, AverageRotations(d.n, poses, &Rs));
+  // The gauge fixes the rotation of the first camera to the identity.
+  for (int i = 0; i < d.n; ++i) {
+    Mat3 expected_R = d.R[i] * d.R[0].transpose();
+    EXPECT_MATRIX_NEAR(expected_R, Rs[i], 1e-6);
+  }
+  for (int k = 0; k < poses.size(); ++k) {
+    if (k == 3) {
+      EXPECT_NEAR(0.5, RelativeRotationError(poses[k], Rs), 1e-6);
+    } else {
+      EXPECT_NEAR(0, RelativeRotationError(poses[k], Rs), 1e-6);
+    }
+  }
+}
+
+TEST(AverageRotations, OnlyReachesTheComponentOfTheFirstImage) {
+  NViewDataSet d = NRealisticCamerasFull(4, 10);
+  std::vector<RelativePose> poses;
+  ExactRelativePoses(d, &poses);
+  std::vector<RelativePose> connected;
+  for (int k = 0; k < poses.size(); ++k) {
+    if (poses[k].image2 != 3) {
+      connected.push_back(poses[k]);
+    }
+  }
+  vector<Mat3> Rs;
+  EXPECT_EQ(3, AverageRotations(d.n, connected, &Rs));
+  Mat3 identity = Mat3::Identity();
+  EXPECT_MATRIX_NEAR(identity, Rs[3], 1e-12);
+}
+
+TEST(AverageTranslations, RecoversTheCentersUpToScale) {
+  NViewDataSet d = NRealisticCamerasFull(6, 10);
+  std::vector<RelativePose> poses;
+  ExactRelativePoses(d, &poses);
+
+  vector<Vec3> centers;
+  AverageTranslations(d.R, poses, &centers);
+  ASSERT_EQ(6, centers.size());
+  Vec3 zero = Vec3::Zero();
+  EXPECT_MATRIX_NEAR(zero, centers[0], 1e-12);
+  Vec3 c0 = d.C[0];
+  double scale = (d.C[1] - c0).norm() / centers[1].norm();
+  for (int i = 1; i < d.n; ++i) {
+    Vec3 expected_baseline = d.C[i] - c0;
+    Vec3 baseline = scale * centers[i];
+    EXPECT_MATRIX_NEAR(expected_baseline, baseline, 1e-6);
+  }
+}
+
+TEST(GlobalEuclideanReconstruction, ReconstructsAnImageSet) {
+  NViewDataSet d = NRealisticCamerasFull(6, 100);
+  // The principal point of an image of width w is at w / 2 - 0.5.
+  Matches matches;
+  std::list<Feature *> features;
+  for (int n = 0; n < d.n; ++n) {
+    for (int p = 0; p < d.x[n].cols(); ++p) {
+      PointFeature *feature = new PointFeature(d.x[n](0, p) - 0.5,
+                                               d.x[n](1, p) - 0.5);
+      features.push_back(feature);
+      matches.Insert(n, p, feature);
+    }
+  }
+  vector<std::pair<size_t, size_t> > image_sizes;
+  for (int n = 0; n < d.n; ++n) {
+    image_sizes.push_back(std::make_pair(size_t(2 * d.K[n](0, 2)),
+                                         size_t(2 * d.K[n](1, 2))));
+  }
+  std::list<Reconstruction *> reconstructions;
+  EXPECT_TRUE(EuclideanReconstructionFromImageSet(matches, image_sizes,
+                                                  d.K[0](0, 0),
+                                                  &reconstructions));
+  ASSERT_EQ(1, reconstructions.size());
+  Reconstruction *reconstruction = reconstructions.front();
+  EXPECT_EQ(6, reconstruction->GetNumberCameras());
+  EXPECT_EQ(100, reconstruction->GetNumberStructures());
+  EXPECT_LT(EstimateRootMeanSquareError(matches, reconstruction), 1e-3);
+
+  // The relative motions are those of the data set, up to scale.
+  PinholeCamera *camera0 =
+      dynamic_cast<PinholeCamera *>(reconstruction->GetCamera(0));
+  PinholeCamera *camera1 =
+      dynamic_cast<PinholeCamera *>(reconstruction->GetCamera(1));
+  ASSERT_TRUE(camera0 != NULL && camera1 != NULL);
+  Mat3 expected_dR = d.R[1] * d.R[0].transpose();
+  Mat3 dR = camera1->orientation_matrix() *
+            camera0->orientation_matrix().transpose();
+  EXPECT_MATRIX_NEAR(expected_dR, dR, 1e-4);
+
+  reconstruction->ClearCamerasMap();
+  reconstruction->ClearStructuresMap();
+  delete reconstruction;
+  std::list<Feature *>::iterator features_iter = features.begin();
+  for (; features_iter != features.end(); ++features_iter)
+    delete *features_iter;
+}
+
+}  // namespace
+}  // namespace libmv
@@ -29,9 +29,12 @@ namespace libmv {
 // criterion: median homography error x number of common matches
 // The outpout images_list contains a list of connected graphs
 // (vectors), each vector contains the ImageID ordered by the criterion.
+// The pairwise criteria are computed once, on num_threads threads, by a
+// ViewGraph (see view_graph.h).
 void SelectEfficientImageOrder(
   const Matches &matches, 
-  std::list<vector<Matches::ImageID> >*images_list);
+  std::list<vector<Matches::ImageID> >*images_list,
+  int num_threads = 1);
 
 }  // namespace libmv
 
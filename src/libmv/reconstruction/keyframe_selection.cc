@@ -26,6 +26,7 @@
 #include "libmv/multiview/robust_fundamental.h"
 #include "libmv/multiview/robust_homography.h"
 #include "libmv/correspondence/matches.h"
+#include "libmv/correspondence/track_bitset.h"
 #include "libmv/reconstruction/keyframe_selection.h"
 
 namespace libmv {
@@ -46,18 +47,16 @@ void SelectKeyframesBasedOnMatchesNumber(const Matches &matches,
                              matches.NumFeatureImage(prev_keyframe);
   num_features_to_keep = std::max(num_features_to_keep, min_num_matches); 
   VLOG(3) << "# Features to keep: " << num_features_to_keep<< std::endl;
-  vector<Matches::ImageID> two_images;
-  two_images.push_back(prev_keyframe);
+  CovisibilityIndex covisibility;
+  covisibility.Build(matches);
   for (;image_iter != matches.get_images().end(); ++image_iter) {
-    two_images.push_back(*image_iter);
-    // TODO(julien) make a new function that just count the common tracks!
-    vector<Matches::TrackID> tracks;
-    TracksInAllImages(matches, two_images, &tracks);
-    VLOG(3) << "Shared tracks: " << tracks.size() << std::endl;
+    int num_shared_tracks =
+      covisibility.NumSharedTracks(prev_keyframe, *image_iter);
+    VLOG(3) << "Shared tracks: " << num_shared_tracks << std::endl;
     // If the current frame share not enough common matches with the previous 
     // keyframe then we select the previous frame 
     // i.e. the one that has enough common matches
-    if (tracks.size() < num_features_to_keep && 
+    if (num_shared_tracks < num_features_to_keep && 
         prev_frame_good != prev_keyframe) {
       VLOG(2) << "Keyframe Detected!" << std::endl;
       keyframes->push_back(prev_frame_good);
@@ -66,15 +65,89 @@ void SelectKeyframesBasedOnMatchesNumber(const Matches &matches,
                              matches.NumFeatureImage(prev_keyframe);
       num_features_to_keep = std::max(num_features_to_keep, min_num_matches);
       VLOG(3) << "# Features to keep: " << num_features_to_keep<< std::endl;
-      two_images.clear();
-      two_images.push_back(prev_keyframe);
     } else {
       prev_frame_good = *image_iter;
-      two_images.pop_back();
     }
   }
 }
 
+OnlineKeyframeSelector::OnlineKeyframeSelector(float min_matches_pc,
+                                               int min_num_matches)
+  : min_matches_pc_(min_matches_pc), min_num_matches_(min_num_matches),
+    num_features_to_keep_(0), has_previous_good_(false), previous_good_(0) {
+}
+
+void OnlineKeyframeSelector::SetKeyframe(
+    Matches::ImageID image,
+    const vector<Matches::TrackID> &tracks) {
+  for (int i = 0; i < keyframe_tracks_.size(); ++i) {
+    is_keyframe_track_[keyframe_tracks_[i]] = 0;
+  }
+  keyframe_tracks_ = tracks;
+  for (int i = 0; i < tracks.size(); ++i) {
+    CHECK_GE(tracks[i], 0);
+    if (tracks[i] >= int(is_keyframe_track_.size())) {
+      is_keyframe_track_.resize(std::max(tracks[i] + 1,
+                                         2 * int(is_keyframe_track_.size())),
+                                0);
+    }
+    is_keyframe_track_[tracks[i]] = 1;
+  }
+  keyframes_.push_back(image);
+  num_features_to_keep_ = min_matches_pc_ * tracks.size();
+  num_features_to_keep_ = std::max(num_features_to_keep_, min_num_matches_);
+  VLOG(3) << "# Features to keep: " << num_features_to_keep_ << std::endl;
+  // The keyframe is the last good frame.
+  has_previous_good_ = false;
+}
+
+bool OnlineKeyframeSelector::AddFrame(Matches::ImageID image,
+                                      const vector<Matches::TrackID> &tracks,
+                                      Matches::ImageID *keyframe) {
+  if (keyframes_.size() == 0) {
+    // The first frame is selected as a keyframe
+    SetKeyframe(image, tracks);
+    if (keyframe) {
+      *keyframe = image;
+    }
+    return true;
+  }
+  int num_shared_tracks = 0;
+  for (int i = 0; i < tracks.size(); ++i) {
+    Matches::TrackID track = tracks[i];
+    num_shared_tracks += track >= 0 &&
+                         track < int(is_keyframe_track_.size()) &&
+                         is_keyframe_track_[track];
+  }
+  VLOG(3) << "Shared tracks: " << num_shared_tracks << std::endl;
+  // If the current frame share not enough common matches with the previous 
+  // keyframe then we select the previous frame 
+  // i.e. the one that has enough common matches
+  if (num_shared_tracks < num_features_to_keep_ && has_previous_good_) {
+    VLOG(2) << "Keyframe Detected!" << std::endl;
+    Matches::ImageID selected = previous_good_;
+    SetKeyframe(selected, previous_good_tracks_);
+    if (keyframe) {
+      *keyframe = selected;
+    }
+    return true;
+  }
+  has_previous_good_ = true;
+  previous_good_ = image;
+  previous_good_tracks_ = tracks;
+  return false;
+}
+
+bool OnlineKeyframeSelector::AddFrame(const Matches &matches,
+                                      Matches::ImageID image,
+                                      Matches::ImageID *keyframe) {
+  vector<Matches::TrackID> tracks;
+  for (Matches::Points r = matches.InImage<PointFeature>(image); r; ++r) {
+    tracks.push_back(r.track());
+  }
+  return AddFrame(image, tracks, keyframe);
+}
+
 /*
  * Not yet finished 
  * TODO(julien) It really doesn't work: Finish this function!
@@ -21,6 +21,8 @@
 #ifndef LIBMV_RECONSTRUCTION_KEYFRAME_SELECTION_H_
 #define LIBMV_RECONSTRUCTION_KEYFRAME_SELECTION_H_
 
+#include <vector>
+
 #include "libmv/reconstruction/reconstruction.h"
 
 namespace libmv {
@@ -37,6 +39,53 @@ void SelectKeyframesBasedOnMatchesNumber(const Matches &matches,
                                          vector<Matches::ImageID> *keyframes,
                                          float min_matches_pc = 0.15,
                                          int min_num_matches = 50);
+
+// Same selection as SelectKeyframesBasedOnMatchesNumber(), done online: the
+// frames are given in order as the tracker outputs them, with the tracks of
+// their point features, so that the reconstruction can start before the end
+// of the tracking. Since a frame is selected when the next one does not share
+// enough tracks with the last keyframe, a keyframe is known one frame late.
+//
+// The tracks of the last keyframe are flagged in an array indexed by track
+// (the tracker numbers its tracks from zero), so each frame costs
+// O(number of its features).
+class OnlineKeyframeSelector {
+ public:
+  OnlineKeyframeSelector(float min_matches_pc = 0.15,
+                         int min_num_matches = 50);
+
+  // Adds the next frame. Returns true if a keyframe has been selected (the
+  // first frame, or the one before image), which is stored in keyframe if it
+  // is not NULL.
+  bool AddFrame(Matches::ImageID image,
+                const vector<Matches::TrackID> &tracks,
+                Matches::ImageID *keyframe = NULL);
+
+  // Same as above with the tracks of the point features of image in matches.
+  bool AddFrame(const Matches &matches,
+                Matches::ImageID image,
+                Matches::ImageID *keyframe = NULL);
+
+  const vector<Matches::ImageID> &keyframes() const { return keyframes_; }
+
+ private:
+  void SetKeyframe(Matches::ImageID image,
+                   const vector<Matches::TrackID> &tracks);
+
+  float min_matches_pc_;
+  int min_num_matches_;
+  vector<Matches::ImageID> keyframes_;
+
+  // The tracks of the last keyframe, and their flags.
+  vector<Matches::TrackID> keyframe_tracks_;
+  std::vector<char> is_keyframe_track_;
+  int num_features_to_keep_;
+
+  // The last frame sharing enough tracks with the last keyframe.
+  bool has_previous_good_;
+  Matches::ImageID previous_good_;
+  vector<Matches::TrackID> previous_good_tracks_;
+};
 }  // namespace libmv
 
 #endif  // LIBMV_RECONSTRUCTION_KEYFRAME_SELECTION_H_
@@ -0,0 +1,73 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <list>
+
+#include "libmv/correspondence/feature.h"
+#include "libmv/correspondence/matches.h"
+#include "libmv/reconstruction/keyframe_selection.h"
+#include "testing/testing.h"
+
+namespace libmv {
+namespace {
+
+TEST(OnlineKeyframeSelector, SameKeyframesAsTheBatchSelection) {
+  // Every frame starts 10 tracks which last 25 frames.
+  const int kNumFrames = 60;
+  Matches matches;
+  std::list<Feature *> features;
+  for (int frame = 0; frame < kNumFrames; ++frame) {
+    for (int start = std::max(0, frame - 24); start <= frame; ++start) {
+      for (int i = 0; i < 10; ++i) {
+        PointFeature *feature = new PointFeature(frame, i);
+        features.push_back(feature);
+        matches.Insert(frame, 10 * start + i, feature);
+      }
+    }
+  }
+  vector<Matches::ImageID> expected;
+  SelectKeyframesBasedOnMatchesNumber(matches, &expected, 0.15, 50);
+  EXPECT_GT(expected.size(), 2);
+
+  OnlineKeyframeSelector selector(0.15, 50);
+  vector<Matches::ImageID> online;
+  for (int frame = 0; frame < kNumFrames; ++frame) {
+    Matches::ImageID keyframe;
+    if (selector.AddFrame(matches, frame, &keyframe)) {
+      // A keyframe is known at most one frame late.
+      EXPECT_TRUE(keyframe == frame || keyframe == frame - 1);
+      online.push_back(keyframe);
+    }
+  }
+  ASSERT_EQ(expected.size(), online.size());
+  ASSERT_EQ(expected.size(), selector.keyframes().size());
+  for (int i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i], online[i]);
+    EXPECT_EQ(expected[i], selector.keyframes()[i]);
+  }
+
+  std::list<Feature *>::iterator it = features.begin();
+  for (; it != features.end(); ++it) {
+    delete *it;
+  }
+}
+
+}  // namespace
+}  // namespace libmv
@@ -18,19 +18,109 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <map>
+
+#include "libmv/base/thread.h"
+#include "libmv/multiview/batch_triangulation.h"
 #include "libmv/multiview/conditioning.h"
 #include "libmv/multiview/nviewtriangulation.h"
 #include "libmv/reconstruction/mapping.h"
 #include "libmv/reconstruction/tools.h"
 
 namespace libmv {
+namespace {
+
+// Triangulates the point track structures_ids[t] with
+// NViewTriangulateAlgebraic() from its observations in the images that have a
+// camera. Each call only reads matches and the reconstruction and writes the
+// slot t of the outputs, so that the tracks can be spread over threads and the
+// reconstruction updated afterwards in the order of the tracks.
+struct AlgebraicTrackTriangulation {
+  const Matches *matches;
+  const Reconstruction *reconstruction;
+  const vector<StructureID> *structures_ids;
+  // Applied to the observations before the triangulation.
+  Mat3 precond;
+  // Whether precond is also applied to the projection matrices.
+  bool precondition_cameras;
+  // Whether the points at infinity are outliers.
+  bool reject_points_at_infinity;
+  // The tracks seen in fewer images are skipped.
+  size_t minimum_num_views;
+
+  Mat4X *X_world;
+  // 1 if the track has been triangulated and is an inlier.
+  std::vector<char> *is_inlier;
+
+  void operator()(int t) const {
+    (*is_inlier)[t] = false;
+    vector<Mat34> Ps;
+    vector<Vec2> xs;
+    Vec2 x_feature;
+    Matches::Features<PointFeature> fp =
+      matches->InTrack<PointFeature>((*structures_ids)[t]);
+    while (fp) {
+      PinholeCamera *camera = dynamic_cast<PinholeCamera *>(
+        reconstruction->GetCamera(fp.image()));
+      if (camera) {
+        if (precondition_cameras) {
+          Ps.push_back(precond * camera->projection_matrix());
+        } else {
+          Ps.push_back(camera->projection_matrix());
+        }
+        x_feature << fp.feature()->x(), fp.feature()->y();
+        xs.push_back(x_feature);
+      }
+      fp.operator++();
+    }
+    if (Ps.size() < minimum_num_views) {
+      return;
+    }
+    Mat2X x(2, xs.size());
+    VectorToMatrix<Vec2, Mat2X>(xs, &x);
+    Mat xn;
+    ApplyTransformationToPoints(x, precond, &xn);
+    // TODO(julien) avoid this copy
+    x = xn;
+    Mat41 X;
+    NViewTriangulateAlgebraic<double>(x, Ps, &X);
+    // Let's remove the point if it has NaN values
+    if (isnan(X.sum()))
+      return;
+    if (reject_points_at_infinity && X(3, 0) == 0)
+      return;
+    // Let's remove the point if it is reconstructed behind one camera
+    for (int cam = 0; cam < Ps.size(); ++cam) {
+      if (!isInFrontOfCamera(Ps[cam], X))
+        return;
+    }
+    X_world->col(t) = X;
+    (*is_inlier)[t] = true;
+  }
+};
+
+// Triangulates all the tracks of structures_ids on num_threads threads.
+void TriangulateTracks(AlgebraicTrackTriangulation *triangulation,
+                       int num_threads,
+                       Mat4X *X_world,
+                       std::vector<char> *is_inlier) {
+  const int num_tracks = triangulation->structures_ids->size();
+  X_world->resize(4, num_tracks);
+  is_inlier->resize(num_tracks);
+  triangulation->X_world = X_world;
+  triangulation->is_inlier = is_inlier;
+  ParallelForDynamic(0, num_tracks, num_threads, triangulation);
+}
+
+}  // namespace
 
 uint PointStructureTriangulationCalibrated(
    const Matches &matches, 
    CameraID image_id, 
    size_t minimum_num_views, 
    Reconstruction *reconstruction,
-   vector<StructureID> *new_structures_ids) {
+   vector<StructureID> *new_structures_ids,
+   int num_threads) {
   // Checks that the camera is in reconstruction
   if (!reconstruction->ImageHasCamera(image_id)) {
       VLOG(1)   << "Error: the image " << image_id 
@@ -39,83 +129,85 @@ uint PointStructureTriangulationCalibrated(
   }
   vector<StructureID> structures_ids;
   Mat2X x_image;
-  vector<Mat34> Ps; // Contains the projection matrices
-  vector<Vec2> xs; 
-  Vec2 x;
   // Selects only the unreconstructed tracks observed in the image
   SelectNonReconstructedPointStructures(matches, image_id, *reconstruction,
                                         &structures_ids, &x_image);
   VLOG(3)   << "Structure points selected:" << x_image.cols() << std::endl;
-  // Computes an isotropic normalization
-  Mat3 precond;
-  IsotropicPreconditionerFromPoints(x_image, &precond);
-  // Selects the point structures that are observed at least in
-  // minimum_num_views images (images that have an already localized camera) 
-  Mat41 X_world;
-  uint number_new_structure = 0;
-  if (new_structures_ids)
-    new_structures_ids->reserve(structures_ids.size());
+  // Gathers the observations of the point structures that are observed at
+  // least in minimum_num_views images (images that have an already localized
+  // camera), as a compressed sparse row list for TriangulatePoints().
+  vector<Mat34> Ps; // Contains the projection matrices
+  std::map<CameraID, int> camera_indices;
+  vector<StructureID> triangulated_ids;
+  vector<int> offsets, cameras;
+  vector<Vec2> xs; 
+  Vec2 x;
+  offsets.push_back(0);
   PinholeCamera *camera = NULL;
   for (size_t t = 0; t < structures_ids.size(); ++t) {
     Matches::Features<PointFeature> fp =
       matches.InTrack<PointFeature>(structures_ids[t]);
-    Ps.clear();
-    xs.clear();
     while (fp) {
       camera = dynamic_cast<PinholeCamera *>(
         reconstruction->GetCamera(fp.image()));
       if (camera) {
-        Ps.push_back(precond * camera->projection_matrix()); 
+        std::map<CameraID, int>::iterator it =
+            camera_indices.find(fp.image());
+        if (it == camera_indices.end()) {
+          it = camera_indices.insert(
+              std::make_pair(fp.image(), int(Ps.size()))).first;
+          Ps.push_back(camera->projection_matrix());
+        }
+        cameras.push_back(it->second);
         x << fp.feature()->x(), fp.feature()->y();
         xs.push_back(x);
       }
       fp.operator++();
     }
-    if (Ps.size() >= minimum_num_views) {
-      Mat2X x(2, xs.size());
-      VectorToMatrix<Vec2, Mat2X>(xs, &x);
-      Mat xn;
-      ApplyTransformationToPoints(x, precond, &xn);
-      // TODO(julien) avoid this copy
-      x = xn;
-      NViewTriangulateAlgebraic<double>(x, Ps, &X_world);
-      bool is_inlier = true;
-      // Let's remove the point if it has NaN values
-      if (isnan(X_world.sum()))
-        is_inlier = false;
-      // Let's remove the point if it is at infinity
-      if (X_world(3,0) == 0)
-        is_inlier = false;   
-      // Let's remove the point if it is reconstructed behind one camera
-      for (int cam = 0; cam < Ps.size(); ++cam) {
-        if (!isInFrontOfCamera(Ps[cam], X_world)) {
-          is_inlier = false;   
-          break;
-        }
-        /* TODO(julien) Check the reprojection error?
-        Vec2 q2; double err = 0;
-        HomogeneousToEuclidean((precond.inverse() * Ps[0] * X_world).col(0), &q2);
-        Vec3 x3;
-        x3 << x.col(0), 1;
-        x3 = precond.inverse() * x3;
-        err = (x3.block<2,1>(0, 0) - q2).norm();
-        VLOG(1)   << "Prj:" << err << "px";
-        */
-      }
-      if (is_inlier) {
-        // Creates an add the point structure to the reconstruction
-        PointStructure * p = new PointStructure();
-        p->set_coords(X_world.col(0));
-        reconstruction->InsertTrack(structures_ids[t], p);
-        if (new_structures_ids)
-          new_structures_ids->push_back(structures_ids[t]);
-        number_new_structure++;
-        VLOG(4)   << "Add Point Structure ["
-                  << structures_ids[t] <<"] "
-                  << p->coords().transpose() << " ("
-                  << p->coords().transpose() / p->coords()[3] << ")"
-                  << std::endl;
-      }
+    int num_views = cameras.size() - offsets[offsets.size() - 1];
+    if (num_views >= minimum_num_views) {
+      offsets.push_back(cameras.size());
+      triangulated_ids.push_back(structures_ids[t]);
+    } else {
+      cameras.resize(offsets[offsets.size() - 1]);
+      xs.resize(offsets[offsets.size() - 1]);
+    }
+  }
+  Mat2X x_tracks(2, xs.size());
+  VectorToMatrix<Vec2, Mat2X>(xs, &x_tracks);
+  Mat4X X_world;
+  vector<int> num_behind;
+  TriangulatePoints(Ps, offsets, cameras, x_tracks, num_threads, &X_world,
+                    NULL, &num_behind);
+
+  uint number_new_structure = 0;
+  if (new_structures_ids)
+    new_structures_ids->reserve(triangulated_ids.size());
+  for (int t = 0; t < triangulated_ids.size(); ++t) {
+    bool is_inlier = true;
+    // Let's remove the point if it has NaN values
+    if (isnan(X_world.col(t).sum()))
+      is_inlier = false;
+    // Let's remove the point if it is at infinity
+    if (X_world(3, t) == 0)
+      is_inlier = false;   
+    // Let's remove the point if it is reconstructed behind one camera, or
+    // if its Z coordinate is not positive, as isInFrontOfCamera() checks
+    if (num_behind[t] > 0 || X_world(2, t) * X_world(3, t) <= 0)
+      is_inlier = false;   
+    if (is_inlier) {
+      // Creates an add the point structure to the reconstruction
+      PointStructure * p = new PointStructure();
+      p->set_coords(X_world.col(t));
+      reconstruction->InsertTrack(triangulated_ids[t], p);
+      if (new_structures_ids)
+        new_structures_ids->push_back(triangulated_ids[t]);
+      number_new_structure++;
+      VLOG(4)   << "Add Point Structure ["
+                << triangulated_ids[t] <<"] "
+                << p->coords().transpose() << " ("
+                << p->coords().transpose() / p->coords()[3] << ")"
+                << std::endl;
     }
   }
   return number_new_structure;
@@ -124,8 +216,8 @@ uint PointStructureTriangulationCalibrated(
 uint PointStructureRetriangulationCalibrated(
    const Matches &matches, 
    CameraID image_id,  
-   Reconstruction *reconstruction) {
-  // Checks that the camera is in reconstruction
+   Reconstruction *reconstruction,
+   int num_threads) {
   // Checks that the camera is in reconstruction
   if (!reconstruction->ImageHasCamera(image_id)) {
       VLOG(1)   << "Error: the image " << image_id 
@@ -134,67 +226,31 @@ uint PointStructureRetriangulationCalibrated(
   }
   vector<StructureID> structures_ids;
   Mat2X x_image;
-  vector<Mat34> Ps; // Contains the projection matrices
-  vector<Vec2> xs; 
-  Vec2 x;
   // Selects only the reconstructed structures observed in the image
   SelectExistingPointStructures(matches, image_id, *reconstruction,
                                 &structures_ids, &x_image);
+  AlgebraicTrackTriangulation triangulation;
+  triangulation.matches = &matches;
+  triangulation.reconstruction = reconstruction;
+  triangulation.structures_ids = &structures_ids;
   // Computes an isotropic normalization
-  Mat3 precond;
-  IsotropicPreconditionerFromPoints(x_image, &precond);
-  Mat41 X_world;
+  IsotropicPreconditionerFromPoints(x_image, &triangulation.precond);
+  triangulation.precondition_cameras = false;
+  triangulation.reject_points_at_infinity = true;
+  triangulation.minimum_num_views = 0;
+  Mat4X X_world;
+  std::vector<char> is_inlier;
+  TriangulateTracks(&triangulation, num_threads, &X_world, &is_inlier);
+
   uint number_updated_structure = 0;
-  PinholeCamera *camera = NULL;
   PointStructure *pstructure = NULL;
   for (size_t t = 0; t < structures_ids.size(); ++t) {
-    Matches::Features<PointFeature> fp =
-      matches.InTrack<PointFeature>(structures_ids[t]);
-    Ps.clear();
-    xs.clear();
-    while (fp) {
-      camera = dynamic_cast<PinholeCamera *>(
-        reconstruction->GetCamera(fp.image()));
-      if (camera) {
-        Ps.push_back(camera->projection_matrix()); 
-        x << fp.feature()->x(), fp.feature()->y();
-        xs.push_back(x);
-      }
-      fp.operator++();
-    }
-    Mat2X x(2, xs.size());
-    VectorToMatrix<Vec2, Mat2X>(xs, &x);
-    Mat xn;
-    ApplyTransformationToPoints(x, precond, &xn);
-    // TODO(julien) avoid this copy
-    x = xn;
-    NViewTriangulateAlgebraic<double>(x, Ps, &X_world);
-    bool is_inlier = true;
-    if (isnan(X_world.sum()))
-      is_inlier = false;
-    if (X_world(3,0) == 0)
-      is_inlier = false;
-    // Let's remove the point if it is reconstructed behind one camera
-    for (int cam = 0; cam < Ps.size(); ++cam) {
-      if (!isInFrontOfCamera(Ps[cam], X_world)) {
-        is_inlier = false;   
-        break;
-      }
-      /* TODO(julien) Check the reprojection error?
-       *  Vec2 q2; double err = 0;
-       *  HomogeneousToEuclidean((precond.inverse() * Ps[0] * X_world).col(0), &q2);
-       *  Vec3 x3;
-       *  x3 << x.col(0), 1;
-       *  x3 = precond.inverse() * x3;
-       *  err = (x3.block<2,1>(0, 0) - q2).norm();
-       *  VLOG(1)   << "Prj:" << err << "px";
-       */
-    }
-    // Creates an add the point structure to the reconstruction
+    // TODO(julien) Check the reprojection error?
+    // Updates the point structure of the reconstruction
     pstructure = dynamic_cast<PointStructure *>(
       reconstruction->GetStructure(structures_ids[t]));
-    if (is_inlier && pstructure) {
-      pstructure->set_coords(X_world.col(0));
+    if (is_inlier[t] && pstructure) {
+      pstructure->set_coords(X_world.col(t));
       number_updated_structure++;
       VLOG(4)   << "Point structure updated ["
                 << structures_ids[t] <<"] "
@@ -211,7 +267,8 @@ uint PointStructureTriangulationUncalibrated(
    CameraID image_id, 
    size_t minimum_num_views, 
    Reconstruction *reconstruction,
-   vector<StructureID> *new_structures_ids) {
+   vector<StructureID> *new_structures_ids,
+   int num_threads) {
   // Checks that the camera is in reconstruction
   if (!reconstruction->ImageHasCamera(image_id)) {
       VLOG(1)   << "Error: the image " << image_id 
@@ -220,69 +277,41 @@ uint PointStructureTriangulationUncalibrated(
   }
   vector<StructureID> structures_ids;
   Mat2X x_image;
-  vector<Mat34> Ps; // Contains the projection matrices
-  vector<Vec2> xs; 
-  Vec2 x;
   // Selects only the unreconstructed tracks observed in the image
   SelectNonReconstructedPointStructures(matches, image_id, *reconstruction,
                                         &structures_ids, &x_image);
   VLOG(3)   << "Structure points selected:" << x_image.cols() << std::endl;
-  // Computes an isotropic normalization
-  Mat3 precond;
-  IsotropicPreconditionerFromPoints(x_image, &precond);
-  // Selects the point structures that are observed at least in
+  // Triangulates the point structures that are observed at least in
   // minimum_num_views images (images that have an already localized camera) 
-  Mat41 X_world;
+  AlgebraicTrackTriangulation triangulation;
+  triangulation.matches = &matches;
+  triangulation.reconstruction = reconstruction;
+  triangulation.structures_ids = &structures_ids;
+  // Computes an isotropic normalization
+  IsotropicPreconditionerFromPoints(x_image, &triangulation.precond);
+  triangulation.precondition_cameras = true;
+  triangulation.reject_points_at_infinity = false;
+  triangulation.minimum_num_views = minimum_num_views;
+  Mat4X X_world;
+  std::vector<char> is_inlier;
+  TriangulateTracks(&triangulation, num_threads, &X_world, &is_inlier);
+
   uint number_new_structure = 0;
   if (new_structures_ids)
     new_structures_ids->reserve(structures_ids.size());
-  PinholeCamera *camera = NULL;
   for (size_t t = 0; t < structures_ids.size(); ++t) {
-    Matches::Features<PointFeature> fp =
-      matches.InTrack<PointFeature>(structures_ids[t]);
-    Ps.clear();
-    xs.clear();
-    while (fp) {
-      camera = dynamic_cast<PinholeCamera *>(
-        reconstruction->GetCamera(fp.image()));
-      if (camera) {
-        Ps.push_back(precond * camera->projection_matrix()); 
-        x << fp.feature()->x(), fp.feature()->y();
-        xs.push_back(x);
-      }
-      fp.operator++();
-    }
-    if (Ps.size() >= minimum_num_views) {
-      Mat2X x(2, xs.size());
-      VectorToMatrix<Vec2, Mat2X>(xs, &x);
-      Mat xn;
-      ApplyTransformationToPoints(x, precond, &xn);
-      // TODO(julien) avoid this copy
-      x = xn;
-      NViewTriangulateAlgebraic<double>(x, Ps, &X_world);
-      bool is_inlier = true;
-      // Let's remove the point if it has NaN values
-      if (isnan(X_world.sum()))
-        is_inlier = false;
-      for (int cam = 0; cam < Ps.size(); ++cam) {
-        if (!isInFrontOfCamera(Ps[cam], X_world)) {
-          is_inlier = false;   
-          break;
-        }
-      }
-      if (is_inlier) {
-        // Creates an add the point structure to the reconstruction
-        PointStructure * p = new PointStructure();
-        p->set_coords(X_world.col(0));
-        reconstruction->InsertTrack(structures_ids[t], p);
-        if (new_structures_ids)
-          new_structures_ids->push_back(structures_ids[t]);
-        number_new_structure++;
-        VLOG(4)   << "Add Point Structure ["
-                  << structures_ids[t] <<"] "
-                  << p->coords().transpose()
-                  << std::endl;
-      }
+    if (is_inlier[t]) {
+      // Creates an add the point structure to the reconstruction
+      PointStructure * p = new PointStructure();
+      p->set_coords(X_world.col(t));
+      reconstruction->InsertTrack(structures_ids[t], p);
+      if (new_structures_ids)
+        new_structures_ids->push_back(structures_ids[t]);
+      number_new_structure++;
+      VLOG(4)   << "Add Point Structure ["
+                << structures_ids[t] <<"] "
+                << p->coords().transpose()
+                << std::endl;
     }
   }
   return number_new_structure;
@@ -291,8 +320,8 @@ uint PointStructureTriangulationUncalibrated(
 uint PointStructureRetriangulationUncalibrated(
    const Matches &matches, 
    CameraID image_id,  
-   Reconstruction *reconstruction) {
-  // Checks that the camera is in reconstruction
+   Reconstruction *reconstruction,
+   int num_threads) {
   // Checks that the camera is in reconstruction
   if (!reconstruction->ImageHasCamera(image_id)) {
       VLOG(1)   << "Error: the image " << image_id 
@@ -301,55 +330,30 @@ uint PointStructureRetriangulationUncalibrated(
   }
   vector<StructureID> structures_ids;
   Mat2X x_image;
-  vector<Mat34> Ps; 
-  vector<Vec2> xs; 
-  Vec2 x;
   // Selects only the reconstructed structures observed in the image
   SelectExistingPointStructures(matches, image_id, *reconstruction,
                                 &structures_ids, &x_image);
+  AlgebraicTrackTriangulation triangulation;
+  triangulation.matches = &matches;
+  triangulation.reconstruction = reconstruction;
+  triangulation.structures_ids = &structures_ids;
   // Computes an isotropic normalization
-  Mat3 precond;
-  IsotropicPreconditionerFromPoints(x_image, &precond);
-  Mat41 X_world;
+  IsotropicPreconditionerFromPoints(x_image, &triangulation.precond);
+  triangulation.precondition_cameras = false;
+  triangulation.reject_points_at_infinity = false;
+  triangulation.minimum_num_views = 0;
+  Mat4X X_world;
+  std::vector<char> is_inlier;
+  TriangulateTracks(&triangulation, num_threads, &X_world, &is_inlier);
+
   uint number_updated_structure = 0;
-  PinholeCamera *camera = NULL;
   PointStructure *pstructure = NULL;
   for (size_t t = 0; t < structures_ids.size(); ++t) {
-    Matches::Features<PointFeature> fp =
-      matches.InTrack<PointFeature>(structures_ids[t]);
-    Ps.clear();
-    xs.clear();
-    while (fp) {
-      camera = dynamic_cast<PinholeCamera *>(
-        reconstruction->GetCamera(fp.image()));
-      if (camera) {
-        Ps.push_back(camera->projection_matrix()); 
-        x << fp.feature()->x(), fp.feature()->y();
-        xs.push_back(x);
-      }
-      fp.operator++();
-    }
-    Mat2X x(2, xs.size());
-    VectorToMatrix<Vec2, Mat2X>(xs, &x);
-    Mat xn;
-    ApplyTransformationToPoints(x, precond, &xn);
-    // TODO(julien) avoid this copy
-    x = xn;
-    NViewTriangulateAlgebraic<double>(x, Ps, &X_world);
-    bool is_inlier = true;
-    if (isnan(X_world.sum()))
-      is_inlier = false;
-    for (int cam = 0; cam < Ps.size(); ++cam) {
-      if (!isInFrontOfCamera(Ps[cam], X_world)) {
-        is_inlier = false;   
-        break;
-      }
-    }
-    // Creates an add the point structure to the reconstruction
+    // Updates the point structure of the reconstruction
     pstructure = dynamic_cast<PointStructure *>(
       reconstruction->GetStructure(structures_ids[t]));
-    if (is_inlier && pstructure) {
-      pstructure->set_coords(X_world.col(0));
+    if (is_inlier[t] && pstructure) {
+      pstructure->set_coords(X_world.col(t));
       number_updated_structure++;
       VLOG(4)   << "Point structure updated ["
                 << structures_ids[t] <<"] "
@@ -34,6 +34,8 @@ namespace libmv {
 //    reconstructs the tracks into structures
 //    remove outliers (points behind one camera or at infinity) 
 //    creates and add them in reconstruction
+// The tracks are triangulated together by TriangulatePoints(), with
+// num_threads threads.
 // Returns the number of structures reconstructed and the list of triangulated
 // points
 uint PointStructureTriangulationCalibrated(
@@ -41,7 +43,8 @@ uint PointStructureTriangulationCalibrated(
    CameraID image_id, 
    size_t minimum_num_views, 
    Reconstruction *reconstruction,
-   vector<StructureID> *new_structures_ids = NULL);
+   vector<StructureID> *new_structures_ids = NULL,
+   int num_threads = 1);
 
 // Retriangulates point tracks observed in the image image_id using theirs
 // observations (matches)  when the instrinsic parameters are known.
@@ -52,11 +55,14 @@ uint PointStructureTriangulationCalibrated(
 //    reconstructs the tracks into structures
 //    remove outliers (points behind one camera or at infinity) 
 //    updates the coordinates in the reconstruction
+// The tracks are triangulated on num_threads threads, then the
+// reconstruction is updated in the order of the tracks.
 // Returns the number of structures retriangulated
 uint PointStructureRetriangulationCalibrated(
    const Matches &matches, 
    CameraID image_id,  
-   Reconstruction *reconstruction);
+   Reconstruction *reconstruction,
+   int num_threads = 1);
 
 // Reconstructs unreconstructed point tracks observed in the image image_id
 // using theirs observations (matches) when the instrinsic param. are unknown. 
@@ -67,6 +73,9 @@ uint PointStructureRetriangulationCalibrated(
 //    reconstructs the tracks into structures
 //    remove outliers (contains NaN coord) TODO(julien) do other tests (rms?)
 //    creates and add them in reconstruction
+// The tracks are triangulated on num_threads threads, then the structures are
+// added in the order of the tracks, so that the result does not depend on
+// num_threads.
 // Returns the number of structures reconstructed and the list of triangulated
 // points
 uint PointStructureTriangulationUncalibrated(
@@ -74,7 +83,8 @@ uint PointStructureTriangulationUncalibrated(
    CameraID image_id, 
    size_t minimum_num_views, 
    Reconstruction *reconstruction,
-   vector<StructureID> *new_structures_ids = NULL);
+   vector<StructureID> *new_structures_ids = NULL,
+   int num_threads = 1);
 
 // Retriangulates point tracks observed in the image image_id using theirs
 // observations (matches)  when the instrinsic parameters are unknown.  
@@ -85,11 +95,14 @@ uint PointStructureTriangulationUncalibrated(
 //    reconstructs the tracks into structures
 //    remove outliers (contains NaN coord) TODO(julien) do other tests (rms?)
 //    updates the coordinates in the reconstruction
+// The tracks are triangulated on num_threads threads, then the
+// reconstruction is updated in the order of the tracks.
 // Returns the number of structures retriangulated
 uint PointStructureRetriangulationUncalibrated(
    const Matches &matches, 
    CameraID image_id,  
-   Reconstruction *reconstruction);
+   Reconstruction *reconstruction,
+   int num_threads = 1);
 }  // namespace libmv
 
 #endif  // LIBMV_RECONSTRUCTION_MAPPING_H_
@@ -0,0 +1,701 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#include "libmv/base/cpu_features.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef LIBMV_HAVE_TARGET_X86
+#include <immintrin.h>
+#endif
+
+#include "libmv/base/memory_budget.h"
+#include "libmv/base/thread.h"
+#include "libmv/image/image_pyramid.h"
+#include "libmv/image/pyramid_sequence.h"
+#include "libmv/logging/logging.h"
+#include "libmv/reconstruction/multiview_stereo.h"
+
+namespace libmv {
+
+MultiViewStereoOptions::MultiViewStereoOptions()
+  : level(1),
+    num_source_views(4),
+    view_stride(2),
+    window_radius(4),
+    window_step(2),
+    num_depth_samples(32),
+    num_iterations(3),
+    min_ncc(0.5),
+    min_consistent_views(2),
+    max_depth_error(0.01),
+    num_threads(1),
+    memory_budget(0) {}
+
+namespace {
+
+typedef float (*NccFunction)(const float *a, const float *b, int n);
+
+struct NccSums {
+  float a, b, aa, bb, ab;
+};
+
+void AddNccSums(const float *a, const float *b, int begin, int n,
+                NccSums *sums) {
+  for (int i = begin; i < n; ++i) {
+    sums->a += a[i];
+    sums->b += b[i];
+    sums->aa += a[i] * a[i];
+    sums->bb += b[i] * b[i];
+    sums->ab += a[i] * b[i];
+  }
+}
+
+float NccFromSums(int n, const NccSums &sums) {
+  if (n == 0) {
+    return 0;
+  }
+  float var_a = sums.aa - sums.a * sums.a / n;
+  float var_b = sums.bb - sums.b * sums.b / n;
+  // Flat windows do not correlate with anything.
+  const float min_variance = 1e-6f * n;
+  if (var_a < min_variance || var_b < min_variance) {
+    return 0;
+  }
+  float ncc = (sums.ab - sums.a * sums.b / n) / std::sqrt(var_a * var_b);
+  return std::max(-1.0f, std::min(1.0f, ncc));
+}
+
+float NccScalar(const float *a, const float *b, int n) {
+  NccSums sums = { 0, 0, 0, 0, 0 };
+  AddNccSums(a, b, 0, n, &sums);
+  return NccFromSums(n, sums);
+}
+
+#ifdef __SSE2__
+inline float HorizontalSum(__m128 v) {
+  float x[4];
+  _mm_storeu_ps(x, v);
+  return (x[0] + x[1]) + (x[2] + x[3]);
+}
+
+float NccSSE2(const float *a, const float *b, int n) {
+  __m128 sum_a = _mm_setzero_ps();
+  __m128 sum_b = _mm_setzero_ps();
+  __m128 sum_aa = _mm_setzero_ps();
+  __m128 sum_bb = _mm_setzero_ps();
+  __m128 sum_ab = _mm_setzero_ps();
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 va = _mm_loadu_ps(a + i);
+    __m128 vb = _mm_loadu_ps(b + i);
+    sum_a = _mm_add_ps(sum_a, va);
+    sum_b = _mm_add_ps(sum_b, vb);
+    sum_aa = _mm_add_ps(sum_aa, _mm_mul_ps(va, va));
+    sum_bb = _mm_add_ps(sum_bb, _mm_mul_ps(vb, vb));
+    sum_ab = _mm_add_ps(sum_ab, _mm_mul_ps(va, vb));
+  }
+  NccSums sums = { HorizontalSum(sum_a), HorizontalSum(sum_b),
+                   HorizontalSum(sum_aa), HorizontalSum(sum_bb),
+                   HorizontalSum(sum_ab) };
+  AddNccSums(a, b, i, n, &sums);
+  return NccFromSums(n, sums);
+}
+#endif
+
+#ifdef LIBMV_HAVE_TARGET_X86
+LIBMV_TARGET_AVX2
+inline float HorizontalSum8(__m256 v) {
+  float x[8];
+  _mm256_storeu_ps(x, v);
+  return ((x[0] + x[1]) + (x[2] + x[3])) + ((x[4] + x[5]) + (x[6] + x[7]));
+}
+
+LIBMV_TARGET_AVX2
+float NccAVX2(const float *a, const float *b, int n) {
+  __m256 sum_a = _mm256_setzero_ps();
+  __m256 sum_b = _mm256_setzero_ps();
+  __m256 sum_aa = _mm256_setzero_ps();
+  __m256 sum_bb = _mm256_setzero_ps();
+  __m256 sum_ab = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 va = _mm256_loadu_ps(a + i);
+    __m256 vb = _mm256_loadu_ps(b + i);
+    sum_a = _mm256_add_ps(sum_a, va);
+    sum_b = _mm256_add_ps(sum_b, vb);
+    sum_aa = _mm256_fmadd_ps(va, va, sum_aa);
+    sum_bb = _mm256_fmadd_ps(vb, vb, sum_bb);
+    sum_ab = _mm256_fmadd_ps(va, vb, sum_ab);
+  }
+  NccSums sums = { HorizontalSum8(sum_a), HorizontalSum8(sum_b),
+                   HorizontalSum8(sum_aa), HorizontalSum8(sum_bb),
+                   HorizontalSum8(sum_ab) };
+  AddNccSums(a, b, i, n, &sums);
+  return NccFromSums(n, sums);
+}
+#endif
+
+const SimdDispatch<NccFunction> &Ncc() {
+  static const SimdDispatch<NccFunction> dispatch =
+      SimdDispatch<NccFunction>(NccScalar)
+#ifdef __SSE2__
+          .Add(SIMD_SSE2, NccSSE2)
+#endif
+#ifdef LIBMV_HAVE_TARGET_X86
+          .Add(SIMD_AVX2, NccAVX2)
+#endif
+      ;
+  return dispatch;
+}
+
+// A linear congruential generator, so that every view has its own
+// reproducible sequence whichever thread computes it.
+class Random {
+ public:
+  explicit Random(unsigned int seed) : state_(seed * 2654435761u + 1) {}
+
+  // Uniform in [0, 1).
+  float Uniform() {
+    state_ = state_ * 1664525u + 1013904223u;
+    return (state_ >> 8) * (1.0f / 16777216.0f);
+  }
+
+ private:
+  unsigned int state_;
+};
+
+// The bilinear sample of channel 0 of image, which has depth channels, at
+// (x, y) with 0 <= x < width - 1 and 0 <= y < height - 1.
+inline float SampleChannel0(const float *image, int width, int depth,
+                            float x, float y) {
+  int x0 = static_cast<int>(x);
+  int y0 = static_cast<int>(y);
+  float dx = x - x0;
+  float dy = y - y0;
+  const float *top = image + (y0 * width + x0) * depth;
+  const float *bottom = top + width * depth;
+  float top_value = top[0] + dx * (top[depth] - top[0]);
+  float bottom_value = bottom[0] + dx * (bottom[depth] - bottom[0]);
+  return top_value + dy * (bottom_value - top_value);
+}
+
+// Scores the inverse depths of the pixels of a reference view. A pixel
+// (x, y) at inverse depth w, on the plane parallel to the reference image,
+// projects in a source view at A * (x, y, 1) + b * w, so the windows are
+// warped by a homography that only changes with w through b.
+class DepthScorer {
+ public:
+  DepthScorer(const StereoView &reference,
+              const std::vector<StereoView> &sources,
+              const MultiViewStereoOptions &options)
+      : reference_(reference), ncc_(Ncc().Get()) {
+    int radius = options.window_radius;
+    int step = std::max(1, options.window_step);
+    for (int v = -radius; v <= radius; v += step) {
+      for (int u = -radius; u <= radius; u += step) {
+        us_.push_back(u);
+        vs_.push_back(v);
+      }
+    }
+    reference_samples_.resize(us_.size());
+    samples_.resize(us_.size());
+    scores_.resize(sources.size());
+
+    Mat3 K_inverse = reference.K.inverse();
+    for (size_t s = 0; s < sources.size(); ++s) {
+      Mat3 R = sources[s].R * reference.R.transpose();
+      Vec3 t = sources[s].t - R * reference.t;
+      Mat3 A = sources[s].K * R * K_inverse;
+      Vec3 b = sources[s].K * t;
+      Warp warp;
+      for (int i = 0; i < 9; ++i) {
+        warp.A[i] = A(i / 3, i % 3);
+      }
+      for (int i = 0; i < 3; ++i) {
+        warp.b[i] = b(i);
+      }
+      warp.image = sources[s].image;
+      warps_.push_back(warp);
+    }
+  }
+
+  // Loads the window of the reference pixel the next scores are for.
+  void SetPixel(int x, int y) {
+    x_ = x;
+    y_ = y;
+    const FloatImage &image = *reference_.image;
+    for (size_t k = 0; k < us_.size(); ++k) {
+      reference_samples_[k] = image(y + vs_[k], x + us_[k], 0);
+    }
+  }
+
+  // The mean NCC of the best half of the source views, or -1 if no view
+  // sees the whole window in front of it.
+  float Score(float w) {
+    int n = us_.size();
+    int num_scores = 0;
+    for (size_t s = 0; s < warps_.size(); ++s) {
+      const Warp &warp = warps_[s];
+      const float *A = warp.A;
+      float px = A[0] * x_ + A[1] * y_ + A[2] + warp.b[0] * w;
+      float py = A[3] * x_ + A[4] * y_ + A[5] + warp.b[1] * w;
+      float pz = A[6] * x_ + A[7] * y_ + A[8] + warp.b[2] * w;
+      const FloatImage &image = *warp.image;
+      float max_x = image.Width() - 1;
+      float max_y = image.Height() - 1;
+      int k = 0;
+      for (; k < n; ++k) {
+        float qz = pz + A[6] * us_[k] + A[7] * vs_[k];
+        if (qz <= 0) {
+          break;
+        }
+        float qx = (px + A[0] * us_[k] + A[1] * vs_[k]) / qz;
+        float qy = (py + A[3] * us_[k] + A[4] * vs_[k]) / qz;
+        if (!(qx >= 0 && qx < max_x && qy >= 0 && qy < max_y)) {
+          break;
+        }
+        samples_[k] = SampleChannel0(image.Data(), image.Width(),
+                                     image.Depth(), qx, qy);
+      }
+      if (k == n) {
+        scores_[num_scores++] = ncc_(&reference_samples_[0], &samples_[0], n);
+      }
+    }
+    if (num_scores == 0) {
+      return -1;
+    }
+    int num_best = (num_scores + 1) / 2;
+    std::partial_sort(scores_.begin(), scores_.begin() + num_best,
+                      scores_.begin() + num_scores, std::greater<float>());
+    float sum = 0;
+    for (int i = 0; i < num_best; ++i) {
+      sum += scores_[i];
+    }
+    return sum / num_best;
+  }
+
+ private:
+  struct Warp {
+    float A[9];
+    float b[3];
+    const FloatImage *image;
+  };
+
+  const StereoView &reference_;
+  NccFunction ncc_;
+  std::vector<float> us_, vs_;
+  std::vector<Warp> warps_;
+  std::vector<float> reference_samples_, samples_, scores_;
+  int x_, y_;
+};
+
+}  // namespace
+
+float NormalizedCrossCorrelation(const float *a, const float *b, int n) {
+  return Ncc().Get()(a, b, n);
+}
+
+void ComputeDepthMap(const StereoView &reference,
+                     const std::vector<StereoView> &sources,
+                     double min_depth, double max_depth,
+                     const MultiViewStereoOptions &options,
+                     DepthMap *depth_map) {
+  const FloatImage &image = *reference.image;
+  int width = image.Width();
+  int height = image.Height();
+  depth_map->depth.Resize(height, width);
+  depth_map->depth.Fill(0);
+  depth_map->score.Resize(height, width);
+  depth_map->score.Fill(-1);
+  int radius = options.window_radius;
+  if (sources.empty() || width <= 2 * radius || height <= 2 * radius ||
+      min_depth <= 0 || max_depth <= min_depth) {
+    return;
+  }
+
+  DepthScorer scorer(reference, sources, options);
+  Array3Df inverse_depth(height, width);
+  inverse_depth.Fill(0);
+  Array3Df &score = depth_map->score;
+  float min_w = 1 / max_depth;
+  float max_w = 1 / min_depth;
+  int num_samples = std::max(1, options.num_depth_samples);
+  float spacing = (max_w - min_w) / num_samples;
+
+  // Plane sweep.
+  for (int y = radius; y < height - radius; ++y) {
+    for (int x = radius; x < width - radius; ++x) {
+      scorer.SetPixel(x, y);
+      for (int i = 0; i < num_samples; ++i) {
+        float w = min_w + (i + 0.5f) * spacing;
+        float s = scorer.Score(w);
+        if (s > score(y, x)) {
+          score(y, x) = s;
+          inverse_depth(y, x) = w;
+        }
+      }
+    }
+  }
+
+  // PatchMatch: the passes alternate between sweeping the image from the top
+  // left and from the bottom right, trying the inverse depths of the left (or
+  // right) and top (or bottom) neighbours, and a random perturbation whose
+  // range halves at every pass.
+  Random random(reference.id);
+  float perturbation = spacing;
+  for (int iteration = 0; iteration < options.num_iterations; ++iteration) {
+    int step = iteration % 2 == 0 ? 1 : -1;
+    int begin_y = step > 0 ? radius : height - radius - 1;
+    int begin_x = step > 0 ? radius : width - radius - 1;
+    for (int j = 0; j < height - 2 * radius; ++j) {
+      int y = begin_y + step * j;
+      for (int i = 0; i < width - 2 * radius; ++i) {
+        int x = begin_x + step * i;
+        scorer.SetPixel(x, y);
+        float candidates[3];
+        int num_candidates = 0;
+        if (i > 0) {
+          candidates[num_candidates++] = inverse_depth(y, x - step);
+        }
+        if (j > 0) {
+          candidates[num_candidates++] = inverse_depth(y - step, x);
+        }
+        float w = inverse_depth(y, x) +
+                  (2 * random.Uniform() - 1) * perturbation;
+        candidates[num_candidates++] = std::max(min_w, std::min(max_w, w));
+        for (int c = 0; c < num_candidates; ++c) {
+          float s = scorer.Score(candidates[c]);
+          if (s > score(y, x)) {
+            score(y, x) = s;
+            inverse_depth(y, x) = candidates[c];
+          }
+        }
+      }
+    }
+    perturbation /= 2;
+  }
+
+  for (int y = radius; y < height - radius; ++y) {
+    for (int x = radius; x < width - radius; ++x) {
+      if (score(y, x) >= options.min_ncc) {
+        depth_map->depth(y, x) = 1 / inverse_depth(y, x);
+      }
+    }
+  }
+}
+
+namespace {
+
+// The depth map of a view and the pixels already fused into a point.
+struct ViewState {
+  DepthMap map;
+  std::vector<char> fused;
+
+  long long MemorySizeInBytes() const {
+    return map.depth.MemorySizeInBytes() + map.score.MemorySizeInBytes() +
+           fused.size();
+  }
+};
+
+// The source views of a view: the views i + k view_stride and
+// i - k view_stride, for k = 1, 2, ...
+void SourceViews(int view, int num_views, const MultiViewStereoOptions &options,
+                 std::vector<int> *sources) {
+  int stride = std::max(1, options.view_stride);
+  sources->clear();
+  for (int k = 1; sources->size() < options.num_source_views; ++k) {
+    int after = view + k * stride;
+    int before = view - k * stride;
+    if (after >= num_views && before < 0) {
+      break;
+    }
+    if (after < num_views) {
+      sources->push_back(after);
+    }
+    if (before >= 0 && sources->size() < options.num_source_views) {
+      sources->push_back(before);
+    }
+  }
+}
+
+// The range of the depths of the points seen by view, from the 5th to the
+// 95th percentile, widened by half. Returns false if it sees no point.
+bool DepthRange(const StereoView &view, const Vec2u &image_size,
+                const vector<Vec3> &points,
+                double *min_depth, double *max_depth) {
+  std::vector<double> depths;
+  for (int i = 0; i < points.size(); ++i) {
+    Vec3 x = view.K * (view.R * points[i] + view.t);
+    if (x(2) <= 0) {
+      continue;
+    }
+    // Without an image size, every point in front is seen.
+    if (image_size(0) && image_size(1) &&
+        (x(0) < 0 || x(0) >= image_size(0) * x(2) ||
+         x(1) < 0 || x(1) >= image_size(1) * x(2))) {
+      continue;
+    }
+    depths.push_back(x(2));
+  }
+  if (depths.empty()) {
+    return false;
+  }
+  std::sort(depths.begin(), depths.end());
+  *min_depth = depths[depths.size() * 5 / 100] / 1.5;
+  *max_depth = depths[(depths.size() - 1) * 95 / 100] * 1.5;
+  return true;
+}
+
+struct DepthMapTask {
+  void operator()(int i) {
+    double min_depth, max_depth;
+    if (!DepthRange((*views)[i], (*image_sizes)[i], *points,
+                    &min_depth, &max_depth)) {
+      return;
+    }
+    std::vector<StereoView> sources;
+    for (int s = 0; s < (*source_views)[i].size(); ++s) {
+      sources.push_back((*views)[(*source_views)[i][s]]);
+    }
+    ViewState *state = new ViewState;
+    ComputeDepthMap((*views)[i], sources, min_depth, max_depth, *options,
+                    &state->map);
+    state->fused.resize(state->map.depth.Size(), 0);
+    (*states)[i] = state;
+  }
+
+  const std::vector<StereoView> *views;
+  const std::vector<Vec2u> *image_sizes;
+  const std::vector<std::vector<int> > *source_views;
+  const vector<Vec3> *points;
+  const MultiViewStereoOptions *options;
+  std::vector<ViewState *> *states;
+};
+
+// Adds the points of the depth map of view that agree with the depth maps of
+// its sources, and marks the pixels of the sources they agree with as fused.
+void FuseDepthMap(int view,
+                  const std::vector<StereoView> &views,
+                  const std::vector<Mat3> &K_inverses,
+                  const std::vector<int> &sources,
+                  const MultiViewStereoOptions &options,
+                  const std::vector<ViewState *> &states,
+                  vector<Vec3> *points,
+                  vector<float> *intensities) {
+  ViewState *state = states[view];
+  if (!state) {
+    return;
+  }
+  const StereoView &reference = views[view];
+  const Array3Df &depth = state->map.depth;
+  std::vector<std::pair<int, int> > agreeing;
+  for (int y = 0; y < depth.Height(); ++y) {
+    for (int x = 0; x < depth.Width(); ++x) {
+      double d = depth(y, x);
+      if (d <= 0 || state->fused[y * depth.Width() + x]) {
+        continue;
+      }
+      Vec3 X = reference.R.transpose() *
+               (d * K_inverses[view] * Vec3(x, y, 1) - reference.t);
+      Vec3 sum = X;
+      agreeing.clear();
+      for (int s = 0; s < sources.size(); ++s) {
+        int other = sources[s];
+        if (!states[other]) {
+          continue;
+        }
+        const StereoView &source = views[other];
+        const Array3Df &source_depth = states[other]->map.depth;
+        Vec3 Xs = source.R * X + source.t;
+        if (Xs(2) <= 0) {
+          continue;
+        }
+        Vec3 q = source.K * Xs;
+        int u = static_cast<int>(std::floor(q(0) / q(2) + 0.5));
+        int v = static_cast<int>(std::floor(q(1) / q(2) + 0.5));
+        if (u < 0 || u >= source_depth.Width() ||
+            v < 0 || v >= source_depth.Height()) {
+          continue;
+        }
+        double ds = source_depth(v, u);
+        if (ds <= 0 || std::fabs(ds - Xs(2)) > options.max_depth_error * Xs(2)) {
+          continue;
+        }
+        sum += source.R.transpose() *
+               (ds * K_inverses[other] * Vec3(u, v, 1) - source.t);
+        agreeing.push_back(std::make_pair(other, v * source_depth.Width() + u));
+      }
+      if (agreeing.size() < options.min_consistent_views) {
+        continue;
+      }
+      points->push_back(sum / (agreeing.size() + 1));
+      intensities->push_back((*reference.image)(y, x, 0));
+      for (int a = 0; a < agreeing.size(); ++a) {
+        states[agreeing[a].first]->fused[agreeing[a].second] = 1;
+      }
+    }
+  }
+}
+
+}  // namespace
+
+bool MultiViewStereo(const Reconstruction &reconstruction,
+                     PyramidSequence *pyramids,
+                     const MultiViewStereoOptions &options,
+                     vector<Vec3> *points,
+                     vector<float> *intensities) {
+  points->clear();
+  intensities->clear();
+
+  // The cameras, scaled to the pyramid level, in the order of their ids.
+  double scale = 1.0 / (1 << options.level);
+  Mat3 S;
+  S << scale, 0, 0,
+       0, scale, 0,
+       0, 0, 1;
+  std::vector<StereoView> views;
+  std::vector<Vec2u> image_sizes;
+  std::map<CameraID, Camera *>::const_iterator camera_iter =
+    reconstruction.cameras().begin();
+  for (; camera_iter != reconstruction.cameras().end(); ++camera_iter) {
+    PinholeCamera *camera = dynamic_cast<PinholeCamera *>(camera_iter->second);
+    if (!camera) {
+      continue;
+    }
+    StereoView view;
+    view.id = camera_iter->first;
+    view.K = S * camera->intrinsic_matrix();
+    view.R = camera->orientation_matrix();
+    view.t = camera->position();
+    view.image = NULL;
+    views.push_back(view);
+    Vec2u size = camera->image_size();
+    size(0) = static_cast<uint>(size(0) * scale);
+    size(1) = static_cast<uint>(size(1) * scale);
+    image_sizes.push_back(size);
+  }
+  int num_views = views.size();
+  if (num_views < 2) {
+    return false;
+  }
+  vector<Vec3> sparse_points;
+  std::map<StructureID, Structure *>::const_iterator track_iter =
+    reconstruction.structures().begin();
+  for (; track_iter != reconstruction.structures().end(); ++track_iter) {
+    PointStructure *point =
+      dynamic_cast<PointStructure *>(track_iter->second);
+    if (point) {
+      sparse_points.push_back(point->coords_affine());
+    }
+  }
+  std::vector<std::vector<int> > source_views(num_views);
+  std::vector<Mat3> K_inverses(num_views);
+  for (int i = 0; i < num_views; ++i) {
+    SourceViews(i, num_views, options, &source_views[i]);
+    K_inverses[i] = views[i].K.inverse();
+  }
+
+  // The sources of a view are at most reach views away from it. A depth map
+  // is fused once the depth maps of its sources are computed, and dropped
+  // once the views it is a source of are fused; an image is released once
+  // its view is fused and no view left to compute uses it.
+  int reach = std::max(1, options.num_source_views) *
+              std::max(1, options.view_stride);
+  std::vector<ViewState *> states(num_views, static_cast<ViewState *>(NULL));
+  int batch = 2 * std::max(1, options.num_threads);
+  MemoryUsage memory(MEMORY_DEPTH_MAPS);
+  bool ok = true;
+  int computed = 0, fused = 0, dropped = 0, released = 0, loaded = 0;
+  while (fused < num_views) {
+    if (computed < num_views) {
+      int end = std::min(num_views, computed + batch);
+      for (; loaded < std::min(num_views, end + reach); ++loaded) {
+        ImagePyramid *pyramid = pyramids->Pyramid(views[loaded].id);
+        if (options.level >= pyramid->NumLevels()) {
+          LOG(ERROR) << "The pyramids have no level " << options.level;
+          pyramids->Unpin(views[loaded].id);
+          ok = false;
+          break;
+        }
+        views[loaded].image = &pyramid->Level(options.level);
+        if (loaded == 0 && options.memory_budget > 0) {
+          // The image and the depth map of a view, for every view between
+          // the first one not fused and the last one loaded.
+          long long view_bytes = views[0].image->MemorySizeInBytes() +
+                                 views[0].image->Size() / views[0].image->Depth()
+                                 * (2 * sizeof(float) + 1);
+          batch = std::max(1LL, options.memory_budget / view_bytes -
+                                3 * reach);
+          end = std::min(num_views, computed + batch);
+        }
+      }
+      if (!ok) {
+        break;
+      }
+      DepthMapTask task;
+      task.views = &views;
+      task.image_sizes = &image_sizes;
+      task.source_views = &source_views;
+      task.points = &sparse_points;
+      task.options = &options;
+      task.states = &states;
+      ParallelForDynamic(computed, end, options.num_threads, &task);
+      computed = end;
+    }
+
+    long long bytes = 0;
+    for (int i = dropped; i < computed; ++i) {
+      bytes += states[i] ? states[i]->MemorySizeInBytes() : 0;
+    }
+    memory.Set(bytes);
+    ReclaimMemoryOverBudget();
+
+    for (; fused < num_views && (computed == num_views ||
+                                 fused + reach < computed); ++fused) {
+      FuseDepthMap(fused, views, K_inverses, source_views[fused], options,
+                   states, points, intensities);
+    }
+    for (; dropped < fused - reach; ++dropped) {
+      delete states[dropped];
+      states[dropped] = NULL;
+    }
+    for (; released < std::min(fused, computed - reach); ++released) {
+      pyramids->Unpin(views[released].id);
+      views[released].image = NULL;
+    }
+    VLOG(1) << "Multi-view stereo: " << fused << " of " << num_views
+            << " views fused, " << points->size() << " points.";
+  }
+  for (; dropped < num_views; ++dropped) {
+    delete states[dropped];
+  }
+  for (; released < loaded; ++released) {
+    pyramids->Unpin(views[released].id);
+  }
+  return ok;
+}
+
+}  // namespace libmv
@@ -0,0 +1,115 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Dense multi-view stereo on top of a sparse reconstruction. A depth map is
+// estimated for every pinhole camera against a few other cameras of the
+// sequence, with a plane sweep refined by PatchMatch propagation and scored by
+// the normalized cross correlation (NCC) of image windows; the depths that
+// agree between views are then fused into a point cloud.
+
+#ifndef LIBMV_RECONSTRUCTION_MULTIVIEW_STEREO_H_
+#define LIBMV_RECONSTRUCTION_MULTIVIEW_STEREO_H_
+
+#include <vector>
+
+#include "libmv/base/vector.h"
+#include "libmv/image/image.h"
+#include "libmv/numeric/numeric.h"
+#include "libmv/reconstruction/reconstruction.h"
+
+namespace libmv {
+
+class PyramidSequence;
+
+struct MultiViewStereoOptions {
+  MultiViewStereoOptions();
+
+  // The pyramid level the depth maps are computed at, 0 being the frames.
+  int level;
+  // The source views compared to every reference view are the cameras
+  // view_stride, 2 view_stride, ... positions before and after it in the
+  // order of the camera ids, the closest first.
+  int num_source_views;
+  int view_stride;
+  // The NCC windows have a sample every window_step pixels within
+  // window_radius pixels of their center.
+  int window_radius;
+  int window_step;
+  // The inverse depths tried by the plane sweep, then the PatchMatch passes.
+  int num_depth_samples;
+  int num_iterations;
+  // The depths scoring less are discarded.
+  double min_ncc;
+  // A fused point must agree, within a relative depth error, with the depth
+  // maps of at least min_consistent_views source views.
+  int min_consistent_views;
+  double max_depth_error;
+  int num_threads;
+  // The bytes of the depth maps and images held at once, which bounds the
+  // number of views processed together; 0 is 2 views per thread.
+  long long memory_budget;
+};
+
+// A camera, at the scale of its single channel image, with the convention
+// x = K * (R * X + t).
+struct StereoView {
+  CameraID id;
+  Mat3 K;
+  Mat3 R;
+  Vec3 t;
+  const FloatImage *image;
+};
+
+// The depth along the optical axis of the pixels of a reference view, 0
+// where unknown, and its score.
+struct DepthMap {
+  Array3Df depth;
+  Array3Df score;
+};
+
+// The NCC of the n values of a and b, in [-1, 1], and 0 if either has no
+// variance. Vectorized with SSE2 or AVX2 when enabled.
+float NormalizedCrossCorrelation(const float *a, const float *b, int n);
+
+// Computes the depth map of reference against sources, between min_depth
+// and max_depth. The score of a depth is the mean NCC of the best half of the
+// source views that see the window.
+void ComputeDepthMap(const StereoView &reference,
+                     const std::vector<StereoView> &sources,
+                     double min_depth, double max_depth,
+                     const MultiViewStereoOptions &options,
+                     DepthMap *depth_map);
+
+// Computes the depth maps of the pinhole cameras of reconstruction, whose ids
+// are the frames of pyramids, and fuses them into points, with the intensity
+// of their reference pixel. The depth range of a view comes from the point
+// structures it sees, and the views that see none are skipped. The depth maps
+// are computed in parallel, a batch of views at a time, and dropped once the
+// views that use them are fused. Returns false if there are fewer than two
+// cameras or the pyramids have no such level.
+bool MultiViewStereo(const Reconstruction &reconstruction,
+                     PyramidSequence *pyramids,
+                     const MultiViewStereoOptions &options,
+                     vector<Vec3> *points,
+                     vector<float> *intensities);
+
+}  // namespace libmv
+
+#endif  // LIBMV_RECONSTRUCTION_MULTIVIEW_STEREO_H_
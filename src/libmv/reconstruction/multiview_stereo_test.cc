@@ -0,0 +1,214 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cmath>
+#include <vector>
+
+#include "libmv/base/memory_budget.h"
+#include "libmv/image/image_pyramid.h"
+#include "libmv/image/pyramid_sequence.h"
+#include "libmv/reconstruction/multiview_stereo.h"
+#include "testing/testing.h"
+
+namespace libmv {
+namespace {
+
+const int kWidth = 64;
+const int kHeight = 48;
+const double kFocal = 60;
+const double kPlaneDepth = 4;
+const int kNumViews = 5;
+
+double Texture(double x, double y) {
+  return 0.5 + 0.2 * sin(13 * x) * cos(11 * y) +
+         0.15 * sin(5.3 * x + 7.1 * y) + 0.1 * cos(17.7 * x - 3 * y);
+}
+
+Mat3 Intrinsics() {
+  Mat3 K;
+  K << kFocal, 0, kWidth / 2,
+       0, kFocal, kHeight / 2,
+       0, 0, 1;
+  return K;
+}
+
+// The cameras look at a textured plane at z = kPlaneDepth, side by side
+// along x.
+Vec3 Translation(int view) {
+  return Vec3(-0.1 * view, 0, 0);
+}
+
+void RenderView(int view, FloatImage *image) {
+  image->Resize(kHeight, kWidth);
+  for (int y = 0; y < kHeight; ++y) {
+    for (int x = 0; x < kWidth; ++x) {
+      double X = -Translation(view)(0) +
+                 kPlaneDepth * (x - kWidth / 2) / kFocal;
+      double Y = kPlaneDepth * (y - kHeight / 2) / kFocal;
+      (*image)(y, x) = Texture(X, Y);
+    }
+  }
+}
+
+// The pyramids of the rendered views, which counts the pinned frames.
+class RenderedPyramidSequence : public PyramidSequence {
+ public:
+  RenderedPyramidSequence() : pinned_(0) {
+    for (int i = 0; i < kNumViews; ++i) {
+      FloatImage image;
+      RenderView(i, &image);
+      pyramids_.push_back(MakeImagePyramid(image, 2, 0.5));
+    }
+  }
+  virtual ~RenderedPyramidSequence() {
+    for (int i = 0; i < pyramids_.size(); ++i) {
+      delete pyramids_[i];
+    }
+  }
+  virtual int Length() { return pyramids_.size(); }
+  virtual ImagePyramid *Pyramid(int frame_number) {
+    ++pinned_;
+    return pyramids_[frame_number];
+  }
+  virtual void Unpin(int frame_number) { --pinned_; }
+
+  int pinned() const { return pinned_; }
+
+ private:
+  std::vector<ImagePyramid *> pyramids_;
+  int pinned_;
+};
+
+TEST(MultiViewStereo, NormalizedCrossCorrelation) {
+  float a[37], b[37], c[37], flat[37];
+  for (int i = 0; i < 37; ++i) {
+    a[i] = sin(0.7 * i);
+    b[i] = 3 * a[i] + 2;
+    c[i] = -a[i];
+    flat[i] = 0.25;
+  }
+  EXPECT_NEAR(1, NormalizedCrossCorrelation(a, b, 37), 1e-5);
+  EXPECT_NEAR(-1, NormalizedCrossCorrelation(a, c, 37), 1e-5);
+  EXPECT_EQ(0, NormalizedCrossCorrelation(a, flat, 37));
+  EXPECT_NEAR(1, NormalizedCrossCorrelation(a, b, 3), 1e-5);
+}
+
+TEST(MultiViewStereo, ComputeDepthMap) {
+  FloatImage images[kNumViews];
+  std::vector<StereoView> views(kNumViews);
+  for (int i = 0; i < kNumViews; ++i) {
+    RenderView(i, &images[i]);
+    views[i].id = i;
+    views[i].K = Intrinsics();
+    views[i].R = Mat3::Identity();
+    views[i].t = Translation(i);
+    views[i].image = &images[i];
+  }
+  std::vector<StereoView> sources;
+  sources.push_back(views[1]);
+  sources.push_back(views[3]);
+  sources.push_back(views[0]);
+  sources.push_back(views[4]);
+
+  MultiViewStereoOptions options;
+  DepthMap depth_map;
+  ComputeDepthMap(views[2], sources, 2, 8, options, &depth_map);
+  ASSERT_EQ(kHeight, depth_map.depth.Height());
+  ASSERT_EQ(kWidth, depth_map.depth.Width());
+
+  int num_interior = 0, num_depths = 0, num_accurate = 0;
+  int radius = options.window_radius;
+  for (int y = radius; y < kHeight - radius; ++y) {
+    for (int x = radius; x < kWidth - radius; ++x) {
+      ++num_interior;
+      double depth = depth_map.depth(y, x);
+      if (depth > 0) {
+        ++num_depths;
+        num_accurate += fabs(depth - kPlaneDepth) < 0.02 * kPlaneDepth;
+      }
+    }
+  }
+  EXPECT_GT(num_depths, 0.8 * num_interior);
+  EXPECT_GT(num_accurate, 0.95 * num_depths);
+  // No window fits on the border.
+  EXPECT_EQ(0, depth_map.depth(0, 0));
+}
+
+void MakeReconstruction(Reconstruction *reconstruction) {
+  for (int i = 0; i < kNumViews; ++i) {
+    PinholeCamera *camera = new PinholeCamera(Intrinsics(), Mat3::Identity(),
+                                              Translation(i));
+    Vec2u size;
+    size << kWidth, kHeight;
+    camera->set_image_size(size);
+    reconstruction->InsertCamera(i, camera);
+  }
+  for (int i = 0; i < 10; ++i) {
+    reconstruction->InsertTrack(i, new PointStructure(
+        Vec4(0.1 * i, 0.05 * (i % 3), kPlaneDepth, 1)));
+  }
+}
+
+TEST(MultiViewStereo, FusedPointsLieOnThePlane) {
+  Reconstruction reconstruction;
+  MakeReconstruction(&reconstruction);
+  RenderedPyramidSequence pyramids;
+  MultiViewStereoOptions options;
+  options.level = 0;
+  options.view_stride = 1;
+  options.num_threads = 2;
+
+  vector<Vec3> points;
+  vector<float> intensities;
+  EXPECT_TRUE(MultiViewStereo(reconstruction, &pyramids, options,
+                              &points, &intensities));
+  EXPECT_EQ(0, pyramids.pinned());
+  EXPECT_EQ(0, MemoryInUse(MEMORY_DEPTH_MAPS));
+  ASSERT_EQ(points.size(), intensities.size());
+  EXPECT_GT(points.size(), kWidth * kHeight / 2);
+  int num_on_plane = 0;
+  for (int i = 0; i < points.size(); ++i) {
+    num_on_plane += fabs(points[i](2) - kPlaneDepth) < 0.02 * kPlaneDepth;
+  }
+  EXPECT_GT(num_on_plane, 0.95 * points.size());
+
+  // Views one at a time give the same points.
+  options.memory_budget = 1;
+  vector<Vec3> budget_points;
+  EXPECT_TRUE(MultiViewStereo(reconstruction, &pyramids, options,
+                              &budget_points, &intensities));
+  EXPECT_EQ(0, pyramids.pinned());
+  ASSERT_EQ(points.size(), budget_points.size());
+  for (int i = 0; i < points.size(); ++i) {
+    EXPECT_EQ(points[i], budget_points[i]);
+  }
+
+  // The pyramids have two levels.
+  options.level = 2;
+  EXPECT_FALSE(MultiViewStereo(reconstruction, &pyramids, options,
+                               &points, &intensities));
+  EXPECT_EQ(0, pyramids.pinned());
+
+  reconstruction.ClearCamerasMap();
+  reconstruction.ClearStructuresMap();
+}
+
+}  // namespace
+}  // namespace libmv
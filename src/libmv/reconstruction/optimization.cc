@@ -18,9 +18,15 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
-#include "libmv/multiview/bundle.h"
+#include <map>
+#include <set>
+
+#include "libmv/logging/logging.h"
+#include "libmv/multiview/sparse_bundle.h"
 #include "libmv/reconstruction/optimization.h"
+#include "libmv/reconstruction/reprojection_error_cache.h"
 #include "libmv/reconstruction/tools.h"
+#include "libmv/reconstruction/track_index.h"
 
 namespace libmv {
 
@@ -28,7 +34,7 @@ double EstimateRootMeanSquareError(const Matches &matches,
                                    Reconstruction *reconstruction) {
   PinholeCamera * pcamera = NULL;
   vector<StructureID> structures_ids;
-  Mat2X x_image;
+  Mat2X x_image, x_projected;
   Mat4X X_world;
   double sum_rms2 = 0;
   size_t num_features = 0;
@@ -45,12 +51,14 @@ double EstimateRootMeanSquareError(const Matches &matches,
       MatrixOfPointStructureCoordinates(structures_ids, 
                                         *reconstruction,
                                         &X_world);
-      Mat2X dx =Project(pcamera->projection_matrix(), X_world) - x_image;
+      // The buffers are reused from camera to camera, and the difference is
+      // reduced without being stored.
+      pcamera->ProjectPoints(X_world, &x_projected);
+      double error2 = (x_projected - x_image).squaredNorm();
       VLOG(1)   << "|Err Cam "<<camera_iter->first<<"| = " 
-                << sqrt(Square(dx.norm()) / x_image.cols()) << " ("
+                << sqrt(error2 / x_image.cols()) << " ("
                 << x_image.cols() << " pts)" << std::endl;
-      // TODO(julien) use normSquare
-      sum_rms2 += Square(dx.norm());
+      sum_rms2 += error2;
       num_features += x_image.cols();
     }
   }
@@ -58,90 +66,309 @@ double EstimateRootMeanSquareError(const Matches &matches,
   return sqrt(sum_rms2 / num_features);
 }
 
+double EstimateRootMeanSquareError(const DenseReconstruction &reconstruction,
+                                   int num_threads) {
+  ReprojectionErrorCache errors(&reconstruction, num_threads);
+  return errors.RootMeanSquareError();
+}
+
 double MetricBundleAdjust(const Matches &matches, 
                           Reconstruction *reconstruction) {
-  double rms = 0, rms0 = EstimateRootMeanSquareError(matches, reconstruction);
+  DenseReconstruction dense;
+  if (!DenseReconstructionFromReconstruction(matches, *reconstruction,
+                                             &dense)) {
+    LOG(FATAL) << "Error: the bundle adjustment can only handle pinhole "
+               << "cameras and point structures.";
+    return 0;
+  }
+  double rms = MetricBundleAdjust(&dense);
+  UpdateReconstruction(dense, reconstruction);
+  return rms;
+}
+
+double MetricBundleAdjust(DenseReconstruction *reconstruction) {
+  LIBMV_SCOPED_TIMER("bundle.metric");
+  vector<Mat3> &Rs = reconstruction->Rs();
+  vector<Vec3> &ts = reconstruction->ts();
+  vector<Vec3> &Xs = reconstruction->Xs();
+  // The adjuster works in place on the arrays; they are restored if the
+  // error did not decrease.
+  vector<Mat3> Rs0 = Rs;
+  vector<Vec3> ts0 = ts;
+  vector<Vec3> Xs0 = Xs;
+  SparseBundleAdjuster bundle;
+  for (int c = 0; c < reconstruction->NumCameras(); ++c) {
+    bundle.AddCamera(reconstruction->Ks()[c], &Rs[c], &ts[c]);
+  }
+  for (int j = 0; j < reconstruction->NumPoints(); ++j) {
+    bundle.AddPoint(&Xs[j]);
+  }
+  for (int k = 0; k < reconstruction->NumObservations(); ++k) {
+    bundle.AddObservation(reconstruction->observation_cameras()[k],
+                          reconstruction->observation_points()[k],
+                          reconstruction->observations()[k]);
+  }
+  double rms0 = bundle.RootMeanSquareError();
   VLOG(1)   << "Initial RMS = " << rms0 << std::endl;
-  size_t ncamera = reconstruction->GetNumberCameras();
-  size_t nstructure = reconstruction->GetNumberStructures();
-  vector<Mat2X> x(ncamera);
-  vector<Vecu>   x_ids(ncamera);
-  vector<Mat3>  Ks(ncamera);
-  vector<Mat3>  Rs(ncamera);
-  vector<Vec3>  ts(ncamera);
-  Mat3X         X(3, nstructure);
-  vector<StructureID> structures_ids;
-  std::map<StructureID, uint> map_structures_ids;
-  
-  size_t str_id = 0;
-  PointStructure *pstructure = NULL;
-  std::map<StructureID, Structure *>::iterator str_iter =  
-    reconstruction->structures().begin();
-  for (; str_iter != reconstruction->structures().end(); ++str_iter) {
-    pstructure = dynamic_cast<PointStructure *>(str_iter->second);
-    if (pstructure) {
-      X.col(str_id) = pstructure->coords_affine();
-      map_structures_ids[str_iter->first] = str_id;
-      str_id++;
-    } else {
-      LOG(FATAL) << "Error: the bundle adjustment cannot handle non point "
-                 << "structure.";
-      return 0;
+  // Past a few thousand cameras the factorization of the reduced camera
+  // system does not fit in memory anymore.
+  const int kMaxCamerasForDirectSolver = 2000;
+  SparseBundleAdjuster::Options options;
+  if (reconstruction->NumCameras() > kMaxCamerasForDirectSolver) {
+    options.linear_solver = SparseBundleAdjuster::Options::ITERATIVE_SCHUR;
+  }
+  // Performs metric bundle adjustment
+  double rms = bundle.Solve(options);
+  // Keep the results only if it's better
+  if (!(rms < rms0)) {
+    Rs = Rs0;
+    ts = ts0;
+    Xs = Xs0;
+  }
+  VLOG(1)   << "Final RMS = " << rms << std::endl;
+  return rms;
+}
+
+double LocalMetricBundleAdjust(const Matches &matches,
+                               const vector<CameraID> &window,
+                               Reconstruction *reconstruction) {
+  LIBMV_SCOPED_TIMER("bundle.local");
+  std::set<CameraID> free_cameras;
+  for (size_t i = 0; i < window.size(); ++i) {
+    if (dynamic_cast<PinholeCamera *>(reconstruction->GetCamera(window[i]))) {
+      free_cameras.insert(window[i]);
     }
   }
-  
-  PinholeCamera * pcamera = NULL;
-  size_t cam_id = 0;
-  std::map<CameraID, Camera *>::iterator cam_iter =  
-    reconstruction->cameras().begin();
-  for (; cam_iter != reconstruction->cameras().end(); ++cam_iter) {
-    pcamera = dynamic_cast<PinholeCamera *>(cam_iter->second);
-    if (pcamera) {
-      pcamera->GetIntrinsicExtrinsicParameters(&Ks[cam_id],
-                                               &Rs[cam_id],
-                                               &ts[cam_id]);
-      SelectExistingPointStructures(matches, cam_iter->first,
-                                    *reconstruction,
-                                    &structures_ids, &x[cam_id]);
-      x_ids[cam_id].resize(structures_ids.size());
-      for (size_t s = 0; s < structures_ids.size(); ++s) {
-        x_ids[cam_id][s] = map_structures_ids[structures_ids[s]];
+  // Selects the point structures seen by the window.
+  std::set<StructureID> local_structures;
+  vector<StructureID> structures_ids;
+  std::set<CameraID>::const_iterator free_iter = free_cameras.begin();
+  for (; free_iter != free_cameras.end(); ++free_iter) {
+    SelectExistingPointStructures(matches, *free_iter, *reconstruction,
+                                  &structures_ids, NULL);
+    local_structures.insert(structures_ids.begin(), structures_ids.end());
+  }
+  if (local_structures.empty()) {
+    return 0;
+  }
+
+  // The adjuster works in place on these; they are only copied back to the
+  // reconstruction if the error decreased. Every camera observing one of the
+  // points is added, the ones outside the window fixed.
+  vector<Vec3>  Xs(local_structures.size());
+  vector<StructureID> local_structures_ids;
+  vector<CameraID> local_cameras_ids;
+  vector<Mat3>  Ks, Rs;
+  vector<Vec3>  ts;
+  std::map<CameraID, int> map_cameras_ids;
+  vector<int>   observation_cameras, observation_points;
+  vector<Vec2>  observations;
+  std::set<StructureID>::const_iterator str_iter = local_structures.begin();
+  for (; str_iter != local_structures.end(); ++str_iter) {
+    PointStructure *pstructure = dynamic_cast<PointStructure *>(
+        reconstruction->GetStructure(*str_iter));
+    int point = local_structures_ids.size();
+    Xs[point] = pstructure->coords_affine();
+    local_structures_ids.push_back(*str_iter);
+    Matches::Features<PointFeature> fp =
+        matches.InTrack<PointFeature>(*str_iter);
+    for (; fp; ++fp) {
+      PinholeCamera *pcamera = dynamic_cast<PinholeCamera *>(
+          reconstruction->GetCamera(fp.image()));
+      if (!pcamera) {
+        continue;
+      }
+      std::map<CameraID, int>::iterator cam_iter =
+          map_cameras_ids.find(fp.image());
+      if (cam_iter == map_cameras_ids.end()) {
+        Mat3 K, R;
+        Vec3 t;
+        pcamera->GetIntrinsicExtrinsicParameters(&K, &R, &t);
+        Ks.push_back(K);
+        Rs.push_back(R);
+        ts.push_back(t);
+        local_cameras_ids.push_back(fp.image());
+        cam_iter = map_cameras_ids.insert(
+            std::make_pair(fp.image(), int(Ks.size()) - 1)).first;
       }
-      //VLOG(1)   << "x_ids = " << x_ids[cam_id].transpose()<<"\n";
-      cam_id++;
-    } else {
-      LOG(FATAL) << "Error: the bundle adjustment cannot handle non pinhole "
-                 << "cameras.";
-      return 0;
+      observation_cameras.push_back(cam_iter->second);
+      observation_points.push_back(point);
+      observations.push_back(Vec2(fp.feature()->x(), fp.feature()->y()));
     }
   }
-  // Performs metric bundle adjustment
-  rms = EuclideanBA(x, x_ids, &Ks, &Rs, &ts, &X, eBUNDLE_METRIC);
+
+  // Rs and ts do not move anymore, the adjuster can point to them.
+  SparseBundleAdjuster bundle;
+  for (size_t c = 0; c < Ks.size(); ++c) {
+    bundle.AddCamera(Ks[c], &Rs[c], &ts[c]);
+    bundle.SetCameraFixed(c, free_cameras.count(local_cameras_ids[c]) == 0);
+  }
+  for (size_t j = 0; j < Xs.size(); ++j) {
+    bundle.AddPoint(&Xs[j]);
+  }
+  for (size_t k = 0; k < observations.size(); ++k) {
+    bundle.AddObservation(observation_cameras[k], observation_points[k],
+                          observations[k]);
+  }
+  double rms0 = bundle.RootMeanSquareError();
+  VLOG(1)   << "Initial local RMS = " << rms0 << " (" << free_cameras.size()
+            << " free cameras, " << Ks.size() - free_cameras.size()
+            << " fixed, " << Xs.size() << " points)" << std::endl;
+  double rms = bundle.Solve();
   // Copy the results only if it's better
   if (rms < rms0) {
-    cam_id = 0;
-    cam_iter = reconstruction->cameras().begin();
-    for (; cam_iter != reconstruction->cameras().end(); ++cam_iter) {
-      pcamera = dynamic_cast<PinholeCamera *>(cam_iter->second);
-      if (pcamera) {
-        pcamera->SetIntrinsicExtrinsicParameters(Ks[cam_id],
-                                                 Rs[cam_id],
-                                                 ts[cam_id]);
-        cam_id++;
+    for (size_t c = 0; c < Ks.size(); ++c) {
+      if (!bundle.IsCameraFixed(c)) {
+        PinholeCamera *pcamera = dynamic_cast<PinholeCamera *>(
+            reconstruction->GetCamera(local_cameras_ids[c]));
+        pcamera->SetIntrinsicExtrinsicParameters(Ks[c], Rs[c], ts[c]);
+      }
+    }
+    for (size_t j = 0; j < Xs.size(); ++j) {
+      PointStructure *pstructure = dynamic_cast<PointStructure *>(
+          reconstruction->GetStructure(local_structures_ids[j]));
+      pstructure->set_coords_affine(Xs[j]);
+    }
+  }
+  VLOG(1)   << "Final local RMS = " << rms << std::endl;
+  return rms;
+}
+
+double MetricMotionAdjust(const Matches &matches,
+                          const vector<CameraID> &cameras,
+                          Reconstruction *reconstruction,
+                          int num_threads) {
+  LIBMV_SCOPED_TIMER("bundle.motion_only");
+  // The adjuster works in place on these; the points are not modified.
+  vector<PinholeCamera *> pcameras;
+  vector<Mat3> Ks, Rs;
+  vector<Vec3> ts;
+  vector<vector<StructureID> > structures_ids;
+  vector<Mat2X> x_images;
+  for (size_t i = 0; i < cameras.size(); ++i) {
+    PinholeCamera *pcamera = dynamic_cast<PinholeCamera *>(
+        reconstruction->GetCamera(cameras[i]));
+    if (!pcamera) {
+      continue;
+    }
+    Mat3 K, R;
+    Vec3 t;
+    pcamera->GetIntrinsicExtrinsicParameters(&K, &R, &t);
+    pcameras.push_back(pcamera);
+    Ks.push_back(K);
+    Rs.push_back(R);
+    ts.push_back(t);
+    structures_ids.push_back(vector<StructureID>());
+    x_images.push_back(Mat2X());
+    SelectExistingPointStructures(matches, cameras[i], *reconstruction,
+                                  &structures_ids.back(), &x_images.back());
+  }
+  std::map<StructureID, int> map_points;
+  vector<Vec3> Xs;
+  for (size_t c = 0; c < pcameras.size(); ++c) {
+    for (size_t k = 0; k < structures_ids[c].size(); ++k) {
+      if (map_points.count(structures_ids[c][k]) == 0) {
+        PointStructure *pstructure = dynamic_cast<PointStructure *>(
+            reconstruction->GetStructure(structures_ids[c][k]));
+        map_points[structures_ids[c][k]] = Xs.size();
+        Xs.push_back(pstructure->coords_affine());
       }
     }
-    str_id = 0;
-    str_iter = reconstruction->structures().begin();
-    for (; str_iter != reconstruction->structures().end(); ++str_iter) {
-      pstructure = dynamic_cast<PointStructure *>(str_iter->second);
-      if (pstructure) {
-        pstructure->set_coords_affine(X.col(str_id));
-        str_id++;
+  }
+
+  SparseBundleAdjuster bundle;
+  for (size_t c = 0; c < pcameras.size(); ++c) {
+    bundle.AddCamera(Ks[c], &Rs[c], &ts[c]);
+  }
+  for (size_t j = 0; j < Xs.size(); ++j) {
+    bundle.AddPoint(&Xs[j]);
+  }
+  for (size_t c = 0; c < pcameras.size(); ++c) {
+    for (size_t k = 0; k < structures_ids[c].size(); ++k) {
+      bundle.AddObservation(c, map_points[structures_ids[c][k]],
+                            x_images[c].col(k));
+    }
+  }
+  SparseBundleAdjuster::Options options;
+  options.num_threads = num_threads;
+  double rms = bundle.SolveMotion(options);
+  for (size_t c = 0; c < pcameras.size(); ++c) {
+    pcameras[c]->SetIntrinsicExtrinsicParameters(Ks[c], Rs[c], ts[c]);
+  }
+  VLOG(1)   << "Motion only RMS = " << bundle.statistics().initial_rms
+            << " -> " << rms << " (" << pcameras.size() << " cameras)"
+            << std::endl;
+  return rms;
+}
+
+double MetricStructureAdjust(const Matches &matches,
+                             const vector<StructureID> &structures,
+                             Reconstruction *reconstruction,
+                             int num_threads) {
+  LIBMV_SCOPED_TIMER("bundle.structure_only");
+  // The adjuster works in place on these; the cameras are not modified.
+  vector<PointStructure *> pstructures;
+  vector<Vec3> Xs;
+  vector<Mat3> Ks, Rs;
+  vector<Vec3> ts;
+  std::map<CameraID, int> map_cameras_ids;
+  vector<int> observation_cameras, observation_points;
+  vector<Vec2> observations;
+  for (size_t i = 0; i < structures.size(); ++i) {
+    PointStructure *pstructure = dynamic_cast<PointStructure *>(
+        reconstruction->GetStructure(structures[i]));
+    if (!pstructure) {
+      continue;
+    }
+    int point = pstructures.size();
+    pstructures.push_back(pstructure);
+    Xs.push_back(pstructure->coords_affine());
+    Matches::Features<PointFeature> fp =
+        matches.InTrack<PointFeature>(structures[i]);
+    for (; fp; ++fp) {
+      PinholeCamera *pcamera = dynamic_cast<PinholeCamera *>(
+          reconstruction->GetCamera(fp.image()));
+      if (!pcamera) {
+        continue;
+      }
+      std::map<CameraID, int>::iterator cam_iter =
+          map_cameras_ids.find(fp.image());
+      if (cam_iter == map_cameras_ids.end()) {
+        Mat3 K, R;
+        Vec3 t;
+        pcamera->GetIntrinsicExtrinsicParameters(&K, &R, &t);
+        Ks.push_back(K);
+        Rs.push_back(R);
+        ts.push_back(t);
+        cam_iter = map_cameras_ids.insert(
+            std::make_pair(fp.image(), int(Ks.size()) - 1)).first;
       }
+      observation_cameras.push_back(cam_iter->second);
+      observation_points.push_back(point);
+      observations.push_back(Vec2(fp.feature()->x(), fp.feature()->y()));
     }
   }
-  //rms = EstimateRootMeanSquareError(matches, reconstruction);
-  VLOG(1)   << "Final RMS = " << rms << std::endl;
+
+  SparseBundleAdjuster bundle;
+  for (size_t c = 0; c < Ks.size(); ++c) {
+    bundle.AddCamera(Ks[c], &Rs[c], &ts[c]);
+  }
+  for (size_t j = 0; j < Xs.size(); ++j) {
+    bundle.AddPoint(&Xs[j]);
+  }
+  for (size_t k = 0; k < observations.size(); ++k) {
+    bundle.AddObservation(observation_cameras[k], observation_points[k],
+                          observations[k]);
+  }
+  SparseBundleAdjuster::Options options;
+  options.num_threads = num_threads;
+  double rms = bundle.SolveStructure(options);
+  for (size_t j = 0; j < pstructures.size(); ++j) {
+    pstructures[j]->set_coords_affine(Xs[j]);
+  }
+  VLOG(1)   << "Structure only RMS = " << bundle.statistics().initial_rms
+            << " -> " << rms << " (" << pstructures.size() << " points)"
+            << std::endl;
   return rms;
 }
 
@@ -210,4 +437,72 @@ uint RemoveOutliers(CameraID image_id,
   VLOG(1) << "#outliers: " << number_outliers << std::endl;
   return number_outliers;
 }
+
+int RemoveOutlierObservations(DenseReconstruction *reconstruction,
+                              double rmse_threshold,
+                              int num_threads,
+                              std::vector<char> *is_outlier) {
+  std::vector<char> is_rejected(reconstruction->NumObservations(), 0);
+  int num_rejected = 0;
+  {
+    ReprojectionErrorCache errors(reconstruction, num_threads);
+    double threshold2 = Square(rmse_threshold);
+    for (int k = 0; k < reconstruction->NumObservations(); ++k) {
+      if (errors.SquaredError(k) > threshold2) {
+        is_rejected[k] = 1;
+        ++num_rejected;
+      }
+    }
+  }
+  if (num_rejected > 0) {
+    reconstruction->RemoveObservations(is_rejected);
+  }
+  if (is_outlier) {
+    is_outlier->swap(is_rejected);
+  }
+  return num_rejected;
+}
+
+uint RemoveAllOutliers(Matches *matches,
+                       Reconstruction *reconstruction,
+                       double rmse_threshold,
+                       int num_threads) {
+  DenseReconstruction dense;
+  DenseReconstructionFromReconstruction(*matches, *reconstruction, &dense);
+  // The cameras and points of the observations, before the removal.
+  vector<int> cameras = dense.observation_cameras();
+  vector<int> points = dense.observation_points();
+  std::vector<char> is_outlier;
+  int num_outliers = RemoveOutlierObservations(&dense, rmse_threshold,
+                                               num_threads, &is_outlier);
+  if (num_outliers == 0) {
+    return 0;
+  }
+  ReconstructedTrackIndex *index = reconstruction->track_index();
+  std::vector<char> lost_views(dense.NumPoints(), 0);
+  for (int k = 0; k < is_outlier.size(); ++k) {
+    if (is_outlier[k]) {
+      lost_views[points[k]] = 1;
+      CameraID image = dense.camera_id(cameras[k]);
+      StructureID track = dense.point_id(points[k]);
+      matches->Remove(image, track);
+      if (index && &index->matches() == matches) {
+        index->RemoveFeature(image, track);
+      }
+    }
+  }
+  // Check if the points which lost views have enough left (with pinhole
+  // cameras)
+  std::vector<int> num_views(dense.NumPoints(), 0);
+  for (int k = 0; k < dense.NumObservations(); ++k) {
+    ++num_views[dense.observation_points()[k]];
+  }
+  for (int j = 0; j < dense.NumPoints(); ++j) {
+    if (lost_views[j] && num_views[j] < 2) {
+      reconstruction->RemoveTrack(dense.point_id(j));
+    }
+  }
+  VLOG(1) << "#outliers: " << num_outliers << std::endl;
+  return num_outliers;
+}
 } // namespace libmv
@@ -21,6 +21,9 @@
 #ifndef LIBMV_RECONSTRUCTION_OPTIMIZATION_H_
 #define LIBMV_RECONSTRUCTION_OPTIMIZATION_H_
 
+#include <vector>
+
+#include "libmv/reconstruction/dense_reconstruction.h"
 #include "libmv/reconstruction/reconstruction.h"
 
 namespace libmv {
@@ -28,11 +31,53 @@ namespace libmv {
 double EstimateRootMeanSquareError(const Matches &matches, 
                                    Reconstruction *reconstruction);
 
+// Root mean square reprojection error of the observations of a dense
+// reconstruction, in pixels, computed with num_threads threads. Use a
+// ReprojectionErrorCache to follow the error of a changing reconstruction.
+double EstimateRootMeanSquareError(const DenseReconstruction &reconstruction,
+                                   int num_threads = 1);
+
 // This method performs an Euclidean Bundle Adjustment
 // and returns the root mean square error.
 double MetricBundleAdjust(const Matches &matches, 
                           Reconstruction *reconstruction);
 
+// Same as above on the arrays of a dense reconstruction, which are adjusted
+// in place (and left unchanged if the error does not decrease). Large
+// reconstructions are solved with the ITERATIVE_SCHUR linear solver of
+// SparseBundleAdjuster.
+double MetricBundleAdjust(DenseReconstruction *reconstruction);
+
+// This method performs a local Euclidean Bundle Adjustment: only the cameras
+// in window and the point structures they observe are optimized. The other
+// cameras observing these points constrain the problem but are kept fixed.
+// The cost is proportional to the size of the window and not to the size of
+// the reconstruction. Returns the root mean square error of the local problem.
+double LocalMetricBundleAdjust(const Matches &matches,
+                               const vector<CameraID> &window,
+                               Reconstruction *reconstruction);
+
+// Motion only Euclidean adjustment: the poses of the pinhole cameras of
+// cameras are refined one by one from their observations of the point
+// structures, which are kept fixed, the cameras in parallel on num_threads
+// threads. Each camera only moves if its error decreases. This is the
+// adjustment to use after the localization of new cameras against a known
+// structure. Returns the root mean square error of the observations.
+double MetricMotionAdjust(const Matches &matches,
+                          const vector<CameraID> &cameras,
+                          Reconstruction *reconstruction,
+                          int num_threads = 1);
+
+// Structure only Euclidean adjustment: the point structures of structures
+// seen by at least two pinhole cameras are refined one by one, the cameras
+// kept fixed, the points in parallel on num_threads threads. This is the
+// adjustment to use after (re)triangulating points. Returns the root mean
+// square error of the observations.
+double MetricStructureAdjust(const Matches &matches,
+                             const vector<StructureID> &structures,
+                             Reconstruction *reconstruction,
+                             int num_threads = 1);
+
 // Remove the matches associated to the points structures seen in the image
 // image_id and have a root mean square error bigger than rmse_threshold
 // NOTE It is at least barely started
@@ -41,6 +86,26 @@ uint RemoveOutliers(CameraID image_id,
                     Reconstruction *reconstruction,
                     double rmse_threshold = 2.0);
 
+// Removes the observations of reconstruction with a reprojection error bigger
+// than rmse_threshold, in a single compaction of the observation arrays. The
+// errors are computed with num_threads threads. If is_outlier is not NULL, it
+// receives for every observation (before the removal) whether it was removed.
+// Returns the number of removed observations.
+int RemoveOutlierObservations(DenseReconstruction *reconstruction,
+                              double rmse_threshold = 2.0,
+                              int num_threads = 1,
+                              std::vector<char> *is_outlier = NULL);
+
+// Same as RemoveOutliers() for all the images at once: the matches of the
+// pinhole cameras with a reprojection error bigger than rmse_threshold are
+// rejected in one parallel pass, then removed, as well as the point
+// structures left with less than two views. Returns the number of removed
+// matches.
+uint RemoveAllOutliers(Matches *matches,
+                       Reconstruction *reconstruction,
+                       double rmse_threshold = 2.0,
+                       int num_threads = 1);
+
 
 }  // namespace libmv
 
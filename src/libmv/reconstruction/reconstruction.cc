@@ -19,7 +19,43 @@
 // IN THE SOFTWARE.
 
 #include "libmv/reconstruction/reconstruction.h"
+#include "libmv/reconstruction/track_index.h"
 
 namespace libmv {
 
+void Reconstruction::InsertTrack(StructureID id, Structure *structure) {
+  std::map<StructureID, Structure *>::iterator it = structures_.find(id);
+  if (it != structures_.end()) {
+    delete it->second;
+    it->second = structure; 
+  } else {
+    structures_[id] = structure;
+    if (track_index_) {
+      track_index_->SetTrackReconstructed(id, true);
+    }
+  }
+}
+
+void Reconstruction::RemoveTrack(StructureID id) {
+  std::map<StructureID, Structure *>::iterator it = structures_.find(id);
+  if (it != structures_.end()) {
+    delete it->second; 
+    structures_.erase(it);
+    if (track_index_) {
+      track_index_->SetTrackReconstructed(id, false);
+    }
+  }
+}
+
+void Reconstruction::ClearStructuresMap() {
+  std::map<StructureID, Structure *>::iterator it = structures_.begin();
+  for (; it != structures_.end(); ++it) {
+    delete it->second;
+    if (track_index_) {
+      track_index_->SetTrackReconstructed(it->first, false);
+    }
+  }
+  structures_.clear();
+}
+
 } // namespace libmv
@@ -34,6 +34,8 @@ namespace libmv {
 // TODO(julien) shoud a camera have the same ID then an image? 
 typedef Matches::ImageID CameraID;
 typedef Matches::TrackID StructureID;
+
+class ReconstructedTrackIndex;
 // Use cases:
 //
 // Reconstruction is a subset of the tracks.  For a single track, there is a 3D
@@ -97,7 +99,7 @@ typedef Matches::TrackID StructureID;
 class Reconstruction {
  public:
    
-  Reconstruction() {}
+  Reconstruction() : track_index_(NULL) {}
   ~Reconstruction() {}
 
   void InsertCamera(CameraID id, Camera *camera) {
@@ -110,15 +112,7 @@ class Reconstruction {
     }
   }
   
-  void InsertTrack(StructureID id, Structure *structure) {
-    std::map<StructureID, Structure *>::iterator it = structures_.find(id);
-    if (it != structures_.end()) {
-      delete it->second;
-      it->second = structure; 
-    } else {
-      structures_[id] = structure;
-    }
-  }
+  void InsertTrack(StructureID id, Structure *structure);
   
   void RemoveCamera(CameraID id) {
     std::map<CameraID, Camera *>::iterator it = cameras_.find(id);
@@ -128,13 +122,7 @@ class Reconstruction {
     }
   }
   
-  void RemoveTrack(StructureID id) {
-    std::map<StructureID, Structure *>::iterator it = structures_.find(id);
-    if (it != structures_.end()) {
-      delete it->second; 
-      structures_.erase(it);
-    }
-  }
+  void RemoveTrack(StructureID id);
   
   bool ImageHasCamera(CameraID id) const {
     std::map<CameraID, Camera *>::const_iterator it = cameras_.find(id);
@@ -171,13 +159,7 @@ class Reconstruction {
     }
     cameras_.clear();
   }
-  void ClearStructuresMap() {
-    std::map<StructureID, Structure *>::iterator it = structures_.begin();
-    for (; it != structures_.end(); ++it) {
-      delete it->second;
-    }
-    structures_.clear();
-  }
+  void ClearStructuresMap();
   
   size_t GetNumberCameras() const    { return cameras_.size(); }
   size_t GetNumberStructures() const { return structures_.size(); }
@@ -192,11 +174,19 @@ class Reconstruction {
     return structures_; }
   const Matches                             & matches() const {
     return matches_; }
+
+  // The index is kept up to date by InsertTrack(), RemoveTrack() and
+  // ClearStructuresMap(); it is not owned (see track_index.h).
+  void set_track_index(ReconstructedTrackIndex *index) {
+    track_index_ = index; }
+  ReconstructedTrackIndex *track_index() { return track_index_; }
+  const ReconstructedTrackIndex *track_index() const { return track_index_; }
   
  private:
   std::map<CameraID, Camera *>        cameras_;
   std::map<StructureID, Structure *>  structures_;
   Matches                             matches_;
+  ReconstructedTrackIndex            *track_index_;
 };
 
 }  // namespace libmv
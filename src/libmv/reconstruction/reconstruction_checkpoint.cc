@@ -0,0 +1,304 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+#include "libmv/camera/pinhole_camera.h"
+#include "libmv/logging/logging.h"
+#include "libmv/multiview/structure.h"
+#include "libmv/reconstruction/reconstruction_checkpoint.h"
+
+namespace libmv {
+namespace {
+
+const char kMagic[4] = { 'L', 'M', 'V', 'C' };
+const unsigned int kVersion = 1;
+
+bool WriteInts(const int *values, int n, FILE *file) {
+  return n == 0 || fwrite(values, sizeof(*values), n, file) == n;
+}
+
+bool WriteInt(int value, FILE *file) {
+  return WriteInts(&value, 1, file);
+}
+
+bool ReadInts(int *values, int n, FILE *file) {
+  return n == 0 || fread(values, sizeof(*values), n, file) == n;
+}
+
+bool ReadInt(int *value, FILE *file) {
+  return ReadInts(value, 1, file) && *value >= 0;
+}
+
+bool WriteReconstruction(const Reconstruction &reconstruction, FILE *file) {
+  std::vector<int> camera_ids;
+  std::vector<unsigned int> image_sizes;
+  std::vector<double> camera_params;
+  std::map<CameraID, Camera *>::const_iterator camera_iter =
+    reconstruction.cameras().begin();
+  for (; camera_iter != reconstruction.cameras().end(); ++camera_iter) {
+    const PinholeCamera *camera =
+      dynamic_cast<const PinholeCamera *>(camera_iter->second);
+    if (!camera) {
+      continue;
+    }
+    camera_ids.push_back(camera_iter->first);
+    image_sizes.push_back(camera->image_width());
+    image_sizes.push_back(camera->image_height());
+    for (int i = 0; i < 3; ++i) {
+      for (int j = 0; j < 3; ++j) {
+        camera_params.push_back(camera->intrinsic_matrix()(i, j));
+      }
+    }
+    for (int i = 0; i < 3; ++i) {
+      for (int j = 0; j < 3; ++j) {
+        camera_params.push_back(camera->orientation_matrix()(i, j));
+      }
+    }
+    for (int i = 0; i < 3; ++i) {
+      camera_params.push_back(camera->position()(i));
+    }
+  }
+  if (!WriteInt(camera_ids.size(), file)) {
+    return false;
+  }
+  for (size_t c = 0; c < camera_ids.size(); ++c) {
+    if (!WriteInt(camera_ids[c], file) ||
+        fwrite(&image_sizes[2 * c], sizeof(unsigned int), 2, file) != 2 ||
+        fwrite(&camera_params[21 * c], sizeof(double), 21, file) != 21) {
+      return false;
+    }
+  }
+
+  std::vector<int> point_ids;
+  std::vector<double> coords;
+  std::map<StructureID, Structure *>::const_iterator point_iter =
+    reconstruction.structures().begin();
+  for (; point_iter != reconstruction.structures().end(); ++point_iter) {
+    const PointStructure *point =
+      dynamic_cast<const PointStructure *>(point_iter->second);
+    if (!point) {
+      continue;
+    }
+    point_ids.push_back(point_iter->first);
+    for (int i = 0; i < 4; ++i) {
+      coords.push_back(point->coords()(i));
+    }
+  }
+  if (!WriteInt(point_ids.size(), file)) {
+    return false;
+  }
+  for (size_t p = 0; p < point_ids.size(); ++p) {
+    if (!WriteInt(point_ids[p], file) ||
+        fwrite(&coords[4 * p], sizeof(double), 4, file) != 4) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void DeleteReconstruction(Reconstruction *reconstruction) {
+  reconstruction->ClearCamerasMap();
+  reconstruction->ClearStructuresMap();
+  delete reconstruction;
+}
+
+bool ReadReconstruction(FILE *file, Reconstruction *reconstruction) {
+  int num_cameras;
+  if (!ReadInt(&num_cameras, file)) {
+    return false;
+  }
+  for (int c = 0; c < num_cameras; ++c) {
+    int id;
+    unsigned int image_size[2];
+    double params[21];
+    if (!ReadInts(&id, 1, file) ||
+        fread(image_size, sizeof(unsigned int), 2, file) != 2 ||
+        fread(params, sizeof(double), 21, file) != 21) {
+      return false;
+    }
+    Mat3 K, R;
+    Vec3 t;
+    for (int i = 0; i < 3; ++i) {
+      for (int j = 0; j < 3; ++j) {
+        K(i, j) = params[3 * i + j];
+        R(i, j) = params[9 + 3 * i + j];
+      }
+      t(i) = params[18 + i];
+    }
+    PinholeCamera *camera = new PinholeCamera(K, R, t);
+    Vec2u size;
+    size << image_size[0], image_size[1];
+    camera->set_image_size(size);
+    reconstruction->InsertCamera(id, camera);
+  }
+  int num_points;
+  if (!ReadInt(&num_points, file)) {
+    return false;
+  }
+  for (int p = 0; p < num_points; ++p) {
+    int id;
+    Vec4 coords;
+    if (!ReadInts(&id, 1, file) ||
+        fread(coords.data(), sizeof(double), 4, file) != 4) {
+      return false;
+    }
+    reconstruction->InsertTrack(id, new PointStructure(coords));
+  }
+  return true;
+}
+
+}  // namespace
+
+bool WriteReconstructionCheckpoint(
+    const std::string &filename,
+    const ReconstructionCheckpointState &state,
+    const std::list<Reconstruction *> &reconstructions) {
+  std::string temporary = filename + ".tmp";
+  FILE *file = fopen(temporary.c_str(), "wb");
+  if (!file) {
+    LOG(ERROR) << "Cannot write the checkpoint " << temporary;
+    return false;
+  }
+  int header[4] = {
+    state.stage, state.keyframe_index, state.sequence_start,
+    state.keyframes.size()
+  };
+  bool ok = fwrite(kMagic, sizeof(kMagic), 1, file) == 1 &&
+            fwrite(&kVersion, sizeof(kVersion), 1, file) == 1 &&
+            WriteInts(header, 4, file) &&
+            WriteInts(state.keyframes.begin(), state.keyframes.size(), file) &&
+            WriteInt(reconstructions.size(), file);
+  std::list<Reconstruction *>::const_iterator iter = reconstructions.begin();
+  for (; ok && iter != reconstructions.end(); ++iter) {
+    ok = WriteReconstruction(**iter, file);
+  }
+  ok = fclose(file) == 0 && ok;
+  if (ok && rename(temporary.c_str(), filename.c_str()) != 0) {
+    ok = false;
+  }
+  if (!ok) {
+    LOG(ERROR) << "Cannot write the checkpoint " << filename;
+    remove(temporary.c_str());
+  }
+  return ok;
+}
+
+bool ReadReconstructionCheckpoint(
+    const std::string &filename,
+    ReconstructionCheckpointState *state,
+    std::list<Reconstruction *> *reconstructions) {
+  FILE *file = fopen(filename.c_str(), "rb");
+  if (!file) {
+    return false;
+  }
+  char magic[4];
+  unsigned int version;
+  int header[4];
+  ReconstructionCheckpointState read_state;
+  std::list<Reconstruction *> read_reconstructions;
+  bool ok = fread(magic, sizeof(magic), 1, file) == 1 &&
+            memcmp(magic, kMagic, sizeof(magic)) == 0 &&
+            fread(&version, sizeof(version), 1, file) == 1 &&
+            version == kVersion &&
+            ReadInts(header, 4, file) &&
+            header[0] >= ReconstructionCheckpointState::KEYFRAMES &&
+            header[0] <= ReconstructionCheckpointState::DONE &&
+            header[3] >= 0;
+  int num_reconstructions = 0;
+  if (ok) {
+    read_state.stage = header[0];
+    read_state.keyframe_index = header[1];
+    read_state.sequence_start = header[2];
+    read_state.keyframes.resize(header[3]);
+    ok = ReadInts(read_state.keyframes.begin(), header[3], file) &&
+         ReadInt(&num_reconstructions, file);
+  }
+  for (int r = 0; ok && r < num_reconstructions; ++r) {
+    read_reconstructions.push_back(new Reconstruction);
+    ok = ReadReconstruction(file, read_reconstructions.back());
+  }
+  fclose(file);
+  if (!ok) {
+    LOG(ERROR) << "Cannot read the checkpoint " << filename;
+    std::list<Reconstruction *>::iterator iter = read_reconstructions.begin();
+    for (; iter != read_reconstructions.end(); ++iter) {
+      DeleteReconstruction(*iter);
+    }
+    return false;
+  }
+  *state = read_state;
+  reconstructions->splice(reconstructions->end(), read_reconstructions);
+  return true;
+}
+
+ReconstructionCheckpointer::ReconstructionCheckpointer(
+    const std::string &filename, int keyframe_period)
+  : filename_(filename), keyframe_period_(keyframe_period),
+    num_keyframes_(0), num_written_(0), resumed_(false) {
+}
+
+ReconstructionCheckpointer::~ReconstructionCheckpointer() {
+  std::list<Reconstruction *>::iterator iter =
+    resumed_reconstructions_.begin();
+  for (; iter != resumed_reconstructions_.end(); ++iter) {
+    DeleteReconstruction(*iter);
+  }
+}
+
+bool ReconstructionCheckpointer::Resume() {
+  resumed_ = ReadReconstructionCheckpoint(filename_, &resumed_state_,
+                                          &resumed_reconstructions_);
+  if (resumed_) {
+    VLOG(1) << "Resuming from " << filename_ << ", stage "
+            << resumed_state_.stage << ", keyframe "
+            << resumed_state_.keyframe_index << std::endl;
+  }
+  return resumed_;
+}
+
+void ReconstructionCheckpointer::TakeResumedReconstructions(
+    std::list<Reconstruction *> *reconstructions) {
+  reconstructions->splice(reconstructions->end(), resumed_reconstructions_);
+}
+
+bool ReconstructionCheckpointer::OnKeyframe(
+    const ReconstructionCheckpointState &state,
+    const std::list<Reconstruction *> &reconstructions) {
+  ++num_keyframes_;
+  if (keyframe_period_ <= 0 || num_keyframes_ % keyframe_period_ != 0) {
+    return true;
+  }
+  return Write(state, reconstructions);
+}
+
+bool ReconstructionCheckpointer::Write(
+    const ReconstructionCheckpointState &state,
+    const std::list<Reconstruction *> &reconstructions) {
+  if (!WriteReconstructionCheckpoint(filename_, state, reconstructions)) {
+    return false;
+  }
+  ++num_written_;
+  return true;
+}
+
+}  // namespace libmv
@@ -0,0 +1,135 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_RECONSTRUCTION_RECONSTRUCTION_CHECKPOINT_H_
+#define LIBMV_RECONSTRUCTION_RECONSTRUCTION_CHECKPOINT_H_
+
+#include <list>
+#include <string>
+
+#include "libmv/base/vector.h"
+#include "libmv/correspondence/matches.h"
+#include "libmv/reconstruction/reconstruction.h"
+
+namespace libmv {
+
+// Where EuclideanReconstructionFromVideo() was when a checkpoint was written.
+struct ReconstructionCheckpointState {
+  enum Stage {
+    // The keyframes are being reconstructed: the last reconstruction goes on
+    // from keyframes[keyframe_index].
+    KEYFRAMES = 0,
+    // The keyframes are done, the non-keyframes are not.
+    NON_KEYFRAMES = 1,
+    DONE = 2,
+  };
+
+  ReconstructionCheckpointState()
+    : stage(KEYFRAMES), keyframe_index(0), sequence_start(0) {}
+
+  int stage;
+  vector<Matches::ImageID> keyframes;
+  int keyframe_index;
+  // The keyframe where the incremental reconstruction of the last
+  // reconstruction started, which sets the bundle adjustment schedule.
+  int sequence_start;
+};
+
+// Checkpoint files hold the state, then the reconstructions, in native byte
+// order:
+//
+//   "LMVC" and the version (32 bit unsigned integers);
+//   the stage, keyframe_index, sequence_start, the number of keyframes and
+//   the keyframes (32 bit signed integers);
+//   the number of reconstructions, and for each one its number of cameras,
+//   the cameras (id and image width and height as 32 bit integers, then K,
+//   R by rows and the position as 21 doubles), its number of points and the
+//   points (id as a 32 bit integer, then the 4 homogeneous coordinates as
+//   doubles).
+//
+// Only the pinhole cameras (without their lens distortion) and the point
+// structures are saved, and not the matches of the reconstructions, which is
+// what the video reconstruction produces. The input matches are saved apart,
+// once, in the binary matches format (see matches_binary.h).
+//
+// The file is written to filename + ".tmp" then renamed, so that a crash
+// while writing leaves the previous checkpoint intact.
+bool WriteReconstructionCheckpoint(
+    const std::string &filename,
+    const ReconstructionCheckpointState &state,
+    const std::list<Reconstruction *> &reconstructions);
+
+// Appends the reconstructions of a checkpoint file to reconstructions.
+// Returns false, leaving the outputs unchanged, if the file cannot be read.
+bool ReadReconstructionCheckpoint(
+    const std::string &filename,
+    ReconstructionCheckpointState *state,
+    std::list<Reconstruction *> *reconstructions);
+
+// Periodically writes checkpoints of EuclideanReconstructionFromVideo(), and
+// resumes it from the last one.
+class ReconstructionCheckpointer {
+ public:
+  // Writes to filename after every keyframe_period keyframes (never during
+  // the keyframes if 0), and after the keyframe and non-keyframe stages.
+  ReconstructionCheckpointer(const std::string &filename,
+                             int keyframe_period);
+  // Deletes the resumed reconstructions that were not taken.
+  ~ReconstructionCheckpointer();
+
+  // Reads the checkpoint file if there is one. Returns false if there is
+  // none, or if it cannot be read; the reconstruction then starts over.
+  bool Resume();
+  bool resumed() const { return resumed_; }
+  const ReconstructionCheckpointState &resumed_state() const {
+    return resumed_state_;
+  }
+  // Moves the resumed reconstructions to the end of reconstructions.
+  void TakeResumedReconstructions(std::list<Reconstruction *> *reconstructions);
+
+  // Called after each reconstructed keyframe; writes every keyframe_period
+  // calls.
+  bool OnKeyframe(const ReconstructionCheckpointState &state,
+                  const std::list<Reconstruction *> &reconstructions);
+  // Writes a checkpoint now.
+  bool Write(const ReconstructionCheckpointState &state,
+             const std::list<Reconstruction *> &reconstructions);
+
+  const std::string &filename() const { return filename_; }
+  // The file of the input matches saved beside the checkpoint.
+  std::string MatchesFilename() const { return filename_ + ".matches"; }
+  int num_written() const { return num_written_; }
+
+ private:
+  ReconstructionCheckpointer(const ReconstructionCheckpointer &);
+  ReconstructionCheckpointer &operator=(const ReconstructionCheckpointer &);
+
+  std::string filename_;
+  int keyframe_period_;
+  int num_keyframes_;
+  int num_written_;
+  bool resumed_;
+  ReconstructionCheckpointState resumed_state_;
+  std::list<Reconstruction *> resumed_reconstructions_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_RECONSTRUCTION_RECONSTRUCTION_CHECKPOINT_H_
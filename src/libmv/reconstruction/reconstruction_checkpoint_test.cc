@@ -0,0 +1,186 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstdio>
+#include <list>
+
+#include "libmv/correspondence/feature.h"
+#include "libmv/reconstruction/euclidean_reconstruction.h"
+#include "libmv/reconstruction/reconstruction_checkpoint.h"
+#include "testing/testing.h"
+
+namespace libmv {
+namespace {
+
+void DeleteReconstructions(std::list<Reconstruction *> *reconstructions) {
+  std::list<Reconstruction *>::iterator iter = reconstructions->begin();
+  for (; iter != reconstructions->end(); ++iter) {
+    (*iter)->ClearCamerasMap();
+    (*iter)->ClearStructuresMap();
+    delete *iter;
+  }
+  reconstructions->clear();
+}
+
+Reconstruction *MakeReconstruction(int first_id) {
+  Reconstruction *reconstruction = new Reconstruction;
+  Mat3 K;
+  K << 500, 0.5, 320, 0, 510, 240, 0, 0, 1;
+  Mat3 R = RotationAroundY(0.1 * first_id);
+  PinholeCamera *camera = new PinholeCamera(K, R, Vec3(first_id, 2, 3));
+  Vec2u size;
+  size << 640, 480;
+  camera->set_image_size(size);
+  reconstruction->InsertCamera(first_id, camera);
+  reconstruction->InsertCamera(first_id + 1,
+                               new PinholeCamera(K, R, Vec3(0, 0, 1)));
+  reconstruction->InsertTrack(10 * first_id,
+                              new PointStructure(Vec4(1, 2, 3, 0.5)));
+  return reconstruction;
+}
+
+TEST(ReconstructionCheckpoint, RoundTrip) {
+  std::string filename = "reconstruction_checkpoint_test.ckpt";
+  ReconstructionCheckpointState state;
+  state.stage = ReconstructionCheckpointState::KEYFRAMES;
+  state.keyframes.push_back(0);
+  state.keyframes.push_back(4);
+  state.keyframes.push_back(9);
+  state.keyframe_index = 2;
+  state.sequence_start = 2;
+  std::list<Reconstruction *> reconstructions;
+  reconstructions.push_back(MakeReconstruction(1));
+  reconstructions.push_back(MakeReconstruction(5));
+  EXPECT_TRUE(WriteReconstructionCheckpoint(filename, state,
+                                            reconstructions));
+
+  ReconstructionCheckpointState read_state;
+  std::list<Reconstruction *> read_reconstructions;
+  ASSERT_TRUE(ReadReconstructionCheckpoint(filename, &read_state,
+                                           &read_reconstructions));
+  EXPECT_EQ(state.stage, read_state.stage);
+  EXPECT_EQ(2, read_state.keyframe_index);
+  EXPECT_EQ(2, read_state.sequence_start);
+  ASSERT_EQ(3, read_state.keyframes.size());
+  EXPECT_EQ(9, read_state.keyframes[2]);
+  ASSERT_EQ(2, read_reconstructions.size());
+
+  std::list<Reconstruction *>::iterator a = reconstructions.begin();
+  std::list<Reconstruction *>::iterator b = read_reconstructions.begin();
+  for (; a != reconstructions.end(); ++a, ++b) {
+    EXPECT_EQ((*a)->GetNumberCameras(), (*b)->GetNumberCameras());
+    EXPECT_EQ((*a)->GetNumberStructures(), (*b)->GetNumberStructures());
+    std::map<CameraID, Camera *>::const_iterator camera_iter =
+      (*a)->cameras().begin();
+    for (; camera_iter != (*a)->cameras().end(); ++camera_iter) {
+      PinholeCamera *expected =
+        dynamic_cast<PinholeCamera *>(camera_iter->second);
+      PinholeCamera *camera =
+        dynamic_cast<PinholeCamera *>((*b)->GetCamera(camera_iter->first));
+      ASSERT_TRUE(camera != NULL);
+      EXPECT_MATRIX_NEAR(expected->projection_matrix(),
+                         camera->projection_matrix(), 1e-12);
+      EXPECT_EQ(expected->image_width(), camera->image_width());
+      EXPECT_EQ(expected->image_height(), camera->image_height());
+    }
+    std::map<StructureID, Structure *>::const_iterator point_iter =
+      (*a)->structures().begin();
+    for (; point_iter != (*a)->structures().end(); ++point_iter) {
+      PointStructure *point =
+        dynamic_cast<PointStructure *>((*b)->GetStructure(point_iter->first));
+      ASSERT_TRUE(point != NULL);
+      EXPECT_MATRIX_NEAR(Vec4(1, 2, 3, 0.5), point->coords(), 0);
+    }
+  }
+  DeleteReconstructions(&reconstructions);
+  DeleteReconstructions(&read_reconstructions);
+  remove(filename.c_str());
+}
+
+TEST(ReconstructionCheckpoint, RejectsOtherFiles) {
+  std::string filename = "reconstruction_checkpoint_test_bad.ckpt";
+  FILE *file = fopen(filename.c_str(), "wb");
+  fputs("LMVC but truncated", file);
+  fclose(file);
+  ReconstructionCheckpointState state;
+  state.keyframe_index = 7;
+  std::list<Reconstruction *> reconstructions;
+  EXPECT_FALSE(ReadReconstructionCheckpoint(filename, &state,
+                                            &reconstructions));
+  EXPECT_EQ(7, state.keyframe_index);
+  EXPECT_TRUE(reconstructions.empty());
+  EXPECT_FALSE(ReadReconstructionCheckpoint("no_such_checkpoint", &state,
+                                            &reconstructions));
+  remove(filename.c_str());
+}
+
+TEST(ReconstructionCheckpointer, WritesEveryPeriodKeyframes) {
+  std::string filename = "reconstruction_checkpointer_test.ckpt";
+  remove(filename.c_str());
+  ReconstructionCheckpointer checkpointer(filename, 3);
+  EXPECT_FALSE(checkpointer.Resume());
+  ReconstructionCheckpointState state;
+  std::list<Reconstruction *> reconstructions;
+  reconstructions.push_back(MakeReconstruction(1));
+  for (int i = 0; i < 7; ++i) {
+    state.keyframe_index = i;
+    checkpointer.OnKeyframe(state, reconstructions);
+  }
+  EXPECT_EQ(2, checkpointer.num_written());
+
+  ReconstructionCheckpointer resumed(filename, 3);
+  ASSERT_TRUE(resumed.Resume());
+  EXPECT_EQ(5, resumed.resumed_state().keyframe_index);
+  std::list<Reconstruction *> resumed_reconstructions;
+  resumed.TakeResumedReconstructions(&resumed_reconstructions);
+  EXPECT_EQ(1, resumed_reconstructions.size());
+  DeleteReconstructions(&reconstructions);
+  DeleteReconstructions(&resumed_reconstructions);
+  remove(filename.c_str());
+}
+
+TEST(ReconstructionCheckpointer, FinishedReconstructionIsNotRedone) {
+  std::string filename = "reconstruction_checkpointer_done.ckpt";
+  ReconstructionCheckpointState state;
+  state.stage = ReconstructionCheckpointState::DONE;
+  std::list<Reconstruction *> reconstructions;
+  reconstructions.push_back(MakeReconstruction(1));
+  ASSERT_TRUE(WriteReconstructionCheckpoint(filename, state,
+                                            reconstructions));
+  DeleteReconstructions(&reconstructions);
+
+  // The matches cannot give a reconstruction: it comes from the checkpoint.
+  PointFeature features[2];
+  Matches matches;
+  matches.Insert(0, 0, &features[0]);
+  matches.Insert(1, 0, &features[1]);
+  ReconstructionCheckpointer checkpointer(filename, 1);
+  ASSERT_TRUE(checkpointer.Resume());
+  EXPECT_TRUE(EuclideanReconstructionFromVideo(matches, 640, 480, 500,
+                                               &reconstructions, 1, NULL,
+                                               &checkpointer));
+  ASSERT_EQ(1, reconstructions.size());
+  EXPECT_EQ(2, reconstructions.front()->GetNumberCameras());
+  DeleteReconstructions(&reconstructions);
+  remove(filename.c_str());
+}
+
+}  // namespace
+}  // namespace libmv
@@ -0,0 +1,177 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/reconstruction/export_blender.h"
+#include "libmv/reconstruction/reconstruction_observer.h"
+
+namespace libmv {
+namespace {
+
+// The reconstruction does not delete its cameras and structures.
+void DeleteSnapshot(Reconstruction *snapshot) {
+  snapshot->ClearCamerasMap();
+  snapshot->ClearStructuresMap();
+  delete snapshot;
+}
+
+}  // namespace
+
+void CopyReconstructionForExport(const Reconstruction &reconstruction,
+                                 Reconstruction *snapshot) {
+  std::map<CameraID, Camera *>::const_iterator camera_iter =
+    reconstruction.cameras().begin();
+  for (; camera_iter != reconstruction.cameras().end(); ++camera_iter) {
+    PinholeCamera *pcamera = dynamic_cast<PinholeCamera *>(camera_iter->second);
+    if (pcamera) {
+      // The copy constructor of PinholeCamera only copies the intrinsics.
+      PinholeCamera *copy = new PinholeCamera(pcamera->intrinsic_matrix(),
+                                              pcamera->orientation_matrix(),
+                                              pcamera->position());
+      copy->set_image_size(pcamera->image_size());
+      snapshot->InsertCamera(camera_iter->first, copy);
+    }
+  }
+  std::map<StructureID, Structure *>::const_iterator track_iter =
+    reconstruction.structures().begin();
+  for (; track_iter != reconstruction.structures().end(); ++track_iter) {
+    PointStructure *point_s =
+      dynamic_cast<PointStructure *>(track_iter->second);
+    if (point_s) {
+      snapshot->InsertTrack(track_iter->first,
+                            new PointStructure(point_s->coords()));
+    }
+  }
+}
+
+void BlenderExportObserver::OnReconstructionStep(
+    const Reconstruction &reconstruction,
+    const std::string &step_name) {
+  ExportToBlenderScript(reconstruction, prefix_ + step_name + ".py");
+}
+
+AsyncBlenderExportObserver::AsyncBlenderExportObserver(
+    const std::string &prefix, int step_period)
+  : prefix_(prefix), step_period_(step_period > 1 ? step_period : 1),
+    num_steps_(0), num_exported_(0), num_dropped_(0), pending_(NULL),
+    busy_(false), stop_(false) {
+  thread_started_ = pthread_create(&thread_, NULL,
+                                   &AsyncBlenderExportObserver::ThreadEntry,
+                                   this) == 0;
+}
+
+AsyncBlenderExportObserver::~AsyncBlenderExportObserver() {
+  Flush();
+  if (thread_started_) {
+    {
+      MutexLock lock(&mutex_);
+      stop_ = true;
+      wake_up_.Signal();
+    }
+    pthread_join(thread_, NULL);
+  }
+}
+
+void AsyncBlenderExportObserver::OnReconstructionStep(
+    const Reconstruction &reconstruction,
+    const std::string &step_name) {
+  {
+    MutexLock lock(&mutex_);
+    if (num_steps_++ % step_period_ != 0) {
+      ++num_dropped_;
+      return;
+    }
+  }
+  Reconstruction *snapshot = new Reconstruction();
+  CopyReconstructionForExport(reconstruction, snapshot);
+  if (!thread_started_) {
+    // Could not spawn the thread; export here instead.
+    ExportToBlenderScript(*snapshot, prefix_ + step_name + ".py");
+    DeleteSnapshot(snapshot);
+    MutexLock lock(&mutex_);
+    ++num_exported_;
+    return;
+  }
+  Reconstruction *replaced = NULL;
+  {
+    MutexLock lock(&mutex_);
+    if (pending_) {
+      replaced = pending_;
+      ++num_dropped_;
+    }
+    pending_ = snapshot;
+    pending_name_ = step_name;
+    wake_up_.Signal();
+  }
+  if (replaced) {
+    DeleteSnapshot(replaced);
+  }
+}
+
+void AsyncBlenderExportObserver::Flush() {
+  MutexLock lock(&mutex_);
+  while (pending_ || busy_) {
+    idle_.Wait(&mutex_);
+  }
+}
+
+int AsyncBlenderExportObserver::num_exported() const {
+  MutexLock lock(&mutex_);
+  return num_exported_;
+}
+
+int AsyncBlenderExportObserver::num_dropped() const {
+  MutexLock lock(&mutex_);
+  return num_dropped_;
+}
+
+void *AsyncBlenderExportObserver::ThreadEntry(void *observer) {
+  static_cast<AsyncBlenderExportObserver *>(observer)->Run();
+  return NULL;
+}
+
+void AsyncBlenderExportObserver::Run() {
+  for (;;) {
+    Reconstruction *snapshot = NULL;
+    std::string name;
+    {
+      MutexLock lock(&mutex_);
+      while (!pending_ && !stop_) {
+        wake_up_.Wait(&mutex_);
+      }
+      if (!pending_) {
+        return;
+      }
+      snapshot = pending_;
+      name = pending_name_;
+      pending_ = NULL;
+      busy_ = true;
+    }
+    ExportToBlenderScript(*snapshot, prefix_ + name + ".py");
+    DeleteSnapshot(snapshot);
+    {
+      MutexLock lock(&mutex_);
+      busy_ = false;
+      ++num_exported_;
+      idle_.Broadcast();
+    }
+  }
+}
+
+}  // namespace libmv
@@ -0,0 +1,122 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_RECONSTRUCTION_RECONSTRUCTION_OBSERVER_H_
+#define LIBMV_RECONSTRUCTION_RECONSTRUCTION_OBSERVER_H_
+
+#include <string>
+
+#include "libmv/base/thread.h"
+#include "libmv/reconstruction/reconstruction.h"
+
+namespace libmv {
+
+// Receives the intermediate states of a reconstruction, e.g. to export debug
+// snapshots. The reconstruction methods notify an observer after each of
+// their steps (initial reconstruction, keyframe or non-keyframe resection,
+// bundle adjustment); step_name identifies the step, e.g. "init-ba".
+class ReconstructionObserver {
+ public:
+  virtual ~ReconstructionObserver() {}
+
+  // The reconstruction is only valid during the call.
+  virtual void OnReconstructionStep(const Reconstruction &reconstruction,
+                                    const std::string &step_name) = 0;
+};
+
+// Notifies observer if it is not NULL.
+inline void NotifyReconstructionStep(ReconstructionObserver *observer,
+                                     const Reconstruction &reconstruction,
+                                     const std::string &step_name) {
+  if (observer) {
+    observer->OnReconstructionStep(reconstruction, step_name);
+  }
+}
+
+// Copies the pinhole cameras and the point structures of reconstruction,
+// which are the parts used by the exporters, into snapshot.
+void CopyReconstructionForExport(const Reconstruction &reconstruction,
+                                 Reconstruction *snapshot);
+
+// Writes the Blender script prefix + step_name + ".py" of every step, on the
+// calling thread.
+class BlenderExportObserver : public ReconstructionObserver {
+ public:
+  explicit BlenderExportObserver(const std::string &prefix = "")
+    : prefix_(prefix) {}
+
+  virtual void OnReconstructionStep(const Reconstruction &reconstruction,
+                                    const std::string &step_name);
+
+ private:
+  std::string prefix_;
+};
+
+// Same as BlenderExportObserver, but the scripts are written by a background
+// thread so that the reconstruction only pays for a copy of the cameras and
+// points. Only one step every step_period is kept, and if the thread is still
+// busy when a new snapshot arrives, the pending one is replaced by the newer
+// one: at most one snapshot waits in memory. Flush() (or the destructor)
+// writes the pending snapshot and waits for the thread.
+class AsyncBlenderExportObserver : public ReconstructionObserver {
+ public:
+  explicit AsyncBlenderExportObserver(const std::string &prefix = "",
+                                      int step_period = 1);
+  virtual ~AsyncBlenderExportObserver();
+
+  virtual void OnReconstructionStep(const Reconstruction &reconstruction,
+                                    const std::string &step_name);
+
+  // Blocks until every accepted snapshot has been written.
+  void Flush();
+
+  // The number of scripts written and of snapshots dropped so far.
+  int num_exported() const;
+  int num_dropped() const;
+
+ private:
+  static void *ThreadEntry(void *observer);
+  void Run();
+
+  // No copying allowed.
+  AsyncBlenderExportObserver(const AsyncBlenderExportObserver &);
+  AsyncBlenderExportObserver &operator=(const AsyncBlenderExportObserver &);
+
+  std::string prefix_;
+  int step_period_;
+  int num_steps_;
+  int num_exported_;
+  int num_dropped_;
+
+  // Protect the members below, and the counters above.
+  mutable Mutex mutex_;
+  ConditionVariable wake_up_;
+  ConditionVariable idle_;
+  Reconstruction *pending_;
+  std::string pending_name_;
+  bool busy_;
+  bool stop_;
+  bool thread_started_;
+  pthread_t thread_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_RECONSTRUCTION_RECONSTRUCTION_OBSERVER_H_
@@ -0,0 +1,100 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstdio>
+#include <sstream>
+
+#include "libmv/reconstruction/reconstruction_observer.h"
+#include "testing/testing.h"
+
+namespace libmv {
+namespace {
+
+bool FileExists(const std::string &file_name) {
+  FILE *file = fopen(file_name.c_str(), "rb");
+  if (!file) {
+    return false;
+  }
+  fclose(file);
+  return true;
+}
+
+TEST(CopyReconstructionForExport, CopiesCamerasAndPoints) {
+  Reconstruction reconstruction;
+  reconstruction.InsertCamera(3, new PinholeCamera(Mat3::Identity(),
+                                                   Mat3::Identity(),
+                                                   Vec3(1, 2, 3)));
+  reconstruction.InsertTrack(7, new PointStructure(Vec3(4, 5, 6)));
+
+  Reconstruction snapshot;
+  CopyReconstructionForExport(reconstruction, &snapshot);
+  EXPECT_EQ(1, snapshot.GetNumberCameras());
+  EXPECT_EQ(1, snapshot.GetNumberStructures());
+  PinholeCamera *camera = dynamic_cast<PinholeCamera *>(snapshot.GetCamera(3));
+  ASSERT_TRUE(camera != NULL);
+  EXPECT_NE(reconstruction.GetCamera(3), camera);
+  EXPECT_MATRIX_NEAR(Vec3(1, 2, 3), camera->position(), 0);
+  PointStructure *point =
+    dynamic_cast<PointStructure *>(snapshot.GetStructure(7));
+  ASSERT_TRUE(point != NULL);
+  EXPECT_MATRIX_NEAR(Vec3(4, 5, 6), point->coords_affine(), 1e-15);
+
+  snapshot.ClearCamerasMap();
+  snapshot.ClearStructuresMap();
+  reconstruction.ClearCamerasMap();
+  reconstruction.ClearStructuresMap();
+}
+
+TEST(AsyncBlenderExportObserver, ExportsOneStepPerPeriod) {
+  Reconstruction reconstruction;
+  reconstruction.InsertCamera(0, new PinholeCamera(Mat3::Identity(),
+                                                   Mat3::Identity(),
+                                                   Vec3::Zero()));
+  reconstruction.InsertTrack(0, new PointStructure(Vec3(0, 0, 1)));
+
+  const int kNumSteps = 5;
+  const std::string prefix = "reconstruction_observer_test-";
+  AsyncBlenderExportObserver observer(prefix, 2);
+  for (int i = 0; i < kNumSteps; ++i) {
+    std::stringstream s;
+    s << "step-" << i;
+    NotifyReconstructionStep(&observer, reconstruction, s.str());
+  }
+  observer.Flush();
+  // Steps 0, 2 and 4 are kept, but a pending step can be replaced by a newer
+  // one while the thread writes.
+  EXPECT_EQ(kNumSteps, observer.num_exported() + observer.num_dropped());
+  EXPECT_GE(observer.num_dropped(), 2);
+  EXPECT_GE(observer.num_exported(), 1);
+  // The last accepted step is always written.
+  EXPECT_TRUE(FileExists(prefix + "step-4.py"));
+  EXPECT_FALSE(FileExists(prefix + "step-3.py"));
+  for (int i = 0; i < kNumSteps; ++i) {
+    std::stringstream s;
+    s << prefix << "step-" << i << ".py";
+    remove(s.str().c_str());
+  }
+
+  reconstruction.ClearCamerasMap();
+  reconstruction.ClearStructuresMap();
+}
+
+}  // namespace
+}  // namespace libmv
@@ -0,0 +1,105 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <vector>
+
+#include "libmv/logging/logging.h"
+#include "libmv/reconstruction/optimization.h"
+#include "libmv/reconstruction/reconstruction_window.h"
+
+namespace libmv {
+
+ReconstructionWindow::ReconstructionWindow(MatchesPager *pager,
+                                           Matches *matches,
+                                           int window_size,
+                                           Reconstruction *reconstruction,
+                                           Reconstruction *frozen)
+    : pager_(pager),
+      matches_(matches),
+      window_size_(window_size),
+      reconstruction_(reconstruction),
+      frozen_(frozen) {
+  CHECK_GT(window_size, 0);
+  CHECK(reconstruction->track_index() == NULL);
+}
+
+bool ReconstructionWindow::PushImage(Matches::ImageID image) {
+  if (!pager_->PageIn(image)) {
+    return false;
+  }
+  images_.push_back(image);
+  while (int(images_.size()) > window_size_) {
+    FreezeFirstImage();
+  }
+  return true;
+}
+
+void ReconstructionWindow::Flush() {
+  while (!images_.empty()) {
+    FreezeFirstImage();
+  }
+}
+
+double ReconstructionWindow::BundleAdjust() {
+  vector<CameraID> cameras;
+  for (int i = 0; i < images_.size(); ++i) {
+    if (reconstruction_->ImageHasCamera(images_[i])) {
+      cameras.push_back(images_[i]);
+    }
+  }
+  if (cameras.size() == 0) {
+    return 0;
+  }
+  return LocalMetricBundleAdjust(*matches_, cameras, reconstruction_);
+}
+
+void ReconstructionWindow::FreezeFirstImage() {
+  Matches::ImageID image = images_.front();
+  images_.pop_front();
+  std::map<CameraID, Camera *>::iterator camera =
+    reconstruction_->cameras().find(image);
+  if (camera != reconstruction_->cameras().end()) {
+    frozen_->InsertCamera(image, camera->second);
+    reconstruction_->cameras().erase(camera);
+  }
+  std::vector<Matches::TrackID> tracks;
+  Matches::Features<Feature> feature = matches_->InImage<Feature>(image);
+  for (; feature; ++feature) {
+    tracks.push_back(feature.track());
+  }
+  pager_->PageOut(image);
+  int num_frozen_points = 0;
+  for (int i = 0; i < tracks.size(); ++i) {
+    if (matches_->NumFeatureTrack(tracks[i]) > 0) {
+      continue;
+    }
+    std::map<StructureID, Structure *>::iterator structure =
+      reconstruction_->structures().find(tracks[i]);
+    if (structure != reconstruction_->structures().end()) {
+      frozen_->InsertTrack(tracks[i], structure->second);
+      reconstruction_->structures().erase(structure);
+      ++num_frozen_points;
+    }
+  }
+  VLOG(2) << "Image " << image << " frozen with " << num_frozen_points
+          << " points." << std::endl;
+}
+
+}  // namespace libmv
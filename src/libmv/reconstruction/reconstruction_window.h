@@ -0,0 +1,84 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_RECONSTRUCTION_RECONSTRUCTION_WINDOW_H_
+#define LIBMV_RECONSTRUCTION_RECONSTRUCTION_WINDOW_H_
+
+#include <deque>
+
+#include "libmv/correspondence/matches.h"
+#include "libmv/correspondence/matches_pager.h"
+#include "libmv/reconstruction/reconstruction.h"
+
+namespace libmv {
+
+// A sliding window over the images of a long sequence, for reconstructions
+// that do not fit in memory. Only the observations of the last window_size
+// images are paged in (see MatchesPager), and the local bundle adjustment
+// only moves the cameras of these images. When an image leaves the window
+// its camera is frozen, and so are the points that no paged in image
+// observes anymore: they are moved to the frozen reconstruction, which holds
+// no observation. The memory used by the observations is then bounded by the
+// size of the window instead of growing with the sequence; the caller may
+// export and clear the frozen reconstruction to bound it too.
+//
+// A frozen point whose track is observed again by a later image is not
+// brought back: the track has no structure anymore and can be triangulated
+// again. The reconstruction must not have a track index (see track_index.h),
+// which would not follow the paging of the matches.
+class ReconstructionWindow {
+ public:
+  // pager, reconstruction and frozen must outlive the window.
+  ReconstructionWindow(MatchesPager *pager,
+                       Matches *matches,
+                       int window_size,
+                       Reconstruction *reconstruction,
+                       Reconstruction *frozen);
+
+  // Pages in image at the end of the window, then freezes the first images
+  // while the window has more than window_size images. Returns false, and
+  // does nothing, if image is not in the file or is already in the window.
+  bool PushImage(Matches::ImageID image);
+
+  // Freezes all the images of the window.
+  void Flush();
+
+  // The images of the window, oldest first.
+  const std::deque<Matches::ImageID> &images() const { return images_; }
+
+  // Performs a local bundle adjustment of the cameras of the window (see
+  // LocalMetricBundleAdjust()). Returns the root mean square error, or 0 if
+  // no image of the window has a camera.
+  double BundleAdjust();
+
+ private:
+  void FreezeFirstImage();
+
+  MatchesPager *pager_;
+  Matches *matches_;
+  int window_size_;
+  Reconstruction *reconstruction_;
+  Reconstruction *frozen_;
+  std::deque<Matches::ImageID> images_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_RECONSTRUCTION_RECONSTRUCTION_WINDOW_H_
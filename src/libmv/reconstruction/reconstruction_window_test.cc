@@ -0,0 +1,104 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "libmv/correspondence/feature.h"
+#include "libmv/correspondence/matches_binary.h"
+#include "libmv/correspondence/matches_pager.h"
+#include "libmv/multiview/projection.h"
+#include "libmv/multiview/test_data_sets.h"
+#include "libmv/reconstruction/reconstruction_window.h"
+#include "testing/testing.h"
+
+namespace libmv {
+namespace {
+
+TEST(ReconstructionWindow, FreezesTheImagesLeavingTheWindow) {
+  // The point j is seen by the views j % 6 to j % 6 + 2.
+  int nviews = 8;
+  int npoints = 60;
+  NViewDataSet d = NRealisticCamerasFull(nviews, npoints);
+  Matches matches;
+  std::vector<PointFeature> features(3 * npoints);
+  for (int j = 0; j < npoints; ++j) {
+    for (int k = 0; k < 3; ++k) {
+      int i = j % 6 + k;
+      PointFeature &feature = features[3 * j + k];
+      feature.coords << d.x[i](0, j), d.x[i](1, j);
+      matches.Insert(i, j, &feature);
+    }
+  }
+  std::string filename = "/tmp/libmv_reconstruction_window_test.bin";
+  ASSERT_TRUE(ExportMatchesToBinary(matches, filename));
+  MappedMatches file;
+  ASSERT_TRUE(file.Open(filename));
+
+  Reconstruction reconstruction, frozen;
+  for (int i = 0; i < nviews; ++i) {
+    reconstruction.InsertCamera(i, new PinholeCamera(d.K[i], d.R[i], d.t[i]));
+  }
+  for (int j = 0; j < npoints; ++j) {
+    reconstruction.InsertTrack(j, new PointStructure(Vec3(d.X.col(j))));
+  }
+  Matches paged;
+  MatchesPager pager(&file, &paged);
+  ReconstructionWindow window(&pager, &paged, 3, &reconstruction, &frozen);
+  for (int i = 0; i < 6; ++i) {
+    EXPECT_TRUE(window.PushImage(i));
+  }
+  EXPECT_FALSE(window.PushImage(5));
+  ASSERT_EQ(3, window.images().size());
+  EXPECT_EQ(3, window.images().front());
+  EXPECT_EQ(3, pager.NumPagedInImages());
+  EXPECT_EQ(3 * 30, pager.NumPagedInFeatures());
+
+  // The views 0 to 2 have left the window, and so have the points seen only
+  // by them.
+  EXPECT_EQ(3, frozen.GetNumberCameras());
+  EXPECT_TRUE(frozen.ImageHasCamera(2));
+  EXPECT_FALSE(reconstruction.ImageHasCamera(2));
+  for (int j = 0; j < npoints; ++j) {
+    bool is_frozen = j % 6 == 0;
+    EXPECT_EQ(is_frozen, frozen.TrackHasStructure(j));
+    EXPECT_NE(is_frozen, reconstruction.TrackHasStructure(j));
+  }
+  EXPECT_NEAR(0, window.BundleAdjust(), 1e-4);
+
+  // The views 6 and 7 have never been paged in.
+  window.Flush();
+  EXPECT_EQ(0, window.images().size());
+  EXPECT_EQ(0, pager.NumPagedInImages());
+  EXPECT_EQ(6, frozen.GetNumberCameras());
+  EXPECT_EQ(2, reconstruction.GetNumberCameras());
+  EXPECT_EQ(npoints, frozen.GetNumberStructures());
+
+  reconstruction.ClearCamerasMap();
+  reconstruction.ClearStructuresMap();
+  frozen.ClearCamerasMap();
+  frozen.ClearStructuresMap();
+  file.Close();
+  std::remove(filename.c_str());
+}
+
+}  // namespace
+}  // namespace libmv
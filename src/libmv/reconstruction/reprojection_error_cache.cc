@@ -0,0 +1,153 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/base/thread.h"
+#include "libmv/reconstruction/reprojection_error_cache.h"
+
+namespace libmv {
+namespace {
+
+// Groups the observations by their values (camera or point indices), as a
+// compressed row list.
+void GroupObservations(const vector<int> &values, int num_values,
+                       std::vector<int> *begin,
+                       std::vector<int> *observations) {
+  begin->assign(num_values + 1, 0);
+  for (int k = 0; k < values.size(); ++k) {
+    ++(*begin)[values[k] + 1];
+  }
+  for (int i = 0; i < num_values; ++i) {
+    (*begin)[i + 1] += (*begin)[i];
+  }
+  observations->resize(values.size());
+  std::vector<int> next(begin->begin(), begin->end() - 1);
+  for (int k = 0; k < values.size(); ++k) {
+    (*observations)[next[values[k]]++] = k;
+  }
+}
+
+struct SquaredErrorsFunctor {
+  const DenseReconstruction *reconstruction;
+  std::vector<double> *squared_errors;
+
+  void operator()(int k) {
+    (*squared_errors)[k] = SquaredReprojectionError(*reconstruction, k);
+  }
+};
+
+}  // namespace
+
+double SquaredReprojectionError(const DenseReconstruction &reconstruction,
+                                int k) {
+  int c = reconstruction.observation_cameras()[k];
+  const Vec3 &X = reconstruction.Xs()[reconstruction.observation_points()[k]];
+  Vec3 x = reconstruction.Ks()[c] * (reconstruction.Rs()[c] * X +
+                                     reconstruction.ts()[c]);
+  return (x.head<2>() / x(2) - reconstruction.observations()[k]).squaredNorm();
+}
+
+ReprojectionErrorCache::ReprojectionErrorCache(
+    const DenseReconstruction *reconstruction, int num_threads)
+  : reconstruction_(reconstruction), sum_squared_errors_(0),
+    num_reprojected_(0) {
+  Rebuild(num_threads);
+}
+
+void ReprojectionErrorCache::Rebuild(int num_threads) {
+  GroupObservations(reconstruction_->observation_cameras(),
+                    reconstruction_->NumCameras(),
+                    &camera_begin_, &camera_observations_);
+  GroupObservations(reconstruction_->observation_points(),
+                    reconstruction_->NumPoints(),
+                    &point_begin_, &point_observations_);
+  Recompute(num_threads);
+}
+
+void ReprojectionErrorCache::Recompute(int num_threads) {
+  int num_observations = reconstruction_->NumObservations();
+  squared_errors_.resize(num_observations);
+  SquaredErrorsFunctor functor;
+  functor.reconstruction = reconstruction_;
+  functor.squared_errors = &squared_errors_;
+  ParallelFor(0, num_observations, num_threads, &functor);
+  num_reprojected_ += num_observations;
+
+  // Summed in order, so that the result does not depend on num_threads.
+  sum_squared_errors_ = 0;
+  for (int k = 0; k < num_observations; ++k) {
+    sum_squared_errors_ += squared_errors_[k];
+  }
+  changed_.clear();
+  is_changed_.assign(num_observations, 0);
+}
+
+void ReprojectionErrorCache::MarkCameraChanged(int camera) {
+  MarkObservations(camera_begin_, camera_observations_, camera);
+}
+
+void ReprojectionErrorCache::MarkPointChanged(int point) {
+  MarkObservations(point_begin_, point_observations_, point);
+}
+
+void ReprojectionErrorCache::MarkObservations(
+    const std::vector<int> &begin,
+    const std::vector<int> &observations,
+    int index) {
+  for (int i = begin[index]; i < begin[index + 1]; ++i) {
+    int k = observations[i];
+    if (!is_changed_[k]) {
+      is_changed_[k] = 1;
+      changed_.push_back(k);
+    }
+  }
+}
+
+void ReprojectionErrorCache::Update() {
+  for (int i = 0; i < changed_.size(); ++i) {
+    int k = changed_[i];
+    double squared_error = SquaredReprojectionError(*reconstruction_, k);
+    sum_squared_errors_ += squared_error - squared_errors_[k];
+    squared_errors_[k] = squared_error;
+    is_changed_[k] = 0;
+  }
+  num_reprojected_ += changed_.size();
+  changed_.clear();
+  // The updates can accumulate rounding errors.
+  if (sum_squared_errors_ < 0) {
+    sum_squared_errors_ = 0;
+  }
+}
+
+double ReprojectionErrorCache::RootMeanSquareError() {
+  Update();
+  if (squared_errors_.empty()) {
+    return 0;
+  }
+  return sqrt(sum_squared_errors_ / squared_errors_.size());
+}
+
+double ReprojectionErrorCache::SquaredError(int observation) {
+  if (is_changed_[observation]) {
+    Update();
+  }
+  return squared_errors_[observation];
+}
+
+}  // namespace libmv
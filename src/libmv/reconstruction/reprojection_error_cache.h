@@ -0,0 +1,97 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_RECONSTRUCTION_REPROJECTION_ERROR_CACHE_H_
+#define LIBMV_RECONSTRUCTION_REPROJECTION_ERROR_CACHE_H_
+
+#include <vector>
+
+#include "libmv/reconstruction/dense_reconstruction.h"
+
+namespace libmv {
+
+// Squared reprojection error of the observation k of reconstruction.
+double SquaredReprojectionError(const DenseReconstruction &reconstruction,
+                                int k);
+
+// Keeps the squared reprojection errors of the observations of a dense
+// reconstruction, so that the root mean square error can be queried without
+// reprojecting every observation. After changing cameras or points, mark them
+// as changed: the next query only reprojects their observations.
+//
+// Usage:
+//
+//   ReprojectionErrorCache errors(&dense);
+//   dense.Rs()[c] = ...;
+//   errors.MarkCameraChanged(c);
+//   double rms = errors.RootMeanSquareError();
+//
+// The reconstruction must outlive the cache. If observations are added to it,
+// call Rebuild().
+class ReprojectionErrorCache {
+ public:
+  // Computes all the errors with num_threads threads.
+  explicit ReprojectionErrorCache(const DenseReconstruction *reconstruction,
+                                  int num_threads = 1);
+
+  // Rebuilds the observation tables and recomputes all the errors.
+  void Rebuild(int num_threads = 1);
+
+  // Recomputes all the errors, in parallel, and forgets the changes.
+  void Recompute(int num_threads = 1);
+
+  void MarkCameraChanged(int camera);
+  void MarkPointChanged(int point);
+
+  // Updates the errors of the observations of the changed cameras and points
+  // and returns the root mean square error, in pixels.
+  double RootMeanSquareError();
+
+  // Same as above, for the squared error of one observation.
+  double SquaredError(int observation);
+
+  // The number of observations that have been reprojected since the
+  // creation of the cache.
+  int num_reprojected() const { return num_reprojected_; }
+
+ private:
+  void MarkObservations(const std::vector<int> &begin,
+                        const std::vector<int> &observations,
+                        int index);
+  void Update();
+
+  const DenseReconstruction *reconstruction_;
+
+  // Observations grouped by camera and by point.
+  std::vector<int> camera_begin_, camera_observations_;
+  std::vector<int> point_begin_, point_observations_;
+
+  std::vector<double> squared_errors_;
+  double sum_squared_errors_;
+
+  // Observations to reproject at the next query, without duplicates.
+  std::vector<int> changed_;
+  std::vector<char> is_changed_;
+  int num_reprojected_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_RECONSTRUCTION_REPROJECTION_ERROR_CACHE_H_
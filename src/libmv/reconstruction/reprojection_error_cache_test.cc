@@ -0,0 +1,88 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/numeric/numeric.h"
+#include "libmv/reconstruction/dense_reconstruction.h"
+#include "libmv/reconstruction/optimization.h"
+#include "libmv/reconstruction/reprojection_error_cache.h"
+#include "testing/testing.h"
+
+namespace libmv {
+namespace {
+
+// Three cameras seeing every point of a small grid, the observations
+// slightly off.
+void SyntheticDenseReconstruction(DenseReconstruction *dense) {
+  Mat3 K;
+  K << 500, 0, 320,
+       0, 500, 240,
+       0, 0, 1;
+  for (int c = 0; c < 3; ++c) {
+    dense->InsertCamera(c, K, RotationAroundY(0.05 * c), Vec3(-0.2 * c, 0, 5));
+  }
+  for (int j = 0; j < 20; ++j) {
+    dense->InsertPoint(j, Vec3(j % 5 - 2, j / 5 - 2, j % 3));
+  }
+  for (int c = 0; c < 3; ++c) {
+    for (int j = 0; j < 20; ++j) {
+      Vec3 x = K * (dense->Rs()[c] * dense->Xs()[j] + dense->ts()[c]);
+      dense->AddObservation(c, j, x.head<2>() / x(2) + Vec2::Random());
+    }
+  }
+}
+
+TEST(ReprojectionErrorCache, MatchesFullRecomputation) {
+  DenseReconstruction dense;
+  SyntheticDenseReconstruction(&dense);
+  ReprojectionErrorCache errors(&dense);
+  EXPECT_NEAR(EstimateRootMeanSquareError(dense),
+              errors.RootMeanSquareError(), 1e-12);
+  EXPECT_EQ(dense.NumObservations(), errors.num_reprojected());
+
+  // Only the observations of the changed camera and point are reprojected.
+  dense.ts()[1] += Vec3(0.01, 0, 0);
+  dense.Xs()[7] += Vec3(0, 0.02, 0);
+  errors.MarkCameraChanged(1);
+  errors.MarkPointChanged(7);
+  double rms = errors.RootMeanSquareError();
+  EXPECT_NEAR(EstimateRootMeanSquareError(dense), rms, 1e-12);
+  EXPECT_EQ(dense.NumObservations() + 20 + 2, errors.num_reprojected());
+  EXPECT_NEAR(SquaredReprojectionError(dense, 27), errors.SquaredError(27),
+              0);
+
+  // Nothing changed since the last query.
+  EXPECT_EQ(rms, errors.RootMeanSquareError());
+  EXPECT_EQ(dense.NumObservations() + 22, errors.num_reprojected());
+}
+
+TEST(ReprojectionErrorCache, ParallelRecomputationIsDeterministic) {
+  DenseReconstruction dense;
+  SyntheticDenseReconstruction(&dense);
+  double rms = EstimateRootMeanSquareError(dense);
+  for (int num_threads = 2; num_threads <= 4; ++num_threads) {
+    EXPECT_EQ(rms, EstimateRootMeanSquareError(dense, num_threads));
+    ReprojectionErrorCache errors(&dense, 1);
+    errors.Recompute(num_threads);
+    EXPECT_EQ(rms, errors.RootMeanSquareError());
+  }
+}
+
+}  // namespace
+}  // namespace libmv
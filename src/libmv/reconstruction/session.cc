@@ -0,0 +1,285 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+#include "libmv/correspondence/import_matches_txt.h"
+#include "libmv/image/image_converter.h"
+#include "libmv/image/image_sequence_io.h"
+#include "libmv/logging/logging.h"
+#include "libmv/reconstruction/euclidean_reconstruction.h"
+#include "libmv/reconstruction/export_blender.h"
+#include "libmv/reconstruction/export_ply.h"
+#include "libmv/reconstruction/optimization.h"
+#include "libmv/reconstruction/session.h"
+
+namespace libmv {
+namespace {
+
+// The detectors work on gray byte images, as the tracker tool gives them,
+// while the frames of the sequences are float images. Returns NULL if the
+// frame is neither.
+ByteImage *GrayByteFrame(const Image &frame) {
+  ByteImage bytes;
+  if (frame.AsArray3Du()) {
+    bytes = *frame.AsArray3Du();
+  } else if (frame.AsArray3Df()) {
+    FloatArrayToScaledByteArray(*frame.AsArray3Df(), &bytes);
+  } else {
+    return NULL;
+  }
+  ByteImage *gray = new ByteImage();
+  if (bytes.Depth() == 3) {
+    Rgb2Gray(bytes, gray);
+  } else {
+    gray->Swap(&bytes);
+  }
+  return gray;
+}
+
+}  // namespace
+
+ReconstructionSession::ReconstructionSession(tracker::Tracker *tracker,
+                                             int num_threads,
+                                             long long image_cache_size)
+  : tracker_(tracker),
+    num_threads_(num_threads),
+    image_cache_(image_cache_size, ImageCache::THREAD_SAFE),
+    frames_(NULL),
+    num_tracked_frames_(0),
+    imported_(false) {
+}
+
+ReconstructionSession::~ReconstructionSession() {
+  ResetTracks();
+}
+
+bool ReconstructionSession::Open(const std::vector<std::string> &paths) {
+  if (frames_.get() && paths == paths_) {
+    return true;
+  }
+  ImageSequence *frames = ImageSequenceFromPaths(paths, &image_cache_);
+  if (!frames) {
+    return false;
+  }
+  ResetTracks();
+  features_.clear();
+  frames_.reset(frames);
+  paths_ = paths;
+  return true;
+}
+
+int ReconstructionSession::Track(int last) {
+  if (!tracker_.get() || !frames_.get() || imported_) {
+    return -1;
+  }
+  if (last < 0 || last >= NumFrames()) {
+    last = NumFrames() - 1;
+  }
+  int num_tracked = 0;
+  for (int i = num_tracked_frames_; i <= last; ++i) {
+    std::map<int, FeatureSet>::iterator it = features_.find(i);
+    if (it == features_.end()) {
+      Image *frame = frames_->GetImage(i);
+      ByteImage *gray = frame ? GrayByteFrame(*frame) : NULL;
+      if (frame) {
+        frames_->Unpin(i);
+      }
+      if (!gray) {
+        LOG(ERROR) << "Cannot read frame " << i;
+        return -1;
+      }
+      Image image(gray);
+      it = features_.insert(std::make_pair(i, FeatureSet())).first;
+      tracker_->DetectAndDescribe(image, &it->second);
+    }
+    // The tracker owns a copy, so that the features stay for a re-track.
+    tracker::FeaturesGraph new_graph;
+    Matches::ImageID image_id;
+    tracker_->Track(new FeatureSet(it->second), last_graph_, &new_graph,
+                    &image_id);
+    last_graph_.Clear();
+    last_graph_.Merge(new_graph);
+    graph_.Merge(new_graph);
+    ++num_tracked_frames_;
+    ++num_tracked;
+  }
+  return num_tracked;
+}
+
+void ReconstructionSession::ResetTracks() {
+  DeleteReconstructions();
+  last_graph_.Clear();
+  graph_.DeleteAndClear();
+  num_tracked_frames_ = 0;
+  imported_ = false;
+  if (tracker_.get()) {
+    // Empties the track index.
+    tracker_->set_use_track_index(tracker_->use_track_index());
+  }
+}
+
+bool ReconstructionSession::ImportMatches(const std::string &filename) {
+  ResetTracks();
+  FeatureSet *feature_set = graph_.CreateNewFeatureSet();
+  if (!ImportMatchesFromTxtParallel(filename, &graph_.matches_, feature_set,
+                                    num_threads_)) {
+    return false;
+  }
+  imported_ = true;
+  return true;
+}
+
+int ReconstructionSession::Solve(int image_width,
+                                 int image_height,
+                                 double focal) {
+  DeleteReconstructions();
+  EuclideanReconstructionFromVideo(graph_.matches_, image_width, image_height,
+                                   focal, &reconstructions_, num_threads_);
+  return reconstructions_.size();
+}
+
+double ReconstructionSession::Refine() {
+  double rms = -1;
+  std::list<Reconstruction *>::iterator it = reconstructions_.begin();
+  for (; it != reconstructions_.end(); ++it) {
+    rms = std::max(rms, MetricBundleAdjust(graph_.matches_, *it));
+  }
+  return rms;
+}
+
+bool ReconstructionSession::Export(const std::string &filename) const {
+  size_t dot = filename.rfind('.');
+  if (dot == std::string::npos || reconstructions_.empty()) {
+    return false;
+  }
+  std::string name = filename.substr(0, dot), ext = filename.substr(dot);
+  if (ext != ".ply" && ext != ".py") {
+    return false;
+  }
+  int i = 0;
+  std::list<Reconstruction *>::const_iterator it = reconstructions_.begin();
+  for (; it != reconstructions_.end(); ++it, ++i) {
+    std::stringstream s;
+    if (reconstructions_.size() > 1)
+      s << name << "-" << i << ext;
+    else
+      s << filename;
+    if (ext == ".ply")
+      ExportToPLY(**it, s.str());
+    else
+      ExportToBlenderScript(**it, s.str());
+  }
+  return true;
+}
+
+std::string ReconstructionSession::Execute(const std::string &request,
+                                           bool *quit) {
+  std::istringstream stream(request);
+  std::string command;
+  stream >> command;
+  std::ostringstream reply;
+  *quit = false;
+  if (command == "open") {
+    std::vector<std::string> paths;
+    std::string path;
+    while (stream >> path) {
+      paths.push_back(path);
+    }
+    if (paths.empty() || !Open(paths)) {
+      return "error cannot open the shot";
+    }
+    reply << "ok " << NumFrames();
+  } else if (command == "track") {
+    int last = -1;
+    std::string word;
+    if (stream >> word) {
+      char *end;
+      last = strtol(word.c_str(), &end, 10);
+      if (*end) {
+        return "error usage: track [LAST]";
+      }
+    }
+    int num_tracked = Track(last);
+    if (num_tracked < 0) {
+      return "error cannot track the frames";
+    }
+    reply << "ok " << num_tracked << " " << matches().NumTracks();
+  } else if (command == "reset") {
+    ResetTracks();
+    reply << "ok";
+  } else if (command == "import") {
+    std::string filename;
+    if (!(stream >> filename) || !ImportMatches(filename)) {
+      return "error cannot import the matches";
+    }
+    reply << "ok " << matches().NumImages() << " " << matches().NumTracks();
+  } else if (command == "solve") {
+    int width, height;
+    double focal;
+    if (!(stream >> width >> height >> focal)) {
+      return "error usage: solve WIDTH HEIGHT FOCAL";
+    }
+    int num_reconstructions = Solve(width, height, focal);
+    int num_cameras = 0, num_points = 0;
+    std::list<Reconstruction *>::const_iterator it = reconstructions_.begin();
+    for (; it != reconstructions_.end(); ++it) {
+      num_cameras += (*it)->GetNumberCameras();
+      num_points += (*it)->GetNumberStructures();
+    }
+    reply << "ok " << num_reconstructions << " " << num_cameras << " "
+          << num_points;
+  } else if (command == "refine") {
+    double rms = Refine();
+    if (rms < 0) {
+      return "error nothing to refine";
+    }
+    reply << "ok " << rms;
+  } else if (command == "export") {
+    std::string filename;
+    if (!(stream >> filename) || !Export(filename)) {
+      return "error cannot export the reconstructions";
+    }
+    reply << "ok";
+  } else if (command == "status") {
+    reply << "ok " << NumFrames() << " " << NumTrackedFrames() << " "
+          << matches().NumTracks() << " " << reconstructions_.size();
+  } else if (command == "quit") {
+    *quit = true;
+    reply << "ok";
+  } else {
+    return "error unknown request '" + command + "'";
+  }
+  return reply.str();
+}
+
+void ReconstructionSession::DeleteReconstructions() {
+  std::list<Reconstruction *>::iterator it = reconstructions_.begin();
+  for (; it != reconstructions_.end(); ++it) {
+    (*it)->ClearCamerasMap();
+    (*it)->ClearStructuresMap();
+    delete *it;
+  }
+  reconstructions_.clear();
+}
+
+}  // namespace libmv
@@ -0,0 +1,132 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_RECONSTRUCTION_SESSION_H_
+#define LIBMV_RECONSTRUCTION_SESSION_H_
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "libmv/base/scoped_ptr.h"
+#include "libmv/correspondence/tracker.h"
+#include "libmv/image/cached_image_sequence.h"
+#include "libmv/image/image_sequence.h"
+#include "libmv/reconstruction/reconstruction.h"
+
+namespace libmv {
+
+// The state of the reconstruction of a shot kept between requests, so that
+// the small re-solves of an interactive session do not pay for the startup
+// of a tool: the frames stay in an image cache, the features of the tracked
+// frames are kept (a re-track only matches them again), the tracker keeps its
+// matcher and track index, and the last reconstructions can be refined
+// without solving again.
+//
+// Execute() runs the requests of the text protocol served by the libmv_server
+// tool, one request per line, of whitespace separated words (so the paths
+// cannot contain spaces):
+//
+//   open PATH...            opens the frames of a shot, image files or a
+//                           video (see ImageSequenceFromPaths()). Reopening
+//                           the open shot keeps everything, another shot
+//                           starts from scratch.
+//   track [LAST]            tracks the frames after the tracked ones, up to
+//                           LAST included or the end of the shot.
+//   reset                   forgets the tracks and the reconstructions, but
+//                           not the frames and their features.
+//   import FILE             replaces the tracks with the matches of FILE
+//                           (see ImportMatchesFromTxt()); frames are not
+//                           tracked again until a reset.
+//   solve WIDTH HEIGHT F    reconstructs the tracks, see
+//                           EuclideanReconstructionFromVideo().
+//   refine                  bundle adjusts the last reconstructions.
+//   export FILE             writes them as PLY (.ply) or Blender (.py) files.
+//   status                  the frames, tracked frames, tracks and
+//                           reconstructions.
+//   quit                    stops the server.
+//
+// The reply is one line, "ok" followed by the results of the request, or
+// "error" followed by a message.
+class ReconstructionSession {
+ public:
+  // The tracker, owned by the session, extracts and matches the features of
+  // the frames; without one, only imported matches can be solved. The
+  // frames are kept in a thread safe image cache of image_cache_size bytes.
+  ReconstructionSession(tracker::Tracker *tracker,
+                        int num_threads = 1,
+                        long long image_cache_size = 256 * 1024 * 1024);
+  ~ReconstructionSession();
+
+  bool Open(const std::vector<std::string> &paths);
+  // Returns the number of frames tracked, or -1 if a frame cannot be read or
+  // there is no tracker.
+  int Track(int last = -1);
+  void ResetTracks();
+  bool ImportMatches(const std::string &filename);
+  // Returns the number of reconstructions.
+  int Solve(int image_width, int image_height, double focal);
+  // Returns the largest root mean square error of the adjusted
+  // reconstructions, or -1 if there is none.
+  double Refine();
+  bool Export(const std::string &filename) const;
+
+  // Runs a request of the protocol above and returns its reply. quit is set
+  // to whether the request asks to stop.
+  std::string Execute(const std::string &request, bool *quit);
+
+  int NumFrames() const { return frames_.get() ? frames_->Length() : 0; }
+  int NumTrackedFrames() const { return num_tracked_frames_; }
+  const Matches &matches() const { return graph_.matches_; }
+  const std::list<Reconstruction *> &reconstructions() const {
+    return reconstructions_;
+  }
+
+ private:
+  void DeleteReconstructions();
+
+  scoped_ptr<tracker::Tracker> tracker_;
+  int num_threads_;
+  ImageCache image_cache_;
+
+  std::vector<std::string> paths_;
+  scoped_ptr<ImageSequence> frames_;
+  // The features extracted from the frames, by frame.
+  std::map<int, FeatureSet> features_;
+
+  // The tracks of all the frames, which own the feature sets, and those of
+  // the last tracked frame, which the next one is matched with.
+  tracker::FeaturesGraph graph_;
+  tracker::FeaturesGraph last_graph_;
+  int num_tracked_frames_;
+  // Whether the tracks were imported, in which case frames are not tracked
+  // until a reset.
+  bool imported_;
+
+  std::list<Reconstruction *> reconstructions_;
+
+  ReconstructionSession(const ReconstructionSession &);
+  ReconstructionSession &operator=(const ReconstructionSession &);
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_RECONSTRUCTION_SESSION_H_
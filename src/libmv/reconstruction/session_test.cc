@@ -0,0 +1,118 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "libmv/correspondence/export_matches_txt.h"
+#include "libmv/multiview/test_data_sets.h"
+#include "libmv/reconstruction/session.h"
+#include "testing/testing.h"
+
+namespace libmv {
+namespace {
+
+// Writes the matches of a synthetic video to filename.
+void WriteSyntheticMatches(const SyntheticVideoOptions &options,
+                           const std::string &filename) {
+  NViewDataSet d = SyntheticVideo(options);
+  Matches matches;
+  std::vector<PointFeature> features;
+  int num_features = 0;
+  for (int i = 0; i < d.n; ++i) {
+    num_features += d.x[i].cols();
+  }
+  features.reserve(num_features);
+  for (int i = 0; i < d.n; ++i) {
+    for (int k = 0; k < d.x[i].cols(); ++k) {
+      features.push_back(PointFeature(d.x[i](0, k), d.x[i](1, k)));
+      matches.Insert(i, d.x_ids[i][k], &features.back());
+    }
+  }
+  ExportMatchesToTxt(matches, filename);
+}
+
+TEST(ReconstructionSession, RejectsMalformedRequests) {
+  ReconstructionSession session(NULL);
+  bool quit;
+  EXPECT_EQ("ok 0 0 0 0", session.Execute("status", &quit));
+  EXPECT_FALSE(quit);
+  EXPECT_EQ(0, session.Execute("fly away", &quit).find("error"));
+  EXPECT_EQ(0, session.Execute("", &quit).find("error"));
+  EXPECT_EQ(0, session.Execute("solve 640", &quit).find("error"));
+  EXPECT_EQ(0, session.Execute("track 3x", &quit).find("error"));
+  // Nothing is open, and there is no tracker.
+  EXPECT_EQ(0, session.Execute("track", &quit).find("error"));
+  EXPECT_EQ(0, session.Execute("refine", &quit).find("error"));
+  EXPECT_EQ(0, session.Execute("import no_such_matches.txt", &quit)
+                   .find("error"));
+  EXPECT_FALSE(quit);
+  EXPECT_EQ("ok", session.Execute("quit", &quit));
+  EXPECT_TRUE(quit);
+}
+
+TEST(ReconstructionSession, RefinesWithoutSolvingAgain) {
+  SyntheticVideoOptions options;
+  options.num_frames = 12;
+  options.num_points = 150;
+  options.noise = 0.5;
+  std::string filename = "session_test_matches.txt";
+  WriteSyntheticMatches(options, filename);
+
+  ReconstructionSession session(NULL);
+  bool quit;
+  EXPECT_EQ(0, session.Execute("import " + filename, &quit).find("ok 12 "));
+  // Imported tracks are not extended by tracking.
+  EXPECT_EQ(0, session.Execute("track", &quit).find("error"));
+
+  EXPECT_EQ(0, session.Execute("solve 640 480 500", &quit).find("ok "));
+  ASSERT_FALSE(session.reconstructions().empty());
+  const Reconstruction *reconstruction = session.reconstructions().front();
+  int num_cameras = reconstruction->GetNumberCameras();
+  EXPECT_GT(num_cameras, 2);
+
+  // The reconstruction stays between the requests.
+  double rms = session.Refine();
+  EXPECT_GE(rms, 0);
+  EXPECT_LT(rms, 2);
+  EXPECT_EQ(reconstruction, session.reconstructions().front());
+  EXPECT_EQ(num_cameras, reconstruction->GetNumberCameras());
+  EXPECT_EQ(0, session.Execute("refine", &quit).find("ok "));
+
+  std::string ply = "session_test.ply";
+  EXPECT_EQ("ok", session.Execute("export " + ply, &quit));
+  FILE *file = fopen(ply.c_str(), "r");
+  EXPECT_TRUE(file != NULL);
+  if (file) {
+    fclose(file);
+  }
+  EXPECT_EQ(0, session.Execute("export session_test.txt", &quit)
+                   .find("error"));
+
+  EXPECT_EQ("ok", session.Execute("reset", &quit));
+  EXPECT_EQ(0, session.matches().NumTracks());
+  EXPECT_TRUE(session.reconstructions().empty());
+  remove(filename.c_str());
+  remove(ply.c_str());
+}
+
+}  // namespace
+}  // namespace libmv
@@ -0,0 +1,121 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cmath>
+
+#include "libmv/logging/logging.h"
+#include "libmv/multiview/structure.h"
+#include "libmv/reconstruction/structure_grid.h"
+
+namespace libmv {
+
+PointStructureGrid::PointStructureGrid(double voxel_size)
+    : voxel_size_(voxel_size) {
+  CHECK_GT(voxel_size, 0);
+}
+
+PointStructureGrid::PointStructureGrid(const Reconstruction &reconstruction,
+                                       double voxel_size)
+    : voxel_size_(voxel_size) {
+  CHECK_GT(voxel_size, 0);
+  std::map<StructureID, Structure *>::const_iterator iter =
+    reconstruction.structures().begin();
+  for (; iter != reconstruction.structures().end(); ++iter) {
+    PointStructure *point = dynamic_cast<PointStructure *>(iter->second);
+    if (point) {
+      Insert(iter->first, point->coords_affine());
+    }
+  }
+}
+
+void PointStructureGrid::Insert(StructureID id, const Vec3 &X) {
+  VoxelKey key(int(floor(X(0) / voxel_size_)),
+               std::make_pair(int(floor(X(1) / voxel_size_)),
+                              int(floor(X(2) / voxel_size_))));
+  std::map<VoxelKey, int>::iterator voxel = voxel_indices_.find(key);
+  if (voxel == voxel_indices_.end()) {
+    voxel = voxel_indices_.insert(std::make_pair(key, voxels_.size())).first;
+    voxel_keys_.push_back(key);
+    voxels_.push_back(Voxel());
+  }
+  voxels_[voxel->second].points.push_back(ids_.size());
+  ids_.push_back(id);
+  Xs_.push_back(X);
+}
+
+void PointStructureGrid::SelectVisibleStructures(
+    const PinholeCamera &camera,
+    vector<StructureID> *structures_ids,
+    double margin,
+    double max_depth) const {
+  const Vec2u &image_size = camera.image_size();
+  CHECK(image_size(0) > 0 && image_size(1) > 0);
+  const Mat34 &P = camera.projection_matrix();
+  // The planes (n, d) of the frustum, a point X being inside if n.X + d > 0.
+  Mat planes(max_depth > 0 ? 6 : 5, 4);
+  planes.row(0) = P.row(2);
+  planes.row(1) = P.row(0) + margin * P.row(2);
+  planes.row(2) = P.row(1) + margin * P.row(2);
+  planes.row(3) = (image_size(0) + margin) * P.row(2) - P.row(0);
+  planes.row(4) = (image_size(1) + margin) * P.row(2) - P.row(1);
+  if (max_depth > 0) {
+    // p3.X is the depth scaled by K(2, 2).
+    planes.row(5) = -P.row(2);
+    planes(5, 3) += max_depth * camera.intrinsic_matrix()(2, 2);
+  }
+  const int num_planes = planes.rows();
+
+  structures_ids->clear();
+  const Vec3 half_size = Vec3::Constant(voxel_size_ / 2);
+  for (int v = 0; v < voxels_.size(); ++v) {
+    const VoxelKey &key = voxel_keys_[v];
+    Vec3 center(key.first + 0.5, key.second.first + 0.5,
+                key.second.second + 0.5);
+    center *= voxel_size_;
+    // The box is outside if it is on the negative side of one plane, and
+    // inside if it is on the positive side of all the planes.
+    bool is_outside = false, is_inside = true;
+    for (int p = 0; p < num_planes && !is_outside; ++p) {
+      Vec3 n = planes.block<1, 3>(p, 0).transpose();
+      double distance = n.dot(center) + planes(p, 3);
+      double radius = n.cwiseAbs().dot(half_size);
+      is_outside = distance + radius <= 0;
+      is_inside = is_inside && distance - radius > 0;
+    }
+    if (is_outside) {
+      continue;
+    }
+    const std::vector<int> &points = voxels_[v].points;
+    for (int i = 0; i < points.size(); ++i) {
+      bool is_visible = true;
+      for (int p = 0; p < num_planes && is_visible && !is_inside; ++p) {
+        is_visible = planes.block<1, 3>(p, 0).dot(Xs_[points[i]].transpose())
+            + planes(p, 3) > 0;
+      }
+      if (is_visible) {
+        structures_ids->push_back(ids_[points[i]]);
+      }
+    }
+  }
+  std::sort(structures_ids->begin(), structures_ids->end());
+}
+
+}  // namespace libmv
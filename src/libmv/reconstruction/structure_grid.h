@@ -0,0 +1,85 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_RECONSTRUCTION_STRUCTURE_GRID_H_
+#define LIBMV_RECONSTRUCTION_STRUCTURE_GRID_H_
+
+#include <map>
+#include <vector>
+
+#include "libmv/base/vector.h"
+#include "libmv/camera/pinhole_camera.h"
+#include "libmv/numeric/numeric.h"
+#include "libmv/reconstruction/reconstruction.h"
+
+namespace libmv {
+
+// A sparse voxel grid over the point structures of a reconstruction, to find
+// the structures a camera sees without projecting all of them.
+//
+// A point X projects inside the image of P = K [R|t] at a positive depth if
+// it is on the positive side of the five planes of the frustum:
+//   p3.X > 0, p1.X >= 0, p2.X >= 0, w p3.X - p1.X > 0, h p3.X - p2.X > 0,
+// where pi is the i-th row of P and (w, h) the image size. A query tests
+// the bounding box of every occupied voxel against these planes: the points
+// of the voxels outside of the frustum are skipped, those of the voxels
+// inside are all selected, and only the points of the voxels crossing a
+// plane are tested one by one.
+//
+// The grid is a snapshot: it does not follow the changes of the
+// reconstruction, structures must be inserted as they are triangulated.
+class PointStructureGrid {
+ public:
+  explicit PointStructureGrid(double voxel_size);
+  // Inserts all the point structures of reconstruction.
+  PointStructureGrid(const Reconstruction &reconstruction, double voxel_size);
+
+  void Insert(StructureID id, const Vec3 &X);
+
+  int NumPoints() const { return ids_.size(); }
+  int NumVoxels() const { return voxels_.size(); }
+
+  // Selects, in increasing order, the structures that project in the image
+  // of camera enlarged by margin pixels on each side, in front of it and up
+  // to max_depth if max_depth > 0. The image size of camera must be set. The
+  // lens distortion of the camera is ignored; the margin can cover it.
+  void SelectVisibleStructures(const PinholeCamera &camera,
+                               vector<StructureID> *structures_ids,
+                               double margin = 0,
+                               double max_depth = 0) const;
+
+ private:
+  struct Voxel {
+    // The indices of the points in ids_ and Xs_.
+    std::vector<int> points;
+  };
+  typedef std::pair<int, std::pair<int, int> > VoxelKey;
+
+  double voxel_size_;
+  std::map<VoxelKey, int> voxel_indices_;
+  std::vector<VoxelKey> voxel_keys_;
+  std::vector<Voxel> voxels_;
+  std::vector<StructureID> ids_;
+  std::vector<Vec3> Xs_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_RECONSTRUCTION_STRUCTURE_GRID_H_
@@ -0,0 +1,131 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+
+#include "libmv/base/vector.h"
+#include "libmv/camera/pinhole_camera.h"
+#include "libmv/multiview/structure.h"
+#include "libmv/numeric/numeric.h"
+#include "libmv/reconstruction/reconstruction.h"
+#include "libmv/reconstruction/structure_grid.h"
+#include "testing/testing.h"
+
+namespace libmv {
+namespace {
+
+// Points spread in a cube around the origin, seen by cameras turning around
+// it, some of them from inside the cube.
+void SyntheticScene(Reconstruction *recons, vector<PinholeCamera *> *cameras) {
+  srand(7);
+  for (int j = 0; j < 2000; ++j) {
+    recons->InsertTrack(j, new PointStructure(Vec3(5 * Vec3::Random())));
+  }
+  Mat3 K;
+  K << 500, 0, 320,
+       0, 500, 240,
+       0, 0, 1;
+  for (int c = 0; c < 6; ++c) {
+    Mat3 R = RotationAroundY(c * M_PI / 3);
+    Vec3 t(0.3 * c, -0.5, 2 * c - 2);
+    PinholeCamera *camera = new PinholeCamera(K, R, t);
+    camera->set_image_size(Vec2u(640, 480));
+    cameras->push_back(camera);
+  }
+}
+
+TEST(PointStructureGrid, SelectsTheProjectedStructures) {
+  Reconstruction recons;
+  vector<PinholeCamera *> cameras;
+  SyntheticScene(&recons, &cameras);
+  Mat4X X(4, recons.GetNumberStructures());
+  for (int j = 0; j < X.cols(); ++j) {
+    X.col(j) = dynamic_cast<PointStructure *>(
+        recons.GetStructure(j))->coords();
+  }
+
+  double voxel_sizes[] = {0.3, 1, 4, 20};
+  for (int s = 0; s < 4; ++s) {
+    PointStructureGrid grid(recons, voxel_sizes[s]);
+    EXPECT_EQ(X.cols(), grid.NumPoints());
+    for (int c = 0; c < cameras.size(); ++c) {
+      Mat2X x;
+      std::vector<char> is_visible;
+      cameras[c]->ProjectPoints(X, &x, &is_visible);
+      vector<StructureID> expected;
+      for (int j = 0; j < X.cols(); ++j) {
+        if (is_visible[j]) {
+          expected.push_back(j);
+        }
+      }
+      vector<StructureID> visible;
+      grid.SelectVisibleStructures(*cameras[c], &visible);
+      ASSERT_EQ(expected.size(), visible.size());
+      for (int i = 0; i < visible.size(); ++i) {
+        EXPECT_EQ(expected[i], visible[i]);
+      }
+    }
+  }
+  for (int c = 0; c < cameras.size(); ++c) {
+    delete cameras[c];
+  }
+  recons.ClearStructuresMap();
+}
+
+TEST(PointStructureGrid, MarginAndMaximumDepth) {
+  Reconstruction recons;
+  vector<PinholeCamera *> cameras;
+  SyntheticScene(&recons, &cameras);
+  PointStructureGrid grid(recons, 1);
+  // Looking at the whole cube from a distance.
+  PinholeCamera camera(cameras[0]->intrinsic_matrix(), Mat3::Identity(),
+                       Vec3(0, 0, 10));
+  camera.set_image_size(Vec2u(640, 480));
+
+  const double margin = 50, max_depth = 10;
+  vector<StructureID> all, enlarged, near;
+  grid.SelectVisibleStructures(camera, &all);
+  grid.SelectVisibleStructures(camera, &enlarged, margin);
+  grid.SelectVisibleStructures(camera, &near, 0, max_depth);
+  EXPECT_GT(enlarged.size(), all.size());
+  EXPECT_LT(near.size(), all.size());
+  EXPECT_GT(near.size(), 0);
+
+  for (int j = 0; j < recons.GetNumberStructures(); ++j) {
+    Vec3 X = dynamic_cast<PointStructure *>(
+        recons.GetStructure(j))->coords_affine();
+    Vec3 hx = camera.projection_matrix() * EuclideanToHomogeneous(X);
+    Vec2 x = hx.head<2>() / hx(2);
+    bool is_enlarged = hx(2) > 0 &&
+        x(0) >= -margin && x(0) < 640 + margin &&
+        x(1) >= -margin && x(1) < 480 + margin;
+    bool is_near = hx(2) > 0 && hx(2) < max_depth &&
+        x(0) >= 0 && x(0) < 640 && x(1) >= 0 && x(1) < 480;
+    EXPECT_EQ(is_enlarged, std::count(enlarged.begin(), enlarged.end(), j));
+    EXPECT_EQ(is_near, std::count(near.begin(), near.end(), j));
+  }
+  for (int c = 0; c < cameras.size(); ++c) {
+    delete cameras[c];
+  }
+  recons.ClearStructuresMap();
+}
+
+}  // namespace
+}  // namespace libmv
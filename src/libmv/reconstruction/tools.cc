@@ -22,6 +22,7 @@
 #include <locale.h>
 
 #include "libmv/reconstruction/tools.h"
+#include "libmv/reconstruction/track_index.h"
 
 namespace libmv {
 
@@ -32,6 +33,11 @@ void SelectExistingPointStructures(const Matches &matches,
                                    const Reconstruction &reconstruction,
                                    vector<StructureID> *structures_ids,
                                    Mat2X *x_image) {
+  const ReconstructedTrackIndex *index = reconstruction.track_index();
+  if (index && &index->matches() == &matches) {
+    index->SelectTracks(image_id, true, structures_ids, x_image);
+    return;
+  }
   const size_t kNumberStructuresToReserve = 1000;
   structures_ids->resize(0);
   //TODO(julien) clean this
@@ -60,6 +66,11 @@ void SelectNonReconstructedPointStructures(const Matches &matches,
                                            const Reconstruction &reconstruction,
                                            vector<StructureID> *structures_ids,
                                            Mat2X *x_image) {
+  const ReconstructedTrackIndex *index = reconstruction.track_index();
+  if (index && &index->matches() == &matches) {
+    index->SelectTracks(image_id, false, structures_ids, x_image);
+    return;
+  }
   const size_t kNumberStructuresToReserve = 10000;
   structures_ids->resize(0);
   //TODO(julien) clean this
@@ -41,6 +41,8 @@ inline void VectorToMatrix(vector<Tvec> &vs, Tmat *m) {
 
 // Selects only the already reconstructed tracks observed in the image image_id
 // and returns a vector of StructureID and their feature coordinates
+// If a ReconstructedTrackIndex of matches is attached to the reconstruction,
+// it is used instead of the matches (the same goes for the function below).
 void SelectExistingPointStructures(const Matches &matches, 
                                    CameraID image_id,
                                    const Reconstruction &reconstruction,
@@ -0,0 +1,158 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include "libmv/reconstruction/track_index.h"
+#include "libmv/camera/pinhole_camera.h"
+
+namespace libmv {
+namespace {
+
+const char kRemoved = 2;
+
+}  // namespace
+
+ReconstructedTrackIndex::ReconstructedTrackIndex(
+    const Matches &matches,
+    const Reconstruction &reconstruction)
+  : matches_(&matches) {
+  std::set<Matches::ImageID>::const_iterator image_iter =
+    matches.get_images().begin();
+  for (; image_iter != matches.get_images().end(); ++image_iter) {
+    int begin = tracks_.size();
+    Matches::Features<PointFeature> fp =
+      matches.InImage<PointFeature>(*image_iter);
+    for (; fp; ++fp) {
+      track_entries_[fp.track()].push_back(tracks_.size());
+      tracks_.push_back(fp.track());
+      xs_.push_back(fp.feature()->coords.cast<double>());
+      is_reconstructed_.push_back(
+          reconstruction.TrackHasStructure(fp.track()));
+    }
+    image_entries_[*image_iter] = std::make_pair(begin, int(tracks_.size()));
+  }
+}
+
+void ReconstructedTrackIndex::SetTrackReconstructed(StructureID track,
+                                                    bool is_reconstructed) {
+  std::map<StructureID, std::vector<int> >::const_iterator it =
+    track_entries_.find(track);
+  if (it == track_entries_.end()) {
+    return;
+  }
+  for (size_t i = 0; i < it->second.size(); ++i) {
+    if (is_reconstructed_[it->second[i]] != kRemoved) {
+      is_reconstructed_[it->second[i]] = is_reconstructed;
+    }
+  }
+}
+
+void ReconstructedTrackIndex::RemoveFeature(CameraID image,
+                                            StructureID track) {
+  std::map<CameraID, std::pair<int, int> >::const_iterator image_it =
+    image_entries_.find(image);
+  std::map<StructureID, std::vector<int> >::const_iterator track_it =
+    track_entries_.find(track);
+  if (image_it == image_entries_.end() || track_it == track_entries_.end()) {
+    return;
+  }
+  for (size_t i = 0; i < track_it->second.size(); ++i) {
+    int e = track_it->second[i];
+    if (image_it->second.first <= e && e < image_it->second.second) {
+      is_reconstructed_[e] = kRemoved;
+    }
+  }
+}
+
+void ReconstructedTrackIndex::SetIntrinsics(const Mat3 &K,
+                                            const LensDistortion *distortion) {
+  std::map<CameraID, std::pair<int, int> >::const_iterator it =
+    image_entries_.begin();
+  for (; it != image_entries_.end(); ++it) {
+    SetImageIntrinsics(it->first, K, distortion);
+  }
+}
+
+void ReconstructedTrackIndex::SetImageIntrinsics(
+    CameraID image,
+    const Mat3 &K,
+    const LensDistortion *distortion) {
+  std::map<CameraID, std::pair<int, int> >::const_iterator it =
+    image_entries_.find(image);
+  if (it == image_entries_.end()) {
+    return;
+  }
+  bearings_.resize(xs_.size());
+  PinholeCamera camera(K, Mat3::Identity(), Vec3::Zero());
+  Mat3 K_inverse = K.inverse();
+  for (int e = it->second.first; e < it->second.second; ++e) {
+    Vec2 x = xs_[e];
+    if (distortion) {
+      distortion->ComputeUndistortedCoordinates(camera, xs_[e], &x);
+    }
+    Vec3 h = K_inverse * Vec3(x(0), x(1), 1);
+    bearings_[e] << h(0) / h(2), h(1) / h(2);
+  }
+  calibrated_images_.insert(image);
+}
+
+void ReconstructedTrackIndex::SelectTracks(CameraID image,
+                                           bool is_reconstructed,
+                                           vector<StructureID> *structures_ids,
+                                           Mat2X *x_image,
+                                           Mat2X *x_camera) const {
+  structures_ids->resize(0);
+  std::map<CameraID, std::pair<int, int> >::const_iterator it =
+    image_entries_.find(image);
+  if (it == image_entries_.end()) {
+    if (x_image) {
+      x_image->resize(2, 0);
+    }
+    if (x_camera) {
+      x_camera->resize(2, 0);
+    }
+    return;
+  }
+  assert(!x_camera || HasIntrinsics(image));
+  int begin = it->second.first, end = it->second.second;
+  int count = 0;
+  for (int e = begin; e < end; ++e) {
+    count += is_reconstructed_[e] == is_reconstructed;
+  }
+  structures_ids->reserve(count);
+  if (x_image) {
+    x_image->resize(2, count);
+  }
+  if (x_camera) {
+    x_camera->resize(2, count);
+  }
+  for (int e = begin; e < end; ++e) {
+    if (is_reconstructed_[e] == is_reconstructed) {
+      if (x_image) {
+        x_image->col(structures_ids->size()) = xs_[e];
+      }
+      if (x_camera) {
+        x_camera->col(structures_ids->size()) = bearings_[e];
+      }
+      structures_ids->push_back(tracks_[e]);
+    }
+  }
+}
+
+}  // namespace libmv
@@ -0,0 +1,107 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_RECONSTRUCTION_TRACK_INDEX_H_
+#define LIBMV_RECONSTRUCTION_TRACK_INDEX_H_
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "libmv/base/vector.h"
+#include "libmv/camera/lens_distortion.h"
+#include "libmv/correspondence/matches.h"
+#include "libmv/numeric/numeric.h"
+#include "libmv/reconstruction/reconstruction.h"
+
+namespace libmv {
+
+// Index of the point features of some matches, by image, stored as
+// contiguous arrays of (track, coordinates, has a structure) entries.
+//
+// Once attached to a reconstruction with Reconstruction::set_track_index(),
+// the index follows the structures inserted and removed in the
+// reconstruction, and SelectExistingPointStructures() and
+// SelectNonReconstructedPointStructures() called with the same matches scan
+// its arrays instead of iterating the matches and looking up each track.
+// The matches must not change while the index is attached.
+//
+// With the intrinsics of the images, the index also keeps the normalized
+// camera coordinates (undistorted, then multiplied by K^-1) of the features,
+// so that the calibrated solvers do not normalize them again at every call.
+class ReconstructedTrackIndex {
+ public:
+  ReconstructedTrackIndex(const Matches &matches,
+                          const Reconstruction &reconstruction);
+
+  const Matches &matches() const { return *matches_; }
+
+  // Called by the reconstruction when the structure of track is inserted
+  // or removed.
+  void SetTrackReconstructed(StructureID track, bool is_reconstructed);
+
+  // Forgets the feature of track in image, after it has been removed from
+  // the matches.
+  void RemoveFeature(CameraID image, StructureID track);
+
+  // Computes the normalized camera coordinates of the features of all the
+  // images, or of one image, with the calibration matrix K and the optional
+  // lens distortion (not owned, only used during the call).
+  void SetIntrinsics(const Mat3 &K, const LensDistortion *distortion = NULL);
+  void SetImageIntrinsics(CameraID image,
+                          const Mat3 &K,
+                          const LensDistortion *distortion = NULL);
+
+  // Whether the normalized coordinates of the features of image are known.
+  bool HasIntrinsics(CameraID image) const {
+    return calibrated_images_.count(image) > 0;
+  }
+
+  // Selects the tracks observed in image that have (or do not have) a
+  // structure, in the order of the matches, and the coordinates of their
+  // features if x_image is not NULL. x_camera receives their normalized
+  // camera coordinates, which requires HasIntrinsics(image).
+  void SelectTracks(CameraID image,
+                    bool is_reconstructed,
+                    vector<StructureID> *structures_ids,
+                    Mat2X *x_image,
+                    Mat2X *x_camera = NULL) const;
+
+ private:
+  const Matches *matches_;
+
+  // The entries of an image are [begin, end).
+  std::map<CameraID, std::pair<int, int> > image_entries_;
+  vector<StructureID> tracks_;
+  vector<Vec2> xs_;
+  // The normalized camera coordinates of the entries, valid for the images
+  // of calibrated_images_.
+  vector<Vec2> bearings_;
+  std::set<CameraID> calibrated_images_;
+  // 0 or 1, or kRemoved for the removed features which are never selected.
+  std::vector<char> is_reconstructed_;
+
+  // The entries of each track.
+  std::map<StructureID, std::vector<int> > track_entries_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_RECONSTRUCTION_TRACK_INDEX_H_
@@ -0,0 +1,157 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <list>
+
+#include "libmv/multiview/projection.h"
+#include "libmv/reconstruction/reconstruction.h"
+#include "libmv/reconstruction/tools.h"
+#include "libmv/reconstruction/track_index.h"
+#include "testing/testing.h"
+
+namespace libmv {
+namespace {
+
+// Compares the selections with and without the index attached.
+void ExpectSameSelections(const Matches &matches,
+                          Reconstruction *reconstruction,
+                          ReconstructedTrackIndex *index) {
+  for (int image = 0; image < 4; ++image) {
+    vector<StructureID> expected_ids, ids;
+    Mat2X expected_x, x;
+    reconstruction->set_track_index(NULL);
+    SelectExistingPointStructures(matches, image, *reconstruction,
+                                  &expected_ids, &expected_x);
+    reconstruction->set_track_index(index);
+    SelectExistingPointStructures(matches, image, *reconstruction, &ids, &x);
+    ASSERT_EQ(expected_ids.size(), ids.size());
+    for (int i = 0; i < ids.size(); ++i) {
+      EXPECT_EQ(expected_ids[i], ids[i]);
+    }
+    EXPECT_MATRIX_NEAR(expected_x, x, 0);
+
+    reconstruction->set_track_index(NULL);
+    SelectNonReconstructedPointStructures(matches, image, *reconstruction,
+                                          &expected_ids, &expected_x);
+    reconstruction->set_track_index(index);
+    SelectNonReconstructedPointStructures(matches, image, *reconstruction,
+                                          &ids, &x);
+    ASSERT_EQ(expected_ids.size(), ids.size());
+    for (int i = 0; i < ids.size(); ++i) {
+      EXPECT_EQ(expected_ids[i], ids[i]);
+    }
+    EXPECT_MATRIX_NEAR(expected_x, x, 0);
+  }
+}
+
+TEST(ReconstructedTrackIndex, FollowsTheStructures) {
+  Matches matches;
+  std::list<Feature *> features;
+  // Image i sees the tracks i to i + 5.
+  for (int image = 0; image < 3; ++image) {
+    for (int track = image; track < image + 6; ++track) {
+      PointFeature *feature = new PointFeature(track, 10 * image);
+      features.push_back(feature);
+      matches.Insert(image, track, feature);
+    }
+  }
+  Reconstruction reconstruction;
+  reconstruction.InsertTrack(1, new PointStructure(Vec3(0, 0, 1)));
+  ReconstructedTrackIndex index(matches, reconstruction);
+  reconstruction.set_track_index(&index);
+  ExpectSameSelections(matches, &reconstruction, &index);
+
+  vector<StructureID> ids;
+  SelectExistingPointStructures(matches, 0, reconstruction, &ids);
+  ASSERT_EQ(1, ids.size());
+  EXPECT_EQ(1, ids[0]);
+
+  reconstruction.InsertTrack(3, new PointStructure(Vec3(0, 1, 1)));
+  reconstruction.InsertTrack(7, new PointStructure(Vec3(1, 0, 1)));
+  reconstruction.InsertTrack(42, new PointStructure(Vec3(1, 1, 1)));
+  ExpectSameSelections(matches, &reconstruction, &index);
+
+  reconstruction.RemoveTrack(1);
+  ExpectSameSelections(matches, &reconstruction, &index);
+  SelectExistingPointStructures(matches, 2, reconstruction, &ids);
+  ASSERT_EQ(2, ids.size());
+  EXPECT_EQ(3, ids[0]);
+  EXPECT_EQ(7, ids[1]);
+
+  reconstruction.ClearStructuresMap();
+  ExpectSameSelections(matches, &reconstruction, &index);
+  SelectExistingPointStructures(matches, 2, reconstruction, &ids);
+  EXPECT_EQ(0, ids.size());
+
+  reconstruction.set_track_index(NULL);
+  std::list<Feature *>::iterator it = features.begin();
+  for (; it != features.end(); ++it) {
+    delete *it;
+  }
+}
+
+TEST(ReconstructedTrackIndex, NormalizedCoordinates) {
+  Matches matches;
+  std::list<Feature *> features;
+  for (int image = 0; image < 2; ++image) {
+    for (int track = 0; track < 4; ++track) {
+      PointFeature *feature = new PointFeature(100 * track + image, 30 * image);
+      features.push_back(feature);
+      matches.Insert(image, track, feature);
+    }
+  }
+  Reconstruction reconstruction;
+  reconstruction.InsertTrack(1, new PointStructure(Vec3(0, 0, 1)));
+  reconstruction.InsertTrack(2, new PointStructure(Vec3(0, 1, 1)));
+  ReconstructedTrackIndex index(matches, reconstruction);
+  Mat3 K;
+  K << 500,   0, 320,
+         0, 510, 240,
+         0,   0,   1;
+  EXPECT_FALSE(index.HasIntrinsics(0));
+  index.SetImageIntrinsics(1, K);
+  EXPECT_FALSE(index.HasIntrinsics(0));
+  EXPECT_TRUE(index.HasIntrinsics(1));
+  index.SetIntrinsics(K);
+  EXPECT_TRUE(index.HasIntrinsics(0));
+
+  for (int image = 0; image < 2; ++image) {
+    vector<StructureID> ids;
+    Mat2X x, x_camera, expected_x_camera;
+    index.SelectTracks(image, true, &ids, &x, &x_camera);
+    ASSERT_EQ(2, ids.size());
+    EuclideanToNormalizedCamera(x, K, &expected_x_camera);
+    EXPECT_MATRIX_NEAR(expected_x_camera, x_camera, 1e-12);
+
+    // Without distortion, undistorting the features changes nothing.
+    LensDistortion distortion;
+    index.SetImageIntrinsics(image, K, &distortion);
+    index.SelectTracks(image, true, &ids, NULL, &x_camera);
+    EXPECT_MATRIX_NEAR(expected_x_camera, x_camera, 1e-12);
+  }
+
+  std::list<Feature *>::iterator it = features.begin();
+  for (; it != features.end(); ++it) {
+    delete *it;
+  }
+}
+
+}  // namespace
+}  // namespace libmv
@@ -0,0 +1,300 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <utility>
+
+#include "libmv/base/thread.h"
+#include "libmv/correspondence/track_store.h"
+#include "libmv/multiview/projection.h"
+#include "libmv/multiview/robust_homography.h"
+#include "libmv/reconstruction/view_graph.h"
+
+namespace libmv {
+namespace {
+
+// Fits a robust homography to the matches of an edge.
+struct EdgeStatistics {
+  const TrackStore *store;
+  const vector<Matches::ImageID> *images;
+  std::vector<ViewGraphEdge> *edges;
+
+  void operator()(int e) {
+    ViewGraphEdge &edge = (*edges)[e];
+    edge.median_transfer_distance = 0;
+    edge.score = edge.num_matches;
+    if (edge.num_matches < 4) {
+      return;
+    }
+    std::vector<Mat> xs2;
+    store->TwoViewPointMatchMatrices((*images)[edge.image1],
+                                     (*images)[edge.image2], &xs2);
+    Mat3 H;
+    vector<int> inliers;
+    double max_error_h = 1;
+    Homography2DFromCorrespondences4PointRobust(xs2[0], xs2[1], max_error_h,
+                                                &H, &inliers, 1e-2);
+    if (inliers.size() == 0) {
+      edge.score = 0;
+      return;
+    }
+    Vec3 p1;
+    Vec2 d;
+    std::vector<double> all_errors;
+    all_errors.reserve(inliers.size());
+    for (int i = 0; i < inliers.size(); ++i) {
+      EuclideanToHomogeneous(Vec2(xs2[0].col(inliers[i])), &p1);
+      p1 = H * p1;
+      HomogeneousToEuclidean(p1, &d);
+      d -= xs2[0].col(inliers[i]);
+      all_errors.push_back(d.norm());
+    }
+    std::sort(all_errors.begin(), all_errors.end());
+    edge.median_transfer_distance = all_errors[inliers.size() / 2];
+    VLOG(1) << "H median:" << edge.median_transfer_distance << "px.\n";
+    edge.score *= edge.median_transfer_distance;
+  }
+};
+
+// The best unused edge of image, among the edges where image is the second
+// image (as_second) or the first one. Ties go to the smallest other image.
+// Returns -1 if no such edge has a positive score.
+int BestIncidentEdge(const ViewGraph &graph,
+                     const std::vector<char> &is_used,
+                     int image,
+                     bool as_second) {
+  int best = -1;
+  double best_score = 0;
+  for (int i = graph.incident_begin()[image];
+       i < graph.incident_begin()[image + 1]; ++i) {
+    int e = graph.incident_edges()[i];
+    const ViewGraphEdge &edge = graph.edge(e);
+    if (is_used[e] || (as_second ? edge.image2 : edge.image1) != image) {
+      continue;
+    }
+    // The incident edges are sorted by (image1, image2), so the other
+    // images come in increasing order.
+    if (edge.score > best_score) {
+      best = e;
+      best_score = edge.score;
+    }
+  }
+  return best;
+}
+
+}  // namespace
+
+void ViewGraph::Build(const Matches &matches,
+                      int min_num_matches,
+                      int num_threads) {
+  images_.clear();
+  edges_.clear();
+  std::map<Matches::ImageID, int> image_indices;
+  std::set<Matches::ImageID>::const_iterator image_iter =
+    matches.get_images().begin();
+  for (; image_iter != matches.get_images().end(); ++image_iter) {
+    image_indices[*image_iter] = images_.size();
+    images_.push_back(*image_iter);
+  }
+
+  // Counts the shared tracks of the pairs of images, track by track.
+  std::map<std::pair<int, int>, int> num_matches;
+  std::vector<int> track_images;
+  std::set<Matches::TrackID>::const_iterator track_iter =
+    matches.get_tracks().begin();
+  for (; track_iter != matches.get_tracks().end(); ++track_iter) {
+    track_images.clear();
+    Matches::Features<PointFeature> fp =
+      matches.InTrack<PointFeature>(*track_iter);
+    for (; fp; ++fp) {
+      track_images.push_back(image_indices[fp.image()]);
+    }
+    std::sort(track_images.begin(), track_images.end());
+    for (int a = 0; a < track_images.size(); ++a) {
+      for (int b = a + 1; b < track_images.size(); ++b) {
+        ++num_matches[std::make_pair(track_images[a], track_images[b])];
+      }
+    }
+  }
+  std::map<std::pair<int, int>, int>::const_iterator pair_iter =
+    num_matches.begin();
+  for (; pair_iter != num_matches.end(); ++pair_iter) {
+    if (pair_iter->second >= min_num_matches) {
+      ViewGraphEdge edge;
+      edge.image1 = pair_iter->first.first;
+      edge.image2 = pair_iter->first.second;
+      edge.num_matches = pair_iter->second;
+      edges_.push_back(edge);
+    }
+  }
+
+  // The point coordinates of the edges are gathered from a flat copy of the
+  // matches rather than looked up track by track.
+  TrackStore store(matches);
+  EdgeStatistics statistics;
+  statistics.store = &store;
+  statistics.images = &images_;
+  statistics.edges = &edges_;
+  ParallelForDynamic(0, edges_.size(), num_threads, &statistics);
+
+  // The edges are sorted by (image1, image2), and so are the incident edges.
+  incident_begin_.assign(images_.size() + 1, 0);
+  for (int e = 0; e < edges_.size(); ++e) {
+    ++incident_begin_[edges_[e].image1 + 1];
+    ++incident_begin_[edges_[e].image2 + 1];
+  }
+  for (int i = 0; i < images_.size(); ++i) {
+    incident_begin_[i + 1] += incident_begin_[i];
+  }
+  incident_edges_.resize(2 * edges_.size());
+  std::vector<int> next(incident_begin_.begin(), incident_begin_.end() - 1);
+  for (int e = 0; e < edges_.size(); ++e) {
+    incident_edges_[next[edges_[e].image1]++] = e;
+    incident_edges_[next[edges_[e].image2]++] = e;
+  }
+}
+
+int ViewGraph::FindEdge(int i, int j) const {
+  if (i > j) {
+    std::swap(i, j);
+  }
+  for (int k = incident_begin_[i]; k < incident_begin_[i + 1]; ++k) {
+    const ViewGraphEdge &edge = edges_[incident_edges_[k]];
+    if (edge.image1 == i && edge.image2 == j) {
+      return incident_edges_[k];
+    }
+  }
+  return -1;
+}
+
+void ViewGraph::ConnectedComponents(
+    std::list<vector<Matches::ImageID> > *components) const {
+  std::vector<int> component(images_.size(), -1);
+  std::vector<int> stack;
+  int num_components = 0;
+  for (int seed = 0; seed < images_.size(); ++seed) {
+    if (component[seed] >= 0) {
+      continue;
+    }
+    std::vector<int> members;
+    component[seed] = num_components;
+    stack.push_back(seed);
+    while (!stack.empty()) {
+      int i = stack.back();
+      stack.pop_back();
+      members.push_back(i);
+      for (int k = incident_begin_[i]; k < incident_begin_[i + 1]; ++k) {
+        const ViewGraphEdge &edge = edges_[incident_edges_[k]];
+        int j = edge.image1 == i ? edge.image2 : edge.image1;
+        if (component[j] < 0) {
+          component[j] = num_components;
+          stack.push_back(j);
+        }
+      }
+    }
+    std::sort(members.begin(), members.end());
+    vector<Matches::ImageID> ids(members.size());
+    for (int m = 0; m < members.size(); ++m) {
+      ids[m] = images_[members[m]];
+    }
+    components->push_back(ids);
+    ++num_components;
+  }
+}
+
+void ViewGraph::EfficientImageOrder(
+    std::list<vector<Matches::ImageID> > *images_list) const {
+  std::vector<char> is_used(edges_.size(), 0);
+  // The chain each image was last added to.
+  std::vector<int> chain_of_image(images_.size(), -1);
+  int num_chains = 0;
+  for (;;) {
+    // Find the global best score; ties go to the smallest (image2, image1).
+    int seed = -1;
+    for (int e = 0; e < edges_.size(); ++e) {
+      if (is_used[e] || edges_[e].score <= 0) {
+        continue;
+      }
+      if (seed < 0 || edges_[e].score > edges_[seed].score ||
+          (edges_[e].score == edges_[seed].score &&
+           (edges_[e].image2 < edges_[seed].image2 ||
+            (edges_[e].image2 == edges_[seed].image2 &&
+             edges_[e].image1 < edges_[seed].image1)))) {
+        seed = e;
+      }
+    }
+    if (seed < 0) {
+      break;
+    }
+    std::vector<int> order;
+    order.push_back(edges_[seed].image1);
+    order.push_back(edges_[seed].image2);
+    chain_of_image[edges_[seed].image1] = num_chains;
+    chain_of_image[edges_[seed].image2] = num_chains;
+
+    // From the seed, grow the chain with the best edges sharing its second
+    // image (column) or its first image (row), depth first. Each entry is an
+    // edge to grow from and the image to add to the chain before.
+    std::vector<std::pair<int, int> > stack;
+    stack.push_back(std::make_pair(seed, -1));
+    while (!stack.empty()) {
+      int e = stack.back().first;
+      int image_to_add = stack.back().second;
+      stack.pop_back();
+      if (image_to_add >= 0 && chain_of_image[image_to_add] != num_chains) {
+        chain_of_image[image_to_add] = num_chains;
+        order.push_back(image_to_add);
+      }
+      is_used[e] = 1;
+      int best_c = BestIncidentEdge(*this, is_used, edges_[e].image2, true);
+      int best_r = BestIncidentEdge(*this, is_used, edges_[e].image1, false);
+      double val_c = best_c >= 0 ? edges_[best_c].score : 0;
+      double val_r = best_r >= 0 ? edges_[best_r].score : 0;
+      if (best_c >= 0) {
+        is_used[best_c] = 1;
+      }
+      if (best_r >= 0) {
+        is_used[best_r] = 1;
+      }
+      // The branch of the best score is explored first.
+      if (val_c < val_r) {
+        if (best_c >= 0) {
+          stack.push_back(std::make_pair(best_c, edges_[best_c].image1));
+        }
+        stack.push_back(std::make_pair(best_r, edges_[best_r].image2));
+      } else {
+        if (best_r >= 0) {
+          stack.push_back(std::make_pair(best_r, edges_[best_r].image2));
+        }
+        if (best_c >= 0) {
+          stack.push_back(std::make_pair(best_c, edges_[best_c].image1));
+        }
+      }
+    }
+    vector<Matches::ImageID> ids(order.size());
+    for (int i = 0; i < order.size(); ++i) {
+      ids[i] = images_[order[i]];
+    }
+    images_list->push_back(ids);
+    ++num_chains;
+  }
+}
+
+}  // namespace libmv
@@ -0,0 +1,99 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_RECONSTRUCTION_VIEW_GRAPH_H_
+#define LIBMV_RECONSTRUCTION_VIEW_GRAPH_H_
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include "libmv/base/vector.h"
+#include "libmv/correspondence/matches.h"
+
+namespace libmv {
+
+// Statistics of a pair of images which share tracks.
+struct ViewGraphEdge {
+  // Indices of the images in the graph, image1 < image2.
+  int image1;
+  int image2;
+  // Number of tracks with a point feature in both images.
+  int num_matches;
+  // Median distance between the inliers of a robust homography of the pair
+  // in the first image and their transfer by the homography; 0 if there
+  // are less than 4 matches.
+  double median_transfer_distance;
+  // num_matches * median_transfer_distance if there are at least 4 matches,
+  // num_matches otherwise: the criterion of SelectEfficientImageOrder().
+  double score;
+};
+
+// Graph of the images of some matches, with an edge per pair of images that
+// share tracks. The pairs are found in one pass over the tracks and their
+// statistics, which need a robust homography fit, are computed once and in
+// parallel. The edges are stored in a sparse adjacency structure; ordering
+// and connected components are derived from it without refitting anything.
+class ViewGraph {
+ public:
+  ViewGraph() {}
+
+  // Builds the graph of matches. Only pairs of images sharing at least
+  // min_num_matches tracks get an edge.
+  void Build(const Matches &matches,
+             int min_num_matches = 1,
+             int num_threads = 1);
+
+  int NumImages() const { return images_.size(); }
+  int NumEdges() const  { return edges_.size(); }
+
+  // The images are indexed in the order of their ids.
+  Matches::ImageID image(int i) const { return images_[i]; }
+  const ViewGraphEdge &edge(int e) const { return edges_[e]; }
+
+  // The edges of image i are incident_edges()[incident_begin()[i]] to
+  // incident_edges()[incident_begin()[i + 1] - 1], sorted by edge index.
+  const std::vector<int> &incident_begin() const { return incident_begin_; }
+  const std::vector<int> &incident_edges() const { return incident_edges_; }
+
+  // Returns -1 if there is no edge between the image indices i and j.
+  int FindEdge(int i, int j) const;
+
+  // The images of each connected component, in the order of their ids. The
+  // images without edges make components of one image.
+  void ConnectedComponents(
+      std::list<vector<Matches::ImageID> > *components) const;
+
+  // The order of SelectEfficientImageOrder(): a list of chains of images,
+  // each started by the best scoring remaining edge and grown greedily with
+  // the best scoring edges of its images.
+  void EfficientImageOrder(
+      std::list<vector<Matches::ImageID> > *images_list) const;
+
+ private:
+  vector<Matches::ImageID> images_;
+  std::vector<ViewGraphEdge> edges_;
+  std::vector<int> incident_begin_;
+  std::vector<int> incident_edges_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_RECONSTRUCTION_VIEW_GRAPH_H_
@@ -0,0 +1,142 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <list>
+
+#include "libmv/correspondence/feature.h"
+#include "libmv/correspondence/matches.h"
+#include "libmv/reconstruction/image_selection.h"
+#include "libmv/reconstruction/view_graph.h"
+#include "testing/testing.h"
+
+namespace libmv {
+namespace {
+
+// Images 0, 1 and 2 share 10 tracks, translated by 0, 1 and 3 pixels along x.
+// Images 4 and 5 share 3 tracks and image 6 has a track of its own.
+class ViewGraphTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    const double offsets[3] = {0, 1, 3};
+    for (int image = 0; image < 3; ++image) {
+      for (int track = 0; track < 10; ++track) {
+        Insert(image, track, 17 * track % 50 + offsets[image],
+                             31 * track % 40);
+      }
+    }
+    for (int image = 4; image < 6; ++image) {
+      for (int track = 10; track < 13; ++track) {
+        Insert(image, track, track, 2 * track + image);
+      }
+    }
+    Insert(6, 13, 5, 5);
+  }
+  virtual void TearDown() {
+    std::list<Feature *>::iterator it = features_.begin();
+    for (; it != features_.end(); ++it) {
+      delete *it;
+    }
+  }
+  void Insert(Matches::ImageID image, Matches::TrackID track,
+              double x, double y) {
+    PointFeature *feature = new PointFeature(x, y);
+    features_.push_back(feature);
+    matches_.Insert(image, track, feature);
+  }
+
+  Matches matches_;
+  std::list<Feature *> features_;
+};
+
+TEST_F(ViewGraphTest, PairwiseStatistics) {
+  ViewGraph graph;
+  graph.Build(matches_, 1, 2);
+  ASSERT_EQ(6, graph.NumImages());
+  ASSERT_EQ(4, graph.NumEdges());
+  EXPECT_EQ(4, graph.image(3));
+  EXPECT_EQ(-1, graph.FindEdge(0, 3));
+  EXPECT_EQ(-1, graph.FindEdge(5, 5));
+
+  const double expected_medians[3][3] = {{0, 1, 3}, {1, 0, 2}, {3, 2, 0}};
+  for (int i = 0; i < 3; ++i) {
+    for (int j = i + 1; j < 3; ++j) {
+      int e = graph.FindEdge(j, i);
+      ASSERT_GE(e, 0);
+      EXPECT_EQ(i, graph.edge(e).image1);
+      EXPECT_EQ(j, graph.edge(e).image2);
+      EXPECT_EQ(10, graph.edge(e).num_matches);
+      EXPECT_NEAR(expected_medians[i][j],
+                  graph.edge(e).median_transfer_distance, 1e-6);
+      EXPECT_NEAR(10 * expected_medians[i][j], graph.edge(e).score, 1e-5);
+    }
+  }
+  int e = graph.FindEdge(3, 4);
+  ASSERT_GE(e, 0);
+  EXPECT_EQ(3, graph.edge(e).num_matches);
+  EXPECT_EQ(3, graph.edge(e).score);
+
+  // Every edge is listed by both of its images.
+  EXPECT_EQ(8, graph.incident_edges().size());
+  EXPECT_EQ(2, graph.incident_begin()[1] - graph.incident_begin()[0]);
+  EXPECT_EQ(0, graph.incident_begin()[6] - graph.incident_begin()[5]);
+
+  graph.Build(matches_, 4);
+  EXPECT_EQ(3, graph.NumEdges());
+}
+
+TEST_F(ViewGraphTest, ConnectedComponents) {
+  ViewGraph graph;
+  graph.Build(matches_);
+  std::list<vector<Matches::ImageID> > components;
+  graph.ConnectedComponents(&components);
+  ASSERT_EQ(3, components.size());
+  std::list<vector<Matches::ImageID> >::iterator it = components.begin();
+  ASSERT_EQ(3, it->size());
+  EXPECT_EQ(0, (*it)[0]);
+  EXPECT_EQ(1, (*it)[1]);
+  EXPECT_EQ(2, (*it)[2]);
+  ++it;
+  ASSERT_EQ(2, it->size());
+  EXPECT_EQ(4, (*it)[0]);
+  EXPECT_EQ(5, (*it)[1]);
+  ++it;
+  ASSERT_EQ(1, it->size());
+  EXPECT_EQ(6, (*it)[0]);
+}
+
+TEST_F(ViewGraphTest, EfficientImageOrder) {
+  std::list<vector<Matches::ImageID> > images_list;
+  SelectEfficientImageOrder(matches_, &images_list, 2);
+  // Starts with the pair of largest score, (0, 2), then adds the best image
+  // paired with 2.
+  ASSERT_EQ(2, images_list.size());
+  std::list<vector<Matches::ImageID> >::iterator it = images_list.begin();
+  ASSERT_EQ(3, it->size());
+  EXPECT_EQ(0, (*it)[0]);
+  EXPECT_EQ(2, (*it)[1]);
+  EXPECT_EQ(1, (*it)[2]);
+  ++it;
+  ASSERT_EQ(2, it->size());
+  EXPECT_EQ(4, (*it)[0]);
+  EXPECT_EQ(5, (*it)[1]);
+}
+
+}  // namespace
+}  // namespace libmv
@@ -0,0 +1,332 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef LIBMV_SCENE_GRAPH_FLAT_SCENE_GRAPH_H
+#define LIBMV_SCENE_GRAPH_FLAT_SCENE_GRAPH_H
+
+#include <algorithm>
+#include <cassert>
+#include <string>
+#include <vector>
+
+#include "libmv/base/vector.h"
+#include "libmv/numeric/numeric.h"
+
+namespace libmv {
+
+/**
+ * A scene graph stored as flat arrays indexed by node, for large camera rigs
+ * and point groups. Where SceneGraph allocates every node and chases pointers
+ * to walk it, here a node is an int and its parent, name, object and
+ * transforms live in contiguous arrays.
+ *
+ * Nodes are stored parents first: a node always has a larger index than its
+ * parent. The world transforms are therefore all brought up to date by one
+ * pass over the arrays; setting a local transform only marks the node dirty,
+ * and the pass recomputes the dirty nodes and their descendants.
+ *
+ * Children are looked up by name through a hash of (parent, name), so paths
+ * resolve in one probe per component. Sibling names are unique.
+ *
+ * The objects are not owned. Node 0 is the root; its local transform is the
+ * view of the scene, as in SGRootNode.
+ */
+template<class Object>
+class FlatSceneGraph {
+ public:
+  enum { kRoot = 0, kNoNode = -1 };
+
+  FlatSceneGraph() { Clear(); }
+
+  // Removes every node but the root, and resets the root transform.
+  void Clear() {
+    parents_.clear();
+    names_.clear();
+    objects_.clear();
+    first_child_.clear();
+    last_child_.clear();
+    next_sibling_.clear();
+    hash_next_.clear();
+    dirty_.clear();
+    local_.clear();
+    world_.clear();
+    buckets_.assign(16, int(kNoNode));
+    AppendNode(kNoNode, "", NULL, Mat4::Identity());
+  }
+
+  int NumNodes() const { return parents_.size(); }
+
+  // Returns the new node, or kNoNode if parent already has a child of that
+  // name.
+  int AddChild(int parent, const std::string &name, Object *object) {
+    assert(IsNode(parent));
+    if (GetChild(parent, name) != kNoNode) {
+      return kNoNode;
+    }
+    return AppendNode(parent, name, object, Mat4::Identity());
+  }
+
+  int GetParent(int node) const { return parents_[node]; }
+  const std::string &GetName(int node) const { return names_[node]; }
+  Object *GetObject(int node) const { return objects_[node]; }
+  void SetObject(int node, Object *object) { objects_[node] = object; }
+
+  // Iterates in insertion order:
+  //   for (int c = g.FirstChild(n); c != kNoNode; c = g.NextSibling(c))
+  int FirstChild(int node) const { return first_child_[node]; }
+  int NextSibling(int node) const { return next_sibling_[node]; }
+  bool HasChildren(int node) const { return first_child_[node] != kNoNode; }
+  int NumChildren(int node) const {
+    int num_children = 0;
+    for (int c = FirstChild(node); c != kNoNode; c = NextSibling(c)) {
+      ++num_children;
+    }
+    return num_children;
+  }
+  // The descendants of a node follow it, but are interleaved with the other
+  // nodes added meanwhile; counting them is a single pass.
+  int NumChildrenRecursive(int node) const {
+    std::vector<char> below(NumNodes(), 0);
+    below[node] = 1;
+    int num_descendants = 0;
+    for (int i = node + 1; i < NumNodes(); ++i) {
+      below[i] = below[parents_[i]];
+      num_descendants += below[i];
+    }
+    return num_descendants;
+  }
+
+  // Returns kNoNode if parent has no child of that name.
+  int GetChild(int parent, const std::string &name) const {
+    int bucket = Bucket(parent, name);
+    for (int i = buckets_[bucket]; i != kNoNode; i = hash_next_[i]) {
+      if (parents_[i] == parent && names_[i] == name) {
+        return i;
+      }
+    }
+    return kNoNode;
+  }
+
+  // Path in the form "/ChildOfRoot/ChildOfChildOfRoot", as in SGNode. Returns
+  // kNoNode if a component is missing.
+  int GetAtPath(const std::string &path) const {
+    int node = kRoot;
+    size_t begin = 0;
+    while (node != kNoNode && begin < path.size()) {
+      if (path[begin] == '/') {
+        ++begin;
+        continue;
+      }
+      size_t end = path.find('/', begin);
+      if (end == std::string::npos) {
+        end = path.size();
+      }
+      node = GetChild(node, path.substr(begin, end - begin));
+      begin = end;
+    }
+    return node;
+  }
+
+  std::string GetPath(int node) const {
+    std::string path;
+    for (; node != kRoot; node = parents_[node]) {
+      path = "/" + names_[node] + path;
+    }
+    return path;
+  }
+
+  const Mat4 &GetLocalTransform(int node) const { return local_[node]; }
+  void SetLocalTransform(int node, const Mat4 &transform) {
+    local_[node] = transform;
+    dirty_[node] = 1;
+    any_dirty_ = true;
+  }
+
+  // The transform of node and all its parents. Brings every world transform
+  // up to date first if some local transform changed.
+  const Mat4 &GetWorldTransform(int node) {
+    UpdateWorldTransforms();
+    return world_[node];
+  }
+
+  // One pass in index order: parents come first, so a dirty parent is
+  // recomputed before any of its children.
+  void UpdateWorldTransforms() {
+    if (!any_dirty_) {
+      return;
+    }
+    if (dirty_[kRoot]) {
+      world_[kRoot] = local_[kRoot];
+    }
+    for (int i = 1; i < NumNodes(); ++i) {
+      if (dirty_[parents_[i]]) {
+        dirty_[i] = 1;
+      }
+      if (dirty_[i]) {
+        world_[i] = world_[parents_[i]] * local_[i];
+      }
+    }
+    std::fill(dirty_.begin(), dirty_.end(), 0);
+    any_dirty_ = false;
+  }
+
+  // Removes node and its descendants; the root cannot be removed. The arrays
+  // are compacted, so the indices of the nodes after node change. Returns the
+  // number of nodes removed.
+  int RemoveSubtree(int node) {
+    assert(IsNode(node) && node != kRoot);
+    std::vector<char> removed(NumNodes(), 0);
+    removed[node] = 1;
+    for (int i = node + 1; i < NumNodes(); ++i) {
+      removed[i] = removed[parents_[i]];
+    }
+
+    // Compacting keeps the parents first order.
+    std::vector<int> new_index(NumNodes(), int(kNoNode));
+    int num_kept = 0;
+    for (int i = 0; i < NumNodes(); ++i) {
+      if (!removed[i]) {
+        new_index[i] = num_kept++;
+      }
+    }
+    int num_removed = NumNodes() - num_kept;
+    // The nodes before node keep their index, and so do their parents.
+    for (int i = node + 1; i < NumNodes(); ++i) {
+      int j = new_index[i];
+      if (j == kNoNode || j == i) {
+        continue;
+      }
+      parents_[j] = parents_[i] == kNoNode ? int(kNoNode)
+                                           : new_index[parents_[i]];
+      names_[j].swap(names_[i]);
+      objects_[j] = objects_[i];
+      dirty_[j] = dirty_[i];
+      local_[j] = local_[i];
+      world_[j] = world_[i];
+    }
+    parents_.resize(num_kept);
+    names_.resize(num_kept);
+    objects_.resize(num_kept);
+    dirty_.resize(num_kept);
+    local_.resize(num_kept);
+    world_.resize(num_kept);
+    Relink();
+    return num_removed;
+  }
+
+ private:
+  bool IsNode(int node) const { return 0 <= node && node < NumNodes(); }
+
+  static size_t HashName(int parent, const std::string &name) {
+    // FNV-1a, seeded with the parent.
+    size_t hash = 2166136261u ^ (size_t(parent) * 2654435761u);
+    for (size_t i = 0; i < name.size(); ++i) {
+      hash = (hash ^ static_cast<unsigned char>(name[i])) * 16777619u;
+    }
+    return hash;
+  }
+
+  int Bucket(int parent, const std::string &name) const {
+    return HashName(parent, name) & (buckets_.size() - 1);
+  }
+
+  int AppendNode(int parent, const std::string &name, Object *object,
+                 const Mat4 &transform) {
+    int node = NumNodes();
+    parents_.push_back(parent);
+    names_.push_back(name);
+    objects_.push_back(object);
+    first_child_.push_back(kNoNode);
+    last_child_.push_back(kNoNode);
+    next_sibling_.push_back(kNoNode);
+    hash_next_.push_back(kNoNode);
+    dirty_.push_back(1);
+    local_.push_back(transform);
+    world_.push_back(transform);
+    any_dirty_ = true;
+
+    if (parent != kNoNode) {
+      LinkChild(parent, node);
+    }
+    if (NumNodes() > int(buckets_.size())) {
+      Rehash(2 * buckets_.size());
+    } else {
+      LinkHash(node);
+    }
+    return node;
+  }
+
+  void LinkChild(int parent, int node) {
+    if (last_child_[parent] == kNoNode) {
+      first_child_[parent] = node;
+    } else {
+      next_sibling_[last_child_[parent]] = node;
+    }
+    last_child_[parent] = node;
+  }
+
+  void LinkHash(int node) {
+    int bucket = Bucket(parents_[node], names_[node]);
+    hash_next_[node] = buckets_[bucket];
+    buckets_[bucket] = node;
+  }
+
+  // The number of buckets stays a power of two.
+  void Rehash(size_t num_buckets) {
+    buckets_.assign(num_buckets, int(kNoNode));
+    for (int i = 0; i < NumNodes(); ++i) {
+      LinkHash(i);
+    }
+  }
+
+  // Rebuilds the child lists and the hash from the parents.
+  void Relink() {
+    int num_nodes = NumNodes();
+    first_child_.assign(num_nodes, int(kNoNode));
+    last_child_.assign(num_nodes, int(kNoNode));
+    next_sibling_.assign(num_nodes, int(kNoNode));
+    hash_next_.assign(num_nodes, int(kNoNode));
+    for (int i = 1; i < num_nodes; ++i) {
+      LinkChild(parents_[i], i);
+    }
+    Rehash(buckets_.size());
+  }
+
+  std::vector<int> parents_;
+  std::vector<std::string> names_;
+  std::vector<Object *> objects_;
+  std::vector<int> first_child_;
+  std::vector<int> last_child_;
+  std::vector<int> next_sibling_;
+
+  // Chained hash of (parent, name), the chains run through hash_next_.
+  std::vector<int> buckets_;
+  std::vector<int> hash_next_;
+
+  // The local transform of the node changed since the last update.
+  std::vector<char> dirty_;
+  bool any_dirty_;
+  vector<Mat4> local_;
+  vector<Mat4> world_;
+};
+
+}  // namespace libmv
+
+#endif  // LIBMV_SCENE_GRAPH_FLAT_SCENE_GRAPH_H
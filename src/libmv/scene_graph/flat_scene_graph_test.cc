@@ -0,0 +1,131 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <cstdio>
+
+#include "libmv/scene_graph/flat_scene_graph.h"
+#include "testing/testing.h"
+
+using libmv::FlatSceneGraph;
+using libmv::Mat4;
+
+namespace {
+
+struct TestStruct {
+  int data_;
+  TestStruct() : data_(0) {}
+};
+
+typedef FlatSceneGraph<TestStruct> Graph;
+
+Mat4 Translation(double x, double y, double z) {
+  Mat4 T = Mat4::Identity();
+  T(0, 3) = x;
+  T(1, 3) = y;
+  T(2, 3) = z;
+  return T;
+}
+
+TEST(FlatSceneGraph, Paths) {
+  Graph graph;
+  TestStruct t0, t1;
+  int child = graph.AddChild(Graph::kRoot, "child", &t0);
+  EXPECT_EQ(Graph::kRoot, graph.GetParent(child));
+  EXPECT_EQ(1, graph.NumChildren(Graph::kRoot));
+  EXPECT_EQ(child, graph.GetAtPath("/child"));
+  EXPECT_EQ(&t0, graph.GetObject(child));
+  EXPECT_EQ("/child", graph.GetPath(child));
+
+  int grandchild = graph.AddChild(child, "childb", &t1);
+  EXPECT_EQ(child, graph.GetParent(grandchild));
+  EXPECT_EQ(1, graph.NumChildren(child));
+  EXPECT_EQ("/child/childb", graph.GetPath(grandchild));
+  EXPECT_EQ(grandchild, graph.GetAtPath("/child/childb"));
+  EXPECT_EQ(Graph::kNoNode, graph.GetAtPath("/child/missing"));
+  EXPECT_EQ(Graph::kNoNode, graph.GetAtPath("/childb"));
+}
+
+TEST(FlatSceneGraph, SiblingNamesAreUnique) {
+  Graph graph;
+  int a = graph.AddChild(Graph::kRoot, "a", NULL);
+  EXPECT_EQ(Graph::kNoNode, graph.AddChild(Graph::kRoot, "a", NULL));
+  // The same name under another parent is fine.
+  EXPECT_NE(Graph::kNoNode, graph.AddChild(a, "a", NULL));
+  EXPECT_EQ(3, graph.NumNodes());
+}
+
+TEST(FlatSceneGraph, BigGraphLookups) {
+  Graph graph;
+  char name[32];
+  for (int i = 0; i < 1000; ++i) {
+    sprintf(name, "camera%d", i);
+    int camera = graph.AddChild(Graph::kRoot, name, NULL);
+    graph.AddChild(camera, "points", NULL);
+  }
+  EXPECT_EQ(2001, graph.NumNodes());
+  EXPECT_EQ(1000, graph.NumChildren(Graph::kRoot));
+  EXPECT_EQ(2000, graph.NumChildrenRecursive(Graph::kRoot));
+  for (int i = 0; i < 1000; ++i) {
+    sprintf(name, "/camera%d/points", i);
+    int points = graph.GetAtPath(name);
+    ASSERT_NE(Graph::kNoNode, points);
+    EXPECT_EQ(name, graph.GetPath(points));
+  }
+}
+
+TEST(FlatSceneGraph, WorldTransforms) {
+  Graph graph;
+  int rig = graph.AddChild(Graph::kRoot, "rig", NULL);
+  int camera = graph.AddChild(rig, "camera", NULL);
+  graph.SetLocalTransform(rig, Translation(1, 0, 0));
+  graph.SetLocalTransform(camera, Translation(0, 2, 0));
+  EXPECT_EQ(Translation(1, 2, 0), graph.GetWorldTransform(camera));
+
+  // Moving the parent moves the cached transform of the child.
+  graph.SetLocalTransform(rig, Translation(5, 0, 0));
+  EXPECT_EQ(Translation(5, 2, 0), graph.GetWorldTransform(camera));
+
+  // The root transform is the view.
+  graph.SetLocalTransform(Graph::kRoot, Translation(0, 0, 3));
+  EXPECT_EQ(Translation(5, 2, 3), graph.GetWorldTransform(camera));
+  EXPECT_EQ(Translation(0, 0, 3), graph.GetWorldTransform(Graph::kRoot));
+}
+
+TEST(FlatSceneGraph, RemoveSubtree) {
+  Graph graph;
+  int a = graph.AddChild(Graph::kRoot, "a", NULL);
+  int b = graph.AddChild(Graph::kRoot, "b", NULL);
+  graph.AddChild(a, "a1", NULL);
+  graph.AddChild(b, "b1", NULL);
+  graph.AddChild(a, "a2", NULL);
+  graph.SetLocalTransform(b, Translation(1, 1, 1));
+
+  EXPECT_EQ(3, graph.RemoveSubtree(a));
+  EXPECT_EQ(3, graph.NumNodes());
+  EXPECT_EQ(Graph::kNoNode, graph.GetAtPath("/a"));
+  EXPECT_EQ(Graph::kNoNode, graph.GetAtPath("/a/a1"));
+  int b1 = graph.GetAtPath("/b/b1");
+  ASSERT_NE(Graph::kNoNode, b1);
+  EXPECT_EQ(graph.GetAtPath("/b"), graph.GetParent(b1));
+  EXPECT_EQ(Translation(1, 1, 1), graph.GetWorldTransform(b1));
+  EXPECT_EQ(1, graph.NumChildren(Graph::kRoot));
+}
+
+}  // namespace
@@ -27,6 +27,7 @@
 #include <cstdio>
 #include <string>
 
+#include "libmv/base/instrumentation.h"
 #include "third_party/gflags/gflags.h"
 #include "third_party/glog/src/glog/logging.h"
 
@@ -38,6 +39,23 @@ inline void Init(const char *usage, int *argc, char ***argv) {
   google::ParseCommandLineFlags(argc, argv, true);
 }
 
+// Records the instrumented scopes of the run into a trace file for
+// chrome://tracing or Perfetto, unless filename is empty; the file is written
+// when the tool exits. The tools pass their --trace flag. The scopes are only
+// recorded by WITH_INSTRUMENTATION builds, see libmv/logging/logging.h.
+inline void StartTrace(const std::string &filename) {
+  if (filename.empty()) {
+    return;
+  }
+#ifndef LIBMV_INSTRUMENTATION
+  LOG(WARNING) << "Built without WITH_INSTRUMENTATION, the trace "
+               << filename << " will be empty.";
+#endif
+  if (!instrumentation::StartTrace(filename)) {
+    LOG(ERROR) << "Cannot write the trace " << filename;
+  }
+}
+
 }  // namespace libmv
 
 #endif  // ifndef LIBMV_TOOLS_TOOL_H_
@@ -0,0 +1,129 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+// A minimal micro-benchmark harness. A benchmark is a function that runs the
+// measured code state->iterations() times:
+//
+//   BENCHMARK(BM_ConvolveGaussian) {
+//     FloatImage image(480, 640), blurred;
+//     image.Fill(0.5);
+//     state->ResetTiming();
+//     for (int i = 0; i < state->iterations(); ++i) {
+//       ConvolveGaussian(image, 1.0, &blurred);
+//     }
+//     state->SetItemsProcessed(state->iterations() * 640.0 * 480.0);
+//   }
+//
+// The runner of benchmark_main.cc calls it with more and more iterations until
+// it runs for --benchmark_min_time seconds, and reports the time per iteration
+// and the items processed per second, as text, CSV or JSON. The benchmarks of
+// a directory are built by LIBMV_BENCHMARK() when BUILD_BENCHMARKS is on. The
+// benchmark names start with BM_ so that they do not hide the functions they
+// measure.
+
+#ifndef TESTING_BENCHMARK_H_
+#define TESTING_BENCHMARK_H_
+
+#include <string>
+#include <vector>
+
+#include "libmv/base/timer.h"
+
+namespace libmv {
+namespace benchmark {
+
+class State {
+ public:
+  explicit State(int iterations)
+      : iterations_(iterations), items_processed_(0), paused_seconds_(0),
+        paused_(false) {}
+
+  int iterations() const { return iterations_; }
+
+  // Restarts the measure, e.g. after the setup of the benchmark.
+  void ResetTiming() {
+    paused_seconds_ = 0;
+    paused_ = false;
+    timer_.Reset();
+  }
+  // The time between PauseTiming() and ResumeTiming() is not counted.
+  void PauseTiming() {
+    if (!paused_) {
+      paused_ = true;
+      pause_timer_.Reset();
+    }
+  }
+  void ResumeTiming() {
+    if (paused_) {
+      paused_ = false;
+      paused_seconds_ += pause_timer_.ElapsedSeconds();
+    }
+  }
+  double ElapsedSeconds() const {
+    double paused = paused_ ? pause_timer_.ElapsedSeconds() : 0;
+    return timer_.ElapsedSeconds() - paused_seconds_ - paused;
+  }
+
+  // The number of items (pixels, features, problems...) processed by all the
+  // iterations, reported as a rate.
+  void SetItemsProcessed(double items) { items_processed_ = items; }
+  double items_processed() const { return items_processed_; }
+
+ private:
+  int iterations_;
+  double items_processed_;
+  WallTimer timer_;
+  WallTimer pause_timer_;
+  double paused_seconds_;
+  bool paused_;
+};
+
+typedef void (*Function)(State *state);
+
+struct Benchmark {
+  std::string name;
+  Function function;
+};
+
+// The benchmarks registered by BENCHMARK(), in the order of registration.
+std::vector<Benchmark> *Benchmarks();
+
+struct Registration {
+  Registration(const char *name, Function function) {
+    Benchmark benchmark;
+    benchmark.name = name;
+    benchmark.function = function;
+    Benchmarks()->push_back(benchmark);
+  }
+};
+
+// Keeps the compiler from removing the computation of a result that is not
+// used otherwise.
+void DoNotOptimize(double value);
+
+}  // namespace benchmark
+}  // namespace libmv
+
+#define BENCHMARK(name) \
+  static void name(libmv::benchmark::State *state); \
+  static libmv::benchmark::Registration name##_registration(#name, name); \
+  static void name(libmv::benchmark::State *state)
+
+#endif  // TESTING_BENCHMARK_H_
@@ -0,0 +1,311 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+// The main of the benchmarks built by LIBMV_BENCHMARK(): runs the registered
+// benchmarks and reports their timings, to the standard output or to the file
+// given with --benchmark_out, so that the results of a release can be compared
+// with the ones of the previous release.
+//
+// With --benchmark_baseline, the results are also compared with the ones of
+// a previous run on the same machine, saved as CSV, and the run fails if a
+// benchmark got slower than the tolerance allows. This is how the performance
+// tests of LIBMV_BENCHMARK() work; the first run records the baseline.
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <map>
+#include <string>
+
+#include "libmv/base/cpu_features.h"
+#include "libmv/base/thread.h"
+#include "libmv/logging/logging.h"
+#include "testing/benchmark.h"
+#include "third_party/gflags/gflags.h"
+
+DEFINE_string(benchmark_filter, "", "Only run the benchmarks whose name "
+              "contains this string.");
+DEFINE_double(benchmark_min_time, 0.5, "Minimum time, in seconds, that every "
+              "benchmark runs for.");
+DEFINE_string(benchmark_format, "text", "Format of the results: text, csv or "
+              "json.");
+DEFINE_string(benchmark_out, "", "File the results are written to, instead "
+              "of the standard output.");
+DEFINE_int32(threads, 0, "Threads of the shared thread pool; 0 for one per "
+             "processor.");
+DEFINE_string(simd, "", "Highest instruction set the kernels may use: scalar, "
+              "neon, sse2, sse4.1, avx2 or avx512; the best supported one by "
+              "default.");
+DEFINE_int32(benchmark_repetitions, 1, "Times every benchmark is run; the "
+             "fastest run is reported.");
+DEFINE_string(benchmark_baseline, "", "CSV results of a previous run to "
+              "compare with; they are recorded there if the file does not "
+              "exist.");
+DEFINE_double(benchmark_tolerance, 0.25, "Fraction by which a benchmark may "
+              "be slower than its baseline.");
+
+namespace libmv {
+namespace benchmark {
+
+std::vector<Benchmark> *Benchmarks() {
+  static std::vector<Benchmark> benchmarks;
+  return &benchmarks;
+}
+
+namespace {
+volatile double sink;
+}  // namespace
+
+void DoNotOptimize(double value) {
+  sink = value;
+}
+
+namespace {
+
+struct Result {
+  std::string name;
+  int iterations;
+  double seconds;
+  double items_processed;
+};
+
+// Runs the benchmark with more iterations until it runs long enough. The next
+// number of iterations is predicted from the last run, with some margin.
+Result Run(const Benchmark &benchmark) {
+  const int kMaxIterations = 1000000000;
+  int iterations = 1;
+  for (;;) {
+    State state(iterations);
+    benchmark.function(&state);
+    double seconds = state.ElapsedSeconds();
+    if (seconds >= FLAGS_benchmark_min_time || iterations >= kMaxIterations) {
+      Result result;
+      result.name = benchmark.name;
+      result.iterations = iterations;
+      result.seconds = seconds;
+      result.items_processed = state.items_processed();
+      return result;
+    }
+    double next = 1.4 * iterations * FLAGS_benchmark_min_time
+                / std::max(seconds, 1e-9);
+    next = std::min(next, 100.0 * iterations);
+    next = std::min(next, static_cast<double>(kMaxIterations));
+    iterations = std::max(iterations + 1, static_cast<int>(next));
+  }
+}
+
+double NanosecondsPerIteration(const Result &result) {
+  return 1e9 * result.seconds / result.iterations;
+}
+
+// The fastest of --benchmark_repetitions runs, which is the least disturbed
+// by the rest of the machine.
+Result RunRepeatedly(const Benchmark &benchmark) {
+  Result best = Run(benchmark);
+  for (int i = 1; i < FLAGS_benchmark_repetitions; ++i) {
+    Result result = Run(benchmark);
+    if (NanosecondsPerIteration(result) < NanosecondsPerIteration(best)) {
+      best = result;
+    }
+  }
+  return best;
+}
+
+double ItemsPerSecond(const Result &result) {
+  return result.seconds > 0 ? result.items_processed / result.seconds : 0;
+}
+
+std::string Date() {
+  char date[64];
+  time_t now = time(NULL);
+  strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&now));
+  return date;
+}
+
+const char *BuildType() {
+#ifdef NDEBUG
+  return "release";
+#else
+  return "debug";
+#endif
+}
+
+void WriteText(const std::vector<Result> &results, FILE *out) {
+  fprintf(out, "%-48s %12s %16s %16s\n",
+          "Benchmark", "Iterations", "Time (ns)", "Items/s");
+  for (size_t i = 0; i < results.size(); ++i) {
+    fprintf(out, "%-48s %12d %16.0f %16.4g\n", results[i].name.c_str(),
+            results[i].iterations, NanosecondsPerIteration(results[i]),
+            ItemsPerSecond(results[i]));
+  }
+}
+
+void WriteCSV(const std::vector<Result> &results, FILE *out) {
+  fprintf(out, "name,iterations,ns_per_iteration,items_per_second\n");
+  for (size_t i = 0; i < results.size(); ++i) {
+    fprintf(out, "%s,%d,%.6g,%.6g\n", results[i].name.c_str(),
+            results[i].iterations, NanosecondsPerIteration(results[i]),
+            ItemsPerSecond(results[i]));
+  }
+}
+
+// The names are C++ identifiers, so they need no escaping.
+void WriteJSON(const char *executable,
+               const std::vector<Result> &results,
+               FILE *out) {
+  fprintf(out, "{\n");
+  fprintf(out, "  \"context\": {\n");
+  fprintf(out, "    \"executable\": \"%s\",\n", executable);
+  fprintf(out, "    \"date\": \"%s\",\n", Date().c_str());
+  fprintf(out, "    \"build_type\": \"%s\",\n", BuildType());
+  fprintf(out, "    \"num_processors\": %d,\n", NumProcessors());
+  fprintf(out, "    \"num_threads\": %d,\n", NumThreads());
+  fprintf(out, "    \"simd\": \"%s\"\n", SimdLevelName(ActiveSimdLevel()));
+  fprintf(out, "  },\n");
+  fprintf(out, "  \"benchmarks\": [");
+  for (size_t i = 0; i < results.size(); ++i) {
+    fprintf(out, "%s\n    {\"name\": \"%s\", \"iterations\": %d, "
+            "\"ns_per_iteration\": %.6g, \"items_per_second\": %.6g}",
+            i ? "," : "", results[i].name.c_str(), results[i].iterations,
+            NanosecondsPerIteration(results[i]), ItemsPerSecond(results[i]));
+  }
+  fprintf(out, "\n  ]\n}\n");
+}
+
+// Reads the time per iteration of the benchmarks from the output of
+// WriteCSV(). Returns false if the file can not be read.
+bool ReadBaseline(const std::string &filename,
+                  std::map<std::string, double> *ns_per_iteration) {
+  FILE *in = fopen(filename.c_str(), "r");
+  if (!in) {
+    return false;
+  }
+  char line[512], name[256];
+  int iterations;
+  double ns, items_per_second;
+  while (fgets(line, sizeof(line), in)) {
+    if (sscanf(line, "%255[^,],%d,%lf,%lf", name, &iterations, &ns,
+               &items_per_second) == 4) {
+      (*ns_per_iteration)[name] = ns;
+    }
+  }
+  fclose(in);
+  return true;
+}
+
+// Compares the results with the baseline, or records them as the baseline if
+// there is none yet. Returns false if a benchmark regressed.
+bool CheckBaseline(const std::vector<Result> &results,
+                   const std::string &filename) {
+  std::map<std::string, double> baseline;
+  if (!ReadBaseline(filename, &baseline)) {
+    FILE *out = fopen(filename.c_str(), "w");
+    if (!out) {
+      LOG(ERROR) << "Can't write the baseline " << filename;
+      return false;
+    }
+    WriteCSV(results, out);
+    fclose(out);
+    LOG(INFO) << "Recorded the baseline " << filename;
+    return true;
+  }
+  bool passed = true;
+  for (size_t i = 0; i < results.size(); ++i) {
+    std::map<std::string, double>::const_iterator it =
+        baseline.find(results[i].name);
+    if (it == baseline.end() || it->second <= 0) {
+      LOG(WARNING) << results[i].name << " is not in the baseline "
+                   << filename;
+      continue;
+    }
+    double ns = NanosecondsPerIteration(results[i]);
+    double change = ns / it->second - 1;
+    printf("%-48s %+7.1f%% (%.0f ns, baseline %.0f ns)\n",
+           results[i].name.c_str(), 100 * change, ns, it->second);
+    if (change > FLAGS_benchmark_tolerance) {
+      LOG(ERROR) << results[i].name << " is " << 100 * change
+                 << "% slower than its baseline.";
+      passed = false;
+    }
+  }
+  return passed;
+}
+
+}  // namespace
+}  // namespace benchmark
+}  // namespace libmv
+
+int main(int argc, char **argv) {
+  using namespace libmv::benchmark;
+
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  if (FLAGS_threads > 0) {
+    libmv::SetNumThreads(FLAGS_threads);
+  }
+  if (!FLAGS_simd.empty()) {
+    libmv::SimdLevel level;
+    if (!libmv::ParseSimdLevel(FLAGS_simd.c_str(), &level)) {
+      LOG(ERROR) << "Unknown instruction set " << FLAGS_simd;
+      return 1;
+    }
+    libmv::SetMaxSimdLevel(level);
+  }
+  if (FLAGS_benchmark_format != "text" &&
+      FLAGS_benchmark_format != "csv" &&
+      FLAGS_benchmark_format != "json") {
+    LOG(ERROR) << "Unknown benchmark format " << FLAGS_benchmark_format;
+    return 1;
+  }
+
+  std::vector<Result> results;
+  const std::vector<Benchmark> &benchmarks = *Benchmarks();
+  for (size_t i = 0; i < benchmarks.size(); ++i) {
+    if (benchmarks[i].name.find(FLAGS_benchmark_filter) == std::string::npos) {
+      continue;
+    }
+    VLOG(1) << "Running " << benchmarks[i].name;
+    results.push_back(RunRepeatedly(benchmarks[i]));
+  }
+
+  FILE *out = stdout;
+  if (!FLAGS_benchmark_out.empty()) {
+    out = fopen(FLAGS_benchmark_out.c_str(), "w");
+    if (!out) {
+      LOG(ERROR) << "Can't open " << FLAGS_benchmark_out;
+      return 1;
+    }
+  }
+  if (FLAGS_benchmark_format == "json") {
+    WriteJSON(argv[0], results, out);
+  } else if (FLAGS_benchmark_format == "csv") {
+    WriteCSV(results, out);
+  } else {
+    WriteText(results, out);
+  }
+  if (out != stdout) {
+    fclose(out);
+  }
+  if (!FLAGS_benchmark_baseline.empty() &&
+      !CheckBaseline(results, FLAGS_benchmark_baseline)) {
+    return 1;
+  }
+  return 0;
+}
@@ -18,14 +18,24 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <cstdio>
 #include <fstream>
 #include <iostream>
+#include <string>
+#include <vector>
 
 #include "libmv/base/scoped_ptr.h"
+#include "libmv/base/timer.h"
 #include "libmv/base/vector.h"
 #include "libmv/base/vector_utils.h"
 #include "libmv/correspondence/feature.h"
+#include "libmv/correspondence/feature_matching.h"
+#include "libmv/descriptor/binary_descriptor.h"
+#include "libmv/descriptor/descriptor.h"
+#include "libmv/descriptor/descriptor_factory.h"
+#include "libmv/descriptor/vector_descriptor.h"
 #include "libmv/detector/detector.h"
+#include "libmv/detector/detector_factory.h"
 #include "libmv/detector/fast_detector.h"
 #include "libmv/detector/star_detector.h"
 #include "libmv/detector/surf_detector.h"
@@ -38,6 +48,18 @@
 using namespace libmv;
 using namespace std;
 
+DEFINE_bool(benchmark, false,
+            "benchmark the quality and speed of every detector and describer "
+            "of the factories instead of testing the FAST repeatability");
+DEFINE_int32(repetitions, 3,
+             "runs of every detection and description in the benchmark, the "
+             "fastest one is kept");
+DEFINE_double(time_budget_ms, 0,
+              "per image detection and description budget of the benchmark; "
+              "the configurations over it are marked (0 for no budget)");
+DEFINE_string(benchmark_out, "DetectorBenchmark.csv",
+              "CSV file of the benchmark results");
+
 void usage() {
   LOG(ERROR) << " repreatability ImageReference ImageA ImageB ... " <<std::endl
     << " ImageReference  : the input image on which features will be extrated,"
@@ -50,7 +72,9 @@ void usage() {
     << std::endl
     << " Gound truth transformation between ImageReference and ImageX is named\
        in ImageX.txt"
-    << " INFO : !!! experimental !!! ." << std::endl;
+    << " INFO : !!! experimental !!! ." << std::endl
+    << " With --benchmark, every detector and describer of the factories is"
+    << " timed on the images and written to --benchmark_out." << std::endl;
 }
 
 
@@ -75,7 +99,15 @@ bool testRepeatability(const libmv::vector<libmv::Feature *> & featuresA,
                        const string & ImageNameB,
                        const Image & imageB,
                        libmv::vector<double> * exportedData = NULL,
-                       ostringstream * stringStream = NULL);
+                       ostringstream * stringStream = NULL,
+                       bool verbose = true);
+
+// Read an image as one gray channel.
+bool readGrayImage(const string & filename, Image * image);
+
+// Benchmark every detector and describer combination on the images, the
+// first one being the reference of the repeatability test.
+int runBenchmark(const std::vector<string> & imageNames);
 
 int main(int argc, char **argv) {
 
@@ -89,6 +121,10 @@ int main(int argc, char **argv) {
     return 1;
   }
 
+  if (FLAGS_benchmark) {
+    return runBenchmark(std::vector<string>(argv + 1, argv + argc));
+  }
+
   // Parse input parameter.
   const string sImageReference = argv[1];
   
@@ -178,19 +214,19 @@ bool detectFeatures(const eDetectorType DetectorType,
 {
   using namespace detector;
   switch (DetectorType)  {
-    case FAST_DETECTOR:
+    case ::FAST_DETECTOR:
     {
       scoped_ptr<Detector> detector(CreateFastDetector(9, 30));
       detector->Detect( im, featuresOut, NULL);
     }
     break;
-    case SURF_DETECTOR:
+    case ::SURF_DETECTOR:
     {
       scoped_ptr<Detector> detector(CreateSURFDetector());
       detector->Detect( im, featuresOut, NULL);
     }
     break;
-    case STAR_DETECTOR:
+    case ::STAR_DETECTOR:
     {
       scoped_ptr<Detector> detector(CreateStarDetector());
       detector->Detect( im, featuresOut, NULL);
@@ -210,7 +246,8 @@ bool testRepeatability(const libmv::vector<libmv::Feature *> & featuresA,
                        const string & ImageNameB,
                        const Image & imageB,
                        libmv::vector<double> * exportedData,
-                       ostringstream * stringStream)
+                       ostringstream * stringStream,
+                       bool verbose)
 {
   // Config Threshold for repeatability
   const double distThreshold = 1.5;
@@ -229,7 +266,7 @@ bool testRepeatability(const libmv::vector<libmv::Feature *> & featuresA,
       transfoMatrix = temp;
     }
     else  {
-      LOG(ERROR) << "Invalid input transformation file.";
+      LOG_IF(ERROR, verbose) << "Invalid input transformation file.";
       if (stringStream) {
         (*stringStream) << "Invalid input transformation file.";
       }
@@ -305,7 +342,9 @@ bool testRepeatability(const libmv::vector<libmv::Feature *> & featuresA,
     << " Position repeatability :\t" << 
       nbRepeatable / (double) nbRepeatablePossible * 100 << endl
     << " Position mean error    :\t" << localisationError << endl;
-  cout << os.str();
+  if (verbose) {
+    cout << os.str();
+  }
   if (stringStream) {
     (*stringStream) << os.str();
   }
@@ -317,3 +356,200 @@ bool testRepeatability(const libmv::vector<libmv::Feature *> & featuresA,
   }
   return (nbRepeatable != 0);
 }
+
+bool readGrayImage(const string & filename, Image * image)
+{
+  ByteImage byteImage;
+  if (0 == ReadImage(filename.c_str(), &byteImage)) {
+    return false;
+  }
+  if (byteImage.Depth() == 3) {
+    ByteImage byteImageGray;
+    Rgb2Gray(byteImage, &byteImageGray);
+    *image = Image(new ByteImage(byteImageGray));
+  } else {
+    *image = Image(new ByteImage(byteImage));
+  }
+  return true;
+}
+
+namespace {
+
+struct DetectorEntry {
+  detector::eDetector type;
+  const char *name;
+};
+
+const DetectorEntry kDetectors[] = {
+  { detector::FAST_DETECTOR,         "FAST"         },
+  { detector::FAST_LIMITED_DETECTOR, "FAST_LIMITED" },
+  { detector::FAST_PYRAMID_DETECTOR, "FAST_PYRAMID" },
+  { detector::SURF_DETECTOR,         "SURF"         },
+  { detector::STAR_DETECTOR,         "STAR"         },
+  { detector::MSER_DETECTOR,         "MSER"         },
+  { detector::MSER_LINEAR_DETECTOR,  "MSER_LINEAR"  },
+};
+
+struct DescriberEntry {
+  descriptor::eDescriber type;
+  const char *name;
+};
+
+const DescriberEntry kDescribers[] = {
+  { descriptor::SIMPLEST_DESCRIBER, "SIMPLEST"  },
+  { descriptor::DIPOLE_DESCRIBER,   "DIPOLE"    },
+  { descriptor::SURF_DESCRIBER,     "SURF"      },
+  { descriptor::DAISY_DESCRIBER,    "DAISY"     },
+  { descriptor::BRIEF_DESCRIBER,    "BRIEF"     },
+};
+
+// Bytes a described feature takes once stored for matching, as a
+// KeypointFeature of a FeatureSet, or 0 if descriptor is NULL.
+size_t featureMemory(const descriptor::Descriptor * descriptor)
+{
+  const descriptor::VecfDescriptor * vector =
+    dynamic_cast<const descriptor::VecfDescriptor *>(descriptor);
+  if (vector) {
+    return sizeof(KeypointFeature) + vector->coords.size() * sizeof(float);
+  }
+  if (dynamic_cast<const descriptor::BinaryDescriptor *>(descriptor)) {
+    return sizeof(KeypointFeature) + sizeof(descriptor::BinaryDescriptor);
+  }
+  return 0;
+}
+
+// The features of every image found by one detector, and the time it took.
+struct DetectionResult {
+  std::vector<libmv::vector<libmv::Feature *> > features;
+  double seconds;
+  int numFeatures;
+  // Mean over the images compared to the reference.
+  double repeatability;
+  double localizationError;
+};
+
+void detectAll(detector::Detector * detector,
+               const std::vector<Image> & images,
+               const std::vector<string> & imageNames,
+               DetectionResult * result)
+{
+  result->features.resize(images.size());
+  result->seconds = 0;
+  result->numFeatures = 0;
+  for (size_t i = 0; i < images.size(); ++i) {
+    double fastest = 0;
+    for (int r = 0; r < std::max(FLAGS_repetitions, 1); ++r) {
+      DeleteElements(&result->features[i]);
+      WallTimer timer;
+      detector->Detect(images[i], &result->features[i], NULL);
+      double seconds = timer.ElapsedSeconds();
+      fastest = r == 0 ? seconds : std::min(fastest, seconds);
+    }
+    result->seconds += fastest;
+    result->numFeatures += result->features[i].size();
+  }
+
+  libmv::vector<double> stats;
+  for (size_t i = 1; i < images.size(); ++i) {
+    testRepeatability(result->features[0], result->features[i],
+                      imageNames[i] + string(".txt"), images[i], &stats,
+                      NULL, false);
+  }
+  result->repeatability = result->localizationError = 0;
+  const int numCompared = images.size() - 1;
+  for (int i = 0; i < numCompared; ++i) {
+    // The ratios of 0 / 0 are counted as 0.
+    if (stats[4 * i + 2] == stats[4 * i + 2]) {
+      result->repeatability += stats[4 * i + 2] / numCompared;
+    }
+    if (stats[4 * i + 3] == stats[4 * i + 3]) {
+      result->localizationError += stats[4 * i + 3] / numCompared;
+    }
+  }
+}
+
+}  // namespace
+
+int runBenchmark(const std::vector<string> & imageNames)
+{
+  std::vector<Image> images(imageNames.size());
+  for (size_t i = 0; i < imageNames.size(); ++i) {
+    if (!readGrayImage(imageNames[i], &images[i])) {
+      LOG(ERROR) << "Invalid inputImage " << imageNames[i];
+      return 1;
+    }
+  }
+
+  ofstream csv(FLAGS_benchmark_out.c_str());
+  csv << "detector,describer,features_per_image,features_per_second,"
+      << "detect_ms_per_image,describe_us_per_feature,bytes_per_feature,"
+      << "described_ratio,repeatability,localization_error,"
+      << "total_ms_per_image,within_budget" << endl;
+  printf("%-13s %-10s %9s %11s %9s %10s %8s %7s %9s %5s\n",
+         "detector", "describer", "feat/img", "feat/s", "det ms",
+         "desc us/f", "B/feat", "repeat%", "total ms", "fits");
+
+  const int numImages = images.size();
+  for (size_t d = 0; d < sizeof(kDetectors) / sizeof(kDetectors[0]); ++d) {
+    scoped_ptr<detector::Detector> detector(
+      detector::detectorFactory(kDetectors[d].type));
+    DetectionResult detection;
+    detectAll(detector.get(), images, imageNames, &detection);
+    const double detectMs = 1000 * detection.seconds / numImages;
+    const double featuresPerSecond = detection.seconds > 0 ?
+      detection.numFeatures / detection.seconds : 0;
+
+    for (size_t k = 0; k < sizeof(kDescribers) / sizeof(kDescribers[0]); ++k) {
+      scoped_ptr<descriptor::Describer> describer(
+        descriptor::describerFactory(kDescribers[k].type));
+      double describeSeconds = 0;
+      size_t bytes = 0;
+      int numDescribed = 0;
+      for (int i = 0; i < numImages; ++i) {
+        double fastest = 0;
+        libmv::vector<descriptor::Descriptor *> descriptors;
+        for (int r = 0; r < std::max(FLAGS_repetitions, 1); ++r) {
+          DeleteElements(&descriptors);
+          WallTimer timer;
+          describer->Describe(detection.features[i], images[i], NULL,
+                              &descriptors);
+          double seconds = timer.ElapsedSeconds();
+          fastest = r == 0 ? seconds : std::min(fastest, seconds);
+        }
+        describeSeconds += fastest;
+        for (int j = 0; j < descriptors.size(); ++j) {
+          if (descriptors[j]) {
+            bytes += featureMemory(descriptors[j]);
+            ++numDescribed;
+          }
+        }
+        DeleteElements(&descriptors);
+      }
+      const double describeUs = detection.numFeatures > 0 ?
+        1e6 * describeSeconds / detection.numFeatures : 0;
+      const double bytesPerFeature = numDescribed > 0 ?
+        bytes / double(numDescribed) : 0;
+      const double describedRatio = detection.numFeatures > 0 ?
+        numDescribed / double(detection.numFeatures) : 0;
+      const double totalMs = detectMs + 1000 * describeSeconds / numImages;
+      const bool withinBudget =
+        FLAGS_time_budget_ms <= 0 || totalMs <= FLAGS_time_budget_ms;
+
+      printf("%-13s %-10s %9.1f %11.0f %9.2f %10.2f %8.0f %7.1f %9.2f %5s\n",
+             kDetectors[d].name, kDescribers[k].name,
+             detection.numFeatures / double(numImages), featuresPerSecond,
+             detectMs, describeUs, bytesPerFeature, detection.repeatability,
+             totalMs, withinBudget ? "yes" : "no");
+      csv << kDetectors[d].name << "," << kDescribers[k].name << ","
+          << detection.numFeatures / double(numImages) << ","
+          << featuresPerSecond << "," << detectMs << "," << describeUs << ","
+          << bytesPerFeature << "," << describedRatio << ","
+          << detection.repeatability << "," << detection.localizationError
+          << "," << totalMs << "," << (withinBudget ? 1 : 0) << endl;
+    }
+    for (int i = 0; i < numImages; ++i) {
+      DeleteElements(&detection.features[i]);
+    }
+  }
+  return 0;
+}
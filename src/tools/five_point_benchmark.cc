@@ -0,0 +1,126 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Compares the speed and accuracy of the five point relative pose solvers on
+// random scenes seen by two calibrated cameras.
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "libmv/base/timer.h"
+#include "libmv/base/vector.h"
+#include "libmv/multiview/five_point.h"
+#include "libmv/multiview/fundamental.h"
+#include "libmv/multiview/projection.h"
+#include "libmv/numeric/numeric.h"
+#include "libmv/tools/tool.h"
+
+DEFINE_int32(trials, 10000, "Number of random problems.");
+DEFINE_double(noise, 0, "Standard deviation of the noise added to the "
+              "normalized image coordinates.");
+DEFINE_double(tolerance, 1e-6, "A solver fails when none of its solutions is "
+              "this close to the true essential matrix.");
+DEFINE_int32(seed, 1, "Seed of the random problems.");
+
+using namespace libmv;
+
+namespace {
+
+typedef void (*FivePointSolver)(const Mat2X &, const Mat2X &, vector<Mat3> *);
+
+struct Problem {
+  Mat2X x1, x2;
+  Mat3 E;
+};
+
+double Gaussian() {
+  // Box-Muller.
+  double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+  double v = (rand() + 1.0) / (RAND_MAX + 2.0);
+  return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+void RandomProblem(Problem *problem) {
+  Mat3X X = Mat3X::Random(3, 5);
+  X.row(2).array() += 3;
+  Mat3 R = RotationAroundZ(Vec3::Random()(0)) *
+           RotationAroundX(0.3 * Vec3::Random()(0)) *
+           RotationAroundY(0.3 * Vec3::Random()(0));
+  Vec3 t = Vec3::Random();
+  EssentialFromRt(Mat3::Identity(), Vec3::Zero(), R, t, &problem->E);
+  problem->E /= problem->E.norm();
+
+  Mat34 P1, P2;
+  P_From_KRt(Mat3::Identity(), Mat3::Identity(), Vec3::Zero(), &P1);
+  P_From_KRt(Mat3::Identity(), R, t, &P2);
+  Project(P1, X, &problem->x1);
+  Project(P2, X, &problem->x2);
+  for (int i = 0; i < 5; ++i) {
+    for (int j = 0; j < 2; ++j) {
+      problem->x1(j, i) += FLAGS_noise * Gaussian();
+      problem->x2(j, i) += FLAGS_noise * Gaussian();
+    }
+  }
+}
+
+void Benchmark(const char *name, FivePointSolver solver,
+               const vector<Problem> &problems) {
+  vector<vector<Mat3> > solutions(problems.size());
+  WallTimer timer;
+  for (int i = 0; i < problems.size(); ++i) {
+    solver(problems[i].x1, problems[i].x2, &solutions[i]);
+  }
+  double seconds = timer.ElapsedSeconds();
+
+  std::vector<double> errors(problems.size());
+  int num_failures = 0, num_solutions = 0;
+  for (int i = 0; i < problems.size(); ++i) {
+    // E is only defined up to its sign.
+    errors[i] = 2;
+    for (int s = 0; s < solutions[i].size(); ++s) {
+      const Mat3 &E = solutions[i][s];
+      errors[i] = std::min(errors[i], std::min((E - problems[i].E).norm(),
+                                               (E + problems[i].E).norm()));
+    }
+    num_failures += errors[i] > FLAGS_tolerance;
+    num_solutions += solutions[i].size();
+  }
+  std::sort(errors.begin(), errors.end());
+  printf("%-16s %8.2f us/problem  %5.2f solutions  median error %.2e  "
+         "failures %.3f%%\n", name, 1e6 * seconds / problems.size(),
+         double(num_solutions) / problems.size(),
+         errors[errors.size() / 2],
+         100.0 * num_failures / problems.size());
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  libmv::Init("Benchmark the five point solvers.", &argc, &argv);
+
+  srand(FLAGS_seed);
+  vector<Problem> problems(std::max(FLAGS_trials, 1));
+  for (int i = 0; i < problems.size(); ++i) {
+    RandomProblem(&problems[i]);
+  }
+  Benchmark("action matrix", FivePointsRelativePose, problems);
+  Benchmark("Nister / Sturm", FivePointsRelativePoseNister, problems);
+  return 0;
+}
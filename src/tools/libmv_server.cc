@@ -0,0 +1,165 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <map>
+#include <string>
+
+#include "libmv/base/thread.h"
+#include "libmv/correspondence/ArrayMatcher_Kdtree.h"
+#include "libmv/correspondence/robust_tracker.h"
+#include "libmv/correspondence/tracker.h"
+#include "libmv/descriptor/descriptor_factory.h"
+#include "libmv/detector/detector_factory.h"
+#include "libmv/logging/logging.h"
+#include "libmv/reconstruction/session.h"
+#include "libmv/tools/revision.h"
+#include "libmv/tools/tool.h"
+
+using namespace libmv;
+
+DEFINE_string(socket, "/tmp/libmv.sock", "Path of the local socket to serve");
+DEFINE_string(detector, "FAST",
+              "select the detector (FAST,FAST_PYRAMID,STAR,CENSURE,SURF,MSER)");
+DEFINE_string(describer, "DAISY",
+              "select the descriptor (SIMPLIEST,SURF,DIPOLE,DAISY)");
+DEFINE_double(robust_tracker_threshold, 1.0,
+              "Epipolar filtering threshold (in pixels)");
+DEFINE_int32(image_cache_mb, 256, "Size of the cache of the frames (MB)");
+DEFINE_int32(threads, 1, "Threads of the reconstruction and of the shared "
+             "thread pool");
+
+tracker::Tracker *CreateTracker() {
+  std::map<std::string, detector::eDetector> detectorMap;
+  detectorMap["FAST"] = detector::FAST_DETECTOR;
+  detectorMap["FAST_PYRAMID"] = detector::FAST_PYRAMID_DETECTOR;
+  detectorMap["SURF"] = detector::SURF_DETECTOR;
+  detectorMap["STAR"] = detector::STAR_DETECTOR;
+  detectorMap["CENSURE"] = detector::CENSURE_DETECTOR;
+  detectorMap["MSER"] = detector::MSER_DETECTOR;
+  if (detectorMap.find(FLAGS_detector) == detectorMap.end()) {
+    LOG(FATAL) << "ERROR : undefined Detector !";
+  }
+  std::map<std::string, descriptor::eDescriber> descriptorMap;
+  descriptorMap["SIMPLIEST"] = descriptor::SIMPLEST_DESCRIBER;
+  descriptorMap["SURF"]      = descriptor::SURF_DESCRIBER;
+  descriptorMap["DIPOLE"]    = descriptor::DIPOLE_DESCRIBER;
+  descriptorMap["DAISY"]     = descriptor::DAISY_DESCRIBER;
+  if (descriptorMap.find(FLAGS_describer) == descriptorMap.end()) {
+    LOG(FATAL) << "ERROR : undefined Describer !";
+  }
+  tracker::RobustTracker *tracker = new tracker::RobustTracker(
+      detectorFactory(detectorMap[FLAGS_detector]),
+      describerFactory(descriptorMap[FLAGS_describer]),
+      new correspondence::ArrayMatcher_Kdtree<float>());
+  tracker->set_rms_threshold_inlier(FLAGS_robust_tracker_threshold);
+  // The index of the tracks stays warm from one request to the next.
+  tracker->set_use_track_index(true);
+  return tracker;
+}
+
+bool WriteAll(int fd, const std::string &data) {
+  size_t written = 0;
+  while (written < data.size()) {
+    ssize_t n = write(fd, data.data() + written, data.size() - written);
+    if (n <= 0) {
+      return false;
+    }
+    written += n;
+  }
+  return true;
+}
+
+// Serves the requests of a client, one per line, until it disconnects.
+// Returns false if the client asked the server to quit.
+bool ServeClient(int client, ReconstructionSession *session) {
+  std::string pending;
+  char buffer[4096];
+  for (;;) {
+    ssize_t n = read(client, buffer, sizeof(buffer));
+    if (n <= 0) {
+      return true;
+    }
+    pending.append(buffer, n);
+    size_t end;
+    while ((end = pending.find('\n')) != std::string::npos) {
+      std::string request = pending.substr(0, end);
+      pending.erase(0, end + 1);
+      VLOG(1) << "Request: " << request;
+      bool quit;
+      std::string reply = session->Execute(request, &quit);
+      VLOG(1) << "Reply: " << reply;
+      if (!WriteAll(client, reply + "\n") || quit) {
+        return !quit;
+      }
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  std::string usage = "Keeps the frames, features, tracks and reconstruction "
+    "of a shot in memory, and serves track, solve and refine requests on a "
+    "local socket, one per line (see libmv/reconstruction/session.h).\n";
+  usage += "Usage: " + std::string(argv[0]) + " -socket /tmp/libmv.sock\n";
+  usage += "Example: echo 'open shot/*.png' | socat - UNIX:/tmp/libmv.sock\n";
+  usage += "Using libmv v" + std::string(LIBMV_VERSION) + "\n";
+  Init(usage.c_str(), &argc, &argv);
+  SetNumThreads(FLAGS_threads);
+
+  int server = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (server < 0 || FLAGS_socket.size() >= sizeof(address.sun_path)) {
+    LOG(ERROR) << "Cannot create the socket " << FLAGS_socket;
+    return 1;
+  }
+  strncpy(address.sun_path, FLAGS_socket.c_str(), sizeof(address.sun_path) - 1);
+  unlink(FLAGS_socket.c_str());
+  if (bind(server, (sockaddr *)&address, sizeof(address)) != 0 ||
+      listen(server, 4) != 0) {
+    LOG(ERROR) << "Cannot listen on " << FLAGS_socket;
+    close(server);
+    return 1;
+  }
+  // A client that disconnects before its reply must not stop the server.
+  signal(SIGPIPE, SIG_IGN);
+
+  ReconstructionSession session(CreateTracker(), FLAGS_threads,
+                                FLAGS_image_cache_mb * 1024LL * 1024);
+  VLOG(0) << "Serving on " << FLAGS_socket;
+  bool serving = true;
+  while (serving) {
+    int client = accept(server, NULL, NULL);
+    if (client < 0) {
+      continue;
+    }
+    serving = ServeClient(client, &session);
+    close(client);
+  }
+  close(server);
+  unlink(FLAGS_socket.c_str());
+  return 0;
+}
@@ -31,10 +31,12 @@
  *              Use the same graph traversal as in image_selection.
  */
 #include <algorithm>
+#include <sstream>
 #include <string>
 #include <vector>
 
 #include "libmv/base/scoped_ptr.h"
+#include "libmv/base/thread.h"
 #include "libmv/correspondence/feature.h"
 #include "libmv/correspondence/import_matches_txt.h"
 #include "libmv/correspondence/matches.h"
@@ -46,10 +48,8 @@
 #include "libmv/image/image_transform_linear.h"
 #include "libmv/image/cached_image_sequence.h"
 #include "libmv/image/sample.h"
-#include "libmv/multiview/robust_affine.h"
-#include "libmv/multiview/robust_euclidean.h"
-#include "libmv/multiview/robust_homography.h"
-#include "libmv/multiview/robust_similarity.h"
+#include "libmv/image/tiled_mosaic.h"
+#include "libmv/multiview/robust_motion2d.h"
 #include "libmv/logging/logging.h"
 
 enum eGEOMETRIC_TRANSFORMATION  {
@@ -65,66 +65,38 @@ DEFINE_int32 (transformation, SIMILARITY, "Transformation type:\n\t 0: \
 Euclidean\n\t 1:Similarity\n\t 2:Affinity\n\t 3:Homography");
 DEFINE_double(blending_ratio, 0.7, "Blending ratio");
 DEFINE_bool(draw_lines, false, "Draw image bounds");
+DEFINE_int32(threads, 1, "Threads warping each image, and of the shared "
+             "thread pool");
+DEFINE_int32(tile_size, 0, "If positive, the mosaic is composited in tiles "
+             "of this size, written as <mosaic>_x<X>_y<Y>.<ext> as soon as no "
+             "more images touch them, instead of one mosaic image");
              
 using namespace libmv;
 
 /**
- * Computes relative euclidean matrices
+ * Computes the relative matrices of the consecutive images
  *
  * \param matches The 2D features matches
- * \param Ss Vector of relative similarity matrices such that 
- *        $q2 = E1 q1$ and $qi = Ei-1 * ...* E1 q1$
+ * \param transformation The type of the matrices (eGEOMETRIC_TRANSFORMATION)
+ * \param Hs A vector of relative matrices such that
+ *        $q2 = H1 q1$ and $qi = Hi-1 * ...* H1 q1$
  *        where qi is a point in the image i
  *        and q1 is its position in the image 1
  * \param outliers_prob The outliers probability [0, 1[
  * \param max_error_2d The maximun 2D error in pixel
  *
- * TODO(julien) put this in reconstruction
- */
-void ComputeRelativeEuclideanMatrices(const Matches &matches,
-                                      vector<Mat3> *Es,
-                                      double outliers_prob = 1e-2,
-                                      double max_error_2d = 1) {
-  Es->reserve(matches.NumImages() - 1);
-  Mat3 E;
-  vector<Mat> xs2;
-  std::set<Matches::ImageID>::const_iterator image_iter =
-    matches.get_images().begin();
-  std::set<Matches::ImageID>::const_iterator prev_image_iter = image_iter;
-  image_iter++;
-  for (;image_iter != matches.get_images().end(); ++image_iter) {
-    TwoViewPointMatchMatrices(matches, *prev_image_iter, *image_iter, &xs2);
-      if (xs2[0].cols() >= 2) {
-        Euclidean2DFromCorrespondences2PointRobust(xs2[0], xs2[1], 
-                                                   max_error_2d , 
-                                                   &E, NULL, 
-                                                   outliers_prob);
-        Es->push_back(E);
-        VLOG(2) << "E = " << std::endl << E << std::endl;
-      } // TODO(julien) what to do when no enough points?
-    ++prev_image_iter;
-  }
-}
-
-/**
- * Computes relative similarity matrices
- *
- * \param matches The 2D features matches
- * \param Ss Vector of relative similarity matrices such that 
- *        $q2 = S1 q1$ and $qi = Si-1 * ...* S1 q1$
- *        where qi is a point in the image i
- *        and q1 is its position in the image 1
- * \param outliers_prob The outliers probability [0, 1[
- * \param max_error_2d The maximun 2D error in pixel
+ * All the pairs of images are estimated at once by EstimateMotion2DBatch().
  *
  * TODO(julien) put this in reconstruction
  */
-void ComputeRelativeSimilarityMatrices(const Matches &matches,
-                                       vector<Mat3> *Ss,
-                                       double outliers_prob = 1e-2,
-                                       double max_error_2d = 1) {
-  Ss->reserve(matches.NumImages() - 1);
-  Mat3 S;
+void ComputeRelativeMatrices(const Matches &matches,
+                             int transformation,
+                             vector<Mat3> *Hs,
+                             double outliers_prob = 1e-2,
+                             double max_error_2d = 1) {
+  Motion2DEstimator::MotionModel model =
+      static_cast<Motion2DEstimator::MotionModel>(transformation);
+  vector<Mat> x1s, x2s;
   vector<Mat> xs2;
   std::set<Matches::ImageID>::const_iterator image_iter =
     matches.get_images().begin();
@@ -132,91 +104,20 @@ void ComputeRelativeSimilarityMatrices(const Matches &matches,
   image_iter++;
   for (;image_iter != matches.get_images().end(); ++image_iter) {
     TwoViewPointMatchMatrices(matches, *prev_image_iter, *image_iter, &xs2);
-      if (xs2[0].cols() >= 2) {
-        Similarity2DFromCorrespondences2PointRobust(xs2[0], xs2[1], 
-                                                    max_error_2d , 
-                                                    &S, NULL, 
-                                                    outliers_prob);
-        Ss->push_back(S);
-        VLOG(2) << "S = " << std::endl << S << std::endl;
-      } // TODO(julien) what to do when no enough points?
+    x1s.push_back(xs2[0]);
+    x2s.push_back(xs2[1]);
     ++prev_image_iter;
   }
-}
-
-/**
- * Computes relative affine matrices
- *
- * \param matches The 2D features matches
- * \param As A vector of relative affine matrices such that 
- *        $q2 = A1 q1$ and $qi = Ai-1 * ...* A1 q1$
- *        where qi is a point in the image i
- *        and q1 is its position in the image 1
- * \param outliers_prob The outliers probability [0, 1[
- * \param max_error_2d The maximun 2D error in pixel
- *
- * TODO(julien) put this in reconstruction
- */
-void ComputeRelativeAffineMatrices(const Matches &matches,
-                                   vector<Mat3> *As,
-                                   double outliers_prob = 1e-2,
-                                   double max_error_2d = 1) {
-  As->reserve(matches.NumImages() - 1);
-  Mat3 A;
-  vector<Mat> xs2;
-  std::set<Matches::ImageID>::const_iterator image_iter =
-    matches.get_images().begin();
-  std::set<Matches::ImageID>::const_iterator prev_image_iter = image_iter;
-  image_iter++;
-  for (;image_iter != matches.get_images().end(); ++image_iter) {
-    TwoViewPointMatchMatrices(matches, *prev_image_iter, *image_iter, &xs2);
-      if (xs2[0].cols() >= 3) {
-        Affine2DFromCorrespondences3PointRobust(xs2[0], xs2[1], 
-                                                max_error_2d , 
-                                                &A, NULL, 
-                                                outliers_prob);
-        As->push_back(A);
-        VLOG(2) << "A = " << std::endl << A << std::endl;
-      } // TODO(julien) what to do when no enough points?
-    ++prev_image_iter;
-  }
-}
-
-/**
- * Computes relative homography matrices
- *
- * \param matches The 2D features matches
- * \param Hs A vector of relative homography matrices such that 
- *        $q2 = H1 q1$ and $qi = Hi-1 * ...* H1 q1$
- *        where qi is a point in the image i
- *        and q1 is its position in the image 1
- * \param outliers_prob The outliers probability [0, 1[
- * \param max_error_2d The maximun 2D error in pixel
- *
- * TODO(julien) Put this in reconstruction
- */
-void ComputeRelativeHomographyMatrices(const Matches &matches,
-                                       vector<Mat3> *Hs,
-                                       double outliers_prob = 1e-2,
-                                       double max_error_2d = 1) {
-  Hs->reserve(matches.NumImages() - 1);
-  Mat3 H;
-  vector<Mat> xs2;
-  std::set<Matches::ImageID>::const_iterator image_iter =
-    matches.get_images().begin();
-  std::set<Matches::ImageID>::const_iterator prev_image_iter = image_iter;
-  image_iter++;
-  for (;image_iter != matches.get_images().end(); ++image_iter) {
-    TwoViewPointMatchMatrices(matches, *prev_image_iter, *image_iter, &xs2);
-      if (xs2[0].cols() >= 4) {
-        Homography2DFromCorrespondences4PointRobust(xs2[0], xs2[1], 
-                                                    max_error_2d, 
-                                                    &H, NULL, 
-                                                    outliers_prob);
-        Hs->push_back(H);
-        VLOG(2) << "H = " << std::endl << H << std::endl;
-      } // TODO(julien) what to do when no enough points?
-    ++prev_image_iter;
+  vector<Mat3> relative_Hs;
+  vector<double> errors;
+  EstimateMotion2DBatch(x1s, x2s, model, max_error_2d, outliers_prob,
+                        &relative_Hs, &errors, NULL, FLAGS_threads);
+  Hs->reserve(relative_Hs.size());
+  for (int i = 0; i < relative_Hs.size(); ++i) {
+    if (errors[i] < HUGE_VAL) {
+      Hs->push_back(relative_Hs[i]);
+      VLOG(2) << "H = " << std::endl << relative_Hs[i] << std::endl;
+    } // TODO(julien) what to do when no enough points?
   }
 }
 
@@ -267,6 +168,21 @@ void ComputeGlobalBoundingBox(const Vec2u &images_size,
   (*bbox)(3) = std::min((int) 5e3, (*bbox)(3));
 }
 
+// Draws the bounds of the image in white.
+void DrawImageBounds(const Vec2u &images_size, FloatImage *image) {
+  float lines_color[3] = {1, 1, 1};
+  DrawLine<FloatImage, float[3]>(0, 0, 0, images_size(1) - 1,
+                                 lines_color, image);
+  DrawLine<FloatImage, float[3]>(0, 0, images_size(0) - 1, 0,
+                                 lines_color, image);
+  DrawLine<FloatImage, float[3]>(               0, images_size(1)-1,
+                                 images_size(0)-1, images_size(1)-1,
+                                 lines_color, image);
+  DrawLine<FloatImage, float[3]>(images_size(0)-1,                0,
+                                 images_size(0)-1, images_size(1)-1,
+                                 lines_color, image);
+}
+
 /**
  * Builds a mosaic of a list of image files.
  * 
@@ -318,7 +234,6 @@ void BuildMosaic(const std::vector<std::string> &image_files,
           0, 0, 1;
   //for (size_t i = 0; i < image_files.size() / 2; ++i)
   //  Hreg = Hreg * Hs[i];
-  float lines_color[3] = {1, 1, 1};
   FloatImage *image = NULL;
   ImageCache cache;
   scoped_ptr<ImageSequence> source(ImageSequenceFromFiles(image_files, &cache));
@@ -328,23 +243,110 @@ void BuildMosaic(const std::vector<std::string> &image_files,
     image = source->GetFloatImage(i);
     if (image) {
       if (draw_lines) {
-        DrawLine<FloatImage, float[3]>(0, 0, 0, images_size(1) - 1, 
-                                       lines_color, image);
-        DrawLine<FloatImage, float[3]>(0, 0, images_size(0) - 1, 0, 
-                                       lines_color, image);
-        DrawLine<FloatImage, float[3]>(               0, images_size(1)-1, 
-                                       images_size(0)-1, images_size(1)-1, 
-                                       lines_color, image);
-        DrawLine<FloatImage, float[3]>(images_size(0)-1,                0, 
-                                       images_size(0)-1, images_size(1)-1, 
-                                       lines_color, image); 
+        DrawImageBounds(images_size, image);
       }
-      WarpImageBlend(*image, (Hreg * H), mosaic, blending_ratio);
+      WarpImageBlend(*image, (Hreg * H), mosaic, blending_ratio,
+                     FLAGS_threads);
     }
     source->Unpin(i);
   }
 }
 
+/**
+ * Builds a mosaic of a list of image files tile by tile.
+ *
+ * Same as BuildMosaic(), but the mosaic is a TiledMosaic: each image is only
+ * warped into the tiles it touches, in parallel, and a tile is written to
+ * <stem of output_file>_x<X>_y<Y><extension of output_file> and freed after
+ * the last image touching it, so only the tiles under the images in flight
+ * are in memory.
+ *
+ * \param image_files The input image files
+ * \param Hs The 2D relative warp matrices
+ * \param blending_ratio The blending ratio for overlapping zones
+ * \param draw_lines If true, the images bounds are drawn
+ * \param tile_size The size of the tiles, in pixels
+ * \param output_file The name the tile files are derived from
+ */
+void BuildTiledMosaic(const std::vector<std::string> &image_files,
+                      const vector<Mat3> &Hs,
+                      float blending_ratio,
+                      bool draw_lines,
+                      int tile_size,
+                      const std::string &output_file) {
+  assert(image_files.size() == Hs.size() - 1);
+
+  Vec2u images_size;
+  ByteImage imageArrayBytes;
+  ReadImage (image_files[0].c_str(), &imageArrayBytes);
+  images_size << imageArrayBytes.Width(), imageArrayBytes.Height();
+
+  Vec4i bbox;
+  ComputeGlobalBoundingBox(images_size, Hs, &bbox);
+  VLOG(0) << "bbox: " << bbox.transpose() << std::endl;
+  TiledMosaic mosaic(bbox(1) - bbox(0), bbox(3) - bbox(2),
+                     imageArrayBytes.Depth(), tile_size);
+  VLOG(0) << "Mosaic size: h=" << mosaic.Height() << " "
+          << "w="              << mosaic.Width() << " "
+          << "tiles="          << mosaic.NumTiles() << std::endl;
+
+  // The warps into the mosaic and, for each tile, the last image touching it.
+  Mat3 Hreg;
+  Hreg << 1, 0, -bbox(0),
+          0, 1, -bbox(2),
+          0, 0, 1;
+  std::vector<Mat3> warps(image_files.size());
+  std::vector<int> last_image(mosaic.NumTiles(), -1);
+  std::vector<std::vector<int> > finished_tiles(image_files.size());
+  Mat3 H;
+  H.setIdentity();
+  std::vector<int> tiles;
+  for (size_t i = 0; i < image_files.size(); ++i) {
+    if (i > 0)
+      H = Hs[i - 1].inverse() * H;
+    warps[i] = Hreg * H;
+    mosaic.TouchedTiles(images_size, warps[i], &tiles);
+    for (size_t j = 0; j < tiles.size(); ++j) {
+      last_image[tiles[j]] = i;
+    }
+  }
+  for (int tile = 0; tile < mosaic.NumTiles(); ++tile) {
+    if (last_image[tile] >= 0) {
+      finished_tiles[last_image[tile]].push_back(tile);
+    }
+  }
+
+  const size_t dot = output_file.find_last_of('.');
+  const std::string stem = output_file.substr(0, dot);
+  const std::string extension =
+      dot == std::string::npos ? "" : output_file.substr(dot);
+  ImageCache cache;
+  scoped_ptr<ImageSequence> source(ImageSequenceFromFiles(image_files, &cache));
+  for (size_t i = 0; i < image_files.size(); ++i) {
+    FloatImage *image = source->GetFloatImage(i);
+    if (image) {
+      if (draw_lines) {
+        DrawImageBounds(images_size, image);
+      }
+      mosaic.WarpBlend(*image, warps[i], blending_ratio, FLAGS_threads);
+    }
+    source->Unpin(i);
+
+    for (size_t j = 0; j < finished_tiles[i].size(); ++j) {
+      const int tile = finished_tiles[i][j];
+      if (!mosaic.Tile(tile)) {
+        continue;
+      }
+      int x, y, width, height;
+      mosaic.TileBounds(tile, &x, &y, &width, &height);
+      std::stringstream tile_file;
+      tile_file << stem << "_x" << x << "_y" << y << extension;
+      WriteImage(*mosaic.Tile(tile), tile_file.str().c_str());
+      mosaic.ReleaseTile(tile);
+    }
+  }
+}
+
 int main(int argc, char **argv) {
 
   std::string usage ="Creates a mosaic from a video.\n";
@@ -354,6 +356,7 @@ int main(int argc, char **argv) {
   usage += "\t - MOSAIC_IMAGE is the output image {PNG, PNM, JPEG}\n";
   google::SetUsageMessage(usage);
   google::ParseCommandLineFlags(&argc, &argv, true);
+  libmv::SetNumThreads(FLAGS_threads);
 
   // This is not the place for this. I am experimenting with what sort of API
   // will be convenient for the tracking base classes.
@@ -376,29 +379,29 @@ int main(int argc, char **argv) {
   vector<Mat3> Hs;
   double outliers_prob = 1e-2;
   VLOG(0) << "Estimating relative matrices..." << std::endl;
-  switch (FLAGS_transformation) {
-    // TODO(julien) add custom degree of freedom selection (e.g. x, y, x & y, ...)
-    case EUCLIDEAN:
-      ComputeRelativeEuclideanMatrices(fg.matches_, &Hs, outliers_prob);
-    break;
-    case SIMILARITY:
-      ComputeRelativeSimilarityMatrices(fg.matches_, &Hs, outliers_prob);
-    break;
-    case AFFINE:
-      ComputeRelativeAffineMatrices(fg.matches_, &Hs, outliers_prob);
-    break;
-    case HOMOGRAPHY:
-      ComputeRelativeHomographyMatrices(fg.matches_, &Hs, outliers_prob);
-    break;
-  }
+  // TODO(julien) add custom degree of freedom selection (e.g. x, y, x & y, ...)
+  ComputeRelativeMatrices(fg.matches_, FLAGS_transformation, &Hs,
+                          outliers_prob);
   VLOG(0) << "Estimating relative matrices...[DONE]." << std::endl;
 
+  if (FLAGS_tile_size > 0) {
+    VLOG(0) << "Building tiled mosaic..." << std::endl;
+    BuildTiledMosaic(files, Hs,
+                     FLAGS_blending_ratio,
+                     FLAGS_draw_lines,
+                     FLAGS_tile_size,
+                     FLAGS_o);
+    VLOG(0) << "Building tiled mosaic...[DONE]." << std::endl;
+    fg.DeleteAndClear();
+    return 0;
+  }
+
   Image mosaic(new FloatImage());
   VLOG(0) << "Building mosaic..." << std::endl;
   BuildMosaic(files, Hs, 
               FLAGS_blending_ratio, 
               FLAGS_draw_lines,
-              mosaic.AsArray3Df());
+              mosaic.MutableArray3Df());
   VLOG(0) << "Building mosaic...[DONE]." << std::endl;
   
   // Write the mosaic
@@ -29,9 +29,12 @@
 #include "libmv/base/vector.h"
 #include "libmv/base/vector_utils.h"
 #include "libmv/base/scoped_ptr.h"
+#include "libmv/base/thread.h"
+#include "libmv/correspondence/distributed_matching.h"
 #include "libmv/correspondence/export_matches_txt.h"
 #include "libmv/correspondence/feature.h"
 #include "libmv/correspondence/feature_matching.h"
+#include "libmv/correspondence/matches_binary.h"
 #include "libmv/correspondence/nRobustViewMatching.h"
 #include "libmv/detector/detector_factory.h"
 #include "libmv/descriptor/descriptor_factory.h"
@@ -52,8 +55,45 @@ DEFINE_bool(save_matches_results, true,
 DEFINE_bool(save_matches_file, false,
             "save the matches in a file");
 DEFINE_string(matches_out, "matches.txt", "Matches output file");
+DEFINE_int32(candidates, 0,
+             "only match every image with its most similar ones, found with "
+             "a vocabulary tree (0 to match all the pairs)");
+DEFINE_int32(threads, 1, "Threads matching the pairs of images, and of the "
+             "shared thread pool");
+DEFINE_bool(release_descriptors, false,
+            "free the descriptors of every image once all its pairs are "
+            "matched");
+DEFINE_string(feature_cache_dir, "",
+              "directory caching the features of every image between runs "
+              "(empty to disable)");
+DEFINE_bool(guided_matching, false,
+            "match again near the epipolar lines of the fitted models");
 DEFINE_bool(save_hugin, true,
             "save Hugin point matches (ready to minimize Hugin project)");
+DEFINE_bool(batch, false,
+            "batch mode for large sets: the features are extracted by "
+            "--threads detectors and describers, the matches of every pair "
+            "are written to --pair_matches_out as soon as they are found, and "
+            "the per image results and displays are skipped");
+DEFINE_string(pair_matches_out, "pair_matches.txt",
+              "batch mode output, one line \"indexA indexB xA yA xB yB\" "
+              "per match");
+DEFINE_string(image_list, "",
+              "file listing input images, one per line, in addition to the "
+              "ones of the command line");
+DEFINE_string(distributed, "",
+              "run one stage of the matching of a set on several nodes "
+              "sharing --distributed_dir and --feature_cache_dir: \"extract\" "
+              "the features of the images of --node, list the \"pairs\" of "
+              "--candidates once, \"match\" the pairs of --node, or "
+              "\"merge\" the matches of all the nodes into --tracks_out "
+              "(empty to match on this machine only)");
+DEFINE_int32(num_nodes, 1, "number of nodes of the distributed stages");
+DEFINE_int32(node, 0, "index of this node, from 0 to --num_nodes - 1");
+DEFINE_string(distributed_dir, ".",
+              "directory of the pair list and the pair matches of the nodes");
+DEFINE_string(tracks_out, "tracks.bin",
+              "binary matches file of the tracks of the merge stage");
 //TODO(pmoulon) this parameter must set the homography as geometric constraint
 DEFINE_bool(save_reconstruction, true,
             "save perspective reconstruction from largest track (.ply)");
@@ -117,20 +157,141 @@ void DisplayMatches(const Matches &matches)
   }
 }
 
+// The stages of --distributed, see libmv/correspondence/distributed_matching.h.
+// The features are only shared through the feature cache.
+int ExtractShard(const libmv::vector<string> &image_vector,
+                 detector::Detector *detector,
+                 descriptor::Describer *describer,
+                 const std::vector<detector::Detector *> &detectors,
+                 const std::vector<descriptor::Describer *> &describers) {
+  std::vector<int> images;
+  ShardImages(image_vector.size(), FLAGS_num_nodes, FLAGS_node, &images);
+  // The features of a chunk are dropped once they are cached.
+  const int chunk_size = 64 * max(FLAGS_threads, 1);
+  bool bRes = true;
+  for (int first = 0; first < images.size(); first += chunk_size) {
+    const int last = min(first + chunk_size, int(images.size()));
+    libmv::vector<string> names;
+    names.reserve(last - first);
+    for (int i = first; i < last; ++i) {
+      names.push_back(image_vector[images[i]]);
+    }
+    correspondence::nRobustViewMatching extractor(detector, describer);
+    extractor.setFeatureCache(FLAGS_feature_cache_dir,
+                              FLAGS_detector + "/" + FLAGS_describer);
+    extractor.setExtractors(detectors, describers);
+    bRes &= extractor.computeAllData(names);
+  }
+  LOG(INFO) << "Node " << FLAGS_node << " extracted the features of "
+            << images.size() << " images.";
+  return bRes ? 0 : 1;
+}
+
+int ListPairs(const libmv::vector<string> &image_vector,
+              correspondence::nRobustViewMatching *matcher) {
+  std::vector<ImagePair> pairs;
+  if (!matcher->computeCandidatePairs(image_vector, FLAGS_candidates,
+                                      &pairs)) {
+    LOG(ERROR) << "No descriptors to find the candidate pairs.";
+    return 1;
+  }
+  string filename = PairListFilename(FLAGS_distributed_dir);
+  if (!WritePairList(filename, pairs)) {
+    LOG(FATAL) << "Cannot write " << filename;
+  }
+  LOG(INFO) << "Listed " << pairs.size() << " candidate pairs in "
+            << filename;
+  return 0;
+}
+
+int MatchPartition(const libmv::vector<string> &image_vector,
+                   correspondence::nRobustViewMatching *matcher) {
+  std::vector<ImagePair> pairs, node_pairs;
+  if (FLAGS_candidates > 0) {
+    string filename = PairListFilename(FLAGS_distributed_dir);
+    if (!ReadPairList(filename, &pairs)) {
+      LOG(FATAL) << "Cannot read the pair list " << filename
+                 << ", run the \"pairs\" stage first.";
+    }
+  } else {
+    AllImagePairs(image_vector.size(), &pairs);
+  }
+  PartitionPairs(pairs, FLAGS_num_nodes, FLAGS_node, &node_pairs);
+  bool bRes = matcher->computePairMatch(image_vector, node_pairs);
+
+  const map< pair<string,string>, Matches> &shared =
+    matcher->getSharedData();
+  std::vector<const Matches *> pair_matches(node_pairs.size(), NULL);
+  for (size_t i = 0; i < node_pairs.size(); ++i) {
+    map< pair<string,string>, Matches>::const_iterator found =
+      shared.find(make_pair(image_vector[node_pairs[i].first],
+                            image_vector[node_pairs[i].second]));
+    if (found != shared.end()) {
+      pair_matches[i] = &found->second;
+    }
+  }
+  string filename = PairMatchesFilename(FLAGS_distributed_dir, FLAGS_node);
+  if (!ExportPairMatchesToBinary(node_pairs, pair_matches, filename)) {
+    LOG(FATAL) << "Cannot write " << filename;
+  }
+  LOG(INFO) << "Node " << FLAGS_node << " matched " << node_pairs.size()
+            << " pairs into " << filename;
+  return bRes ? 0 : 1;
+}
+
+int MergeNodes() {
+  PairTrackBuilder builder;
+  for (int node = 0; node < FLAGS_num_nodes; ++node) {
+    string filename = PairMatchesFilename(FLAGS_distributed_dir, node);
+    if (!builder.AddFile(filename)) {
+      LOG(FATAL) << "Cannot read the matches of node " << node << " from "
+                 << filename;
+    }
+  }
+  Matches tracks;
+  FeatureSet features;
+  int num_dropped = builder.Build(&tracks, &features);
+  if (!ExportMatchesToBinary(tracks, FLAGS_tracks_out)) {
+    LOG(FATAL) << "Cannot write " << FLAGS_tracks_out;
+  }
+  LOG(INFO) << "Merged " << builder.NumFeatures() << " features into "
+            << tracks.NumTracks() << " tracks (" << num_dropped
+            << " inconsistent tracks dropped) in " << FLAGS_tracks_out;
+  return 0;
+}
 
 int main(int argc, char **argv) {
 
   google::SetUsageMessage("NViewMatching Demo.");
   google::ParseCommandLineFlags(&argc, &argv, true);
+  libmv::SetNumThreads(FLAGS_threads);
 
-  libmv::vector<string> image_vector;
-
+  std::vector<string> image_names;
   for (int i = 1;i < argc;++i) {
     std::string arg (argv[i]);
     if (IsArgImage(arg)) {
-      image_vector.push_back(arg);
+      image_names.push_back(arg);
     }
   }
+  if (!FLAGS_image_list.empty()) {
+    ifstream list(FLAGS_image_list.c_str());
+    if (!list) {
+      LOG(FATAL) << "Cannot read the image list " << FLAGS_image_list;
+    }
+    string line;
+    while (getline(list, line)) {
+      if (IsArgImage(line)) {
+        image_names.push_back(line);
+      }
+    }
+  }
+  // libmv::vector moves its elements with memcpy when it grows, which breaks
+  // short strings: reserve all the names up front.
+  libmv::vector<string> image_vector;
+  image_vector.reserve(image_names.size());
+  for (size_t i = 0; i < image_names.size(); ++i) {
+    image_vector.push_back(image_names[i]);
+  }
 
   detector::eDetector edetector = detector::FAST_DETECTOR;
   if (FLAGS_detector == "FAST") {
@@ -162,16 +323,82 @@ int main(int argc, char **argv) {
 
   libmv::correspondence::nRobustViewMatching nViewMatcher(spDetector.get(),
                                                           spDescriber.get());
+  nViewMatcher.setGuidedMatching(FLAGS_guided_matching);
+  nViewMatcher.setNumThreads(FLAGS_threads);
+  nViewMatcher.setReleaseDescriptors(FLAGS_release_descriptors);
+  if (!FLAGS_feature_cache_dir.empty()) {
+    nViewMatcher.setFeatureCache(FLAGS_feature_cache_dir,
+                                 FLAGS_detector + "/" + FLAGS_describer);
+  }
 
-  nViewMatcher.computeCrossMatch(image_vector);
+  // The detectors and describers are not thread safe: one pair per thread.
+  std::vector<detector::Detector *> batchDetectors;
+  std::vector<descriptor::Describer *> batchDescribers;
+  ofstream pairMatchesFile;
+  if (FLAGS_batch || !FLAGS_distributed.empty()) {
+    for (int i = 0; i < max(FLAGS_threads, 1); ++i) {
+      batchDetectors.push_back(detectorFactory(edetector));
+      batchDescribers.push_back(describerFactory(edescriber));
+    }
+    nViewMatcher.setExtractors(batchDetectors, batchDescribers);
+  }
+
+  if (!FLAGS_distributed.empty()) {
+    if (FLAGS_num_nodes < 1 || FLAGS_node < 0 ||
+        FLAGS_node >= FLAGS_num_nodes) {
+      LOG(FATAL) << "Invalid node " << FLAGS_node << " of " << FLAGS_num_nodes;
+    }
+    if (FLAGS_feature_cache_dir.empty() && FLAGS_distributed != "merge") {
+      LOG(FATAL) << "The distributed stages need a --feature_cache_dir.";
+    }
+    int status = 0;
+    if (FLAGS_distributed == "extract") {
+      status = ExtractShard(image_vector, spDetector.get(), spDescriber.get(),
+                            batchDetectors, batchDescribers);
+    } else if (FLAGS_distributed == "pairs") {
+      if (FLAGS_candidates <= 0) {
+        LOG(FATAL) << "The \"pairs\" stage needs --candidates, without it "
+                   << "all the pairs are matched.";
+      }
+      status = ListPairs(image_vector, &nViewMatcher);
+    } else if (FLAGS_distributed == "match") {
+      status = MatchPartition(image_vector, &nViewMatcher);
+    } else if (FLAGS_distributed == "merge") {
+      status = MergeNodes();
+    } else {
+      LOG(FATAL) << "ERROR : undefined distributed stage !";
+    }
+    DeleteElements(&batchDetectors);
+    DeleteElements(&batchDescribers);
+    return status;
+  }
+
+  if (FLAGS_batch) {
+    pairMatchesFile.open(FLAGS_pair_matches_out.c_str());
+    if (!pairMatchesFile) {
+      LOG(FATAL) << "Cannot write " << FLAGS_pair_matches_out;
+    }
+    nViewMatcher.setPairMatchesOutput(&pairMatchesFile);
+  }
+
+  if (FLAGS_candidates > 0) {
+    nViewMatcher.computeCandidateMatch(image_vector, FLAGS_candidates);
+  } else {
+    nViewMatcher.computeCrossMatch(image_vector);
+  }
 
-  // Show Cross Matches
-  DisplayMatches(nViewMatcher.getMatches());
-  
   //-- Export the matches
   if (FLAGS_save_matches_file) {
     ExportMatchesToTxt(nViewMatcher.getMatches(), FLAGS_matches_out);
   }
+  if (FLAGS_batch) {
+    DeleteElements(&batchDetectors);
+    DeleteElements(&batchDescribers);
+    return 0;
+  }
+
+  // Show Cross Matches
+  DisplayMatches(nViewMatcher.getMatches());
 
   //-- Export and visualize data (show matches between the images)
   if (FLAGS_save_matches_results) {
@@ -0,0 +1,372 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Times the track and reconstruct pipeline of tools/track and
+// tools/reconstruct_video on synthetic videos of increasing sizes: for every
+// stage, the wall time and the peak memory, and the final reprojection error.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <list>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <cstring>
+#endif
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "libmv/base/memory_budget.h"
+#include "libmv/base/thread.h"
+#include "libmv/base/timer.h"
+#include "libmv/correspondence/klt.h"
+#include "libmv/correspondence/matches.h"
+#include "libmv/image/image.h"
+#include "libmv/image/image_pyramid.h"
+#include "libmv/multiview/test_data_sets.h"
+#include "libmv/reconstruction/euclidean_reconstruction.h"
+#include "libmv/reconstruction/optimization.h"
+#include "libmv/reconstruction/reconstruction.h"
+#include "libmv/tools/tool.h"
+
+DEFINE_int32(frames, 30, "Number of frames of the smallest video.");
+DEFINE_int32(points, 200, "Number of points of the smallest video.");
+DEFINE_string(sizes, "1,2,4", "Comma separated scales of the videos: the "
+              "frames and the points are multiplied by each of them.");
+DEFINE_double(noise, 0.3, "Standard deviation of the noise of the "
+              "projections, in pixels.");
+DEFINE_double(outliers, 0.02, "Fraction of the observations that are "
+              "outliers; only used without --track.");
+DEFINE_int32(min_track_length, 8, "Minimum number of frames a point is "
+             "tracked for.");
+DEFINE_bool(track, true, "Render the frames and track them with KLT, as "
+            "tools/track does, instead of using the projections directly.");
+DEFINE_int32(pyramid_levels, 3, "Number of levels of the image pyramids.");
+DEFINE_int32(threads, 1, "Threads tracking the features and reconstructing "
+             "the non-keyframes, and of the shared thread pool.");
+DEFINE_int32(seed, 1, "Seed of the random videos.");
+DEFINE_bool(csv, false, "Write a CSV line per size instead of a table.");
+DEFINE_string(trace, "", "Write a Chrome trace event timeline of the "
+              "instrumented scopes to this file.");
+DEFINE_int32(memory_budget_mb, 0, "Budget of the memory accounted by the "
+             "caches, pyramids, tracks and bundle adjusters; 0 is no budget.");
+
+using namespace libmv;
+
+namespace {
+
+const char *kStages[] = { "generate", "track", "reconstruct", "bundle" };
+const int kNumStages = 4;
+
+// Restarts the measure of the peak memory, when the system can. Otherwise the
+// peak is the one of the process, which is still the one of the stage for
+// the largest sizes since they run last.
+void ResetPeakMemory() {
+#ifdef __linux__
+  FILE *clear_refs = fopen("/proc/self/clear_refs", "w");
+  if (clear_refs) {
+    fputs("5", clear_refs);
+    fclose(clear_refs);
+  }
+#endif
+}
+
+// The peak resident memory since the last ResetPeakMemory(), in megabytes.
+double PeakMemoryInMB() {
+#ifdef __linux__
+  FILE *status = fopen("/proc/self/status", "r");
+  if (status) {
+    char line[256];
+    long kilobytes = -1;
+    while (fgets(line, sizeof(line), status)) {
+      if (strncmp(line, "VmHWM:", 6) == 0) {
+        kilobytes = strtol(line + 6, NULL, 10);
+        break;
+      }
+    }
+    fclose(status);
+    if (kilobytes >= 0) {
+      return kilobytes / 1024.0;
+    }
+  }
+#endif
+#ifndef _WIN32
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.0;
+#else
+  return 0;
+#endif
+}
+
+struct Measure {
+  double seconds[kNumStages];
+  double peak_mb[kNumStages];
+  int num_observations;
+  int num_tracks;
+  int num_cameras;
+  int num_points;
+  double rms;
+};
+
+class StageTimer {
+ public:
+  StageTimer(int stage, Measure *measure) : stage_(stage), measure_(measure) {
+    ResetPeakMemory();
+  }
+  ~StageTimer() {
+    measure_->seconds[stage_] = timer_.ElapsedSeconds();
+    measure_->peak_mb[stage_] = PeakMemoryInMB();
+  }
+ private:
+  int stage_;
+  Measure *measure_;
+  WallTimer timer_;
+};
+
+// Renders every visible point as a Gaussian blob, of an intensity that
+// depends on the point so that the neighborhoods differ.
+void RenderFrame(const NViewDataSet &d, int frame,
+                 int width, int height, FloatImage *image) {
+  const int kRadius = 4;
+  const double kSigma = 1.5;
+  image->Resize(height, width);
+  image->Fill(0.1);
+  for (int k = 0; k < d.x[frame].cols(); ++k) {
+    double u = d.x[frame](0, k), v = d.x[frame](1, k);
+    double intensity = 0.3 + 0.05 * (d.x_ids[frame][k] % 11);
+    int x0 = static_cast<int>(u), y0 = static_cast<int>(v);
+    for (int y = std::max(y0 - kRadius, 0);
+         y <= std::min(y0 + kRadius, height - 1); ++y) {
+      for (int x = std::max(x0 - kRadius, 0);
+           x <= std::min(x0 + kRadius, width - 1); ++x) {
+        double r2 = (x - u) * (x - u) + (y - v) * (y - v);
+        (*image)(y, x) += intensity * exp(-r2 / (2 * kSigma * kSigma));
+      }
+    }
+  }
+}
+
+// The observations of the data set as matches, the track of a point being
+// its index.
+void MatchesFromDataSet(const NViewDataSet &d,
+                        Matches *matches,
+                        std::vector<Feature *> *features) {
+  for (int i = 0; i < d.n; ++i) {
+    for (int k = 0; k < d.x[i].cols(); ++k) {
+      PointFeature *feature = new PointFeature(d.x[i](0, k), d.x[i](1, k));
+      features->push_back(feature);
+      matches->Insert(i, d.x_ids[i][k], feature);
+    }
+  }
+}
+
+// Tracks the rendered frames as tools/track does, detecting new features
+// where the tracks were lost.
+void TrackFrames(const NViewDataSet &d, int width, int height,
+                 Matches *matches,
+                 std::vector<Feature *> *features) {
+  KLTContext klt;
+  klt.SetNumThreads(FLAGS_threads);
+  FloatImage image;
+  ImagePyramid *previous = NULL;
+  KLTContext::FeatureList live;
+  std::vector<Matches::TrackID> live_tracks;
+  Matches::TrackID next_track = 0;
+  for (int i = 0; i < d.n; ++i) {
+    RenderFrame(d, i, width, height, &image);
+    ImagePyramid *current = MakeImagePyramid(image, FLAGS_pyramid_levels, 0.9);
+
+    KLTContext::FeatureList tracked;
+    std::vector<Matches::TrackID> tracked_tracks;
+    if (previous) {
+      KLTContext::FeatureArray features1(live.size()), features2;
+      std::vector<int> is_tracked;
+      int k = 0;
+      for (KLTContext::FeatureList::iterator it = live.begin();
+           it != live.end(); ++it, ++k) {
+        features1[k] = **it;
+      }
+      klt.TrackFeatures(previous, features1, current, &features2, &is_tracked);
+      for (k = 0; k < features2.size(); ++k) {
+        if (is_tracked[k]) {
+          tracked.push_back(new KLTPointFeature(features2[k]));
+          tracked_tracks.push_back(live_tracks[k]);
+        }
+      }
+    }
+    klt.ReplenishGoodFeatures(current->Level(0), &tracked);
+    while (tracked_tracks.size() < tracked.size()) {
+      tracked_tracks.push_back(next_track++);
+    }
+    int k = 0;
+    for (KLTContext::FeatureList::iterator it = tracked.begin();
+         it != tracked.end(); ++it, ++k) {
+      features->push_back(*it);
+      matches->Insert(i, tracked_tracks[k], *it);
+    }
+    live.swap(tracked);
+    live_tracks.swap(tracked_tracks);
+    delete previous;
+    previous = current;
+  }
+  delete previous;
+}
+
+bool RunPipeline(int scale, Measure *measure) {
+  ResetPeakMemoryInUse();
+  SyntheticVideoOptions options;
+  options.num_frames = scale * FLAGS_frames;
+  options.num_points = scale * FLAGS_points;
+  options.noise = FLAGS_noise;
+  options.outlier_ratio = FLAGS_track ? 0 : FLAGS_outliers;
+  options.min_track_length = FLAGS_min_track_length;
+
+  NViewDataSet d;
+  {
+    StageTimer timer(0, measure);
+    d = SyntheticVideo(options);
+  }
+  measure->num_observations = 0;
+  for (int i = 0; i < d.n; ++i) {
+    measure->num_observations += d.x[i].cols();
+  }
+
+  Matches matches;
+  std::vector<Feature *> features;
+  {
+    StageTimer timer(1, measure);
+    if (FLAGS_track) {
+      TrackFrames(d, options.width, options.height, &matches, &features);
+    } else {
+      MatchesFromDataSet(d, &matches, &features);
+    }
+  }
+  measure->num_tracks = matches.NumTracks();
+
+  std::list<Reconstruction *> reconstructions;
+  bool success;
+  {
+    StageTimer timer(2, measure);
+    success = EuclideanReconstructionFromVideo(matches,
+                                               options.width,
+                                               options.height,
+                                               options.focal,
+                                               &reconstructions,
+                                               FLAGS_threads);
+  }
+
+  // The largest reconstruction is adjusted and evaluated.
+  Reconstruction *reconstruction = NULL;
+  std::list<Reconstruction *>::iterator it = reconstructions.begin();
+  for (; it != reconstructions.end(); ++it) {
+    if (!reconstruction || (*it)->GetNumberCameras() >
+                           reconstruction->GetNumberCameras()) {
+      reconstruction = *it;
+    }
+  }
+  success = success && reconstruction;
+  {
+    StageTimer timer(3, measure);
+    if (success) {
+      MetricBundleAdjust(matches, reconstruction);
+    }
+  }
+  measure->num_cameras = success ? reconstruction->GetNumberCameras() : 0;
+  measure->num_points = success ? reconstruction->GetNumberStructures() : 0;
+  measure->rms = success ? EstimateRootMeanSquareError(matches, reconstruction)
+                         : 0;
+  if (VLOG_IS_ON(1)) {
+    PrintMemoryUsage(stderr);
+  }
+
+  for (it = reconstructions.begin(); it != reconstructions.end(); ++it) {
+    (*it)->ClearCamerasMap();
+    (*it)->ClearStructuresMap();
+    delete *it;
+  }
+  for (int i = 0; i < features.size(); ++i) {
+    delete features[i];
+  }
+  return success;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  libmv::Init("Benchmark the tracking and the reconstruction of synthetic "
+              "videos.", &argc, &argv);
+  libmv::SetNumThreads(FLAGS_threads);
+  libmv::StartTrace(FLAGS_trace);
+  libmv::SetMemoryBudget(FLAGS_memory_budget_mb * 1048576LL);
+
+  std::vector<int> scales;
+  const char *sizes = FLAGS_sizes.c_str();
+  for (char *end; *sizes; sizes = *end ? end + 1 : end) {
+    int scale = strtol(sizes, &end, 10);
+    if (end == sizes || scale <= 0) {
+      LOG(ERROR) << "Invalid --sizes " << FLAGS_sizes;
+      return 1;
+    }
+    scales.push_back(scale);
+  }
+
+  if (FLAGS_csv) {
+    printf("frames,points,observations,tracks");
+    for (int s = 0; s < kNumStages; ++s) {
+      printf(",%s_seconds,%s_peak_mb", kStages[s], kStages[s]);
+    }
+    printf(",cameras,reconstructed_points,rms\n");
+  }
+  for (int i = 0; i < scales.size(); ++i) {
+    srand(FLAGS_seed);
+    Measure measure;
+    bool success = RunPipeline(scales[i], &measure);
+    int frames = scales[i] * FLAGS_frames, points = scales[i] * FLAGS_points;
+    if (FLAGS_csv) {
+      printf("%d,%d,%d,%d", frames, points,
+             measure.num_observations, measure.num_tracks);
+      for (int s = 0; s < kNumStages; ++s) {
+        printf(",%.6f,%.1f", measure.seconds[s], measure.peak_mb[s]);
+      }
+      printf(",%d,%d,%.6f\n",
+             measure.num_cameras, measure.num_points, measure.rms);
+      continue;
+    }
+    printf("%d frames, %d points, %d observations, %d tracks\n",
+           frames, points, measure.num_observations, measure.num_tracks);
+    printf("  %-12s %10s %10s\n", "stage", "seconds", "peak MB");
+    for (int s = 0; s < kNumStages; ++s) {
+      printf("  %-12s %10.3f %10.1f\n",
+             kStages[s], measure.seconds[s], measure.peak_mb[s]);
+    }
+    if (success) {
+      printf("  %d cameras, %d points, rms %.4f px\n\n",
+             measure.num_cameras, measure.num_points, measure.rms);
+    } else {
+      printf("  reconstruction failed\n\n");
+    }
+  }
+  return 0;
+}
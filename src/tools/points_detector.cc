@@ -114,7 +114,7 @@ int main(int argc, char **argv) {
   }
 
 
-  DrawFeatures(*imageReference.AsArray3Du(), features);
+  DrawFeatures(*imageReference.MutableArray3Du(), features);
   if (!WritePng(*imageReference.AsArray3Du(), sImageOut.c_str())) {
     LOG(FATAL) << "Failed saving output image: " << sImageOut;
   }
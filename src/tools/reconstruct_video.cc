@@ -20,12 +20,17 @@
 #include <list>
 #include <string>
 
+#include "libmv/base/thread.h"
 #include "libmv/correspondence/import_matches_txt.h"
+#include "libmv/correspondence/matches_binary.h"
 #include "libmv/correspondence/tracker.h"
 #include "libmv/logging/logging.h"
 #include "libmv/reconstruction/euclidean_reconstruction.h"
 #include "libmv/reconstruction/export_blender.h"
 #include "libmv/reconstruction/export_ply.h"
+#include "libmv/reconstruction/reconstruction_checkpoint.h"
+#include "libmv/reconstruction/reconstruction_observer.h"
+#include "libmv/tools/tool.h"
 
 using namespace libmv;
 
@@ -43,6 +48,26 @@ DEFINE_double(u0, 0,
 DEFINE_double(v0, 0,
              "Principal point v coordinate (px)");
 
+DEFINE_int32(snapshot_period, 0,
+             "Export a Blender script of one intermediate reconstruction step "
+             "every snapshot_period steps, in the background (0: none)");
+
+DEFINE_int32(segment_size, 0,
+             "Reconstruct segments of segment_size keyframes in parallel and "
+             "merge them (0: reconstruct the keyframes sequentially)");
+DEFINE_int32(segment_overlap, 3,
+             "Keyframes shared by two consecutive segments");
+DEFINE_int32(threads, 1, "Threads reconstructing the segments and the "
+             "non-keyframes, and of the shared thread pool");
+DEFINE_string(checkpoint, "", "Save the state of the reconstruction to this "
+              "file, and resume from it if it exists (with the matches saved "
+              "beside it, instead of the input file)");
+DEFINE_int32(checkpoint_period, 10, "Keyframes between two checkpoints");
+DEFINE_bool(binary, false, "Export a binary PLY file, or a Blender script "
+            "loading the cameras and points from a binary .bin file");
+DEFINE_string(trace, "", "Write a Chrome trace event timeline of the "
+              "instrumented scopes to this file.");
+
 void GetFilePathExtention(const std::string &file, 
                           std::string *path_name, 
                           std::string *ext) {
@@ -64,14 +89,41 @@ int main (int argc, char *argv[]) {
   //usage += argv[0] + "<detector>";
   google::SetUsageMessage(usage);
   google::ParseCommandLineFlags(&argc, &argv, true);
+  libmv::SetNumThreads(FLAGS_threads);
+  libmv::StartTrace(FLAGS_trace);
 
   // Imports matches
   tracker::FeaturesGraph fg;
   FeatureSet *fs = fg.CreateNewFeatureSet();
   
-  VLOG(0) << "Loading Matches file..." << std::endl;
-  ImportMatchesFromTxt(FLAGS_i, &fg.matches_, fs);
-  VLOG(0) << "Loading Matches file...[DONE]." << std::endl;
+  ReconstructionCheckpointer *checkpointer = NULL;
+  if (!FLAGS_checkpoint.empty()) {
+    checkpointer = new ReconstructionCheckpointer(FLAGS_checkpoint,
+                                                  FLAGS_checkpoint_period);
+  }
+  if (checkpointer && checkpointer->Resume() &&
+      ImportMatchesFromBinary(checkpointer->MatchesFilename(),
+                              &fg.matches_, fs)) {
+    VLOG(0) << "Resuming from " << FLAGS_checkpoint << std::endl;
+  } else {
+    if (checkpointer && checkpointer->resumed()) {
+      // The checkpoint is useless without its matches.
+      delete checkpointer;
+      checkpointer = new ReconstructionCheckpointer(FLAGS_checkpoint,
+                                                    FLAGS_checkpoint_period);
+    }
+    VLOG(0) << "Loading Matches file..." << std::endl;
+    if (!ImportMatchesFromTxtParallel(FLAGS_i, &fg.matches_, fs,
+                                      FLAGS_threads)) {
+      LOG(ERROR) << "Cannot read the matches " << FLAGS_i;
+      delete checkpointer;
+      return 1;
+    }
+    VLOG(0) << "Loading Matches file...[DONE]." << std::endl;
+    if (checkpointer) {
+      ExportMatchesToBinary(fg.matches_, checkpointer->MatchesFilename());
+    }
+  }
   
   // Estimates the camera trajectory and 3D structure of the scene
   int w = FLAGS_w, h = FLAGS_h;
@@ -83,10 +135,28 @@ int main (int argc, char *argv[]) {
   // TODO(julien) put u and v as arguments of EuclideanReconstructionFromVideo
   VLOG(0) << "Euclidean Reconstruction From Video..." << std::endl;
   std::list<Reconstruction *> reconstructions;
-  EuclideanReconstructionFromVideo(fg.matches_, 
-                                   w, h,
-                                   FLAGS_f,
-                                   &reconstructions);
+  AsyncBlenderExportObserver *snapshots = NULL;
+  if (FLAGS_snapshot_period > 0) {
+    snapshots = new AsyncBlenderExportObserver("", FLAGS_snapshot_period);
+  }
+  if (FLAGS_segment_size > 0) {
+    EuclideanReconstructionFromVideoBySegments(fg.matches_,
+                                               w, h,
+                                               FLAGS_f,
+                                               &reconstructions,
+                                               FLAGS_segment_size,
+                                               FLAGS_segment_overlap,
+                                               FLAGS_threads, snapshots);
+  } else {
+    EuclideanReconstructionFromVideo(fg.matches_, 
+                                     w, h,
+                                     FLAGS_f,
+                                     &reconstructions,
+                                     FLAGS_threads, snapshots,
+                                     checkpointer);
+  }
+  delete snapshots;
+  delete checkpointer;
   VLOG(0) << "Euclidean Reconstruction From Video...[DONE]" << std::endl;
   
   // Exports the reconstructions
@@ -104,7 +174,10 @@ int main (int argc, char *argv[]) {
         s << file_path_name << "-" << i << ".ply";
       else
         s << FLAGS_o;
-      ExportToPLY(**iter, s.str());
+      if (FLAGS_binary)
+        ExportToBinaryPLY(**iter, s.str());
+      else
+        ExportToPLY(**iter, s.str());
     }
   } else  if (file_ext == "py") {    
     for (; iter != reconstructions.end(); ++iter) {
@@ -113,7 +186,10 @@ int main (int argc, char *argv[]) {
         s << file_path_name << "-" << i << ".py";
       else
         s << FLAGS_o;
-      ExportToBlenderScript(**iter, s.str());
+      if (FLAGS_binary)
+        ExportToCompactBlenderScript(**iter, s.str());
+      else
+        ExportToBlenderScript(**iter, s.str());
     }
   }
   VLOG(0) << "Exporting Reconstructions...[DONE]" << std::endl;
@@ -29,13 +29,21 @@
  * \note The empty spaces are filled with the images stabilized images and are 
  *       not  blended/smoothed.
  * 
- * TODO(julien) Support moving camera (using a "mean" H)
+ * With --streaming, the frames are decoded, warped and encoded by concurrent
+ * stages with bounded queues between them, and the motion is estimated as the
+ * frames go, so the first stabilized frames are written before the end of the
+ * shot is analysed. --smoothing_radius then follows a moving camera: each
+ * frame is warped to the camera path averaged over a sliding window of frames
+ * around it.
+ *
+ * TODO(julien) Support moving camera (using a "mean" H) without --streaming.
  */
 #include <algorithm>
 #include <string>
 #include <vector>
 
 #include "libmv/base/scoped_ptr.h"
+#include "libmv/base/thread.h"
 #include "libmv/correspondence/feature.h"
 #include "libmv/correspondence/import_matches_txt.h"
 #include "libmv/correspondence/matches.h"
@@ -47,10 +55,7 @@
 #include "libmv/image/image_transform_linear.h"
 #include "libmv/image/cached_image_sequence.h"
 #include "libmv/image/sample.h"
-#include "libmv/multiview/robust_affine.h"
-#include "libmv/multiview/robust_euclidean.h"
-#include "libmv/multiview/robust_homography.h"
-#include "libmv/multiview/robust_similarity.h"
+#include "libmv/multiview/robust_motion2d.h"
 #include "libmv/logging/logging.h"
 
 enum eGEOMETRIC_TRANSFORMATION  {
@@ -64,7 +69,17 @@ DEFINE_string(m, "matches.txt", "Matches input file");
 DEFINE_int32 (transformation, SIMILARITY, "Transformation type:\n\t 0: \
 Euclidean\n\t 1:Similarity\n\t 2:Affinity\n\t 3:Homography");
 DEFINE_bool(draw_lines, false, "Draw image bounds");
+DEFINE_int32(threads, 1, "Threads warping each image, and of the shared "
+             "thread pool");
              
+DEFINE_bool(streaming, false, "Decode, warp and encode the frames in "
+            "concurrent stages, estimating the motion as the frames go.");
+DEFINE_int32(queue_size, 4, "Frames buffered between the stages, with "
+             "--streaming.");
+DEFINE_int32(smoothing_radius, 0, "With --streaming, 0 stabilizes on the "
+             "first frame (fixed camera); r > 0 follows the camera path "
+             "averaged over the 2r + 1 frames around each frame.");
+
 DEFINE_string(of, "./",     "Output folder.");
 DEFINE_string(os, "_stab",  "Output file suffix.");
 
@@ -100,137 +115,29 @@ std::string ReplaceFolder(const std::string &s,
 }
 
 /**
- * Computes relative euclidean matrices
- *
- * \param matches The 2D features matches
- * \param Ss Vector of relative similarity matrices such that 
- *        $q2 = E1 q1$ and $qi = Ei-1 * ...* E1 q1$
- *        where qi is a point in the image i
- *        and q1 is its position in the image 1
- * \param outliers_prob The outliers probability [0, 1[
- * \param max_error_2d The maximun 2D error in pixel
- *
- * TODO(julien) put this in reconstruction
- */
-void ComputeRelativeEuclideanMatrices(const Matches &matches,
-                                      vector<Mat3> *Es,
-                                      double outliers_prob = 1e-2,
-                                      double max_error_2d = 1) {
-  Es->reserve(matches.NumImages() - 1);
-  Mat3 E;
-  vector<Mat> xs2;
-  std::set<Matches::ImageID>::const_iterator image_iter =
-    matches.get_images().begin();
-  std::set<Matches::ImageID>::const_iterator prev_image_iter = image_iter;
-  image_iter++;
-  for (;image_iter != matches.get_images().end(); ++image_iter) {
-    TwoViewPointMatchMatrices(matches, *prev_image_iter, *image_iter, &xs2);
-      if (xs2[0].cols() >= 2) {
-        Euclidean2DFromCorrespondences2PointRobust(xs2[0], xs2[1], 
-                                                   max_error_2d , 
-                                                   &E, NULL, 
-                                                   outliers_prob);
-        Es->push_back(E);
-        VLOG(2) << "E = " << std::endl << E << std::endl;
-      } // TODO(julien) what to do when no enough points?
-    ++prev_image_iter;
-  }
-}
-
-/**
- * Computes relative similarity matrices
+ * Computes relative matrices
  *
  * \param matches The 2D features matches
- * \param Ss Vector of relative similarity matrices such that 
- *        $q2 = S1 q1$ and $qi = Si-1 * ...* S1 q1$
- *        where qi is a point in the image i
- *        and q1 is its position in the image 1
- * \param outliers_prob The outliers probability [0, 1[
- * \param max_error_2d The maximun 2D error in pixel
- *
- * TODO(julien) put this in reconstruction
- */
-void ComputeRelativeSimilarityMatrices(const Matches &matches,
-                                       vector<Mat3> *Ss,
-                                       double outliers_prob = 1e-2,
-                                       double max_error_2d = 1) {
-  Ss->reserve(matches.NumImages() - 1);
-  Mat3 S;
-  vector<Mat> xs2;
-  std::set<Matches::ImageID>::const_iterator image_iter =
-    matches.get_images().begin();
-  std::set<Matches::ImageID>::const_iterator prev_image_iter = image_iter;
-  image_iter++;
-  for (;image_iter != matches.get_images().end(); ++image_iter) {
-    TwoViewPointMatchMatrices(matches, *prev_image_iter, *image_iter, &xs2);
-      if (xs2[0].cols() >= 2) {
-        Similarity2DFromCorrespondences2PointRobust(xs2[0], xs2[1], 
-                                                    max_error_2d , 
-                                                    &S, NULL, 
-                                                    outliers_prob);
-        Ss->push_back(S);
-        VLOG(2) << "S = " << std::endl << S << std::endl;
-      } // TODO(julien) what to do when no enough points?
-    ++prev_image_iter;
-  }
-}
-
-/**
- * Computes relative affine matrices
- *
- * \param matches The 2D features matches
- * \param As A vector of relative affine matrices such that 
- *        $q2 = A1 q1$ and $qi = Ai-1 * ...* A1 q1$
- *        where qi is a point in the image i
- *        and q1 is its position in the image 1
- * \param outliers_prob The outliers probability [0, 1[
- * \param max_error_2d The maximun 2D error in pixel
- *
- * TODO(julien) put this in reconstruction
- */
-void ComputeRelativeAffineMatrices(const Matches &matches,
-                                   vector<Mat3> *As,
-                                   double outliers_prob = 1e-2,
-                                   double max_error_2d = 1) {
-  As->reserve(matches.NumImages() - 1);
-  Mat3 A;
-  vector<Mat> xs2;
-  std::set<Matches::ImageID>::const_iterator image_iter =
-    matches.get_images().begin();
-  std::set<Matches::ImageID>::const_iterator prev_image_iter = image_iter;
-  image_iter++;
-  for (;image_iter != matches.get_images().end(); ++image_iter) {
-    TwoViewPointMatchMatrices(matches, *prev_image_iter, *image_iter, &xs2);
-      if (xs2[0].cols() >= 3) {
-        Affine2DFromCorrespondences3PointRobust(xs2[0], xs2[1], 
-                                                max_error_2d , 
-                                                &A, NULL, 
-                                                outliers_prob);
-        As->push_back(A);
-        VLOG(2) << "A = " << std::endl << A << std::endl;
-      } // TODO(julien) what to do when no enough points?
-    ++prev_image_iter;
-  }
-}
-
-/**
- * Computes relative homography matrices
- *
- * \param matches The 2D features matches
- * \param Hs A vector of relative homography matrices such that 
+ * \param model The motion model
+ * \param Hs A vector of relative matrices such that
  *        $q2 = H1 q1$ and $qi = Hi-1 * ...* H1 q1$
  *        where qi is a point in the image i
  *        and q1 is its position in the image 1
  * \param outliers_prob The outliers probability [0, 1[
  * \param max_error_2d The maximun 2D error in pixel
  *
+ * Each estimation is warm started from the previous one, see
+ * Motion2DEstimator.
+ *
  * TODO(julien) Put this in reconstruction
  */
-void ComputeRelativeHomographyMatrices(const Matches &matches,
-                                       vector<Mat3> *Hs,
-                                       double outliers_prob = 1e-2,
-                                       double max_error_2d = 1) {
+void ComputeRelativeMatrices(const Matches &matches,
+                             Motion2DEstimator::MotionModel model,
+                             vector<Mat3> *Hs,
+                             double outliers_prob = 1e-2,
+                             double max_error_2d = 1) {
   Hs->reserve(matches.NumImages() - 1);
+  Motion2DEstimator estimator(model, max_error_2d, outliers_prob);
   Mat3 H;
   vector<Mat> xs2;
   std::set<Matches::ImageID>::const_iterator image_iter =
@@ -239,18 +146,42 @@ void ComputeRelativeHomographyMatrices(const Matches &matches,
   image_iter++;
   for (;image_iter != matches.get_images().end(); ++image_iter) {
     TwoViewPointMatchMatrices(matches, *prev_image_iter, *image_iter, &xs2);
-      if (xs2[0].cols() >= 4) {
-        Homography2DFromCorrespondences4PointRobust(xs2[0], xs2[1], 
-                                                    max_error_2d, 
-                                                    &H, NULL, 
-                                                    outliers_prob);
+      if (xs2[0].cols() >= estimator.MinimumSamples()) {
+        estimator.Estimate(xs2[0], xs2[1], &H);
         Hs->push_back(H);
         VLOG(2) << "H = " << std::endl << H << std::endl;
-      } // TODO(julien) what to do when no enough points?
+        VLOG(2) << "Warm started: " << estimator.warm_started();
+      } else {
+        // TODO(julien) what to do when no enough points?
+        estimator.Reset();
+      }
     ++prev_image_iter;
   }
 }
 
+// The file the stabilized version of image_file is written to.
+std::string OutputFilename(const std::string &image_file) {
+  std::stringstream s;
+  s << ReplaceFolder(image_file.substr(0, image_file.rfind(".")), FLAGS_of);
+  s << FLAGS_os;
+  s << image_file.substr(image_file.rfind("."), image_file.size());
+  return s.str();
+}
+
+void DrawImageBounds(const Vec2u &images_size, FloatImage *image) {
+  float lines_color[3] = {1, 1, 1};
+  DrawLine<FloatImage, float[3]>(0, 0, 0, images_size(1) - 1,
+                                 lines_color, image);
+  DrawLine<FloatImage, float[3]>(0, 0, images_size(0) - 1, 0,
+                                 lines_color, image);
+  DrawLine<FloatImage, float[3]>(               0, images_size(1)-1,
+                                 images_size(0)-1, images_size(1)-1,
+                                 lines_color, image);
+  DrawLine<FloatImage, float[3]>(images_size(0)-1,                0,
+                                 images_size(0)-1, images_size(1)-1,
+                                 lines_color, image);
+}
+
 /**
  * Stabilize a list of images.
  * 
@@ -278,7 +209,6 @@ void Stabilize(const std::vector<std::string> &image_files,
                         imageArrayBytes.Width(), 
                         imageArrayBytes.Depth());
   image_stab.Fill(0);
-  float lines_color[3] = {1, 1, 1};
   FloatImage *image = NULL;
   ImageCache cache;
   scoped_ptr<ImageSequence> source(ImageSequenceFromFiles(image_files, &cache));
@@ -289,32 +219,192 @@ void Stabilize(const std::vector<std::string> &image_files,
     if (image) {
       //VLOG(1) << "H = \n" << H << "\n";
       if (draw_lines) {
-        DrawLine<FloatImage, float[3]>(0, 0, 0, images_size(1) - 1, 
-                                       lines_color, image);
-        DrawLine<FloatImage, float[3]>(0, 0, images_size(0) - 1, 0, 
-                                       lines_color, image);
-        DrawLine<FloatImage, float[3]>(               0, images_size(1)-1, 
-                                       images_size(0)-1, images_size(1)-1, 
-                                       lines_color, image);
-        DrawLine<FloatImage, float[3]>(images_size(0)-1,                0, 
-                                       images_size(0)-1, images_size(1)-1, 
-                                       lines_color, image); 
-      }        
-      WarpImage(*image, H, &image_stab);
+        DrawImageBounds(images_size, image);
+      }
+      WarpImage(*image, H, &image_stab, false, FLAGS_threads);
       
       // Saves the stabilized image
-      std::stringstream s;
-      s << ReplaceFolder(image_files[i].substr(0, image_files[i].rfind(".")), 
-                         FLAGS_of);
-      s << FLAGS_os;
-      s << image_files[i].substr(image_files[i].rfind("."), 
-                                 image_files[i].size());
-      WriteImage(image_stab, s.str().c_str());
+      WriteImage(image_stab, OutputFilename(image_files[i]).c_str());
     }
     source->Unpin(i);
   }
 }
 
+/**
+ * Estimates the camera path of the streaming stabilization frame by frame,
+ * only as far as it is asked for.
+ *
+ * Path(i) maps the points of the first image to image i, as the product of
+ * the relative matrices of ComputeRelativeMatrices(); the frames without
+ * enough matches to the previous one are assumed not to move.
+ */
+class StreamingPath {
+ public:
+  StreamingPath(const Matches &matches,
+                Motion2DEstimator::MotionModel model,
+                double outliers_prob = 1e-2,
+                double max_error_2d = 1)
+      : matches_(matches),
+        estimator_(model, max_error_2d, outliers_prob),
+        image_(matches.get_images().begin()) {
+    path_.push_back(Mat3::Identity());
+  }
+
+  const Mat3 &Path(int i) {
+    while (path_.size() <= static_cast<size_t>(i)) {
+      Mat3 H = Mat3::Identity();
+      std::set<Matches::ImageID>::const_iterator previous = image_;
+      if (image_ != matches_.get_images().end() &&
+          ++image_ != matches_.get_images().end()) {
+        TwoViewPointMatchMatrices(matches_, *previous, *image_, &xs2_);
+        if (xs2_[0].cols() >= estimator_.MinimumSamples()) {
+          estimator_.Estimate(xs2_[0], xs2_[1], &H);
+          VLOG(2) << "H = " << std::endl << H << std::endl;
+        } else {
+          estimator_.Reset();
+        }
+      }
+      path_.push_back(H * path_.back());
+    }
+    return path_[i];
+  }
+
+ private:
+  const Matches &matches_;
+  Motion2DEstimator estimator_;
+  std::set<Matches::ImageID>::const_iterator image_;
+  vector<Mat> xs2_;
+  std::vector<Mat3> path_;
+};
+
+// The warp of frame i of num_frames. The matrices of the path are normalized
+// before they are averaged over the window.
+Mat3 StreamingWarp(StreamingPath *path, int i, int num_frames, int radius) {
+  Mat3 inverse = path->Path(i).inverse();
+  if (radius <= 0) {
+    return inverse;
+  }
+  Mat3 smoothed = Mat3::Zero();
+  int begin = std::max(0, i - radius);
+  int end = std::min(num_frames, i + radius + 1);
+  for (int j = begin; j < end; ++j) {
+    const Mat3 &P = path->Path(j);
+    smoothed += P / P(2, 2);
+  }
+  return smoothed / (end - begin) * inverse;
+}
+
+// A frame passed between the stages of StabilizeStreaming(). A null image is
+// a frame that could not be read.
+struct Frame {
+  int index;
+  FloatImage *image;
+};
+
+struct DecodeStage {
+  static void *Entry(void *self) {
+    DecodeStage *stage = static_cast<DecodeStage *>(self);
+    for (int i = 0; i < stage->files->size(); ++i) {
+      Frame frame;
+      frame.index = i;
+      frame.image = new FloatImage;
+      if (!ReadImage((*stage->files)[i].c_str(), frame.image)) {
+        LOG(ERROR) << "Can't read " << (*stage->files)[i];
+        delete frame.image;
+        frame.image = NULL;
+      }
+      if (!stage->output->Push(frame)) {
+        delete frame.image;
+        break;
+      }
+    }
+    stage->output->Close();
+    return NULL;
+  }
+  const std::vector<std::string> *files;
+  BoundedQueue<Frame> *output;
+};
+
+struct EncodeStage {
+  static void *Entry(void *self) {
+    EncodeStage *stage = static_cast<EncodeStage *>(self);
+    Frame frame;
+    while (stage->input->Pop(&frame)) {
+      std::string filename = OutputFilename((*stage->files)[frame.index]);
+      if (!WriteImage(*frame.image, filename.c_str())) {
+        LOG(ERROR) << "Can't write " << filename;
+      }
+      delete frame.image;
+    }
+    return NULL;
+  }
+  const std::vector<std::string> *files;
+  BoundedQueue<Frame> *input;
+};
+
+/**
+ * Same as Stabilize(), with the decoding and the encoding of the images on
+ * their own threads, at most FLAGS_queue_size frames ahead of or behind the
+ * warp, which runs on the calling thread with FLAGS_threads threads. The
+ * relative matrices are estimated when a frame needs them, and with a
+ * smoothing radius r frame i is written once frame i + r is estimated.
+ */
+void StabilizeStreaming(const std::vector<std::string> &image_files,
+                        StreamingPath *path,
+                        int smoothing_radius,
+                        bool draw_lines) {
+  BoundedQueue<Frame> decoded(FLAGS_queue_size);
+  BoundedQueue<Frame> warped(FLAGS_queue_size);
+  DecodeStage decode;
+  decode.files = &image_files;
+  decode.output = &decoded;
+  EncodeStage encode;
+  encode.files = &image_files;
+  encode.input = &warped;
+  pthread_t decoder, encoder;
+  if (pthread_create(&decoder, NULL, &DecodeStage::Entry, &decode) != 0) {
+    LOG(ERROR) << "Can't start the decoding thread.";
+    return;
+  }
+  if (pthread_create(&encoder, NULL, &EncodeStage::Entry, &encode) != 0) {
+    LOG(ERROR) << "Can't start the encoding thread.";
+    decoded.Close();
+    pthread_join(decoder, NULL);
+    return;
+  }
+
+  // The stabilized images keep the parts of the previous ones that the
+  // current one does not cover, as in Stabilize().
+  FloatImage image_stab;
+  Vec2u images_size;
+  Frame frame;
+  while (decoded.Pop(&frame)) {
+    if (!frame.image) {
+      continue;
+    }
+    if (image_stab.Size() == 0) {
+      images_size << frame.image->Width(), frame.image->Height();
+      image_stab.Resize(frame.image->Height(), frame.image->Width(),
+                        frame.image->Depth());
+      image_stab.Fill(0);
+    }
+    Mat3 H = StreamingWarp(path, frame.index, image_files.size(),
+                           smoothing_radius);
+    if (draw_lines) {
+      DrawImageBounds(images_size, frame.image);
+    }
+    WarpImage(*frame.image, H, &image_stab, false, FLAGS_threads);
+    delete frame.image;
+    frame.image = new FloatImage(image_stab);
+    if (!warped.Push(frame)) {
+      delete frame.image;
+    }
+  }
+  warped.Close();
+  pthread_join(decoder, NULL);
+  pthread_join(encoder, NULL);
+}
+
 int main(int argc, char **argv) {
 
   std::string usage ="Stabilize a video.\n";
@@ -323,6 +413,7 @@ int main(int argc, char **argv) {
   usage += "\t - IMAGEX is an input image {PNG, PNM, JPEG}\n";
   google::SetUsageMessage(usage);
   google::ParseCommandLineFlags(&argc, &argv, true);
+  libmv::SetNumThreads(FLAGS_threads);
 
   // This is not the place for this. I am experimenting with what sort of API
   // will be convenient for the tracking base classes.
@@ -338,21 +429,42 @@ int main(int argc, char **argv) {
   ImportMatchesFromTxt(FLAGS_m, &fg.matches_, fs);
   VLOG(0) << "Loading Matches file...[DONE]." << std::endl;
     
+  if (FLAGS_streaming) {
+    Motion2DEstimator::MotionModel models[] = {
+      Motion2DEstimator::EUCLIDEAN,
+      Motion2DEstimator::SIMILARITY,
+      Motion2DEstimator::AFFINE,
+      Motion2DEstimator::HOMOGRAPHY,
+    };
+    if (FLAGS_transformation < EUCLIDEAN || FLAGS_transformation > HOMOGRAPHY) {
+      LOG(ERROR) << "Unknown transformation " << FLAGS_transformation;
+      fg.DeleteAndClear();
+      return 1;
+    }
+    StreamingPath path(fg.matches_, models[FLAGS_transformation]);
+    VLOG(0) << "Stabilizing images..." << std::endl;
+    StabilizeStreaming(files, &path, FLAGS_smoothing_radius,
+                       FLAGS_draw_lines);
+    VLOG(0) << "Stabilizing images...[DONE]." << std::endl;
+    fg.DeleteAndClear();
+    return 0;
+  }
+
   vector<Mat3> Hs;
   VLOG(0) << "Estimating relative matrices..." << std::endl;
   switch (FLAGS_transformation) {
     // TODO(julien) add custom degree of freedom selection (e.g. x, y, x & y, ...)
     case EUCLIDEAN:
-      ComputeRelativeEuclideanMatrices(fg.matches_, &Hs);
+      ComputeRelativeMatrices(fg.matches_, Motion2DEstimator::EUCLIDEAN, &Hs);
     break;
     case SIMILARITY:
-      ComputeRelativeSimilarityMatrices(fg.matches_, &Hs);
+      ComputeRelativeMatrices(fg.matches_, Motion2DEstimator::SIMILARITY, &Hs);
     break;
     case AFFINE:
-      ComputeRelativeAffineMatrices(fg.matches_, &Hs);
+      ComputeRelativeMatrices(fg.matches_, Motion2DEstimator::AFFINE, &Hs);
     break;
     case HOMOGRAPHY:
-      ComputeRelativeHomographyMatrices(fg.matches_, &Hs);
+      ComputeRelativeMatrices(fg.matches_, Motion2DEstimator::HOMOGRAPHY, &Hs);
     break;
   }
   VLOG(0) << "Estimating relative matrices...[DONE]." << std::endl;
@@ -19,24 +19,38 @@
 // IN THE SOFTWARE.
 
 #include <algorithm>
+#include <iterator>
 #include <string>
 #include <vector>
 
+#include "libmv/base/memory_budget.h"
 #include "libmv/base/scoped_ptr.h"
-#include "libmv/correspondence/matches.h"
 #include "libmv/correspondence/feature.h"
 #include "libmv/correspondence/klt.h"
+#include "libmv/correspondence/matches_binary.h"
 #include "libmv/image/image.h"
 #include "libmv/image/image_io.h"
 #include "libmv/image/image_pyramid.h"
 #include "libmv/image/image_sequence_io.h"
 #include "libmv/image/cached_image_sequence.h"
-#include "libmv/image/pyramid_sequence.h"
+#include "libmv/image/video_sequence.h"
+#include "libmv/logging/logging.h"
 #include "third_party/gflags/gflags.h"
 
 DEFINE_bool(debug_images, true, "Output debug images.");
 DEFINE_double(sigma, 0.9, "Blur filter strength.");
 DEFINE_int32(pyramid_levels, 4, "Number of levels in the image pyramid.");
+DEFINE_int32(memory_budget_mb, 0, "Budget of the memory accounted by the "
+             "caches, pyramids, tracks and bundle adjusters; 0 is no budget.");
+DEFINE_string(o, "tracks.bin", "Binary matches output file, written as the "
+              "frames are tracked; nothing is written if empty.");
+DEFINE_double(replenish_ratio, 0.5, "New features are detected where there "
+              "are none when fewer than this ratio of the features of the "
+              "first frame are still tracked.");
+DEFINE_int32(threads, 1, "Threads tracking the features.");
+DEFINE_double(max_forward_backward_error, 0, "Features that do not track "
+              "back to within this many pixels of where they started are "
+              "dropped; 0 disables the check.");
 
 using namespace libmv;
 
@@ -44,7 +58,7 @@ using std::sort;
 using std::string;
 
 void WriteOutputImage(const FloatImage &image,
-                      Matches::Points features,
+                      const KLTContext::FeatureArray &features,
                       const char *output_filename) {
   FloatImage output_image(image.Height(), image.Width(), 3);
   for (int i = 0; i < image.Height(); ++i) {
@@ -57,16 +71,43 @@ void WriteOutputImage(const FloatImage &image,
 
   Vec3 green;
   green << 0, 1, 0;
-  for (; features; ++features) {
-    DrawFeature(*features.feature(), green, &output_image);
+  for (size_t i = 0; i < features.size(); ++i) {
+    DrawFeature(features[i], green, &output_image);
   }
 
   WritePnm(output_image, output_filename);
 }
 
+// Appends the features that detect adds to the live features to features,
+// with new track ids. detect is DetectGoodFeatures() or
+// ReplenishGoodFeatures(); the features it allocates are only used to carry
+// the new positions, so the live features stay in contiguous arrays.
+template <typename Detect>
+void AddGoodFeatures(KLTContext *klt,
+                     Detect detect,
+                     const Array3Df &image_and_gradients,
+                     KLTContext::FeatureArray *features,
+                     std::vector<int> *tracks,
+                     int *num_tracks) {
+  KLTContext::FeatureList list;
+  for (size_t i = 0; i < features->size(); ++i) {
+    list.push_back(&(*features)[i]);
+  }
+  const size_t num_live = features->size();
+  (klt->*detect)(image_and_gradients, &list);
+  KLTContext::FeatureList::iterator it = list.begin();
+  std::advance(it, num_live);
+  for (; it != list.end(); ++it) {
+    features->push_back(**it);
+    tracks->push_back((*num_tracks)++);
+    delete *it;
+  }
+}
+
 int main(int argc, char **argv) {
   google::SetUsageMessage("Track a sequence.");
   google::ParseCommandLineFlags(&argc, &argv, true);
+  SetMemoryBudget(FLAGS_memory_budget_mb * 1048576LL);
 
   // This is not the place for this. I am experimenting with what sort of API
   // will be convenient for the tracking base classes.
@@ -75,63 +116,106 @@ int main(int argc, char **argv) {
     files.push_back(argv[i]);
   }
   sort(files.begin(), files.end());
+  bool video = files.size() == 1 && IsVideoFile(files[0]);
 
-  if (files.size() < 2) {
+  if (files.size() < 2 && !video) {
     printf("Not enough files.\n");
     return 1;
   }
 
-  ImageCache cache;
-  scoped_ptr<ImageSequence> source(ImageSequenceFromFiles(files, &cache));
-  PyramidSequence *pyramid_sequence =
-      MakePyramidSequence(source.get(), FLAGS_pyramid_levels, FLAGS_sigma);
-
-  KLTContext klt;
-  Matches matches;
-
-  scoped_ptr<ImagePyramid> pyramid(pyramid_sequence->Pyramid(0));
-  KLTContext::FeatureList features;
-  klt.DetectGoodFeatures(pyramid->Level(0), &features);
-  int i = 0;
-  for (KLTContext::FeatureList::iterator it = features.begin();
-       it != features.end(); ++it, ++i) {
-    matches.Insert(0, i, *it);
+  MatchesBinaryWriter writer;
+  if (!FLAGS_o.empty() && !writer.Open(FLAGS_o)) {
+    return 1;
   }
 
-  if (FLAGS_debug_images) {
-    WriteOutputImage(
-        pyramid_sequence->Pyramid(0)->Level(0),
-        matches.InImage<PointFeature>(0),
-        (files[0]+".out.ppm").c_str());
+  ImageCache cache;
+  scoped_ptr<ImageSequence> source(ImageSequenceFromPaths(files, &cache));
+  if (!source.get()) {
+    return 1;
+  }
+  // The frames of a video are named after it.
+  if (video) {
+    char name[32];
+    string filename = files[0];
+    files.clear();
+    for (int i = 0; i < source->Length(); ++i) {
+      snprintf(name, sizeof(name), ".%05d", i);
+      files.push_back(filename + name);
+    }
   }
-  for (size_t i = 1; i < files.size(); ++i) {
-    printf("Tracking %2zd features in %s\n", features.size(), files[i].c_str());
-
-    for (Matches::Features<KLTPointFeature> r =
-         matches.InImage<KLTPointFeature>(i-1); r; ++r) {
-      KLTPointFeature *next_position = new KLTPointFeature;
-      if (klt.TrackFeature(pyramid_sequence->Pyramid(i-1), *r.feature(),
-                           pyramid_sequence->Pyramid(i), next_position)) {
-        matches.Insert(i, r.track(), next_position);
-      } else {
-        delete next_position;
+  KLTContext klt;
+  klt.SetNumThreads(FLAGS_threads);
+  klt.SetMaxForwardBackwardError(FLAGS_max_forward_backward_error);
+
+  // Only frames i - 1 and i are resident: their pyramids, and their features
+  // with the track of each slot. The arrays are swapped every frame, so their
+  // storage is reused once the number of features settled.
+  scoped_ptr<ImagePyramid> previous_pyramid(NULL), pyramid(NULL);
+  KLTContext::FeatureArray previous_features, features;
+  std::vector<int> previous_tracks, tracks, tracked;
+  int num_tracks = 0;
+  size_t min_features = 0;
+  for (size_t i = 0; i < files.size(); ++i) {
+    FloatImage *image = source->GetFloatImage(i);
+    if (!image) {
+      LOG(ERROR) << "Cannot read " << files[i];
+      return 1;
+    }
+    // The pyramid of frame i - 2 is rebuilt in place, so that the two
+    // pyramids are only allocated once (not with a backend).
+    if (!pyramid.get() || !RebuildImagePyramid(*image, FLAGS_pyramid_levels,
+                                               FLAGS_sigma, pyramid.get())) {
+      pyramid.reset(klt.MakeImagePyramid(*image, FLAGS_pyramid_levels,
+                                         FLAGS_sigma));
+    }
+    source->Unpin(i);
+
+    if (i == 0) {
+      AddGoodFeatures(&klt, &KLTContext::DetectGoodFeatures,
+                      pyramid->Level(0), &features, &tracks, &num_tracks);
+      min_features = FLAGS_replenish_ratio * features.size();
+    } else {
+      printf("Tracking %2zd features in %s\n", previous_features.size(),
+             files[i].c_str());
+      klt.TrackFeatures(previous_pyramid.get(), previous_features,
+                        pyramid.get(), &features, &tracked);
+      // Drop the lost features, keeping the others sorted by track.
+      tracks.resize(previous_tracks.size());
+      size_t num_live = 0;
+      for (size_t j = 0; j < features.size(); ++j) {
+        if (tracked[j]) {
+          features[num_live] = features[j];
+          tracks[num_live] = previous_tracks[j];
+          num_live++;
+        }
+      }
+      features.resize(num_live);
+      tracks.resize(num_live);
+      if (features.size() < min_features) {
+        AddGoodFeatures(&klt, &KLTContext::ReplenishGoodFeatures,
+                        pyramid->Level(0), &features, &tracks, &num_tracks);
       }
     }
 
+    if (writer.IsOpen()) {
+      for (size_t j = 0; j < features.size(); ++j) {
+        writer.Add(i, tracks[j], features[j].x(), features[j].y());
+      }
+    }
     if (FLAGS_debug_images) {
-      WriteOutputImage(
-          pyramid_sequence->Pyramid(i)->Level(0),
-          matches.InImage<PointFeature>(i),
-          (files[i]+".out.ppm").c_str());
+      WriteOutputImage(pyramid->Level(0), features,
+                       (files[i]+".out.ppm").c_str());
     }
+    previous_features.swap(features);
+    previous_tracks.swap(tracks);
+    ImagePyramid *recycled = previous_pyramid.release();
+    previous_pyramid.reset(pyramid.release());
+    pyramid.reset(recycled);
   }
 
-  // XXX
-  // TODO(keir): Now do something useful with 'correspondences'!
-  // XXX
-  //
-  printf( "\n %2d tracks found\n", (int)matches.NumTracks());
+  if (writer.IsOpen() && !writer.Close()) {
+    return 1;
+  }
+  printf( "\n %2d tracks found\n", num_tracks);
   return 0;
 }
-
-
@@ -61,7 +61,8 @@
 
 using namespace libmv;
 
-DEFINE_string(detector, "FAST", "select the detector (FAST,STAR,SURF,MSER)");
+DEFINE_string(detector, "FAST",
+              "select the detector (FAST,FAST_PYRAMID,STAR,CENSURE,SURF,MSER)");
 DEFINE_string(describer, "DAISY",
               "select the descriptor (SIMPLIEST,SURF,DIPOLE,DAISY)");
 DEFINE_bool  (save_features, false,
@@ -86,6 +87,8 @@ DEFINE_double(principal_point_v, 0,
               "principal point v coordinate");
 
 DEFINE_string(o, "matches.txt", "Matches output file");
+DEFINE_string(trace, "", "Write a Chrome trace event timeline of the "
+              "instrumented scopes to this file.");
 
 void DrawFeatures(ByteImage &imageArrayBytes,
                   Matches::Features<PointFeature> &features,
@@ -265,6 +268,7 @@ int main (int argc, char *argv[]) {
   //usage += argv[0] + "<detector>";
   google::SetUsageMessage(usage);
   google::ParseCommandLineFlags(&argc, &argv, true);
+  libmv::StartTrace(FLAGS_trace);
 
   std::list<std::string> image_list;
   vector<std::pair<size_t, size_t> > image_sizes;
@@ -287,8 +291,10 @@ int main (int argc, char *argv[]) {
   detector::eDetector edetector = detector::FAST_DETECTOR;
   std::map<std::string, detector::eDetector> detectorMap;
   detectorMap["FAST"] = detector::FAST_DETECTOR;
+  detectorMap["FAST_PYRAMID"] = detector::FAST_PYRAMID_DETECTOR;
   detectorMap["SURF"] = detector::SURF_DETECTOR;
   detectorMap["STAR"] = detector::STAR_DETECTOR;
+  detectorMap["CENSURE"] = detector::CENSURE_DETECTOR;
   detectorMap["MSER"] = detector::MSER_DETECTOR;
   if (detectorMap.find(FLAGS_detector) != detectorMap.end()) {
     edetector = detectorMap[FLAGS_detector];
@@ -23,7 +23,9 @@
 // (up to 2 coef).
 // Undistorted images are saved in the same location as input images, with a
 // suffix "_undist" placed at the end of the file name.
-// Note: All images must have the same size.
+// Note: All images must have the same size. The undistortion map is computed
+// once, and the images are undistorted with --threads threads; with
+// --look_ahead the reading, undistortion and writing of the images overlap.
 // 
 // We use the Brown's distortion model
 // Variables:
@@ -56,7 +58,7 @@
 #include "libmv/image/image.h"
 #include "libmv/image/image_io.h"
 #include "libmv/image/image_sequence_io.h"
-#include "libmv/image/sample.h"
+#include "libmv/image/pipelined_sequence.h"
 #include "libmv/logging/logging.h"
 
 DEFINE_double(k1, 0,  "Radial distortion coefficient k1 (Brown's model)");
@@ -77,6 +79,11 @@ DEFINE_double(sk, 0,  "Skew factor");
 DEFINE_string(of, "",         "Output folder.");
 DEFINE_string(os, "_undist",  "Output file suffix.");
 
+DEFINE_int32(threads, 1, "Threads undistorting each image.");
+DEFINE_int32(look_ahead, 0, "Images read and undistorted ahead on worker "
+             "threads while the current one is written (0: one at a time).");
+DEFINE_int32(cache_mb, 256, "Size of the image cache with --look_ahead.");
+
 using namespace libmv;
 
 /// TODO(julien) Put this somewhere else...
@@ -124,7 +131,7 @@ int main(int argc, char **argv) {
     files.push_back(argv[i]);
   }
   
-  LensDistortion lens_distortion;
+  LensDistortionField lens_distortion;
   if (FLAGS_k5 == 0) {
     if (FLAGS_k4 == 0) {
       if (FLAGS_k3 == 0) {
@@ -167,86 +174,67 @@ int main(int argc, char **argv) {
           << lens_distortion.tangential_distortion().transpose() << std::endl;
   
   PinholeCameraDistortion camera(&lens_distortion);
-  FloatImage *image = NULL;
-  FloatImage *image_out = NULL;
-  ImageCache cache;
-  Vec2u size_image;
-  Vec2 q;
-  Mat qs_x(0, 0);
-  Mat qs_y(0, 0);
-  
+  const bool pipelined = FLAGS_look_ahead > 0;
+  ImageCache cache(pipelined ? FLAGS_cache_mb * 1048576LL : 10*1024*1024,
+                   pipelined ? ImageCache::THREAD_SAFE :
+                               ImageCache::SINGLE_THREADED);
   scoped_ptr<ImageSequence> source(ImageSequenceFromFiles(files, &cache));
+
+  // The undistortion map is computed once, for the size of the first image.
+  FloatImage *image = source->GetFloatImage(0);
+  if (!image) {
+    LOG(ERROR) << "Cannot read " << files[0];
+    return 1;
+  }
+  VLOG(0) << "Estimating undistortion map..." << std::endl;
+  Vec2u size_image;
+  size_image << image->Width(), image->Height();
+  source->Unpin(0);
+  camera.set_image_size(size_image);
+  Mat3 K;
+  if (FLAGS_u0 == 0)
+    FLAGS_u0 = size_image(0) / 2 - 0.5;
+  if (FLAGS_v0 == 0)
+    FLAGS_v0 = size_image(1) / 2 - 0.5;
+  if (FLAGS_fy == 0)
+    FLAGS_fy = FLAGS_fx;
+  K << FLAGS_fx, FLAGS_sk, FLAGS_u0,
+              0, FLAGS_fy, FLAGS_v0,
+              0,        0,        1;
+  camera.set_intrinsic_matrix(K);
+  lens_distortion.ComputeDistortionMap(camera);
+  VLOG(0) << "Estimating undistortion map...[DONE]." << std::endl;
+
+  // With a look ahead, the next images are decoded and undistorted on the
+  // worker threads of the pipeline stages while this one writes the current
+  // image.
+  scoped_ptr<ImageSequence> decoded(NULL);
+  ImageSequence *frames = source.get();
+  if (pipelined) {
+    decoded.reset(PipelineSequence(frames, FLAGS_look_ahead));
+    frames = decoded.get();
+  }
+  scoped_ptr<ImageSequence> undistorted(
+      UndistortSequence(frames, &lens_distortion, FLAGS_threads));
+  scoped_ptr<ImageSequence> output(NULL);
+  frames = undistorted.get();
+  if (pipelined) {
+    output.reset(PipelineSequence(frames, FLAGS_look_ahead));
+    frames = output.get();
+  }
+
   for (size_t i = 0; i < files.size(); ++i) {
-    image = source->GetFloatImage(i);
+    image = frames->GetFloatImage(i);
     if (image) {
-      if (qs_x.cols() == 0) {
-        VLOG(0) << "Estimating undistortion map..." << std::endl;
-        size_image << image->Width(), image->Height();
-        image_out = new FloatImage(image->Height(),
-                                   image->Width(),
-                                   image->Depth());
-        image_out->fill(0);
-        if (!image_out)
-          return 1;
-        camera.set_image_size(size_image);
-        Mat3 K;
-        if (FLAGS_u0 == 0)
-          FLAGS_u0 = size_image(0) / 2 - 0.5;
-        if (FLAGS_v0 == 0)
-          FLAGS_v0 = size_image(1) / 2 - 0.5;
-        if (FLAGS_fy == 0)
-          FLAGS_fy = FLAGS_fx;
-        K << FLAGS_fx, FLAGS_sk, FLAGS_u0,
-                    0, FLAGS_fy, FLAGS_v0,
-                    0,        0,        1;
-        camera.set_intrinsic_matrix(K);
-        qs_x.resize(image->Height(), image->Width());
-        qs_y.resize(image->Height(), image->Width());
-        qs_x.fill(-1);
-        qs_y.fill(-1);
-        // TODO(julien) Put this map building in lens_distortion
-        for (size_t x = 0; x < image->Width(); ++x) 
-          for (size_t y = 0; y < image->Height(); ++y) {
-            q << x, y;
-            camera.ComputeUndistortedCoordinates(q, &q);
-            if (image->Contains(q(1), q(0))) {
-              qs_x(y, x) = q(0);
-              qs_y(y, x) = q(1);
-              for (int d = 0; d < image_out->Depth(); ++d) 
-              (*image_out)(y, x, d) = SampleLinear(*image, q(1), q(0), d);
-            }
-          }
-        VLOG(0) << "Estimating undistortion map...[DONE]." << std::endl;
-        VLOG(1) << "qs_x : \n" << qs_x << std::endl;
-        VLOG(1) << "qs_y : \n" << qs_y << std::endl;
-      } else {
-        // Tests if the size of the image is the same as the previous one
-        if (size_image(0) != image->Width() || size_image(1) != image->Height())
-          return 2;
-        // TODO(julien) Put this image undistorting in camera?
-        VLOG(0) << "Undistorting image " << i << "..." << std::endl;
-        for (size_t x = 0; x < image->Width(); ++x) 
-        for (size_t y = 0; y < image->Height(); ++y) {
-          if (image->Contains(qs_y(y, x), qs_x(y, x))) {
-          for (int d = 0; d < image_out->Depth(); ++d) 
-            (*image_out)(y, x, d) = SampleLinear(*image,
-                                                 qs_y(y, x), 
-                                                 qs_x(y, x), d);
-          }
-        }
-        VLOG(0) << "Undistorting image " << i << "...[DONE]." << std::endl;
-      }
+      // Write the output image
+      VLOG(0) << "Saving undistorted image " << i << "." << std::endl;
+      std::stringstream s;
+      s << ReplaceFolder(files[i].substr(0, files[i].rfind(".")), FLAGS_of);
+      s << FLAGS_os;
+      s << files[i].substr(files[i].rfind("."), files[i].size());
+      WriteImage(*image, s.str().c_str());
     }
-    source->Unpin(i);
-    // Write the output image
-    VLOG(0) << "Saving undistorted image." << std::endl;
-    std::stringstream s;
-    s << ReplaceFolder(files[i].substr(0, files[i].rfind(".")), FLAGS_of);
-    s << FLAGS_os;
-    s << files[i].substr(files[i].rfind("."), files[i].size());
-    WriteImage(*image_out, s.str().c_str());
+    frames->Unpin(i);
   }
-  if (image_out)
-    delete image_out;
   return 0;
 }
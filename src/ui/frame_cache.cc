@@ -0,0 +1,257 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <QMetaType>
+#include <QRunnable>
+#include <QThread>
+#include <cstdlib>
+
+#include "libmv/image/convolve.h"
+#include "libmv/image/image.h"
+#include "libmv/image/image_io.h"
+#include "libmv/numeric/numeric.h"
+#include "ui/frame_cache.h"
+
+namespace {
+
+// Reads file as the viewer displays it: the gray levels horizontally blurred,
+// or the colors as they are.
+bool DecodeFrame(const QString &file, QImage *image) {
+  libmv::ByteImage mv_image;
+  if (!libmv::ReadImage(file.toStdString().c_str(), &mv_image)) {
+    return false;
+  }
+  if (mv_image.Depth() == 1) {
+    libmv::FloatImage float_mv_image;
+    float_mv_image.CopyFrom(mv_image);
+    libmv::FloatImage blurred_mv_image;
+    libmv::Vec gauss, dgauss;
+    libmv::ComputeGaussianKernel(5, &gauss, &dgauss);
+    libmv::ConvolveHorizontal(float_mv_image, gauss, &blurred_mv_image);
+    libmv::FloatArrayToScaledByteArray(blurred_mv_image, &mv_image);
+
+    // The QImage does not own the pixels, hence the copy.
+    QImage gray(mv_image.Data(), mv_image.Width(), mv_image.Height(),
+                QImage::Format_Indexed8);
+    gray.setNumColors(256);
+    for (int i = 0; i < 256; ++i) {
+      gray.setColor(i, qRgb(i, i, i));
+    }
+    *image = gray.copy();
+  } else if (mv_image.Depth() == 3) {
+    // QImage::Format_RGB888 is not in Qt 4.3.
+    *image = QImage(mv_image.Width(), mv_image.Height(), QImage::Format_RGB32);
+    for (int y = 0; y < mv_image.Height(); ++y) {
+      QRgb *row = reinterpret_cast<QRgb *>(image->scanLine(y));
+      for (int x = 0; x < mv_image.Width(); ++x) {
+        row[x] = qRgb(mv_image(y, x, 0), mv_image(y, x, 1), mv_image(y, x, 2));
+      }
+    }
+  } else {
+    return false;
+  }
+  return !image->isNull();
+}
+
+// Decodes a frame, unless the playhead moved away from it while the task was
+// queued, and posts the result back to the cache on the GUI thread.
+class DecodeTask : public QRunnable {
+ public:
+  DecodeTask(FrameCache *cache, const QString &file, int frame,
+             int generation, int radius, int proxy_size, bool needs_proxy)
+      : cache_(cache), file_(file), frame_(frame), generation_(generation),
+        radius_(radius), proxy_size_(proxy_size), needs_proxy_(needs_proxy) {}
+
+  virtual void run() {
+    bool near = NearPlayhead();
+    if (!near && !needs_proxy_) {
+      NotDecoded(false);
+      return;
+    }
+    QImage full;
+    if (!DecodeFrame(file_, &full)) {
+      NotDecoded(true);
+      return;
+    }
+    QImage proxy = full;
+    if (full.width() > proxy_size_ || full.height() > proxy_size_) {
+      proxy = full.scaled(proxy_size_, proxy_size_, Qt::KeepAspectRatio,
+                          Qt::SmoothTransformation);
+    }
+    QSize size = full.size();
+    if (!NearPlayhead()) {
+      full = QImage();
+    }
+    QMetaObject::invokeMethod(cache_, "frameDecoded", Qt::QueuedConnection,
+                              Q_ARG(int, frame_), Q_ARG(int, generation_),
+                              Q_ARG(QSize, size), Q_ARG(QImage, full),
+                              Q_ARG(QImage, proxy));
+  }
+
+ private:
+  bool NearPlayhead() const {
+    return generation_ == cache_->generation() &&
+           std::abs(frame_ - cache_->playhead()) <= radius_;
+  }
+
+  void NotDecoded(bool failed) {
+    QMetaObject::invokeMethod(cache_, "frameNotDecoded", Qt::QueuedConnection,
+                              Q_ARG(int, frame_), Q_ARG(int, generation_),
+                              Q_ARG(bool, failed));
+  }
+
+  FrameCache *cache_;
+  QString file_;
+  int frame_;
+  int generation_;
+  int radius_;
+  int proxy_size_;
+  bool needs_proxy_;
+};
+
+int PixmapBytes(const QImage &image) {
+  return image.width() * image.height() * 4;
+}
+
+}  // namespace
+
+FrameCache::FrameCache(QObject *parent)
+    : QObject(parent),
+      full_(256 << 20),
+      proxy_size_(256),
+      radius_(2),
+      playhead_(0),
+      generation_(0) {
+  qRegisterMetaType<QImage>("QImage");
+  // Leave a core to the GUI thread.
+  pool_.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+}
+
+FrameCache::~FrameCache() {
+  generation_.ref();
+  pool_.waitForDone();
+}
+
+void FrameCache::setFiles(const QStringList &files) {
+  generation_.ref();
+  files_ = files;
+  proxies_.assign(files.size(), QPixmap());
+  sizes_.assign(files.size(), QSize());
+  pending_.clear();
+  // Empty the LRU by shrinking it.
+  long long max_bytes = full_.MaxSize();
+  full_.SetMaxSize(0);
+  full_.SetMaxSize(max_bytes);
+  playhead_ = 0;
+}
+
+void FrameCache::setMaxFullResolutionBytes(int bytes) {
+  full_.SetMaxSize(bytes);
+}
+
+QPixmap FrameCache::setPlayhead(int frame) {
+  playhead_ = frame;
+  // Nearest first, so the playhead is decoded before its neighbours.
+  requestDecode(frame);
+  for (int i = 1; i <= radius_; ++i) {
+    requestDecode(frame + i);
+    requestDecode(frame - i);
+  }
+  return this->frame(frame);
+}
+
+QPixmap FrameCache::frame(int frame) {
+  if (frame < 0 || frame >= numFrames()) {
+    return QPixmap();
+  }
+  QPixmap *full;
+  if (full_.FetchAndPin(frame, &full)) {
+    QPixmap pixmap = *full;
+    full_.Unpin(frame);
+    return pixmap;
+  }
+  return proxies_[frame];
+}
+
+bool FrameCache::hasProxy(int frame) const {
+  return 0 <= frame && frame < numFrames() && !proxies_[frame].isNull();
+}
+
+bool FrameCache::hasFullResolution(int frame) {
+  return full_.ContainsKey(frame);
+}
+
+QSize FrameCache::frameSize(int frame) const {
+  if (frame < 0 || frame >= numFrames()) {
+    return QSize();
+  }
+  return sizes_[frame];
+}
+
+bool FrameCache::nearPlayhead(int frame) const {
+  return std::abs(frame - playhead()) <= radius_;
+}
+
+void FrameCache::requestDecode(int frame) {
+  if (frame < 0 || frame >= numFrames() ||
+      hasFullResolution(frame) ||
+      pending_.count(frame)) {
+    return;
+  }
+  pending_.insert(frame);
+  pool_.start(new DecodeTask(this, files_[frame], frame, generation(),
+                             radius_, proxy_size_, !hasProxy(frame)));
+}
+
+void FrameCache::storeFullResolution(int frame, const QImage &image) {
+  if (hasFullResolution(frame)) {
+    return;
+  }
+  full_.StoreAndPinSized(frame, new QPixmap(QPixmap::fromImage(image)),
+                         PixmapBytes(image));
+  full_.Unpin(frame);
+}
+
+void FrameCache::frameDecoded(int frame, int generation, QSize size,
+                              QImage full, QImage proxy) {
+  if (generation != this->generation()) {
+    return;
+  }
+  pending_.erase(frame);
+  sizes_[frame] = size;
+  if (proxies_[frame].isNull()) {
+    proxies_[frame] = QPixmap::fromImage(proxy);
+  }
+  // The playhead may have moved on since the decode.
+  if (!full.isNull() && nearPlayhead(frame)) {
+    storeFullResolution(frame, full);
+  }
+  emit frameReady(frame);
+}
+
+void FrameCache::frameNotDecoded(int frame, int generation, bool failed) {
+  if (generation != this->generation()) {
+    return;
+  }
+  pending_.erase(frame);
+  if (failed) {
+    emit frameFailed(frame, files_[frame]);
+  }
+}
@@ -0,0 +1,107 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef SRC_UI_FRAME_CACHE_H
+#define SRC_UI_FRAME_CACHE_H
+
+#include <QAtomicInt>
+#include <QImage>
+#include <QObject>
+#include <QPixmap>
+#include <QSize>
+#include <QStringList>
+#include <QThreadPool>
+#include <set>
+#include <vector>
+
+#include "libmv/image/lru_cache.h"
+
+// Decodes the frames of a sequence off the GUI thread and keeps them at two
+// resolutions for display: a downscaled proxy of every decoded frame, small
+// enough to keep for the whole sequence, and full resolution pixmaps of the
+// frames around the playhead only, in an LRU bounded in bytes. Pixmaps live in
+// the windowing system (X server or video memory), so they are created on the
+// GUI thread and only for the frames that are about to be displayed.
+class FrameCache : public QObject
+{
+  Q_OBJECT
+
+ public:
+  FrameCache(QObject *parent = 0);
+  virtual ~FrameCache();
+
+  // Replaces the sequence; the decodes still running for the previous one are
+  // dropped when they finish.
+  void setFiles(const QStringList &files);
+  int numFrames() const { return files_.size(); }
+
+  // The proxies fit in max_side x max_side.
+  void setProxySize(int max_side) { proxy_size_ = max_side; }
+  // Frames within radius of the playhead are decoded at full resolution.
+  void setFullResolutionRadius(int radius) { radius_ = radius; }
+  void setMaxFullResolutionBytes(int bytes);
+
+  // Moves the playhead and returns the best pixmap available for frame, which
+  // is null until its first decode finishes. The frames within the radius are
+  // decoded in the background, nearest first; frameReady() is emitted as they
+  // arrive.
+  QPixmap setPlayhead(int frame);
+  // The best pixmap available for frame, without decoding anything.
+  QPixmap frame(int frame);
+  bool hasProxy(int frame) const;
+  bool hasFullResolution(int frame);
+  // The full resolution size of frame, or an invalid size if not decoded yet.
+  QSize frameSize(int frame) const;
+
+  // Safe to call from the decoding threads.
+  int playhead() const { return playhead_; }
+  int generation() const { return generation_; }
+
+ signals:
+  void frameReady(int frame);
+  void frameFailed(int frame, const QString &file);
+
+ private slots:
+  void frameDecoded(int frame, int generation, QSize size,
+                    QImage full, QImage proxy);
+  void frameNotDecoded(int frame, int generation, bool failed);
+
+ private:
+  bool nearPlayhead(int frame) const;
+  void requestDecode(int frame);
+  void storeFullResolution(int frame, const QImage &image);
+
+  QStringList files_;
+  std::vector<QPixmap> proxies_;
+  std::vector<QSize> sizes_;
+  // Full resolution pixmaps, sized in bytes.
+  libmv::LRUCache<int, QPixmap> full_;
+  std::set<int> pending_;
+
+  int proxy_size_;
+  int radius_;
+  // Read by the decoding threads, which copy the rest of the settings.
+  QAtomicInt playhead_;
+  QAtomicInt generation_;
+
+  QThreadPool pool_;
+};
+
+#endif  // SRC_UI_FRAME_CACHE_H
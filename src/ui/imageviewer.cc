@@ -4,10 +4,6 @@
 #include <iostream>
 using namespace std;
 
-#include "libmv/numeric/numeric.h"
-#include "libmv/image/image.h"
-#include "libmv/image/image_io.h"
-#include "libmv/image/convolve.h"
 #include "ui/imageviewer.h"
 #include "ui/scrubber.h"
 
@@ -28,10 +24,14 @@ ImageViewer::ImageViewer()
 
   setCentralWidget(scrollArea);
 
-  scrubber.setNumItems(20);
+  scrubber.setNumItems(0);
   statusBar()->addPermanentWidget(&scrubber, 1);
   scrubber.setCallback(callback, this);
 
+  connect(&frames, SIGNAL(frameReady(int)), this, SLOT(frameReady(int)));
+  connect(&frames, SIGNAL(frameFailed(int, const QString &)),
+          this, SLOT(frameFailed(int, const QString &)));
+
   createActions();
   createMenus();
 
@@ -39,78 +39,59 @@ ImageViewer::ImageViewer()
   resize(500, 400);
 }
 
+// The frames are decoded in the background by the FrameCache, so long
+// sequences open at once and scrubbing does not block on the disk.
 void ImageViewer::open()
 {
-  QString fileName = QFileDialog::getOpenFileName(this,
-      tr("Open File"), QDir::currentPath());
-  if (!fileName.isEmpty()) {
-
-    libmv::ByteImage mv_image;
-    if(!libmv::ReadImage(fileName.toStdString().c_str(), &mv_image))  {
-      QMessageBox::information(this, tr("Libmv Testbed"),
-          tr("Cannot load %1.").arg(fileName));
-      return;
-    }
-    
-    libmv::FloatImage float_mv_image;
-    float_mv_image.CopyFrom(mv_image);
-    libmv::FloatImage blurred_mv_image;
-    libmv::Vec gauss, dgauss;
-    libmv::ComputeGaussianKernel(5, &gauss, &dgauss);
-    libmv::ConvolveHorizontal(float_mv_image,
-                              gauss,
-                              &blurred_mv_image);
-//    libmv::ConvolveVertical(blurred_mv_image,
-//                              gauss,
-//                              &float_mv_image);
-//    libmv::ConvolveVertical(float_mv_image,
-//                              gauss,
-//                              &blurred_mv_image);
-//    mv_image.CopyFrom(blurred_mv_image);
-    libmv::FloatArrayToScaledByteArray(blurred_mv_image, &mv_image);
-//    mv_image.CopyFrom(float_mv_image);
-
-    printf("w=%d,h=%d,d=%d\n", mv_image.Width(), mv_image.Height(),
-                 mv_image.Depth());
-
-    QImage image;
-    if (mv_image.Depth() == 1) {
-      image = QImage(mv_image.Data(), mv_image.Width(), mv_image.Height(), QImage::Format_Indexed8);
-    } else if (mv_image.Depth() == 3) {
-      //Sorry QImage::Format_RGB888 isn't implemented in qt 4.3 the version on my computer (Daniel).
-      QMessageBox::information(this, tr("Libmv Testbed"),
-          tr("Cannot load %1. Try converting your image to greyscale.").arg(fileName));
-      return;
-    }
-    
-    image.setNumColors(256);
-    for (int i = 0, count = image.numColors(); i < count; ++i) {
-      image.setColor(i, qRgb(i,i,i));
-    }
-
-    if (image.isNull()) {
-      QMessageBox::information(this, tr("Libmv Testbed"),
-          tr("Cannot load %1.").arg(fileName));
-      return;
-    }
-    
-    QPixmap qp = QPixmap::fromImage(image);
-    scrubber.setCurrentItem(qp);
-    imageLabel->setPixmap(qp);
+  QStringList fileNames = QFileDialog::getOpenFileNames(this,
+      tr("Open Files"), QDir::currentPath());
+  if (!fileNames.isEmpty()) {
+    frames.setFiles(fileNames);
+    scrubber.setNumItems(fileNames.size());
+    scrubber.setCurrentItem(0);
+    frameSize = QSize();
+    imageLabel->setPixmap(QPixmap());
 
     scaleFactor = 1.0;
 
+    FrameChange();
+  }
+}
+
+void ImageViewer::showFrame(const QPixmap &pixmap)
+{
+  QSize size = frames.frameSize(scrubber.currentItem());
+  if (pixmap.isNull() || !size.isValid())
+    return;
+  bool firstFrame = !frameSize.isValid();
+  frameSize = size;
+  // A proxy is stretched to the full resolution size by the label.
+  imageLabel->setPixmap(pixmap);
+
+  if (firstFrame) {
     printAct->setEnabled(true);
     fitToWindowAct->setEnabled(true);
     updateActions();
-
-    if (!fitToWindowAct->isChecked())
-      imageLabel->adjustSize();
   }
+  if (!fitToWindowAct->isChecked())
+    imageLabel->resize(scaleFactor * frameSize);
 }
 
 void ImageViewer::FrameChange() {
-  imageLabel->setPixmap(scrubber.GetCurrentItem());
+  showFrame(frames.setPlayhead(scrubber.currentItem()));
+}
+
+void ImageViewer::frameReady(int frame)
+{
+  scrubber.setItemState(frame, frames.hasFullResolution(frame) ?
+                        Scrubber::ITEM_FULL_RESOLUTION : Scrubber::ITEM_PROXY);
+  if (frame == scrubber.currentItem())
+    showFrame(frames.frame(frame));
+}
+
+void ImageViewer::frameFailed(int, const QString &fileName)
+{
+  statusBar()->showMessage(tr("Cannot load %1.").arg(fileName));
 }
 
 void ImageViewer::print()
@@ -120,11 +101,12 @@ void ImageViewer::print()
   if (dialog.exec()) {
     QPainter painter(&printer);
     QRect rect = painter.viewport();
-    QSize size = imageLabel->pixmap()->size();
+    QSize size = frameSize;
     size.scale(rect.size(), Qt::KeepAspectRatio);
     painter.setViewport(rect.x(), rect.y(), size.width(), size.height());
-    painter.setWindow(imageLabel->pixmap()->rect());
-    painter.drawPixmap(0, 0, scrubber.GetCurrentItem());
+    painter.setWindow(QRect(QPoint(0, 0), frameSize));
+    painter.drawPixmap(QRect(QPoint(0, 0), frameSize),
+                       frames.frame(scrubber.currentItem()));
   }
 }
 
@@ -140,7 +122,7 @@ void ImageViewer::zoomOut()
 
 void ImageViewer::normalSize()
 {
-  imageLabel->adjustSize();
+  imageLabel->resize(frameSize);
   scaleFactor = 1.0;
 }
 
@@ -235,7 +217,7 @@ void ImageViewer::scaleImage(double factor)
 {
   Q_ASSERT(imageLabel->pixmap());
   scaleFactor *= factor;
-  imageLabel->resize(scaleFactor * imageLabel->pixmap()->size());
+  imageLabel->resize(scaleFactor * frameSize);
 
   adjustScrollBar(scrollArea->horizontalScrollBar(), factor);
   adjustScrollBar(scrollArea->verticalScrollBar(), factor);
@@ -47,6 +47,7 @@
 #include <QMainWindow>
 #include <QPrinter>
 
+#include "ui/frame_cache.h"
 #include "ui/scrubber.h"
 
 class QAction;
@@ -66,6 +67,8 @@ public:
 
 private slots:
     void open();
+    void frameReady(int frame);
+    void frameFailed(int frame, const QString &fileName);
     void print();
     void zoomIn();
     void zoomOut();
@@ -79,6 +82,7 @@ private:
     void updateActions();
     void scaleImage(double factor);
     void adjustScrollBar(QScrollBar *scrollBar, double factor);
+    void showFrame(const QPixmap &pixmap);
 
     QScrollArea *scrollArea;
     double scaleFactor;
@@ -102,6 +106,9 @@ private:
     QLabel *imageLabel;
     
     Scrubber scrubber;
+    FrameCache frames;
+    // The full resolution size of the displayed frame, which may be a proxy.
+    QSize frameSize;
 };
 
 #endif
@@ -5,6 +5,7 @@
 Scrubber::Scrubber(QWidget *parent)
     : QWidget(parent)
 {
+  num_items_ = 0;
   current_item_ = 0;
   frame_change = 0;
 }
@@ -13,10 +14,17 @@ void Scrubber::setNumItems(int newsize) {
   num_items_ = newsize;
   items_.resize(num_items_);
   clearItems();
+  if (current_item_ >= num_items_) {
+    current_item_ = 0;
+  }
+  update();
 }
 
-void Scrubber::setItem(int index, QPixmap &pix){
-  items_[index] = pix;
+void Scrubber::setItemState(int index, ItemState state) {
+  if (items_[index] != state) {
+    items_[index] = state;
+    update();
+  }
 }
 
 void Scrubber::setCurrentItem(int index) {
@@ -25,58 +33,89 @@ void Scrubber::setCurrentItem(int index) {
 
 void Scrubber::clearItems() {
   for (unsigned int i = 0; i < items_.size(); ++i) {
-    items_[i] = QPixmap();
+    items_[i] = ITEM_EMPTY;
   }
-
-}
-QPixmap Scrubber::GetItem(int index) {
-  return items_[index];
-}
-
-QPixmap Scrubber::GetCurrentItem() {
-  return items_[current_item_];
 }
 
-void Scrubber::setCurrentItem(QPixmap pix) {
-  items_[current_item_] = pix;
+int Scrubber::ItemAt(int x) const {
+  int item = x * num_items_ / qMax(width(), 1);
+  return qBound(0, item, num_items_ - 1);
 }
 
-// TODO(keir): This breaks down when there are more than about 30 frames,
-// because the names run into each other. Change this so that there is a mode
-// that only shows 1 .. 10 .. 20 .. instead of every frame.
 void Scrubber::paintEvent(QPaintEvent *)
 {
+    if (num_items_ == 0) {
+      return;
+    }
+    QColor itemProxyColor(100, 205, 100, 95);
     QColor itemPresentColor(100, 205, 100, 191);
     QColor itemHighlightedColor(100, 5, 20, 191);
 
     QPainter painter(this);
-    int blockWidth = width() / num_items_;
+    double blockWidth = width() / double(num_items_);
     int blockHeight = height();
     painter.setFont(QFont("Arial", 8));
 
-    QRect itemRect(blockWidth*current_item_, 0, blockWidth, blockHeight);
-    painter.fillRect(itemRect, itemHighlightedColor);
+    // Long sequences only get a label every 1, 10, 20, ... frames, and no
+    // separators once the frames are a few pixels wide.
+    int labelStep = 1;
+    const int minLabelWidth = painter.fontMetrics().width("00000");
+    while (labelStep * blockWidth < minLabelWidth) {
+      labelStep = labelStep == 1 ? 10 : labelStep + 10;
+    }
 
-    for (unsigned int i = 0; i < items_.size(); ++i) {
-      painter.setPen(Qt::gray);
-      painter.drawLine(blockWidth*i, 0, blockWidth*i, blockHeight);
-      painter.setPen(Qt::black);
-      QRect itemRect(blockWidth*i, 0, blockWidth, blockHeight);
-      if (!items_[i].isNull()) {
+    for (int i = 0; i < num_items_; ++i) {
+      int x0 = int(blockWidth * i), x1 = int(blockWidth * (i + 1));
+      QRect itemRect(x0, 0, qMax(x1 - x0, 1), blockHeight);
+      if (items_[i] == ITEM_PROXY) {
+        painter.fillRect(itemRect, itemProxyColor);
+      } else if (items_[i] == ITEM_FULL_RESOLUTION) {
         painter.fillRect(itemRect, itemPresentColor);
       }
+      if (blockWidth >= 4) {
+        painter.setPen(Qt::gray);
+        painter.drawLine(x0, 0, x0, blockHeight);
+      }
+    }
+
+    int x0 = int(blockWidth * current_item_);
+    int x1 = int(blockWidth * (current_item_ + 1));
+    painter.fillRect(QRect(x0, 0, qMax(x1 - x0, 1), blockHeight),
+                     itemHighlightedColor);
+
+    painter.setPen(Qt::black);
+    for (int i = 0; i < num_items_; i += labelStep) {
+      QRect labelRect(int(blockWidth * (i + 0.5)) - minLabelWidth / 2, 0,
+                      minLabelWidth, blockHeight);
       QString numformat;
       numformat.sprintf("%d", i);
-      painter.drawText(itemRect, Qt::AlignCenter, numformat);
+      painter.drawText(labelRect, Qt::AlignCenter, numformat);
     }
 }
 
-void Scrubber::mousePressEvent (QMouseEvent *e) {
-  int blockWidth = width() / num_items_;
-  int itemHit = e->x() / blockWidth;
-  setCurrentItem(itemHit);
+void Scrubber::SelectItem(int index) {
+  if (index == current_item_) {
+    return;
+  }
+  setCurrentItem(index);
   repaint();
-  emit selectionChanged(itemHit);
+  emit selectionChanged(index);
   if(frame_change)
     frame_change(frame_change_data_);
 }
+
+void Scrubber::mousePressEvent (QMouseEvent *e) {
+  if (num_items_ == 0) {
+    return;
+  }
+  SelectItem(ItemAt(e->x()));
+}
+
+// Dragging scrubs through the frames; the FrameCache keeps it responsive by
+// showing proxies until the full resolution frames are decoded.
+void Scrubber::mouseMoveEvent (QMouseEvent *e) {
+  if (num_items_ == 0 || !(e->buttons() & Qt::LeftButton)) {
+    return;
+  }
+  SelectItem(ItemAt(e->x()));
+}
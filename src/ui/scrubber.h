@@ -3,21 +3,28 @@
 
 #include <QWidget>
 #include <vector>
-#include <QPixmap>
 
+// A strip of frame numbers to pick the current frame by clicking or dragging.
+// It only shows which frames are loaded; the pixmaps are kept by a FrameCache.
 class Scrubber : public QWidget
 {
   Q_OBJECT
 
  public:
+  enum ItemState {
+    ITEM_EMPTY,
+    // Only a downscaled proxy is loaded.
+    ITEM_PROXY,
+    ITEM_FULL_RESOLUTION
+  };
+
   Scrubber(QWidget *parent = 0);
   void setNumItems(int newsize);
-  void setItem(int index, QPixmap &pix);
+  int numItems() const { return num_items_; }
+  void setItemState(int index, ItemState state);
   void setCurrentItem(int index);
-  void setCurrentItem(QPixmap pix);
+  int currentItem() const { return current_item_; }
   void clearItems();
-  QPixmap GetItem(int index);
-  QPixmap GetCurrentItem();
   
   void setCallback(void (*func)(void *), void *d) {
     frame_change = func;
@@ -27,13 +34,17 @@ class Scrubber : public QWidget
  protected:
   void paintEvent(QPaintEvent *event);
   void mousePressEvent (QMouseEvent *e);
+  void mouseMoveEvent (QMouseEvent *e);
 
  signals:
   void selectionChanged(int newValue);
 
  private:
+  int ItemAt(int x) const;
+  void SelectItem(int index);
+
   int num_items_;
-  std::vector<QPixmap> items_;
+  std::vector<ItemState> items_;
   int current_item_;
   
   void (*frame_change)(void *);
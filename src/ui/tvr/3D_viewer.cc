@@ -23,6 +23,8 @@
 #include <QtGui>
 #include <QtOpenGL>
 
+#include <algorithm>
+
 using namespace libmv::scene;
 
 void SceneCamera::Draw() {
@@ -85,20 +87,155 @@ void SceneCamera::SetParameters(libmv::Mat3 K, libmv::Mat3 R, libmv::Vec3 t) {
   t_ = t;
 }
 
+// A leaf draws this many points per squared pixel of its radius on screen, so
+// far away leaves draw a subsample instead of points on top of each other.
+static const float kPointsPerSquaredPixel = 0.5;
+// Keeps the far away leaves from vanishing altogether.
+static const int kMinLeafPoints = 8;
+
+ScenePointCloud::ScenePointCloud()
+    : dirty_(false),
+#if QT_VERSION >= 0x040700
+      buffer_(QGLBuffer::VertexBuffer),
+#endif
+      use_buffer_(false) {}
+
 void ScenePointCloud::Draw() {
+  using namespace libmv;
+
   glDisable(GL_LIGHTING);
-  glColor3f(0,1,0);
-  glBegin(GL_POINTS);
-  for (int i = 0; i < points_.size(); ++i) {
-    glColor3fv(&colors_[i](0));
-    glVertex3dv(&points_[i](0));
+  if (dirty_) {
+    Upload();
   }
-  glEnd();
+  if (octree_.nodes().empty()) {
+    return;
+  }
+
+  // The frustum planes in the point cloud frame are sums of the rows of the
+  // clip matrix; a point is inside when it is on the positive side of all.
+  Mat4 modelview, projection;
+  glGetDoublev(GL_MODELVIEW_MATRIX, modelview.data());
+  glGetDoublev(GL_PROJECTION_MATRIX, projection.data());
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  Mat4 clip = projection * modelview;
+  Vec4 planes[6];
+  for (int i = 0; i < 3; ++i) {
+    planes[2 * i] = (clip.row(3) + clip.row(i)).transpose();
+    planes[2 * i + 1] = (clip.row(3) - clip.row(i)).transpose();
+  }
+  Vec4 eye = modelview.inverse() * Vec4(0, 0, 0, 1);
+  // Pixels per unit of length at unit distance from the eye.
+  float pixel_scale = projection(1, 1) * viewport[3] / 2;
+
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+#if QT_VERSION >= 0x040700
+  if (use_buffer_) {
+    buffer_.bind();
+    glVertexPointer(3, GL_FLOAT, 0, 0);
+    glColorPointer(3, GL_FLOAT, 0,
+        reinterpret_cast<GLvoid *>(points_.size() * sizeof(Vec3f)));
+  }
+#endif
+  if (!use_buffer_) {
+    glVertexPointer(3, GL_FLOAT, 0, &points_[0]);
+    glColorPointer(3, GL_FLOAT, 0, &colors_[0]);
+  }
+
+  DrawNode(0, planes, false, eye.head<3>().cast<float>() / eye(3),
+           pixel_scale);
+
+#if QT_VERSION >= 0x040700
+  if (use_buffer_) {
+    buffer_.release();
+  }
+#endif
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+// Draws the visible leaves under the node. Inside is true when the node is
+// known to be in the frustum, which spares the tests on its children.
+void ScenePointCloud::DrawNode(int index, const libmv::Vec4 planes[6],
+                               bool inside, const libmv::Vec3f &eye,
+                               float pixel_scale) {
+  using namespace libmv;
+
+  const PointOctree::Node &node = octree_.nodes()[index];
+  if (!inside) {
+    inside = true;
+    for (int i = 0; i < 6; ++i) {
+      // The box corners the farthest along and against the plane normal.
+      Vec3 far_corner, near_corner;
+      for (int k = 0; k < 3; ++k) {
+        bool positive = planes[i](k) >= 0;
+        far_corner(k) = positive ? node.max(k) : node.min(k);
+        near_corner(k) = positive ? node.min(k) : node.max(k);
+      }
+      if (planes[i].head<3>().dot(far_corner) + planes[i](3) < 0) {
+        return;
+      }
+      if (planes[i].head<3>().dot(near_corner) + planes[i](3) < 0) {
+        inside = false;
+      }
+    }
+  }
+
+  if (!node.IsLeaf()) {
+    for (int i = 0; i < 8; ++i) {
+      if (node.children[i] != -1) {
+        DrawNode(node.children[i], planes, inside, eye, pixel_scale);
+      }
+    }
+    return;
+  }
+
+  // The leaf points are shuffled, so the first ones are a fair subsample.
+  int count = node.end - node.begin;
+  float radius = (node.max - node.min).norm() / 2;
+  float distance = (eye - (node.min + node.max) / 2).norm();
+  if (distance > radius) {
+    float pixels = pixel_scale * radius / distance;
+    int lod_count = int(kPointsPerSquaredPixel * pixels * pixels);
+    count = std::min(count, std::max(kMinLeafPoints, lod_count));
+  }
+  glDrawArrays(GL_POINTS, node.begin, count);
+}
+
+// Builds the octree, which reorders the points, and uploads them once; the
+// colors follow the positions in the same buffer.
+void ScenePointCloud::Upload() {
+  octree_.Build(&points_, &colors_);
+  dirty_ = false;
+  use_buffer_ = false;
+  if (points_.empty()) {
+    return;
+  }
+#if QT_VERSION >= 0x040700
+  if (buffer_.isCreated() || buffer_.create()) {
+    int bytes = points_.size() * sizeof(libmv::Vec3f);
+    buffer_.setUsagePattern(QGLBuffer::StaticDraw);
+    buffer_.bind();
+    buffer_.allocate(2 * bytes);
+    buffer_.write(0, &points_[0], bytes);
+    buffer_.write(bytes, &colors_[0], bytes);
+    buffer_.release();
+    use_buffer_ = true;
+  }
+#endif
 }
 
 void ScenePointCloud::AddPoint(libmv::Vec3 &point, libmv::Vec3f &color) {
-  points_.push_back(point);
+  points_.push_back(point.cast<float>());
   colors_.push_back(color);
+  dirty_ = true;
+}
+
+void ScenePointCloud::Clear() {
+  points_.clear();
+  colors_.clear();
+  dirty_ = true;
 }
 
 
@@ -193,11 +330,13 @@ void ViewerCamera::MouseZoom(float dw) {
 }
 
 Viewer3D::Viewer3D(QGLWidget *share, GLTexture *textures, QWidget *parent) :
-    QGLWidget(0, share), document_(NULL), textures_(textures) {
+    QGLWidget(0, share), document_(NULL), textures_(textures),
+    scene_built_(false) {
   using namespace Eigen;
   
   connect(parent, SIGNAL(GLUpdateNeeded()), this, SLOT(GLUpdate()));
   connect(parent, SIGNAL(TextureChanged()), this, SLOT(TextureChange()));
+  connect(parent, SIGNAL(DocumentChanged()), this, SLOT(DocumentChanged()));
   
   scene_graph_ = Node<SceneObject>("root node", NULL);
   
@@ -215,21 +354,33 @@ void Viewer3D::SetDocument(TvrDocument *doc) {
   assert(document_);
   assert(textures_);
   
+  DocumentChanged();
+}
+
+// Reloads the cameras and the points, which change as the background jobs
+// publish them.
+void Viewer3D::DocumentChanged() {
   if (document_->X.size() > 0) {
+    scene_point_cloud_.Clear();
     for (int i = 0; i < document_->X.size(); ++i) {
       scene_point_cloud_.AddPoint(document_->X[i], document_->X_colors[i]);
     }
-    scene_graph_.AddChild(new Node<SceneObject>("PointCloud",
-                                                &scene_point_cloud_));
-    
     for (int i = 0; i < 2; ++i) {
       scene_cameras_[i].SetParameters(document_->K[i], document_->R[i],
                                       document_->t[i]);
       scene_cameras_[i].SetTexture(textures_[i]);
-      std::stringstream name;
-      name << "Camera" << i;
-      scene_graph_.AddChild(new Node<SceneObject>(name.str().c_str(),
-                                                  &scene_cameras_[i]));
+    }
+
+    if (!scene_built_) {
+      scene_graph_.AddChild(new Node<SceneObject>("PointCloud",
+                                                  &scene_point_cloud_));
+      for (int i = 0; i < 2; ++i) {
+        std::stringstream name;
+        name << "Camera" << i;
+        scene_graph_.AddChild(new Node<SceneObject>(name.str().c_str(),
+                                                    &scene_cameras_[i]));
+      }
+      scene_built_ = true;
     }
   }
 }
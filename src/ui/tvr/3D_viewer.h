@@ -27,11 +27,15 @@
 
 #include <QGLWidget>
 #include <QImage>
+#if QT_VERSION >= 0x040700
+#include <QGLBuffer>
+#endif
 
 #include "libmv/base/vector.h"
 #include "libmv/scene_graph/scene_graph_simple.h"
 #include "ui/tvr/tvr_document.h"
 #include "ui/tvr/gl_texture.h"
+#include "ui/tvr/point_octree.h"
 
 class SceneObject {
  public:
@@ -63,16 +67,34 @@ class SceneCamera : public SceneObject {
   GLTexture texture_;
 };
 
+// The points are uploaded once to a vertex buffer, in the order of an octree
+// over them. Each frame only the octree leaves inside the view frustum are
+// drawn, and the far away leaves only draw a subsample of their points.
 class ScenePointCloud : public SceneObject {
  public:
+  ScenePointCloud();
   void Draw();
   ObjectType GetType() { return PointCloud; }
   void AddPoint(libmv::Vec3 &point, libmv::Vec3f &color);
+  void Clear();
   
   ~ScenePointCloud() {};
  private:
-  std::vector<libmv::Vec3> points_;
+  void Upload();
+  void DrawNode(int index, const libmv::Vec4 planes[6], bool inside,
+                const libmv::Vec3f &eye, float pixel_scale);
+
+  std::vector<libmv::Vec3f> points_;
   std::vector<libmv::Vec3f> colors_;
+  PointOctree octree_;
+  // The points were added after the last upload.
+  bool dirty_;
+#if QT_VERSION >= 0x040700
+  QGLBuffer buffer_;
+#endif
+  // False draws from points_ and colors_ in client memory, for the drivers
+  // without vertex buffers.
+  bool use_buffer_;
 };
 
 
@@ -127,6 +149,7 @@ class Viewer3D : public QGLWidget {
 
  public slots:
   void SetDocument(TvrDocument *);
+  void DocumentChanged();
   void GLUpdate() { updateGL(); }
   void TextureChange();
 
@@ -148,6 +171,8 @@ class Viewer3D : public QGLWidget {
   ScenePointCloud scene_point_cloud_;
   SceneCamera scene_cameras_[2];
   libmv::scene::Node<SceneObject> scene_graph_;
+  // The point cloud and the cameras were added to scene_graph_.
+  bool scene_built_;
   ViewerCamera viewer_camera_;
   
   QPoint lastPos_;
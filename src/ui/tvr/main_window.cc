@@ -22,25 +22,7 @@
 #include <QFileDialog>
 #include <QtGui>
 
-#include "libmv/base/scoped_ptr.h"
 #include "libmv/base/vector.h"
-#include "libmv/base/vector_utils.h"
-#include "libmv/correspondence/feature_matching.h"
-#include "libmv/correspondence/feature_matching_FLANN.h"
-#include "libmv/detector/detector.h"
-#include "libmv/detector/fast_detector.h"
-#include "libmv/detector/star_detector.h"
-#include "libmv/descriptor/descriptor.h"
-#include "libmv/descriptor/daisy_descriptor.h"
-#include "libmv/descriptor/simpliest_descriptor.h"
-#include "libmv/image/array_nd.h"
-#include "libmv/image/image.h"
-#include "libmv/logging/logging.h"
-#include "libmv/multiview/projection.h"
-#include "libmv/multiview/fundamental.h"
-#include "libmv/multiview/focal_from_fundamental.h"
-#include "libmv/multiview/nviewtriangulation.h"
-#include "libmv/multiview/bundle.h"
 
 #include "ui/tvr/main_window.h"
 
@@ -54,6 +36,17 @@ TvrMainWindow::TvrMainWindow(QWidget *parent)
 
   InvalidateTextures();
 
+  // The matching and the reconstruction run in the background.
+  connect(&worker_, SIGNAL(Progress(int, const QString &)),
+          this, SLOT(JobProgress(int, const QString &)));
+  connect(&worker_, SIGNAL(Published()), this, SLOT(JobPublished()));
+  connect(&worker_, SIGNAL(Finished(bool, const QString &)),
+          this, SLOT(JobFinished(bool, const QString &)));
+  progress_bar_ = new QProgressBar;
+  progress_bar_->setRange(0, 100);
+  QMainWindow::statusBar()->addPermanentWidget(progress_bar_);
+  SetJobRunning(false);
+
   viewers_area_ = new QMdiArea;
   setCentralWidget(viewers_area_);
   Show2DView();
@@ -139,6 +132,19 @@ void TvrMainWindow::CreateActions() {
       "optimization of camera parameters and points."));
   connect(metric_bundle_action_, SIGNAL(triggered()),
           this, SLOT(MetricBundle()));
+
+  reconstruct_all_action_ = new QAction(tr("&Reconstruct All"), this);
+  reconstruct_all_action_->setShortcut(tr("Ctrl+R"));
+  reconstruct_all_action_->setStatusTip(tr("Run every step from the "
+      "features to the bundle adjustment, showing the points as they come"));
+  connect(reconstruct_all_action_, SIGNAL(triggered()),
+          this, SLOT(ReconstructAll()));
+
+  cancel_job_action_ = new QAction(tr("C&ancel"), this);
+  cancel_job_action_->setShortcut(tr("Esc"));
+  cancel_job_action_->setStatusTip(tr("Stop the running computation"));
+  connect(cancel_job_action_, SIGNAL(triggered()),
+          this, SLOT(CancelJob()));
 }
 
 void TvrMainWindow::CreateMenus() {
@@ -156,6 +162,9 @@ void TvrMainWindow::CreateMenus() {
   calibration_menu_->addAction(focal_from_fundamental_action_);
   calibration_menu_->addAction(metric_reconstruction_action_);
   calibration_menu_->addAction(metric_bundle_action_);
+  calibration_menu_->addSeparator();
+  calibration_menu_->addAction(reconstruct_all_action_);
+  file_menu_->addAction(cancel_job_action_);
 }
 
 void TvrMainWindow::OpenImages() {
@@ -229,6 +238,13 @@ void TvrMainWindow::InitTexture(int index) {
 
   if (im.isNull()) return;
 
+  // Reopening images replaces the textures, free the video memory of the old
+  // ones.
+  if (textures_[index].textureID != 0) {
+    context_.makeCurrent();
+    glDeleteTextures(1, &textures_[index].textureID);
+    textures_[index].textureID = 0;
+  }
   glGenTextures(1, &textures_[index].textureID);
 
   textures_[index].width = im.width();
@@ -262,116 +278,12 @@ void TvrMainWindow::ComputeFeatures() {
       tr("No images were loaded."));
     return;
   }
-
-  for (int i = 0; i < 2; ++i) {
-    ComputeFeatures(i);
-  }
-
-  // Display information to the user.
-  QMainWindow::statusBar()->showMessage(QString(" Number of features found : ")
-    + "Image 0 : "
-    + QString::number(document_.feature_sets[0].features.size())
-    + " , Image 1 : "
-    + QString::number(document_.feature_sets[1].features.size()));
-}
-
-void TvrMainWindow::ComputeFeatures(int image_index) {
-
-  // Display information to the user.
-  QMainWindow::statusBar()->showMessage("Start : ComputeFeatures for image : "
-    + QString::number(image_index) );
-
-  QImage &qimage = document_.images[image_index];
-  int width = qimage.width(), height = qimage.height();
-  FeatureSet &fs = document_.feature_sets[image_index];
-
-  // Convert to gray-scale.
-  // TODO(keir): Make a libmv image <-> QImage interop library inside libmv for
-  // easy bidirectional exchange of images between Qt and libmv.
-  Array3Du image(height, width);
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      // TODO(pau): there are better ways to compute intensity.
-      //            Implement one and put it on libmv/image.
-      int depth = qimage.depth() / 8;
-      int bands = (depth == 4) ? 3 : depth;  // Skip alpha channel for RGBA.
-      int sum = 0;
-      for (int c = 0; c < bands; ++c) {
-        sum += qimage.bits()[depth*(y * width + x) + c];
-      }
-      image(y, x) = sum / bands;
-    }
-  }
-
-  scoped_ptr<detector::Detector> detector(detector::CreateFastDetector(9, 30, true));
-  //scoped_ptr<detector::Detector> detector(detector::CreateStarDetector());
-
-  vector<Feature *> features;
-  Image im(new Array3Du(image));
-  detector->Detect(im, &features, NULL);
-
-  vector<descriptor::Descriptor *> descriptors;
-  scoped_ptr<descriptor::Describer> describer(descriptor::CreateSimpliestDescriber());
-  //scoped_ptr<descriptor::Describer> describer(descriptor::CreateDaisyDescriber());
-  describer->Describe(features, im, NULL, &descriptors);
-
-  // Copy data.
-  fs.features.resize(descriptors.size());
-  for(int i = 0;i < descriptors.size(); ++i)
-  {
-    KeypointFeature & feat = fs.features[i];
-    feat.descriptor = *(descriptor::VecfDescriptor*)descriptors[i];
-    *(PointFeature*)(&feat) = *(PointFeature*)features[i];
-  }
-
-  DeleteElements(&descriptors);
-  DeleteElements(&features);
-  /*// Display information to the user.
-  QMainWindow::statusBar()->showMessage("End : Build kd-Tree for image : "
-   + QString::number(image_index) );
-
-  if(fs.features.size() > 0)  {
-    // Build the kd-tree.
-    fs.tree.SetDimensions(fs.features[0].descriptor.coords.size());
-    for (int i = 0; i < fs.features.size(); ++i) {
-      fs.tree.AddPoint(fs.features[i].descriptor.coords.data(), i);
-    }
-    fs.tree.Build(10);
-  }*/
-
-  UpdateViewers();
-
-  // Display information to the user.
-  QMainWindow::statusBar()->showMessage("End : ComputeFeatures for image : "
-   + QString::number(image_index) );
+  StartJob(TvrWorker::COMPUTE_FEATURES, TvrWorker::COMPUTE_FEATURES);
 }
 
 void TvrMainWindow::ComputeCandidateMatches() {
-  // Display information to the user.
-  QMainWindow::statusBar()->showMessage("Start : ComputeCandidateMatches");
-
-  clock_t startTime = clock();
-  /*FindSymmetricCandidateMatches_FLANN(document_.feature_sets[0],
-                                      document_.feature_sets[1],
-                                      &document_.matches);*/
-
-  /*FindCandidateMatchesDistanceRatio_FLANN(document_.feature_sets[0],
-                                    document_.feature_sets[1],
-                                    &document_.matches,
-                                    0.8f);*/
-
-  FindCandidateMatches( document_.feature_sets[0],
-                        document_.feature_sets[1],
-                        &document_.matches);
-
-  clock_t stopTime = clock();
-  double millisecond =  ((double)stopTime - startTime) / CLOCKS_PER_SEC;
-  UpdateViewers();
-
-  // Display information to the user.
-  QMainWindow::statusBar()->showMessage("End : ComputeCandidateMatches found : "
-        + QString::number(document_.matches.NumTracks()) + " matches in : "
-        + QString::number(millisecond) + " ms");
+  StartJob(TvrWorker::COMPUTE_CANDIDATE_MATCHES,
+           TvrWorker::COMPUTE_CANDIDATE_MATCHES);
 }
 
 void TvrMainWindow::ComputeRobustMatches() {
@@ -381,27 +293,8 @@ void TvrMainWindow::ComputeRobustMatches() {
       tr("Cannot compute Robust Matches.\nNo putative matches for robust test."));
     return;
   }
-
-  // Display information to the user.
-  QMainWindow::statusBar()->showMessage("Start : ComputeRobustMatches");
-
-  libmv::Matches new_matches;
-
-  ComputeFundamental(document_.matches,
-                     &document_.F, &new_matches);
-  const int nbPointsBefore = document_.matches.NumTracks();
-  const int nbPointsAfter = new_matches.NumTracks();
-  // TODO(pau) Make sure this is not copying too many things.  We could
-  //           implement an efficient swap for the biparted graph (just swaping
-  //           the maps), or remove outlier tracks from the candidate matches
-  //           instead of constructing a new correspondance set.
-  std::swap(document_.matches, new_matches);
-  UpdateViewers();
-
-
-  QMainWindow::statusBar()->showMessage("End : ComputeRobustMatches : "
-    + QString::number(nbPointsAfter) + " inliers "
-    + QString::number(nbPointsBefore-nbPointsAfter) + " outliers found ");
+  StartJob(TvrWorker::COMPUTE_ROBUST_MATCHES,
+           TvrWorker::COMPUTE_ROBUST_MATCHES);
 }
 
 void TvrMainWindow::FocalFromFundamental() {
@@ -411,50 +304,8 @@ void TvrMainWindow::FocalFromFundamental() {
       tr("Cannot compute Focal from Fundamental.\nFundamental was not computed."));
     return;
   }
-
-  QMainWindow::statusBar()->showMessage("Start : FocalFromFundamental");
-
-  vector<Mat> xs;
-  TwoViewPointMatchMatrices(document_.matches, 0, 1, &xs);
-  Mat &x1 = xs[0];
-  Mat &x2 = xs[1];
-
-  libmv::Vec2 p0((document_.images[0].width() - 1) / 2.,
-                 (document_.images[0].height() - 1) / 2.);
-  libmv::Vec2 p1((document_.images[1].width() - 1) / 2.,
-                 (document_.images[1].height() - 1) / 2.);
-
-  bool use_hartleys_method = false;
-  if (use_hartleys_method) {
-    libmv::FocalFromFundamental(document_.F, p0, p1,
-                                &document_.focal_distance[0],
-                                &document_.focal_distance[1]);
-    LOG(INFO) << "focal 0: " << document_.focal_distance[0]
-              << " focal 1: " << document_.focal_distance[1] << "\n";
-  } else {
-    double fmin_mm = 10;
-    double fmax_mm = 150;
-    double sensor_width_mm = 36; // Assuming a full-sized sensor 1x equiv.
-    double width_pix = document_.images[0].width();
-    libmv::FocalFromFundamentalExhaustive(document_.F, p0, x1, x2,
-                                          fmin_mm / sensor_width_mm * width_pix,
-                                          fmax_mm / sensor_width_mm * width_pix,
-                                          100,
-                                          &document_.focal_distance[0]);
-    document_.focal_distance[1] = document_.focal_distance[0];
-
-    LOG(INFO) << "focal: " << document_.focal_distance[0]
-              << "pix    35mm equiv: " << document_.focal_distance[0]
-                                          * sensor_width_mm / width_pix
-              << "\n";
-  }
-
-  UpdateViewers();
-
-  QMainWindow::statusBar()->showMessage(QString("End : FocalFromFundamental. ")
-    + "Focal (pix) estimated to : " + QString::number(document_.focal_distance[0])
-    + "for Image 0 and to : " + QString::number(document_.focal_distance[1])
-    + "for Image 1." );
+  StartJob(TvrWorker::FOCAL_FROM_FUNDAMENTAL,
+           TvrWorker::FOCAL_FROM_FUNDAMENTAL);
 }
 
 void TvrMainWindow::MetricReconstruction() {
@@ -465,71 +316,8 @@ void TvrMainWindow::MetricReconstruction() {
       "\nGeometric correspondence list is empty."));
     return;
   }
-
-  QMainWindow::statusBar()->showMessage("Start : MetricReconstruction");
-  using namespace libmv;
-
-  Vec2 p0((document_.images[0].width() - 1) / 2.,
-          (document_.images[0].height() - 1) / 2.);
-  Vec2 p1((document_.images[1].width() - 1) / 2.,
-          (document_.images[1].height() - 1) / 2.);
-  double f0 = document_.focal_distance[0];
-  double f1 = document_.focal_distance[1];
-  Mat3 K0, K1;
-  K0 << f0,  0, p0(0),
-         0, f0, p0(1),
-         0,  0,     1;
-  K1 << f1,  0, p1(0),
-         0, f1, p1(1),
-         0,  0,     1;
-
-  // Compute essential matrix
-  Mat3 E;
-  EssentialFromFundamental(document_.F, K0, K1, &E);
-
-  // Get matches from the correspondence structure.
-  vector<Mat> xs(2);
-  TwoViewPointMatchMatrices(document_.matches, 0, 1, &xs);
-  Mat &x0 = xs[0];
-  Mat &x1 = xs[1];
-
-  // Recover R, t from E and K
-  Mat3 R;
-  Vec3 t;
-  MotionFromEssentialAndCorrespondence(E, K0, x0.col(0), K1, x1.col(0), &R, &t);
-
-  LOG(INFO) << "R:\n" << R << "\nt:\n" << t;
-
-  document_.K[0] = K0;
-  document_.R[0] = Mat3::Identity();
-  document_.t[0] = Vec3::Zero();
-  document_.K[1] = K1;
-  document_.R[1] = R;
-  document_.t[1] = t;
-
-  // Triangulate features.
-  vector<Mat34> Ps(2);
-  P_From_KRt(document_.K[0], document_.R[0], document_.t[0], &Ps[0]);
-  P_From_KRt(document_.K[1], document_.R[1], document_.t[1], &Ps[1]);
-
-  int n = x0.cols();
-  document_.X.resize(n);
-  document_.X_colors.resize(n);
-  for (int i = 0; i < n; ++i) {
-    Mat2X x(2, 2);
-    x.col(0) = x0.col(i);
-    x.col(1) = x1.col(i);
-    Vec4 X;
-    NViewTriangulate(x, Ps, &X);
-    document_.X[i] = libmv::HomogeneousToEuclidean(X);
-
-    // Get 3D point color from first image.
-    QRgb rgb = document_.images[0].pixel(int(round(x0(0,i))),
-                                         int(round(x0(1,i))));
-    document_.X_colors[i] << qBlue(rgb), qGreen(rgb), qRed(rgb);
-    document_.X_colors[i] /= 255;
-  }
-  QMainWindow::statusBar()->showMessage("End : MetricReconstruction");
+  StartJob(TvrWorker::METRIC_RECONSTRUCTION,
+           TvrWorker::METRIC_RECONSTRUCTION);
 }
 
 void TvrMainWindow::MetricBundle() {
@@ -540,44 +328,68 @@ void TvrMainWindow::MetricBundle() {
       "\nGeometric correspondence list is empty."));
     return;
   }
+  StartJob(TvrWorker::METRIC_BUNDLE, TvrWorker::METRIC_BUNDLE);
+}
 
-  QMainWindow::statusBar()->showMessage("Start : MetricBundle");
-  using namespace libmv;
+void TvrMainWindow::ReconstructAll() {
 
-  vector<Mat3> K(2);
-  vector<Mat3> R(2);
-  vector<Vec3> t(2);
-  for (int i = 0; i < 2; ++i) {
-    K[i] = document_.K[i];
-    R[i] = document_.R[i];
-    t[i] = document_.t[i];
-  }
-  vector<Mat2X> x(2);
-  vector<Mat> xs(2);
-  TwoViewPointMatchMatrices(document_.matches, 0, 1, &xs);
-  for (int i = 0; i < 2; ++i) {
-    x[i] = xs[i];
+  if (textures_[0].textureID==0 || textures_[1].textureID==0) {
+      QMessageBox::information(this, tr("TVR"),
+      tr("No images were loaded."));
+    return;
   }
+  StartJob(TvrWorker::COMPUTE_FEATURES, TvrWorker::METRIC_BUNDLE);
+}
 
-  Mat3X X(3, document_.X.size());
-  for (int i = 0; i < X.cols(); ++i) {
-    X.col(i) = document_.X[i];
+void TvrMainWindow::CancelJob() {
+  worker_.Cancel();
+  QMainWindow::statusBar()->showMessage(
+    "Canceling, waiting for the current step to stop...");
+}
+
+void TvrMainWindow::StartJob(TvrWorker::Step first, TvrWorker::Step last) {
+  if (!worker_.Start(document_, first, last)) {
+    return;
   }
-  assert(x[0].cols() == X.cols());
-  assert(x[1].cols() == X.cols());
+  SetJobRunning(true);
+}
 
-  EuclideanBAFull(x, &K, &R, &t, &X);                 // Run BA.
+void TvrMainWindow::SetJobRunning(bool running) {
+  open_images_action_->setEnabled(!running);
+  matching_menu_->setEnabled(!running);
+  calibration_menu_->setEnabled(!running);
+  reconstruct_all_action_->setEnabled(!running);
+  cancel_job_action_->setEnabled(running);
+  progress_bar_->setValue(0);
+  progress_bar_->setVisible(running);
+}
 
-  for (int i = 0; i < 2; ++i) {
-    document_.K[i] = K[i];
-    document_.R[i] = R[i];
-    document_.t[i] = t[i];
-  }
-  for (int i = 0; i < X.cols(); ++i) {
-    document_.X[i] = X.col(i);
+void TvrMainWindow::JobProgress(int percent, const QString &message) {
+  progress_bar_->setValue(percent);
+  QMainWindow::statusBar()->showMessage(message);
+}
+
+// Shows the cameras and points of a reconstruction step as soon as they are
+// available; the finished job replaces them.
+void TvrMainWindow::JobPublished() {
+  worker_.TakePublished(&document_);
+  emit DocumentChanged();
+  UpdateViewers();
+}
+
+void TvrMainWindow::JobFinished(bool succeeded, const QString &message) {
+  // The worker may still be returning from run().
+  worker_.wait();
+  worker_.TakeDocument(&document_);
+  SetJobRunning(false);
+  emit DocumentChanged();
+  UpdateViewers();
+
+  if (succeeded || worker_.IsCanceled()) {
+    QMainWindow::statusBar()->showMessage(message);
+  } else {
+    QMessageBox::information(this, tr("TVR"), message);
   }
-  //TODO(pmoulon) : Display residuals before and after bundle adjustment)
-  QMainWindow::statusBar()->showMessage("End : MetricBundle");
 }
 
 void TvrMainWindow::UpdateViewers() {
@@ -30,6 +30,7 @@
 #include <QMenu>
 #include <QAction>
 #include <QMdiArea>
+#include <QProgressBar>
 #include <qgl.h>
 
 #include "ui/tvr/features.h"
@@ -37,6 +38,7 @@
 #include "ui/tvr/match_viewer.h"
 #include "ui/tvr/3D_viewer.h"
 #include "ui/tvr/gl_texture.h"
+#include "ui/tvr/tvr_worker.h"
 
 class TvrMainWindow : public QMainWindow {
   Q_OBJECT
@@ -51,12 +53,13 @@ class TvrMainWindow : public QMainWindow {
   void Show2DView();
   void Show3DView();
   void ComputeFeatures();
-  void ComputeFeatures(int image_index);
   void ComputeCandidateMatches();
   void ComputeRobustMatches();
   void FocalFromFundamental();
   void MetricReconstruction();
   void MetricBundle();
+  void ReconstructAll();
+  void CancelJob();
   void UpdateViewers();
   
   void InvalidateTextures();
@@ -66,10 +69,21 @@ class TvrMainWindow : public QMainWindow {
  signals:
   void TextureChanged();
   void GLUpdateNeeded();
+  // The cameras or the points of document_ changed.
+  void DocumentChanged();
+
+ private slots:
+  void JobProgress(int percent, const QString &message);
+  void JobPublished();
+  void JobFinished(bool succeeded, const QString &message);
     
  private:
   void CreateActions();
   void CreateMenus();
+  // Runs the steps first to last in the background, with the actions that
+  // change the document disabled until the job finishes.
+  void StartJob(TvrWorker::Step first, TvrWorker::Step last);
+  void SetJobRunning(bool running);
   void SynchronizeDepthmapList();
   
  private:
@@ -77,6 +91,7 @@ class TvrMainWindow : public QMainWindow {
   TvrDocument document_;
   QGLWidget context_;
   GLTexture textures_[2];
+  TvrWorker worker_;
 
   // Qt widgets, menus and actions.
   QMenu *file_menu_;
@@ -93,6 +108,9 @@ class TvrMainWindow : public QMainWindow {
   QAction *focal_from_fundamental_action_;
   QAction *metric_reconstruction_action_;
   QAction *metric_bundle_action_;
+  QAction *reconstruct_all_action_;
+  QAction *cancel_job_action_;
+  QProgressBar *progress_bar_;
 
   QMdiArea *viewers_area_;
 };
@@ -0,0 +1,149 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <algorithm>
+#include <cassert>
+
+#include "ui/tvr/point_octree.h"
+
+using libmv::Vec3f;
+
+namespace {
+
+int Octant(const Vec3f &point, const Vec3f &center) {
+  return (point(0) > center(0) ? 1 : 0) |
+         (point(1) > center(1) ? 2 : 0) |
+         (point(2) > center(2) ? 4 : 0);
+}
+
+// A fixed seed keeps the level of detail stable from one run to the next.
+void Shuffle(int *begin, int *end) {
+  unsigned int state = 12345;
+  for (int n = end - begin; n > 1; --n) {
+    state = state * 1103515245 + 12345;
+    std::swap(begin[n - 1], begin[(state >> 8) % n]);
+  }
+}
+
+template<typename T>
+void Permute(const std::vector<int> &order, std::vector<T> *values) {
+  std::vector<T> permuted(order.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    permuted[i] = (*values)[order[i]];
+  }
+  values->swap(permuted);
+}
+
+}  // namespace
+
+bool PointOctree::Node::IsLeaf() const {
+  for (int i = 0; i < 8; ++i) {
+    if (children[i] != -1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void PointOctree::Build(std::vector<Vec3f> *points,
+                        std::vector<Vec3f> *colors,
+                        int max_leaf_size,
+                        int max_depth) {
+  assert(points->size() == colors->size());
+  nodes_.clear();
+  max_leaf_size_ = max_leaf_size;
+  max_depth_ = max_depth;
+  if (points->empty()) {
+    return;
+  }
+
+  Vec3f min = (*points)[0], max = (*points)[0];
+  for (size_t i = 1; i < points->size(); ++i) {
+    min = min.cwiseMin((*points)[i]);
+    max = max.cwiseMax((*points)[i]);
+  }
+
+  int num_points = points->size();
+  std::vector<int> order(num_points), scratch(num_points);
+  for (int i = 0; i < num_points; ++i) {
+    order[i] = i;
+  }
+  BuildNode(*points, min, max, 0, num_points, 0, &order, &scratch);
+
+  Permute(order, points);
+  Permute(order, colors);
+}
+
+// Splits order[begin, end) by octant with a counting sort, so that the
+// children ranges follow each other, and recurses.
+int PointOctree::BuildNode(const std::vector<Vec3f> &points,
+                           const Vec3f &min, const Vec3f &max,
+                           int begin, int end, int depth,
+                           std::vector<int> *order,
+                           std::vector<int> *scratch) {
+  int index = nodes_.size();
+  nodes_.push_back(Node());
+  Node &node = nodes_.back();
+  node.min = min;
+  node.max = max;
+  node.begin = begin;
+  node.end = end;
+  std::fill(node.children, node.children + 8, -1);
+
+  if (end - begin <= max_leaf_size_ || depth >= max_depth_) {
+    Shuffle(&(*order)[begin], &(*order)[0] + end);
+    return index;
+  }
+
+  Vec3f center = (min + max) / 2;
+  int counts[8] = {0};
+  for (int i = begin; i < end; ++i) {
+    ++counts[Octant(points[(*order)[i]], center)];
+  }
+  int starts[9];
+  starts[0] = begin;
+  for (int i = 0; i < 8; ++i) {
+    starts[i + 1] = starts[i] + counts[i];
+  }
+  int next[8];
+  std::copy(starts, starts + 8, next);
+  for (int i = begin; i < end; ++i) {
+    int point = (*order)[i];
+    (*scratch)[next[Octant(points[point], center)]++] = point;
+  }
+  std::copy(&(*scratch)[begin], &(*scratch)[0] + end, &(*order)[begin]);
+
+  for (int i = 0; i < 8; ++i) {
+    if (counts[i] == 0) {
+      continue;
+    }
+    Vec3f child_min, child_max;
+    for (int k = 0; k < 3; ++k) {
+      bool upper = (i >> k) & 1;
+      child_min(k) = upper ? center(k) : min(k);
+      child_max(k) = upper ? max(k) : center(k);
+    }
+    // The recursion grows nodes_, so node may no longer be valid.
+    int child = BuildNode(points, child_min, child_max, starts[i],
+                          starts[i + 1], depth + 1, order, scratch);
+    nodes_[index].children[i] = child;
+  }
+  return index;
+}
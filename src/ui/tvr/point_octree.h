@@ -0,0 +1,65 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef UI_TVR_POINT_OCTREE_H_
+#define UI_TVR_POINT_OCTREE_H_
+
+#include <vector>
+
+#include "libmv/numeric/numeric.h"
+
+// An octree over a point cloud, for culling and level of detail when drawing.
+// Building it reorders the points so that the points of every node are the
+// contiguous range [begin, end), which can be drawn straight out of a vertex
+// buffer. The points of a leaf are shuffled, so any prefix of a leaf range is
+// a uniform subsample of the leaf.
+class PointOctree {
+ public:
+  struct Node {
+    libmv::Vec3f min, max;
+    int begin, end;
+    // Indices in nodes(), or -1 for the empty octants. All -1 for a leaf.
+    int children[8];
+
+    bool IsLeaf() const;
+  };
+
+  // Reorders points and colors in place. Nodes holding max_leaf_size points
+  // or less, or at max_depth, are not split.
+  void Build(std::vector<libmv::Vec3f> *points,
+             std::vector<libmv::Vec3f> *colors,
+             int max_leaf_size = 4096,
+             int max_depth = 16);
+
+  // The root is nodes()[0], if the cloud is not empty.
+  const std::vector<Node> &nodes() const { return nodes_; }
+
+ private:
+  int BuildNode(const std::vector<libmv::Vec3f> &points,
+                const libmv::Vec3f &min, const libmv::Vec3f &max,
+                int begin, int end, int depth,
+                std::vector<int> *order, std::vector<int> *scratch);
+
+  std::vector<Node> nodes_;
+  int max_leaf_size_;
+  int max_depth_;
+};
+
+#endif  // UI_TVR_POINT_OCTREE_H_
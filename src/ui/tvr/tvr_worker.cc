@@ -0,0 +1,562 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+
+#include "libmv/base/scoped_ptr.h"
+#include "libmv/base/vector.h"
+#include "libmv/base/vector_utils.h"
+#include "libmv/correspondence/feature_matching.h"
+#include "libmv/detector/detector.h"
+#include "libmv/detector/fast_detector.h"
+#include "libmv/descriptor/descriptor.h"
+#include "libmv/descriptor/simpliest_descriptor.h"
+#include "libmv/image/array_nd.h"
+#include "libmv/image/image.h"
+#include "libmv/logging/logging.h"
+#include "libmv/multiview/bundle.h"
+#include "libmv/multiview/focal_from_fundamental.h"
+#include "libmv/multiview/fundamental.h"
+#include "libmv/multiview/nviewtriangulation.h"
+#include "libmv/multiview/projection.h"
+#include "ui/tvr/features.h"
+#include "ui/tvr/tvr_worker.h"
+
+using namespace libmv;
+
+namespace {
+
+// Hands the reconstruction steps over to the worker, which publishes them.
+class PublishObserver : public ReconstructionObserver {
+ public:
+  explicit PublishObserver(TvrWorker *worker) : worker_(worker) {}
+
+  virtual void OnReconstructionStep(const Reconstruction &reconstruction,
+                                    const std::string &step_name) {
+    worker_->Publish(reconstruction, step_name);
+  }
+
+ private:
+  TvrWorker *worker_;
+};
+
+// The triangulation publishes its points this many times.
+const int kNumTriangulationSteps = 20;
+
+}  // namespace
+
+TvrWorker::TvrWorker(QObject *parent)
+    : QThread(parent),
+      canceled_(0),
+      features_computed_(false),
+      has_published_(false),
+      step_colors_(NULL) {
+  observer_ = new PublishObserver(this);
+}
+
+TvrWorker::~TvrWorker() {
+  Cancel();
+  wait();
+  delete observer_;
+}
+
+bool TvrWorker::Start(const TvrDocument &document, Step first, Step last) {
+  if (isRunning()) {
+    return false;
+  }
+  document_ = document;
+  first_ = first;
+  last_ = last;
+  canceled_ = 0;
+  features_computed_ = false;
+  {
+    QMutexLocker lock(&published_mutex_);
+    has_published_ = false;
+  }
+  start();
+  return true;
+}
+
+void TvrWorker::Cancel() {
+  canceled_ = 1;
+}
+
+bool TvrWorker::IsCanceled() const {
+  return canceled_ != 0;
+}
+
+// The matches point to the features, so the results are swapped, which keeps
+// the features where they are, rather than copied. The features are only
+// handed over when the job computed them; otherwise both the matches of the
+// job and of the document point to the features of the document.
+void TvrWorker::TakeDocument(TvrDocument *document) {
+  assert(!isRunning());
+  if (features_computed_) {
+    for (int i = 0; i < 2; ++i) {
+      document->feature_sets[i].features.swap(
+          document_.feature_sets[i].features);
+    }
+    features_computed_ = false;
+  }
+  std::swap(document->matches, document_.matches);
+  document->F = document_.F;
+  for (int i = 0; i < 2; ++i) {
+    document->focal_distance[i] = document_.focal_distance[i];
+    document->K[i] = document_.K[i];
+    document->R[i] = document_.R[i];
+    document->t[i] = document_.t[i];
+  }
+  document->X.swap(document_.X);
+  document->X_colors.swap(document_.X_colors);
+}
+
+void TvrWorker::TakePublished(TvrDocument *document) {
+  QMutexLocker lock(&published_mutex_);
+  if (!has_published_) {
+    return;
+  }
+  for (int i = 0; i < 2; ++i) {
+    document->K[i] = published_.K[i];
+    document->R[i] = published_.R[i];
+    document->t[i] = published_.t[i];
+  }
+  document->X = published_.X;
+  document->X_colors = published_.X_colors;
+}
+
+void TvrWorker::Publish(const Reconstruction &reconstruction,
+                        const std::string &step_name) {
+  VLOG(1) << "Publishing step " << step_name << " with "
+          << reconstruction.GetNumberStructures() << " points.";
+  {
+    QMutexLocker lock(&published_mutex_);
+    for (int i = 0; i < 2; ++i) {
+      PinholeCamera *camera =
+          dynamic_cast<PinholeCamera *>(reconstruction.GetCamera(i));
+      if (camera) {
+        published_.K[i] = camera->intrinsic_matrix();
+        published_.R[i] = camera->orientation_matrix();
+        published_.t[i] = camera->position();
+      }
+    }
+    published_.X.clear();
+    published_.X_colors.clear();
+    std::map<StructureID, Structure *>::const_iterator it =
+        reconstruction.structures().begin();
+    for (; it != reconstruction.structures().end(); ++it) {
+      PointStructure *point = dynamic_cast<PointStructure *>(it->second);
+      if (!point) {
+        continue;
+      }
+      published_.X.push_back(point->coords_affine());
+      if (step_colors_ && it->first < int(step_colors_->size())) {
+        published_.X_colors.push_back((*step_colors_)[it->first]);
+      } else {
+        published_.X_colors.push_back(Vec3f(1, 1, 1));
+      }
+    }
+    has_published_ = true;
+  }
+  emit Published();
+}
+
+void TvrWorker::run() {
+  QString message;
+  for (int step = first_; step <= last_; ++step) {
+    step_ = Step(step);
+    if (IsCanceled()) {
+      emit Finished(false, tr("Canceled."));
+      return;
+    }
+    if (!RunStep(step_, &message)) {
+      emit Finished(false, message);
+      return;
+    }
+    ReportProgress(1, message);
+  }
+  emit Finished(true, message);
+}
+
+bool TvrWorker::RunStep(Step step, QString *message) {
+  switch (step) {
+    case COMPUTE_FEATURES: return ComputeFeatures(message);
+    case COMPUTE_CANDIDATE_MATCHES: return ComputeCandidateMatches(message);
+    case COMPUTE_ROBUST_MATCHES: return ComputeRobustMatches(message);
+    case FOCAL_FROM_FUNDAMENTAL: return FocalFromFundamental(message);
+    case METRIC_RECONSTRUCTION: return MetricReconstruction(message);
+    case METRIC_BUNDLE: return MetricBundle(message);
+  }
+  return false;
+}
+
+void TvrWorker::ReportProgress(double fraction, const QString &message) {
+  double done = (step_ - first_ + fraction) / (last_ - first_ + 1);
+  emit Progress(int(100 * done), message);
+}
+
+bool TvrWorker::ComputeFeatures(QString *message) {
+  if (document_.images[0].isNull() || document_.images[1].isNull()) {
+    *message = tr("No images were loaded.");
+    return false;
+  }
+  FeatureSet feature_sets[2];
+  for (int i = 0; i < 2; ++i) {
+    if (IsCanceled()) {
+      *message = tr("ComputeFeatures canceled.");
+      return false;
+    }
+    ReportProgress(i / 2.,
+        tr("Start : ComputeFeatures for image : %1").arg(i));
+    ComputeFeatures(i, &feature_sets[i]);
+  }
+  for (int i = 0; i < 2; ++i) {
+    document_.feature_sets[i].features.swap(feature_sets[i].features);
+  }
+  // The matches point to the old features.
+  document_.matches = libmv::Matches();
+  features_computed_ = true;
+
+  *message = QString(" Number of features found : ")
+    + "Image 0 : "
+    + QString::number(document_.feature_sets[0].features.size())
+    + " , Image 1 : "
+    + QString::number(document_.feature_sets[1].features.size());
+  return true;
+}
+
+void TvrWorker::ComputeFeatures(int image_index, FeatureSet *feature_set) {
+  const QImage &qimage = document_.images[image_index];
+  int width = qimage.width(), height = qimage.height();
+  FeatureSet &fs = *feature_set;
+
+  // Convert to gray-scale.
+  // TODO(keir): Make a libmv image <-> QImage interop library inside libmv for
+  // easy bidirectional exchange of images between Qt and libmv.
+  Array3Du image(height, width);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      // TODO(pau): there are better ways to compute intensity.
+      //            Implement one and put it on libmv/image.
+      int depth = qimage.depth() / 8;
+      int bands = (depth == 4) ? 3 : depth;  // Skip alpha channel for RGBA.
+      int sum = 0;
+      for (int c = 0; c < bands; ++c) {
+        sum += qimage.bits()[depth*(y * width + x) + c];
+      }
+      image(y, x) = sum / bands;
+    }
+  }
+
+  scoped_ptr<detector::Detector> detector(detector::CreateFastDetector(9, 30, true));
+  //scoped_ptr<detector::Detector> detector(detector::CreateStarDetector());
+
+  vector<Feature *> features;
+  Image im(new Array3Du(image));
+  detector->Detect(im, &features, NULL);
+
+  vector<descriptor::Descriptor *> descriptors;
+  scoped_ptr<descriptor::Describer> describer(descriptor::CreateSimpliestDescriber());
+  //scoped_ptr<descriptor::Describer> describer(descriptor::CreateDaisyDescriber());
+  describer->Describe(features, im, NULL, &descriptors);
+
+  // Copy data.
+  fs.features.resize(descriptors.size());
+  for(int i = 0;i < descriptors.size(); ++i)
+  {
+    KeypointFeature & feat = fs.features[i];
+    feat.descriptor = *(descriptor::VecfDescriptor*)descriptors[i];
+    *(PointFeature*)(&feat) = *(PointFeature*)features[i];
+  }
+
+  DeleteElements(&descriptors);
+  DeleteElements(&features);
+}
+
+bool TvrWorker::ComputeCandidateMatches(QString *message) {
+  ReportProgress(0, "Start : ComputeCandidateMatches");
+
+  clock_t startTime = clock();
+  libmv::Matches matches;
+  FindCandidateMatches(document_.feature_sets[0],
+                       document_.feature_sets[1],
+                       &matches);
+  clock_t stopTime = clock();
+  double millisecond =  ((double)stopTime - startTime) / CLOCKS_PER_SEC;
+  if (IsCanceled()) {
+    *message = tr("ComputeCandidateMatches canceled.");
+    return false;
+  }
+  std::swap(document_.matches, matches);
+
+  *message = "End : ComputeCandidateMatches found : "
+        + QString::number(document_.matches.NumTracks()) + " matches in : "
+        + QString::number(millisecond) + " ms";
+  return true;
+}
+
+bool TvrWorker::ComputeRobustMatches(QString *message) {
+  if (document_.matches.NumTracks() == 0)  {
+    *message = tr("Cannot compute Robust Matches.\n"
+                  "No putative matches for robust test.");
+    return false;
+  }
+  ReportProgress(0, "Start : ComputeRobustMatches");
+
+  libmv::Matches new_matches;
+  Mat3 F;
+  ComputeFundamental(document_.matches, &F, &new_matches);
+  if (IsCanceled()) {
+    *message = tr("ComputeRobustMatches canceled.");
+    return false;
+  }
+  const int nbPointsBefore = document_.matches.NumTracks();
+  const int nbPointsAfter = new_matches.NumTracks();
+  // TODO(pau) Make sure this is not copying too many things.  We could
+  //           implement an efficient swap for the biparted graph (just swaping
+  //           the maps), or remove outlier tracks from the candidate matches
+  //           instead of constructing a new correspondance set.
+  document_.F = F;
+  std::swap(document_.matches, new_matches);
+
+  *message = "End : ComputeRobustMatches : "
+    + QString::number(nbPointsAfter) + " inliers "
+    + QString::number(nbPointsBefore-nbPointsAfter) + " outliers found ";
+  return true;
+}
+
+bool TvrWorker::FocalFromFundamental(QString *message) {
+  if (document_.matches.NumTracks() == 0)  {
+    *message = tr("Cannot compute Focal from Fundamental.\n"
+                  "Fundamental was not computed.");
+    return false;
+  }
+  ReportProgress(0, "Start : FocalFromFundamental");
+
+  vector<Mat> xs;
+  TwoViewPointMatchMatrices(document_.matches, 0, 1, &xs);
+  Mat &x1 = xs[0];
+  Mat &x2 = xs[1];
+
+  libmv::Vec2 p0((document_.images[0].width() - 1) / 2.,
+                 (document_.images[0].height() - 1) / 2.);
+  libmv::Vec2 p1((document_.images[1].width() - 1) / 2.,
+                 (document_.images[1].height() - 1) / 2.);
+
+  double focal_distance[2];
+  bool use_hartleys_method = false;
+  if (use_hartleys_method) {
+    libmv::FocalFromFundamental(document_.F, p0, p1,
+                                &focal_distance[0],
+                                &focal_distance[1]);
+    LOG(INFO) << "focal 0: " << focal_distance[0]
+              << " focal 1: " << focal_distance[1] << "\n";
+  } else {
+    double fmin_mm = 10;
+    double fmax_mm = 150;
+    double sensor_width_mm = 36; // Assuming a full-sized sensor 1x equiv.
+    double width_pix = document_.images[0].width();
+    libmv::FocalFromFundamentalExhaustive(document_.F, p0, x1, x2,
+                                          fmin_mm / sensor_width_mm * width_pix,
+                                          fmax_mm / sensor_width_mm * width_pix,
+                                          100,
+                                          &focal_distance[0]);
+    focal_distance[1] = focal_distance[0];
+
+    LOG(INFO) << "focal: " << focal_distance[0]
+              << "pix    35mm equiv: " << focal_distance[0]
+                                          * sensor_width_mm / width_pix
+              << "\n";
+  }
+  if (IsCanceled()) {
+    *message = tr("FocalFromFundamental canceled.");
+    return false;
+  }
+  document_.focal_distance[0] = focal_distance[0];
+  document_.focal_distance[1] = focal_distance[1];
+
+  *message = QString("End : FocalFromFundamental. ")
+    + "Focal (pix) estimated to : " + QString::number(focal_distance[0])
+    + "for Image 0 and to : " + QString::number(focal_distance[1])
+    + "for Image 1.";
+  return true;
+}
+
+bool TvrWorker::MetricReconstruction(QString *message) {
+  if (document_.matches.NumTracks() == 0)  {
+    *message = tr("Cannot compute Metric reconstruction."
+                  "\nGeometric correspondence list is empty.");
+    return false;
+  }
+  ReportProgress(0, "Start : MetricReconstruction");
+
+  Vec2 p0((document_.images[0].width() - 1) / 2.,
+          (document_.images[0].height() - 1) / 2.);
+  Vec2 p1((document_.images[1].width() - 1) / 2.,
+          (document_.images[1].height() - 1) / 2.);
+  double f0 = document_.focal_distance[0];
+  double f1 = document_.focal_distance[1];
+  Mat3 K[2], R[2];
+  Vec3 t[2];
+  K[0] << f0,  0, p0(0),
+           0, f0, p0(1),
+           0,  0,     1;
+  K[1] << f1,  0, p1(0),
+           0, f1, p1(1),
+           0,  0,     1;
+
+  // Compute essential matrix
+  Mat3 E;
+  EssentialFromFundamental(document_.F, K[0], K[1], &E);
+
+  // Get matches from the correspondence structure.
+  vector<Mat> xs(2);
+  TwoViewPointMatchMatrices(document_.matches, 0, 1, &xs);
+  Mat &x0 = xs[0];
+  Mat &x1 = xs[1];
+
+  // Recover R, t from E and K
+  MotionFromEssentialAndCorrespondence(E, K[0], x0.col(0), K[1], x1.col(0),
+                                       &R[1], &t[1]);
+  R[0] = Mat3::Identity();
+  t[0] = Vec3::Zero();
+
+  LOG(INFO) << "R:\n" << R[1] << "\nt:\n" << t[1];
+
+  // Triangulate features, publishing the points as they come.
+  vector<Mat34> Ps(2);
+  P_From_KRt(K[0], R[0], t[0], &Ps[0]);
+  P_From_KRt(K[1], R[1], t[1], &Ps[1]);
+
+  int n = x0.cols();
+  vector<Vec3> X(n);
+  vector<Vec3f> X_colors(n);
+  int publish_period = std::max(1, n / kNumTriangulationSteps);
+  for (int i = 0; i < n; ++i) {
+    Mat2X x(2, 2);
+    x.col(0) = x0.col(i);
+    x.col(1) = x1.col(i);
+    Vec4 Xh;
+    NViewTriangulate(x, Ps, &Xh);
+    X[i] = libmv::HomogeneousToEuclidean(Xh);
+
+    // Get 3D point color from first image.
+    QRgb rgb = document_.images[0].pixel(int(round(x0(0,i))),
+                                         int(round(x0(1,i))));
+    X_colors[i] << qBlue(rgb), qGreen(rgb), qRed(rgb);
+    X_colors[i] /= 255;
+
+    if ((i + 1) % publish_period == 0 && i + 1 < n) {
+      if (IsCanceled()) {
+        *message = tr("MetricReconstruction canceled.");
+        return false;
+      }
+      NotifyStep(K, R, t, X, X_colors, i + 1, "triangulation");
+      ReportProgress(double(i + 1) / n, tr("Triangulated %1 of %2 points")
+                                        .arg(i + 1).arg(n));
+    }
+  }
+  NotifyStep(K, R, t, X, X_colors, n, "metric");
+
+  for (int i = 0; i < 2; ++i) {
+    document_.K[i] = K[i];
+    document_.R[i] = R[i];
+    document_.t[i] = t[i];
+  }
+  document_.X.swap(X);
+  document_.X_colors.swap(X_colors);
+
+  *message = "End : MetricReconstruction";
+  return true;
+}
+
+bool TvrWorker::MetricBundle(QString *message) {
+  if (document_.matches.NumTracks() == 0)  {
+    *message = tr("Cannot compute Metric bundle adjustement."
+                  "\nGeometric correspondence list is empty.");
+    return false;
+  }
+  ReportProgress(0, "Start : MetricBundle");
+
+  vector<Mat3> K(2);
+  vector<Mat3> R(2);
+  vector<Vec3> t(2);
+  for (int i = 0; i < 2; ++i) {
+    K[i] = document_.K[i];
+    R[i] = document_.R[i];
+    t[i] = document_.t[i];
+  }
+  vector<Mat2X> x(2);
+  vector<Mat> xs(2);
+  TwoViewPointMatchMatrices(document_.matches, 0, 1, &xs);
+  for (int i = 0; i < 2; ++i) {
+    x[i] = xs[i];
+  }
+
+  Mat3X X(3, document_.X.size());
+  for (int i = 0; i < X.cols(); ++i) {
+    X.col(i) = document_.X[i];
+  }
+  assert(x[0].cols() == X.cols());
+  assert(x[1].cols() == X.cols());
+
+  EuclideanBAFull(x, &K, &R, &t, &X);                 // Run BA.
+  if (IsCanceled()) {
+    *message = tr("MetricBundle canceled.");
+    return false;
+  }
+
+  for (int i = 0; i < 2; ++i) {
+    document_.K[i] = K[i];
+    document_.R[i] = R[i];
+    document_.t[i] = t[i];
+  }
+  for (int i = 0; i < X.cols(); ++i) {
+    document_.X[i] = X.col(i);
+  }
+  NotifyStep(document_.K, document_.R, document_.t, document_.X,
+             document_.X_colors, document_.X.size(), "bundle");
+  //TODO(pmoulon) : Display residuals before and after bundle adjustment)
+  *message = "End : MetricBundle";
+  return true;
+}
+
+void TvrWorker::NotifyStep(const Mat3 K[2], const Mat3 R[2], const Vec3 t[2],
+                           const vector<Vec3> &X,
+                           const vector<Vec3f> &X_colors,
+                           int num_points, const std::string &step_name) {
+  Reconstruction reconstruction;
+  for (int i = 0; i < 2; ++i) {
+    reconstruction.InsertCamera(i, new PinholeCamera(K[i], R[i], t[i]));
+  }
+  for (int i = 0; i < num_points; ++i) {
+    reconstruction.InsertTrack(i, new PointStructure(X[i]));
+  }
+  step_colors_ = &X_colors;
+  NotifyReconstructionStep(observer_, reconstruction, step_name);
+  step_colors_ = NULL;
+
+  // The reconstruction does not delete its cameras and structures.
+  reconstruction.ClearCamerasMap();
+  reconstruction.ClearStructuresMap();
+}
@@ -0,0 +1,127 @@
+// Copyright (c) 2011 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+#ifndef UI_TVR_TVR_WORKER_H_
+#define UI_TVR_TVR_WORKER_H_
+
+#include <QAtomicInt>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+
+#include <string>
+
+#include "libmv/reconstruction/reconstruction_observer.h"
+#include "ui/tvr/tvr_document.h"
+
+// Runs the matching and reconstruction steps of tvr in a thread of its own,
+// on a copy of the document, so that the interface stays responsive. The
+// steps only write to the copy when they complete, so a canceled job leaves
+// the copy with the steps completed so far.
+//
+// While the reconstruction steps run, their cameras and points are reported
+// to a ReconstructionObserver which publishes them: Published() is emitted,
+// and TakePublished() hands them to the GUI thread for display.
+class TvrWorker : public QThread {
+  Q_OBJECT
+
+ public:
+  // In the order of the pipeline.
+  enum Step {
+    COMPUTE_FEATURES,
+    COMPUTE_CANDIDATE_MATCHES,
+    COMPUTE_ROBUST_MATCHES,
+    FOCAL_FROM_FUNDAMENTAL,
+    METRIC_RECONSTRUCTION,
+    METRIC_BUNDLE
+  };
+
+  TvrWorker(QObject *parent = 0);
+  // Cancels the running job and waits for it.
+  virtual ~TvrWorker();
+
+  // Runs the steps first to last on a copy of document. Returns false if a
+  // job is already running.
+  bool Start(const TvrDocument &document, Step first, Step last);
+  // The current step stops at its next check, and the later steps are
+  // skipped. The candidate matching, the robust fit and the bundle adjustment
+  // cannot be interrupted and run to their end.
+  void Cancel();
+  bool IsCanceled() const;
+
+  // Moves the results of the job into document, once Finished() is emitted.
+  // The images of document are left alone.
+  void TakeDocument(TvrDocument *document);
+  // Copies the cameras and points of the last published step into document.
+  void TakePublished(TvrDocument *document);
+
+  // Called by the observer, on the worker thread.
+  void Publish(const libmv::Reconstruction &reconstruction,
+               const std::string &step_name);
+
+ signals:
+  // Percent of the whole job.
+  void Progress(int percent, const QString &message);
+  void Published();
+  // Message sums up the last step, or tells why the job stopped: it failed,
+  // or it was canceled if IsCanceled().
+  void Finished(bool succeeded, const QString &message);
+
+ protected:
+  void run();
+
+ private:
+  bool RunStep(Step step, QString *message);
+  bool ComputeFeatures(QString *message);
+  void ComputeFeatures(int image_index, FeatureSet *feature_set);
+  bool ComputeCandidateMatches(QString *message);
+  bool ComputeRobustMatches(QString *message);
+  bool FocalFromFundamental(QString *message);
+  bool MetricReconstruction(QString *message);
+  bool MetricBundle(QString *message);
+
+  // Fraction is the part of the current step done.
+  void ReportProgress(double fraction, const QString &message);
+  // Notifies observer_ of the two cameras and of the first num_points of X.
+  void NotifyStep(const libmv::Mat3 K[2], const libmv::Mat3 R[2],
+                  const libmv::Vec3 t[2], const vector<libmv::Vec3> &X,
+                  const vector<libmv::Vec3f> &X_colors,
+                  int num_points, const std::string &step_name);
+
+  // Only touched by the worker thread while the job runs.
+  TvrDocument document_;
+  Step first_, last_, step_;
+  // The job replaced the features of the document.
+  bool features_computed_;
+
+  QAtomicInt canceled_;
+
+  // Protects published_ and has_published_.
+  QMutex published_mutex_;
+  TvrDocument published_;
+  bool has_published_;
+  // The colors of the points being notified, read by Publish().
+  const vector<libmv::Vec3f> *step_colors_;
+
+  libmv::ReconstructionObserver *observer_;
+};
+
+#endif  // UI_TVR_TVR_WORKER_H_